@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _EVL_ARM_ASM_TICK_H
+#define _EVL_ARM_ASM_TICK_H
+
+#include <linux/clockchips.h>
+#include <asm/arch_timer.h>
+
+/*
+ * Program the CP15 comparator of the per-CPU architected timer
+ * directly, this is what the clockevent handler of the arch timer
+ * driver would do, minus the indirect call.
+ */
+static inline int evl_arch_get_direct_tick(struct clock_event_device *real_dev)
+{
+	return arch_timer_get_oob_access(real_dev);
+}
+
+static __always_inline
+void __evl_program_direct_tick(const int access, u64 cycles)
+{
+	unsigned long ctrl;
+	u64 cnt;
+
+	ctrl = arch_timer_reg_read_cp15(access, ARCH_TIMER_REG_CTRL);
+	ctrl |= ARCH_TIMER_CTRL_ENABLE;
+	ctrl &= ~ARCH_TIMER_CTRL_IT_MASK;
+
+	if (access == ARCH_TIMER_PHYS_ACCESS)
+		cnt = __arch_counter_get_cntpct();
+	else
+		cnt = __arch_counter_get_cntvct();
+
+	arch_timer_reg_write_cp15(access, ARCH_TIMER_REG_CVAL, cnt + cycles);
+	arch_timer_reg_write_cp15(access, ARCH_TIMER_REG_CTRL, ctrl);
+}
+
+static inline void evl_arch_program_direct_tick(int access, u64 cycles)
+{
+	if (access == ARCH_TIMER_VIRT_ACCESS)
+		__evl_program_direct_tick(ARCH_TIMER_VIRT_ACCESS, cycles);
+	else
+		__evl_program_direct_tick(ARCH_TIMER_PHYS_ACCESS, cycles);
+}
+
+#endif /* !_EVL_ARM_ASM_TICK_H */
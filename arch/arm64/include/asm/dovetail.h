@@ -19,6 +19,7 @@
 #define ARM64_TRAP_SVE		7	/* SVE access trap */
 #define ARM64_TRAP_BTI		8	/* Branch target identification */
 #define ARM64_TRAP_SME		9	/* SME access trap */
+#define ARM64_TRAP_BRK		10	/* BRK instruction from EL0 */
 
 #ifdef CONFIG_DOVETAIL
 
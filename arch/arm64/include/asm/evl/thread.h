@@ -2,9 +2,46 @@
 #ifndef _EVL_ARM64_ASM_THREAD_H
 #define _EVL_ARM64_ASM_THREAD_H
 
+#include <asm/insn-def.h>
+#include <asm/ptrace.h>
+#include <asm/sysreg.h>
+
 static inline bool evl_is_breakpoint(int trapnr)
 {
-	return trapnr == ARM64_TRAP_DEBUG || trapnr == ARM64_TRAP_UNDI;
+	return trapnr == ARM64_TRAP_DEBUG || trapnr == ARM64_TRAP_BRK ||
+		trapnr == ARM64_TRAP_UNDI;
+}
+
+/* Trap classes the core may handle out-of-band (see thread.c). */
+#define EVL_OOB_TRAP_FPE	ARM64_TRAP_FPE
+#define EVL_OOB_TRAP_BRK	ARM64_TRAP_BRK
+
+/* IOE, DZE, OFE, UFE, IXE and IDE in FPCR. */
+#define EVL_FPCR_TRAP_BITS	(GENMASK(12, 8) | BIT(15))
+
+/*
+ * Disable FP exception trapping for the current task, so that the
+ * faulting instruction yields the IEEE default result when
+ * restarted. The sticky flags stay in FPSR. The user FP context is
+ * live since the task trapped on an FP instruction.
+ */
+static inline bool evl_fixup_fpe_trap(struct pt_regs *regs)
+{
+	write_sysreg(read_sysreg(fpcr) & ~EVL_FPCR_TRAP_BITS, fpcr);
+
+	return true;
+}
+
+/* Step over a BRK instruction, the A32/T32 encodings are left alone. */
+static inline bool evl_fixup_brk_trap(struct pt_regs *regs)
+{
+	if (compat_user_mode(regs))
+		return false;
+
+	instruction_pointer_set(regs,
+		instruction_pointer(regs) + AARCH64_INSN_SIZE);
+
+	return true;
 }
 
 #endif /* !_EVL_ARM64_ASM_THREAD_H */
@@ -86,6 +86,7 @@ extern void fpsimd_kvm_prepare(void);
 extern void fpsimd_restore_current_oob(void);
 extern void fpsimd_suspend_inband(void);
 extern void fpsimd_resume_inband(void);
+extern void sve_oob_syscall_entry(void);
 #endif
 
 struct cpu_fp_state {
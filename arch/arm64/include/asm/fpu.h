@@ -12,4 +12,7 @@
 #define kernel_fpu_begin()	kernel_neon_begin()
 #define kernel_fpu_end()	kernel_neon_end()
 
+#define oob_kernel_fpu_begin()	oob_kernel_neon_begin()
+#define oob_kernel_fpu_end()	oob_kernel_neon_end()
+
 #endif /* ! __ASM_FPU_H */
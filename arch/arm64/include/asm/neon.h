@@ -16,4 +16,8 @@
 void kernel_neon_begin(void);
 void kernel_neon_end(void);
 
+/* Kernel mode NEON from any stage, hard irqs off in between. */
+void oob_kernel_neon_begin(void);
+void oob_kernel_neon_end(void);
+
 #endif /* ! __ASM_NEON_H */
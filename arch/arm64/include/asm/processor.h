@@ -172,6 +172,10 @@ struct thread_struct {
 
 	struct user_fpsimd_state	kernel_fpsimd_state;
 	unsigned int			kernel_fpsimd_cpu;
+#ifdef CONFIG_EVL_LAZY_SVE
+	unsigned int			oob_sve_level;	/* SVE ownership */
+	unsigned int			oob_sve_credit;
+#endif
 #ifdef CONFIG_ARM64_PTR_AUTH
 	struct ptrauth_keys_user	keys_user;
 #ifdef CONFIG_ARM64_PTR_AUTH_KERNEL
@@ -284,9 +284,19 @@ static __always_inline bool exit_to_user_mode_prepare(struct pt_regs *regs)
 		 * Caution: do_notify_resume() might have switched us
 		 * to the out-of-band stage.
 		 */
-		return running_inband();
+		if (running_inband())
+			return true;
 	}
 
+	/*
+	 * Complete the fpsimd restore fpsimd_restore_current_oob()
+	 * deferred on switching in, now that we know we are resuming
+	 * user mode on the out-of-band stage.
+	 */
+	if (IS_ENABLED(CONFIG_EVL_LAZY_FPU) && running_oob() &&
+		test_thread_flag(TIF_FOREIGN_FPSTATE))
+		fpsimd_restore_current_state();
+
 	return false;
 }
 
@@ -628,6 +638,9 @@ static inline void fp_user_discard(void)
 		sve_vq_minus_one = sve_vq_from_vl(task_get_sve_vl(current)) - 1;
 		sve_flush_live(true, sve_vq_minus_one);
 	}
+
+	if (IS_ENABLED(CONFIG_EVL_LAZY_SVE) && running_oob())
+		sve_oob_syscall_entry();
 }
 
 UNHANDLED(el1t, 64, sync)
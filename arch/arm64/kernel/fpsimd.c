@@ -182,10 +182,13 @@ static inline void set_sve_default_vl(int val)
 
 static void __percpu *efi_sve_state;
 
+static void __percpu *oob_sve_state;
+
 #else /* ! CONFIG_ARM64_SVE */
 
 /* Dummy declaration for code that will be optimised out: */
 extern void __percpu *efi_sve_state;
+extern void __percpu *oob_sve_state;
 
 #endif /* ! CONFIG_ARM64_SVE */
 
@@ -231,7 +234,18 @@ void fpsimd_restore_current_oob(void)
 	 * on the out-of-band stage. Skip this for kernel threads
 	 * which have no such context but always bear
 	 * TIF_FOREIGN_FPSTATE.
+	 *
+	 * With CONFIG_EVL_LAZY_FPU, leave TIF_FOREIGN_FPSTATE set
+	 * and defer the restore until the task actually returns to
+	 * user mode from the out-of-band stage (see
+	 * exit_to_user_mode_prepare()). This spares the restore for
+	 * tasks which are switched out again before then, e.g. when
+	 * preempted or blocking in the kernel, or switching inband
+	 * where the regular return path takes care of it.
 	 */
+	if (IS_ENABLED(CONFIG_EVL_LAZY_FPU))
+		return;
+
 	if (current->mm)
 		fpsimd_restore_current_state();
 }
@@ -1153,17 +1167,32 @@ int vec_verify_vq_map(enum vec_type type)
 	return 0;
 }
 
+static void __init sve_oob_setup(int max_vl)
+{
+	if (!IS_ENABLED(CONFIG_DOVETAIL) ||
+		!IS_ENABLED(CONFIG_KERNEL_MODE_NEON))
+		return;
+
+	oob_sve_state = __alloc_percpu(
+		SVE_SIG_REGS_SIZE(sve_vq_from_vl(max_vl)), SVE_VQ_BYTES);
+	if (!oob_sve_state)
+		panic("Cannot allocate percpu memory for oob SVE save/restore");
+}
+
 static void __init sve_efi_setup(void)
 {
 	int max_vl = 0;
 	int i;
 
-	if (!IS_ENABLED(CONFIG_EFI))
-		return;
-
 	for (i = 0; i < ARRAY_SIZE(vl_info); i++)
 		max_vl = max(vl_info[i].max_vl, max_vl);
 
+	if (sve_vl_valid(max_vl))
+		sve_oob_setup(max_vl);
+
+	if (!IS_ENABLED(CONFIG_EFI))
+		return;
+
 	/*
 	 * alloc_percpu() warns and prints a backtrace if this goes wrong.
 	 * This is evidence of a crippled system and we are returning void,
@@ -1412,6 +1441,98 @@ static void sve_init_regs(void)
 	}
 }
 
+#ifdef CONFIG_EVL_LAZY_SVE
+
+/*
+ * SVE ownership tracking for threads running out-of-band. Since the
+ * ABI allows us to discard the state not shared with FPSIMD on
+ * syscall, we revoke SVE access from the caller of an oob syscall
+ * unless it is considered an owner, so that only the FPSIMD state
+ * has to be switched until it uses SVE again. The access trap which
+ * follows is handled on the out-of-band stage provided the SVE
+ * storage exists; each of them raises the ownership level of the
+ * thread, allowing it to keep SVE access for 2^level - 1 further
+ * syscalls. Conversely, the level decays for every syscall issued
+ * while SVE is not in use.
+ */
+#define OOB_SVE_MAX_LEVEL	8
+
+/* Hard irqs off, in-syscall on the out-of-band stage. */
+void sve_oob_syscall_entry(void)
+{
+	struct thread_struct *t = &current->thread;
+
+	if (!system_supports_sve())
+		return;
+
+	if (!test_thread_flag(TIF_SVE)) {
+		if (t->oob_sve_level)
+			t->oob_sve_level--;
+		return;
+	}
+
+	if (t->oob_sve_credit) {
+		t->oob_sve_credit--;
+		return;
+	}
+
+	/*
+	 * The live registers only hold the FPSIMD state at this
+	 * point (see fp_user_discard()), stop tracking SVE until
+	 * next use.
+	 */
+	if (!test_thread_flag(TIF_FOREIGN_FPSTATE)) {
+		clear_thread_flag(TIF_SVE);
+		sve_user_disable();
+	}
+}
+
+/*
+ * Re-enable SVE for an oob thread which dropped it on syscall,
+ * without leaving the out-of-band stage. The first access still has
+ * to be handled in-band, since the SVE storage is allocated there.
+ */
+static bool do_oob_sve_acc(void)
+{
+	struct thread_struct *t = &current->thread;
+	unsigned long flags;
+
+	if (!running_oob() || !t->sve_state ||
+		!system_supports_sve() || is_compat_task())
+		return false;
+
+	/*
+	 * If the state is live, sve_init_regs() flushes the
+	 * registers, the in-memory copy is rewritten on next save.
+	 */
+	if (test_thread_flag(TIF_FOREIGN_FPSTATE))
+		memset(t->sve_state, 0, sve_state_size(current));
+
+	get_cpu_fpsimd_context(flags);
+
+	if (test_and_set_thread_flag(TIF_SVE))
+		WARN_ON(1); /* SVE access shouldn't have trapped */
+
+	sve_init_regs();
+
+	put_cpu_fpsimd_context(flags);
+
+	t->oob_sve_level = min_t(unsigned int, t->oob_sve_level + 1,
+				OOB_SVE_MAX_LEVEL);
+	t->oob_sve_credit = (1U << t->oob_sve_level) - 1;
+
+	return true;
+}
+
+#else
+
+static inline bool do_oob_sve_acc(void)
+{
+	return false;
+}
+
+#endif	/* !CONFIG_EVL_LAZY_SVE */
+
 /*
  * Trapped SVE access
  *
@@ -1427,6 +1548,9 @@ void do_sve_acc(unsigned long esr, struct pt_regs *regs)
 {
 	unsigned long flags;
 
+	if (do_oob_sve_acc())
+		return;
+
 	oob_trap_notify(ARM64_TRAP_SVE, regs);
 
 	/* Even if we chose not to use SVE, the hardware could still trap: */
@@ -1556,7 +1680,9 @@ void do_fpsimd_exc(unsigned long esr, struct pt_regs *regs)
 			si_code = FPE_FLTRES;
 	}
 
-	oob_trap_notify(ARM64_TRAP_FPE, regs);
+	/* The companion core may have fixed this up out-of-band. */
+	if (!mark_cond_trap_entry(ARM64_TRAP_FPE, regs))
+		return;
 
 	send_sig_fault(SIGFPE, si_code,
 		       (void __user *)instruction_pointer(regs),
@@ -1708,6 +1834,10 @@ void fpsimd_flush_thread(void)
 		current->thread.sve_state = NULL;
 
 		fpsimd_flush_thread_vl(ARM64_VEC_SVE);
+#ifdef CONFIG_EVL_LAZY_SVE
+		current->thread.oob_sve_level = 0;
+		current->thread.oob_sve_credit = 0;
+#endif
 	}
 
 	if (system_supports_sme()) {
@@ -2153,6 +2283,105 @@ void __efi_fpsimd_end(void)
 
 #endif /* CONFIG_EFI */
 
+#ifdef CONFIG_DOVETAIL
+
+static DEFINE_PER_CPU(struct user_fpsimd_state, oob_fpsimd_state);
+static DEFINE_PER_CPU(unsigned int, oob_neon_depth);
+static DEFINE_PER_CPU(unsigned long, oob_neon_flags);
+static DEFINE_PER_CPU(bool, oob_sve_state_used);
+static DEFINE_PER_CPU(bool, oob_sm_state);
+
+/*
+ * oob_kernel_neon_begin(): obtain the CPU FPSIMD registers from any
+ * stage.
+ *
+ * kernel_neon_begin() relies on in-band preemption and softirq
+ * masking, which the oob stage ignores. This variant may be called
+ * from the oob stage as well, including from oob interrupt
+ * handlers: hard irqs are kept off until the matching call to
+ * oob_kernel_neon_end(), and the live register state is saved to a
+ * per-CPU area then restored on exit, whichever context owns it,
+ * the same way __efi_fpsimd_begin() does when !may_use_simd(). On
+ * SVE capable parts, the full vector state has to be preserved,
+ * since writing to the V registers zeroes the upper bits of the Z
+ * registers. Nested calls only bump a depth count. Callers should
+ * keep such sections short.
+ */
+void oob_kernel_neon_begin(void)
+{
+	unsigned long flags;
+	char *sve_state;
+	bool ffr = true;
+	u64 svcr;
+
+	if (WARN_ON(!system_supports_fpsimd()))
+		return;
+
+	flags = hard_local_irq_save();
+
+	if (__this_cpu_inc_return(oob_neon_depth) > 1)
+		return;
+
+	__this_cpu_write(oob_neon_flags, flags);
+
+	if (system_supports_sve() && likely(oob_sve_state)) {
+		sve_state = this_cpu_ptr(oob_sve_state);
+		__this_cpu_write(oob_sve_state_used, true);
+
+		if (system_supports_sme()) {
+			svcr = read_sysreg_s(SYS_SVCR);
+			__this_cpu_write(oob_sm_state, svcr & SVCR_SM_MASK);
+			/* Unless we have FA64 FFR does not exist in streaming mode. */
+			if (!system_supports_fa64())
+				ffr = !(svcr & SVCR_SM_MASK);
+		}
+
+		sve_save_state(sve_state + sve_ffr_offset(sve_max_vl()),
+			&this_cpu_ptr(&oob_fpsimd_state)->fpsr, ffr);
+
+		/* Neon is not available in streaming mode. */
+		if (system_supports_sme())
+			sysreg_clear_set_s(SYS_SVCR, SVCR_SM_MASK, 0);
+	} else {
+		fpsimd_save_state(this_cpu_ptr(&oob_fpsimd_state));
+	}
+}
+EXPORT_SYMBOL_GPL(oob_kernel_neon_begin);
+
+void oob_kernel_neon_end(void)
+{
+	char const *sve_state;
+	bool ffr = true;
+
+	if (!system_supports_fpsimd())
+		return;
+
+	WARN_ON_ONCE(!hard_irqs_disabled());
+
+	if (__this_cpu_dec_return(oob_neon_depth) > 0)
+		return;
+
+	if (__this_cpu_xchg(oob_sve_state_used, false)) {
+		sve_state = this_cpu_ptr(oob_sve_state);
+
+		if (system_supports_sme() && __this_cpu_read(oob_sm_state)) {
+			sysreg_clear_set_s(SYS_SVCR, 0, SVCR_SM_MASK);
+			if (!system_supports_fa64())
+				ffr = false;
+		}
+
+		sve_load_state(sve_state + sve_ffr_offset(sve_max_vl()),
+			&this_cpu_ptr(&oob_fpsimd_state)->fpsr, ffr);
+	} else {
+		fpsimd_load_state(this_cpu_ptr(&oob_fpsimd_state));
+	}
+
+	hard_local_irq_restore(__this_cpu_read(oob_neon_flags));
+}
+EXPORT_SYMBOL_GPL(oob_kernel_neon_end);
+
+#endif /* CONFIG_DOVETAIL */
+
 #endif /* CONFIG_KERNEL_MODE_NEON */
 
 #ifdef CONFIG_CPU_PM
@@ -1017,8 +1017,20 @@ void do_debug_exception(unsigned long addr_if_watchpoint, unsigned long esr,
 {
 	const struct fault_info *inf = esr_to_debug_fault_info(esr);
 	unsigned long pc = instruction_pointer(regs);
+	int trapnr = ARM64_TRAP_DEBUG;
 
-	mark_trap_entry(ARM64_TRAP_DEBUG, regs);
+	if (user_mode(regs) && ESR_ELx_EC(esr) == ESR_ELx_EC_BRK64)
+		trapnr = ARM64_TRAP_BRK;
+
+	/*
+	 * The companion core may step over a user BRK out-of-band,
+	 * anything else must be handled in-band.
+	 */
+	if (!mark_cond_trap_entry(trapnr, regs)) {
+		if (trapnr == ARM64_TRAP_BRK)
+			return;
+		BUG_ON(dovetail_debug());
+	}
 
 	debug_exception_enter(regs);
 
@@ -1031,7 +1043,7 @@ void do_debug_exception(unsigned long addr_if_watchpoint, unsigned long esr,
 
 	debug_exception_exit(regs);
 
-	mark_trap_exit(ARM64_TRAP_DEBUG, regs);
+	mark_trap_exit(trapnr, regs);
 }
 NOKPROBE_SYMBOL(do_debug_exception);
 
@@ -18,6 +18,9 @@
 
 #define ARCH_APICTIMER_STOPS_ON_C3	1
 
+/* Divisor applied to the TSC rate by the lapic-deadline clockevent */
+#define TSC_DIVISOR	8
+
 /* Macros for apic_extnmi which controls external NMI masking */
 #define APIC_EXTNMI_BSP		0 /* Default */
 #define APIC_EXTNMI_ALL		1
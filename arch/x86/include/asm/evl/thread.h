@@ -2,11 +2,45 @@
 #ifndef _EVL_X86_ASM_THREAD_H
 #define _EVL_X86_ASM_THREAD_H
 
+#include <linux/sched.h>
 #include <asm/traps.h>
+#include <asm/fpu/types.h>
 
 static inline bool evl_is_breakpoint(int trapnr)
 {
 	return trapnr == X86_TRAP_DB || trapnr == X86_TRAP_BP;
 }
 
+/* Trap classes the core may handle out-of-band (see thread.c). */
+#define EVL_OOB_TRAP_FPE	X86_TRAP_XF
+#define EVL_OOB_TRAP_BRK	X86_TRAP_BP
+
+/* All exception mask bits in MXCSR. */
+#define EVL_MXCSR_MASK_BITS	0x1f80
+
+/*
+ * Mask the SIMD FP exceptions for the current task, so that the
+ * faulting instruction yields the IEEE default result when
+ * restarted. The sticky flags stay in MXCSR. math_error() synced
+ * the register file to memory already, update both copies.
+ */
+static inline bool evl_fixup_fpe_trap(struct pt_regs *regs)
+{
+	struct fpstate *fps = current->thread.fpu.fpstate;
+	u32 mxcsr;
+
+	asm volatile("stmxcsr %0" : "=m" (mxcsr));
+	mxcsr |= EVL_MXCSR_MASK_BITS;
+	asm volatile("ldmxcsr %0" :: "m" (mxcsr));
+	fps->regs.fxsave.mxcsr |= EVL_MXCSR_MASK_BITS;
+
+	return true;
+}
+
+/* INT3 is a trap, the instruction pointer is past it already. */
+static inline bool evl_fixup_brk_trap(struct pt_regs *regs)
+{
+	return true;
+}
+
 #endif /* !_EVL_X86_ASM_THREAD_H */
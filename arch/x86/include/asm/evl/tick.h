@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _EVL_X86_ASM_TICK_H
+#define _EVL_X86_ASM_TICK_H
+
+#include <linux/clockchips.h>
+#include <linux/string.h>
+#include <linux/minmax.h>
+#include <asm/apic.h>
+#include <asm/msr.h>
+#include <asm/tsc.h>
+
+/* Access modes to the local APIC timer. */
+#define EVL_APIC_TSC_DEADLINE	0
+#define EVL_APIC_X2APIC_COUNT	1
+
+/*
+ * Program the TSC deadline of the local APIC directly, this is what
+ * the clockevent handler of the lapic-deadline device would do,
+ * minus the indirect call and interrupt masking, since we run with
+ * hard irqs off already.
+ *
+ * Virtual machines may not expose the TSC deadline mode, leaving us
+ * with the oneshot count of the lapic device. We may program the
+ * latter directly too in x2APIC mode, which is common with KVM
+ * guests, since the host then handles the MSR write in-kernel,
+ * arming the high-resolution timer backing the virtual APIC timer
+ * without the instruction decoding a MMIO access would require.
+ */
+static inline int evl_arch_get_direct_tick(struct clock_event_device *real_dev)
+{
+	if (!strcmp(real_dev->name, "lapic-deadline"))
+		return this_cpu_has(X86_FEATURE_TSC_DEADLINE_TIMER) ?
+			EVL_APIC_TSC_DEADLINE : -ENODEV;
+
+#ifdef CONFIG_X86_X2APIC
+	if (x2apic_enabled() && !strcmp(real_dev->name, "lapic"))
+		return EVL_APIC_X2APIC_COUNT;
+#endif
+
+	return -ENODEV;
+}
+
+/* Minimum count of the lapic device, see setup_APIC_timer(). */
+#define EVL_APIC_MIN_COUNT	0xF
+
+static inline void evl_arch_program_direct_tick(int access, u64 cycles)
+{
+#ifdef CONFIG_X86_X2APIC
+	if (access == EVL_APIC_X2APIC_COUNT) {
+		/* A zero count would stop the timer. */
+		cycles = clamp_t(u64, cycles, EVL_APIC_MIN_COUNT, U32_MAX);
+		native_apic_msr_write(APIC_TMICT, (u32)cycles);
+		return;
+	}
+#endif
+
+	/* This MSR is special and needs a special fence. */
+	weak_wrmsr_fence();
+	wrmsrl(MSR_IA32_TSC_DEADLINE, rdtsc() + cycles * TSC_DIVISOR);
+}
+
+#endif /* !_EVL_X86_ASM_TICK_H */
@@ -115,6 +115,10 @@ extern void switch_fpu_return(void);
 void fpu__suspend_inband(void);
 void fpu__resume_inband(void);
 
+/* Kernel FPU usage from any stage, hard irqs off in between. */
+void oob_kernel_fpu_begin(void);
+void oob_kernel_fpu_end(void);
+
 /*
  * Query the presence of one or more xfeatures. Works on any legacy CPU as well.
  *
@@ -179,10 +179,21 @@ extern void switch_mm_irqs_off(struct mm_struct *prev, struct mm_struct *next,
 			       struct task_struct *tsk);
 #define switch_mm_irqs_off switch_mm_irqs_off
 
+/*
+ * Most oob context switches happen between threads of the same
+ * process, or toward kernel threads borrowing the active mm. In the
+ * former case, when the CPU is not in lazy TLB mode, there is nothing
+ * switch_mm_irqs_off() would do, so spare the call and the debug
+ * checks on this hot path.
+ */
 static inline void
 switch_oob_mm(struct mm_struct *prev, struct mm_struct *next,
-	      struct task_struct *tsk)
+	      struct task_struct *tsk) /* hard irqs off */
 {
+	if (next == this_cpu_read(cpu_tlbstate.loaded_mm) &&
+	    !this_cpu_read(cpu_tlbstate_shared.is_lazy))
+		return;
+
 	switch_mm_irqs_off(prev, next, tsk);
 }
 
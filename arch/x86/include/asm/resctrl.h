@@ -180,6 +180,9 @@ static inline void resctrl_arch_mon_ctx_free(struct rdt_resource *r, int evtid,
 
 void resctrl_cpu_detect(struct cpuinfo_x86 *c);
 
+/* Number of usable CLOSIDs while mounted, zero otherwise. */
+int closids_supported(void);
+
 #else
 
 static inline void resctrl_sched_in(struct task_struct *tsk) {}
@@ -257,7 +257,6 @@ int lapic_get_maxlvt(void)
 
 /* Clock divisor */
 #define APIC_DIVISOR 16
-#define TSC_DIVISOR  8
 
 /* i82489DX specific */
 #define		I82489DX_BASE_DIVIDER		(((0x2) << 18))
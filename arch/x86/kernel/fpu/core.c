@@ -958,7 +958,15 @@ noinstr void fpu_idle_fpregs(void)
  */
 static DEFINE_PER_CPU(struct fpu *, in_kernel_fpstate);
 
-static int fpu__init_kernel_fpstate(unsigned int cpu)
+/*
+ * Holds the fpu state preempted by oob_kernel_fpu_begin(), along with
+ * the nesting depth and the hard irq state to restore on exit.
+ */
+static DEFINE_PER_CPU(struct fpu *, oob_kernel_fpstate);
+static DEFINE_PER_CPU(unsigned int, oob_kernel_fpu_depth);
+static DEFINE_PER_CPU(unsigned long, oob_kernel_fpu_flags);
+
+static struct fpu *alloc_kernel_fpstate(void)
 {
 	struct fpu *fpu;
 	int fpu_size;
@@ -973,26 +981,90 @@ static int fpu__init_kernel_fpstate(unsigned int cpu)
 	 */
 	fpu = kzalloc(fpu_size, GFP_KERNEL);
 	if (fpu == NULL)
-		return -ENOMEM;
+		return NULL;
 
 	fpu->last_cpu = -1;
 	fpstate_reset(fpu);
-	this_cpu_write(in_kernel_fpstate, fpu);
 	memcpy(&fpu->fpstate->regs, &init_fpstate.regs,
 		init_fpstate_copy_size());
 
+	return fpu;
+}
+
+static int fpu__init_kernel_fpstate(unsigned int cpu)
+{
+	struct fpu *kfpu, *ofpu;
+
+	kfpu = alloc_kernel_fpstate();
+	if (kfpu == NULL)
+		return -ENOMEM;
+
+	ofpu = alloc_kernel_fpstate();
+	if (ofpu == NULL) {
+		kfree(kfpu);
+		return -ENOMEM;
+	}
+
+	this_cpu_write(in_kernel_fpstate, kfpu);
+	this_cpu_write(oob_kernel_fpstate, ofpu);
+
 	return 0;
 }
 
 static int fpu__drop_kernel_fpstate(unsigned int cpu)
 {
-	struct fpu *fpu = this_cpu_read(in_kernel_fpstate);
-
-	kfree(fpu);
+	kfree(this_cpu_read(in_kernel_fpstate));
+	kfree(this_cpu_read(oob_kernel_fpstate));
 
 	return 0;
 }
 
+/*
+ * oob_kernel_fpu_begin - grab the FPU for kernel code on any stage
+ *
+ * kernel_fpu_begin() is in-band only, as it relies on disabling
+ * preemption. This one may be called from the oob stage as well,
+ * including from oob interrupt handlers: hard irqs are kept off until
+ * the matching call to oob_kernel_fpu_end(), and the live register
+ * state, whichever context owns it (an in-band kernel section, the
+ * current task or any other), is saved to a per-CPU area, then
+ * restored on exit. Since nothing can preempt the caller, nested
+ * calls only bump a depth count. Callers should keep such sections
+ * short, and leave dynamically enabled features (AMX) alone, which
+ * are not preserved.
+ */
+void oob_kernel_fpu_begin(void)
+{
+	unsigned long flags = hard_local_irq_save();
+	struct fpu *ofpu;
+
+	if (__this_cpu_inc_return(oob_kernel_fpu_depth) > 1)
+		return;
+
+	ofpu = this_cpu_read(oob_kernel_fpstate);
+	save_fpregs_to_fpstate(ofpu);
+	__this_cpu_write(oob_kernel_fpu_flags, flags);
+
+	if (boot_cpu_has(X86_FEATURE_XMM))
+		ldmxcsr(MXCSR_DEFAULT);
+}
+EXPORT_SYMBOL_GPL(oob_kernel_fpu_begin);
+
+void oob_kernel_fpu_end(void)
+{
+	struct fpu *ofpu = this_cpu_read(oob_kernel_fpstate);
+
+	WARN_ON_FPU(!hard_irqs_disabled());
+	WARN_ON_FPU(this_cpu_read(oob_kernel_fpu_depth) == 0);
+
+	if (__this_cpu_dec_return(oob_kernel_fpu_depth) > 0)
+		return;
+
+	restore_fpregs_from_fpstate(ofpu->fpstate, XFEATURE_MASK_FPSTATE);
+	hard_local_irq_restore(__this_cpu_read(oob_kernel_fpu_flags));
+}
+EXPORT_SYMBOL_GPL(oob_kernel_fpu_end);
+
 void fpu__suspend_inband(void)
 {
 	struct fpu *kfpu = this_cpu_read(in_kernel_fpstate);
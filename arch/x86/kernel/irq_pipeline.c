@@ -13,6 +13,7 @@
 #include <asm/irq_work.h>
 #include <asm/mshyperv.h>
 #include <asm/idtentry.h>
+#include <dovetail/irq.h>
 
 void (*pipeline_hv_callback_fn)(struct pt_regs *regs) = NULL;
 
@@ -183,6 +184,8 @@ void arch_do_IRQ_pipelined(struct irq_desc *desc)
 	struct pt_regs *regs = raw_cpu_ptr(&irq_pipeline.tick_regs), *old_regs;
 	irqentry_state_t state;
 
+	irq_stat_pipeline_replay(desc);
+
 	/* Emulate a kernel entry. */
 	state = pipeline_enter_rcu();
 
@@ -238,7 +241,9 @@ static void arch_handle_irq(struct pt_regs *regs, u8 vector, bool irq_movable)
 		}
 	}
 
+	irq_stat_pipeline_entry(desc);
 	generic_pipeline_irq_desc(desc);
+	irq_stat_pipeline_exit(desc);
 
 	set_irq_regs(old_regs);
 }
@@ -1326,8 +1326,14 @@ void do_user_addr_fault(struct pt_regs *regs,
 	/*
 	 * If we're in an interrupt, have no user context or are running
 	 * in a region with pagefaults disabled then we must not take the fault
+	 *
+	 * The same goes for a NMI preempting the oob stage, which the
+	 * companion core could not demote to in-band anyway: fix up the
+	 * access right away, e.g. for perf walking the user stack of an
+	 * oob task.
 	 */
-	if (unlikely(running_inband() && (faulthandler_disabled() || !mm))) {
+	if (unlikely((running_inband() || in_nmi()) &&
+		     (faulthandler_disabled() || !mm))) {
 		bad_area_nosemaphore(regs, error_code, address);
 		return;
 	}
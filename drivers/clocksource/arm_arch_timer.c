@@ -772,6 +772,25 @@ static int arch_timer_set_next_event_phys(unsigned long evt,
 	return 0;
 }
 
+#ifdef CONFIG_IRQ_PIPELINE
+/*
+ * An out-of-band core may program the CP15 comparator directly,
+ * provided no erratum workaround applies. Return the register
+ * access mode for doing so, or -ENODEV.
+ */
+int arch_timer_get_oob_access(struct clock_event_device *clk)
+{
+	if (clk->set_next_event == arch_timer_set_next_event_virt)
+		return ARCH_TIMER_VIRT_ACCESS;
+
+	if (clk->set_next_event == arch_timer_set_next_event_phys)
+		return ARCH_TIMER_PHYS_ACCESS;
+
+	return -ENODEV;
+}
+EXPORT_SYMBOL_GPL(arch_timer_get_oob_access);
+#endif
+
 static noinstr u64 arch_counter_get_cnt_mem(struct arch_timer *t, int offset_lo)
 {
 	u32 cnt_lo, cnt_hi, tmp_hi;
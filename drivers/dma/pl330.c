@@ -438,7 +438,11 @@ struct dma_pl330_chan {
 	struct pl330_dmac *dmac;
 
 	/* To protect channel manipulation */
+#ifdef CONFIG_DMA_PL330_OOB
+	hard_spinlock_t lock;
+#else
 	spinlock_t lock;
+#endif
 
 	/*
 	 * Hardware channel thread of PL330 DMAC. NULL if the channel is
@@ -478,7 +482,11 @@ struct pl330_dmac {
 	/* Populated by the PL330 core driver during pl330_add */
 	struct pl330_config	pcfg;
 
+#ifdef CONFIG_DMA_PL330_OOB
+	hard_spinlock_t		lock;
+#else
 	spinlock_t		lock;
+#endif
 	/* Maximum possible events/irqs */
 	int			events[32];
 	/* BUS address of MicroCode buffer */
@@ -556,6 +564,20 @@ static int pl330_config_write(struct dma_chan *chan,
 			struct dma_slave_config *slave_config,
 			enum dma_transfer_direction direction);
 
+static inline bool pl330_oob_capable(void)
+{
+	return IS_ENABLED(CONFIG_DMA_PL330_OOB);
+}
+
+/*
+ * A pulsed request stays armed in its thread slot once done, the
+ * next pulse restarts the same microcode.
+ */
+static inline bool pl330_desc_pulsed(struct dma_pl330_desc *desc)
+{
+	return pl330_oob_capable() && desc->txd.flags & DMA_OOB_PULSE;
+}
+
 static inline bool _queue_full(struct pl330_thread *thrd)
 {
 	return thrd->req[0].desc != NULL && thrd->req[1].desc != NULL;
@@ -1635,6 +1657,31 @@ static void pl330_dotask(struct tasklet_struct *t)
 	return;
 }
 
+/* Returns the pulsed request notified by event 'ev', if any */
+static struct dma_pl330_desc *pl330_pulsed_req(struct pl330_dmac *pl330, int ev)
+{
+	struct dma_pl330_desc *desc;
+	struct pl330_thread *thrd;
+	int id;
+
+	if (!pl330_oob_capable())
+		return NULL;
+
+	id = pl330->events[ev];
+	if (id < 0)
+		return NULL;
+
+	thrd = &pl330->channels[id];
+	if (thrd->req_running == -1)
+		return NULL;
+
+	desc = thrd->req[thrd->req_running].desc;
+	if (!desc || !pl330_desc_pulsed(desc))
+		return NULL;
+
+	return desc;
+}
+
 /* Returns 1 if state was updated, 0 otherwise */
 static int pl330_update(struct pl330_dmac *pl330)
 {
@@ -1687,6 +1734,10 @@ static int pl330_update(struct pl330_dmac *pl330)
 			u32 inten = readl(regs + INTEN);
 			int active;
 
+			/* Pulsed requests are completed from the oob stage. */
+			if (pl330_pulsed_req(pl330, ev))
+				continue;
+
 			/* Clear the event */
 			if (inten & (1 << ev))
 				writel(1 << ev, regs + INTCLR);
@@ -2092,7 +2143,8 @@ static void pl330_tasklet(struct tasklet_struct *t)
 		spin_unlock(&pch->thread->dmac->lock);
 		power_down = true;
 		pch->active = false;
-	} else {
+	} else if (!pl330_desc_pulsed(list_first_entry(&pch->work_list,
+					struct dma_pl330_desc, node))) {
 		/* Make sure the PL330 Channel thread is active */
 		spin_lock(&pch->thread->dmac->lock);
 		pl330_start_thread(pch->thread);
@@ -2499,6 +2551,34 @@ static void pl330_issue_pending(struct dma_chan *chan)
 	pl330_tasklet(&pch->task);
 }
 
+#ifdef CONFIG_DMA_PL330_OOB
+static int pl330_pulse_oob(struct dma_chan *chan)
+{
+	struct dma_pl330_chan *pch = to_pchan(chan);
+	struct dma_pl330_desc *desc;
+	unsigned long flags;
+	int ret = -EIO;
+
+	spin_lock_irqsave(&pch->lock, flags);
+	desc = list_first_entry_or_null(&pch->work_list,
+					struct dma_pl330_desc, node);
+	if (desc && desc->status == BUSY && pl330_desc_pulsed(desc)) {
+		spin_lock(&pch->dmac->lock);
+		_trigger(pch->thread);
+		spin_unlock(&pch->dmac->lock);
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&pch->lock, flags);
+
+	return ret;
+}
+#else
+static int pl330_pulse_oob(struct dma_chan *chan)
+{
+	return -ENOTSUPP;
+}
+#endif
+
 /*
  * We returned the last one of the circular list of descriptor(s)
  * from prep_xxx, so the argument to submit corresponds to the last
@@ -2617,6 +2697,7 @@ static struct dma_pl330_desc *pl330_get_desc(struct dma_pl330_chan *pch)
 	/* Initialize the descriptor */
 	desc->pchan = pch;
 	desc->txd.cookie = 0;
+	desc->txd.flags &= ~(DMA_OOB_INTERRUPT|DMA_OOB_PULSE);
 	async_tx_ack(&desc->txd);
 
 	desc->peri = peri_id ? pch->chan.chan_id : 0;
@@ -2695,6 +2776,12 @@ static struct dma_async_tx_descriptor *pl330_prep_dma_cyclic(
 	if (len % period_len != 0)
 		return NULL;
 
+	if (flags & (DMA_OOB_INTERRUPT|DMA_OOB_PULSE)) {
+		dev_err(pch->dmac->ddma.dev,
+			"%s: no out-of-band cyclic transfers\n", __func__);
+		return NULL;
+	}
+
 	if (!is_slave_direction(direction)) {
 		dev_err(pch->dmac->ddma.dev, "%s:%d Invalid dma direction\n",
 		__func__, __LINE__);
@@ -2856,6 +2943,25 @@ pl330_prep_slave_sg(struct dma_chan *chan, struct scatterlist *sgl,
 	if (unlikely(!pch || !sgl || !sg_len))
 		return NULL;
 
+	/*
+	 * Out-of-band transfers are pulsed, running a single request
+	 * which the thread can restart as is.
+	 */
+	if (flg & (DMA_OOB_INTERRUPT|DMA_OOB_PULSE)) {
+		if (!pl330_oob_capable()) {
+			dev_err(pch->dmac->ddma.dev,
+				"%s: out-of-band slave transfers disabled\n",
+				__func__);
+			return NULL;
+		}
+		if (!(flg & DMA_OOB_PULSE) || sg_len != 1) {
+			dev_err(pch->dmac->ddma.dev,
+				"%s: out-of-band slave transfers must be pulsed, single-entry\n",
+				__func__);
+			return NULL;
+		}
+	}
+
 	pl330_config_write(chan, &pch->slave_config, direction);
 
 	if (!pl330_prep_slave_fifo(pch, direction))
@@ -2898,14 +3004,85 @@ pl330_prep_slave_sg(struct dma_chan *chan, struct scatterlist *sgl,
 		desc->rqcfg.brst_len = pch->burst_len;
 		desc->rqtype = direction;
 		desc->bytes_requested = sg_dma_len(sg);
+		desc->txd.flags |= flg & (DMA_OOB_INTERRUPT|DMA_OOB_PULSE);
 	}
 
 	/* Return the last desc in the chain */
 	return &desc->txd;
 }
 
+#ifdef CONFIG_DMA_PL330_OOB
+/*
+ * Complete the pulsed requests from the out-of-band stage. Anything
+ * else, including faults, is left to pl330_update() once the IRQ is
+ * forwarded to the in-band stage.
+ */
+static irqreturn_t pl330_update_oob(struct pl330_dmac *pl330)
+{
+	void __iomem *regs = pl330->base;
+	struct dmaengine_desc_callback cb;
+	struct dma_pl330_desc *desc;
+	u32 es, inten, pending;
+	unsigned long flags;
+	LIST_HEAD(done);
+	int ev;
+
+	spin_lock_irqsave(&pl330->lock, flags);
+
+	es = readl(regs + ES);
+	pending = es;
+
+	for (ev = 0; ev < pl330->pcfg.num_events; ev++) {
+		if (!(es & (1 << ev)))
+			continue;
+
+		desc = pl330_pulsed_req(pl330, ev);
+		if (!desc)
+			continue;
+
+		inten = readl(regs + INTEN);
+		if (inten & (1 << ev))
+			writel(1 << ev, regs + INTCLR);
+
+		/* Leave the request armed for the next pulse. */
+		pl330->channels[pl330->events[ev]].req_running = -1;
+		pending &= ~(1 << ev);
+
+		if (desc->txd.flags & DMA_OOB_INTERRUPT)
+			list_add_tail(&desc->rqd, &done);
+	}
+
+	if (readl(regs + FSM) & 0x1 ||
+		readl(regs + FSC) & ((1 << pl330->pcfg.num_chan) - 1))
+		pending = -1U;
+
+	spin_unlock_irqrestore(&pl330->lock, flags);
+
+	while (!list_empty(&done)) {
+		desc = list_first_entry(&done, struct dma_pl330_desc, rqd);
+		list_del(&desc->rqd);
+		dmaengine_desc_get_callback(&desc->txd, &cb);
+		if (dmaengine_desc_callback_valid(&cb))
+			dmaengine_desc_callback_invoke(&cb, NULL);
+	}
+
+	if (pending)
+		return IRQ_FORWARD;
+
+	return es ? IRQ_HANDLED : IRQ_NONE;
+}
+#else
+static irqreturn_t pl330_update_oob(struct pl330_dmac *pl330)
+{
+	return IRQ_NONE;
+}
+#endif
+
 static irqreturn_t pl330_irq_handler(int irq, void *data)
 {
+	if (pl330_oob_capable() && running_oob())
+		return pl330_update_oob(data);
+
 	if (pl330_update(data))
 		return IRQ_HANDLED;
 	else
@@ -3067,7 +3244,8 @@ pl330_probe(struct amba_device *adev, const struct amba_id *id)
 		irq = adev->irq[i];
 		if (irq) {
 			ret = devm_request_irq(&adev->dev, irq,
-					       pl330_irq_handler, 0,
+					       pl330_irq_handler,
+					       pl330_oob_capable() ? IRQF_OOB : 0,
 					       dev_name(&adev->dev), pl330);
 			if (ret)
 				return ret;
@@ -3126,6 +3304,8 @@ pl330_probe(struct amba_device *adev, const struct amba_id *id)
 		dma_cap_set(DMA_SLAVE, pd->cap_mask);
 		dma_cap_set(DMA_CYCLIC, pd->cap_mask);
 		dma_cap_set(DMA_PRIVATE, pd->cap_mask);
+		if (pl330_oob_capable())
+			dma_cap_set(DMA_OOB, pd->cap_mask);
 	}
 
 	pd->device_alloc_chan_resources = pl330_alloc_chan_resources;
@@ -3138,6 +3318,7 @@ pl330_probe(struct amba_device *adev, const struct amba_id *id)
 	pd->device_pause = pl330_pause;
 	pd->device_terminate_all = pl330_terminate_all;
 	pd->device_issue_pending = pl330_issue_pending;
+	pd->device_pulse_oob = pl330_pulse_oob;
 	pd->src_addr_widths = PL330_DMA_BUSWIDTHS;
 	pd->dst_addr_widths = PL330_DMA_BUSWIDTHS;
 	pd->directions = BIT(DMA_DEV_TO_MEM) | BIT(DMA_MEM_TO_DEV);
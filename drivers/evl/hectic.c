@@ -14,6 +14,8 @@
 #include <linux/semaphore.h>
 #include <linux/irq_work.h>
 #include <evl/thread.h>
+#include <evl/sched.h>
+#include <evl/clock.h>
 #include <evl/flag.h>
 #include <evl/file.h>
 #include <evl/stax.h>
@@ -49,10 +51,24 @@ struct rtswitch_context {
 	bool failed;
 	struct hectic_error error;
 
+	bool timing;
+	ktime_t switch_start;
+	struct hectic_switch_timing timing_stats;
+
 	struct rtswitch_task *utask;
 	struct irq_work wake_utask;
 	struct evl_stax stax;
 	struct evl_file efile;
+
+	struct hectic_bench_hist bench[HECTIC_HIST_NR];
+	ktime_t probe_date;
+	struct {
+		struct evl_kthread kthread;
+		struct evl_flag wake;
+		struct evl_flag ack;
+		ktime_t stamp;
+		int cpu;	/* -1 if no wakee */
+	} xcpu;
 };
 
 static u32 fp_features;
@@ -101,6 +117,65 @@ static void handle_fpu_error(struct rtswitch_context *ctx,
 		}
 }
 
+/*
+ * In timing mode, measure the time it takes for an oob task to
+ * resume after another oob task woke it up on the same CPU, which
+ * includes the FPU context switching overhead. Only switches started
+ * by rtswitch_to_rt() without pause are considered.
+ */
+static inline void mark_switch(struct rtswitch_context *ctx)
+{
+	if (ctx->timing)
+		ctx->switch_start = evl_read_clock(&evl_mono_clock);
+}
+
+static void account_switch(struct rtswitch_context *ctx)
+{
+	struct hectic_switch_timing *t = &ctx->timing_stats;
+	u64 delta;
+
+	if (!ctx->switch_start)
+		return;
+
+	delta = ktime_to_ns(ktime_sub(evl_read_clock(&evl_mono_clock),
+					ctx->switch_start));
+	ctx->switch_start = 0;
+	t->total_ns += delta;
+	if (delta > t->max_ns)
+		t->max_ns = delta;
+	t->count++;
+}
+
+static void bench_account(struct rtswitch_context *ctx,
+			  int kind, ktime_t start, ktime_t end)
+{
+	struct hectic_bench_hist *h = &ctx->bench[kind];
+	u64 delta;
+	int n;
+
+	/* Unsynchronized user clock readings might be slightly off. */
+	delta = end > start ? ktime_to_ns(ktime_sub(end, start)) : 0;
+	if (h->count == 0 || delta < h->min_ns)
+		h->min_ns = delta;
+	if (delta > h->max_ns)
+		h->max_ns = delta;
+	h->total_ns += delta;
+	h->count++;
+	n = delta ? min(fls64(delta), HECTIC_HIST_BUCKETS - 1) : 0;
+	h->buckets[n]++;
+}
+
+static void reset_bench(struct rtswitch_context *ctx)
+{
+	int kind;
+
+	memset(ctx->bench, 0, sizeof(ctx->bench));
+	for (kind = 0; kind < HECTIC_HIST_NR; kind++)
+		ctx->bench[kind].kind = kind;
+
+	ctx->probe_date = 0;
+}
+
 static int rtswitch_pend_rt(struct rtswitch_context *ctx,
 			    unsigned int idx)
 {
@@ -117,6 +192,8 @@ static int rtswitch_pend_rt(struct rtswitch_context *ctx,
 	if (rc < 0)
 		return rc;
 
+	account_switch(ctx);
+
 	if (ctx->failed)
 		return 1;
 
@@ -182,6 +259,7 @@ static int rtswitch_to_rt(struct rtswitch_context *ctx,
 			break;
 
 		case HECTIC_OOB_WAIT:
+			mark_switch(ctx);
 			evl_raise_flag(&to->rt_synch);
 			break;
 
@@ -193,6 +271,8 @@ static int rtswitch_to_rt(struct rtswitch_context *ctx,
 	if (rc < 0)
 		return rc;
 
+	account_switch(ctx);
+
 	if (ctx->failed)
 		return 1;
 
@@ -453,6 +533,154 @@ static int rtswitch_create_kthread(struct rtswitch_context *ctx,
 	return err;
 }
 
+static void bench_xcpu_kthread(void *arg)
+{
+	struct rtswitch_context *ctx = arg;
+	int ret;
+
+	while (!evl_kthread_should_stop()) {
+		ret = evl_wait_flag(&ctx->xcpu.wake);
+		if (ret)
+			break;
+		bench_account(ctx, HECTIC_HIST_XCPU_WAKEUP, ctx->xcpu.stamp,
+			evl_read_clock(&evl_mono_clock));
+		evl_raise_flag(&ctx->xcpu.ack);
+	}
+}
+
+static void stop_bench_xcpu(struct rtswitch_context *ctx)
+{
+	if (ctx->xcpu.cpu >= 0) {
+		evl_stop_kthread(&ctx->xcpu.kthread);
+		ctx->xcpu.cpu = -1;
+	}
+}
+
+/* in-band */
+static int setup_bench(struct rtswitch_context *ctx,
+		       struct hectic_bench_req *req)
+{
+	int ret;
+
+	switch (req->mode) {
+	case HECTIC_BENCH_STAGE:
+		return 0;
+	case HECTIC_BENCH_XCPU:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (req->cpu >= num_possible_cpus() || !is_evl_cpu(req->cpu))
+		return -EINVAL;
+
+	if (ctx->xcpu.cpu == req->cpu)
+		return 0;
+
+	stop_bench_xcpu(ctx);
+
+	ret = evl_run_kthread_on_cpu(&ctx->xcpu.kthread, req->cpu,
+				bench_xcpu_kthread, ctx,
+				EVL_FIFO_MAX_PRIO,
+				EVL_CLONE_PUBLIC,
+				"hecx@%u:%d",
+				req->cpu, task_pid_nr(current));
+	if (ret)
+		return ret;
+
+	ctx->xcpu.cpu = req->cpu;
+
+	return 0;
+}
+
+/*
+ * Time a full oob -> in-band -> oob round trip of the caller, each
+ * transition separately.
+ */
+static int run_bench_stage(struct rtswitch_context *ctx,
+			   unsigned int count)
+{
+	ktime_t t0, t1, t2;
+	int ret;
+
+	while (count-- > 0) {
+		t0 = evl_read_clock(&evl_mono_clock);
+		evl_switch_inband(EVL_HMDIAG_NONE);
+		t1 = evl_read_clock(&evl_mono_clock);
+		ret = evl_switch_oob();
+		if (ret)
+			return ret;
+		t2 = evl_read_clock(&evl_mono_clock);
+		bench_account(ctx, HECTIC_HIST_TO_INBAND, t0, t1);
+		bench_account(ctx, HECTIC_HIST_TO_OOB, t1, t2);
+	}
+
+	return 0;
+}
+
+static int run_bench_xcpu(struct rtswitch_context *ctx,
+			  unsigned int count)
+{
+	int ret;
+
+	if (ctx->xcpu.cpu < 0)
+		return -EINVAL;
+
+	while (count-- > 0) {
+		ctx->xcpu.stamp = evl_read_clock(&evl_mono_clock);
+		evl_raise_flag(&ctx->xcpu.wake);
+		ret = evl_wait_flag(&ctx->xcpu.ack);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* oob */
+static int run_bench(struct rtswitch_context *ctx,
+		     struct hectic_bench_req *req)
+{
+	switch (req->mode) {
+	case HECTIC_BENCH_STAGE:
+		return run_bench_stage(ctx, req->count);
+	case HECTIC_BENCH_XCPU:
+		return run_bench_xcpu(ctx, req->count);
+	default:
+		return -EINVAL;
+	}
+}
+
+/* oob */
+static int probe_syscall(struct rtswitch_context *ctx,
+			 struct hectic_syscall_probe *probe)
+{
+	ktime_t now = evl_read_clock(&evl_mono_clock);
+
+	bench_account(ctx, HECTIC_HIST_SYSCALL_ENTRY,
+		ns_to_ktime(probe->entry_date), now);
+
+	if (probe->prev_return_date && ctx->probe_date)
+		bench_account(ctx, HECTIC_HIST_SYSCALL_EXIT, ctx->probe_date,
+			ns_to_ktime(probe->prev_return_date));
+
+	/* Close enough to the return date of this call. */
+	ctx->probe_date = evl_read_clock(&evl_mono_clock);
+
+	return 0;
+}
+
+static int get_bench(struct rtswitch_context *ctx,
+		     struct hectic_bench_hist *hist)
+{
+	if (hist->kind >= HECTIC_HIST_NR)
+		return -EINVAL;
+
+	*hist = ctx->bench[hist->kind];
+
+	return 0;
+}
+
 static void rtswitch_utask_waker(struct irq_work *work)
 {
 	struct rtswitch_context *ctx;
@@ -466,7 +694,9 @@ static long hectic_ioctl(struct file *filp, unsigned int cmd,
 	struct rtswitch_context *ctx = filp->private_data;
 	struct hectic_switch_req fromto, __user *u_fromto;
 	struct hectic_task_index task, __user *u_task;
+	struct hectic_bench_hist hist, __user *u_hist;
 	struct hectic_error __user *u_lerr;
+	struct hectic_bench_req req;
 	__u32 count;
 	int err;
 
@@ -543,6 +773,46 @@ static long hectic_ioctl(struct file *filp, unsigned int cmd,
 		evl_unlock_stax(&ctx->stax);
 		return 0;
 
+	case EVL_HECIOC_SET_TIMING:
+		/* Switching timing on resets the statistics. */
+		ctx->timing = false;
+		ctx->switch_start = 0;
+		if (arg) {
+			memset(&ctx->timing_stats, 0,
+				sizeof(ctx->timing_stats));
+			ctx->timing = true;
+		}
+		return 0;
+
+	case EVL_HECIOC_GET_TIMING:
+		return copy_to_user((void __user *)arg, &ctx->timing_stats,
+				sizeof(ctx->timing_stats)) ? -EFAULT : 0;
+
+	case EVL_HECIOC_SETUP_BENCH:
+		if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+			return -EFAULT;
+
+		down(&ctx->lock);
+		err = setup_bench(ctx, &req);
+		up(&ctx->lock);
+
+		return err;
+
+	case EVL_HECIOC_GET_BENCH:
+		u_hist = (typeof(u_hist))arg;
+		if (copy_from_user(&hist, u_hist, sizeof(hist)))
+			return -EFAULT;
+
+		err = get_bench(ctx, &hist);
+		if (!err && copy_to_user(u_hist, &hist, sizeof(hist)))
+			err = -EFAULT;
+
+		return err;
+
+	case EVL_HECIOC_RESET_BENCH:
+		reset_bench(ctx);
+		return 0;
+
 	default:
 		return -ENOTTY;
 	}
@@ -554,7 +824,10 @@ static long hectic_oob_ioctl(struct file *filp, unsigned int cmd,
 	struct rtswitch_context *ctx = filp->private_data;
 	struct hectic_switch_req fromto, __user *u_fromto;
 	struct hectic_task_index task, __user *u_task;
+	struct hectic_bench_hist hist, __user *u_hist;
+	struct hectic_syscall_probe probe;
 	struct hectic_error __user *u_lerr;
+	struct hectic_bench_req req;
 	int err;
 
 	switch (cmd) {
@@ -583,6 +856,25 @@ static long hectic_oob_ioctl(struct file *filp, unsigned int cmd,
 		evl_unlock_stax(&ctx->stax);
 		return 0;
 
+	case EVL_HECIOC_RUN_BENCH:
+		err = raw_copy_from_user(&req, (void __user *)arg, sizeof(req));
+		return err ? -EFAULT : run_bench(ctx, &req);
+
+	case EVL_HECIOC_SYSCALL_PROBE:
+		err = raw_copy_from_user(&probe, (void __user *)arg,
+					sizeof(probe));
+		return err ? -EFAULT : probe_syscall(ctx, &probe);
+
+	case EVL_HECIOC_GET_BENCH:
+		u_hist = (typeof(u_hist))arg;
+		err = raw_copy_from_user(&hist, u_hist, sizeof(hist));
+		if (err)
+			return -EFAULT;
+		err = get_bench(ctx, &hist);
+		if (!err && raw_copy_to_user(u_hist, &hist, sizeof(hist)))
+			err = -EFAULT;
+		return err;
+
 	default:
 		return -ENOTTY;
 	}
@@ -609,6 +901,13 @@ static int hectic_open(struct inode *inode, struct file *filp)
 	ctx->failed = false;
 	ctx->error.last_switch.from = ctx->error.last_switch.to = -1;
 	ctx->pause_us = 0;
+	ctx->timing = false;
+	ctx->switch_start = 0;
+	memset(&ctx->timing_stats, 0, sizeof(ctx->timing_stats));
+	reset_bench(ctx);
+	ctx->xcpu.cpu = -1;
+	evl_init_flag(&ctx->xcpu.wake);
+	evl_init_flag(&ctx->xcpu.ack);
 
 	init_irq_work(&ctx->wake_utask, rtswitch_utask_waker);
 	evl_init_timer(&ctx->wake_up_delay, timed_wake_up);
@@ -625,6 +924,9 @@ static int hectic_release(struct inode *inode, struct file *filp)
 	struct rtswitch_context *ctx = filp->private_data;
 	unsigned int i;
 
+	stop_bench_xcpu(ctx);
+	evl_destroy_flag(&ctx->xcpu.ack);
+	evl_destroy_flag(&ctx->xcpu.wake);
 	evl_destroy_stax(&ctx->stax);
 	evl_destroy_timer(&ctx->wake_up_delay);
 
@@ -14,6 +14,11 @@
 #include <linux/cdev.h>
 #include <linux/fs.h>
 #include <linux/fcntl.h>
+#include <linux/kthread.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/delay.h>
+#include <linux/smp.h>
 #include <evl/file.h>
 #include <evl/flag.h>
 #include <evl/clock.h>
@@ -27,6 +32,20 @@
 #define TUNER_WARMUP_STEPS	10
 #define TUNER_RESULT_STEPS	40
 
+#define MULTI_START_DELAY	10000000UL
+#define MULTI_MAX_HCELLS	100000
+
+#define HWLAT_MAX_GAPS		32
+
+#define STRESS_WINDOW_US	10000
+#define STRESS_DEF_FOOTPRINT	8192		/* KiB */
+#define STRESS_MAX_FOOTPRINT	(1024 * 1024)	/* KiB */
+#define STRESS_IPI_BATCH	64
+#define STRESS_ALL_MASK		(BIT(EVL_LAT_STRESS_NR) - 1)
+
+static uint hwlat_threshold_arg = 10000;
+module_param_named(hwlat_threshold, hwlat_threshold_arg, uint, 0644);
+
 #define progress(__runner, __fmt, __args...)				\
 	do {								\
 		if ((__runner)->verbosity > 1)				\
@@ -57,6 +76,8 @@ struct runner_state {
 	unsigned int max_samples;
 };
 
+struct multi_runner;
+
 struct latmus_runner {
 	const char *name;
 	unsigned int (*get_gravity)(struct latmus_runner *runner);
@@ -85,6 +106,11 @@ struct latmus_runner {
 			struct evl_xbuf *xbuf;
 			u32 hcells;
 			s32 *histogram;
+			/* Multi-CPU mode only. */
+			struct multi_runner *group;
+			u32 cell_ns;
+			s64 total_sum;
+			u64 total_samples;
 		};
 	};
 };
@@ -104,6 +130,7 @@ struct kthread_runner {
 struct uthread_runner {
 	struct evl_timer timer;
 	struct evl_flag pulse;
+	int type;
 	struct latmus_runner runner;
 };
 
@@ -114,9 +141,54 @@ struct sirq_runner {
 	struct latmus_runner runner;
 };
 
+struct hwlat_runner {
+	struct evl_kthread kthread;
+	struct evl_flag barrier;
+	struct evl_flag ready;
+	ktime_t start_time;
+	ktime_t threshold;
+	bool armed;
+	hard_spinlock_t lock;
+	unsigned int nr_gaps;
+	struct latmus_hwlat_gap gaps[HWLAT_MAX_GAPS];
+	struct latmus_runner runner;
+};
+
+struct multi_slot {
+	struct latmus_runner *runner;
+	int cpu;
+};
+
+struct multi_runner {
+	bool stopping;
+	bool started;
+	int nr_slots;
+	struct latmus_runner runner;
+	struct multi_slot slots[];
+};
+
+struct latmus_stress;
+
+struct stress_worker {
+	struct latmus_stress *stress;
+	struct task_struct *task;
+	struct hrtimer timer;
+	u8 *area;
+	size_t size;
+};
+
+struct latmus_stress {
+	struct latmus_stress_setup setup;
+	cpumask_var_t cpus;
+	ktime_t irq_period;
+	atomic64_t rounds[EVL_LAT_STRESS_NR];
+	struct stress_worker *workers; /* Indexed by CPU */
+};
+
 struct latmus_state {
 	struct evl_file efile;
 	struct latmus_runner *runner;
+	struct latmus_stress *stress;
 };
 
 static inline void init_runner_base(struct latmus_runner *runner)
@@ -245,6 +317,50 @@ static int add_tuning_sample(struct latmus_runner *runner,
 	return 0;	/* Keep going. */
 }
 
+static int add_multi_sample(struct latmus_runner *runner,
+			    ktime_t timestamp)
+{
+	struct runner_state *state = &runner->state;
+	ktime_t period = runner->period;
+	int delta, cell;
+
+	if (READ_ONCE(runner->group->stopping)) {
+		done_sampling(runner, 0);
+		return 1;	/* Finished. */
+	}
+
+	if (runner->warmup_samples < runner->warmup_limit) {
+		runner->warmup_samples++;
+		state->ideal = ktime_add(state->ideal, period);
+		return 0;
+	}
+
+	delta = (int)ktime_to_ns(ktime_sub(timestamp, state->ideal));
+	if (delta < state->min_lat)
+		state->min_lat = delta;
+	if (delta > state->max_lat)
+		state->max_lat = delta;
+
+	/* Early shots are accounted for in the first cell. */
+	cell = delta > 0 ? delta / runner->cell_ns : 0;
+	if (cell >= runner->hcells)
+		cell = runner->hcells - 1;
+	runner->histogram[cell]++;
+
+	runner->total_sum += delta;
+	runner->total_samples++;
+	state->ideal = ktime_add(state->ideal, period);
+
+	while (delta > 0 &&
+		(unsigned int)delta > ktime_to_ns(period)) { /* period > 0 */
+		state->overruns++;
+		state->ideal = ktime_add(state->ideal, period);
+		delta -= ktime_to_ns(period);
+	}
+
+	return 0;	/* Keep going. */
+}
+
 static void latmus_irq_handler(struct evl_timer *timer) /* hard irqs off */
 {
 	struct irq_runner *irq_runner;
@@ -518,7 +634,7 @@ static int start_kthread_runner(struct latmus_runner *runner,
 }
 
 static struct latmus_runner *
-create_kthread_runner(int priority, int cpu)
+create_kthread_runner(int priority, int cpu, bool multi)
 {
 	struct kthread_runner *k_runner;
 	int ret;
@@ -539,12 +655,21 @@ create_kthread_runner(int priority, int cpu)
 	init_runner_base(&k_runner->runner);
 	evl_init_flag(&k_runner->barrier);
 
-	ret = evl_run_kthread_on_cpu(&k_runner->kthread, cpu,
-				kthread_handler, k_runner,
-				priority,
-				EVL_CLONE_PUBLIC,
-				"latmus-klat:%d",
-				task_pid_nr(current));
+	/* Multi-CPU runners need distinct names. */
+	if (multi)
+		ret = evl_run_kthread_on_cpu(&k_runner->kthread, cpu,
+					kthread_handler, k_runner,
+					priority,
+					EVL_CLONE_PUBLIC,
+					"latmus-klat:%d.%d",
+					task_pid_nr(current), cpu);
+	else
+		ret = evl_run_kthread_on_cpu(&k_runner->kthread, cpu,
+					kthread_handler, k_runner,
+					priority,
+					EVL_CLONE_PUBLIC,
+					"latmus-klat:%d",
+					task_pid_nr(current));
 	if (ret) {
 		kfree(k_runner);
 		return ERR_PTR(ret);
@@ -630,7 +755,40 @@ static int add_uthread_sample(struct latmus_runner *runner,
 	return ret;
 }
 
-static struct latmus_runner *create_uthread_runner(int cpu)
+static int add_net_sample(struct latmus_runner *runner,
+			  struct latmus_net_sample *sample)
+{
+	struct runner_state *state = &runner->state;
+	struct uthread_runner *u_runner;
+	ktime_t origin;
+
+	u_runner = container_of(runner, struct uthread_runner, runner);
+
+	if (!sample->sent)
+		return add_uthread_sample(runner, 0);
+
+	if (sample->received < sample->sent)
+		return -EINVAL;
+
+	/*
+	 * Like the SIRQ runner does, discount the time elapsed from
+	 * the ideal release date to the origin of the measured path.
+	 */
+	if (u_runner->type == EVL_LAT_NET_RX) {
+		if (sample->ingress < sample->sent ||
+		    sample->ingress > sample->received)
+			return -EINVAL;
+		origin = ns_to_ktime(sample->ingress);
+	} else {
+		origin = ns_to_ktime(sample->sent);
+	}
+
+	state->offset = (int)ktime_to_ns(ktime_sub(origin, state->ideal));
+
+	return add_uthread_sample(runner, ns_to_ktime(sample->received));
+}
+
+static struct latmus_runner *create_uthread_runner(int cpu, int type)
 {
 	struct uthread_runner *u_runner;
 
@@ -639,7 +797,8 @@ static struct latmus_runner *create_uthread_runner(int cpu)
 		return NULL;
 
 	u_runner->runner = (struct latmus_runner){
-		.name = "uthread",
+		.name = type == EVL_LAT_NET_RX ? "netrx" :
+			type == EVL_LAT_NET_RTT ? "netrtt" : "uthread",
 		.destroy = destroy_uthread_runner,
 		.get_gravity = get_uthread_gravity,
 		.set_gravity = set_uthread_gravity,
@@ -648,6 +807,7 @@ static struct latmus_runner *create_uthread_runner(int cpu)
 		.stop = stop_uthread_runner,
 	};
 
+	u_runner->type = type;
 	init_runner_base(&u_runner->runner);
 	evl_init_timer_on_cpu(&u_runner->timer, cpu, latmus_pulse_handler);
 	evl_set_timer_gravity(&u_runner->timer, EVL_TIMER_UGRAVITY);
@@ -656,6 +816,179 @@ static struct latmus_runner *create_uthread_runner(int cpu)
 	return &u_runner->runner;
 }
 
+/* Hard irqs off. */
+static void add_hwlat_gap(struct hwlat_runner *h_runner,
+			ktime_t date, ktime_t gap)
+{
+	struct latmus_runner *runner = &h_runner->runner;
+	struct runner_state *state = &runner->state;
+	struct latmus_hwlat_gap *rec;
+	int delta, cell;
+
+	delta = (int)min_t(s64, ktime_to_ns(gap), INT_MAX);
+	if (delta < state->min_lat)
+		state->min_lat = delta;
+	if (delta > state->max_lat)
+		state->max_lat = delta;
+	if (delta > state->allmax_lat) {
+		state->allmax_lat = delta;
+		trace_evl_latspot(delta);
+		trace_evl_trigger("latmus");
+	}
+
+	if (runner->histogram) {
+		cell = delta / 1000; /* us */
+		if (cell >= runner->hcells)
+			cell = runner->hcells - 1;
+		runner->histogram[cell]++;
+	}
+
+	state->sum += delta;
+	state->cur_samples++;
+
+	/* Gaps in excess are only accounted for in the summary. */
+	raw_spin_lock(&h_runner->lock);
+	if (h_runner->nr_gaps < HWLAT_MAX_GAPS) {
+		rec = &h_runner->gaps[h_runner->nr_gaps++];
+		rec->date = ktime_to_ns(date);
+		rec->gap = delta;
+		rec->__pad = 0;
+	}
+	raw_spin_unlock(&h_runner->lock);
+}
+
+static void sample_hwlat_window(struct hwlat_runner *h_runner)
+{
+	ktime_t width = h_runner->runner.period / 2,
+		threshold = h_runner->threshold, start, last, now, gap;
+	unsigned long flags;
+
+	/*
+	 * Spin over half of the period, so that the in-band side
+	 * still gets some CPU time on the isolated core in between.
+	 */
+	flags = hard_local_irq_save();
+
+	start = last = evl_read_clock(&evl_mono_clock);
+	do {
+		now = evl_read_clock(&evl_mono_clock);
+		gap = ktime_sub(now, last);
+		if (gap > threshold)
+			add_hwlat_gap(h_runner, last, gap);
+		last = now;
+	} while (ktime_sub(now, start) < width);
+
+	hard_local_irq_restore(flags);
+}
+
+static void hwlat_handler(void *arg)
+{
+	struct hwlat_runner *h_runner = arg;
+	int ret = 0;
+
+	for (;;) {
+		if (evl_kthread_should_stop())
+			break;
+
+		ret = evl_wait_flag(&h_runner->barrier);
+		if (ret)
+			break;
+
+		ret = evl_set_period(&evl_mono_clock,
+				h_runner->start_time,
+				h_runner->runner.period);
+		if (ret)
+			break;
+
+		while (READ_ONCE(h_runner->armed)) {
+			ret = evl_wait_period(NULL);
+			if (ret == -ETIMEDOUT)
+				h_runner->runner.state.overruns++;
+			else if (ret)
+				goto out;
+			sample_hwlat_window(h_runner);
+			evl_raise_flag(&h_runner->ready);
+		}
+
+		evl_set_period(NULL, 0, 0);
+	}
+out:
+	done_sampling(&h_runner->runner, ret);
+	evl_raise_flag(&h_runner->ready);
+	evl_stop_kthread(&h_runner->kthread);
+}
+
+static void destroy_hwlat_runner(struct latmus_runner *runner)
+{
+	struct hwlat_runner *h_runner;
+
+	h_runner = container_of(runner, struct hwlat_runner, runner);
+	evl_stop_kthread(&h_runner->kthread);
+	evl_destroy_flag(&h_runner->barrier);
+	evl_destroy_flag(&h_runner->ready);
+	destroy_runner_base(runner);
+	kfree(h_runner);
+}
+
+static int start_hwlat_runner(struct latmus_runner *runner,
+			ktime_t start_time)
+{
+	struct hwlat_runner *h_runner;
+
+	h_runner = container_of(runner, struct hwlat_runner, runner);
+
+	h_runner->start_time = start_time;
+	h_runner->threshold = ns_to_ktime(READ_ONCE(hwlat_threshold_arg));
+	WRITE_ONCE(h_runner->armed, true);
+	evl_raise_flag(&h_runner->barrier);
+
+	return 0;
+}
+
+static void stop_hwlat_runner(struct latmus_runner *runner)
+{
+	struct hwlat_runner *h_runner;
+
+	h_runner = container_of(runner, struct hwlat_runner, runner);
+
+	WRITE_ONCE(h_runner->armed, false);
+}
+
+static struct latmus_runner *create_hwlat_runner(int priority, int cpu)
+{
+	struct hwlat_runner *h_runner;
+	int ret;
+
+	h_runner = kzalloc(sizeof(*h_runner), GFP_KERNEL);
+	if (h_runner == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	h_runner->runner = (struct latmus_runner){
+		.name = "hwlat",
+		.destroy = destroy_hwlat_runner,
+		.start = start_hwlat_runner,
+		.stop = stop_hwlat_runner,
+	};
+
+	init_runner_base(&h_runner->runner);
+	evl_init_flag(&h_runner->barrier);
+	evl_init_flag(&h_runner->ready);
+	raw_spin_lock_init(&h_runner->lock);
+
+	ret = evl_run_kthread_on_cpu(&h_runner->kthread, cpu,
+				hwlat_handler, h_runner,
+				priority,
+				EVL_CLONE_PUBLIC,
+				"latmus-hwlat:%d",
+				task_pid_nr(current));
+	if (ret) {
+		kfree(h_runner);
+		return ERR_PTR(ret);
+	}
+
+	return &h_runner->runner;
+}
+
 static inline void build_score(struct latmus_runner *runner, int step)
 {
 	struct runner_state *state = &runner->state;
@@ -791,7 +1124,7 @@ static int measure_continously(struct latmus_runner *runner)
 	state->sum = 0;
 	state->overruns = 0;
 	state->cur_samples = 0;
-	state->offset = 0;	/* for SIRQ latency only. */
+	state->offset = 0;	/* for SIRQ and NET latency only. */
 	state->ideal = ktime_add(evl_read_clock(&evl_mono_clock), period);
 
 	ret = runner->start(runner, state->ideal);
@@ -808,6 +1141,64 @@ out:
 	return ret;
 }
 
+/*
+ * The hwlat runner produces gap records at an unpredictable rate,
+ * which we forward to the xbuf channel from the caller's context
+ * as they come, so that the sampling loop never has to.
+ */
+static int measure_hwlat(struct latmus_runner *runner)
+{
+	struct latmus_hwlat_gap gaps[HWLAT_MAX_GAPS];
+	struct runner_state *state = &runner->state;
+	struct hwlat_runner *h_runner;
+	struct evl_file *sfilp;
+	struct evl_xbuf *xbuf;
+	unsigned long flags;
+	unsigned int nr;
+	int ret;
+
+	h_runner = container_of(runner, struct hwlat_runner, runner);
+
+	xbuf = evl_get_xbuf(runner->xfd, &sfilp);
+	if (xbuf == NULL)
+		return -EBADF;
+
+	state->min_lat = INT_MAX;
+	state->max_lat = INT_MIN;
+	state->allmax_lat = INT_MIN;
+	state->sum = 0;
+	state->overruns = 0;
+	state->cur_samples = 0;
+	h_runner->nr_gaps = 0;
+
+	ret = runner->start(runner, ktime_add(evl_read_clock(&evl_mono_clock),
+						runner->period));
+	if (ret)
+		goto out;
+
+	for (;;) {
+		ret = evl_wait_flag(&h_runner->ready) ?: runner->status;
+		if (ret)
+			break;
+
+		raw_spin_lock_irqsave(&h_runner->lock, flags);
+		nr = h_runner->nr_gaps;
+		memcpy(gaps, h_runner->gaps, nr * sizeof(gaps[0]));
+		h_runner->nr_gaps = 0;
+		raw_spin_unlock_irqrestore(&h_runner->lock, flags);
+
+		if (nr > 0)
+			evl_write_xbuf(xbuf, gaps, nr * sizeof(gaps[0]),
+				O_NONBLOCK);
+	}
+
+	runner->stop(runner);
+out:
+	evl_put_xbuf(sfilp);
+
+	return ret;
+}
+
 static int tune_gravity(struct latmus_runner *runner)
 {
 	struct runner_state *state = &runner->state;
@@ -816,6 +1207,8 @@ static int tune_gravity(struct latmus_runner *runner)
 	unsigned int orig_gravity;
 
 	state->max_samples = TUNER_SAMPLING_TIME / (int)ktime_to_ns(period);
+	/* Background tuning would defeat the calibration. */
+	evl_stop_gravity_tuning();
 	orig_gravity = runner->get_gravity(runner);
 	runner->add_sample = add_tuning_sample;
 	runner->set_gravity(runner, 0);
@@ -968,7 +1361,10 @@ static int run_measurement(struct latmus_runner *runner,
 	if (raw_copy_from_user_ptr64(&mr, result->data_ptr, sizeof(mr)))
 		return -EFAULT;
 
-	ret = measure_continously(runner);
+	if (runner->start == start_hwlat_runner)
+		ret = measure_hwlat(runner);
+	else
+		ret = measure_continously(runner);
 	if (ret != -EINTR)
 		return ret;
 
@@ -1003,6 +1399,572 @@ static void cleanup_measurement(struct latmus_runner *runner)
 		kfree(runner->histogram);
 }
 
+static void stop_multi_runner(struct latmus_runner *runner)
+{
+	struct multi_runner *group;
+	struct latmus_runner *r;
+	int n;
+
+	group = container_of(runner, struct multi_runner, runner);
+
+	/*
+	 * Kthread runners have no stop handler, they park on their
+	 * barrier next time they collect a sample.
+	 */
+	WRITE_ONCE(group->stopping, true);
+
+	for (n = 0; n < group->nr_slots; n++) {
+		r = group->slots[n].runner;
+		if (r->stop)
+			r->stop(r);
+	}
+}
+
+static int start_multi_runner(struct latmus_runner *runner,
+			      ktime_t start_time)
+{
+	struct runner_state *state;
+	struct multi_runner *group;
+	struct latmus_runner *r;
+	int n, ret;
+
+	group = container_of(runner, struct multi_runner, runner);
+
+	/*
+	 * Kthread runners from the previous run may not have parked
+	 * yet, let the caller retry until they did.
+	 */
+	if (group->started) {
+		for (n = 0; n < group->nr_slots; n++) {
+			r = group->slots[n].runner;
+			if (!r->stop && !evl_peek_flag(&r->done))
+				return -EBUSY;
+		}
+	}
+
+	WRITE_ONCE(group->stopping, false);
+	group->started = true;
+
+	for (n = 0; n < group->nr_slots; n++) {
+		r = group->slots[n].runner;
+		state = &r->state;
+		state->min_lat = INT_MAX;
+		state->max_lat = INT_MIN;
+		state->overruns = 0;
+		state->ideal = start_time;
+		r->warmup_samples = 0;
+		r->total_sum = 0;
+		r->total_samples = 0;
+		memset(r->histogram, 0, r->hcells * sizeof(s32));
+		evl_clear_flag(&r->done);
+	}
+
+	for (n = 0; n < group->nr_slots; n++) {
+		r = group->slots[n].runner;
+		ret = r->start(r, start_time);
+		if (ret) {
+			stop_multi_runner(runner);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/* Smallest latency below which @ppm millionths of the samples fall. */
+static s32 get_percentile(struct latmus_runner *runner, u32 ppm)
+{
+	u64 threshold, count = 0;
+	int cell;
+
+	threshold = DIV_ROUND_UP_ULL(runner->total_samples * ppm, 1000000);
+
+	for (cell = 0; cell < runner->hcells - 1; cell++) {
+		count += runner->histogram[cell];
+		if (count >= threshold)
+			return min_t(s64, (s64)(cell + 1) * runner->cell_ns,
+				     runner->state.max_lat);
+	}
+
+	return runner->state.max_lat;
+}
+
+static void build_cpu_result(struct multi_slot *slot,
+			     struct latmus_cpu_result *res)
+{
+	struct latmus_runner *r = slot->runner;
+
+	memset(res, 0, sizeof(*res));
+	res->cpu = slot->cpu;
+	res->samples = r->total_samples;
+	if (res->samples == 0)
+		return;
+
+	res->sum_lat = r->total_sum;
+	res->min_lat = r->state.min_lat;
+	res->max_lat = r->state.max_lat;
+	res->overruns = r->state.overruns;
+	res->p50_lat = get_percentile(r, 500000);
+	res->p99_lat = get_percentile(r, 990000);
+	res->p999_lat = get_percentile(r, 999000);
+	res->p9999_lat = get_percentile(r, 999900);
+}
+
+static int run_multi_measurement(struct latmus_runner *runner,
+				 struct latmus_result *result)
+{
+	struct latmus_multi_result mr;
+	struct latmus_cpu_result res;
+	struct multi_runner *group;
+	enum evl_tmode tmode;
+	ktime_t start, timeout;
+	__u32 nr;
+	int ret, n;
+
+	group = container_of(runner, struct multi_runner, runner);
+
+	if (result->len != sizeof(mr))
+		return -EINVAL;
+
+	if (raw_copy_from_user_ptr64(&mr, result->data_ptr, sizeof(mr)))
+		return -EFAULT;
+
+	if (mr.nr_results < group->nr_slots)
+		return -EINVAL;
+
+	/*
+	 * Leave enough time for all runners to be armed before the
+	 * common start date.
+	 */
+	start = ktime_add_ns(evl_read_clock(&evl_mono_clock),
+			     MULTI_START_DELAY);
+	ret = runner->start(runner, start);
+	if (ret)
+		return ret;
+
+	if (mr.duration) {
+		/* All runners share the same period, hence warmup. */
+		timeout = ktime_add_ns(start, ktime_to_ns(runner->period) *
+				       group->slots[0].runner->warmup_limit);
+		timeout = ktime_add_ns(timeout, mr.duration);
+		tmode = EVL_ABS;
+	} else {
+		timeout = EVL_INFINITE;
+		tmode = EVL_REL;
+	}
+
+	/*
+	 * Nobody raises the group flag, we only wait for the run to
+	 * time out, or for the caller to be interrupted.
+	 */
+	ret = evl_wait_flag_timeout(&runner->done, timeout, tmode);
+	runner->stop(runner);
+	if (ret != -ETIMEDOUT && ret != -EINTR)
+		return ret;
+
+	for (n = 0; n < group->nr_slots; n++) {
+		build_cpu_result(&group->slots[n], &res);
+		if (raw_copy_to_user_ptr64(mr.results_ptr + n * sizeof(res),
+					   &res, sizeof(res)))
+			return -EFAULT;
+	}
+
+	nr = group->nr_slots;
+	if (raw_copy_to_user_ptr64(result->data_ptr +
+				   offsetof(struct latmus_multi_result, nr_results),
+				   &nr, sizeof(nr)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static void destroy_multi_runner(struct latmus_runner *runner)
+{
+	struct multi_runner *group;
+	struct latmus_runner *r;
+	int n;
+
+	group = container_of(runner, struct multi_runner, runner);
+
+	for (n = 0; n < group->nr_slots; n++) {
+		r = group->slots[n].runner;
+		r->destroy(r);
+	}
+
+	destroy_runner_base(runner);
+	kfree(group);
+}
+
+static int setup_multi_slot(struct multi_runner *group,
+			    struct latmus_multi_setup *setup, int cpu)
+{
+	struct multi_slot *slot = &group->slots[group->nr_slots];
+	struct latmus_runner *r;
+
+	switch (setup->type) {
+	case EVL_LAT_IRQ:
+		r = create_irq_runner(cpu);
+		break;
+	case EVL_LAT_KERN:
+		r = create_kthread_runner(setup->priority, cpu, true);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (r == NULL)
+		return -ENOMEM;
+
+	if (IS_ERR(r))
+		return PTR_ERR(r);
+
+	r->period = setup->period;
+	r->warmup_limit = ONE_BILLION / (int)ktime_to_ns(setup->period); /* 1s warmup */
+	r->hcells = setup->hcells;
+	r->cell_ns = setup->cell_ns;
+	r->group = group;
+	r->add_sample = add_multi_sample;
+	r->histogram = kcalloc(r->hcells, sizeof(s32), GFP_KERNEL);
+	if (r->histogram == NULL) {
+		r->destroy(r);
+		return -ENOMEM;
+	}
+
+	r->cleanup = cleanup_measurement;
+	slot->runner = r;
+	slot->cpu = cpu;
+	group->nr_slots++;
+
+	return 0;
+}
+
+static int setup_multi_measurement(struct latmus_state *ls,
+				   struct latmus_multi_setup __user *u_setup)
+{
+	struct latmus_multi_setup setup;
+	struct multi_runner *group;
+	cpumask_var_t cpus;
+	int cpu, ret;
+	size_t len;
+
+	if (copy_from_user(&setup, u_setup, sizeof(setup)))
+		return -EFAULT;
+
+	if (setup.type != EVL_LAT_IRQ && setup.type != EVL_LAT_KERN)
+		return -EINVAL;
+
+	if (setup.period <= 0 || setup.period > ONE_BILLION)
+		return -EINVAL;
+
+	if (setup.priority < 1 || setup.priority > EVL_FIFO_MAX_PRIO)
+		return -EINVAL;
+
+	if (setup.hcells == 0 || setup.hcells > MULTI_MAX_HCELLS ||
+	    setup.cell_ns == 0 || setup.cell_ns > ONE_BILLION)
+		return -EINVAL;
+
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL))
+		return -ENOMEM;
+
+	len = min_t(size_t, setup.cpu_set_len, cpumask_size());
+	if (copy_from_user(cpumask_bits(cpus),
+			   u64_to_user_ptr(setup.cpu_set_ptr), len)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	cpumask_and(cpus, cpus, cpu_possible_mask);
+	if (cpumask_empty(cpus) || !cpumask_subset(cpus, &evl_oob_cpus)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	group = kzalloc(struct_size(group, slots, cpumask_weight(cpus)),
+			GFP_KERNEL);
+	if (group == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	group->runner = (struct latmus_runner){
+		.name = "multi",
+		.destroy = destroy_multi_runner,
+		.start = start_multi_runner,
+		.stop = stop_multi_runner,
+		.run = run_multi_measurement,
+	};
+	group->runner.period = setup.period;
+	init_runner_base(&group->runner);
+
+	for_each_cpu(cpu, cpus) {
+		ret = setup_multi_slot(group, &setup, cpu);
+		if (ret) {
+			destroy_multi_runner(&group->runner);
+			goto out;
+		}
+	}
+
+	/* Clear previous runner. */
+	if (ls->runner)
+		ls->runner->destroy(ls->runner);
+
+	ls->runner = &group->runner;
+	ret = 0;
+out:
+	free_cpumask_var(cpus);
+
+	return ret;
+}
+
+static void stress_cache(struct stress_worker *w)
+{
+	size_t off;
+
+	/* Dirty every line, the footprint should exceed the LLC. */
+	for (off = 0; off < w->size; off += L1_CACHE_BYTES)
+		w->area[off]++;
+}
+
+static void stress_membw(struct stress_worker *w)
+{
+	size_t half = w->size / 2;
+
+	memcpy(w->area + half, w->area, half);
+}
+
+static void stress_tlb(struct stress_worker *w)
+{
+	size_t off;
+
+	/*
+	 * vmalloc maps the area with base pages, touch one line per
+	 * page, spreading accesses over the cache sets.
+	 */
+	for (off = 0; off < w->size; off += PAGE_SIZE)
+		(void)READ_ONCE(w->area[off + ((off >> PAGE_SHIFT) *
+					L1_CACHE_BYTES) % PAGE_SIZE]);
+}
+
+static void stress_ipi_handler(void *arg)
+{
+}
+
+static void stress_ipi(struct stress_worker *w)
+{
+	int n;
+
+	for (n = 0; n < STRESS_IPI_BATCH; n++)
+		on_each_cpu_mask(w->stress->cpus, stress_ipi_handler,
+				NULL, true);
+}
+
+/* EVL_LAT_STRESS_IRQ is timer-driven, see stress_irq_handler(). */
+static void (*const stress_ops[EVL_LAT_STRESS_NR])(struct stress_worker *w) = {
+	[0] = stress_cache,
+	[1] = stress_membw,
+	[2] = stress_tlb,
+	[3] = stress_ipi,
+};
+
+static enum hrtimer_restart stress_irq_handler(struct hrtimer *timer)
+{
+	struct stress_worker *w = container_of(timer, struct stress_worker, timer);
+	struct latmus_stress *stress = w->stress;
+
+	atomic64_inc(&stress->rounds[ilog2(EVL_LAT_STRESS_IRQ)]);
+	hrtimer_forward_now(timer, stress->irq_period);
+
+	return HRTIMER_RESTART;
+}
+
+static int stress_worker(void *arg)
+{
+	struct stress_worker *w = arg;
+	struct latmus_stress *stress = w->stress;
+	u32 mask = stress->setup.mask;
+	unsigned int busy_us, n;
+	ktime_t deadline;
+
+	if (mask & EVL_LAT_STRESS_IRQ)
+		hrtimer_start(&w->timer, stress->irq_period,
+			HRTIMER_MODE_REL_PINNED_HARD);
+
+	/* Only the timer is running, wait for kthread_stop(). */
+	if (!(mask & ~EVL_LAT_STRESS_IRQ)) {
+		for (;;) {
+			set_current_state(TASK_INTERRUPTIBLE);
+			if (kthread_should_stop())
+				break;
+			schedule();
+		}
+		__set_current_state(TASK_RUNNING);
+		goto out;
+	}
+
+	busy_us = STRESS_WINDOW_US * stress->setup.intensity / 100;
+
+	while (!kthread_should_stop()) {
+		deadline = ktime_add_us(ktime_get(), busy_us);
+		do {
+			for (n = 0; n < EVL_LAT_STRESS_NR; n++) {
+				if (stress_ops[n] && (mask & BIT(n))) {
+					stress_ops[n](w);
+					atomic64_inc(&stress->rounds[n]);
+				}
+			}
+			cond_resched();
+		} while (!kthread_should_stop() &&
+			ktime_before(ktime_get(), deadline));
+
+		if (busy_us < STRESS_WINDOW_US)
+			usleep_range(STRESS_WINDOW_US - busy_us,
+				STRESS_WINDOW_US - busy_us + 100);
+	}
+out:
+	hrtimer_cancel(&w->timer);
+
+	return 0;
+}
+
+static void stop_stressors(struct latmus_state *ls)
+{
+	struct latmus_stress *stress = ls->stress;
+	struct stress_worker *w;
+	int cpu;
+
+	if (stress == NULL)
+		return;
+
+	for_each_cpu(cpu, stress->cpus) {
+		w = &stress->workers[cpu];
+		if (w->task)
+			kthread_stop(w->task);
+		vfree(w->area);
+	}
+
+	free_cpumask_var(stress->cpus);
+	kfree(stress->workers);
+	kfree(stress);
+	ls->stress = NULL;
+}
+
+static int start_stressors(struct latmus_state *ls,
+			struct latmus_stress_setup __user *u_setup)
+{
+	struct latmus_stress_setup setup;
+	struct latmus_stress *stress;
+	struct stress_worker *w;
+	struct task_struct *p;
+	size_t len;
+	int cpu;
+
+	if (copy_from_user(&setup, u_setup, sizeof(setup)))
+		return -EFAULT;
+
+	if (setup.mask & ~STRESS_ALL_MASK)
+		return -EINVAL;
+
+	if (setup.mask && (setup.intensity < 1 || setup.intensity > 100))
+		return -EINVAL;
+
+	if (setup.footprint == 0)
+		setup.footprint = STRESS_DEF_FOOTPRINT;
+	else if (setup.footprint > STRESS_MAX_FOOTPRINT)
+		return -EINVAL;
+
+	stop_stressors(ls);
+
+	if (setup.mask == 0)
+		return 0;
+
+	stress = kzalloc(sizeof(*stress), GFP_KERNEL);
+	if (stress == NULL)
+		return -ENOMEM;
+
+	/* Assigned now, so that stop_stressors() may undo a partial setup. */
+	ls->stress = stress;
+	stress->setup = setup;
+	stress->irq_period = ns_to_ktime(NSEC_PER_MSEC / setup.intensity);
+
+	stress->workers = kcalloc(nr_cpu_ids, sizeof(*w), GFP_KERNEL);
+	if (stress->workers == NULL ||
+		!zalloc_cpumask_var(&stress->cpus, GFP_KERNEL)) {
+		kfree(stress->workers);
+		kfree(stress);
+		ls->stress = NULL;
+		return -ENOMEM;
+	}
+
+	if (setup.cpu_set_len == 0) {
+		cpumask_copy(stress->cpus, cpu_online_mask);
+	} else {
+		len = min_t(size_t, setup.cpu_set_len, cpumask_size());
+		if (copy_from_user(cpumask_bits(stress->cpus),
+				u64_to_user_ptr(setup.cpu_set_ptr), len)) {
+			stop_stressors(ls);
+			return -EFAULT;
+		}
+		cpumask_and(stress->cpus, stress->cpus, cpu_online_mask);
+		if (cpumask_empty(stress->cpus)) {
+			stop_stressors(ls);
+			return -EINVAL;
+		}
+	}
+
+	for_each_cpu(cpu, stress->cpus) {
+		w = &stress->workers[cpu];
+		w->stress = stress;
+		hrtimer_setup(&w->timer, stress_irq_handler, CLOCK_MONOTONIC,
+			HRTIMER_MODE_REL_PINNED_HARD);
+		if (setup.mask & (EVL_LAT_STRESS_CACHE|EVL_LAT_STRESS_MEMBW|
+					EVL_LAT_STRESS_TLB)) {
+			w->size = (size_t)setup.footprint * 1024;
+			w->area = vzalloc_node(w->size, cpu_to_node(cpu));
+			if (w->area == NULL) {
+				stop_stressors(ls);
+				return -ENOMEM;
+			}
+		}
+		p = kthread_create_on_cpu(stress_worker, w, cpu,
+					"latmus-stress/%u");
+		if (IS_ERR(p)) {
+			stop_stressors(ls);
+			return PTR_ERR(p);
+		}
+		w->task = p;
+	}
+
+	/* Start all stressors together once the setup is complete. */
+	for_each_cpu(cpu, stress->cpus)
+		wake_up_process(stress->workers[cpu].task);
+
+	printk(EVL_INFO "latmus: stressors 0x%x, intensity %u%%, "
+		"footprint %u KiB, on CPU(s) %*pbl\n",
+		setup.mask, setup.intensity, setup.footprint,
+		cpumask_pr_args(stress->cpus));
+
+	return 0;
+}
+
+static int get_stress_status(struct latmus_state *ls,
+			struct latmus_stress_status __user *u_status)
+{
+	struct latmus_stress *stress = ls->stress;
+	struct latmus_stress_status status;
+	int n;
+
+	memset(&status, 0, sizeof(status));
+
+	if (stress) {
+		status.setup = stress->setup;
+		status.nr_cpus = cpumask_weight(stress->cpus);
+		for (n = 0; n < EVL_LAT_STRESS_NR; n++)
+			status.rounds[n] = atomic64_read(&stress->rounds[n]);
+	}
+
+	return copy_to_user(u_status, &status, sizeof(status)) ? -EFAULT : 0;
+}
+
 static long latmus_ioctl(struct file *filp, unsigned int cmd,
 			 unsigned long arg)
 {
@@ -1021,13 +1983,29 @@ static long latmus_ioctl(struct file *filp, unsigned int cmd,
 		return 0;
 	}
 
+	if (cmd == EVL_LATIOC_MEASURE_MULTI)
+		return setup_multi_measurement(ls,
+				(struct latmus_multi_setup __user *)arg);
+
+	if (cmd == EVL_LATIOC_STRESS)
+		return start_stressors(ls,
+				(struct latmus_stress_setup __user *)arg);
+
+	if (cmd == EVL_LATIOC_GETSTRESS)
+		return get_stress_status(ls,
+				(struct latmus_stress_status __user *)arg);
+
 	/* All other cmds require a setup struct to be passed. */
 
 	if (copy_from_user(&setup_data, (struct latmus_setup __user *)arg,
 			   sizeof(setup_data)))
 		return -EFAULT;
 
-	if (setup_data.type == EVL_LAT_SIRQ && cmd != EVL_LATIOC_MEASURE)
+	if ((setup_data.type == EVL_LAT_SIRQ ||
+	     setup_data.type == EVL_LAT_NET_RX ||
+	     setup_data.type == EVL_LAT_NET_RTT ||
+	     setup_data.type == EVL_LAT_HWLAT) &&
+	    cmd != EVL_LATIOC_MEASURE)
 		return -EINVAL;
 
 	switch (cmd) {
@@ -1070,14 +2048,21 @@ static long latmus_ioctl(struct file *filp, unsigned int cmd,
 		break;
 	case EVL_LAT_KERN:
 		runner = create_kthread_runner(setup_data.priority,
-					       setup_data.cpu);
+					       setup_data.cpu, false);
 		break;
 	case EVL_LAT_USER:
-		runner = create_uthread_runner(setup_data.cpu);
+	case EVL_LAT_NET_RX:
+	case EVL_LAT_NET_RTT:
+		runner = create_uthread_runner(setup_data.cpu,
+					       setup_data.type);
 		break;
 	case EVL_LAT_SIRQ:
 		runner = create_sirq_runner(setup_data.cpu);
 		break;
+	case EVL_LAT_HWLAT:
+		runner = create_hwlat_runner(setup_data.priority,
+					setup_data.cpu);
+		break;
 	default:
 		return -EINVAL;
 	}
@@ -1103,6 +2088,7 @@ static long latmus_oob_ioctl(struct file *filp, unsigned int cmd,
 {
 	struct latmus_state *ls = filp->private_data;
 	struct latmus_runner *runner;
+	struct latmus_net_sample net_sample;
 	struct latmus_result result;
 	__u64 timestamp;
 	int ret;
@@ -1129,6 +2115,18 @@ static long latmus_oob_ioctl(struct file *filp, unsigned int cmd,
 			return -EFAULT;
 		ret = add_uthread_sample(runner, ns_to_ktime(timestamp));
 		break;
+	case EVL_LATIOC_NETPULSE:
+		if (runner->start != start_uthread_runner ||
+		    container_of(runner, struct uthread_runner,
+				 runner)->type == EVL_LAT_USER)
+			return -EINVAL;
+		ret = raw_copy_from_user(&net_sample,
+				(struct latmus_net_sample __user *)arg,
+				sizeof(net_sample));
+		if (ret)
+			return -EFAULT;
+		ret = add_net_sample(runner, &net_sample);
+		break;
 	default:
 		ret = -ENOTTY;
 	}
@@ -1164,6 +2162,7 @@ static int latmus_release(struct inode *inode, struct file *filp)
 	if (runner)
 		runner->destroy(runner);
 
+	stop_stressors(ls);
 	evl_release_file(&ls->efile);
 	kfree(ls);
 
@@ -17,6 +17,7 @@
 #include <linux/interrupt.h>
 #include <linux/irqreturn.h>
 #include <linux/kfifo.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/overflow.h>
@@ -27,6 +28,7 @@
 #include <linux/string.h>
 #include <linux/timekeeping.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include <linux/workqueue.h>
 
 #include <uapi/linux/gpio.h>
@@ -210,6 +212,9 @@ static long linehandle_set_config(struct linehandle_state *lh,
 	return 0;
 }
 
+static long linehandle_pulse_ioctl(struct linehandle_state *lh,
+				unsigned int cmd, void __user *ip);
+
 static long linehandle_ioctl(struct file *file, unsigned int cmd,
 			     unsigned long arg)
 {
@@ -267,7 +272,7 @@ static long linehandle_ioctl(struct file *file, unsigned int cmd,
 	case GPIOHANDLE_SET_CONFIG_IOCTL:
 		return linehandle_set_config(lh, ip);
 	default:
-		return -EINVAL;
+		return linehandle_pulse_ioctl(lh, cmd, ip);
 	}
 }
 
@@ -281,6 +286,345 @@ static long linehandle_ioctl_compat(struct file *file, unsigned int cmd,
 
 #ifdef CONFIG_GPIOLIB_OOB
 
+/*
+ * Pulse generator. An EVL timer plays each edge at hard irq level,
+ * then fetches the next one either from the ring user space fills
+ * in, or from the frequency ramp we compute. Edge dates are derived
+ * from the start date, so that errors do not accumulate.
+ */
+struct linehandle_pulse {
+	struct linehandle_state *lh;
+	struct gpiohandle_pulse_ring *ring;
+	u32 nr_edges;
+	u32 tail;
+	struct evl_timer timer;
+	struct evl_poll_head poll_head;
+	hard_spinlock_t lock;
+	bool running;
+	u32 mode;
+	ktime_t next_date;
+	u64 pending;
+	u64 values;
+	u64 line_mask;
+	u64 start_period;
+	u64 end_period;
+	u64 nr_pulses;
+	u64 ramp_edges;
+};
+
+#define GPIOHANDLE_PULSE_MAX_EDGES	65536
+
+static void set_pulse_values(struct linehandle_pulse *pulse, u64 values)
+{
+	struct linehandle_state *lh = pulse->lh;
+	DECLARE_BITMAP(valmap, GPIOHANDLES_MAX);
+	int n;
+
+	for (n = 0; n < lh->num_descs; n++)
+		__assign_bit(n, valmap, values & BIT_ULL(n));
+
+	gpiod_set_array_value_oob(lh->gdev->chip, valmap,
+				lh->num_descs, lh->descs);
+	pulse->values = values;
+}
+
+static u64 get_ramp_period(struct linehandle_pulse *pulse, u64 nr)
+{
+	u64 span;
+
+	if (pulse->nr_pulses == 1)
+		return pulse->start_period;
+
+	if (pulse->end_period >= pulse->start_period) {
+		span = pulse->end_period - pulse->start_period;
+		return pulse->start_period +
+			mul_u64_u64_div_u64(span, nr, pulse->nr_pulses - 1);
+	}
+
+	span = pulse->start_period - pulse->end_period;
+
+	return pulse->start_period -
+		mul_u64_u64_div_u64(span, nr, pulse->nr_pulses - 1);
+}
+
+/* pulse->lock held, hard irqs off. */
+static bool fetch_pulse_edge(struct linehandle_pulse *pulse,
+			u64 *delay, u64 *values)
+{
+	struct gpiohandle_pulse_ring *ring = pulse->ring;
+	struct gpiohandle_pulse_edge *edge;
+	u32 head;
+
+	if (pulse->mode == GPIOHANDLE_PULSE_RAMP) {
+		if (pulse->ramp_edges >= pulse->nr_pulses * 2)
+			return false;
+		/* Rising then falling edge, half a period apart. */
+		*delay = pulse->ramp_edges ?
+			get_ramp_period(pulse, (pulse->ramp_edges - 1) / 2) / 2 : 0;
+		if (pulse->ramp_edges & 1)
+			*values = pulse->values & ~pulse->line_mask;
+		else
+			*values = pulse->values | pulse->line_mask;
+		pulse->ramp_edges++;
+		return true;
+	}
+
+	/*
+	 * The ring is writable from user space, do not trust the
+	 * indices: anything beyond the ring size reads as empty.
+	 */
+	head = smp_load_acquire(&ring->head);
+	if (head == pulse->tail || head - pulse->tail > pulse->nr_edges)
+		return false;
+
+	edge = &ring->edges[pulse->tail & (pulse->nr_edges - 1)];
+	*delay = READ_ONCE(edge->delay_ns);
+	*values = READ_ONCE(edge->values);
+	pulse->tail++;
+	smp_store_release(&ring->tail, pulse->tail);
+
+	return true;
+}
+
+/* pulse->lock held, hard irqs off. */
+static void stop_pulse_locked(struct linehandle_pulse *pulse, u32 status)
+{
+	pulse->running = false;
+	evl_stop_timer(&pulse->timer);
+	WRITE_ONCE(pulse->ring->status, status);
+}
+
+static void pulse_timer_handler(struct evl_timer *timer) /* hard irqs off */
+{
+	struct linehandle_pulse *pulse =
+		container_of(timer, struct linehandle_pulse, timer);
+	u64 delay, values;
+
+	raw_spin_lock(&pulse->lock);
+
+	if (!pulse->running)
+		goto out;
+
+	set_pulse_values(pulse, pulse->pending);
+
+	if (fetch_pulse_edge(pulse, &delay, &values)) {
+		pulse->pending = values;
+		pulse->next_date = ktime_add_ns(pulse->next_date, delay);
+		evl_start_timer(timer, pulse->next_date, EVL_INFINITE);
+	} else {
+		/* Running out of edges is fine only for a ramp. */
+		stop_pulse_locked(pulse,
+			pulse->mode == GPIOHANDLE_PULSE_EDGES ?
+			GPIOHANDLE_PULSE_UNDERRUN : 0);
+	}
+
+	evl_signal_poll_events(&pulse->poll_head, POLLOUT|POLLWRNORM);
+out:
+	raw_spin_unlock(&pulse->lock);
+}
+
+static int setup_pulse(struct linehandle_state *lh, void __user *ip)
+{
+	struct gpiohandle_pulse_setup setup;
+	struct linehandle_pulse *pulse;
+	size_t size;
+
+	if (!oob_handling_requested(lh->lflags) ||
+		!test_bit(FLAG_IS_OUT, &lh->descs[0]->flags))
+		return -EPERM;
+
+	if (copy_from_user(&setup, ip, sizeof(setup)))
+		return -EFAULT;
+
+	if (!setup.nr_edges || setup.nr_edges > GPIOHANDLE_PULSE_MAX_EDGES ||
+		!is_power_of_2(setup.nr_edges))
+		return -EINVAL;
+
+	if (READ_ONCE(lh->oob_state.pulse))
+		return -EBUSY;
+
+	pulse = kzalloc(sizeof(*pulse), GFP_KERNEL);
+	if (!pulse)
+		return -ENOMEM;
+
+	size = PAGE_ALIGN(struct_size(pulse->ring, edges, setup.nr_edges));
+	pulse->ring = vmalloc_user(size);
+	if (!pulse->ring) {
+		kfree(pulse);
+		return -ENOMEM;
+	}
+
+	pulse->lh = lh;
+	pulse->nr_edges = setup.nr_edges;
+	pulse->ring->nr_edges = setup.nr_edges;
+	raw_spin_lock_init(&pulse->lock);
+	evl_init_poll_head(&pulse->poll_head);
+	evl_init_timer(&pulse->timer, pulse_timer_handler);
+
+	if (cmpxchg(&lh->oob_state.pulse, NULL, pulse)) {
+		evl_destroy_timer(&pulse->timer);
+		vfree(pulse->ring);
+		kfree(pulse);
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+static int start_pulse(struct linehandle_state *lh,
+		const struct gpiohandle_pulse_start *req)
+{
+	struct linehandle_pulse *pulse = READ_ONCE(lh->oob_state.pulse);
+	DECLARE_BITMAP(valmap, GPIOHANDLES_MAX);
+	u64 delay, values = 0;
+	unsigned long flags;
+	ktime_t date;
+	int n, ret;
+
+	if (!pulse)
+		return -ENXIO;
+
+	switch (req->mode) {
+	case GPIOHANDLE_PULSE_EDGES:
+		break;
+	case GPIOHANDLE_PULSE_RAMP:
+		if (!req->ramp.line_mask || !req->ramp.nr_pulses ||
+			!req->ramp.start_period_ns || !req->ramp.end_period_ns)
+			return -EINVAL;
+		if (req->ramp.line_mask & ~GENMASK_ULL(lh->num_descs - 1, 0))
+			return -EINVAL;
+		if (req->ramp.nr_pulses > U64_MAX / 2)
+			return -EINVAL;
+		/* The lines we do not pulse keep their current value. */
+		ret = gpiod_get_array_value_oob(lh->gdev->chip, valmap,
+					lh->num_descs, lh->descs);
+		if (ret)
+			return ret;
+		for (n = 0; n < lh->num_descs; n++)
+			if (test_bit(n, valmap))
+				values |= BIT_ULL(n);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	raw_spin_lock_irqsave(&pulse->lock, flags);
+
+	if (pulse->running) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	pulse->mode = req->mode;
+	pulse->values = values;
+	pulse->line_mask = req->ramp.line_mask;
+	pulse->start_period = req->ramp.start_period_ns;
+	pulse->end_period = req->ramp.end_period_ns;
+	pulse->nr_pulses = req->ramp.nr_pulses;
+	pulse->ramp_edges = 0;
+
+	if (!fetch_pulse_edge(pulse, &delay, &pulse->pending)) {
+		ret = -ENODATA;
+		goto out;
+	}
+
+	date = req->start_ns ? ns_to_ktime(req->start_ns) :
+		evl_read_clock(&evl_mono_clock);
+	pulse->next_date = ktime_add_ns(date, delay);
+	pulse->running = true;
+	WRITE_ONCE(pulse->ring->status, GPIOHANDLE_PULSE_RUNNING);
+	evl_start_timer(&pulse->timer, pulse->next_date, EVL_INFINITE);
+	ret = 0;
+out:
+	raw_spin_unlock_irqrestore(&pulse->lock, flags);
+
+	return ret;
+}
+
+static int stop_pulse(struct linehandle_state *lh)
+{
+	struct linehandle_pulse *pulse = READ_ONCE(lh->oob_state.pulse);
+	unsigned long flags;
+
+	if (!pulse)
+		return -ENXIO;
+
+	raw_spin_lock_irqsave(&pulse->lock, flags);
+	if (pulse->running)
+		stop_pulse_locked(pulse, 0);
+	raw_spin_unlock_irqrestore(&pulse->lock, flags);
+
+	return 0;
+}
+
+static void free_pulse(struct linehandle_state *lh)
+{
+	struct linehandle_pulse *pulse = lh->oob_state.pulse;
+
+	if (!pulse)
+		return;
+
+	stop_pulse(lh);
+	evl_destroy_timer(&pulse->timer);
+	vfree(pulse->ring);
+	kfree(pulse);
+}
+
+static __poll_t linehandle_oob_poll(struct file *file,
+				struct oob_poll_wait *wait)
+{
+	struct linehandle_state *lh = file->private_data;
+	struct linehandle_pulse *pulse = READ_ONCE(lh->oob_state.pulse);
+	unsigned long flags;
+	__poll_t ready = 0;
+	u32 used;
+
+	if (!pulse)
+		return POLLERR;
+
+	evl_poll_watch(&pulse->poll_head, wait, NULL);
+
+	raw_spin_lock_irqsave(&pulse->lock, flags);
+
+	used = READ_ONCE(pulse->ring->head) - pulse->tail;
+	if (used < pulse->nr_edges)
+		ready |= POLLOUT|POLLWRNORM;
+
+	raw_spin_unlock_irqrestore(&pulse->lock, flags);
+
+	return ready;
+}
+
+static int linehandle_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct linehandle_state *lh = file->private_data;
+	struct linehandle_pulse *pulse = READ_ONCE(lh->oob_state.pulse);
+
+	if (!pulse)
+		return -ENXIO;
+
+	return remap_vmalloc_range(vma, pulse->ring, vma->vm_pgoff);
+}
+
+static long linehandle_pulse_ioctl(struct linehandle_state *lh,
+				unsigned int cmd, void __user *ip)
+{
+	struct gpiohandle_pulse_start req;
+
+	switch (cmd) {
+	case GPIOHANDLE_SETUP_PULSE_IOCTL:
+		return setup_pulse(lh, ip);
+	case GPIOHANDLE_START_PULSE_IOCTL:
+		if (copy_from_user(&req, ip, sizeof(req)))
+			return -EFAULT;
+		return start_pulse(lh, &req);
+	case GPIOHANDLE_STOP_PULSE_IOCTL:
+		return stop_pulse(lh);
+	default:
+		return -EINVAL;
+	}
+}
+
 static long linehandle_oob_ioctl(struct file *file, unsigned int cmd,
 				unsigned long arg)
 {
@@ -320,11 +664,31 @@ static long linehandle_oob_ioctl(struct file *file, unsigned int cmd,
 
 		return gpiod_set_array_value_oob(gc, valmap,
 					lh->num_descs, lh->descs);
+	} else if (cmd == GPIOHANDLE_START_PULSE_IOCTL) {
+		struct gpiohandle_pulse_start req;
+
+		if (raw_copy_from_user(&req, ip, sizeof(req)))
+			return -EFAULT;
+
+		return start_pulse(lh, &req);
+	} else if (cmd == GPIOHANDLE_STOP_PULSE_IOCTL) {
+		return stop_pulse(lh);
 	}
 
 	return -EINVAL;
 }
 
+#else
+
+static inline long linehandle_pulse_ioctl(struct linehandle_state *lh,
+					unsigned int cmd, void __user *ip)
+{
+	return -EINVAL;
+}
+
+static inline void free_pulse(struct linehandle_state *lh)
+{ }
+
 #endif	/* CONFIG_GPIOLIB_OOB */
 
 static void linehandle_free(struct linehandle_state *lh)
@@ -343,8 +707,10 @@ static int linehandle_release(struct inode *inode, struct file *file)
 {
  	struct linehandle_state *lh = file->private_data;
 
-	if (oob_handling_requested(lh->lflags))
+	if (oob_handling_requested(lh->lflags)) {
 		evl_release_file(&lh->oob_state.efile);
+		free_pulse(lh);
+	}
 
 	linehandle_free(lh);
 	return 0;
@@ -357,6 +723,8 @@ static const struct file_operations linehandle_fileops = {
 	.unlocked_ioctl = linehandle_ioctl,
 #ifdef CONFIG_GPIOLIB_OOB
 	.oob_ioctl = linehandle_oob_ioctl,
+	.oob_poll = linehandle_oob_poll,
+	.mmap = linehandle_mmap,
 #endif
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = linehandle_ioctl_compat,
@@ -2022,14 +2390,41 @@ static int lineevent_read_pin(struct lineevent_state *le,
 
 #ifdef CONFIG_GPIOLIB_OOB
 
+/*
+ * Tell which edge triggered the interrupt. If both edges are
+ * monitored, the current line level has to be sampled, which we can
+ * do directly from the oob stage since the chip cannot sleep.
+ */
+static int lineevent_oob_read_level(struct lineevent_state *le)
+{
+	DECLARE_BITMAP(valmap, 1);
+	int ret;
+
+	if ((le->eflags & GPIOEVENT_REQUEST_BOTH_EDGES) !=
+		GPIOEVENT_REQUEST_BOTH_EDGES)
+		return 0;
+
+	ret = gpiod_get_array_value_oob(le->gdev->chip, valmap, 1, &le->desc);
+	if (ret)
+		return 0;
+
+	return test_bit(0, valmap);
+}
+
 static irqreturn_t lineevent_oob_irq_handler(int irq, void *p)
 {
 	struct lineevent_state *le = p;
 	struct gpioevent_data ge;
 
+	/*
+	 * Timestamp first, as close as possible to the hardware
+	 * event. There is no way to get a timestamp from the HTE
+	 * subsystem on the oob stage, since it delivers from in-band
+	 * context.
+	 */
 	ge.timestamp = evl_ktime_monotonic();
 
-	if (lineevent_read_pin(le, &ge, false) == IRQ_NONE)
+	if (lineevent_read_pin(le, &ge, lineevent_oob_read_level(le)) == IRQ_NONE)
 		return IRQ_NONE;
 
 	raw_spin_lock(&le->oob_state.wait.wchan.lock);
@@ -2060,21 +2455,34 @@ static __poll_t lineevent_oob_poll(struct file *file,
 	return ready;
 }
 
+/*
+ * Pull as many events as the user buffer can hold from the ring,
+ * waiting for the first one unless O_NONBLOCK is set. This way, an
+ * oob thread monitoring a busy line (e.g. an encoder) can drain the
+ * backlog in a single call.
+ */
 static ssize_t lineevent_oob_read(struct file *file,
 				char __user *buf,
 				size_t count)
 {
 	struct lineevent_state *le = file->private_data;
 	struct gpioevent_data ge = { 0 };
+	ssize_t bytes_read = 0;
 	unsigned long flags;
+	ssize_t ge_size;
 	int ret;
 
-	if (count < sizeof(struct gpioevent_data))
-		return -EINVAL;
-
 	if (!oob_handling_requested(le->lflags))
 		return -EPERM;
 
+	/* Same as lineevent_read(). */
+	if (compat_need_64bit_alignment_fixup())
+		ge_size = sizeof(struct compat_gpioeevent_data);
+	else
+		ge_size = sizeof(struct gpioevent_data);
+	if (count < ge_size)
+		return -EINVAL;
+
 	do {
 		raw_spin_lock_irqsave(&le->oob_state.wait.wchan.lock, flags);
 
@@ -2089,18 +2497,25 @@ static ssize_t lineevent_oob_read(struct file *file,
 		raw_spin_unlock_irqrestore(&le->oob_state.wait.wchan.lock, flags);
 
 		if (ret) {
-			ret = raw_copy_to_user(buf, &ge, sizeof(ge));
-			return ret ? -EFAULT : sizeof(ge);
+			if (raw_copy_to_user(buf + bytes_read, &ge, ge_size))
+				return -EFAULT;
+			bytes_read += ge_size;
+			continue;
 		}
 
+		if (bytes_read)
+			break;
+
 		if (file->f_flags & O_NONBLOCK)
 			return -EAGAIN;
 
 		ret = evl_wait_event(&le->oob_state.wait,
  				!kfifo_is_empty(&le->events));
-	} while (!ret);
+		if (ret)
+			return ret;
+	} while (count >= bytes_read + ge_size);
 
-	return ret;
+	return bytes_read;
 }
 
 static int lineevent_init_oob_state(struct lineevent_state *le,
@@ -2358,7 +2773,8 @@ static int lineevent_create(struct gpio_device *gdev, void __user *ip)
 	}
 
 	if (oob_handling_requested(lflags)) {
-		if (desc->gdev->chip->can_sleep)
+		if (desc->gdev->chip->can_sleep ||
+			desc->gdev->chip->ngpio > CONFIG_GPIOLIB_FASTPATH_LIMIT)
 			ret = -EOPNOTSUPP;
 		else
 			ret = lineevent_init_oob_state(le, irq, label, irqflags);
@@ -0,0 +1,458 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/poll.h>
+#include <linux/mutex.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+
+#include <linux/iio/iio.h>
+#include <linux/iio/sysfs.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/buffer_impl.h>
+#include <linux/iio/buffer-oob.h>
+
+#include <evl/clock.h>
+#include <evl/timer.h>
+#include <evl/wait.h>
+#include <evl/poll.h>
+#include <uapi/evl/devices/iio.h>
+
+/*
+ * The IIO oob buffer captures fixed-size sample blocks without any
+ * help from the in-band stage. Each pulse, either from an EVL timer
+ * or from the oob handler of some hardware trigger, re-runs a single
+ * DMA_OOB_PULSE transfer into a coherent landing block, which the
+ * oob completion handler copies to the next slot of a ring user
+ * space may map. EVL threads wait for new blocks on the buffer fd
+ * via oob_read() or oob_poll().
+ */
+
+struct iio_oob_buffer {
+	struct iio_buffer buffer;
+	struct iio_dev *indio_dev;
+	const struct iio_oob_buffer_ops *ops;
+	struct dma_chan *chan;
+	size_t block_size;
+	unsigned int nr_blocks;
+	void *dma_vaddr;
+	dma_addr_t dma_addr;
+	struct iio_oob_ring *ring;
+	size_t ring_size;
+	void *data;
+	u32 tail;
+	u64 period_ns;
+	bool running;
+	struct mutex lock;
+	struct evl_timer timer;
+	struct evl_wait_queue wait;
+	struct evl_poll_head poll_head;
+};
+
+static inline
+struct iio_oob_buffer *to_oob_buffer(struct iio_buffer *buffer)
+{
+	return container_of(buffer, struct iio_oob_buffer, buffer);
+}
+
+static inline void *get_block(struct iio_oob_buffer *ob, u32 seq)
+{
+	return ob->data + (seq & (ob->nr_blocks - 1)) * ob->block_size;
+}
+
+static void capture_done(void *arg) /* oob stage, hardirqs off */
+{
+	struct iio_oob_buffer *ob = arg;
+	struct iio_oob_ring *ring = ob->ring;
+	u32 head = ring->head;
+
+	memcpy(get_block(ob, head), ob->dma_vaddr, ob->block_size);
+	ring->timestamps[head & (ob->nr_blocks - 1)] =
+		ktime_to_ns(evl_read_clock(&evl_mono_clock));
+	smp_store_release(&ring->head, head + 1);
+
+	raw_spin_lock(&ob->wait.wchan.lock);
+	evl_flush_wait_locked(&ob->wait, 0);
+	evl_signal_poll_events(&ob->poll_head, POLLIN|POLLRDNORM);
+	raw_spin_unlock(&ob->wait.wchan.lock);
+}
+
+static void pulse_capture(struct iio_oob_buffer *ob)
+{
+	if (ob->ops && ob->ops->start)
+		ob->ops->start(ob->indio_dev);
+
+	dma_pulse_oob(ob->chan);
+}
+
+static void capture_timer_handler(struct evl_timer *timer) /* hard irqs off */
+{
+	struct iio_oob_buffer *ob =
+		container_of(timer, struct iio_oob_buffer, timer);
+
+	pulse_capture(ob);
+}
+
+/**
+ * iio_oob_buffer_pulse() - Capture the next block
+ * @buffer: The oob buffer
+ *
+ * For buffers running with a zero oob_period_ns, i.e. paced by some
+ * hardware event. Call from the oob stage, typically from the
+ * IRQF_OOB handler of that event.
+ */
+void iio_oob_buffer_pulse(struct iio_buffer *buffer)
+{
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+
+	if (READ_ONCE(ob->running))
+		pulse_capture(ob);
+}
+EXPORT_SYMBOL_GPL(iio_oob_buffer_pulse);
+
+static int iio_oob_buffer_enable(struct iio_buffer *buffer,
+				 struct iio_dev *indio_dev)
+{
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+	struct dma_async_tx_descriptor *desc;
+	dma_cookie_t cookie;
+	int ret;
+
+	guard(mutex)(&ob->lock);
+
+	desc = dmaengine_prep_slave_single(ob->chan, ob->dma_addr,
+					ob->block_size, DMA_DEV_TO_MEM,
+					DMA_OOB_INTERRUPT|DMA_OOB_PULSE);
+	if (!desc)
+		return -EIO;
+
+	desc->callback = capture_done;
+	desc->callback_param = ob;
+
+	cookie = dmaengine_submit(desc);
+	ret = dma_submit_error(cookie);
+	if (ret) {
+		dmaengine_terminate_sync(ob->chan);
+		return ret;
+	}
+
+	ob->tail = READ_ONCE(ob->ring->head);
+	WRITE_ONCE(ob->running, true);
+	dma_async_issue_pending(ob->chan);
+
+	if (ob->period_ns)
+		evl_start_timer(&ob->timer,
+				evl_abs_timeout(&ob->timer,
+						ns_to_ktime(ob->period_ns)),
+				ns_to_ktime(ob->period_ns));
+
+	return 0;
+}
+
+static int iio_oob_buffer_disable(struct iio_buffer *buffer,
+				  struct iio_dev *indio_dev)
+{
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+
+	guard(mutex)(&ob->lock);
+
+	WRITE_ONCE(ob->running, false);
+	evl_stop_timer(&ob->timer);
+	dmaengine_terminate_sync(ob->chan);
+	evl_flush_wait(&ob->wait, 0);
+	evl_signal_poll_events(&ob->poll_head, POLLERR);
+
+	return 0;
+}
+
+static inline bool block_ready(struct iio_oob_buffer *ob)
+{
+	return READ_ONCE(ob->ring->head) != ob->tail ||
+		!READ_ONCE(ob->running);
+}
+
+/*
+ * Fetch the next block, or the oldest one we may still copy safely
+ * if the reader was lagging. Only a single reader may exist, since
+ * the buffer fd cannot be opened twice.
+ */
+static ssize_t iio_oob_buffer_read(struct iio_buffer *buffer,
+				   struct file *filp,
+				   char __user *buf, size_t n)
+{
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+	struct iio_oob_ring *ring = ob->ring;
+	u32 head, seq;
+	int ret;
+
+	if (n < ob->block_size)
+		return -EINVAL;
+
+	if (!(filp->f_flags & O_NONBLOCK)) {
+		ret = evl_wait_event(&ob->wait, block_ready(ob));
+		if (ret)
+			return ret;
+	}
+
+	for (;;) {
+		head = smp_load_acquire(&ring->head);
+		seq = ob->tail;
+		if (head == seq)
+			return READ_ONCE(ob->running) ? -EAGAIN : -EIO;
+
+		if (head - seq >= ob->nr_blocks) {
+			ring->overruns += head - seq - ob->nr_blocks + 1;
+			seq = head - ob->nr_blocks + 1;
+		}
+
+		if (raw_copy_to_user(buf, get_block(ob, seq), ob->block_size))
+			return -EFAULT;
+
+		/* Make sure the slot was not recycled under our feet. */
+		smp_rmb();
+		if (READ_ONCE(ring->head) - seq < ob->nr_blocks)
+			break;
+
+		ob->tail = seq + 1;
+		ring->overruns++;
+	}
+
+	ob->tail = seq + 1;
+
+	return ob->block_size;
+}
+
+static __poll_t iio_oob_buffer_poll(struct iio_buffer *buffer,
+				    struct oob_poll_wait *wait)
+{
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+
+	evl_poll_watch(&ob->poll_head, wait, NULL);
+
+	if (READ_ONCE(ob->ring->head) != ob->tail)
+		return POLLIN|POLLRDNORM;
+
+	return READ_ONCE(ob->running) ? 0 : POLLERR;
+}
+
+static int iio_oob_buffer_mmap(struct iio_buffer *buffer,
+			       struct vm_area_struct *vma)
+{
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+
+	/* Readers may not scribble over the ring. */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	return remap_vmalloc_range(vma, ob->ring, vma->vm_pgoff);
+}
+
+static void iio_oob_buffer_release(struct iio_buffer *buffer)
+{
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+
+	evl_destroy_timer(&ob->timer);
+	evl_destroy_wait(&ob->wait);
+	dma_free_coherent(ob->chan->device->dev, ob->block_size,
+			ob->dma_vaddr, ob->dma_addr);
+	vfree(ob->ring);
+	mutex_destroy(&ob->lock);
+	kfree(ob);
+}
+
+static const struct iio_buffer_access_funcs iio_oob_buffer_access = {
+	.enable = iio_oob_buffer_enable,
+	.disable = iio_oob_buffer_disable,
+	.release = iio_oob_buffer_release,
+	.oob_read = iio_oob_buffer_read,
+	.oob_poll = iio_oob_buffer_poll,
+	.mmap = iio_oob_buffer_mmap,
+	.modes = INDIO_BUFFER_HARDWARE,
+	.flags = INDIO_BUFFER_FLAG_FIXED_WATERMARK | INDIO_BUFFER_FLAG_OOB,
+};
+
+static ssize_t oob_period_ns_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct iio_buffer *buffer = to_iio_dev_attr(attr)->buffer;
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+
+	return sysfs_emit(buf, "%llu\n", READ_ONCE(ob->period_ns));
+}
+
+static ssize_t oob_period_ns_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t len)
+{
+	struct iio_buffer *buffer = to_iio_dev_attr(attr)->buffer;
+	struct iio_oob_buffer *ob = to_oob_buffer(buffer);
+	u64 period;
+	int ret;
+
+	ret = kstrtou64(buf, 0, &period);
+	if (ret)
+		return ret;
+
+	guard(mutex)(&ob->lock);
+
+	if (ob->running)
+		return -EBUSY;
+
+	WRITE_ONCE(ob->period_ns, period);
+
+	return len;
+}
+
+static IIO_DEVICE_ATTR_RW(oob_period_ns, 0);
+
+static ssize_t oob_block_size_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct iio_buffer *buffer = to_iio_dev_attr(attr)->buffer;
+
+	return sysfs_emit(buf, "%zu\n", to_oob_buffer(buffer)->block_size);
+}
+
+static IIO_DEVICE_ATTR_RO(oob_block_size, 0);
+
+static const struct iio_dev_attr *iio_oob_buffer_attrs[] = {
+	&iio_dev_attr_oob_period_ns,
+	&iio_dev_attr_oob_block_size,
+	NULL,
+};
+
+static int alloc_ring(struct iio_oob_buffer *ob)
+{
+	size_t hdr_size, data_size;
+
+	hdr_size = PAGE_ALIGN(struct_size(ob->ring, timestamps, ob->nr_blocks));
+	data_size = PAGE_ALIGN(ob->nr_blocks * ob->block_size);
+	ob->ring_size = hdr_size + data_size;
+	ob->ring = vmalloc_user(ob->ring_size);
+	if (!ob->ring)
+		return -ENOMEM;
+
+	ob->ring->nr_blocks = ob->nr_blocks;
+	ob->ring->block_size = ob->block_size;
+	ob->ring->data_offset = hdr_size;
+	ob->data = (void *)ob->ring + hdr_size;
+
+	return 0;
+}
+
+static struct iio_buffer *iio_oob_buffer_alloc(struct iio_dev *indio_dev,
+					struct dma_chan *chan,
+					size_t block_size,
+					unsigned int nr_blocks,
+					const struct iio_oob_buffer_ops *ops)
+{
+	struct iio_oob_buffer *ob;
+	int ret;
+
+	if (!block_size || !nr_blocks)
+		return ERR_PTR(-EINVAL);
+
+	ob = kzalloc(sizeof(*ob), GFP_KERNEL);
+	if (!ob)
+		return ERR_PTR(-ENOMEM);
+
+	ob->indio_dev = indio_dev;
+	ob->ops = ops;
+	ob->chan = chan;
+	ob->block_size = block_size;
+	ob->nr_blocks = roundup_pow_of_two(nr_blocks);
+
+	ret = alloc_ring(ob);
+	if (ret)
+		goto err_free;
+
+	ob->dma_vaddr = dma_alloc_coherent(chan->device->dev, block_size,
+					&ob->dma_addr, GFP_KERNEL);
+	if (!ob->dma_vaddr) {
+		ret = -ENOMEM;
+		goto err_free_ring;
+	}
+
+	mutex_init(&ob->lock);
+	evl_init_timer(&ob->timer, capture_timer_handler);
+	evl_init_wait(&ob->wait, &evl_mono_clock, EVL_WAIT_PRIO);
+	evl_init_poll_head(&ob->poll_head);
+
+	iio_buffer_init(&ob->buffer);
+	ob->buffer.access = &iio_oob_buffer_access;
+	ob->buffer.attrs = iio_oob_buffer_attrs;
+	ob->buffer.direction = IIO_BUFFER_DIRECTION_IN;
+
+	return &ob->buffer;
+
+err_free_ring:
+	vfree(ob->ring);
+err_free:
+	kfree(ob);
+
+	return ERR_PTR(ret);
+}
+
+static void __devm_iio_oob_buffer_free(void *buffer)
+{
+	iio_buffer_put(buffer);
+}
+
+/**
+ * devm_iio_oob_buffer_setup() - Setup an oob capture buffer
+ * @dev: Device for devm ownership
+ * @indio_dev: IIO device to which to attach this buffer.
+ * @chan: DMA channel to the converter, configured by the caller
+ *	which keeps ownership of it. Its dmaengine driver must support
+ *	DMA_OOB_PULSE transfers.
+ * @block_size: Number of bytes captured by each pulse.
+ * @nr_blocks: Depth of the capture ring, rounded up to a power of two.
+ * @ops: Optional hooks, may be NULL.
+ *
+ * This allocates an oob capture buffer and attaches it to an IIO
+ * device with iio_device_attach_buffer(). It also appends the
+ * INDIO_BUFFER_HARDWARE mode to the supported modes of the IIO
+ * device. Capture is paced by an EVL timer every oob_period_ns, or
+ * by calls to iio_oob_buffer_pulse() if that period is zero.
+ */
+struct iio_buffer *devm_iio_oob_buffer_setup(struct device *dev,
+					struct iio_dev *indio_dev,
+					struct dma_chan *chan,
+					size_t block_size,
+					unsigned int nr_blocks,
+					const struct iio_oob_buffer_ops *ops)
+{
+	struct iio_buffer *buffer;
+	int ret;
+
+	buffer = iio_oob_buffer_alloc(indio_dev, chan, block_size,
+				nr_blocks, ops);
+	if (IS_ERR(buffer))
+		return buffer;
+
+	indio_dev->modes |= INDIO_BUFFER_HARDWARE;
+
+	ret = iio_device_attach_buffer(indio_dev, buffer);
+	if (ret) {
+		iio_buffer_put(buffer);
+		return ERR_PTR(ret);
+	}
+
+	ret = devm_add_action_or_reset(dev, __devm_iio_oob_buffer_free,
+				buffer);
+	if (ret)
+		return ERR_PTR(ret);
+
+	return buffer;
+}
+EXPORT_SYMBOL_GPL(devm_iio_oob_buffer_setup);
+
+MODULE_DESCRIPTION("Out-of-band DMA capture buffer for the IIO framework");
+MODULE_LICENSE("GPL");
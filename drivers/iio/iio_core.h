@@ -11,6 +11,7 @@
 #define _IIO_CORE_H_
 #include <linux/kernel.h>
 #include <linux/device.h>
+#include <evl/file.h>
 
 struct iio_buffer;
 struct iio_chan_spec;
@@ -21,6 +22,9 @@ extern const struct device_type iio_device_type;
 struct iio_dev_buffer_pair {
 	struct iio_dev		*indio_dev;
 	struct iio_buffer	*buffer;
+#if IS_ENABLED(CONFIG_IIO_BUFFER_OOB)
+	struct evl_file		efile;
+#endif
 };
 
 #define IIO_IOCTL_UNHANDLED	1
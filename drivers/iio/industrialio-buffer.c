@@ -295,6 +295,76 @@ static __poll_t iio_buffer_poll(struct file *filp,
 	return 0;
 }
 
+#if IS_ENABLED(CONFIG_IIO_BUFFER_OOB)
+
+static ssize_t iio_buffer_oob_read(struct file *filp, char __user *buf,
+				   size_t n)
+{
+	struct iio_dev_buffer_pair *ib = filp->private_data;
+	struct iio_buffer *rb = ib->buffer;
+
+	if (!rb->access->oob_read)
+		return -EINVAL;
+
+	return rb->access->oob_read(rb, filp, buf, n);
+}
+
+static __poll_t iio_buffer_oob_poll(struct file *filp,
+				    struct oob_poll_wait *wait)
+{
+	struct iio_dev_buffer_pair *ib = filp->private_data;
+	struct iio_buffer *rb = ib->buffer;
+
+	if (!rb->access->oob_poll)
+		return POLLERR;
+
+	return rb->access->oob_poll(rb, wait);
+}
+
+static int iio_buffer_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct iio_dev_buffer_pair *ib = filp->private_data;
+	struct iio_buffer *rb = ib->buffer;
+
+	if (!rb->access->mmap)
+		return -ENODEV;
+
+	return rb->access->mmap(rb, vma);
+}
+
+static inline bool iio_buffer_is_oob(struct iio_buffer *buffer)
+{
+	return buffer->access->flags & INDIO_BUFFER_FLAG_OOB;
+}
+
+static int iio_buffer_open_oob(struct iio_dev_buffer_pair *ib,
+			       struct file *filp)
+{
+	if (!iio_buffer_is_oob(ib->buffer))
+		return 0;
+
+	return evl_open_file(&ib->efile, filp);
+}
+
+static void iio_buffer_release_oob(struct iio_dev_buffer_pair *ib)
+{
+	if (iio_buffer_is_oob(ib->buffer))
+		evl_release_file(&ib->efile);
+}
+
+#else
+
+static inline int iio_buffer_open_oob(struct iio_dev_buffer_pair *ib,
+				      struct file *filp)
+{
+	return 0;
+}
+
+static inline void iio_buffer_release_oob(struct iio_dev_buffer_pair *ib)
+{ }
+
+#endif
+
 ssize_t iio_buffer_read_wrapper(struct file *filp, char __user *buf,
 				size_t n, loff_t *f_ps)
 {
@@ -1597,6 +1667,8 @@ static int iio_buffer_chrdev_release(struct inode *inode, struct file *filep)
 
 	wake_up(&buffer->pollq);
 
+	iio_buffer_release_oob(ib);
+
 	guard(mutex)(&buffer->dmabufs_mutex);
 
 	/* Close all attached DMABUFs */
@@ -2001,6 +2073,11 @@ static const struct file_operations iio_buffer_chrdev_fileops = {
 	.compat_ioctl = compat_ptr_ioctl,
 	.poll = iio_buffer_poll,
 	.release = iio_buffer_chrdev_release,
+#if IS_ENABLED(CONFIG_IIO_BUFFER_OOB)
+	.oob_read = iio_buffer_oob_read,
+	.oob_poll = iio_buffer_oob_poll,
+	.mmap = iio_buffer_mmap,
+#endif
 };
 
 static long iio_device_buffer_getfd(struct iio_dev *indio_dev, unsigned long arg)
@@ -2009,6 +2086,7 @@ static long iio_device_buffer_getfd(struct iio_dev *indio_dev, unsigned long arg
 	int __user *ival = (int __user *)arg;
 	struct iio_dev_buffer_pair *ib;
 	struct iio_buffer *buffer;
+	struct file *file;
 	int fd, idx, ret;
 
 	if (copy_from_user(&idx, ival, sizeof(idx)))
@@ -2035,29 +2113,47 @@ static long iio_device_buffer_getfd(struct iio_dev *indio_dev, unsigned long arg
 	ib->indio_dev = indio_dev;
 	ib->buffer = buffer;
 
-	fd = anon_inode_getfd("iio:buffer", &iio_buffer_chrdev_fileops,
-			      ib, O_RDWR | O_CLOEXEC);
+	fd = get_unused_fd_flags(O_CLOEXEC);
 	if (fd < 0) {
 		ret = fd;
 		goto error_free_ib;
 	}
 
+	file = anon_inode_getfile("iio:buffer", &iio_buffer_chrdev_fileops,
+				  ib, O_RDWR | O_CLOEXEC);
+	if (IS_ERR(file)) {
+		ret = PTR_ERR(file);
+		goto error_put_fd;
+	}
+
+	/*
+	 * Oob buffers must be known from the EVL core before the fd
+	 * becomes reachable from userland.
+	 */
+	ret = iio_buffer_open_oob(ib, file);
+	if (ret) {
+		fput(file);
+		put_unused_fd(fd);
+		return ret;
+	}
+
 	if (copy_to_user(ival, &fd, sizeof(fd))) {
 		/*
-		 * "Leak" the fd, as there's not much we can do about this
-		 * anyway. 'fd' might have been closed already, as
-		 * anon_inode_getfd() called fd_install() on it, which made
-		 * it reachable by userland.
-		 *
-		 * Instead of allowing a malicious user to play tricks with
-		 * us, rely on the process exit path to do any necessary
-		 * cleanup, as in releasing the file, if still needed.
+		 * fput() will trigger the release() callback, which
+		 * drops the resources we hold, so do not go onto the
+		 * regular error cleanup path here.
 		 */
+		fput(file);
+		put_unused_fd(fd);
 		return -EFAULT;
 	}
 
+	fd_install(fd, file);
+
 	return 0;
 
+error_put_fd:
+	put_unused_fd(fd);
 error_free_ib:
 	kfree(ib);
 error_clear_busy_bit:
@@ -23,6 +23,7 @@
 #include <linux/pinctrl/consumer.h>
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
+#include <net/page_pool/helpers.h>
 
 #include "m_can.h"
 
@@ -462,7 +463,9 @@ static void m_can_coalescing_disable(struct m_can_classdev *cdev)
 	if (!cdev->net->irq)
 		return;
 
-	hrtimer_cancel(&cdev->hrtimer);
+	/* Coalescing is never armed for oob-capable devices. */
+	if (!net_running_oob())
+		hrtimer_cancel(&cdev->hrtimer);
 	m_can_interrupt_enable(cdev, new_interrupts);
 }
 
@@ -504,6 +507,212 @@ static u32 m_can_get_timestamp(struct m_can_classdev *cdev)
 	return (tsc << 16);
 }
 
+#ifdef CONFIG_NET_OOB
+
+/* Peripherals and v3.0 cores (single TX buffer) stay in-band. */
+static inline bool m_can_oob_capable(struct m_can_classdev *cdev)
+{
+	return !cdev->is_peripheral && cdev->net->irq && cdev->version > 30;
+}
+
+static inline unsigned long m_can_irqflags(struct m_can_classdev *cdev)
+{
+	/* An oob interrupt cannot be shared with in-band handlers. */
+	return cdev->oob_mode ? IRQF_OOB : IRQF_SHARED;
+}
+
+/*
+ * The timestamp of frames received from the oob stage is converted
+ * to CLOCK_MONOTONIC, which is best done at the finest resolution.
+ * The counter then wraps after 2^16 nominal bit times, which leaves
+ * enough time for converting the frames we pull from the RX FIFO.
+ * Non-peripheral devices have no other use of the timestamp.
+ */
+static u32 m_can_ts_prescaler(struct m_can_classdev *cdev)
+{
+	u32 prescaler = m_can_oob_capable(cdev) ? 1 : 16;
+
+	cdev->ts_tick_ns = div_u64((u64)prescaler * NSEC_PER_SEC,
+				   cdev->can.bittiming.bitrate);
+
+	return prescaler;
+}
+
+/*
+ * M_CAN has no PTP clock, age the RX timestamp against the current
+ * value of the counter instead.
+ */
+static void m_can_oob_rx_timestamp(struct m_can_classdev *cdev,
+				   struct sk_buff *skb, u32 rxts)
+{
+	u64 now = ktime_get_mono_fast_ns();
+	u16 tsc;
+
+	tsc = FIELD_GET(TSCV_TSC_MASK, m_can_read(cdev, M_CAN_TSCV));
+	skb_hwtstamps(skb)->hwtstamp =
+		ns_to_ktime(now - (u64)(u16)(tsc - rxts) * cdev->ts_tick_ns);
+}
+
+/*
+ * Build a frame around a page from the RX pool, which the oob stage
+ * can draw from. This mirrors alloc_can_skb() and alloc_canfd_skb().
+ */
+static struct sk_buff *m_can_alloc_oob_skb(struct m_can_classdev *cdev,
+					   bool fd, struct canfd_frame **cf)
+{
+	struct net_device *dev = cdev->net;
+	struct sk_buff *skb;
+	struct page *page;
+
+	page = page_pool_dev_alloc_pages(cdev->rx_pool);
+	if (!page)
+		return NULL;
+
+	skb = napi_build_skb(page_address(page), PAGE_SIZE);
+	if (!skb) {
+		page_pool_put_full_page(cdev->rx_pool, page, false);
+		return NULL;
+	}
+
+	skb_mark_for_recycle(skb);
+	skb_reserve(skb, NET_SKB_PAD);
+	skb->dev = dev;
+	skb->protocol = htons(fd ? ETH_P_CANFD : ETH_P_CAN);
+	skb->pkt_type = PACKET_BROADCAST;
+	skb->ip_summed = CHECKSUM_UNNECESSARY;
+	skb_reset_mac_header(skb);
+	skb_reset_network_header(skb);
+	skb_reset_transport_header(skb);
+	can_skb_reserve(skb);
+	can_skb_prv(skb)->ifindex = dev->ifindex;
+	can_skb_prv(skb)->skbcnt = 0;
+
+	if (fd) {
+		*cf = skb_put_zero(skb, sizeof(struct canfd_frame));
+		(*cf)->flags = CANFD_FDF;
+	} else {
+		*cf = skb_put_zero(skb, sizeof(struct can_frame));
+	}
+
+	return skb;
+}
+
+/*
+ * Error frames are allocated from the in-band heap and delivered to
+ * the in-band stack, leave error handling to the relay.
+ */
+static void m_can_oob_defer_errors(struct m_can_classdev *cdev, u32 irqstatus)
+{
+	atomic_or(irqstatus, &cdev->oob_irqstatus);
+	irq_work_queue(&cdev->oob_relay);
+}
+
+/* Frames sent from the oob stage have no echo skb. */
+static inline void m_can_oob_mark_tx(struct m_can_classdev *cdev, u32 putidx)
+{
+	set_bit(putidx, &cdev->oob_tx_mask);
+}
+
+static inline bool m_can_oob_tx_done(struct m_can_classdev *cdev,
+				     unsigned int msg_mark)
+{
+	return test_and_clear_bit(msg_mark, &cdev->oob_tx_mask);
+}
+
+/* Echoing an in-band frame from the oob stage is left to the relay. */
+static inline void m_can_oob_relay_echo(struct m_can_classdev *cdev,
+					unsigned int msg_mark)
+{
+	set_bit(msg_mark, &cdev->oob_echo_pending);
+	irq_work_queue(&cdev->oob_relay);
+}
+
+/* Release the FIFO elements of frames sent from the oob stage. */
+static void m_can_oob_tx_retire(struct m_can_classdev *cdev, int count)
+{
+	unsigned long irqflags;
+	bool wake;
+
+	raw_spin_lock_irqsave(&cdev->tx_handling_spinlock, irqflags);
+	wake = cdev->tx_fifo_in_flight >= cdev->tx_fifo_size;
+	cdev->tx_fifo_in_flight -= count;
+	raw_spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
+
+	if (!wake)
+		return;
+
+	if (net_running_oob()) {
+		atomic_set(&cdev->oob_tx_wake, 1);
+		irq_work_queue(&cdev->oob_relay);
+	} else {
+		netif_wake_queue(cdev->net);
+	}
+}
+
+static inline void m_can_oob_clean(struct m_can_classdev *cdev)
+{
+	cdev->oob_tx_mask = 0;
+	cdev->oob_echo_pending = 0;
+}
+
+#else
+
+static inline bool m_can_oob_capable(struct m_can_classdev *cdev)
+{
+	return false;
+}
+
+static inline unsigned long m_can_irqflags(struct m_can_classdev *cdev)
+{
+	return IRQF_SHARED;
+}
+
+static inline u32 m_can_ts_prescaler(struct m_can_classdev *cdev)
+{
+	return 16;
+}
+
+static inline void m_can_oob_rx_timestamp(struct m_can_classdev *cdev,
+					  struct sk_buff *skb, u32 rxts)
+{
+}
+
+static inline struct sk_buff *m_can_alloc_oob_skb(struct m_can_classdev *cdev,
+						  bool fd, struct canfd_frame **cf)
+{
+	return NULL;
+}
+
+static inline void m_can_oob_defer_errors(struct m_can_classdev *cdev,
+					  u32 irqstatus)
+{
+}
+
+static inline void m_can_oob_mark_tx(struct m_can_classdev *cdev, u32 putidx)
+{
+}
+
+static inline bool m_can_oob_tx_done(struct m_can_classdev *cdev,
+				     unsigned int msg_mark)
+{
+	return false;
+}
+
+static inline void m_can_oob_relay_echo(struct m_can_classdev *cdev,
+					unsigned int msg_mark)
+{
+}
+
+static inline void m_can_oob_tx_retire(struct m_can_classdev *cdev, int count)
+{
+}
+
+static inline void m_can_oob_clean(struct m_can_classdev *cdev)
+{
+}
+
+#endif	/* CONFIG_NET_OOB */
+
 static void m_can_clean(struct net_device *net)
 {
 	struct m_can_classdev *cdev = netdev_priv(net);
@@ -524,9 +733,10 @@ static void m_can_clean(struct net_device *net)
 
 	netdev_reset_queue(cdev->net);
 
-	spin_lock_irqsave(&cdev->tx_handling_spinlock, irqflags);
+	raw_spin_lock_irqsave(&cdev->tx_handling_spinlock, irqflags);
 	cdev->tx_fifo_in_flight = 0;
-	spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
+	m_can_oob_clean(cdev);
+	raw_spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
 }
 
 /* For peripherals, pass skb to rx-offload, which will push skb from
@@ -565,7 +775,9 @@ static int m_can_read_fifo(struct net_device *dev, u32 fgi)
 	if (err)
 		goto out_fail;
 
-	if (fifo_header.dlc & RX_BUF_FDF)
+	if (net_running_oob())
+		skb = m_can_alloc_oob_skb(cdev, fifo_header.dlc & RX_BUF_FDF, &cf);
+	else if (fifo_header.dlc & RX_BUF_FDF)
 		skb = alloc_canfd_skb(dev, &cf);
 	else
 		skb = alloc_can_skb(dev, (struct can_frame **)&cf);
@@ -606,12 +818,16 @@ static int m_can_read_fifo(struct net_device *dev, u32 fgi)
 
 	timestamp = FIELD_GET(RX_BUF_RXTS_MASK, fifo_header.dlc) << 16;
 
+	if (net_running_oob())
+		m_can_oob_rx_timestamp(cdev, skb,
+				       FIELD_GET(RX_BUF_RXTS_MASK, fifo_header.dlc));
+
 	m_can_receive_skb(cdev, skb, timestamp);
 
 	return 0;
 
 out_free_skb:
-	kfree_skb(skb);
+	dev_kfree_skb_any(skb);
 out_fail:
 	netdev_err(dev, "FIFO read returned %d\n", err);
 	return err;
@@ -1030,6 +1246,11 @@ static int m_can_rx_handler(struct net_device *dev, int quota, u32 irqstatus)
 		}
 	}
 
+	if (net_running_oob() && (irqstatus & (IR_ERR_STATE | IR_ERR_BUS_30X))) {
+		m_can_oob_defer_errors(cdev, irqstatus);
+		irqstatus &= ~(IR_ERR_STATE | IR_ERR_BUS_30X);
+	}
+
 	if (irqstatus & IR_ERR_STATE)
 		work_done += m_can_handle_state_errors(dev,
 						       m_can_read(cdev, M_CAN_PSR));
@@ -1103,11 +1324,11 @@ static void m_can_finish_tx(struct m_can_classdev *cdev, int transmitted,
 
 	netdev_completed_queue(cdev->net, transmitted, transmitted_frame_len);
 
-	spin_lock_irqsave(&cdev->tx_handling_spinlock, irqflags);
+	raw_spin_lock_irqsave(&cdev->tx_handling_spinlock, irqflags);
 	if (cdev->tx_fifo_in_flight >= cdev->tx_fifo_size && transmitted > 0)
 		netif_wake_queue(cdev->net);
 	cdev->tx_fifo_in_flight -= transmitted;
-	spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
+	raw_spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
 }
 
 static netdev_tx_t m_can_start_tx(struct m_can_classdev *cdev)
@@ -1115,18 +1336,18 @@ static netdev_tx_t m_can_start_tx(struct m_can_classdev *cdev)
 	unsigned long irqflags;
 	int tx_fifo_in_flight;
 
-	spin_lock_irqsave(&cdev->tx_handling_spinlock, irqflags);
+	raw_spin_lock_irqsave(&cdev->tx_handling_spinlock, irqflags);
 	tx_fifo_in_flight = cdev->tx_fifo_in_flight + 1;
 	if (tx_fifo_in_flight >= cdev->tx_fifo_size) {
 		netif_stop_queue(cdev->net);
 		if (tx_fifo_in_flight > cdev->tx_fifo_size) {
 			netdev_err_once(cdev->net, "hard_xmit called while TX FIFO full\n");
-			spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
+			raw_spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
 			return NETDEV_TX_BUSY;
 		}
 	}
 	cdev->tx_fifo_in_flight = tx_fifo_in_flight;
-	spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
+	raw_spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
 
 	return NETDEV_TX_OK;
 }
@@ -1142,6 +1363,7 @@ static int m_can_echo_tx_event(struct net_device *dev)
 	unsigned int msg_mark;
 	int processed = 0;
 	unsigned int processed_frame_len = 0;
+	int oob_processed = 0;
 
 	struct m_can_classdev *cdev = netdev_priv(dev);
 
@@ -1169,6 +1391,16 @@ static int m_can_echo_tx_event(struct net_device *dev)
 		ack_fgi = fgi;
 		fgi = (++fgi >= cdev->mcfg[MRAM_TXE].num ? 0 : fgi);
 
+		if (m_can_oob_tx_done(cdev, msg_mark)) {
+			++oob_processed;
+			continue;
+		}
+
+		if (net_running_oob()) {
+			m_can_oob_relay_echo(cdev, msg_mark);
+			continue;
+		}
+
 		/* update stats */
 		processed_frame_len += m_can_tx_update_stats(cdev, msg_mark,
 							     timestamp);
@@ -1180,7 +1412,11 @@ static int m_can_echo_tx_event(struct net_device *dev)
 		m_can_write(cdev, M_CAN_TXEFA, FIELD_PREP(TXEFA_EFAI_MASK,
 							  ack_fgi));
 
-	m_can_finish_tx(cdev, processed, processed_frame_len);
+	if (oob_processed)
+		m_can_oob_tx_retire(cdev, oob_processed);
+
+	if (processed)
+		m_can_finish_tx(cdev, processed, processed_frame_len);
 
 	return err;
 }
@@ -1576,11 +1812,12 @@ static int m_can_chip_config(struct net_device *dev)
 	/* set bittiming params */
 	m_can_set_bittiming(dev);
 
-	/* enable internal timestamp generation, with a prescaler of 16. The
-	 * prescaler is applied to the nominal bit timing
+	/* enable internal timestamp generation, with a prescaler of 16, or 1
+	 * for oob-capable devices. The prescaler is applied to the nominal
+	 * bit timing
 	 */
 	m_can_write(cdev, M_CAN_TSCC,
-		    FIELD_PREP(TSCC_TCP_MASK, 0xf) |
+		    FIELD_PREP(TSCC_TCP_MASK, m_can_ts_prescaler(cdev) - 1) |
 		    FIELD_PREP(TSCC_TSS_MASK, TSCC_TSS_INTERNAL));
 
 	err = m_can_config_disable(cdev);
@@ -1794,6 +2031,9 @@ static void m_can_stop(struct net_device *dev)
 	}
 }
 
+static void m_can_oob_sync(struct m_can_classdev *cdev);
+static void m_can_destroy_rx_pool(struct m_can_classdev *cdev);
+
 static int m_can_close(struct net_device *dev)
 {
 	struct m_can_classdev *cdev = netdev_priv(dev);
@@ -1804,6 +2044,7 @@ static int m_can_close(struct net_device *dev)
 	if (dev->irq)
 		free_irq(dev->irq, dev);
 
+	m_can_oob_sync(cdev);
 	m_can_clean(dev);
 
 	if (cdev->is_peripheral) {
@@ -1814,6 +2055,8 @@ static int m_can_close(struct net_device *dev)
 		napi_disable(&cdev->napi);
 	}
 
+	m_can_destroy_rx_pool(cdev);
+
 	close_candev(dev);
 
 	m_can_clk_stop(cdev);
@@ -1916,7 +2159,10 @@ static netdev_tx_t m_can_tx_handler(struct m_can_classdev *cdev,
 		/* Push loopback echo.
 		 * Will be looped back on TX interrupt based on message marker
 		 */
-		can_put_echo_skb(skb, dev, putidx, frame_len);
+		if (net_running_oob())
+			m_can_oob_mark_tx(cdev, putidx);
+		else
+			can_put_echo_skb(skb, dev, putidx, frame_len);
 
 		if (cdev->is_peripheral) {
 			/* Delay enabling TX FIFO element */
@@ -1990,6 +2236,177 @@ static netdev_tx_t m_can_start_peripheral_xmit(struct m_can_classdev *cdev,
 	return NETDEV_TX_OK;
 }
 
+#ifdef CONFIG_NET_OOB
+
+/*
+ * Send a frame from the oob stage, on behalf of the EVL TX thread
+ * which dropped @skb if we fail. There is no echo skb nor byte queue
+ * accounting for such frames, the EVL stack does not loop them back
+ * and paces its own senders. In-band and oob senders share the TX
+ * FIFO: the TX lock protects its level, the oob stax of the TX queue
+ * serializes the stages on the put index.
+ */
+static netdev_tx_t m_can_oob_xmit(struct m_can_classdev *cdev,
+				  struct sk_buff *skb)
+{
+	struct netdev_queue *txq = netdev_get_tx_queue(cdev->net, 0);
+	struct net_device_stats *stats = &cdev->net->stats;
+	unsigned int len = can_skb_get_data_len(skb);
+	unsigned long irqflags;
+	netdev_tx_t ret;
+
+	if (cdev->can.ctrlmode & CAN_CTRLMODE_LISTENONLY ||
+	    cdev->can.state == CAN_STATE_BUS_OFF) {
+		stats->tx_dropped++;
+		dev_kfree_skb_any(skb);
+		return NETDEV_TX_OK;
+	}
+
+	raw_spin_lock_irqsave(&cdev->tx_handling_spinlock, irqflags);
+	if (cdev->tx_fifo_in_flight >= cdev->tx_fifo_size) {
+		raw_spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
+		return NETDEV_TX_BUSY;
+	}
+	if (++cdev->tx_fifo_in_flight >= cdev->tx_fifo_size)
+		netif_tx_stop_queue(txq);
+	raw_spin_unlock_irqrestore(&cdev->tx_handling_spinlock, irqflags);
+
+	netif_tx_lock_oob(txq);
+	ret = m_can_tx_handler(cdev, skb);
+	netif_tx_unlock_oob(txq);
+
+	if (ret != NETDEV_TX_OK) {
+		m_can_oob_tx_retire(cdev, 1);
+		return ret;
+	}
+
+	stats->tx_packets++;
+	stats->tx_bytes += len;
+	dev_kfree_skb_any(skb);
+
+	return NETDEV_TX_OK;
+}
+
+/* in-band, hard irq context */
+static void m_can_oob_relay(struct irq_work *work)
+{
+	struct m_can_classdev *cdev =
+		container_of(work, struct m_can_classdev, oob_relay);
+	unsigned long pending = xchg(&cdev->oob_echo_pending, 0);
+	unsigned int frame_len = 0;
+	int processed = 0;
+	unsigned int putidx;
+
+	for_each_set_bit(putidx, &pending, BITS_PER_LONG) {
+		frame_len += m_can_tx_update_stats(cdev, putidx, 0);
+		processed++;
+	}
+
+	if (processed)
+		m_can_finish_tx(cdev, processed, frame_len);
+
+	if (atomic_xchg(&cdev->oob_tx_wake, 0))
+		netif_wake_queue(cdev->net);
+
+	/* Error frames are delivered from softirq context. */
+	if (atomic_read(&cdev->oob_irqstatus))
+		queue_work(system_bh_wq, &cdev->oob_err_work);
+}
+
+static void m_can_oob_err_work(struct work_struct *work)
+{
+	struct m_can_classdev *cdev =
+		container_of(work, struct m_can_classdev, oob_err_work);
+	struct net_device *dev = cdev->net;
+	u32 irqstatus;
+
+	irqstatus = atomic_xchg(&cdev->oob_irqstatus, 0);
+
+	if (irqstatus & IR_ERR_STATE)
+		m_can_handle_state_errors(dev, m_can_read(cdev, M_CAN_PSR));
+
+	if (irqstatus & IR_ERR_BUS_30X)
+		m_can_handle_bus_errors(dev, irqstatus,
+					m_can_read(cdev, M_CAN_PSR));
+}
+
+static void m_can_oob_init(struct m_can_classdev *cdev)
+{
+	init_irq_work(&cdev->oob_relay, m_can_oob_relay);
+	INIT_WORK(&cdev->oob_err_work, m_can_oob_err_work);
+}
+
+static void m_can_oob_sync(struct m_can_classdev *cdev)
+{
+	irq_work_sync(&cdev->oob_relay);
+	cancel_work_sync(&cdev->oob_err_work);
+}
+
+/*
+ * RX buffers of oob-capable devices come from a page pool which is
+ * filled upfront, so that the oob stage can draw from it. Twice the
+ * RX FIFO size leaves room for the frames still held by the stacks
+ * while the FIFO is drained.
+ */
+static int m_can_create_rx_pool(struct m_can_classdev *cdev)
+{
+	struct page_pool_params pp_params = {
+		.flags = PP_FLAG_PAGE_OOB,
+		.order = 0,
+		.pool_size = cdev->mcfg[MRAM_RXF0].num * 2,
+		.nid = dev_to_node(cdev->dev),
+		.dev = cdev->dev,
+		.netdev = cdev->net,
+	};
+	struct page_pool *pool;
+
+	if (!m_can_oob_capable(cdev))
+		return 0;
+
+	pool = page_pool_create(&pp_params);
+	if (IS_ERR(pool))
+		return PTR_ERR(pool);
+
+	cdev->rx_pool = pool;
+
+	return 0;
+}
+
+static void m_can_destroy_rx_pool(struct m_can_classdev *cdev)
+{
+	if (cdev->rx_pool) {
+		page_pool_destroy(cdev->rx_pool);
+		cdev->rx_pool = NULL;
+	}
+}
+
+#else
+
+static inline netdev_tx_t m_can_oob_xmit(struct m_can_classdev *cdev,
+					 struct sk_buff *skb)
+{
+	return NETDEV_TX_BUSY;
+}
+
+static inline void m_can_oob_init(struct m_can_classdev *cdev)
+{
+}
+
+static inline void m_can_oob_sync(struct m_can_classdev *cdev)
+{
+}
+
+static inline int m_can_create_rx_pool(struct m_can_classdev *cdev)
+{
+	return 0;
+}
+
+static inline void m_can_destroy_rx_pool(struct m_can_classdev *cdev)
+{
+}
+
+#endif	/* CONFIG_NET_OOB */
+
 static netdev_tx_t m_can_start_xmit(struct sk_buff *skb,
 				    struct net_device *dev)
 {
@@ -1997,6 +2414,9 @@ static netdev_tx_t m_can_start_xmit(struct sk_buff *skb,
 	unsigned int frame_len;
 	netdev_tx_t ret;
 
+	if (net_running_oob())
+		return m_can_oob_xmit(cdev, skb);
+
 	if (can_dev_dropped_skb(dev, skb))
 		return NETDEV_TX_OK;
 
@@ -2013,10 +2433,14 @@ static netdev_tx_t m_can_start_xmit(struct sk_buff *skb,
 
 	netdev_sent_queue(dev, frame_len);
 
-	if (cdev->is_peripheral)
+	if (cdev->is_peripheral) {
 		ret = m_can_start_peripheral_xmit(cdev, skb);
-	else
+	} else {
+		/* Serialize with oob senders, see m_can_oob_xmit(). */
+		netif_tx_lock_oob(netdev_get_tx_queue(dev, 0));
 		ret = m_can_tx_handler(cdev, skb);
+		netif_tx_unlock_oob(netdev_get_tx_queue(dev, 0));
+	}
 
 	if (ret != NETDEV_TX_OK)
 		netdev_completed_queue(dev, 1, frame_len);
@@ -2058,6 +2482,12 @@ static int m_can_open(struct net_device *dev)
 	if (err)
 		goto out_phy_power_off;
 
+	err = m_can_create_rx_pool(cdev);
+	if (err) {
+		netdev_err(dev, "failed to create RX page pool\n");
+		goto exit_disable_clks;
+	}
+
 	/* open the can device */
 	err = open_candev(dev);
 	if (err) {
@@ -2088,8 +2518,8 @@ static int m_can_open(struct net_device *dev)
 					   IRQF_ONESHOT,
 					   dev->name, dev);
 	} else if (dev->irq) {
-		err = request_irq(dev->irq, m_can_isr, IRQF_SHARED, dev->name,
-				  dev);
+		err = request_irq(dev->irq, m_can_isr, m_can_irqflags(cdev),
+				  dev->name, dev);
 	}
 
 	if (err < 0) {
@@ -2119,17 +2549,67 @@ out_wq_fail:
 		napi_disable(&cdev->napi);
 	close_candev(dev);
 exit_disable_clks:
+	m_can_destroy_rx_pool(cdev);
 	m_can_clk_stop(cdev);
 out_phy_power_off:
 	phy_power_off(cdev->transceiver);
 	return err;
 }
 
+#ifdef CONFIG_NET_OOB
+
+/*
+ * Move the interrupt of a running device to the oob stage, or back
+ * in-band. Any pending poll must have completed from the stage the
+ * interrupt belonged to before switching.
+ */
+static void m_can_switch_irq_oob(struct m_can_classdev *cdev, bool on)
+{
+	unsigned int irq = cdev->net->irq;
+
+	disable_irq(irq);
+	napi_disable(&cdev->napi);
+	irq_switch_oob(irq, on);
+	napi_enable(&cdev->napi);
+	enable_irq(irq);
+}
+
+/* rtnl_lock held */
+static int m_can_enable_oob(struct net_device *dev)
+{
+	struct m_can_classdev *cdev = netdev_priv(dev);
+
+	if (netif_running(dev))
+		m_can_switch_irq_oob(cdev, true);
+
+	cdev->oob_mode = true;
+
+	return 0;
+}
+
+/* rtnl_lock held */
+static void m_can_disable_oob(struct net_device *dev)
+{
+	struct m_can_classdev *cdev = netdev_priv(dev);
+
+	if (netif_running(dev))
+		m_can_switch_irq_oob(cdev, false);
+
+	cdev->oob_mode = false;
+	irq_work_sync(&cdev->oob_relay);
+}
+
+#endif	/* CONFIG_NET_OOB */
+
 static const struct net_device_ops m_can_netdev_ops = {
 	.ndo_open = m_can_open,
 	.ndo_stop = m_can_close,
 	.ndo_start_xmit = m_can_start_xmit,
 	.ndo_change_mtu = can_change_mtu,
+#ifdef CONFIG_NET_OOB
+	.ndo_enable_oob = m_can_enable_oob,
+	.ndo_disable_oob = m_can_disable_oob,
+#endif
 };
 
 static int m_can_get_coalesce(struct net_device *dev,
@@ -2243,6 +2723,8 @@ static int register_m_can_dev(struct m_can_classdev *cdev)
 
 	dev->flags |= IFF_ECHO;	/* we support local echo */
 	dev->netdev_ops = &m_can_netdev_ops;
+	if (m_can_oob_capable(cdev))
+		netdev_set_oob_capable(dev);
 	if (dev->irq && cdev->is_peripheral)
 		dev->ethtool_ops = &m_can_ethtool_ops_coalescing;
 	else
@@ -2432,6 +2914,8 @@ int m_can_class_register(struct m_can_classdev *cdev)
 	if (ret)
 		goto rx_offload_del;
 
+	m_can_oob_init(cdev);
+
 	ret = register_m_can_dev(cdev);
 	if (ret) {
 		dev_err(cdev->dev, "registering %s failed (err=%d)\n",
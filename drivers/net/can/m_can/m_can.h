@@ -19,6 +19,7 @@
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/iopoll.h>
+#include <linux/irq_work.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/netdevice.h>
@@ -114,7 +115,7 @@ struct m_can_classdev {
 	u32 tx_fifo_putidx;
 
 	/* Protects shared state between start_xmit and m_can_isr */
-	spinlock_t tx_handling_spinlock;
+	hard_spinlock_t tx_handling_spinlock;
 	int tx_fifo_in_flight;
 
 	struct m_can_tx_op *tx_ops;
@@ -128,6 +129,23 @@ struct m_can_classdev {
 	struct mram_cfg mcfg[MRAM_CFG_NUM];
 
 	struct hrtimer hrtimer;
+
+#ifdef CONFIG_NET_OOB
+	/* Out-of-band datapath enabled (ndo_enable_oob) */
+	bool oob_mode;
+	/* oob-accessible RX buffers */
+	struct page_pool *rx_pool;
+	/* Period of the timestamp counter */
+	u32 ts_tick_ns;
+	/* TX FIFO elements sent from the oob stage, with no echo skb */
+	unsigned long oob_tx_mask;
+	/* Work seen from the oob stage, relayed in-band */
+	unsigned long oob_echo_pending;
+	atomic_t oob_tx_wake;
+	atomic_t oob_irqstatus;
+	struct irq_work oob_relay;
+	struct work_struct oob_err_work;
+#endif
 };
 
 struct m_can_classdev *m_can_class_allocate_dev(struct device *dev, int sizeof_priv);
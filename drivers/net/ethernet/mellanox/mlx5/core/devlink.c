@@ -478,6 +478,39 @@ mlx5_devlink_hairpin_queue_size_validate(struct devlink *devlink, u32 id,
 	return 0;
 }
 
+#ifdef CONFIG_NET_OOB
+
+static int
+mlx5_devlink_oob_num_channels_validate(struct devlink *devlink, u32 id,
+				       union devlink_param_value val,
+				       struct netlink_ext_ack *extack)
+{
+	if (!val.vu32 || val.vu32 > U16_MAX) {
+		NL_SET_ERR_MSG_MOD(extack, "Value is out of range");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void mlx5_devlink_oob_params_init_values(struct devlink *devlink)
+{
+	union devlink_param_value value;
+
+	/* One channel dedicated to oob traffic by default. */
+	value.vu32 = 1;
+	devl_param_driverinit_value_set(
+		devlink, MLX5_DEVLINK_PARAM_ID_OOB_NUM_CHANNELS, value);
+}
+
+#else
+
+static void mlx5_devlink_oob_params_init_values(struct devlink *devlink)
+{
+}
+
+#endif
+
 static void mlx5_devlink_hairpin_params_init_values(struct devlink *devlink)
 {
 	struct mlx5_core_dev *dev = devlink_priv(devlink);
@@ -557,6 +590,12 @@ static const struct devlink_param mlx5_devlink_eth_params[] = {
 			     "hairpin_queue_size", DEVLINK_PARAM_TYPE_U32,
 			     BIT(DEVLINK_PARAM_CMODE_DRIVERINIT), NULL, NULL,
 			     mlx5_devlink_hairpin_queue_size_validate),
+#ifdef CONFIG_NET_OOB
+	DEVLINK_PARAM_DRIVER(MLX5_DEVLINK_PARAM_ID_OOB_NUM_CHANNELS,
+			     "oob_num_channels", DEVLINK_PARAM_TYPE_U32,
+			     BIT(DEVLINK_PARAM_CMODE_DRIVERINIT), NULL, NULL,
+			     mlx5_devlink_oob_num_channels_validate),
+#endif
 };
 
 static int mlx5_devlink_eth_params_register(struct devlink *devlink)
@@ -579,6 +618,7 @@ static int mlx5_devlink_eth_params_register(struct devlink *devlink)
 					value);
 
 	mlx5_devlink_hairpin_params_init_values(devlink);
+	mlx5_devlink_oob_params_init_values(devlink);
 
 	return 0;
 }
@@ -50,6 +50,7 @@
 #include <net/xdp.h>
 #include <linux/dim.h>
 #include <linux/bits.h>
+#include <linux/irq_work.h>
 #include "wq.h"
 #include "mlx5_core.h"
 #include "en_stats.h"
@@ -312,6 +313,9 @@ struct mlx5e_params {
 	int hard_mtu;
 	bool ptp_rx;
 	__be32 terminate_lkey_be;
+#ifdef CONFIG_NET_OOB
+	u16 oob_num_channels;
+#endif
 };
 
 static inline u8 mlx5e_get_dcb_num_tc(struct mlx5e_params *params)
@@ -734,6 +738,7 @@ struct mlx5e_rq {
 
 enum mlx5e_channel_state {
 	MLX5E_CHANNEL_STATE_XSK,
+	MLX5E_CHANNEL_STATE_OOB,
 	MLX5E_CHANNEL_NUM_STATES
 };
 
@@ -784,6 +789,11 @@ struct mlx5e_channel {
 	/* coalescing configuration */
 	struct dim_cq_moder        rx_cq_moder;
 	struct dim_cq_moder        tx_cq_moder;
+
+#ifdef CONFIG_NET_OOB
+	/* Relays error recovery requests from the oob stage. */
+	struct irq_work            oob_recover_work;
+#endif
 };
 
 struct mlx5e_ptp;
@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-2.0 OR Linux-OpenIB
+
+#include <linux/irq.h>
+#include "en/oob.h"
+#include "en/params.h"
+#include "en/htb.h"
+#include "en/xsk/pool.h"
+#include "devlink.h"
+
+#define MLX5E_OOB_DEFAULT_NUM_CHANNELS	1
+
+/*
+ * Oob channels run their NAPI poll from the oob stage, so anything
+ * which may need in-band services from there is excluded: XDP, XSK,
+ * packet merging (LRO, HW-GRO), non-linear RX buffers, multiple
+ * traffic classes, HTB and TX port timestamping. This is called for
+ * every change of parameters, see mlx5e_safe_switch_params().
+ */
+int mlx5e_oob_validate_params(struct mlx5e_priv *priv,
+			      struct mlx5e_params *params)
+{
+	struct net_device *netdev = priv->netdev;
+	struct mlx5_core_dev *mdev = priv->mdev;
+	bool linear;
+	int ix;
+
+	if (!mlx5e_params_has_oob(params))
+		return 0;
+
+	if (params->oob_num_channels >= params->num_channels) {
+		netdev_err(netdev, "oob: %u oob channels leave no in-band channel\n",
+			   params->oob_num_channels);
+		return -EINVAL;
+	}
+
+	if (params->mqprio.num_tc > 1) {
+		netdev_err(netdev, "oob: multiple traffic classes are not supported\n");
+		return -EINVAL;
+	}
+
+	if (params->xdp_prog) {
+		netdev_err(netdev, "oob: XDP is not supported\n");
+		return -EINVAL;
+	}
+
+	if (params->packet_merge.type != MLX5E_PACKET_MERGE_NONE) {
+		netdev_err(netdev, "oob: LRO and HW-GRO are not supported\n");
+		return -EINVAL;
+	}
+
+	if (MLX5E_GET_PFLAG(params, MLX5E_PFLAG_TX_PORT_TS)) {
+		netdev_err(netdev, "oob: TX port timestamping is not supported\n");
+		return -EINVAL;
+	}
+
+	if (priv->htb && mlx5e_htb_cur_leaf_nodes(priv->htb)) {
+		netdev_err(netdev, "oob: HTB offload is not supported\n");
+		return -EINVAL;
+	}
+
+	if (params->rq_wq_type == MLX5_WQ_TYPE_LINKED_LIST_STRIDING_RQ)
+		linear = mlx5e_rx_mpwqe_is_linear_skb(mdev, params, NULL);
+	else
+		linear = mlx5e_rx_is_linear_skb(mdev, params, NULL);
+
+	if (!linear) {
+		netdev_err(netdev, "oob: MTU %u requires non-linear RX buffers\n",
+			   params->sw_mtu);
+		return -EINVAL;
+	}
+
+	for (ix = mlx5e_params_inband_channels(params);
+	     ix < params->num_channels; ix++) {
+		if (mlx5e_xsk_get_pool(params, params->xsk, ix)) {
+			netdev_err(netdev, "oob: channel %d has an XSK pool\n", ix);
+			return -EBUSY;
+		}
+	}
+
+	return 0;
+}
+
+/* in-band */
+static void mlx5e_oob_recover_relay(struct irq_work *work)
+{
+	struct mlx5e_channel *c = container_of(work, struct mlx5e_channel,
+					       oob_recover_work);
+	struct workqueue_struct *wq = c->priv->wq;
+	int tc;
+
+	for (tc = 0; tc < c->num_tc; tc++)
+		if (test_bit(MLX5E_SQ_STATE_RECOVERING, &c->sq[tc].state))
+			queue_work(wq, &c->sq[tc].recover_work);
+
+	if (test_bit(MLX5E_SQ_STATE_RECOVERING, &c->icosq.state))
+		queue_work(wq, &c->icosq.recover_work);
+
+	if (test_bit(MLX5E_RQ_STATE_RECOVERING, &c->rq.state))
+		queue_work(wq, &c->rq.recover_work);
+}
+
+void mlx5e_oob_init_channel(struct mlx5e_channel *c,
+			    struct mlx5e_params *params)
+{
+	init_irq_work(&c->oob_recover_work, mlx5e_oob_recover_relay);
+
+	if (mlx5e_params_oob_channel(params, c->ix))
+		set_bit(MLX5E_CHANNEL_STATE_OOB, c->state);
+}
+
+/*
+ * The completion vector of an oob channel is moved to the oob stage
+ * while the channel is active, so that its NAPI context is scheduled
+ * from there. Other consumers of the same vector, such as RDMA CQs
+ * bound to it, would see their completion handlers run from the oob
+ * stage as well.
+ */
+static void mlx5e_oob_switch_irq(struct mlx5e_channel *c, bool on)
+{
+	unsigned int irq = c->napi.irq;
+
+	disable_irq(irq);
+	irq_switch_oob(irq, on);
+	enable_irq(irq);
+}
+
+/* Called before the NAPI context is enabled. */
+void mlx5e_oob_activate_channel(struct mlx5e_channel *c)
+{
+	if (mlx5e_channel_is_oob(c))
+		mlx5e_oob_switch_irq(c, true);
+}
+
+/* Called after the NAPI context is disabled. */
+void mlx5e_oob_deactivate_channel(struct mlx5e_channel *c)
+{
+	if (mlx5e_channel_is_oob(c)) {
+		mlx5e_oob_switch_irq(c, false);
+		irq_work_sync(&c->oob_recover_work);
+	}
+}
+
+/*
+ * Hide the oob channels from the in-band stack: their TX queues go
+ * past real_num_tx_queues, and the default RSS indirection table only
+ * spreads over the in-band channels. ntuple rules (ethtool -N) steer
+ * the oob flows to the oob channels by index.
+ */
+static int mlx5e_oob_channels_changed(struct mlx5e_priv *priv, void *context)
+{
+	u16 count = mlx5e_params_inband_channels(&priv->channels.params);
+	int err;
+
+	err = mlx5e_update_tx_netdev_queues(priv);
+	if (err)
+		return err;
+
+	if (priv->rx_res && !netif_is_rxfh_configured(priv->netdev))
+		mlx5e_rx_res_rss_set_indir_uniform(priv->rx_res, count);
+
+	return 0;
+}
+
+static u16 mlx5e_oob_get_num_channels(struct mlx5e_priv *priv)
+{
+	struct devlink *devlink = priv_to_devlink(priv->mdev);
+	union devlink_param_value val;
+	int err;
+
+	err = devl_param_driverinit_value_get(devlink,
+					      MLX5_DEVLINK_PARAM_ID_OOB_NUM_CHANNELS,
+					      &val);
+	if (err)
+		return MLX5E_OOB_DEFAULT_NUM_CHANNELS;
+
+	return min_t(u32, val.vu32, U16_MAX);
+}
+
+static int mlx5e_oob_set_num_channels(struct mlx5e_priv *priv, u16 nch)
+{
+	struct mlx5e_params new_params;
+	int err;
+
+	mutex_lock(&priv->state_lock);
+	new_params = priv->channels.params;
+	new_params.oob_num_channels = nch;
+	err = mlx5e_safe_switch_params(priv, &new_params,
+				       mlx5e_oob_channels_changed, NULL, true);
+	mutex_unlock(&priv->state_lock);
+
+	return err;
+}
+
+/* rtnl_lock held */
+int mlx5e_enable_oob(struct net_device *netdev)
+{
+	struct mlx5e_priv *priv = netdev_priv(netdev);
+	int err;
+
+	err = mlx5e_oob_set_num_channels(priv, mlx5e_oob_get_num_channels(priv));
+	if (err)
+		netdev_err(netdev, "oob: failed to set up the oob channels, %d\n", err);
+
+	return err;
+}
+
+/* rtnl_lock held */
+void mlx5e_disable_oob(struct net_device *netdev)
+{
+	struct mlx5e_priv *priv = netdev_priv(netdev);
+	int err;
+
+	err = mlx5e_oob_set_num_channels(priv, 0);
+	if (err)
+		netdev_warn(netdev, "oob: failed to release the oob channels, %d\n", err);
+}
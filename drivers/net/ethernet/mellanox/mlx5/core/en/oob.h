@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: GPL-2.0 OR Linux-OpenIB */
+
+#ifndef __MLX5_EN_OOB_H__
+#define __MLX5_EN_OOB_H__
+
+#include "en.h"
+
+#ifdef CONFIG_NET_OOB
+
+/* The oob channels are the last oob_num_channels ones of the set. */
+static inline u16 mlx5e_params_inband_channels(struct mlx5e_params *params)
+{
+	return params->num_channels - params->oob_num_channels;
+}
+
+static inline bool mlx5e_params_has_oob(struct mlx5e_params *params)
+{
+	return params->oob_num_channels > 0;
+}
+
+static inline bool mlx5e_params_oob_channel(struct mlx5e_params *params, int ix)
+{
+	return mlx5e_params_has_oob(params) &&
+		ix >= mlx5e_params_inband_channels(params);
+}
+
+static inline bool mlx5e_channel_is_oob(struct mlx5e_channel *c)
+{
+	return c && test_bit(MLX5E_CHANNEL_STATE_OOB, c->state);
+}
+
+/*
+ * Packets sent from the oob stage always go through the SQs of the
+ * oob channels, which the in-band stack never selects since they
+ * live past real_num_tx_queues. The queue mapping of the packet
+ * picks one of them. With a single traffic class, the TX queue
+ * index of a channel SQ is the channel index.
+ */
+static inline u16 mlx5e_oob_txq_ix(struct mlx5e_params *params,
+				   struct sk_buff *skb)
+{
+	return mlx5e_params_inband_channels(params) +
+		skb_get_queue_mapping(skb) % params->oob_num_channels;
+}
+
+/*
+ * Error recovery runs from a workqueue, which the oob stage cannot
+ * kick directly. The request is relayed in-band, where the recovery
+ * work of any queue of @c marked as recovering is scheduled.
+ */
+static inline void mlx5e_queue_recover_work(struct mlx5e_channel *c,
+					    struct workqueue_struct *wq,
+					    struct work_struct *recover_work)
+{
+	if (net_running_oob())
+		irq_work_queue(&c->oob_recover_work);
+	else
+		queue_work(wq, recover_work);
+}
+
+int mlx5e_oob_validate_params(struct mlx5e_priv *priv,
+			      struct mlx5e_params *params);
+void mlx5e_oob_init_channel(struct mlx5e_channel *c,
+			    struct mlx5e_params *params);
+void mlx5e_oob_activate_channel(struct mlx5e_channel *c);
+void mlx5e_oob_deactivate_channel(struct mlx5e_channel *c);
+int mlx5e_enable_oob(struct net_device *netdev);
+void mlx5e_disable_oob(struct net_device *netdev);
+
+#else
+
+static inline u16 mlx5e_params_inband_channels(struct mlx5e_params *params)
+{
+	return params->num_channels;
+}
+
+static inline bool mlx5e_params_has_oob(struct mlx5e_params *params)
+{
+	return false;
+}
+
+static inline bool mlx5e_params_oob_channel(struct mlx5e_params *params, int ix)
+{
+	return false;
+}
+
+static inline bool mlx5e_channel_is_oob(struct mlx5e_channel *c)
+{
+	return false;
+}
+
+static inline int mlx5e_oob_validate_params(struct mlx5e_priv *priv,
+					    struct mlx5e_params *params)
+{
+	return 0;
+}
+
+static inline void mlx5e_oob_init_channel(struct mlx5e_channel *c,
+					  struct mlx5e_params *params) {}
+static inline void mlx5e_oob_activate_channel(struct mlx5e_channel *c) {}
+static inline void mlx5e_oob_deactivate_channel(struct mlx5e_channel *c) {}
+
+static inline void mlx5e_queue_recover_work(struct mlx5e_channel *c,
+					    struct workqueue_struct *wq,
+					    struct work_struct *recover_work)
+{
+	queue_work(wq, recover_work);
+}
+
+#endif /* CONFIG_NET_OOB */
+
+static inline bool mlx5e_txqsq_is_oob(struct mlx5e_txqsq *sq)
+{
+	return mlx5e_channel_is_oob(sq->channel);
+}
+
+static inline bool mlx5e_rq_is_oob(struct mlx5e_rq *rq)
+{
+	return mlx5e_channel_is_oob(rq->channel);
+}
+
+/*
+ * Oob channels hand over their packets directly, GRO is in-band
+ * only.
+ */
+static inline void mlx5e_rq_deliver_skb(struct mlx5e_rq *rq, struct sk_buff *skb)
+{
+	if (mlx5e_rq_is_oob(rq))
+		netif_receive_skb(skb);
+	else
+		napi_gro_receive(rq->cq.napi, skb);
+}
+
+#endif /* __MLX5_EN_OOB_H__ */
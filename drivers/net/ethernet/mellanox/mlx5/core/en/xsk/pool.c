@@ -5,6 +5,7 @@
 #include "pool.h"
 #include "setup.h"
 #include "en/params.h"
+#include "en/oob.h"
 
 static int mlx5e_xsk_map_pool(struct mlx5_core_dev *mdev,
 			      struct xsk_buff_pool *pool)
@@ -86,6 +87,9 @@ static int mlx5e_xsk_enable_locked(struct mlx5e_priv *priv,
 	if (unlikely(mlx5e_xsk_get_pool(&priv->channels.params, &priv->xsk, ix)))
 		return -EBUSY;
 
+	if (unlikely(mlx5e_params_oob_channel(params, ix)))
+		return -EBUSY;
+
 	if (unlikely(!mlx5e_xsk_is_pool_sane(pool)))
 		return -EINVAL;
 
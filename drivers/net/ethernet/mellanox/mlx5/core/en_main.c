@@ -74,6 +74,7 @@
 #include "en/trap.h"
 #include "lib/devcom.h"
 #include "lib/sd.h"
+#include "en/oob.h"
 
 static bool mlx5e_hw_gro_supported(struct mlx5_core_dev *mdev)
 {
@@ -919,6 +920,13 @@ static int mlx5e_alloc_rq(struct mlx5e_params *params,
 
 		pp_params.order     = 0;
 		pp_params.flags     = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+		/* An oob pool has no slow path, leave room for the pages
+		 * held by the stack.
+		 */
+		if (mlx5e_rq_is_oob(rq)) {
+			pp_params.flags |= PP_FLAG_PAGE_OOB;
+			pool_size *= 2;
+		}
 		pp_params.pool_size = pool_size;
 		pp_params.nid       = node;
 		pp_params.dev       = rq->pdev;
@@ -1631,7 +1639,7 @@ static int mlx5e_alloc_txqsq(struct mlx5e_channel *c,
 		set_bit(MLX5E_SQ_STATE_VLAN_NEED_L2_INLINE, &sq->state);
 	if (mlx5_ipsec_device_caps(c->priv->mdev))
 		set_bit(MLX5E_SQ_STATE_IPSEC, &sq->state);
-	if (param->is_mpw)
+	if (param->is_mpw && !mlx5e_txqsq_is_oob(sq))
 		set_bit(MLX5E_SQ_STATE_MPWQE, &sq->state);
 	sq->stop_room = param->stop_room;
 	sq->ptp_cyc2time = mlx5_sq_ts_translator(mdev);
@@ -1865,6 +1873,12 @@ void mlx5e_deactivate_txqsq(struct mlx5e_txqsq *sq)
 
 	mlx5e_tx_disable_queue(sq->txq);
 
+	/* Wait for oob senders to notice the stopped queue. */
+	if (mlx5e_txqsq_is_oob(sq)) {
+		netif_tx_lock_oob(sq->txq);
+		netif_tx_unlock_oob(sq->txq);
+	}
+
 	/* last doorbell out, godspeed .. */
 	if (mlx5e_wqc_has_room_for(wq, sq->cc, sq->pc, 1)) {
 		u16 pi = mlx5_wq_cyc_ctr2ix(wq, sq->pc);
@@ -2734,6 +2748,7 @@ static int mlx5e_open_channel(struct mlx5e_priv *priv, int ix,
 
 	netif_napi_add_config(netdev, &c->napi, mlx5e_napi_poll, ix);
 	netif_napi_set_irq(&c->napi, irq);
+	mlx5e_oob_init_channel(c, params);
 
 	err = mlx5e_open_queues(c, params, cparam);
 	if (unlikely(err))
@@ -2768,6 +2783,7 @@ static void mlx5e_activate_channel(struct mlx5e_channel *c)
 {
 	int tc;
 
+	mlx5e_oob_activate_channel(c);
 	napi_enable(&c->napi);
 
 	for (tc = 0; tc < c->num_tc; tc++)
@@ -2801,6 +2817,7 @@ static void mlx5e_deactivate_channel(struct mlx5e_channel *c)
 	mlx5e_qos_deactivate_queues(c);
 
 	napi_disable(&c->napi);
+	mlx5e_oob_deactivate_channel(c);
 }
 
 static void mlx5e_close_channel(struct mlx5e_channel *c)
@@ -3042,7 +3059,7 @@ int mlx5e_update_tx_netdev_queues(struct mlx5e_priv *priv)
 	if (priv->htb)
 		qos_queues = mlx5e_htb_cur_leaf_nodes(priv->htb);
 
-	nch = priv->channels.params.num_channels;
+	nch = mlx5e_params_inband_channels(&priv->channels.params);
 	ntc = mlx5e_get_dcb_num_tc(&priv->channels.params);
 	num_txqs = nch * ntc + qos_queues;
 	if (MLX5E_GET_PFLAG(&priv->channels.params, MLX5E_PFLAG_TX_PORT_TS))
@@ -3061,7 +3078,7 @@ static void mlx5e_set_default_xps_cpumasks(struct mlx5e_priv *priv,
 {
 	int ix;
 
-	for (ix = 0; ix < params->num_channels; ix++) {
+	for (ix = 0; ix < mlx5e_params_inband_channels(params); ix++) {
 		int num_comp_vectors, irq, vec_ix;
 		struct mlx5_core_dev *mdev;
 
@@ -3147,7 +3164,8 @@ static int mlx5e_num_channels_changed(struct mlx5e_priv *priv)
 		mlx5e_rx_res_rss_update_num_channels(priv->rx_res, count);
 
 		if (!netif_is_rxfh_configured(priv->netdev))
-			mlx5e_rx_res_rss_set_indir_uniform(priv->rx_res, count);
+			mlx5e_rx_res_rss_set_indir_uniform(priv->rx_res,
+				mlx5e_params_inband_channels(&priv->channels.params));
 	}
 
 	return 0;
@@ -3320,6 +3338,10 @@ int mlx5e_safe_switch_params(struct mlx5e_priv *priv,
 	struct mlx5e_channels *new_chs;
 	int err;
 
+	err = mlx5e_oob_validate_params(priv, params);
+	if (err)
+		return err;
+
 	reset &= test_bit(MLX5E_STATE_OPENED, &priv->state);
 	if (!reset)
 		return mlx5e_switch_priv_params(priv, params, preactivate, context);
@@ -3862,7 +3884,10 @@ static int mlx5e_setup_tc(struct net_device *dev, enum tc_setup_type type,
 		return err;
 	case TC_SETUP_QDISC_HTB:
 		mutex_lock(&priv->state_lock);
-		err = mlx5e_htb_setup_tc(priv, type_data);
+		if (mlx5e_params_has_oob(&priv->channels.params))
+			err = -EBUSY;
+		else
+			err = mlx5e_htb_setup_tc(priv, type_data);
 		mutex_unlock(&priv->state_lock);
 		return err;
 	default:
@@ -5192,6 +5217,10 @@ const struct net_device_ops mlx5e_netdev_ops = {
 	.ndo_bpf		 = mlx5e_xdp,
 	.ndo_xdp_xmit            = mlx5e_xdp_xmit,
 	.ndo_xsk_wakeup          = mlx5e_xsk_wakeup,
+#ifdef CONFIG_NET_OOB
+	.ndo_enable_oob          = mlx5e_enable_oob,
+	.ndo_disable_oob         = mlx5e_disable_oob,
+#endif
 #ifdef CONFIG_MLX5_EN_ARFS
 	.ndo_rx_flow_steer	 = mlx5e_rx_flow_steer,
 #endif
@@ -5605,6 +5634,10 @@ static void mlx5e_build_nic_netdev(struct net_device *netdev)
 
 	netdev->priv_flags       |= IFF_UNICAST_FLT;
 
+	/* Oob TX buffers are premapped for the parent device. */
+	if (mdev->device == mlx5_core_dma_dev(mdev))
+		netdev_set_oob_capable(netdev);
+
 	netif_set_tso_max_size(netdev, GSO_MAX_SIZE);
 	mlx5e_set_xdp_feature(netdev);
 	mlx5e_set_netdev_dev_addr(netdev);
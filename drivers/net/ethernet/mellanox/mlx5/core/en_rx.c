@@ -59,6 +59,7 @@
 #include "en/params.h"
 #include "devlink.h"
 #include "en/devlink.h"
+#include "en/oob.h"
 
 static struct sk_buff *
 mlx5e_skb_from_cqe_mpwrq_linear(struct mlx5e_rq *rq, struct mlx5e_mpw_info *wi,
@@ -1034,7 +1035,8 @@ int mlx5e_poll_ico_cq(struct mlx5e_cq *cq)
 						     (struct mlx5_err_cqe *)cqe);
 				mlx5_wq_cyc_wqe_dump(&sq->wq, ci, wi->num_wqebbs);
 				if (!test_and_set_bit(MLX5E_SQ_STATE_RECOVERING, &sq->state))
-					queue_work(cq->workqueue, &sq->recover_work);
+					mlx5e_queue_recover_work(sq->channel, cq->workqueue,
+								 &sq->recover_work);
 				break;
 			}
 
@@ -1801,7 +1803,7 @@ static void trigger_report(struct mlx5e_rq *rq, struct mlx5_cqe64 *cqe)
 	if (cqe_syndrome_needs_recover(err_cqe->syndrome) &&
 	    !test_and_set_bit(MLX5E_RQ_STATE_RECOVERING, &rq->state)) {
 		mlx5e_dump_error_cqe(&rq->cq, rq->rqn, err_cqe);
-		queue_work(priv->wq, &rq->recover_work);
+		mlx5e_queue_recover_work(rq->channel, priv->wq, &rq->recover_work);
 	}
 }
 
@@ -1848,7 +1850,7 @@ static void mlx5e_handle_rx_cqe(struct mlx5e_rq *rq, struct mlx5_cqe64 *cqe)
 			goto wq_cyc_pop;
 		}
 
-	napi_gro_receive(rq->cq.napi, skb);
+	mlx5e_rq_deliver_skb(rq, skb);
 
 wq_cyc_pop:
 	mlx5_wq_cyc_pop(wq);
@@ -2416,7 +2418,7 @@ static void mlx5e_handle_rx_cqe_mpwrq(struct mlx5e_rq *rq, struct mlx5_cqe64 *cq
 			goto mpwrq_cqe_out;
 		}
 
-	napi_gro_receive(rq->cq.napi, skb);
+	mlx5e_rq_deliver_skb(rq, skb);
 
 mpwrq_cqe_out:
 	if (likely(wi->consumed_strides < rq->mpwqe.num_strides))
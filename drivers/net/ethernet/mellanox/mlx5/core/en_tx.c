@@ -41,6 +41,7 @@
 #include "en_accel/ipsec_rxtx.h"
 #include "en_accel/macsec.h"
 #include "en/ptp.h"
+#include "en/oob.h"
 #include <net/ipv6.h>
 
 static void mlx5e_dma_unmap_wqe_err(struct mlx5e_txqsq *sq, u8 num_dma)
@@ -177,6 +178,26 @@ mlx5e_tx_get_gso_ihs(struct mlx5e_txqsq *sq, struct sk_buff *skb, int *hopbyhop)
 	return ihs;
 }
 
+/*
+ * Buffers from the oob device pool are premapped for the parent
+ * device, which is our DMA device (see mlx5e_build_nic_netdev()), so
+ * syncing is enough. Nothing may be mapped from the oob stage.
+ */
+static inline dma_addr_t
+mlx5e_tx_oob_storage_addr(struct mlx5e_txqsq *sq, struct sk_buff *skb,
+			  unsigned char *skb_data, u16 headlen)
+{
+	dma_addr_t dma_addr = skb_oob_storage_addr(skb);
+
+	if (unlikely(dma_addr == DMA_MAPPING_ERROR))
+		return dma_addr;
+
+	dma_addr += skb_data - skb->head;
+	dma_sync_single_for_device(sq->pdev, dma_addr, headlen, DMA_TO_DEVICE);
+
+	return dma_addr;
+}
+
 static inline int
 mlx5e_txwqe_build_dsegs(struct mlx5e_txqsq *sq, struct sk_buff *skb,
 			unsigned char *skb_data, u16 headlen,
@@ -187,17 +208,25 @@ mlx5e_txwqe_build_dsegs(struct mlx5e_txqsq *sq, struct sk_buff *skb,
 	int i;
 
 	if (headlen) {
-		dma_addr = dma_map_single(sq->pdev, skb_data, headlen,
-					  DMA_TO_DEVICE);
-		if (unlikely(dma_mapping_error(sq->pdev, dma_addr)))
-			goto dma_unmap_wqe_err;
+		if (net_running_oob()) {
+			/* Premapped, nothing to unmap on completion. */
+			dma_addr = mlx5e_tx_oob_storage_addr(sq, skb, skb_data, headlen);
+			if (unlikely(dma_addr == DMA_MAPPING_ERROR))
+				goto dma_unmap_wqe_err;
+		} else {
+			dma_addr = dma_map_single(sq->pdev, skb_data, headlen,
+						  DMA_TO_DEVICE);
+			if (unlikely(dma_mapping_error(sq->pdev, dma_addr)))
+				goto dma_unmap_wqe_err;
+
+			mlx5e_dma_push(sq, dma_addr, headlen, MLX5E_DMA_MAP_SINGLE);
+			num_dma++;
+		}
 
 		dseg->addr       = cpu_to_be64(dma_addr);
 		dseg->lkey       = sq->mkey_be;
 		dseg->byte_count = cpu_to_be32(headlen);
 
-		mlx5e_dma_push(sq, dma_addr, headlen, MLX5E_DMA_MAP_SINGLE);
-		num_dma++;
 		dseg++;
 	}
 
@@ -396,6 +425,15 @@ mlx5e_txwqe_complete(struct mlx5e_txqsq *sq, struct sk_buff *skb,
 
 	sq->pc += wi->num_wqebbs;
 
+	/*
+	 * Oob SQs are not flow controlled by the stack, the oob sender
+	 * drops when the ring is full.
+	 */
+	if (mlx5e_txqsq_is_oob(sq)) {
+		mlx5e_notify_hw(wq, sq->pc, sq->uar_map, cseg);
+		return;
+	}
+
 	mlx5e_tx_check_stop(sq);
 
 	if (unlikely(sq->ptpsq &&
@@ -672,6 +710,69 @@ static void mlx5e_txwqe_build_eseg(struct mlx5e_priv *priv, struct mlx5e_txqsq *
 		mlx5e_cqe_ts_id_eseg(sq->ptpsq, skb, eseg);
 }
 
+#ifdef CONFIG_NET_OOB
+
+/*
+ * Transmit from the oob stage. The packet is queued to an oob SQ,
+ * serialized with the oob stax of its TX queue. Fragmented and GSO
+ * packets are not expected from the oob stack, no offload
+ * accelerator applies either.
+ */
+static netdev_tx_t mlx5e_xmit_oob(struct sk_buff *skb, struct net_device *dev)
+{
+	struct mlx5e_priv *priv = netdev_priv(dev);
+	struct mlx5e_params *params = &priv->channels.params;
+	struct mlx5e_accel_tx_state accel = {};
+	struct mlx5e_tx_wqe_attr wqe_attr;
+	struct netdev_queue *txq;
+	struct mlx5e_tx_attr attr;
+	struct mlx5e_tx_wqe *wqe;
+	struct mlx5e_txqsq *sq;
+	u16 txq_ix, pi;
+
+	if (unlikely(!mlx5e_params_has_oob(params) ||
+		     skb_shinfo(skb)->nr_frags || skb_is_gso(skb)))
+		goto drop;
+
+	txq_ix = mlx5e_oob_txq_ix(params, skb);
+	txq = netdev_get_tx_queue(dev, txq_ix);
+	netif_tx_lock_oob(txq);
+
+	/*
+	 * All queues are stopped while the channels are switched, in
+	 * which case txq2sq cannot be trusted.
+	 */
+	if (unlikely(netif_xmit_stopped(txq)))
+		goto unlock_drop;
+
+	sq = priv->txq2sq[txq_ix];
+	if (unlikely(!mlx5e_wqc_has_room_for(&sq->wq, sq->cc, sq->pc,
+					     sq->stop_room))) {
+		sq->stats->dropped++;
+		goto unlock_drop;
+	}
+
+	mlx5e_sq_xmit_prepare(sq, skb, &accel, &attr);
+	mlx5e_sq_calc_wqe_attr(skb, &attr, &wqe_attr);
+	pi = mlx5e_txqsq_get_next_pi(sq, wqe_attr.num_wqebbs);
+	wqe = MLX5E_TX_FETCH_WQE(sq, pi);
+	mlx5e_txwqe_build_eseg(priv, sq, skb, &accel, &wqe->eth, attr.ihs);
+	mlx5e_sq_xmit_wqe(sq, skb, &attr, &wqe_attr, wqe, pi, false);
+
+	netif_tx_unlock_oob(txq);
+
+	return NETDEV_TX_OK;
+
+unlock_drop:
+	netif_tx_unlock_oob(txq);
+drop:
+	dev_kfree_skb_any(skb);
+
+	return NETDEV_TX_OK;
+}
+
+#endif
+
 netdev_tx_t mlx5e_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct mlx5e_priv *priv = netdev_priv(dev);
@@ -682,6 +783,11 @@ netdev_tx_t mlx5e_xmit(struct sk_buff *skb, struct net_device *dev)
 	struct mlx5e_txqsq *sq;
 	u16 pi;
 
+#ifdef CONFIG_NET_OOB
+	if (net_running_oob())
+		return mlx5e_xmit_oob(skb, dev);
+#endif
+
 	/* All changes to txq2sq are performed in sync with mlx5e_xmit, when the
 	 * queue being changed is disabled, and smp_wmb guarantees that the
 	 * changes are visible before mlx5e_xmit tries to read from txq2sq. It
@@ -867,7 +973,8 @@ bool mlx5e_poll_tx_cq(struct mlx5e_cq *cq, int napi_budget)
 				mlx5e_dump_error_cqe(&sq->cq, sq->sqn,
 						     (struct mlx5_err_cqe *)cqe);
 				mlx5_wq_cyc_wqe_dump(&sq->wq, ci, wi->num_wqebbs);
-				queue_work(cq->workqueue, &sq->recover_work);
+				mlx5e_queue_recover_work(sq->channel, cq->workqueue,
+							 &sq->recover_work);
 			}
 			stats->cqe_err++;
 		}
@@ -884,9 +991,11 @@ bool mlx5e_poll_tx_cq(struct mlx5e_cq *cq, int napi_budget)
 	sq->dma_fifo_cc = dma_fifo_cc;
 	sq->cc = sqcc;
 
-	netdev_tx_completed_queue(sq->txq, npkts, nbytes);
-
-	mlx5e_txqsq_wake(sq);
+	/* Oob SQs are not flow controlled by the stack. */
+	if (!mlx5e_txqsq_is_oob(sq)) {
+		netdev_tx_completed_queue(sq->txq, npkts, nbytes);
+		mlx5e_txqsq_wake(sq);
+	}
 
 	return (i == MLX5E_TX_CQ_POLL_BUDGET);
 }
@@ -172,6 +172,46 @@ static u64 icss_iep_gettime(struct icss_iep *iep,
 	return (u64)ts_lo | (u64)ts_hi << 32;
 }
 
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+
+/*
+ * Same as icss_iep_gettime(), callable from the out-of-band stage.
+ * This runs locklessly with respect to ptp_clk_mutex, so a reader
+ * racing with a clock step from the in-band stage may observe the
+ * counter value from either side of that step. Hard irqs must be
+ * disabled across the counter read since COUNT_REG1 is latched by
+ * reading COUNT_REG0.
+ */
+static int icss_iep_gettime_oob(struct icss_iep *iep, u64 *ns,
+				struct ptp_system_timestamp *sts)
+{
+	u32 ts_hi = 0, ts_lo;
+	unsigned long flags;
+
+	if (iep->ops) {
+		if (!iep->ops->gettime_oob)
+			return -EOPNOTSUPP;
+		*ns = iep->ops->gettime_oob(iep->clockops_data, sts);
+		return 0;
+	}
+
+	flags = hard_local_irq_save();
+
+	ptp_read_system_prets_oob(sts);
+	ts_lo = readl(iep->base + iep->plat_data->reg_offs[ICSS_IEP_COUNT_REG0]);
+	ptp_read_system_postts_oob(sts);
+	if (iep->plat_data->flags & ICSS_IEP_64BIT_COUNTER_SUPPORT)
+		ts_hi = readl(iep->base + iep->plat_data->reg_offs[ICSS_IEP_COUNT_REG1]);
+
+	hard_local_irq_restore(flags);
+
+	*ns = (u64)ts_lo | (u64)ts_hi << 32;
+
+	return 0;
+}
+
+#endif
+
 static void icss_iep_enable(struct icss_iep *iep)
 {
 	regmap_update_bits(iep->map, ICSS_IEP_GLOBAL_CFG_REG,
@@ -367,6 +407,27 @@ static int icss_iep_ptp_gettimeex(struct ptp_clock_info *ptp,
 	return 0;
 }
 
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+
+static int icss_iep_ptp_gettimex_oob(struct ptp_clock_info *ptp,
+				     struct timespec64 *ts,
+				     struct ptp_system_timestamp *sts)
+{
+	struct icss_iep *iep = container_of(ptp, struct icss_iep, ptp_info);
+	u64 ns;
+	int ret;
+
+	ret = icss_iep_gettime_oob(iep, &ns, sts);
+	if (ret)
+		return ret;
+
+	*ts = ns_to_timespec64(ns);
+
+	return 0;
+}
+
+#endif
+
 static int icss_iep_ptp_settime(struct ptp_clock_info *ptp,
 				const struct timespec64 *ts)
 {
@@ -626,6 +687,9 @@ static struct ptp_clock_info icss_iep_ptp_info = {
 	.adjfine	= icss_iep_ptp_adjfine,
 	.adjtime	= icss_iep_ptp_adjtime,
 	.gettimex64	= icss_iep_ptp_gettimeex,
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+	.gettimex64_oob	= icss_iep_ptp_gettimex_oob,
+#endif
 	.settime64	= icss_iep_ptp_settime,
 	.enable		= icss_iep_ptp_enable,
 };
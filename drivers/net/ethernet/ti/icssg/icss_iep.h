@@ -91,6 +91,10 @@ struct icss_iep_clockops {
 	void (*settime)(void *clockops_data, u64 ns);
 	void (*adjtime)(void *clockops_data, s64 delta);
 	u64 (*gettime)(void *clockops_data, struct ptp_system_timestamp *sts);
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+	/* Same as gettime, callable from the out-of-band stage. */
+	u64 (*gettime_oob)(void *clockops_data, struct ptp_system_timestamp *sts);
+#endif
 	int (*perout_enable)(void *clockops_data,
 			     struct ptp_perout_request *req, int on,
 			     u64 *cmp);
@@ -18,6 +18,7 @@
 #include <linux/remoteproc/pruss.h>
 #include <linux/regmap.h>
 #include <linux/remoteproc.h>
+#include <net/page_pool/helpers.h>
 
 #include "icssg_prueth.h"
 #include "../k3-cppi-desc-pool.h"
@@ -50,6 +51,13 @@ void prueth_cleanup_rx_chns(struct prueth_emac *emac,
 
 	if (rx_chn->rx_chn)
 		k3_udma_glue_release_rx_chn(rx_chn->rx_chn);
+
+#ifdef CONFIG_NET_OOB
+	if (rx_chn->pg_pool) {
+		page_pool_destroy(rx_chn->pg_pool);
+		rx_chn->pg_pool = NULL;
+	}
+#endif
 }
 EXPORT_SYMBOL_GPL(prueth_cleanup_rx_chns);
 
@@ -84,6 +92,9 @@ void prueth_ndev_del_tx_napi(struct prueth_emac *emac, int num)
 		if (tx_chn->irq)
 			free_irq(tx_chn->irq, tx_chn);
 		netif_napi_del(&tx_chn->napi_tx);
+#ifdef CONFIG_NET_OOB
+		irq_work_sync(&tx_chn->oob_relay);
+#endif
 	}
 }
 EXPORT_SYMBOL_GPL(prueth_ndev_del_tx_napi);
@@ -94,6 +105,7 @@ void prueth_xmit_free(struct prueth_tx_chn *tx_chn,
 	struct cppi5_host_desc_t *first_desc, *next_desc;
 	dma_addr_t buf_dma, next_desc_dma;
 	u32 buf_dma_len;
+	void **swdata;
 
 	first_desc = desc;
 	next_desc = first_desc;
@@ -101,8 +113,11 @@ void prueth_xmit_free(struct prueth_tx_chn *tx_chn,
 	cppi5_hdesc_get_obuf(first_desc, &buf_dma, &buf_dma_len);
 	k3_udma_glue_tx_cppi5_to_dma_addr(tx_chn->tx_chn, &buf_dma);
 
-	dma_unmap_single(tx_chn->dma_dev, buf_dma, buf_dma_len,
-			 DMA_TO_DEVICE);
+	/* Buffers from the oob pool are premapped, see prueth_tx_map_head() */
+	swdata = cppi5_hdesc_get_swdata(first_desc);
+	if (!swdata[1])
+		dma_unmap_single(tx_chn->dma_dev, buf_dma, buf_dma_len,
+				 DMA_TO_DEVICE);
 
 	next_desc_dma = cppi5_hdesc_get_next_hbdesc(first_desc);
 	k3_udma_glue_tx_cppi5_to_dma_addr(tx_chn->tx_chn, &next_desc_dma);
@@ -125,12 +140,95 @@ void prueth_xmit_free(struct prueth_tx_chn *tx_chn,
 }
 EXPORT_SYMBOL_GPL(prueth_xmit_free);
 
+static void emac_tx_complete_queue(struct prueth_emac *emac,
+				   struct prueth_tx_chn *tx_chn,
+				   int num_tx, unsigned int total_bytes)
+{
+	struct net_device *ndev = emac->ndev;
+	struct netdev_queue *netif_txq;
+
+	netif_txq = netdev_get_tx_queue(ndev, tx_chn->id);
+	netdev_tx_completed_queue(netif_txq, num_tx, total_bytes);
+
+	if (netif_tx_queue_stopped(netif_txq)) {
+		/* If the TX queue was stopped, wake it now
+		 * if we have enough room.
+		 */
+		__netif_tx_lock(netif_txq, smp_processor_id());
+		if (netif_running(ndev) &&
+		    (k3_cppi_desc_pool_avail(tx_chn->desc_pool) >=
+		     MAX_SKB_FRAGS))
+			netif_tx_wake_queue(netif_txq);
+		__netif_tx_unlock(netif_txq);
+	}
+}
+
+#ifdef CONFIG_NET_OOB
+
+/*
+ * The oob stage cannot complete the in-band side of TX processing
+ * (BQL, queue wakeup, teardown completion), so it leaves it to this
+ * irq_work. Since we run in hard irq context, the queue lock cannot
+ * be taken; the wakeup relies on the barrier issued by
+ * icssg_ndo_start_xmit() after stopping the queue instead.
+ */
+static void emac_tx_oob_relay(struct irq_work *work)
+{
+	struct prueth_tx_chn *tx_chn =
+			container_of(work, struct prueth_tx_chn, oob_relay);
+	struct prueth_emac *emac = tx_chn->emac;
+	struct net_device *ndev = emac->ndev;
+	struct netdev_queue *netif_txq;
+	unsigned int total_bytes;
+	int num_tx;
+
+	num_tx = atomic_xchg(&tx_chn->oob_done_pkts, 0);
+	total_bytes = atomic_xchg(&tx_chn->oob_done_bytes, 0);
+	netif_txq = netdev_get_tx_queue(ndev, tx_chn->id);
+
+	if (num_tx)
+		netdev_tx_completed_queue(netif_txq, num_tx, total_bytes);
+
+	if (netif_tx_queue_stopped(netif_txq) && netif_running(ndev) &&
+	    k3_cppi_desc_pool_avail(tx_chn->desc_pool) >= MAX_SKB_FRAGS)
+		netif_tx_wake_queue(netif_txq);
+
+	if (atomic_xchg(&tx_chn->oob_tdown, 0))
+		complete(&emac->tdown_complete);
+}
+
+static void emac_tx_relay_oob(struct prueth_tx_chn *tx_chn,
+			      int num_tx, unsigned int total_bytes)
+{
+	atomic_add(num_tx, &tx_chn->oob_done_pkts);
+	atomic_add(total_bytes, &tx_chn->oob_done_bytes);
+	irq_work_queue(&tx_chn->oob_relay);
+}
+
+static void emac_tx_tdown_oob(struct prueth_tx_chn *tx_chn)
+{
+	atomic_set(&tx_chn->oob_tdown, 1);
+	irq_work_queue(&tx_chn->oob_relay);
+}
+
+#else
+
+static inline void emac_tx_relay_oob(struct prueth_tx_chn *tx_chn,
+				     int num_tx, unsigned int total_bytes)
+{
+}
+
+static inline void emac_tx_tdown_oob(struct prueth_tx_chn *tx_chn)
+{
+}
+
+#endif
+
 int emac_tx_complete_packets(struct prueth_emac *emac, int chn,
 			     int budget, bool *tdown)
 {
 	struct net_device *ndev = emac->ndev;
 	struct cppi5_host_desc_t *desc_tx;
-	struct netdev_queue *netif_txq;
 	struct prueth_tx_chn *tx_chn;
 	unsigned int total_bytes = 0;
 	struct sk_buff *skb;
@@ -147,8 +245,12 @@ int emac_tx_complete_packets(struct prueth_emac *emac, int chn,
 
 		/* teardown completion */
 		if (cppi5_desc_is_tdcm(desc_dma)) {
-			if (atomic_dec_and_test(&emac->tdown_cnt))
-				complete(&emac->tdown_complete);
+			if (atomic_dec_and_test(&emac->tdown_cnt)) {
+				if (net_running_oob())
+					emac_tx_tdown_oob(tx_chn);
+				else
+					complete(&emac->tdown_complete);
+			}
 			*tdown = true;
 			break;
 		}
@@ -177,20 +279,10 @@ int emac_tx_complete_packets(struct prueth_emac *emac, int chn,
 	if (!num_tx)
 		return 0;
 
-	netif_txq = netdev_get_tx_queue(ndev, chn);
-	netdev_tx_completed_queue(netif_txq, num_tx, total_bytes);
-
-	if (netif_tx_queue_stopped(netif_txq)) {
-		/* If the TX queue was stopped, wake it now
-		 * if we have enough room.
-		 */
-		__netif_tx_lock(netif_txq, smp_processor_id());
-		if (netif_running(ndev) &&
-		    (k3_cppi_desc_pool_avail(tx_chn->desc_pool) >=
-		     MAX_SKB_FRAGS))
-			netif_tx_wake_queue(netif_txq);
-		__netif_tx_unlock(netif_txq);
-	}
+	if (net_running_oob())
+		emac_tx_relay_oob(tx_chn, num_tx, total_bytes);
+	else
+		emac_tx_complete_queue(emac, tx_chn, num_tx, total_bytes);
 
 	return num_tx;
 }
@@ -217,8 +309,10 @@ static int emac_napi_tx_poll(struct napi_struct *napi_tx, int budget)
 	if (num_tx_packets >= budget)
 		return budget;
 
+	/* No hrtimer may be armed from the oob stage, skip pacing. */
 	if (napi_complete_done(napi_tx, num_tx_packets)) {
-		if (unlikely(tx_chn->tx_pace_timeout_ns && !tdown)) {
+		if (unlikely(tx_chn->tx_pace_timeout_ns && !tdown &&
+			     !net_running_oob())) {
 			hrtimer_start(&tx_chn->tx_hrtimer,
 				      ns_to_ktime(tx_chn->tx_pace_timeout_ns),
 				      HRTIMER_MODE_REL_PINNED);
@@ -230,6 +324,11 @@ static int emac_napi_tx_poll(struct napi_struct *napi_tx, int budget)
 	return num_tx_packets;
 }
 
+/*
+ * This handler and prueth_rx_irq() run from the oob stage while the
+ * port is diverted (IRQF_OOB), napi_schedule() then hands the poll
+ * over to an EVL RX lane.
+ */
 static irqreturn_t prueth_tx_irq(int irq, void *dev_id)
 {
 	struct prueth_tx_chn *tx_chn = dev_id;
@@ -252,9 +351,12 @@ int prueth_ndev_add_tx_napi(struct prueth_emac *emac)
 		hrtimer_init(&tx_chn->tx_hrtimer, CLOCK_MONOTONIC,
 			     HRTIMER_MODE_REL_PINNED);
 		tx_chn->tx_hrtimer.function = &emac_tx_timer_callback;
+#ifdef CONFIG_NET_OOB
+		init_irq_work(&tx_chn->oob_relay, emac_tx_oob_relay);
+#endif
 		ret = request_irq(tx_chn->irq, prueth_tx_irq,
-				  IRQF_TRIGGER_HIGH, tx_chn->name,
-				  tx_chn);
+				  IRQF_TRIGGER_HIGH | prueth_oob_irqflags(emac),
+				  tx_chn->name, tx_chn);
 		if (ret) {
 			netif_napi_del(&tx_chn->napi_tx);
 			dev_err(prueth->dev, "unable to request TX IRQ %d\n",
@@ -499,6 +601,160 @@ int prueth_dma_rx_push(struct prueth_emac *emac,
 }
 EXPORT_SYMBOL_GPL(prueth_dma_rx_push);
 
+#ifdef CONFIG_NET_OOB
+
+/*
+ * When the port may run the oob datapath, RX buffers come from a
+ * page pool which the oob stage can draw from: all pages are
+ * allocated and DMA mapped upfront, the pool has no slow path. Twice
+ * the ring size leaves room for the packets which are still held by
+ * the stacks while the ring is refilled.
+ */
+int prueth_create_rx_page_pool(struct prueth_emac *emac,
+			       struct prueth_rx_chn *rx_chn)
+{
+	struct page_pool_params pp_params = {
+		.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV |
+			 PP_FLAG_PAGE_OOB,
+		.order = 0,
+		.pool_size = rx_chn->descs_num * 2,
+		.nid = dev_to_node(emac->prueth->dev),
+		.dev = rx_chn->dma_dev,
+		.dma_dir = DMA_FROM_DEVICE,
+		.offset = PRUETH_RX_HEADROOM,
+		.max_len = PRUETH_MAX_PKT_SIZE,
+		.netdev = emac->ndev,
+	};
+	struct page_pool *pool;
+
+	pool = page_pool_create(&pp_params);
+	if (IS_ERR(pool))
+		return PTR_ERR(pool);
+
+	rx_chn->pg_pool = pool;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(prueth_create_rx_page_pool);
+
+static int prueth_dma_rx_push_page(struct prueth_emac *emac,
+				   struct page *page,
+				   struct prueth_rx_chn *rx_chn)
+{
+	struct net_device *ndev = emac->ndev;
+	struct cppi5_host_desc_t *desc_rx;
+	u32 buf_len = PRUETH_MAX_PKT_SIZE;
+	dma_addr_t desc_dma;
+	dma_addr_t buf_dma;
+	void **swdata;
+
+	desc_rx = k3_cppi_desc_pool_alloc(rx_chn->desc_pool);
+	if (!desc_rx) {
+		netdev_err(ndev, "rx push: failed to allocate descriptor\n");
+		return -ENOMEM;
+	}
+	desc_dma = k3_cppi_desc_pool_virt2dma(rx_chn->desc_pool, desc_rx);
+
+	/* The page stays mapped as long as it belongs to the pool. */
+	buf_dma = page_pool_get_dma_addr(page) + PRUETH_RX_HEADROOM;
+
+	cppi5_hdesc_init(desc_rx, CPPI5_INFO0_HDESC_EPIB_PRESENT,
+			 PRUETH_NAV_PS_DATA_SIZE);
+	k3_udma_glue_rx_dma_to_cppi5_addr(rx_chn->rx_chn, &buf_dma);
+	cppi5_hdesc_attach_buf(desc_rx, buf_dma, buf_len, buf_dma, buf_len);
+
+	swdata = cppi5_hdesc_get_swdata(desc_rx);
+	*swdata = page;
+
+	return k3_udma_glue_push_rx_chn(rx_chn->rx_chn, 0,
+					desc_rx, desc_dma);
+}
+
+/*
+ * Receive a frame into a page from the RX pool, from either
+ * stage. GRO knows nothing about oob diversion, so frames go through
+ * netif_receive_skb() when the port is diverted, which hands them
+ * over to the oob stack first.
+ */
+static int emac_rx_page(struct prueth_emac *emac,
+			struct prueth_rx_chn *rx_chn,
+			struct cppi5_host_desc_t *desc_rx)
+{
+	struct net_device *ndev = emac->ndev;
+	u32 buf_dma_len, pkt_len;
+	struct page *page, *new_page;
+	struct sk_buff *skb;
+	dma_addr_t buf_dma;
+	void **swdata;
+	u32 *psdata;
+	int ret;
+
+	swdata = cppi5_hdesc_get_swdata(desc_rx);
+	page = *swdata;
+	psdata = cppi5_hdesc_get_psdata(desc_rx);
+
+	cppi5_hdesc_get_obuf(desc_rx, &buf_dma, &buf_dma_len);
+	k3_udma_glue_rx_cppi5_to_dma_addr(rx_chn->rx_chn, &buf_dma);
+	pkt_len = cppi5_hdesc_get_pktlen(desc_rx);
+	/* firmware adds 4 CRC bytes, strip them */
+	pkt_len -= 4;
+
+	dma_sync_single_for_cpu(rx_chn->dma_dev, buf_dma, pkt_len,
+				DMA_FROM_DEVICE);
+
+	new_page = page_pool_dev_alloc_pages(rx_chn->pg_pool);
+	/* if the pool is exhausted we drop the packet but push the
+	 * descriptor back to the ring with the old page to prevent a
+	 * stall
+	 */
+	if (!new_page) {
+		ndev->stats.rx_dropped++;
+		new_page = page;
+		goto requeue;
+	}
+
+	skb = build_skb(page_address(page), PAGE_SIZE);
+	if (!skb) {
+		ndev->stats.rx_dropped++;
+		page_pool_put_full_page(rx_chn->pg_pool, page, false);
+		goto requeue;
+	}
+
+	skb_mark_for_recycle(skb);
+	skb_reserve(skb, PRUETH_RX_HEADROOM);
+	skb_put(skb, pkt_len);
+	skb->dev = ndev;
+
+	/* RX HW timestamp */
+	if (emac->rx_ts_enabled)
+		emac_rx_timestamp(emac, skb, psdata);
+
+	if (emac->prueth->is_switch_mode)
+		skb->offload_fwd_mark = emac->offload_fwd_mark;
+	skb->protocol = eth_type_trans(skb, ndev);
+	ndev->stats.rx_bytes += pkt_len;
+	ndev->stats.rx_packets++;
+
+	if (netif_oob_diversion(ndev))
+		netif_receive_skb(skb);
+	else
+		napi_gro_receive(&emac->napi_rx, skb);
+requeue:
+	k3_cppi_desc_pool_free(rx_chn->desc_pool, desc_rx);
+
+	/* queue another RX DMA */
+	ret = prueth_dma_rx_push_page(emac, new_page, rx_chn);
+	if (WARN_ON(ret < 0)) {
+		page_pool_put_full_page(rx_chn->pg_pool, new_page, false);
+		ndev->stats.rx_errors++;
+		ndev->stats.rx_dropped++;
+	}
+
+	return ret;
+}
+
+#endif /* CONFIG_NET_OOB */
+
 u64 icssg_ts_to_ns(u32 hi_sw, u32 hi, u32 lo, u32 cycle_time_ns)
 {
 	u32 iepcount_lo, iepcount_hi, hi_rollover_count;
@@ -559,6 +815,11 @@ static int emac_rx_packet(struct prueth_emac *emac, u32 flow_id)
 
 	desc_rx = k3_cppi_desc_pool_dma2virt(rx_chn->desc_pool, desc_dma);
 
+#ifdef CONFIG_NET_OOB
+	if (rx_chn->pg_pool)
+		return emac_rx_page(emac, rx_chn, desc_rx);
+#endif
+
 	swdata = cppi5_hdesc_get_swdata(desc_rx);
 	skb = *swdata;
 
@@ -618,6 +879,15 @@ static void prueth_rx_cleanup(void *data, dma_addr_t desc_dma)
 
 	desc_rx = k3_cppi_desc_pool_dma2virt(rx_chn->desc_pool, desc_dma);
 	swdata = cppi5_hdesc_get_swdata(desc_rx);
+
+#ifdef CONFIG_NET_OOB
+	if (rx_chn->pg_pool) {
+		page_pool_put_full_page(rx_chn->pg_pool, *swdata, false);
+		k3_cppi_desc_pool_free(rx_chn->desc_pool, desc_rx);
+		return;
+	}
+#endif
+
 	skb = *swdata;
 	cppi5_hdesc_get_obuf(desc_rx, &buf_dma, &buf_dma_len);
 	k3_udma_glue_rx_cppi5_to_dma_addr(rx_chn->rx_chn, &buf_dma);
@@ -644,19 +914,37 @@ static int prueth_tx_ts_cookie_get(struct prueth_emac *emac)
 	return -EBUSY;
 }
 
-/**
- * icssg_ndo_start_xmit - EMAC Transmit function
- * @skb: SKB pointer
- * @ndev: EMAC network adapter
- *
- * Called by the system to transmit a packet  - we queue the packet in
- * EMAC hardware transmit queue
- * Doesn't wait for completion we'll check for TX completion in
- * emac_tx_complete_packets().
- *
- * Return: enum netdev_tx
+/*
+ * Buffers from the EVL pool of an oob-capable port are premapped,
+ * only the cache needs syncing before the UDMA may fetch them. On
+ * K3, ICSSG and its UDMA share the same view of memory, so the
+ * address obtained on behalf of the PRUSS device is valid for the
+ * latter too. Any other buffer cannot be mapped from the oob stage.
  */
-enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev)
+static dma_addr_t prueth_tx_map_head(struct prueth_tx_chn *tx_chn,
+				     struct sk_buff *skb, u32 len,
+				     bool premapped)
+{
+	dma_addr_t buf_dma;
+
+	if (premapped) {
+		buf_dma = skb_oob_storage_addr(skb);
+		if (buf_dma == DMA_MAPPING_ERROR)
+			return buf_dma;
+
+		buf_dma += skb_headroom(skb);
+		dma_sync_single_for_device(tx_chn->dma_dev, buf_dma, len,
+					   DMA_TO_DEVICE);
+		return buf_dma;
+	}
+
+	if (net_running_oob())
+		return DMA_MAPPING_ERROR;
+
+	return dma_map_single(tx_chn->dma_dev, skb->data, len, DMA_TO_DEVICE);
+}
+
+static enum netdev_tx emac_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 {
 	struct cppi5_host_desc_t *first_desc, *next_desc, *cur_desc;
 	struct prueth_emac *emac = netdev_priv(ndev);
@@ -667,6 +955,7 @@ enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev
 	u32 pkt_len, dst_tag_id;
 	int i, ret = 0, q_idx;
 	bool in_tx_ts = 0;
+	bool premapped;
 	int tx_ts_cookie;
 	void **swdata;
 	u32 *epib;
@@ -677,8 +966,15 @@ enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev
 	tx_chn = &emac->tx_chns[q_idx];
 	netif_txq = netdev_get_tx_queue(ndev, q_idx);
 
+	/* Paged buffers cannot be mapped from the oob stage. */
+	premapped = netdev_is_oob_capable(ndev) && skb_has_oob_storage(skb);
+	if (net_running_oob() && skb_shinfo(skb)->nr_frags) {
+		ret = NETDEV_TX_OK;
+		goto drop_free_skb;
+	}
+
 	/* Map the linear buffer */
-	buf_dma = dma_map_single(tx_chn->dma_dev, skb->data, pkt_len, DMA_TO_DEVICE);
+	buf_dma = prueth_tx_map_head(tx_chn, skb, pkt_len, premapped);
 	if (dma_mapping_error(tx_chn->dma_dev, buf_dma)) {
 		netdev_err(ndev, "tx: failed to map skb buffer\n");
 		ret = NETDEV_TX_OK;
@@ -688,7 +984,9 @@ enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev
 	first_desc = k3_cppi_desc_pool_alloc(tx_chn->desc_pool);
 	if (!first_desc) {
 		netdev_dbg(ndev, "tx: failed to allocate descriptor\n");
-		dma_unmap_single(tx_chn->dma_dev, buf_dma, pkt_len, DMA_TO_DEVICE);
+		if (!premapped)
+			dma_unmap_single(tx_chn->dma_dev, buf_dma, pkt_len,
+					 DMA_TO_DEVICE);
 		goto drop_stop_q_busy;
 	}
 
@@ -698,8 +996,9 @@ enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev
 	epib = first_desc->epib;
 	epib[0] = 0;
 	epib[1] = 0;
+	/* TX timestamps are reported from the in-band stage only. */
 	if (skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP &&
-	    emac->tx_ts_enabled) {
+	    emac->tx_ts_enabled && !net_running_oob()) {
 		tx_ts_cookie = prueth_tx_ts_cookie_get(emac);
 		if (tx_ts_cookie >= 0) {
 			skb_shinfo(skb)->tx_flags |= SKBTX_IN_PROGRESS;
@@ -730,7 +1029,8 @@ enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev
 	k3_udma_glue_tx_dma_to_cppi5_addr(tx_chn->tx_chn, &buf_dma);
 	cppi5_hdesc_attach_buf(first_desc, buf_dma, pkt_len, buf_dma, pkt_len);
 	swdata = cppi5_hdesc_get_swdata(first_desc);
-	*swdata = skb;
+	swdata[0] = skb;
+	swdata[1] = (void *)(uintptr_t)premapped;
 
 	/* Handle the case where skb is fragmented in pages */
 	cur_desc = first_desc;
@@ -776,7 +1076,9 @@ enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev
 	desc_dma = k3_cppi_desc_pool_virt2dma(tx_chn->desc_pool, first_desc);
 	/* cppi5_desc_dump(first_desc, 64); */
 
-	skb_tx_timestamp(skb);  /* SW timestamp if SKBTX_IN_PROGRESS not set */
+	/* The oob stack reports its own SW timestamps */
+	if (!net_running_oob())
+		skb_tx_timestamp(skb);  /* SW timestamp if SKBTX_IN_PROGRESS not set */
 	ret = k3_udma_glue_push_tx_chn(tx_chn->tx_chn, first_desc, desc_dma);
 	if (ret) {
 		netdev_err(ndev, "tx: push failed: %d\n", ret);
@@ -792,8 +1094,12 @@ enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev
 		smp_mb__after_atomic();
 
 		if (k3_cppi_desc_pool_avail(tx_chn->desc_pool) >=
-		    MAX_SKB_FRAGS)
-			netif_tx_wake_queue(netif_txq);
+		    MAX_SKB_FRAGS) {
+			if (net_running_oob())
+				emac_tx_relay_oob(tx_chn, 0, 0);
+			else
+				netif_tx_wake_queue(netif_txq);
+		}
 	}
 
 	return NETDEV_TX_OK;
@@ -827,6 +1133,35 @@ drop_stop_q_busy:
 	netif_tx_stop_queue(netif_txq);
 	return NETDEV_TX_BUSY;
 }
+
+/**
+ * icssg_ndo_start_xmit - EMAC Transmit function
+ * @skb: SKB pointer
+ * @ndev: EMAC network adapter
+ *
+ * Called by the system to transmit a packet  - we queue the packet in
+ * EMAC hardware transmit queue
+ * Doesn't wait for completion we'll check for TX completion in
+ * emac_tx_complete_packets().
+ *
+ * With oob diversion enabled, the EVL TX handler may call us from
+ * the oob stage concurrently to the in-band stack, the stage
+ * exclusion lock of the queue serializes both.
+ *
+ * Return: enum netdev_tx
+ */
+enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev)
+{
+	struct netdev_queue *netif_txq;
+	enum netdev_tx ret;
+
+	netif_txq = netdev_get_tx_queue(ndev, skb_get_queue_mapping(skb));
+	netif_tx_lock_oob(netif_txq);
+	ret = emac_start_xmit(skb, ndev);
+	netif_tx_unlock_oob(netif_txq);
+
+	return ret;
+}
 EXPORT_SYMBOL_GPL(icssg_ndo_start_xmit);
 
 static void prueth_tx_cleanup(void *data, dma_addr_t desc_dma)
@@ -893,8 +1228,9 @@ int icssg_napi_rx_poll(struct napi_struct *napi_rx, int budget)
 			break;
 	}
 
+	/* No hrtimer may be armed from the oob stage, skip pacing. */
 	if (num_rx < budget && napi_complete_done(napi_rx, num_rx)) {
-		if (unlikely(emac->rx_pace_timeout_ns)) {
+		if (unlikely(emac->rx_pace_timeout_ns && !net_running_oob())) {
 			hrtimer_start(&emac->rx_hrtimer,
 				      ns_to_ktime(emac->rx_pace_timeout_ns),
 				      HRTIMER_MODE_REL_PINNED);
@@ -914,6 +1250,30 @@ int prueth_prepare_rx_chan(struct prueth_emac *emac,
 	struct sk_buff *skb;
 	int i, ret;
 
+#ifdef CONFIG_NET_OOB
+	if (chn->pg_pool) {
+		struct page *page;
+
+		for (i = 0; i < chn->descs_num; i++) {
+			page = page_pool_dev_alloc_pages(chn->pg_pool);
+			if (!page)
+				return -ENOMEM;
+
+			ret = prueth_dma_rx_push_page(emac, page, chn);
+			if (ret < 0) {
+				netdev_err(emac->ndev,
+					   "cannot submit page for rx chan %s ret %d\n",
+					   chn->name, ret);
+				page_pool_put_full_page(chn->pg_pool, page,
+							false);
+				return ret;
+			}
+		}
+
+		return 0;
+	}
+#endif
+
 	for (i = 0; i < chn->descs_num; i++) {
 		skb = __netdev_alloc_skb_ip_align(NULL, buf_size, GFP_KERNEL);
 		if (!skb)
@@ -420,36 +420,39 @@ static int emac_phy_connect(struct prueth_emac *emac)
 	return 0;
 }
 
-static u64 prueth_iep_gettime(void *clockops_data, struct ptp_system_timestamp *sts)
+static u64 __prueth_iep_gettime(struct prueth_emac *emac,
+				struct ptp_system_timestamp *sts, bool oob)
 {
 	u32 hi_rollover_count, hi_rollover_count_r;
-	struct prueth_emac *emac = clockops_data;
 	struct prueth *prueth = emac->prueth;
 	void __iomem *fw_hi_r_count_addr;
 	void __iomem *fw_count_hi_addr;
 	u32 iepcount_hi, iepcount_hi_r;
-	unsigned long flags;
 	u32 iepcount_lo;
 	u64 ts = 0;
 
 	fw_count_hi_addr = prueth->shram.va + TIMESYNC_FW_WC_COUNT_HI_SW_OFFSET_OFFSET;
 	fw_hi_r_count_addr = prueth->shram.va + TIMESYNC_FW_WC_HI_ROLLOVER_COUNT_OFFSET;
 
-	local_irq_save(flags);
 	do {
 		iepcount_hi = icss_iep_get_count_hi(emac->iep);
 		iepcount_hi += readl(fw_count_hi_addr);
 		hi_rollover_count = readl(fw_hi_r_count_addr);
-		ptp_read_system_prets(sts);
+		if (oob)
+			ptp_read_system_prets_oob(sts);
+		else
+			ptp_read_system_prets(sts);
 		iepcount_lo = icss_iep_get_count_low(emac->iep);
-		ptp_read_system_postts(sts);
+		if (oob)
+			ptp_read_system_postts_oob(sts);
+		else
+			ptp_read_system_postts(sts);
 
 		iepcount_hi_r = icss_iep_get_count_hi(emac->iep);
 		iepcount_hi_r += readl(fw_count_hi_addr);
 		hi_rollover_count_r = readl(fw_hi_r_count_addr);
 	} while ((iepcount_hi_r != iepcount_hi) ||
 		 (hi_rollover_count != hi_rollover_count_r));
-	local_irq_restore(flags);
 
 	ts = ((u64)hi_rollover_count) << 23 | iepcount_hi;
 	ts = ts * (u64)IEP_DEFAULT_CYCLE_TIME_NS + iepcount_lo;
@@ -457,6 +460,37 @@ static u64 prueth_iep_gettime(void *clockops_data, struct ptp_system_timestamp *
 	return ts;
 }
 
+static u64 prueth_iep_gettime(void *clockops_data, struct ptp_system_timestamp *sts)
+{
+	struct prueth_emac *emac = clockops_data;
+	unsigned long flags;
+	u64 ts;
+
+	local_irq_save(flags);
+	ts = __prueth_iep_gettime(emac, sts, false);
+	local_irq_restore(flags);
+
+	return ts;
+}
+
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+
+static u64 prueth_iep_gettime_oob(void *clockops_data,
+				  struct ptp_system_timestamp *sts)
+{
+	struct prueth_emac *emac = clockops_data;
+	unsigned long flags;
+	u64 ts;
+
+	flags = hard_local_irq_save();
+	ts = __prueth_iep_gettime(emac, sts, true);
+	hard_local_irq_restore(flags);
+
+	return ts;
+}
+
+#endif
+
 static void prueth_iep_settime(void *clockops_data, u64 ns)
 {
 	struct icssg_setclock_desc __iomem *sc_descp;
@@ -556,6 +590,9 @@ static int prueth_perout_enable(void *clockops_data,
 const struct icss_iep_clockops prueth_iep_clockops = {
 	.settime = prueth_iep_settime,
 	.gettime = prueth_iep_gettime,
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+	.gettime_oob = prueth_iep_gettime_oob,
+#endif
 	.perout_enable = prueth_perout_enable,
 };
 
@@ -740,6 +777,14 @@ static int emac_ndo_open(struct net_device *ndev)
 		goto cleanup_tx;
 	}
 
+#ifdef CONFIG_NET_OOB
+	ret = prueth_create_rx_page_pool(emac, &emac->rx_chns);
+	if (ret) {
+		dev_err(dev, "failed to create rx page pool: %d\n", ret);
+		goto cleanup_rx;
+	}
+#endif
+
 	ret = prueth_ndev_add_tx_napi(emac);
 	if (ret)
 		goto cleanup_rx;
@@ -747,7 +792,8 @@ static int emac_ndo_open(struct net_device *ndev)
 	/* we use only the highest priority flow for now i.e. @irq[3] */
 	rx_flow = PRUETH_RX_FLOW_DATA;
 	ret = request_irq(emac->rx_chns.irq[rx_flow], prueth_rx_irq,
-			  IRQF_TRIGGER_HIGH, dev_name(dev), emac);
+			  IRQF_TRIGGER_HIGH | prueth_oob_irqflags(emac),
+			  dev_name(dev), emac);
 	if (ret) {
 		dev_err(dev, "unable to request RX IRQ\n");
 		goto cleanup_napi;
@@ -1024,6 +1070,68 @@ static int emac_ndo_vlan_rx_del_vid(struct net_device *ndev,
 	return 0;
 }
 
+#ifdef CONFIG_NET_OOB
+
+/*
+ * Move the DMA interrupts of a running port to the oob stage, or
+ * back in-band. Any pending poll must have completed from the
+ * stage the interrupt belonged to before switching. The oob
+ * diversion flag is raised across the whole sequence by the core,
+ * so that polls completing from the oob stage meanwhile are
+ * released to the RX lanes.
+ */
+static void emac_switch_irqs_oob(struct prueth_emac *emac, bool on)
+{
+	unsigned int rx_irq = emac->rx_chns.irq[PRUETH_RX_FLOW_DATA];
+	struct prueth_tx_chn *tx_chn;
+	int i;
+
+	disable_irq(rx_irq);
+	napi_disable(&emac->napi_rx);
+	irq_switch_oob(rx_irq, on);
+	napi_enable(&emac->napi_rx);
+	enable_irq(rx_irq);
+
+	for (i = 0; i < emac->tx_ch_num; i++) {
+		tx_chn = &emac->tx_chns[i];
+		disable_irq(tx_chn->irq);
+		napi_disable(&tx_chn->napi_tx);
+		irq_switch_oob(tx_chn->irq, on);
+		napi_enable(&tx_chn->napi_tx);
+		enable_irq(tx_chn->irq);
+	}
+}
+
+/* rtnl_lock held */
+static int emac_ndo_enable_oob(struct net_device *ndev)
+{
+	struct prueth_emac *emac = netdev_priv(ndev);
+
+	/*
+	 * Interrupt pacing relies on hrtimers which the oob stage
+	 * cannot arm, it is ignored until oob is disabled.
+	 */
+	if (netif_running(ndev))
+		emac_switch_irqs_oob(emac, true);
+
+	emac->oob_mode = true;
+
+	return 0;
+}
+
+/* rtnl_lock held */
+static void emac_ndo_disable_oob(struct net_device *ndev)
+{
+	struct prueth_emac *emac = netdev_priv(ndev);
+
+	if (netif_running(ndev))
+		emac_switch_irqs_oob(emac, false);
+
+	emac->oob_mode = false;
+}
+
+#endif	/* CONFIG_NET_OOB */
+
 static const struct net_device_ops emac_netdev_ops = {
 	.ndo_open = emac_ndo_open,
 	.ndo_stop = emac_ndo_stop,
@@ -1038,6 +1146,10 @@ static const struct net_device_ops emac_netdev_ops = {
 	.ndo_fix_features = emac_ndo_fix_features,
 	.ndo_vlan_rx_add_vid = emac_ndo_vlan_rx_add_vid,
 	.ndo_vlan_rx_kill_vid = emac_ndo_vlan_rx_del_vid,
+#ifdef CONFIG_NET_OOB
+	.ndo_enable_oob = emac_ndo_enable_oob,
+	.ndo_disable_oob = emac_ndo_disable_oob,
+#endif
 };
 
 static int prueth_netdev_init(struct prueth *prueth,
@@ -1167,6 +1279,7 @@ static int prueth_netdev_init(struct prueth *prueth,
 	ndev->hw_features = NETIF_F_SG;
 	ndev->features = ndev->hw_features | NETIF_F_HW_VLAN_CTAG_FILTER;
 	ndev->hw_features |= NETIF_PRUETH_HSR_OFFLOAD_FEATURES;
+	netdev_set_oob_capable(ndev);
 
 	netif_napi_add(ndev, &emac->napi_rx, icssg_napi_rx_poll);
 	hrtimer_init(&emac->rx_hrtimer, CLOCK_MONOTONIC,
@@ -12,6 +12,7 @@
 #include <linux/genalloc.h>
 #include <linux/if_vlan.h>
 #include <linux/interrupt.h>
+#include <linux/irq_work.h>
 #include <linux/kernel.h>
 #include <linux/mfd/syscon.h>
 #include <linux/module.h>
@@ -121,6 +122,13 @@ struct prueth_tx_chn {
 	char name[32];
 	struct hrtimer tx_hrtimer;
 	unsigned long tx_pace_timeout_ns;
+#ifdef CONFIG_NET_OOB
+	/* TX completion work relayed from the oob stage */
+	struct irq_work oob_relay;
+	atomic_t oob_done_pkts;
+	atomic_t oob_done_bytes;
+	atomic_t oob_tdown;
+#endif
 };
 
 struct prueth_rx_chn {
@@ -131,6 +139,9 @@ struct prueth_rx_chn {
 	u32 descs_num;
 	unsigned int irq[ICSSG_MAX_RFLOWS];	/* separate irq per flow */
 	char name[32];
+#ifdef CONFIG_NET_OOB
+	struct page_pool *pg_pool;	/* oob-accessible RX buffers */
+#endif
 };
 
 /* There are 4 Tx DMA channels, but the highest priority is CH3 (thread 3)
@@ -208,6 +219,11 @@ struct prueth_emac {
 	unsigned long rx_pace_timeout_ns;
 
 	struct netdev_hw_addr_list vlan_mcast_list[MAX_VLAN_ID];
+
+#ifdef CONFIG_NET_OOB
+	/* Out-of-band datapath enabled (ndo_enable_oob) */
+	bool oob_mode;
+#endif
 };
 
 /**
@@ -392,6 +408,21 @@ int emac_fdb_flow_id_updated(struct prueth_emac *emac);
 #define prueth_napi_to_tx_chn(pnapi) \
 	container_of(pnapi, struct prueth_tx_chn, napi_tx)
 
+#ifdef CONFIG_NET_OOB
+/* RX buffers are built around pages from rx_chn->pg_pool */
+#define PRUETH_RX_HEADROOM	(NET_SKB_PAD + NET_IP_ALIGN)
+
+static inline unsigned long prueth_oob_irqflags(struct prueth_emac *emac)
+{
+	return emac->oob_mode ? IRQF_OOB : 0;
+}
+#else
+static inline unsigned long prueth_oob_irqflags(struct prueth_emac *emac)
+{
+	return 0;
+}
+#endif
+
 void icssg_stats_work_handler(struct work_struct *work);
 void emac_update_hardware_stats(struct prueth_emac *emac);
 int emac_get_stat_by_name(struct prueth_emac *emac, char *stat_name);
@@ -415,6 +446,10 @@ int prueth_init_rx_chns(struct prueth_emac *emac,
 int prueth_dma_rx_push(struct prueth_emac *emac,
 		       struct sk_buff *skb,
 		       struct prueth_rx_chn *rx_chn);
+#ifdef CONFIG_NET_OOB
+int prueth_create_rx_page_pool(struct prueth_emac *emac,
+			       struct prueth_rx_chn *rx_chn);
+#endif
 void emac_rx_timestamp(struct prueth_emac *emac,
 		       struct sk_buff *skb, u32 *psdata);
 enum netdev_tx icssg_ndo_start_xmit(struct sk_buff *skb, struct net_device *ndev);
@@ -476,6 +476,20 @@ int ptp_clock_index(struct ptp_clock *ptp)
 }
 EXPORT_SYMBOL(ptp_clock_index);
 
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+
+int ptp_clock_gettimex_oob(struct ptp_clock *ptp, struct timespec64 *ts,
+			   struct ptp_system_timestamp *sts)
+{
+	if (!ptp->info->gettimex64_oob)
+		return -EOPNOTSUPP;
+
+	return ptp->info->gettimex64_oob(ptp->info, ts, sts);
+}
+EXPORT_SYMBOL(ptp_clock_gettimex_oob);
+
+#endif
+
 int ptp_find_pin(struct ptp_clock *ptp,
 		 enum ptp_pin_function func, unsigned int chan)
 {
@@ -21,6 +21,7 @@
 #include <linux/err.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/irq.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/of.h>
@@ -116,6 +117,9 @@ MODULE_PARM_DESC(polling_limit_us,
  * @fill_tx_desc: preallocated TX DMA descriptor used for RX-only transfers
  *	(cyclically copies from zero page to TX FIFO)
  * @fill_tx_addr: bus address of zero page
+ * @oob_xfer: out-of-band transfer running a queue of frames
+ * @oob_frame: index of the frame currently sent from @oob_xfer
+ * @oob_cs: CS register value for sending the frames of @oob_xfer
  */
 struct bcm2835_spi {
 	void __iomem *regs;
@@ -144,6 +148,11 @@ struct bcm2835_spi {
 	unsigned int rx_dma_active;
 	struct dma_async_tx_descriptor *fill_tx_desc;
 	dma_addr_t fill_tx_addr;
+#ifdef CONFIG_SPI_BCM2835_OOB
+	struct spi_oob_transfer *oob_xfer;
+	unsigned int oob_frame;
+	u32 oob_cs;
+#endif
 };
 
 /**
@@ -371,11 +380,20 @@ static void bcm2835_spi_reset_hw(struct bcm2835_spi *bs)
 	bcm2835_wr(bs, BCM2835_SPI_DLEN, 0);
 }
 
+#ifdef CONFIG_SPI_BCM2835_OOB
+static irqreturn_t bcm2835_spi_oob_interrupt(struct bcm2835_spi *bs, u32 cs);
+#endif
+
 static irqreturn_t bcm2835_spi_interrupt(int irq, void *dev_id)
 {
 	struct bcm2835_spi *bs = dev_id;
 	u32 cs = bcm2835_rd(bs, BCM2835_SPI_CS);
 
+#ifdef CONFIG_SPI_BCM2835_OOB
+	if (bs->oob_xfer)
+		return bcm2835_spi_oob_interrupt(bs, cs);
+#endif
+
 	/* Bail out early if interrupts are not enabled */
 	if (!(cs & BCM2835_SPI_CS_INTR))
 		return IRQ_NONE;
@@ -1348,9 +1366,83 @@ err_cleanup:
 
 #ifdef CONFIG_SPI_BCM2835_OOB
 
+static void bcm2835_spi_load_oob_frame(struct bcm2835_spi *bs,
+				struct spi_oob_frame *frame)
+{
+	u32 effective_speed_hz;
+	unsigned long cdiv;
+
+	cdiv = bcm2835_get_clkdiv(bs, frame->speed_hz, &effective_speed_hz);
+	frame->effective_speed_hz = effective_speed_hz;
+	bcm2835_wr(bs, BCM2835_SPI_CLK, cdiv);
+	bcm2835_wr(bs, BCM2835_SPI_DLEN, frame->len);
+}
+
+/*
+ * Sequence the frames of a queue: the DONE interrupt signals the end
+ * of the current frame, at which point we load the settings of the
+ * next one, restarting the transfer. TX and RX DMA streams go on
+ * moving data, so the RX DMA completion still ends the whole queue.
+ */
+static irqreturn_t bcm2835_spi_oob_interrupt(struct bcm2835_spi *bs, u32 cs)
+{				/* oob stage */
+	struct spi_oob_transfer *xfer = bs->oob_xfer;
+
+	if (!(cs & BCM2835_SPI_CS_INTD) || !(cs & BCM2835_SPI_CS_DONE) ||
+		bcm2835_rd(bs, BCM2835_SPI_DLEN))
+		return IRQ_NONE;
+
+	if (++bs->oob_frame >= xfer->setup.nr_frames) {
+		/* Last frame sent, wait for the next pulse. */
+		bcm2835_wr(bs, BCM2835_SPI_CS, bs->oob_cs | BCM2835_SPI_CS_TA);
+		return IRQ_HANDLED;
+	}
+
+	bcm2835_wr(bs, BCM2835_SPI_CS, bs->oob_cs);
+	bcm2835_spi_load_oob_frame(bs, xfer->setup.frames + bs->oob_frame);
+	bcm2835_wr(bs, BCM2835_SPI_CS,
+		bs->oob_cs | BCM2835_SPI_CS_TA | BCM2835_SPI_CS_INTD);
+
+	return IRQ_HANDLED;
+}
+
+static int bcm2835_spi_prepare_oob_queue(struct spi_controller *ctlr,
+					struct spi_oob_transfer *xfer)
+{
+	struct bcm2835_spi *bs = spi_controller_get_devdata(ctlr);
+	struct spi_oob_frame *frame;
+	unsigned int n;
+	int ret;
+
+	/*
+	 * Chip selects are driven by GPIOs which we cannot switch
+	 * from the oob stage, so all frames must address the device
+	 * the transfer was prepared for.
+	 */
+	for (n = 0; n < xfer->setup.nr_frames; n++) {
+		frame = xfer->setup.frames + n;
+		if (frame->spi != xfer->spi)
+			return -ENOTSUPP;
+		if (frame->len > 65532)
+			return -EINVAL;
+	}
+
+	/* The DONE interrupt drives the queue, from the oob stage. */
+	ret = irq_switch_oob(bs->irq, true);
+	if (ret)
+		return ret;
+
+	bs->oob_xfer = xfer;
+
+	return 0;
+}
+
 static int bcm2835_spi_prepare_oob_transfer(struct spi_controller *ctlr,
 					struct spi_oob_transfer *xfer)
 {
+	if (xfer->setup.nr_frames)
+		return bcm2835_spi_prepare_oob_queue(ctlr, xfer);
+
 	/*
 	 * The size of a transfer is limited by DLEN which is 16-bit
 	 * wide, and we don't want to scatter transfers in out-of-band
@@ -1373,15 +1465,22 @@ static void bcm2835_spi_start_oob_transfer(struct spi_controller *ctlr,
 	/* See bcm2835_spi_prepare_message(). */
 	bcm2835_wr(bs, BCM2835_SPI_CS, cs);
 
-	cdiv = bcm2835_get_clkdiv(bs, xfer->setup.speed_hz, &effective_speed_hz);
-	xfer->effective_speed_hz = effective_speed_hz;
-	bcm2835_wr(bs, BCM2835_SPI_CLK, cdiv);
-	bcm2835_wr(bs, BCM2835_SPI_DLEN, xfer->setup.frame_len);
+	if (xfer->setup.nr_frames) {
+		bcm2835_spi_load_oob_frame(bs, xfer->setup.frames);
+		xfer->effective_speed_hz = xfer->setup.frames->effective_speed_hz;
+	} else {
+		cdiv = bcm2835_get_clkdiv(bs, xfer->setup.speed_hz,
+					&effective_speed_hz);
+		xfer->effective_speed_hz = effective_speed_hz;
+		bcm2835_wr(bs, BCM2835_SPI_CLK, cdiv);
+		bcm2835_wr(bs, BCM2835_SPI_DLEN, xfer->setup.frame_len);
+	}
 
 	if (spi->mode & SPI_3WIRE)
 		cs |= BCM2835_SPI_CS_REN;
-	bcm2835_wr(bs, BCM2835_SPI_CS,
-		   cs | BCM2835_SPI_CS_TA | BCM2835_SPI_CS_DMAEN);
+	cs |= BCM2835_SPI_CS_DMAEN;
+	bs->oob_cs = cs;
+	bcm2835_wr(bs, BCM2835_SPI_CS, cs | BCM2835_SPI_CS_TA);
 }
 
 static void bcm2835_spi_pulse_oob_transfer(struct spi_controller *ctlr,
@@ -1389,8 +1488,21 @@ static void bcm2835_spi_pulse_oob_transfer(struct spi_controller *ctlr,
 {
 	struct bcm2835_spi *bs = spi_controller_get_devdata(ctlr);
 
-	/* Reload DLEN for the next pulse. */
-	bcm2835_wr(bs, BCM2835_SPI_DLEN, xfer->setup.frame_len);
+	if (!xfer->setup.nr_frames) {
+		/* Reload DLEN for the next pulse. */
+		bcm2835_wr(bs, BCM2835_SPI_DLEN, xfer->setup.frame_len);
+		return;
+	}
+
+	/*
+	 * Restart from the first frame. Dropping TA clears DONE
+	 * which might still be set from the previous pulse.
+	 */
+	bs->oob_frame = 0;
+	bcm2835_wr(bs, BCM2835_SPI_CS, bs->oob_cs);
+	bcm2835_spi_load_oob_frame(bs, xfer->setup.frames);
+	bcm2835_wr(bs, BCM2835_SPI_CS,
+		bs->oob_cs | BCM2835_SPI_CS_TA | BCM2835_SPI_CS_INTD);
 }
 
 static void bcm2835_spi_terminate_oob_transfer(struct spi_controller *ctlr,
@@ -1399,6 +1511,11 @@ static void bcm2835_spi_terminate_oob_transfer(struct spi_controller *ctlr,
 	struct bcm2835_spi *bs = spi_controller_get_devdata(ctlr);
 
 	bcm2835_spi_reset_hw(bs);
+
+	if (bs->oob_xfer) {
+		irq_switch_oob(bs->irq, false);
+		bs->oob_xfer = NULL;
+	}
 }
 
 #else
@@ -1423,6 +1540,8 @@ static int bcm2835_spi_probe(struct platform_device *pdev)
 	ctlr->use_gpio_descriptors = true;
 	ctlr->mode_bits = BCM2835_SPI_MODE_BITS;
 	ctlr->bits_per_word_mask = SPI_BPW_MASK(8);
+	if (IS_ENABLED(CONFIG_SPI_BCM2835_OOB))
+		ctlr->flags |= SPI_CONTROLLER_OOB_QUEUE;
 	ctlr->num_chipselect = 3;
 	ctlr->max_transfer_size = bcm2835_spi_max_transfer_size;
 	ctlr->setup = bcm2835_spi_setup;
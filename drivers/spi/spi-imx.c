@@ -1452,6 +1452,23 @@ static int spi_imx_calculate_timeout(struct spi_imx_data *spi_imx, int size)
 	return msecs_to_jiffies(2 * timeout * MSEC_PER_SEC);
 }
 
+static void spi_imx_set_dma_wml(struct spi_imx_data *spi_imx,
+				unsigned int len, unsigned int bits_per_word)
+{
+	unsigned int bytes_per_word, i;
+
+	bytes_per_word = spi_imx_bytes_per_word(bits_per_word);
+	for (i = spi_imx->devtype_data->fifo_size / 2; i > 0; i--) {
+		if (!(len % (i * bytes_per_word)))
+			break;
+	}
+	/* Use 1 as wml in case no available burst length got */
+	if (i == 0)
+		i = 1;
+
+	spi_imx->wml =  i;
+}
+
 static int spi_imx_dma_transfer(struct spi_imx_data *spi_imx,
 				struct spi_transfer *transfer)
 {
@@ -1461,20 +1478,11 @@ static int spi_imx_dma_transfer(struct spi_imx_data *spi_imx,
 	struct spi_controller *controller = spi_imx->controller;
 	struct sg_table *tx = &transfer->tx_sg, *rx = &transfer->rx_sg;
 	struct scatterlist *last_sg = sg_last(rx->sgl, rx->nents);
-	unsigned int bytes_per_word, i;
 	int ret;
 
 	/* Get the right burst length from the last sg to ensure no tail data */
-	bytes_per_word = spi_imx_bytes_per_word(transfer->bits_per_word);
-	for (i = spi_imx->devtype_data->fifo_size / 2; i > 0; i--) {
-		if (!(sg_dma_len(last_sg) % (i * bytes_per_word)))
-			break;
-	}
-	/* Use 1 as wml in case no available burst length got */
-	if (i == 0)
-		i = 1;
-
-	spi_imx->wml =  i;
+	spi_imx_set_dma_wml(spi_imx, sg_dma_len(last_sg),
+			transfer->bits_per_word);
 
 	ret = spi_imx_dma_configure(controller);
 	if (ret)
@@ -1772,6 +1780,97 @@ static int spi_imx_target_abort(struct spi_controller *controller)
 	return 0;
 }
 
+#ifdef CONFIG_SPI_IMX_OOB
+
+static int spi_imx_prepare_oob_transfer(struct spi_controller *controller,
+					struct spi_oob_transfer *xfer)
+{
+	struct spi_imx_data *spi_imx = spi_controller_get_devdata(controller);
+	struct spi_device *spi = xfer->spi;
+	struct spi_transfer t = { };
+	struct spi_message msg;
+	int ret;
+
+	/*
+	 * The SDMA filling the TX FIFO starts every burst (SMC mode)
+	 * so that a pulse needs no CPU action on the controller, this
+	 * is safe only on parts with ERR009165 fixed.
+	 */
+	if (spi_imx->target_mode || !controller->dma_rx ||
+		!spi_imx->devtype_data->tx_glitch_fixed)
+		return -ENOTSUPP;
+
+	/* A frame must fit into a single SDMA buffer descriptor. */
+	if (xfer->setup.frame_len > MAX_SDMA_BD_BYTES ||
+		!xfer->setup.speed_hz)
+		return -EINVAL;
+
+	ret = pm_runtime_resume_and_get(spi_imx->dev);
+	if (ret < 0)
+		return ret;
+
+	t.len = xfer->setup.frame_len;
+	t.speed_hz = xfer->setup.speed_hz;
+	t.bits_per_word = xfer->setup.bits_per_word;
+	spi_message_init_with_transfers(&msg, &t, 1);
+	msg.spi = spi;
+
+	ret = spi_imx->devtype_data->prepare_message(spi_imx, &msg);
+	if (ret)
+		goto fail;
+
+	spi_imx->spi_bus_clk = t.speed_hz;
+	spi_imx->bits_per_word = t.bits_per_word;
+	spi_imx->dynamic_burst = 0;
+	spi_imx->rx_only = false;
+	spi_imx->usedma = true;
+	ret = spi_imx->devtype_data->prepare_transfer(spi_imx, spi, &t);
+	if (ret)
+		goto fail;
+
+	xfer->effective_speed_hz = spi_imx->spi_bus_clk;
+
+	spi_imx_set_dma_wml(spi_imx, t.len, t.bits_per_word);
+	ret = spi_imx_dma_configure(controller);
+	if (ret)
+		goto fail;
+
+	spi_imx->devtype_data->reset(spi_imx);
+
+	return 0;
+fail:
+	pm_runtime_mark_last_busy(spi_imx->dev);
+	pm_runtime_put_autosuspend(spi_imx->dev);
+
+	return ret;
+}
+
+static void spi_imx_start_oob_transfer(struct spi_controller *controller,
+				struct spi_oob_transfer *xfer)
+{
+	struct spi_imx_data *spi_imx = spi_controller_get_devdata(controller);
+
+	/* Enable DMA requests, the next pulse kicks the transfer. */
+	spi_imx->devtype_data->setup_wml(spi_imx);
+}
+
+static void spi_imx_terminate_oob_transfer(struct spi_controller *controller,
+					struct spi_oob_transfer *xfer)
+{
+	struct spi_imx_data *spi_imx = spi_controller_get_devdata(controller);
+
+	writel(0, spi_imx->base + MX51_ECSPI_DMA);
+	spi_imx->devtype_data->reset(spi_imx);
+	pm_runtime_mark_last_busy(spi_imx->dev);
+	pm_runtime_put_autosuspend(spi_imx->dev);
+}
+
+#else
+#define spi_imx_prepare_oob_transfer	NULL
+#define spi_imx_start_oob_transfer	NULL
+#define spi_imx_terminate_oob_transfer	NULL
+#endif
+
 static int spi_imx_probe(struct platform_device *pdev)
 {
 	struct device_node *np = pdev->dev.of_node;
@@ -1830,6 +1929,9 @@ static int spi_imx_probe(struct platform_device *pdev)
 	controller->prepare_message = spi_imx_prepare_message;
 	controller->unprepare_message = spi_imx_unprepare_message;
 	controller->target_abort = spi_imx_target_abort;
+	controller->prepare_oob_transfer = spi_imx_prepare_oob_transfer;
+	controller->start_oob_transfer = spi_imx_start_oob_transfer;
+	controller->terminate_oob_transfer = spi_imx_terminate_oob_transfer;
 	controller->mode_bits = SPI_CPOL | SPI_CPHA | SPI_CS_HIGH | SPI_NO_CS |
 				SPI_MOSI_IDLE_LOW;
 
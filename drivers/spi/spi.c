@@ -4859,6 +4859,85 @@ static void unprepare_oob_dma(struct spi_controller *ctlr)
 	dmaengine_terminate_sync(ctlr->dma_tx);
 }
 
+static int match_oob_frame_device(struct device *dev, const void *data)
+{
+	struct spi_device *spi = to_spi_device(dev);
+	const struct spi_oob_frame *frame = data;
+
+	return spi_get_chipselect(spi, 0) == frame->cs;
+}
+
+static void put_oob_frames(struct spi_oob_transfer *xfer)
+{
+	struct spi_oob_setup *p = &xfer->setup;
+	unsigned int n;
+
+	for (n = 0; n < p->nr_frames; n++) {
+		if (p->frames[n].spi) {
+			put_device(&p->frames[n].spi->dev);
+			p->frames[n].spi = NULL;
+		}
+	}
+}
+
+/*
+ * Resolve the target device of each frame from its chip select, then
+ * lay out the frames back-to-back. The frame length of the transfer
+ * becomes the length of the whole queue.
+ */
+static int validate_oob_frames(struct spi_controller *ctlr,
+			struct spi_oob_transfer *xfer, int w_size)
+{
+	struct spi_oob_setup *p = &xfer->setup;
+	struct spi_oob_frame *frame;
+	struct device *dev;
+	unsigned int n;
+	u64 len = 0;
+
+	if (!(ctlr->flags & SPI_CONTROLLER_OOB_QUEUE))
+		return -ENOTSUPP;
+
+	for (n = 0; n < p->nr_frames; n++) {
+		frame = p->frames + n;
+		frame->spi = NULL;
+		frame->effective_speed_hz = 0;
+		if (frame->len == 0 || frame->len % w_size)
+			goto fail;
+
+		if (frame->cs >= ctlr->num_chipselect)
+			goto fail;
+
+		dev = device_find_child(&ctlr->dev, frame,
+					match_oob_frame_device);
+		if (!dev)
+			goto fail;
+
+		frame->spi = to_spi_device(dev);
+		if (!frame->speed_hz)
+			frame->speed_hz = frame->spi->max_speed_hz;
+
+		if (ctlr->max_speed_hz && frame->speed_hz > ctlr->max_speed_hz)
+			frame->speed_hz = ctlr->max_speed_hz;
+
+		if (frame->speed_hz && ctlr->min_speed_hz &&
+			frame->speed_hz < ctlr->min_speed_hz)
+			goto fail;
+
+		frame->offset = len;
+		len += frame->len;
+		if (len > U32_MAX)
+			goto fail;
+	}
+
+	p->frame_len = len;
+
+	return 0;
+fail:
+	put_oob_frames(xfer);
+
+	return -EINVAL;
+}
+
 /*
  * A simpler version of __spi_validate() for oob transfers.
  */
@@ -4869,7 +4948,7 @@ static int validate_oob_xfer(struct spi_device *spi,
 	struct spi_oob_setup *p = &xfer->setup;
 	int w_size;
 
-	if (p->frame_len == 0)
+	if (p->nr_frames == 0 && p->frame_len == 0)
 		return -EINVAL;
 
 	if (!p->bits_per_word)
@@ -4891,13 +4970,17 @@ static int validate_oob_xfer(struct spi_device *spi,
 	else
 		w_size = 4;
 
-	if (p->frame_len % w_size)
-		return -EINVAL;
-
 	if (p->speed_hz && ctlr->min_speed_hz &&
 		p->speed_hz < ctlr->min_speed_hz)
 		return -EINVAL;
 
+	/* All frames of a queue share the DMA word size. */
+	if (p->nr_frames)
+		return validate_oob_frames(ctlr, xfer, w_size);
+
+	if (p->frame_len % w_size)
+		return -EINVAL;
+
 	return 0;
 }
 
@@ -4932,8 +5015,10 @@ int spi_prepare_oob_transfer(struct spi_device *spi,
 	iolen = alen * 2;
 	iobuf = dma_alloc_coherent(ctlr->dev.parent, iolen,
 				&dma_addr, GFP_KERNEL);
-	if (iobuf == NULL)
-		return -ENOMEM;
+	if (iobuf == NULL) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
 
 	xfer->spi = spi;
 	xfer->dma_addr = dma_addr;
@@ -4941,26 +5026,33 @@ int spi_prepare_oob_transfer(struct spi_device *spi,
 	xfer->aligned_frame_len = alen;
 	xfer->effective_speed_hz = 0;
 
-	ret = prepare_oob_dma(ctlr, xfer);
-	if (ret)
-		goto fail_prep_dma;
-
 	ret = bus_lock_oob(ctlr);
 	if (ret)
 		goto fail_bus_lock;
 
+	/*
+	 * The controller may have to configure the DMA channels, do
+	 * this before preparing the descriptors.
+	 */
 	ret = ctlr->prepare_oob_transfer(ctlr, xfer);
 	if (ret)
 		goto fail_prep_xfer;
 
+	ret = prepare_oob_dma(ctlr, xfer);
+	if (ret)
+		goto fail_prep_dma;
+
 	return 0;
 
+fail_prep_dma:
+	if (ctlr->terminate_oob_transfer)
+		ctlr->terminate_oob_transfer(ctlr, xfer);
 fail_prep_xfer:
 	bus_unlock_oob(ctlr);
 fail_bus_lock:
-	unprepare_oob_dma(ctlr);
-fail_prep_dma:
 	dma_free_coherent(ctlr->dev.parent, iolen, iobuf, dma_addr);
+fail_alloc:
+	put_oob_frames(xfer);
 
 	return ret;
 }
@@ -5004,6 +5096,7 @@ void spi_terminate_oob_transfer(struct spi_oob_transfer *xfer)
 	bus_unlock_oob(ctlr);
 	dma_free_coherent(ctlr->dev.parent, xfer->aligned_frame_len * 2,
 			xfer->io_buffer, xfer->dma_addr);
+	put_oob_frames(xfer);
 }
 EXPORT_SYMBOL_GPL(spi_terminate_oob_transfer);
 
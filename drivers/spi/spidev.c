@@ -26,6 +26,7 @@
 
 #include <linux/uaccess.h>
 #include <uapi/evl/devices/spidev.h>
+#include <evl/uaccess.h>
 #include <evl/device.h>
 
 /*
@@ -84,6 +85,7 @@ struct spidev_data {
 	struct {
 		struct evl_file	efile;
 		struct spi_oob_transfer xfer;
+		struct spi_oob_frame *frames;
 		struct evl_flag flag;
 		struct evl_ksem sem;
 		bool enabled;
@@ -396,6 +398,8 @@ static int enable_oob_mode(struct spidev_data *spidev,
 	xfer->setup.speed_hz = oob_setup.speed_hz;
 	xfer->setup.bits_per_word = oob_setup.bits_per_word;
 	xfer->setup.xfer_done = oob_transfer_done;
+	xfer->setup.frames = NULL;
+	xfer->setup.nr_frames = 0;
 	ret = spi_prepare_oob_transfer(spidev->spi, xfer);
 	if (ret)
 		goto out;
@@ -416,6 +420,97 @@ out:
 	return ret == -ENOTSUPP ? -EOPNOTSUPP : ret;
 }
 
+static int enable_oob_queue(struct spidev_data *spidev,
+			struct spi_ioc_oob_queue __user *u_ioc)
+{
+	struct spi_oob_transfer *xfer = &spidev->oob.xfer;
+	struct spi_ioc_oob_frame __user *u_frames;
+	struct spi_ioc_oob_queue oob_queue;
+	struct spi_ioc_oob_frame frame;
+	struct spi_oob_frame *frames;
+	unsigned int n;
+	int ret;
+
+	ret = evl_trydown(&spidev->oob.sem);
+	if (ret)
+		return ret;
+
+	if (spidev->oob.enabled) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (copy_from_user(&oob_queue, u_ioc, sizeof(oob_queue))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	if (!oob_queue.nr_frames || oob_queue.nr_frames > SPI_OOB_MAX_FRAMES) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	frames = kcalloc(oob_queue.nr_frames, sizeof(*frames), GFP_KERNEL);
+	if (!frames) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	u_frames = evl_valptr64(oob_queue.frames_ptr, struct spi_ioc_oob_frame);
+	for (n = 0; n < oob_queue.nr_frames; n++) {
+		if (copy_from_user(&frame, u_frames + n, sizeof(frame))) {
+			ret = -EFAULT;
+			goto fail;
+		}
+		frames[n].len = frame.len;
+		frames[n].speed_hz = frame.speed_hz;
+		frames[n].cs = frame.chip_select;
+	}
+
+	xfer->setup.speed_hz = 0;
+	xfer->setup.bits_per_word = oob_queue.bits_per_word;
+	xfer->setup.xfer_done = oob_transfer_done;
+	xfer->setup.frames = frames;
+	xfer->setup.nr_frames = oob_queue.nr_frames;
+	ret = spi_prepare_oob_transfer(spidev->spi, xfer);
+	if (ret)
+		goto fail;
+
+	evl_clear_flag(&spidev->oob.flag);
+	spi_start_oob_transfer(xfer);
+
+	for (n = 0; n < oob_queue.nr_frames; n++) {
+		if (put_user(frames[n].offset, &u_frames[n].offset) ||
+			put_user(frames[n].effective_speed_hz,
+				&u_frames[n].effective_speed_hz)) {
+			ret = -EFAULT;
+			goto fail_put;
+		}
+	}
+
+	if (put_user((__u32)spi_get_oob_txoff(xfer), &u_ioc->tx_offset) ||
+		put_user((__u32)spi_get_oob_rxoff(xfer), &u_ioc->rx_offset) ||
+		put_user((__u32)spi_get_oob_iolen(xfer), &u_ioc->iobuf_len)) {
+		ret = -EFAULT;
+		goto fail_put;
+	}
+
+	spidev->oob.frames = frames;
+	spidev->oob.enabled = true;
+	evl_up(&spidev->oob.sem);
+
+	return 0;
+
+fail_put:
+	spi_terminate_oob_transfer(xfer);
+fail:
+	kfree(frames);
+out:
+	evl_up(&spidev->oob.sem);
+
+	return ret == -ENOTSUPP ? -EOPNOTSUPP : ret;
+}
+
 static int disable_oob_mode(struct spidev_data *spidev)
 {
 	int ret;
@@ -426,6 +521,8 @@ static int disable_oob_mode(struct spidev_data *spidev)
 
 	if (spidev->oob.enabled) {
 		spi_terminate_oob_transfer(&spidev->oob.xfer);
+		kfree(spidev->oob.frames);
+		spidev->oob.frames = NULL;
 		spidev->oob.enabled = false;
 	}
 
@@ -641,6 +738,11 @@ spidev_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 				(struct spi_ioc_oob_setup __user *)arg);
 		break;
 
+	case SPI_IOC_ENABLE_OOB_QUEUE:
+		retval = enable_oob_queue(spidev,
+				(struct spi_ioc_oob_queue __user *)arg);
+		break;
+
 	case SPI_IOC_DISABLE_OOB_MODE:
 		retval = disable_oob_mode(spidev);
 		break;
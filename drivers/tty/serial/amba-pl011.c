@@ -41,6 +41,13 @@
 #include <linux/sizes.h>
 #include <linux/io.h>
 #include <linux/acpi.h>
+#ifdef CONFIG_SERIAL_AMBA_PL011_OOB
+#include <linux/miscdevice.h>
+#include <evl/device.h>
+#include <evl/timer.h>
+#include <evl/clock.h>
+#include <uapi/evl/devices/uart.h>
+#endif
 
 #define UART_NR			14
 
@@ -255,6 +262,44 @@ enum pl011_rs485_tx_state {
 	WAIT_AFTER_SEND,
 };
 
+#ifdef CONFIG_SERIAL_AMBA_PL011_OOB
+
+#define PL011_OOB_RING_SIZE	SZ_4K
+#define PL011_OOB_RING_MASK	(PL011_OOB_RING_SIZE - 1)
+#define PL011_OOB_MAX_FRAMES	32
+
+/* Oob mode, see include/uapi/evl/devices/uart.h. */
+struct pl011_oob_state {
+	struct miscdevice	miscdev;
+	char			name[16];
+	bool			registered;
+	bool			busy;		/* under port mutex */
+	struct evl_file		efile;
+	hard_spinlock_t		lock;
+	struct evl_wait_queue	rx_wait;
+	struct evl_wait_queue	tx_wait;
+	struct evl_poll_head	poll_head;
+	struct evl_ksem		rx_sem;
+	struct evl_ksem		tx_sem;
+	struct evl_timer	gap_timer;
+	struct evl_uart_config	config;
+	struct evl_uart_stats	stats;
+	u8			*rx_buf;
+	u8			*tx_buf;
+	/* Free-running ring indexes, masked on access. */
+	unsigned int		rx_head;
+	unsigned int		rx_tail;
+	unsigned int		tx_head;
+	unsigned int		tx_tail;
+	/* RX ring positions ending the frames detected so far. */
+	unsigned int		frames[PL011_OOB_MAX_FRAMES];
+	unsigned int		frame_head;
+	unsigned int		frame_tail;
+	unsigned int		rx_mark;
+};
+
+#endif
+
 /*
  * We wrap our port structure around the generic uart_port.
  */
@@ -281,8 +326,23 @@ struct uart_amba_port {
 	struct pl011_dmatx_data	dmatx;
 	bool			dma_probed;
 #endif
+#ifdef CONFIG_SERIAL_AMBA_PL011_OOB
+	struct pl011_oob_state	oob;
+#endif
 };
 
+#ifdef CONFIG_SERIAL_AMBA_PL011_OOB
+static inline bool pl011_oob_busy(struct uart_amba_port *uap)
+{
+	return uap->oob.busy;
+}
+#else
+static inline bool pl011_oob_busy(struct uart_amba_port *uap)
+{
+	return false;
+}
+#endif
+
 static unsigned int pl011_tx_empty(struct uart_port *port);
 
 static unsigned int pl011_reg_to_offset(const struct uart_amba_port *uap,
@@ -1897,6 +1957,10 @@ static int pl011_startup(struct uart_port *port)
 	unsigned int cr;
 	int retval;
 
+	/* The port is owned by its oob device. */
+	if (pl011_oob_busy(uap))
+		return -EBUSY;
+
 	retval = pl011_hwinit(port);
 	if (retval)
 		goto clk_dis;
@@ -2356,6 +2420,717 @@ static const struct uart_ops sbsa_uart_pops = {
 #endif
 };
 
+#ifdef CONFIG_SERIAL_AMBA_PL011_OOB
+
+/*
+ * Oob mode: the port is driven from the oob stage through a
+ * dedicated character device, bypassing the tty layer entirely. Both
+ * are mutually exclusive, serialized by the port mutex.
+ */
+
+static inline bool pl011_oob_rx_ready(struct pl011_oob_state *oob)
+{
+	if (oob->config.frame_gap_ns)
+		return oob->frame_head != oob->frame_tail;
+
+	return oob->rx_head != oob->rx_tail;
+}
+
+static inline unsigned int pl011_oob_tx_room(struct pl011_oob_state *oob)
+{
+	return PL011_OOB_RING_SIZE - (oob->tx_head - oob->tx_tail);
+}
+
+/* oob->lock held, hard irqs off. */
+static bool pl011_oob_rx_chars(struct uart_amba_port *uap)
+{
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned int ch, n = 0;
+	bool active = false;
+
+	while (!(pl011_read(uap, REG_FR) & UART01x_FR_RXFE)) {
+		ch = pl011_read(uap, REG_DR);
+		active = true;
+
+		if (unlikely(ch & UART_DR_ERROR)) {
+			if (ch & UART011_DR_OE)
+				oob->stats.hw_overruns++;
+			if (ch & UART011_DR_BE) {
+				oob->stats.breaks++;
+				continue;
+			}
+			if (ch & UART011_DR_PE) {
+				oob->stats.parity_errors++;
+				continue;
+			}
+			if (ch & UART011_DR_FE) {
+				oob->stats.framing_errors++;
+				continue;
+			}
+		}
+
+		if (oob->rx_head - oob->rx_tail >= PL011_OOB_RING_SIZE) {
+			oob->stats.rx_overruns++;
+			continue;
+		}
+
+		oob->rx_buf[oob->rx_head++ & PL011_OOB_RING_MASK] = ch;
+		n++;
+	}
+
+	oob->stats.rx_bytes += n;
+
+	return active;
+}
+
+/* oob->lock held, hard irqs off. */
+static bool pl011_oob_tx_chars(struct uart_amba_port *uap)
+{
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned int n = 0;
+
+	while (oob->tx_tail != oob->tx_head &&
+		!(pl011_read(uap, REG_FR) & UART01x_FR_TXFF)) {
+		pl011_write(oob->tx_buf[oob->tx_tail++ & PL011_OOB_RING_MASK],
+			uap, REG_DR);
+		n++;
+	}
+
+	oob->stats.tx_bytes += n;
+
+	/* Keep the TX interrupt enabled until the ring is drained. */
+	if (oob->tx_tail == oob->tx_head)
+		uap->im &= ~UART011_TXIM;
+	else
+		uap->im |= UART011_TXIM;
+
+	pl011_write(uap->im, uap, REG_IMSC);
+
+	return n > 0;
+}
+
+static void pl011_oob_signal(struct pl011_oob_state *oob, __poll_t events)
+{
+	unsigned long flags;
+
+	if (events & POLLIN) {
+		raw_spin_lock_irqsave(&oob->rx_wait.wchan.lock, flags);
+		evl_wake_up_head(&oob->rx_wait);
+		raw_spin_unlock_irqrestore(&oob->rx_wait.wchan.lock, flags);
+	}
+
+	if (events & POLLOUT) {
+		raw_spin_lock_irqsave(&oob->tx_wait.wchan.lock, flags);
+		evl_wake_up_head(&oob->tx_wait);
+		raw_spin_unlock_irqrestore(&oob->tx_wait.wchan.lock, flags);
+	}
+
+	if (events)
+		evl_signal_poll_events(&oob->poll_head, events);
+}
+
+static irqreturn_t pl011_oob_int(int irq, void *dev_id)
+{
+	struct uart_amba_port *uap = dev_id;
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned int status, pass_counter = AMBA_ISR_PASS_LIMIT;
+	bool rx = false, tx = false;
+	__poll_t events = 0;
+
+	raw_spin_lock(&oob->lock);
+
+	status = pl011_read(uap, REG_RIS) & uap->im;
+	if (!status) {
+		raw_spin_unlock(&oob->lock);
+		return IRQ_NONE;
+	}
+
+	do {
+		pl011_write(status & ~(UART011_TXIS | UART011_RTIS | UART011_RXIS),
+			uap, REG_ICR);
+
+		if (status & (UART011_RTIS | UART011_RXIS))
+			rx |= pl011_oob_rx_chars(uap);
+		if (status & UART011_TXIS)
+			tx |= pl011_oob_tx_chars(uap);
+
+		if (pass_counter-- == 0)
+			break;
+
+		status = pl011_read(uap, REG_RIS) & uap->im;
+	} while (status != 0);
+
+	/*
+	 * With frame gap detection enabled, readers are woken up by
+	 * the gap timer, which any line activity pushes back.
+	 */
+	if (rx) {
+		if (oob->config.frame_gap_ns)
+			evl_start_timer(&oob->gap_timer,
+					evl_abs_timeout(&oob->gap_timer,
+						ns_to_ktime(oob->config.frame_gap_ns)),
+					EVL_INFINITE);
+		else
+			events |= POLLIN|POLLRDNORM;
+	}
+
+	if (tx)
+		events |= POLLOUT|POLLWRNORM;
+
+	raw_spin_unlock(&oob->lock);
+
+	pl011_oob_signal(oob, events);
+
+	return IRQ_HANDLED;
+}
+
+static void pl011_oob_gap_handler(struct evl_timer *timer) /* hard irqs off */
+{
+	struct pl011_oob_state *oob;
+	bool ready = false;
+
+	oob = container_of(timer, struct pl011_oob_state, gap_timer);
+
+	raw_spin_lock(&oob->lock);
+
+	/*
+	 * The line has been silent long enough, close the current
+	 * frame. If the frame table is full, the data received is
+	 * merged into the next frame.
+	 */
+	if (oob->rx_head != oob->rx_mark &&
+		oob->frame_head - oob->frame_tail < PL011_OOB_MAX_FRAMES) {
+		oob->frames[oob->frame_head++ % PL011_OOB_MAX_FRAMES] =
+			oob->rx_head;
+		oob->rx_mark = oob->rx_head;
+		oob->stats.rx_frames++;
+		ready = true;
+	}
+
+	raw_spin_unlock(&oob->lock);
+
+	if (ready)
+		pl011_oob_signal(oob, POLLIN|POLLRDNORM);
+}
+
+static int pl011_oob_copy_to_user(char __user *u_buf, const u8 *ring,
+				unsigned int pos, unsigned int len)
+{
+	unsigned int off = pos & PL011_OOB_RING_MASK;
+	unsigned int n = min(len, PL011_OOB_RING_SIZE - off);
+
+	if (raw_copy_to_user(u_buf, ring + off, n) ||
+		raw_copy_to_user(u_buf + n, ring, len - n))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int pl011_oob_copy_from_user(u8 *ring, unsigned int pos,
+				const char __user *u_buf, unsigned int len)
+{
+	unsigned int off = pos & PL011_OOB_RING_MASK;
+	unsigned int n = min(len, PL011_OOB_RING_SIZE - off);
+
+	if (raw_copy_from_user(ring + off, u_buf, n) ||
+		raw_copy_from_user(ring, u_buf + n, len - n))
+		return -EFAULT;
+
+	return 0;
+}
+
+/*
+ * The ring is only written by the IRQ handler from rx_head on, so
+ * the data between rx_tail and the end position can be copied
+ * without holding the lock. Readers are serialized by rx_sem.
+ */
+static ssize_t pl011_oob_read(struct file *filp, char __user *u_buf,
+			size_t count)
+{
+	struct uart_amba_port *uap = filp->private_data;
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned int tail, end, len;
+	unsigned long flags;
+	ssize_t ret;
+
+	if (!count)
+		return 0;
+
+	ret = evl_down(&oob->rx_sem);
+	if (ret)
+		return ret;
+
+	for (;;) {
+		raw_spin_lock_irqsave(&oob->lock, flags);
+		if (pl011_oob_rx_ready(oob))
+			break;
+		raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+		if (filp->f_flags & O_NONBLOCK) {
+			ret = -EAGAIN;
+			goto out;
+		}
+
+		ret = evl_wait_event(&oob->rx_wait, pl011_oob_rx_ready(oob));
+		if (ret)
+			goto out;
+	}
+
+	tail = oob->rx_tail;
+	if (oob->config.frame_gap_ns) {
+		/* Return one frame, dropping what does not fit. */
+		end = oob->frames[oob->frame_tail++ % PL011_OOB_MAX_FRAMES];
+		len = min_t(size_t, end - tail, count);
+	} else {
+		len = min_t(size_t, oob->rx_head - tail, count);
+		end = tail + len;
+	}
+
+	raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+	ret = pl011_oob_copy_to_user(u_buf, oob->rx_buf, tail, len);
+
+	raw_spin_lock_irqsave(&oob->lock, flags);
+	oob->rx_tail = end;
+	raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+	if (!ret)
+		ret = len;
+out:
+	evl_up(&oob->rx_sem);
+
+	return ret;
+}
+
+static ssize_t pl011_oob_write(struct file *filp, const char __user *u_buf,
+			size_t count)
+{
+	struct uart_amba_port *uap = filp->private_data;
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned int head, room, len;
+	unsigned long flags;
+	size_t written = 0;
+	ssize_t ret;
+
+	ret = evl_down(&oob->tx_sem);
+	if (ret)
+		return ret;
+
+	while (written < count) {
+		raw_spin_lock_irqsave(&oob->lock, flags);
+		room = pl011_oob_tx_room(oob);
+		head = oob->tx_head;
+		raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+		if (!room) {
+			if (filp->f_flags & O_NONBLOCK) {
+				ret = -EAGAIN;
+				break;
+			}
+			ret = evl_wait_event(&oob->tx_wait,
+					pl011_oob_tx_room(oob) > 0);
+			if (ret)
+				break;
+			continue;
+		}
+
+		len = min_t(size_t, room, count - written);
+		if (pl011_oob_copy_from_user(oob->tx_buf, head,
+						u_buf + written, len)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		raw_spin_lock_irqsave(&oob->lock, flags);
+		oob->tx_head += len;
+		pl011_oob_tx_chars(uap);
+		raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+		written += len;
+	}
+
+	evl_up(&oob->tx_sem);
+
+	return written ?: ret;
+}
+
+static __poll_t pl011_oob_poll(struct file *filp,
+			struct oob_poll_wait *wait)
+{
+	struct uart_amba_port *uap = filp->private_data;
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned long flags;
+	__poll_t ready = 0;
+
+	evl_poll_watch(&oob->poll_head, wait, NULL);
+
+	raw_spin_lock_irqsave(&oob->lock, flags);
+
+	if (pl011_oob_rx_ready(oob))
+		ready |= POLLIN|POLLRDNORM;
+
+	if (pl011_oob_tx_room(oob))
+		ready |= POLLOUT|POLLWRNORM;
+
+	raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+	return ready;
+}
+
+static void pl011_oob_get_stats(struct uart_amba_port *uap,
+				struct evl_uart_stats *stats)
+{
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&oob->lock, flags);
+	*stats = oob->stats;
+	raw_spin_unlock_irqrestore(&oob->lock, flags);
+}
+
+static long pl011_oob_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	struct uart_amba_port *uap = filp->private_data;
+	struct evl_uart_stats stats;
+
+	if (cmd != EVL_UARTIOC_GET_STATS)
+		return -ENOTTY;
+
+	pl011_oob_get_stats(uap, &stats);
+
+	return raw_copy_to_user((void __user *)arg, &stats,
+				sizeof(stats)) ? -EFAULT : 0;
+}
+
+static int pl011_oob_fifo_level(u8 level)
+{
+	switch (level) {
+	case 1:
+		return 0;
+	case 2:
+		return 1;
+	case 4:
+		return 2;
+	case 6:
+		return 3;
+	case 7:
+		return 4;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Port mutex held. */
+static int pl011_oob_set_config(struct uart_amba_port *uap,
+				const struct evl_uart_config *config)
+{
+	static const tcflag_t csize[] = { CS5, CS6, CS7, CS8 };
+	struct pl011_oob_state *oob = &uap->oob;
+	struct ktermios termios = { };
+	unsigned int clkdiv;
+	unsigned long flags;
+	int rxl, txl;
+
+	clkdiv = uap->vendor->oversampling ? 8 : 16;
+	if (!config->baud || config->baud > uap->port.uartclk / clkdiv)
+		return -EINVAL;
+
+	if (config->data_bits < 5 || config->data_bits > 8 ||
+		config->stop_bits < 1 || config->stop_bits > 2 ||
+		config->parity > EVL_UART_PARITY_EVEN ||
+		config->flags & ~EVL_UART_CRTSCTS)
+		return -EINVAL;
+
+	rxl = pl011_oob_fifo_level(config->rx_fifo_level);
+	txl = pl011_oob_fifo_level(config->tx_fifo_level);
+	if (rxl < 0 || txl < 0)
+		return -EINVAL;
+
+	termios.c_cflag = CREAD | CLOCAL | csize[config->data_bits - 5];
+	if (config->stop_bits == 2)
+		termios.c_cflag |= CSTOPB;
+	if (config->parity != EVL_UART_PARITY_NONE)
+		termios.c_cflag |= PARENB;
+	if (config->parity == EVL_UART_PARITY_ODD)
+		termios.c_cflag |= PARODD;
+	if (config->flags & EVL_UART_CRTSCTS)
+		termios.c_cflag |= CRTSCTS;
+	tty_termios_encode_baud_rate(&termios, config->baud, config->baud);
+
+	raw_spin_lock_irqsave(&oob->lock, flags);
+	uap->im = 0;
+	pl011_write(uap->im, uap, REG_IMSC);
+	raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+	evl_stop_timer(&oob->gap_timer);
+
+	/* Let the regular code program the line. */
+	pl011_set_termios(&uap->port, &termios, NULL);
+	pl011_write(FIELD_PREP(UART011_IFLS_RXIFLSEL, rxl) |
+		FIELD_PREP(UART011_IFLS_TXIFLSEL, txl), uap, REG_IFLS);
+
+	raw_spin_lock_irqsave(&oob->lock, flags);
+	oob->config = *config;
+	/* Pending data goes to the next frame. */
+	oob->frame_head = oob->frame_tail;
+	oob->rx_mark = oob->rx_head;
+	uap->im = UART011_RTIM | UART011_RXIM;
+	pl011_oob_tx_chars(uap);
+	raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+	return 0;
+}
+
+static long pl011_oob_inband_ioctl(struct file *filp, unsigned int cmd,
+				unsigned long arg)
+{
+	struct uart_amba_port *uap = filp->private_data;
+	struct tty_port *tport = &uap->port.state->port;
+	struct pl011_oob_state *oob = &uap->oob;
+	struct evl_uart_config config;
+	void __user *u_arg = (void __user *)arg;
+	struct evl_uart_stats stats;
+	int ret;
+
+	switch (cmd) {
+	case EVL_UARTIOC_SET_CONFIG:
+		if (copy_from_user(&config, u_arg, sizeof(config)))
+			return -EFAULT;
+		mutex_lock(&tport->mutex);
+		ret = pl011_oob_set_config(uap, &config);
+		mutex_unlock(&tport->mutex);
+		break;
+	case EVL_UARTIOC_GET_CONFIG:
+		mutex_lock(&tport->mutex);
+		config = oob->config;
+		mutex_unlock(&tport->mutex);
+		ret = copy_to_user(u_arg, &config, sizeof(config)) ? -EFAULT : 0;
+		break;
+	case EVL_UARTIOC_GET_STATS:
+		pl011_oob_get_stats(uap, &stats);
+		ret = copy_to_user(u_arg, &stats, sizeof(stats)) ? -EFAULT : 0;
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+static int pl011_oob_startup(struct uart_amba_port *uap)
+{
+	static const struct evl_uart_config default_config = {
+		.baud = 115200,
+		.data_bits = 8,
+		.stop_bits = 1,
+		.parity = EVL_UART_PARITY_NONE,
+		.rx_fifo_level = 4,
+		.tx_fifo_level = 4,
+	};
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned int cr, i;
+	int ret;
+
+	oob->rx_buf = kzalloc(PL011_OOB_RING_SIZE * 2, GFP_KERNEL);
+	if (!oob->rx_buf)
+		return -ENOMEM;
+
+	oob->tx_buf = oob->rx_buf + PL011_OOB_RING_SIZE;
+	oob->rx_head = oob->rx_tail = oob->rx_mark = 0;
+	oob->tx_head = oob->tx_tail = 0;
+	oob->frame_head = oob->frame_tail = 0;
+	memset(&oob->stats, 0, sizeof(oob->stats));
+	evl_init_wait(&oob->rx_wait, &evl_mono_clock, EVL_WAIT_PRIO);
+	evl_init_wait(&oob->tx_wait, &evl_mono_clock, EVL_WAIT_PRIO);
+	evl_init_poll_head(&oob->poll_head);
+	evl_init_ksem(&oob->rx_sem, 1);
+	evl_init_ksem(&oob->tx_sem, 1);
+	evl_init_timer(&oob->gap_timer, pl011_oob_gap_handler);
+
+	ret = pl011_hwinit(&uap->port);
+	if (ret)
+		goto fail_hwinit;
+
+	uap->im = 0;
+	pl011_write(uap->im, uap, REG_IMSC);
+
+	ret = request_irq(uap->port.irq, pl011_oob_int, IRQF_OOB,
+			"uart-pl011-oob", uap);
+	if (ret)
+		goto fail_irq;
+
+	cr = pl011_read(uap, REG_CR);
+	cr &= UART011_CR_RTS | UART011_CR_DTR;
+	cr |= UART01x_CR_UARTEN | UART011_CR_RXE | UART011_CR_TXE;
+	pl011_write(cr, uap, REG_CR);
+
+	/* Same as pl011_enable_interrupts(). */
+	pl011_write(UART011_RTIS | UART011_RXIS, uap, REG_ICR);
+	for (i = 0; i < uap->fifosize * 2; ++i) {
+		if (pl011_read(uap, REG_FR) & UART01x_FR_RXFE)
+			break;
+
+		pl011_read(uap, REG_DR);
+	}
+
+	ret = pl011_oob_set_config(uap, &default_config);
+	if (ret)
+		goto fail_config;
+
+	return 0;
+
+fail_config:
+	free_irq(uap->port.irq, uap);
+	pl011_disable_uart(uap);
+fail_irq:
+	clk_disable_unprepare(uap->clk);
+fail_hwinit:
+	evl_destroy_timer(&oob->gap_timer);
+	kfree(oob->rx_buf);
+
+	return ret;
+}
+
+static void pl011_oob_shutdown(struct uart_amba_port *uap)
+{
+	struct pl011_oob_state *oob = &uap->oob;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&oob->lock, flags);
+	uap->im = 0;
+	pl011_write(uap->im, uap, REG_IMSC);
+	pl011_write(0xffff, uap, REG_ICR);
+	raw_spin_unlock_irqrestore(&oob->lock, flags);
+
+	free_irq(uap->port.irq, uap);
+	evl_destroy_timer(&oob->gap_timer);
+
+	pl011_disable_uart(uap);
+	clk_disable_unprepare(uap->clk);
+	pinctrl_pm_select_sleep_state(uap->port.dev);
+
+	if (dev_get_platdata(uap->port.dev)) {
+		struct amba_pl011_data *plat;
+
+		plat = dev_get_platdata(uap->port.dev);
+		if (plat->exit)
+			plat->exit();
+	}
+
+	kfree(oob->rx_buf);
+}
+
+static int pl011_oob_open(struct inode *inode, struct file *filp)
+{
+	struct pl011_oob_state *oob =
+		container_of(filp->private_data, struct pl011_oob_state, miscdev);
+	struct uart_amba_port *uap =
+		container_of(oob, struct uart_amba_port, oob);
+	struct tty_port *tport = &uap->port.state->port;
+	int ret;
+
+	/*
+	 * RS485 direction control is driven from in-band timers,
+	 * which the oob stage cannot rely on.
+	 */
+	if (uap->port.rs485.flags & SER_RS485_ENABLED)
+		return -EOPNOTSUPP;
+
+	mutex_lock(&tport->mutex);
+
+	if (oob->busy || uart_console(&uap->port) ||
+		tty_port_initialized(tport)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = pl011_oob_startup(uap);
+	if (ret)
+		goto out;
+
+	filp->private_data = uap;
+	ret = evl_open_file(&oob->efile, filp);
+	if (ret) {
+		pl011_oob_shutdown(uap);
+		goto out;
+	}
+
+	oob->busy = true;
+out:
+	mutex_unlock(&tport->mutex);
+
+	return ret;
+}
+
+static int pl011_oob_release(struct inode *inode, struct file *filp)
+{
+	struct uart_amba_port *uap = filp->private_data;
+	struct tty_port *tport = &uap->port.state->port;
+	struct pl011_oob_state *oob = &uap->oob;
+
+	evl_destroy_wait(&oob->rx_wait);
+	evl_destroy_wait(&oob->tx_wait);
+	evl_destroy_ksem(&oob->rx_sem);
+	evl_destroy_ksem(&oob->tx_sem);
+	evl_release_file(&oob->efile);
+
+	mutex_lock(&tport->mutex);
+	pl011_oob_shutdown(uap);
+	oob->busy = false;
+	mutex_unlock(&tport->mutex);
+
+	return 0;
+}
+
+static const struct file_operations pl011_oob_fops = {
+	.owner		= THIS_MODULE,
+	.open		= pl011_oob_open,
+	.release	= pl011_oob_release,
+	.unlocked_ioctl	= pl011_oob_inband_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
+	.oob_read	= pl011_oob_read,
+	.oob_write	= pl011_oob_write,
+	.oob_ioctl	= pl011_oob_ioctl,
+	.compat_oob_ioctl = compat_ptr_oob_ioctl,
+	.oob_poll	= pl011_oob_poll,
+	.llseek		= noop_llseek,
+};
+
+static void pl011_oob_register(struct uart_amba_port *uap)
+{
+	struct pl011_oob_state *oob = &uap->oob;
+	int ret;
+
+	raw_spin_lock_init(&oob->lock);
+	snprintf(oob->name, sizeof(oob->name), "ttyAMA%d-oob", uap->port.line);
+	oob->miscdev.minor = MISC_DYNAMIC_MINOR;
+	oob->miscdev.name = oob->name;
+	oob->miscdev.fops = &pl011_oob_fops;
+	oob->miscdev.parent = uap->port.dev;
+
+	/* The regular tty device remains available. */
+	ret = misc_register(&oob->miscdev);
+	if (ret)
+		dev_warn(uap->port.dev, "cannot register oob device (%d)\n", ret);
+	else
+		oob->registered = true;
+}
+
+static void pl011_oob_unregister(struct uart_amba_port *uap)
+{
+	if (uap->oob.registered)
+		misc_deregister(&uap->oob.miscdev);
+}
+
+#else
+
+static inline void pl011_oob_register(struct uart_amba_port *uap) { }
+
+static inline void pl011_oob_unregister(struct uart_amba_port *uap) { }
+
+#endif /* CONFIG_SERIAL_AMBA_PL011_OOB */
+
 static struct uart_amba_port *amba_ports[UART_NR];
 
 #ifdef CONFIG_SERIAL_AMBA_PL011_CONSOLE
@@ -2918,13 +3693,20 @@ static int pl011_probe(struct amba_device *dev, const struct amba_id *id)
 
 	amba_set_drvdata(dev, uap);
 
-	return pl011_register_port(uap);
+	ret = pl011_register_port(uap);
+	if (ret)
+		return ret;
+
+	pl011_oob_register(uap);
+
+	return 0;
 }
 
 static void pl011_remove(struct amba_device *dev)
 {
 	struct uart_amba_port *uap = amba_get_drvdata(dev);
 
+	pl011_oob_unregister(uap);
 	uart_remove_one_port(&amba_reg, &uap->port);
 	pl011_unregister_port(uap);
 }
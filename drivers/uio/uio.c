@@ -25,6 +25,7 @@
 #include <linux/cdev.h>
 #include <linux/uio_driver.h>
 #include <linux/dma-mapping.h>
+#include <linux/irq_work.h>
 
 #define UIO_MAX_DEVICES		(1U << MINORBITS)
 
@@ -423,17 +424,86 @@ static void uio_free_minor(unsigned long minor)
 	mutex_unlock(&minor_lock);
 }
 
+static inline bool uio_oob_handling(struct uio_info *info)
+{
+	return IS_ENABLED(CONFIG_UIO_OOB) && info->irq_flags & IRQF_OOB;
+}
+
+static void uio_inband_notify(struct uio_device *idev)
+{
+	wake_up_interruptible(&idev->wait);
+	kill_fasync(&idev->async_queue, SIGIO, POLL_IN);
+}
+
+#ifdef CONFIG_UIO_OOB
+
+static void uio_inband_notify_work(struct irq_work *work)
+{
+	struct uio_device *idev;
+
+	idev = container_of(work, struct uio_device, oob.inband_work);
+	uio_inband_notify(idev);
+}
+
+/*
+ * Wake up the oob listeners, then relay the event to the in-band
+ * ones, which cannot be woken up directly from the oob stage.
+ */
+static void uio_oob_notify(struct uio_device *idev)
+{
+	evl_flush_wait(&idev->oob.wait, 0);
+	evl_signal_poll_events(&idev->oob.poll_head, POLLIN|POLLRDNORM);
+
+	if (running_oob()) {
+		irq_work_queue(&idev->oob.inband_work);
+	} else {
+		uio_inband_notify(idev);
+		evl_schedule();
+	}
+}
+
+static void uio_init_oob_state(struct uio_device *idev)
+{
+	evl_init_wait(&idev->oob.wait, &evl_mono_clock, EVL_WAIT_PRIO);
+	evl_init_poll_head(&idev->oob.poll_head);
+	init_irq_work(&idev->oob.inband_work, uio_inband_notify_work);
+}
+
+static void uio_cleanup_oob_state(struct uio_device *idev)
+{
+	irq_work_sync(&idev->oob.inband_work);
+	evl_flush_wait(&idev->oob.wait, EVL_T_RMID);
+	evl_signal_poll_events(&idev->oob.poll_head, POLLHUP);
+	evl_schedule();
+}
+
+#else
+
+static inline void uio_oob_notify(struct uio_device *idev) { }
+
+static inline void uio_init_oob_state(struct uio_device *idev) { }
+
+static inline void uio_cleanup_oob_state(struct uio_device *idev) { }
+
+#endif	/* !CONFIG_UIO_OOB */
+
 /**
  * uio_event_notify - trigger an interrupt event
  * @info: UIO device capabilities
+ *
+ * This may be called from the oob stage if @info requests
+ * out-of-band handling.
  */
 void uio_event_notify(struct uio_info *info)
 {
 	struct uio_device *idev = info->uio_dev;
 
 	atomic_inc(&idev->event);
-	wake_up_interruptible(&idev->wait);
-	kill_fasync(&idev->async_queue, SIGIO, POLL_IN);
+
+	if (uio_oob_handling(info))
+		uio_oob_notify(idev);
+	else
+		uio_inband_notify(idev);
 }
 EXPORT_SYMBOL_GPL(uio_event_notify);
 
@@ -468,11 +538,63 @@ static irqreturn_t uio_interrupt_thread(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/**
+ * uio_oob_interrupt_handler - out-of-band interrupt handler
+ * @irq: IRQ number
+ * @dev_id: Pointer to the devices uio_device structure
+ */
+static irqreturn_t uio_oob_interrupt_handler(int irq, void *dev_id)
+{
+	struct uio_device *idev = (struct uio_device *)dev_id;
+	irqreturn_t ret;
+
+	ret = idev->info->handler(irq, idev->info);
+	if (ret == IRQ_HANDLED)
+		uio_event_notify(idev->info);
+
+	return ret;
+}
+
 struct uio_listener {
 	struct uio_device *dev;
 	s32 event_count;
+#ifdef CONFIG_UIO_OOB
+	struct evl_file efile;
+	bool oob;
+#endif
 };
 
+#ifdef CONFIG_UIO_OOB
+
+static int uio_open_oob(struct uio_listener *listener, struct file *filep)
+{
+	int ret;
+
+	ret = evl_open_file(&listener->efile, filep);
+	if (!ret)
+		listener->oob = true;
+
+	return ret;
+}
+
+static void uio_release_oob(struct uio_listener *listener)
+{
+	if (listener->oob)
+		evl_release_file(&listener->efile);
+}
+
+#else
+
+static inline
+int uio_open_oob(struct uio_listener *listener, struct file *filep)
+{
+	return 0;
+}
+
+static inline void uio_release_oob(struct uio_listener *listener) { }
+
+#endif	/* !CONFIG_UIO_OOB */
+
 static int uio_open(struct inode *inode, struct file *filep)
 {
 	struct uio_device *idev;
@@ -494,7 +616,7 @@ static int uio_open(struct inode *inode, struct file *filep)
 		goto err_module_get;
 	}
 
-	listener = kmalloc(sizeof(*listener), GFP_KERNEL);
+	listener = kzalloc(sizeof(*listener), GFP_KERNEL);
 	if (!listener) {
 		ret = -ENOMEM;
 		goto err_alloc_listener;
@@ -511,8 +633,13 @@ static int uio_open(struct inode *inode, struct file *filep)
 		goto err_infoopen;
 	}
 
-	if (idev->info->open)
+	if (uio_oob_handling(idev->info))
+		ret = uio_open_oob(listener, filep);
+	if (!ret && idev->info->open) {
 		ret = idev->info->open(idev->info, inode);
+		if (ret)
+			uio_release_oob(listener);
+	}
 	mutex_unlock(&idev->info_lock);
 	if (ret)
 		goto err_infoopen;
@@ -551,6 +678,8 @@ static int uio_release(struct inode *inode, struct file *filep)
 		ret = idev->info->release(idev->info, inode);
 	mutex_unlock(&idev->info_lock);
 
+	uio_release_oob(listener);
+
 	module_put(idev->owner);
 	kfree(listener);
 	put_device(&idev->dev);
@@ -632,6 +761,71 @@ static ssize_t uio_read(struct file *filep, char __user *buf,
 	return retval;
 }
 
+#ifdef CONFIG_UIO_OOB
+
+static inline bool uio_oob_ready(struct uio_listener *listener)
+{
+	struct uio_device *idev = listener->dev;
+
+	return !READ_ONCE(idev->info) ||
+		listener->event_count != atomic_read(&idev->event);
+}
+
+/*
+ * Same as uio_read() from the oob stage. idev->info is cleared
+ * before the oob waiters are flushed on unregistration.
+ */
+static ssize_t uio_oob_read(struct file *filep, char __user *buf,
+			size_t count)
+{
+	struct uio_listener *listener = filep->private_data;
+	struct uio_device *idev = listener->dev;
+	s32 event_count;
+	int ret;
+
+	if (count != sizeof(s32))
+		return -EINVAL;
+
+	if (!(filep->f_flags & O_NONBLOCK)) {
+		ret = evl_wait_event(&idev->oob.wait, uio_oob_ready(listener));
+		if (ret)
+			return ret;
+	}
+
+	if (!READ_ONCE(idev->info))
+		return -EIO;
+
+	event_count = atomic_read(&idev->event);
+	if (event_count == listener->event_count)
+		return -EAGAIN;
+
+	if (raw_copy_to_user(buf, &event_count, count))
+		return -EFAULT;
+
+	listener->event_count = event_count;
+
+	return count;
+}
+
+static __poll_t uio_oob_poll(struct file *filep,
+			struct oob_poll_wait *wait)
+{
+	struct uio_listener *listener = filep->private_data;
+	struct uio_device *idev = listener->dev;
+
+	evl_poll_watch(&idev->oob.poll_head, wait, NULL);
+
+	if (!READ_ONCE(idev->info))
+		return POLLERR;
+
+	if (listener->event_count != atomic_read(&idev->event))
+		return POLLIN|POLLRDNORM;
+
+	return 0;
+}
+
+#endif	/* CONFIG_UIO_OOB */
+
 static ssize_t uio_write(struct file *filep, const char __user *buf,
 			size_t count, loff_t *ppos)
 {
@@ -886,6 +1080,10 @@ static const struct file_operations uio_fops = {
 	.poll		= uio_poll,
 	.fasync		= uio_fasync,
 	.llseek		= noop_llseek,
+#ifdef CONFIG_UIO_OOB
+	.oob_read	= uio_oob_read,
+	.oob_poll	= uio_oob_poll,
+#endif
 };
 
 static int uio_major_init(void)
@@ -989,6 +1187,9 @@ int __uio_register_device(struct module *owner,
 	if (!parent || !info || !info->name || !info->version)
 		return -EINVAL;
 
+	if (info->irq_flags & IRQF_OOB && !IS_ENABLED(CONFIG_UIO_OOB))
+		return -EOPNOTSUPP;
+
 	info->uio_dev = NULL;
 
 	idev = kzalloc(sizeof(*idev), GFP_KERNEL);
@@ -1001,6 +1202,8 @@ int __uio_register_device(struct module *owner,
 	mutex_init(&idev->info_lock);
 	init_waitqueue_head(&idev->wait);
 	atomic_set(&idev->event, 0);
+	if (uio_oob_handling(info))
+		uio_init_oob_state(idev);
 
 	ret = uio_get_minor(idev);
 	if (ret) {
@@ -1038,8 +1241,12 @@ int __uio_register_device(struct module *owner,
 		 * FDs at the time of unregister and therefore may not be
 		 * freed until they are released.
 		 */
-		ret = request_threaded_irq(info->irq, uio_interrupt_handler, uio_interrupt_thread,
-					   info->irq_flags, info->name, idev);
+		if (uio_oob_handling(info))
+			ret = request_irq(info->irq, uio_oob_interrupt_handler,
+					info->irq_flags, info->name, idev);
+		else
+			ret = request_threaded_irq(info->irq, uio_interrupt_handler, uio_interrupt_thread,
+						   info->irq_flags, info->name, idev);
 		if (ret) {
 			info->uio_dev = NULL;
 			goto err_request_irq;
@@ -1119,9 +1326,12 @@ void uio_unregister_device(struct uio_info *info)
 	if (info->irq && info->irq != UIO_IRQ_CUSTOM)
 		free_irq(info->irq, idev);
 
-	idev->info = NULL;
+	WRITE_ONCE(idev->info, NULL);
 	mutex_unlock(&idev->info_lock);
 
+	if (uio_oob_handling(info))
+		uio_cleanup_oob_state(idev);
+
 	wake_up_interruptible(&idev->wait);
 	kill_fasync(&idev->async_queue, SIGIO, POLL_HUP);
 
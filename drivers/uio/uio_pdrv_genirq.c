@@ -30,11 +30,18 @@
 
 struct uio_pdrv_genirq_platdata {
 	struct uio_info *uioinfo;
-	spinlock_t lock;
+	/* Shared with the oob IRQ handler in oob mode. */
+	hard_spinlock_t lock;
 	unsigned long flags;
 	struct platform_device *pdev;
 };
 
+static bool oob;
+#ifdef CONFIG_UIO_OOB
+module_param(oob, bool, 0);
+MODULE_PARM_DESC(oob, "Handle the device interrupt on the out-of-band stage");
+#endif
+
 /* Bits in uio_pdrv_genirq_platdata.flags */
 enum {
 	UIO_IRQ_DISABLED = 0,
@@ -148,6 +155,9 @@ static int uio_pdrv_genirq_probe(struct platform_device *pdev)
 		return ret;
 	}
 
+	if (oob)
+		uioinfo->irq_flags |= IRQF_OOB;
+
 	priv = devm_kzalloc(&pdev->dev, sizeof(*priv), GFP_KERNEL);
 	if (!priv) {
 		dev_err(&pdev->dev, "unable to kmalloc\n");
@@ -3,6 +3,7 @@
 #define _ASM_GENERIC_EVL_IRQ_H
 
 #include <evl/irq.h>
+#include <evl/irqstat.h>
 
 static inline void irq_enter_pipeline(void)
 {
@@ -18,4 +19,25 @@ static inline void irq_exit_pipeline(void)
 #endif
 }
 
+static inline void irq_stat_pipeline_entry(struct irq_desc *desc)
+{
+#ifdef CONFIG_EVL
+	evl_irqstat_entry(desc);
+#endif
+}
+
+static inline void irq_stat_pipeline_exit(struct irq_desc *desc)
+{
+#ifdef CONFIG_EVL
+	evl_irqstat_exit();
+#endif
+}
+
+static inline void irq_stat_pipeline_replay(struct irq_desc *desc)
+{
+#ifdef CONFIG_EVL
+	evl_irqstat_replay(desc);
+#endif
+}
+
 #endif /* !_ASM_GENERIC_EVL_IRQ_H */
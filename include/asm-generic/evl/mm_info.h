@@ -12,11 +12,16 @@
 #define EVL_MM_INIT_BIT    31
 
 struct evl_wait_queue;
+struct evl_private_heap;
 
 struct oob_mm_state {
 	unsigned long flags;	/* Guaranteed zero initially. */
 	struct list_head ptrace_sync;
 	struct evl_wait_queue ptsync_barrier;
+	struct list_head pinned_ubufs;
+	hard_spinlock_t ubuf_lock;
+	int nr_ubufs;
+	struct evl_private_heap *private_heap;
 };
 
 #else
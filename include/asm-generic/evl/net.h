@@ -13,9 +13,17 @@
 #include <evl/cache.h>
 
 #define EVL_NET_FRAGS_HASHBITS 7
+/* Max. number of datagrams under reassembly per namespace. */
+#define EVL_NET_FRAGS_MAX_TREES	64
+/* Max. memory held by queued fragments per namespace (bytes). */
+#define EVL_NET_FRAGS_MEM_LIMIT	(4 * 1024 * 1024)
+/* Max. number of ARP resolutions in flight per namespace. */
+#define EVL_NET_ARP_MAX_SOLICIT	16
 
 struct evl_net_frag_tdir;
+struct evl_net_arp_solicit;
 struct net_device;
+struct sk_buff;
 
 struct evl_net_frag_tree {
 	/* End offset (bytes). */
@@ -26,46 +34,74 @@ struct evl_net_frag_tree {
 	int flags;
 	/* Root of fragment tree. */
 	struct rb_root frags;
+	/* Rightmost fragment, for in-order insertion in O(1). */
+	struct sk_buff *tail;
+	/* Memory charged for the queued fragments (truesize). */
+	size_t mem;
 	/* Hash collision link. */
 	struct hlist_node hash;
-	/* Backlink to parent tree directory. */
-	struct evl_net_frag_tdir *tdir;
-	/* The device performing garbage collection. */
+	/* Link into the free or aging list of the directory. */
+	struct list_head next;
+	/* Reassembly deadline (IP_FRAG_TIME from first fragment). */
+	ktime_t expiry;
+	/* The device the fragments came from. */
 	struct net_device *gc_dev;
-	/* Garbage collection link (pending). */
-	struct hlist_node gc;
-	/* Expiration timer (set to IP_FRAG_TIME). */
-	struct evl_timer timer;
-	/*
-	 * Serializes access to the frags tree. This is lightweight,
-	 * and may be initialized from the out-of-band stage.
-	 */
-	evl_spinlock_t lock;
 	/* Hash key (ipv4 so far). */
 	union {
 		struct frag_v4_compare_key ipv4;
 	} key;
 };
 
-struct evl_net_frag_gc {
-	/* Garbage collection queue for fragment trees. */
-	struct hlist_head queue;
-	/*
-	 * Serializes access to the garbage collection queue between
-	 * an oob interrupt handler and a kthread.
-	 */
-	hard_spinlock_t lock;
+struct evl_net_frag_stats {
+	/* Datagrams reassembled successfully. */
+	unsigned long reassembled;
+	/* Datagrams dropped on reassembly timeout. */
+	unsigned long timeouts;
+	/* Fragments dropped because no tree was available. */
+	unsigned long table_full;
+	/* Fragments dropped because of the memory limit. */
+	unsigned long overlimit;
+	/* Fragments dropped as malformed or inconsistent. */
+	unsigned long invalid;
+	/* Fragments dropped as duplicates. */
+	unsigned long duplicates;
 };
 
 struct evl_net_frag_tdir {
 	/* Hash map of fragment trees. */
 	DECLARE_HASHTABLE(ht, EVL_NET_FRAGS_HASHBITS);
-	/* Serializes updates to the hash table. */
+	/* Preallocated array of trees. */
+	struct evl_net_frag_tree *trees;
+	/* Trees available for reassembly. */
+	struct list_head free_trees;
+	/* Trees under reassembly, oldest first. */
+	struct list_head aging;
+	/* Serializes all updates to the directory and its trees. */
 	struct evl_kmutex lock;
-	/* Garbage collector. */
-	struct evl_net_frag_gc gc;
+	/* Single expiry timer, armed for the oldest tree. */
+	struct evl_timer timer;
+	/* The device whose RX thread runs the expiry sweep. */
+	struct net_device *gc_dev;
+	/* Set by the timer when a sweep is due. */
+	bool sweep;
+	/* Memory held by queued fragments, and its limit (bytes). */
+	size_t mem;
+	size_t mem_limit;
 	/* Fragment lifetime (ns). */
 	ktime_t timeout;
+	/* Drop and reassembly counters, guarded by ->lock. */
+	struct evl_net_frag_stats stats;
+};
+
+struct evl_net_arp_sdir {
+	/* Preallocated array of solicitation slots. */
+	struct evl_net_arp_solicit *slots;
+	/* Number of slots in use. */
+	unsigned int nr_busy;
+	/* Serializes all updates to the directory and its slots. */
+	hard_spinlock_t lock;
+	/* Retransmit and expiry timer, running while a slot is busy. */
+	struct evl_timer timer;
 };
 
 struct oob_net_state {
@@ -74,11 +110,23 @@ struct oob_net_state {
 		struct evl_net_frag_tdir ftdir;
 		/* ARP resolution cache. */
 		struct evl_cache arp;
+		/* ARP resolutions in flight from the oob stage. */
+		struct evl_net_arp_sdir sdir;
 		/* Route cache of IPv4 destinations. */
 		struct evl_cache routes;
 		/* Cache of active UDP4 receivers. */
 		struct evl_cache udp;
+		/* Multicast group memberships of UDP4 sockets. */
+		struct evl_cache mcast;
 	} ipv4;
+	struct {
+		/* Neighbor cache. */
+		struct evl_cache ndisc;
+		/* Route cache of IPv6 destinations. */
+		struct evl_cache routes;
+		/* Cache of active UDP6 receivers. */
+		struct evl_cache udp;
+	} ipv6;
 };
 
 void net_init_oob_state(struct net *net);
@@ -6,16 +6,21 @@
 
 #include <linux/list.h>
 #include <linux/rcupdate.h>
+#include <linux/workqueue.h>
 #include <net/page_pool/types.h>
 #include <evl/wait.h>
 #include <evl/poll.h>
 #include <evl/flag.h>
 #include <evl/stax.h>
 #include <evl/crossing.h>
+#include <evl/work.h>
+#include <uapi/evl/net/bpf-abi.h>
 
 struct evl_net_qdisc;
 struct evl_kthread;
+struct net_device;
 struct bpf_prog;
+struct evl_socket;
 
 struct evl_net_skb_queue {
 	struct list_head queue;
@@ -29,6 +34,65 @@ struct evl_net_ebpf_filter {
 
 #define EVL_NETDEV_POLL_SCHED    0
 #define EVL_NETDEV_RXFILTER_BIT  1
+#define EVL_NETDEV_RX_OWNED      2 /* Lane is driven (thread or busy poller) */
+#define EVL_NETDEV_TXFILTER_BIT  3
+
+/*
+ * Ingress packets are sorted into priority bands, the handler always
+ * serves the highest non-empty band first.
+ */
+#define EVL_NET_RX_BANDS  4
+
+/*
+ * An RX lane serves a subset of the hardware RX queues of a device,
+ * with its own handler thread pinned to an oob CPU.
+ */
+struct evl_netdev_rx_lane {
+	struct net_device *dev;
+	struct evl_kthread *handler;
+	struct evl_flag flag;
+	struct list_head poll; /* NAPI instances to poll (oob) */
+	hard_spinlock_t lock; /* Serializes accesses to poll */
+	struct evl_net_skb_queue packets[EVL_NET_RX_BANDS]; /* Ingress packets by band (oob) */
+	unsigned long flags;
+	unsigned int index;
+	int cpu;	/* -1 if not pinned to a single CPU */
+};
+
+/*
+ * Flows steered to the RX lane of their consumer CPU, indexed by the
+ * NIC flow hash, each slot holds a lane index plus one, zero if
+ * unset.
+ */
+#define EVL_NETDEV_RX_FLOWS  256
+
+/*
+ * Per-CPU cache of free TX pages, refilled from and drained to the
+ * device pool by batches.
+ */
+#define EVL_NETDEV_MAGAZINE_SIZE  32
+
+struct evl_netdev_magazine {
+	unsigned int count;
+	struct page *pages[EVL_NETDEV_MAGAZINE_SIZE];
+} ____cacheline_aligned;
+
+/* Count of resizing periods kept in the pool occupancy history. */
+#define EVL_NETDEV_POOL_HIST  8
+
+/*
+ * Per-CPU counters of an oob port. Racing with the other stage on
+ * the same CPU may lose an update, which is fine for statistics.
+ */
+struct evl_netdev_stats {
+	u64 rx_packets;
+	u64 rx_bytes;
+	u64 rx_unclaimed;
+	u64 tx_packets;
+	u64 tx_bytes;
+	u64 tx_qdisc_drops;
+	u64 tx_errors;
+};
 
 struct evl_netdev_state {
 	/* TX page pool (premapped if device is oob-capable). */
@@ -36,20 +100,39 @@ struct evl_netdev_state {
 	struct evl_wait_queue tx_wait;
 	size_t pool_max;
 	size_t buf_size;
+	struct evl_netdev_magazine __percpu *magazines;
+	unsigned int magazine_size;
+	atomic_t pool_misses;
+	/* Adaptive sizing of the TX pool, pool_max is the current size. */
+	size_t pool_min;
+	size_t pool_limit;
+	atomic_t pool_low;	/* low-water mark of free pages */
+	int pool_last_misses;
+	unsigned int pool_idle;
+	unsigned int pool_hist[EVL_NETDEV_POOL_HIST]; /* peak use (%) */
+	unsigned int pool_hist_next;
+	struct delayed_work pool_resizer;
+	struct evl_work pool_kick;
 	struct evl_poll_head poll_head;
 	/* RX handling */
-	struct evl_kthread *rx_handler;
-	struct evl_flag rx_flag;
-	struct list_head rx_poll; /* NAPI instances to poll (oob) */
-	hard_spinlock_t rx_lock; /* Serializes accesses to rx_poll */
-	struct evl_net_skb_queue rx_packets; /* Ingress packets to process (oob) */
+	struct evl_netdev_rx_lane *rx_lanes;
+	unsigned int nr_rx_lanes;
+	u8 rx_flows[EVL_NETDEV_RX_FLOWS];
 	/* TX handling */
-	struct evl_net_qdisc *qdisc;
+	struct evl_net_qdisc __rcu *qdisc;
 	struct evl_kthread *tx_handler;
 	struct evl_flag tx_flag;
-	/* RX filter/redirector */
+	/* RX filter/redirector, TX classifier */
 	spinlock_t filter_lock;
 	struct evl_net_ebpf_filter __rcu *rx_filter;
+	struct evl_socket __rcu *rx_socks[EVL_RX_MAX_SOCKETS];
+	atomic_long_t rx_verdicts[EVL_RX_NR_ACTIONS];
+	atomic_long_t rx_invalid;
+	struct evl_net_ebpf_filter __rcu *tx_filter;
+	atomic_long_t tx_verdicts[EVL_TX_NR_ACTIONS];
+	atomic_long_t tx_invalid;
+	/* Counters. */
+	struct evl_netdev_stats __percpu *stats;
 	/* Runtime state flags. */
 	unsigned long flags;
 	/* Count of oob ports referring to this device. */
@@ -19,6 +19,7 @@ struct oob_poll_wait {
 		void (*unwatch)(struct evl_poll_head *head);
 		int events_received;
 		int index;
+		int prio;	/* Waiter priority, orders the poll head */
 	} connectors[EVL_POLL_NR_CONNECTORS];
 };
 
@@ -6,6 +6,7 @@
 #define __CLKSOURCE_ARM_ARCH_TIMER_H
 
 #include <linux/bitops.h>
+#include <linux/errno.h>
 #include <linux/timecounter.h>
 #include <linux/types.h>
 
@@ -96,6 +97,16 @@ extern u64 (*arch_timer_read_counter)(void);
 extern struct arch_timer_kvm_info *arch_timer_get_kvm_info(void);
 extern bool arch_timer_evtstrm_available(void);
 
+struct clock_event_device;
+#ifdef CONFIG_IRQ_PIPELINE
+extern int arch_timer_get_oob_access(struct clock_event_device *clk);
+#else
+static inline int arch_timer_get_oob_access(struct clock_event_device *clk)
+{
+	return -ENODEV;
+}
+#endif
+
 #else
 
 static inline u32 arch_timer_get_rate(void)
@@ -113,6 +124,12 @@ static inline bool arch_timer_evtstrm_available(void)
 	return false;
 }
 
+struct clock_event_device;
+static inline int arch_timer_get_oob_access(struct clock_event_device *clk)
+{
+	return -ENODEV;
+}
+
 #endif
 
 #endif
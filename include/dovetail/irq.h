@@ -8,4 +8,14 @@ static inline void irq_enter_pipeline(void) { }
 
 static inline void irq_exit_pipeline(void) { }
 
+/* Placeholders for tracking events through the pipeline. */
+
+struct irq_desc;
+
+static inline void irq_stat_pipeline_entry(struct irq_desc *desc) { }
+
+static inline void irq_stat_pipeline_exit(struct irq_desc *desc) { }
+
+static inline void irq_stat_pipeline_replay(struct irq_desc *desc) { }
+
 #endif /* !_DOVETAIL_IRQ_H */
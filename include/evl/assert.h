@@ -9,22 +9,31 @@
 #define _EVL_ASSERT_H
 
 #include <linux/kconfig.h>
+#include <linux/jump_label.h>
 #include <linux/irqstage.h>
 
 #define EVL_INFO	KERN_INFO    "EVL: "
 #define EVL_WARNING	KERN_WARNING "EVL: "
 #define EVL_ERR		KERN_ERR     "EVL: "
 
+/*
+ * Compiled-in assertions can be switched off at runtime via
+ * /sys/devices/virtual/evl/control/debug_checks.
+ */
+DECLARE_STATIC_KEY_TRUE(evl_debug_checks);
+
 #define EVL_DEBUG(__subsys)				\
 	IS_ENABLED(CONFIG_EVL_DEBUG_##__subsys)
+#define EVL_CHECK(__subsys)				\
+	(EVL_DEBUG(__subsys) && static_branch_likely(&evl_debug_checks))
 #define EVL_ASSERT(__subsys, __cond)			\
-	(!WARN_ON(EVL_DEBUG(__subsys) && !(__cond)))
+	(!WARN_ON(EVL_CHECK(__subsys) && !(__cond)))
 #define EVL_WARN(__subsys, __cond, __fmt...)		\
-	WARN(EVL_DEBUG(__subsys) && (__cond), __fmt)
+	WARN(EVL_CHECK(__subsys) && (__cond), __fmt)
 #define EVL_WARN_ON(__subsys, __cond)			\
-	WARN_ON(EVL_DEBUG(__subsys) && (__cond))
+	WARN_ON(EVL_CHECK(__subsys) && (__cond))
 #define EVL_WARN_ON_ONCE(__subsys, __cond)		\
-	WARN_ON_ONCE(EVL_DEBUG(__subsys) && (__cond))
+	WARN_ON_ONCE(EVL_CHECK(__subsys) && (__cond))
 #ifdef CONFIG_SMP
 #define EVL_WARN_ON_SMP(__subsys, __cond)		\
 	EVL_WARN_ON(__subsys, __cond)
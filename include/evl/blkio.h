@@ -0,0 +1,65 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_BLKIO_H
+#define _EVL_BLKIO_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <uapi/evl/blkio-abi.h>
+
+struct page;
+struct evl_blkio_queue;
+
+/*
+ * A request to an oob block queue. The I/O buffer lives in a pinned
+ * user buffer, described by its page array and the offset of the
+ * data into the first page, so that the provider may build its DMA
+ * descriptors (e.g. NVMe PRP lists) from it. The buffer is also
+ * mapped into the kernel space at vaddr.
+ */
+struct evl_blkio_req {
+	int op;			/* EVL_BLKIO_* */
+	sector_t sector;	/* Absolute on the queue */
+	unsigned int nr_sectors;
+	struct page **pages;
+	unsigned int offset;
+	void *vaddr;
+	unsigned int tag;	/* Passed back to evl_blkio_complete() */
+};
+
+/*
+ * Both handlers are called from the out-of-band stage with hard irqs
+ * off, serialized by the core. ->submit() must not wait for the
+ * device, only queue the request then ring the doorbell, returning
+ * -EAGAIN if the hardware queue is full. ->poll() reaps the pending
+ * completions, calling evl_blkio_complete() for each of them, and
+ * returns their count.
+ */
+struct evl_blkio_ops {
+	int (*submit)(struct evl_blkio_queue *q, struct evl_blkio_req *req);
+	int (*poll)(struct evl_blkio_queue *q);
+};
+
+struct evl_blkio_queue {
+	const char *name;
+	const struct evl_blkio_ops *ops;
+	unsigned int sector_shift;
+	/* The range of sectors reserved for oob use. */
+	sector_t start_sector;
+	sector_t nr_sectors;
+	unsigned int depth;
+	/* Private to the core. */
+	void *owner;
+	struct list_head next;
+};
+
+int evl_register_blkio_queue(struct evl_blkio_queue *q);
+
+void evl_unregister_blkio_queue(struct evl_blkio_queue *q);
+
+void evl_blkio_complete(struct evl_blkio_queue *q,
+			unsigned int tag, int status);
+
+#endif /* !_EVL_BLKIO_H */
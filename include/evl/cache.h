@@ -13,6 +13,7 @@
 #include <linux/spinlock.h>
 #include <linux/rcupdate.h>
 #include <linux/refcount.h>
+#include <linux/llist.h>
 #include <evl/work.h>
 
 struct evl_cache;
@@ -23,8 +24,8 @@ struct evl_cache_entry {
 	refcount_t refcnt;
 	/* Link in hash table. */
 	struct evl_cache_entry __rcu *next;
-	/* Holder for work trampoline to RCU. */
-	struct evl_work work;
+	/* Link in the oob reclaim queue. */
+	struct llist_node reclaim;
 	/* Owner cache. */
 	struct evl_cache *cache;
 	/* RCU holder for release. */
@@ -48,10 +49,21 @@ struct evl_hash_table {
 	unsigned int shift;
 	/* Number of busy entries. */
 	int nr_entries;
+	/* Larger table entries are migrating to, if resizing. */
+	struct evl_hash_table __rcu *future;
 	/* RCU holder for release. */
 	struct rcu_head	rcu;
 };
 
+/* Per-CPU lookup statistics, approximate. */
+struct evl_cache_stats {
+	unsigned long lookups;
+	unsigned long misses;
+	/* Entries compared, which gives the average depth. */
+	unsigned long probes;
+	unsigned int max_depth;
+};
+
 /* Generic cache. */
 struct evl_cache {
 	/* Client-specific operation descriptor. */
@@ -64,6 +76,8 @@ struct evl_cache {
 	size_t init_shift;
 	/* Name of cache. */
 	const char *name;
+	/* Lookup statistics. */
+	struct evl_cache_stats __percpu *stats;
 };
 
 int evl_init_cache(struct evl_cache *cache);
@@ -98,6 +112,9 @@ void evl_clean_cache(struct evl_cache *cache,
 
 void evl_flush_cache(struct evl_cache *cache);
 
+ssize_t evl_show_cache_stats(struct evl_cache *cache,
+			char *buf, size_t size);
+
 static inline void evl_lock_cache(struct evl_cache *cache)
 {
 	spin_lock_bh(&cache->lock);
@@ -21,8 +21,11 @@
 
 struct evl_rq;
 struct evl_timerbase;
+struct evl_slave_tqueue;
+struct evl_clock_lateness;
 struct clock_event_device;
 struct __kernel_timex;
+struct file;
 
 struct evl_clock_gravity {
 	ktime_t irq;
@@ -48,8 +51,13 @@ struct evl_clock {
 		void (*adjust)(struct evl_clock *clock);
 	} ops;
 	struct evl_timerbase *timerdata;
+	struct evl_slave_tqueue *slavedata;
 	struct evl_clock *master;
 	ktime_t offset;	/* from master clock. */
+	struct evl_clock_state *u_state; /* in the shared heap */
+#ifdef CONFIG_EVL_RUNSTATS
+	struct evl_clock_lateness __percpu *lateness;
+#endif
 #ifdef CONFIG_SMP
 	struct cpumask affinity; /* which CPU this clock beats on. */
 #endif
@@ -77,6 +85,15 @@ void evl_adjust_timers(struct evl_clock *clock,
 
 void evl_stop_timers(struct evl_clock *clock);
 
+void evl_publish_clock_state(struct evl_clock *clock,
+			ktime_t mono_ref, ktime_t base,
+			u64 mult, u32 shift);
+
+static inline void evl_publish_clock_offset(struct evl_clock *clock)
+{
+	evl_publish_clock_state(clock, 0, clock->offset, 1, 0);
+}
+
 static inline u64 evl_read_clock_cycles(struct evl_clock *clock)
 {
 	return clock->ops.read_cycles(clock);
@@ -141,6 +158,25 @@ static inline void evl_reset_clock_gravity(struct evl_clock *clock)
 
 #define evl_get_clock_gravity(__clock, __type)  ((__clock)->gravity.__type)
 
+int evl_read_timerfd(struct file *filp, u64 *ticks, ktime_t *expiry);
+
+#ifdef CONFIG_EVL_GRAVITY_AUTOTUNE
+
+int evl_start_gravity_tuning(ktime_t bound);
+
+void evl_stop_gravity_tuning(void);
+
+ktime_t evl_get_gravity_tuning(void);
+
+ssize_t evl_show_gravity_history(char *buf, size_t size);
+
+#else
+
+static inline void evl_stop_gravity_tuning(void)
+{ }
+
+#endif
+
 int evl_clock_init(void);
 
 void evl_clock_cleanup(void);
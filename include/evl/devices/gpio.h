@@ -15,6 +15,7 @@
 #include <evl/poll.h>
 #include <evl/wait.h>
 #include <evl/irq.h>
+#include <evl/timer.h>
 
 struct lineevent_oob_state {
 	struct evl_file efile;
@@ -23,16 +24,23 @@ struct lineevent_oob_state {
 	hard_spinlock_t lock;
 };
 
+struct linehandle_pulse;
+
+struct linehandle_oob_state {
+	struct evl_file efile;
+	struct linehandle_pulse *pulse;
+};
+
 #else
 
 struct lineevent_oob_state {
 	struct evl_file efile;
 };
 
-#endif
-
 struct linehandle_oob_state {
 	struct evl_file efile;
 };
 
+#endif
+
 #endif /* !_EVL_DEVICES_GPIO_H */
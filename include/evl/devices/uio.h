@@ -0,0 +1,30 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_DEVICES_UIO_H
+#define _EVL_DEVICES_UIO_H
+
+#include <evl/device.h>
+
+#ifdef CONFIG_UIO_OOB
+
+#include <linux/irq_work.h>
+#include <evl/clock.h>
+#include <evl/poll.h>
+#include <evl/sched.h>
+#include <evl/wait.h>
+
+struct uio_oob_state {
+	struct evl_wait_queue wait;
+	struct evl_poll_head poll_head;
+	struct irq_work inband_work;
+};
+
+#else
+
+struct uio_oob_state { };
+
+#endif
+
+#endif /* !_EVL_DEVICES_UIO_H */
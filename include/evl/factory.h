@@ -13,7 +13,6 @@
 #include <linux/bits.h>
 #include <linux/list.h>
 #include <linux/spinlock.h>
-#include <linux/rbtree.h>
 #include <linux/rcupdate.h>
 #include <linux/irq_work.h>
 #include <linux/mutex.h>
@@ -39,9 +38,15 @@ struct evl_element;
 
 #define EVL_DEVHASH_BITS	8
 
+#define EVL_INDEX_HASH_BITS	8
+
+/*
+ * Fundles are hashed for lookups from either stage, which run
+ * locklessly under RCU protection, like evl_cache lookups do.
+ */
 struct evl_index {
-	struct rb_root root;
-	hard_spinlock_t lock;
+	DECLARE_HASHTABLE(table, EVL_INDEX_HASH_BITS);
+	hard_spinlock_t lock;	/* Serializes updates. */
 	fundle_t generator;
 };
 
@@ -82,9 +87,10 @@ struct evl_element {
 	refcount_t refs;
 	fundle_t fundle;
 	int clone_flags;
-	struct rb_node index_node;
+	struct hlist_node index_node;
 	struct irq_work irq_work;
 	struct list_head flush;
+	struct list_head publish;
 	struct hlist_node hash;
 	struct {
 		struct file *filp;
@@ -140,6 +146,17 @@ __evl_get_element_by_fundle(struct evl_index *map,
 		evl_get_element_by_fundle(__map, __fundle, __type);	\
 	})
 
+struct evl_element *
+__evl_get_element_by_name(struct evl_factory *fac,
+			const char *name);
+
+#define evl_get_factory_element_by_name(__fac, __name, __type)		\
+	({								\
+		struct evl_element *__e;				\
+		__e = __evl_get_element_by_name(__fac, __name);		\
+		__e ? container_of(__e, __type, element) : NULL;	\
+	})
+
 /*
  * An element can be disposed of only after the device backing it is
  * removed. If @dev is valid, so is @e at the time of the call.
@@ -174,6 +191,11 @@ static inline bool evl_element_is_observable(struct evl_element *e)
 	return !!(e->clone_flags & EVL_CLONE_OBSERVABLE);
 }
 
+static inline bool evl_element_is_deferred(struct evl_element *e)
+{
+	return !!(e->clone_flags & EVL_CLONE_DEFERRED);
+}
+
 void __evl_put_element(struct evl_element *e);
 
 static inline void evl_put_element(struct evl_element *e) /* in-band or OOB */
@@ -230,7 +252,13 @@ extern struct evl_factory evl_monitor_factory;
 extern struct evl_factory evl_poll_factory;
 extern struct evl_factory evl_thread_factory;
 extern struct evl_factory evl_trace_factory;
+extern struct evl_factory evl_flightrec_factory;
+extern struct evl_factory evl_blkio_factory;
 extern struct evl_factory evl_xbuf_factory;
+extern struct evl_factory evl_mqueue_factory;
+extern struct evl_factory evl_evgroup_factory;
+extern struct evl_factory evl_barrier_factory;
+extern struct evl_factory evl_blackboard_factory;
 extern struct evl_factory evl_proxy_factory;
 extern struct evl_factory evl_observable_factory;
 extern struct evl_factory evl_rng_factory;
@@ -7,7 +7,6 @@
 #ifndef _EVL_FILE_H
 #define _EVL_FILE_H
 
-#include <linux/rbtree.h>
 #include <linux/list.h>
 #include <evl/crossing.h>
 
@@ -25,7 +24,7 @@ struct evl_fd {
 	unsigned int fd;
 	struct evl_file *efilp;
 	struct files_struct *files;
-	struct rb_node rb;
+	struct hlist_node hash;
 	struct list_head poll_nodes; /* poll_item->node */
 };
 
@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_FLIGHTREC_H
+#define _EVL_FLIGHTREC_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/jump_label.h>
+#include <uapi/evl/flightrec-abi.h>
+
+#ifdef CONFIG_EVL_FLIGHTREC
+
+DECLARE_STATIC_KEY_FALSE(evl_flightrec_enabled);
+
+void __evl_flightrec(int type, pid_t pid, u64 arg0, u64 arg1);
+
+void __evl_flightrec_timer(ktime_t lateness);
+
+/* Arguments are only evaluated when the recorder is enabled. */
+#define evl_flightrec(__type, __pid, __arg0, __arg1)			\
+	do {								\
+		if (static_branch_unlikely(&evl_flightrec_enabled))	\
+			__evl_flightrec(__type, __pid, __arg0, __arg1);	\
+	} while (0)
+
+static __always_inline
+void evl_flightrec_timer(ktime_t lateness)
+{
+	if (static_branch_unlikely(&evl_flightrec_enabled))
+		__evl_flightrec_timer(lateness);
+}
+
+void evl_freeze_flightrec(void);
+
+void evl_init_flightrec(void);
+
+#else
+
+#define evl_flightrec(__type, __pid, __arg0, __arg1)	\
+	do { } while (0)
+
+static inline
+void evl_flightrec_timer(ktime_t lateness)
+{ }
+
+static inline void evl_freeze_flightrec(void)
+{ }
+
+static inline void evl_init_flightrec(void)
+{ }
+
+#endif
+
+#endif /* !_EVL_FLIGHTREC_H */
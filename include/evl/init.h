@@ -16,6 +16,8 @@ DECLARE_PER_CPU(struct evl_machine_cpudata, evl_machine_cpudata);
 
 extern struct cpumask evl_oob_cpus;
 
+extern struct cpumask evl_tickless_cpus;
+
 #ifdef CONFIG_EVL_DEBUG
 void evl_warn_init(const char *fn, int level, int status);
 #else
@@ -8,6 +8,8 @@
 #define _EVL_IRQ_H
 
 #include <evl/sched.h>
+#include <evl/flightrec.h>
+#include <evl/irqstat.h>
 
 /* hard irqs off. */
 static inline void evl_enter_irq(void)
@@ -15,6 +17,8 @@ static inline void evl_enter_irq(void)
 	struct evl_rq *rq = this_evl_rq();
 
 	rq->local_flags |= RQ_IRQ;
+	evl_flightrec(EVL_FLTREC_IRQENTRY, 0, 0, 0);
+	evl_irqstat_oob();
 }
 
 /* hard irqs off. */
@@ -23,6 +27,7 @@ static inline void evl_exit_irq(void)
 	struct evl_rq *this_rq = this_evl_rq();
 
 	this_rq->local_flags &= ~RQ_IRQ;
+	evl_flightrec(EVL_FLTREC_IRQEXIT, 0, 0, 0);
 
 	/*
 	 * CAUTION: Switching stages as a result of rescheduling may
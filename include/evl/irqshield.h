@@ -0,0 +1,25 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_IRQSHIELD_H
+#define _EVL_IRQSHIELD_H
+
+#include <linux/cpumask.h>
+
+#ifdef CONFIG_EVL_IRQ_SHIELD
+
+extern struct cpumask evl_irq_shield_cpus;
+
+unsigned long evl_get_irq_shield_violations(void);
+
+void evl_init_irq_shield(void);
+
+#else
+
+static inline void evl_init_irq_shield(void)
+{ }
+
+#endif
+
+#endif /* !_EVL_IRQSHIELD_H */
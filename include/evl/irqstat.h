@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_IRQSTAT_H
+#define _EVL_IRQSTAT_H
+
+#include <linux/jump_label.h>
+
+struct irq_desc;
+
+#ifdef CONFIG_EVL_IRQSTATS
+
+DECLARE_STATIC_KEY_FALSE(evl_irqstats_enabled);
+
+void __evl_irqstat_entry(struct irq_desc *desc);
+
+void __evl_irqstat_exit(void);
+
+void __evl_irqstat_oob(void);
+
+void __evl_irqstat_replay(struct irq_desc *desc);
+
+/* hard irqs off, upon hardware entry. */
+static __always_inline void evl_irqstat_entry(struct irq_desc *desc)
+{
+	if (static_branch_unlikely(&evl_irqstats_enabled))
+		__evl_irqstat_entry(desc);
+}
+
+/* hard irqs off, once the event was dispatched to either stage. */
+static __always_inline void evl_irqstat_exit(void)
+{
+	if (static_branch_unlikely(&evl_irqstats_enabled))
+		__evl_irqstat_exit();
+}
+
+/* hard irqs off, entering the oob stage. */
+static __always_inline void evl_irqstat_oob(void)
+{
+	if (static_branch_unlikely(&evl_irqstats_enabled))
+		__evl_irqstat_oob();
+}
+
+/* In-band, replaying a deferred event. */
+static __always_inline void evl_irqstat_replay(struct irq_desc *desc)
+{
+	if (static_branch_unlikely(&evl_irqstats_enabled))
+		__evl_irqstat_replay(desc);
+}
+
+void evl_init_irqstats(void);
+
+#else
+
+static inline void evl_irqstat_entry(struct irq_desc *desc)
+{ }
+
+static inline void evl_irqstat_exit(void)
+{ }
+
+static inline void evl_irqstat_oob(void)
+{ }
+
+static inline void evl_irqstat_replay(struct irq_desc *desc)
+{ }
+
+static inline void evl_init_irqstats(void)
+{ }
+
+#endif
+
+#endif /* !_EVL_IRQSTAT_H */
@@ -0,0 +1,39 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_KLOG_H
+#define _EVL_KLOG_H
+
+#include <linux/printk.h>
+#include <linux/jump_label.h>
+
+#ifdef CONFIG_EVL_KLOG
+
+DECLARE_STATIC_KEY_FALSE(evl_klog_enabled);
+
+__printf(1, 2) void __evl_klog(const char *fmt, ...);
+
+/*
+ * printk() replacement for the out-of-band stage, the message is
+ * relayed to the in-band log asynchronously. The format may start
+ * with a KERN_<level> prefix.
+ */
+#define evl_klog(__fmt, __args...)					\
+	do {								\
+		if (static_branch_unlikely(&evl_klog_enabled))		\
+			__evl_klog(__fmt, ##__args);			\
+	} while (0)
+
+void evl_init_klog(void);
+
+#else
+
+#define evl_klog(__fmt, __args...)	no_printk(__fmt, ##__args)
+
+static inline void evl_init_klog(void)
+{ }
+
+#endif
+
+#endif /* !_EVL_KLOG_H */
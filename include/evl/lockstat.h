@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_LOCKSTAT_H
+#define _EVL_LOCKSTAT_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <evl/clock.h>
+
+#define EVL_LOCKSTAT_MUTEX	0
+#define EVL_LOCKSTAT_STAX	1
+
+#ifdef CONFIG_EVL_LOCKSTAT
+
+/* Number of contending call sites tracked per lock class. */
+#define EVL_LOCKSTAT_SITES	4
+
+struct evl_lockstat_site {
+	unsigned long ip;
+	unsigned long count;
+};
+
+/*
+ * Contention statistics, shared by all the locks initialized from
+ * the same call site, like lockdep classes.
+ */
+struct evl_lockstat_class {
+	const char *name;
+	int type;		/* EVL_LOCKSTAT_* */
+	struct list_head next;	/* lockstat_classes */
+	hard_spinlock_t lock;
+	unsigned long contended;
+	ktime_t wait_total;
+	ktime_t wait_max;
+	unsigned long holds;
+	ktime_t hold_total;
+	ktime_t hold_max;
+	struct evl_lockstat_site sites[EVL_LOCKSTAT_SITES];
+};
+
+#define EVL_LOCKSTAT_CLASS_INIT(__var, __name, __type)			\
+	{								\
+		.name = __name,						\
+		.type = __type,						\
+		.next = LIST_HEAD_INIT((__var).next),			\
+		.lock = __HARD_SPIN_LOCK_INITIALIZER((__var).lock),	\
+	}
+
+static inline ktime_t evl_lockstat_date(void)
+{
+	return evl_read_clock(&evl_mono_clock);
+}
+
+void evl_register_lockstat(struct evl_lockstat_class *class);
+
+void evl_lockstat_wait(struct evl_lockstat_class *class,
+		ktime_t start, unsigned long ip);
+
+void evl_lockstat_hold(struct evl_lockstat_class *class,
+		ktime_t start);
+
+ssize_t evl_show_lock_stats(char *buf, size_t size);
+
+#else
+
+struct evl_lockstat_class { };
+
+#define EVL_LOCKSTAT_CLASS_INIT(__var, __name, __type)	{ }
+
+static inline ktime_t evl_lockstat_date(void)
+{
+	return 0;
+}
+
+static inline
+void evl_register_lockstat(struct evl_lockstat_class *class)
+{ }
+
+static inline
+void evl_lockstat_wait(struct evl_lockstat_class *class,
+		ktime_t start, unsigned long ip)
+{ }
+
+static inline
+void evl_lockstat_hold(struct evl_lockstat_class *class,
+		ktime_t start)
+{ }
+
+#endif /* !CONFIG_EVL_LOCKSTAT */
+
+#define evl_define_lockstat(__var, __name, __type)		\
+	static struct evl_lockstat_class __var =		\
+		EVL_LOCKSTAT_CLASS_INIT(__var, __name, __type)
+
+#endif /* !_EVL_LOCKSTAT_H */
@@ -0,0 +1,19 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_MEMGUARD_H
+#define _EVL_MEMGUARD_H
+
+#ifdef CONFIG_EVL_MEMGUARD
+
+void evl_kick_memguard(void);
+
+#else
+
+static inline void evl_kick_memguard(void)
+{ }
+
+#endif
+
+#endif /* !_EVL_MEMGUARD_H */
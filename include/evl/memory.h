@@ -12,9 +12,11 @@
 #include <linux/atomic.h>
 #include <linux/spinlock.h>
 #include <linux/rbtree.h>
+#include <linux/refcount.h>
 #include <evl/list.h>
 #include <evl/factory.h>
 #include <uapi/evl/types.h>
+#include <uapi/evl/control-abi.h>
 
 #define EVL_HEAP_PAGE_SHIFT	9 /* 2^9 => 512 bytes */
 #define EVL_HEAP_PAGE_SIZE	(1UL << EVL_HEAP_PAGE_SHIFT)
@@ -32,6 +34,13 @@
 #define EVL_HEAP_PGENT_BITS      (32 - EVL_HEAP_PAGE_SHIFT)
 /* Each page is represented by a page map entry. */
 #define EVL_HEAP_PGMAP_BYTES	sizeof(struct evl_heap_pgentry)
+/*
+ * Free ranges of 2^1 to 2^EVL_HEAP_SEG_ORDERS pages are kept on
+ * per-order lists up to EVL_HEAP_SEG_DEPTH deep, instead of being
+ * merged back into the rbtrees.
+ */
+#define EVL_HEAP_SEG_ORDERS	7 /* 2^7 pages => 64k */
+#define EVL_HEAP_SEG_DEPTH	8
 
 struct evl_heap_pgentry {
 	/* Linkage in bucket list. */
@@ -55,14 +64,36 @@ struct evl_heap_pgentry {
  * A range descriptor is stored at the beginning of the first page of
  * a range of free pages. evl_heap_range.size is nrpages *
  * EVL_HEAP_PAGE_SIZE. Ranges are indexed by address and size in
- * rbtrees.
+ * rbtrees, or linked to a segregated list by order.
  */
 struct evl_heap_range {
-	struct rb_node addr_node;
+	union {
+		struct rb_node addr_node;
+		struct list_head seg_next;
+	};
 	struct rb_node size_node;
 	size_t size;
 };
 
+/*
+ * Per-CPU cache of free blocks for a bucket size. EVL_HEAP_MAG_BATCH
+ * blocks move between the heap and a magazine at once, when the
+ * latter runs empty or full.
+ */
+#define EVL_HEAP_MAG_SIZE	16
+#define EVL_HEAP_MAG_BATCH	(EVL_HEAP_MAG_SIZE / 2)
+
+struct evl_heap_magazine {
+	unsigned int count;
+	void *slots[EVL_HEAP_MAG_SIZE];
+	unsigned long hits;
+	unsigned long misses;
+};
+
+struct evl_heap_cache {
+	struct evl_heap_magazine mags[EVL_HEAP_MAX_BUCKETS];
+};
+
 struct evl_heap {
 	void *membase;
 	struct rb_root addr_tree;
@@ -70,9 +101,19 @@ struct evl_heap {
 	struct evl_heap_pgentry *pagemap;
 	size_t usable_size;
 	size_t used_size;
+	size_t peak_used;
+	/* Busy blocks per bucket, multi-page blocks last. */
+	unsigned long nr_busy[EVL_HEAP_MAX_BUCKETS + 1];
 	u32 buckets[EVL_HEAP_MAX_BUCKETS];
+	struct list_head seglists[EVL_HEAP_SEG_ORDERS];
+	int seglen[EVL_HEAP_SEG_ORDERS];
 	hard_spinlock_t lock;
 	struct list_head next;
+	struct evl_heap_cache __percpu *cache;
+	int node;
+#ifdef CONFIG_EVL_DEBUG_HEAP_TAGS
+	unsigned long *tags;
+#endif
 };
 
 extern struct evl_heap evl_system_heap;
@@ -84,6 +125,7 @@ static inline size_t evl_get_heap_size(const struct evl_heap *heap)
 	return heap->usable_size;
 }
 
+/* Blocks held in the per-CPU caches count as used. */
 static inline size_t evl_get_heap_free(const struct evl_heap *heap)
 {
 	return heap->usable_size - heap->used_size;
@@ -99,6 +141,17 @@ int evl_init_heap(struct evl_heap *heap, void *membase,
 
 void evl_destroy_heap(struct evl_heap *heap);
 
+#ifdef CONFIG_EVL_HEAP_CACHE
+int evl_enable_heap_cache(struct evl_heap *heap);
+
+ssize_t evl_show_sysheap_cache(char *buf, size_t size);
+#else
+static inline int evl_enable_heap_cache(struct evl_heap *heap)
+{
+	return 0;
+}
+#endif
+
 void *evl_alloc_chunk(struct evl_heap *heap, size_t size);
 
 void evl_free_chunk(struct evl_heap *heap, void *block);
@@ -122,6 +175,11 @@ int evl_shared_offset(void *p)
 	return p - evl_get_heap_base(&evl_shared_heap);
 }
 
+#if defined(CONFIG_NUMA) || defined(CONFIG_EVL_SYSHEAP_GROWTH)
+void *evl_alloc(size_t size);
+
+void evl_free(void *ptr);
+#else
 static inline void *evl_alloc(size_t size)
 {
 	return evl_alloc_chunk(&evl_system_heap, size);
@@ -131,6 +189,17 @@ static inline void evl_free(void *ptr)
 {
 	evl_free_chunk(&evl_system_heap, ptr);
 }
+#endif
+
+ssize_t evl_show_sysheap_usage(char *buf, size_t size);
+
+int evl_get_core_heap_stats(struct evl_heap_stats *st);
+
+ssize_t evl_show_heap_stats(char *buf, size_t size);
+
+#ifdef CONFIG_EVL_DEBUG_HEAP_TAGS
+ssize_t evl_show_heap_tags(char *buf, size_t size);
+#endif
 
 int evl_init_memory(void);
 
@@ -138,4 +207,36 @@ void evl_cleanup_memory(void);
 
 extern size_t evl_shm_size;
 
+extern bool evl_shm_hugepage;
+
+struct oob_mm_state;
+struct vm_area_struct;
+
+struct evl_private_heap {
+	struct evl_heap heap;
+	refcount_t refs;
+	bool mapped;
+};
+
+int evl_create_private_heap(struct oob_mm_state *oob_mm, size_t size);
+
+void evl_drop_private_heap(struct oob_mm_state *oob_mm);
+
+int evl_mmap_private_heap(struct vm_area_struct *vma, unsigned long addr);
+
+struct evl_heap *evl_get_state_heap(int clone_flags);
+
+void evl_put_state_heap(struct evl_heap *heap);
+
+/* Offset of @p from the base of the calling process's mapping. */
+static inline
+int evl_state_offset(struct evl_heap *heap, void *p)
+{
+	if (heap == &evl_shared_heap)
+		return evl_shared_offset(p);
+
+	/* Private heaps are mapped right past the shared one. */
+	return evl_shm_size + (p - evl_get_heap_base(heap));
+}
+
 #endif /* !_EVL_MEMORY_H */
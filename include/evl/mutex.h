@@ -15,6 +15,7 @@
 #include <evl/timer.h>
 #include <evl/wait.h>
 #include <evl/sched.h>
+#include <evl/lockstat.h>
 
 struct evl_clock;
 struct evl_thread;
@@ -43,6 +44,19 @@ struct evl_mutex {
 		int wprio;
 	} boost;
 	struct evl_clock *clock;
+#ifdef CONFIG_EVL_LOCKSTAT
+	struct evl_lockstat_class *lockstat;
+	ktime_t lockstat_date;	/* Start of in-kernel ownership */
+#endif
+#ifdef CONFIG_EVL_MUTEX_SPIN
+	atomic_t spin_acquired;	/* Contended acquisitions by spinning */
+	atomic_t slept;		/* Contended acquisitions by sleeping */
+#endif
+};
+
+struct evl_mutex_stats {
+	unsigned int spin_acquired;
+	unsigned int slept;
 };
 
 void __evl_init_mutex(struct evl_mutex *mutex,
@@ -50,12 +64,15 @@ void __evl_init_mutex(struct evl_mutex *mutex,
 		atomic_t *fastlock,
 		u32 *ceiling,
 		const char *name,
-		struct lock_class_key *lock_key);
+		struct lock_class_key *lock_key,
+		struct evl_lockstat_class *lockstat);
 
 #define evl_init_mutex(__mutex, __clock, __fastlock, __ceiling)		\
 	do {								\
 		static struct lock_class_key key;			\
-		__evl_init_mutex(__mutex, __clock, __fastlock, __ceiling, #__mutex, &key); \
+		evl_define_lockstat(lockstat, #__mutex, EVL_LOCKSTAT_MUTEX); \
+		__evl_init_mutex(__mutex, __clock, __fastlock, __ceiling, #__mutex, \
+				&key, &lockstat);			\
 	} while (0)
 
 #define evl_init_mutex_pi(__mutex, __clock, __fastlock)			\
@@ -68,6 +85,9 @@ void evl_destroy_mutex(struct evl_mutex *mutex);
 
 int evl_trylock_mutex(struct evl_mutex *mutex);
 
+void evl_get_mutex_stats(struct evl_mutex *mutex,
+			struct evl_mutex_stats *stats);
+
 int evl_lock_mutex_timeout(struct evl_mutex *mutex, ktime_t timeout,
 			enum evl_tmode timeout_mode);
 
@@ -115,6 +135,8 @@ struct evl_kmutex {
 				.owner = NULL,				\
 				.requeue_wait = evl_requeue_mutex_wait,	\
 				.wait_list = LIST_HEAD_INIT((__name).mutex.wchan.wait_list), \
+				.wait_index = RB_ROOT,			\
+				.nr_waiters = 0,			\
 				.name = #__name,			\
 			},						\
 		},							\
@@ -0,0 +1,27 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_NET_CAN_H
+#define _EVL_NET_CAN_H
+
+#include <evl/net/socket.h>
+
+struct sk_buff;
+
+#ifdef CONFIG_EVL_NET_CAN
+
+bool evl_net_can_accept(struct sk_buff *skb);
+
+#else
+
+static inline bool evl_net_can_accept(struct sk_buff *skb)
+{
+	return false;
+}
+
+#endif
+
+extern struct evl_socket_domain evl_net_can;
+
+#endif /* !_EVL_NET_CAN_H */
@@ -38,10 +38,15 @@ void evl_net_wake_rx(struct net_device *dev);
 
 int evl_net_dev_allocfd(struct net *net, const char *devname);
 
-enum evl_net_rx_action
-__evl_net_filter_rx(struct evl_netdev_state *est, struct sk_buff *skb);
+bool evl_net_steer_rx_socket(struct sk_buff *skb, unsigned int slot);
 
-static inline enum evl_net_rx_action
+u32 __evl_net_filter_rx(struct evl_netdev_state *est, struct sk_buff *skb);
+
+/*
+ * Returns the verdict of the RX program, see EVL_RX_ACTION() and
+ * EVL_RX_ARG().
+ */
+static inline u32
 evl_net_filter_rx(struct net_device *dev, struct sk_buff *skb)
 {
 	struct evl_netdev_state *est = dev->oob_state.estate;
@@ -52,6 +57,28 @@ evl_net_filter_rx(struct net_device *dev, struct sk_buff *skb)
 	return EVL_RX_VLAN;
 }
 
+u32 __evl_net_filter_tx(struct evl_netdev_state *est, struct sk_buff *skb);
+
+/*
+ * Returns the verdict of the TX program, see EVL_TX_ACTION() and
+ * EVL_TX_ARG().
+ */
+static inline u32
+evl_net_filter_tx(struct net_device *dev, struct sk_buff *skb)
+{
+	struct evl_netdev_state *est = dev->oob_state.estate;
+
+	if (test_bit(EVL_NETDEV_TXFILTER_BIT, &est->flags))
+		return __evl_net_filter_tx(est, skb);
+
+	return EVL_TX_PASS;
+}
+
+#define evl_net_inc_port_stat(__est, __field)		\
+	this_cpu_inc((__est)->stats->__field)
+#define evl_net_add_port_stat(__est, __field, __val)	\
+	this_cpu_add((__est)->stats->__field, __val)
+
 static inline struct net_device *evl_net_real_dev(struct net_device *dev)
 {
 	if (is_vlan_dev(dev))
@@ -60,6 +87,24 @@ static inline struct net_device *evl_net_real_dev(struct net_device *dev)
 	return dev;
 }
 
+/*
+ * Whether the NIC behind @dev computes the transport checksum of
+ * the outgoing packets matching @mask (e.g. NETIF_F_IP_CSUM). Frames
+ * sent via a VLAN device are tagged inline, which the NIC must be
+ * able to parse as well.
+ */
+static inline bool evl_net_can_offload_csum(struct net_device *dev,
+					netdev_features_t mask)
+{
+	struct net_device *real_dev = evl_net_real_dev(dev);
+	netdev_features_t features = READ_ONCE(real_dev->features);
+
+	if (is_vlan_dev(dev))
+		features &= real_dev->vlan_features;
+
+	return !!(features & (mask | NETIF_F_HW_CSUM));
+}
+
 #endif
 
 #endif /* !_EVL_NET_DEVICE_H */
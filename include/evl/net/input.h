@@ -8,6 +8,8 @@
 #define _EVL_NET_INPUT_H
 
 #include <linux/list.h>
+#include <linux/hashtable.h>
+#include <linux/rcupdate.h>
 #include <evl/lock.h>
 
 struct sk_buff;
@@ -16,11 +18,20 @@ struct evl_net_handler {
 	void (*ingress)(struct sk_buff *skb);
 };
 
+#define EVL_NET_RXQ_HASH_BITS	5
+
+/*
+ * Subscribers to an ingress protocol are indexed by the (device,
+ * VLAN) pair they are bound to, for lookup locklessly under RCU by
+ * the receivers. The subscriber list and the index are updated
+ * in-band only, under the lock which serializes accesses to the
+ * protocol hash.
+ */
 struct evl_net_rxqueue {
 	u32 hkey;
 	struct hlist_node hash;
 	struct list_head subscribers;
-	evl_spinlock_t lock;
+	DECLARE_HASHTABLE(sub_hash, EVL_NET_RXQ_HASH_BITS);
 	struct list_head next;
 };
 
@@ -19,6 +19,9 @@ struct evl_net_ipv4_cookie {
 	__be32 daddr;		/* Destination IP */
 	__u8 protocol;		/* Internet protocol identifier  */
 	int transhdrlen;	/* Transport header length */
+	bool pinned;		/* Payload may live in pinned ubufs */
+	__wsum csum;		/* (out) Payload checksum, unless hw_csum */
+	bool hw_csum;		/* (out) NIC checksums the datagram */
 };
 
 int evl_net_ipv4_deliver(struct sk_buff *skb);
@@ -29,7 +32,7 @@ static inline void evl_net_ipv4_gc(struct net *net)
 {
 	struct evl_net_frag_tdir *ftdir = &net->oob.ipv4.ftdir;
 
-	if (!hlist_empty(&ftdir->gc.queue))
+	if (READ_ONCE(ftdir->sweep))
 		__evl_net_ipv4_gc(ftdir);
 }
 
@@ -7,8 +7,13 @@
 #ifndef _EVL_NET_IPV4_ARP_H
 #define _EVL_NET_IPV4_ARP_H
 
+#include <linux/list.h>
 #include <net/neighbour.h>
 #include <evl/cache.h>
+#include <evl/work.h>
+
+/* Max. number of packets waiting for a resolution. */
+#define EVL_NET_ARP_BACKLOG	8
 
 /* ARP entry. */
 struct evl_net_arp_entry {
@@ -18,6 +23,8 @@ struct evl_net_arp_entry {
 	netdevice_tracker dev_tracker;
 	/* Cached hardware address. */
 	unsigned char ha[ALIGN(MAX_ADDR_LEN, sizeof(unsigned long))] __aligned(8);
+	/* Installed administratively, ignores in-band updates. */
+	bool pinned;
 	/* Index key. */
 	struct evl_net_arp_key {
 		/* Associated netdev (in-band refcounted). */
@@ -27,15 +34,59 @@ struct evl_net_arp_entry {
 	} key;
 };
 
+/* Resolution started from the oob stage. */
+struct evl_net_arp_solicit {
+	/* Device the peer is reachable through (NULL if free). */
+	struct net_device *dev;
+	/* IPv4 addresses of the peer and ours. */
+	__be32 daddr;
+	__be32 saddr;
+	/* Resolution status. */
+	enum {
+		EVL_ARP_SOLICIT_PENDING,
+		EVL_ARP_SOLICIT_RESOLVED,
+	} state;
+	/* Date the request is given up at. */
+	ktime_t deadline;
+	/* Hardware address received from the peer. */
+	unsigned char ha[ALIGN(MAX_ADDR_LEN, sizeof(unsigned long))] __aligned(8);
+	/* Packets waiting for the resolution to complete. */
+	struct list_head backlog;
+	unsigned int backlog_len;
+	/* In-band cache update once resolved. */
+	struct evl_work fill_work;
+	/* Back link to the directory. */
+	struct evl_net_arp_sdir *sdir;
+};
+
 int evl_net_init_arp(struct net *net);
 
 void evl_net_cleanup_arp(struct net *net);
 
 void evl_net_flush_arp(struct net *net);
 
+void evl_net_flush_arp_dev(struct net *net, struct net_device *dev);
+
+ssize_t evl_net_store_arp(struct net *net, const char *buf, size_t len);
+
 struct evl_net_arp_entry *
 evl_net_get_arp_entry(struct net_device *dev, __be32 addr);
 
+bool evl_net_solicit_arp(struct net_device *dev, __be32 daddr);
+
+int evl_net_defer_arp_xmit(struct net_device *dev, __be32 daddr,
+			struct sk_buff *skb);
+
+void __evl_net_snoop_arp(struct net *net, struct sk_buff *skb);
+
+static inline void evl_net_snoop_arp(struct sk_buff *skb)
+{
+	struct net *net = dev_net(skb->dev);
+
+	if (READ_ONCE(net->oob.ipv4.sdir.nr_busy))
+		__evl_net_snoop_arp(net, skb);
+}
+
 static inline void evl_net_put_arp_entry(struct evl_net_arp_entry *earp)
 {
 	evl_put_cache_entry(&earp->entry);
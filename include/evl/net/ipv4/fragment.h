@@ -7,8 +7,20 @@
 #ifndef _EVL_NET_IPV4_FRAGMENT_H
 #define _EVL_NET_IPV4_FRAGMENT_H
 
+#include <linux/types.h>
+
 struct sk_buff;
+struct net;
+struct evl_net_frag_tdir;
 
 struct sk_buff *evl_ipv4_defrag(struct sk_buff *skb);
 
+void evl_ipv4_sweep_frags(struct evl_net_frag_tdir *ftdir);
+
+ssize_t evl_ipv4_show_frag_stats(struct net *net, char *buf, size_t len);
+
+int evl_net_init_ipv4_frags(struct net *net);
+
+void evl_net_cleanup_ipv4_frags(struct net *net);
+
 #endif /* !_EVL_NET_IPV4_FRAGMENT_H */
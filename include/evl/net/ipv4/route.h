@@ -26,4 +26,6 @@ void evl_net_flush_ipv4_routes(struct net *net, struct net_device *dev);
 
 struct evl_net_route *evl_net_get_ipv4_route(struct net *net, __be32 daddr);
 
+ssize_t evl_net_store_ipv4_routes(struct net *net, const char *buf, size_t len);
+
 #endif /* !_EVL_NET_IPV4_ROUTE_H */
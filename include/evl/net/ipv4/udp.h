@@ -7,22 +7,39 @@
 #ifndef _EVL_NET_IPV4_UDP_H
 #define _EVL_NET_IPV4_UDP_H
 
-#include <linux/refcount.h>
 #include <evl/net/socket.h>
 #include <evl/cache.h>
 #include <evl/sem.h>
 #include <evl/mutex.h>
 
-/* Cached UDP receiver. */
-struct evl_net_udp_receiver {
-	/* Generic cache entry. */
-	struct evl_cache_entry entry;
+/* Max. number of sockets sharing a port (SO_REUSEPORT). */
+#define EVL_NET_UDP_MAX_FANOUT	32
+
+/* Per-socket receive queue, member of a port group. */
+struct evl_net_udp_rxq {
 	/* Queue of pending datagrams. */
 	struct list_head queue;
-	/* Wait queue receivers sleep on. */
+	/* Wait queue the owner sleeps on. */
 	struct evl_wait_queue wait;
-	/* Users (SO_REUSEPORT) */
-	refcount_t refs;
+	/* CPU the owner last received on, -1 if none yet. */
+	int cpu;
+	/* Owning socket. */
+	struct evl_socket *esk;
+};
+
+/* Cached UDP receiver, i.e. a group of sockets sharing a port. */
+struct evl_net_udp_receiver {
+	/* Generic cache entry. */
+	struct evl_cache_entry entry;
+	/* Serializes oob lookups and in-band updates of the members. */
+	hard_spinlock_t lock;
+	/* Receive queues of the member sockets. */
+	struct evl_net_udp_rxq *members[EVL_NET_UDP_MAX_FANOUT];
+	unsigned int nr_members;
+	/* Fanout policy (EVL_UDP_FANOUT_*). */
+	u32 fanout;
+	/* Cursor for EVL_UDP_FANOUT_RR. */
+	unsigned int rr_next;
 	/* The hash key must be aliasable to u32[]. */
 	struct __evl_net_udp_key {
 		u32 dport;
@@ -30,6 +47,25 @@ struct evl_net_udp_receiver {
 	} key __packed;
 };
 
+/* Max. number of oob sockets joining a group on an interface. */
+#define EVL_NET_UDP_MAX_MCAST	32
+
+/* Cached multicast group membership, fed by IP_ADD_MEMBERSHIP. */
+struct evl_net_udp_mcast {
+	/* Generic cache entry. */
+	struct evl_cache_entry entry;
+	/* Serializes oob lookups and in-band updates of the members. */
+	hard_spinlock_t lock;
+	/* Sockets which joined the group. */
+	struct evl_socket *members[EVL_NET_UDP_MAX_MCAST];
+	unsigned int nr_members;
+	/* The hash key must be aliasable to u32[]. */
+	struct __evl_net_mcast_key {
+		u32 group;
+		u32 ifindex;
+	} key __packed;
+};
+
 int evl_net_deliver_udp(struct sk_buff *skb);
 
 int evl_net_init_udp(struct net *net);
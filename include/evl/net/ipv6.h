@@ -0,0 +1,52 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_NET_IPV6_H
+#define _EVL_NET_IPV6_H
+
+#include <linux/in6.h>
+#include <evl/net/socket.h>
+#include <evl/net/ip.h>
+
+struct sk_buff;
+struct net;
+
+struct evl_net_ipv6_cookie {
+	struct in6_addr saddr;	/* Source IP */
+	struct in6_addr daddr;	/* Destination IP */
+	__u8 protocol;		/* Next header */
+	int transhdrlen;	/* Transport header length */
+	bool pinned;		/* Payload may live in pinned ubufs */
+	__wsum csum;		/* (out) Payload checksum, unless hw_csum */
+	bool hw_csum;		/* (out) NIC checksums the datagram */
+};
+
+#ifdef CONFIG_EVL_NET_IPV6
+
+int evl_net_ipv6_deliver(struct sk_buff *skb);
+
+int evl_net_init_ipv6(struct net *net);
+
+void evl_net_cleanup_ipv6(struct net *net);
+
+#else
+
+static inline int evl_net_ipv6_deliver(struct sk_buff *skb)
+{
+	return -ENOTSUPP;
+}
+
+static inline int evl_net_init_ipv6(struct net *net)
+{
+	return 0;
+}
+
+static inline void evl_net_cleanup_ipv6(struct net *net)
+{ }
+
+#endif
+
+extern struct evl_socket_domain evl_net_ipv6;
+
+#endif /* !_EVL_NET_IPV6_H */
@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_NET_IPV6_NDISC_H
+#define _EVL_NET_IPV6_NDISC_H
+
+#include <linux/in6.h>
+#include <net/neighbour.h>
+#include <evl/cache.h>
+
+/* Neighbor entry. */
+struct evl_net_ndisc_entry {
+	/* Generic cache entry. */
+	struct evl_cache_entry entry;
+	/* Device reference tracker. */
+	netdevice_tracker dev_tracker;
+	/* Cached hardware address. */
+	unsigned char ha[ALIGN(MAX_ADDR_LEN, sizeof(unsigned long))] __aligned(8);
+	/* Index key. */
+	struct evl_net_ndisc_key {
+		/* Associated netdev (in-band refcounted). */
+		struct net_device *dev;
+		/* IPv6 address of neighbor. */
+		struct in6_addr addr;
+	} key;
+};
+
+int evl_net_init_ndisc(struct net *net);
+
+void evl_net_cleanup_ndisc(struct net *net);
+
+void evl_net_flush_ndisc(struct net *net);
+
+struct evl_net_ndisc_entry *
+evl_net_get_ndisc_entry(struct net_device *dev, const struct in6_addr *addr);
+
+static inline void evl_net_put_ndisc_entry(struct evl_net_ndisc_entry *end)
+{
+	evl_put_cache_entry(&end->entry);
+}
+
+#endif /* !_EVL_NET_IPV6_NDISC_H */
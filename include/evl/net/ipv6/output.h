@@ -0,0 +1,24 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_NET_IPV6_OUTPUT_H
+#define _EVL_NET_IPV6_OUTPUT_H
+
+#include <linux/types.h>
+#include <linux/time.h>
+#include <evl/net/output.h>
+
+struct evl_socket;
+struct evl_net_ipv6_route;
+struct evl_net_ipv6_cookie;
+struct iovec;
+
+struct sk_buff *evl_net_ipv6_build_datagram(struct evl_socket *esk,
+					struct iovec *iov, size_t iovlen,
+					struct evl_net_ipv6_route *ert,
+					size_t datalen,
+					ktime_t timeout,
+					struct evl_net_ipv6_cookie *ipc);
+
+#endif /* !_EVL_NET_IPV6_OUTPUT_H */
@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_NET_IPV6_ROUTE_H
+#define _EVL_NET_IPV6_ROUTE_H
+
+#include <linux/in6.h>
+#include <net/ip6_route.h>
+#include <evl/cache.h>
+
+struct net;
+struct net_device;
+struct flowi6;
+
+/* Cached route for IPv6 datagrams. */
+struct evl_net_ipv6_route {
+	/* Generic cache entry. */
+	struct evl_cache_entry entry;
+	/* Destination as resolved in-band (in-band refcounted). */
+	struct dst_entry *dst;
+	/* Source address picked by the in-band stack. */
+	struct in6_addr saddr;
+	/* Index key (destination IP). */
+	struct in6_addr key;
+};
+
+#ifdef CONFIG_EVL_NET_IPV6
+
+int evl_net_init_ipv6_routing(struct net *net);
+
+void evl_net_cleanup_ipv6_routing(struct net *net);
+
+void evl_net_learn_ipv6_route(struct net *net,
+			struct flowi6 *fl6, struct dst_entry *dst);
+
+void evl_net_flush_ipv6_routes(struct net *net, struct net_device *dev);
+
+struct evl_net_ipv6_route *
+evl_net_get_ipv6_route(struct net *net, const struct in6_addr *daddr);
+
+#else
+
+static inline
+void evl_net_flush_ipv6_routes(struct net *net, struct net_device *dev)
+{ }
+
+#endif
+
+static inline void evl_net_put_ipv6_route(struct evl_net_ipv6_route *ert)
+{
+	evl_put_cache_entry(&ert->entry);
+}
+
+static inline const struct in6_addr *
+evl_net_ipv6_nexthop(const struct evl_net_ipv6_route *ert,
+		const struct in6_addr *daddr)
+{
+	return rt6_nexthop(dst_rt6_info(ert->dst), daddr);
+}
+
+#endif /* !_EVL_NET_IPV6_ROUTE_H */
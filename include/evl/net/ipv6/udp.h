@@ -0,0 +1,39 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_NET_IPV6_UDP_H
+#define _EVL_NET_IPV6_UDP_H
+
+#include <linux/refcount.h>
+#include <linux/in6.h>
+#include <evl/net/socket.h>
+#include <evl/cache.h>
+#include <evl/wait.h>
+
+/* Cached UDP6 receiver. */
+struct evl_net_udp6_receiver {
+	/* Generic cache entry. */
+	struct evl_cache_entry entry;
+	/* Queue of pending datagrams. */
+	struct list_head queue;
+	/* Wait queue receivers sleep on. */
+	struct evl_wait_queue wait;
+	/* Users (SO_REUSEPORT) */
+	refcount_t refs;
+	/* The hash key must be aliasable to u32[]. */
+	struct __evl_net_udp6_key {
+		u32 dport;
+		struct in6_addr daddr;
+	} key __packed;
+};
+
+int evl_net_deliver_udp6(struct sk_buff *skb);
+
+int evl_net_init_udp6(struct net *net);
+
+void evl_net_cleanup_udp6(struct net *net);
+
+extern struct evl_net_proto evl_net_udp6_proto;
+
+#endif /* !_EVL_NET_IPV6_UDP_H */
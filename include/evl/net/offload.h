@@ -9,6 +9,7 @@
 
 #include <linux/list.h>
 #include <linux/uio.h>
+#include <linux/in6.h>
 #include <net/ip.h>
 
 struct evl_net_offload {
@@ -16,6 +17,7 @@ struct evl_net_offload {
 	size_t count;
 	union {
 		struct sockaddr_in in;
+		struct sockaddr_in6 in6;
 	} dest;
 	int destlen;
 	struct list_head next;
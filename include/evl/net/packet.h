@@ -11,6 +11,9 @@
 
 bool evl_net_packet_deliver(struct sk_buff *skb);
 
+bool evl_net_packet_deliver_to(struct evl_socket *esk,
+			struct sk_buff *skb);
+
 extern struct evl_socket_domain evl_net_packet;
 
 #endif /* !_EVL_NET_PACKET_H */
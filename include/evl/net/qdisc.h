@@ -12,19 +12,38 @@
 #include <evl/net/skb.h>
 
 struct evl_net_qdisc;
+struct evl_net_qdisc_class_stats;
+struct net_device;
 
+/* Upper bound on the classes reported by @get_stats. */
+#define EVL_NET_QDISC_MAX_CLASSES  64
+
+/*
+ * @init receives the user-defined parameters as passed to
+ * EVL_NDEVIOC_SETQDISC, or NULL for the default setup. @flush
+ * pulls every pending packet regardless of its scheduling
+ * constraints when the qdisc is replaced, defaulting to @dequeue if
+ * unset. @get_stats optionally fills in the counters of up to @nr
+ * classes, returning the actual count of classes.
+ */
 struct evl_net_qdisc_ops {
 	const char *name;
 	size_t priv_size;
-	int (*init)(struct evl_net_qdisc *qdisc);
+	int (*init)(struct evl_net_qdisc *qdisc,
+		const void *params, size_t len);
 	void (*destroy)(struct evl_net_qdisc *qdisc);
 	int (*enqueue)(struct evl_net_qdisc *qdisc, struct sk_buff *skb);
 	struct sk_buff *(*dequeue)(struct evl_net_qdisc *qdisc);
+	struct sk_buff *(*flush)(struct evl_net_qdisc *qdisc);
+	int (*get_stats)(struct evl_net_qdisc *qdisc,
+			struct evl_net_qdisc_class_stats *stats,
+			unsigned int nr);
 	struct list_head next;
 };
 
 struct evl_net_qdisc {
 	const struct evl_net_qdisc_ops *oob_ops;
+	struct net_device *dev;	/* Real device */
 	unsigned long packet_dropped;
 };
 
@@ -37,11 +56,17 @@ void evl_net_register_qdisc(struct evl_net_qdisc_ops *ops);
 
 void evl_net_unregister_qdisc(struct evl_net_qdisc_ops *ops);
 
+struct evl_net_qdisc_ops *evl_net_find_qdisc(const char *name);
+
 struct evl_net_qdisc *
-evl_net_alloc_qdisc(struct evl_net_qdisc_ops *ops);
+evl_net_alloc_qdisc(struct evl_net_qdisc_ops *ops,
+		struct net_device *dev,
+		const void *params, size_t len);
 
 void evl_net_free_qdisc(struct evl_net_qdisc *qdisc);
 
+void evl_net_kick_qdisc(struct evl_net_qdisc *qdisc);
+
 int evl_net_sched_packet(struct net_device *dev,
 			 struct sk_buff *skb);
 
@@ -51,4 +76,10 @@ void evl_net_cleanup_qdisc(void);
 
 extern struct evl_net_qdisc_ops evl_net_qdisc_fifo;
 
+extern struct evl_net_qdisc_ops evl_net_qdisc_etf;
+
+extern struct evl_net_qdisc_ops evl_net_qdisc_taprio;
+
+extern struct evl_net_qdisc_ops evl_net_qdisc_prio;
+
 #endif /* !_EVL_NET_QDISC_H */
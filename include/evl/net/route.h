@@ -19,6 +19,8 @@ struct evl_net_route {
 	struct evl_cache_entry entry;
 	/* Destination as resolved in-band (in-band refcounted). */
 	struct rtable *rt;
+	/* Installed administratively, ignores in-band updates. */
+	bool pinned;
 	/* Index key (destination IP). */
 	u8 key[0] __aligned(4);
 };
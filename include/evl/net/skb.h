@@ -24,6 +24,7 @@ struct evl_net_cb {
 	struct evl_socket *tracker;
 	union {
 		/* protocol-specific stuff should live here. */
+		unsigned int rx_slot;	/* EVL_RX_SOCKET target */
 	};
 };
 #define EVL_NET_CB(__skb)  ((struct evl_net_cb *)&((__skb)->cb[0]))
@@ -78,4 +79,8 @@ ssize_t evl_net_skb_to_uio(const struct iovec *iov, size_t iovlen,
 			struct sk_buff *skb, size_t skip,
 			bool *short_write);
 
+int evl_net_load_payload(void *data, const void __user *src,
+			size_t len, __wsum *csum, size_t offset,
+			bool pinned);
+
 #endif /* !_EVL_NET_SKB_H */
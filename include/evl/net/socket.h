@@ -11,8 +11,12 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/refcount.h>
+#include <linux/llist.h>
+#include <linux/percpu.h>
 #include <linux/skbuff.h>
+#include <linux/uaccess.h>
 #include <evl/wait.h>
+#include <evl/clock.h>
 #include <evl/file.h>
 #include <evl/poll.h>
 #include <evl/crossing.h>
@@ -26,6 +30,10 @@ struct net;
 struct net_device;
 struct evl_net_offload;
 struct evl_net_udp_receiver;
+struct evl_net_udp_rxq;
+struct evl_net_udp6_receiver;
+struct evl_packet_umem;
+struct evl_can_filterset;
 
 struct evl_net_proto {
 	int (*attach)(struct evl_socket *esk,
@@ -49,6 +57,8 @@ struct evl_net_proto {
 			size_t iovlen);
 	__poll_t (*oob_poll)(struct evl_socket *esk,
 			struct oob_poll_wait *wait);
+	long (*oob_ioctl)(struct evl_socket *esk, unsigned int cmd,
+			unsigned long arg);
 	struct net_device *(*get_netif)(struct evl_socket *esk);
 	void (*handle_offload)(struct evl_socket *esk);
 };
@@ -59,6 +69,31 @@ struct evl_socket_domain {
 	struct list_head next;
 };
 
+/* Per-CPU counters of a socket, updates may race like port stats. */
+struct evl_socket_pcpu_stats {
+	u64 rx_packets;
+	u64 rx_bytes;
+	u64 rx_drops;
+	u64 tx_packets;
+	u64 tx_bytes;
+	u64 tx_offloaded;
+	u64 rx_remote;
+};
+
+/*
+ * Per-CPU cache of rmem/wmem credit charged to the socket budget by
+ * batches, see evl_charge_socket_rmem().
+ */
+struct evl_socket_pcpu_credit {
+	int rmem;
+	int wmem;
+};
+
+#define evl_net_inc_sock_stat(__esk, __field)		\
+	this_cpu_inc((__esk)->stats->__field)
+#define evl_net_add_sock_stat(__esk, __field, __val)	\
+	this_cpu_add((__esk)->stats->__field, __val)
+
 struct evl_socket {
 	struct evl_net_proto *proto;
 	struct evl_file efile;
@@ -72,13 +107,29 @@ struct evl_socket {
 	struct sock *sk;
 	atomic_t rmem_count;
 	int rmem_max;
+	int rmem_batch;
 	atomic_t wmem_count;
 	int wmem_max;
+	int wmem_batch;
+	struct evl_socket_pcpu_credit __percpu *credits;
 	struct evl_wait_queue wmem_wait;
 	struct evl_crossing wmem_drain;
 	int protocol;
 	refcount_t refs;	/* release vs destroy */
-	struct evl_work inband_offload;
+	struct llist_node offload_next;	/* Offload batch, oob_lock held */
+	bool offload_pending;
+	u32 tx_flags;
+	u32 rx_flags;
+	atomic_t tx_seq;
+	atomic_t zc_seq;	/* MSG_ZEROCOPY sends */
+	struct list_head errq;	/* TX stamps, oob_lock held */
+	int errq_len;
+	/* Busy polling, the window is zero if disabled. */
+	ktime_t busy_poll;
+	int busy_ifindex;	/* Last input device */
+	u16 busy_rxq;		/* Last input queue */
+	int rx_cpu;		/* Consumer CPU, -1 if none */
+	struct evl_socket_pcpu_stats __percpu *stats;
 	union {
 		/* Packet interface data. */
 		struct {
@@ -86,7 +137,15 @@ struct evl_socket {
 			int ifindex; /* Same as real_ifindex or vlan ifindex */
 			u16 vlan_id; /* non-zero if vlan device, zero otherwise */
 			u32 proto_hash;
+			struct hlist_node hash_sub; /* evl_net_rxqueue.sub_hash */
+			struct evl_packet_umem *umem; /* Mapped ring mode */
 		} packet;
+		/* CAN raw interface data. */
+		struct {
+			int ifindex; /* Zero for any interface */
+			struct evl_can_filterset *filters;
+			struct list_head next; /* Bound sockets */
+		} can;
 		/* Used by all IP protocols we support. */
 		struct {
 			/* Offload descriptors. */
@@ -97,7 +156,11 @@ struct evl_socket {
 					u32 rcv_addr;
 					u16 rcv_port;
 					struct evl_net_udp_receiver *receiver;
+					struct evl_net_udp_rxq *rxq;
 				} udp;
+				struct {
+					struct evl_net_udp6_receiver *receiver;
+				} udp6;
 			};
 		} ip;
 	} u;
@@ -109,37 +172,77 @@ static inline unsigned int evl_socket_f_flags(struct evl_socket *esk)
 	return esk->efile.filp->f_flags;
 }
 
-static inline bool evl_charge_socket_rmem(struct evl_socket *esk,
-					  size_t size)
-{
-	/* An overflow of skb->truesize - 1 is allowed, not more. */
-	if (atomic_read(&esk->rmem_count) >= esk->rmem_max)
-		return false;
+bool evl_charge_socket_rmem(struct evl_socket *esk, size_t size);
+
+void evl_uncharge_socket_rmem(struct evl_socket *esk, size_t size);
+
+int evl_charge_socket_wmem(struct evl_socket *esk, size_t size,
+			ktime_t timeout, enum evl_tmode tmode);
+
+void evl_uncharge_socket_wmem(struct evl_socket *esk, size_t size);
 
-	/* We don't have to saturate, atomic_t is fine. */
-	atomic_add(size, &esk->rmem_count);
+/*
+ * Report the ingress time of @skb stamped by evl_net_receive() to
+ * the receiver.
+ */
+static inline int evl_net_put_rxstamp(struct user_oob_msghdr __user *u_msghdr,
+				struct sk_buff *skb)
+{
+	struct __evl_timespec uts = ktime_to_u_timespec(skb->tstamp);
 
-	return true;
+	return raw_copy_to_user(&u_msghdr->timestamp, &uts, sizeof(uts)) ?
+		-EFAULT : 0;
 }
 
-static inline void evl_uncharge_socket_rmem(struct evl_socket *esk,
-					    size_t size)
+int evl_net_put_rxctl(struct evl_socket *esk,
+		struct user_oob_msghdr __user *u_msghdr,
+		struct sk_buff *skb,
+		const void *data, size_t len);
+
+/*
+ * Remember where the last input came from, so that a busy-polling
+ * receiver knows which RX lane to drive.
+ */
+static inline void evl_net_note_rx(struct evl_socket *esk,
+				struct sk_buff *skb)
 {
-	int count = atomic_sub_return(size, &esk->rmem_count);
-	EVL_WARN_ON(NET, count < 0);
+	if (READ_ONCE(esk->busy_poll)) {
+		WRITE_ONCE(esk->busy_ifindex, skb->dev->ifindex);
+		WRITE_ONCE(esk->busy_rxq, skb_rx_queue_recorded(skb) ?
+			skb_get_rx_queue(skb) : 0);
+	}
 }
 
-int evl_charge_socket_wmem(struct evl_socket *esk, size_t size,
-			ktime_t timeout, enum evl_tmode tmode);
+ktime_t evl_net_busy_poll(struct evl_socket *esk, ktime_t deadline);
 
-void evl_uncharge_socket_wmem(struct evl_socket *esk, size_t size);
+void evl_net_steer_rx(struct evl_socket *esk, struct sk_buff *skb);
+
+static inline ktime_t evl_net_busy_poll_deadline(struct evl_socket *esk)
+{
+	ktime_t window = READ_ONCE(esk->busy_poll);
+
+	if (!window || !READ_ONCE(esk->busy_ifindex))
+		return 0;
+
+	return ktime_add(evl_read_clock(&evl_mono_clock), window);
+}
 
 int evl_register_socket_domain(struct evl_socket_domain *domain);
 
 void evl_unregister_socket_domain(struct evl_socket_domain *domain);
 
+int evl_net_prepare_tx(struct evl_socket *esk,
+		const struct user_oob_msghdr __user *u_msghdr,
+		struct sk_buff *skb);
+
+void evl_net_report_txstamp(struct sk_buff *skb);
+
+void evl_net_report_zerocopy(struct evl_socket *esk);
+
 void evl_net_offload_inband(struct evl_socket *esk,
 			struct evl_net_offload *ofld,
 			struct list_head *q);
 
+void evl_net_init_offload(void);
+
 #endif /* !_EVL_NET_SOCKET_H */
@@ -14,21 +14,27 @@
 #include <evl/factory.h>
 #include <evl/wait.h>
 #include <evl/poll.h>
+#include <evl/work.h>
 #include <uapi/evl/types.h>
 #include <uapi/evl/observable-abi.h>
 
 struct file;
+struct evl_notification_record;
 
 struct evl_observable {
 	struct evl_element element;
 	struct list_head observers; 	/* struct evl_observer */
 	struct list_head flush_list; 	/* struct evl_observer */
+	struct list_head shared_observers; /* struct evl_observer */
+	struct evl_notification_record *ring; /* for shared observers */
+	u32 ring_size;
+	u32 ring_head;
 	struct evl_wait_queue oob_wait;
 	wait_queue_head_t inband_wait_r;
 	wait_queue_head_t inband_wait_w;
 	struct evl_poll_head poll_head;
-	struct irq_work wake_r_irqwork;
-	struct irq_work wake_w_irqwork;
+	struct evl_inband_wakeup wake_r_wakeup;
+	struct evl_inband_wakeup wake_w_wakeup;
 	struct irq_work flush_irqwork;
 	hard_spinlock_t lock;		/* guards observers and flush_list */
 	u32 serial_counter;
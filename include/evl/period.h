@@ -0,0 +1,44 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_PERIOD_H
+#define _EVL_PERIOD_H
+
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <evl/timer.h>
+
+/*
+ * A period group releases all its members at the same dates, from
+ * a single timer per CPU instead of one per thread.
+ */
+struct evl_period_slot {
+	struct evl_timer timer;
+	hard_spinlock_t lock;
+	struct list_head waiters; /* by decreasing priority */
+	u64 released;		/* count of releases so far */
+	int nr_members;
+	struct evl_period_group *group;
+};
+
+struct evl_period_group {
+	struct evl_clock *clock;
+	ktime_t idate;
+	ktime_t period;
+	struct evl_period_slot __percpu *slots;
+};
+
+int evl_init_period_group(struct evl_period_group *pg,
+			struct evl_clock *clock,
+			ktime_t idate, ktime_t period);
+
+void evl_destroy_period_group(struct evl_period_group *pg);
+
+int evl_join_period_group(struct evl_period_group *pg);
+
+void evl_leave_period_group(struct evl_thread *thread);
+
+int evl_wait_group_period(unsigned long *overruns_r);
+
+#endif /* !_EVL_PERIOD_H */
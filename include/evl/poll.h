@@ -9,6 +9,7 @@
 
 #include <linux/types.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/rbtree.h>
 #include <linux/spinlock.h>
 #include <linux/poll.h>
@@ -22,6 +23,7 @@ struct file;
 
 struct evl_poll_node {
 	struct list_head next;	/* in watchpoint->poll_nodes */
+	hard_spinlock_t *lock;	/* fd bucket lock guarding next */
 };
 
 /*
@@ -31,9 +33,17 @@ struct evl_poll_node {
 struct evl_poll_watchpoint {
 	unsigned int fd;
 	int events_polled;
+	int modifiers;		/* EVL_POLLONESHOT, EVL_POLLET */
+	int events_seen;	/* Last state probed (EVL_POLLET). */
+	int events_reported;	/* Returned to the waiter. */
 	union evl_value pollval;
 	struct oob_poll_wait wait;
 	struct evl_flag *flag;
+	struct llist_head *ready_list;
+	struct llist_node ready;  /* in *ready_list */
+	atomic_t queued;
+	/* Persistent watchpoints only, called with hard irqs off. */
+	void (*signal)(struct evl_poll_watchpoint *wpt, int events);
 	struct file *filp;
 	struct evl_poll_node node;
 };
@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_PTP_H
+#define _EVL_PTP_H
+
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
+#include <evl/clock.h>
+
+struct ptp_clock_info;
+
+struct evl_ptp_clock {
+	struct evl_clock clock;
+	struct ptp_clock_info *info;
+	struct delayed_work sync_work;
+	unsigned long sync_delay;	/* jiffies */
+	seqcount_t seq;
+	/* Reference point and rate for extrapolating the PHC time. */
+	ktime_t mono_ref;
+	ktime_t phc_ref;
+	u64 mult;			/* PHC/mono rate, 32.32 */
+};
+
+struct evl_ptp_clock *
+evl_register_ptp_clock(struct ptp_clock_info *info,
+		const char *name, ktime_t sync_period);
+
+void evl_unregister_ptp_clock(struct evl_ptp_clock *pc);
+
+#endif /* !_EVL_PTP_H */
@@ -12,6 +12,7 @@
 #define _EVL_RANDOM_H
 
 #include <linux/types.h>
+#include <uapi/evl/random-abi.h>
 
 void evl_init_rng(void);
 
@@ -21,4 +22,6 @@ u16 evl_read_rng_u16(void);
 
 u32 evl_read_rng_u32(void);
 
+void evl_fill_rng(void *buf, size_t len, int mode);
+
 #endif /* !_EVL_RANDOM_H */
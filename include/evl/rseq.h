@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_RSEQ_H
+#define _EVL_RSEQ_H
+
+#include <linux/dovetail.h>
+#include <evl/thread.h>
+
+struct pt_regs;
+
+#ifdef CONFIG_EVL_RSEQ
+
+/*
+ * @prev is being switched out by __evl_schedule() on its own
+ * behalf, check for an abort on the way back to user mode if it was
+ * preempted while a critical section might be in progress. Blocked
+ * threads are running a syscall, which a critical section may not
+ * contain.
+ */
+static inline void evl_rseq_preempt(struct evl_thread *prev)
+{
+	if ((prev->state & (EVL_T_USER|EVL_THREAD_BLOCK_BITS)) != EVL_T_USER)
+		return;
+
+	if (prev->u_window && READ_ONCE(prev->u_window->rseq_cs)) {
+		prev->local_info |= EVL_T_RSEQ;
+		dovetail_send_mayday(prev->altsched.task);
+	}
+}
+
+static inline void evl_rseq_set_cpu(struct evl_thread *thread, int cpu)
+{
+	if (thread->u_window)
+		WRITE_ONCE(thread->u_window->cpu, cpu);
+}
+
+void evl_rseq_handle_abort(struct evl_thread *curr,
+			struct pt_regs *regs);
+
+#else
+
+static inline void evl_rseq_preempt(struct evl_thread *prev)
+{ }
+
+static inline void evl_rseq_set_cpu(struct evl_thread *thread, int cpu)
+{ }
+
+static inline void evl_rseq_handle_abort(struct evl_thread *curr,
+					struct pt_regs *regs)
+{ }
+
+#endif
+
+#endif /* !_EVL_RSEQ_H */
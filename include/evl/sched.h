@@ -11,11 +11,13 @@
 #include <linux/percpu.h>
 #include <linux/list.h>
 #include <linux/irq_pipeline.h>
+#include <linux/sched/topology.h>
 #include <evl/thread.h>
 #include <evl/sched/queue.h>
 #include <evl/sched/weak.h>
 #include <evl/sched/quota.h>
 #include <evl/sched/tp.h>
+#include <evl/sched/edf.h>
 #include <evl/assert.h>
 #include <evl/init.h>
 
@@ -57,11 +59,59 @@
  * Hardware timer is stopped.
  */
 #define RQ_TSTOPPED	0x00000800
+/*
+ * CPU dedicated to out-of-band work (evl.tickless_cpus), the
+ * in-band tick is suppressed entirely while EVL threads run.
+ */
+#define RQ_TICKLESS	0x00000400
+/*
+ * A preemption deferral is in progress for the current thread,
+ * respectively has expired.
+ */
+#define RQ_PDEFER	0x00000200
+#define RQ_PDEXPIRED	0x00000100
 
 struct evl_sched_fifo {
 	struct evl_sched_queue runnable;
 };
 
+enum evl_swstat_kind {
+	EVL_SWSTAT_PICK,	/* picking the next thread */
+	EVL_SWSTAT_SWITCH,	/* switching contexts */
+	EVL_SWSTAT_IRQOFF,	/* hard irqs off in __evl_schedule() */
+	EVL_SWSTAT_NR
+};
+
+#ifdef CONFIG_EVL_DEBUG_SWSTATS
+
+/*
+ * Bucket 0 counts null durations, bucket n > 0 counts durations in
+ * the [2^(n-1), 2^n) nanosecond range, the last one accumulates any
+ * longer duration. Each histogram is only updated by its owner CPU
+ * with hard irqs off, readers therefore need no locking.
+ */
+#define EVL_SWSTAT_BUCKETS  32
+
+struct evl_switch_stats {
+	ktime_t start[EVL_SWSTAT_NR];
+	unsigned long hist[EVL_SWSTAT_NR][EVL_SWSTAT_BUCKETS];
+};
+
+#endif
+
+/*
+ * Lock chain walks for priority inheritance and deadlock detection
+ * started from a CPU. A walk is cut off when a link in the chain
+ * sees no change in effective priority, in which case there is
+ * nothing left to propagate further down.
+ */
+struct evl_pi_stats {
+	unsigned long walks;
+	unsigned long hops;
+	unsigned long cutoffs;
+	unsigned int max_depth;
+};
+
 struct evl_rq {
 	hard_spinlock_t lock;
 
@@ -77,6 +127,9 @@ struct evl_rq {
 #endif
 #ifdef CONFIG_EVL_SCHED_TP
 	struct evl_sched_tp tp;
+#endif
+#ifdef CONFIG_EVL_SCHED_EDF
+	struct evl_sched_edf edf;
 #endif
 	struct evl_thread root_thread;
 	struct lock_class_key root_lock_key;
@@ -84,6 +137,9 @@ struct evl_rq {
 	ktime_t last_account_switch;
 	struct evl_account *current_account;
 #endif
+#ifdef CONFIG_EVL_RUNSTATS_PMU
+	struct evl_pmu_state pmu;
+#endif
 
 	/*
 	 * runqueue-local data the owner may modify locklessly.
@@ -92,11 +148,51 @@ struct evl_rq {
 #ifdef CONFIG_SMP
 	int cpu;
 	struct cpumask resched_cpus;
+#ifdef CONFIG_EVL_RUNSTATS
+	unsigned long resched_ipis;	/* remote resched IPIs sent */
+	unsigned long resched_merged;	/* requests merged into pending IPIs */
+#endif
+#endif
+#ifdef CONFIG_EVL_RUNSTATS
+	struct evl_pi_stats pi_stats;
+#endif
+#ifdef CONFIG_EVL_RUNSTATS
+	unsigned long mm_switches;	/* switches across address spaces */
+	unsigned long mm_lazy;		/* switches keeping the active mm */
+#endif
+#if defined(CONFIG_EVL_TIMER_HOUSEKEEPING) && defined(CONFIG_EVL_RUNSTATS)
+	unsigned long timer_offloads;	/* shots taken over by housekeeping */
+	unsigned long timer_hosted;	/* shots fired on behalf of others */
 #endif
 	struct evl_timer inband_timer;
 	struct evl_timer rrbtimer;
 #ifdef CONFIG_EVL_WATCHDOG
 	struct evl_timer wdtimer;
+#endif
+#ifdef CONFIG_EVL_THREAD_BUDGET
+	struct evl_timer budget_timer;
+#endif
+#ifdef CONFIG_EVL_PREEMPT_DEFER
+	struct evl_timer defer_timer;
+#ifdef CONFIG_EVL_RUNSTATS
+	unsigned long defer_granted;	/* preemption deferrals granted */
+	unsigned long defer_expired;	/* grace periods which ran out */
+#endif
+#endif
+#ifdef CONFIG_EVL_IDLE_LEAD
+	ktime_t idle_lead;		/* early shot before idling */
+#endif
+#ifdef CONFIG_EVL_FREQ_LOCK
+	bool freq_locked;		/* frequency lock requested */
+	unsigned long freq_activity;	/* jiffies at last oob switch */
+#endif
+#ifdef CONFIG_EVL_SMT_EXCL
+	bool smt_holding;		/* siblings held for ->curr */
+	atomic_t smt_holds;		/* siblings holding this CPU */
+	struct cpumask smt_siblings;	/* siblings we may hold */
+#endif
+#ifdef CONFIG_EVL_DEBUG_SWSTATS
+	struct evl_switch_stats swstats;
 #endif
 	/* Misc stuff. */
 	char *proxy_timer_name;
@@ -218,6 +314,16 @@ static inline int evl_rq_cpu(struct evl_rq *rq)
 	return rq->cpu;
 }
 
+#ifdef CONFIG_EVL_RUNSTATS
+static inline void evl_count_resched_merge(struct evl_rq *this_rq)
+{
+	this_rq->resched_merged++;
+}
+#else
+static inline void evl_count_resched_merge(struct evl_rq *this_rq)
+{ }
+#endif
+
 static inline void evl_set_resched(struct evl_rq *rq)
 {
 	struct evl_rq *this_rq = this_evl_rq();
@@ -240,7 +346,16 @@ static inline void evl_set_resched(struct evl_rq *rq)
 		 * test_resched()).
 		 */
 		this_rq->local_flags |= RQ_SCHED;
-		cpumask_set_cpu(evl_rq_cpu(rq), &this_rq->resched_cpus);
+		if (cpumask_test_and_set_cpu(evl_rq_cpu(rq),
+						&this_rq->resched_cpus))
+			evl_count_resched_merge(this_rq);
+	} else {
+		/*
+		 * The remote CPU has a rescheduling request pending
+		 * already, which was or is about to be kicked by an
+		 * IPI. Piggyback on it.
+		 */
+		evl_count_resched_merge(this_rq);
 	}
 }
 
@@ -281,6 +396,35 @@ void evl_migrate_thread(struct evl_thread *thread,
 
 #endif /* !CONFIG_SMP */
 
+#ifdef CONFIG_EVL_SCHED_CAPACITY
+
+void evl_init_thread_capacity(struct evl_thread *thread);
+
+int evl_select_capacity_cpu(struct evl_thread *thread, int cpu);
+
+static inline bool evl_cpu_fits(struct evl_thread *thread, int cpu)
+{
+	return arch_scale_cpu_capacity(cpu) >= thread->min_capacity;
+}
+
+#else
+
+static inline void evl_init_thread_capacity(struct evl_thread *thread)
+{ }
+
+static inline
+int evl_select_capacity_cpu(struct evl_thread *thread, int cpu)
+{
+	return cpu;
+}
+
+static inline bool evl_cpu_fits(struct evl_thread *thread, int cpu)
+{
+	return true;
+}
+
+#endif
+
 void evl_start_ptsync(struct evl_thread *stopper);
 
 #define for_each_evl_cpu(cpu)		\
@@ -435,6 +579,30 @@ bool evl_set_effective_thread_priority(struct evl_thread *thread,
 #include <evl/sched/idle.h>
 #include <evl/sched/fifo.h>
 
+/*
+ * The weak class hosts every EVL thread running in-band, so we
+ * open-code its queue operations on the hot paths too.
+ */
+static inline void __evl_requeue_weak_thread(struct evl_thread *thread)
+{
+	evl_add_schedq(&thread->rq->weak.runnable, thread);
+}
+
+static inline void __evl_enqueue_weak_thread(struct evl_thread *thread)
+{
+	evl_add_schedq_tail(&thread->rq->weak.runnable, thread);
+}
+
+static inline void __evl_dequeue_weak_thread(struct evl_thread *thread)
+{
+	evl_del_schedq(&thread->rq->weak.runnable, thread);
+}
+
+static inline struct evl_thread *__evl_pick_weak_thread(struct evl_rq *rq)
+{
+	return evl_get_schedq(&rq->weak.runnable);
+}
+
 void evl_putback_thread(struct evl_thread *thread);
 
 int evl_set_thread_policy_locked(struct evl_thread *thread,
@@ -463,10 +631,136 @@ static inline int evl_init_rq_thread(struct evl_thread *thread)
 	if (ret)
 		return ret;
 #endif
+#ifdef CONFIG_EVL_SCHED_EDF
+	ret = evl_edf_init_thread(thread);
+	if (ret)
+		return ret;
+#endif
 
 	return ret;
 }
 
+#ifdef CONFIG_EVL_THREAD_BUDGET
+
+/*
+ * (Re)arm the runtime budget timer of @rq for @next, which is
+ * about to run on it. rq->lock held, hard irqs off.
+ */
+static inline void evl_switch_budget(struct evl_rq *rq,
+				struct evl_thread *next)
+{
+	if (next->budget.runtime)
+		evl_start_timer(&rq->budget_timer,
+				evl_abs_timeout(&rq->budget_timer,
+						next->budget.runtime),
+				EVL_INFINITE);
+	else
+		evl_stop_timer(&rq->budget_timer);
+}
+
+#else
+
+static inline void evl_switch_budget(struct evl_rq *rq,
+				struct evl_thread *next)
+{ }
+
+#endif
+
+#ifdef CONFIG_EVL_IDLE_LEAD
+
+/* Anticipation of the next shot for leaving an idle state. */
+static inline ktime_t evl_get_idle_lead(struct evl_rq *rq)
+{
+	return rq->idle_lead;
+}
+
+static inline void evl_clear_idle_lead(struct evl_rq *rq)
+{
+	rq->idle_lead = 0;
+}
+
+#else
+
+static inline ktime_t evl_get_idle_lead(struct evl_rq *rq)
+{
+	return 0;
+}
+
+static inline void evl_clear_idle_lead(struct evl_rq *rq)
+{ }
+
+#endif
+
+#ifdef CONFIG_EVL_RESCTRL
+void evl_switch_resctrl(struct evl_thread *curr);
+#else
+static inline void evl_switch_resctrl(struct evl_thread *curr)
+{ }
+#endif
+
+#ifdef CONFIG_EVL_FREQ_LOCK
+
+void __evl_lock_freq(struct evl_rq *rq);
+
+/*
+ * Note out-of-band activity on @rq when @next is an EVL thread,
+ * locking the CPU frequency if not done yet. rq->lock held, hard
+ * irqs off.
+ */
+static inline void evl_switch_freq(struct evl_rq *rq,
+				struct evl_thread *next)
+{
+	if (!(next->state & EVL_T_ROOT)) {
+		WRITE_ONCE(rq->freq_activity, jiffies);
+		if (unlikely(!READ_ONCE(rq->freq_locked)))
+			__evl_lock_freq(rq);
+	}
+}
+
+#else
+
+static inline void evl_switch_freq(struct evl_rq *rq,
+				struct evl_thread *next)
+{ }
+
+#endif
+
+#ifdef CONFIG_EVL_SMT_EXCL
+
+void __evl_switch_smt(struct evl_rq *rq, bool hold);
+
+void evl_kick_smt_idler(struct evl_rq *this_rq);
+
+void evl_init_smt(void);
+
+/*
+ * Hold or release the SMT siblings of @rq depending on whether @next
+ * which is about to run on it asks for an exclusive core. rq->lock
+ * held, hard irqs off.
+ */
+static inline void evl_switch_smt(struct evl_rq *rq,
+				struct evl_thread *next)
+{
+	bool hold = !!(next->state & EVL_T_EXCL);
+
+	if (unlikely(hold != rq->smt_holding))
+		__evl_switch_smt(rq, hold);
+}
+
+#else
+
+static inline void evl_switch_smt(struct evl_rq *rq,
+				struct evl_thread *next)
+{ }
+
+static inline void evl_kick_smt_idler(struct evl_rq *this_rq)
+{ }
+
+static inline void evl_init_smt(void)
+{ }
+
+#endif
+
 /* rq->lock held, hard irqs off */
 static inline void evl_sched_yield(struct evl_rq *rq)
 {
@@ -541,6 +835,8 @@ static __always_inline void evl_enqueue_thread(struct evl_thread *thread)
 	 */
 	if (likely(sched_class == &evl_sched_fifo))
 		__evl_enqueue_fifo_thread(thread);
+	else if (sched_class == &evl_sched_weak)
+		__evl_enqueue_weak_thread(thread);
 	else if (sched_class != &evl_sched_idle)
 		sched_class->sched_enqueue(thread);
 }
@@ -556,6 +852,8 @@ static __always_inline void evl_dequeue_thread(struct evl_thread *thread)
 	 */
 	if (likely(sched_class == &evl_sched_fifo))
 		__evl_dequeue_fifo_thread(thread);
+	else if (sched_class == &evl_sched_weak)
+		__evl_dequeue_weak_thread(thread);
 	else if (sched_class != &evl_sched_idle)
 		sched_class->sched_dequeue(thread);
 }
@@ -572,6 +870,8 @@ static __always_inline void evl_requeue_thread(struct evl_thread *thread)
 	 */
 	if (likely(sched_class == &evl_sched_fifo))
 		__evl_requeue_fifo_thread(thread);
+	else if (sched_class == &evl_sched_weak)
+		__evl_requeue_weak_thread(thread);
 	else if (sched_class != &evl_sched_idle)
 		sched_class->sched_requeue(thread);
 }
@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_SCHED_EDF_H
+#define _EVL_SCHED_EDF_H
+
+#ifndef _EVL_SCHED_H
+#error "please don't include evl/sched/edf.h directly"
+#endif
+
+#ifdef CONFIG_EVL_SCHED_EDF
+
+/*
+ * EDF threads are not ordered by priority but by absolute deadline,
+ * they all share a single priority level, which only matters for
+ * ordering them in wait channels with respect to threads from other
+ * classes.
+ */
+#define EVL_EDF_PRIO		0
+
+/*
+ * Bandwidth (runtime / period) is expressed as a fixed-point value
+ * with EVL_EDF_BW_SHIFT fractional bits. The sum of the bandwidths
+ * of all EDF threads assigned to a runqueue may not exceed
+ * EVL_EDF_BW_UNIT.
+ */
+#define EVL_EDF_BW_SHIFT	20
+#define EVL_EDF_BW_UNIT		(1ULL << EVL_EDF_BW_SHIFT)
+
+extern struct evl_sched_class evl_sched_edf;
+
+struct evl_sched_edf {
+	struct list_head runnable; /* by increasing absolute deadline */
+	struct evl_timer budget_timer;
+	u64 total_bw;
+};
+
+static inline int evl_edf_init_thread(struct evl_thread *thread)
+{
+	memset(&thread->edf, 0, sizeof(thread->edf));
+
+	return 0;
+}
+
+void evl_edf_charge_current(struct evl_rq *rq);
+
+#endif /* !CONFIG_EVL_SCHED_EDF */
+
+#endif /* !_EVL_SCHED_EDF_H */
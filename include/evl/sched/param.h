@@ -8,6 +8,8 @@
 #ifndef _EVL_SCHED_PARAM_H
 #define _EVL_SCHED_PARAM_H
 
+#include <linux/ktime.h>
+
 struct evl_idle_param {
 	int prio;
 };
@@ -30,6 +32,14 @@ struct evl_tp_param {
 	int ptid;	/* partition id. */
 };
 
+struct evl_edf_param {
+	int prio;
+	ktime_t runtime;
+	ktime_t period;
+	ktime_t deadline;
+	ktime_t abs_deadline;	/* inherited by PI boost. */
+};
+
 union evl_sched_param {
 	struct evl_idle_param idle;
 	struct evl_fifo_param fifo;
@@ -40,6 +50,9 @@ union evl_sched_param {
 #ifdef CONFIG_EVL_SCHED_TP
 	struct evl_tp_param tp;
 #endif
+#ifdef CONFIG_EVL_SCHED_EDF
+	struct evl_edf_param edf;
+#endif
 };
 
 #endif /* !_EVL_SCHED_PARAM_H */
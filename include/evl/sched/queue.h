@@ -60,6 +60,15 @@ int evl_get_schedq_weight(struct evl_sched_queue *q)
 	return find_first_bit(q->prio_map, EVL_MLQ_LEVELS);
 }
 
+/* Highest priority queued, -1 if empty. */
+static __always_inline
+int evl_get_schedq_prio(struct evl_sched_queue *q)
+{
+	int idx = evl_get_schedq_weight(q);
+
+	return idx >= EVL_MLQ_LEVELS ? -1 : EVL_MLQ_LEVELS - idx - 1;
+}
+
 static __always_inline
 int get_qindex(struct evl_sched_queue *q, int prio)
 {
@@ -123,7 +132,113 @@ void evl_del_schedq(struct evl_sched_queue *q,
 	__evl_del_schedq(q, &thread->rq_next, get_qindex(q, thread->cprio));
 }
 
-#else /* !CONFIG_EVL_SCHED_SCALABLE */
+#elif defined(CONFIG_EVL_SCHED_BITMAP)
+
+#define EVL_BMQ_LEVELS		 EVL_CORE_NR_PRIO
+
+/*
+ * Threads queued at the same priority level are linked into a
+ * circular list via thread->rq_next, without any list head. The
+ * level slot refers to the first thread of that list, and is
+ * valid only if the corresponding bit is set in the priority map.
+ */
+struct evl_sched_queue {
+	DECLARE_BITMAP(prio_map, EVL_BMQ_LEVELS);
+	struct evl_thread *heads[EVL_BMQ_LEVELS];
+};
+
+static __always_inline
+void evl_init_schedq(struct evl_sched_queue *q)
+{
+	bitmap_zero(q->prio_map, EVL_BMQ_LEVELS);
+}
+
+/* Highest priority queued, -1 if empty. */
+static __always_inline
+int evl_get_schedq_prio(struct evl_sched_queue *q)
+{
+	int idx = find_last_bit(q->prio_map, EVL_BMQ_LEVELS);
+
+	return idx >= EVL_BMQ_LEVELS ? -1 : idx;
+}
+
+static __always_inline
+struct evl_thread *evl_peek_schedq(struct evl_sched_queue *q, int prio)
+{
+	return q->heads[prio];
+}
+
+static __always_inline
+void __evl_insert_schedq(struct evl_sched_queue *q,
+			struct evl_thread *thread, bool head)
+{
+	int prio = thread->cprio;
+
+	if (!test_bit(prio, q->prio_map)) {
+		INIT_LIST_HEAD(&thread->rq_next);
+		q->heads[prio] = thread;
+		__set_bit(prio, q->prio_map);
+		return;
+	}
+
+	/*
+	 * Linking before the first thread in the circular list means
+	 * adding to the tail of the level. Moving the level head to
+	 * the new thread then turns this into adding to the front.
+	 */
+	list_add_tail(&thread->rq_next, &q->heads[prio]->rq_next);
+	if (head)
+		q->heads[prio] = thread;
+}
+
+static __always_inline
+void evl_add_schedq(struct evl_sched_queue *q,
+		struct evl_thread *thread)
+{
+	__evl_insert_schedq(q, thread, true);
+}
+
+static __always_inline
+void evl_add_schedq_tail(struct evl_sched_queue *q,
+			struct evl_thread *thread)
+{
+	__evl_insert_schedq(q, thread, false);
+}
+
+static __always_inline
+void evl_del_schedq(struct evl_sched_queue *q,
+		struct evl_thread *thread)
+{
+	int prio = thread->cprio;
+
+	if (list_empty(&thread->rq_next)) {
+		__clear_bit(prio, q->prio_map);
+		return;
+	}
+
+	if (q->heads[prio] == thread)
+		q->heads[prio] = list_next_entry(thread, rq_next);
+
+	list_del(&thread->rq_next);
+}
+
+static __always_inline
+struct evl_thread *evl_get_schedq(struct evl_sched_queue *q)
+{
+	struct evl_thread *thread;
+	int prio;
+
+	prio = evl_get_schedq_prio(q);
+	if (prio < 0)
+		return NULL;
+
+	thread = evl_peek_schedq(q, prio);
+	evl_del_schedq(q, thread);
+
+	return thread;
+}
+
+#else /* !CONFIG_EVL_SCHED_SCALABLE && !CONFIG_EVL_SCHED_BITMAP */
 
 struct evl_sched_queue {
 	struct list_head head;
@@ -144,6 +259,16 @@ struct evl_thread *evl_get_schedq(struct evl_sched_queue *q)
 	return list_get_entry(&q->head, struct evl_thread, rq_next);
 }
 
+/* Highest priority queued, -1 if empty. */
+static __always_inline
+int evl_get_schedq_prio(struct evl_sched_queue *q)
+{
+	if (list_empty(&q->head))
+		return -1;
+
+	return list_first_entry(&q->head, struct evl_thread, rq_next)->cprio;
+}
+
 static __always_inline
 void evl_add_schedq(struct evl_sched_queue *q,
 		struct evl_thread *thread)
@@ -165,6 +290,6 @@ void evl_del_schedq(struct evl_sched_queue *q,
 	list_del(&thread->rq_next);
 }
 
-#endif /* CONFIG_EVL_SCHED_SCALABLE */
+#endif /* !CONFIG_EVL_SCHED_SCALABLE && !CONFIG_EVL_SCHED_BITMAP */
 
 #endif /* !_EVL_SCHED_QUEUE_H */
@@ -23,6 +23,7 @@ extern struct evl_sched_class evl_sched_quota;
 
 struct evl_quota_group {
 	struct evl_rq *rq;
+	struct evl_quota_group *parent;
 	ktime_t quota;
 	ktime_t quota_peak;
 	ktime_t run_start;
@@ -31,15 +32,28 @@ struct evl_quota_group {
 	struct list_head members;
 	struct list_head expired;
 	struct list_head next;
-	int nr_active;
+	int nr_active;		/* includes children */
 	int nr_threads;
+	int nr_children;
 	int tgid;
 	int quota_percent;
 	int quota_peak_percent;
+	/* Statistics, include children. */
+	ktime_t run_time;
+	u64 nr_throttled;
+	/* Adaptive mode (top-level groups only). */
+	bool adaptive;
+	bool adapt_busy;
+	ktime_t quota_min;
+	ktime_t quota_max;
+	ktime_t adapt_demand;
+	ktime_t adapt_run_time;
+	u64 adapt_throttled;
 };
 
 struct evl_sched_quota {
 	ktime_t period;
+	int nr_adaptive;
 	struct evl_timer refill_timer;
 	struct evl_timer limit_timer;
 	struct list_head groups;
@@ -28,6 +28,9 @@ struct evl_tp_window {
 struct evl_tp_schedule {
 	int pwin_nr;
 	ktime_t tf_duration;
+	/* Synchronized mode only, clock is NULL otherwise. */
+	struct evl_clock *clock;
+	ktime_t epoch;
 	atomic_t refcount;
 	struct evl_tp_window pwins[0];
 };
@@ -40,8 +43,11 @@ struct evl_sched_tp {
 	struct evl_tp_rq *tps;
 	struct evl_timer tf_timer;
 	struct evl_tp_schedule *gps;
+	/* Replaces gps at the next time frame boundary. */
+	struct evl_tp_schedule *staged_gps;
 	int wnext;
 	ktime_t tf_start;
+	ktime_t tf_start_ref;	/* on gps->clock if synchronized */
 	struct list_head threads;
 };
 
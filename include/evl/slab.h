@@ -0,0 +1,67 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_SLAB_H
+#define _EVL_SLAB_H
+
+#include <linux/types.h>
+#include <linux/cache.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+
+/*
+ * A cache of fixed-size objects carved from the system heap, which
+ * may be used from either stage. Objects are aligned on cache lines,
+ * free ones sit on per-CPU lists first, then on a shared list.
+ */
+
+struct evl_slab_page;
+
+struct evl_slab_cpu {
+	void *free;
+	unsigned int count;
+};
+
+struct evl_slab {
+	const char *name;
+	size_t size;		/* Object size */
+	size_t stride;		/* Distance between objects */
+	void (*ctor)(void *obj);
+	struct evl_slab_cpu __percpu *pcpu;
+	hard_spinlock_t lock;
+	void *depot;		/* Shared free list */
+	struct evl_slab_page *pages;
+	unsigned long nr_objs;
+};
+
+/*
+ * Each object is followed by a link to the next free one, so that
+ * the constructed state is preserved while the object is free.
+ */
+#define __EVL_SLAB_LINK(__size)		ALIGN(__size, sizeof(void *))
+#define __EVL_SLAB_STRIDE(__size)			\
+	ALIGN(__EVL_SLAB_LINK(__size) + sizeof(void *), L1_CACHE_BYTES)
+
+#define DEFINE_EVL_SLAB(__name, __type, __ctor)				\
+	static DEFINE_PER_CPU(struct evl_slab_cpu, __name ## _pcpu);	\
+	static struct evl_slab __name = {				\
+		.name = #__name,					\
+		.size = sizeof(__type),					\
+		.stride = __EVL_SLAB_STRIDE(sizeof(__type)),		\
+		.ctor = __ctor,						\
+		.pcpu = &__name ## _pcpu,				\
+		.lock = __HARD_SPIN_LOCK_INITIALIZER(__name.lock),	\
+	}
+
+/* For slabs which are not statically defined. */
+int evl_init_slab(struct evl_slab *slab, const char *name,
+		size_t size, void (*ctor)(void *obj));
+
+void evl_destroy_slab(struct evl_slab *slab);
+
+void *evl_slab_alloc(struct evl_slab *slab);
+
+void evl_slab_free(struct evl_slab *slab, void *obj);
+
+#endif /* !_EVL_SLAB_H */
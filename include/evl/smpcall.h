@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_SMPCALL_H
+#define _EVL_SMPCALL_H
+
+#include <linux/llist.h>
+#include <linux/bitops.h>
+#include <linux/irqstage.h>
+
+#define EVL_SMPCALL_PENDING	0
+
+/*
+ * Out-of-band cross-CPU call. The function runs from the EVL
+ * reschedule IPI handler on the target CPU, with hard irqs off, so
+ * it must be short and oob-safe.
+ */
+struct evl_smp_call {
+	struct llist_node next;
+	void (*func)(void *arg);
+	void *arg;
+	unsigned long flags;
+};
+
+static inline
+void evl_init_smp_call(struct evl_smp_call *call,
+		void (*func)(void *arg), void *arg)
+{
+	call->func = func;
+	call->arg = arg;
+	call->flags = 0;
+}
+
+static inline bool evl_smp_call_pending(struct evl_smp_call *call)
+{
+	return test_bit_acquire(EVL_SMPCALL_PENDING, &call->flags);
+}
+
+#ifdef CONFIG_SMP
+
+int evl_smp_call(int cpu, void (*func)(void *arg), void *arg);
+
+int evl_smp_call_async(int cpu, struct evl_smp_call *call);
+
+void evl_run_smp_calls(void);
+
+#else
+
+static inline
+int evl_smp_call(int cpu, void (*func)(void *arg), void *arg)
+{
+	unsigned long flags;
+
+	if (cpu)
+		return -EINVAL;
+
+	flags = hard_local_irq_save();
+	func(arg);
+	hard_local_irq_restore(flags);
+
+	return 0;
+}
+
+static inline
+int evl_smp_call_async(int cpu, struct evl_smp_call *call)
+{
+	if (cpu)
+		return -EINVAL;
+
+	if (test_and_set_bit_lock(EVL_SMPCALL_PENDING, &call->flags))
+		return -EBUSY;
+
+	evl_smp_call(cpu, call->func, call->arg);
+	clear_bit_unlock(EVL_SMPCALL_PENDING, &call->flags);
+
+	return 0;
+}
+
+static inline void evl_run_smp_calls(void)
+{ }
+
+#endif
+
+#endif /* !_EVL_SMPCALL_H */
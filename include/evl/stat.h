@@ -10,12 +10,31 @@
 #ifndef _EVL_STAT_H
 #define _EVL_STAT_H
 
+#include <linux/log2.h>
+#include <linux/jump_label.h>
 #include <evl/clock.h>
+#include <uapi/evl/thread-abi.h>
 
 struct evl_rq;
 
 #ifdef CONFIG_EVL_RUNSTATS
 
+/*
+ * Accounting may be switched off at runtime via
+ * /sys/devices/virtual/evl/control/runstats, which spares the clock
+ * reads on the hot paths. evl_runstats_epoch is the date accounting
+ * was last enabled, so that the time elapsed while it was off is not
+ * charged to anyone.
+ */
+DECLARE_STATIC_KEY_TRUE(evl_runstats_enabled);
+
+extern ktime_t evl_runstats_epoch;
+
+static __always_inline bool evl_runstats_on(void)
+{
+	return static_branch_likely(&evl_runstats_enabled);
+}
+
 struct evl_account {
 	ktime_t start;   /* Start of execution time accumulation */
 	ktime_t total; /* Accumulated execution time */
@@ -54,11 +73,16 @@ static inline void evl_reset_account(struct evl_account *account)
  */
 #define evl_update_account(__rq)				\
 	do {							\
-		ktime_t __now = evl_get_timestamp();		\
-		(__rq)->current_account->total +=		\
-			__now - (__rq)->last_account_switch;	\
-		(__rq)->last_account_switch = __now;		\
-		smp_wmb();					\
+		ktime_t __now, __last;				\
+		if (evl_runstats_on()) {			\
+			__now = evl_get_timestamp();		\
+			__last = max((__rq)->last_account_switch, \
+				READ_ONCE(evl_runstats_epoch));	\
+			(__rq)->current_account->total +=	\
+				__now - __last;			\
+			(__rq)->last_account_switch = __now;	\
+			smp_wmb();				\
+		}						\
 	} while (0)
 
 /* Obtain last account switch date of considered runqueue */
@@ -108,6 +132,11 @@ void evl_set_counter(struct evl_counter *c, unsigned long value)
 
 #else /* !CONFIG_EVL_RUNSTATS */
 
+static __always_inline bool evl_runstats_on(void)
+{
+	return false;
+}
+
 struct evl_account {
 };
 
@@ -128,6 +157,187 @@ struct evl_counter {
 
 #endif /* CONFIG_EVL_RUNSTATS */
 
+struct evl_thread;
+struct perf_event;
+
+/* Hardware counters sampled at context switches. */
+enum evl_pmu_counter {
+	EVL_PMU_CYCLES,
+	EVL_PMU_INSNS,
+	EVL_PMU_LLC_MISSES,
+	EVL_PMU_BRANCH_MISSES,
+	EVL_PMU_NR
+};
+
+#ifdef CONFIG_EVL_RUNSTATS_PMU
+
+struct evl_pmu_account {
+	u64 total[EVL_PMU_NR];
+};
+
+/* Per-CPU counters, only touched by their owner CPU, hard irqs off. */
+struct evl_pmu_state {
+	struct perf_event *events[EVL_PMU_NR];
+	u64 last[EVL_PMU_NR];
+};
+
+void evl_pmu_switch(struct evl_rq *rq, struct evl_thread *prev);
+
+#else /* !CONFIG_EVL_RUNSTATS_PMU */
+
+struct evl_pmu_account {
+};
+
+struct evl_pmu_state {
+};
+
+static inline
+void evl_pmu_switch(struct evl_rq *rq, struct evl_thread *prev)
+{ }
+
+#endif /* !CONFIG_EVL_RUNSTATS_PMU */
+
+#ifdef CONFIG_EVL_RUNSTATS
+
+/*
+ * Ready-queue latency, i.e. the time elapsed between the thread
+ * becoming runnable and actually running. Updated by the thread's
+ * CPU, rq->lock held, hard irqs off.
+ */
+struct evl_runlat {
+	ktime_t ready_date;
+	unsigned long count;
+	ktime_t total;
+	ktime_t min;
+	ktime_t max;
+	unsigned long hist[EVL_RUNLAT_BUCKETS];
+};
+
+static inline void evl_mark_ready(struct evl_runlat *rl)
+{
+	if (!evl_runstats_on())
+		return;
+
+	/* A ready thread rotated within its group keeps its date. */
+	if (!rl->ready_date)
+		rl->ready_date = evl_get_timestamp();
+}
+
+static inline void evl_account_runlat(struct evl_runlat *rl)
+{
+	ktime_t lat;
+	int n = 0;
+
+	if (!rl->ready_date)
+		return;
+
+	if (!evl_runstats_on()) {
+		rl->ready_date = 0;
+		return;
+	}
+
+	lat = ktime_sub(evl_get_timestamp(), rl->ready_date);
+	rl->ready_date = 0;
+
+	if (rl->count++ == 0 || lat < rl->min)
+		rl->min = lat;
+	if (lat > rl->max)
+		rl->max = lat;
+	rl->total = ktime_add(rl->total, lat);
+
+	if (lat >= EVL_RUNLAT_BASE_NS)
+		n = min(ilog2(lat) - ilog2(EVL_RUNLAT_BASE_NS) + 1,
+			EVL_RUNLAT_BUCKETS - 1);
+	rl->hist[n]++;
+}
+
+/*
+ * Response time of a periodic thread, from its release by the
+ * periodic timer to its next call to evl_wait_period(). Updated by
+ * the thread itself, hard irqs off. Readers may race with updates,
+ * which is harmless for such statistics.
+ */
+struct evl_resptime {
+	ktime_t release;
+	unsigned long count;
+	ktime_t total;
+	ktime_t min;
+	ktime_t max;
+	unsigned long misses;
+	unsigned long overruns;
+	unsigned long hist[EVL_RESPTIME_BUCKETS];
+};
+
+static inline void evl_mark_release(struct evl_resptime *rt,
+				ktime_t date)
+{
+	rt->release = evl_runstats_on() ? date : 0;
+}
+
+static inline void evl_account_resptime(struct evl_resptime *rt,
+					ktime_t now, ktime_t period)
+{
+	ktime_t t;
+	int n = 0;
+
+	if (!rt->release)
+		return;
+
+	t = ktime_sub(now, rt->release);
+	rt->release = 0;
+	if (t < 0)
+		return;
+
+	if (rt->count++ == 0 || t < rt->min)
+		rt->min = t;
+	if (t > rt->max)
+		rt->max = t;
+	rt->total = ktime_add(rt->total, t);
+
+	if (t > period)
+		rt->misses++;
+
+	if (t >= EVL_RESPTIME_BASE_NS)
+		n = min(ilog2(t) - ilog2(EVL_RESPTIME_BASE_NS) + 1,
+			EVL_RESPTIME_BUCKETS - 1);
+	rt->hist[n]++;
+}
+
+static inline void evl_count_overruns(struct evl_resptime *rt,
+				unsigned long overruns)
+{
+	if (evl_runstats_on())
+		rt->overruns += overruns;
+}
+
+#else /* !CONFIG_EVL_RUNSTATS */
+
+struct evl_runlat {
+};
+
+static inline void evl_mark_ready(struct evl_runlat *rl)
+{ }
+
+static inline void evl_account_runlat(struct evl_runlat *rl)
+{ }
+
+struct evl_resptime {
+};
+
+static inline void evl_mark_release(struct evl_resptime *rt,
+				ktime_t date)
+{ }
+
+static inline void evl_account_resptime(struct evl_resptime *rt,
+					ktime_t now, ktime_t period)
+{ }
+
+static inline void evl_count_overruns(struct evl_resptime *rt,
+				unsigned long overruns)
+{ }
+
+#endif /* !CONFIG_EVL_RUNSTATS */
+
 /*
  * Account the exectime of the current account until now, switch to
  * new_account, return the previous one.
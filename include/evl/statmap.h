@@ -0,0 +1,55 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef _EVL_STATMAP_H
+#define _EVL_STATMAP_H
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <uapi/evl/control-abi.h>
+
+struct evl_thread;
+struct vm_area_struct;
+
+#ifdef CONFIG_EVL_RUNSTATS
+
+void evl_attach_statslot(struct evl_thread *thread);
+
+void evl_detach_statslot(struct evl_thread *thread);
+
+void evl_update_statslot(struct evl_thread *thread);
+
+int evl_get_statmap_info(struct evl_statmap_info *info);
+
+int evl_mmap_statmap(struct vm_area_struct *vma);
+
+void evl_init_statmap(void);
+
+#else
+
+static inline void evl_attach_statslot(struct evl_thread *thread)
+{ }
+
+static inline void evl_detach_statslot(struct evl_thread *thread)
+{ }
+
+static inline void evl_update_statslot(struct evl_thread *thread)
+{ }
+
+static inline int evl_get_statmap_info(struct evl_statmap_info *info)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int evl_mmap_statmap(struct vm_area_struct *vma)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline void evl_init_statmap(void)
+{ }
+
+#endif
+
+#endif /* !_EVL_STATMAP_H */
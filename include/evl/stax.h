@@ -9,20 +9,43 @@
 
 #include <linux/atomic.h>
 #include <linux/wait.h>
-#include <linux/irq_work.h>
 #include <evl/wait.h>
+#include <evl/lockstat.h>
+#include <evl/work.h>
 
 #define EVL_STAX_INBAND_SPIN  BIT(0)
 
 struct evl_stax {
 	atomic_t gate;
 	int flags;
+	int nr_excl_waiters;
 	struct evl_wait_queue oob_wait;
 	wait_queue_head_t inband_wait;
-	struct irq_work irq_work;
+	struct evl_inband_wakeup wakeup;
+	/* Contention counters. */
+	atomic_t oob_contended;
+	atomic_t inband_contended;
+	atomic_t excl_contended;
+#ifdef CONFIG_EVL_LOCKSTAT
+	struct evl_lockstat_class *lockstat;
+	ktime_t lockstat_date;	/* Start of exclusive ownership */
+#endif
 };
 
-void evl_init_stax(struct evl_stax *stax, int flags);
+struct evl_stax_stats {
+	unsigned int oob_contended;
+	unsigned int inband_contended;
+	unsigned int excl_contended;
+};
+
+void __evl_init_stax(struct evl_stax *stax, int flags,
+		struct evl_lockstat_class *lockstat);
+
+#define evl_init_stax(__stax, __flags)					\
+	do {								\
+		evl_define_lockstat(lockstat, #__stax, EVL_LOCKSTAT_STAX); \
+		__evl_init_stax(__stax, __flags, &lockstat);		\
+	} while (0)
 
 void evl_destroy_stax(struct evl_stax *stax);
 
@@ -32,4 +55,13 @@ int evl_trylock_stax(struct evl_stax *stax);
 
 void evl_unlock_stax(struct evl_stax *stax);
 
+int evl_lock_stax_excl(struct evl_stax *stax);
+
+int evl_trylock_stax_excl(struct evl_stax *stax);
+
+void evl_unlock_stax_excl(struct evl_stax *stax);
+
+void evl_get_stax_stats(struct evl_stax *stax,
+			struct evl_stax_stats *stats);
+
 #endif /* !_EVL_STAX_H */
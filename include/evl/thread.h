@@ -35,9 +35,15 @@
 #define EVL_THREAD_INFO_MASK	(EVL_T_RMID|EVL_T_TIMEO|EVL_T_BREAK|	\
 				EVL_T_KICKED|EVL_T_BCAST|EVL_T_NOMEM)
 /* Mode bits configurable via EVL_THRIOC_SET/CLEAR_MODE. */
-#define EVL_THREAD_MODE_BITS	(EVL_T_WOSS|EVL_T_WOLI|EVL_T_WOSX|	\
+#define EVL_THREAD_HM_BITS	(EVL_T_WOSS|EVL_T_WOLI|EVL_T_WOSX|	\
 				EVL_T_WOSO|EVL_T_HMSIG|EVL_T_HMOBS)
 
+#ifdef CONFIG_EVL_SMT_EXCL
+#define EVL_THREAD_MODE_BITS	(EVL_THREAD_HM_BITS|EVL_T_EXCL)
+#else
+#define EVL_THREAD_MODE_BITS	EVL_THREAD_HM_BITS
+#endif
+
 /*
  * These are special internal values of HM diags which are never sent
  * to user-space, but specifically handled by evl_switch_inband().
@@ -48,9 +54,12 @@
 struct evl_thread;
 struct evl_rq;
 struct evl_sched_class;
+struct evl_thread_statslot;
 struct evl_poll_watchpoint;
 struct evl_wait_channel;
 struct evl_observable;
+struct evl_period_slot;
+struct evl_switch_log;
 struct file;
 
 struct evl_init_thread_attr {
@@ -92,10 +101,33 @@ struct evl_thread {
 	struct list_head boosters;
 	struct evl_wait_channel *wchan;	/* Wait channel @thread pends on */
 	struct list_head wait_next;	/* in wchan->wait_list */
+	struct rb_node wait_group;	/* in wchan->wait_index if group tail */
+	int wait_group_prio;		/* priority of the group we end */
 
 	struct evl_timer rtimer;  /* Resource timer */
 	struct evl_timer ptimer;  /* Periodic timer */
+	struct {
+		struct evl_period_slot *slot;
+		struct list_head next;	/* in slot->waiters */
+		u64 release;		/* next release to wait for */
+	} pgroup;
 	ktime_t rrperiod;	  /* Round-robin period (ns) */
+#ifdef CONFIG_EVL_THREAD_BUDGET
+	struct {
+		ktime_t runtime;  /* Max continuous runtime, zero if none */
+		int action;	  /* EVL_BUDGET_* */
+	} budget;
+#endif
+#ifdef CONFIG_EVL_RESCTRL
+	struct {
+		u32 closid;
+		u32 rmid;
+		int flags;	  /* EVL_RESCTRL_* */
+	} resctrl;
+#endif
+#ifdef CONFIG_EVL_SCHED_CAPACITY
+	unsigned int min_capacity; /* Placement hint (SCHED_CAPACITY_SCALE) */
+#endif
 
 	/*
 	 * Shared scheduler-specific data covered by both thread->lock
@@ -118,6 +150,19 @@ struct evl_thread {
 #ifdef CONFIG_EVL_SCHED_TP
 	struct evl_tp_rq *tps;
 	struct list_head tp_link;	/* evl_rq->tp.threads */
+#endif
+#ifdef CONFIG_EVL_SCHED_EDF
+	struct {
+		ktime_t runtime;
+		ktime_t period;
+		ktime_t deadline;	/* relative */
+		ktime_t abs_deadline;
+		ktime_t budget;		/* remaining runtime */
+		ktime_t run_start;
+		u64 bw;
+		struct evl_rq *bw_rq;	/* rq the bandwidth is charged to */
+		unsigned long nr_postponed;
+	} edf;
 #endif
 	struct list_head rq_next;	/* evl_rq->policy.runqueue */
 	struct list_head next;		/* in evl_thread_list */
@@ -142,10 +187,16 @@ struct evl_thread {
 		struct evl_counter csw;	/* context switches */
 		struct evl_counter sc;	/* OOB syscalls */
 		struct evl_counter rwa;	/* remote wakeups */
+		struct evl_counter oobtrap; /* traps handled oob */
 		struct evl_account account; /* exec time accounting */
 		struct evl_account lastperiod;
+		struct evl_pmu_account pmu; /* PMU counters */
+		struct evl_runlat runlat; /* ready-queue latency */
+		struct evl_resptime resptime; /* periodic response time */
+		struct evl_thread_statslot *slot; /* statmap slot */
 	} stat;
 	struct evl_user_window *u_window;
+	struct evl_heap *u_window_heap;
 
 	/* Misc stuff. */
 
@@ -158,6 +209,9 @@ struct evl_thread {
 	struct oob_mm_state *oob_mm;	/* Mostly RO. */
 	struct list_head ptsync_next;	/* covered by oob_mm->lock. */
 	struct evl_observable *observable;
+#ifdef CONFIG_EVL_DEBUG_SWITCH_LOG
+	struct evl_switch_log *switch_log;
+#endif
 	char *name;
 };
 
@@ -280,6 +334,12 @@ void evl_hold_thread(struct evl_thread *thread,
 void evl_release_thread(struct evl_thread *thread,
 			int mask, int info);
 
+void evl_hold_thread_set(struct evl_thread **threads,
+			int nr, int mask);
+
+void evl_release_thread_set(struct evl_thread **threads,
+			int nr, int mask, int info);
+
 void evl_unblock_thread(struct evl_thread *thread,
 			int reason);
 
@@ -308,6 +368,16 @@ void evl_notify_thread(struct evl_thread *thread,
 void evl_get_thread_state(struct evl_thread *thread,
 			struct evl_thread_state *statebuf);
 
+#ifdef CONFIG_EVL_DEBUG_SWITCH_LOG
+void evl_log_inband_switch(struct evl_thread *curr,
+			int cause, union evl_value details);
+#else
+static inline
+void evl_log_inband_switch(struct evl_thread *curr,
+			int cause, union evl_value details)
+{ }
+#endif
+
 int evl_detach_self(void);
 
 void evl_kick_thread(struct evl_thread *thread,
@@ -328,6 +398,13 @@ int evl_set_thread_schedparam(struct evl_thread *thread,
 
 int evl_killall(int mask);
 
+#ifdef CONFIG_EVL_THREAD_POOL
+void evl_init_thread_pool(void);
+#else
+static inline void evl_init_thread_pool(void)
+{ }
+#endif
+
 bool evl_is_thread_file(struct file *filp);
 
 void __evl_propagate_schedparam_change(struct evl_thread *curr);
@@ -12,6 +12,7 @@
 #include <linux/time.h>
 #include <linux/list.h>
 #include <linux/rbtree.h>
+#include <linux/bitops.h>
 #include <evl/clock.h>
 #include <evl/stat.h>
 #include <evl/list.h>
@@ -27,9 +28,10 @@
 #define EVL_TIMER_KGRAVITY  0x00000040
 #define EVL_TIMER_UGRAVITY  0x00000080
 #define EVL_TIMER_IGRAVITY  0	     /* most conservative */
+#define EVL_TIMER_NONCRIT   0x00000100 /* may tick on the housekeeping CPU */
 
 #define EVL_TIMER_GRAVITY_MASK	(EVL_TIMER_KGRAVITY|EVL_TIMER_UGRAVITY)
-#define EVL_TIMER_INIT_MASK	EVL_TIMER_GRAVITY_MASK
+#define EVL_TIMER_INIT_MASK	(EVL_TIMER_GRAVITY_MASK|EVL_TIMER_NONCRIT)
 
 #ifdef CONFIG_EVL_TIMER_SCALABLE
 
@@ -83,7 +85,97 @@ void evl_remove_tnode(struct evl_tqueue *tq, struct evl_tnode *node)
 	for ((__node) = evl_get_tqueue_head(__tq); (__node);	\
 	     (__node) = evl_get_tqueue_next(__tq, __node))
 
-#else /* !CONFIG_EVL_TIMER_SCALABLE */
+#elif defined(CONFIG_EVL_TIMER_WHEEL)
+
+/*
+ * Timers due before tq->horizon are kept in an exact, date-ordered
+ * list. Later timers are hashed by expiry date into the slots of a
+ * timer wheel with no ordering, which makes arming and cancelling
+ * them constant-time operations. The wheel slots are cascaded to
+ * the exact list only when a lookup goes past the end of the
+ * latter, so that timeouts which are cancelled long before they
+ * would elapse never pay for sorting.
+ */
+#define EVL_TWHEEL_SHIFT	20	/* slot span: ~1ms */
+#define EVL_TWHEEL_SLOTS	256
+#define EVL_TWHEEL_SPAN		((ktime_t)1 << EVL_TWHEEL_SHIFT)
+
+struct evl_tnode {
+	ktime_t date;
+	struct list_head next;
+	int slot;		/* wheel slot, -1 if in the exact list */
+};
+
+struct evl_tqueue {
+	struct list_head q;	/* exact list, dates < horizon */
+	ktime_t horizon;	/* aligned on EVL_TWHEEL_SPAN */
+	unsigned int nr_wheel;
+	DECLARE_BITMAP(slot_map, EVL_TWHEEL_SLOTS);
+	struct list_head wheel[EVL_TWHEEL_SLOTS];
+};
+
+static inline int evl_twheel_slot(ktime_t date)
+{
+	return (date >> EVL_TWHEEL_SHIFT) & (EVL_TWHEEL_SLOTS - 1);
+}
+
+void evl_init_tqueue(struct evl_tqueue *tq);
+
+#define evl_destroy_tqueue(__tq)	do { } while (0)
+
+void evl_cascade_tqueue(struct evl_tqueue *tq);
+
+static inline bool evl_tqueue_is_empty(struct evl_tqueue *tq)
+{
+	return list_empty(&tq->q) && tq->nr_wheel == 0;
+}
+
+static inline
+struct evl_tnode *evl_get_tqueue_head(struct evl_tqueue *tq)
+{
+	if (list_empty(&tq->q)) {
+		if (!tq->nr_wheel)
+			return NULL;
+		evl_cascade_tqueue(tq);
+	}
+
+	return list_first_entry(&tq->q, struct evl_tnode, next);
+}
+
+/*
+ * @node must be linked to the exact list, which is always the case
+ * when walking the queue from its head.
+ */
+static inline
+struct evl_tnode *evl_get_tqueue_next(struct evl_tqueue *tq,
+				struct evl_tnode *node)
+{
+	if (list_is_last(&node->next, &tq->q)) {
+		if (!tq->nr_wheel)
+			return NULL;
+		evl_cascade_tqueue(tq);
+	}
+
+	return list_entry(node->next.next, struct evl_tnode, next);
+}
+
+static inline
+void evl_remove_tnode(struct evl_tqueue *tq, struct evl_tnode *node)
+{
+	list_del(&node->next);
+
+	if (node->slot >= 0) {
+		if (list_empty(&tq->wheel[node->slot]))
+			__clear_bit(node->slot, tq->slot_map);
+		tq->nr_wheel--;
+	}
+}
+
+#define for_each_evl_tnode(__node, __tq)			\
+	for ((__node) = evl_get_tqueue_head(__tq); (__node);	\
+	     (__node) = evl_get_tqueue_next(__tq, __node))
+
+#else /* !CONFIG_EVL_TIMER_SCALABLE && !CONFIG_EVL_TIMER_WHEEL */
 
 struct evl_tnode {
 	ktime_t date;
@@ -151,15 +243,39 @@ void evl_remove_tnode(struct evl_tqueue *tq, struct evl_tnode *node)
 #define for_each_evl_tnode(__node, __tq)	\
 	list_for_each_entry(__node, &(__tq)->q, next)
 
-#endif /* CONFIG_EVL_TIMER_SCALABLE */
+#endif /* !CONFIG_EVL_TIMER_SCALABLE && !CONFIG_EVL_TIMER_WHEEL */
 
 struct evl_rq;
 
+/*
+ * Timers are queued by expiry date relative to their own clock. The
+ * timers of a master clock are queued to its per-CPU timer base,
+ * those of each slave clock to a separate per-CPU queue linked to
+ * the timer base of its master, which serializes accesses to all of
+ * them. Changing the offset of a slave clock from its master
+ * therefore does not require requeuing its timers.
+ */
 struct evl_timerbase {
 	hard_spinlock_t lock;
 	struct evl_tqueue q;
+	struct list_head slaves;
+};
+
+struct evl_slave_tqueue {
+	struct evl_tqueue q;
+	struct evl_clock *clock;
+	struct list_head next;	/* in evl_timerbase->slaves */
 };
 
+static inline struct evl_tqueue *
+evl_percpu_tqueue(struct evl_clock *clock, int cpu)
+{
+	if (clock->master == clock)
+		return &per_cpu_ptr(clock->timerdata, cpu)->q;
+
+	return &per_cpu_ptr(clock->slavedata, cpu)->q;
+}
+
 static inline struct evl_timerbase *
 evl_percpu_timers(struct evl_clock *clock, int cpu)
 {
@@ -172,24 +288,62 @@ evl_this_cpu_timers(struct evl_clock *clock)
 	return raw_cpu_ptr(clock->timerdata);
 }
 
+/*
+ * Timer classes lateness statistics are collected for, see
+ * evl_set_timer_class().
+ */
+enum evl_timer_class {
+	EVL_TIMER_CLASS_OTHER = 0,
+	EVL_TIMER_CLASS_TIMEOUT,
+	EVL_TIMER_CLASS_PERIODIC,
+	EVL_TIMER_CLASS_TIMERFD,
+	EVL_TIMER_CLASS_RR,
+	EVL_TIMER_CLASS_WATCHDOG,
+	EVL_TIMER_CLASS_BUDGET,
+	EVL_TIMER_CLASS_MEMGUARD,
+	EVL_NR_TIMER_CLASSES
+};
+
+/* Histogram buckets by log2 of the lateness (ns). */
+#define EVL_LATENESS_HIST_SIZE	32
+
+struct evl_timer_lateness {
+	u64 count;
+	s64 sum;
+	s64 min;
+	s64 max;
+	unsigned long hist[EVL_LATENESS_HIST_SIZE];
+};
+
+/* Per-CPU lateness statistics of a clock. */
+struct evl_clock_lateness {
+	struct evl_timer_lateness class[EVL_NR_TIMER_CLASSES];
+};
+
 struct evl_timer {
 	struct evl_clock *clock;
 	struct evl_tnode node;
 	struct list_head adjlink;
 	int status;
 	ktime_t interval;	/* 0 == oneshot */
+	ktime_t slack;		/* allowed expiry delay, 0 == exact */
 	ktime_t start_date;
 	u64 consumed_ticks;	/* advanced by evl_get_timer_overruns() */
 	u64 periodic_ticks;
 #ifdef CONFIG_SMP
 	struct evl_rq *rq;
+#endif
+#ifdef CONFIG_EVL_TIMER_HOUSEKEEPING
+	struct evl_rq *home_rq;	/* rq the timer was meant to tick on */
 #endif
 	struct evl_timerbase *base;
+	struct evl_tqueue *tq;
 	void (*handler)(struct evl_timer *timer);
 	const char *name;
 #ifdef CONFIG_EVL_RUNSTATS
 	struct evl_counter scheduled;
 	struct evl_counter fired;
+	enum evl_timer_class lclass;
 #endif /* CONFIG_EVL_RUNSTATS */
 };
 
@@ -252,6 +406,13 @@ static inline unsigned long evl_get_timer_gravity(struct evl_timer *timer)
 }
 
 /* timer base locked. */
+static inline ktime_t evl_get_timer_expiry(struct evl_timer *timer)
+{
+	/* Ideal expiry date without anticipation (no gravity) */
+	return ktime_add(evl_tdate(timer),
+			evl_get_timer_gravity(timer));
+}
+
 static inline void evl_update_timer_date(struct evl_timer *timer)
 {
 	evl_tdate(timer) = ktime_add_ns(timer->start_date,
@@ -276,6 +437,15 @@ void __evl_init_timer(struct evl_timer *timer,
 void evl_set_timer_gravity(struct evl_timer *timer,
 			int gravity);
 
+void evl_set_timer_slack(struct evl_timer *timer,
+			ktime_t slack);
+
+ktime_t evl_get_timer_batch_date(struct evl_tqueue *tq,
+				struct evl_tnode *tn);
+
+struct evl_timer *evl_get_slave_timers_head(struct evl_timerbase *tmb,
+					ktime_t *datep);
+
 #define evl_init_timer_on_rq(__timer, __clock, __handler, __rq, __flags) \
 	__evl_init_timer(__timer, __clock, __handler,			\
 			__rq, #__handler, __flags)
@@ -312,6 +482,36 @@ void evl_account_timer_fired(struct evl_timer *timer)
 	evl_inc_counter(&timer->fired);
 }
 
+static inline
+void evl_set_timer_class(struct evl_timer *timer, enum evl_timer_class lclass)
+{
+	timer->lclass = lclass;
+}
+
+/*
+ * Account for the lateness of @timer firing at @now. Called from the
+ * tick handler with the timer base locked, so that per-CPU
+ * statistics need no further serialization.
+ */
+static inline
+void evl_account_timer_lateness(struct evl_timer *timer, ktime_t now)
+{
+	struct evl_timer_lateness *st;
+	s64 lat;
+
+	st = &raw_cpu_ptr(timer->clock->lateness)->class[timer->lclass];
+	lat = ktime_to_ns(ktime_sub(now, evl_get_timer_expiry(timer)));
+	if (st->count++ == 0) {
+		st->min = st->max = lat;
+	} else if (lat < st->min) {
+		st->min = lat;
+	} else if (lat > st->max) {
+		st->max = lat;
+	}
+	st->sum += lat;
+	st->hist[lat > 0 ? min(fls64(lat), EVL_LATENESS_HIST_SIZE - 1) : 0]++;
+}
+
 #else /* !CONFIG_EVL_RUNSTATS */
 
 static inline
@@ -323,6 +523,12 @@ void evl_account_timer_scheduled(struct evl_timer *timer) { }
 static inline
 void evl_account_timer_fired(struct evl_timer *timer) { }
 
+static inline
+void evl_set_timer_class(struct evl_timer *timer, enum evl_timer_class lclass) { }
+
+static inline
+void evl_account_timer_lateness(struct evl_timer *timer, ktime_t now) { }
+
 #endif /* !CONFIG_EVL_RUNSTATS */
 
 static inline
@@ -339,14 +545,6 @@ const char *evl_get_timer_name(struct evl_timer *timer)
 
 bool evl_timer_deactivate(struct evl_timer *timer);
 
-/* timer base locked. */
-static inline ktime_t evl_get_timer_expiry(struct evl_timer *timer)
-{
-	/* Ideal expiry date without anticipation (no gravity) */
-	return ktime_add(evl_tdate(timer),
-			evl_get_timer_gravity(timer));
-}
-
 ktime_t evl_get_timer_date(struct evl_timer *timer);
 
 ktime_t __evl_get_timer_delta(struct evl_timer *timer);
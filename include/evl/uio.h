@@ -8,9 +8,54 @@
 #define _EVL_UIO_H
 
 #include <linux/types.h>
+#include <linux/minmax.h>
+#include <linux/list.h>
+#include <linux/atomic.h>
 
 struct iovec;
 struct kvec;
+struct page;
+struct oob_mm_state;
+
+/*
+ * User buffers pinned in advance by the application, which the core
+ * may access directly through a kernel mapping instead of going
+ * through the uaccess helpers on every transfer. Registration and
+ * removal happen in-band, lookups may happen from any stage, holding
+ * a reference on the buffer while copying.
+ */
+struct evl_ubuf {
+	unsigned long start;
+	size_t len;
+	struct page **pages;
+	int nr_pages;
+	void *vaddr;
+	atomic_t refs;
+	struct list_head next;
+};
+
+struct evl_ubuf *evl_get_ubuf(const void __user *ptr, size_t len);
+
+static inline void evl_put_ubuf(struct evl_ubuf *ubuf)
+{
+	atomic_dec(&ubuf->refs);
+}
+
+static inline
+void *evl_ubuf_ptr(struct evl_ubuf *ubuf, const void __user *ptr)
+{
+	return ubuf->vaddr + ((unsigned long)ptr - ubuf->start);
+}
+
+void evl_init_ubufs(struct oob_mm_state *oob_mm);
+
+int evl_pin_ubuf(struct oob_mm_state *oob_mm,
+		unsigned long addr, size_t len);
+
+int evl_unpin_ubuf(struct oob_mm_state *oob_mm,
+		unsigned long addr);
+
+void evl_drop_ubufs(struct oob_mm_state *oob_mm);
 
 ssize_t evl_copy_to_uio(const struct iovec *iov, size_t iovlen,
 			const void *data, size_t len);
@@ -37,4 +82,18 @@ size_t evl_iov_flat_length(const struct iovec *iov, int iovlen)
 	return count;
 }
 
+/* Consume @count bytes from the head of @iov. */
+static inline
+void evl_iov_advance(struct iovec *iov, size_t iovlen, size_t count)
+{
+	size_t n, len;
+
+	for (n = 0; n < iovlen && count > 0; n++) {
+		len = min(count, iov[n].iov_len);
+		iov[n].iov_base += len;
+		iov[n].iov_len -= len;
+		count -= len;
+	}
+}
+
 #endif /* !_EVL_UIO_H */
@@ -10,6 +10,7 @@
 
 #include <linux/errno.h>
 #include <linux/list.h>
+#include <linux/rbtree.h>
 #include <evl/assert.h>
 #include <evl/timeout.h>
 
@@ -24,6 +25,9 @@ struct evl_wait_channel {
 	bool (*requeue_wait)(struct evl_wait_channel *wchan,
 			struct evl_thread *waiter);
 	struct list_head wait_list;
+	/* Priority groups of a crowded wait_list, see evl_add_waiter(). */
+	struct rb_root wait_index;
+	int nr_waiters;
 	const char *name;
 };
 
@@ -41,6 +45,8 @@ struct evl_wait_queue {
 			.owner = NULL,					\
 			.requeue_wait = evl_requeue_wait,		\
 			.wait_list = LIST_HEAD_INIT((__name).wchan.wait_list), \
+			.wait_index = RB_ROOT,				\
+			.nr_waiters = 0,				\
 			.name = #__name,				\
 		},							\
 	}
@@ -91,6 +97,15 @@ void evl_add_wait_queue_unchecked(struct evl_wait_queue *wq,
 				  ktime_t timeout,
 				  enum evl_tmode timeout_mode);
 
+void evl_add_waiter(struct evl_wait_channel *wchan,
+		struct evl_thread *waiter);
+
+void evl_add_waiter_tail(struct evl_wait_channel *wchan,
+			struct evl_thread *waiter);
+
+void evl_del_waiter(struct evl_wait_channel *wchan,
+		struct evl_thread *waiter);
+
 int __evl_wait_schedule(struct evl_wait_channel *wchan);
 
 static inline int evl_wait_schedule(struct evl_wait_queue *wq)
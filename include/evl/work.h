@@ -9,6 +9,7 @@
 
 #include <linux/irq_work.h>
 #include <linux/workqueue.h>
+#include <linux/llist.h>
 #include <evl/flag.h>
 
 struct evl_element;
@@ -101,6 +102,84 @@ void evl_flush_sync_work(struct evl_sync_work *sync_work)
 	evl_flush_work(&sync_work->work);
 }
 
+/*
+ * Deferred processing on the oob stage, by per-CPU EVL kthreads
+ * running at the priority of their workqueue.
+ */
+struct evl_oob_worker;
+
+struct evl_oob_work {
+	struct list_head next;
+	void (*handler)(struct evl_oob_work *work);
+	struct evl_oob_worker *worker;
+	unsigned long flags;
+};
+
+#define EVL_OOB_WORK_PENDING	0
+
+struct evl_oob_workqueue;
+
+/* Priorities of the system oob workqueues. */
+#define EVL_OOB_WQ_PRIO		50
+#define EVL_OOB_WQ_HIGHPRIO	90
+
+extern struct evl_oob_workqueue *evl_oob_wq;
+
+extern struct evl_oob_workqueue *evl_oob_highpri_wq;
+
+static inline
+void evl_init_oob_work(struct evl_oob_work *work,
+		void (*handler)(struct evl_oob_work *work))
+{
+	INIT_LIST_HEAD(&work->next);
+	work->handler = handler;
+	work->worker = NULL;
+	work->flags = 0;
+}
+
+struct evl_oob_workqueue *
+evl_alloc_oob_workqueue(const char *name, int priority);
+
+void evl_destroy_oob_workqueue(struct evl_oob_workqueue *wq);
+
+bool evl_queue_oob_work_on(struct evl_oob_workqueue *wq,
+			int cpu, struct evl_oob_work *work);
+
+bool evl_queue_oob_work(struct evl_oob_workqueue *wq,
+			struct evl_oob_work *work);
+
+bool evl_cancel_oob_work(struct evl_oob_work *work);
+
+int evl_init_oob_workqueues(void);
+
+/*
+ * Wake up requests for in-band waiters, issued from the oob stage.
+ * Requests pending on a CPU are batched, then run by a single in-band
+ * irq_work on the next transition to that stage.
+ */
+struct evl_inband_wakeup {
+	struct llist_node node;
+	void (*handler)(struct evl_inband_wakeup *wakeup);
+	unsigned long flags;
+};
+
+#define EVL_INBAND_WAKEUP_PENDING	0
+
+static inline
+void evl_init_inband_wakeup(struct evl_inband_wakeup *wakeup,
+			void (*handler)(struct evl_inband_wakeup *wakeup))
+{
+	init_llist_node(&wakeup->node);
+	wakeup->handler = handler;
+	wakeup->flags = 0;
+}
+
+bool evl_queue_inband_wakeup(struct evl_inband_wakeup *wakeup);
+
+#ifdef CONFIG_EVL_RUNSTATS
+ssize_t evl_show_inband_wakeups(char *buf, size_t size);
+#endif
+
 void __evl_do_irq_work(struct irq_work *irq_work);
 void __evl_do_work(struct work_struct *wq_work);
 void __evl_do_sync_work(struct work_struct *wq_work);
@@ -12,6 +12,11 @@
 struct evl_file;
 struct evl_xbuf;
 
+struct evl_xbuf_slot {
+	void *ptr[2];
+	size_t len[2];
+};
+
 struct evl_xbuf *evl_get_xbuf(int efd,
 			struct evl_file **efilpp);
 
@@ -25,4 +30,9 @@ ssize_t evl_write_xbuf(struct evl_xbuf *xbuf,
 		const void *buf, size_t count,
 		int f_flags);
 
+int evl_reserve_xbuf(struct evl_xbuf *xbuf, size_t count,
+		struct evl_xbuf_slot *slot, int f_flags);
+
+void evl_commit_xbuf(struct evl_xbuf *xbuf);
+
 #endif /* !_EVL_XBUF_H */
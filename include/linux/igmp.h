@@ -142,4 +142,9 @@ extern void __ip_mc_inc_group(struct in_device *in_dev, __be32 addr,
 extern void ip_mc_inc_group(struct in_device *in_dev, __be32 addr);
 int ip_mc_check_igmp(struct sk_buff *skb);
 
+#ifdef CONFIG_NET_OOB
+int ip_mc_join_oob_group(struct sock *sk, __be32 group, int ifindex);
+void ip_mc_leave_oob_group(struct sock *sk, __be32 group, int ifindex);
+#endif
+
 #endif
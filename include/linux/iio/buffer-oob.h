@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+#ifndef __IIO_BUFFER_OOB_H__
+#define __IIO_BUFFER_OOB_H__
+
+#include <linux/iio/buffer.h>
+
+struct iio_dev;
+struct device;
+struct dma_chan;
+
+/**
+ * struct iio_oob_buffer_ops - driver hooks of an oob capture buffer
+ * @start:	optional, called from the oob stage before each DMA
+ *		pulse, e.g. to kick a software-started conversion.
+ */
+struct iio_oob_buffer_ops {
+	void (*start)(struct iio_dev *indio_dev);
+};
+
+struct iio_buffer *devm_iio_oob_buffer_setup(struct device *dev,
+					struct iio_dev *indio_dev,
+					struct dma_chan *chan,
+					size_t block_size,
+					unsigned int nr_blocks,
+					const struct iio_oob_buffer_ops *ops);
+
+void iio_oob_buffer_pulse(struct iio_buffer *buffer);
+
+#endif /* __IIO_BUFFER_OOB_H__ */
@@ -11,10 +11,13 @@
 
 struct dma_buf_attachment;
 struct dma_fence;
+struct file;
 struct iio_dev;
 struct iio_dma_buffer_block;
 struct iio_buffer;
+struct oob_poll_wait;
 struct sg_table;
+struct vm_area_struct;
 
 /**
  * INDIO_BUFFER_FLAG_FIXED_WATERMARK - Watermark level of the buffer can not be
@@ -22,6 +25,13 @@ struct sg_table;
  */
 #define INDIO_BUFFER_FLAG_FIXED_WATERMARK BIT(0)
 
+/**
+ * INDIO_BUFFER_FLAG_OOB - The buffer fd can be read and polled from the
+ *   out-of-band stage by EVL threads, via the @oob_read and @oob_poll
+ *   handlers.
+ */
+#define INDIO_BUFFER_FLAG_OOB BIT(1)
+
 /**
  * struct iio_buffer_access_funcs - access functions for buffers.
  * @store_to:		actually store stuff to the buffer
@@ -53,6 +63,11 @@ struct sg_table;
  * @lock_queue:		called when the core needs to lock the buffer queue;
  *                      it is used when enqueueing DMABUF objects.
  * @unlock_queue:       used to unlock a previously locked buffer queue
+ * @oob_read:		read from the out-of-band stage, INDIO_BUFFER_FLAG_OOB
+ *			buffers only.
+ * @oob_poll:		poll from the out-of-band stage, INDIO_BUFFER_FLAG_OOB
+ *			buffers only.
+ * @mmap:		map the buffer memory into the caller's address space.
  * @modes:		Supported operating modes by this buffer type
  * @flags:		A bitmask combination of INDIO_BUFFER_FLAG_*
  *
@@ -93,6 +108,12 @@ struct iio_buffer_access_funcs {
 	void (*lock_queue)(struct iio_buffer *buffer);
 	void (*unlock_queue)(struct iio_buffer *buffer);
 
+	ssize_t (*oob_read)(struct iio_buffer *buffer, struct file *filp,
+			    char __user *buf, size_t n);
+	__poll_t (*oob_poll)(struct iio_buffer *buffer,
+			     struct oob_poll_wait *wait);
+	int (*mmap)(struct iio_buffer *buffer, struct vm_area_struct *vma);
+
 	unsigned int modes;
 	unsigned int flags;
 };
@@ -1383,13 +1383,16 @@ struct netdev_net_notifier {
  *			   struct kernel_hwtstamp_config *kernel_config,
  *			   struct netlink_ext_ack *extack);
  *	Change the hardware timestamping parameters for NIC device.
- * void	(*ndo_enable_oob)(struct net_device *dev);
+ * int	(*ndo_enable_oob)(struct net_device *dev);
  *	Turn on out-of-band I/O handling. On return from this handler, the device
- *	must be prepared to handle RX/TX packets from the out-of-band stage. This
+ *	must be prepared to handle RX/TX packets from the out-of-band stage. The
+ *	diversion flag is already set when this handler runs, so that packets
+ *	received from the out-of-band stage meanwhile are diverted. This
  *	handler is optional.
  * void	(*ndo_disable_oob)(struct net_device *dev);
  *	Turn off out-of-band I/O handling, reverting the effect of ndo_enable_oob().
- *	This handler is optional.
+ *	The diversion flag is cleared only on return from this handler. This
+ *	handler is optional.
  */
 struct net_device_ops {
 	int			(*ndo_init)(struct net_device *dev);
@@ -4591,21 +4594,21 @@ static inline void netif_enable_oob_diversion(struct net_device *dev)
 {
 	const struct net_device_ops *ops = dev->netdev_ops;
 
+	set_bit(__LINK_STATE_OOB, &dev->state);
+	smp_mb__after_atomic();
+
 	if (ops->ndo_enable_oob)
 		ops->ndo_enable_oob(dev);
-
-	set_bit(__LINK_STATE_OOB, &dev->state);
 }
 
 static inline void netif_disable_oob_diversion(struct net_device *dev)
 {
 	const struct net_device_ops *ops = dev->netdev_ops;
 
-	clear_bit(__LINK_STATE_OOB, &dev->state);
-	smp_mb__after_atomic();
-
 	if (ops->ndo_disable_oob)
 		ops->ndo_disable_oob(dev);
+
+	clear_bit(__LINK_STATE_OOB, &dev->state);
 }
 
 /**
@@ -4641,6 +4644,7 @@ void process_inband_tx_backlog(struct softnet_data *sd);
 int netif_oob_switch_port(struct net_device *dev, bool enabled);
 bool netif_oob_get_port(struct net_device *dev);
 ssize_t netif_oob_query_pool(struct net_device *dev, char *buf);
+ssize_t netif_oob_query_stats(struct net_device *dev, char *buf);
 
 static inline void netdev_set_oob_capable(struct net_device *dev)
 {
@@ -104,6 +104,17 @@ struct ptp_system_timestamp {
  *               reading the lowest bits of the PHC timestamp and the second
  *               reading immediately follows that.
  *
+ * @gettimex64_oob:  Same as @gettimex64, except that this method may be
+ *                   called from the out-of-band stage, or in-band with
+ *                   hard interrupts disabled. It must not sleep nor take
+ *                   any in-band lock, and should read the system clock
+ *                   using ptp_read_system_prets_oob() and
+ *                   ptp_read_system_postts_oob(). Only available with
+ *                   CONFIG_PTP_1588_CLOCK_OOB.
+ *                   parameter ts: Holds the PHC timestamp.
+ *                   parameter sts: If not NULL, it holds a pair of
+ *                   timestamps from the system clock, as @gettimex64.
+ *
  * @getcrosststamp:  Reads the current time from the hardware clock and
  *                   system clock simultaneously.
  *                   parameter cts: Contains timestamp (device,system) pair,
@@ -182,6 +193,10 @@ struct ptp_clock_info {
 	int (*gettime64)(struct ptp_clock_info *ptp, struct timespec64 *ts);
 	int (*gettimex64)(struct ptp_clock_info *ptp, struct timespec64 *ts,
 			  struct ptp_system_timestamp *sts);
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+	int (*gettimex64_oob)(struct ptp_clock_info *ptp, struct timespec64 *ts,
+			      struct ptp_system_timestamp *sts);
+#endif
 	int (*getcrosststamp)(struct ptp_clock_info *ptp,
 			      struct system_device_crosststamp *cts);
 	int (*settime64)(struct ptp_clock_info *p, const struct timespec64 *ts);
@@ -379,6 +394,27 @@ int ptp_find_pin(struct ptp_clock *ptp,
 int ptp_find_pin_unlocked(struct ptp_clock *ptp,
 			  enum ptp_pin_function func, unsigned int chan);
 
+#ifdef CONFIG_PTP_1588_CLOCK_OOB
+
+/**
+ * ptp_clock_gettimex_oob() - read a PTP clock from the out-of-band stage
+ *
+ * This function may be called from the out-of-band stage, or
+ * in-band with hard interrupts disabled. The caller must ensure
+ * that @ptp is not unregistered while this call is in progress.
+ *
+ * @ptp:    The clock obtained from ptp_clock_register().
+ * @ts:     Holds the PHC timestamp.
+ * @sts:    If not NULL, it holds a pair of system timestamps.
+ * Return:  Zero on success, -EOPNOTSUPP if the clock driver does
+ *          not implement ptp_clock_info::gettimex64_oob().
+ */
+
+int ptp_clock_gettimex_oob(struct ptp_clock *ptp, struct timespec64 *ts,
+			   struct ptp_system_timestamp *sts);
+
+#endif
+
 /**
  * ptp_schedule_worker() - schedule ptp auxiliary work
  *
@@ -495,4 +531,40 @@ static inline void ptp_read_system_postts(struct ptp_system_timestamp *sts)
 	}
 }
 
+/*
+ * The out-of-band variants read the NMI-safe fast timekeeper
+ * accessors, which never wait for an in-band timekeeping update to
+ * complete. CLOCK_MONOTONIC readings are directly comparable to the
+ * EVL monotonic clock.
+ */
+static inline void __ptp_read_system_ts_oob(clockid_t clockid,
+					    struct timespec64 *ts)
+{
+	switch (clockid) {
+	case CLOCK_REALTIME:
+		*ts = ns_to_timespec64(ktime_get_real_fast_ns());
+		break;
+	case CLOCK_MONOTONIC:
+		*ts = ns_to_timespec64(ktime_get_mono_fast_ns());
+		break;
+	case CLOCK_MONOTONIC_RAW:
+		*ts = ns_to_timespec64(ktime_get_raw_fast_ns());
+		break;
+	default:
+		break;
+	}
+}
+
+static inline void ptp_read_system_prets_oob(struct ptp_system_timestamp *sts)
+{
+	if (sts)
+		__ptp_read_system_ts_oob(sts->clockid, &sts->pre_ts);
+}
+
+static inline void ptp_read_system_postts_oob(struct ptp_system_timestamp *sts)
+{
+	if (sts)
+		__ptp_read_system_ts_oob(sts->clockid, &sts->post_ts);
+}
+
 #endif
@@ -292,12 +292,18 @@ int up_oob_call(smp_call_func_t func, void *info);
 #ifdef CONFIG_SMP
 int smp_call_function_oob(int cpu, smp_call_func_t func, void *info, bool wait);
 void smp_flush_oob_call_function_queue(void);
+void smp_shield_inband_ipis(void);
+void smp_unshield_inband_ipis(void);
+void smp_get_inband_ipi_stats(int cpu, unsigned long *deferred,
+			unsigned long *forced);
 #else
 static inline int smp_call_function_oob(int cpu, smp_call_func_t func,
 					void *info, bool wait)
 {
 	return up_oob_call(func, info);
 }
+static inline void smp_shield_inband_ipis(void) { }
+static inline void smp_unshield_inband_ipis(void) { }
 #endif /* !CONFIG_SMP */
 #else
 #define hard_get_cpu(flags)	({ (void)(flags); get_cpu(); })
@@ -601,6 +601,11 @@ struct spi_controller {
 	 * assert/de-assert more than one chip select at once.
 	 */
 #define SPI_CONTROLLER_MULTI_CS		BIT(7)
+	/*
+	 * The spi-controller can run a queue of out-of-band frames
+	 * on a single pulse, see struct spi_oob_frame.
+	 */
+#define SPI_CONTROLLER_OOB_QUEUE	BIT(8)
 
 	/* Flag indicating if the allocation of this struct is devres-managed */
 	bool			devm_allocated;
@@ -1270,6 +1275,25 @@ extern void spi_unoptimize_message(struct spi_message *msg);
 extern int devm_spi_optimize_message(struct device *dev, struct spi_device *spi,
 				     struct spi_message *msg);
 
+/*
+ * A frame in a queue of out-of-band transfers. All frames of a queue
+ * are laid out back-to-back in the RX and TX areas of the I/O buffer,
+ * moved by a single DMA stream per direction on every pulse. The
+ * controller switches the chip select, length and clock rate from
+ * one frame to the next on its own, the transfer completes once the
+ * last frame was received.
+ */
+struct spi_oob_frame {
+	/* Caller-defined settings. */
+	u32 len;
+	u32 speed_hz;
+	u8 cs;
+	/* Set by spi_prepare_oob_transfer(). */
+	struct spi_device *spi;
+	u32 offset;		/* into the RX and TX areas */
+	u32 effective_speed_hz;
+};
+
 struct spi_oob_transfer {
 	struct spi_device *spi;
 	dma_addr_t dma_addr;
@@ -1286,6 +1310,12 @@ struct spi_oob_transfer {
 		u32 speed_hz;
 		u8 bits_per_word;
 		dma_async_tx_callback xfer_done;
+		/*
+		 * Optional queue of frames, frame_len is the sum
+		 * of their lengths in this case.
+		 */
+		struct spi_oob_frame *frames;
+		unsigned int nr_frames;
 	} setup;
 };
 
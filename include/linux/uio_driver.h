@@ -16,6 +16,7 @@
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/interrupt.h>
+#include <evl/devices/uio.h>
 
 struct module;
 struct uio_map;
@@ -84,6 +85,7 @@ struct uio_device {
 	struct mutex		info_lock;
 	struct kobject          *map_dir;
 	struct kobject          *portio_dir;
+	struct uio_oob_state	oob;
 };
 
 /**
@@ -94,7 +96,8 @@ struct uio_device {
  * @mem:		list of mappable memory regions, size==0 for end of list
  * @port:		list of port regions, size==0 for end of list
  * @irq:		interrupt number or UIO_IRQ_CUSTOM
- * @irq_flags:		flags for request_irq()
+ * @irq_flags:		flags for request_irq(), IRQF_OOB requests out-of-band
+ *			handling, in which case @handler must be oob-safe
  * @priv:		optional private data
  * @handler:		the device's irq handler
  * @mmap:		mmap operation for this uio device
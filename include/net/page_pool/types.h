@@ -77,6 +77,8 @@ struct pp_alloc_cache {
  * @queue_idx:	queue idx this page_pool is being created for.
  * @flags:	PP_FLAG_DMA_MAP, PP_FLAG_DMA_SYNC_DEV, PP_FLAG_SYSTEM_POOL,
  *		PP_FLAG_ALLOW_UNREADABLE_NETMEM.
+ * @oob_fill:	pages populating an oob-accessed pool at init, up to
+ *		@pool_size which is the default.
  */
 struct page_pool_params {
 	struct_group_tagged(page_pool_params_fast, fast,
@@ -93,6 +95,7 @@ struct page_pool_params {
 		struct net_device *netdev;
 		unsigned int queue_idx;
 		unsigned int	flags;
+		unsigned int	oob_fill;
 /* private: used by test code only */
 		void (*init_callback)(netmem_ref netmem, void *arg);
 		void *init_arg;
@@ -284,6 +287,17 @@ static inline unsigned int page_pool_cache_refill(struct page_pool *pool)
 	return IS_ENABLED(CONFIG_PAGE_POOL_OOB) &&
 		pool->slow.flags & PP_FLAG_PAGE_OOB ? pool->p.pool_size : PP_ALLOC_CACHE_REFILL;
 }
+
+#ifdef CONFIG_PAGE_POOL_OOB
+unsigned int page_pool_oob_grow(struct page_pool *pool, unsigned int nr);
+unsigned int page_pool_oob_shrink(struct page_pool *pool, unsigned int nr);
+
+/* Pages of an oob-accessed pool which are free at the moment. */
+static inline unsigned int page_pool_oob_free(struct page_pool *pool)
+{
+	return READ_ONCE(pool->alloc.count);
+}
+#endif
 #else
 static inline void page_pool_destroy(struct page_pool *pool)
 {
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+#ifndef __SOUND_SOC_OOB_PCM_H
+#define __SOUND_SOC_OOB_PCM_H
+
+#include <linux/dmaengine.h>
+
+struct device;
+struct snd_soc_oob_pcm;
+
+struct snd_soc_oob_pcm *
+snd_soc_oob_pcm_register(struct device *dev, const char *name,
+			struct dma_chan *chan,
+			enum dma_transfer_direction dir,
+			size_t period_bytes, unsigned int nr_periods);
+
+void snd_soc_oob_pcm_unregister(struct snd_soc_oob_pcm *opcm);
+
+int devm_snd_soc_oob_pcm_register(struct device *dev, const char *name,
+				struct dma_chan *chan,
+				enum dma_transfer_direction dir,
+				size_t period_bytes, unsigned int nr_periods);
+
+#endif /* __SOUND_SOC_OOB_PCM_H */
@@ -14,6 +14,7 @@
 
 #include <linux/mman.h>
 #include <linux/sched.h>
+#include <linux/sched/topology.h>
 #include <linux/math64.h>
 #include <linux/tracepoint.h>
 #include <linux/trace_seq.h>
@@ -153,6 +154,7 @@ DECLARE_EVENT_CLASS(evl_syscall_exit,
 			 {SCHED_FIFO, "fifo"},		\
 			 {SCHED_RR, "rr"},		\
 			 {SCHED_QUOTA, "quota"},	\
+			 {SCHED_EDF, "edf"},		\
 			 {SCHED_WEAK, "weak"})
 
 const char *evl_trace_sched_attrs(struct trace_seq *seq,
@@ -521,11 +523,44 @@ TRACE_EVENT(evl_thread_migrate,
 		  __entry->thread, __entry->pid, __entry->cpu)
 );
 
+TRACE_EVENT(evl_thread_place,
+	TP_PROTO(struct evl_thread *thread, unsigned int from,
+		unsigned int to, unsigned int min_capacity),
+	TP_ARGS(thread, from, to, min_capacity),
+
+	TP_STRUCT__entry(
+		__field(struct evl_thread *, thread)
+		__field(pid_t, pid)
+		__field(unsigned int, from)
+		__field(unsigned int, to)
+		__field(unsigned int, min_capacity)
+		__field(unsigned long, capacity)
+	),
+
+	TP_fast_assign(
+		__entry->thread = thread;
+		__entry->pid = evl_get_inband_pid(thread);
+		__entry->from = from;
+		__entry->to = to;
+		__entry->min_capacity = min_capacity;
+		__entry->capacity = arch_scale_cpu_capacity(to);
+	),
+
+	TP_printk("thread=%p pid=%d cpu=%u -> cpu=%u capacity=%lu/%u",
+		  __entry->thread, __entry->pid, __entry->from,
+		  __entry->to, __entry->capacity, __entry->min_capacity)
+);
+
 DEFINE_EVENT(curr_thread_event, evl_watchdog_signal,
 	TP_PROTO(struct evl_thread *curr),
 	TP_ARGS(curr)
 );
 
+DEFINE_EVENT(curr_thread_event, evl_budget_overrun,
+	TP_PROTO(struct evl_thread *curr),
+	TP_ARGS(curr)
+);
+
 DEFINE_EVENT(curr_thread_event, evl_switch_oob,
 	TP_PROTO(struct evl_thread *curr),
 	TP_ARGS(curr)
@@ -547,7 +582,9 @@ DEFINE_EVENT(curr_thread_event, evl_switched_oob,
 			{ EVL_HMDIAG_LKDEPEND,		"lock dependency" },	\
 			{ EVL_HMDIAG_LKIMBALANCE,	"lock imbalance" },	\
 			{ EVL_HMDIAG_LKSLEEP,		"sleep holding lock" },	\
-			{ EVL_HMDIAG_STAGEX,		"stage exclusion" } )
+			{ EVL_HMDIAG_STAGEX,		"stage exclusion" },	\
+			{ EVL_HMDIAG_OVERRUN,		"partition overrun" },	\
+			{ EVL_HMDIAG_BUDGET,		"runtime budget" } )
 
 TRACE_EVENT(evl_switch_inband,
 	TP_PROTO(int cause),
@@ -907,6 +944,23 @@ TRACE_EVENT(evl_trace,
 	TP_printk("%s", __get_str(msg))
 );
 
+TRACE_EVENT(evl_klog,
+	TP_PROTO(int cpu, ktime_t date, const char *msg),
+	TP_ARGS(cpu, date, msg),
+	TP_STRUCT__entry(
+		__field(int, cpu)
+		__field(ktime_t, date)
+		__string(msg, msg)
+	),
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->date = date;
+		__assign_str(msg);
+	),
+	TP_printk("cpu=%d date=%Lu %s", __entry->cpu,
+		ktime_to_ns(__entry->date), __get_str(msg))
+);
+
 TRACE_EVENT(evl_latspot,
 	TP_PROTO(int latmax_ns),
 	TP_ARGS(latmax_ns),
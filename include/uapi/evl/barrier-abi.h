@@ -0,0 +1,42 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_BARRIER_ABI_H
+#define _EVL_UAPI_BARRIER_ABI_H
+
+#include <linux/types.h>
+
+#define EVL_BARRIER_DEV		"barrier"
+
+#define EVL_BARRIER_MAX_COUNT	1024
+
+struct evl_barrier_attrs {
+	__u32 clockfd;
+	__u32 count;	/* Number of participants. */
+	__u32 spin_ns;	/* Spin time before sleeping, zero disables. */
+	__u32 __pad;
+};
+
+/*
+ * Read-only for user-space. generation is bumped each time the
+ * barrier trips, arrived counts the participants waiting for the
+ * current cycle to complete.
+ */
+struct evl_barrier_state {
+	__u32 generation;
+	__u32 arrived;
+};
+
+struct evl_barrier_waitreq {
+	__u64 timeout_ptr;	/* (struct __evl_timespec __user *timeout) */
+};
+
+/* Returned by EVL_BARIOC_WAIT to the last arrival. */
+#define EVL_BARRIER_SERIAL	1
+
+#define EVL_BARRIER_IOCBASE	'b'
+
+#define EVL_BARIOC_WAIT		_IOW(EVL_BARRIER_IOCBASE, 0, struct evl_barrier_waitreq)
+
+#endif /* !_EVL_UAPI_BARRIER_ABI_H */
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_BLACKBOARD_ABI_H
+#define _EVL_UAPI_BLACKBOARD_ABI_H
+
+#include <linux/types.h>
+
+#define EVL_BLACKBOARD_DEV		"blackboard"
+
+#define EVL_BLACKBOARD_MAX_BUFFERS	8
+#define EVL_BLACKBOARD_MAX_SIZE		(16 * 1024 * 1024)
+
+struct evl_blackboard_attrs {
+	__u32 clockfd;
+	__u32 size;		/* Bytes per buffer. */
+	__u32 nr_buffers;	/* 2 to EVL_BLACKBOARD_MAX_BUFFERS. */
+	__u32 __pad;
+};
+
+/*
+ * A blackboard holds the latest version of a state block, in a set
+ * of nr_buffers rotating buffers which the processes sharing it map
+ * by mmap(2)ing the element fd: this header comes first, buffer #n
+ * starts at data_offset + n * stride. There is a single writer at
+ * any point in time, serializing with other writers is up to the
+ * application. Publishing and reading never enter the kernel:
+ *
+ * - the writer picks buffer #n = (latest + 1) % nr_buffers, bumps
+ *   seq[n] to an odd value, issues a write barrier, fills the
+ *   buffer, issues a write barrier again, bumps seq[n] to the next
+ *   even value, then releases latest = n and version + 1.
+ *
+ * - readers acquire latest, then acquire seq[latest], retrying if
+ *   odd. They read the buffer in place, issue a read barrier, then
+ *   retry from the beginning if seq[latest] changed meanwhile.
+ *
+ * A reader may only have to retry if the writer published
+ * nr_buffers - 1 new versions while it was reading.
+ *
+ * Threads may wait for new versions from the oob stage with
+ * EVL_BBIOC_WAIT, or evl_poll() the element fd for POLLIN. Both are
+ * woken up by EVL_BBIOC_NOTIFY, which the writer issues once it has
+ * published, if it expects waiters. Polling is edge-triggered: it
+ * only reports notifications happening while the poller waits.
+ */
+struct evl_blackboard_state {
+	__u32 version;		/* atomic */
+	__u32 latest;		/* atomic */
+	__u32 nr_buffers;
+	__u32 size;
+	__u32 stride;
+	__u32 data_offset;
+	__u32 seq[EVL_BLACKBOARD_MAX_BUFFERS];	/* atomic */
+};
+
+struct evl_blackboard_waitreq {
+	__u64 timeout_ptr;	/* (struct __evl_timespec __user *timeout) */
+	__u32 version;		/* in: last seen, out: current */
+	__u32 __pad;
+};
+
+#define EVL_BLACKBOARD_IOCBASE	'B'
+
+#define EVL_BBIOC_NOTIFY	_IO(EVL_BLACKBOARD_IOCBASE, 0)
+#define EVL_BBIOC_WAIT		_IOWR(EVL_BLACKBOARD_IOCBASE, 1, struct evl_blackboard_waitreq)
+
+#endif /* !_EVL_UAPI_BLACKBOARD_ABI_H */
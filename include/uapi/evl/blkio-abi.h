@@ -0,0 +1,64 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_BLKIO_ABI_H
+#define _EVL_UAPI_BLKIO_ABI_H
+
+#include <linux/types.h>
+
+#define EVL_BLKIO_DEV		"blkio"
+
+/*
+ * Raw block I/O from the out-of-band stage. A channel is bound to a
+ * sector range of a queue some block driver reserved for oob use,
+ * e.g. a dedicated NVMe submission/completion queue pair. Requests
+ * are submitted to the hardware directly from the caller's context,
+ * completions are reaped by busy polling the queue, there is no page
+ * cache and no interrupt involved. I/O buffers must have been pinned
+ * beforehand (EVL_CTLIOC_PIN_UBUF).
+ */
+
+#define EVL_BLKIO_NAMELEN	32
+
+struct evl_blkio_bindreq {
+	char name[EVL_BLKIO_NAMELEN];	/* Queue name */
+	__u64 start;		/* First sector of the range */
+	__u64 nr_sectors;	/* Length of the range */
+	__u32 sector_size;	/* (out) */
+	__u32 depth;		/* (out) max. requests in flight */
+};
+
+#define EVL_BLKIO_READ		0
+#define EVL_BLKIO_WRITE		1
+#define EVL_BLKIO_FLUSH		2
+
+struct evl_blkio_sqe {
+	__u64 buf_ptr;		/* In some pinned user buffer */
+	__u64 sector;		/* Relative to the bound range */
+	__u32 nr_sectors;
+	__u32 op;		/* EVL_BLKIO_* */
+	__u64 cookie;		/* Passed back on completion */
+};
+
+struct evl_blkio_cqe {
+	__u64 cookie;
+	__s32 status;		/* 0 or -errno */
+	__u32 __pad;
+};
+
+struct evl_blkio_pollreq {
+	__u64 cqes_ptr;		/* struct evl_blkio_cqe[nr] */
+	__u32 nr;
+	__u32 __pad;
+	/* Max. busy wait for a first completion, zero for a single pass. */
+	__u64 spin_ns;
+};
+
+#define EVL_BLKIO_IOCBASE	'k'
+
+#define EVL_BLKIOC_BIND		_IOWR(EVL_BLKIO_IOCBASE, 0, struct evl_blkio_bindreq)
+#define EVL_BLKIOC_SUBMIT	_IOW(EVL_BLKIO_IOCBASE, 1, struct evl_blkio_sqe)
+#define EVL_BLKIOC_POLL		_IOW(EVL_BLKIO_IOCBASE, 2, struct evl_blkio_pollreq)
+
+#endif /* !_EVL_UAPI_BLKIO_ABI_H */
@@ -23,6 +23,29 @@
 #define EVL_CLKIOC_GET_TIME	_IOR(EVL_CLOCK_IOCBASE, 2, struct __evl_timespec)
 #define EVL_CLKIOC_SET_TIME	_IOW(EVL_CLOCK_IOCBASE, 3, struct __evl_timespec)
 #define EVL_CLKIOC_NEW_TIMER	_IO(EVL_CLOCK_IOCBASE, 5)
+#define EVL_CLKIOC_GET_STATE	_IOR(EVL_CLOCK_IOCBASE, 6, __u32)
+
+/*
+ * Conversion parameters published in the shared heap for each
+ * clock, so that user code may read the time from any clock based
+ * on the monotonic clock, without issuing any syscall:
+ *
+ *     t = base + (((CLOCK_MONOTONIC - mono_ref) * mult) >> shift)
+ *
+ * @seq is odd while an update is in progress, readers should retry
+ * until they read the same even value before and after fetching
+ * the parameters. A zero @mult means that the clock does not derive
+ * from the monotonic clock, in which case EVL_CLKIOC_GET_TIME has to
+ * be used instead. EVL_CLKIOC_GET_STATE returns the offset of this
+ * descriptor into the shared heap.
+ */
+struct evl_clock_state {
+	__u32 seq;
+	__u32 shift;
+	__u64 mult;
+	__s64 mono_ref;
+	__s64 base;
+};
 
 struct evl_timerfd_setreq {
 	__u64 value_ptr;       /* (struct __evl_itimerspec __user *value) */
@@ -33,5 +56,7 @@ struct evl_timerfd_setreq {
 
 #define EVL_TFDIOC_SET	 _IOWR(EVL_TIMERFD_IOCBASE, 0, struct evl_timerfd_setreq)
 #define EVL_TFDIOC_GET	 _IOR(EVL_TIMERFD_IOCBASE, 1, struct __evl_itimerspec)
+#define EVL_TFDIOC_SET_SLACK	_IOW(EVL_TIMERFD_IOCBASE, 2, struct __evl_timespec)
+#define EVL_TFDIOC_GET_SLACK	_IOR(EVL_TIMERFD_IOCBASE, 3, struct __evl_timespec)
 
 #endif /* !_EVL_UAPI_CLOCK_ABI_H */
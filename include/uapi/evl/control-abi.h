@@ -10,14 +10,14 @@
 #include <linux/types.h>
 
 /* Earliest ABI level we support. */
-#define EVL_ABI_BASE   36
+#define EVL_ABI_BASE   38
 /*
  * Current/latest ABI level we support. We may decouple the base and
  * current ABI levels by providing backward compatibility from the
  * latter to the former. CAUTION: a litteral value is required for the
  * current ABI definition (scripts reading this may be naive).
  */
-#define EVL_ABI_LEVEL  37
+#define EVL_ABI_LEVEL  38
 
 #define EVL_CONTROL_DEV  "/dev/evl/control"
 
@@ -33,10 +33,107 @@ struct evl_cpu_state {
 	__u64 state_ptr;	/* (__u32 __user *state) */
 };
 
+/* Core heaps, for EVL_CTLIOC_GET_HEAPSTATS. */
+#define EVL_HEAP_SYSTEM		0
+#define EVL_HEAP_SHARED		1
+#define EVL_HEAP_PRIVATE	2	/* Caller's own */
+/* Buckets of small blocks, from 16 to 256 bytes. */
+#define EVL_HEAP_NR_BUCKETS	5
+
+struct evl_heap_stats {
+	__u32 heap;
+	__u32 frag;		/* per mille */
+	__u64 usable_size;
+	__u64 used_size;
+	__u64 peak_used;
+	__u64 largest_free;
+	/* Busy blocks per bucket, then count of multi-page blocks. */
+	__u64 nr_busy[EVL_HEAP_NR_BUCKETS + 1];
+};
+
+/*
+ * Thread statistics area, mapped by mmap() on the control device at
+ * EVL_STATMAP_OFFSET. Each thread owns the slot matching its minor
+ * device number while it exists, unused slots have a null fundle.
+ * Slots are updated in place when their thread switches out, readers
+ * should retry while the sequence count is odd, or changed across
+ * the read.
+ */
+#define EVL_STATMAP_OFFSET	0x40000000
+#define EVL_STATSLOT_NAMELEN	32
+
+struct evl_thread_statslot {
+	__u32 seq;
+	__u32 fundle;
+	__s32 pid;
+	__u32 cpu;
+	__u32 state;
+	__u32 __pad;
+	__u64 isw;
+	__u64 csw;
+	__u64 sc;
+	__u64 rwa;
+	__u64 xtime;		/* ns */
+	__u64 runlat_count;
+	__u64 runlat_max_ns;
+	char name[EVL_STATSLOT_NAMELEN];
+	__u64 __reserved[2];
+};
+
+struct evl_statmap_info {
+	__u32 nr_slots;
+	__u32 slot_size;
+	__u64 size;		/* Length to map */
+};
+
+/*
+ * User buffer to pin for zero-copy I/O, for EVL_CTLIOC_PIN_UBUF and
+ * EVL_CTLIOC_UNPIN_UBUF. The latter only looks at addr.
+ */
+struct evl_ubuf_req {
+	__u64 addr;
+	__u64 len;
+};
+
+/*
+ * Set of threads to suspend or resume at once, for
+ * EVL_CTLIOC_HOLD_SET and EVL_CTLIOC_RELEASE_SET. fundles_ptr refers
+ * to an array of nr_threads thread handles, all belonging to the
+ * caller's process, excluding the caller. Either all of them are
+ * processed, or none is.
+ */
+#define EVL_THREAD_SET_MAX	256
+
+struct evl_thread_set_req {
+	__u64 fundles_ptr;	/* __u32[nr_threads] */
+	__u32 nr_threads;
+	__u32 __pad;
+};
+
+/*
+ * Size of the private heap to set up for the caller's process, for
+ * EVL_CTLIOC_SET_PRIVHEAP. Once mapped, this heap holds the state of
+ * the threads and non-public elements the process creates. It is
+ * mapped along with the shared heap, by a single shared mmap() on
+ * the control device covering shm_size + size bytes, the private
+ * heap starting at offset shm_size. State offsets are relative to
+ * the base of this mapping in all cases.
+ */
+struct evl_privheap_req {
+	__u64 size;
+};
+
 #define EVL_CONTROL_IOCBASE	'C'
 
 #define EVL_CTLIOC_GET_COREINFO		_IOR(EVL_CONTROL_IOCBASE, 0, struct evl_core_info)
 #define EVL_CTLIOC_SCHEDCTL		_IOWR(EVL_CONTROL_IOCBASE, 1, struct evl_sched_ctlreq)
 #define EVL_CTLIOC_GET_CPUSTATE		_IOR(EVL_CONTROL_IOCBASE, 2, struct evl_cpu_state)
+#define EVL_CTLIOC_GET_HEAPSTATS	_IOWR(EVL_CONTROL_IOCBASE, 3, struct evl_heap_stats)
+#define EVL_CTLIOC_GET_STATMAP		_IOR(EVL_CONTROL_IOCBASE, 4, struct evl_statmap_info)
+#define EVL_CTLIOC_PIN_UBUF		_IOW(EVL_CONTROL_IOCBASE, 5, struct evl_ubuf_req)
+#define EVL_CTLIOC_UNPIN_UBUF		_IOW(EVL_CONTROL_IOCBASE, 6, struct evl_ubuf_req)
+#define EVL_CTLIOC_HOLD_SET		_IOW(EVL_CONTROL_IOCBASE, 7, struct evl_thread_set_req)
+#define EVL_CTLIOC_RELEASE_SET		_IOW(EVL_CONTROL_IOCBASE, 8, struct evl_thread_set_req)
+#define EVL_CTLIOC_SET_PRIVHEAP		_IOW(EVL_CONTROL_IOCBASE, 9, struct evl_privheap_req)
 
 #endif /* !_EVL_UAPI_CONTROL_ABI_H */
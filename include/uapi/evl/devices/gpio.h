@@ -5,6 +5,65 @@
 #ifndef _EVL_UAPI_DEVICES_GPIO_H
 #define _EVL_UAPI_DEVICES_GPIO_H
 
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
 #define GPIOHANDLE_REQUEST_OOB		(1UL << 5)
 
+/*
+ * Pulse generator for oob output line handles. Edges are played by
+ * an EVL timer, from a ring shared with user space by mmap(2)ing the
+ * line handle once GPIOHANDLE_SETUP_PULSE_IOCTL has sized it. The
+ * producer advances @head after filling edges, the kernel advances
+ * @tail as it plays them. Both indices are free-running, modulo
+ * @nr_edges which is a power of two.
+ */
+struct gpiohandle_pulse_edge {
+	/* Delay from the previous edge, or from the start date. */
+	__u64 delay_ns;
+	/* Bit #n gives the value of line #n of the handle. */
+	__u64 values;
+};
+
+struct gpiohandle_pulse_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 nr_edges;
+	__u32 status;
+	struct gpiohandle_pulse_edge edges[];
+};
+
+/* gpiohandle_pulse_ring.status */
+#define GPIOHANDLE_PULSE_RUNNING	(1U << 0)
+#define GPIOHANDLE_PULSE_UNDERRUN	(1U << 1)
+
+struct gpiohandle_pulse_setup {
+	__u32 nr_edges;
+	__u32 __pad;
+};
+
+/* gpiohandle_pulse_start.mode */
+#define GPIOHANDLE_PULSE_EDGES		0 /* Play the ring. */
+#define GPIOHANDLE_PULSE_RAMP		1 /* Generate a frequency ramp. */
+
+struct gpiohandle_pulse_start {
+	/* Absolute date on the EVL monotonic clock, zero for now. */
+	__u64 start_ns;
+	__u32 mode;
+	__u32 __pad;
+	/* GPIOHANDLE_PULSE_RAMP only. */
+	struct {
+		/* Lines to pulse, others keep their value. */
+		__u64 line_mask;
+		/* Period of the first and last pulse. */
+		__u64 start_period_ns;
+		__u64 end_period_ns;
+		__u64 nr_pulses;
+	} ramp;
+};
+
+#define GPIOHANDLE_SETUP_PULSE_IOCTL	_IOW(0xB4, 0x40, struct gpiohandle_pulse_setup)
+#define GPIOHANDLE_START_PULSE_IOCTL	_IOW(0xB4, 0x41, struct gpiohandle_pulse_start)
+#define GPIOHANDLE_STOP_PULSE_IOCTL	_IO(0xB4, 0x42)
+
 #endif /* !_EVL_UAPI_DEVICES_GPIO_H */
@@ -30,6 +30,69 @@ struct hectic_error {
 	unsigned int fp_val;
 };
 
+/* oob -> oob switch times, when timing is enabled. */
+struct hectic_switch_timing {
+	__u64 total_ns;
+	__u64 max_ns;
+	__u64 count;
+};
+
+/*
+ * Benchmark modes for EVL_HECIOC_RUN_BENCH, issued from the
+ * out-of-band stage by an EVL thread:
+ *
+ * HECTIC_BENCH_STAGE: the caller switches from the oob stage to the
+ * in-band stage then back, count times.
+ *
+ * HECTIC_BENCH_XCPU: the caller wakes up a kernel thread pinned to
+ * the CPU set by EVL_HECIOC_SETUP_BENCH, waiting for it to resume
+ * each time, count times.
+ *
+ * In addition, EVL_HECIOC_SYSCALL_PROBE measures the oob syscall
+ * entry and exit paths, from the dates read by the caller on the EVL
+ * monotonic clock before issuing the request, and after the previous
+ * one returned.
+ */
+#define HECTIC_BENCH_STAGE	0
+#define HECTIC_BENCH_XCPU	1
+
+struct hectic_bench_req {
+	__u32 mode;
+	__u32 cpu;		/* HECTIC_BENCH_XCPU only */
+	__u32 count;
+	__u32 __pad;
+};
+
+struct hectic_syscall_probe {
+	__u64 entry_date;
+	__u64 prev_return_date;	/* zero on first call */
+};
+
+/* Histograms collected by the benchmarks. */
+#define HECTIC_HIST_TO_INBAND		0
+#define HECTIC_HIST_TO_OOB		1
+#define HECTIC_HIST_SYSCALL_ENTRY	2
+#define HECTIC_HIST_SYSCALL_EXIT	3
+#define HECTIC_HIST_XCPU_WAKEUP		4
+#define HECTIC_HIST_NR			5
+
+/*
+ * Bucket 0 counts null durations, bucket n > 0 counts durations in
+ * the [2^(n-1), 2^n) nanosecond range, the last one accumulates any
+ * longer duration.
+ */
+#define HECTIC_HIST_BUCKETS	32
+
+struct hectic_bench_hist {
+	__u32 kind;		/* HECTIC_HIST_*, set by the caller */
+	__u32 __pad;
+	__u64 count;
+	__u64 total_ns;
+	__u64 min_ns;
+	__u64 max_ns;
+	__u64 buckets[HECTIC_HIST_BUCKETS];
+};
+
 #define EVL_HECTIC_IOCBASE	'H'
 
 #define EVL_HECIOC_SET_TASKS_COUNT	_IOW(EVL_HECTIC_IOCBASE, 0, __u32)
@@ -43,5 +106,12 @@ struct hectic_error {
 #define EVL_HECIOC_SET_PAUSE 		_IOW(EVL_HECTIC_IOCBASE, 8, __u32)
 #define EVL_HECIOC_LOCK_STAX 		_IO(EVL_HECTIC_IOCBASE, 9)
 #define EVL_HECIOC_UNLOCK_STAX 		_IO(EVL_HECTIC_IOCBASE, 10)
+#define EVL_HECIOC_SET_TIMING 		_IOW(EVL_HECTIC_IOCBASE, 11, __u32)
+#define EVL_HECIOC_GET_TIMING 		_IOR(EVL_HECTIC_IOCBASE, 12, struct hectic_switch_timing)
+#define EVL_HECIOC_SETUP_BENCH 		_IOW(EVL_HECTIC_IOCBASE, 13, struct hectic_bench_req)
+#define EVL_HECIOC_RUN_BENCH 		_IOW(EVL_HECTIC_IOCBASE, 14, struct hectic_bench_req)
+#define EVL_HECIOC_SYSCALL_PROBE 	_IOW(EVL_HECTIC_IOCBASE, 15, struct hectic_syscall_probe)
+#define EVL_HECIOC_GET_BENCH 		_IOWR(EVL_HECTIC_IOCBASE, 16, struct hectic_bench_hist)
+#define EVL_HECIOC_RESET_BENCH 		_IO(EVL_HECTIC_IOCBASE, 17)
 
 #endif /* !_EVL_UAPI_DEVICES_HECTIC_H */
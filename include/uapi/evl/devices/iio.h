@@ -0,0 +1,31 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_DEVICES_IIO_H
+#define _EVL_UAPI_DEVICES_IIO_H
+
+#include <linux/types.h>
+
+/*
+ * Layout of the capture ring of an oob IIO buffer, as obtained by
+ * mmap(2)ing the buffer fd read-only. Block #seq lives at
+ * @data_offset + (seq & (@nr_blocks - 1)) * @block_size from the
+ * start of the mapping, and was captured at timestamps[seq &
+ * (@nr_blocks - 1)] on the EVL monotonic clock. @head counts the
+ * blocks captured so far, block #head being the one which may be
+ * in flight. A reader copying block #seq should re-read @head
+ * afterwards, the copy is valid only if @head - seq < @nr_blocks.
+ */
+struct iio_oob_ring {
+	__u32 head;
+	__u32 nr_blocks;
+	__u32 block_size;
+	__u32 data_offset;
+	/* Blocks read(2) could not deliver in time. */
+	__u32 overruns;
+	__u32 __pad;
+	__u64 timestamps[];
+};
+
+#endif /* !_EVL_UAPI_DEVICES_IIO_H */
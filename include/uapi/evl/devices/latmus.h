@@ -15,7 +15,10 @@
 #define EVL_LAT_KERN  1
 #define EVL_LAT_USER  2
 #define EVL_LAT_SIRQ  3
-#define EVL_LAT_LAST  EVL_LAT_SIRQ
+#define EVL_LAT_NET_RX  4
+#define EVL_LAT_NET_RTT 5
+#define EVL_LAT_HWLAT   6
+#define EVL_LAT_LAST  EVL_LAT_HWLAT
 
 struct latmus_setup {
 	__u32 type;
@@ -45,6 +48,40 @@ struct latmus_measurement {
 	__u32 samples;
 };
 
+/*
+ * EVL_LAT_NET_* runners pulse a user thread like EVL_LAT_USER does,
+ * which sends a frame to some peer echoing it back through the
+ * out-of-band network stack, then reports the sample below with
+ * EVL_LATIOC_NETPULSE. All dates are read from the EVL monotonic
+ * clock. The ingress date is the timestamp field of the received
+ * message. EVL_LAT_NET_RX measures ingress to thread wakeup latency,
+ * EVL_LAT_NET_RTT the full round trip. A zero sent date reports
+ * nothing, only waiting for the next pulse.
+ */
+struct latmus_net_sample {
+	__u64 sent;
+	__u64 ingress;
+	__u64 received;
+};
+
+/*
+ * The EVL_LAT_HWLAT runner spins with hard irqs off on the target
+ * CPU for half of each period, reading the EVL monotonic clock back
+ * to back. Since nothing but the hardware or firmware may preempt
+ * it (SMIs, memory refresh, hypervisor exits), any interval between
+ * two consecutive readings which exceeds the threshold given by the
+ * latmus.hwlat_threshold parameter (ns, 10 us by default) is
+ * sent as the record below through the xbuf channel. The results of
+ * EVL_LATIOC_RUN sum up all gaps seen: min_lat, max_lat and sum_lat
+ * apply to the gap durations in nanoseconds, samples counts the
+ * gaps, overruns the sampling periods missed.
+ */
+struct latmus_hwlat_gap {
+	__u64 date;		/* EVL monotonic clock at gap start */
+	__u32 gap;		/* ns */
+	__u32 __pad;
+};
+
 struct latmus_measurement_result {
 	__u64 last_ptr;		/* (struct latmus_measurement __user *last) */
 	__u64 histogram_ptr;	/* (__s32 __user *histogram) */
@@ -56,6 +93,93 @@ struct latmus_result {
 	__u32 len;
 };
 
+/*
+ * Multi-CPU measurement: one runner of the given type (EVL_LAT_IRQ or
+ * EVL_LAT_KERN) is started on each CPU of the set, all of them
+ * aligned on the same start time. Latencies are accumulated into
+ * per-CPU histograms of hcells cells, cell_ns wide each, from which
+ * the percentiles are computed in kernel space at the end of each
+ * run. The last cell collects all samples beyond the histogram
+ * range; percentiles falling into it are reported as max_lat.
+ */
+struct latmus_multi_setup {
+	__u32 type;
+	__s32 priority;
+	__u64 period;
+	__u64 cpu_set_ptr;	/* (const cpu_set_t __user *cpu_set) */
+	__u32 cpu_set_len;
+	__u32 hcells;
+	__u32 cell_ns;
+	__u32 __pad;
+};
+
+struct latmus_cpu_result {
+	__s64 sum_lat;
+	__u64 samples;
+	__s32 min_lat;
+	__s32 max_lat;
+	__s32 p50_lat;
+	__s32 p99_lat;
+	__s32 p999_lat;		/* 99.9th percentile */
+	__s32 p9999_lat;	/* 99.99th percentile */
+	__u32 overruns;
+	__u32 cpu;
+};
+
+/*
+ * Passed to EVL_LATIOC_RUN via latmus_result.data_ptr after
+ * EVL_LATIOC_MEASURE_MULTI. The run lasts for duration nanoseconds
+ * after the warmup period, or until the caller is interrupted if
+ * zero. nr_results is the room available in the result array on
+ * input, and the number of results written on output.
+ */
+struct latmus_multi_result {
+	__u64 results_ptr;	/* (struct latmus_cpu_result __user *results) */
+	__u64 duration;
+	__u32 nr_results;
+	__u32 __pad;
+};
+
+/*
+ * In-kernel stressors run by in-band threads pinned to each CPU of
+ * the set (in-band CPUs, or oob CPUs where they compete with the
+ * in-band stage only), on behalf of the file which started them,
+ * until stopped or the file is closed. They are independent from
+ * the measurement, so that the same load can be set for any runner.
+ *
+ * intensity (1-100) is the share of each 10 ms window the stressor
+ * threads are busy; it also scales the rate of the timer interrupts
+ * in EVL_LAT_STRESS_IRQ mode, from 1 kHz up to 100 kHz per CPU.
+ * footprint is the size of the buffer thrashed by the memory
+ * stressors on each CPU, in KiB. An empty CPU set means all online
+ * CPUs. A zero stressor mask stops the stressors.
+ */
+#define EVL_LAT_STRESS_CACHE	(1 << 0) /* Cache line thrashing */
+#define EVL_LAT_STRESS_MEMBW	(1 << 1) /* Memory bandwidth saturation */
+#define EVL_LAT_STRESS_TLB	(1 << 2) /* Page-strided accesses */
+#define EVL_LAT_STRESS_IPI	(1 << 3) /* Cross-CPU function calls */
+#define EVL_LAT_STRESS_IRQ	(1 << 4) /* High-rate timer interrupts */
+#define EVL_LAT_STRESS_NR	5
+
+struct latmus_stress_setup {
+	__u32 mask;		/* EVL_LAT_STRESS_* */
+	__u32 intensity;
+	__u64 cpu_set_ptr;	/* (const cpu_set_t __user *cpu_set) */
+	__u32 cpu_set_len;
+	__u32 footprint;	/* KiB per CPU, 0 for the default (8 MiB) */
+};
+
+/*
+ * The active stressor setup, for recording along with the results,
+ * and the work units each kind of stressor went through so far.
+ */
+struct latmus_stress_status {
+	struct latmus_stress_setup setup;
+	__u64 rounds[EVL_LAT_STRESS_NR];
+	__u32 nr_cpus;
+	__u32 __pad;
+};
+
 #define EVL_LATMUS_IOCBASE	'L'
 
 #define EVL_LATIOC_TUNE		_IOWR(EVL_LATMUS_IOCBASE, 0, struct latmus_setup)
@@ -63,5 +187,9 @@ struct latmus_result {
 #define EVL_LATIOC_RUN		_IOR(EVL_LATMUS_IOCBASE, 2, struct latmus_result)
 #define EVL_LATIOC_PULSE	_IOW(EVL_LATMUS_IOCBASE, 3, __u64)
 #define EVL_LATIOC_RESET	_IO(EVL_LATMUS_IOCBASE, 4)
+#define EVL_LATIOC_MEASURE_MULTI	_IOW(EVL_LATMUS_IOCBASE, 5, struct latmus_multi_setup)
+#define EVL_LATIOC_NETPULSE	_IOW(EVL_LATMUS_IOCBASE, 6, struct latmus_net_sample)
+#define EVL_LATIOC_STRESS	_IOW(EVL_LATMUS_IOCBASE, 7, struct latmus_stress_setup)
+#define EVL_LATIOC_GETSTRESS	_IOR(EVL_LATMUS_IOCBASE, 8, struct latmus_stress_status)
 
 #endif /* !_EVL_UAPI_DEVICES_LATMUS_H */
@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_DEVICES_PCM_H
+#define _EVL_UAPI_DEVICES_PCM_H
+
+#include <linux/types.h>
+
+/*
+ * Out-of-band PCM streams (e.g. /dev/pcm-i2s0-tx-oob) run a cyclic
+ * DMA transfer over a ring of nr_periods periods, which applications
+ * access by mmap(2)ing the device. Period interrupts are handled from
+ * the oob stage: each oob_read() call waits for the next period
+ * boundary, then returns an evl_pcm_status. At that point, the DMA
+ * is transferring period #(period_count % nr_periods), any other
+ * period may be safely filled (playback) or consumed (capture).
+ */
+
+#define EVL_PCM_PLAYBACK	0
+#define EVL_PCM_CAPTURE		1
+
+struct evl_pcm_info {
+	__u32 period_bytes;
+	__u32 nr_periods;
+	__u32 direction;	/* EVL_PCM_* */
+	__u32 __pad;
+};
+
+struct evl_pcm_status {
+	/* Periods elapsed since the stream was started. */
+	__u64 period_count;
+	/* Date of the last period boundary on the EVL monotonic clock. */
+	__u64 timestamp;
+	/* Period boundaries the caller missed since its previous read. */
+	__u32 missed;
+	__u32 __pad;
+};
+
+#define EVL_PCM_IOCBASE		'p'
+
+#define EVL_PCMIOC_GET_INFO	_IOR(EVL_PCM_IOCBASE, 0, struct evl_pcm_info)
+#define EVL_PCMIOC_START	_IO(EVL_PCM_IOCBASE, 1)
+#define EVL_PCMIOC_STOP		_IO(EVL_PCM_IOCBASE, 2)
+
+#endif /* !_EVL_UAPI_DEVICES_PCM_H */
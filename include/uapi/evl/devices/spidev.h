@@ -19,8 +19,39 @@ struct spi_ioc_oob_setup {
 	__u32 rx_offset;
 };
 
+/*
+ * Manage out-of-band mode with a queue of frames (master only). Each
+ * SPI_IOC_RUN_OOB_XFER request runs the whole queue, frames being
+ * sent back-to-back in array order. The data of each frame lives at
+ * its offset from the TX and RX areas of the I/O buffer.
+ */
+#define SPI_OOB_MAX_FRAMES	64
+
+struct spi_ioc_oob_frame {
+	/* Input */
+	__u32 len;
+	__u32 speed_hz;
+	__u8 chip_select;
+	__u8 __pad[3];
+	/* Output */
+	__u32 offset;
+	__u32 effective_speed_hz;
+};
+
+struct spi_ioc_oob_queue {
+	/* Input */
+	__u64 frames_ptr;	/* (struct spi_ioc_oob_frame __user *frames) */
+	__u32 nr_frames;
+	__u8 bits_per_word;
+	/* Output */
+	__u32 iobuf_len;
+	__u32 tx_offset;
+	__u32 rx_offset;
+};
+
 #define SPI_IOC_ENABLE_OOB_MODE		_IOWR(SPI_IOC_MAGIC, 50, struct spi_ioc_oob_setup)
 #define SPI_IOC_DISABLE_OOB_MODE	_IO(SPI_IOC_MAGIC, 51)
 #define SPI_IOC_RUN_OOB_XFER		_IO(SPI_IOC_MAGIC, 52)
+#define SPI_IOC_ENABLE_OOB_QUEUE	_IOWR(SPI_IOC_MAGIC, 53, struct spi_ioc_oob_queue)
 
 #endif /* _EVL_UAPI_DEVICES_SPIDEV_H */
@@ -0,0 +1,64 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_DEVICES_UART_H
+#define _EVL_UAPI_DEVICES_UART_H
+
+#include <linux/types.h>
+
+/*
+ * Out-of-band UART devices (e.g. /dev/ttyAMA0-oob) give exclusive
+ * access to a serial port from the oob stage, through oob_read(),
+ * oob_write() and evl_poll(). The port cannot be used as a tty while
+ * its oob device is open, and conversely.
+ *
+ * If frame_gap_ns is zero, oob_read() returns as soon as some data is
+ * available. Otherwise, received bytes are grouped into frames
+ * separated by line silences of at least frame_gap_ns, and each
+ * oob_read() call returns a single complete frame, the part which
+ * does not fit into the user buffer being dropped.
+ */
+
+#define EVL_UART_PARITY_NONE	0
+#define EVL_UART_PARITY_ODD	1
+#define EVL_UART_PARITY_EVEN	2
+
+/* Hardware flow control. */
+#define EVL_UART_CRTSCTS	(1 << 0)
+
+struct evl_uart_config {
+	__u32 baud;
+	__u8 data_bits;		/* 5-8 */
+	__u8 stop_bits;		/* 1-2 */
+	__u8 parity;		/* EVL_UART_PARITY_* */
+	__u8 flags;		/* EVL_UART_* */
+	/*
+	 * FIFO interrupt trigger levels in eighths of the FIFO depth,
+	 * among 1, 2, 4, 6 and 7. Lower RX levels reduce the latency
+	 * of the frame gap detector, higher ones the interrupt rate.
+	 */
+	__u8 rx_fifo_level;
+	__u8 tx_fifo_level;
+	__u16 __pad;
+	__u64 frame_gap_ns;
+};
+
+struct evl_uart_stats {
+	__u64 rx_bytes;
+	__u64 tx_bytes;
+	__u32 rx_frames;
+	__u32 rx_overruns;	/* RX ring full */
+	__u32 hw_overruns;	/* RX FIFO full */
+	__u32 framing_errors;
+	__u32 parity_errors;
+	__u32 breaks;
+};
+
+#define EVL_UART_IOCBASE	'u'
+
+#define EVL_UARTIOC_SET_CONFIG	_IOW(EVL_UART_IOCBASE, 0, struct evl_uart_config)
+#define EVL_UARTIOC_GET_CONFIG	_IOR(EVL_UART_IOCBASE, 1, struct evl_uart_config)
+#define EVL_UARTIOC_GET_STATS	_IOR(EVL_UART_IOCBASE, 2, struct evl_uart_stats)
+
+#endif /* !_EVL_UAPI_DEVICES_UART_H */
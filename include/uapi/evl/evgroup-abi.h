@@ -0,0 +1,63 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_EVGROUP_ABI_H
+#define _EVL_UAPI_EVGROUP_ABI_H
+
+#include <linux/types.h>
+
+#define EVL_EVGROUP_DEV		"evgroup"
+
+struct evl_evgroup_attrs {
+	__u32 clockfd;
+	__u32 width;	/* 32 or 64 event bits. */
+	__u64 initval;
+};
+
+/*
+ * An event group lives in the shared heap, mapped by every EVL
+ * process. value holds the event bits, of which only the lower
+ * width bits are valid. User-space may manipulate them directly:
+ *
+ * - testing bits is a plain atomic read.
+ *
+ * - clearing bits is an atomic AND with the complement of the mask,
+ *   which never involves the kernel.
+ *
+ * - setting bits is an atomic OR. The caller reloads waiters past a
+ *   full memory barrier, issuing EVL_EVGIOC_POST with a zero mask
+ *   if non-zero, so that sleepers evaluate the new value.
+ *
+ * - waiting for bits starts with checking the condition against
+ *   value, consuming the matching bits by a compare-and-exchange
+ *   loop if EVL_EVGROUP_CLEAR is set. If the condition is not met,
+ *   the caller issues EVL_EVGIOC_WAIT, which counts it in waiters
+ *   then sleeps until some update satisfies the condition, doing
+ *   the same atomically with respect to other waiters.
+ */
+struct evl_evgroup_state {
+	__u64 value;		/* atomic */
+	__u32 waiters;		/* atomic */
+	__u32 width;
+};
+
+/* Wait modes. */
+#define EVL_EVGROUP_ANY		0x0 /* Any bit from the mask. */
+#define EVL_EVGROUP_ALL		0x1 /* All bits from the mask. */
+#define EVL_EVGROUP_CLEAR	0x2 /* Consume the matching bits. */
+
+struct evl_evgroup_waitreq {
+	__u64 timeout_ptr;	/* (struct __evl_timespec __user *timeout) */
+	__u64 mask;
+	__u32 mode;
+	__u32 __pad;
+	__u64 value;		/* Group value when the condition was met. */
+};
+
+#define EVL_EVGROUP_IOCBASE	'g'
+
+#define EVL_EVGIOC_WAIT		_IOWR(EVL_EVGROUP_IOCBASE, 0, struct evl_evgroup_waitreq)
+#define EVL_EVGIOC_POST		_IOW(EVL_EVGROUP_IOCBASE, 1, __u64)
+
+#endif /* !_EVL_UAPI_EVGROUP_ABI_H */
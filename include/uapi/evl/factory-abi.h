@@ -25,6 +25,9 @@ struct evl_element_ids {
 #define EVL_CLONE_UNICAST	(1 << 19)
 #define EVL_CLONE_INPUT		(1 << 20)
 #define EVL_CLONE_OUTPUT	(1 << 21)
+#define EVL_CLONE_LOSSY		(1 << 22)
+/* Private element, publish to sysfs asynchronously. */
+#define EVL_CLONE_DEFERRED	(1 << 23)
 #define EVL_CLONE_COREDEV	(1 << 31)
 #define EVL_CLONE_MASK		(((__u32)-1 << 16) & ~EVL_CLONE_COREDEV)
 /*
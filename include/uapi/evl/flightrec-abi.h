@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_FLIGHTREC_ABI_H
+#define _EVL_UAPI_FLIGHTREC_ABI_H
+
+#include <linux/types.h>
+
+/*
+ * The flight recorder logs core events into per-CPU rings of
+ * fixed-size records, which /dev/evl/flightrec maps read-only to
+ * user space. The mapping is a sequence of evl_flightrec_info.nr_cpus
+ * areas of area_size bytes, one per possible CPU, each starting with
+ * a ring header immediately followed by nr_records records.
+ *
+ * A record lives at index (seq & (nr_records - 1)), the writer
+ * publishes it by incrementing head, overwriting the oldest one when
+ * the ring is full. Readers should re-check head after copying
+ * records out, discarding those which might have been overwritten
+ * meanwhile. All rings stop recording once frozen, either upon
+ * request, or when the trigger condition is met.
+ */
+
+#define EVL_FLTREC_SWITCH	0 /* pid=prev, arg[0]=next pid, arg[1]=prev state */
+#define EVL_FLTREC_WAKEUP	1 /* pid=thread, arg[0]=mask, arg[1]=info */
+#define EVL_FLTREC_TIMER	2 /* arg[0]=lateness (ns) */
+#define EVL_FLTREC_SYSENTRY	3 /* pid=caller, arg[0]=syscall number */
+#define EVL_FLTREC_SYSEXIT	4 /* pid=caller, arg[0]=return value */
+#define EVL_FLTREC_IRQENTRY	5
+#define EVL_FLTREC_IRQEXIT	6
+
+struct evl_flightrec_record {
+	__u64 date;		/* EVL monotonic clock (ns) */
+	__u32 type;		/* EVL_FLTREC_* */
+	__s32 pid;
+	__u64 arg[2];
+};
+
+/* Rings are frozen. */
+#define EVL_FLTREC_FROZEN	(1 << 0)
+
+struct evl_flightrec_ring {
+	__u64 head;
+	__u32 flags;
+	__u32 __pad;
+	__u64 freeze_date;
+	__u64 __reserved[5];
+};
+
+struct evl_flightrec_info {
+	__u32 nr_cpus;
+	__u32 nr_records;
+	__u64 area_size;
+};
+
+struct evl_flightrec_trigger {
+	/* Freeze on timer lateness above this value, zero disables. */
+	__u64 lateness_ns;
+};
+
+#define EVL_FLIGHTREC_IOCBASE	'R'
+
+#define EVL_FLTIOC_GET_INFO	_IOR(EVL_FLIGHTREC_IOCBASE, 0, struct evl_flightrec_info)
+#define EVL_FLTIOC_SET_TRIGGER	_IOW(EVL_FLIGHTREC_IOCBASE, 1, struct evl_flightrec_trigger)
+#define EVL_FLTIOC_FREEZE	_IO(EVL_FLIGHTREC_IOCBASE, 2)
+#define EVL_FLTIOC_THAW		_IO(EVL_FLIGHTREC_IOCBASE, 3)
+
+#endif /* !_EVL_UAPI_FLIGHTREC_ABI_H */
@@ -30,6 +30,7 @@ struct evl_monitor_attrs {
 #define EVL_MONITOR_SIGNALED   0x1 /* Gate/Event */
 #define EVL_MONITOR_BROADCAST  0x2 /* Event */
 #define EVL_MONITOR_TARGETED   0x4 /* Event */
+#define EVL_MONITOR_SLOWPATH   0x8 /* Event (mask) */
 
 #define EVL_MONITOR_NOGATE  -1U
 
@@ -46,10 +47,34 @@ struct evl_monitor_state {
 			__u32 value; /* atomic_t */
 			__u32 pollrefs; /* atomic_t */
 			__u32 gate_offset;
+			__u32 waiters; /* atomic_t */
 		} event;
 	} u;
 };
 
+/*
+ * Ungated events may be posted and consumed from user-space without
+ * entering the kernel, which is then only needed to sleep or wake up
+ * sleepers:
+ *
+ * - count: value is the semaphore count, negative values tell how
+ *   many threads are waiting. A unit may be taken by decrementing a
+ *   positive value, or posted by incrementing a non-negative value.
+ *   EVL_MONIOC_SIGNAL is required whenever the value is negative,
+ *   or pollrefs is non-zero once the increment is done (passing a
+ *   zero count to trigger the poll notification only).
+ *
+ * - mask: value is the event mask. Unless EVL_MONITOR_SLOWPATH is
+ *   set in flags, bits may be consumed by clearing them, or posted
+ *   by setting them. EVL_MONIOC_SIGNAL is required whenever waiters or
+ *   pollrefs is non-zero once the bits are set (passing a zero mask
+ *   to have the waiters check for the new bits), or pollrefs is
+ *   non-zero once the mask is cleared.
+ *
+ * The kernel counts in waiters and pollrefs before checking the
+ * value, so the value should be updated by a fully ordered atomic
+ * operation before reading those counts.
+ */
 struct evl_monitor_waitreq {
 	__u64 timeout_ptr;	/* (struct __evl_timespec __user *timeout) */
 	__s32 gatefd;
@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_MQUEUE_ABI_H
+#define _EVL_UAPI_MQUEUE_ABI_H
+
+#include <linux/types.h>
+
+#define EVL_MQUEUE_DEV		"mqueue"
+
+#define EVL_MQUEUE_MAX_PRIOS	32
+#define EVL_MQUEUE_MAX_MSGSIZE	65536
+#define EVL_MQUEUE_MAX_CAPACITY	65536
+
+struct evl_mqueue_attrs {
+	__u32 clockfd;
+	__u32 msgsize;	/* Maximum message size in bytes. */
+	__u32 capacity;	/* Messages per priority level, power of 2. */
+	__u32 nr_prios;	/* Priority levels, 0 is the lowest. */
+};
+
+/*
+ * A message queue lives in the shared heap, mapped by every EVL
+ * process. There is one bounded multi-producer/multi-consumer ring
+ * for each priority level, indexed by free-running head (next slot
+ * to fill) and tail (next slot to drain) counters. Every slot
+ * carries a sequence number which tells its state to the claimers:
+ *
+ * - seq == head means that the slot is free for the writer which
+ *   manages to move head to head + 1. The writer copies the message
+ *   to the slot, then releases seq = head + 1.
+ *
+ * - seq == tail + 1 means that the slot holds a message for the
+ *   reader which manages to move tail to tail + 1. The reader copies
+ *   the message out, then releases seq = tail + capacity.
+ *
+ * Initially, slot #n has seq == n. Readers scan the rings from the
+ * highest priority level down. Sending and receiving never enter the
+ * kernel, except for blocking when a ring is full or all rings are
+ * empty, and for waking up sleepers:
+ *
+ * - a reader finding all rings empty issues EVL_MQIOC_WAIT_INPUT,
+ *   which counts the caller in rd_waiters then sleeps until some
+ *   message is readable. A writer reloads rd_waiters past a full
+ *   memory barrier once a message is published, issuing
+ *   EVL_MQIOC_WAKE_INPUT if non-zero.
+ *
+ * - symmetrically, a writer finding the ring of its priority level
+ *   full issues EVL_MQIOC_WAIT_OUTPUT, and a reader checks
+ *   wr_waiters after releasing a slot, issuing EVL_MQIOC_WAKE_OUTPUT
+ *   if non-zero.
+ *
+ * Returning from a wait request only means that the condition was
+ * met at some point, the caller should retry claiming a slot.
+ */
+struct evl_mqueue_ring {
+	__u32 head;	/* atomic */
+	__u32 tail;	/* atomic */
+};
+
+struct evl_mqueue_slot {
+	__u32 seq;	/* atomic */
+	__u32 len;
+	__u8 data[];
+};
+
+struct evl_mqueue_state {
+	__u32 rd_waiters;	/* atomic */
+	__u32 wr_waiters;	/* atomic */
+	__u32 msgsize;
+	__u32 capacity;
+	__u32 nr_prios;
+	__u32 slot_size;	/* Distance between slots. */
+	__u32 slots_offset;	/* Slot array, from this state. */
+	__u32 __pad;
+	struct evl_mqueue_ring rings[];	/* [nr_prios] */
+};
+
+struct evl_mqueue_waitreq {
+	__u64 timeout_ptr;	/* (struct __evl_timespec __user *timeout) */
+	__u32 prio;		/* Level to wait for (output only). */
+};
+
+#define EVL_MQUEUE_IOCBASE	'q'
+
+#define EVL_MQIOC_WAIT_INPUT	_IOW(EVL_MQUEUE_IOCBASE, 0, struct evl_mqueue_waitreq)
+#define EVL_MQIOC_WAIT_OUTPUT	_IOW(EVL_MQUEUE_IOCBASE, 1, struct evl_mqueue_waitreq)
+#define EVL_MQIOC_WAKE_INPUT	_IO(EVL_MQUEUE_IOCBASE, 2)
+#define EVL_MQIOC_WAKE_OUTPUT	_IO(EVL_MQUEUE_IOCBASE, 3)
+
+#endif /* !_EVL_UAPI_MQUEUE_ABI_H */
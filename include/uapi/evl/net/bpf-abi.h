@@ -7,11 +7,71 @@
 #ifndef _EVL_UAPI_NET_BPF_ABI_H
 #define _EVL_UAPI_NET_BPF_ABI_H
 
+#include <linux/types.h>
+
+/*
+ * The RX program returns a verdict, with the action in the low byte
+ * and an action-specific argument in the upper bits.
+ */
 enum evl_net_rx_action {
 	EVL_RX_DROP = 0,	/* Discard */
 	EVL_RX_ACCEPT,		/* Pass to oob stack */
 	EVL_RX_SKIP,		/* Leave to inband stack */
 	EVL_RX_VLAN,		/* Apply VLAN-based rules */
+	EVL_RX_STEER,		/* Pass to oob stack via RX queue <arg> */
+	EVL_RX_SOCKET,		/* Deliver to packet socket in slot <arg> */
+	EVL_RX_NR_ACTIONS
+};
+
+#define EVL_RX_ACTION(__verdict)	((__verdict) & 0xff)
+#define EVL_RX_ARG(__verdict)		((__verdict) >> 8)
+#define EVL_RX_STEER_TO(__queue)	(EVL_RX_STEER | ((__queue) << 8))
+#define EVL_RX_DELIVER_TO(__slot)	(EVL_RX_SOCKET | ((__slot) << 8))
+
+/* Per-device table of sockets EVL_RX_SOCKET may deliver to. */
+#define EVL_RX_MAX_SOCKETS	16
+
+struct evl_net_rxsock_req {
+	__u32 slot;
+	__s32 fd;		/* Packet socket, -1 clears the slot. */
+};
+
+struct evl_net_rx_stats {
+	__u64 verdicts[EVL_RX_NR_ACTIONS];
+	__u64 invalid;		/* Unknown action or bad argument. */
+};
+
+/*
+ * The TX program runs on every egress frame before it enters the
+ * qdisc of the port, seeing it from the link-layer header. Its
+ * verdict follows the same layout as with RX.
+ */
+enum evl_net_tx_action {
+	EVL_TX_DROP = 0,	/* Discard */
+	EVL_TX_PASS,		/* Send as built */
+	EVL_TX_CLASSIFY,	/* Apply the marks in <arg>, then send */
+	EVL_TX_NR_ACTIONS
+};
+
+#define EVL_TX_ACTION(__verdict)	((__verdict) & 0xff)
+#define EVL_TX_ARG(__verdict)		((__verdict) >> 8)
+#define EVL_TX_CLASSIFY_AS(__marks)	(EVL_TX_CLASSIFY | ((__marks) << 8))
+
+/*
+ * Marks EVL_TX_CLASSIFY may combine: the packet priority selecting
+ * the band or traffic class in the qdisc, the DSCP of an IP packet,
+ * and the PCP of a VLAN-tagged frame.
+ */
+#define EVL_TX_SET_PRIO		0x10
+#define EVL_TX_SET_DSCP		0x800
+#define EVL_TX_SET_PCP		0x8000
+#define EVL_TX_PRIO(__prio)	(EVL_TX_SET_PRIO | ((__prio) & 0xf))
+#define EVL_TX_DSCP(__dscp)	(EVL_TX_SET_DSCP | (((__dscp) & 0x3f) << 5))
+#define EVL_TX_PCP(__pcp)	(EVL_TX_SET_PCP | (((__pcp) & 0x7) << 12))
+
+struct evl_net_tx_stats {
+	__u64 verdicts[EVL_TX_NR_ACTIONS];
+	__u64 invalid;		/* Unknown action or bad argument. */
 };
 
 #endif /* !_EVL_UAPI_NET_BPF_ABI_H */
@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_NET_CAN_ABI_H
+#define _EVL_UAPI_NET_CAN_ABI_H
+
+#include <linux/types.h>
+#include <evl/net/socket-abi.h>
+
+/*
+ * Oob CAN sockets are created with socket(AF_CAN, SOCK_RAW |
+ * SOCK_OOB, CAN_RAW), then bound to a CAN interface with a struct
+ * sockaddr_can, can_ifindex being zero for all interfaces. Each
+ * message sent or received with EVL_SOCKIOC_SENDMSG and
+ * EVL_SOCKIOC_RECVMSG carries a single struct can_frame (CAN_MTU) or
+ * struct canfd_frame (CANFD_MTU).
+ *
+ * Incoming frames matching the filters of an oob CAN socket bound to
+ * the input interface are handled by the out-of-band stack, every
+ * matching socket receiving a copy. Other frames, including error
+ * frames, are left to the in-band stack. Frames sent oob are not
+ * looped back to any socket.
+ *
+ * The timestamp field of a received message is the reception date
+ * on the EVL monotonic clock, as captured by the controller if the
+ * driver supports it, or when the frame entered the oob stack
+ * otherwise.
+ */
+
+/*
+ * Receive filters of a socket, see struct can_filter. By default, a
+ * socket accepts every frame, setting an empty filter list makes it
+ * receive none.
+ */
+#define EVL_CAN_MAX_FILTERS	32
+
+struct evl_can_filters {
+	__u64 filters_ptr;	/* (struct can_filter __user *filters) */
+	__u32 count;
+	__u32 __pad;
+};
+
+#define EVL_CAN_IOC_SETFILTER	_IOW(EVL_SOCKET_IOCBASE, 48, struct evl_can_filters)
+
+#endif /* !_EVL_UAPI_NET_CAN_ABI_H */
@@ -8,9 +8,55 @@
 #define _EVL_UAPI_NET_DEVICE_ABI_H
 
 #include <linux/types.h>
+#include <evl/net/bpf-abi.h>
 
 #define EVL_NETDEV_IOCBASE  0xef
 
+#define EVL_NET_QDISC_NAMELEN	32
+
+struct evl_net_qdisc_req {
+	__u64 name_ptr;		/* (const char __user *name) */
+	__u64 params_ptr;	/* (const void __user *params) */
+	__u32 params_len;
+	__u32 __pad;
+};
+
+/* Per-class counters of the current qdisc, if it supports them. */
+struct evl_net_qdisc_class_stats {
+	__u64 packets;
+	__u64 bytes;
+	__u64 dropped;
+	__u32 backlog;
+	__u32 __pad;
+};
+
+struct evl_net_qdisc_statreq {
+	__u64 stats_ptr;	/* (struct evl_net_qdisc_class_stats __user *stats) */
+	__u32 nr_classes;	/* in: room in stats[], out: actual count. */
+	__u32 __pad;
+};
+
+/* Counters of an oob port, see EVL_NDEVIOC_GETSTATS. */
+struct evl_net_port_stats {
+	__u64 rx_packets;
+	__u64 rx_bytes;
+	__u64 rx_filtered;	/* Dropped by the RX program */
+	__u64 rx_unclaimed;	/* No receiver */
+	__u64 tx_packets;
+	__u64 tx_bytes;
+	__u64 tx_qdisc_drops;	/* Refused by the qdisc */
+	__u64 tx_errors;	/* Refused by the driver */
+	__u64 pool_empty;	/* Allocations which found the pool empty */
+	__u64 tx_filtered;	/* Dropped by the TX program */
+};
+
 #define EVL_NDEVIOC_SETRXEBPF	_IOW(EVL_NETDEV_IOCBASE, 0, __s32 /* fd */)
+#define EVL_NDEVIOC_SETQDISC	_IOW(EVL_NETDEV_IOCBASE, 1, struct evl_net_qdisc_req)
+#define EVL_NDEVIOC_GETQSTATS	_IOWR(EVL_NETDEV_IOCBASE, 2, struct evl_net_qdisc_statreq)
+#define EVL_NDEVIOC_SETRXSOCK	_IOW(EVL_NETDEV_IOCBASE, 3, struct evl_net_rxsock_req)
+#define EVL_NDEVIOC_GETRXSTATS	_IOR(EVL_NETDEV_IOCBASE, 4, struct evl_net_rx_stats)
+#define EVL_NDEVIOC_GETSTATS	_IOR(EVL_NETDEV_IOCBASE, 5, struct evl_net_port_stats)
+#define EVL_NDEVIOC_SETTXEBPF	_IOW(EVL_NETDEV_IOCBASE, 6, __s32 /* fd */)
+#define EVL_NDEVIOC_GETTXSTATS	_IOR(EVL_NETDEV_IOCBASE, 7, struct evl_net_tx_stats)
 
 #endif /* !_EVL_UAPI_NET_DEVICE_ABI_H */
@@ -0,0 +1,131 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_NET_PACKET_ABI_H
+#define _EVL_UAPI_NET_PACKET_ABI_H
+
+#include <linux/types.h>
+#include <evl/net/socket-abi.h>
+
+#define EVL_PACKET_MAX_FRAMES		4096
+#define EVL_PACKET_MAX_FRAMESZ		16384
+
+struct evl_packet_ring_attrs {
+	__u32 frame_size;	/* Bytes per frame. */
+	__u32 rx_frames;	/* RX ring size, power of 2. */
+	__u32 tx_frames;	/* TX ring size, power of 2. */
+	__u32 area_offset;	/* (out) evl_packet_area, in the shared heap. */
+};
+
+/*
+ * A mapped ring area lives in the shared heap, mapped by every EVL
+ * process. It contains one RX and one TX ring of descriptors indexed
+ * by free-running head (next slot to fill) and tail (next slot to
+ * drain) counters. Slot #n of the RX ring is backed by frame
+ * #(n & (rx_frames - 1)), slot #n of the TX ring by frame
+ * #(rx_frames + (n & (tx_frames - 1))), with frames laid out
+ * frame_size bytes apart from frames_offset.
+ *
+ * - the kernel fills the RX ring with incoming packets, moving
+ *   rx.head past each new descriptor. User-space consumes
+ *   descriptors at rx.tail, then moves it forward to release the
+ *   frames. Packets arriving while the RX ring is full are dropped
+ *   and counted in rx.dropped. EVL_SOCKIOC_RECVMSG on a socket in
+ *   ring mode waits for the RX ring to be non-empty, returning the
+ *   count of readable descriptors; poll(POLLIN) works too.
+ *
+ * - user-space fills TX frames, writes the descriptors then moves
+ *   tx.head forward, before issuing EVL_PACKET_IOC_KICK_TX from the
+ *   out-of-band stage. The kernel sends every pending descriptor in
+ *   a single call, moving tx.tail forward as frames are released.
+ *
+ * Each side only reads the counters moved by the other one, the
+ * kernel relies on its private copy of the geometry and of its own
+ * counters, never trusting the shared values.
+ */
+struct evl_packet_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 dropped;
+	__u32 __pad;
+};
+
+#define EVL_PACKET_DESC_TRUNC	(1U << 0) /* RX frame was truncated. */
+
+struct evl_packet_desc {
+	__u32 len;		/* Frame length, MAC header included. */
+	__u32 ifindex;		/* RX: input device, TX: output device or 0. */
+	__be16 protocol;	/* Network byte order. */
+	__u8 pkttype;		/* RX only. */
+	__u8 flags;
+	__u32 __pad;
+};
+
+struct evl_packet_area {
+	struct evl_packet_ring rx;
+	struct evl_packet_ring tx;
+	__u32 frame_size;
+	__u32 rx_frames;
+	__u32 tx_frames;
+	__u32 rx_descs_offset;	/* From this area. */
+	__u32 tx_descs_offset;	/* From this area. */
+	__u32 frames_offset;	/* From this area. */
+};
+
+#define EVL_PACKET_MAX_SCHED		1024
+
+/*
+ * Cyclic transmission schedule. Once set up on a socket in ring mode
+ * by EVL_PACKET_IOC_SETUP_SCHED, a kernel thread sends the TX frame
+ * slot designated by every active entry of the table at @offset
+ * nanoseconds into each cycle, cycles being @period nanoseconds apart
+ * from @start on the EVL clock @clockfd refers to. The frames to send
+ * are described by the TX descriptor of the same slot, which
+ * user-space fills once. Slots referred to by the schedule should not
+ * be used by the TX ring at the same time.
+ *
+ * The table lives in the shared heap: user-space may update
+ * nr_entries, the offsets and frame slots in place at any time, the
+ * kernel reading each entry once per cycle. Entries must be sorted
+ * by increasing offset. Updating a frame which might be on its way
+ * is best done by filling a spare slot, then switching the entry to
+ * it. With EVL_PACKET_SCHED_TXTIME set, all frames of a cycle are
+ * queued at the start of the previous one with their launch time
+ * set, for the oob_etf qdisc or the NIC to release on time, instead
+ * of being sent when their offset elapses.
+ */
+#define EVL_PACKET_SCHED_TXTIME		(1U << 0)
+
+struct evl_packet_sched_entry {
+	__u64 offset;		/* From the start of the cycle (ns). */
+	__u32 frame;		/* TX frame slot. */
+	__u32 __pad;
+};
+
+struct evl_packet_sched_table {
+	__u32 nr_entries;	/* Active entries, up to max_entries. */
+	__u32 __pad;
+	__u64 cycles;		/* (out) Cycles completed. */
+	__u64 missed;		/* (out) Frames which could not be sent. */
+	struct evl_packet_sched_entry entries[];
+};
+
+struct evl_packet_sched_attrs {
+	__s32 clockfd;
+	__u32 max_entries;
+	__u32 flags;
+	__u32 prio;		/* SCHED_FIFO priority of the sender. */
+	__u64 period;		/* Cycle duration (ns). */
+	struct __evl_timespec start;
+	__u32 table_offset;	/* (out) evl_packet_sched_table, in the shared heap. */
+	__u32 __pad;
+};
+
+/* Keep clear of the common socket requests. */
+#define EVL_PACKET_IOC_SETUP_RING	_IOWR(EVL_SOCKET_IOCBASE, 32, struct evl_packet_ring_attrs)
+#define EVL_PACKET_IOC_KICK_TX		_IO(EVL_SOCKET_IOCBASE, 33)
+#define EVL_PACKET_IOC_SETUP_SCHED	_IOWR(EVL_SOCKET_IOCBASE, 34, struct evl_packet_sched_attrs)
+#define EVL_PACKET_IOC_STOP_SCHED	_IO(EVL_SOCKET_IOCBASE, 35)
+
+#endif /* !_EVL_UAPI_NET_PACKET_ABI_H */
@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_NET_QDISC_ABI_H
+#define _EVL_UAPI_NET_QDISC_ABI_H
+
+#include <linux/types.h>
+
+/*
+ * Parameters of the "oob_etf" qdisc (earliest txtime first). Packets
+ * are released to the device @delta_ns ahead of their launch time,
+ * read from the EVL monotonic clock. With EVL_NET_ETF_OFFLOAD, the
+ * NIC is asked to hold them until their launch time on TX queue
+ * @queue, which requires its hardware clock to be synchronized to the
+ * TAI time base; the qdisc falls back to software release if the
+ * device cannot do that.
+ */
+#define EVL_NET_ETF_OFFLOAD	(1U << 0)
+
+struct evl_net_etf_params {
+	__s64 delta_ns;
+	__u32 flags;
+	__s32 queue;
+};
+
+/*
+ * Parameters of the "oob_taprio" qdisc (802.1Qbv time-aware
+ * shaper). Packets are queued to the traffic class @prio_tc_map
+ * gives for their priority, higher classes are served first. Gates
+ * open and close according to the control list in @entries, which
+ * is cycled through endlessly from @base_time_ns on the EVL clock
+ * @clockfd. Every entry opens the classes set in @gate_mask for
+ * @interval_ns. A packet is not started unless it may leave before
+ * its gate closes, based on the link speed. All gates stay open
+ * until the base time is reached.
+ *
+ * With EVL_NET_TAPRIO_OFFLOAD, the schedule is passed to the NIC
+ * instead, mapping traffic class #n to TX queue #n, in which case
+ * @base_time_ns refers to the device clock. The qdisc falls back to
+ * software gating if the device cannot do that.
+ */
+#define EVL_NET_TAPRIO_MAX_TC		8
+#define EVL_NET_TAPRIO_MAX_ENTRIES	64
+
+#define EVL_NET_TAPRIO_OFFLOAD		(1U << 0)
+
+struct evl_net_taprio_entry {
+	__u32 gate_mask;
+	__u32 interval_ns;
+};
+
+struct evl_net_taprio_params {
+	__s64 base_time_ns;
+	__s32 clockfd;
+	__u32 flags;
+	__u32 nr_tc;
+	__u32 nr_entries;
+	__u8 prio_tc_map[16];
+	struct evl_net_taprio_entry entries[];
+};
+
+/*
+ * Parameters of the "oob_prio" qdisc (strict priority bands). A
+ * packet goes to the band @pcp_band_map gives for its VLAN priority
+ * if tagged, or to the band @prio_band_map gives for the socket
+ * priority otherwise. Band #0 is served first. Each band holds up to
+ * @limit packets, zero meaning a default of 1000.
+ *
+ * A band with a non-zero @idleslope_kbps is shaped by the credit
+ * based algorithm of 802.1Qav: it may only send while its credit is
+ * not negative, the credit grows at the idle slope while packets are
+ * waiting, decreases at the send slope (idle slope minus port rate)
+ * while sending, and is bounded by @hicredit and @locredit bytes.
+ * Shaping requires the link speed to be known.
+ */
+#define EVL_NET_PRIO_MAX_BANDS	8
+
+struct evl_net_prio_band {
+	__u32 idleslope_kbps;
+	__s32 hicredit;
+	__s32 locredit;
+	__u32 limit;
+};
+
+struct evl_net_prio_params {
+	__u32 nr_bands;
+	__u8 prio_band_map[16];
+	__u8 pcp_band_map[8];
+	__u32 __pad;
+	struct evl_net_prio_band bands[EVL_NET_PRIO_MAX_BANDS];
+};
+
+#endif /* !_EVL_UAPI_NET_QDISC_ABI_H */
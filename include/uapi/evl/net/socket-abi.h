@@ -16,6 +16,12 @@
 /* Keep this distinct from SOCK_IOC_TYPE (0x89) */
 #define EVL_SOCKET_IOCBASE  0xee
 
+/*
+ * On receive, the timestamp field of packet and UDP messages is set
+ * to the time the packet entered the out-of-band stack, on the EVL
+ * monotonic clock. CAN frames report their hardware stamp instead if
+ * the driver provided one.
+ */
 struct user_oob_msghdr {
 	__u64 name_ptr;		/* (struct sockaddr __user *name) */
 	__u64 iov_ptr;		/* (struct iovec __user *iov) */
@@ -29,16 +35,142 @@ struct user_oob_msghdr {
 	struct __evl_timespec timestamp; /* Stats / TSN trigger */
 };
 
+/*
+ * Transmit flags set by EVL_SOCKIOC_SETTXFLAGS:
+ *
+ * EVL_SOCKTX_TIME: the timestamp field of every message sent is its
+ * launch time on the EVL monotonic clock, zero meaning as soon as
+ * possible. This is honored by the "oob_etf" qdisc (see
+ * EVL_NDEVIOC_SETQDISC).
+ *
+ * EVL_SOCKTX_STAMP: every packet sent is stamped when handed over to
+ * the driver, the stamp is queued to the socket error queue which
+ * EVL_SOCKIOC_RECVMSG reads from with MSG_ERRQUEUE set, copying a
+ * struct evl_sock_txstamp to the control buffer. Reading the error
+ * queue never blocks, POLLERR is raised when it is not empty. Stamps
+ * bear the sequence number of the message they refer to, counting
+ * from zero since the flag was set.
+ *
+ * Sending with MSG_ZEROCOPY set reads the payload through the kernel
+ * mapping of the user buffers pinned with EVL_CTLIOC_PIN_UBUF, the
+ * checksum being computed along with the single copy to the device
+ * pool. Parts of the payload outside of any pinned buffer go through
+ * the regular user access path. Every such message sent queues an
+ * EVL_SOCKTX_ZEROCOPY_DONE record to the error queue once its buffer
+ * may be reused, bearing the sequence number of the message among
+ * the MSG_ZEROCOPY ones, counting from zero.
+ */
+#define EVL_SOCKTX_TIME		(1U << 0)
+#define EVL_SOCKTX_STAMP	(1U << 1)
+
+#define EVL_SOCKTX_STAMP_SW	(1U << 0) /* Software stamp */
+#define EVL_SOCKTX_ZEROCOPY_DONE (1U << 1) /* MSG_ZEROCOPY completion */
+
+struct evl_sock_txstamp {
+	__u32 id;
+	__u32 flags;
+	struct __evl_timespec stamp;
+};
+
+/*
+ * Receive flags set by EVL_SOCKIOC_SETRXFLAGS:
+ *
+ * EVL_SOCKRX_STAMP: every packet or datagram received comes with a
+ * struct evl_sock_rxstamp written at the start of the control
+ * buffer, which must be large enough to hold it, ctllen being
+ * updated accordingly. The software stamp is the time the packet
+ * entered the out-of-band stack on the EVL monotonic clock, the
+ * hardware stamp is the raw value the NIC driver reported if any,
+ * usually read from the PHC of the device. Other control data the
+ * protocol returns (e.g. the UDP_GRO segment size) follows.
+ */
+#define EVL_SOCKRX_STAMP	(1U << 0)
+
+#define EVL_SOCKRX_STAMP_SW	(1U << 0) /* Software stamp is valid */
+#define EVL_SOCKRX_STAMP_HW	(1U << 1) /* Hardware stamp is valid */
+
+struct evl_sock_rxstamp {
+	__u32 flags;
+	__u32 __pad;
+	struct __evl_timespec sw;
+	struct __evl_timespec hw;
+};
+
+/*
+ * Vector of @vlen message headers for EVL_SOCKIOC_SENDMMSG and
+ * EVL_SOCKIOC_RECVMMSG, which process each entry in turn like
+ * EVL_SOCKIOC_SENDMSG and EVL_SOCKIOC_RECVMSG would. The request
+ * fails only if the first entry does, otherwise @count tells how many
+ * entries were processed, and @error the status of the entry which
+ * stopped the batch, or zero if all of them went through. Receivers
+ * may set MSG_DONTWAIT on all entries but the first one, in order to
+ * collect whatever is pending once some input is available.
+ */
+struct user_oob_msgvec {
+	__u64 msg_ptr;		/* (struct user_oob_msghdr __user *msgvec) */
+	__u32 vlen;
+	__u32 count;		/* (out) processed entries. */
+	__s32 error;		/* (out) status of entry #count. */
+	__u32 __pad;
+};
+
+/*
+ * Busy polling window in microseconds set by
+ * EVL_SOCKIOC_SETBUSYPOLL, zero disables. When no input is pending,
+ * a receiver first polls the RX queue of the device it last received
+ * from for that long, before going to sleep.
+ */
+#define EVL_SOCK_MAX_BUSYPOLL	10000
+
+/*
+ * CPU the receiver of a socket consumes input from, set by
+ * EVL_SOCKIOC_SETRXCPU, -1 clears. The flows delivered to the socket
+ * from an RX lane running on another CPU are steered to the lane
+ * pinned to the consumer CPU if the device has one, so that queuing
+ * and wakeup happen locally. This relies on the flow hash the NIC
+ * computes. rx_remote in struct evl_socket_stats counts the packets
+ * which were still delivered from another CPU.
+ */
+
+/*
+ * Oob UDP sockets honor the in-band UDP_SEGMENT and UDP_GRO socket
+ * options. With a segment size set, every message sent is split into
+ * datagrams of that size, the last one possibly shorter. With
+ * UDP_GRO enabled, EVL_SOCKIOC_RECVMSG may return several consecutive
+ * datagrams from the same peer at once, all of the same size but the
+ * last one which may be shorter. This size is then written as a
+ * __u32 to the control buffer if any, ctllen being updated
+ * accordingly.
+ */
+
 struct evl_netdev_activation {
 	__u64 poolsz;
 	__u64 bufsz;
 };
 
+/* Counters of a socket, see EVL_SOCKIOC_GETSTATS. */
+struct evl_socket_stats {
+	__u64 rx_packets;
+	__u64 rx_bytes;
+	__u64 rx_drops;		/* Receive buffer or ring full */
+	__u64 tx_packets;
+	__u64 tx_bytes;
+	__u64 tx_offloaded;	/* Handed over to the in-band stack */
+	__u64 rx_remote;	/* Delivered away from the RX CPU */
+};
+
 #define EVL_SOCKIOC_ACTIVATE	_IOW(EVL_SOCKET_IOCBASE, 2, struct evl_netdev_activation)
 #define EVL_SOCKIOC_DEACTIVATE	_IO(EVL_SOCKET_IOCBASE, 3)
 #define EVL_SOCKIOC_SENDMSG	_IOW(EVL_SOCKET_IOCBASE, 4, struct user_oob_msghdr)
 #define EVL_SOCKIOC_RECVMSG	_IOWR(EVL_SOCKET_IOCBASE, 5, struct user_oob_msghdr)
 #define EVL_SOCKIOC_SETRECVSZ	_IOW(EVL_SOCKET_IOCBASE, 6, int)
 #define EVL_SOCKIOC_SETSENDSZ	_IOW(EVL_SOCKET_IOCBASE, 7, int)
+#define EVL_SOCKIOC_SENDMMSG	_IOWR(EVL_SOCKET_IOCBASE, 8, struct user_oob_msgvec)
+#define EVL_SOCKIOC_RECVMMSG	_IOWR(EVL_SOCKET_IOCBASE, 9, struct user_oob_msgvec)
+#define EVL_SOCKIOC_SETTXFLAGS	_IOW(EVL_SOCKET_IOCBASE, 10, __u32)
+#define EVL_SOCKIOC_SETBUSYPOLL	_IOW(EVL_SOCKET_IOCBASE, 11, __u32)
+#define EVL_SOCKIOC_GETSTATS	_IOR(EVL_SOCKET_IOCBASE, 12, struct evl_socket_stats)
+#define EVL_SOCKIOC_SETRXFLAGS	_IOW(EVL_SOCKET_IOCBASE, 13, __u32)
+#define EVL_SOCKIOC_SETRXCPU	_IOW(EVL_SOCKET_IOCBASE, 14, __s32)
 
 #endif /* !_EVL_UAPI_NET_SOCKET_ABI_H */
@@ -0,0 +1,38 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note
+ */
+
+#ifndef _EVL_UAPI_NET_UDP_ABI_H
+#define _EVL_UAPI_NET_UDP_ABI_H
+
+#include <linux/types.h>
+#include <evl/net/socket-abi.h>
+
+/*
+ * Oob UDP sockets bound to the same address and port with
+ * SO_REUSEPORT form a group, each incoming datagram being queued to
+ * a single member. EVL_UDP_IOC_SETFANOUT issued on any member
+ * selects how the member is picked for the whole group:
+ *
+ * EVL_UDP_FANOUT_HASH: by hash of the flow addresses and ports, so
+ * that a given flow always reaches the same socket (default).
+ *
+ * EVL_UDP_FANOUT_RR: in turn.
+ *
+ * EVL_UDP_FANOUT_CPU: the socket which last received on the CPU
+ * handling the datagram, by flow hash if none.
+ */
+#define EVL_UDP_FANOUT_HASH	0
+#define EVL_UDP_FANOUT_RR	1
+#define EVL_UDP_FANOUT_CPU	2
+
+#define EVL_UDP_IOC_SETFANOUT	_IOW(EVL_SOCKET_IOCBASE, 40, __u32)
+
+/*
+ * Multicast datagrams received oob are delivered to every oob UDP
+ * socket bound to the destination port which joined the group on the
+ * input interface with IP_ADD_MEMBERSHIP, as if IP_MULTICAST_ALL was
+ * off. Source filters are not applied.
+ */
+
+#endif /* !_EVL_UAPI_NET_UDP_ABI_H */
@@ -14,7 +14,10 @@
 /* __evl_notification.flags */
 #define EVL_NOTIFY_ALWAYS	(0 << 0)
 #define EVL_NOTIFY_ONCHANGE	(1 << 0)
-#define EVL_NOTIFY_MASK		EVL_NOTIFY_ONCHANGE
+#define EVL_NOTIFY_SHARED	(1 << 1)
+#define EVL_NOTIFY_CONFLATE	(1 << 2)
+#define EVL_NOTIFY_MASK		(EVL_NOTIFY_ONCHANGE|EVL_NOTIFY_SHARED|	\
+				 EVL_NOTIFY_CONFLATE)
 
 struct evl_notice {
 	__u32 tag;
@@ -24,6 +27,28 @@ struct evl_notice {
 /* Notice tags below this value are reserved to the core. */
 #define EVL_NOTICE_USER  64
 
+/*
+ * Shared observers (EVL_NOTIFY_SHARED) read notices from a single
+ * ring the observable writes each notice to once, instead of
+ * receiving a private copy. The ring is sized by the backlog count
+ * of the first shared subscription, rounded up to a power of two.
+ * The writer never waits for shared observers: an observer lagging
+ * behind by more than the ring size receives an EVL_NOTICE_OVERRUN
+ * notice with the count of notices lost as its event value, then
+ * resumes from the oldest notice still available. This mode is not
+ * available to unicast observables, and cannot be combined with
+ * EVL_NOTIFY_ONCHANGE.
+ */
+#define EVL_NOTICE_OVERRUN  63
+
+/*
+ * A conflating observer (EVL_NOTIFY_CONFLATE) only keeps the latest
+ * value per tag: a notice bearing the same tag as a notice still
+ * pending for this observer overwrites the latter in place, keeping
+ * its position in the queue. The backlog of such observer is bounded
+ * by the number of distinct tags in use. This mode cannot be combined
+ * with EVL_NOTIFY_SHARED.
+ */
 struct evl_subscription {
 	__u32 backlog_count;
 	__u32 flags;
@@ -37,9 +62,37 @@ struct __evl_notification {
 	struct __evl_timespec date;
 };
 
+/*
+ * A mapped observer (EVL_OBSIOC_SUBSCRIBE_MAPPED) receives notices
+ * into a ring living in the shared heap, at ring_offset. The kernel
+ * stores each notice at slots[head & (size - 1)] then moves head
+ * past it, the observer consumes notices from tail, then moves tail
+ * past them, both indices being free-running counters. A notice
+ * sent while the ring is full is dropped and counted in lost. Only
+ * waiting for the ring to become non-empty requires a syscall:
+ * reading the observable, or polling it for POLLIN. Notices read
+ * this way are consumed from the ring. This mode cannot be combined
+ * with EVL_NOTIFY_SHARED or EVL_NOTIFY_CONFLATE.
+ */
+struct evl_notice_ring {
+	__u32 head;	/* Written by the kernel. */
+	__u32 tail;	/* Written by the observer. */
+	__u32 size;	/* Slots, power of 2. */
+	__u32 lost;	/* Written by the kernel. */
+	struct __evl_notification slots[];
+};
+
+struct evl_mapped_subscription {
+	__u32 backlog_count;
+	__u32 flags;
+	__u32 ring_offset;	/* (out) ring, from the shared heap base. */
+	__u32 __pad;
+};
+
 #define EVL_OBSERVABLE_IOCBASE	'o'
 
 #define EVL_OBSIOC_SUBSCRIBE		_IOW(EVL_OBSERVABLE_IOCBASE, 0, struct evl_subscription)
 #define EVL_OBSIOC_UNSUBSCRIBE		_IO(EVL_OBSERVABLE_IOCBASE, 1)
+#define EVL_OBSIOC_SUBSCRIBE_MAPPED	_IOWR(EVL_OBSERVABLE_IOCBASE, 2, struct evl_mapped_subscription)
 
 #endif /* !_EVL_UAPI_OBSERVABLE_ABI_H */
@@ -17,6 +17,17 @@
 #define EVL_POLL_CTLDEL  1
 #define EVL_POLL_CTLMOD  2
 
+/*
+ * Modifiers which may be or'ed to evl_poll_ctlreq.events. A one-shot
+ * item is disabled as soon as it reports an event, until it is
+ * re-armed by EVL_POLL_CTLMOD. An edge-triggered item reports the
+ * events signaled while waiting, and only the events which turned
+ * ready since the previous wait from its current state.
+ */
+#define EVL_POLLONESHOT  (1U << 30)
+#define EVL_POLLET	 (1U << 31)
+#define EVL_POLL_MODIFIERS  (EVL_POLLONESHOT|EVL_POLLET)
+
 struct evl_poll_ctlreq {
 	__u32 action;
 	__u32 fd;
@@ -30,13 +41,59 @@ struct evl_poll_event {
 	union evl_value pollval;
 };
 
+/* Event returned by EVL_POLIOC_WAIT_TIMERS. */
+struct evl_poll_timer_event {
+	__u32 fd;
+	__u32 events;
+	union evl_value pollval;
+	__u64 ticks;
+	struct __evl_timespec expiry;
+};
+
 struct evl_poll_waitreq {
 	__u64 timeout_ptr;	/* (struct __evl_timespec __user *timeout) */
-	__u64 pollset_ptr;	/* (struct evl_poll_event __user *pollset) */
+	__u64 pollset_ptr;	/* (struct evl_poll_event __user *pollset)
+				   or (struct evl_poll_timer_event __user *) */
 	int nrset;
 };
 
+/*
+ * A poll group may deliver events into a completion ring living in
+ * the shared heap, set up by EVL_POLIOC_SETUP_RING which returns the
+ * ring offset from the heap base. In this mode, the items of the
+ * group are watched continuously: every event signaled for an item
+ * is appended at events[head & (size - 1)] as it happens, then head
+ * is moved past it. The consumer reads events from tail, then moves
+ * tail past them, both indices being free-running counters. Events
+ * signaled while the ring is full are dropped and counted in lost.
+ * Items reporting events when armed, i.e. when the ring is set up or
+ * the group is updated, are appended as well.
+ *
+ * The consumer only needs to issue EVL_POLIOC_WAIT_RING when the
+ * ring is empty, which returns as soon as the ring may have some
+ * events, or the timeout elapsed.
+ */
+struct evl_poll_ring {
+	__u32 head;	/* Written by the kernel. */
+	__u32 tail;	/* Written by the consumer. */
+	__u32 size;	/* Events, power of 2. */
+	__u32 lost;	/* Written by the kernel. */
+	struct evl_poll_event events[];
+};
+
+struct evl_poll_ringreq {
+	__u32 nr_events;	/* (in) ring size. */
+	__u32 ring_offset;	/* (out) ring, from the shared heap base. */
+};
+
+struct evl_poll_ringwait {
+	__u64 timeout_ptr;	/* (struct __evl_timespec __user *timeout) */
+};
+
 #define EVL_POLIOC_CTL		_IOW(EVL_POLL_IOCBASE, 0, struct evl_poll_ctlreq)
 #define EVL_POLIOC_WAIT		_IOWR(EVL_POLL_IOCBASE, 1, struct evl_poll_waitreq)
+#define EVL_POLIOC_WAIT_TIMERS	_IOWR(EVL_POLL_IOCBASE, 2, struct evl_poll_waitreq)
+#define EVL_POLIOC_SETUP_RING	_IOWR(EVL_POLL_IOCBASE, 3, struct evl_poll_ringreq)
+#define EVL_POLIOC_WAIT_RING	_IOW(EVL_POLL_IOCBASE, 4, struct evl_poll_ringwait)
 
 #endif /* !_EVL_UAPI_POLL_ABI_H */
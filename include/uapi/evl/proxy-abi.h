@@ -17,4 +17,21 @@ struct evl_proxy_attrs {
 	__u32 granularity;
 };
 
+#define EVL_PROXY_IOCBASE	'P'
+
+/*
+ * Delay the relay of the output by the given count of microseconds
+ * (__u32) after the ring becomes non-empty, so that bursts are sent
+ * in a single write to the target file. Zero disables the delay.
+ */
+#define EVL_PROXYIOC_SET_FLUSH_DELAY	_IOW(EVL_PROXY_IOCBASE, 0, __u32)
+
+/*
+ * Refill the input ring ahead of the readers as soon as at most the
+ * given count of bytes (__u32) is left in it, reading as much as
+ * the ring can hold. Zero disables the read-ahead, the ring is then
+ * filled on demand only.
+ */
+#define EVL_PROXYIOC_SET_READAHEAD	_IOW(EVL_PROXY_IOCBASE, 1, __u32)
+
 #endif /* !_EVL_UAPI_PROXY_ABI_H */
@@ -11,10 +11,21 @@
 
 #define EVL_RANDOM_DEV	"random"
 
+/* Generator modes for EVL_RNGIOC_FILL. */
+#define EVL_RNG_FAST		0 /* Lagged Fibonacci, not for crypto. */
+#define EVL_RNG_CHACHA		1 /* ChaCha20 key stream. */
+
+struct evl_rng_fillreq {
+	__u64 buf_ptr;		/* (void __user *buf) */
+	__u32 len;
+	__u32 mode;
+};
+
 #define EVL_RANDOM_IOCBASE  'r'
 
 #define EVL_RNGIOC_U8		_IOR(EVL_RANDOM_IOCBASE, 0, __u8)
 #define EVL_RNGIOC_U16		_IOR(EVL_RANDOM_IOCBASE, 1, __u16)
 #define EVL_RNGIOC_U32		_IOR(EVL_RANDOM_IOCBASE, 2, __u32)
+#define EVL_RNGIOC_FILL		_IOW(EVL_RANDOM_IOCBASE, 3, struct evl_rng_fillreq)
 
 #endif /* !_EVL_UAPI_RANDOM_ABI_H */
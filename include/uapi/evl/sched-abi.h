@@ -35,11 +35,16 @@ enum evl_quota_ctlop {
 	evl_quota_force_remove,
 	evl_quota_set,
 	evl_quota_get,
+	evl_quota_add_child,
+	evl_quota_set_adaptive,
 };
 
 struct evl_quota_ctlparam {
 	enum evl_quota_ctlop op;
 	union {
+		struct {
+			int parent;
+		} add_child;
 		struct {
 			int tgid;
 		} remove;
@@ -51,6 +56,17 @@ struct evl_quota_ctlparam {
 		struct {
 			int tgid;
 		} get;
+		/*
+		 * Let the budget of a top-level group follow its
+		 * demand within [quota_min, quota_max] (percent of
+		 * the period). A negative quota_min switches back to
+		 * the static budget in effect.
+		 */
+		struct {
+			int tgid;
+			int quota_min;
+			int quota_max;
+		} adapt;
 	} u;
 };
 
@@ -59,6 +75,9 @@ struct evl_quota_ctlinfo {
 	int quota;
 	int quota_peak;
 	int quota_sum;
+	int parent;	/* -1 for top-level groups */
+	__u64 run_time;	/* ns, consumed by the group and its children */
+	__u64 nr_throttled; /* budget exhaustions */
 };
 
 #define SCHED_TP		45
@@ -82,11 +101,27 @@ enum evl_tp_ctlop {
 	evl_tp_start,
 	evl_tp_stop,
 	evl_tp_get,
+	evl_tp_stage,
 };
 
+/*
+ * A non-zero epoch on install requests a synchronized schedule:
+ * time frames start at epoch + k * frame duration as measured by
+ * the EVL clock referred to by clockfd. Installing the same
+ * windows with the same epoch on multiple CPUs aligns their
+ * partition windows.
+ *
+ * evl_tp_stage installs the windows in advance, replacing the running
+ * schedule exactly at the next time frame boundary. A synchronized
+ * schedule may only be replaced by another one based on the same
+ * clock, with time frames following on from that boundary. If no
+ * schedule is running, the staged one takes effect immediately.
+ */
 struct evl_tp_ctlparam {
 	enum evl_tp_ctlop op;
 	int nr_windows;
+	__s32 clockfd;
+	struct __evl_timespec epoch;
 	struct __evl_tp_window windows[0];
 };
 
@@ -96,6 +131,7 @@ struct evl_tp_ctlparam {
 
 struct evl_tp_ctlinfo {
 	int nr_windows;
+	struct __evl_timespec epoch; /* zero if not synchronized */
 	struct __evl_tp_window windows[0];
 };
 
@@ -103,6 +139,17 @@ struct evl_tp_ctlinfo {
 	(sizeof(struct evl_tp_ctlinfo) +	\
 		__nr_windows * sizeof(struct __evl_tp_window))
 
+#define SCHED_EDF		46
+#define sched_edf_runtime	sched_u.edf.__sched_runtime
+#define sched_edf_period	sched_u.edf.__sched_period
+#define sched_edf_deadline	sched_u.edf.__sched_deadline
+
+struct __evl_edf_param {
+	struct __evl_timespec __sched_runtime;
+	struct __evl_timespec __sched_period;
+	struct __evl_timespec __sched_deadline; /* zero means == period */
+};
+
 struct evl_sched_attrs {
 	int sched_policy;
 	int sched_priority;
@@ -110,6 +157,7 @@ struct evl_sched_attrs {
 		struct __evl_rr_param rr;
 		struct __evl_quota_param quota;
 		struct __evl_tp_param tp;
+		struct __evl_edf_param edf;
 	} sched_u;
 };
 
@@ -7,10 +7,28 @@
 #ifndef _EVL_UAPI_SYSCALL_ABI_H
 #define _EVL_UAPI_SYSCALL_ABI_H
 
+#include <linux/types.h>
+
 #define sys_evl_read	0	/* oob_read() */
 #define sys_evl_write	1	/* oob_write() */
 #define sys_evl_ioctl	2	/* oob_ioctl() */
+#define sys_evl_batch	3	/* oob_ioctl() x N */
+
+#define NR_EVL_SYSCALLS 4
 
-#define NR_EVL_SYSCALLS 3
+/*
+ * An oob_ioctl() request submitted with sys_evl_batch. The requests
+ * of a batch are issued in order, each result is written back to its
+ * descriptor. Processing stops at the first request which fails, or
+ * if the caller was switched in-band or received a signal on return
+ * from a request. sys_evl_batch returns the count of requests
+ * issued, including the one which failed.
+ */
+struct evl_oob_op {
+	__u32 fd;
+	__u32 request;
+	__u64 arg;
+	__s64 result;
+};
 
 #endif /* !_EVL_UAPI_SYSCALL_ABI_H */
@@ -37,6 +37,7 @@
 #define EVL_T_HMSIG   0x00100000 /* Notify HM events via SIGDEBUG */
 #define EVL_T_HMOBS   0x00200000 /* Notify HM events via observable */
 #define EVL_T_WOSO    0x00400000 /* Schedule overrun */
+#define EVL_T_EXCL    0x00800000 /* Exclusive core (SMT siblings held) */
 
 /* Information flags (shared) */
 
@@ -63,6 +64,7 @@
 #define EVL_T_IGNOVR  0x00000002 /* Overrun detection temporarily disabled */
 #define EVL_T_INFAULT 0x00000004 /* In fault handling */
 #define EVL_T_NORST   0x00000008 /* Disable syscall restart */
+#define EVL_T_RSEQ    0x00000010 /* Restartable sequence check pending */
 
 /*
  * Must follow strictly the declaration order of the state flags
@@ -96,11 +98,46 @@
 #define EVL_HMDIAG_LKSLEEP	7
 #define EVL_HMDIAG_STAGEX	8
 #define EVL_HMDIAG_OVERRUN	9
+#define EVL_HMDIAG_BUDGET	10
 
 struct evl_user_window {
 	__u32 state;
 	__u32 info;
 	__u32 pp_pending;
+	__u32 cpu;		/* CPU the thread runs on out-of-band */
+	__u64 rseq_cs;		/* (struct evl_rseq_cs __user *), or zero */
+	__u32 preempt_defer;	/* Set by user-space, see below */
+	__u32 preempt_yield;	/* Set by the core, see below */
+};
+
+/*
+ * A thread may ask for a preemption by another oob thread to be
+ * deferred while running a short critical section, by setting
+ * preempt_defer in its user window. If the core honours such
+ * request, it sets preempt_yield. Once done with the section, the
+ * thread clears preempt_defer, then if preempt_yield is set, clears
+ * it and issues EVL_THRIOC_YIELD in order to let the pending switch
+ * happen. A thread which fails to do so within the grace period is
+ * preempted regardless.
+ */
+
+/*
+ * Restartable sequence descriptor. A thread enters a critical
+ * section by storing the address of its descriptor into rseq_cs in
+ * its user window. If the thread is preempted out-of-band while its
+ * instruction pointer lies within [start_ip, start_ip +
+ * post_commit_offset), it resumes at abort_ip instead. rseq_cs is
+ * cleared by the core whenever it inspects it, user-space does not
+ * have to clear it on exit from the section. The descriptor must be
+ * resident in memory, the critical section may not issue any
+ * syscall.
+ */
+struct evl_rseq_cs {
+	__u32 version;		/* Zero */
+	__u32 flags;		/* Zero */
+	__u64 start_ip;
+	__u64 post_commit_offset;
+	__u64 abort_ip;
 };
 
 struct evl_thread_state {
@@ -114,6 +151,82 @@ struct evl_thread_state {
 	__u64 xtime;
 };
 
+/*
+ * Residency risks reported by EVL_THRIOC_PREFAULT for the range, any
+ * of which may cause a page fault, therefore an in-band switch on
+ * first touch from the oob stage.
+ */
+#define EVL_RESIDENCY_UNLOCKED		0x1 /* Not locked in memory */
+#define EVL_RESIDENCY_UNMAPPED		0x2 /* Hole in the range */
+#define EVL_RESIDENCY_UNPOPULATED	0x4 /* Populating failed (I/O, PFN map) */
+#define EVL_RESIDENCY_COW		0x8 /* Private writable, COW after fork() */
+
+struct evl_residency_req {
+	__u64 addr;	/* Zero length means the current stack area. */
+	__u64 len;
+	__u32 risk;	/* out: EVL_RESIDENCY_* */
+	__u32 __pad;
+};
+
+/*
+ * Ready-queue latency histogram: bucket #0 counts the delays below
+ * EVL_RUNLAT_BASE_NS, bucket #n those in [BASE << (n-1), BASE << n),
+ * the last bucket also counts all larger delays.
+ */
+#define EVL_RUNLAT_BUCKETS	16
+#define EVL_RUNLAT_BASE_NS	256
+
+struct evl_thread_runlat {
+	__u64 count;
+	__u64 total_ns;
+	__u64 min_ns;
+	__u64 max_ns;
+	__u64 hist[EVL_RUNLAT_BUCKETS];
+};
+
+/*
+ * Response time histogram of a periodic thread, from its release by
+ * the periodic timer to its next wait for a period. Same bucketing
+ * as the ready-queue latency, based on EVL_RESPTIME_BASE_NS. A
+ * release completing past the next one is a deadline miss, each
+ * release skipped because of such lateness is an overrun.
+ */
+#define EVL_RESPTIME_BUCKETS	20
+#define EVL_RESPTIME_BASE_NS	1024
+
+struct evl_thread_resptime {
+	__u64 count;
+	__u64 total_ns;
+	__u64 min_ns;
+	__u64 max_ns;
+	__u64 misses;
+	__u64 overruns;
+	__u64 hist[EVL_RESPTIME_BUCKETS];
+};
+
+/* Actions upon runtime budget overrun. */
+#define EVL_BUDGET_NOTIFY	0 /* HM notification only */
+#define EVL_BUDGET_DEMOTE	1 /* Notify, then demote to SCHED_WEAK */
+#define EVL_BUDGET_STOP		2 /* Kick out of the oob stage */
+
+struct evl_thread_budget {
+	/* Max continuous oob runtime, zero disables. */
+	__u64 runtime_ns;
+	__u32 action;		/* EVL_BUDGET_* */
+	__u32 __pad;
+};
+
+/* Resource control settings overridden while running oob. */
+#define EVL_RESCTRL_CLOSID	(1 << 0)
+#define EVL_RESCTRL_RMID	(1 << 1)
+
+struct evl_thread_resctrl {
+	__u32 closid;
+	__u32 rmid;
+	__u32 flags;		/* EVL_RESCTRL_*, zero clears */
+	__u32 __pad;
+};
+
 #define EVL_THREAD_IOCBASE	'T'
 
 #define EVL_THRIOC_SIGNAL		_IOW(EVL_THREAD_IOCBASE, 0, __u32)
@@ -129,5 +242,11 @@ struct evl_thread_state {
 #define EVL_THRIOC_UNBLOCK		_IO(EVL_THREAD_IOCBASE, 10)
 #define EVL_THRIOC_DEMOTE		_IO(EVL_THREAD_IOCBASE, 11)
 #define EVL_THRIOC_YIELD		_IO(EVL_THREAD_IOCBASE, 12)
+#define EVL_THRIOC_PREFAULT		_IOWR(EVL_THREAD_IOCBASE, 13, struct evl_residency_req)
+#define EVL_THRIOC_GET_RUNLAT		_IOR(EVL_THREAD_IOCBASE, 14, struct evl_thread_runlat)
+#define EVL_THRIOC_SET_BUDGET		_IOW(EVL_THREAD_IOCBASE, 15, struct evl_thread_budget)
+#define EVL_THRIOC_SET_RESCTRL		_IOW(EVL_THREAD_IOCBASE, 16, struct evl_thread_resctrl)
+#define EVL_THRIOC_GET_RESPTIME		_IOR(EVL_THREAD_IOCBASE, 17, struct evl_thread_resptime)
+#define EVL_THRIOC_SET_CAPACITY		_IOW(EVL_THREAD_IOCBASE, 18, __u32)
 
 #endif /* !_EVL_UAPI_THREAD_ABI_H */
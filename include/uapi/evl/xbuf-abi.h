@@ -16,4 +16,68 @@ struct evl_xbuf_attrs {
 	__u32 o_bufsz;
 };
 
+/*
+ * The rings may be mapped by user-space with mmap(2), so that
+ * producers and consumers may exchange frames in place instead of
+ * copying them through write(2) and read(2). The inbound ring
+ * (oob_write() -> read()) is mapped at offset zero, the outbound ring
+ * (write() -> oob_read()) at i_bufsz rounded up to the page size. A
+ * ring may be mapped twice back-to-back by passing twice its size as
+ * the mapping length, provided its size is a multiple of the page
+ * size: this way, a frame wrapping around the end of the ring is
+ * still contiguous in memory.
+ *
+ * The ring indices are still maintained by the kernel, which
+ * serializes multiple producers and consumers across both stages. A
+ * frame is described by its offset into the ring and its length:
+ *
+ * - EVL_XBUFIOC_RESERVE reserves len bytes for writing, blocking
+ *   until enough room is available unless O_NONBLOCK is set, then
+ *   returns the frame offset. The frame is handed over to the
+ *   consumers by EVL_XBUFIOC_COMMIT.
+ *
+ * - EVL_XBUFIOC_ACQUIRE returns the offset of the next len bytes to
+ *   read, with the same blocking rules as read(2) (including short
+ *   reads), updating len with the actual frame length. The frame is
+ *   released to the producers by EVL_XBUFIOC_RELEASE.
+ *
+ * Like for read(2) and write(2), the request picks the inbound or
+ * outbound ring depending on the issuing stage: out-of-band
+ * producers reserve from the inbound ring then consume from the
+ * outbound ring, in-band producers and consumers do the opposite.
+ * Frames become visible to the other side in reservation order, once
+ * all pending frames are committed.
+ */
+struct evl_xbuf_frame {
+	__u32 offset;
+	__u32 len;
+};
+
+/*
+ * Batched transfers: EVL_XBUFIOC_READV and EVL_XBUFIOC_WRITEV move
+ * up to iovlen messages at once, one per I/O vector cell, each of
+ * them with the same semantics as a single read(2) or write(2). Only
+ * the first message may block, subsequent ones are transferred as
+ * long as they do not. The actual length of every message is
+ * returned to the array pointed at by lens_ptr unless null, the
+ * count of messages transferred to count. An error is returned only
+ * if the first message could not be transferred, except -EFAULT
+ * which is always reported.
+ */
+struct evl_xbuf_batch {
+	__u64 iov_ptr;		/* (struct iovec __user *iov) */
+	__u64 lens_ptr;		/* (__u32 __user *lens) */
+	__u32 iovlen;
+	__u32 count;
+};
+
+#define EVL_XBUF_IOCBASE	'x'
+
+#define EVL_XBUFIOC_RESERVE	_IOWR(EVL_XBUF_IOCBASE, 0, struct evl_xbuf_frame)
+#define EVL_XBUFIOC_COMMIT	_IOW(EVL_XBUF_IOCBASE, 1, struct evl_xbuf_frame)
+#define EVL_XBUFIOC_ACQUIRE	_IOWR(EVL_XBUF_IOCBASE, 2, struct evl_xbuf_frame)
+#define EVL_XBUFIOC_RELEASE	_IOW(EVL_XBUF_IOCBASE, 3, struct evl_xbuf_frame)
+#define EVL_XBUFIOC_READV	_IOWR(EVL_XBUF_IOCBASE, 4, struct evl_xbuf_batch)
+#define EVL_XBUFIOC_WRITEV	_IOWR(EVL_XBUF_IOCBASE, 5, struct evl_xbuf_batch)
+
 #endif /* !_EVL_UAPI_XBUF_ABI_H */
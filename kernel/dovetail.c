@@ -237,7 +237,7 @@ int pipeline_syscall(unsigned int nr, struct pt_regs *regs)
 	 * after exiting to user.
 	 */
 
-	if ((local_flags & _TLF_OOB) && __in_oob_syscall(tsk, nr, regs)) {
+	if (likely((local_flags & _TLF_OOB) && __in_oob_syscall(tsk, nr, regs))) {
 		ret = handle_oob_syscall(regs);
 		if (!IS_ENABLED(CONFIG_DOVETAIL_LEGACY_SYSCALL_RANGE))
 			WARN_ON_ONCE(dovetail_debug() && !ret);
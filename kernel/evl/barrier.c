@@ -0,0 +1,354 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/memory.h>
+#include <evl/factory.h>
+#include <evl/sched.h>
+#include <evl/wait.h>
+#include <evl/uaccess.h>
+#include <uapi/evl/barrier-abi.h>
+
+/*
+ * A cyclic barrier, released by the last participant to arrive.
+ * All sleepers are flushed at once from the wait queue, so that the
+ * rescheduling IPIs to the remote CPUs they run on are sent in a
+ * single batch by the next call to the scheduler, at most one per
+ * CPU. Participants may spin for a short while before sleeping,
+ * which saves the sleep/wakeup/switch cycle when arrivals are
+ * tightly grouped on distinct CPUs.
+ */
+struct evl_barrier_cpu_stats {
+	unsigned long arrivals;
+	unsigned long spun;
+	unsigned long slept;
+};
+
+struct evl_barrier {
+	struct evl_element element;
+	struct evl_barrier_state *state;
+	struct evl_heap *heap;
+	u32 count;
+	u32 arrived;
+	u32 generation;
+	u32 spin_ns;
+	struct evl_barrier_cpu_stats __percpu *stats;
+	struct evl_wait_queue wait;
+};
+
+static inline void account_barrier(unsigned long __percpu *counter)
+{
+	unsigned long flags;
+
+	flags = hard_local_irq_save();
+	raw_cpu_inc(*counter);
+	hard_local_irq_restore(flags);
+}
+
+static inline void publish_barrier_state(struct evl_barrier *b)
+{
+	WRITE_ONCE(b->state->arrived, b->arrived);
+	WRITE_ONCE(b->state->generation, b->generation);
+}
+
+/*
+ * Spin until the barrier trips, or more important work is pending
+ * for the local scheduler, or the spin budget is exhausted.
+ */
+static bool spin_on_barrier(struct evl_barrier *b, u32 gen)
+{
+	struct evl_rq *this_rq = this_evl_rq();
+	ktime_t end;
+
+	if (!IS_ENABLED(CONFIG_SMP) || !b->spin_ns)
+		return false;
+
+	end = ktime_add_ns(evl_read_clock(&evl_mono_clock), b->spin_ns);
+
+	for (;;) {
+		if (READ_ONCE(b->generation) != gen)
+			return true;
+		if (evl_need_resched(this_rq))
+			break;
+		if (evl_read_clock(&evl_mono_clock) >= end)
+			break;
+		cpu_relax();
+	}
+
+	return false;
+}
+
+static int wait_barrier(struct evl_barrier *b,
+			struct evl_barrier_waitreq __user *u_wreq)
+{
+	struct __evl_timespec __user *u_uts;
+	struct evl_barrier_waitreq wreq;
+	struct __evl_timespec uts;
+	enum evl_tmode tmode;
+	struct timespec64 ts64;
+	unsigned long flags;
+	ktime_t timeout;
+	u32 gen;
+	int ret;
+
+	ret = raw_copy_from_user(&wreq, u_wreq, sizeof(wreq));
+	if (ret)
+		return -EFAULT;
+
+	u_uts = evl_valptr64(wreq.timeout_ptr, struct __evl_timespec);
+	ret = raw_copy_from_user(&uts, u_uts, sizeof(uts));
+	if (ret)
+		return -EFAULT;
+
+	if ((unsigned long)uts.tv_nsec >= ONE_BILLION)
+		return -EINVAL;
+
+	ts64 = u_timespec_to_timespec64(uts);
+	timeout = timespec64_to_ktime(ts64);
+	tmode = timeout ? EVL_ABS : EVL_REL;
+
+	raw_spin_lock_irqsave(&b->wait.wchan.lock, flags);
+
+	raw_cpu_inc(b->stats->arrivals);
+	gen = b->generation;
+
+	if (++b->arrived == b->count) {
+		b->arrived = 0;
+		WRITE_ONCE(b->generation, gen + 1);
+		publish_barrier_state(b);
+		evl_flush_wait_locked(&b->wait, 0);
+		raw_spin_unlock_irqrestore(&b->wait.wchan.lock, flags);
+		evl_schedule();
+		return EVL_BARRIER_SERIAL;
+	}
+
+	publish_barrier_state(b);
+
+	raw_spin_unlock_irqrestore(&b->wait.wchan.lock, flags);
+
+	if (spin_on_barrier(b, gen)) {
+		account_barrier(&b->stats->spun);
+		return 0;
+	}
+
+	account_barrier(&b->stats->slept);
+
+	ret = evl_wait_event_timeout(&b->wait, timeout, tmode,
+				READ_ONCE(b->generation) != gen);
+	if (!ret)
+		return 0;
+
+	/*
+	 * Withdraw from the current cycle, unless the barrier tripped
+	 * in the meantime, in which case we were released anyway.
+	 */
+	raw_spin_lock_irqsave(&b->wait.wchan.lock, flags);
+
+	if (b->generation == gen) {
+		b->arrived--;
+		publish_barrier_state(b);
+	} else {
+		ret = 0;
+	}
+
+	raw_spin_unlock_irqrestore(&b->wait.wchan.lock, flags);
+
+	return ret;
+}
+
+static long barrier_oob_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	struct evl_barrier *b = element_of(filp, struct evl_barrier);
+	long ret;
+
+	switch (cmd) {
+	case EVL_BARIOC_WAIT:
+		ret = wait_barrier(b, (struct evl_barrier_waitreq __user *)arg);
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+static int barrier_release(struct inode *inode, struct file *filp)
+{
+	struct evl_barrier *b = element_of(filp, struct evl_barrier);
+
+	evl_flush_wait(&b->wait, EVL_T_RMID);
+
+	return evl_release_element(inode, filp);
+}
+
+static const struct file_operations barrier_fops = {
+	.open		= evl_open_element,
+	.release	= barrier_release,
+	.oob_ioctl	= barrier_oob_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_oob_ioctl  = compat_ptr_oob_ioctl,
+#endif
+};
+
+static struct evl_element *
+barrier_factory_build(struct evl_factory *fac, const char __user *u_name,
+		void __user *u_attrs, int clone_flags, u32 *state_offp)
+{
+	struct evl_barrier_state *state;
+	struct evl_barrier_attrs attrs;
+	struct evl_barrier *b;
+	struct evl_clock *clock;
+	int ret;
+
+	if (clone_flags & ~EVL_CLONE_PUBLIC)
+		return ERR_PTR(-EINVAL);
+
+	ret = copy_from_user(&attrs, u_attrs, sizeof(attrs));
+	if (ret)
+		return ERR_PTR(-EFAULT);
+
+	if (attrs.count == 0 || attrs.count > EVL_BARRIER_MAX_COUNT)
+		return ERR_PTR(-EINVAL);
+
+	/* Spinning longer than this would defeat the purpose. */
+	if (attrs.spin_ns > NSEC_PER_MSEC)
+		return ERR_PTR(-EINVAL);
+
+	clock = evl_get_clock_by_fd(attrs.clockfd);
+	if (clock == NULL)
+		return ERR_PTR(-EINVAL);
+
+	b = kzalloc(sizeof(*b), GFP_KERNEL);
+	if (b == NULL) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
+
+	b->stats = alloc_percpu(struct evl_barrier_cpu_stats);
+	if (b->stats == NULL) {
+		ret = -ENOMEM;
+		goto fail_stats;
+	}
+
+	ret = evl_init_user_element(&b->element, &evl_barrier_factory,
+				u_name, clone_flags);
+	if (ret)
+		goto fail_element;
+
+	b->heap = evl_get_state_heap(clone_flags);
+	state = evl_zalloc_chunk(b->heap, sizeof(*state));
+	if (state == NULL) {
+		ret = -ENOMEM;
+		goto fail_heap;
+	}
+
+	b->state = state;
+	b->count = attrs.count;
+	b->spin_ns = attrs.spin_ns;
+	evl_init_wait(&b->wait, clock, EVL_WAIT_PRIO);
+	*state_offp = evl_state_offset(b->heap, state);
+
+	return &b->element;
+
+fail_heap:
+	evl_put_state_heap(b->heap);
+	evl_destroy_element(&b->element);
+fail_element:
+	free_percpu(b->stats);
+fail_stats:
+	kfree(b);
+fail_alloc:
+	evl_put_clock(clock);
+
+	return ERR_PTR(ret);
+}
+
+static void barrier_factory_dispose(struct evl_element *e)
+{
+	struct evl_barrier *b;
+
+	b = container_of(e, struct evl_barrier, element);
+
+	evl_put_clock(b->wait.clock);
+	evl_destroy_wait(&b->wait);
+	evl_free_chunk(b->heap, b->state);
+	evl_put_state_heap(b->heap);
+	free_percpu(b->stats);
+	evl_destroy_element(&b->element);
+	kfree_rcu(b, element.rcu);
+}
+
+/* count generation arrived */
+static ssize_t state_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_barrier *b;
+	ssize_t ret;
+
+	b = evl_get_element_by_dev(dev, struct evl_barrier);
+	if (b == NULL)
+		return -EIO;
+
+	ret = scnprintf(buf, PAGE_SIZE, "%u %u %u\n",
+			b->count,
+			READ_ONCE(b->state->generation),
+			READ_ONCE(b->state->arrived));
+
+	evl_put_element(&b->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(state);
+
+/* cpu arrivals spun slept */
+static ssize_t arrivals_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_barrier_cpu_stats *stats;
+	struct evl_barrier *b;
+	ssize_t ret = 0;
+	int cpu;
+
+	b = evl_get_element_by_dev(dev, struct evl_barrier);
+	if (b == NULL)
+		return -EIO;
+
+	for_each_online_cpu(cpu) {
+		stats = per_cpu_ptr(b->stats, cpu);
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "%d %lu %lu %lu\n",
+				cpu, READ_ONCE(stats->arrivals),
+				READ_ONCE(stats->spun),
+				READ_ONCE(stats->slept));
+	}
+
+	evl_put_element(&b->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(arrivals);
+
+static struct attribute *barrier_attrs[] = {
+	&dev_attr_state.attr,
+	&dev_attr_arrivals.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(barrier);
+
+struct evl_factory evl_barrier_factory = {
+	.name	=	EVL_BARRIER_DEV,
+	.fops	=	&barrier_fops,
+	.build =	barrier_factory_build,
+	.dispose =	barrier_factory_dispose,
+	.nrdev	=	CONFIG_EVL_NR_BARRIERS,
+	.attrs	=	barrier_groups,
+	.flags	=	EVL_FACTORY_CLONE,
+};
@@ -0,0 +1,289 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/poll.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/factory.h>
+#include <evl/sched.h>
+#include <evl/wait.h>
+#include <evl/poll.h>
+#include <evl/uaccess.h>
+#include <uapi/evl/blackboard-abi.h>
+
+/*
+ * Read-mostly state shared between a writer and any number of
+ * readers, in place and without copy. The protocol runs entirely in
+ * user-space over the mapped buffers (see blackboard-abi.h), we only
+ * provide the memory and a change notification.
+ */
+struct evl_blackboard {
+	struct evl_element element;
+	struct evl_blackboard_state *state;
+	size_t area_size;
+	struct evl_wait_queue wait;
+	struct evl_poll_head poll_head;
+};
+
+static inline u32 get_version(struct evl_blackboard *bb)
+{
+	return atomic_read(__ATOMIC32(&bb->state->version));
+}
+
+static int wait_blackboard(struct evl_blackboard *bb,
+			struct evl_blackboard_waitreq __user *u_wreq)
+{
+	struct __evl_timespec __user *u_uts;
+	struct evl_blackboard_waitreq wreq;
+	struct __evl_timespec uts;
+	enum evl_tmode tmode;
+	struct timespec64 ts64;
+	ktime_t timeout;
+	u32 version;
+	int ret;
+
+	ret = raw_copy_from_user(&wreq, u_wreq, sizeof(wreq));
+	if (ret)
+		return -EFAULT;
+
+	u_uts = evl_valptr64(wreq.timeout_ptr, struct __evl_timespec);
+	ret = raw_copy_from_user(&uts, u_uts, sizeof(uts));
+	if (ret)
+		return -EFAULT;
+
+	if ((unsigned long)uts.tv_nsec >= ONE_BILLION)
+		return -EINVAL;
+
+	ts64 = u_timespec_to_timespec64(uts);
+	timeout = timespec64_to_ktime(ts64);
+	tmode = timeout ? EVL_ABS : EVL_REL;
+
+	/*
+	 * The writer publishes the new version before notifying,
+	 * which grabs the wait channel lock we test the condition
+	 * under: we cannot miss a change.
+	 */
+	ret = evl_wait_event_timeout(&bb->wait, timeout, tmode,
+				get_version(bb) != wreq.version);
+	if (ret)
+		return ret;
+
+	version = get_version(bb);
+
+	return raw_copy_to_user(&u_wreq->version, &version,
+				sizeof(version)) ? -EFAULT : 0;
+}
+
+static void notify_blackboard(struct evl_blackboard *bb)
+{
+	evl_flush_wait(&bb->wait, 0);
+	evl_signal_poll_events(&bb->poll_head, POLLIN|POLLRDNORM);
+	evl_schedule();
+}
+
+static long blackboard_oob_ioctl(struct file *filp, unsigned int cmd,
+				unsigned long arg)
+{
+	struct evl_blackboard *bb = element_of(filp, struct evl_blackboard);
+	long ret = 0;
+
+	switch (cmd) {
+	case EVL_BBIOC_WAIT:
+		ret = wait_blackboard(bb,
+			(struct evl_blackboard_waitreq __user *)arg);
+		break;
+	case EVL_BBIOC_NOTIFY:
+		notify_blackboard(bb);
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+/* In-band writers may notify too, waiting is oob only. */
+static long blackboard_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	struct evl_blackboard *bb = element_of(filp, struct evl_blackboard);
+
+	if (cmd != EVL_BBIOC_NOTIFY)
+		return -ENOTTY;
+
+	notify_blackboard(bb);
+
+	return 0;
+}
+
+static __poll_t blackboard_oob_poll(struct file *filp,
+				struct oob_poll_wait *wait)
+{
+	struct evl_blackboard *bb = element_of(filp, struct evl_blackboard);
+
+	evl_poll_watch(&bb->poll_head, wait, NULL);
+
+	/* Edge-triggered, only notifications report POLLIN. */
+	return 0;
+}
+
+static int blackboard_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct evl_blackboard *bb = element_of(filp, struct evl_blackboard);
+	size_t len = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff || len > bb->area_size)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, bb->state, 0);
+}
+
+static int blackboard_release(struct inode *inode, struct file *filp)
+{
+	struct evl_blackboard *bb = element_of(filp, struct evl_blackboard);
+
+	evl_flush_wait(&bb->wait, EVL_T_RMID);
+
+	return evl_release_element(inode, filp);
+}
+
+static const struct file_operations blackboard_fops = {
+	.open		= evl_open_element,
+	.release	= blackboard_release,
+	.unlocked_ioctl	= blackboard_ioctl,
+	.oob_ioctl	= blackboard_oob_ioctl,
+	.oob_poll	= blackboard_oob_poll,
+	.mmap		= blackboard_mmap,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl	= compat_ptr_ioctl,
+	.compat_oob_ioctl  = compat_ptr_oob_ioctl,
+#endif
+};
+
+static struct evl_element *
+blackboard_factory_build(struct evl_factory *fac, const char __user *u_name,
+		void __user *u_attrs, int clone_flags, u32 *state_offp)
+{
+	struct evl_blackboard_attrs attrs;
+	struct evl_blackboard_state *state;
+	struct evl_blackboard *bb;
+	struct evl_clock *clock;
+	size_t hdr_size, stride;
+	int ret;
+
+	if (clone_flags & ~EVL_CLONE_PUBLIC)
+		return ERR_PTR(-EINVAL);
+
+	ret = copy_from_user(&attrs, u_attrs, sizeof(attrs));
+	if (ret)
+		return ERR_PTR(-EFAULT);
+
+	if (attrs.size == 0 || attrs.size > EVL_BLACKBOARD_MAX_SIZE ||
+		attrs.nr_buffers < 2 ||
+		attrs.nr_buffers > EVL_BLACKBOARD_MAX_BUFFERS)
+		return ERR_PTR(-EINVAL);
+
+	clock = evl_get_clock_by_fd(attrs.clockfd);
+	if (clock == NULL)
+		return ERR_PTR(-EINVAL);
+
+	bb = kzalloc(sizeof(*bb), GFP_KERNEL);
+	if (bb == NULL) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
+
+	ret = evl_init_user_element(&bb->element, &evl_blackboard_factory,
+				u_name, clone_flags);
+	if (ret)
+		goto fail_element;
+
+	hdr_size = PAGE_ALIGN(sizeof(*state));
+	stride = PAGE_ALIGN(attrs.size);
+	bb->area_size = hdr_size + stride * attrs.nr_buffers;
+	state = vmalloc_user(bb->area_size);
+	if (state == NULL) {
+		ret = -ENOMEM;
+		goto fail_area;
+	}
+
+	state->nr_buffers = attrs.nr_buffers;
+	state->size = attrs.size;
+	state->stride = stride;
+	state->data_offset = hdr_size;
+	/* The first update goes to buffer #0. */
+	state->latest = attrs.nr_buffers - 1;
+
+	bb->state = state;
+	evl_init_wait(&bb->wait, clock, EVL_WAIT_PRIO);
+	evl_init_poll_head(&bb->poll_head);
+
+	return &bb->element;
+
+fail_area:
+	evl_destroy_element(&bb->element);
+fail_element:
+	kfree(bb);
+fail_alloc:
+	evl_put_clock(clock);
+
+	return ERR_PTR(ret);
+}
+
+static void blackboard_factory_dispose(struct evl_element *e)
+{
+	struct evl_blackboard *bb;
+
+	bb = container_of(e, struct evl_blackboard, element);
+
+	evl_put_clock(bb->wait.clock);
+	evl_destroy_wait(&bb->wait);
+	vfree(bb->state);
+	evl_destroy_element(&bb->element);
+	kfree_rcu(bb, element.rcu);
+}
+
+/* size nr_buffers version */
+static ssize_t state_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_blackboard *bb;
+	ssize_t ret;
+
+	bb = evl_get_element_by_dev(dev, struct evl_blackboard);
+	if (bb == NULL)
+		return -EIO;
+
+	ret = scnprintf(buf, PAGE_SIZE, "%u %u %u\n",
+			bb->state->size,
+			bb->state->nr_buffers,
+			get_version(bb));
+
+	evl_put_element(&bb->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(state);
+
+static struct attribute *blackboard_attrs[] = {
+	&dev_attr_state.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(blackboard);
+
+struct evl_factory evl_blackboard_factory = {
+	.name	=	EVL_BLACKBOARD_DEV,
+	.fops	=	&blackboard_fops,
+	.build =	blackboard_factory_build,
+	.dispose =	blackboard_factory_dispose,
+	.nrdev	=	CONFIG_EVL_NR_BLACKBOARDS,
+	.attrs	=	blackboard_groups,
+	.flags	=	EVL_FACTORY_CLONE,
+};
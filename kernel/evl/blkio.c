@@ -0,0 +1,513 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/bitmap.h>
+#include <linux/mutex.h>
+#include <linux/delay.h>
+#include <linux/capability.h>
+#include <linux/uaccess.h>
+#include <evl/file.h>
+#include <evl/factory.h>
+#include <evl/clock.h>
+#include <evl/uio.h>
+#include <evl/uaccess.h>
+#include <evl/blkio.h>
+
+/*
+ * Out-of-band block I/O channels. Block drivers reserve a hardware
+ * queue for oob use, which they register with the core as an
+ * evl_blkio_queue. A channel opened on /dev/evl/blkio binds to a
+ * sector range of such queue exclusively, then EVL threads submit
+ * requests and busy poll for their completion from the oob stage,
+ * referring to pinned user buffers for the data. The driver has to
+ * quiesce its queue before unregistering it.
+ */
+
+#define BLKIO_MAX_DEPTH		1024
+
+#define BLKIO_POLL_BATCH	8
+
+struct blkio_slot {
+	struct evl_blkio_req req;
+	struct evl_ubuf *ubuf;
+	__u64 cookie;
+};
+
+struct blkio_channel {
+	struct evl_file efile;
+	struct evl_blkio_queue *q;
+	sector_t start;
+	sector_t nr_sectors;
+	unsigned int depth;
+	struct blkio_slot *slots;
+	unsigned long *busy;
+	unsigned int inflight;
+	struct evl_blkio_cqe *cqes;
+	unsigned int cq_head;
+	unsigned int nr_done;
+	hard_spinlock_t lock;
+};
+
+static LIST_HEAD(queue_list);
+
+static DEFINE_MUTEX(queue_lock);
+
+static void release_slot(struct blkio_channel *ch, unsigned int tag)
+{
+	struct blkio_slot *slot = ch->slots + tag;
+
+	__clear_bit(tag, ch->busy);
+	ch->inflight--;
+
+	if (slot->ubuf) {
+		evl_put_ubuf(slot->ubuf);
+		slot->ubuf = NULL;
+	}
+}
+
+static void post_completion(struct blkio_channel *ch,
+			unsigned int tag, int status)
+{
+	struct evl_blkio_cqe *cqe;
+
+	/* At most ch->depth requests in flight, cannot overflow. */
+	cqe = ch->cqes + (ch->cq_head + ch->nr_done) % ch->depth;
+	cqe->cookie = ch->slots[tag].cookie;
+	cqe->status = status;
+	cqe->__pad = 0;
+	ch->nr_done++;
+	release_slot(ch, tag);
+}
+
+/* oob stage, hard irqs off, from q->ops->poll() only. */
+void evl_blkio_complete(struct evl_blkio_queue *q,
+			unsigned int tag, int status)
+{
+	struct blkio_channel *ch = q->owner;
+
+	if (EVL_WARN_ON(CORE, !ch || tag >= ch->depth ||
+				!test_bit(tag, ch->busy)))
+		return;
+
+	post_completion(ch, tag, status);
+}
+EXPORT_SYMBOL_GPL(evl_blkio_complete);
+
+int evl_register_blkio_queue(struct evl_blkio_queue *q)
+{
+	struct evl_blkio_queue *pos;
+	int ret = 0;
+
+	if (!q->ops || !q->ops->submit || !q->ops->poll ||
+		!q->depth || !q->nr_sectors)
+		return -EINVAL;
+
+	q->owner = NULL;
+
+	mutex_lock(&queue_lock);
+
+	list_for_each_entry(pos, &queue_list, next) {
+		if (!strcmp(pos->name, q->name)) {
+			ret = -EEXIST;
+			goto out;
+		}
+	}
+
+	list_add_tail(&q->next, &queue_list);
+out:
+	mutex_unlock(&queue_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(evl_register_blkio_queue);
+
+void evl_unregister_blkio_queue(struct evl_blkio_queue *q)
+{
+	struct blkio_channel *ch;
+	unsigned long flags;
+	unsigned int tag;
+
+	mutex_lock(&queue_lock);
+
+	list_del(&q->next);
+	ch = q->owner;
+	if (ch) {
+		/*
+		 * The hardware is quiescent, fail the requests still
+		 * pending so that their buffers are released.
+		 */
+		raw_spin_lock_irqsave(&ch->lock, flags);
+		for_each_set_bit(tag, ch->busy, ch->depth)
+			post_completion(ch, tag, -ENXIO);
+		ch->q = NULL;
+		raw_spin_unlock_irqrestore(&ch->lock, flags);
+		q->owner = NULL;
+	}
+
+	mutex_unlock(&queue_lock);
+}
+EXPORT_SYMBOL_GPL(evl_unregister_blkio_queue);
+
+static int bind_channel(struct blkio_channel *ch,
+			struct evl_blkio_bindreq *breq)
+{
+	struct evl_blkio_queue *q;
+	unsigned int depth;
+	int ret = -ENODEV;
+
+	if (!capable(CAP_SYS_RAWIO))
+		return -EPERM;
+
+	breq->name[sizeof(breq->name) - 1] = '\0';
+
+	mutex_lock(&queue_lock);
+
+	if (ch->q || ch->slots) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	list_for_each_entry(q, &queue_list, next) {
+		if (!strcmp(q->name, breq->name)) {
+			ret = 0;
+			break;
+		}
+	}
+
+	if (ret)
+		goto out;
+
+	if (q->owner) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (breq->nr_sectors == 0 || breq->start >= q->nr_sectors ||
+		breq->nr_sectors > q->nr_sectors - breq->start) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	depth = min_t(unsigned int, q->depth, BLKIO_MAX_DEPTH);
+	ch->slots = kcalloc(depth, sizeof(*ch->slots), GFP_KERNEL);
+	ch->cqes = kcalloc(depth, sizeof(*ch->cqes), GFP_KERNEL);
+	ch->busy = bitmap_zalloc(depth, GFP_KERNEL);
+	if (!ch->slots || !ch->cqes || !ch->busy) {
+		kfree(ch->slots);
+		kfree(ch->cqes);
+		bitmap_free(ch->busy);
+		ch->slots = NULL;
+		ch->cqes = NULL;
+		ch->busy = NULL;
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ch->start = q->start_sector + breq->start;
+	ch->nr_sectors = breq->nr_sectors;
+	ch->depth = depth;
+	q->owner = ch;
+	ch->q = q;
+	breq->sector_size = 1U << q->sector_shift;
+	breq->depth = depth;
+out:
+	mutex_unlock(&queue_lock);
+
+	return ret;
+}
+
+static int submit_request(struct blkio_channel *ch,
+			struct evl_blkio_sqe *sqe)
+{
+	const void __user *u_buf = evl_valptr64(sqe->buf_ptr, void);
+	struct evl_ubuf *ubuf = NULL;
+	struct evl_blkio_queue *q;
+	struct blkio_slot *slot;
+	unsigned long flags;
+	unsigned int tag;
+	size_t len = 0;
+	int ret;
+
+	switch (sqe->op) {
+	case EVL_BLKIO_READ:
+	case EVL_BLKIO_WRITE:
+		if (sqe->nr_sectors == 0 || sqe->sector >= ch->nr_sectors ||
+			sqe->nr_sectors > ch->nr_sectors - sqe->sector)
+			return -EINVAL;
+		break;
+	case EVL_BLKIO_FLUSH:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	raw_spin_lock_irqsave(&ch->lock, flags);
+
+	q = ch->q;
+	if (!q) {
+		ret = -ENXIO;
+		goto out;
+	}
+
+	if (sqe->op != EVL_BLKIO_FLUSH) {
+		len = (size_t)sqe->nr_sectors << q->sector_shift;
+		ubuf = evl_get_ubuf(u_buf, len);
+		if (!ubuf) {
+			ret = -EFAULT;
+			goto out;
+		}
+	}
+
+	tag = find_first_zero_bit(ch->busy, ch->depth);
+	if (tag >= ch->depth) {
+		ret = -EAGAIN;
+		goto fail;
+	}
+
+	slot = ch->slots + tag;
+	slot->req.op = sqe->op;
+	slot->req.tag = tag;
+	if (ubuf) {
+		slot->req.sector = ch->start + sqe->sector;
+		slot->req.nr_sectors = sqe->nr_sectors;
+		slot->req.pages = ubuf->pages +
+			(((unsigned long)u_buf & PAGE_MASK) -
+				(ubuf->start & PAGE_MASK)) / PAGE_SIZE;
+		slot->req.offset = offset_in_page(u_buf);
+		slot->req.vaddr = evl_ubuf_ptr(ubuf, u_buf);
+	} else {
+		slot->req.sector = 0;
+		slot->req.nr_sectors = 0;
+		slot->req.pages = NULL;
+		slot->req.offset = 0;
+		slot->req.vaddr = NULL;
+	}
+
+	ret = q->ops->submit(q, &slot->req);
+	if (ret)
+		goto fail;
+
+	slot->ubuf = ubuf;
+	slot->cookie = sqe->cookie;
+	__set_bit(tag, ch->busy);
+	ch->inflight++;
+	raw_spin_unlock_irqrestore(&ch->lock, flags);
+
+	return 0;
+fail:
+	if (ubuf)
+		evl_put_ubuf(ubuf);
+out:
+	raw_spin_unlock_irqrestore(&ch->lock, flags);
+
+	return ret;
+}
+
+static int reap_completions(struct blkio_channel *ch,
+			struct evl_blkio_cqe *cqes, unsigned int max)
+{
+	struct evl_blkio_queue *q;
+	unsigned long flags;
+	unsigned int n;
+
+	raw_spin_lock_irqsave(&ch->lock, flags);
+
+	q = ch->q;
+	if (q && ch->inflight)
+		q->ops->poll(q);
+	else if (!q && !ch->nr_done) {
+		raw_spin_unlock_irqrestore(&ch->lock, flags);
+		return -ENXIO;
+	}
+
+	for (n = 0; n < max && ch->nr_done > 0; n++) {
+		cqes[n] = ch->cqes[ch->cq_head];
+		ch->cq_head = (ch->cq_head + 1) % ch->depth;
+		ch->nr_done--;
+	}
+
+	raw_spin_unlock_irqrestore(&ch->lock, flags);
+
+	return n;
+}
+
+static int poll_completions(struct blkio_channel *ch,
+			struct evl_blkio_pollreq *preq)
+{
+	struct evl_blkio_cqe batch[BLKIO_POLL_BATCH], __user *u_cqes;
+	ktime_t deadline = 0;
+	unsigned int count = 0;
+	int n;
+
+	u_cqes = evl_valptr64(preq->cqes_ptr, struct evl_blkio_cqe);
+
+	if (preq->spin_ns)
+		deadline = ktime_add_ns(evl_read_clock(&evl_mono_clock),
+					preq->spin_ns);
+
+	while (count < preq->nr) {
+		n = reap_completions(ch, batch,
+				min_t(unsigned int, preq->nr - count,
+					BLKIO_POLL_BATCH));
+		if (n < 0)
+			return count ?: n;
+
+		if (n > 0) {
+			if (raw_copy_to_user(u_cqes + count, batch,
+						n * sizeof(batch[0])))
+				return -EFAULT;
+			count += n;
+			continue;
+		}
+
+		if (count || !deadline ||
+			evl_read_clock(&evl_mono_clock) >= deadline)
+			break;
+
+		cpu_relax();
+	}
+
+	return count;
+}
+
+static long blkio_oob_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	struct blkio_channel *ch = filp->private_data;
+	struct evl_blkio_pollreq preq;
+	struct evl_blkio_sqe sqe;
+	long ret;
+
+	switch (cmd) {
+	case EVL_BLKIOC_SUBMIT:
+		if (raw_copy_from_user(&sqe, (void __user *)arg, sizeof(sqe)))
+			return -EFAULT;
+		ret = submit_request(ch, &sqe);
+		break;
+	case EVL_BLKIOC_POLL:
+		if (raw_copy_from_user(&preq, (void __user *)arg, sizeof(preq)))
+			return -EFAULT;
+		ret = poll_completions(ch, &preq);
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+static long blkio_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	struct blkio_channel *ch = filp->private_data;
+	struct evl_blkio_bindreq breq, __user *u_breq;
+	long ret;
+
+	if (cmd != EVL_BLKIOC_BIND)
+		return -ENOTTY;
+
+	u_breq = (typeof(u_breq))arg;
+	if (copy_from_user(&breq, u_breq, sizeof(breq)))
+		return -EFAULT;
+
+	ret = bind_channel(ch, &breq);
+	if (ret)
+		return ret;
+
+	return copy_to_user(u_breq, &breq, sizeof(breq)) ? -EFAULT : 0;
+}
+
+static int blkio_open(struct inode *inode, struct file *filp)
+{
+	struct blkio_channel *ch;
+	int ret;
+
+	ch = kzalloc(sizeof(*ch), GFP_KERNEL);
+	if (ch == NULL)
+		return -ENOMEM;
+
+	ret = evl_open_file(&ch->efile, filp);
+	if (ret) {
+		kfree(ch);
+		return ret;
+	}
+
+	raw_spin_lock_init(&ch->lock);
+	filp->private_data = ch;
+	stream_open(inode, filp);
+
+	return 0;
+}
+
+static void drain_channel(struct blkio_channel *ch)
+{
+	struct evl_blkio_queue *q;
+	unsigned long flags;
+	bool busy;
+
+	/*
+	 * The device may still be writing to the buffers of the
+	 * requests in flight, wait for all of them to complete
+	 * before the underlying pages can be unpinned.
+	 */
+	for (;;) {
+		raw_spin_lock_irqsave(&ch->lock, flags);
+		q = ch->q;
+		if (q && ch->inflight)
+			q->ops->poll(q);
+		busy = q && ch->inflight;
+		raw_spin_unlock_irqrestore(&ch->lock, flags);
+		if (!busy)
+			break;
+		usleep_range(100, 200);
+	}
+}
+
+static int blkio_release(struct inode *inode, struct file *filp)
+{
+	struct blkio_channel *ch = filp->private_data;
+	unsigned long flags;
+
+	/* No more oob callers past this point. */
+	evl_release_file(&ch->efile);
+
+	drain_channel(ch);
+
+	mutex_lock(&queue_lock);
+	if (ch->q) {
+		ch->q->owner = NULL;
+		raw_spin_lock_irqsave(&ch->lock, flags);
+		ch->q = NULL;
+		raw_spin_unlock_irqrestore(&ch->lock, flags);
+	}
+	mutex_unlock(&queue_lock);
+
+	kfree(ch->slots);
+	kfree(ch->cqes);
+	bitmap_free(ch->busy);
+	kfree(ch);
+
+	return 0;
+}
+
+static const struct file_operations blkio_fops = {
+	.open		= blkio_open,
+	.release	= blkio_release,
+	.unlocked_ioctl	= blkio_ioctl,
+	.oob_ioctl	= blkio_oob_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl	= compat_ptr_ioctl,
+	.compat_oob_ioctl  = compat_ptr_oob_ioctl,
+#endif
+};
+
+struct evl_factory evl_blkio_factory = {
+	.name	=	EVL_BLKIO_DEV,
+	.fops	=	&blkio_fops,
+	.flags	=	EVL_FACTORY_SINGLE,
+};
@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/anon_inodes.h>
 #include <linux/file.h>
+#include <linux/math64.h>
 #include <evl/sched.h>
 #include <evl/timer.h>
 #include <evl/clock.h>
@@ -32,7 +33,9 @@
 #include <evl/control.h>
 #include <evl/file.h>
 #include <evl/irq.h>
+#include <evl/memory.h>
 #include <evl/uaccess.h>
+#include <evl/flightrec.h>
 #include <asm/evl/calibration.h>
 #include <trace/events/evl.h>
 
@@ -42,88 +45,74 @@ static LIST_HEAD(clock_list);
 
 static DEFINE_MUTEX(clocklist_lock);
 
-/* timer base locked */
-static void adjust_timer(struct evl_clock *clock,
-			struct evl_timer *timer, struct evl_tqueue *q,
-			ktime_t delta)
+/*
+ * timer base locked. When a clock is stepped backward, make the
+ * periodic timers which already ticked resume in the new timeline,
+ * instead of waiting for their next date in the old one to come.
+ */
+static void rewind_periodic_timers(struct evl_clock *clock,
+				struct evl_tqueue *tq)
 {
-	ktime_t period, diff;
+	struct evl_timer *timer, *tmp;
+	ktime_t now, diff, period;
+	struct list_head adjq;
+	struct evl_tnode *tn;
 	s64 div;
 
-	/* Apply the new offset from the master base. */
-	evl_tdate(timer) = ktime_sub(evl_tdate(timer), delta);
-
-	if (!evl_timer_is_periodic(timer))
-		goto enqueue;
+	INIT_LIST_HEAD(&adjq);
+	now = evl_read_clock(clock);
 
-	timer->start_date = ktime_sub(timer->start_date, delta);
-	period = timer->interval;
-	diff = ktime_sub(evl_read_clock(clock), evl_get_timer_expiry(timer));
+	for_each_evl_tnode(tn, tq) {
+		timer = container_of(tn, struct evl_timer, node);
+		if (!evl_timer_is_periodic(timer) ||
+			!(timer->status & EVL_TIMER_FIRED))
+			continue;
+		diff = ktime_sub(now, evl_get_timer_expiry(timer));
+		if (ktime_add(diff, timer->interval) <= 0)
+			list_add_tail(&timer->adjlink, &adjq);
+	}
 
-	if (diff >= period) {
-		/*
-		 * Timer should tick several times before now, instead
-		 * of calling timer->handler several times, we change
-		 * the timer date without changing its pexpect, so
-		 * that timer will tick only once and the lost ticks
-		 * will be counted as overruns.
-		 */
-		div = ktime_divns(diff, ktime_to_ns(period));
-		timer->periodic_ticks += div;
-		evl_update_timer_date(timer);
-	} else if (ktime_to_ns(delta) < 0
-		&& (timer->status & EVL_TIMER_FIRED)
-		&& ktime_to_ns(ktime_add(diff, period)) <= 0) {
-		/*
-		 * Timer is periodic and NOT waiting for its first
-		 * shot, so we make it tick sooner than its original
-		 * date in order to avoid the case where by adjusting
-		 * time to a sooner date, real-time periodic timers do
-		 * not tick until the original date has passed.
-		 */
+	list_for_each_entry_safe(timer, tmp, &adjq, adjlink) {
+		list_del(&timer->adjlink);
+		evl_dequeue_timer(timer, tq);
+		period = timer->interval;
+		diff = ktime_sub(now, evl_get_timer_expiry(timer));
 		div = ktime_divns(-diff, ktime_to_ns(period));
 		timer->periodic_ticks -= div;
 		timer->consumed_ticks -= div;
 		evl_update_timer_date(timer);
+		evl_enqueue_timer(timer, tq);
 	}
-
-enqueue:
-	evl_enqueue_timer(timer, q);
 }
 
+/*
+ * The offset of @clock from its master changed by @delta. Since
+ * timers are queued by date relative to their own clock, there is
+ * nothing to requeue, we only have to reprogram the shot on every
+ * CPU which has timers pending on @clock. The only exception is a
+ * backward step, which requires rewinding the periodic timers.
+ * Forward steps are handled as overruns by the tick handler, which
+ * fires the overdue timers once.
+ */
 void evl_adjust_timers(struct evl_clock *clock, ktime_t delta)
 {
-	struct evl_timer *timer, *tmp;
 	struct evl_timerbase *tmb;
 	struct evl_tqueue *tq;
-	struct evl_tnode *tn;
-	struct list_head adjq;
 	struct evl_rq *rq;
 	unsigned long flags;
 	int cpu;
 
-	INIT_LIST_HEAD(&adjq);
-
 	for_each_online_cpu(cpu) {
 		rq = evl_cpu_rq(cpu);
 		tmb = evl_percpu_timers(clock, cpu);
-		tq = &tmb->q;
+		tq = evl_percpu_tqueue(clock, cpu);
 		raw_spin_lock_irqsave(&tmb->lock, flags);
 
-		for_each_evl_tnode(tn, tq) {
-			timer = container_of(tn, struct evl_timer, node);
-			if (timer->clock == clock)
-				list_add_tail(&timer->adjlink, &adjq);
-		}
-
-		if (list_empty(&adjq))
+		if (evl_tqueue_is_empty(tq))
 			goto next;
 
-		list_for_each_entry_safe(timer, tmp, &adjq, adjlink) {
-			list_del(&timer->adjlink);
-			evl_dequeue_timer(timer, tq);
-			adjust_timer(clock, timer, tq, delta);
-		}
+		if (delta < 0)
+			rewind_periodic_timers(clock, tq);
 
 		if (rq != this_evl_rq())
 			evl_program_remote_tick(clock, rq);
@@ -152,6 +141,57 @@ void inband_clock_was_set(void)
 	mutex_unlock(&clocklist_lock);
 }
 
+/*
+ * Update the conversion parameters user code may use for reading
+ * @clock locklessly. Updates are serialized by the caller, they all
+ * happen in-band for a given clock.
+ */
+void evl_publish_clock_state(struct evl_clock *clock,
+			ktime_t mono_ref, ktime_t base,
+			u64 mult, u32 shift)
+{
+	struct evl_clock_state *st = clock->u_state;
+
+	if (st == NULL)
+		return;
+
+	WRITE_ONCE(st->seq, st->seq + 1);
+	smp_wmb();
+	WRITE_ONCE(st->mono_ref, mono_ref);
+	WRITE_ONCE(st->base, base);
+	WRITE_ONCE(st->mult, mult);
+	WRITE_ONCE(st->shift, shift);
+	smp_wmb();
+	WRITE_ONCE(st->seq, st->seq + 1);
+}
+EXPORT_SYMBOL_GPL(evl_publish_clock_state);
+
+#ifdef CONFIG_EVL_RUNSTATS
+
+static inline int alloc_lateness_stats(struct evl_clock *clock)
+{
+	clock->lateness = alloc_percpu(struct evl_clock_lateness);
+
+	return clock->lateness ? 0 : -ENOMEM;
+}
+
+static inline void free_lateness_stats(struct evl_clock *clock)
+{
+	free_percpu(clock->lateness);
+}
+
+#else
+
+static inline int alloc_lateness_stats(struct evl_clock *clock)
+{
+	return 0;
+}
+
+static inline void free_lateness_stats(struct evl_clock *clock)
+{ }
+
+#endif
+
 static int init_clock(struct evl_clock *clock, struct evl_clock *master)
 {
 	int ret;
@@ -163,6 +203,28 @@ static int init_clock(struct evl_clock *clock, struct evl_clock *master)
 
 	clock->master = master;
 
+	ret = alloc_lateness_stats(clock);
+	if (ret) {
+		evl_destroy_element(&clock->element);
+		return ret;
+	}
+
+	clock->u_state = evl_zalloc_chunk(&evl_shared_heap,
+					sizeof(*clock->u_state));
+	if (clock->u_state == NULL) {
+		free_lateness_stats(clock);
+		evl_destroy_element(&clock->element);
+		return -ENOMEM;
+	}
+
+	/*
+	 * Any clock ticking on the monotonic clock device is
+	 * readable from user space: the monotonic clock itself and
+	 * its slaves, which are offset from it.
+	 */
+	if (master == &evl_mono_clock)
+		evl_publish_clock_offset(clock);
+
 	/*
 	 * Once the device appears in the filesystem, it has to be
 	 * usable. Make sure all inits have been completed before this
@@ -172,6 +234,8 @@ static int init_clock(struct evl_clock *clock, struct evl_clock *master)
 					&evl_clock_factory,
 					clock->name);
 	if (ret) {
+		evl_free_chunk(&evl_shared_heap, clock->u_state);
+		free_lateness_stats(clock);
 		evl_destroy_element(&clock->element);
 		return ret;
 	}
@@ -226,6 +290,7 @@ int evl_init_clock(struct evl_clock *clock,
 	for_each_online_cpu(cpu) {
 		tmb = evl_percpu_timers(clock, cpu);
 		evl_init_tqueue(&tmb->q);
+		INIT_LIST_HEAD(&tmb->slaves);
 		raw_spin_lock_init(&tmb->lock);
 	}
 
@@ -249,21 +314,66 @@ fail:
 }
 EXPORT_SYMBOL_GPL(evl_init_clock);
 
+static void unlink_slave_tqueues(struct evl_clock *clock)
+{
+	struct evl_slave_tqueue *sq;
+	struct evl_timerbase *tmb;
+	unsigned long flags;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		tmb = evl_percpu_timers(clock, cpu);
+		sq = per_cpu_ptr(clock->slavedata, cpu);
+		raw_spin_lock_irqsave(&tmb->lock, flags);
+		list_del(&sq->next);
+		raw_spin_unlock_irqrestore(&tmb->lock, flags);
+		EVL_WARN_ON(CORE, !evl_tqueue_is_empty(&sq->q));
+		evl_destroy_tqueue(&sq->q);
+	}
+
+	free_percpu(clock->slavedata);
+}
+
 int evl_init_slave_clock(struct evl_clock *clock,
 			struct evl_clock *master)
 {
+	struct evl_slave_tqueue *sq;
+	struct evl_timerbase *tmb;
+	unsigned long flags;
+	int cpu, ret;
+
 	inband_context_only();
 
-	/* A slave clock shares its master's device. */
+	/*
+	 * A slave clock shares its master's device and timer bases,
+	 * queuing its own timers separately though.
+	 */
 #ifdef CONFIG_SMP
 	clock->affinity = master->affinity;
 #endif
 	clock->timerdata = master->timerdata;
+	clock->slavedata = alloc_percpu(struct evl_slave_tqueue);
+	if (clock->slavedata == NULL)
+		return -ENOMEM;
+
+	for_each_online_cpu(cpu) {
+		tmb = evl_percpu_timers(clock, cpu);
+		sq = per_cpu_ptr(clock->slavedata, cpu);
+		evl_init_tqueue(&sq->q);
+		sq->clock = clock;
+		raw_spin_lock_irqsave(&tmb->lock, flags);
+		list_add_tail(&sq->next, &tmb->slaves);
+		raw_spin_unlock_irqrestore(&tmb->lock, flags);
+	}
+
 	clock->offset = evl_read_clock(clock) -
 		evl_read_clock(master);
-	init_clock(clock, master);
 
-	return 0;
+	ret = init_clock(clock, master);
+	if (ret)
+		unlink_slave_tqueues(clock);
+
+	return ret;
 }
 EXPORT_SYMBOL_GPL(evl_init_slave_clock);
 
@@ -280,30 +390,49 @@ static inline bool timer_needs_enqueuing(struct evl_timer *timer)
 			EVL_TIMER_RUNNING);
 }
 
-/* hard irqs off */
-static void do_clock_tick(struct evl_clock *clock, struct evl_timerbase *tmb)
+/*
+ * Read the current time from @clock, extrapolated from its master
+ * which is the time reference for programming the shots.
+ */
+static inline ktime_t read_tqueue_clock(struct evl_clock *clock)
 {
-	struct evl_rq *rq = this_evl_rq();
-	struct evl_timer *timer;
-	struct evl_tqueue *tq;
-	struct evl_tnode *tn;
-	ktime_t now;
+	return ktime_add(evl_read_clock(clock->master), clock->offset);
+}
 
-	if (EVL_WARN_ON_ONCE(CORE, !hard_irqs_disabled()))
-		hard_local_irq_disable();
+#if defined(CONFIG_EVL_TIMER_HOUSEKEEPING) && defined(CONFIG_EVL_RUNSTATS)
 
-	tq = &tmb->q;
-	raw_spin_lock(&tmb->lock);
+/*
+ * Only the housekeeping CPU fires timers on behalf of other CPUs,
+ * so it is the single writer of these counters.
+ */
+static inline void account_timer_offload(struct evl_timer *timer,
+					struct evl_rq *rq)
+{
+	struct evl_rq *home_rq = READ_ONCE(timer->home_rq);
 
-	/*
-	 * Optimisation: any local timer reprogramming triggered by
-	 * invoked timer handlers can wait until we leave this tick
-	 * handler. This is a hint for the program_local_shot()
-	 * handler of the ticking clock.
-	 */
-	rq->local_flags |= RQ_TIMER;
+	if ((timer->status & EVL_TIMER_NONCRIT) && home_rq && home_rq != rq) {
+		WRITE_ONCE(home_rq->timer_offloads, home_rq->timer_offloads + 1);
+		WRITE_ONCE(rq->timer_hosted, rq->timer_hosted + 1);
+	}
+}
 
-	now = evl_read_clock(clock);
+#else
+
+static inline void account_timer_offload(struct evl_timer *timer,
+					struct evl_rq *rq)
+{ }
+
+#endif
+
+/* hard irqs off, tmb->lock held (dropped temporarily) */
+static void fire_timers(struct evl_rq *rq, struct evl_timerbase *tmb,
+			struct evl_clock *clock, struct evl_tqueue *tq)
+{
+	struct evl_timer *timer;
+	struct evl_tnode *tn;
+	ktime_t now;
+
+	now = read_tqueue_clock(clock);
 	while ((tn = evl_get_tqueue_head(tq)) != NULL) {
 		timer = container_of(tn, struct evl_timer, node);
 		if (now < evl_tdate(timer))
@@ -312,6 +441,7 @@ static void do_clock_tick(struct evl_clock *clock, struct evl_timerbase *tmb)
 		trace_evl_timer_expire(timer);
 		evl_dequeue_timer(timer, tq);
 		evl_account_timer_fired(timer);
+		account_timer_offload(timer, rq);
 		timer->status |= EVL_TIMER_FIRED;
 
 		/*
@@ -325,9 +455,12 @@ static void do_clock_tick(struct evl_clock *clock, struct evl_timerbase *tmb)
 			continue;
 		}
 
+		evl_account_timer_lateness(timer, now);
+		evl_flightrec_timer(ktime_sub(now, evl_get_timer_expiry(timer)));
+
 		raw_spin_unlock(&tmb->lock);
 		timer->handler(timer);
-		now = evl_read_clock(clock);
+		now = read_tqueue_clock(clock);
 		raw_spin_lock(&tmb->lock);
 
 		if (timer_needs_enqueuing(timer)) {
@@ -335,10 +468,44 @@ static void do_clock_tick(struct evl_clock *clock, struct evl_timerbase *tmb)
 				timer->periodic_ticks++;
 				evl_update_timer_date(timer);
 			} while (evl_tdate(timer) < now);
-			if (likely(evl_timer_on_rq(timer, rq)))
-				evl_enqueue_timer(timer, tq);
+			if (likely(evl_timer_on_rq(timer, rq) &&
+					timer->base == tmb))
+				evl_enqueue_timer(timer, timer->tq);
 		}
 	}
+}
+
+/* hard irqs off */
+static void do_clock_tick(struct evl_clock *clock, struct evl_timerbase *tmb)
+{
+	struct evl_rq *rq = this_evl_rq();
+	struct evl_slave_tqueue *sq;
+
+	if (EVL_WARN_ON_ONCE(CORE, !hard_irqs_disabled()))
+		hard_local_irq_disable();
+
+	raw_spin_lock(&tmb->lock);
+
+	/* We are awake, no anticipation needed anymore. */
+	evl_clear_idle_lead(rq);
+
+	/*
+	 * Optimisation: any local timer reprogramming triggered by
+	 * invoked timer handlers can wait until we leave this tick
+	 * handler. This is a hint for the program_local_shot()
+	 * handler of the ticking clock.
+	 */
+	rq->local_flags |= RQ_TIMER;
+
+	fire_timers(rq, tmb, clock, &tmb->q);
+
+	/*
+	 * Slave clocks are unlinked from the timer base only once
+	 * no timer may be pending on them, so the list is stable
+	 * across the unlocked sections.
+	 */
+	list_for_each_entry(sq, &tmb->slaves, next)
+		fire_timers(rq, tmb, sq->clock, &sq->q);
 
 	rq->local_flags &= ~RQ_TIMER;
 
@@ -389,27 +556,39 @@ void evl_announce_tick(struct evl_clock *clock) /* hard irqs off */
 }
 EXPORT_SYMBOL_GPL(evl_announce_tick);
 
-void evl_stop_timers(struct evl_clock *clock)
+/* timer base locked. */
+static void deactivate_timers(struct evl_tqueue *tq)
 {
-	struct evl_timerbase *tmb;
 	struct evl_timer *timer;
-	struct evl_tqueue *tq;
 	struct evl_tnode *tn;
+
+	while (!evl_tqueue_is_empty(tq)) {
+		tn = evl_get_tqueue_head(tq);
+		timer = container_of(tn, struct evl_timer, node);
+		if (EVL_WARN_ON(CORE, timer->status & EVL_TIMER_DEQUEUED))
+			continue;
+		evl_timer_deactivate(timer);
+	}
+}
+
+void evl_stop_timers(struct evl_clock *clock)
+{
+	struct evl_slave_tqueue *sq;
+	struct evl_timerbase *tmb;
 	unsigned long flags;
 	int cpu;
 
-	/* Deactivate all outstanding timers on the clock. */
-
+	/*
+	 * Deactivate all outstanding timers on the clock, including
+	 * those of its slaves if @clock is a master.
+	 */
 	for_each_evl_cpu(cpu) {
 		tmb = evl_percpu_timers(clock, cpu);
 		raw_spin_lock_irqsave(&tmb->lock, flags);
-		tq = &tmb->q;
-		while (!evl_tqueue_is_empty(tq)) {
-			tn = evl_get_tqueue_head(tq);
-			timer = container_of(tn, struct evl_timer, node);
-			if (EVL_WARN_ON(CORE, timer->status & EVL_TIMER_DEQUEUED))
-				continue;
-			evl_timer_deactivate(timer);
+		deactivate_timers(evl_percpu_tqueue(clock, cpu));
+		if (clock->master == clock) {
+			list_for_each_entry(sq, &tmb->slaves, next)
+				deactivate_timers(&sq->q);
 		}
 		raw_spin_unlock_irqrestore(&tmb->lock, flags);
 	}
@@ -563,6 +742,7 @@ struct evl_timerfd {
 	struct evl_wait_queue readers;
 	struct evl_poll_head poll_head;
 	struct evl_file efile;
+	ktime_t expiry;
 	bool ticked;
 };
 
@@ -604,6 +784,7 @@ static void timerfd_handler(struct evl_timer *timer) /* hard IRQs off */
 	struct evl_timerfd *timerfd;
 
 	timerfd = container_of(timer, struct evl_timerfd, timer);
+	timerfd->expiry = evl_get_timer_expiry(timer);
 	timerfd->ticked = true;
 	evl_signal_poll_events(&timerfd->poll_head, POLLIN|POLLRDNORM);
 	evl_flush_wait(&timerfd->readers, 0);
@@ -619,13 +800,25 @@ static bool read_timerfd_event(struct evl_timerfd *timerfd)
 	return false;
 }
 
+static u64 get_timerfd_ticks(struct evl_timerfd *timerfd)
+{
+	u64 ticks = 1;
+
+	if (evl_timer_is_periodic(&timerfd->timer))
+		ticks += evl_get_timer_overruns(&timerfd->timer);
+
+	return ticks;
+}
+
 static long timerfd_common_ioctl(struct file *filp,
 				unsigned int cmd, unsigned long arg)
 {
 	struct evl_timerfd *timerfd = filp->private_data;
 	struct __evl_itimerspec uits, uoits, __user *u_uits;
 	struct evl_timerfd_setreq sreq, __user *u_sreq;
+	struct __evl_timespec uts, __user *u_uts;
 	struct itimerspec64 its, oits;
+	struct timespec64 ts64;
 	long ret = 0;
 
 	switch (cmd) {
@@ -662,6 +855,23 @@ static long timerfd_common_ioctl(struct file *filp,
 		if (raw_copy_to_user(u_uits, &uits, sizeof(uits)))
 			return -EFAULT;
 		break;
+	case EVL_TFDIOC_SET_SLACK:
+		u_uts = (typeof(u_uts))arg;
+		if (raw_copy_from_user(&uts, u_uts, sizeof(uts)))
+			return -EFAULT;
+		if (uts.tv_sec < 0 ||
+			(unsigned long)uts.tv_nsec >= ONE_BILLION)
+			return -EINVAL;
+		ts64 = u_timespec_to_timespec64(uts);
+		evl_set_timer_slack(&timerfd->timer, timespec64_to_ktime(ts64));
+		break;
+	case EVL_TFDIOC_GET_SLACK:
+		ts64 = ktime_to_timespec64(READ_ONCE(timerfd->timer.slack));
+		uts = timespec64_to_u_timespec(ts64);
+		u_uts = (typeof(u_uts))arg;
+		if (raw_copy_to_user(u_uts, &uts, sizeof(uts)))
+			return -EFAULT;
+		break;
 	default:
 		ret = -ENOTTY;
 	}
@@ -688,10 +898,7 @@ static ssize_t timerfd_oob_read(struct file *filp,
 	if (ret)
 		return ret;
 
-	ticks = 1;
-	if (evl_timer_is_periodic(&timerfd->timer))
-		ticks += evl_get_timer_overruns(&timerfd->timer);
-
+	ticks = get_timerfd_ticks(timerfd);
 	if (raw_put_user(ticks, u_ticks))
 		return -EFAULT;
 
@@ -734,6 +941,41 @@ static const struct file_operations timerfd_fops = {
 #endif
 };
 
+/**
+ * evl_read_timerfd - read a timerfd without blocking
+ * @filp: the file which might be a timerfd
+ * @ticks: the count of expiries since the last read
+ * @expiry: the ideal date of the latest expiry, from the clock of
+ * the timer
+ *
+ * Same as a non-blocking oob_read() on a timerfd, without the
+ * syscall overhead for the caller which already has the file at
+ * hand. Returns -EINVAL if @filp is not a timerfd, -EAGAIN if the
+ * timer did not tick since the last read.
+ */
+int evl_read_timerfd(struct file *filp, u64 *ticks, ktime_t *expiry)
+{
+	struct evl_timerfd *timerfd;
+	unsigned long flags;
+	bool ticked;
+
+	if (filp->f_op != &timerfd_fops)
+		return -EINVAL;
+
+	timerfd = filp->private_data;
+	raw_spin_lock_irqsave(&timerfd->readers.wchan.lock, flags);
+	ticked = read_timerfd_event(timerfd);
+	*expiry = timerfd->expiry;
+	raw_spin_unlock_irqrestore(&timerfd->readers.wchan.lock, flags);
+
+	if (!ticked)
+		return -EAGAIN;
+
+	*ticks = get_timerfd_ticks(timerfd);
+
+	return 0;
+}
+
 static int new_timerfd(struct evl_clock *clock)
 {
 	struct evl_timerfd *timerfd;
@@ -759,6 +1001,7 @@ static int new_timerfd(struct evl_clock *clock)
 	evl_get_element(&clock->element);
 	evl_init_timer_on_rq(&timerfd->timer, clock, timerfd_handler,
 			NULL, EVL_TIMER_UGRAVITY);
+	evl_set_timer_class(&timerfd->timer, EVL_TIMER_CLASS_TIMERFD);
 	evl_init_wait(&timerfd->readers, clock, EVL_WAIT_PRIO);
 	evl_init_poll_head(&timerfd->poll_head);
 
@@ -816,6 +1059,10 @@ static long clock_common_ioctl(struct evl_clock *clock,
 		ts64 = u_timespec_to_timespec64(uts);
 		ret = set_clock_time(clock, ts64);
 		break;
+	case EVL_CLKIOC_GET_STATE:
+		ret = raw_put_user(evl_shared_offset(clock->u_state),
+			(__u32 __user *)arg) ? -EFAULT : 0;
+		break;
 	default:
 		ret = -ENOTTY;
 	}
@@ -906,22 +1153,24 @@ static void destroy_clock(struct evl_clock *clock)
 	inband_context_only();
 
 	/*
-	 * Slave clocks use the timer queues from their master.
+	 * Slave clocks use the timer bases from their master.
 	 */
-	if (clock->master != clock)
-		return;
-
-	for_each_online_cpu(cpu) {
-		tmb = evl_percpu_timers(clock, cpu);
-		EVL_WARN_ON(CORE, !evl_tqueue_is_empty(&tmb->q));
-		evl_destroy_tqueue(&tmb->q);
+	if (clock->master == clock) {
+		for_each_online_cpu(cpu) {
+			tmb = evl_percpu_timers(clock, cpu);
+			EVL_WARN_ON(CORE, !evl_tqueue_is_empty(&tmb->q));
+			evl_destroy_tqueue(&tmb->q);
+		}
+		free_percpu(clock->timerdata);
+	} else {
+		unlink_slave_tqueues(clock);
 	}
-
-	free_percpu(clock->timerdata);
 	mutex_lock(&clocklist_lock);
 	list_del(&clock->next);
 	mutex_unlock(&clocklist_lock);
 
+	evl_free_chunk(&evl_shared_heap, clock->u_state);
+	free_lateness_stats(clock);
 	evl_destroy_element(&clock->element);
 
 	if (clock->dispose)
@@ -1004,8 +1253,114 @@ out:
 
 static DEVICE_ATTR_RW(gravity);
 
+#ifdef CONFIG_EVL_RUNSTATS
+
+static const char *timer_class_labels[EVL_NR_TIMER_CLASSES] = {
+	[EVL_TIMER_CLASS_OTHER] = "other",
+	[EVL_TIMER_CLASS_TIMEOUT] = "timeout",
+	[EVL_TIMER_CLASS_PERIODIC] = "periodic",
+	[EVL_TIMER_CLASS_TIMERFD] = "timerfd",
+	[EVL_TIMER_CLASS_RR] = "rr",
+	[EVL_TIMER_CLASS_WATCHDOG] = "watchdog",
+	[EVL_TIMER_CLASS_BUDGET] = "budget",
+	[EVL_TIMER_CLASS_MEMGUARD] = "memguard",
+};
+
+/*
+ * One line per CPU and timer class which fired: cpu, class, count
+ * of expiries, min, average and max lateness (ns). Then one line
+ * per class, giving the histogram of the lateness over all CPUs,
+ * the n-th bucket counting the expiries late by [2^(n-1), 2^n) ns,
+ * the first one those which were not late.
+ */
+static ssize_t lateness_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	unsigned long hist[EVL_LATENESS_HIST_SIZE];
+	struct evl_timer_lateness *st;
+	struct evl_clock *clock;
+	int cpu, c, n, last;
+	ssize_t len = 0;
+	u64 count;
+
+	clock = evl_get_element_by_dev(dev, struct evl_clock);
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		for (c = 0; c < EVL_NR_TIMER_CLASSES; c++) {
+			st = &per_cpu_ptr(clock->lateness, cpu)->class[c];
+			count = READ_ONCE(st->count);
+			if (!count)
+				continue;
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					"%d %s %llu %lld %lld %lld\n",
+					cpu, timer_class_labels[c], count,
+					READ_ONCE(st->min),
+					div64_s64(READ_ONCE(st->sum), count),
+					READ_ONCE(st->max));
+		}
+	}
+
+	for (c = 0; c < EVL_NR_TIMER_CLASSES; c++) {
+		memset(hist, 0, sizeof(hist));
+		last = -1;
+		for_each_cpu(cpu, &evl_oob_cpus) {
+			st = &per_cpu_ptr(clock->lateness, cpu)->class[c];
+			for (n = 0; n < EVL_LATENESS_HIST_SIZE; n++) {
+				hist[n] += READ_ONCE(st->hist[n]);
+				if (hist[n])
+					last = max(last, n);
+			}
+		}
+		if (last < 0)
+			continue;
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s",
+				timer_class_labels[c]);
+		for (n = 0; n <= last; n++)
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					" %lu", hist[n]);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+
+	evl_put_element(&clock->element);
+
+	return len;
+}
+
+/* Writing anything resets the statistics. */
+static ssize_t lateness_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct evl_clock_lateness *cl;
+	struct evl_timerbase *tmb;
+	struct evl_clock *clock;
+	unsigned long flags;
+	int cpu;
+
+	clock = evl_get_element_by_dev(dev, struct evl_clock);
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		tmb = evl_percpu_timers(clock, cpu);
+		cl = per_cpu_ptr(clock->lateness, cpu);
+		raw_spin_lock_irqsave(&tmb->lock, flags);
+		memset(cl, 0, sizeof(*cl));
+		raw_spin_unlock_irqrestore(&tmb->lock, flags);
+	}
+
+	evl_put_element(&clock->element);
+
+	return count;
+}
+static DEVICE_ATTR_RW(lateness);
+
+#endif
+
 static struct attribute *clock_attrs[] = {
 	&dev_attr_gravity.attr,
+#ifdef CONFIG_EVL_RUNSTATS
+	&dev_attr_lateness.attr,
+#endif
 	NULL,
 };
 ATTRIBUTE_GROUPS(clock);
@@ -1078,6 +1433,7 @@ static void adjust_realtime_clock(struct evl_clock *clock)
 	clock->offset = evl_read_clock(clock) -
 		evl_read_clock(&evl_mono_clock);
 
+	evl_publish_clock_offset(clock);
 	evl_adjust_timers(clock, clock->offset - old_offset);
 }
 
@@ -6,13 +6,22 @@
 
 #include <linux/types.h>
 #include <linux/mm.h>
+#include <linux/huge_mm.h>
+#include <linux/pfn_t.h>
+#include <linux/sched/mm.h>
 #include <linux/sched/isolation.h>
 #include <linux/bitmap.h>
 #include <evl/memory.h>
 #include <evl/factory.h>
 #include <evl/tick.h>
+#include <evl/sched.h>
 #include <evl/control.h>
+#include <evl/lockstat.h>
+#include <evl/statmap.h>
+#include <evl/work.h>
 #include <evl/uaccess.h>
+#include <evl/uio.h>
+#include <evl/irqshield.h>
 #include <asm/evl/fptest.h>
 
 static BLOCKING_NOTIFIER_HEAD(state_notifier_list);
@@ -248,11 +257,78 @@ static int do_cpu_state(struct evl_cpu_state *cpst)
 				      sizeof(state)) ? -EFAULT : 0;
 }
 
+/*
+ * Suspend or resume a set of threads from the caller's process at
+ * once. All handles are resolved and checked before any thread is
+ * touched, so that the request either applies to the whole set, or
+ * fails with no effect.
+ */
+static int do_thread_set(const struct evl_thread_set_req *req, bool hold)
+{
+	struct oob_mm_state *oob_mm = dovetail_mm_state();
+	struct evl_thread **threads, *thread;
+	int nr = req->nr_threads, n, ret = 0;
+	fundle_t *fundles;
+
+	if (nr == 0 || nr > EVL_THREAD_SET_MAX)
+		return -EINVAL;
+
+	threads = evl_alloc(nr * (sizeof(*threads) + sizeof(*fundles)));
+	if (!threads)
+		return -ENOMEM;
+
+	fundles = (fundle_t *)(threads + nr);
+	if (raw_copy_from_user_ptr64(fundles, req->fundles_ptr,
+					nr * sizeof(*fundles))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	for (n = 0; n < nr; n++) {
+		thread = evl_get_factory_element_by_fundle(&evl_thread_factory,
+					fundles[n], struct evl_thread);
+		if (!thread) {
+			ret = -ESRCH;
+			break;
+		}
+		threads[n] = thread;
+		if (thread == evl_current()) {
+			ret = -EDEADLK;
+		} else if (thread->oob_mm != oob_mm ||
+			!(thread->state & EVL_T_USER)) {
+			ret = -EPERM;
+		} else if (thread->state & (EVL_T_DORMANT|EVL_T_ZOMBIE)) {
+			ret = -ESRCH;
+		}
+		if (ret) {
+			n++;
+			break;
+		}
+	}
+
+	if (!ret) {
+		if (hold)
+			evl_hold_thread_set(threads, nr, EVL_T_SUSP);
+		else
+			evl_release_thread_set(threads, nr, EVL_T_SUSP, 0);
+	}
+
+	while (--n >= 0)
+		evl_put_element(&threads[n]->element);
+out:
+	evl_free(threads);
+
+	return ret;
+}
+
 static long control_common_ioctl(struct file *filp, unsigned int cmd,
 			unsigned long arg)
 {
 	struct evl_cpu_state cpst = { .state_ptr = 0 }, __user *u_cpst;
+	struct evl_heap_stats hst, __user *u_hst;
+	struct evl_statmap_info smi;
 	struct evl_sched_ctlreq ctl, __user *u_ctl;
+	struct evl_thread_set_req tsr;
 	long ret;
 
 	switch (cmd) {
@@ -270,6 +346,30 @@ static long control_common_ioctl(struct file *filp, unsigned int cmd,
 			return -EFAULT;
 		ret = do_cpu_state(&cpst);
 		break;
+	case EVL_CTLIOC_GET_HEAPSTATS:
+		u_hst = (typeof(u_hst))arg;
+		ret = raw_copy_from_user(&hst.heap, &u_hst->heap,
+					sizeof(hst.heap));
+		if (ret)
+			return -EFAULT;
+		ret = evl_get_core_heap_stats(&hst);
+		if (!ret && raw_copy_to_user(u_hst, &hst, sizeof(hst)))
+			ret = -EFAULT;
+		break;
+	case EVL_CTLIOC_GET_STATMAP:
+		ret = evl_get_statmap_info(&smi);
+		if (!ret && raw_copy_to_user((struct evl_statmap_info __user *)arg,
+						&smi, sizeof(smi)))
+			ret = -EFAULT;
+		break;
+	case EVL_CTLIOC_HOLD_SET:
+	case EVL_CTLIOC_RELEASE_SET:
+		ret = raw_copy_from_user(&tsr, (struct evl_thread_set_req __user *)arg,
+					sizeof(tsr));
+		if (ret)
+			return -EFAULT;
+		ret = do_thread_set(&tsr, cmd == EVL_CTLIOC_HOLD_SET);
+		break;
 	default:
 		ret = -ENOTTY;
 	}
@@ -316,10 +416,33 @@ static long control_oob_ioctl(struct file *filp, unsigned int cmd,
 static long control_ioctl(struct file *filp, unsigned int cmd,
 			unsigned long arg)
 {
+	struct oob_mm_state *oob_mm = dovetail_mm_state();
+	struct evl_privheap_req phreq;
 	struct evl_core_info info;
+	struct evl_ubuf_req ureq;
 	long ret;
 
 	switch (cmd) {
+	case EVL_CTLIOC_PIN_UBUF:
+	case EVL_CTLIOC_UNPIN_UBUF:
+		if (!oob_mm || !test_bit(EVL_MM_ACTIVE_BIT, &oob_mm->flags))
+			return -EPERM;
+		if (copy_from_user(&ureq, (struct evl_ubuf_req __user *)arg,
+					sizeof(ureq)))
+			return -EFAULT;
+		if (cmd == EVL_CTLIOC_PIN_UBUF)
+			ret = evl_pin_ubuf(oob_mm, ureq.addr, ureq.len);
+		else
+			ret = evl_unpin_ubuf(oob_mm, ureq.addr);
+		break;
+	case EVL_CTLIOC_SET_PRIVHEAP:
+		if (!oob_mm || !test_bit(EVL_MM_ACTIVE_BIT, &oob_mm->flags))
+			return -EPERM;
+		if (copy_from_user(&phreq, (struct evl_privheap_req __user *)arg,
+					sizeof(phreq)))
+			return -EFAULT;
+		ret = evl_create_private_heap(oob_mm, phreq.size);
+		break;
 	case EVL_CTLIOC_GET_COREINFO:
 		info.abi_base = EVL_ABI_BASE;
 		info.abi_current = EVL_ABI_LEVEL;
@@ -335,15 +458,103 @@ static long control_ioctl(struct file *filp, unsigned int cmd,
 	return ret;
 }
 
+#ifdef CONFIG_EVL_SHARED_HUGEPAGE
+
+static inline unsigned long shm_pfn(struct vm_area_struct *vma,
+				unsigned long addr)
+{
+	void *p = evl_get_heap_base(&evl_shared_heap);
+
+	return (__pa(p) + addr - vma->vm_start) >> PAGE_SHIFT;
+}
+
+static vm_fault_t shm_fault(struct vm_fault *vmf)
+{
+	return vmf_insert_pfn(vmf->vma, vmf->address,
+			shm_pfn(vmf->vma, vmf->address));
+}
+
+static vm_fault_t shm_huge_fault(struct vm_fault *vmf, unsigned int order)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long addr = vmf->address & PMD_MASK, pfn;
+
+	if (order != PMD_ORDER)
+		return VM_FAULT_FALLBACK;
+
+	/*
+	 * The mapping should be PMD-aligned since we provide
+	 * thp_get_unmapped_area(), unless a fixed address was given.
+	 */
+	pfn = shm_pfn(vma, addr);
+	if (addr < vma->vm_start || addr + PMD_SIZE > vma->vm_end ||
+		!IS_ALIGNED(pfn, HPAGE_PMD_NR))
+		return VM_FAULT_FALLBACK;
+
+	return vmf_insert_pfn_pmd(vmf, pfn_to_pfn_t(pfn),
+				vmf->flags & FAULT_FLAG_WRITE);
+}
+
+static const struct vm_operations_struct shm_vm_ops = {
+	.fault = shm_fault,
+	.huge_fault = shm_huge_fault,
+};
+
+static unsigned long control_get_unmapped_area(struct file *filp,
+					unsigned long addr, unsigned long len,
+					unsigned long pgoff, unsigned long flags)
+{
+	if (evl_shm_hugepage)
+		return thp_get_unmapped_area(filp, addr, len, pgoff, flags);
+
+	return mm_get_unmapped_area(current->mm, filp, addr, len, pgoff, flags);
+}
+
+#endif
+
 static int control_mmap(struct file *filp, struct vm_area_struct *vma)
 {
 	void *p = evl_get_heap_base(&evl_shared_heap);
 	unsigned long pfn = __pa(p) >> PAGE_SHIFT;
 	size_t len = vma->vm_end - vma->vm_start;
+	int ret;
+
+	if (vma->vm_pgoff == EVL_STATMAP_OFFSET >> PAGE_SHIFT)
+		return evl_mmap_statmap(vma);
+
+	/*
+	 * A mapping extending past the shared heap covers the private
+	 * heap of the caller too. Since it is remapped in two parts,
+	 * the mapping has to be shared, and we cannot populate it on
+	 * demand with huge PMDs.
+	 */
+	if (len > evl_shm_size) {
+		if (!(vma->vm_flags & VM_SHARED))
+			return -EINVAL;
+		ret = remap_pfn_range(vma, vma->vm_start, pfn,
+				evl_shm_size, PAGE_SHARED);
+		if (ret)
+			return ret;
+		return evl_mmap_private_heap(vma, vma->vm_start + evl_shm_size);
+	}
 
 	if (len != evl_shm_size)
 		return -EINVAL;
 
+#ifdef CONFIG_EVL_SHARED_HUGEPAGE
+	/*
+	 * Populate shared mappings of a huge page backed heap on
+	 * demand, so that huge PMDs may be installed. Private
+	 * mappings still get regular PTEs.
+	 */
+	if (evl_shm_hugepage && (vma->vm_flags & VM_SHARED)) {
+		vm_flags_set(vma, VM_PFNMAP | VM_HUGEPAGE |
+			VM_DONTEXPAND | VM_DONTDUMP);
+		vma->vm_ops = &shm_vm_ops;
+		return 0;
+	}
+#endif
+
 	return remap_pfn_range(vma, vma->vm_start, pfn, len, PAGE_SHARED);
 }
 
@@ -352,6 +563,9 @@ static const struct file_operations control_fops = {
 	.oob_ioctl	=	control_oob_ioctl,
 	.unlocked_ioctl	=	control_ioctl,
 	.mmap		=	control_mmap,
+#ifdef CONFIG_EVL_SHARED_HUGEPAGE
+	.get_unmapped_area =	control_get_unmapped_area,
+#endif
 #ifdef CONFIG_COMPAT
 	.compat_ioctl	= compat_ptr_ioctl,
 	.compat_oob_ioctl  = compat_ptr_oob_ioctl,
@@ -411,6 +625,15 @@ static ssize_t cpus_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(cpus);
 
+static ssize_t tickless_cpus_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%*pbl\n",
+			cpumask_pr_args(&evl_tickless_cpus));
+}
+static DEVICE_ATTR_RO(tickless_cpus);
+
 #ifdef CONFIG_EVL_SCHED_QUOTA
 
 static ssize_t quota_show(struct device *dev,
@@ -459,15 +682,478 @@ static DEVICE_ATTR_RO(tp);
 
 #endif
 
+#ifdef CONFIG_EVL_DEBUG_SWSTATS
+
+/*
+ * One line per out-of-band CPU, the CPU number is followed by the
+ * counts for each log2-scaled bucket (see EVL_SWSTAT_BUCKETS).
+ */
+static ssize_t show_swstats(char *buf, enum evl_swstat_kind kind)
+{
+	unsigned long *hist;
+	ssize_t len = 0;
+	int cpu, n;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		hist = evl_cpu_rq(cpu)->swstats.hist[kind];
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d", cpu);
+		for (n = 0; n < EVL_SWSTAT_BUCKETS; n++)
+			len += scnprintf(buf + len, PAGE_SIZE - len,
+					" %lu", READ_ONCE(hist[n]));
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+
+	return len;
+}
+
+static ssize_t switch_pick_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	return show_swstats(buf, EVL_SWSTAT_PICK);
+}
+static DEVICE_ATTR_RO(switch_pick);
+
+static ssize_t switch_time_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	return show_swstats(buf, EVL_SWSTAT_SWITCH);
+}
+static DEVICE_ATTR_RO(switch_time);
+
+static ssize_t switch_irqoff_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	return show_swstats(buf, EVL_SWSTAT_IRQOFF);
+}
+static DEVICE_ATTR_RO(switch_irqoff);
+
+#endif
+
+#if defined(CONFIG_SMP) && defined(CONFIG_EVL_RUNSTATS)
+
+/*
+ * One line per out-of-band CPU: count of remote rescheduling IPIs
+ * sent from that CPU, and count of remote rescheduling requests
+ * which were merged into a pending IPI instead.
+ */
+static ssize_t resched_ipis_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	struct evl_rq *rq;
+	ssize_t len = 0;
+	int cpu;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		rq = evl_cpu_rq(cpu);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %lu %lu\n",
+				cpu, READ_ONCE(rq->resched_ipis),
+				READ_ONCE(rq->resched_merged));
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(resched_ipis);
+
+#endif
+
+#if defined(CONFIG_EVL_TIMER_HOUSEKEEPING) && defined(CONFIG_EVL_RUNSTATS)
+
+/*
+ * One line per out-of-band CPU: count of timer shots the
+ * housekeeping CPU took over from that CPU, and count of shots it
+ * fired on behalf of other CPUs.
+ */
+static ssize_t timer_offloads_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	struct evl_rq *rq;
+	ssize_t len = 0;
+	int cpu;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		rq = evl_cpu_rq(cpu);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %lu %lu\n",
+				cpu, READ_ONCE(rq->timer_offloads),
+				READ_ONCE(rq->timer_hosted));
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(timer_offloads);
+
+#endif
+
+#if defined(CONFIG_EVL_PREEMPT_DEFER) && defined(CONFIG_EVL_RUNSTATS)
+
+/*
+ * One line per out-of-band CPU: count of preemption deferrals
+ * granted to threads running on that CPU, and count of those which
+ * ran out of grace before the thread yielded.
+ */
+static ssize_t preempt_deferrals_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	struct evl_rq *rq;
+	ssize_t len = 0;
+	int cpu;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		rq = evl_cpu_rq(cpu);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %lu %lu\n",
+				cpu, READ_ONCE(rq->defer_granted),
+				READ_ONCE(rq->defer_expired));
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(preempt_deferrals);
+
+#endif
+
+#ifdef CONFIG_EVL_RUNSTATS
+
+/*
+ * One line per out-of-band CPU: count of context switches from that
+ * CPU which had to change address spaces, and count of those which
+ * could keep the active mm.
+ */
+static ssize_t mm_switches_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	struct evl_rq *rq;
+	ssize_t len = 0;
+	int cpu;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		rq = evl_cpu_rq(cpu);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %lu %lu\n",
+				cpu, READ_ONCE(rq->mm_switches),
+				READ_ONCE(rq->mm_lazy));
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(mm_switches);
+
+/*
+ * One line per out-of-band CPU: count of lock chain walks started
+ * from that CPU, total and maximum number of wait channels visited,
+ * and count of walks cut off early since no priority change had to
+ * be propagated any further.
+ */
+static ssize_t pi_walks_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_pi_stats *st;
+	ssize_t len = 0;
+	int cpu;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		st = &evl_cpu_rq(cpu)->pi_stats;
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				"%d %lu %lu %u %lu\n",
+				cpu, READ_ONCE(st->walks),
+				READ_ONCE(st->hops),
+				READ_ONCE(st->max_depth),
+				READ_ONCE(st->cutoffs));
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(pi_walks);
+
+static ssize_t inband_wakeups_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	return evl_show_inband_wakeups(buf, PAGE_SIZE);
+}
+static DEVICE_ATTR_RO(inband_wakeups);
+
+#endif
+
+#ifdef CONFIG_EVL_LOCKSTAT
+
+static ssize_t lock_stats_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	return evl_show_lock_stats(buf, PAGE_SIZE);
+}
+static DEVICE_ATTR_RO(lock_stats);
+
+#endif
+
+#ifdef CONFIG_EVL_GRAVITY_AUTOTUNE
+
+static ssize_t gravity_tuning_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%Lu\n",
+			ktime_to_ns(evl_get_gravity_tuning()));
+}
+
+static ssize_t gravity_tuning_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long long bound;
+	int ret;
+
+	ret = kstrtoull(buf, 10, &bound);
+	if (ret < 0)
+		return -EINVAL;
+
+	if (bound == 0) {
+		evl_stop_gravity_tuning();
+		return count;
+	}
+
+	return evl_start_gravity_tuning(ns_to_ktime(bound)) ?: count;
+}
+static DEVICE_ATTR_RW(gravity_tuning);
+
+/*
+ * One line per tuning window, oldest first: timestamp, best case
+ * lateness of the probe timers over the window, then the gravity
+ * values applied in return (ns).
+ */
+static ssize_t gravity_history_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	return evl_show_gravity_history(buf, PAGE_SIZE);
+}
+static DEVICE_ATTR_RO(gravity_history);
+
+#endif
+
+static ssize_t sysheap_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	return evl_show_sysheap_usage(buf, PAGE_SIZE);
+}
+static DEVICE_ATTR_RO(sysheap);
+
+static ssize_t heap_stats_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	return evl_show_heap_stats(buf, PAGE_SIZE);
+}
+static DEVICE_ATTR_RO(heap_stats);
+
+#ifdef CONFIG_EVL_DEBUG_HEAP_TAGS
+
+static ssize_t heap_tags_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	return evl_show_heap_tags(buf, PAGE_SIZE);
+}
+static DEVICE_ATTR_RO(heap_tags);
+
+#endif
+
+#ifdef CONFIG_EVL_HEAP_CACHE
+
+static ssize_t heap_cache_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	return evl_show_sysheap_cache(buf, PAGE_SIZE);
+}
+static DEVICE_ATTR_RO(heap_cache);
+
+#endif
+
+DEFINE_STATIC_KEY_TRUE(evl_debug_checks);
+EXPORT_SYMBOL_GPL(evl_debug_checks);
+
+static ssize_t debug_checks_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n",
+			static_key_enabled(&evl_debug_checks));
+}
+
+static ssize_t debug_checks_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	bool on;
+	int ret;
+
+	ret = kstrtobool(buf, &on);
+	if (ret < 0)
+		return -EINVAL;
+
+	if (on)
+		static_branch_enable(&evl_debug_checks);
+	else
+		static_branch_disable(&evl_debug_checks);
+
+	return count;
+}
+static DEVICE_ATTR_RW(debug_checks);
+
+#ifdef CONFIG_EVL_RUNSTATS
+
+DEFINE_STATIC_KEY_TRUE(evl_runstats_enabled);
+EXPORT_SYMBOL_GPL(evl_runstats_enabled);
+
+ktime_t evl_runstats_epoch;
+EXPORT_SYMBOL_GPL(evl_runstats_epoch);
+
+static ssize_t runstats_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", evl_runstats_on());
+}
+
+static ssize_t runstats_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	bool on;
+	int ret;
+
+	ret = kstrtobool(buf, &on);
+	if (ret < 0)
+		return -EINVAL;
+
+	if (on == evl_runstats_on())
+		return count;
+
+	if (on) {
+		WRITE_ONCE(evl_runstats_epoch, evl_read_clock(&evl_mono_clock));
+		static_branch_enable(&evl_runstats_enabled);
+	} else {
+		static_branch_disable(&evl_runstats_enabled);
+	}
+
+	return count;
+}
+static DEVICE_ATTR_RW(runstats);
+
+#endif
+
+#ifdef CONFIG_EVL_DEFER_INBAND_IPIS
+
+/*
+ * One line per out-of-band CPU: count of in-band IPIs deferred
+ * while that CPU was running oob, and count of those a waiting
+ * sender had to raise eventually.
+ */
+static ssize_t inband_ipis_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	unsigned long deferred, forced;
+	ssize_t len = 0;
+	int cpu;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		smp_get_inband_ipi_stats(cpu, &deferred, &forced);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %lu %lu\n",
+				cpu, deferred, forced);
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(inband_ipis);
+
+#endif
+
+#ifdef CONFIG_EVL_IRQ_SHIELD
+
+static ssize_t irq_shield_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%*pbl\n",
+			cpumask_pr_args(&evl_irq_shield_cpus));
+}
+static DEVICE_ATTR_RO(irq_shield);
+
+static ssize_t irq_shield_violations_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%lu\n",
+			evl_get_irq_shield_violations());
+}
+static DEVICE_ATTR_RO(irq_shield_violations);
+
+#endif
+
 static struct attribute *control_attrs[] = {
 	&dev_attr_state.attr,
 	&dev_attr_abi.attr,
 	&dev_attr_cpus.attr,
+	&dev_attr_tickless_cpus.attr,
+	&dev_attr_sysheap.attr,
+	&dev_attr_heap_stats.attr,
+	&dev_attr_debug_checks.attr,
+#ifdef CONFIG_EVL_RUNSTATS
+	&dev_attr_runstats.attr,
+#endif
+#ifdef CONFIG_EVL_DEBUG_HEAP_TAGS
+	&dev_attr_heap_tags.attr,
+#endif
+#ifdef CONFIG_EVL_DEFER_INBAND_IPIS
+	&dev_attr_inband_ipis.attr,
+#endif
+#ifdef CONFIG_EVL_IRQ_SHIELD
+	&dev_attr_irq_shield.attr,
+	&dev_attr_irq_shield_violations.attr,
+#endif
 #ifdef CONFIG_EVL_SCHED_QUOTA
 	&dev_attr_quota.attr,
 #endif
 #ifdef CONFIG_EVL_SCHED_TP
 	&dev_attr_tp.attr,
+#endif
+#if defined(CONFIG_SMP) && defined(CONFIG_EVL_RUNSTATS)
+	&dev_attr_resched_ipis.attr,
+#endif
+#if defined(CONFIG_EVL_TIMER_HOUSEKEEPING) && defined(CONFIG_EVL_RUNSTATS)
+	&dev_attr_timer_offloads.attr,
+#endif
+#if defined(CONFIG_EVL_PREEMPT_DEFER) && defined(CONFIG_EVL_RUNSTATS)
+	&dev_attr_preempt_deferrals.attr,
+#endif
+#ifdef CONFIG_EVL_RUNSTATS
+	&dev_attr_mm_switches.attr,
+	&dev_attr_pi_walks.attr,
+	&dev_attr_inband_wakeups.attr,
+#endif
+#ifdef CONFIG_EVL_LOCKSTAT
+	&dev_attr_lock_stats.attr,
+#endif
+#ifdef CONFIG_EVL_GRAVITY_AUTOTUNE
+	&dev_attr_gravity_tuning.attr,
+	&dev_attr_gravity_history.attr,
+#endif
+#ifdef CONFIG_EVL_HEAP_CACHE
+	&dev_attr_heap_cache.attr,
+#endif
+#ifdef CONFIG_EVL_DEBUG_SWSTATS
+	&dev_attr_switch_pick.attr,
+	&dev_attr_switch_time.attr,
+	&dev_attr_switch_irqoff.attr,
 #endif
 	NULL,
 };
@@ -0,0 +1,313 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/memory.h>
+#include <evl/factory.h>
+#include <evl/sched.h>
+#include <evl/wait.h>
+#include <evl/uaccess.h>
+#include <uapi/evl/evgroup-abi.h>
+
+/*
+ * Event bits are set, tested and cleared by user-space directly, see
+ * uapi/evl/evgroup-abi.h for the protocol. The kernel only deals
+ * with blocking and waking up threads, consuming the bits on behalf
+ * of the sleepers it releases. We rely on our private copy of the
+ * width, since the shared state can be scribbled over by
+ * user-space.
+ */
+struct evl_evgroup {
+	struct evl_element element;
+	struct evl_evgroup_state *state;
+	struct evl_heap *heap;
+	u64 valid_bits;
+	struct evl_wait_queue wait;
+};
+
+static __always_inline atomic_t *__ATOMIC32(__u32 *ptr)
+{
+	return (atomic_t *)ptr;
+}
+
+static __always_inline atomic64_t *__ATOMIC64(__u64 *ptr)
+{
+	return (atomic64_t *)ptr;
+}
+
+static inline bool evgroup_cond_met(u64 value, u64 mask, u32 mode)
+{
+	if (mode & EVL_EVGROUP_ALL)
+		return (value & mask) == mask;
+
+	return !!(value & mask);
+}
+
+/* Check the wait condition, consuming the bits if required. */
+static bool try_wait_evgroup(struct evl_evgroup *eg,
+			u64 mask, u32 mode, u64 *valuep)
+{
+	atomic64_t *value = __ATOMIC64(&eg->state->value);
+	s64 old, new;
+
+	old = atomic64_read(value);
+	do {
+		if (!evgroup_cond_met(old, mask, mode))
+			return false;
+		if (!(mode & EVL_EVGROUP_CLEAR))
+			break;
+		new = old & ~mask;
+	} while (!atomic64_try_cmpxchg(value, &old, new));
+
+	*valuep = old;
+
+	return true;
+}
+
+static int wait_evgroup(struct evl_evgroup *eg,
+			struct evl_evgroup_waitreq __user *u_wreq)
+{
+	struct __evl_timespec __user *u_uts;
+	struct evl_evgroup_waitreq wreq;
+	struct __evl_timespec uts;
+	enum evl_tmode tmode;
+	struct timespec64 ts64;
+	atomic_t *waiters;
+	ktime_t timeout;
+	u64 value = 0;
+	int ret;
+
+	ret = raw_copy_from_user(&wreq, u_wreq, sizeof(wreq));
+	if (ret)
+		return -EFAULT;
+
+	if (wreq.mask == 0 || (wreq.mask & ~eg->valid_bits) ||
+		(wreq.mode & ~(EVL_EVGROUP_ALL|EVL_EVGROUP_CLEAR)))
+		return -EINVAL;
+
+	u_uts = evl_valptr64(wreq.timeout_ptr, struct __evl_timespec);
+	ret = raw_copy_from_user(&uts, u_uts, sizeof(uts));
+	if (ret)
+		return -EFAULT;
+
+	if ((unsigned long)uts.tv_nsec >= ONE_BILLION)
+		return -EINVAL;
+
+	ts64 = u_timespec_to_timespec64(uts);
+	timeout = timespec64_to_ktime(ts64);
+	tmode = timeout ? EVL_ABS : EVL_REL;
+
+	/*
+	 * Advertise the sleeper before checking the condition, pairs
+	 * with the barrier user-space issues between setting bits and
+	 * reading the waiter count.
+	 */
+	waiters = __ATOMIC32(&eg->state->waiters);
+	atomic_inc(waiters);
+	smp_mb__after_atomic();
+	ret = evl_wait_event_timeout(&eg->wait, timeout, tmode,
+				try_wait_evgroup(eg, wreq.mask,
+						wreq.mode, &value));
+	atomic_dec(waiters);
+
+	if (ret)
+		return ret;
+
+	return raw_put_user(value, &u_wreq->value) ? -EFAULT : 0;
+}
+
+static int post_evgroup(struct evl_evgroup *eg, u64 __user *u_bits)
+{
+	u64 bits;
+
+	if (raw_get_user(bits, u_bits))
+		return -EFAULT;
+
+	if (bits & ~eg->valid_bits)
+		return -EINVAL;
+
+	if (bits)
+		atomic64_or(bits, __ATOMIC64(&eg->state->value));
+
+	/*
+	 * We cannot tell which sleepers the new value satisfies
+	 * without evaluating their own condition, have them all do
+	 * so.
+	 */
+	evl_flush_wait(&eg->wait, 0);
+	evl_schedule();
+
+	return 0;
+}
+
+static long evgroup_oob_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	struct evl_evgroup *eg = element_of(filp, struct evl_evgroup);
+	long ret;
+
+	switch (cmd) {
+	case EVL_EVGIOC_WAIT:
+		ret = wait_evgroup(eg, (struct evl_evgroup_waitreq __user *)arg);
+		break;
+	case EVL_EVGIOC_POST:
+		ret = post_evgroup(eg, (u64 __user *)arg);
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+static int evgroup_release(struct inode *inode, struct file *filp)
+{
+	struct evl_evgroup *eg = element_of(filp, struct evl_evgroup);
+
+	evl_flush_wait(&eg->wait, EVL_T_RMID);
+
+	return evl_release_element(inode, filp);
+}
+
+static const struct file_operations evgroup_fops = {
+	.open		= evl_open_element,
+	.release	= evgroup_release,
+	.oob_ioctl	= evgroup_oob_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_oob_ioctl  = compat_ptr_oob_ioctl,
+#endif
+};
+
+static struct evl_element *
+evgroup_factory_build(struct evl_factory *fac, const char __user *u_name,
+		void __user *u_attrs, int clone_flags, u32 *state_offp)
+{
+	struct evl_evgroup_state *state;
+	struct evl_evgroup_attrs attrs;
+	struct evl_evgroup *eg;
+	struct evl_clock *clock;
+	u64 valid_bits;
+	int ret;
+
+	if (clone_flags & ~EVL_CLONE_PUBLIC)
+		return ERR_PTR(-EINVAL);
+
+	ret = copy_from_user(&attrs, u_attrs, sizeof(attrs));
+	if (ret)
+		return ERR_PTR(-EFAULT);
+
+	switch (attrs.width) {
+	case 32:
+		valid_bits = U32_MAX;
+		break;
+	case 64:
+		valid_bits = U64_MAX;
+		break;
+	default:
+		return ERR_PTR(-EINVAL);
+	}
+
+	if (attrs.initval & ~valid_bits)
+		return ERR_PTR(-EINVAL);
+
+	clock = evl_get_clock_by_fd(attrs.clockfd);
+	if (clock == NULL)
+		return ERR_PTR(-EINVAL);
+
+	eg = kzalloc(sizeof(*eg), GFP_KERNEL);
+	if (eg == NULL) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
+
+	ret = evl_init_user_element(&eg->element, &evl_evgroup_factory,
+				u_name, clone_flags);
+	if (ret)
+		goto fail_element;
+
+	eg->heap = evl_get_state_heap(clone_flags);
+	state = evl_zalloc_chunk(eg->heap, sizeof(*state));
+	if (state == NULL) {
+		ret = -ENOMEM;
+		goto fail_heap;
+	}
+
+	atomic64_set(__ATOMIC64(&state->value), attrs.initval);
+	state->width = attrs.width;
+	eg->state = state;
+	eg->valid_bits = valid_bits;
+	evl_init_wait(&eg->wait, clock, EVL_WAIT_PRIO);
+	*state_offp = evl_state_offset(eg->heap, state);
+
+	return &eg->element;
+
+fail_heap:
+	evl_put_state_heap(eg->heap);
+	evl_destroy_element(&eg->element);
+fail_element:
+	kfree(eg);
+fail_alloc:
+	evl_put_clock(clock);
+
+	return ERR_PTR(ret);
+}
+
+static void evgroup_factory_dispose(struct evl_element *e)
+{
+	struct evl_evgroup *eg;
+
+	eg = container_of(e, struct evl_evgroup, element);
+
+	evl_put_clock(eg->wait.clock);
+	evl_destroy_wait(&eg->wait);
+	evl_free_chunk(eg->heap, eg->state);
+	evl_put_state_heap(eg->heap);
+	evl_destroy_element(&eg->element);
+	kfree_rcu(eg, element.rcu);
+}
+
+/* width value waiters */
+static ssize_t state_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_evgroup *eg;
+	ssize_t ret;
+
+	eg = evl_get_element_by_dev(dev, struct evl_evgroup);
+	if (eg == NULL)
+		return -EIO;
+
+	ret = scnprintf(buf, PAGE_SIZE, "%u %#llx %u\n",
+			eg->valid_bits == U32_MAX ? 32 : 64,
+			(u64)atomic64_read(__ATOMIC64(&eg->state->value)) &
+			eg->valid_bits,
+			atomic_read(__ATOMIC32(&eg->state->waiters)));
+
+	evl_put_element(&eg->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(state);
+
+static struct attribute *evgroup_attrs[] = {
+	&dev_attr_state.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(evgroup);
+
+struct evl_factory evl_evgroup_factory = {
+	.name	=	EVL_EVGROUP_DEV,
+	.fops	=	&evgroup_fops,
+	.build =	evgroup_factory_build,
+	.dispose =	evgroup_factory_dispose,
+	.nrdev	=	CONFIG_EVL_NR_EVGROUPS,
+	.attrs	=	evgroup_groups,
+	.flags	=	EVL_FACTORY_CLONE,
+};
@@ -45,6 +45,10 @@ static struct evl_factory *factories[] = {
 	&evl_monitor_factory,
 	&evl_poll_factory,
 	&evl_xbuf_factory,
+	&evl_mqueue_factory,
+	&evl_evgroup_factory,
+	&evl_barrier_factory,
+	&evl_blackboard_factory,
 	&evl_proxy_factory,
 	&evl_observable_factory,
 	&evl_rng_factory,
@@ -54,6 +58,12 @@ static struct evl_factory *factories[] = {
 #ifdef CONFIG_FTRACE
 	&evl_trace_factory,
 #endif
+#ifdef CONFIG_EVL_FLIGHTREC
+	&evl_flightrec_factory,
+#endif
+#ifdef CONFIG_EVL_BLKIO
+	&evl_blkio_factory,
+#endif
 };
 
 #define NR_FACTORIES	\
@@ -67,6 +77,19 @@ static wait_queue_head_t flusher_wait;
 
 static LIST_HEAD(flusher_queue);
 
+/*
+ * Deferred elements are usable as soon as they are cloned, their
+ * device shows up in sysfs once the publisher has registered it.
+ * publish_lock serializes the publisher with device removal.
+ */
+static void publish_elements(struct work_struct *work);
+
+static DEFINE_MUTEX(publish_lock);
+
+static LIST_HEAD(publish_queue);
+
+static DECLARE_WORK(publish_work, publish_elements);
+
 int evl_init_element(struct evl_element *e,
 		struct evl_factory *fac, int clone_flags)
 {
@@ -90,6 +113,7 @@ int evl_init_element(struct evl_element *e,
 	e->fundle = EVL_NO_HANDLE;
 	e->devname = NULL;
 	e->clone_flags = clone_flags;
+	INIT_LIST_HEAD(&e->publish);
 
 	return 0;
 }
@@ -205,7 +229,7 @@ static void __do_put_element(struct evl_element *e)
 	 * completing the file release process of public elements (see
 	 * __fput()).
 	 */
-	if (likely(e->dev))
+	if (likely(e->dev) || evl_element_is_deferred(e))
 		evl_remove_element_device(e);
 
 	/*
@@ -449,6 +473,17 @@ static int create_element_device(struct evl_element *e,
 	if (ret)
 		goto fail_visibility;
 
+	/* The publisher creates the device later on. */
+	if (evl_element_is_deferred(e)) {
+		refcount_inc(&e->refs);
+		fd_install(e->fpriv.efd, e->fpriv.filp);
+		mutex_lock(&publish_lock);
+		list_add_tail(&e->publish, &publish_queue);
+		mutex_unlock(&publish_lock);
+		schedule_work(&publish_work);
+		return 0;
+	}
+
 	dev = create_sys_device(rdev, fac, e, evl_element_name(e));
 	if (IS_ERR(dev)) {
 		ret = PTR_ERR(dev);
@@ -515,12 +550,44 @@ int evl_create_core_element_device(struct evl_element *e,
 	return create_element_device(e, fac);
 }
 
+static void publish_elements(struct work_struct *work)
+{
+	struct evl_element *e;
+	struct device *dev;
+
+	mutex_lock(&publish_lock);
+
+	while (!list_empty(&publish_queue)) {
+		e = list_first_entry(&publish_queue,
+				struct evl_element, publish);
+		list_del_init(&e->publish);
+		/* Failing leaves the element usable, only hidden. */
+		dev = create_sys_device(MKDEV(0, e->minor), e->factory,
+					e, evl_element_name(e));
+		if (IS_ERR(dev))
+			printk_ratelimited(EVL_WARNING "cannot publish %s",
+					evl_element_name(e));
+		else
+			e->dev = dev;
+	}
+
+	mutex_unlock(&publish_lock);
+}
+
 void evl_remove_element_device(struct evl_element *e)
 {
 	struct evl_factory *fac = e->factory;
 	struct device *dev = e->dev;
 
-	device_unregister(dev);
+	if (evl_element_is_deferred(e)) {
+		mutex_lock(&publish_lock);
+		list_del_init(&e->publish);
+		dev = e->dev;
+		mutex_unlock(&publish_lock);
+	}
+
+	if (dev)
+		device_unregister(dev);
 
 	if (evl_element_is_public(e))
 		cdev_del(&e->cdev);
@@ -539,7 +606,7 @@ static long ioctl_clone_device(struct file *filp, unsigned int cmd,
 	const char __user *u_name;
 	struct evl_factory *fac;
 	void __user *u_attrs;
-	int ret;
+	int ret, deferred;
 
 	if (cmd != EVL_IOC_CLONE)
 		return -ENOTTY;
@@ -559,12 +626,24 @@ static long ioctl_clone_device(struct file *filp, unsigned int cmd,
 	if (u_name == NULL && req.clone_flags & EVL_CLONE_PUBLIC)
 		return -EINVAL;
 
+	/*
+	 * Deferred publication is handled here, factories do not
+	 * need to know about it. Public elements need their device
+	 * node right away.
+	 */
+	deferred = req.clone_flags & EVL_CLONE_DEFERRED;
+	if (deferred && req.clone_flags & EVL_CLONE_PUBLIC)
+		return -EINVAL;
+
 	u_attrs = evl_valptr64(req.attrs_ptr, void);
 	fac = container_of(filp->f_inode->i_cdev, struct evl_factory, cdev);
-	e = fac->build(fac, u_name, u_attrs, req.clone_flags, &state_offset);
+	e = fac->build(fac, u_name, u_attrs,
+		req.clone_flags & ~EVL_CLONE_DEFERRED, &state_offset);
 	if (IS_ERR(e))
 		return PTR_ERR(e);
 
+	e->clone_flags |= deferred;
+
 	/* This must be set before the device appears. */
 	filp->private_data = e;
 	barrier();
@@ -639,25 +718,14 @@ static const struct file_operations clone_fops = {
 static int index_element_at(struct evl_index *map,
 			struct evl_element *e, fundle_t fundle)
 {
-	struct rb_node **rbp, *parent;
 	struct evl_element *tmp;
 
-	parent = NULL;
-	rbp = &map->root.rb_node;
-	while (*rbp) {
-		tmp = rb_entry(*rbp, struct evl_element, index_node);
-		parent = *rbp;
-		if (fundle < tmp->fundle)
-			rbp = &(*rbp)->rb_left;
-		else if (fundle > tmp->fundle)
-			rbp = &(*rbp)->rb_right;
-		else
+	hash_for_each_possible(map->table, tmp, index_node, fundle)
+		if (tmp->fundle == fundle)
 			return -EEXIST;
-	}
 
 	e->fundle = fundle;
-	rb_link_node(&e->index_node, parent, rbp);
-	rb_insert_color(&e->index_node, &map->root);
+	hash_add_rcu(map->table, &e->index_node, fundle);
 
 	return 0;
 }
@@ -687,42 +755,66 @@ void evl_index_element(struct evl_index *map, struct evl_element *e)
 	} while (ret);
 }
 
+/*
+ * The container of @e must not be freed before a RCU grace period
+ * has elapsed since this call, which kfree_rcu() guarantees.
+ */
 void evl_unindex_element(struct evl_index *map, struct evl_element *e)
 {
 	unsigned long flags;
 
 	raw_spin_lock_irqsave(&map->lock, flags);
-	rb_erase(&e->index_node, &map->root);
+	hash_del_rcu(&e->index_node);
 	raw_spin_unlock_irqrestore(&map->lock, flags);
 }
 
+/* in-band or OOB */
 struct evl_element *
 __evl_get_element_by_fundle(struct evl_index *map, fundle_t fundle)
 {
 	struct evl_element *e;
-	unsigned long flags;
-	struct rb_node *rb;
 
-	raw_spin_lock_irqsave(&map->lock, flags);
+	rcu_read_lock();
 
-	rb = map->root.rb_node;
-	while (rb) {
-		e = rb_entry(rb, struct evl_element, index_node);
-		if (fundle < e->fundle) {
-			rb = rb->rb_left;
-		} else if (fundle > e->fundle) {
-			rb = rb->rb_right;
-		} else {
+	hash_for_each_possible_rcu(map->table, e, index_node, fundle) {
+		if (e->fundle == fundle) {
 			if (unlikely(!refcount_inc_not_zero(&e->refs)))
-				e = NULL;
-			break;
+				break;
+			rcu_read_unlock();
+			return e;
 		}
 	}
 
-	raw_spin_unlock_irqrestore(&map->lock, flags);
+	rcu_read_unlock();
+
+	return NULL;
+}
+
+/* in-band only */
+struct evl_element *
+__evl_get_element_by_name(struct evl_factory *fac, const char *name)
+{
+	struct evl_element *e;
+	u64 hlen;
+
+	hlen = hashlen_string("EVL", name);
+
+	mutex_lock(&fac->hash_lock);
+
+	hash_for_each_possible(fac->name_hash, e, hash, hlen) {
+		if (!strcmp(e->devname->name, name)) {
+			if (unlikely(!refcount_inc_not_zero(&e->refs)))
+				break;
+			mutex_unlock(&fac->hash_lock);
+			return e;
+		}
+	}
+
+	mutex_unlock(&fac->hash_lock);
 
-	return rb ? e : NULL;
+	return NULL;
 }
+EXPORT_SYMBOL_GPL(__evl_get_element_by_name);
 
 static char *factory_type_devnode(const struct device *dev, umode_t *mode,
 			kuid_t *uid, kgid_t *gid)
@@ -819,7 +911,7 @@ int evl_create_factory(struct evl_factory *fac, dev_t rdev)
 
 	fac->dev = dev;
 	raw_spin_lock_init(&fac->index.lock);
-	fac->index.root = RB_ROOT;
+	hash_init(fac->index.table);
 	fac->index.generator = EVL_NO_HANDLE;
 	hash_init(fac->name_hash);
 	mutex_init(&fac->hash_lock);
@@ -13,94 +13,84 @@
 #include <linux/completion.h>
 #include <linux/irq_work.h>
 #include <linux/spinlock.h>
+#include <linux/hash.h>
 #include <evl/file.h>
 #include <evl/memory.h>
 #include <evl/assert.h>
 #include <evl/sched.h>
 #include <evl/poll.h>
 
-static struct rb_root fd_tree = RB_ROOT;
-
-static DEFINE_HARD_SPINLOCK(fdt_lock);
-
 /*
- * We could have a per-files_struct table of fds managed out-of-band,
- * but this looks overkill at the moment. So we only have a single
- * rb-tree for now, indexing our file descriptors on a composite key
- * which pairs the the in-band fd and the originating files struct
- * pointer.
+ * Our file descriptors are indexed on a composite key which pairs
+ * the in-band fd and the originating files struct pointer, hashed
+ * to a fixed set of buckets. Each bucket is guarded by its own hard
+ * lock, so that oob lookups from different processes or for
+ * different fds seldom contend, and cost a constant time regardless
+ * of the number of open fds. The fd lists are short, and lookups
+ * only hold the bucket lock for the time needed to grab a reference
+ * on the file, which is what makes this scheme oob-safe.
+ *
+ * The bucket lock also guards the lists of poll nodes watching the
+ * fds it indexes, serializing their updates with the removal of the
+ * latter.
  */
-
-static inline bool lean_left(struct evl_fd *lh, struct evl_fd *rh)
+#define EVL_FD_HASH_BITS	8
+#define EVL_FD_HASH_SIZE	(1 << EVL_FD_HASH_BITS)
+
+struct evl_fd_bucket {
+	struct hlist_head head;
+	hard_spinlock_t lock;
+} ____cacheline_aligned_in_smp;
+
+static struct evl_fd_bucket fd_buckets[EVL_FD_HASH_SIZE] = {
+	[0 ... EVL_FD_HASH_SIZE - 1] = {
+		.lock = __HARD_SPIN_LOCK_INITIALIZER(fd_buckets.lock),
+	},
+};
+
+static inline struct evl_fd_bucket *
+get_bucket(unsigned int fd, struct files_struct *files)
 {
-	if (lh->files == rh->files)
-		return lh->fd < rh->fd;
-
-	return lh->files < rh->files;
+	return fd_buckets + hash_32(fd ^ hash_ptr(files, 32),
+				EVL_FD_HASH_BITS);
 }
 
-static inline bool lean_right(struct evl_fd *lh, struct evl_fd *rh)
+/* bucket->lock held, irqs off. */
+static inline
+struct evl_fd *lookup_efd(struct evl_fd_bucket *bucket, unsigned int fd,
+			struct files_struct *files)
 {
-	if (lh->files == rh->files)
-		return lh->fd > rh->fd;
-
-	return lh->files > rh->files;
-}
+	struct evl_fd *efd;
 
-static inline int index_efd(struct evl_fd *efd, struct file *filp)
-{
-	struct rb_node **rbp, *parent = NULL;
-	struct evl_fd *tmp;
-
-	rbp = &fd_tree.rb_node;
-	while (*rbp) {
-		tmp = rb_entry(*rbp, struct evl_fd, rb);
-		parent = *rbp;
-		if (lean_left(efd, tmp))
-			rbp = &(*rbp)->rb_left;
-		else if (lean_right(efd, tmp))
-			rbp = &(*rbp)->rb_right;
-		else
-			return -EEXIST;
+	hlist_for_each_entry(efd, &bucket->head, hash) {
+		if (efd->fd == fd && efd->files == files)
+			return efd;
 	}
 
-	rb_link_node(&efd->rb, parent, rbp);
-	rb_insert_color(&efd->rb, &fd_tree);
-
-	return 0;
+	return NULL;
 }
 
-static inline
-struct evl_fd *lookup_efd(unsigned int fd,
-			struct files_struct *files)
+/* bucket->lock held, irqs off. */
+static inline int index_efd(struct evl_fd_bucket *bucket,
+			struct evl_fd *efd)
 {
-	struct evl_fd *efd, tmp;
-	struct rb_node *rb;
-
-	tmp.fd = fd;
-	tmp.files = files;
-	rb = fd_tree.rb_node;
-	while (rb) {
-		efd = rb_entry(rb, struct evl_fd, rb);
-		if (lean_left(&tmp, efd))
-			rb = rb->rb_left;
-		else if (lean_right(&tmp, efd))
-			rb = rb->rb_right;
-		else
-			return efd;
-	}
+	if (lookup_efd(bucket, efd->fd, efd->files))
+		return -EEXIST;
 
-	return NULL;
+	hlist_add_head(&efd->hash, &bucket->head);
+
+	return 0;
 }
 
+/* bucket->lock held, irqs off. */
 static inline
-struct evl_fd *unindex_efd(unsigned int fd,
+struct evl_fd *unindex_efd(struct evl_fd_bucket *bucket, unsigned int fd,
 			struct files_struct *files)
 {
-	struct evl_fd *efd = lookup_efd(fd, files);
+	struct evl_fd *efd = lookup_efd(bucket, fd, files);
 
 	if (efd)
-		rb_erase(&efd->rb, &fd_tree);
+		hlist_del(&efd->hash);
 
 	return efd;
 }
@@ -110,6 +100,7 @@ void install_inband_fd(unsigned int fd, struct file *filp,
 		struct files_struct *files)
 {
 	unsigned long flags;
+	struct evl_fd_bucket *bucket;
 	struct evl_fd *efd;
 	int ret = -ENOMEM;
 
@@ -122,15 +113,16 @@ void install_inband_fd(unsigned int fd, struct file *filp,
 		efd->files = files;
 		efd->efilp = filp->f_oob_ctx;
 		INIT_LIST_HEAD(&efd->poll_nodes);
-		raw_spin_lock_irqsave(&fdt_lock, flags);
-		ret = index_efd(efd, filp);
-		raw_spin_unlock_irqrestore(&fdt_lock, flags);
+		bucket = get_bucket(fd, files);
+		raw_spin_lock_irqsave(&bucket->lock, flags);
+		ret = index_efd(bucket, efd);
+		raw_spin_unlock_irqrestore(&bucket->lock, flags);
 	}
 
 	EVL_WARN_ON(CORE, ret);
 }
 
-/* fdt_lock held, irqs off. CAUTION: resched required on exit. */
+/* bucket->lock held, irqs off. CAUTION: resched required on exit. */
 static void drop_watchpoints(struct evl_fd *efd)
 {
 	if (!list_empty(&efd->poll_nodes))
@@ -142,16 +134,18 @@ void uninstall_inband_fd(unsigned int fd, struct file *filp,
 			struct files_struct *files)
 {
 	unsigned long flags;
+	struct evl_fd_bucket *bucket;
 	struct evl_fd *efd;
 
 	if (filp->f_oob_ctx == NULL)
 		return;
 
-	raw_spin_lock_irqsave(&fdt_lock, flags);
-	efd = unindex_efd(fd, files);
+	bucket = get_bucket(fd, files);
+	raw_spin_lock_irqsave(&bucket->lock, flags);
+	efd = unindex_efd(bucket, fd, files);
 	if (efd)
 		drop_watchpoints(efd);
-	raw_spin_unlock_irqrestore(&fdt_lock, flags);
+	raw_spin_unlock_irqrestore(&bucket->lock, flags);
 	evl_schedule();
 
 	if (efd)
@@ -163,23 +157,25 @@ void replace_inband_fd(unsigned int fd, struct file *filp,
 		struct files_struct *files)
 {
 	unsigned long flags;
+	struct evl_fd_bucket *bucket;
 	struct evl_fd *efd;
 
 	if (filp->f_oob_ctx == NULL)
 		return;
 
-	raw_spin_lock_irqsave(&fdt_lock, flags);
+	bucket = get_bucket(fd, files);
+	raw_spin_lock_irqsave(&bucket->lock, flags);
 
-	efd = lookup_efd(fd, files);
+	efd = lookup_efd(bucket, fd, files);
 	if (efd) {
 		drop_watchpoints(efd);
 		efd->efilp = filp->f_oob_ctx;
-		raw_spin_unlock_irqrestore(&fdt_lock, flags);
+		raw_spin_unlock_irqrestore(&bucket->lock, flags);
 		evl_schedule();
 		return;
 	}
 
-	raw_spin_unlock_irqrestore(&fdt_lock, flags);
+	raw_spin_unlock_irqrestore(&bucket->lock, flags);
 
 	install_inband_fd(fd, filp, files);
 }
@@ -188,15 +184,17 @@ struct evl_file *evl_get_file(unsigned int fd)
 {
 	struct evl_file *efilp = NULL;
 	unsigned long flags;
+	struct evl_fd_bucket *bucket;
 	struct evl_fd *efd;
 
-	raw_spin_lock_irqsave(&fdt_lock, flags);
-	efd = lookup_efd(fd, current->files);
+	bucket = get_bucket(fd, current->files);
+	raw_spin_lock_irqsave(&bucket->lock, flags);
+	efd = lookup_efd(bucket, fd, current->files);
 	if (efd) {
 		efilp = efd->efilp;
 		evl_get_fileref(efilp);
 	}
-	raw_spin_unlock_irqrestore(&fdt_lock, flags);
+	raw_spin_unlock_irqrestore(&bucket->lock, flags);
 
 	return efilp;
 }
@@ -207,16 +205,19 @@ struct evl_file *evl_watch_fd(unsigned int fd,
 {
 	struct evl_file *efilp = NULL;
 	unsigned long flags;
+	struct evl_fd_bucket *bucket;
 	struct evl_fd *efd;
 
-	raw_spin_lock_irqsave(&fdt_lock, flags);
-	efd = lookup_efd(fd, current->files);
+	bucket = get_bucket(fd, current->files);
+	node->lock = &bucket->lock;
+	raw_spin_lock_irqsave(&bucket->lock, flags);
+	efd = lookup_efd(bucket, fd, current->files);
 	if (efd) {
 		efilp = efd->efilp;
 		evl_get_fileref(efilp);
 		list_add(&node->next, &efd->poll_nodes);
 	}
-	raw_spin_unlock_irqrestore(&fdt_lock, flags);
+	raw_spin_unlock_irqrestore(&bucket->lock, flags);
 
 	return efilp;
 }
@@ -225,9 +226,9 @@ void evl_ignore_fd(struct evl_poll_node *node)
 {
 	unsigned long flags;
 
-	raw_spin_lock_irqsave(&fdt_lock, flags);
+	raw_spin_lock_irqsave(node->lock, flags);
 	list_del(&node->next);
-	raw_spin_unlock_irqrestore(&fdt_lock, flags);
+	raw_spin_unlock_irqrestore(node->lock, flags);
 }
 
 /**
@@ -265,7 +266,7 @@ void evl_release_file(struct evl_file *efilp)
 	 * NOTE: In-band and out-of-band fds are working together in
 	 * lockstep mode via dovetail_install/uninstall_fd() calls.
 	 * Therefore, we can't livelock with evl_get_file() as @efilp
-	 * was removed from the fd tree before fops->release() called
+	 * was removed from the fd table before fops->release() called
 	 * us.
 	 */
 	evl_pass_crossing(&efilp->crossing);
@@ -0,0 +1,221 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+#include <linux/log2.h>
+#include <evl/factory.h>
+#include <evl/clock.h>
+#include <evl/flightrec.h>
+
+/*
+ * Per-CPU flight recorder. Records are written locally with hard irqs
+ * off, so that the writer only competes with readers, on which it
+ * never waits. This is cheap enough to stay on in production, and
+ * entirely skipped via a static branch when no ring could be set up.
+ */
+
+static uint flightrec_records_arg = 4096;
+module_param_named(flightrec_records, flightrec_records_arg, uint, 0444);
+
+DEFINE_STATIC_KEY_FALSE(evl_flightrec_enabled);
+
+static void *flightrec_area;
+
+static unsigned int flightrec_nr_records;
+
+static size_t flightrec_area_size;
+
+static u64 trigger_lateness;
+
+static inline struct evl_flightrec_ring *get_ring(int cpu)
+{
+	return flightrec_area + cpu * flightrec_area_size;
+}
+
+static inline
+struct evl_flightrec_record *get_record(struct evl_flightrec_ring *ring,
+					u64 seq)
+{
+	struct evl_flightrec_record *records = (void *)(ring + 1);
+
+	return records + (seq & (flightrec_nr_records - 1));
+}
+
+notrace void __evl_flightrec(int type, pid_t pid, u64 arg0, u64 arg1)
+{
+	struct evl_flightrec_ring *ring;
+	struct evl_flightrec_record *rec;
+	unsigned long flags;
+	u64 head;
+
+	flags = hard_local_irq_save();
+
+	ring = get_ring(raw_smp_processor_id());
+	if (!(READ_ONCE(ring->flags) & EVL_FLTREC_FROZEN)) {
+		head = ring->head;
+		rec = get_record(ring, head);
+		rec->date = evl_read_clock(&evl_mono_clock);
+		rec->type = type;
+		rec->pid = pid;
+		rec->arg[0] = arg0;
+		rec->arg[1] = arg1;
+		smp_store_release(&ring->head, head + 1);
+	}
+
+	hard_local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(__evl_flightrec);
+
+notrace void __evl_flightrec_timer(ktime_t lateness)
+{
+	u64 threshold = READ_ONCE(trigger_lateness);
+
+	__evl_flightrec(EVL_FLTREC_TIMER, 0, lateness, 0);
+
+	if (threshold && lateness > 0 && (u64)lateness > threshold)
+		evl_freeze_flightrec();
+}
+
+/*
+ * Stop recording on all CPUs, e.g. when a driver detects some
+ * anomaly, so that the events leading to it can be analyzed.
+ * Callable from any stage.
+ */
+void evl_freeze_flightrec(void)
+{
+	ktime_t now = evl_read_clock(&evl_mono_clock);
+	struct evl_flightrec_ring *ring;
+	int cpu;
+
+	if (!static_branch_unlikely(&evl_flightrec_enabled))
+		return;
+
+	for_each_possible_cpu(cpu) {
+		ring = get_ring(cpu);
+		if (!(READ_ONCE(ring->flags) & EVL_FLTREC_FROZEN)) {
+			WRITE_ONCE(ring->freeze_date, now);
+			smp_wmb();
+			WRITE_ONCE(ring->flags, EVL_FLTREC_FROZEN);
+		}
+	}
+}
+EXPORT_SYMBOL_GPL(evl_freeze_flightrec);
+
+static void thaw_flightrec(void)
+{
+	struct evl_flightrec_ring *ring;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = get_ring(cpu);
+		WRITE_ONCE(ring->flags, 0);
+		WRITE_ONCE(ring->freeze_date, 0);
+	}
+}
+
+static long flightrec_common_ioctl(struct file *filp, unsigned int cmd,
+				unsigned long arg)
+{
+	struct evl_flightrec_trigger trigger;
+	struct evl_flightrec_info info;
+	long ret = 0;
+
+	if (flightrec_area == NULL)
+		return -ENODEV;
+
+	switch (cmd) {
+	case EVL_FLTIOC_GET_INFO:
+		info.nr_cpus = nr_cpu_ids;
+		info.nr_records = flightrec_nr_records;
+		info.area_size = flightrec_area_size;
+		ret = raw_copy_to_user((void __user *)arg, &info,
+				sizeof(info)) ? -EFAULT : 0;
+		break;
+	case EVL_FLTIOC_SET_TRIGGER:
+		ret = raw_copy_from_user(&trigger, (void __user *)arg,
+					sizeof(trigger));
+		if (ret)
+			return -EFAULT;
+		WRITE_ONCE(trigger_lateness, trigger.lateness_ns);
+		break;
+	case EVL_FLTIOC_FREEZE:
+		evl_freeze_flightrec();
+		break;
+	case EVL_FLTIOC_THAW:
+		thaw_flightrec();
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+static long flightrec_oob_ioctl(struct file *filp, unsigned int cmd,
+				unsigned long arg)
+{
+	return flightrec_common_ioctl(filp, cmd, arg);
+}
+
+static long flightrec_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	return flightrec_common_ioctl(filp, cmd, arg);
+}
+
+static int flightrec_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	if (flightrec_area == NULL)
+		return -ENODEV;
+
+	/* Readers may not scribble over the rings. */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	return remap_vmalloc_range(vma, flightrec_area, vma->vm_pgoff);
+}
+
+static const struct file_operations flightrec_fops = {
+	.open		=	stream_open,
+	.unlocked_ioctl	=	flightrec_ioctl,
+	.oob_ioctl	=	flightrec_oob_ioctl,
+	.mmap		=	flightrec_mmap,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl	=	compat_ptr_ioctl,
+	.compat_oob_ioctl  =	compat_ptr_oob_ioctl,
+#endif
+};
+
+struct evl_factory evl_flightrec_factory = {
+	.name	=	"flightrec",
+	.fops	=	&flightrec_fops,
+	.flags	=	EVL_FACTORY_SINGLE,
+};
+
+void __init evl_init_flightrec(void)
+{
+	size_t size;
+
+	if (flightrec_records_arg == 0)
+		return;
+
+	flightrec_nr_records = roundup_pow_of_two(flightrec_records_arg);
+	size = sizeof(struct evl_flightrec_ring) +
+		flightrec_nr_records * sizeof(struct evl_flightrec_record);
+	flightrec_area_size = PAGE_ALIGN(size);
+
+	flightrec_area = vmalloc_user(flightrec_area_size * nr_cpu_ids);
+	if (flightrec_area == NULL) {
+		printk(EVL_WARNING "cannot allocate flight recorder\n");
+		return;
+	}
+
+	static_branch_enable(&evl_flightrec_enabled);
+}
@@ -0,0 +1,296 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/notifier.h>
+#include <linux/math64.h>
+#include <evl/sched.h>
+#include <evl/clock.h>
+#include <evl/timer.h>
+#include <evl/control.h>
+
+/*
+ * Background gravity tuning for the monotonic clock. The gravity
+ * values calibrated by latmus drift with the thermal and frequency
+ * state of the CPUs, so we keep measuring the lateness of a
+ * low-rate periodic probe timer on every out-of-band CPU, and
+ * correct the gravity periodically from the in-band stage based on
+ * the best case observed over the last sampling window, which
+ * should be zero ideally.
+ *
+ * A timer handler can only measure the interrupt latency, therefore
+ * the correction computed for the irq gravity is applied to the
+ * kernel and user gravities as well, keeping the differences
+ * between them as calibrated. The accumulated correction cannot
+ * exceed the bound set when enabling the tuner, so that the gravity
+ * cannot run away from the calibrated values if something goes awry.
+ */
+
+#define GRAVITY_PROBE_PERIOD	(10 * NSEC_PER_MSEC)
+#define GRAVITY_TUNING_WINDOW	(1 * NSEC_PER_SEC)
+/* Errors below this threshold are considered noise. */
+#define GRAVITY_DEADBAND	250	/* ns */
+#define GRAVITY_HISTORY_LEN	64
+
+struct gravity_probe {
+	struct evl_timer timer;
+	hard_spinlock_t lock;
+	ktime_t min_lat;
+	unsigned int samples;
+};
+
+struct gravity_record {
+	ktime_t date;
+	s32 min_lat;
+	struct evl_clock_gravity gravity;
+};
+
+static DEFINE_PER_CPU(struct gravity_probe, gravity_probes);
+
+static DEFINE_MUTEX(tuning_lock);
+
+static struct delayed_work tuning_work;
+
+static ktime_t tuning_bound;	/* Zero if tuning is off. */
+
+static ktime_t tuning_shift;
+
+static struct gravity_record history[GRAVITY_HISTORY_LEN];
+
+static unsigned int history_next, history_count;
+
+static void probe_handler(struct evl_timer *timer) /* hard irqs off */
+{
+	struct gravity_probe *probe;
+	ktime_t now, ideal, lat;
+
+	probe = container_of(timer, struct gravity_probe, timer);
+	now = evl_read_clock(&evl_mono_clock);
+	/*
+	 * Compute the ideal date of the current shot directly, since
+	 * the timer date might have been anticipated according to a
+	 * former gravity value.
+	 */
+	ideal = ktime_add_ns(timer->start_date,
+			timer->periodic_ticks * ktime_to_ns(timer->interval));
+	lat = ktime_sub(now, ideal);
+
+	raw_spin_lock(&probe->lock);
+	if (probe->samples == 0 || lat < probe->min_lat)
+		probe->min_lat = lat;
+	probe->samples++;
+	raw_spin_unlock(&probe->lock);
+}
+
+/* tuning_lock held */
+static void record_history(ktime_t min_lat)
+{
+	struct gravity_record *r;
+
+	r = history + history_next;
+	r->date = evl_read_clock(&evl_mono_clock);
+	r->min_lat = (s32)clamp_t(s64, ktime_to_ns(min_lat), S32_MIN, S32_MAX);
+	r->gravity = evl_mono_clock.gravity;
+	history_next = (history_next + 1) % GRAVITY_HISTORY_LEN;
+	if (history_count < GRAVITY_HISTORY_LEN)
+		history_count++;
+}
+
+static inline ktime_t shift_gravity(ktime_t value, ktime_t step)
+{
+	return max_t(ktime_t, ktime_add(value, step), 0);
+}
+
+static void tune_gravity(struct work_struct *work)
+{
+	struct evl_clock_gravity gravity;
+	struct gravity_probe *probe;
+	ktime_t min_lat = 0, step;
+	bool sampled = false;
+	unsigned long flags;
+	int cpu;
+
+	mutex_lock(&tuning_lock);
+
+	if (!tuning_bound)
+		goto out;
+
+	/* Figure out the best case over all CPUs, then reset. */
+	for_each_cpu(cpu, &evl_cpu_affinity) {
+		probe = per_cpu_ptr(&gravity_probes, cpu);
+		raw_spin_lock_irqsave(&probe->lock, flags);
+		if (probe->samples > 0) {
+			if (!sampled || probe->min_lat < min_lat)
+				min_lat = probe->min_lat;
+			sampled = true;
+		}
+		probe->samples = 0;
+		raw_spin_unlock_irqrestore(&probe->lock, flags);
+	}
+
+	if (!sampled)
+		goto requeue;
+
+	/*
+	 * Converge halfway to the ideal gravity at each step, which
+	 * damps the effect of spurious measurements.
+	 */
+	step = 0;
+	if (abs(ktime_to_ns(min_lat)) > GRAVITY_DEADBAND) {
+		step = div_s64(min_lat, 2);
+		step = clamp_t(ktime_t, ktime_add(tuning_shift, step),
+			-tuning_bound, tuning_bound) - tuning_shift;
+	}
+
+	if (step) {
+		gravity = evl_mono_clock.gravity;
+		gravity.irq = shift_gravity(gravity.irq, step);
+		gravity.kernel = shift_gravity(gravity.kernel, step);
+		gravity.user = shift_gravity(gravity.user, step);
+		if (!evl_set_clock_gravity(&evl_mono_clock, &gravity))
+			tuning_shift = ktime_add(tuning_shift, step);
+	}
+
+	record_history(min_lat);
+requeue:
+	schedule_delayed_work(&tuning_work,
+			nsecs_to_jiffies(GRAVITY_TUNING_WINDOW));
+out:
+	mutex_unlock(&tuning_lock);
+}
+
+static void stop_probes(void)
+{
+	int cpu;
+
+	for_each_cpu(cpu, &evl_cpu_affinity)
+		evl_destroy_timer(&per_cpu_ptr(&gravity_probes, cpu)->timer);
+}
+
+/**
+ * evl_start_gravity_tuning - start tuning the gravity continuously
+ * @bound: the maximum correction which may be applied to the
+ * current gravity values, in either direction.
+ *
+ * Calling this routine while tuning restarts tuning with the
+ * current gravity values as the new reference.
+ */
+int evl_start_gravity_tuning(ktime_t bound)
+{
+	struct gravity_probe *probe;
+	ktime_t start;
+	int cpu;
+
+	inband_context_only();
+
+	if (bound <= 0)
+		return -EINVAL;
+
+	if (!evl_is_running())
+		return -EAGAIN;
+
+	evl_stop_gravity_tuning();
+
+	mutex_lock(&tuning_lock);
+
+	start = ktime_add(evl_read_clock(&evl_mono_clock),
+			GRAVITY_PROBE_PERIOD);
+
+	for_each_cpu(cpu, &evl_cpu_affinity) {
+		probe = per_cpu_ptr(&gravity_probes, cpu);
+		raw_spin_lock_init(&probe->lock);
+		probe->samples = 0;
+		evl_init_timer_on_cpu(&probe->timer, cpu, probe_handler);
+		evl_set_timer_name(&probe->timer, "[gravity-probe]");
+		evl_start_timer(&probe->timer, start, GRAVITY_PROBE_PERIOD);
+	}
+
+	tuning_shift = 0;
+	tuning_bound = bound;
+	schedule_delayed_work(&tuning_work,
+			nsecs_to_jiffies(GRAVITY_TUNING_WINDOW));
+
+	mutex_unlock(&tuning_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(evl_start_gravity_tuning);
+
+/**
+ * evl_stop_gravity_tuning - stop tuning the gravity
+ *
+ * The gravity values applied last are kept.
+ */
+void evl_stop_gravity_tuning(void)
+{
+	inband_context_only();
+
+	mutex_lock(&tuning_lock);
+
+	if (tuning_bound) {
+		tuning_bound = 0;
+		stop_probes();
+	}
+
+	mutex_unlock(&tuning_lock);
+
+	/* tune_gravity() bails out early once the bound is cleared. */
+	cancel_delayed_work_sync(&tuning_work);
+}
+EXPORT_SYMBOL_GPL(evl_stop_gravity_tuning);
+
+ktime_t evl_get_gravity_tuning(void)
+{
+	return READ_ONCE(tuning_bound);
+}
+
+ssize_t evl_show_gravity_history(char *buf, size_t size)
+{
+	struct gravity_record *r;
+	ssize_t ret = 0;
+	unsigned int n;
+
+	mutex_lock(&tuning_lock);
+
+	/* Oldest record first. */
+	for (n = 0; n < history_count; n++) {
+		r = history + (history_next + GRAVITY_HISTORY_LEN -
+			history_count + n) % GRAVITY_HISTORY_LEN;
+		ret += scnprintf(buf + ret, size - ret,
+				"%Ld %d %Ldi %Ldk %Ldu\n",
+				ktime_to_ns(r->date), r->min_lat,
+				ktime_to_ns(r->gravity.irq),
+				ktime_to_ns(r->gravity.kernel),
+				ktime_to_ns(r->gravity.user));
+	}
+
+	mutex_unlock(&tuning_lock);
+
+	return ret;
+}
+
+static int gravity_state_notifier(struct notifier_block *nb,
+				unsigned long state, void *arg)
+{
+	/* The probe timers are going away with the core tick. */
+	if (state == EVL_STATE_TEARDOWN)
+		evl_stop_gravity_tuning();
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block gravity_state_nb = {
+	.notifier_call = gravity_state_notifier,
+};
+
+static int __init evl_gravity_init(void)
+{
+	INIT_DELAYED_WORK(&tuning_work, tune_gravity);
+	evl_add_state_chain(&gravity_state_nb);
+
+	return 0;
+}
+late_initcall(evl_gravity_init);
@@ -6,6 +6,7 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/async.h>
 #include <evl/init.h>
 #include <evl/sched.h>
 #include <evl/clock.h>
@@ -17,18 +18,29 @@
 #include <evl/control.h>
 #include <evl/random.h>
 #include <evl/net.h>
+#include <evl/flightrec.h>
+#include <evl/klog.h>
+#include <evl/irqstat.h>
+#include <evl/irqshield.h>
+#include <evl/statmap.h>
+#include <evl/work.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/evl.h>
 
 static char *oobcpus_arg;
 module_param_named(oobcpus, oobcpus_arg, charp, 0444);
 
+static char *tickless_arg;
+module_param_named(tickless_cpus, tickless_arg, charp, 0444);
+
 static char init_state_arg[16] = "enabled";
 module_param_string(state, init_state_arg, sizeof(init_state_arg), 0444);
 
 struct cpumask evl_oob_cpus;
 EXPORT_SYMBOL_GPL(evl_oob_cpus);
 
+struct cpumask evl_tickless_cpus;
+
 DEFINE_PER_CPU(struct evl_machine_cpudata, evl_machine_cpudata);
 EXPORT_PER_CPU_SYMBOL_GPL(evl_machine_cpudata);
 
@@ -160,6 +172,26 @@ cleanup_stage:
 	return ret;
 }
 
+/*
+ * Each of these facilities is checked for availability by its
+ * users, which only show up at the earliest once user space has
+ * started, i.e. after all async initcalls have completed.
+ */
+static void __init init_facilities(void *arg, async_cookie_t cookie)
+{
+	evl_init_flightrec();
+
+	evl_init_irqstats();
+
+	evl_init_irq_shield();
+
+	evl_init_statmap();
+
+	evl_init_thread_pool();
+
+	evl_init_smt();
+}
+
 static int __init evl_init(void)
 {
 	int ret;
@@ -184,6 +216,19 @@ static int __init evl_init(void)
 	} else
 		cpumask_copy(&evl_oob_cpus, cpu_online_mask);
 
+	/*
+	 * Subset of the out-of-band CPUs dedicated to EVL threads,
+	 * on which the in-band tick should never preempt them.
+	 */
+	if (tickless_arg && *tickless_arg) {
+		if (cpulist_parse(tickless_arg, &evl_tickless_cpus)) {
+			printk(EVL_WARNING "invalid set of tickless cpus\n");
+			cpumask_clear(&evl_tickless_cpus);
+		}
+		cpumask_and(&evl_tickless_cpus, &evl_tickless_cpus,
+			&evl_oob_cpus);
+	}
+
 	/* Threads may run on any out-of-band CPU by default. */
 	evl_cpu_affinity = evl_oob_cpus;
 
@@ -194,6 +239,21 @@ static int __init evl_init(void)
 	/* Set up the random generators. */
 	evl_init_rng();
 
+	/* Drivers may log from their oob handlers early. */
+	evl_init_klog();
+
+	/*
+	 * Optional facilities nothing else depends on during boot
+	 * may be set up concurrently with the remaining initcalls.
+	 */
+	if (IS_ENABLED(CONFIG_EVL_ASYNC_INIT))
+		async_schedule(init_facilities, NULL);
+	else
+		init_facilities(NULL, 0);
+
+	if (evl_init_oob_workqueues())
+		printk(EVL_WARNING "cannot create oob workqueues\n");
+
 	printk(EVL_INFO "core started %s%s%s\n",
 		boot_debug_notice,
 		boot_trace_notice,
@@ -0,0 +1,186 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/irqnr.h>
+#include <linux/interrupt.h>
+#include <linux/cpuhotplug.h>
+#include <linux/workqueue.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <evl/init.h>
+#include <evl/assert.h>
+#include <evl/irqshield.h>
+
+/*
+ * Keep in-band device interrupts away from a set of shielded oob
+ * CPUs, leaving those to IRQF_OOB interrupts only. Since drivers may
+ * re-spread their vectors at any time (reset, queue reconfiguration,
+ * CPU hotplug), the whole IRQ space is scanned periodically from
+ * in-band context, any in-band interrupt found routed to a shielded
+ * CPU is steered back to the housekeeping CPUs, and reported as a
+ * violation past the initial pass. Softirqs and irq_work raised by
+ * in-band handlers run on the CPU which took the interrupt, so they
+ * follow.
+ *
+ * Per-CPU interrupts, and those which affinity is managed by the
+ * kernel cannot be moved, so we leave them alone.
+ */
+
+static char *irq_shield_arg;
+module_param_named(irq_shield, irq_shield_arg, charp, 0444);
+
+static uint irq_shield_period_arg = 1000; /* ms */
+module_param_named(irq_shield_period, irq_shield_period_arg, uint, 0444);
+
+struct cpumask evl_irq_shield_cpus;
+
+static struct cpumask housekeeping_cpus;
+
+static atomic_long_t shield_violations;
+
+static bool shield_armed;
+
+static void shield_scan_work(struct work_struct *work);
+
+static DECLARE_DELAYED_WORK(shield_work, shield_scan_work);
+
+static DEFINE_MUTEX(shield_lock);
+
+static bool has_oob_action(struct irq_desc *desc)
+{
+	struct irqaction *action;
+	unsigned long flags;
+	bool ret = false;
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+
+	for (action = desc->action; action; action = action->next) {
+		if (action->flags & IRQF_OOB) {
+			ret = true;
+			break;
+		}
+	}
+
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+
+	return ret;
+}
+
+static bool steer_irq(unsigned int irq, struct irq_desc *desc,
+		struct cpumask *tmp)
+{
+	const struct cpumask *affinity;
+
+	if (READ_ONCE(desc->action) == NULL || irq_is_percpu_devid(irq) ||
+		irqd_affinity_is_managed(&desc->irq_data) ||
+		!irq_can_set_affinity(irq) || has_oob_action(desc))
+		return false;
+
+	affinity = irq_data_get_affinity_mask(&desc->irq_data);
+	if (!cpumask_intersects(affinity, &evl_irq_shield_cpus))
+		return false;
+
+	/* Keep the driver's preference among the housekeeping CPUs. */
+	if (!cpumask_and(tmp, affinity, &housekeeping_cpus))
+		cpumask_copy(tmp, &housekeeping_cpus);
+
+	if (irq_set_affinity(irq, tmp))
+		return false;
+
+	if (shield_armed) {
+		atomic_long_inc(&shield_violations);
+		printk_ratelimited(EVL_WARNING
+			"in-band IRQ%u was routed to shielded CPUs, steered to %*pbl\n",
+			irq, cpumask_pr_args(tmp));
+	}
+
+	return true;
+}
+
+static void shield_scan(void)
+{
+	struct irq_desc *desc;
+	cpumask_var_t tmp;
+	unsigned int irq;
+
+	if (!zalloc_cpumask_var(&tmp, GFP_KERNEL))
+		return;
+
+	mutex_lock(&shield_lock);
+
+	cpumask_andnot(&housekeeping_cpus, cpu_online_mask,
+		&evl_irq_shield_cpus);
+	if (!cpumask_empty(&housekeeping_cpus)) {
+		for_each_irq_desc(irq, desc)
+			steer_irq(irq, desc, tmp);
+	}
+
+	shield_armed = true;
+
+	mutex_unlock(&shield_lock);
+
+	free_cpumask_var(tmp);
+}
+
+static void shield_scan_work(struct work_struct *work)
+{
+	shield_scan();
+	schedule_delayed_work(&shield_work,
+			msecs_to_jiffies(irq_shield_period_arg));
+}
+
+/* Hotplug may re-spread interrupts, re-scan as soon as possible. */
+static int shield_cpu_online(unsigned int cpu)
+{
+	mod_delayed_work(system_wq, &shield_work, 0);
+
+	return 0;
+}
+
+unsigned long evl_get_irq_shield_violations(void)
+{
+	return atomic_long_read(&shield_violations);
+}
+
+void __init evl_init_irq_shield(void)
+{
+	int ret;
+
+	if (!irq_shield_arg || !*irq_shield_arg)
+		return;
+
+	if (cpulist_parse(irq_shield_arg, &evl_irq_shield_cpus)) {
+		printk(EVL_WARNING "invalid set of IRQ shielded cpus\n");
+		cpumask_clear(&evl_irq_shield_cpus);
+		return;
+	}
+
+	/* Only oob CPUs can be shielded. */
+	cpumask_and(&evl_irq_shield_cpus, &evl_irq_shield_cpus, &evl_oob_cpus);
+	if (cpumask_empty(&evl_irq_shield_cpus))
+		return;
+
+	if (cpumask_subset(cpu_online_mask, &evl_irq_shield_cpus)) {
+		printk(EVL_WARNING "cannot shield all cpus from in-band IRQs\n");
+		cpumask_clear(&evl_irq_shield_cpus);
+		return;
+	}
+
+	if (irq_shield_period_arg == 0)
+		irq_shield_period_arg = 1000;
+
+	shield_scan();
+
+	ret = cpuhp_setup_state_nocalls(CPUHP_AP_ONLINE_DYN, "evl/irqshield:online",
+					shield_cpu_online, NULL);
+	if (ret < 0)
+		printk(EVL_WARNING "cannot track cpu hotplug for IRQ shield\n");
+
+	schedule_delayed_work(&shield_work,
+			msecs_to_jiffies(irq_shield_period_arg));
+}
@@ -0,0 +1,296 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/interrupt.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <evl/assert.h>
+#include <evl/clock.h>
+#include <evl/irqstat.h>
+
+/*
+ * Per-IRQ, per-CPU pipeline statistics. For every interrupt, we
+ * count the events which were handled on the oob stage immediately,
+ * and those which got deferred, i.e. logged for later delivery. For
+ * the former, we measure the delay between the hardware entry and
+ * the oob stage taking over, for the latter the delay until the
+ * in-band stage eventually replayed them. Both delays feed log2
+ * histograms. All updates are local to the CPU receiving the event,
+ * with hard irqs off, readers from /proc are lockless.
+ */
+
+/* Bucket #0 is < 256 ns, #n is [2^(n+7), 2^(n+8)) ns, the last one open. */
+#define EVL_IRQSTAT_BUCKETS	16
+
+struct evl_irqstat {
+	u64 oob_count;
+	u64 deferred;
+	u64 replayed;
+	ktime_t pending_since;
+	u64 oob_max_ns;
+	u64 replay_max_ns;
+	u32 oob_hist[EVL_IRQSTAT_BUCKETS];
+	u32 replay_hist[EVL_IRQSTAT_BUCKETS];
+};
+
+/* The event being pipelined on this CPU. */
+struct evl_irq_inflight {
+	struct irq_desc *desc;
+	ktime_t date;
+	bool oob;
+};
+
+DEFINE_STATIC_KEY_FALSE(evl_irqstats_enabled);
+
+static DEFINE_PER_CPU(struct evl_irq_inflight, irq_inflight);
+
+static DEFINE_PER_CPU(struct evl_irqstat *, irqstat_table);
+
+static unsigned int irqstat_nr_irqs;
+
+static inline int latency_bucket(u64 ns)
+{
+	int b = ns < 256 ? 0 : ilog2(ns) - 7;
+
+	return min(b, EVL_IRQSTAT_BUCKETS - 1);
+}
+
+static inline struct evl_irqstat *get_irqstat(struct irq_desc *desc)
+{
+	unsigned int irq = irq_desc_get_irq(desc);
+
+	if (irq >= irqstat_nr_irqs)
+		return NULL;
+
+	return raw_cpu_read(irqstat_table) + irq;
+}
+
+notrace void __evl_irqstat_entry(struct irq_desc *desc)
+{
+	struct evl_irq_inflight *inflight = raw_cpu_ptr(&irq_inflight);
+
+	inflight->desc = desc;
+	inflight->date = evl_read_clock(&evl_mono_clock);
+	inflight->oob = false;
+}
+
+notrace void __evl_irqstat_oob(void)
+{
+	struct evl_irq_inflight *inflight = raw_cpu_ptr(&irq_inflight);
+	struct evl_irqstat *st;
+	u64 delay;
+
+	/* Oob events replayed on unstall have no hardware entry. */
+	if (inflight->desc == NULL || inflight->oob)
+		return;
+
+	inflight->oob = true;
+	st = get_irqstat(inflight->desc);
+	if (st == NULL)
+		return;
+
+	delay = ktime_to_ns(ktime_sub(evl_read_clock(&evl_mono_clock),
+					inflight->date));
+	st->oob_count++;
+	st->oob_hist[latency_bucket(delay)]++;
+	if (delay > st->oob_max_ns)
+		st->oob_max_ns = delay;
+}
+
+notrace void __evl_irqstat_exit(void)
+{
+	struct evl_irq_inflight *inflight = raw_cpu_ptr(&irq_inflight);
+	struct evl_irqstat *st;
+
+	if (inflight->desc == NULL)
+		return;
+
+	if (!inflight->oob) {
+		st = get_irqstat(inflight->desc);
+		if (st) {
+			st->deferred++;
+			/* Multiple posts coalesce into a single replay. */
+			if (st->pending_since == 0)
+				st->pending_since = inflight->date;
+		}
+	}
+
+	inflight->desc = NULL;
+}
+
+notrace void __evl_irqstat_replay(struct irq_desc *desc)
+{
+	struct evl_irqstat *st;
+	unsigned long flags;
+	u64 delay;
+
+	flags = hard_local_irq_save();
+
+	st = get_irqstat(desc);
+	if (st && st->pending_since) {
+		delay = ktime_to_ns(ktime_sub(evl_read_clock(&evl_mono_clock),
+						st->pending_since));
+		st->pending_since = 0;
+		st->replayed++;
+		st->replay_hist[latency_bucket(delay)]++;
+		if (delay > st->replay_max_ns)
+			st->replay_max_ns = delay;
+	}
+
+	hard_local_irq_restore(flags);
+}
+
+static inline bool irqstat_active(struct evl_irqstat *st)
+{
+	return READ_ONCE(st->oob_count) || READ_ONCE(st->deferred);
+}
+
+static void show_irq_name(struct seq_file *p, unsigned int irq)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+	struct irqaction *action;
+	unsigned long flags;
+
+	if (desc == NULL) {
+		seq_puts(p, " -\n");
+		return;
+	}
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+
+	action = desc->action;
+	if (action && action->name)
+		seq_printf(p, " %s%s", action->name,
+			action->flags & IRQF_OOB ? " [oob]" : "");
+	else
+		seq_puts(p, " -");
+
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+
+	seq_putc(p, '\n');
+}
+
+static void *irqstat_seq_start(struct seq_file *p, loff_t *pos)
+{
+	return *pos <= irqstat_nr_irqs ? pos : NULL;
+}
+
+static void *irqstat_seq_next(struct seq_file *p, void *v, loff_t *pos)
+{
+	(*pos)++;
+
+	return irqstat_seq_start(p, pos);
+}
+
+static void irqstat_seq_stop(struct seq_file *p, void *v)
+{ }
+
+/* Position zero is the header, IRQ n is shown at position n + 1. */
+static int counters_seq_show(struct seq_file *p, void *v)
+{
+	int irq = *(loff_t *)v - 1, cpu;
+	struct evl_irqstat *st;
+
+	if (irq < 0) {
+		seq_printf(p, "%5s %4s %12s %10s %12s %12s %10s  NAME\n",
+			"IRQ", "CPU", "OOB", "OOB_MAX", "DEFERRED",
+			"REPLAYED", "INB_MAX");
+		return 0;
+	}
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu(irqstat_table, cpu) + irq;
+		if (!irqstat_active(st))
+			continue;
+		seq_printf(p, "%5d %4d %12llu %10llu %12llu %12llu %10llu ",
+			irq, cpu, st->oob_count, st->oob_max_ns,
+			st->deferred, st->replayed, st->replay_max_ns);
+		show_irq_name(p, irq);
+	}
+
+	return 0;
+}
+
+static void show_histogram(struct seq_file *p, int irq, int cpu,
+			const char *stage, u32 *hist)
+{
+	int n;
+
+	seq_printf(p, "%5d %4d %-6s", irq, cpu, stage);
+	for (n = 0; n < EVL_IRQSTAT_BUCKETS; n++)
+		seq_printf(p, " %u", READ_ONCE(hist[n]));
+	seq_putc(p, '\n');
+}
+
+static int latency_seq_show(struct seq_file *p, void *v)
+{
+	int irq = *(loff_t *)v - 1, cpu;
+	struct evl_irqstat *st;
+
+	if (irq < 0) {
+		seq_printf(p, "# log2 buckets in ns: <256, [256-512), ..., >=%u\n",
+			1U << (EVL_IRQSTAT_BUCKETS + 6));
+		seq_printf(p, "%5s %4s %-6s BUCKETS\n", "IRQ", "CPU", "STAGE");
+		return 0;
+	}
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu(irqstat_table, cpu) + irq;
+		if (READ_ONCE(st->oob_count))
+			show_histogram(p, irq, cpu, "oob", st->oob_hist);
+		if (READ_ONCE(st->replayed))
+			show_histogram(p, irq, cpu, "inband", st->replay_hist);
+	}
+
+	return 0;
+}
+
+static const struct seq_operations counters_seq_ops = {
+	.start	= irqstat_seq_start,
+	.next	= irqstat_seq_next,
+	.stop	= irqstat_seq_stop,
+	.show	= counters_seq_show,
+};
+
+static const struct seq_operations latency_seq_ops = {
+	.start	= irqstat_seq_start,
+	.next	= irqstat_seq_next,
+	.stop	= irqstat_seq_stop,
+	.show	= latency_seq_show,
+};
+
+void __init evl_init_irqstats(void)
+{
+	struct evl_irqstat *table;
+	int cpu;
+
+	irqstat_nr_irqs = irq_get_nr_irqs();
+
+	for_each_possible_cpu(cpu) {
+		table = vzalloc(irqstat_nr_irqs * sizeof(*table));
+		if (table == NULL)
+			goto fail;
+		per_cpu(irqstat_table, cpu) = table;
+	}
+
+	proc_create_seq("oob_interrupts", 0444, NULL, &counters_seq_ops);
+	proc_create_seq("oob_irq_latency", 0444, NULL, &latency_seq_ops);
+
+	static_branch_enable(&evl_irqstats_enabled);
+
+	return;
+fail:
+	for_each_possible_cpu(cpu) {
+		vfree(per_cpu(irqstat_table, cpu));
+		per_cpu(irqstat_table, cpu) = NULL;
+	}
+
+	printk(EVL_WARNING "cannot allocate IRQ statistics\n");
+}
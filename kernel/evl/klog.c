@@ -0,0 +1,164 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/printk.h>
+#include <evl/clock.h>
+#include <evl/work.h>
+#include <evl/klog.h>
+#include <trace/events/evl.h>
+
+/*
+ * Per-CPU log rings for the out-of-band stage. Writers fill a slot
+ * locally with hard irqs off, a single in-band reader drains all
+ * rings in batches into the kernel log and the trace buffer, from a
+ * work item kicked by the writers. Messages which do not fit are
+ * dropped and counted, writers never wait for the reader.
+ */
+
+#define KLOG_MSGLEN	128
+
+static uint klog_records_arg = 256;
+module_param_named(klog_records, klog_records_arg, uint, 0444);
+
+DEFINE_STATIC_KEY_FALSE(evl_klog_enabled);
+
+struct klog_record {
+	ktime_t date;
+	char text[KLOG_MSGLEN];
+};
+
+struct klog_ring {
+	unsigned long head;	/* Next slot to write, per writer. */
+	unsigned long tail;	/* Next slot to read, per reader. */
+	unsigned long dropped;
+	unsigned long reported;
+	struct klog_record records[];
+};
+
+static void *klog_area;
+
+static unsigned int klog_nr_records;
+
+static size_t klog_ring_size;
+
+static struct evl_work klog_work;
+
+static inline struct klog_ring *get_ring(int cpu)
+{
+	return klog_area + cpu * klog_ring_size;
+}
+
+static inline
+struct klog_record *get_record(struct klog_ring *ring, unsigned long seq)
+{
+	return ring->records + (seq & (klog_nr_records - 1));
+}
+
+notrace void __evl_klog(const char *fmt, ...)
+{
+	struct klog_record *rec;
+	struct klog_ring *ring;
+	unsigned long flags, head;
+	va_list args;
+
+	flags = hard_local_irq_save();
+
+	ring = get_ring(raw_smp_processor_id());
+
+	/* We might be preempting a writer on the same CPU. */
+	if (unlikely(in_nmi()))
+		goto drop;
+
+	head = ring->head;
+	if (head - smp_load_acquire(&ring->tail) >= klog_nr_records)
+		goto drop;
+
+	rec = get_record(ring, head);
+	rec->date = evl_read_clock(&evl_mono_clock);
+	va_start(args, fmt);
+	vscnprintf(rec->text, sizeof(rec->text), fmt, args);
+	va_end(args);
+	smp_store_release(&ring->head, head + 1);
+
+	hard_local_irq_restore(flags);
+
+	evl_call_inband(&klog_work);
+
+	return;
+drop:
+	WRITE_ONCE(ring->dropped, ring->dropped + 1);
+	hard_local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(__evl_klog);
+
+static void emit_record(int cpu, struct klog_record *rec)
+{
+	const char *text = rec->text;
+	int level;
+
+	trace_evl_klog(cpu, rec->date, printk_skip_level(text));
+
+	level = printk_get_level(text);
+	if (level)
+		printk("%c%cEVL: [%d] %s", KERN_SOH_ASCII, level, cpu,
+			printk_skip_level(text));
+	else
+		printk(EVL_INFO "[%d] %s", cpu, text);
+}
+
+static void drain_ring(int cpu)
+{
+	struct klog_ring *ring = get_ring(cpu);
+	struct klog_record rec;
+	unsigned long tail, head, dropped;
+
+	tail = ring->tail;
+	head = smp_load_acquire(&ring->head);
+
+	while (tail != head) {
+		rec = *get_record(ring, tail);
+		/* Release the slot before the (slow) output. */
+		smp_store_release(&ring->tail, ++tail);
+		emit_record(cpu, &rec);
+	}
+
+	dropped = READ_ONCE(ring->dropped);
+	if (dropped != ring->reported) {
+		printk(EVL_WARNING "[%d] %lu log messages lost\n",
+			cpu, dropped - ring->reported);
+		ring->reported = dropped;
+	}
+}
+
+static void do_klog_work(struct evl_work *work)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		drain_ring(cpu);
+}
+
+void __init evl_init_klog(void)
+{
+	if (klog_records_arg == 0)
+		return;
+
+	klog_nr_records = roundup_pow_of_two(klog_records_arg);
+	klog_ring_size = struct_size_t(struct klog_ring, records,
+				klog_nr_records);
+	klog_ring_size = ALIGN(klog_ring_size, SMP_CACHE_BYTES);
+
+	klog_area = vzalloc(klog_ring_size * nr_cpu_ids);
+	if (klog_area == NULL) {
+		printk(EVL_WARNING "cannot allocate oob log rings\n");
+		return;
+	}
+
+	evl_init_work(&klog_work, do_klog_work);
+	static_branch_enable(&evl_klog_enabled);
+}
@@ -8,31 +8,116 @@
  */
 
 #include <linux/kmemleak.h>
+#include <linux/percpu.h>
 #include <evl/cache.h>
 
+/*
+ * Growing a table migrates the entries to the larger one in a single
+ * pass under the cache lock, since updaters may be running in atomic
+ * context. Meanwhile, the old table links to the new one via
+ * ->future, and lockless lookups consult both in sequence. An entry
+ * moves from the tail of its old chain to the head of its new chain,
+ * after which it is unlinked from the old one, so that a concurrent
+ * lookup may only visit extra entries, never miss any.
+ */
+
 static int realloc_hash_table(struct evl_cache *cache);
 
 static void hash_free_rcu(struct rcu_head *rcu);
 
 static void entry_free_rcu(struct rcu_head *rcu);
 
-static void entry_free_work(struct evl_work *work);
+static void reclaim_entries(struct evl_work *work);
+
+/*
+ * Entries released from oob are queued here, for a single work item
+ * to hand them over to RCU in-band. Whichever releaser finds the
+ * queue empty triggers the work, so we only pay for a stage
+ * transition once per batch.
+ */
+static LLIST_HEAD(reclaim_queue);
+
+static EVL_DEFINE_WORK(reclaim_work, reclaim_entries);
 
 int evl_init_cache(struct evl_cache *cache) /* in-band */
 {
+	int ret;
+
 	spin_lock_init(&cache->lock);
 	cache->hash_table = NULL;
 
-	return realloc_hash_table(cache);
+	cache->stats = alloc_percpu(struct evl_cache_stats);
+	if (!cache->stats)
+		return -ENOMEM;
+
+	ret = realloc_hash_table(cache);
+	if (ret) {
+		free_percpu(cache->stats);
+		cache->stats = NULL;
+	}
+
+	return ret;
 }
 EXPORT_SYMBOL_GPL(evl_init_cache);
 
 void evl_cleanup_cache(struct evl_cache *cache) /* in-band */
 {
 	evl_flush_cache(cache);
+	free_percpu(cache->stats);
+	cache->stats = NULL;
 }
 EXPORT_SYMBOL_GPL(evl_cleanup_cache);
 
+static inline struct evl_hash_table *
+get_table_locked(struct evl_cache *cache)
+{
+	return rcu_dereference_protected(cache->hash_table,
+					lockdep_is_held(&cache->lock));
+}
+
+static inline struct evl_hash_table *
+get_future_locked(struct evl_cache *cache, struct evl_hash_table *ht)
+{
+	return rcu_dereference_protected(ht->future,
+					lockdep_is_held(&cache->lock));
+}
+
+static inline struct evl_cache_entry __rcu **
+get_bucket(struct evl_hash_table *ht, u32 hashval)
+{
+	return &ht->buckets[hashval >> (32 - ht->shift)]; /* Modulo table size. */
+}
+
+static inline void drop_entry(struct evl_cache_entry *e)
+{
+	if (refcount_dec_and_test(&e->refcnt))
+		call_rcu(&e->rcu, entry_free_rcu);
+}
+
+/* cache->lock held */
+static bool unlink_entry_locked(struct evl_cache *cache,
+				struct evl_hash_table *ht,
+				u32 hashval, const void *key)
+{
+	struct evl_cache_entry *e, **ep;
+
+	for (ep = get_bucket(ht, hashval),
+		     e = rcu_dereference_protected(*ep,
+			     lockdep_is_held(&cache->lock));
+	     e; e = rcu_dereference_protected(e->next,
+		     lockdep_is_held(&cache->lock))) {
+		if (cache->ops->eq(e, key)) {
+			rcu_assign_pointer(*ep, e->next);
+			ht->nr_entries--;
+			drop_entry(e);
+			return true;
+		}
+		ep = &e->next;
+	}
+
+	return false;
+}
+
 /*
  * Cache a new entry. The cache must have been locked prior to calling
  * this routine. This call must be issued from the in-band stage.
@@ -43,50 +128,49 @@ int evl_add_cache_entry_locked(struct evl_cache *cache, /* in-band */
 			struct evl_cache_entry *entry)
 {
 	const void *key = cache->ops->get_key(entry);
-	struct evl_cache_entry *e, **ep;
-	struct evl_hash_table *ht;
+	struct evl_hash_table *ht, *target, *t;
+	struct evl_cache_entry __rcu **bucket;
 	u32 hashval;
 	int ret;
 
 	hashval = cache->ops->hash(key);
 retry:
-	ht = rcu_dereference_protected(cache->hash_table,
-				lockdep_is_held(&cache->lock));
-	if (!ht || ht->nr_entries >= (1 << ht->shift)) {
-		spin_unlock_bh(&cache->lock);
-		ret = realloc_hash_table(cache);
-		spin_lock_bh(&cache->lock);
-		if (ret)
-			return ret;
-		goto retry;
-	}
+	ht = get_table_locked(cache);
+	if (!ht)
+		goto grow;
 
 	/*
-	 * Find the place to attach the new entry, dropping a previous
-	 * match on the fly if any.
+	 * While resizing, new entries go to the future table, which
+	 * is larger already.
 	 */
-	hashval >>= (32 - ht->shift); /* Modulo table size. */
-	for (ep = &ht->buckets[hashval],
-		     e = rcu_dereference_protected(ht->buckets[hashval],
-			     lockdep_is_held(&cache->lock));
-	     e; e = rcu_dereference_protected(e->next,
-		     lockdep_is_held(&cache->lock))) {
-		if (cache->ops->eq(e, key)) {
-			rcu_assign_pointer(*ep, e->next);
-			if (refcount_dec_and_test(&e->refcnt))
-				call_rcu(&e->rcu, entry_free_rcu);
-		} else {
-			ep = &e->next;
-		}
+	target = get_future_locked(cache, ht);
+	if (!target) {
+		if (ht->nr_entries >= (1 << ht->shift))
+			goto grow;
+		target = ht;
 	}
 
-	ht->nr_entries++;
+	/* Drop a previous match on the fly if any, from any table. */
+	for (t = ht; t; t = get_future_locked(cache, t))
+		unlink_entry_locked(cache, t, hashval, key);
+
+	target->nr_entries++;
 	entry->cache = cache;
 	refcount_set(&entry->refcnt, 1);
-	evl_init_work(&entry->work, entry_free_work);
-	rcu_assign_pointer(*ep, entry);
+	bucket = get_bucket(target, hashval);
+	RCU_INIT_POINTER(entry->next,
+			rcu_dereference_protected(*bucket,
+				lockdep_is_held(&cache->lock)));
+	rcu_assign_pointer(*bucket, entry);
 
 	return 0;
+grow:
+	spin_unlock_bh(&cache->lock);
+	ret = realloc_hash_table(cache);
+	spin_lock_bh(&cache->lock);
+	if (ret)
+		return ret;
+	goto retry;
 }
 EXPORT_SYMBOL_GPL(evl_add_cache_entry_locked);
 
@@ -118,33 +202,16 @@ EXPORT_SYMBOL_GPL(evl_add_cache_entry);
  */
 void evl_del_cache_entry_locked(struct evl_cache *cache, const void *key) /* in-band */
 {
-	struct evl_cache_entry *e, **ep;
 	struct evl_hash_table *ht;
 	u32 hashval;
 
-	ht = rcu_dereference_protected(cache->hash_table,
-				lockdep_is_held(&cache->lock));
-	if (!ht)
-		return;
-
 	hashval = cache->ops->hash(key);
-	hashval >>= (32 - ht->shift); /* Modulo table size. */
 
 	/* Don't bark on invalid removal request, just ignore it. */
-	for (ep = &ht->buckets[hashval],
-		     e = rcu_dereference_protected(
-			     ht->buckets[hashval],
-			     lockdep_is_held(&cache->lock));
-	     e; e = rcu_dereference_protected(
-		     e->next,
-		     lockdep_is_held(&cache->lock))) {
-		if (cache->ops->eq(e, key)) {
-			rcu_assign_pointer(*ep, e->next);
-			if (refcount_dec_and_test(&e->refcnt))
-				call_rcu(&e->rcu, entry_free_rcu);
+	for (ht = get_table_locked(cache); ht;
+	     ht = get_future_locked(cache, ht)) {
+		if (unlink_entry_locked(cache, ht, hashval, key))
 			break;
-		}
-		ep = &e->next;
 	}
 }
 EXPORT_SYMBOL_GPL(evl_del_cache_entry_locked);
@@ -163,34 +230,42 @@ void evl_del_cache_entry(struct evl_cache *cache, const void *key) /* in-band */
 }
 EXPORT_SYMBOL_GPL(evl_del_cache_entry);
 
-void evl_flush_cache(struct evl_cache *cache) /* in-band */
+/* cache->lock held */
+static void drop_table_locked(struct evl_cache *cache,
+			struct evl_hash_table *ht)
 {
-	struct evl_cache_entry __rcu **buckets, *e, *next;
-	struct evl_hash_table *ht;
-	size_t size;
+	struct evl_cache_entry *e, *next;
 	int n;
 
+	for (n = 0; n < (1 << ht->shift); n++) {
+		for (e = rcu_dereference_protected(ht->buckets[n],
+				lockdep_is_held(&cache->lock)); e; e = next) {
+			next = rcu_dereference_protected(e->next,
+					lockdep_is_held(&cache->lock));
+			drop_entry(e);
+		}
+	}
+
+	call_rcu(&ht->rcu, hash_free_rcu);
+}
+
+void evl_flush_cache(struct evl_cache *cache) /* in-band */
+{
+	struct evl_hash_table *ht, *future;
+
 	spin_lock_bh(&cache->lock);
 
-	ht = rcu_dereference_protected(cache->hash_table,
-				lockdep_is_held(&cache->lock));
+	/*
+	 * A resize in progress notices that the table went away next
+	 * time it grabs the lock, then bails out.
+	 */
+	ht = get_table_locked(cache);
 	if (likely(ht)) {
 		rcu_assign_pointer(cache->hash_table, NULL);
-		size = (1 << ht->shift) * sizeof(struct evl_cache_entry *);
-		buckets = rcu_dereference_protected(ht->buckets,
-					lockdep_is_held(&cache->lock));
-
-		for (n = 0; n < (1 << ht->shift); n++) {
-			for (e = rcu_dereference_protected(buckets[n],
-					lockdep_is_held(&cache->lock)); e; e = next) {
-				next = rcu_dereference_protected(e->next,
-						lockdep_is_held(&cache->lock));
-				if (refcount_dec_and_test(&e->refcnt))
-					call_rcu(&e->rcu, entry_free_rcu);
-			}
-		}
-
-		call_rcu(&ht->rcu, hash_free_rcu);
+		future = get_future_locked(cache, ht);
+		drop_table_locked(cache, ht);
+		if (future)
+			drop_table_locked(cache, future);
 	}
 
 	spin_unlock_bh(&cache->lock);
@@ -201,30 +276,24 @@ void evl_clean_cache(struct evl_cache *cache,
 		bool (*testfn)(struct evl_cache_entry *e, void *arg),
 		void *arg) /* in-band */
 {
-	struct evl_cache_entry __rcu **buckets, *e, **ep, *next;
+	struct evl_cache_entry *e, **ep, *next;
 	struct evl_hash_table *ht;
-	size_t size;
 	int n;
 
 	spin_lock_bh(&cache->lock);
 
-	ht = rcu_dereference_protected(cache->hash_table,
-				lockdep_is_held(&cache->lock));
-	if (likely(ht)) {
-		size = (1 << ht->shift) * sizeof(struct evl_cache_entry *);
-		buckets = rcu_dereference_protected(ht->buckets,
-					lockdep_is_held(&cache->lock));
-
+	for (ht = get_table_locked(cache); ht;
+	     ht = get_future_locked(cache, ht)) {
 		for (n = 0; n < (1 << ht->shift); n++) {
 			for (ep = &ht->buckets[n],
-				     e = rcu_dereference_protected(buckets[n],
+				     e = rcu_dereference_protected(*ep,
 					lockdep_is_held(&cache->lock)); e; e = next) {
 				next = rcu_dereference_protected(e->next,
 						lockdep_is_held(&cache->lock));
 				if (testfn(e, arg)) {
 					rcu_assign_pointer(*ep, e->next);
-					if (refcount_dec_and_test(&e->refcnt))
-						call_rcu(&e->rcu, entry_free_rcu);
+					ht->nr_entries--;
+					drop_entry(e);
 				} else {
 					ep = &e->next;
 				}
@@ -236,31 +305,54 @@ void evl_clean_cache(struct evl_cache *cache,
 }
 EXPORT_SYMBOL_GPL(evl_clean_cache);
 
+/* in-band / oob */
+static inline void update_stats(struct evl_cache *cache,
+				unsigned int depth, bool found)
+{
+	/*
+	 * Racing with the other stage on the same CPU may lose an
+	 * update, which is fine for statistics.
+	 */
+	this_cpu_inc(cache->stats->lookups);
+	this_cpu_add(cache->stats->probes, depth);
+	if (!found)
+		this_cpu_inc(cache->stats->misses);
+	if (depth > this_cpu_read(cache->stats->max_depth))
+		this_cpu_write(cache->stats->max_depth, depth);
+}
+
 /* in-band / oob */
 struct evl_cache_entry *evl_lookup_cache(struct evl_cache *cache,
 					const void *key)
 {
 	struct evl_cache_entry *e = NULL;
 	struct evl_hash_table *ht;
+	unsigned int depth = 0;
 	u32 hashval;
 
+	hashval = cache->ops->hash(key);
+
 	rcu_read_lock();
 
-	ht = rcu_dereference(cache->hash_table);
-	if (likely(ht)) {
-		hashval = cache->ops->hash(key);
-		hashval >>= (32 - ht->shift); /* Modulo table size. */
-		for (e = rcu_dereference(ht->buckets[hashval]);
+	/* Consult the future table last, see realloc_hash_table(). */
+	for (ht = rcu_dereference(cache->hash_table); ht;
+	     ht = rcu_dereference(ht->future)) {
+		/* Order against an entry moving on, see migrate_bucket(). */
+		smp_rmb();
+		for (e = rcu_dereference(*get_bucket(ht, hashval));
 		     e; e = rcu_dereference(e->next)) {
+			depth++;
 			if (cache->ops->eq(e, key)) {
 				refcount_inc(&e->refcnt);
-				break;
+				goto out;
 			}
 		}
 	}
-
+out:
 	rcu_read_unlock();
 
+	update_stats(cache, depth, e != NULL);
+
 	return e;
 }
 EXPORT_SYMBOL_GPL(evl_lookup_cache);
@@ -271,12 +363,49 @@ void evl_put_cache_entry(struct evl_cache_entry *entry)
 	if (refcount_dec_and_test(&entry->refcnt)) {
 		if (running_inband())
 			call_rcu(&entry->rcu, entry_free_rcu);
-		else
-			evl_call_inband(&entry->work);
+		else if (llist_add(&entry->reclaim, &reclaim_queue))
+			evl_call_inband(&reclaim_work);
 	}
 }
 EXPORT_SYMBOL_GPL(evl_put_cache_entry);
 
+/*
+ * name log2(buckets) entries lookups misses probes max_depth, with a
+ * trailing '*' if resizing.
+ */
+ssize_t evl_show_cache_stats(struct evl_cache *cache, /* in-band */
+			char *buf, size_t size)
+{
+	unsigned long lookups = 0, misses = 0, probes = 0;
+	struct evl_hash_table *ht, *future;
+	unsigned int max_depth = 0, shift;
+	struct evl_cache_stats *st;
+	int cpu, nr_entries;
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(cache->stats, cpu);
+		lookups += READ_ONCE(st->lookups);
+		misses += READ_ONCE(st->misses);
+		probes += READ_ONCE(st->probes);
+		max_depth = max(max_depth, READ_ONCE(st->max_depth));
+	}
+
+	spin_lock_bh(&cache->lock);
+	ht = get_table_locked(cache);
+	future = ht ? get_future_locked(cache, ht) : NULL;
+	shift = ht ? ht->shift : 0;
+	nr_entries = ht ? ht->nr_entries : 0;
+	if (future)
+		nr_entries += future->nr_entries;
+	spin_unlock_bh(&cache->lock);
+
+	return scnprintf(buf, size, "%s %u %d %lu %lu %lu %u%s\n",
+			cache->name, shift, nr_entries,
+			lookups, misses, probes, max_depth,
+			future ? " *" : "");
+}
+EXPORT_SYMBOL_GPL(evl_show_cache_stats);
+
 static void entry_free_rcu(struct rcu_head *rcu) /* in-band */
 {
 	struct evl_cache_entry *e = container_of(rcu, struct evl_cache_entry, rcu);
@@ -284,15 +413,19 @@ static void entry_free_rcu(struct rcu_head *rcu) /* in-band */
 }
 
 /*
- * Trampoline to schedule our RCU callback. We could not do this
+ * Trampoline to schedule our RCU callbacks. We could not do this
  * directly from oob, since call_rcu() would not support this, _and_
  * RCU does neither watch nor even know about the oob context in the
  * first place.
  */
-static void entry_free_work(struct evl_work *work) /* in-band */
+static void reclaim_entries(struct evl_work *work) /* in-band */
 {
-	struct evl_cache_entry *e = container_of(work, struct evl_cache_entry, work);
-	call_rcu(&e->rcu, entry_free_rcu);
+	struct evl_cache_entry *e, *next;
+	struct llist_node *list;
+
+	list = llist_del_all(&reclaim_queue);
+	llist_for_each_entry_safe(e, next, list, reclaim)
+		call_rcu(&e->rcu, entry_free_rcu);
 }
 
 static void hash_free_rcu(struct rcu_head *head)
@@ -312,6 +445,46 @@ static void hash_free_rcu(struct rcu_head *head)
 	kfree(ht);
 }
 
+/*
+ * Move the entries of an old bucket to the future table, tail
+ * first. Returns the number of entries moved.
+ */
+static int migrate_bucket(struct evl_cache *cache, /* cache->lock held */
+			struct evl_hash_table *old_ht,
+			struct evl_hash_table *new_ht, int n)
+{
+	struct evl_cache_entry *e, **ep, **bucket;
+	int count = 0;
+	u32 hash;
+
+	for (;;) {
+		ep = &old_ht->buckets[n];
+		e = rcu_dereference_protected(*ep,
+					lockdep_is_held(&cache->lock));
+		if (!e)
+			break;
+
+		while (rcu_access_pointer(e->next)) {
+			ep = &e->next;
+			e = rcu_dereference_protected(*ep,
+					lockdep_is_held(&cache->lock));
+		}
+
+		hash = cache->ops->hash(cache->ops->get_key(e));
+		bucket = get_bucket(new_ht, hash);
+		rcu_assign_pointer(e->next,
+				rcu_dereference_protected(*bucket,
+					lockdep_is_held(&cache->lock)));
+		rcu_assign_pointer(*bucket, e);
+		rcu_assign_pointer(*ep, NULL);
+		old_ht->nr_entries--;
+		new_ht->nr_entries++;
+		count++;
+	}
+
+	return count;
+}
+
 /*
  * Grow the hash table of a cache.  We may look up into a table from
  * oob inside a read-side RCU section (Dovetail may emulate an NMI
@@ -323,7 +496,6 @@ static int realloc_hash_table(struct evl_cache *cache)
 	struct evl_cache_entry __rcu **buckets;
 	unsigned int shift;
 	size_t size;
-	u32 hash;
 	int n;
 
 	rcu_read_lock();
@@ -354,47 +526,38 @@ static int realloc_hash_table(struct evl_cache *cache)
 	new_ht->buckets = buckets;
 	new_ht->shift = shift;
 	new_ht->nr_entries = 0;
+	RCU_INIT_POINTER(new_ht->future, NULL);
 
 	spin_lock_bh(&cache->lock);
 
-	old_ht = rcu_dereference_protected(cache->hash_table, lockdep_is_held(&cache->lock));
-	if (!old_ht)
-		goto finish;
+	old_ht = get_table_locked(cache);
+	if (!old_ht) {
+		rcu_assign_pointer(cache->hash_table, new_ht);
+		spin_unlock_bh(&cache->lock);
+		return 0;
+	}
 
 	/* Somebody slipped in and grew the table already, abort. */
-	if (old_ht->shift >= shift) {
+	if (old_ht->shift >= shift || get_future_locked(cache, old_ht)) {
 		spin_unlock_bh(&cache->lock);
 		hash_free_rcu(&new_ht->rcu);
 		return 0;
 	}
 
-	/* Copy the old table content to the new (larger) one. */
-	for (n = 0; n < (1 << old_ht->shift); n++) {
-		struct evl_cache_entry *e, *next;
-
-		for (e = rcu_dereference_protected(old_ht->buckets[n],
-						   lockdep_is_held(&cache->lock));
-		     e; e = next) {
-			hash = cache->ops->hash(e);
-			hash >>= (32 - shift);
-			next = rcu_dereference_protected(e->next,
-						lockdep_is_held(&cache->lock));
-			rcu_assign_pointer(e->next,
-					   rcu_dereference_protected(
-						new_ht->buckets[hash],
-						lockdep_is_held(&cache->lock)));
-			rcu_assign_pointer(new_ht->buckets[hash], e);
-		}
-	}
+	/* Lookups and updates consider the new table from now on. */
+	rcu_assign_pointer(old_ht->future, new_ht);
 
-	new_ht->nr_entries = old_ht->nr_entries;
+	for (n = 0; n < (1 << old_ht->shift); n++)
+		migrate_bucket(cache, old_ht, new_ht, n);
 
-finish:
+	/*
+	 * Keep old_ht->future valid until the old table is released,
+	 * lookups still walking the latter go on to the new one.
+	 */
 	rcu_assign_pointer(cache->hash_table, new_ht);
 	spin_unlock_bh(&cache->lock);
 
-	if (old_ht)
-		call_rcu(&old_ht->rcu, hash_free_rcu);
+	call_rcu(&old_ht->rcu, hash_free_rcu);
 
 	return 0;
 }
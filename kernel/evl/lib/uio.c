@@ -9,6 +9,12 @@
 #include <linux/export.h>
 #include <linux/uaccess.h>
 #include <linux/compat.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/delay.h>
+#include <linux/dovetail.h>
 #include <evl/uaccess.h>
 #include <evl/uio.h>
 #include <evl/memory.h>
@@ -99,6 +105,216 @@ struct iovec *evl_load_uio(const struct iovec __user *u_iov,
 }
 EXPORT_SYMBOL_GPL(evl_load_uio);
 
+#define EVL_MAX_UBUFS	32
+
+void evl_init_ubufs(struct oob_mm_state *oob_mm)
+{
+	INIT_LIST_HEAD(&oob_mm->pinned_ubufs);
+	raw_spin_lock_init(&oob_mm->ubuf_lock);
+	oob_mm->nr_ubufs = 0;
+}
+
+/*
+ * Look up the pinned buffer covering [ptr, ptr + len), grabbing a
+ * reference on it. Callable from any stage.
+ */
+struct evl_ubuf *evl_get_ubuf(const void __user *ptr, size_t len)
+{
+	struct oob_mm_state *oob_mm = dovetail_mm_state();
+	unsigned long addr = (unsigned long)ptr, flags;
+	struct evl_ubuf *ubuf, *ret = NULL;
+
+	if (!oob_mm || !test_bit(EVL_MM_ACTIVE_BIT, &oob_mm->flags) ||
+		!READ_ONCE(oob_mm->nr_ubufs))
+		return NULL;
+
+	raw_spin_lock_irqsave(&oob_mm->ubuf_lock, flags);
+
+	list_for_each_entry(ubuf, &oob_mm->pinned_ubufs, next) {
+		if (addr >= ubuf->start &&
+			len <= ubuf->len - (addr - ubuf->start)) {
+			atomic_inc(&ubuf->refs);
+			ret = ubuf;
+			break;
+		}
+	}
+
+	raw_spin_unlock_irqrestore(&oob_mm->ubuf_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(evl_get_ubuf);
+
+static int copy_to_ubuf(void __user *dst, const void *src, size_t len)
+{
+	struct evl_ubuf *ubuf;
+	void *p;
+
+	ubuf = evl_get_ubuf(dst, len);
+	if (!ubuf)
+		return raw_copy_to_user(dst, src, len) ? -EFAULT : 0;
+
+	p = evl_ubuf_ptr(ubuf, dst);
+	memcpy(p, src, len);
+	flush_kernel_vmap_range(p, len);
+	evl_put_ubuf(ubuf);
+
+	return 0;
+}
+
+static int copy_from_ubuf(void *dst, const void __user *src, size_t len)
+{
+	struct evl_ubuf *ubuf;
+	void *p;
+
+	ubuf = evl_get_ubuf(src, len);
+	if (!ubuf)
+		return raw_copy_from_user(dst, src, len) ? -EFAULT : 0;
+
+	p = evl_ubuf_ptr(ubuf, src);
+	invalidate_kernel_vmap_range(p, len);
+	memcpy(dst, p, len);
+	evl_put_ubuf(ubuf);
+
+	return 0;
+}
+
+static void release_ubuf(struct mm_struct *mm, struct evl_ubuf *ubuf)
+{
+	/* Wait for the oob copies still referring to us to drain. */
+	while (atomic_read(&ubuf->refs))
+		usleep_range(100, 200);
+
+	vunmap(ubuf->vaddr - offset_in_page(ubuf->start));
+	unpin_user_pages_dirty_lock(ubuf->pages, ubuf->nr_pages, true);
+	account_locked_vm(mm, ubuf->nr_pages, false);
+	kvfree(ubuf->pages);
+	kfree(ubuf);
+}
+
+/* In-band, on behalf of the task owning @oob_mm. */
+int evl_pin_ubuf(struct oob_mm_state *oob_mm, unsigned long addr, size_t len)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long flags, first;
+	struct evl_ubuf *ubuf;
+	int ret, nr_pages;
+
+	if (len == 0 || addr + len < addr)
+		return -EINVAL;
+
+	if (!access_ok((void __user *)addr, len))
+		return -EFAULT;
+
+	first = addr & PAGE_MASK;
+	nr_pages = (PAGE_ALIGN(addr + len) - first) >> PAGE_SHIFT;
+
+	ubuf = kzalloc(sizeof(*ubuf), GFP_KERNEL);
+	if (!ubuf)
+		return -ENOMEM;
+
+	ubuf->pages = kvmalloc_array(nr_pages, sizeof(struct page *),
+				GFP_KERNEL);
+	if (!ubuf->pages) {
+		ret = -ENOMEM;
+		goto fail_pages;
+	}
+
+	ret = account_locked_vm(mm, nr_pages, true);
+	if (ret)
+		goto fail_account;
+
+	ret = pin_user_pages_fast(first, nr_pages,
+				FOLL_WRITE | FOLL_LONGTERM, ubuf->pages);
+	if (ret != nr_pages) {
+		if (ret > 0)
+			unpin_user_pages(ubuf->pages, ret);
+		ret = ret < 0 ? ret : -EFAULT;
+		goto fail_pin;
+	}
+
+	ubuf->vaddr = vmap(ubuf->pages, nr_pages, VM_MAP, PAGE_KERNEL);
+	if (!ubuf->vaddr) {
+		ret = -ENOMEM;
+		goto fail_map;
+	}
+
+	ubuf->vaddr += offset_in_page(addr);
+	ubuf->start = addr;
+	ubuf->len = len;
+	ubuf->nr_pages = nr_pages;
+	atomic_set(&ubuf->refs, 0);
+
+	raw_spin_lock_irqsave(&oob_mm->ubuf_lock, flags);
+
+	if (oob_mm->nr_ubufs >= EVL_MAX_UBUFS) {
+		raw_spin_unlock_irqrestore(&oob_mm->ubuf_lock, flags);
+		ret = -EAGAIN;
+		goto fail_register;
+	}
+
+	list_add(&ubuf->next, &oob_mm->pinned_ubufs);
+	WRITE_ONCE(oob_mm->nr_ubufs, oob_mm->nr_ubufs + 1);
+
+	raw_spin_unlock_irqrestore(&oob_mm->ubuf_lock, flags);
+
+	return 0;
+
+fail_register:
+	vunmap(ubuf->vaddr - offset_in_page(addr));
+fail_map:
+	unpin_user_pages(ubuf->pages, nr_pages);
+fail_pin:
+	account_locked_vm(mm, nr_pages, false);
+fail_account:
+	kvfree(ubuf->pages);
+fail_pages:
+	kfree(ubuf);
+
+	return ret;
+}
+
+/* In-band, on behalf of the task owning @oob_mm. */
+int evl_unpin_ubuf(struct oob_mm_state *oob_mm, unsigned long addr)
+{
+	struct evl_ubuf *ubuf, *found = NULL;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&oob_mm->ubuf_lock, flags);
+
+	list_for_each_entry(ubuf, &oob_mm->pinned_ubufs, next) {
+		if (ubuf->start == addr) {
+			list_del(&ubuf->next);
+			WRITE_ONCE(oob_mm->nr_ubufs, oob_mm->nr_ubufs - 1);
+			found = ubuf;
+			break;
+		}
+	}
+
+	raw_spin_unlock_irqrestore(&oob_mm->ubuf_lock, flags);
+
+	if (!found)
+		return -ENOENT;
+
+	release_ubuf(current->mm, found);
+
+	return 0;
+}
+
+/* In-band, when @oob_mm is dropped, nothing may run oob there. */
+void evl_drop_ubufs(struct oob_mm_state *oob_mm)
+{
+	struct mm_struct *mm = container_of(oob_mm, struct mm_struct, oob_state);
+	struct evl_ubuf *ubuf, *tmp;
+
+	list_for_each_entry_safe(ubuf, tmp, &oob_mm->pinned_ubufs, next) {
+		list_del(&ubuf->next);
+		release_ubuf(mm, ubuf);
+	}
+
+	oob_mm->nr_ubufs = 0;
+}
+
 ssize_t evl_copy_to_uio(const struct iovec *iov, size_t iovlen,
 			const void *data, size_t len)
 {
@@ -114,9 +330,9 @@ ssize_t evl_copy_to_uio(const struct iovec *iov, size_t iovlen,
 		if (nbytes > len)
 			nbytes = len;
 
-		ret = raw_copy_to_user(iov->iov_base, data, nbytes);
+		ret = copy_to_ubuf(iov->iov_base, data, nbytes);
 		if (ret)
-			return -EFAULT;
+			return ret;
 
 		len -= nbytes;
 		data += nbytes;
@@ -145,9 +361,9 @@ ssize_t evl_copy_from_uio(const struct iovec *iov, size_t iovlen,
 		if (nbytes > len)
 			nbytes = len;
 
-		ret = raw_copy_from_user(data, iov->iov_base, nbytes);
+		ret = copy_from_ubuf(data, iov->iov_base, nbytes);
 		if (ret)
-			return -EFAULT;
+			return ret;
 
 		len -= nbytes;
 		data += nbytes;
@@ -0,0 +1,224 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <evl/lockstat.h>
+#include "../locking/lock_events.h"
+
+/*
+ * Classes register lazily the first time a lock is initialized, and
+ * stay in place until the module which defines them goes away. The
+ * hard lock below only protects the class list, statistics are
+ * serialized by the per-class lock, which can be grabbed from any
+ * stage.
+ */
+static LIST_HEAD(lockstat_classes);
+
+static int nr_lockstat_classes;
+
+static DEFINE_HARD_SPINLOCK(lockstat_lock);
+
+void evl_register_lockstat(struct evl_lockstat_class *class)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&lockstat_lock, flags);
+
+	if (list_empty(&class->next)) {
+		list_add_tail(&class->next, &lockstat_classes);
+		nr_lockstat_classes++;
+	}
+
+	raw_spin_unlock_irqrestore(&lockstat_lock, flags);
+}
+EXPORT_SYMBOL_GPL(evl_register_lockstat);
+
+/*
+ * Count a contending call site. When the table is full, the least
+ * frequent entry is evicted in favor of the new site, which inherits
+ * its count plus one. This keeps the heavy hitters in the table at
+ * a constant cost, with counts which may only be overestimated.
+ *
+ * class->lock held, irqs off.
+ */
+static void account_site(struct evl_lockstat_class *class,
+			unsigned long ip)
+{
+	struct evl_lockstat_site *site, *min = &class->sites[0];
+	int n;
+
+	for (n = 0; n < EVL_LOCKSTAT_SITES; n++) {
+		site = &class->sites[n];
+		if (site->ip == ip) {
+			site->count++;
+			return;
+		}
+		if (site->count < min->count)
+			min = site;
+	}
+
+	min->ip = ip;
+	min->count++;
+}
+
+void evl_lockstat_wait(struct evl_lockstat_class *class,
+		ktime_t start, unsigned long ip)
+{
+	ktime_t delta = ktime_sub(evl_lockstat_date(), start);
+	unsigned long flags;
+
+	if (class->type == EVL_LOCKSTAT_STAX)
+		lockevent_inc(evl_stax_contended);
+	else
+		lockevent_inc(evl_mutex_contended);
+
+	raw_spin_lock_irqsave(&class->lock, flags);
+
+	class->contended++;
+	class->wait_total = ktime_add(class->wait_total, delta);
+	if (delta > class->wait_max)
+		class->wait_max = delta;
+
+	account_site(class, ip);
+
+	raw_spin_unlock_irqrestore(&class->lock, flags);
+}
+EXPORT_SYMBOL_GPL(evl_lockstat_wait);
+
+void evl_lockstat_hold(struct evl_lockstat_class *class,
+		ktime_t start)
+{
+	ktime_t delta = ktime_sub(evl_lockstat_date(), start);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&class->lock, flags);
+
+	class->holds++;
+	class->hold_total = ktime_add(class->hold_total, delta);
+	if (delta > class->hold_max)
+		class->hold_max = delta;
+
+	raw_spin_unlock_irqrestore(&class->lock, flags);
+}
+EXPORT_SYMBOL_GPL(evl_lockstat_hold);
+
+static int compare_wait_total(const void *a, const void *b)
+{
+	const struct evl_lockstat_class *ca = a, *cb = b;
+
+	if (ca->wait_total == cb->wait_total)
+		return 0;
+
+	return ca->wait_total > cb->wait_total ? -1 : 1;
+}
+
+static const char *lockstat_types[] = {
+	[EVL_LOCKSTAT_MUTEX] = "mutex",
+	[EVL_LOCKSTAT_STAX] = "stax",
+};
+
+/*
+ * One line per contended lock class, ranked by decreasing total wait
+ * time: class name, lock type, contention count, total and maximum
+ * wait times, count of timed hold periods, total and maximum hold
+ * times (ns), followed by the top contending call sites with their
+ * hit counts.
+ */
+ssize_t evl_show_lock_stats(char *buf, size_t size)
+{
+	struct evl_lockstat_class *class, *snap;
+	struct evl_lockstat_site *site;
+	unsigned long flags;
+	int nr = 0, max, n, s;
+	ssize_t len = 0;
+
+	max = READ_ONCE(nr_lockstat_classes);
+	if (max == 0)
+		return 0;
+
+	snap = kcalloc(max, sizeof(*snap), GFP_KERNEL);
+	if (snap == NULL)
+		return -ENOMEM;
+
+	raw_spin_lock_irqsave(&lockstat_lock, flags);
+
+	list_for_each_entry(class, &lockstat_classes, next) {
+		if (nr >= max)
+			break;
+		raw_spin_lock(&class->lock);
+		if (class->contended)
+			snap[nr++] = *class;
+		raw_spin_unlock(&class->lock);
+	}
+
+	raw_spin_unlock_irqrestore(&lockstat_lock, flags);
+
+	sort(snap, nr, sizeof(*snap), compare_wait_total, NULL);
+
+	for (n = 0; n < nr; n++) {
+		class = snap + n;
+		len += scnprintf(buf + len, size - len,
+				"%s %s %lu %Lu %Lu %lu %Lu %Lu",
+				class->name, lockstat_types[class->type],
+				class->contended,
+				ktime_to_ns(class->wait_total),
+				ktime_to_ns(class->wait_max),
+				class->holds,
+				ktime_to_ns(class->hold_total),
+				ktime_to_ns(class->hold_max));
+		for (s = 0; s < EVL_LOCKSTAT_SITES; s++) {
+			site = &class->sites[s];
+			if (site->count)
+				len += scnprintf(buf + len, size - len,
+						" %pS:%lu",
+						(void *)site->ip, site->count);
+		}
+		len += scnprintf(buf + len, size - len, "\n");
+	}
+
+	kfree(snap);
+
+	return len;
+}
+
+#ifdef CONFIG_MODULES
+
+static int lockstat_module_notify(struct notifier_block *nb,
+				unsigned long action, void *data)
+{
+	struct evl_lockstat_class *class, *tmp;
+	struct module *mod = data;
+	unsigned long flags;
+
+	if (action != MODULE_STATE_GOING)
+		return NOTIFY_DONE;
+
+	raw_spin_lock_irqsave(&lockstat_lock, flags);
+
+	list_for_each_entry_safe(class, tmp, &lockstat_classes, next) {
+		if (within_module((unsigned long)class, mod)) {
+			list_del(&class->next);
+			nr_lockstat_classes--;
+		}
+	}
+
+	raw_spin_unlock_irqrestore(&lockstat_lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lockstat_module_nb = {
+	.notifier_call = lockstat_module_notify,
+};
+
+static int __init evl_init_lockstat(void)
+{
+	return register_module_notifier(&lockstat_module_nb);
+}
+core_initcall(evl_init_lockstat);
+
+#endif
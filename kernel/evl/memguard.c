@@ -0,0 +1,158 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/perf_event.h>
+#include <linux/irq_pipeline.h>
+#include <evl/control.h>
+#include <evl/sched.h>
+#include <evl/timer.h>
+#include <evl/flag.h>
+#include <evl/memguard.h>
+
+/*
+ * MemGuard-like memory bandwidth regulation. Each out-of-band CPU
+ * is granted a budget of LLC misses per regulation period, counted
+ * by a pinned PMU event which overflows when the budget is
+ * exhausted. The overflow handler - which may run in NMI context -
+ * only marks the CPU as throttled and kicks the reschedule IPI,
+ * from which a per-CPU throttler is woken up on the oob stage. The
+ * throttler runs at the lowest FIFO priority, spinning until the
+ * replenishment timer refills the budget at the next period. This
+ * keeps in-band work off the CPU meanwhile, without delaying any
+ * out-of-band thread.
+ *
+ * Like in pmu.c, the counter is reset by calling the PMU handlers
+ * directly, which we may do from the oob stage for an event bound
+ * to the current CPU.
+ */
+
+static ulong memguard_budget_arg;
+module_param_named(memguard_budget, memguard_budget_arg, ulong, 0444);
+
+static uint memguard_period_arg = 1000;
+module_param_named(memguard_period, memguard_period_arg, uint, 0444);
+
+struct memguard_cpu {
+	struct perf_event *event;
+	struct evl_timer timer;
+	struct evl_kthread kthread;
+	struct evl_flag throttle;
+	bool throttled;
+};
+
+static DEFINE_PER_CPU(struct memguard_cpu, memguard_cpus);
+
+static void memguard_overflow(struct perf_event *event,
+			struct perf_sample_data *data,
+			struct pt_regs *regs)
+{
+	struct memguard_cpu *mg = this_cpu_ptr(&memguard_cpus);
+
+	if (!READ_ONCE(mg->throttled)) {
+		WRITE_ONCE(mg->throttled, true);
+		irq_send_oob_ipi(RESCHEDULE_OOB_IPI,
+				cpumask_of(raw_smp_processor_id()));
+	}
+}
+
+/* oob stage stalled, from the reschedule IPI handler. */
+void evl_kick_memguard(void)
+{
+	struct memguard_cpu *mg = this_cpu_ptr(&memguard_cpus);
+
+	if (READ_ONCE(mg->throttled))
+		evl_raise_flag_nosched(&mg->throttle);
+}
+
+static void replenish_handler(struct evl_timer *timer) /* hard irqs off */
+{
+	struct memguard_cpu *mg = container_of(timer, struct memguard_cpu, timer);
+	struct perf_event *event = mg->event;
+
+	if (event->state == PERF_EVENT_STATE_ACTIVE) {
+		event->pmu->stop(event, PERF_EF_UPDATE);
+		local64_set(&event->hw.period_left, memguard_budget_arg);
+		event->pmu->start(event, PERF_EF_RELOAD);
+	}
+
+	WRITE_ONCE(mg->throttled, false);
+}
+
+static void throttler_work(void *arg)
+{
+	struct memguard_cpu *mg = arg;
+
+	while (!evl_kthread_should_stop()) {
+		if (evl_wait_flag(&mg->throttle))
+			break;
+		while (READ_ONCE(mg->throttled) &&
+			!evl_kthread_should_stop())
+			cpu_relax();
+	}
+}
+
+static int __init evl_init_memguard(void)
+{
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HARDWARE,
+		.config = PERF_COUNT_HW_CACHE_MISSES,
+		.size = sizeof(attr),
+		.pinned = 1,
+	};
+	struct memguard_cpu *mg;
+	ktime_t period;
+	int cpu, ret;
+
+	if (!evl_is_enabled() || memguard_budget_arg == 0)
+		return 0;
+
+	attr.sample_period = memguard_budget_arg;
+	period = ns_to_ktime((u64)memguard_period_arg * 1000);
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		mg = per_cpu_ptr(&memguard_cpus, cpu);
+		mg->event = perf_event_create_kernel_counter(&attr, cpu, NULL,
+							memguard_overflow,
+							NULL);
+		if (IS_ERR(mg->event)) {
+			printk(EVL_WARNING
+			       "cannot regulate memory bandwidth on CPU%d (%ld)\n",
+			       cpu, PTR_ERR(mg->event));
+			mg->event = NULL;
+			continue;
+		}
+
+		evl_init_flag(&mg->throttle);
+		ret = evl_run_kthread_on_cpu(&mg->kthread, cpu,
+					throttler_work, mg,
+					EVL_FIFO_MIN_PRIO,
+					EVL_CLONE_PUBLIC,
+					"memguard:%d", cpu);
+		if (ret) {
+			printk(EVL_WARNING
+			       "cannot start memguard throttler on CPU%d\n",
+			       cpu);
+			evl_destroy_flag(&mg->throttle);
+			perf_event_release_kernel(mg->event);
+			mg->event = NULL;
+			continue;
+		}
+
+		evl_init_timer_on_rq(&mg->timer, &evl_mono_clock,
+				replenish_handler, evl_cpu_rq(cpu),
+				EVL_TIMER_IGRAVITY);
+		evl_set_timer_name(&mg->timer, "[memguard]");
+		evl_set_timer_class(&mg->timer, EVL_TIMER_CLASS_MEMGUARD);
+		evl_start_timer(&mg->timer,
+				evl_abs_timeout(&mg->timer, period),
+				period);
+	}
+
+	return 0;
+}
+late_initcall(evl_init_memguard);
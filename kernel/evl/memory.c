@@ -16,11 +16,19 @@
 #include <linux/log2.h>
 #include <linux/bitops.h>
 #include <linux/vmalloc.h>
+#include <linux/percpu.h>
+#include <linux/nodemask.h>
+#include <linux/rculist.h>
+#include <linux/huge_mm.h>
+#include <linux/math64.h>
 #include <linux/uaccess.h>
 #include <evl/memory.h>
 #include <evl/monitor.h>
 #include <evl/assert.h>
 #include <evl/init.h>
+#include <evl/work.h>
+#include <uapi/evl/evgroup-abi.h>
+#include <uapi/evl/barrier-abi.h>
 
 static unsigned long sysheap_size_arg;
 module_param_named(sysheap_size, sysheap_size_arg, ulong, 0444);
@@ -32,6 +40,8 @@ struct evl_heap evl_shared_heap;
 
 size_t evl_shm_size;
 
+bool evl_shm_hugepage;
+
 enum evl_heap_pgtype {
 	page_free =0,
 	page_cont =1,
@@ -211,14 +221,108 @@ static void insert_range_byaddr(struct evl_heap *heap, struct evl_heap_range *r)
 	rb_insert_color(&r->addr_node, &heap->addr_tree);
 }
 
+static void merge_page_range(struct evl_heap *heap,
+			void *page, size_t size)
+{
+	struct evl_heap_range *freed = page, *left, *right;
+	bool addr_linked = false;
+
+	freed->size = size;
+
+	left = search_left_mergeable(heap, freed);
+	if (left) {
+		rb_erase(&left->size_node, &heap->size_tree);
+		left->size += freed->size;
+		freed = left;
+		addr_linked = true;
+	}
+
+	right = search_right_mergeable(heap, freed);
+	if (right) {
+		rb_erase(&right->size_node, &heap->size_tree);
+		freed->size += right->size;
+		if (addr_linked)
+			rb_erase(&right->addr_node, &heap->addr_tree);
+		else
+			rb_replace_node(&right->addr_node, &freed->addr_node,
+					&heap->addr_tree);
+	} else if (!addr_linked)
+		insert_range_byaddr(heap, freed);
+
+	insert_range_bysize(heap, freed);
+	mark_pages(heap, addr_to_pagenr(heap, page),
+		size >> EVL_HEAP_PAGE_SHIFT, page_free);
+}
+
+/*
+ * Return the index of the segregated list holding free ranges of
+ * @size, or -1 if that size is not a power-of-two count of pages
+ * within [2, 2^EVL_HEAP_SEG_ORDERS].
+ */
+static inline int get_seg_index(size_t size)
+{
+	size_t nrpages = size >> EVL_HEAP_PAGE_SHIFT;
+
+	if (nrpages < 2 || nrpages > (1UL << EVL_HEAP_SEG_ORDERS) ||
+		!is_power_of_2(nrpages))
+		return -1;
+
+	return ilog2(nrpages) - 1;
+}
+
+/*
+ * Give the ranges parked on the segregated lists back to the trees,
+ * merging them with their free neighbours. This happens only when
+ * the trees cannot serve a request, which bounds the work to
+ * EVL_HEAP_SEG_ORDERS * EVL_HEAP_SEG_DEPTH merges.
+ */
+static bool drain_seglists(struct evl_heap *heap)
+{
+	struct evl_heap_range *r;
+	bool drained = false;
+	int n;
+
+	for (n = 0; n < EVL_HEAP_SEG_ORDERS; n++) {
+		while (!list_empty(&heap->seglists[n])) {
+			r = list_first_entry(&heap->seglists[n],
+					struct evl_heap_range, seg_next);
+			list_del(&r->seg_next);
+			merge_page_range(heap, r, r->size);
+			drained = true;
+		}
+		heap->seglen[n] = 0;
+	}
+
+	return drained;
+}
+
 static int reserve_page_range(struct evl_heap *heap, size_t size)
 {
 	struct evl_heap_range *new, *splitr;
+	int n;
+
+	/*
+	 * Common multi-page sizes are served from the segregated
+	 * lists in constant time if possible.
+	 */
+	n = get_seg_index(size);
+	if (n >= 0 && !list_empty(&heap->seglists[n])) {
+		new = list_first_entry(&heap->seglists[n],
+				struct evl_heap_range, seg_next);
+		list_del(&new->seg_next);
+		heap->seglen[n]--;
+		return addr_to_pagenr(heap, new);
+	}
 
 	/* Find a suitable range of pages covering 'size'. */
 	new = search_size_ge(&heap->size_tree, size);
-	if (new == NULL)
-		return -1;
+	if (new == NULL) {
+		if (!drain_seglists(heap))
+			return -1;
+		new = search_size_ge(&heap->size_tree, size);
+		if (new == NULL)
+			return -1;
+	}
 
 	rb_erase(&new->size_node, &heap->size_tree);
 	if (new->size == size) {
@@ -243,34 +347,24 @@ static int reserve_page_range(struct evl_heap *heap, size_t size)
 static void release_page_range(struct evl_heap *heap,
 			void *page, size_t size)
 {
-	struct evl_heap_range *freed = page, *left, *right;
-	bool addr_linked = false;
-
-	freed->size = size;
+	struct evl_heap_range *freed = page;
+	int n;
 
-	left = search_left_mergeable(heap, freed);
-	if (left) {
-		rb_erase(&left->size_node, &heap->size_tree);
-		left->size += freed->size;
-		freed = left;
-		addr_linked = true;
+	/*
+	 * Park common multi-page sizes on their segregated list
+	 * without merging, unless that list is deep enough already.
+	 */
+	n = get_seg_index(size);
+	if (n >= 0 && heap->seglen[n] < EVL_HEAP_SEG_DEPTH) {
+		freed->size = size;
+		list_add(&freed->seg_next, &heap->seglists[n]);
+		heap->seglen[n]++;
+		mark_pages(heap, addr_to_pagenr(heap, page),
+			size >> EVL_HEAP_PAGE_SHIFT, page_free);
+		return;
 	}
 
-	right = search_right_mergeable(heap, freed);
-	if (right) {
-		rb_erase(&right->size_node, &heap->size_tree);
-		freed->size += right->size;
-		if (addr_linked)
-			rb_erase(&right->addr_node, &heap->addr_tree);
-		else
-			rb_replace_node(&right->addr_node, &freed->addr_node,
-					&heap->addr_tree);
-	} else if (!addr_linked)
-		insert_range_byaddr(heap, freed);
-
-	insert_range_bysize(heap, freed);
-	mark_pages(heap, addr_to_pagenr(heap, page),
-		size >> EVL_HEAP_PAGE_SHIFT, page_free);
+	merge_page_range(heap, page, size);
 }
 
 static void add_page_front(struct evl_heap *heap,
@@ -401,9 +495,81 @@ static void *add_free_range(struct evl_heap *heap,
 	return pagenr_to_addr(heap, pg);
 }
 
+/*
+ * Busy blocks are counted per bucket, the last slot counting the
+ * multi-page blocks.
+ */
+static inline void account_alloc(struct evl_heap *heap, int slot)
+{
+	heap->nr_busy[slot]++;
+	if (heap->used_size > heap->peak_used)
+		heap->peak_used = heap->used_size;
+}
+
+static inline void account_free(struct evl_heap *heap, int slot)
+{
+	heap->nr_busy[slot]--;
+}
+
+#ifdef CONFIG_EVL_DEBUG_HEAP_TAGS
+
+/*
+ * In tagging mode, we record the caller which allocated each busy
+ * block, up to EVL_HEAP_PAGE_SIZE >> EVL_HEAP_MIN_LOG2 blocks per
+ * page, for tracking leaks.
+ */
+#define TAGS_PER_PAGE	(EVL_HEAP_PAGE_SIZE >> EVL_HEAP_MIN_LOG2)
+
+static int alloc_heap_tags(struct evl_heap *heap, int nrpages)
+{
+	heap->tags = vzalloc(array_size(nrpages * TAGS_PER_PAGE,
+						sizeof(unsigned long)));
+
+	return heap->tags ? 0 : -ENOMEM;
+}
+
+static void free_heap_tags(struct evl_heap *heap)
+{
+	vfree(heap->tags);
+}
+
+/* heap->lock held. Page slot #0 is used for multi-page blocks. */
+static unsigned long *get_block_tag(struct evl_heap *heap, void *block)
+{
+	unsigned long pgoff = block - heap->membase;
+	int pg = pgoff >> EVL_HEAP_PAGE_SHIFT, b = 0;
+
+	if (heap->pagemap[pg].type != page_list)
+		b = (pgoff & ~EVL_HEAP_PAGE_MASK) >> heap->pagemap[pg].type;
+
+	return heap->tags + pg * TAGS_PER_PAGE + b;
+}
+
+static inline void set_block_tag(struct evl_heap *heap, void *block,
+				unsigned long caller)
+{
+	*get_block_tag(heap, block) = caller;
+}
+
+#else
+
+static inline int alloc_heap_tags(struct evl_heap *heap, int nrpages)
+{
+	return 0;
+}
+
+static inline void free_heap_tags(struct evl_heap *heap)
+{ }
+
+static inline void set_block_tag(struct evl_heap *heap, void *block,
+				unsigned long caller)
+{ }
+
+#endif
+
 int evl_init_heap(struct evl_heap *heap, void *membase, size_t size)
 {
-	int n, nrpages;
+	int n, nrpages, ret;
 
 	inband_context_only();
 
@@ -414,6 +580,11 @@ int evl_init_heap(struct evl_heap *heap, void *membase, size_t size)
 	for (n = 0; n < EVL_HEAP_MAX_BUCKETS; n++)
 		heap->buckets[n] = -1U;
 
+	for (n = 0; n < EVL_HEAP_SEG_ORDERS; n++) {
+		INIT_LIST_HEAD(&heap->seglists[n]);
+		heap->seglen[n] = 0;
+	}
+
 	raw_spin_lock_init(&heap->lock);
 
 	nrpages = size >> EVL_HEAP_PAGE_SHIFT;
@@ -425,6 +596,16 @@ int evl_init_heap(struct evl_heap *heap, void *membase, size_t size)
 	heap->membase = membase;
 	heap->usable_size = size;
 	heap->used_size = 0;
+	heap->peak_used = 0;
+	memset(heap->nr_busy, 0, sizeof(heap->nr_busy));
+	heap->cache = NULL;
+	heap->node = NUMA_NO_NODE;
+
+	ret = alloc_heap_tags(heap, nrpages);
+	if (ret) {
+		kfree(heap->pagemap);
+		return ret;
+	}
 
 	/*
 	 * The free page pool is maintained as a set of ranges of
@@ -432,28 +613,282 @@ int evl_init_heap(struct evl_heap *heap, void *membase, size_t size)
 	 * Initially, we have a single range in those trees covering
 	 * the whole memory we have been given for the heap. Over
 	 * time, that range will be split then possibly re-merged back
-	 * as allocations and deallocations take place.
+	 * as allocations and deallocations take place, except for
+	 * the common multi-page sizes which are parked on segregated
+	 * lists when released.
 	 */
 	heap->size_tree = RB_ROOT;
 	heap->addr_tree = RB_ROOT;
-	release_page_range(heap, membase, size);
+	merge_page_range(heap, membase, size);
 
 	return 0;
 }
 EXPORT_SYMBOL_GPL(evl_init_heap);
 
+/* heap->lock held. */
+static void *alloc_bucket_block(struct evl_heap *heap, int log2size)
+{
+	size_t bsize = 1 << log2size;
+	int ilog, pg, b;
+	void *block;
+
+	ilog = log2size - EVL_HEAP_MIN_LOG2;
+	EVL_WARN_ON(MEMORY, ilog < 0 || ilog >= EVL_HEAP_MAX_BUCKETS);
+	pg = heap->buckets[ilog];
+	/*
+	 * Find a block in the heading page if any. If there is none,
+	 * there won't be any down the list: add a new page right
+	 * away.
+	 */
+	if (pg < 0 || heap->pagemap[pg].map == -1U) {
+		block = add_free_range(heap, bsize, log2size);
+		if (block)
+			account_alloc(heap, ilog);
+		return block;
+	}
+
+	b = ffs(~heap->pagemap[pg].map) - 1;
+	/*
+	 * Got one block from the heading per-bucket page, tag it as
+	 * busy in the per-page allocation map.
+	 */
+	heap->pagemap[pg].map |= (1U << b);
+	heap->used_size += bsize;
+	block = heap->membase +
+		(pg << EVL_HEAP_PAGE_SHIFT) +
+		(b << log2size);
+	if (heap->pagemap[pg].map == -1U)
+		move_page_back(heap, pg, log2size);
+
+	account_alloc(heap, ilog);
+
+	return block;
+}
+
+/* heap->lock held, @block is known to start a bucketed block. */
+static void free_bucket_block(struct evl_heap *heap, void *block,
+			int log2size)
+{
+	unsigned long pgoff = block - heap->membase;
+	int pg = pgoff >> EVL_HEAP_PAGE_SHIFT, n;
+	u32 oldmap;
+
+	/* Block position in page. */
+	n = (pgoff & ~EVL_HEAP_PAGE_MASK) >> log2size;
+	oldmap = heap->pagemap[pg].map;
+	heap->pagemap[pg].map &= ~(1U << n);
+
+	/*
+	 * If the page the block was sitting on is fully idle, return
+	 * it to the pool. Otherwise, check whether that page is
+	 * transitioning from fully busy to partially busy state, in
+	 * which case it should move toward the front of the
+	 * per-bucket page list.
+	 */
+	if (heap->pagemap[pg].map == ~gen_block_mask(log2size)) {
+		remove_page(heap, pg, log2size);
+		release_page_range(heap, pagenr_to_addr(heap, pg),
+				EVL_HEAP_PAGE_SIZE);
+	} else if (oldmap == -1U)
+		move_page_front(heap, pg, log2size);
+
+	heap->used_size -= 1 << log2size;
+	account_free(heap, log2size - EVL_HEAP_MIN_LOG2);
+}
+
+#ifdef CONFIG_EVL_HEAP_CACHE
+
+/*
+ * Each CPU has a magazine of free blocks for each bucket size, which
+ * serves allocation and release requests for small blocks locally,
+ * with hard irqs off. The heap lock is grabbed only for moving
+ * EVL_HEAP_MAG_BATCH blocks at once between a magazine and the heap,
+ * when the former runs empty on allocation, or full on release. The
+ * blocks sitting in a magazine are still busy from the standpoint of
+ * the heap.
+ *
+ * Since a magazine only caches blocks of a single size, there is no
+ * point in caching blocks for a heap which is sized exactly for a
+ * known set of allocations, such as the shared heap: this would only
+ * strand free memory on remote CPUs.
+ */
+int evl_enable_heap_cache(struct evl_heap *heap)
+{
+	inband_context_only();
+
+	heap->cache = alloc_percpu(struct evl_heap_cache);
+	if (heap->cache == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void disable_heap_cache(struct evl_heap *heap)
+{
+	/* The whole heap memory is going away, don't bother draining. */
+	free_percpu(heap->cache);
+	heap->cache = NULL;
+}
+
+static inline struct evl_heap_magazine *
+get_magazine(struct evl_heap *heap, int log2size) /* hard irqs off */
+{
+	return this_cpu_ptr(heap->cache)->mags + log2size - EVL_HEAP_MIN_LOG2;
+}
+
+/* hard irqs off */
+static void *refill_magazine(struct evl_heap *heap,
+			struct evl_heap_magazine *mag, int log2size)
+{
+	void *block, *extra;
+	int n;
+
+	raw_spin_lock(&heap->lock);
+
+	block = alloc_bucket_block(heap, log2size);
+	if (block) {
+		for (n = 1; n < EVL_HEAP_MAG_BATCH; n++) {
+			extra = alloc_bucket_block(heap, log2size);
+			if (extra == NULL)
+				break;
+			mag->slots[mag->count++] = extra;
+		}
+	}
+
+	raw_spin_unlock(&heap->lock);
+
+	return block;
+}
+
+/* hard irqs off */
+static void drain_magazine(struct evl_heap *heap,
+			struct evl_heap_magazine *mag, int log2size)
+{
+	int n;
+
+	/*
+	 * Release the oldest blocks, the most recently freed ones are
+	 * more likely to be hot in the cache.
+	 */
+	raw_spin_lock(&heap->lock);
+
+	for (n = 0; n < EVL_HEAP_MAG_BATCH; n++)
+		free_bucket_block(heap, mag->slots[n], log2size);
+
+	raw_spin_unlock(&heap->lock);
+
+	mag->count -= EVL_HEAP_MAG_BATCH;
+	memmove(mag->slots, mag->slots + EVL_HEAP_MAG_BATCH,
+		mag->count * sizeof(mag->slots[0]));
+}
+
+static bool cache_alloc(struct evl_heap *heap, int log2size,
+			void **blockp)
+{
+	struct evl_heap_magazine *mag;
+	unsigned long flags;
+
+	if (heap->cache == NULL)
+		return false;
+
+	flags = hard_local_irq_save();
+
+	mag = get_magazine(heap, log2size);
+	if (likely(mag->count > 0)) {
+		*blockp = mag->slots[--mag->count];
+		mag->hits++;
+	} else {
+		*blockp = refill_magazine(heap, mag, log2size);
+		mag->misses++;
+	}
+
+	hard_local_irq_restore(flags);
+
+	return true;
+}
+
+static bool cache_free(struct evl_heap *heap, void *block,
+		int log2size)
+{
+	struct evl_heap_magazine *mag;
+	unsigned long flags;
+
+	if (heap->cache == NULL)
+		return false;
+
+	flags = hard_local_irq_save();
+
+	mag = get_magazine(heap, log2size);
+	if (unlikely(mag->count == EVL_HEAP_MAG_SIZE))
+		drain_magazine(heap, mag, log2size);
+
+	mag->slots[mag->count++] = block;
+
+	hard_local_irq_restore(flags);
+
+	return true;
+}
+
+static ssize_t show_heap_cache(struct evl_heap *heap,
+			char *buf, size_t size)
+{
+	struct evl_heap_magazine *mag;
+	ssize_t ret = 0;
+	int cpu, n;
+
+	if (heap->cache == NULL)
+		return 0;
+
+	for_each_online_cpu(cpu) {
+		for (n = 0; n < EVL_HEAP_MAX_BUCKETS; n++) {
+			mag = per_cpu_ptr(heap->cache, cpu)->mags + n;
+			ret += scnprintf(buf + ret, size - ret,
+					"%d %d %u %lu %lu %u\n",
+					heap->node, cpu,
+					1U << (n + EVL_HEAP_MIN_LOG2),
+					READ_ONCE(mag->hits),
+					READ_ONCE(mag->misses),
+					READ_ONCE(mag->count));
+		}
+	}
+
+	return ret;
+}
+
+#else
+
+static inline void disable_heap_cache(struct evl_heap *heap)
+{ }
+
+static inline bool cache_alloc(struct evl_heap *heap, int log2size,
+			void **blockp)
+{
+	return false;
+}
+
+static inline bool cache_free(struct evl_heap *heap, void *block,
+			int log2size)
+{
+	return false;
+}
+
+#endif
+
 void evl_destroy_heap(struct evl_heap *heap)
 {
 	inband_context_only();
 
+	disable_heap_cache(heap);
+	free_heap_tags(heap);
 	kfree(heap->pagemap);
 }
 EXPORT_SYMBOL_GPL(evl_destroy_heap);
 
-void *evl_alloc_chunk(struct evl_heap *heap, size_t size)
+static void *alloc_chunk(struct evl_heap *heap, size_t size,
+			unsigned long caller)
 {
-	int log2size, ilog, pg, b = -1;
 	unsigned long flags;
+	int log2size;
 	size_t bsize;
 	void *block;
 
@@ -473,6 +908,9 @@ void *evl_alloc_chunk(struct evl_heap *heap, size_t size)
 			bsize = ALIGN(size, EVL_HEAP_PAGE_SIZE);
 	}
 
+	if (bsize < EVL_HEAP_PAGE_SIZE && cache_alloc(heap, log2size, &block))
+		return block;
+
 	/*
 	 * Allocate entire pages directly from the pool whenever the
 	 * block is larger or equal to EVL_HEAP_PAGE_SIZE.  Otherwise,
@@ -487,65 +925,68 @@ void *evl_alloc_chunk(struct evl_heap *heap, size_t size)
 	 */
 	raw_spin_lock_irqsave(&heap->lock, flags);
 
-	if (bsize >= EVL_HEAP_PAGE_SIZE)
+	if (bsize >= EVL_HEAP_PAGE_SIZE) {
 		/* Add a range of contiguous free pages. */
 		block = add_free_range(heap, bsize, 0);
-	else {
-		ilog = log2size - EVL_HEAP_MIN_LOG2;
-		EVL_WARN_ON(MEMORY, ilog < 0 || ilog >= EVL_HEAP_MAX_BUCKETS);
-		pg = heap->buckets[ilog];
-		/*
-		 * Find a block in the heading page if any. If there
-		 * is none, there won't be any down the list: add a
-		 * new page right away.
-		 */
-		if (pg < 0 || heap->pagemap[pg].map == -1U)
-			block = add_free_range(heap, bsize, log2size);
-		else {
-			b = ffs(~heap->pagemap[pg].map) - 1;
-			/*
-			 * Got one block from the heading per-bucket
-			 * page, tag it as busy in the per-page
-			 * allocation map.
-			 */
-			heap->pagemap[pg].map |= (1U << b);
-			heap->used_size += bsize;
-			block = heap->membase +
-				(pg << EVL_HEAP_PAGE_SHIFT) +
-				(b << log2size);
-			if (heap->pagemap[pg].map == -1U)
-				move_page_back(heap, pg, log2size);
-		}
-	}
+		if (block)
+			account_alloc(heap, EVL_HEAP_MAX_BUCKETS);
+	} else
+		block = alloc_bucket_block(heap, log2size);
+
+	if (block)
+		set_block_tag(heap, block, caller);
 
 	raw_spin_unlock_irqrestore(&heap->lock, flags);
 
 	return block;
 }
+
+void *evl_alloc_chunk(struct evl_heap *heap, size_t size)
+{
+	return alloc_chunk(heap, size, _RET_IP_);
+}
 EXPORT_SYMBOL_GPL(evl_alloc_chunk);
 
 void evl_free_chunk(struct evl_heap *heap, void *block)
 {
 	unsigned long pgoff, boff;
-	int log2size, pg, n;
 	unsigned long flags;
+	int log2size, pg;
 	size_t bsize;
-	u32 oldmap;
-
-	raw_spin_lock_irqsave(&heap->lock, flags);
 
 	/* Compute the heading page number in the page map. */
 	pgoff = block - heap->membase;
 	pg = pgoff >> EVL_HEAP_PAGE_SHIFT;
 
-	if (!page_is_valid(heap, pg))
-		goto bad;
+	/*
+	 * The type of a page holding a busy block cannot change
+	 * until that block is released, so we may peek at it
+	 * locklessly for figuring out whether the block could go to
+	 * a magazine. Non-bucketed page types are all lower than
+	 * EVL_HEAP_MIN_LOG2.
+	 */
+	log2size = heap->pagemap[pg].type;
+	if (log2size >= EVL_HEAP_MIN_LOG2) {
+		boff = pgoff & ~EVL_HEAP_PAGE_MASK;
+		if ((boff & ((1UL << log2size) - 1)) != 0) /* Not at block start? */
+			goto bad;
+		if (cache_free(heap, block, log2size))
+			return;
+	}
 
-	switch (heap->pagemap[pg].type) {
+	raw_spin_lock_irqsave(&heap->lock, flags);
+
+	if (!page_is_valid(heap, pg))
+		goto bad_locked;
+
+	switch (heap->pagemap[pg].type) {
 	case page_list:
 		bsize = heap->pagemap[pg].bsize;
 		EVL_WARN_ON(MEMORY, (bsize & (EVL_HEAP_PAGE_SIZE - 1)) != 0);
+		set_block_tag(heap, block, 0);
 		release_page_range(heap, pagenr_to_addr(heap, pg), bsize);
+		heap->used_size -= bsize;
+		account_free(heap, EVL_HEAP_MAX_BUCKETS);
 		break;
 
 	default:
@@ -554,35 +995,17 @@ void evl_free_chunk(struct evl_heap *heap, void *block)
 		EVL_WARN_ON(MEMORY, bsize >= EVL_HEAP_PAGE_SIZE);
 		boff = pgoff & ~EVL_HEAP_PAGE_MASK;
 		if ((boff & (bsize - 1)) != 0) /* Not at block start? */
-			goto bad;
-
-		n = boff >> log2size; /* Block position in page. */
-		oldmap = heap->pagemap[pg].map;
-		heap->pagemap[pg].map &= ~(1U << n);
-
-		/*
-		 * If the page the block was sitting on is fully idle,
-		 * return it to the pool. Otherwise, check whether
-		 * that page is transitioning from fully busy to
-		 * partially busy state, in which case it should move
-		 * toward the front of the per-bucket page list.
-		 */
-		if (heap->pagemap[pg].map == ~gen_block_mask(log2size)) {
-			remove_page(heap, pg, log2size);
-			release_page_range(heap, pagenr_to_addr(heap, pg),
-					EVL_HEAP_PAGE_SIZE);
-		} else if (oldmap == -1U)
-			move_page_front(heap, pg, log2size);
+			goto bad_locked;
+		set_block_tag(heap, block, 0);
+		free_bucket_block(heap, block, log2size);
 	}
 
-	heap->used_size -= bsize;
-
 	raw_spin_unlock_irqrestore(&heap->lock, flags);
 
 	return;
-bad:
+bad_locked:
 	raw_spin_unlock_irqrestore(&heap->lock, flags);
-
+bad:
 	EVL_WARN(MEMORY, 1, "invalid block %p in heap %s",
 		block, heap == &evl_shared_heap ?
 		"shared" : "system");
@@ -619,6 +1042,123 @@ out:
 }
 EXPORT_SYMBOL_GPL(evl_check_chunk);
 
+/* heap->lock held. */
+static size_t get_largest_free(struct evl_heap *heap)
+{
+	struct evl_heap_range *r;
+	size_t largest = 0;
+	struct rb_node *rb;
+	int n;
+
+	rb = rb_last(&heap->size_tree);
+	if (rb) {
+		r = rb_entry(rb, struct evl_heap_range, size_node);
+		largest = r->size;
+	}
+
+	/* Parked ranges are free too, although not merged. */
+	for (n = EVL_HEAP_SEG_ORDERS - 1; n >= 0; n--) {
+		if (!list_empty(&heap->seglists[n])) {
+			largest = max_t(size_t, largest,
+					EVL_HEAP_PAGE_SIZE << (n + 1));
+			break;
+		}
+	}
+
+	return largest;
+}
+
+/* Accumulate the figures from @heap into @st. */
+static void collect_heap_stats(struct evl_heap *heap,
+			struct evl_heap_stats *st)
+{
+	unsigned long flags;
+	size_t largest;
+	int n;
+
+	raw_spin_lock_irqsave(&heap->lock, flags);
+
+	st->usable_size += heap->usable_size;
+	st->used_size += heap->used_size;
+	st->peak_used += heap->peak_used;
+	largest = get_largest_free(heap);
+	if (largest > st->largest_free)
+		st->largest_free = largest;
+	for (n = 0; n <= EVL_HEAP_MAX_BUCKETS; n++)
+		st->nr_busy[n] += heap->nr_busy[n];
+
+	raw_spin_unlock_irqrestore(&heap->lock, flags);
+}
+
+/*
+ * The fragmentation ratio is the share of free memory which is not
+ * part of the largest free range, i.e. zero means that the largest
+ * request we could serve is as large as the free memory.
+ */
+static void finish_heap_stats(struct evl_heap_stats *st)
+{
+	u64 free = st->usable_size - st->used_size;
+
+	st->frag = 0;
+	if (free > 0 && st->largest_free < free)
+		st->frag = 1000 - div64_u64(st->largest_free * 1000, free);
+}
+
+#ifdef CONFIG_EVL_SHARED_HUGEPAGE
+
+/*
+ * The shared heap is mapped by every EVL process, and carries the
+ * fast-path state of threads and monitors. Back it by huge page(s)
+ * when possible, so that control_mmap() may map it through huge PMDs
+ * instead of as many PTEs as regular pages it spans, saving TLB
+ * entries on the hot paths. We round the size up to a PMD boundary
+ * for this, which merely increases the capacity of the heap. Fall
+ * back to regular pages if no contiguous memory is available.
+ */
+static void *alloc_shared_mem(size_t *sizep)
+{
+	size_t size = ALIGN(*sizep, HPAGE_PMD_SIZE);
+	struct page *page;
+	int order;
+
+	order = get_order(size);
+	if (order <= MAX_PAGE_ORDER) {
+		page = alloc_pages(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN,
+				order);
+		if (page) {
+			evl_shm_hugepage = true;
+			*sizep = size;
+			return page_address(page);
+		}
+	}
+
+	return kzalloc(*sizep, GFP_KERNEL);
+}
+
+static void free_shared_mem(void *mem, size_t size)
+{
+	if (evl_shm_hugepage) {
+		free_pages((unsigned long)mem, get_order(size));
+		evl_shm_hugepage = false;
+	} else {
+		kfree(mem);
+	}
+}
+
+#else
+
+static void *alloc_shared_mem(size_t *sizep)
+{
+	return kzalloc(*sizep, GFP_KERNEL);
+}
+
+static void free_shared_mem(void *mem, size_t size)
+{
+	kfree(mem);
+}
+
+#endif
+
 static int init_shared_heap(void)
 {
 	size_t size;
@@ -628,15 +1168,20 @@ static int init_shared_heap(void)
 	size = CONFIG_EVL_NR_THREADS *
 		sizeof(struct evl_user_window) +
 		CONFIG_EVL_NR_MONITORS *
-		sizeof(struct evl_monitor_state);
+		sizeof(struct evl_monitor_state) +
+		CONFIG_EVL_NR_EVGROUPS *
+		sizeof(struct evl_evgroup_state) +
+		CONFIG_EVL_NR_BARRIERS *
+		sizeof(struct evl_barrier_state) +
+		CONFIG_EVL_MQUEUE_HEAP_SZ * 1024;
 	size = PAGE_ALIGN(size);
-	mem = kzalloc(size, GFP_KERNEL);
+	mem = alloc_shared_mem(&size);
 	if (mem == NULL)
 		return -ENOMEM;
 
 	ret = evl_init_heap(&evl_shared_heap, mem, size);
 	if (ret) {
-		kfree(mem);
+		free_shared_mem(mem, size);
 		return ret;
 	}
 
@@ -650,39 +1195,683 @@ static void cleanup_shared_heap(void)
 	void *membase = evl_get_heap_base(&evl_shared_heap);
 
 	evl_destroy_heap(&evl_shared_heap);
-	kfree(membase);
+	free_shared_mem(membase, evl_shm_size);
 }
 
-static int init_system_heap(void)
+/*
+ * A process may ask for a heap of its own, which then holds the
+ * user-visible state of the elements it creates, except for public
+ * ones other processes may share, which stay on the shared heap.
+ * This way, processes neither contend on the same heap lock nor
+ * share cache lines for their state. The private heap is mapped
+ * right past the shared heap by mmap() on the control device, so
+ * that state offsets are still relative to the base of the shared
+ * mapping. The owner mm, each mapping of the heap and each block
+ * allocated from it hold a reference on the heap.
+ */
+int evl_create_private_heap(struct oob_mm_state *oob_mm, size_t size)
 {
-	size_t size = sysheap_size_arg;
-	void *sysmem;
+	struct evl_private_heap *ph;
+	void *mem;
 	int ret;
 
-	if (size == 0)
-		size = CONFIG_EVL_COREMEM_SIZE * 1024;
+	size = PAGE_ALIGN(size);
+	if (size == 0 || get_order(size) > MAX_PAGE_ORDER)
+		return -EINVAL;
+
+	if (READ_ONCE(oob_mm->private_heap))
+		return -EBUSY;
+
+	ph = kzalloc(sizeof(*ph), GFP_KERNEL);
+	if (ph == NULL)
+		return -ENOMEM;
+
+	/* Contiguous, so that remap_pfn_range() may map it. */
+	mem = alloc_pages_exact(size, GFP_KERNEL | __GFP_ZERO);
+	if (mem == NULL) {
+		ret = -ENOMEM;
+		goto fail_mem;
+	}
+
+	ret = evl_init_heap(&ph->heap, mem, size);
+	if (ret)
+		goto fail_heap;
+
+	refcount_set(&ph->refs, 1);
+
+	if (cmpxchg(&oob_mm->private_heap, NULL, ph)) {
+		ret = -EBUSY;
+		goto fail_race;
+	}
 
-	sysmem = vmalloc(size);
+	return 0;
+
+fail_race:
+	evl_destroy_heap(&ph->heap);
+fail_heap:
+	free_pages_exact(mem, size);
+fail_mem:
+	kfree(ph);
+
+	return ret;
+}
+
+static void get_private_heap(struct evl_private_heap *ph)
+{
+	refcount_inc(&ph->refs);
+}
+
+static void put_private_heap(struct evl_private_heap *ph) /* in-band */
+{
+	void *membase = evl_get_heap_base(&ph->heap);
+	size_t size = evl_get_heap_size(&ph->heap);
+
+	if (refcount_dec_and_test(&ph->refs)) {
+		evl_destroy_heap(&ph->heap);
+		free_pages_exact(membase, size);
+		kfree(ph);
+	}
+}
+
+/*
+ * Pick the heap which should hold the state of a new element
+ * created by the current process with @clone_flags, grabbing a
+ * reference on it. Allocations may go to the private heap only once
+ * the caller has mapped it.
+ */
+struct evl_heap *evl_get_state_heap(int clone_flags)
+{
+	struct oob_mm_state *oob_mm = dovetail_mm_state();
+	struct evl_private_heap *ph;
+
+	if (oob_mm == NULL || (clone_flags & EVL_CLONE_PUBLIC))
+		return &evl_shared_heap;
+
+	ph = READ_ONCE(oob_mm->private_heap);
+	if (ph == NULL || !READ_ONCE(ph->mapped))
+		return &evl_shared_heap;
+
+	get_private_heap(ph);
+
+	return &ph->heap;
+}
+
+void evl_put_state_heap(struct evl_heap *heap)
+{
+	if (heap != &evl_shared_heap)
+		put_private_heap(container_of(heap,
+					struct evl_private_heap, heap));
+}
+
+static void private_heap_vmopen(struct vm_area_struct *vma)
+{
+	get_private_heap(vma->vm_private_data);
+}
+
+static void private_heap_vmclose(struct vm_area_struct *vma)
+{
+	put_private_heap(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct private_heap_vm_ops = {
+	.open = private_heap_vmopen,
+	.close = private_heap_vmclose,
+};
+
+/*
+ * Map the private heap of the mm owning @vma at @addr, which must
+ * leave exactly enough room up to the end of the mapping.
+ */
+int evl_mmap_private_heap(struct vm_area_struct *vma, unsigned long addr)
+{
+	struct evl_private_heap *ph = vma->vm_mm->oob_state.private_heap;
+	void *membase;
+	size_t size;
+	int ret;
+
+	if (ph == NULL)
+		return -EINVAL;
+
+	membase = evl_get_heap_base(&ph->heap);
+	size = evl_get_heap_size(&ph->heap);
+	if (vma->vm_end - addr != size)
+		return -EINVAL;
+
+	ret = remap_pfn_range(vma, addr, __pa(membase) >> PAGE_SHIFT,
+			size, PAGE_SHARED);
+	if (ret)
+		return ret;
+
+	get_private_heap(ph);
+	vma->vm_private_data = ph;
+	vma->vm_ops = &private_heap_vm_ops;
+	WRITE_ONCE(ph->mapped, true);
+
+	return 0;
+}
+
+/* In-band, when @oob_mm is dropped. */
+void evl_drop_private_heap(struct oob_mm_state *oob_mm)
+{
+	struct evl_private_heap *ph = oob_mm->private_heap;
+
+	if (ph) {
+		oob_mm->private_heap = NULL;
+		put_private_heap(ph);
+	}
+}
+
+/*
+ * The system heap is split into per-node partitions, so that
+ * allocations from evl_alloc() may be served from memory local to
+ * the caller. Each partition is a list of extents, i.e. separate
+ * heaps, which may grow at runtime if CONFIG_EVL_SYSHEAP_GROWTH is
+ * enabled. Extents are only appended while the core runs, so that
+ * the lists can be walked locklessly from any stage. evl_system_heap
+ * is the first extent of the first node with memory.
+ */
+static struct list_head node_extents[MAX_NUMNODES];
+
+static nodemask_t heap_nodes = NODE_MASK_NONE;
+
+#define for_each_sysheap_extent(__heap, __nid)				\
+	for_each_node_mask(__nid, heap_nodes)				\
+		list_for_each_entry_lockless(__heap, &node_extents[__nid], next)
+
+static int init_node_heap(struct evl_heap *heap, int nid, size_t size)
+{
+	void *sysmem;
+	int ret;
+
+	sysmem = vmalloc_node(size, nid);
 	if (sysmem == NULL)
 		return -ENOMEM;
 
-	ret = evl_init_heap(&evl_system_heap, sysmem, size);
+	ret = evl_init_heap(heap, sysmem, size);
 	if (ret) {
 		vfree(sysmem);
 		return -ENOMEM;
 	}
 
+	heap->node = nid;
+
+	ret = evl_enable_heap_cache(heap);
+	if (ret) {
+		evl_destroy_heap(heap);
+		vfree(sysmem);
+		return ret;
+	}
+
 	return 0;
 }
 
-static void cleanup_system_heap(void)
+static void cleanup_node_heap(struct evl_heap *heap)
 {
-	void *membase = evl_get_heap_base(&evl_system_heap);
+	void *membase = evl_get_heap_base(heap);
 
-	evl_destroy_heap(&evl_system_heap);
+	evl_destroy_heap(heap);
 	vfree(membase);
 }
 
+/* in-band, serialized by the caller. */
+static int add_node_extent(int nid, size_t size)
+{
+	struct evl_heap *heap;
+	int ret;
+
+	if (list_empty(&node_extents[nid]) && nodes_empty(heap_nodes)) {
+		heap = &evl_system_heap;
+	} else {
+		heap = kzalloc_node(sizeof(*heap), GFP_KERNEL, nid);
+		if (heap == NULL)
+			return -ENOMEM;
+	}
+
+	ret = init_node_heap(heap, nid, size);
+	if (ret) {
+		if (heap != &evl_system_heap)
+			kfree(heap);
+		return ret;
+	}
+
+	/* Publish the extent once fully initialized. */
+	list_add_tail_rcu(&heap->next, &node_extents[nid]);
+
+	return 0;
+}
+
+static size_t get_node_free(int nid)
+{
+	struct evl_heap *heap;
+	size_t free = 0;
+
+	list_for_each_entry_lockless(heap, &node_extents[nid], next)
+		free += evl_get_heap_free(heap);
+
+	return free;
+}
+
+#ifdef CONFIG_EVL_SYSHEAP_GROWTH
+
+/*
+ * When the free memory of a partition drops below the low
+ * watermark, we ask an in-band worker to add an extent to it. The
+ * out-of-band side never waits for this: allocations which cannot
+ * be served in the meantime fail as usual.
+ */
+#define SYSHEAP_EXTENT_SIZE	(CONFIG_EVL_SYSHEAP_EXTENT_SIZE * 1024)
+#define SYSHEAP_LOWMARK		(CONFIG_EVL_SYSHEAP_LOWMARK * 1024)
+
+static struct evl_work growth_work;
+
+static nodemask_t growing_nodes = NODE_MASK_NONE;
+
+static int nr_extents[MAX_NUMNODES];
+
+static void grow_system_heap(struct evl_work *work)
+{
+	int nid, ret;
+
+	for_each_node_mask(nid, heap_nodes) {
+		if (!node_isset(nid, growing_nodes))
+			continue;
+		if (nr_extents[nid] < CONFIG_EVL_SYSHEAP_MAX_EXTENTS &&
+			get_node_free(nid) < SYSHEAP_LOWMARK) {
+			ret = add_node_extent(nid, SYSHEAP_EXTENT_SIZE);
+			if (ret)
+				printk_ratelimited(EVL_WARNING
+					"cannot grow system heap on node %d [%d]\n",
+					nid, ret);
+			else
+				nr_extents[nid]++;
+		}
+		node_clear(nid, growing_nodes);
+	}
+}
+
+static inline void check_growth(int nid)
+{
+	if (get_node_free(nid) < SYSHEAP_LOWMARK &&
+		nr_extents[nid] < CONFIG_EVL_SYSHEAP_MAX_EXTENTS &&
+		!node_test_and_set(nid, growing_nodes))
+		evl_call_inband(&growth_work);
+}
+
+static void init_growth(void)
+{
+	int nid;
+
+	evl_init_work(&growth_work, grow_system_heap);
+	nodes_clear(growing_nodes);
+	for_each_node_mask(nid, heap_nodes)
+		nr_extents[nid] = 1;
+}
+
+static void cleanup_growth(void)
+{
+	evl_cancel_work(&growth_work);
+}
+
+#else
+
+static inline void check_growth(int nid)
+{ }
+
+static inline void init_growth(void)
+{ }
+
+static inline void cleanup_growth(void)
+{ }
+
+#endif
+
+static void cleanup_system_heap(void)
+{
+	struct evl_heap *heap, *n;
+	int nid;
+
+	cleanup_growth();
+
+	for_each_node_mask(nid, heap_nodes) {
+		list_for_each_entry_safe(heap, n, &node_extents[nid], next) {
+			list_del(&heap->next);
+			cleanup_node_heap(heap);
+			if (heap != &evl_system_heap)
+				kfree(heap);
+		}
+	}
+
+	nodes_clear(heap_nodes);
+}
+
+static int init_system_heap(void)
+{
+	size_t size = sysheap_size_arg;
+	int nid, ret;
+
+	if (size == 0)
+		size = CONFIG_EVL_COREMEM_SIZE * 1024;
+
+	/* The requested size is evenly shared by all memory nodes. */
+	size = PAGE_ALIGN(size / num_node_state(N_MEMORY));
+
+	for_each_node_state(nid, N_MEMORY) {
+		INIT_LIST_HEAD(&node_extents[nid]);
+		ret = add_node_extent(nid, size);
+		if (ret)
+			goto fail;
+		node_set(nid, heap_nodes);
+	}
+
+	init_growth();
+
+	return 0;
+fail:
+	cleanup_system_heap();
+
+	return ret;
+}
+
+#if defined(CONFIG_NUMA) || defined(CONFIG_EVL_SYSHEAP_GROWTH)
+
+static void *alloc_from_node(int nid, size_t size, unsigned long caller)
+{
+	struct evl_heap *heap;
+	void *p = NULL;
+
+	list_for_each_entry_lockless(heap, &node_extents[nid], next) {
+		p = alloc_chunk(heap, size, caller);
+		if (p)
+			break;
+	}
+
+	check_growth(nid);
+
+	return p;
+}
+
+/**
+ * evl_alloc - allocate a block from the system heap
+ * @size: the size of the block
+ *
+ * The block is obtained from the partition of the memory node
+ * nearest to the current CPU, or from any other partition with
+ * enough free space, trying them in node order.
+ */
+void *evl_alloc(size_t size)
+{
+	int nid, local = numa_mem_id();
+	void *p;
+
+	if (node_isset(local, heap_nodes)) {
+		p = alloc_from_node(local, size, _RET_IP_);
+		if (p)
+			return p;
+	}
+
+	for_each_node_mask(nid, heap_nodes) {
+		if (nid == local)
+			continue;
+		p = alloc_from_node(nid, size, _RET_IP_);
+		if (p)
+			return p;
+	}
+
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(evl_alloc);
+
+void evl_free(void *ptr)
+{
+	struct evl_heap *heap;
+	int nid;
+
+	for_each_sysheap_extent(heap, nid) {
+		if (ptr >= heap->membase &&
+			ptr < heap->membase + heap->usable_size) {
+			evl_free_chunk(heap, ptr);
+			return;
+		}
+	}
+
+	EVL_WARN(MEMORY, 1, "invalid block %p in system heap", ptr);
+}
+EXPORT_SYMBOL_GPL(evl_free);
+
+#endif
+
+/*
+ * One line per partition of the system heap: node number, size and
+ * amount of memory in use (bytes), count of extents.
+ */
+ssize_t evl_show_sysheap_usage(char *buf, size_t size)
+{
+	size_t heapsz, used;
+	struct evl_heap *heap;
+	ssize_t ret = 0;
+	int nid, nr;
+
+	for_each_node_mask(nid, heap_nodes) {
+		heapsz = used = 0;
+		nr = 0;
+		list_for_each_entry_lockless(heap, &node_extents[nid], next) {
+			heapsz += evl_get_heap_size(heap);
+			used += READ_ONCE(heap->used_size);
+			nr++;
+		}
+		ret += scnprintf(buf + ret, size - ret, "%d %zu %zu %d\n",
+				nid, heapsz, used, nr);
+	}
+
+	return ret;
+}
+
+#ifdef CONFIG_EVL_HEAP_CACHE
+
+/*
+ * One line per partition of the system heap, CPU and bucket size:
+ * node number, CPU number, block size, count of allocations served
+ * from the magazine, count of those which had to refill it from the
+ * heap, and count of blocks currently cached.
+ */
+ssize_t evl_show_sysheap_cache(char *buf, size_t size)
+{
+	struct evl_heap *heap;
+	ssize_t ret = 0;
+	int nid;
+
+	for_each_sysheap_extent(heap, nid)
+		ret += show_heap_cache(heap, buf + ret, size - ret);
+
+	return ret;
+}
+
+#endif
+
+/**
+ * evl_get_core_heap_stats - collect the statistics of a core heap
+ * @st: the statistics block, st->heap tells which heap (either
+ * EVL_HEAP_SYSTEM, EVL_HEAP_SHARED or EVL_HEAP_PRIVATE for the
+ * private heap of the caller's process, if any)
+ *
+ * The figures for the system heap are summed over all of its
+ * partitions, except for the largest free range, which is the
+ * largest one in any partition. Therefore the peak usage is an upper
+ * bound on NUMA systems.
+ */
+int evl_get_core_heap_stats(struct evl_heap_stats *st)
+{
+	struct evl_private_heap *ph;
+	struct oob_mm_state *oob_mm;
+	struct evl_heap *heap;
+	int nid, n;
+
+	BUILD_BUG_ON(EVL_HEAP_NR_BUCKETS != EVL_HEAP_MAX_BUCKETS);
+
+	st->usable_size = 0;
+	st->used_size = 0;
+	st->peak_used = 0;
+	st->largest_free = 0;
+	for (n = 0; n <= EVL_HEAP_MAX_BUCKETS; n++)
+		st->nr_busy[n] = 0;
+
+	switch (st->heap) {
+	case EVL_HEAP_SYSTEM:
+		for_each_sysheap_extent(heap, nid)
+			collect_heap_stats(heap, st);
+		break;
+	case EVL_HEAP_SHARED:
+		collect_heap_stats(&evl_shared_heap, st);
+		break;
+	case EVL_HEAP_PRIVATE:
+		oob_mm = dovetail_mm_state();
+		ph = oob_mm ? READ_ONCE(oob_mm->private_heap) : NULL;
+		if (ph == NULL)
+			return -ENOENT;
+		collect_heap_stats(&ph->heap, st);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	finish_heap_stats(st);
+
+	return 0;
+}
+
+/*
+ * One line per core heap: name, usable size, used size, peak usage,
+ * largest free range (bytes), fragmentation ratio (per mille), then
+ * the count of busy blocks in each bucket from 16 to 256 bytes,
+ * followed by the count of multi-page blocks.
+ */
+ssize_t evl_show_heap_stats(char *buf, size_t size)
+{
+	static const char *names[] = {
+		[EVL_HEAP_SYSTEM] = "system",
+		[EVL_HEAP_SHARED] = "shared",
+	};
+	struct evl_heap_stats st;
+	ssize_t ret = 0;
+	int h, n;
+
+	for (h = 0; h < ARRAY_SIZE(names); h++) {
+		st.heap = h;
+		evl_get_core_heap_stats(&st);
+		ret += scnprintf(buf + ret, size - ret,
+				"%s %llu %llu %llu %llu %u",
+				names[h], st.usable_size, st.used_size,
+				st.peak_used, st.largest_free, st.frag);
+		for (n = 0; n <= EVL_HEAP_MAX_BUCKETS; n++)
+			ret += scnprintf(buf + ret, size - ret,
+					" %llu", st.nr_busy[n]);
+		ret += scnprintf(buf + ret, size - ret, "\n");
+	}
+
+	return ret;
+}
+
+#ifdef CONFIG_EVL_DEBUG_HEAP_TAGS
+
+#define MAX_TAG_CALLERS  64
+
+struct tag_usage {
+	unsigned long caller;
+	unsigned long count;
+	size_t bytes;
+};
+
+static void count_tag(struct tag_usage *usage, int *nr,
+		unsigned long caller, size_t bytes)
+{
+	int n;
+
+	for (n = 0; n < *nr; n++) {
+		if (usage[n].caller == caller)
+			goto found;
+	}
+
+	if (*nr < MAX_TAG_CALLERS - 1) {
+		n = (*nr)++;
+		usage[n].caller = caller;
+	} else {
+		/* The last slot collects the overflow. */
+		n = MAX_TAG_CALLERS - 1;
+		usage[n].caller = 0;
+		*nr = MAX_TAG_CALLERS;
+	}
+found:
+	usage[n].count++;
+	usage[n].bytes += bytes;
+}
+
+static void collect_heap_tags(struct evl_heap *heap,
+			struct tag_usage *usage, int *nr)
+{
+	unsigned long flags, *tags, map;
+	int pg, nrpages, log2size, b;
+
+	nrpages = heap->usable_size >> EVL_HEAP_PAGE_SHIFT;
+
+	/* Scan page by page, so that we don't hog the heap lock. */
+	for (pg = 0; pg < nrpages; pg++) {
+		raw_spin_lock_irqsave(&heap->lock, flags);
+
+		tags = heap->tags + pg * TAGS_PER_PAGE;
+		switch (heap->pagemap[pg].type) {
+		case page_free:
+		case page_cont:
+			break;
+		case page_list:
+			count_tag(usage, nr, tags[0], heap->pagemap[pg].bsize);
+			break;
+		default:
+			log2size = heap->pagemap[pg].type;
+			map = heap->pagemap[pg].map & gen_block_mask(log2size);
+			for_each_set_bit(b, &map, TAGS_PER_PAGE)
+				count_tag(usage, nr, tags[b], 1 << log2size);
+		}
+
+		raw_spin_unlock_irqrestore(&heap->lock, flags);
+	}
+}
+
+/*
+ * One line per caller owning busy blocks in the core heaps: caller
+ * address, count of blocks, and overall size. If there are too many
+ * callers, the last line gathers the remaining ones, with a null
+ * caller address.
+ */
+ssize_t evl_show_heap_tags(char *buf, size_t size)
+{
+	struct evl_heap *heap;
+	struct tag_usage *usage;
+	int nr = 0, nid, n;
+	ssize_t ret = 0;
+
+	inband_context_only();
+
+	usage = kcalloc(MAX_TAG_CALLERS, sizeof(*usage), GFP_KERNEL);
+	if (usage == NULL)
+		return -ENOMEM;
+
+	for_each_sysheap_extent(heap, nid)
+		collect_heap_tags(heap, usage, &nr);
+
+	collect_heap_tags(&evl_shared_heap, usage, &nr);
+
+	for (n = 0; n < nr; n++)
+		ret += scnprintf(buf + ret, size - ret, "%pS %lu %zu\n",
+				(void *)usage[n].caller,
+				usage[n].count, usage[n].bytes);
+
+	kfree(usage);
+
+	return ret;
+}
+
+#endif
+
 int __init evl_init_memory(void)
 {
 	int ret;
@@ -8,7 +8,6 @@
 #include <linux/list.h>
 #include <linux/slab.h>
 #include <linux/wait.h>
-#include <linux/irq_work.h>
 #include <evl/thread.h>
 #include <evl/mutex.h>
 #include <evl/thread.h>
@@ -16,6 +15,7 @@
 #include <evl/factory.h>
 #include <evl/monitor.h>
 #include <evl/poll.h>
+#include <evl/work.h>
 #include <evl/uaccess.h>
 #include <trace/events/evl.h>
 
@@ -27,6 +27,7 @@ static __always_inline  atomic_t *__ATOMIC32(__u32 *ptr)
 struct evl_monitor {
 	struct evl_element element;
 	struct evl_monitor_state *state;
+	struct evl_heap *heap;
 	int type : 2,
 	    protocol : 4;
 	union {
@@ -43,11 +44,13 @@ struct evl_monitor {
 			/* In-band wait queue (write side). */
 			wait_queue_head_t inband_wait_w;
 			/* In-band wake up work (read side). */
-			struct irq_work inband_wake_r;
+			struct evl_inband_wakeup inband_wake_r;
 			/* In-band wake up work (write side). */
-			struct irq_work inband_wake_w;
+			struct evl_inband_wakeup inband_wake_w;
 			/* Gate (valid during active wait only). */
 			struct evl_monitor *gate;
+			/* Broadcast being relayed to marked waiters. */
+			bool relay;
 			/* Out-of-band poll head. */
 			struct evl_poll_head poll_head;
 			/* in ->events */
@@ -153,8 +156,52 @@ static void untrack_event(struct evl_monitor *event, struct evl_monitor *gate)
 	}
 }
 
-/* gate->lock + event->wait_queue.wchan.lock held, irqs off */
-static void wakeup_waiters(struct evl_monitor *event, struct evl_monitor *gate)
+/* event->wait_queue.wchan.lock held, irqs off */
+static void mark_waiters(struct evl_monitor *event)
+{
+	struct evl_thread *waiter;
+	struct evl_rq *rq;
+
+	evl_for_each_waiter(waiter, &event->wait_queue) {
+		rq = evl_get_thread_rq_noirq(waiter);
+		waiter->info |= EVL_T_SIGNAL;
+		evl_put_thread_rq_noirq(waiter, rq);
+	}
+}
+
+/*
+ * Wake up the first marked waiter, leaving the relay on if more are
+ * left for the next gate release. Returns false if all marked
+ * waiters went away in the meantime.
+ *
+ * event->wait_queue.wchan.lock held, irqs off
+ */
+static bool relay_broadcast(struct evl_monitor *event)
+{
+	struct evl_thread *waiter, *n;
+	bool woken = false;
+
+	event->relay = false;
+
+	evl_for_each_waiter_safe(waiter, n, &event->wait_queue) {
+		if (!(waiter->info & EVL_T_SIGNAL))
+			continue;
+		if (woken) {
+			event->relay = true;
+			break;
+		}
+		evl_wake_up(&event->wait_queue, waiter, 0);
+		woken = true;
+	}
+
+	return woken;
+}
+
+/*
+ * gate->lock + event->wait_queue.wchan.lock held, irqs off. Returns
+ * true if the signal is still pending.
+ */
+static bool wakeup_waiters(struct evl_monitor *event, struct evl_monitor *gate)
 {
 	struct evl_monitor_state *state = event->state;
 	struct evl_thread *waiter, *n;
@@ -177,8 +224,22 @@ static void wakeup_waiters(struct evl_monitor *event, struct evl_monitor *gate)
 	 * thread heading the wait queue is readied.
 	 */
 	if (evl_wait_active(&event->wait_queue)) {
+		/*
+		 * All waiters woken up by a broadcast would have to
+		 * pass the gate we hold, only to block on it again
+		 * but one. Instead, mark them so that they are let
+		 * in one after another, each time the gate is
+		 * released, keeping the signal pending until then.
+		 * A regular or targeted notification received in
+		 * the meantime is folded into the broadcast, since
+		 * the marked threads are still waiting.
+		 */
 		if (bcast) {
-			evl_flush_wait_locked(&event->wait_queue, 0);
+			mark_waiters(event);
+			event->relay = true;
+		}
+		if (event->relay && relay_broadcast(event)) {
+			/* One marked waiter may pass the gate next. */
 		} else if (state->flags & EVL_MONITOR_TARGETED) {
 			evl_for_each_waiter_safe(waiter, n,
 						&event->wait_queue) {
@@ -190,11 +251,42 @@ static void wakeup_waiters(struct evl_monitor *event, struct evl_monitor *gate)
 			evl_wake_up_head(&event->wait_queue);
 		}
 		untrack_event(event, gate);
-	} /* Otherwise, spurious wakeup (fine, might happen). */
+	} else { /* Otherwise, spurious wakeup (fine, might happen). */
+		event->relay = false;
+	}
+
+	state->flags &= ~(EVL_MONITOR_BROADCAST|EVL_MONITOR_TARGETED);
+	if (!event->relay)
+		state->flags &= ~EVL_MONITOR_SIGNALED;
+
+	return event->relay;
+}
+
+/* gate->lock held, irqs off */
+static void signal_gate(struct evl_monitor *gate)
+{
+	struct evl_monitor_state *state = gate->state;
+	struct evl_monitor *event, *n;
+	bool pending = false;
+
+	assert_hard_lock(&gate->lock);
 
-	state->flags &= ~(EVL_MONITOR_SIGNALED|
-			EVL_MONITOR_BROADCAST|
-			EVL_MONITOR_TARGETED);
+	/*
+	 * While gate.mutex is still held by current, we can
+	 * manipulate the state flags racelessly. Leaving the gate
+	 * signaled makes user-space release it from the kernel next
+	 * time, so that we can relay broadcasts.
+	 */
+	if (state->flags & EVL_MONITOR_SIGNALED) {
+		list_for_each_entry_safe(event, n, &gate->events, next) {
+			raw_spin_lock(&event->wait_queue.wchan.lock);
+			if (event->state->flags & EVL_MONITOR_SIGNALED)
+				pending |= wakeup_waiters(event, gate);
+			raw_spin_unlock(&event->wait_queue.wchan.lock);
+		}
+		if (!pending)
+			state->flags &= ~EVL_MONITOR_SIGNALED;
+	}
 }
 
 static int __enter_monitor(struct evl_monitor *gate,
@@ -253,9 +345,7 @@ static void __exit_monitor(struct evl_monitor *gate,
 
 static int exit_monitor(struct evl_monitor *gate)
 {
-	struct evl_monitor_state *state = gate->state;
 	struct evl_thread *curr = evl_current();
-	struct evl_monitor *event, *n;
 	unsigned long flags;
 
 	if (gate->type != EVL_MONITOR_GATE)
@@ -270,19 +360,7 @@ static int exit_monitor(struct evl_monitor *gate)
 	 */
 	raw_spin_lock_irqsave(&gate->lock, flags);
 
-	/*
-	 * While gate.mutex is still held by current, we can
-	 * manipulate the state flags racelessly.
-	 */
-	if (state->flags & EVL_MONITOR_SIGNALED) {
-		state->flags &= ~EVL_MONITOR_SIGNALED;
-		list_for_each_entry_safe(event, n, &gate->events, next) {
-			raw_spin_lock(&event->wait_queue.wchan.lock);
-			if (event->state->flags & EVL_MONITOR_SIGNALED)
-				wakeup_waiters(event, gate);
-			raw_spin_unlock(&event->wait_queue.wchan.lock);
-		}
-	}
+	signal_gate(gate);
 
 	/*
 	 * The whole wakeup+exit sequence must appear as atomic, drop
@@ -411,24 +489,53 @@ static int post_count(struct evl_monitor *event, s32 sigval,
 	return ret;
 }
 
-static void inband_wake_r_irqwork(struct irq_work *work) /* in-band */
+static void inband_wake_r_wakeup(struct evl_inband_wakeup *wakeup) /* in-band */
 {
 	struct evl_monitor *event;
 
-	event = container_of(work, struct evl_monitor, inband_wake_r);
+	event = container_of(wakeup, struct evl_monitor, inband_wake_r);
 	wake_up(&event->inband_wait_r);
 	evl_put_element(&event->element);
 }
 
-static void inband_wake_w_irqwork(struct irq_work *work) /* in-band */
+static void inband_wake_w_wakeup(struct evl_inband_wakeup *wakeup) /* in-band */
 {
 	struct evl_monitor *event;
 
-	event = container_of(work, struct evl_monitor, inband_wake_w);
+	event = container_of(wakeup, struct evl_monitor, inband_wake_w);
 	wake_up(&event->inband_wait_w);
 	evl_put_element(&event->element);
 }
 
+static inline bool match_mask(s32 val, s32 match_value,
+			bool exact_match, s32 *r_value)
+{
+	*r_value = val & match_value;
+
+	return *r_value && *r_value == (exact_match ? match_value : *r_value);
+}
+
+/*
+ * Consume the matching bits, racing with user-space which may clear
+ * bits concurrently without holding any lock.
+ */
+static bool consume_mask(struct evl_monitor_state *state,
+			s32 match_value,
+			bool exact_match,
+			s32 *r_value)
+{
+	atomic_t *value = __ATOMIC32(&state->u.event.value);
+	int val;
+
+	val = atomic_read(value);
+	do {
+		if (!match_mask(val, match_value, exact_match, r_value))
+			return false;
+	} while (!atomic_try_cmpxchg(value, &val, val & ~*r_value));
+
+	return true;
+}
+
 /* event->wait_queue.wchan.lock held, dropped on success, irqs off. */
 static bool __trywait_mask(struct evl_monitor *event,
 			s32 match_value,
@@ -439,10 +546,7 @@ static bool __trywait_mask(struct evl_monitor *event,
 	struct evl_monitor_state *state = event->state;
 	int testval;
 
-	*r_value = atomic_read(__ATOMIC32(&state->u.event.value)) & match_value;
-	testval = exact_match ? match_value : *r_value;
-	if (*r_value && *r_value == testval) {
-		atomic_andnot(*r_value, __ATOMIC32(&state->u.event.value));
+	if (consume_mask(state, match_value, exact_match, r_value)) {
 		testval = atomic_read(__ATOMIC32(&state->u.event.value));
 		raw_spin_unlock_irqrestore(&event->wait_queue.wchan.lock, flags);
 		if (!testval) {
@@ -493,6 +597,7 @@ static int wait_mask_oob(struct file *filp,
 		s32 *r_value)
 {
 	struct evl_monitor *event = element_of(filp, struct evl_monitor);
+	atomic_t *waiters = __ATOMIC32(&event->state->u.event.waiters);
 	struct evl_thread *curr = evl_current();
 	struct evl_mask_wait w;
 	unsigned long flags;
@@ -503,12 +608,23 @@ static int wait_mask_oob(struct file *filp,
 
 	raw_spin_lock_irqsave(&event->wait_queue.wchan.lock, flags);
 
-	if (__trywait_mask(event, match_value, exact_match, r_value, flags))
-		return 0;	/* oob lock already dropped on success. */
+	/*
+	 * Count in before checking the mask, so that user-space
+	 * posting bits without entering the kernel either sees us or
+	 * sets them early enough for us to see them.
+	 */
+	atomic_inc(waiters);
+	smp_mb__after_atomic();
+
+	if (__trywait_mask(event, match_value, exact_match, r_value, flags)) {
+		ret = 0;	/* oob lock already dropped on success. */
+		goto out;
+	}
 
 	if (filp->f_flags & O_NONBLOCK) {
 		raw_spin_unlock_irqrestore(&event->wait_queue.wchan.lock, flags);
-		return -EAGAIN;
+		ret = -EAGAIN;
+		goto out;
 	}
 
 	w.exact_match = exact_match;
@@ -521,6 +637,8 @@ static int wait_mask_oob(struct file *filp,
 	ret = evl_wait_schedule(&event->wait_queue);
 	if (!ret)
 		*r_value = w.value;
+out:
+	atomic_dec(waiters);
 
 	return ret;
 }
@@ -528,7 +646,8 @@ static int wait_mask_oob(struct file *filp,
 static int post_mask(struct evl_monitor *event, int bits, bool bcast)
 {
 	struct evl_monitor_state *state = event->state;
-	int waitval, testval, consumed = 0, val;
+	atomic_t *value = __ATOMIC32(&state->u.event.value);
+	int waitval, consumed, val;
 	struct evl_thread *waiter, *tmp;
 	struct evl_mask_wait *w;
 	unsigned long flags;
@@ -536,33 +655,46 @@ static int post_mask(struct evl_monitor *event, int bits, bool bcast)
 	raw_spin_lock_irqsave(&event->wait_queue.wchan.lock, flags);
 
 	/*
-	 * NOTE: the only reasons we still have state->u.event.value
-	 * as an atomic value ATM is strictly for ABI preservation,
-	 * and allow for peeking at the mask value directly from
-	 * userland (which is hardly a common operation and could be
-	 * done differently anyway). We may turn this into a plain
-	 * word when an ABI jump is required from applications for
-	 * some compelling reason.
+	 * User-space may set and clear bits concurrently without
+	 * holding this lock, see uapi/evl/monitor-abi.h. A zero
+	 * @bits value is a request for checking the bits it already
+	 * set against the waiters.
+	 */
+	atomic_or(bits, value);
+
+	/*
+	 * Figure out which bits the waiters consume from a snapshot
+	 * of the mask, all matching waiters receiving the same bits
+	 * on broadcast, then clear them at once provided the mask
+	 * did not change in the meantime. The wait list is stable
+	 * under lock, so the second pass picks the same waiters.
 	 */
-	atomic_or(bits, __ATOMIC32(&state->u.event.value));
-
-	evl_for_each_waiter_safe(waiter, tmp, &event->wait_queue) {
-		w = waiter->wait_data;
-		waitval = w->value & atomic_read(__ATOMIC32(&state->u.event.value));
-		testval = w->exact_match ? w->value : waitval;
-		if (waitval && waitval == testval) {
-			w->value = waitval;
-			consumed |= waitval;
-			evl_wake_up(&event->wait_queue, waiter, 0);
-			if (!bcast)
-				break;
+	val = atomic_read(value);
+	do {
+		consumed = 0;
+		evl_for_each_waiter(waiter, &event->wait_queue) {
+			w = waiter->wait_data;
+			if (match_mask(val, w->value, w->exact_match, &waitval)) {
+				consumed |= waitval;
+				if (!bcast)
+					break;
+			}
+		}
+	} while (consumed && !atomic_try_cmpxchg(value, &val, val & ~consumed));
+
+	if (consumed) {
+		evl_for_each_waiter_safe(waiter, tmp, &event->wait_queue) {
+			w = waiter->wait_data;
+			if (match_mask(val, w->value, w->exact_match, &waitval)) {
+				w->value = waitval;
+				evl_wake_up(&event->wait_queue, waiter, 0);
+				if (!bcast)
+					break;
+			}
 		}
 	}
 
-	if (consumed)
-		atomic_andnot(consumed, __ATOMIC32(&state->u.event.value));
-
-	val = atomic_read(__ATOMIC32(&state->u.event.value));
+	val = atomic_read(value);
 
 	raw_spin_unlock_irqrestore(&event->wait_queue.wchan.lock, flags);
 
@@ -581,7 +713,7 @@ static int post_mask(struct evl_monitor *event, int bits, bool bcast)
 			wake_up(&event->inband_wait_r);
 		} else {
 			evl_get_element(&event->element);
-			if (!irq_work_queue(&event->inband_wake_r))
+			if (!evl_queue_inband_wakeup(&event->inband_wake_r))
 				evl_put_element(&event->element);
 		}
 	}
@@ -637,13 +769,21 @@ static int wait_gated_event(struct evl_monitor *event,
 	if (event->gate == NULL) {
 		list_add_tail(&event->next, &gate->events);
 		event->gate = gate;
-		event->state->u.event.gate_offset = evl_shared_offset(gate->state);
+		event->state->u.event.gate_offset = 
+			evl_state_offset(gate->heap, gate->state);
 	} else if (event->gate != gate) {
 		raw_spin_unlock_irqrestore(&gate->lock, flags);
 		op_ret = -EBADFD;
 		goto put;
 	}
 
+	/*
+	 * Deliver the pending notifications before we queue up,
+	 * since we are about to release the gate. This also keeps
+	 * broadcasts relayed when their waiters wait again.
+	 */
+	signal_gate(gate);
+
 	/*
 	 * Since we still hold the mutex until __exit_monitor() is
 	 * called later on, do not perform the WOLI checks when
@@ -694,6 +834,13 @@ static int wait_gated_event(struct evl_monitor *event,
 			curr->local_info |= EVL_T_NORST;
 			goto put;
 		}
+		/*
+		 * A waiter marked by a broadcast was notified before
+		 * timing out, even if its turn in the relay did not
+		 * come in time.
+		 */
+		if (ret == -ETIMEDOUT && (curr->info & EVL_T_SIGNAL))
+			ret = 0;
 		op_ret = ret;
 		if (ret == -EIDRM)
 			goto put;
@@ -842,7 +989,7 @@ static long monitor_ioctl(struct file *filp, unsigned int cmd,
 	bind.type = mon->type;
 	bind.protocol = mon->protocol;
 	bind.eids.minor = mon->element.minor;
-	bind.eids.state_offset = evl_shared_offset(mon->state);
+	bind.eids.state_offset = evl_state_offset(mon->heap, mon->state);
 	bind.eids.fundle = fundle_of(mon);
 	u_bind = (typeof(u_bind))arg;
 
@@ -943,6 +1090,7 @@ static __poll_t monitor_oob_poll(struct file *filp,
 		case EVL_EVENT_COUNT:
 			evl_poll_watch(&mon->poll_head, wait, monitor_unwatch);
 			atomic_inc(__ATOMIC32(&state->u.event.pollrefs));
+			smp_mb__after_atomic();
 			if (atomic_read(__ATOMIC32(&state->u.event.value)) > 0)
 				ret = POLLIN|POLLRDNORM;
 			break;
@@ -954,6 +1102,7 @@ static __poll_t monitor_oob_poll(struct file *filp,
 			 * (pre-32).
 			 */
 			atomic_inc(__ATOMIC32(&state->u.event.pollrefs));
+			smp_mb__after_atomic();
 			val = atomic_read(__ATOMIC32(&state->u.event.value));
 			/*
 			 * Return POLLIN when some bits are present,
@@ -1023,6 +1172,8 @@ static ssize_t monitor_read(struct file *filp, char __user *u_buf,
 		return -EINVAL;
 
 	init_wait_entry(&wq_entry, 0);
+	atomic_inc(__ATOMIC32(&event->state->u.event.waiters));
+	smp_mb__after_atomic();
 
 	for (;;) {
 		spin_lock_irqsave(&event->inband_wait_r.lock, ib_flags);
@@ -1057,6 +1208,8 @@ unlocked:
 
 	spin_unlock_irqrestore(&event->inband_wait_r.lock, ib_flags);
 
+	atomic_dec(__ATOMIC32(&event->state->u.event.waiters));
+
 	/*
 	 * If we have successfully collected all the bits, send a
 	 * POLLOUT wakeup.
@@ -1134,6 +1287,7 @@ static ssize_t monitor_oob_write(struct file *filp,
 static __poll_t monitor_poll(struct file *filp, poll_table *wait)
 {
 	struct evl_monitor *event = element_of(filp, struct evl_monitor);
+	unsigned long flags;
 	__poll_t ret = 0;
 	int val;
 
@@ -1143,6 +1297,17 @@ static __poll_t monitor_poll(struct file *filp, poll_table *wait)
 	poll_wait(filp, &event->inband_wait_r, wait);
 	poll_wait(filp, &event->inband_wait_w, wait);
 
+	/*
+	 * We cannot tell when in-band pollers go away, have user-space
+	 * enter the kernel for updating the mask from now on.
+	 */
+	if (!(READ_ONCE(event->state->flags) & EVL_MONITOR_SLOWPATH)) {
+		raw_spin_lock_irqsave(&event->wait_queue.wchan.lock, flags);
+		event->state->flags |= EVL_MONITOR_SLOWPATH;
+		raw_spin_unlock_irqrestore(&event->wait_queue.wchan.lock, flags);
+		smp_mb();
+	}
+
 	val = atomic_read(__ATOMIC32(&event->state->u.event.value));
 	if (val)
 		ret |= POLLIN|POLLRDNORM;
@@ -1231,7 +1396,8 @@ monitor_factory_build(struct evl_factory *fac, const char __user *u_name,
 	if (ret)
 		goto fail_element;
 
-	state = evl_zalloc_chunk(&evl_shared_heap, sizeof(*state));
+	mon->heap = evl_get_state_heap(clone_flags);
+	state = evl_zalloc_chunk(mon->heap, sizeof(*state));
 	if (state == NULL) {
 		ret = -ENOMEM;
 		goto fail_heap;
@@ -1261,8 +1427,8 @@ monitor_factory_build(struct evl_factory *fac, const char __user *u_name,
 		evl_init_poll_head(&mon->poll_head);
 		init_waitqueue_head(&mon->inband_wait_r);
 		init_waitqueue_head(&mon->inband_wait_w);
-		init_irq_work(&mon->inband_wake_r, inband_wake_r_irqwork);
-		init_irq_work(&mon->inband_wake_w, inband_wake_w_irqwork);
+		evl_init_inband_wakeup(&mon->inband_wake_r, inband_wake_r_wakeup);
+		evl_init_inband_wakeup(&mon->inband_wake_w, inband_wake_w_wakeup);
 	}
 
 	/*
@@ -1273,12 +1439,13 @@ monitor_factory_build(struct evl_factory *fac, const char __user *u_name,
 	mon->type = attrs.type;
 	mon->protocol = attrs.protocol;
 	mon->state = state;
-	*state_offp = evl_shared_offset(state);
+	*state_offp = evl_state_offset(mon->heap, state);
 	evl_index_factory_element(&mon->element);
 
 	return &mon->element;
 
 fail_heap:
+	evl_put_state_heap(mon->heap);
 	evl_destroy_element(&mon->element);
 fail_element:
 	kfree(mon);
@@ -1310,7 +1477,8 @@ static void monitor_factory_dispose(struct evl_element *e)
 		evl_destroy_mutex(&mon->mutex);
 	}
 
-	evl_free_chunk(&evl_shared_heap, mon->state);
+	evl_free_chunk(mon->heap, mon->state);
+	evl_put_state_heap(mon->heap);
 	evl_destroy_element(&mon->element);
 	kfree_rcu(mon, element.rcu);
 }
@@ -1373,8 +1541,43 @@ static ssize_t state_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(state);
 
+#ifdef CONFIG_EVL_MUTEX_SPIN
+
+/*
+ * Contended acquisitions of a gate, either after spinning on the
+ * owner or after sleeping. Nothing to report for events.
+ */
+static ssize_t spin_stats_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_mutex_stats stats;
+	struct evl_monitor *mon;
+	ssize_t ret = 0;
+
+	mon = evl_get_element_by_dev(dev, struct evl_monitor);
+	if (mon == NULL)
+		return -EIO;
+
+	if (mon->type == EVL_MONITOR_GATE) {
+		evl_get_mutex_stats(&mon->mutex, &stats);
+		ret = snprintf(buf, PAGE_SIZE, "%u %u\n",
+			stats.spin_acquired, stats.slept);
+	}
+
+	evl_put_element(&mon->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(spin_stats);
+
+#endif
+
 static struct attribute *monitor_attrs[] = {
 	&dev_attr_state.attr,
+#ifdef CONFIG_EVL_MUTEX_SPIN
+	&dev_attr_spin_stats.attr,
+#endif
 	NULL,
 };
 ATTRIBUTE_GROUPS(monitor);
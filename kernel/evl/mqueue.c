@@ -0,0 +1,363 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/atomic.h>
+#include <linux/overflow.h>
+#include <evl/thread.h>
+#include <evl/clock.h>
+#include <evl/memory.h>
+#include <evl/factory.h>
+#include <evl/sched.h>
+#include <evl/wait.h>
+#include <evl/uaccess.h>
+#include <uapi/evl/mqueue-abi.h>
+
+/*
+ * The message rings are managed by user-space directly, see
+ * uapi/evl/mqueue-abi.h for the protocol. The kernel only deals with
+ * blocking and waking up threads, inspecting the rings to figure out
+ * whether the wait condition is met. The shared state can be
+ * scribbled over by user-space, so we rely on our private copy of the
+ * geometry, and never dereference anything but the slot headers from
+ * there.
+ */
+struct evl_mqueue {
+	struct evl_element element;
+	struct evl_mqueue_state *state;
+	struct evl_heap *heap;
+	void *slots;
+	u32 msgsize;
+	u32 capacity;
+	u32 nr_prios;
+	size_t slot_size;
+	struct evl_wait_queue readers;
+	struct evl_wait_queue writers;
+};
+
+static __always_inline atomic_t *__ATOMIC32(__u32 *ptr)
+{
+	return (atomic_t *)ptr;
+}
+
+static inline struct evl_mqueue_slot *
+get_slot(struct evl_mqueue *mq, u32 prio, u32 pos)
+{
+	size_t n = (size_t)prio * mq->capacity + (pos & (mq->capacity - 1));
+
+	return mq->slots + n * mq->slot_size;
+}
+
+static bool ring_readable(struct evl_mqueue *mq, u32 prio)
+{
+	struct evl_mqueue_ring *ring = mq->state->rings + prio;
+	u32 pos = atomic_read(__ATOMIC32(&ring->tail));
+	u32 seq = smp_load_acquire(&get_slot(mq, prio, pos)->seq);
+
+	/* A stale tail reads as readable, causing a mere retry. */
+	return (s32)(seq - (pos + 1)) >= 0;
+}
+
+static bool ring_writable(struct evl_mqueue *mq, u32 prio)
+{
+	struct evl_mqueue_ring *ring = mq->state->rings + prio;
+	u32 pos = atomic_read(__ATOMIC32(&ring->head));
+	u32 seq = smp_load_acquire(&get_slot(mq, prio, pos)->seq);
+
+	return (s32)(seq - pos) >= 0;
+}
+
+static bool mqueue_readable(struct evl_mqueue *mq)
+{
+	int prio;
+
+	for (prio = mq->nr_prios - 1; prio >= 0; prio--)
+		if (ring_readable(mq, prio))
+			return true;
+
+	return false;
+}
+
+static int wait_mqueue(struct evl_mqueue *mq,
+		struct evl_mqueue_waitreq __user *u_wreq, bool output)
+{
+	struct evl_mqueue_state *state = mq->state;
+	struct __evl_timespec __user *u_uts;
+	struct evl_mqueue_waitreq wreq;
+	struct __evl_timespec uts;
+	enum evl_tmode tmode;
+	struct timespec64 ts64;
+	ktime_t timeout;
+	atomic_t *waiters;
+	int ret;
+
+	ret = raw_copy_from_user(&wreq, u_wreq, sizeof(wreq));
+	if (ret)
+		return -EFAULT;
+
+	u_uts = evl_valptr64(wreq.timeout_ptr, struct __evl_timespec);
+	ret = raw_copy_from_user(&uts, u_uts, sizeof(uts));
+	if (ret)
+		return -EFAULT;
+
+	if ((unsigned long)uts.tv_nsec >= ONE_BILLION)
+		return -EINVAL;
+
+	if (output && wreq.prio >= mq->nr_prios)
+		return -EINVAL;
+
+	ts64 = u_timespec_to_timespec64(uts);
+	timeout = timespec64_to_ktime(ts64);
+	tmode = timeout ? EVL_ABS : EVL_REL;
+
+	/*
+	 * Advertise the sleeper before checking the condition, pairs
+	 * with the barrier user-space issues between publishing a
+	 * slot and reading the waiter count.
+	 */
+	if (output) {
+		waiters = __ATOMIC32(&state->wr_waiters);
+		atomic_inc(waiters);
+		smp_mb__after_atomic();
+		ret = evl_wait_event_timeout(&mq->writers, timeout, tmode,
+					ring_writable(mq, wreq.prio));
+	} else {
+		waiters = __ATOMIC32(&state->rd_waiters);
+		atomic_inc(waiters);
+		smp_mb__after_atomic();
+		ret = evl_wait_event_timeout(&mq->readers, timeout, tmode,
+					mqueue_readable(mq));
+	}
+
+	atomic_dec(waiters);
+
+	return ret;
+}
+
+static void wake_mqueue(struct evl_mqueue *mq, bool output)
+{
+	unsigned long flags;
+
+	/*
+	 * A single message was posted, which a single reader may
+	 * consume. Conversely, a released slot only unblocks writers
+	 * waiting on its priority level, which we cannot tell apart,
+	 * so wake them all up.
+	 */
+	if (output) {
+		evl_flush_wait(&mq->writers, 0);
+	} else {
+		raw_spin_lock_irqsave(&mq->readers.wchan.lock, flags);
+		evl_wake_up_head(&mq->readers);
+		raw_spin_unlock_irqrestore(&mq->readers.wchan.lock, flags);
+	}
+
+	evl_schedule();
+}
+
+static long mqueue_oob_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	struct evl_mqueue *mq = element_of(filp, struct evl_mqueue);
+	struct evl_mqueue_waitreq __user *u_wreq;
+	long ret = 0;
+
+	u_wreq = (typeof(u_wreq))arg;
+
+	switch (cmd) {
+	case EVL_MQIOC_WAIT_INPUT:
+		ret = wait_mqueue(mq, u_wreq, false);
+		break;
+	case EVL_MQIOC_WAIT_OUTPUT:
+		ret = wait_mqueue(mq, u_wreq, true);
+		break;
+	case EVL_MQIOC_WAKE_INPUT:
+		wake_mqueue(mq, false);
+		break;
+	case EVL_MQIOC_WAKE_OUTPUT:
+		wake_mqueue(mq, true);
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+static int mqueue_release(struct inode *inode, struct file *filp)
+{
+	struct evl_mqueue *mq = element_of(filp, struct evl_mqueue);
+
+	evl_flush_wait(&mq->readers, EVL_T_RMID);
+	evl_flush_wait(&mq->writers, EVL_T_RMID);
+
+	return evl_release_element(inode, filp);
+}
+
+static const struct file_operations mqueue_fops = {
+	.open		= evl_open_element,
+	.release	= mqueue_release,
+	.oob_ioctl	= mqueue_oob_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_oob_ioctl  = compat_ptr_oob_ioctl,
+#endif
+};
+
+static struct evl_element *
+mqueue_factory_build(struct evl_factory *fac, const char __user *u_name,
+		void __user *u_attrs, int clone_flags, u32 *state_offp)
+{
+	struct evl_mqueue_state *state;
+	struct evl_mqueue_slot *slot;
+	struct evl_mqueue_attrs attrs;
+	size_t slot_size, rings_size;
+	struct evl_mqueue *mq;
+	struct evl_clock *clock;
+	u32 n, nr_slots;
+	int ret;
+
+	if (clone_flags & ~EVL_CLONE_PUBLIC)
+		return ERR_PTR(-EINVAL);
+
+	ret = copy_from_user(&attrs, u_attrs, sizeof(attrs));
+	if (ret)
+		return ERR_PTR(-EFAULT);
+
+	if (attrs.msgsize == 0 || attrs.msgsize > EVL_MQUEUE_MAX_MSGSIZE ||
+		attrs.capacity == 0 || !is_power_of_2(attrs.capacity) ||
+		attrs.capacity > EVL_MQUEUE_MAX_CAPACITY ||
+		attrs.nr_prios == 0 || attrs.nr_prios > EVL_MQUEUE_MAX_PRIOS)
+		return ERR_PTR(-EINVAL);
+
+	clock = evl_get_clock_by_fd(attrs.clockfd);
+	if (clock == NULL)
+		return ERR_PTR(-EINVAL);
+
+	mq = kzalloc(sizeof(*mq), GFP_KERNEL);
+	if (mq == NULL) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
+
+	ret = evl_init_user_element(&mq->element, &evl_mqueue_factory,
+				u_name, clone_flags);
+	if (ret)
+		goto fail_element;
+
+	/* Keep the slot headers aligned for atomic accesses. */
+	slot_size = ALIGN(sizeof(*slot) + attrs.msgsize, sizeof(u64));
+	rings_size = ALIGN(struct_size(state, rings, attrs.nr_prios),
+			L1_CACHE_BYTES);
+	nr_slots = attrs.nr_prios * attrs.capacity;
+	mq->heap = evl_get_state_heap(clone_flags);
+	state = evl_zalloc_chunk(mq->heap,
+				size_add(rings_size, size_mul(nr_slots, slot_size)));
+	if (state == NULL) {
+		ret = -ENOMEM;
+		goto fail_heap;
+	}
+
+	mq->state = state;
+	mq->slots = (void *)state + rings_size;
+	mq->msgsize = attrs.msgsize;
+	mq->capacity = attrs.capacity;
+	mq->nr_prios = attrs.nr_prios;
+	mq->slot_size = slot_size;
+
+	state->msgsize = attrs.msgsize;
+	state->capacity = attrs.capacity;
+	state->nr_prios = attrs.nr_prios;
+	state->slot_size = slot_size;
+	state->slots_offset = rings_size;
+
+	for (n = 0; n < nr_slots; n++) {
+		slot = mq->slots + n * slot_size;
+		slot->seq = n & (attrs.capacity - 1);
+	}
+
+	evl_init_wait(&mq->readers, clock, EVL_WAIT_PRIO);
+	evl_init_wait(&mq->writers, clock, EVL_WAIT_PRIO);
+	*state_offp = evl_state_offset(mq->heap, state);
+
+	return &mq->element;
+
+fail_heap:
+	evl_put_state_heap(mq->heap);
+	evl_destroy_element(&mq->element);
+fail_element:
+	kfree(mq);
+fail_alloc:
+	evl_put_clock(clock);
+
+	return ERR_PTR(ret);
+}
+
+static void mqueue_factory_dispose(struct evl_element *e)
+{
+	struct evl_mqueue *mq;
+
+	mq = container_of(e, struct evl_mqueue, element);
+
+	evl_put_clock(mq->readers.clock);
+	evl_destroy_wait(&mq->readers);
+	evl_destroy_wait(&mq->writers);
+	evl_free_chunk(mq->heap, mq->state);
+	evl_put_state_heap(mq->heap);
+	evl_destroy_element(&mq->element);
+	kfree_rcu(mq, element.rcu);
+}
+
+/*
+ * msgsize capacity nr_prios rd_waiters wr_waiters, then one line per
+ * priority level from the lowest: prio pending, as seen from the
+ * ring indices.
+ */
+static ssize_t state_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_mqueue_ring *ring;
+	struct evl_mqueue *mq;
+	ssize_t ret;
+	u32 prio;
+
+	mq = evl_get_element_by_dev(dev, struct evl_mqueue);
+	if (mq == NULL)
+		return -EIO;
+
+	ret = scnprintf(buf, PAGE_SIZE, "%u %u %u %u %u\n",
+			mq->msgsize, mq->capacity, mq->nr_prios,
+			atomic_read(__ATOMIC32(&mq->state->rd_waiters)),
+			atomic_read(__ATOMIC32(&mq->state->wr_waiters)));
+
+	for (prio = 0; prio < mq->nr_prios; prio++) {
+		ring = mq->state->rings + prio;
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "%u %u\n", prio,
+				READ_ONCE(ring->head) - READ_ONCE(ring->tail));
+	}
+
+	evl_put_element(&mq->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(state);
+
+static struct attribute *mqueue_attrs[] = {
+	&dev_attr_state.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(mqueue);
+
+struct evl_factory evl_mqueue_factory = {
+	.name	=	EVL_MQUEUE_DEV,
+	.fops	=	&mqueue_fops,
+	.build =	mqueue_factory_build,
+	.dispose =	mqueue_factory_dispose,
+	.nrdev	=	CONFIG_EVL_NR_MQUEUES,
+	.attrs	=	mqueue_groups,
+	.flags	=	EVL_FACTORY_CLONE,
+};
@@ -7,6 +7,7 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <evl/timer.h>
 #include <evl/thread.h>
 #include <evl/mutex.h>
@@ -21,7 +22,8 @@ void __evl_init_mutex(struct evl_mutex *mutex,
 		struct evl_clock *clock,
 		atomic_t *fastlock, u32 *ceiling,
 		const char *name,
-		struct lock_class_key *lock_key)
+		struct lock_class_key *lock_key,
+		struct evl_lockstat_class *lockstat)
 {
 	int type = ceiling ? EVL_MUTEX_PP : EVL_MUTEX_PI;
 
@@ -36,9 +38,20 @@ void __evl_init_mutex(struct evl_mutex *mutex,
 	mutex->wchan.requeue_wait = evl_requeue_mutex_wait;
 	mutex->wchan.name = name;
 	INIT_LIST_HEAD(&mutex->wchan.wait_list);
+	mutex->wchan.wait_index = RB_ROOT;
+	mutex->wchan.nr_waiters = 0;
 	raw_spin_lock_init(&mutex->wchan.lock);
 	lockdep_set_class_and_name(&mutex->wchan.lock, lock_key, name);
 	might_hard_lock(&mutex->wchan.lock);
+#ifdef CONFIG_EVL_LOCKSTAT
+	mutex->lockstat = lockstat;
+	mutex->lockstat_date = 0;
+	evl_register_lockstat(lockstat);
+#endif
+#ifdef CONFIG_EVL_MUTEX_SPIN
+	atomic_set(&mutex->spin_acquired, 0);
+	atomic_set(&mutex->slept, 0);
+#endif
 }
 EXPORT_SYMBOL_GPL(__evl_init_mutex);
 
@@ -186,6 +199,142 @@ fundle_t get_owner_handle(fundle_t ownerh, struct evl_mutex *mutex)
  * Fast path: try to give mutex to the current thread. We hold no lock
  * on entry, irqs are on.
  */
+#ifdef CONFIG_EVL_LOCKSTAT
+
+/*
+ * Hold times are only sampled for mutexes acquired from kernel
+ * space, since userland cannot release those via the fast path.
+ * mutex->wchan.lock held, irqs off.
+ */
+static inline void start_mutex_hold(struct evl_mutex *mutex)
+{
+	mutex->lockstat_date = evl_lockstat_date();
+}
+
+/* mutex->wchan.lock held, irqs off. */
+static inline void stop_mutex_hold(struct evl_mutex *mutex)
+{
+	if (mutex->lockstat_date) {
+		evl_lockstat_hold(mutex->lockstat, mutex->lockstat_date);
+		mutex->lockstat_date = 0;
+	}
+}
+
+static inline void account_mutex_wait(struct evl_mutex *mutex,
+				ktime_t start, unsigned long ip)
+{
+	if (start)
+		evl_lockstat_wait(mutex->lockstat, start, ip);
+}
+
+#else
+
+static inline void start_mutex_hold(struct evl_mutex *mutex)
+{ }
+
+static inline void stop_mutex_hold(struct evl_mutex *mutex)
+{ }
+
+static inline void account_mutex_wait(struct evl_mutex *mutex,
+				ktime_t start, unsigned long ip)
+{ }
+
+#endif
+
+#ifdef CONFIG_EVL_MUTEX_SPIN
+
+static uint mutex_spin_arg = 5000;
+module_param_named(mutex_spin, mutex_spin_arg, uint, 0444);
+
+/*
+ * Spin while the owner of @mutex designated by handle @h keeps
+ * running out-of-band on a remote CPU, betting that it will drop the
+ * lock sooner than we could go through a sleep/wakeup/switch
+ * cycle. Give up as soon as the owner is switched out, some work
+ * is pending for the local scheduler, or the spin budget is
+ * exhausted. Return true if the owner changed, i.e. the mutex is
+ * worth grabbing again.
+ */
+static bool spin_on_mutex_owner(struct evl_mutex *mutex, fundle_t h)
+{
+	struct evl_rq *this_rq = this_evl_rq(), *rq;
+	struct evl_thread *owner;
+	bool released = false;
+	ktime_t end;
+
+	if (!mutex_spin_arg)
+		return false;
+
+	owner = evl_get_factory_element_by_fundle(&evl_thread_factory,
+						evl_get_index(h),
+						struct evl_thread);
+	if (owner == NULL)
+		return false;
+
+	end = ktime_add_ns(evl_read_clock(&evl_mono_clock), mutex_spin_arg);
+
+	for (;;) {
+		if (evl_get_index(atomic_read(mutex->fastlock)) !=
+			evl_get_index(h)) {
+			released = true;
+			break;
+		}
+		rq = READ_ONCE(owner->rq);
+		if (rq == this_rq || READ_ONCE(rq->curr) != owner)
+			break;
+		if (evl_need_resched(this_rq))
+			break;
+		if (evl_read_clock(&evl_mono_clock) >= end)
+			break;
+		cpu_relax();
+	}
+
+	evl_put_element(&owner->element);
+
+	return released;
+}
+
+static inline void account_mutex_spin(struct evl_mutex *mutex)
+{
+	atomic_inc(&mutex->spin_acquired);
+}
+
+static inline void account_mutex_sleep(struct evl_mutex *mutex)
+{
+	atomic_inc(&mutex->slept);
+}
+
+void evl_get_mutex_stats(struct evl_mutex *mutex,
+			struct evl_mutex_stats *stats)
+{
+	stats->spin_acquired = atomic_read(&mutex->spin_acquired);
+	stats->slept = atomic_read(&mutex->slept);
+}
+
+#else
+
+static inline bool spin_on_mutex_owner(struct evl_mutex *mutex, fundle_t h)
+{
+	return false;
+}
+
+static inline void account_mutex_spin(struct evl_mutex *mutex)
+{ }
+
+static inline void account_mutex_sleep(struct evl_mutex *mutex)
+{ }
+
+void evl_get_mutex_stats(struct evl_mutex *mutex,
+			struct evl_mutex_stats *stats)
+{
+	stats->spin_acquired = 0;
+	stats->slept = 0;
+}
+
+#endif
+
+EXPORT_SYMBOL_GPL(evl_get_mutex_stats);
+
 static int fast_grab_mutex(struct evl_mutex *mutex, fundle_t *oldh)
 {
 	struct evl_thread *curr = evl_current();
@@ -213,6 +362,7 @@ static int fast_grab_mutex(struct evl_mutex *mutex, fundle_t *oldh)
 	 * to the current thread, applying any PP boost if applicable.
 	 */
 	set_mutex_owner(mutex);
+	start_mutex_hold(mutex);
 
 	disable_inband_switch(curr, mutex);
 
@@ -295,7 +445,7 @@ static void flush_mutex_locked(struct evl_mutex *mutex, int reason)
 	} else {
 		list_for_each_entry_safe(waiter, tmp,
 					&mutex->wchan.wait_list, wait_next) {
-			list_del_init(&waiter->wait_next);
+			evl_del_waiter(&mutex->wchan, waiter);
 			evl_wakeup_thread(waiter, EVL_T_PEND, reason);
 		}
 
@@ -402,8 +552,9 @@ int evl_lock_mutex_timeout(struct evl_mutex *mutex, ktime_t timeout,
 	struct evl_thread *curr = evl_current(), *owner;
 	atomic_t *lockp = mutex->fastlock;
 	fundle_t currh, h, oldh;
+	bool check_dep_only, spun = false, may_spin = true;
+	ktime_t wait_start = 0;
 	unsigned long flags;
-	bool check_dep_only;
 	int ret;
 
 	oob_context_only();
@@ -412,14 +563,34 @@ int evl_lock_mutex_timeout(struct evl_mutex *mutex, ktime_t timeout,
 	trace_evl_mutex_lock(mutex);
 retry:
 	ret = fast_grab_mutex(mutex, &h); /* This detects recursion. */
-	if (likely(ret != -EBUSY))
+	if (likely(ret != -EBUSY)) {
+		if (spun && !ret)
+			account_mutex_spin(mutex);
+		account_mutex_wait(mutex, wait_start, _RET_IP_);
 		return ret;
+	}
+
+	/*
+	 * Spin on the owner once before considering the slow path,
+	 * which we go to directly when retrying later on.
+	 */
+	spun = false;
+	if (may_spin) {
+		may_spin = false;
+		wait_start = evl_lockstat_date();
+		if (spin_on_mutex_owner(mutex, h)) {
+			spun = true;
+			goto retry;
+		}
+	}
 
 	/*
 	 * Well, no luck, mutex is locked and/or claimed already. This
 	 * is the start of the slow path.
 	 */
 	ret = 0;
+	if (!wait_start)
+		wait_start = evl_lockstat_date();
 
 	/*
 	 * As long as mutex->wchan.lock is held and FLCLAIM is set in
@@ -468,6 +639,7 @@ retry:
 	if (owner == NULL) {
 		untrack_mutex_owner(mutex);
 		raw_spin_unlock_irqrestore(&mutex->wchan.lock, flags);
+		account_mutex_wait(mutex, wait_start, _RET_IP_);
 		return -EOWNERDEAD;
 	}
 
@@ -543,7 +715,8 @@ retry:
 	}
 
 	raw_spin_unlock(&curr->lock);
-	list_add_priff(curr, &mutex->wchan.wait_list, wprio, wait_next);
+	evl_add_waiter(&mutex->wchan, curr);
+	account_mutex_sleep(mutex);
 	evl_sleep_on(timeout, timeout_mode, mutex->clock, &mutex->wchan);
 	raw_spin_unlock_irqrestore(&mutex->wchan.lock, flags);
 	ret = __evl_wait_schedule(&mutex->wchan);
@@ -570,6 +743,7 @@ fail:
 	 */
 	undo_pi_walk(mutex);
 	hard_local_irq_enable();
+	account_mutex_wait(mutex, wait_start, _RET_IP_);
 	evl_schedule();
 
 	return ret;
@@ -585,8 +759,9 @@ static void wakeup_and_release(struct evl_mutex *mutex)
 	 * Allow the top waiter in line to retry acquiring the mutex.
 	 */
 	if (!list_empty(&mutex->wchan.wait_list)) {
-		top_waiter = list_get_entry_init(&mutex->wchan.wait_list,
-						struct evl_thread, wait_next);
+		top_waiter = list_first_entry(&mutex->wchan.wait_list,
+					struct evl_thread, wait_next);
+		evl_del_waiter(&mutex->wchan, top_waiter);
 		evl_wakeup_thread(top_waiter, EVL_T_PEND, 0);
 	}
 
@@ -625,6 +800,7 @@ void __evl_unlock_mutex(struct evl_mutex *mutex)
 	if (EVL_WARN_ON(CORE, mutex->wchan.owner != curr))
 		goto out;
 
+	stop_mutex_hold(mutex);
 	enable_inband_switch(curr, mutex);
 
 	/*
@@ -752,8 +928,8 @@ bool evl_requeue_mutex_wait(struct evl_wait_channel *wchan,
 	 * ownership. Make sure we still have an owner.
 	 */
 	if (owner == NULL) {
-		list_del(&waiter->wait_next);
-		list_add_priff(waiter, &wchan->wait_list, wprio, wait_next);
+		evl_del_waiter(wchan, waiter);
+		evl_add_waiter(wchan, waiter);
 		return false;
 	}
 
@@ -769,8 +945,8 @@ bool evl_requeue_mutex_wait(struct evl_wait_channel *wchan,
 	 * Reorder the wait list according to the (updated) priority
 	 * of the waiter, then requeue the booster accordingly.
 	 */
-	list_del(&waiter->wait_next);
-	list_add_priff(waiter, &wchan->wait_list, wprio, wait_next);
+	evl_del_waiter(wchan, waiter);
+	evl_add_waiter(wchan, waiter);
 	if (mutex->flags & EVL_MUTEX_PIBOOST) {
 		top_waiter = list_first_entry(&mutex->wchan.wait_list,
 					struct evl_thread, wait_next);
@@ -778,7 +954,17 @@ bool evl_requeue_mutex_wait(struct evl_wait_channel *wchan,
 			/* Requeue booster at the right place. */
 			list_del(&mutex->next_booster);
 			enqueue_booster(mutex, top_waiter);
+		} else {
+			/*
+			 * The boost value is unchanged, so is the
+			 * effective priority of the owner: there is
+			 * nothing to propagate down the lock chain.
+			 */
+			ret = false;
 		}
+	} else {
+		/* No boost from this mutex, same as above. */
+		ret = false;
 	}
 
 	raw_spin_unlock(&owner->lock);
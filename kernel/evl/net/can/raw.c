@@ -0,0 +1,737 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/if_arp.h>
+#include <linux/can.h>
+#include <linux/can/core.h>
+#include <linux/can/skb.h>
+#include <linux/poll.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/overflow.h>
+#include <net/sock.h>
+#include <evl/lock.h>
+#include <evl/thread.h>
+#include <evl/wait.h>
+#include <evl/poll.h>
+#include <evl/sched.h>
+#include <evl/uio.h>
+#include <evl/clock.h>
+#include <evl/net/socket.h>
+#include <evl/net/can.h>
+#include <evl/net/input.h>
+#include <evl/net/output.h>
+#include <evl/net/device.h>
+#include <evl/net/skb.h>
+#include <evl/uaccess.h>
+#include <uapi/evl/net/can-abi.h>
+
+/*
+ * Raw CAN interface. Frames are linear skbs conveying a single
+ * struct can_frame or struct canfd_frame, CAN XL is left to the
+ * in-band stack.
+ */
+
+struct evl_can_filterset {
+	int count;
+	struct can_filter filters[];
+};
+
+/*
+ * Bound sockets, linked through esk->u.can.next. can_lock protects
+ * this list and the filters of every socket on it, it is shared
+ * between in-band and oob contexts, never accessed from oob IRQ
+ * handlers. Like for raw packet sockets, a linear scan is deemed
+ * good enough for the handful of sockets a fieldbus application
+ * would open.
+ */
+static LIST_HEAD(can_sockets);
+
+static DEFINE_EVL_SPINLOCK(can_lock);
+
+static struct evl_can_filterset *alloc_filterset(int count)
+{
+	struct evl_can_filterset *fset;
+
+	fset = kzalloc(struct_size(fset, filters, count), GFP_KERNEL);
+	if (fset)
+		fset->count = count;
+
+	return fset;
+}
+
+static bool match_can_filters(struct evl_can_filterset *fset,
+			canid_t can_id)
+{
+	struct can_filter *f;
+	canid_t mask;
+	bool match;
+	int n;
+
+	for (n = 0; n < fset->count; n++) {
+		f = &fset->filters[n];
+		mask = f->can_mask & ~CAN_ERR_FLAG;
+		match = (can_id & mask) == (f->can_id & ~CAN_INV_FILTER & mask);
+		if (f->can_id & CAN_INV_FILTER)
+			match = !match;
+		if (match)
+			return true;
+	}
+
+	return false;
+}
+
+/* can_lock held */
+static bool can_socket_accepts(struct evl_socket *esk,
+			struct sk_buff *skb, canid_t can_id)
+{
+	int ifindex = esk->u.can.ifindex;
+
+	if (ifindex && ifindex != skb->dev->ifindex)
+		return false;
+
+	return match_can_filters(esk->u.can.filters, can_id);
+}
+
+static inline canid_t get_can_id(struct sk_buff *skb)
+{
+	/* Same layout for classic and FD frames. */
+	return ((struct canfd_frame *)skb->data)->can_id;
+}
+
+/* oob, hard irqs off, can_lock held */
+static void queue_can_frame(struct evl_socket *esk, struct sk_buff *skb)
+{
+	raw_spin_lock(&esk->input_wait.wchan.lock);
+
+	list_add_tail(&skb->list, &esk->input);
+	if (evl_wait_active(&esk->input_wait))
+		evl_wake_up_head(&esk->input_wait);
+
+	raw_spin_unlock(&esk->input_wait.wchan.lock);
+
+	evl_signal_poll_events(&esk->poll_head,	POLLIN|POLLRDNORM);
+}
+
+/*
+ * oob, from the RX thread, hard irqs on. Every matching socket
+ * receives a clone of @skb, which is dropped eventually.
+ */
+static void net_can_ingress(struct sk_buff *skb)
+{
+	canid_t can_id = get_can_id(skb);
+	bool delivered = false;
+	struct evl_socket *esk;
+	struct sk_buff *qskb;
+	unsigned long flags;
+
+	evl_spin_lock_irqsave(&can_lock, flags);
+
+	list_for_each_entry(esk, &can_sockets, u.can.next) {
+		if (!can_socket_accepts(esk, skb, can_id))
+			continue;
+
+		qskb = evl_net_clone_skb(skb);
+		if (qskb == NULL) {
+			evl_net_inc_sock_stat(esk, rx_drops);
+			break;
+		}
+
+		if (!evl_net_charge_skb_rmem(esk, qskb)) {
+			evl_net_free_skb(qskb);
+			continue;
+		}
+
+		queue_can_frame(esk, qskb);
+		delivered = true;
+	}
+
+	evl_spin_unlock_irqrestore(&can_lock, flags);
+
+	if (!delivered)
+		evl_net_inc_port_stat(skb->dev->oob_state.estate, rx_unclaimed);
+
+	evl_net_free_skb(skb);
+}
+
+static struct evl_net_handler evl_net_can_handler = {
+	.ingress = net_can_ingress,
+};
+
+/**
+ *	evl_net_can_accept - pick a CAN frame for the out-of-band
+ *	stack.
+ *
+ *	Accept an incoming CAN frame if it matches the filters of at
+ *	least one oob CAN socket bound to the input device. Error
+ *	frames and CAN XL frames are left to the in-band stack.
+ *
+ *	@skb the frame to inspect. May be linked to some upstream
+ *	queue.
+ *
+ *	Returns true if the oob stack took @skb over.
+ */
+bool evl_net_can_accept(struct sk_buff *skb) /* oob or in-band */
+{
+	bool accept = false;
+	struct evl_socket *esk;
+	unsigned long flags;
+	canid_t can_id;
+
+	if (list_empty(&can_sockets))
+		return false;
+
+	if (!can_is_can_skb(skb) && !can_is_canfd_skb(skb))
+		return false;
+
+	can_id = get_can_id(skb);
+	if (can_id & CAN_ERR_FLAG)
+		return false;
+
+	evl_spin_lock_irqsave(&can_lock, flags);
+
+	list_for_each_entry(esk, &can_sockets, u.can.next) {
+		if (can_socket_accepts(esk, skb, can_id)) {
+			accept = true;
+			break;
+		}
+	}
+
+	evl_spin_unlock_irqrestore(&can_lock, flags);
+
+	if (!accept)
+		return false;
+
+	/* evl_net_receive() stamps the frame in software. */
+	evl_net_receive(skb, &evl_net_can_handler);
+
+	return true;
+}
+
+/* in-band. */
+static int attach_can_socket(struct evl_socket *esk,
+			struct evl_net_proto *proto, int protocol)
+{
+	struct evl_can_filterset *fset;
+
+	/* Accept all frames by default, like in-band raw sockets. */
+	fset = alloc_filterset(1);
+	if (fset == NULL)
+		return -ENOMEM;
+
+	esk->proto = proto;
+	esk->protocol = CAN_RAW;
+	esk->u.can.ifindex = 0;
+	esk->u.can.filters = fset;
+	INIT_LIST_HEAD(&esk->u.can.next);
+
+	return 0;
+}
+
+/* in-band, stop receiving. */
+static void release_can_socket(struct evl_socket *esk)
+{
+	unsigned long flags;
+
+	evl_spin_lock_irqsave(&can_lock, flags);
+	list_del_init(&esk->u.can.next);
+	evl_spin_unlock_irqrestore(&can_lock, flags);
+}
+
+/* in-band, __sk_destruct() */
+static void destroy_can_socket(struct evl_socket *esk)
+{
+	release_can_socket(esk);
+	kfree(esk->u.can.filters);
+}
+
+/* in-band */
+static int bind_can_socket(struct evl_socket *esk,
+			struct sockaddr *addr,
+			int len)
+{
+	struct sockaddr_can *addr_can;
+	struct net_device *dev;
+	unsigned long flags;
+	int ifindex;
+
+	if (len < CAN_REQUIRED_SIZE(struct sockaddr_can, can_ifindex))
+		return -EINVAL;
+
+	addr_can = (struct sockaddr_can *)addr;
+	if (addr_can->can_family != AF_CAN)
+		return -EINVAL;
+
+	/*
+	 * The in-band stack validated the interface already, recheck
+	 * since it might have gone in the meantime.
+	 */
+	ifindex = addr_can->can_ifindex;
+	if (ifindex) {
+		dev = dev_get_by_index(esk->net, ifindex);
+		if (dev == NULL)
+			return -ENODEV;
+		if (dev->type != ARPHRD_CAN) {
+			dev_put(dev);
+			return -ENODEV;
+		}
+		dev_put(dev);
+	}
+
+	mutex_lock(&esk->lock);
+
+	evl_spin_lock_irqsave(&can_lock, flags);
+	esk->u.can.ifindex = ifindex;
+	if (list_empty(&esk->u.can.next))
+		list_add_tail(&esk->u.can.next, &can_sockets);
+	evl_spin_unlock_irqrestore(&can_lock, flags);
+
+	mutex_unlock(&esk->lock);
+
+	return 0;
+}
+
+/* in-band */
+static struct net_device *get_netif_can(struct evl_socket *esk)
+{
+	return evl_net_get_dev_by_index(esk->net,
+					READ_ONCE(esk->u.can.ifindex));
+}
+
+/* oob */
+static struct net_device *find_xmit_device(struct evl_socket *esk,
+			const struct user_oob_msghdr __user *u_msghdr)
+{
+	struct sockaddr_can __user *u_addr;
+	__u64 name_ptr = 0, namelen = 0;
+	struct sockaddr_can addr;
+	struct net_device *dev;
+	int ret;
+
+	if (u_msghdr) {
+		ret = raw_get_user(name_ptr, &u_msghdr->name_ptr);
+		if (ret)
+			return ERR_PTR(-EFAULT);
+
+		ret = raw_get_user(namelen, &u_msghdr->namelen);
+		if (ret)
+			return ERR_PTR(-EFAULT);
+	}
+
+	if (!name_ptr) {
+		if (namelen)
+			return ERR_PTR(-EINVAL);
+
+		dev = evl_net_get_dev_by_index(esk->net,
+					READ_ONCE(esk->u.can.ifindex));
+	} else {
+		if (namelen < CAN_REQUIRED_SIZE(struct sockaddr_can, can_ifindex))
+			return ERR_PTR(-EINVAL);
+
+		u_addr = evl_valptr64(name_ptr, struct sockaddr_can);
+		ret = raw_copy_from_user(&addr, u_addr,
+				CAN_REQUIRED_SIZE(struct sockaddr_can, can_ifindex));
+		if (ret)
+			return ERR_PTR(-EFAULT);
+
+		if (addr.can_family != AF_CAN)
+			return ERR_PTR(-EINVAL);
+
+		dev = evl_net_get_dev_by_index(esk->net, addr.can_ifindex);
+	}
+
+	if (dev == NULL)
+		return ERR_PTR(-ENXIO);
+
+	if (dev->type != ARPHRD_CAN) {
+		evl_net_put_dev(dev);
+		return ERR_PTR(-ENXIO);
+	}
+
+	return dev;
+}
+
+/* oob */
+static struct sk_buff *alloc_can_xmit_skb(struct evl_socket *esk,
+				const struct user_oob_msghdr __user *u_msghdr,
+				struct net_device *dev,
+				ktime_t timeout, enum evl_tmode tmode)
+{
+	struct sk_buff *skb;
+	int ret;
+
+	skb = evl_net_dev_alloc_skb(dev, timeout, tmode);
+	if (IS_ERR(skb))
+		return skb;
+
+	/*
+	 * CAN drivers expect the CAN private area in the headroom,
+	 * see can_skb_prv(). Frames sent oob are not echoed.
+	 */
+	can_skb_reserve(skb);
+	can_skb_prv(skb)->ifindex = dev->ifindex;
+	can_skb_prv(skb)->skbcnt = 0;
+	can_skb_prv(skb)->frame_len = 0;
+	skb->ip_summed = CHECKSUM_UNNECESSARY;
+	skb->pkt_type = PACKET_HOST;
+	skb_reset_mac_header(skb);
+	skb_reset_network_header(skb);
+	skb_reset_transport_header(skb);
+	skb->dev = dev;
+	skb->priority = READ_ONCE(esk->sk->sk_priority);
+
+	ret = evl_net_prepare_tx(esk, u_msghdr, skb);
+	if (ret) {
+		evl_net_free_skb(skb);
+		return ERR_PTR(ret);
+	}
+
+	return skb;
+}
+
+/*
+ * oob. Send the @count bytes of frame data already copied to
+ * @skb. The caller still owns @skb on error.
+ */
+static int xmit_can_frame(struct evl_socket *esk,
+			struct net_device *dev, struct sk_buff *skb,
+			size_t count, ktime_t timeout, enum evl_tmode tmode)
+{
+	struct canfd_frame *cfd = (struct canfd_frame *)skb->data;
+	int ret;
+
+	switch (count) {
+	case CAN_MTU:
+		skb->protocol = htons(ETH_P_CAN);
+		break;
+	case CANFD_MTU:
+		if (READ_ONCE(dev->mtu) != CANFD_MTU)
+			return -EINVAL;
+		skb->protocol = htons(ETH_P_CANFD);
+		cfd->flags |= CANFD_FDF;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	skb_put(skb, count);
+
+	if (!can_is_can_skb(skb) && !can_is_canfd_skb(skb))
+		return -EINVAL;
+
+	ret = evl_net_charge_skb_wmem(esk, skb, timeout, tmode);
+	if (ret)
+		return ret;
+
+	ret = evl_net_transmit(skb);
+	if (ret)
+		evl_net_uncharge_skb_wmem(skb);
+
+	return ret;
+}
+
+/* oob */
+static ssize_t send_can(struct evl_socket *esk,
+			const struct user_oob_msghdr __user *u_msghdr,
+			struct iovec *iov,
+			size_t iovlen)
+{
+	struct __evl_timespec uts;
+	struct net_device *dev;
+	enum evl_tmode tmode;
+	struct sk_buff *skb;
+	__u32 msg_flags = 0;
+	ssize_t ret, count;
+	ktime_t timeout;
+	size_t rem;
+
+	if (u_msghdr) {
+		ret = raw_get_user(msg_flags, &u_msghdr->flags);
+		if (ret)
+			return -EFAULT;
+
+		if (msg_flags & ~MSG_DONTWAIT)
+			return -EINVAL;
+
+		/* Fetch the timeout on obtaining a buffer from the TX pool. */
+		ret = raw_copy_from_user(&uts, &u_msghdr->timeout, sizeof(uts));
+		if (ret)
+			return -EFAULT;
+
+		timeout = u_timespec_to_ktime(uts);
+	} else {
+		timeout = EVL_INFINITE;
+	}
+
+	if (evl_socket_f_flags(esk) & O_NONBLOCK)
+		msg_flags |= MSG_DONTWAIT;
+
+	if (msg_flags & MSG_DONTWAIT)
+		timeout = EVL_NONBLOCK;
+
+	tmode = timeout ? EVL_ABS : EVL_REL;
+
+	dev = find_xmit_device(esk, u_msghdr);
+	if (IS_ERR(dev))
+		return PTR_ERR(dev);
+
+	skb = alloc_can_xmit_skb(esk, u_msghdr, dev, timeout, tmode);
+	if (IS_ERR(skb)) {
+		ret = PTR_ERR(skb);
+		goto out;
+	}
+
+	count = evl_copy_from_uio(iov, iovlen, skb->data, skb_tailroom(skb), &rem);
+	if (rem)
+		ret = -EMSGSIZE;
+	else
+		ret = xmit_can_frame(esk, dev, skb, count, timeout, tmode);
+
+	if (ret)
+		goto cleanup;
+
+	ret = count;
+out:
+	evl_net_put_dev(dev);
+
+	return ret;
+cleanup:
+	evl_net_free_skb(skb);
+	goto out;
+}
+
+static ssize_t copy_can_frame_to_user(struct user_oob_msghdr __user *u_msghdr,
+				const struct iovec *iov,
+				size_t iovlen,
+				struct sk_buff *skb)
+{
+	struct skb_shared_hwtstamps *hwts = skb_hwtstamps(skb);
+	struct sockaddr_can addr, __user *u_addr;
+	struct __evl_timespec uts;
+	__u64 name_ptr, namelen;
+	__u32 msg_flags = 0;
+	ssize_t ret, count;
+
+	count = evl_copy_to_uio(iov, iovlen, skb->data, skb->len);
+
+	if (u_msghdr == NULL)
+		return count;
+
+	ret = raw_get_user(name_ptr, &u_msghdr->name_ptr);
+	if (ret)
+		return -EFAULT;
+
+	ret = raw_get_user(namelen, &u_msghdr->namelen);
+	if (ret)
+		return -EFAULT;
+
+	if (name_ptr) {
+		if (namelen != sizeof(addr)) {
+			if (namelen < sizeof(addr))
+				return -EINVAL;
+			ret = raw_put_user(sizeof(addr), &u_msghdr->namelen);
+			if (ret)
+				return -EFAULT;
+		}
+		memset(&addr, 0, sizeof(addr));
+		addr.can_family = AF_CAN;
+		addr.can_ifindex = skb->dev->ifindex;
+		u_addr = evl_valptr64(name_ptr, struct sockaddr_can);
+		ret = raw_copy_to_user(u_addr, &addr, sizeof(addr));
+		if (ret)
+			return -EFAULT;
+	} else {
+		if (namelen)
+			return -EINVAL;
+	}
+
+	uts = ktime_to_u_timespec(hwts->hwtstamp ?: skb->tstamp);
+	ret = raw_copy_to_user(&u_msghdr->timestamp, &uts, sizeof(uts));
+	if (ret)
+		return -EFAULT;
+
+	if (count < skb->len)
+		msg_flags |= MSG_TRUNC;
+
+	ret = raw_put_user(msg_flags, &u_msghdr->flags);
+	if (ret)
+		return -EFAULT;
+
+	return count;
+}
+
+/* oob */
+static ssize_t receive_can(struct evl_socket *esk,
+			struct user_oob_msghdr __user *u_msghdr,
+			struct iovec *iov,
+			size_t iovlen)
+{
+	ktime_t timeout, busy_deadline;
+	struct __evl_timespec uts;
+	enum evl_tmode tmode;
+	struct sk_buff *skb;
+	unsigned long flags;
+	__u32 msg_flags = 0;
+	ssize_t ret;
+
+	if (u_msghdr) {
+		ret = raw_get_user(msg_flags, &u_msghdr->flags);
+		if (ret)
+			return -EFAULT;
+
+		if (msg_flags & ~MSG_DONTWAIT)
+			return -EINVAL;
+
+		ret = raw_copy_from_user(&uts, &u_msghdr->timeout,
+					sizeof(uts));
+		if (ret)
+			return -EFAULT;
+
+		timeout = u_timespec_to_ktime(uts);
+		tmode = timeout ? EVL_ABS : EVL_REL;
+	} else {
+		timeout = EVL_INFINITE;
+		tmode = EVL_REL;
+	}
+
+	if (evl_socket_f_flags(esk) & O_NONBLOCK)
+		msg_flags |= MSG_DONTWAIT;
+
+	busy_deadline = evl_net_busy_poll_deadline(esk);
+
+	do {
+		raw_spin_lock_irqsave(&esk->input_wait.wchan.lock, flags);
+
+		if (!list_empty(&esk->input)) {
+			skb = list_get_entry(&esk->input, struct sk_buff, list);
+			raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+			evl_net_note_rx(esk, skb);
+			ret = copy_can_frame_to_user(u_msghdr, iov, iovlen, skb);
+			evl_net_uncharge_skb_rmem(skb);
+			evl_net_free_skb(skb);
+			return ret;
+		}
+
+		if (msg_flags & MSG_DONTWAIT) {
+			raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+			return -EWOULDBLOCK;
+		}
+
+		if (busy_deadline) {
+			raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+			busy_deadline = evl_net_busy_poll(esk, busy_deadline);
+			ret = 0;
+			continue;
+		}
+
+		evl_add_wait_queue(&esk->input_wait, timeout, tmode);
+		raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+		ret = evl_wait_schedule(&esk->input_wait);
+	} while (!ret);
+
+	return ret;
+}
+
+/* oob */
+static __poll_t poll_can(struct evl_socket *esk,
+			struct oob_poll_wait *wait)
+{
+	struct evl_netdev_state *est;
+	struct net_device *dev;
+	__poll_t ret = 0;
+
+	evl_poll_watch(&esk->poll_head, wait, NULL);
+	if (!list_empty(&esk->input))
+		ret = POLLIN|POLLRDNORM;
+
+	dev = evl_net_get_dev_by_index(esk->net,
+				READ_ONCE(esk->u.can.ifindex));
+	if (dev) {
+		est = dev->oob_state.estate;
+		evl_poll_watch(&est->poll_head, wait, NULL);
+		ret |= POLLOUT|POLLWRNORM;
+		evl_net_put_dev(dev);
+	}
+
+	return ret;
+}
+
+/* in-band */
+static int set_can_filters(struct evl_socket *esk,
+			struct evl_can_filters __user *u_req)
+{
+	struct evl_can_filterset *fset, *old;
+	struct evl_can_filters req;
+	struct can_filter __user *u_filters;
+	unsigned long flags;
+
+	if (copy_from_user(&req, u_req, sizeof(req)))
+		return -EFAULT;
+
+	if (req.count > EVL_CAN_MAX_FILTERS)
+		return -EINVAL;
+
+	fset = alloc_filterset(req.count);
+	if (fset == NULL)
+		return -ENOMEM;
+
+	u_filters = evl_valptr64(req.filters_ptr, struct can_filter);
+	if (copy_from_user(fset->filters, u_filters,
+				req.count * sizeof(struct can_filter))) {
+		kfree(fset);
+		return -EFAULT;
+	}
+
+	/* Readers only look at the filters with can_lock held. */
+	evl_spin_lock_irqsave(&can_lock, flags);
+	old = esk->u.can.filters;
+	esk->u.can.filters = fset;
+	evl_spin_unlock_irqrestore(&can_lock, flags);
+
+	kfree(old);
+
+	return 0;
+}
+
+/* in-band */
+static int ioctl_can(struct evl_socket *esk, unsigned int cmd,
+		unsigned long arg)
+{
+	switch (cmd) {
+	case EVL_CAN_IOC_SETFILTER:
+		return set_can_filters(esk, (struct evl_can_filters __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static struct evl_net_proto can_raw_proto = {
+	.attach	= attach_can_socket,
+	.release = release_can_socket,
+	.destroy = destroy_can_socket,
+	.bind = bind_can_socket,
+	.ioctl = ioctl_can,
+	.oob_send = send_can,
+	.oob_poll = poll_can,
+	.oob_receive = receive_can,
+	.get_netif = get_netif_can,
+};
+
+static struct evl_net_proto *match_can_domain(int type, int protocol)
+{
+	if (protocol != CAN_RAW)
+		return NULL;
+
+	if (type != SOCK_RAW)
+		return ERR_PTR(-ESOCKTNOSUPPORT);
+
+	return &can_raw_proto;
+}
+
+struct evl_socket_domain evl_net_can = {
+	.af_domain = AF_CAN,
+	.match = match_can_domain,
+};
@@ -15,6 +15,9 @@
 #include <linux/filter.h>
 #include <linux/anon_inodes.h>
 #include <linux/file.h>
+#include <linux/net.h>
+#include <linux/moduleparam.h>
+#include <net/sock.h>
 #include <evl/uaccess.h>
 #include <evl/sched.h>
 #include <evl/thread.h>
@@ -27,12 +30,18 @@
 #include <evl/net/input.h>
 #include <evl/net/output.h>
 #include <evl/net/route.h>
+#include <evl/net/packet.h>
+#include <evl/net/ipv4/arp.h>
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "evl."
 
 /*
  * Since we need an EVL kthread to handle traffic from the out-of-band
  * stage without borrowing CPU time unwisely from random contexts,
- * let's have separate, per-device threads for RX and TX. This gives
- * the best flexibility for leveraging multi-core capabilities on
+ * let's have separate, per-device threads for RX and TX, with one RX
+ * thread per lane on multi-queue devices. This gives the best
+ * flexibility for leveraging multi-core capabilities on
  * high-bandwidth systems. Kthread priority defaults to 1, chrt is our
  * friend for fine-grained tuning. Unlike the RX kthread which is
  * always created for a device underlying an oob port, the TX one is
@@ -42,6 +51,13 @@
 #define KTHREAD_RX_PRIO  1
 #define KTHREAD_TX_PRIO  1
 
+/*
+ * Max. number of RX lanes per device. A device gets one lane per
+ * hardware RX queue, up to the number of oob CPUs and this limit,
+ * the RX threads are spread over the oob CPUs round-robin.
+ */
+#define EVL_NETDEV_MAX_RX_LANES  16
+
 /*
  * The default number of I/O pages which should be available on a
  * per-device basis for conveying out-of-band traffic if not specified
@@ -60,6 +76,15 @@
 #define EVL_MAX_NETDEV_POOLSZ  32768
 #define EVL_MAX_NETDEV_BUFSZ   (PAGE_SIZE * 4)
 
+/*
+ * Device pools may grow up to netdev_pool_growth times the size
+ * requested at activation under pressure, and shrink back down to
+ * it when idle, never beyond EVL_MAX_NETDEV_POOLSZ. The default
+ * factor of 1 keeps pools at a fixed size.
+ */
+static uint netdev_pool_growth_arg = 1;
+module_param_named(netdev_pool_growth, netdev_pool_growth_arg, uint, 0444);
+
 /*
  * The list of network interfaces (real and virtual devices) which are
  * usable for sending/receiving oob traffic.
@@ -72,9 +97,16 @@ static struct evl_net_ebpf_filter *
 __set_rx_filter(struct evl_netdev_state *est,
 		struct evl_net_ebpf_filter *filter);
 
+static struct evl_net_ebpf_filter *
+__set_tx_filter(struct evl_netdev_state *est,
+		struct evl_net_ebpf_filter *filter);
+
+static void clear_rx_sockets(struct evl_netdev_state *est);
+
 static struct evl_kthread *
 start_handler_thread(struct net_device *dev,
-		void (*fn)(void *arg),
+		void (*fn)(void *arg), void *arg,
+		const struct cpumask *affinity,
 		int prio, const char *type)
 {
 	struct evl_kthread *kt;
@@ -84,7 +116,7 @@ start_handler_thread(struct net_device *dev,
 	if (kt == NULL)
 		return ERR_PTR(-ENOMEM);
 
-	ret = evl_run_kthread(kt, fn, dev, prio, 0, "%s.%s",
+	ret = _evl_run_kthread(kt, affinity, fn, arg, prio, 0, "%s.%s",
 			netdev_name(dev), type);
 	if (ret) {
 		kfree(kt);
@@ -94,6 +126,76 @@ start_handler_thread(struct net_device *dev,
 	return kt;
 }
 
+static void stop_rx_lanes(struct evl_netdev_state *est, unsigned int count)
+{
+	struct evl_netdev_rx_lane *lane;
+
+	while (count-- > 0) {
+		lane = est->rx_lanes + count;
+		evl_stop_kthread(lane->handler);
+		evl_destroy_flag(&lane->flag);
+	}
+
+	kfree(est->rx_lanes);
+	est->rx_lanes = NULL;
+}
+
+static int start_rx_lanes(struct net_device *dev,
+			struct evl_netdev_state *est)
+{
+	unsigned int nr_cpus, nr, n, band;
+	struct evl_netdev_rx_lane *lane;
+	struct evl_kthread *kt;
+	char type[16];
+	int cpu;
+
+	nr_cpus = cpumask_weight(&evl_oob_cpus);
+	nr = min3(dev->real_num_rx_queues, nr_cpus,
+		(unsigned int)EVL_NETDEV_MAX_RX_LANES);
+	nr = max(nr, 1U);
+
+	est->rx_lanes = kcalloc(nr, sizeof(*lane), GFP_KERNEL);
+	if (est->rx_lanes == NULL)
+		return -ENOMEM;
+
+	for (n = 0; n < nr; n++) {
+		lane = est->rx_lanes + n;
+		lane->dev = dev;
+		lane->index = n;
+		for (band = 0; band < EVL_NET_RX_BANDS; band++)
+			evl_net_init_skb_queue(&lane->packets[band]);
+		INIT_LIST_HEAD(&lane->poll);
+		raw_spin_lock_init(&lane->lock);
+		evl_init_flag(&lane->flag);
+		/* Keep the original naming for single-lane devices. */
+		if (nr > 1) {
+			snprintf(type, sizeof(type), "rx%u", n);
+			cpu = cpumask_nth(n % nr_cpus, &evl_oob_cpus);
+			lane->cpu = cpu;
+			kt = start_handler_thread(dev, evl_net_do_rx, lane,
+						cpumask_of(cpu),
+						KTHREAD_RX_PRIO, type);
+		} else {
+			lane->cpu = -1;
+			kt = start_handler_thread(dev, evl_net_do_rx, lane,
+						&evl_oob_cpus,
+						KTHREAD_RX_PRIO, "rx");
+		}
+		if (IS_ERR(kt)) {
+			evl_destroy_flag(&lane->flag);
+			stop_rx_lanes(est, n);
+			return PTR_ERR(kt);
+		}
+		lane->handler = kt;
+	}
+
+	/* Lanes must be valid before the count is. */
+	smp_wmb();
+	est->nr_rx_lanes = nr;
+
+	return 0;
+}
+
 /*
  * enable_oob_port - @dev is a device which we want to enable as a
  * port for channeling out-of-band traffic. This may be a real device,
@@ -104,6 +206,7 @@ static int enable_oob_port(struct net_device *dev,
 {
 	struct oob_netdev_state *rnds, *nds;
 	struct evl_netdev_state *pest, *est;
+	struct evl_net_qdisc *qdisc;
 	struct net_device *real_dev;
 	struct evl_kthread *kt;
 	unsigned long flags;
@@ -130,6 +233,11 @@ static int enable_oob_port(struct net_device *dev,
 		est = kzalloc(sizeof(*est), GFP_KERNEL);
 		if (est == NULL)
 			return -ENOMEM;
+		est->stats = alloc_percpu(struct evl_netdev_stats);
+		if (est->stats == NULL) {
+			kfree(est);
+			return -ENOMEM;
+		}
 		rnds->estate = est;
 	}
 
@@ -151,30 +259,28 @@ static int enable_oob_port(struct net_device *dev,
 		act->bufsz = mtu;
 
 	est->pool_max = act->poolsz;
+	est->pool_min = act->poolsz;
+	est->pool_limit = min_t(size_t,
+				act->poolsz * max(netdev_pool_growth_arg, 1U),
+				EVL_MAX_NETDEV_POOLSZ);
 	est->buf_size = act->bufsz;
 	spin_lock_init(&est->filter_lock);
-	est->qdisc = evl_net_alloc_qdisc(&evl_net_qdisc_fifo);
-	if (IS_ERR(est->qdisc)) {
-		ret = PTR_ERR(est->qdisc);
+	qdisc = evl_net_alloc_qdisc(&evl_net_qdisc_fifo, real_dev, NULL, 0);
+	if (IS_ERR(qdisc)) {
+		ret = PTR_ERR(qdisc);
 		goto fail_alloc_qdisc;
 	}
 
+	RCU_INIT_POINTER(est->qdisc, qdisc);
+
 	ret = evl_net_dev_build_pool(real_dev);
 	if (ret)
 		goto fail_build_pool;
 
-	evl_net_init_skb_queue(&est->rx_packets);
-	INIT_LIST_HEAD(&est->rx_poll);
-	raw_spin_lock_init(&est->rx_lock);
-	evl_init_flag(&est->rx_flag);
-
-	kt = start_handler_thread(real_dev, evl_net_do_rx,
-				KTHREAD_RX_PRIO, "rx");
-	if (IS_ERR(kt))
+	ret = start_rx_lanes(real_dev, est);
+	if (ret)
 		goto fail_start_rx;
 
-	est->rx_handler = kt;
-
 	/*
 	 * We need a TX handler only for oob-capable
 	 * devices. Otherwise, the traffic would go through an in-band
@@ -182,10 +288,12 @@ static int enable_oob_port(struct net_device *dev,
 	 */
 	if (netdev_is_oob_capable(real_dev)) {
 		evl_init_flag(&est->tx_flag);
-		kt = start_handler_thread(real_dev, evl_net_do_tx,
-					KTHREAD_TX_PRIO, "tx");
-		if (IS_ERR(kt))
+		kt = start_handler_thread(real_dev, evl_net_do_tx, real_dev,
+					&evl_oob_cpus, KTHREAD_TX_PRIO, "tx");
+		if (IS_ERR(kt)) {
+			ret = PTR_ERR(kt);
 			goto fail_start_tx;
+		}
 
 		est->tx_handler = kt;
 	}
@@ -210,16 +318,16 @@ fail_start_tx:
 	 * we cannot have any rxq in the cache or dump lists.
 	 */
 	if (netdev_is_oob_capable(real_dev)) {
-		evl_stop_kthread(est->rx_handler);
+		stop_rx_lanes(est, est->nr_rx_lanes);
 		evl_destroy_flag(&est->tx_flag);
 	}
 fail_start_rx:
 	evl_net_dev_purge_pool(real_dev);
-	evl_destroy_flag(&est->rx_flag);
 fail_build_pool:
-	evl_net_free_qdisc(est->qdisc);
+	evl_net_free_qdisc(qdisc);
 fail_alloc_qdisc:
 	if (!pest) {
+		free_percpu(est->stats);
 		kfree(est);
 		rnds->estate = NULL;
 	}
@@ -284,14 +392,16 @@ static void disable_oob_port(struct net_device *dev) /* inband, rtnl_lock held *
 
 	netif_disable_oob_diversion(real_dev);
 
-	evl_stop_kthread(est->rx_handler);
+	stop_rx_lanes(est, est->nr_rx_lanes);
 	if (est->tx_handler)
 		evl_stop_kthread(est->tx_handler);
 
 	__set_rx_filter(est, NULL);
+	__set_tx_filter(est, NULL);
+	clear_rx_sockets(est);
 	evl_net_dev_purge_pool(real_dev);
-	evl_destroy_flag(&est->rx_flag);
-	evl_net_free_qdisc(est->qdisc);
+	evl_net_free_qdisc(rtnl_dereference(est->qdisc));
+	free_percpu(est->stats);
 	kfree(est);
 	rnds->estate = NULL;
 }
@@ -450,13 +560,82 @@ ssize_t netif_oob_query_pool(struct net_device *dev, char *buf)
 {
 	struct evl_netdev_state *est;
 	struct net_device *real_dev;
+	unsigned int cached = 0;
+	int cpu, n;
+	ssize_t len;
 
 	real_dev = evl_net_real_dev(dev);
 	est = real_dev->oob_state.estate;
 	if (est == NULL)
 		return -ENXIO;
 
-	return sprintf(buf, "%zu %zu\n", est->pool_max, est->buf_size);
+	/*
+	 * Pool size, buffer size, then pressure: pages cached by the
+	 * per-CPU magazines, and count of allocations which found the
+	 * pool empty. Next come the size limits of the pool, and the
+	 * peak occupancy (%) over the last resizing periods, oldest
+	 * first.
+	 */
+	for_each_possible_cpu(cpu)
+		cached += READ_ONCE(per_cpu_ptr(est->magazines, cpu)->count);
+
+	len = sprintf(buf, "%zu %zu %u %d %zu %zu", READ_ONCE(est->pool_max),
+		est->buf_size, cached, atomic_read(&est->pool_misses),
+		est->pool_min, est->pool_limit);
+
+	for (n = 0; n < EVL_NETDEV_POOL_HIST; n++)
+		len += sprintf(buf + len, " %u",
+			READ_ONCE(est->pool_hist[(est->pool_hist_next + n) %
+						EVL_NETDEV_POOL_HIST]));
+
+	return len + sprintf(buf + len, "\n");
+}
+
+static void collect_port_stats(struct evl_netdev_state *est,
+			struct evl_net_port_stats *stats)
+{
+	struct evl_netdev_stats *p;
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for_each_possible_cpu(cpu) {
+		p = per_cpu_ptr(est->stats, cpu);
+		stats->rx_packets += READ_ONCE(p->rx_packets);
+		stats->rx_bytes += READ_ONCE(p->rx_bytes);
+		stats->rx_unclaimed += READ_ONCE(p->rx_unclaimed);
+		stats->tx_packets += READ_ONCE(p->tx_packets);
+		stats->tx_bytes += READ_ONCE(p->tx_bytes);
+		stats->tx_qdisc_drops += READ_ONCE(p->tx_qdisc_drops);
+		stats->tx_errors += READ_ONCE(p->tx_errors);
+	}
+
+	stats->rx_filtered = atomic_long_read(&est->rx_verdicts[EVL_RX_DROP]);
+	stats->tx_filtered = atomic_long_read(&est->tx_verdicts[EVL_TX_DROP]);
+	stats->pool_empty = atomic_read(&est->pool_misses);
+}
+
+ssize_t netif_oob_query_stats(struct net_device *dev, char *buf)
+{
+	struct evl_net_port_stats stats;
+	struct evl_netdev_state *est;
+
+	est = evl_net_real_dev(dev)->oob_state.estate;
+	if (est == NULL)
+		return -ENXIO;
+
+	collect_port_stats(est, &stats);
+
+	return sprintf(buf, "rx_packets %llu\nrx_bytes %llu\n"
+		"rx_filtered %llu\nrx_unclaimed %llu\n"
+		"tx_packets %llu\ntx_bytes %llu\n"
+		"tx_qdisc_drops %llu\ntx_errors %llu\n"
+		"pool_empty %llu\ntx_filtered %llu\n",
+		stats.rx_packets, stats.rx_bytes,
+		stats.rx_filtered, stats.rx_unclaimed,
+		stats.tx_packets, stats.tx_bytes,
+		stats.tx_qdisc_drops, stats.tx_errors,
+		stats.pool_empty, stats.tx_filtered);
 }
 
 int evl_netdev_event(struct notifier_block *ev_block,
@@ -473,21 +652,73 @@ int evl_netdev_event(struct notifier_block *ev_block,
 		evl_net_flush_routes(dev_net(dev), dev);
 	}
 
+	/*
+	 * Pinned entries may refer to any device, drop them before
+	 * the latter goes away.
+	 */
+	if (event == NETDEV_UNREGISTER) {
+		evl_net_flush_arp_dev(dev_net(dev), dev);
+		evl_net_flush_routes(dev_net(dev), dev);
+	}
+
 	return NOTIFY_DONE;
 }
 
-enum evl_net_rx_action
-__evl_net_filter_rx(struct evl_netdev_state *est, struct sk_buff *skb)
+static inline u32 run_filter(struct bpf_prog *prog, struct sk_buff *skb)
+{
+	if (unlikely(prog->cb_access))
+		memset(bpf_skb_cb(skb), 0, BPF_SKB_CB_LEN);
+
+	/*
+	 * Nothing migrates over the oob stage, so we may branch to
+	 * the program directly, which is a plain call into the JITed
+	 * code in the common case.
+	 */
+	if (running_oob())
+		return bpf_prog_run(prog, skb);
+
+	return bpf_prog_run_pin_on_cpu(prog, skb);
+}
+
+static u32 check_rx_verdict(struct evl_netdev_state *est, u32 verdict)
+{
+	unsigned int action = EVL_RX_ACTION(verdict);
+
+	switch (action) {
+	case EVL_RX_STEER:
+		if (EVL_RX_ARG(verdict) > U16_MAX)
+			goto invalid;
+		break;
+	case EVL_RX_SOCKET:
+		if (EVL_RX_ARG(verdict) >= EVL_RX_MAX_SOCKETS)
+			goto invalid;
+		break;
+	default:
+		if (action >= EVL_RX_NR_ACTIONS)
+			goto invalid;
+	}
+
+	atomic_long_inc(&est->rx_verdicts[action]);
+
+	return verdict;
+invalid:
+	/* Fallback to the VLAN rules, as with no program. */
+	atomic_long_inc(&est->rx_invalid);
+
+	return EVL_RX_VLAN;
+}
+
+u32 __evl_net_filter_rx(struct evl_netdev_state *est, struct sk_buff *skb)
 {
 	struct evl_net_ebpf_filter *filter = READ_ONCE(est->rx_filter);
-	enum evl_net_rx_action ret = EVL_RX_VLAN;
+	u32 ret = EVL_RX_VLAN;
 
 	if (filter) {
 		rcu_read_lock(); /* Recheck under lock. */
 
 		filter = rcu_dereference(est->rx_filter);
 		if (filter)
-			ret = bpf_prog_run_clear_cb(filter->prog, skb);
+			ret = check_rx_verdict(est, run_filter(filter->prog, skb));
 
 		rcu_read_unlock();
 	}
@@ -495,7 +726,112 @@ __evl_net_filter_rx(struct evl_netdev_state *est, struct sk_buff *skb)
 	return ret;
 }
 
-static void drop_rx_filter(struct rcu_head *rcu)
+static u32 run_tx_filter(struct bpf_prog *prog, struct sk_buff *skb)
+{
+	struct evl_net_cb cb;
+	u32 verdict;
+
+	if (likely(!prog->cb_access))
+		return run_filter(prog, skb);
+
+	/*
+	 * The scratch area of the program overlays our control
+	 * block, which the TX path still needs past this point.
+	 */
+	cb = *EVL_NET_CB(skb);
+	verdict = run_filter(prog, skb);
+	*EVL_NET_CB(skb) = cb;
+
+	return verdict;
+}
+
+static u32 check_tx_verdict(struct evl_netdev_state *est, u32 verdict)
+{
+	unsigned int action = EVL_TX_ACTION(verdict);
+
+	switch (action) {
+	case EVL_TX_CLASSIFY:
+		if (EVL_TX_ARG(verdict) > U16_MAX)
+			goto invalid;
+		break;
+	default:
+		if (action >= EVL_TX_NR_ACTIONS)
+			goto invalid;
+	}
+
+	atomic_long_inc(&est->tx_verdicts[action]);
+
+	return verdict;
+invalid:
+	/* Send as built, as with no program. */
+	atomic_long_inc(&est->tx_invalid);
+
+	return EVL_TX_PASS;
+}
+
+u32 __evl_net_filter_tx(struct evl_netdev_state *est, struct sk_buff *skb)
+{
+	struct evl_net_ebpf_filter *filter = READ_ONCE(est->tx_filter);
+	u32 ret = EVL_TX_PASS;
+
+	if (filter) {
+		rcu_read_lock(); /* Recheck under lock. */
+
+		filter = rcu_dereference(est->tx_filter);
+		if (filter)
+			ret = check_tx_verdict(est, run_tx_filter(filter->prog, skb));
+
+		rcu_read_unlock();
+	}
+
+	return ret;
+}
+
+/* oob, from the RX thread, hard irqs on. */
+static void rx_socket_ingress(struct sk_buff *skb)
+{
+	struct evl_netdev_state *est = skb->dev->oob_state.estate;
+	struct evl_socket *esk;
+	bool delivered = false;
+
+	rcu_read_lock();
+
+	esk = rcu_dereference(est->rx_socks[EVL_NET_CB(skb)->rx_slot]);
+	if (esk)
+		delivered = evl_net_packet_deliver_to(esk, skb);
+
+	rcu_read_unlock();
+
+	if (!delivered) {
+		evl_net_inc_port_stat(est, rx_unclaimed);
+		evl_net_free_skb(skb);
+	}
+}
+
+static struct evl_net_handler evl_net_rx_socket = {
+	.ingress = rx_socket_ingress,
+};
+
+/**
+ * evl_net_steer_rx_socket - queue an ingress packet for the socket
+ * the RX program picked.
+ *
+ * The packet goes through the RX lane as usual, the socket slot is
+ * looked up by the RX thread, dropping @skb if empty by then.
+ *
+ * @skb the packet to deliver. May be linked to some upstream queue.
+ *
+ * @slot the socket slot, validated by __evl_net_filter_rx().
+ */
+bool evl_net_steer_rx_socket(struct sk_buff *skb, unsigned int slot)
+{
+	EVL_NET_CB(skb)->rx_slot = slot;
+	evl_net_receive(skb, &evl_net_rx_socket);
+
+	return true;
+}
+
+static void drop_filter(struct rcu_head *rcu)
 {
 	struct evl_net_ebpf_filter *filter = container_of(rcu, struct evl_net_ebpf_filter, rcu);
 
@@ -504,27 +840,82 @@ static void drop_rx_filter(struct rcu_head *rcu)
 }
 
 static struct evl_net_ebpf_filter *
-__set_rx_filter(struct evl_netdev_state *est,
-		struct evl_net_ebpf_filter *filter)
+swap_filter(struct evl_netdev_state *est,
+	struct evl_net_ebpf_filter __rcu **slot, int bit,
+	struct evl_net_ebpf_filter *filter)
 {
 	struct evl_net_ebpf_filter *old;
 
 	spin_lock_bh(&est->filter_lock);
-	old = rcu_dereference_protected(est->rx_filter,
+	old = rcu_dereference_protected(*slot,
 				lockdep_is_held(&est->filter_lock));
-	rcu_assign_pointer(est->rx_filter, filter);
+	rcu_assign_pointer(*slot, filter);
 	if (filter)
-		set_bit(EVL_NETDEV_RXFILTER_BIT, &est->flags);
+		set_bit(bit, &est->flags);
 	else
-		clear_bit(EVL_NETDEV_RXFILTER_BIT, &est->flags);
+		clear_bit(bit, &est->flags);
 	spin_unlock_bh(&est->filter_lock);
 
 	if (old)
-		call_rcu(&old->rcu, drop_rx_filter);
+		call_rcu(&old->rcu, drop_filter);
 
 	return old;
 }
 
+static struct evl_net_ebpf_filter *
+__set_rx_filter(struct evl_netdev_state *est,
+		struct evl_net_ebpf_filter *filter)
+{
+	return swap_filter(est, &est->rx_filter,
+			EVL_NETDEV_RXFILTER_BIT, filter);
+}
+
+static struct evl_net_ebpf_filter *
+__set_tx_filter(struct evl_netdev_state *est,
+		struct evl_net_ebpf_filter *filter)
+{
+	return swap_filter(est, &est->tx_filter,
+			EVL_NETDEV_TXFILTER_BIT, filter);
+}
+
+/*
+ * Fetch the program file descriptor at @arg, -1 means none. The
+ * program holds a reference from the returned filter.
+ */
+static int get_filter(struct net_device *dev, unsigned long arg,
+		struct evl_net_ebpf_filter **newp)
+{
+	struct evl_net_ebpf_filter *new;
+	struct bpf_prog *prog;
+	int ret, fd;
+
+	*newp = NULL;
+
+	ret = raw_get_user(fd, (__s32 *)arg);
+	if (ret)
+		return -EFAULT;
+
+	if (fd == -1)
+		return 0;
+
+	prog = bpf_prog_get_type(fd, BPF_PROG_TYPE_SOCKET_FILTER);
+	if (IS_ERR(prog)) {
+		netdev_warn(dev, "invalid out-of-band eBPF program\n");
+		return PTR_ERR(prog);
+	}
+
+	new = kmalloc(sizeof(*new), GFP_KERNEL);
+	if (!new) {
+		bpf_prog_put(prog);
+		return -ENOMEM;
+	}
+
+	new->prog = prog;
+	*newp = new;
+
+	return 0;
+}
+
 /*
  * set_rx_filter - install an eBPF program module to redirect ingress
  * traffic to the proper network stack, inband or oob.  @dev is a
@@ -533,26 +924,15 @@ __set_rx_filter(struct evl_netdev_state *est,
 static int set_rx_filter(struct net_device *dev, unsigned long arg)
 {
 	struct oob_netdev_state *nds = &dev->oob_state;
-	struct evl_net_ebpf_filter *old, *new = NULL;
-	struct bpf_prog *prog;
-	int ret, fd;
+	struct evl_net_ebpf_filter *old, *new;
+	int ret;
 
-	ret = raw_get_user(fd, (__s32 *)arg);
+	ret = get_filter(dev, arg, &new);
 	if (ret)
-		return -EFAULT;
+		return ret;
 
-	if (fd != -1) {
-		prog = bpf_prog_get_type(fd, BPF_PROG_TYPE_SOCKET_FILTER);
-		if (IS_ERR(prog)) {
-			netdev_warn(dev, "invalid out-of-band eBPF program\n");
-			return PTR_ERR(prog);
-		}
-		new = kmalloc(sizeof(*new), GFP_KERNEL);
-		if (!new)
-			return -ENOMEM;
-		new->prog = prog;
+	if (new)
 		netdev_notice(dev, "out-of-band eBPF program installed\n");
-	}
 
 	old = __set_rx_filter(nds->estate, new);
 	if (old && !new)
@@ -561,6 +941,374 @@ static int set_rx_filter(struct net_device *dev, unsigned long arg)
 	return 0;
 }
 
+/*
+ * set_tx_filter - install an eBPF program module classifying egress
+ * traffic before it enters the qdisc, which may drop or re-mark
+ * packets.  @dev is a physical interface.
+ */
+static int set_tx_filter(struct net_device *dev, unsigned long arg)
+{
+	struct oob_netdev_state *nds = &dev->oob_state;
+	struct evl_net_ebpf_filter *old, *new;
+	int ret;
+
+	ret = get_filter(dev, arg, &new);
+	if (ret)
+		return ret;
+
+	if (new)
+		netdev_notice(dev, "out-of-band TX eBPF program installed\n");
+
+	old = __set_tx_filter(nds->estate, new);
+	if (old && !new)
+		netdev_notice(dev, "out-of-band TX eBPF program removed\n");
+
+	return 0;
+}
+
+/*
+ * Swap the socket in an RX slot, the previous one is released once
+ * the RX threads may not see it anymore. in-band.
+ */
+static void swap_rx_socket(struct evl_netdev_state *est,
+			unsigned int slot, struct evl_socket *esk)
+{
+	struct evl_socket *old;
+
+	spin_lock_bh(&est->filter_lock);
+	old = rcu_dereference_protected(est->rx_socks[slot],
+				lockdep_is_held(&est->filter_lock));
+	rcu_assign_pointer(est->rx_socks[slot], esk);
+	spin_unlock_bh(&est->filter_lock);
+
+	if (old) {
+		synchronize_rcu();
+		fput(old->efile.filp);
+	}
+}
+
+static void clear_rx_sockets(struct evl_netdev_state *est)
+{
+	struct evl_socket *socks[EVL_RX_MAX_SOCKETS];
+	unsigned int slot;
+
+	spin_lock_bh(&est->filter_lock);
+
+	for (slot = 0; slot < EVL_RX_MAX_SOCKETS; slot++) {
+		socks[slot] = rcu_dereference_protected(est->rx_socks[slot],
+					lockdep_is_held(&est->filter_lock));
+		RCU_INIT_POINTER(est->rx_socks[slot], NULL);
+	}
+
+	spin_unlock_bh(&est->filter_lock);
+
+	synchronize_rcu();
+
+	for (slot = 0; slot < EVL_RX_MAX_SOCKETS; slot++)
+		if (socks[slot])
+			fput(socks[slot]->efile.filp);
+}
+
+/*
+ * set_rx_socket - fill a slot of the socket table the RX program
+ * may deliver to (EVL_RX_SOCKET). The slot holds a reference on the
+ * socket file until cleared, or the oob port is dismantled. @dev is
+ * a physical interface.
+ */
+static int set_rx_socket(struct net_device *dev, unsigned long arg)
+{
+	struct evl_net_rxsock_req req, __user *u_req;
+	struct evl_netdev_state *est;
+	struct evl_socket *esk = NULL;
+	struct file *filp = NULL;
+	struct socket *sock;
+	int ret;
+
+	u_req = (typeof(u_req))arg;
+	ret = copy_from_user(&req, u_req, sizeof(req));
+	if (ret)
+		return -EFAULT;
+
+	if (req.slot >= EVL_RX_MAX_SOCKETS)
+		return -EINVAL;
+
+	if (req.fd != -1) {
+		filp = fget(req.fd);
+		if (filp == NULL)
+			return -EBADF;
+		/* Only oob packet sockets may receive raw frames. */
+		sock = sock_from_file(filp);
+		if (sock == NULL || sock->sk->sk_family != AF_PACKET ||
+			sock->sk->sk_oob_ctx == NULL) {
+			fput(filp);
+			return -EINVAL;
+		}
+		esk = sock->sk->sk_oob_ctx;
+	}
+
+	rtnl_lock();
+
+	est = dev->oob_state.estate;
+	if (est == NULL) {
+		ret = -ENXIO;
+		goto out;
+	}
+
+	swap_rx_socket(est, req.slot, esk);
+	filp = NULL;
+out:
+	rtnl_unlock();
+
+	if (filp)
+		fput(filp);
+
+	return ret;
+}
+
+/*
+ * get_rx_stats - read the verdict counters of the RX program.
+ */
+static int get_rx_stats(struct net_device *dev, unsigned long arg)
+{
+	struct evl_net_rx_stats stats;
+	struct evl_netdev_state *est;
+	unsigned int n;
+	int ret = 0;
+
+	rtnl_lock();
+
+	est = dev->oob_state.estate;
+	if (est == NULL) {
+		ret = -ENXIO;
+	} else {
+		for (n = 0; n < EVL_RX_NR_ACTIONS; n++)
+			stats.verdicts[n] = atomic_long_read(&est->rx_verdicts[n]);
+		stats.invalid = atomic_long_read(&est->rx_invalid);
+	}
+
+	rtnl_unlock();
+
+	if (!ret && copy_to_user((void __user *)arg, &stats, sizeof(stats)))
+		ret = -EFAULT;
+
+	return ret;
+}
+
+/*
+ * get_tx_stats - read the verdict counters of the TX program.
+ */
+static int get_tx_stats(struct net_device *dev, unsigned long arg)
+{
+	struct evl_net_tx_stats stats;
+	struct evl_netdev_state *est;
+	unsigned int n;
+	int ret = 0;
+
+	rtnl_lock();
+
+	est = dev->oob_state.estate;
+	if (est == NULL) {
+		ret = -ENXIO;
+	} else {
+		for (n = 0; n < EVL_TX_NR_ACTIONS; n++)
+			stats.verdicts[n] = atomic_long_read(&est->tx_verdicts[n]);
+		stats.invalid = atomic_long_read(&est->tx_invalid);
+	}
+
+	rtnl_unlock();
+
+	if (!ret && copy_to_user((void __user *)arg, &stats, sizeof(stats)))
+		ret = -EFAULT;
+
+	return ret;
+}
+
+/*
+ * get_port_stats - read the counters of an oob port.
+ */
+static int get_port_stats(struct net_device *dev, unsigned long arg)
+{
+	struct evl_net_port_stats stats;
+	struct evl_netdev_state *est;
+	int ret = 0;
+
+	rtnl_lock();
+
+	est = dev->oob_state.estate;
+	if (est == NULL)
+		ret = -ENXIO;
+	else
+		collect_port_stats(est, &stats);
+
+	rtnl_unlock();
+
+	if (!ret && copy_to_user((void __user *)arg, &stats, sizeof(stats)))
+		ret = -EFAULT;
+
+	return ret;
+}
+
+/*
+ * Move the pending packets from @old to @new, which is live
+ * already. Packets @new refuses are dropped.
+ */
+static void drain_qdisc(struct evl_net_qdisc *old,
+			struct evl_net_qdisc *new) /* in-band */
+{
+	struct sk_buff *(*pull)(struct evl_net_qdisc *qdisc);
+	struct sk_buff *skb;
+
+	pull = old->oob_ops->flush ?: old->oob_ops->dequeue;
+
+	while ((skb = pull(old)) != NULL) {
+		if (new->oob_ops->enqueue(new, skb)) {
+			new->packet_dropped++;
+			evl_net_uncharge_skb_wmem(skb);
+			evl_net_free_skb(skb);
+		}
+	}
+
+	evl_net_kick_qdisc(new);
+}
+
+/*
+ * set_qdisc - replace the out-of-band queueing discipline of a
+ * device by a new instance of the named one. @dev is a physical
+ * interface which must have been turned into an oob port.
+ */
+static int set_qdisc(struct net_device *dev, unsigned long arg)
+{
+	struct evl_net_qdisc_req req, __user *u_req;
+	char name[EVL_NET_QDISC_NAMELEN];
+	struct evl_net_qdisc *new, *old;
+	struct evl_net_qdisc_ops *ops;
+	struct evl_netdev_state *est;
+	void *params = NULL;
+	long len;
+	int ret;
+
+	u_req = (typeof(u_req))arg;
+	ret = copy_from_user(&req, u_req, sizeof(req));
+	if (ret)
+		return -EFAULT;
+
+	len = strncpy_from_user(name, evl_valptr64(req.name_ptr, const char),
+				sizeof(name));
+	if (len < 0)
+		return len;
+
+	if (len == sizeof(name))
+		return -ENAMETOOLONG;
+
+	ops = evl_net_find_qdisc(name);
+	if (ops == NULL)
+		return -ENOENT;
+
+	if (req.params_len) {
+		if (req.params_len > PAGE_SIZE)
+			return -EINVAL;
+		params = memdup_user(evl_valptr64(req.params_ptr, void),
+				req.params_len);
+		if (IS_ERR(params))
+			return PTR_ERR(params);
+	}
+
+	rtnl_lock();
+
+	/* Only oob-capable devices have an oob TX path to schedule. */
+	est = dev->oob_state.estate;
+	if (est == NULL) {
+		ret = -ENXIO;
+		goto out;
+	}
+
+	if (!netdev_is_oob_capable(dev)) {
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+
+	new = evl_net_alloc_qdisc(ops, dev, params, req.params_len);
+	if (IS_ERR(new)) {
+		ret = PTR_ERR(new);
+		goto out;
+	}
+
+	/*
+	 * Once the grace period has elapsed, neither the senders nor
+	 * the TX handler may refer to the old qdisc anymore.
+	 */
+	old = rtnl_dereference(est->qdisc);
+	rcu_assign_pointer(est->qdisc, new);
+	synchronize_rcu();
+
+	drain_qdisc(old, new);
+	evl_net_free_qdisc(old);
+	netdev_notice(dev, "out-of-band qdisc set to %s\n", ops->name);
+	ret = 0;
+out:
+	rtnl_unlock();
+	kfree(params);
+
+	return ret;
+}
+
+/*
+ * get_qstats - read the per-class counters of the current qdisc of
+ * a device. The actual count of classes is returned, which may
+ * exceed the room available in the user buffer.
+ */
+static int get_qstats(struct net_device *dev, unsigned long arg)
+{
+	struct evl_net_qdisc_statreq req, __user *u_req;
+	struct evl_net_qdisc_class_stats *stats;
+	struct evl_net_qdisc *qdisc;
+	struct evl_netdev_state *est;
+	unsigned int nr;
+	int ret;
+
+	u_req = (typeof(u_req))arg;
+	ret = copy_from_user(&req, u_req, sizeof(req));
+	if (ret)
+		return -EFAULT;
+
+	nr = min_t(unsigned int, req.nr_classes, EVL_NET_QDISC_MAX_CLASSES);
+	stats = kcalloc(nr ?: 1, sizeof(*stats), GFP_KERNEL);
+	if (stats == NULL)
+		return -ENOMEM;
+
+	rtnl_lock();
+
+	est = dev->oob_state.estate;
+	if (est == NULL) {
+		ret = -ENXIO;
+		goto out;
+	}
+
+	qdisc = rtnl_dereference(est->qdisc);
+	if (!qdisc->oob_ops->get_stats) {
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+
+	ret = qdisc->oob_ops->get_stats(qdisc, stats, nr);
+out:
+	rtnl_unlock();
+
+	if (ret >= 0) {
+		req.nr_classes = ret;
+		ret = 0;
+		if (copy_to_user(evl_valptr64(req.stats_ptr, void), stats,
+					min_t(unsigned int, nr, req.nr_classes) *
+					sizeof(*stats)) ||
+			put_user(req.nr_classes, &u_req->nr_classes))
+			ret = -EFAULT;
+	}
+
+	kfree(stats);
+
+	return ret;
+}
+
 static long netdev_ioctl(struct file *filp, unsigned int cmd,
 			unsigned long arg)
 {
@@ -571,6 +1319,27 @@ static long netdev_ioctl(struct file *filp, unsigned int cmd,
 	case EVL_NDEVIOC_SETRXEBPF:
 		ret = set_rx_filter(evl_net_real_dev(dev), arg);
 		break;
+	case EVL_NDEVIOC_SETQDISC:
+		ret = set_qdisc(evl_net_real_dev(dev), arg);
+		break;
+	case EVL_NDEVIOC_GETQSTATS:
+		ret = get_qstats(evl_net_real_dev(dev), arg);
+		break;
+	case EVL_NDEVIOC_SETRXSOCK:
+		ret = set_rx_socket(evl_net_real_dev(dev), arg);
+		break;
+	case EVL_NDEVIOC_GETRXSTATS:
+		ret = get_rx_stats(evl_net_real_dev(dev), arg);
+		break;
+	case EVL_NDEVIOC_GETSTATS:
+		ret = get_port_stats(evl_net_real_dev(dev), arg);
+		break;
+	case EVL_NDEVIOC_SETTXEBPF:
+		ret = set_tx_filter(evl_net_real_dev(dev), arg);
+		break;
+	case EVL_NDEVIOC_GETTXSTATS:
+		ret = get_tx_stats(evl_net_real_dev(dev), arg);
+		break;
 	}
 
 	return ret;
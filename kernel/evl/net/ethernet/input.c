@@ -6,11 +6,14 @@
 
 #include <linux/if_vlan.h>
 #include <linux/netdevice.h>
+#include <linux/ipv6.h>
 #include <linux/bitmap.h>
 #include <evl/net/skb.h>
+#include <evl/net/device.h>
 #include <evl/net/input.h>
 #include <evl/net/packet.h>
 #include <evl/net/ipv4.h>
+#include <evl/net/ipv6.h>
 
 static DECLARE_BITMAP(vlan_map, VLAN_N_VID);
 
@@ -24,8 +27,9 @@ static void untag_packet(struct sk_buff *skb,
 	/*
 	 * We run very early in the RX path, eth_type_trans() already
 	 * pulled the MAC header at this point though. We accept
-	 * ETH_P_IP encapsulation only so that ARP and friends still
-	 * flow through the regular network stack. Fix up the protocol
+	 * ETH_P_IP and UDP over ETH_P_IPV6 encapsulation only so that
+	 * ARP, neighbor discovery and friends still flow through the
+	 * regular network stack. Fix up the protocol
 	 * tag in the skb manually, cache the VLAN information in the
 	 * skb, then reorder the MAC header eventually.
 	 */
@@ -41,6 +45,25 @@ static void untag_packet(struct sk_buff *skb,
 	skb->mac_header += VLAN_HLEN;
 }
 
+static bool is_oob_encap(struct sk_buff *skb, struct vlan_ethhdr *ehdr)
+{
+	const struct ipv6hdr *ip6h;
+
+	switch (ehdr->h_vlan_encapsulated_proto) {
+	case htons(ETH_P_IP):
+		return true;
+	case htons(ETH_P_IPV6):
+		if (!IS_ENABLED(CONFIG_EVL_NET_IPV6) ||
+			skb_headlen(skb) < VLAN_HLEN + sizeof(*ip6h))
+			return false;
+		/* skb->data points at the VLAN tag. */
+		ip6h = (const struct ipv6hdr *)(skb->data + VLAN_HLEN);
+		return ip6h->nexthdr == IPPROTO_UDP;
+	default:
+		return false;
+	}
+}
+
 /**
  * evl_net_ether_accept - Unconditionally accept an ethernet packet
  * for the out-of-band stack, stripping out the VLAN information if
@@ -69,7 +92,7 @@ bool evl_net_ether_accept(struct sk_buff *skb)
 
 	mac_hdr = skb_mac_header(skb);
 	ehdr = (struct vlan_ethhdr *)mac_hdr;
-	if (ehdr->h_vlan_encapsulated_proto != htons(ETH_P_IP))
+	if (!is_oob_encap(skb, ehdr))
 		return false;
 
 	untag_packet(skb, mac_hdr, ehdr);
@@ -112,7 +135,7 @@ bool evl_net_ether_accept_vlan(struct sk_buff *skb)
 		eth_type_vlan(skb->protocol)) {
 		mac_hdr = skb_mac_header(skb);
 		ehdr = (struct vlan_ethhdr *)mac_hdr;
-		if (ehdr->h_vlan_encapsulated_proto == htons(ETH_P_IP)) {
+		if (is_oob_encap(skb, ehdr)) {
 			vlan_tci = ntohs(ehdr->h_vlan_TCI);
 			if (test_bit(vlan_tci & VLAN_VID_MASK, vlan_map))
 				goto untag;
@@ -145,9 +168,16 @@ static void net_ether_ingress(struct sk_buff *skb) /* oob */
 	case ETH_P_IP:
 		if (!evl_net_ipv4_deliver(skb))
 			return;
+		break;
+	case ETH_P_IPV6:
+		if (!evl_net_ipv6_deliver(skb))
+			return;
+		break;
 	}
 
-	evl_net_free_skb(skb);	/* Dropped. */
+	/* Dropped. */
+	evl_net_inc_port_stat(skb->dev->oob_state.estate, rx_unclaimed);
+	evl_net_free_skb(skb);
 }
 
 static struct evl_net_handler evl_net_ether = {
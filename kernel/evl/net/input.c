@@ -5,21 +5,41 @@
  */
 
 #include <linux/types.h>
+#include <linux/module.h>
 #include <linux/list.h>
 #include <linux/atomic.h>
 #include <linux/netdevice.h>
 #include <linux/irq_work.h>
 #include <linux/if_vlan.h>
+#include <linux/if_arp.h>
 #include <linux/skbuff.h>
+#include <linux/hash.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <net/dsfield.h>
 #include <evl/thread.h>
+#include <evl/sched.h>
 #include <evl/lock.h>
 #include <evl/list.h>
 #include <evl/flag.h>
 #include <evl/net.h>
 #include <evl/net/device.h>
+#include <evl/net/socket.h>
 #include <evl/net/ipv4.h>
+#include <evl/net/ipv4/arp.h>
+#include <evl/net/can.h>
 
-static void napi_poll_oob(struct evl_netdev_state *est) /* oob */
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "evl."
+
+/*
+ * Optional FIFO priority the RX thread of a lane should run at while
+ * processing each band, zero leaves the thread priority untouched.
+ */
+static int rx_band_prio[EVL_NET_RX_BANDS];
+module_param_array_named(net_rx_band_prio, rx_band_prio, int, NULL, 0644);
+
+static void napi_poll_oob(struct evl_netdev_rx_lane *lane) /* oob */
 {
 	struct napi_struct *napi, *tmp;
 	LIST_HEAD(requeuing);
@@ -28,22 +48,21 @@ static void napi_poll_oob(struct evl_netdev_state *est) /* oob */
 	/*
 	 * We cannot conflict with the in-band stack on queuing via
 	 * napi->poll_list by design, since we own the NAPI instances
-	 * queued to est->rx_poll until we release them in this
+	 * queued to lane->poll until we release them in this
 	 * routine by a call to napi_schedule_unprep().
 	 */
-	raw_spin_lock_irqsave(&est->rx_lock, flags);
+	raw_spin_lock_irqsave(&lane->lock, flags);
 
 	/*
 	 * We are about to drop the RX lock, clear this flag early to
-	 * close a race. We might compete with __set_rx_filter(), so
-	 * use atomic bitops.
+	 * close a race with napi_schedule_oob(), using atomic bitops.
 	 */
-	clear_bit(EVL_NETDEV_POLL_SCHED, &est->flags);
+	clear_bit(EVL_NETDEV_POLL_SCHED, &lane->flags);
 
-	list_for_each_entry_safe(napi, tmp, &est->rx_poll, poll_list) {
+	list_for_each_entry_safe(napi, tmp, &lane->poll, poll_list) {
 		int budget = napi->weight;
 		list_del_init(&napi->poll_list);
-		raw_spin_unlock_irqrestore(&est->rx_lock, flags);
+		raw_spin_unlock_irqrestore(&lane->lock, flags);
 		budget -= napi->poll(napi, budget);
 		/*
 		 * If the budget was not fully consumed (> 0), then we
@@ -58,15 +77,124 @@ static void napi_poll_oob(struct evl_netdev_state *est) /* oob */
 			napi_schedule_unprep(napi);
 		else
 			list_add(&napi->poll_list, &requeuing);
-		raw_spin_lock_irqsave(&est->rx_lock, flags);
+		raw_spin_lock_irqsave(&lane->lock, flags);
 	}
 
 	if (!list_empty(&requeuing)) {
-		list_splice(&requeuing, &est->rx_poll);
-		set_bit(EVL_NETDEV_POLL_SCHED, &est->flags);
+		list_splice(&requeuing, &lane->poll);
+		set_bit(EVL_NETDEV_POLL_SCHED, &lane->flags);
 	}
 
-	raw_spin_unlock_irqrestore(&est->rx_lock, flags);
+	raw_spin_unlock_irqrestore(&lane->lock, flags);
+}
+
+/*
+ * A lane is driven by its RX thread, or by a receiver busy polling
+ * it on behalf of a socket. Whoever fails to grab the lane may rely
+ * on the current owner to process the pending work, since the owner
+ * checks for work again after releasing it, kicking the RX thread
+ * if needed.
+ */
+static inline bool grab_rx_lane(struct evl_netdev_rx_lane *lane)
+{
+	return !test_and_set_bit(EVL_NETDEV_RX_OWNED, &lane->flags);
+}
+
+/* Highest band with pending input above @floor, -1 if none. */
+static int get_pending_band(struct evl_netdev_rx_lane *lane, int floor)
+{
+	int band;
+
+	for (band = EVL_NET_RX_BANDS - 1; band > floor; band--)
+		if (!list_empty_careful(&lane->packets[band].queue))
+			return band;
+
+	return -1;
+}
+
+static void release_rx_lane(struct evl_netdev_rx_lane *lane)
+{
+	clear_bit(EVL_NETDEV_RX_OWNED, &lane->flags);
+	/* Pairs with kick_rx_lane(). */
+	smp_mb__after_atomic();
+	if (test_bit(EVL_NETDEV_POLL_SCHED, &lane->flags) ||
+		get_pending_band(lane, -1) >= 0)
+		evl_raise_flag(&lane->flag);
+}
+
+static void kick_rx_lane(struct evl_netdev_rx_lane *lane)
+{
+	/* Pairs with release_rx_lane(). */
+	smp_mb();
+	if (!test_bit(EVL_NETDEV_RX_OWNED, &lane->flags))
+		evl_raise_flag(&lane->flag);
+}
+
+/*
+ * Raise the RX thread to the priority configured for @band if higher
+ * than its base priority, or drop it back to @base_prio if @band is
+ * negative.
+ */
+static void boost_rx_lane(struct evl_netdev_rx_lane *lane,
+			int band, int base_prio)
+{
+	struct evl_thread *thread = &lane->handler->thread;
+	int prio = base_prio;
+
+	if (band >= 0)
+		prio = max(base_prio, min(READ_ONCE(rx_band_prio[band]),
+						EVL_FIFO_MAX_PRIO));
+
+	if (prio != thread->bprio)
+		evl_set_kthread_priority(lane->handler, prio);
+}
+
+/*
+ * oob, lane owned. Bands are processed strictly by priority: a packet
+ * queued to a higher band while a lower one is being drained is
+ * processed before the latter resumes. Unprocessed packets of the
+ * preempted band stay on a local list, so that ordering within a band
+ * is preserved. If @boost is set, the caller is the RX thread of the
+ * lane which should follow the priority of the band being processed.
+ */
+static void run_rx_lane(struct evl_netdev_rx_lane *lane, bool boost)
+{
+	struct list_head pending[EVL_NET_RX_BANDS];
+	int band, base_prio = 0;
+	struct sk_buff *skb;
+
+	if (test_bit(EVL_NETDEV_POLL_SCHED, &lane->flags))
+		napi_poll_oob(lane);
+
+	if (boost) {
+		if (lane->handler->thread.base_class == &evl_sched_fifo)
+			base_prio = lane->handler->thread.bprio;
+		else
+			boost = false;
+	}
+
+	for (band = 0; band < EVL_NET_RX_BANDS; band++)
+		INIT_LIST_HEAD(&pending[band]);
+again:
+	for (band = EVL_NET_RX_BANDS - 1; band >= 0; band--) {
+		if (list_empty(&pending[band]) &&
+			!evl_net_move_skb_queue(&lane->packets[band],
+						&pending[band]))
+			continue;
+		if (boost)
+			boost_rx_lane(lane, band, base_prio);
+		while (!list_empty(&pending[band])) {
+			skb = list_first_entry(&pending[band],
+					struct sk_buff, list);
+			list_del(&skb->list);
+			EVL_NET_CB(skb)->handler->ingress(skb);
+			if (get_pending_band(lane, band) >= 0)
+				goto again;
+		}
+	}
+
+	if (boost)
+		boost_rx_lane(lane, -1, base_prio);
 }
 
 /*
@@ -80,44 +208,201 @@ static void napi_poll_oob(struct evl_netdev_state *est) /* oob */
  * them over to the proper protocol layer.
  *
  * - the garbage collection to flush the IP fragments which have not
- * been collected in time.
+ * been collected in time (first lane only).
  *
- * Each net device is served by a dedicated RX thread.
+ * Each RX lane of a net device is served by a dedicated RX thread.
  */
 void evl_net_do_rx(void *arg)
 {
-	struct net_device *dev = arg;
-	struct evl_netdev_state *est;
-	struct sk_buff *skb, *next;
-	LIST_HEAD(list);
+	struct evl_netdev_rx_lane *lane = arg;
+	struct net_device *dev = lane->dev;
 	int ret;
 
-	est = dev->oob_state.estate;
-
 	while (!evl_kthread_should_stop()) {
-		ret = evl_wait_flag(&est->rx_flag);
+		ret = evl_wait_flag(&lane->flag);
 		if (ret)
 			break;
 
-		if (test_bit(EVL_NETDEV_POLL_SCHED, &est->flags))
-			napi_poll_oob(est);
+		if (grab_rx_lane(lane)) {
+			run_rx_lane(lane, true);
+			release_rx_lane(lane);
+		}
+
+		if (lane->index == 0)
+			evl_net_ipv4_gc(dev_net(dev));
+	}
+}
+
+/**
+ * evl_net_busy_poll - drive the RX lane a socket last received from.
+ *
+ * Run one polling round over the RX lane which conveyed the last
+ * input of @esk, processing the ingress packets directly from the
+ * context of the caller. Busy polling stops when @deadline is
+ * reached, or if the lane cannot be found anymore.
+ *
+ * @esk the receiving socket.
+ *
+ * @deadline the end of the spin window on the EVL monotonic clock.
+ *
+ * Returns @deadline if the caller may poll again, zero otherwise, in
+ * which case it should sleep waiting for input.
+ */
+ktime_t evl_net_busy_poll(struct evl_socket *esk, ktime_t deadline) /* oob */
+{
+	struct evl_netdev_rx_lane *lane;
+	struct evl_netdev_state *est;
+	struct net_device *dev;
+
+	if (evl_read_clock(&evl_mono_clock) >= deadline)
+		return 0;
+
+	dev = evl_net_get_dev_by_index(esk->net, READ_ONCE(esk->busy_ifindex));
+	if (dev == NULL)
+		return 0;
 
-		if (evl_net_move_skb_queue(&est->rx_packets, &list)) {
-			list_for_each_entry_safe(skb, next, &list, list) {
-				list_del(&skb->list);
-				EVL_NET_CB(skb)->handler->ingress(skb);
-			}
+	est = evl_net_real_dev(dev)->oob_state.estate;
+	if (est == NULL || !est->nr_rx_lanes) {
+		deadline = 0;
+		goto out;
+	}
+
+	lane = est->rx_lanes + READ_ONCE(esk->busy_rxq) % est->nr_rx_lanes;
+	if (grab_rx_lane(lane)) {
+		run_rx_lane(lane, false);
+		release_rx_lane(lane);
+		evl_schedule();
+	} else {
+		cpu_relax();
+	}
+out:
+	evl_net_put_dev(dev);
+
+	return deadline;
+}
+
+/*
+ * NAPI instances are spread over the RX lanes according to the
+ * hardware queue they serve, so are the ingress packets, based on
+ * the RX queue the driver recorded.
+ */
+static inline struct evl_netdev_rx_lane *
+get_napi_lane(struct evl_netdev_state *est, struct napi_struct *n)
+{
+	unsigned int index = n->index >= 0 ? n->index : hash_ptr(n, 16);
+
+	return est->rx_lanes + index % est->nr_rx_lanes;
+}
+
+static inline struct evl_netdev_rx_lane *
+get_skb_lane(struct evl_netdev_state *est, struct sk_buff *skb)
+{
+	unsigned int index = 0, flow;
+
+	/*
+	 * A flow steered by evl_net_steer_rx() goes to the lane of its
+	 * consumer CPU. Record the lane as the RX queue, so that the
+	 * receiver knows where the packet came from.
+	 */
+	if (skb->l4_hash || skb->sw_hash) {
+		flow = READ_ONCE(est->rx_flows[skb->hash % EVL_NETDEV_RX_FLOWS]);
+		if (flow && flow <= est->nr_rx_lanes) {
+			skb_record_rx_queue(skb, flow - 1);
+			return est->rx_lanes + flow - 1;
 		}
+	}
+
+	if (skb_rx_queue_recorded(skb))
+		index = skb_get_rx_queue(skb);
+
+	return est->rx_lanes + index % est->nr_rx_lanes;
+}
+
+/**
+ * evl_net_steer_rx - steer an ingress flow to its consumer CPU.
+ *
+ * Called by protocols when queuing @skb to @esk. If the socket
+ * declared a consumer CPU (EVL_SOCKIOC_SETRXCPU) and we are not
+ * running on it, count a remote delivery, then have the next packets
+ * of the same flow go to the lane pinned to that CPU if any, so that
+ * queuing and wakeup stay local. Only the flow hash computed by the
+ * NIC is considered, we do not dissect packets on the fast path.
+ *
+ * @esk the receiving socket.
+ *
+ * @skb the packet being delivered.
+ */
+void evl_net_steer_rx(struct evl_socket *esk, struct sk_buff *skb) /* oob */
+{
+	int cpu = READ_ONCE(esk->rx_cpu);
+	struct evl_netdev_state *est;
+	unsigned int n;
 
-		evl_net_ipv4_gc(dev_net(dev));
+	if (cpu < 0 || cpu == raw_smp_processor_id())
+		return;
+
+	evl_net_inc_sock_stat(esk, rx_remote);
+
+	if (!skb->l4_hash && !skb->sw_hash)
+		return;
+
+	est = evl_net_real_dev(skb->dev)->oob_state.estate;
+	if (est == NULL)
+		return;
+
+	for (n = 0; n < est->nr_rx_lanes; n++) {
+		if (est->rx_lanes[n].cpu == cpu) {
+			WRITE_ONCE(est->rx_flows[skb->hash % EVL_NETDEV_RX_FLOWS],
+				n + 1);
+			break;
+		}
 	}
 }
 
+/* Wake up the first lane, which also collects stale IP fragments. */
 void evl_net_wake_rx(struct net_device *dev)
 {
 	struct evl_netdev_state *est = dev->oob_state.estate;
 
-	evl_raise_flag(&est->rx_flag);
+	evl_raise_flag(&est->rx_lanes[0].flag);
+}
+
+/* Wake up every lane with pending ingress packets. */
+static void wake_rx_lanes(struct evl_netdev_state *est)
+{
+	struct evl_netdev_rx_lane *lane;
+	unsigned int n;
+
+	for (n = 0; n < est->nr_rx_lanes; n++) {
+		lane = est->rx_lanes + n;
+		if (get_pending_band(lane, -1) >= 0)
+			kick_rx_lane(lane);
+	}
+}
+
+/*
+ * Pick the priority band of an ingress packet. A non-zero
+ * skb->priority, e.g. set by the RX filter program or the driver,
+ * wins over the VLAN PCP bits, which in turn win over the class
+ * selector of the IP DSCP field. Anything else goes to the lowest
+ * band.
+ */
+static int get_skb_band(struct sk_buff *skb)
+{
+	unsigned int prio = 0, off = skb_network_offset(skb);
+
+	if (skb->priority)
+		prio = skb->priority;
+	else if (skb_vlan_tag_present(skb))
+		prio = skb_vlan_tag_get_prio(skb);
+	else if (skb->protocol == htons(ETH_P_IP) &&
+		skb_headlen(skb) >= off + sizeof(struct iphdr))
+		prio = ipv4_get_dsfield(ip_hdr(skb)) >> 5;
+	else if (skb->protocol == htons(ETH_P_IPV6) &&
+		skb_headlen(skb) >= off + sizeof(struct ipv6hdr))
+		prio = ipv6_get_dsfield(ipv6_hdr(skb)) >> 5;
+
+	return min(prio, 7U) * EVL_NET_RX_BANDS / 8;
 }
 
 /**
@@ -144,11 +429,16 @@ void evl_net_receive(struct sk_buff *skb,
 		struct evl_net_handler *handler) /* in-band or oob */
 {
 	struct evl_netdev_state *est = skb->dev->oob_state.estate;
+	struct evl_netdev_rx_lane *lane;
 
 	if (skb->next)
 		skb_list_del_init(skb);
 
 	EVL_NET_CB(skb)->handler = handler;
+	/* Ingress time on the EVL clock, as reported to receivers. */
+	skb->tstamp = evl_read_clock(&evl_mono_clock);
+	evl_net_inc_port_stat(est, rx_packets);
+	evl_net_add_port_stat(est, rx_bytes, skb->len);
 
 	/*
 	 * Enqueue then kick our kthread handling the ingress path
@@ -156,10 +446,11 @@ void evl_net_receive(struct sk_buff *skb,
 	 * the NIC driver to invoke napi_complete_done() when the RX
 	 * side goes quiescent.
 	 */
-	evl_net_add_skb_queue(&est->rx_packets, skb);
+	lane = get_skb_lane(est, skb);
+	evl_net_add_skb_queue(&lane->packets[get_skb_band(skb)], skb);
 
 	if (running_oob())
-		evl_net_wake_rx(skb->dev);
+		kick_rx_lane(lane);
 }
 
 struct evl_net_rxqueue *evl_net_alloc_rxqueue(u32 hkey) /* in-band */
@@ -172,12 +463,12 @@ struct evl_net_rxqueue *evl_net_alloc_rxqueue(u32 hkey) /* in-band */
 
 	rxq->hkey = hkey;
 	INIT_LIST_HEAD(&rxq->subscribers);
-	evl_spin_lock_init(&rxq->lock);
+	hash_init(rxq->sub_hash);
 
 	return rxq;
 }
 
-/* in-band */
+/* in-band, once no reader may see @rxq anymore. */
 void evl_net_free_rxqueue(struct evl_net_rxqueue *rxq)
 {
 	EVL_WARN_ON(NET, !list_empty(&rxq->subscribers));
@@ -188,8 +479,9 @@ void evl_net_free_rxqueue(struct evl_net_rxqueue *rxq)
 /**
  * napi_schedule_oob - plan for polling a NAPI instance.
  *
- * The RX kthread is resumed so that it polls the associated device
- * for ingress packets directly from the oob stage.
+ * The RX kthread of the lane @n belongs to is resumed so that it
+ * polls the associated device for ingress packets directly from the
+ * oob stage.
  *
  * @n is the NAPI instance associated to a device for which oob packet
  * diversion is enabled. An earlier call to napi_schedule_prep() is
@@ -199,38 +491,40 @@ void napi_schedule_oob(struct napi_struct *n) /* oob */
 {
 	struct net_device *dev = n->dev;
 	struct evl_netdev_state *est = dev->oob_state.estate;
+	struct evl_netdev_rx_lane *lane;
 	unsigned long flags;
 
 	if (EVL_WARN_ON(NET, !(n->state & NAPIF_STATE_SCHED)))
 		return;
 
 	/*
-	 * We might have multiple NAPI instances per device, so
+	 * We might have multiple NAPI instances per lane, so
 	 * serialization is required despite a single NAPI instance
 	 * may be active at any point in time. Oh, well. See
 	 * napi_poll_oob() for an explanation about the requirement
 	 * for atomic bitops (EVL_NETDEV_POLL_SCHED).
 	 */
-	raw_spin_lock_irqsave(&est->rx_lock, flags);
-	list_add(&n->poll_list, &est->rx_poll);
-	set_bit(EVL_NETDEV_POLL_SCHED, &est->flags);
-	raw_spin_unlock_irqrestore(&est->rx_lock, flags);
-	evl_net_wake_rx(dev);
+	lane = get_napi_lane(est, n);
+	raw_spin_lock_irqsave(&lane->lock, flags);
+	list_add(&n->poll_list, &lane->poll);
+	set_bit(EVL_NETDEV_POLL_SCHED, &lane->flags);
+	raw_spin_unlock_irqrestore(&lane->lock, flags);
+	kick_rx_lane(lane);
 }
 
 /**
  * napi_complete_oob - release a NAPI instance.
  *
  * May be called in-band or out-of-band indifferently. Eventually, the
- * RX kthread is resumed so that it passes the pending ingress packets
- * to the proper protocol handlers.
+ * RX kthreads are resumed so that they pass the pending ingress
+ * packets to the proper protocol handlers.
  *
  * @n is the NAPI instance associated to a device for which oob packet
  * diversion is enabled.
  */
 void napi_complete_oob(struct napi_struct *n) /* inband / oob */
 {
-	evl_net_wake_rx(n->dev);
+	wake_rx_lanes(n->dev->oob_state.estate);
 }
 
 /**
@@ -253,24 +547,48 @@ void napi_complete_oob(struct napi_struct *n) /* inband / oob */
  */
 bool netif_deliver_oob(struct sk_buff *skb) /* oob or in-band */
 {
+	u32 verdict;
+
 	skb_reset_network_header(skb);
 	if (!skb_transport_header_was_set(skb))
 		skb_reset_transport_header(skb);
 	skb_reset_mac_len(skb);
 
+	/*
+	 * CAN frames have no link layer header, the filters of the
+	 * oob CAN sockets decide on their own.
+	 */
+	if (skb->dev->type == ARPHRD_CAN)
+		return evl_net_can_accept(skb);
+
+	/*
+	 * ARP always flows in-band, but a reply may complete a
+	 * resolution which the oob stage is waiting for.
+	 */
+	if (skb->protocol == htons(ETH_P_ARP))
+		evl_net_snoop_arp(skb);
+
 	/*
 	 * Filter the incoming packet through the eBPF RX program
 	 * attached to the input device (if any), passing it down to
 	 * the regular in-band stack if the filter code says that we
 	 * are not interested in it.
 	 */
-	switch (evl_net_filter_rx(skb->dev, skb)) {
+	verdict = evl_net_filter_rx(skb->dev, skb);
+	switch (EVL_RX_ACTION(verdict)) {
 	case EVL_RX_VLAN:
 		/*
 		 * Apply our VLAN rules to decide whether this is an
 		 * oob packet.
 		 */
 		break;
+	case EVL_RX_STEER:
+		/*
+		 * Pin the flow to the RX lane the program picked,
+		 * then accept as usual.
+		 */
+		skb_record_rx_queue(skb, EVL_RX_ARG(verdict));
+		fallthrough;
 	case EVL_RX_ACCEPT:
 		/* Direct the packet to the oob stack unconditionally. */
 		switch (skb->protocol) {
@@ -284,6 +602,9 @@ bool netif_deliver_oob(struct sk_buff *skb) /* oob or in-band */
 			 */
 			return false;
 		}
+	case EVL_RX_SOCKET:
+		/* Raw delivery to the socket the program picked. */
+		return evl_net_steer_rx_socket(skb, EVL_RX_ARG(verdict));
 	case EVL_RX_SKIP:
 		/* Leave the packet to inband. */
 		return false;
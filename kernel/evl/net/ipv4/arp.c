@@ -9,17 +9,42 @@
  * observed on oob-enabled devices, uncaching invalidated/dead
  * entries. The front cache may be used safely from oob context for
  * address lookup.
+ *
+ * Entries may also be pinned administratively, so that the first
+ * packet sent to a peer never waits for the in-band resolution. A
+ * pinned entry is neither replaced nor dropped by the in-band
+ * updates, nor by a regular flush, only by an explicit removal, or
+ * when its device is unregistered.
+ *
+ * On a cache miss for a peer directly reachable through an oob port,
+ * the resolution may also be driven from the oob stage: a request is
+ * broadcast, the packets to the peer wait in a bounded backlog, and
+ * the reply is snooped on its way to the in-band stack, which flushes
+ * the backlog and fills the front cache eventually.
  */
 
 #include <linux/if_ether.h>
+#include <linux/etherdevice.h>
 #include <linux/hash.h>
+#include <linux/inet.h>
+#include <linux/string.h>
 #include <linux/notifier.h>
+#include <linux/if_arp.h>
+#include <linux/inetdevice.h>
 #include <net/netevent.h>
 #include <net/arp.h>
+#include <evl/clock.h>
+#include <evl/net/skb.h>
+#include <evl/net/device.h>
+#include <evl/net/output.h>
 #include <evl/net/ipv4/arp.h>
 
 #define EVL_NET_ARP_CACHE_SHIFT  8
 
+/* Retransmit period and lifetime of an oob solicitation (ns). */
+#define EVL_NET_ARP_PROBE_PERIOD	(250 * NSEC_PER_MSEC)
+#define EVL_NET_ARP_SOLICIT_TIME	(1000 * NSEC_PER_MSEC)
+
 static u32 hash_arp_entry(const void *key)
 {
 	const struct evl_net_arp_key *arp_k = key;
@@ -69,35 +94,71 @@ static struct evl_cache_ops arp_cache_ops = {
 	.drop		= free_arp_entry,
 };
 
+/* in-band, cache locked */
+static bool is_pinned_locked(struct evl_cache *cache,
+			const struct evl_net_arp_key *key)
+{
+	struct evl_cache_entry *entry;
+	bool pinned;
+
+	entry = evl_lookup_cache(cache, key);
+	if (!entry)
+		return false;
+
+	pinned = container_of(entry, struct evl_net_arp_entry, entry)->pinned;
+	evl_put_cache_entry(entry);
+
+	return pinned;
+}
+
 /*
- * Cache a new ARP entry.
+ * Cache a new ARP entry, which replaces any learned one for the same
+ * key. A pinned entry may only be replaced by another pinned entry.
  */
-static int cache_arp_entry(struct evl_cache *cache, struct neighbour *neigh) /* in-band */
+static int add_arp_entry(struct evl_cache *cache, struct net_device *dev,
+			__be32 addr, const unsigned char *ha,
+			bool pinned) /* in-band */
 {
-	struct net_device *dev = neigh->dev;
 	struct evl_net_arp_entry *e;
-	int ret;
+	int ret = 0;
 
 	e = kzalloc(sizeof(*e), GFP_ATOMIC);
 	if (!e)
 		return -ENOMEM;
 
 	e->key.dev = dev;
-	e->key.addr = *(const __be32 *)neigh->primary_key;
-	memcpy(e->ha, neigh->ha, sizeof(e->ha));
+	e->key.addr = addr;
+	e->pinned = pinned;
+	memcpy(e->ha, ha, dev->addr_len);
 	netdev_hold(dev, &e->dev_tracker, GFP_ATOMIC);
 
-	ret = evl_add_cache_entry(cache, &e->entry);
+	evl_lock_cache(cache);
+
+	if (pinned || !is_pinned_locked(cache, &e->key))
+		ret = evl_add_cache_entry_locked(cache, &e->entry);
+	else
+		ret = -EEXIST;
+
+	evl_unlock_cache(cache);
+
 	if (ret) {
 		netdev_put(dev, &e->dev_tracker);
 		kfree(e);
 	}
 
-	return ret;
+	return ret == -EEXIST ? 0 : ret;
+}
+
+static inline int cache_arp_entry(struct evl_cache *cache,
+				struct neighbour *neigh) /* in-band */
+{
+	return add_arp_entry(cache, neigh->dev,
+			*(const __be32 *)neigh->primary_key,
+			neigh->ha, false);
 }
 
 /*
- * Uncache an ARP entry.
+ * Uncache a learned ARP entry.
  */
 static void uncache_arp_entry(struct evl_cache *cache, struct neighbour *neigh) /* in-band */
 {
@@ -106,7 +167,12 @@ static void uncache_arp_entry(struct evl_cache *cache, struct neighbour *neigh)
 		.dev = neigh->dev,
 	};
 
-	evl_del_cache_entry(cache, &key);
+	evl_lock_cache(cache);
+
+	if (!is_pinned_locked(cache, &key))
+		evl_del_cache_entry_locked(cache, &key);
+
+	evl_unlock_cache(cache);
 }
 
 /*
@@ -186,15 +252,504 @@ struct evl_net_arp_entry *evl_net_get_arp_entry(struct net_device *dev, __be32 a
 	return NULL;
 }
 
+/*
+ * Broadcast an ARP request for @daddr on behalf of @saddr. This may
+ * fail on buffer shortage, in which case the next probe will retry.
+ */
+static int send_arp_request(struct net_device *dev,
+			__be32 daddr, __be32 saddr) /* oob */
+{
+	struct net_device *real_dev = evl_net_real_dev(dev);
+	struct sk_buff *skb;
+	struct arphdr *arp;
+	unsigned char *p;
+	int ret;
+
+	skb = evl_net_dev_alloc_skb(dev, EVL_NONBLOCK, EVL_REL);
+	if (IS_ERR(skb))
+		return PTR_ERR(skb);
+
+	skb_reserve(skb, real_dev->hard_header_len);
+	arp = skb_put(skb, arp_hdr_len(real_dev));
+	skb_reset_network_header(skb);
+	arp->ar_hrd = htons(ARPHRD_ETHER);
+	arp->ar_pro = htons(ETH_P_IP);
+	arp->ar_hln = ETH_ALEN;
+	arp->ar_pln = sizeof(__be32);
+	arp->ar_op = htons(ARPOP_REQUEST);
+	p = (unsigned char *)(arp + 1);
+	ether_addr_copy(p, real_dev->dev_addr);
+	p += ETH_ALEN;
+	memcpy(p, &saddr, sizeof(saddr));
+	p += sizeof(saddr);
+	eth_zero_addr(p);
+	p += ETH_ALEN;
+	memcpy(p, &daddr, sizeof(daddr));
+	skb->protocol = htons(ETH_P_ARP);
+
+	ret = evl_net_ether_transmit(dev, skb, dev->broadcast);
+	if (ret)
+		evl_net_free_skb(skb);
+
+	return ret;
+}
+
+/* sdir->lock held. */
+static struct evl_net_arp_solicit *
+find_solicit_locked(struct evl_net_arp_sdir *sdir,
+		struct net_device *dev, __be32 daddr)
+{
+	struct evl_net_arp_solicit *sol;
+	int n;
+
+	for (n = 0; n < EVL_NET_ARP_MAX_SOLICIT; n++) {
+		sol = sdir->slots + n;
+		if (sol->dev == dev && sol->daddr == daddr)
+			return sol;
+	}
+
+	return NULL;
+}
+
+/* sdir->lock held. The backlog is handed over to the caller. */
+static void release_solicit_locked(struct evl_net_arp_sdir *sdir,
+				struct evl_net_arp_solicit *sol,
+				struct list_head *list)
+{
+	list_splice_tail_init(&sol->backlog, list);
+	sol->backlog_len = 0;
+	sol->dev = NULL;
+	if (--sdir->nr_busy == 0)
+		evl_stop_timer(&sdir->timer);
+}
+
+static void drop_backlog(struct list_head *list)
+{
+	struct sk_buff *skb, *n;
+
+	list_for_each_entry_safe(skb, n, list, list) {
+		list_del(&skb->list);
+		evl_net_wput_skb(skb);
+	}
+}
+
+/*
+ * Retransmit the pending requests, giving up on those which went
+ * unanswered for too long, dropping their backlog.
+ */
+static void solicit_timer_handler(struct evl_timer *timer) /* oob stage stalled */
+{
+	struct evl_net_arp_sdir *sdir =
+		container_of(timer, struct evl_net_arp_sdir, timer);
+	struct evl_net_arp_solicit *sol;
+	struct net_device *dev;
+	__be32 daddr, saddr;
+	unsigned long flags;
+	LIST_HEAD(list);
+	ktime_t now;
+	int n;
+
+	now = evl_read_clock(&evl_mono_clock);
+
+	for (n = 0; n < EVL_NET_ARP_MAX_SOLICIT; n++) {
+		sol = sdir->slots + n;
+		raw_spin_lock_irqsave(&sdir->lock, flags);
+		if (!sol->dev || sol->state != EVL_ARP_SOLICIT_PENDING) {
+			raw_spin_unlock_irqrestore(&sdir->lock, flags);
+			continue;
+		}
+		if (now >= sol->deadline) {
+			netdev_dbg(sol->dev, "no ARP reply from %pI4\n",
+				&sol->daddr);
+			release_solicit_locked(sdir, sol, &list);
+			raw_spin_unlock_irqrestore(&sdir->lock, flags);
+			continue;
+		}
+		dev = sol->dev;
+		daddr = sol->daddr;
+		saddr = sol->saddr;
+		raw_spin_unlock_irqrestore(&sdir->lock, flags);
+		send_arp_request(dev, daddr, saddr);
+	}
+
+	drop_backlog(&list);
+}
+
+/*
+ * Once resolved oob, fill the front cache so that the next packets
+ * to the peer take the fast path, then recycle the slot which served
+ * as a stopgap meanwhile.
+ */
+static void fill_arp_cache(struct evl_work *work) /* in-band */
+{
+	struct evl_net_arp_solicit *sol =
+		container_of(work, struct evl_net_arp_solicit, fill_work);
+	struct evl_net_arp_sdir *sdir = sol->sdir;
+	struct oob_net_state *nets =
+		container_of(sdir, struct oob_net_state, ipv4.sdir);
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	if (add_arp_entry(&nets->ipv4.arp, sol->dev, sol->daddr, sol->ha, false))
+		printk(EVL_WARNING "out of memory for ARP cache\n");
+
+	raw_spin_lock_irqsave(&sdir->lock, flags);
+	release_solicit_locked(sdir, sol, &list);
+	raw_spin_unlock_irqrestore(&sdir->lock, flags);
+}
+
+/**
+ * evl_net_solicit_arp - start resolving an address from the oob stage.
+ *
+ * Make sure a solicitation is in flight for @daddr on @dev, sending
+ * the first request if there was none yet.
+ *
+ * Returns true if the resolution is tracked, in which case the
+ * packets to the peer may be passed to evl_net_defer_arp_xmit(), or
+ * false if the solicitation table is full.
+ */
+bool evl_net_solicit_arp(struct net_device *dev, __be32 daddr) /* oob */
+{
+	struct evl_net_arp_sdir *sdir = &dev_net(dev)->oob.ipv4.sdir;
+	struct evl_net_arp_solicit *sol;
+	unsigned long flags;
+	ktime_t period;
+	__be32 saddr;
+	int n;
+
+	raw_spin_lock_irqsave(&sdir->lock, flags);
+
+	sol = find_solicit_locked(sdir, dev, daddr);
+	if (sol) {
+		raw_spin_unlock_irqrestore(&sdir->lock, flags);
+		return true;
+	}
+
+	sol = find_solicit_locked(sdir, NULL, 0);
+	if (!sol) {
+		raw_spin_unlock_irqrestore(&sdir->lock, flags);
+		return false;
+	}
+
+	rcu_read_lock();
+	saddr = inet_select_addr(dev, daddr, RT_SCOPE_LINK);
+	rcu_read_unlock();
+
+	sol->dev = dev;
+	sol->daddr = daddr;
+	sol->saddr = saddr;
+	sol->state = EVL_ARP_SOLICIT_PENDING;
+	sol->deadline = ktime_add(evl_read_clock(&evl_mono_clock),
+				EVL_NET_ARP_SOLICIT_TIME);
+	if (sdir->nr_busy++ == 0) {
+		period = EVL_NET_ARP_PROBE_PERIOD;
+		evl_start_timer(&sdir->timer,
+				evl_abs_timeout(&sdir->timer, period), period);
+	}
+
+	raw_spin_unlock_irqrestore(&sdir->lock, flags);
+
+	send_arp_request(dev, daddr, saddr);
+
+	return true;
+}
+
+/**
+ * evl_net_defer_arp_xmit - send a packet once its peer is resolved.
+ *
+ * @skb is a complete packet to @daddr on @dev, except for the
+ * ethernet header. It is sent immediately if the solicitation
+ * started by evl_net_solicit_arp() completed meanwhile, queued to the
+ * backlog otherwise.
+ *
+ * Returns zero on success, -ENOBUFS if the backlog is full, or
+ * -EHOSTUNREACH if the solicitation timed out. @skb still belongs to
+ * the caller on error.
+ */
+int evl_net_defer_arp_xmit(struct net_device *dev, __be32 daddr,
+			struct sk_buff *skb) /* oob */
+{
+	struct evl_net_arp_sdir *sdir = &dev_net(dev)->oob.ipv4.sdir;
+	unsigned char ha[MAX_ADDR_LEN];
+	struct evl_net_arp_solicit *sol;
+	unsigned long flags;
+	int ret = 0;
+
+	raw_spin_lock_irqsave(&sdir->lock, flags);
+
+	sol = find_solicit_locked(sdir, dev, daddr);
+	if (!sol) {
+		ret = -EHOSTUNREACH;
+	} else if (sol->state == EVL_ARP_SOLICIT_RESOLVED) {
+		memcpy(ha, sol->ha, dev->addr_len);
+		ret = 1;
+	} else if (sol->backlog_len >= EVL_NET_ARP_BACKLOG) {
+		ret = -ENOBUFS;
+	} else {
+		list_add_tail(&skb->list, &sol->backlog);
+		sol->backlog_len++;
+	}
+
+	raw_spin_unlock_irqrestore(&sdir->lock, flags);
+
+	if (ret > 0)
+		ret = evl_net_ether_transmit(dev, skb, ha);
+
+	return ret;
+}
+
+/*
+ * Peek at an incoming ARP packet, completing the pending solicitation
+ * for its sender if any. Requests from the peer convey its hardware
+ * address as well as replies do. The packet is left untouched for
+ * the in-band stack to process next.
+ */
+void __evl_net_snoop_arp(struct net *net, struct sk_buff *skb) /* oob or in-band */
+{
+	struct evl_net_arp_sdir *sdir = &net->oob.ipv4.sdir;
+	unsigned char ha[ETH_ALEN];
+	struct evl_net_arp_solicit *sol;
+	struct sk_buff *nskb, *n;
+	struct net_device *dev;
+	const unsigned char *p;
+	unsigned long flags;
+	struct arphdr *arp;
+	LIST_HEAD(list);
+	__be32 sip;
+	int slot;
+
+	if (skb_headlen(skb) < arp_hdr_len(skb->dev))
+		return;
+
+	arp = arp_hdr(skb);
+	if (arp->ar_hrd != htons(ARPHRD_ETHER) ||
+		arp->ar_pro != htons(ETH_P_IP) ||
+		arp->ar_hln != ETH_ALEN ||
+		arp->ar_pln != sizeof(__be32))
+		return;
+
+	if (arp->ar_op != htons(ARPOP_REPLY) &&
+		arp->ar_op != htons(ARPOP_REQUEST))
+		return;
+
+	p = (const unsigned char *)(arp + 1);
+	memcpy(&sip, p + ETH_ALEN, sizeof(sip));
+
+	raw_spin_lock_irqsave(&sdir->lock, flags);
+
+	for (slot = 0; slot < EVL_NET_ARP_MAX_SOLICIT; slot++) {
+		sol = sdir->slots + slot;
+		if (sol->dev && sol->daddr == sip &&
+			sol->state == EVL_ARP_SOLICIT_PENDING &&
+			evl_net_real_dev(sol->dev) == skb->dev)
+			break;
+	}
+
+	if (slot == EVL_NET_ARP_MAX_SOLICIT) {
+		raw_spin_unlock_irqrestore(&sdir->lock, flags);
+		return;
+	}
+
+	/*
+	 * The slot stays busy until the front cache is filled, serving
+	 * the resolved address to the senders meanwhile. Queue the
+	 * filler with the lock held, so that flush_solicit_dev() may
+	 * wait for it to release any resolved slot.
+	 */
+	dev = sol->dev;
+	ether_addr_copy(sol->ha, p);
+	ether_addr_copy(ha, p);
+	sol->state = EVL_ARP_SOLICIT_RESOLVED;
+	list_splice_init(&sol->backlog, &list);
+	sol->backlog_len = 0;
+	evl_call_inband(&sol->fill_work);
+
+	raw_spin_unlock_irqrestore(&sdir->lock, flags);
+
+	list_for_each_entry_safe(nskb, n, &list, list) {
+		list_del(&nskb->list);
+		if (evl_net_ether_transmit(dev, nskb, ha))
+			evl_net_wput_skb(nskb);
+	}
+}
+
+/* in-band, @dev cannot be picked for oob output anymore. */
+static void flush_solicit_dev(struct evl_net_arp_sdir *sdir,
+			struct net_device *dev)
+{
+	struct evl_net_arp_solicit *sol;
+	unsigned long flags;
+	LIST_HEAD(list);
+	int n;
+
+	for (n = 0; n < EVL_NET_ARP_MAX_SOLICIT; n++) {
+		sol = sdir->slots + n;
+		if (READ_ONCE(sol->dev) != dev)
+			continue;
+		/* A resolved slot is released by the cache filler. */
+		if (READ_ONCE(sol->state) == EVL_ARP_SOLICIT_RESOLVED)
+			evl_flush_work(&sol->fill_work);
+		raw_spin_lock_irqsave(&sdir->lock, flags);
+		if (sol->dev == dev)
+			release_solicit_locked(sdir, sol, &list);
+		raw_spin_unlock_irqrestore(&sdir->lock, flags);
+	}
+
+	drop_backlog(&list);
+}
+
+static int init_solicit_dir(struct evl_net_arp_sdir *sdir)
+{
+	struct evl_net_arp_solicit *sol;
+	int n;
+
+	sdir->slots = kcalloc(EVL_NET_ARP_MAX_SOLICIT,
+			sizeof(*sdir->slots), GFP_KERNEL);
+	if (!sdir->slots)
+		return -ENOMEM;
+
+	for (n = 0; n < EVL_NET_ARP_MAX_SOLICIT; n++) {
+		sol = sdir->slots + n;
+		INIT_LIST_HEAD(&sol->backlog);
+		evl_init_work(&sol->fill_work, fill_arp_cache);
+		sol->sdir = sdir;
+	}
+
+	raw_spin_lock_init(&sdir->lock);
+	sdir->nr_busy = 0;
+	/* Probes may tick on the housekeeping CPU. */
+	evl_init_timer_on_rq(&sdir->timer, &evl_mono_clock,
+			solicit_timer_handler, NULL,
+			EVL_TIMER_IGRAVITY|EVL_TIMER_NONCRIT);
+
+	return 0;
+}
+
+static void cleanup_solicit_dir(struct evl_net_arp_sdir *sdir)
+{
+	struct evl_net_arp_solicit *sol;
+	unsigned long flags;
+	LIST_HEAD(list);
+	int n;
+
+	evl_destroy_timer(&sdir->timer);
+
+	for (n = 0; n < EVL_NET_ARP_MAX_SOLICIT; n++) {
+		sol = sdir->slots + n;
+		evl_flush_work(&sol->fill_work);
+		raw_spin_lock_irqsave(&sdir->lock, flags);
+		if (sol->dev)
+			release_solicit_locked(sdir, sol, &list);
+		raw_spin_unlock_irqrestore(&sdir->lock, flags);
+	}
+
+	drop_backlog(&list);
+	kfree(sdir->slots);
+}
+
 static struct notifier_block netevent_notifier __read_mostly = {
 	.notifier_call = netevent_handler,
 };
 
+static bool match_learned_arp(struct evl_cache_entry *entry, void *arg)
+{
+	return !container_of(entry, struct evl_net_arp_entry, entry)->pinned;
+}
+
+static bool match_arp_dev(struct evl_cache_entry *entry, void *arg)
+{
+	return container_of(entry, struct evl_net_arp_entry, entry)->key.dev == arg;
+}
+
+/* Drop the learned entries, leaving pinned ones in place. */
 void evl_net_flush_arp(struct net *net)
 {
 	struct oob_net_state *nets = &net->oob;
 
-	evl_flush_cache(&nets->ipv4.arp);
+	evl_clean_cache(&nets->ipv4.arp, match_learned_arp, NULL);
+}
+
+/* Drop all the entries referring to @dev, pinned or not. */
+void evl_net_flush_arp_dev(struct net *net, struct net_device *dev)
+{
+	struct oob_net_state *nets = &net->oob;
+
+	flush_solicit_dev(&nets->ipv4.sdir, dev);
+	evl_clean_cache(&nets->ipv4.arp, match_arp_dev, dev);
+}
+
+/*
+ * Parse one line written to the arp attribute:
+ *
+ * "<ipv4> <mac> <ifname>" pins an entry,
+ * "-<ipv4> <ifname>" removes it.
+ */
+static int parse_arp_line(struct net *net, const char *line) /* in-band */
+{
+	char addr[INET_ADDRSTRLEN], mac[3 * ETH_ALEN], ifname[IFNAMSIZ];
+	struct evl_cache *cache = &net->oob.ipv4.arp;
+	struct evl_net_arp_key key;
+	unsigned char ha[ETH_ALEN];
+	struct net_device *dev;
+	bool del;
+	int ret;
+
+	del = *line == '-';
+	if (del)
+		ret = sscanf(line + 1, "%15s %15s", addr, ifname) == 2;
+	else
+		ret = sscanf(line, "%15s %17s %15s", addr, mac, ifname) == 3 &&
+			mac_pton(mac, ha);
+
+	if (!ret || !in4_pton(addr, -1, (u8 *)&key.addr, -1, NULL))
+		return -EINVAL;
+
+	dev = dev_get_by_name(net, ifname);
+	if (!dev)
+		return -ENODEV;
+
+	ret = 0;
+	if (del) {
+		key.dev = dev;
+		evl_del_cache_entry(cache, &key);
+	} else if (dev->addr_len != ETH_ALEN) {
+		ret = -EINVAL;
+	} else {
+		ret = add_arp_entry(cache, dev, key.addr, ha, true);
+	}
+
+	dev_put(dev);
+
+	return ret;
+}
+
+/*
+ * Store handler for the arp attribute, which accepts one pinned
+ * entry to add or remove per line, see parse_arp_line(). A single
+ * word flushes the learned entries like any write used to.
+ */
+ssize_t evl_net_store_arp(struct net *net, const char *buf, size_t len)
+{
+	char *s, *p, *line;
+	int ret = 0;
+
+	s = p = kstrndup(buf, len, GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+
+	while (!ret && (line = strsep(&p, "\n")) != NULL) {
+		line = strim(line);
+		if (!*line)
+			continue;
+		if (!strpbrk(line, " \t"))
+			evl_net_flush_arp(net);
+		else
+			ret = parse_arp_line(net, line);
+	}
+
+	kfree(s);
+
+	return ret ?: len;
 }
 
 int evl_net_init_arp(struct net *net)
@@ -213,6 +768,12 @@ int evl_net_init_arp(struct net *net)
 	if (ret)
 		return ret;
 
+	ret = init_solicit_dir(&nets->ipv4.sdir);
+	if (ret) {
+		evl_flush_cache(cache);
+		return ret;
+	}
+
 	register_netevent_notifier(&netevent_notifier);
 
 	return 0;
@@ -220,6 +781,9 @@ int evl_net_init_arp(struct net *net)
 
 void evl_net_cleanup_arp(struct net *net)
 {
+	struct oob_net_state *nets = &net->oob;
+
 	unregister_netevent_notifier(&netevent_notifier);
-	evl_net_flush_arp(net);
+	cleanup_solicit_dir(&nets->ipv4.sdir);
+	evl_flush_cache(&nets->ipv4.arp);
 }
@@ -10,30 +10,42 @@
 #include <linux/rcupdate.h>
 #include <linux/jhash.h>
 #include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/units.h>
 #include <net/ip.h>
 #include <net/inet_frag.h>
+#include <evl/assert.h>
+#include <evl/list.h>
 #include <evl/memory.h>
+#include <evl/clock.h>
 #include <evl/net/device.h>
 #include <evl/net/skb.h>
 #include <evl/net/ipv4/fragment.h>
 
 /*
- * Fragment expiration handler. Triggers when a fragmented datagram
- * could not be reassembled within the allotted time (IP_FRAG_TIME).
+ * The reassembly state lives in a table of frag trees preallocated
+ * for each network namespace, so that no memory is allocated on the
+ * ingress path. A fragment which cannot be queued because the table
+ * is full or the memory limit would be exceeded is dropped.
+ *
+ * Since all trees share the same lifetime, the aging list which
+ * links them in creation order is also sorted by expiry date. A
+ * single timer is armed for the oldest tree, which tells the RX
+ * thread of the device the fragments came from to sweep the expired
+ * trees in a row.
  */
-static void frag_expired(struct evl_timer *timer)
+
+static void frag_expired(struct evl_timer *timer) /* oob stage stalled */
 {
 	struct evl_net_frag_tdir *ftdir;
-	struct evl_net_frag_tree *ft;
+	struct net_device *dev;
 
-	ft = container_of(timer, struct evl_net_frag_tree, timer);
-	ftdir = ft->tdir;
-	raw_spin_lock(&ftdir->gc.lock);
-	hlist_add_head(&ft->gc, &ftdir->gc.queue);
-	raw_spin_unlock(&ftdir->gc.lock);
+	ftdir = container_of(timer, struct evl_net_frag_tdir, timer);
+	dev = READ_ONCE(ftdir->gc_dev);
+	WRITE_ONCE(ftdir->sweep, true);
 	/* Tell the RX thread to run the garbage collection. */
-	evl_net_wake_rx(ft->gc_dev);
-	netdev_warn(ft->gc_dev, "reassembly timed out, frag tree %px\n", ft);
+	if (dev)
+		evl_net_wake_rx(dev);
 }
 
 static u32 hash_frag_key(const void *data, u32 len)
@@ -47,30 +59,12 @@ static bool compare_frag_key(struct evl_net_frag_tree *ft,
 	return !memcmp(&ft->key.ipv4, key, sizeof(*key));
 }
 
-static struct evl_net_frag_tree *
-alloc_frag_tree(struct evl_net_frag_tdir *ftdir,
-		const struct frag_v4_compare_key *key,
-		struct net_device *dev)
+/* ftdir->lock held. */
+static void arm_frag_timer(struct evl_net_frag_tdir *ftdir,
+			struct evl_net_frag_tree *ft)
 {
-	struct evl_net_frag_tree *ft;
-
-	ft = evl_alloc(sizeof(*ft));
-	if (!ft)
-		return NULL;
-
-	ft->end = 0;
-	ft->len = 0;
-	ft->flags = 0;
-	ft->frags = RB_ROOT;
-	ft->tdir = ftdir;
-	ft->gc_dev = dev;
-	INIT_HLIST_NODE(&ft->gc);
-	ft->key.ipv4 = *key;
-	evl_init_timer(&ft->timer, frag_expired);
-	evl_spin_lock_init(&ft->lock);
-	netdev_dbg(dev, "allocated frag tree %px\n", ft);
-
-	return ft;
+	WRITE_ONCE(ftdir->gc_dev, ft->gc_dev);
+	evl_start_timer(&ftdir->timer, ft->expiry, EVL_INFINITE);
 }
 
 /* ftdir->lock held. */
@@ -87,23 +81,75 @@ get_frag_tree(struct evl_net_frag_tdir *ftdir,
 			return ft;
 	}
 
-	ft = alloc_frag_tree(ftdir, key, dev);
-	if (!ft)
-		return ERR_PTR(-ENOMEM);
+	if (list_empty(&ftdir->free_trees)) {
+		ftdir->stats.table_full++;
+		return ERR_PTR(-ENOBUFS);
+	}
 
+	ft = list_get_entry(&ftdir->free_trees, struct evl_net_frag_tree, next);
+	ft->end = 0;
+	ft->len = 0;
+	ft->flags = 0;
+	ft->frags = RB_ROOT;
+	ft->tail = NULL;
+	ft->mem = 0;
+	ft->gc_dev = dev;
+	ft->key.ipv4 = *key;
+	ft->expiry = ktime_add(evl_read_clock(&evl_mono_clock), ftdir->timeout);
 	hash_add(ftdir->ht, &ft->hash, hashval);
-	netdev_dbg(dev, "hashed frag tree %px\n", ft);
 
 	/* Starts aging only once hashed. */
-	evl_start_timer(&ft->timer,
-			evl_abs_timeout(&ft->timer, ftdir->timeout),
-			0);
+	list_add_tail(&ft->next, &ftdir->aging);
+	if (list_is_singular(&ftdir->aging))
+		arm_frag_timer(ftdir, ft);
+
+	netdev_dbg(dev, "hashed frag tree %px\n", ft);
+
 	return ft;
 }
 
+static struct sk_buff *pop_frag(struct evl_net_frag_tree *ft)
+{
+	struct rb_node *rb = rb_first(&ft->frags);
+
+	if (!rb)
+		return NULL;
+
+	/*
+	 * Unlink first, since ->rbnode is going to be overwritten by
+	 * the caller.
+	 */
+	rb_erase(rb, &ft->frags);
+
+	return rb_entry(rb, struct sk_buff, rbnode);
+}
+
+/*
+ * Drop a frag tree, releasing the fragments it still holds. The tree
+ * goes back to the free list.
+ *
+ * ftdir->lock held.
+ */
+static void drop_frag_tree(struct evl_net_frag_tdir *ftdir,
+			struct evl_net_frag_tree *ft)
+{
+	struct sk_buff *skb;
+
+	while ((skb = pop_frag(ft)) != NULL) {
+		skb->dev = ft->gc_dev;
+		evl_net_free_skb(skb);
+	}
+
+	ftdir->mem -= ft->mem;
+	hash_del(&ft->hash);
+	list_move(&ft->next, &ftdir->free_trees);
+}
+
 /*
  * Index the new fragment into the frag tree on the fragment offset
- * found into the IP header.
+ * found into the IP header. Fragments usually arrive in order, in
+ * which case the new one simply becomes the right child of the
+ * rightmost node, without walking the tree.
  *
  * CAUTION: since ->rbnode and ->dev are unionized in sk_buff, the
  * device the indexed skbs came from can only be found in the heading
@@ -111,12 +157,26 @@ get_frag_tree(struct evl_net_frag_tdir *ftdir,
  *
  * @offset is a count of 8-byte chunks.
  *
- * ftdir->lock and ft->lock held, irqs off.
+ * ftdir->lock held.
  */
 static int index_frag(struct evl_net_frag_tree *ft, int offset, struct sk_buff *skb)
 {
 	struct rb_node **rbp, *parent;
-	int ret = 0;
+	int tail_offset;
+
+	if (ft->tail) {
+		tail_offset = ntohs(ip_hdr(ft->tail)->frag_off) & IP_OFFSET;
+		if (offset > tail_offset) {
+			parent = &ft->tail->rbnode;
+			rbp = &parent->rb_right;
+			ft->tail = skb;
+			goto link;
+		}
+		if (offset == tail_offset)
+			return -EEXIST; /* Duplicate - drop it. */
+	} else {
+		ft->tail = skb;
+	}
 
 	parent = NULL;
 	rbp = &ft->frags.rb_node;
@@ -133,42 +193,34 @@ static int index_frag(struct evl_net_frag_tree *ft, int offset, struct sk_buff *
 		else
 			return -EEXIST; /* Duplicate - drop it. */
 	}
-
+link:
 	rb_link_node(&skb->rbnode, parent, rbp);
 	rb_insert_color(&skb->rbnode, &ft->frags);
 
-	return ret;
+	return 0;
 }
 
 /*
  * Reassemble the datagram, connecting all skbs indexed in the frag
  * tree as a single-linked list in logical offset order. The tree is
- * guaranteed non-empty on entry.
+ * guaranteed non-empty on entry, and empty on return.
  *
  * @ft  the frag tree to reassemble from.
- *
- * No lock held, the frag tree is not hashed, only known to the
- * caller.
  */
-static struct sk_buff *reasm_frag(struct net *net,
-				struct evl_net_frag_tree *ft,
+static struct sk_buff *reasm_frag(struct evl_net_frag_tree *ft,
 				struct net_device *dev)
 {
-	struct rb_node *rb = rb_first(&ft->frags);
 	struct sk_buff *head, **skbp, *fskb;
 
 	/* This has to be the heading packet at offset 0. */
-	head = rb_entry(rb, struct sk_buff, rbnode);
+	head = pop_frag(ft);
 	head->dev = dev;
 	skbp = &skb_shinfo(head)->frag_list;
-	rb = rb_next(rb);
 
-	while (rb) {
-		fskb = rb_entry(rb, struct sk_buff, rbnode);
+	while ((fskb = pop_frag(ft)) != NULL) {
 		fskb->dev = dev;
 		*skbp = fskb;
 		skbp = &fskb->next;
-		rb = rb_next(rb);
 	}
 
 	*skbp = NULL;
@@ -192,10 +244,9 @@ static struct sk_buff *push_frag(struct sk_buff *skb, struct net_device *dev)
 		.id = iph->id,
 		.protocol = iph->protocol,
 	};
-	int offset, floff, end, len, ret;
+	int offset, floff, end, ret;
 	struct evl_net_frag_tree *ft;
 	struct sk_buff *head;
-	unsigned long flags;
 
 	rcu_read_lock();
 	key.vif = l3mdev_master_ifindex_rcu(dev);
@@ -209,8 +260,6 @@ static struct sk_buff *push_frag(struct sk_buff *skb, struct net_device *dev)
 		goto out_notree;
 	}
 
-	evl_spin_lock(&ft->lock);
-
 	floff = ntohs(iph->frag_off);
 	offset = (floff & IP_OFFSET) << 3; /* 8-byte chunks */
 	/*
@@ -223,7 +272,17 @@ static struct sk_buff *push_frag(struct sk_buff *skb, struct net_device *dev)
 		iph->id, ft, ntohs(iph->frag_off), floff & ~IP_OFFSET,
 		ip_hdrlen(skb), &iph->saddr, &iph->daddr);
 
+	if (ftdir->mem + skb->truesize > ftdir->mem_limit) {
+		ftdir->stats.overlimit++;
+		ret = -ENOBUFS;
+		goto out;
+	}
+
 	ret = -EINVAL;
+	/* RFC 791: the reassembled datagram cannot exceed 64k. */
+	if (end + ip_hdrlen(skb) > 65535)
+		goto invalid;
+
 	if (!(floff & IP_MF)) {	/* Last fragment in the series? */
 		/*
 		 * If we were already past the incoming fragment, or
@@ -232,7 +291,7 @@ static struct sk_buff *push_frag(struct sk_buff *skb, struct net_device *dev)
 		 */
 		if (end < ft->end ||
 			((ft->flags & INET_FRAG_LAST_IN) && end != ft->end))
-			goto out;
+			goto invalid;
 
 		ft->flags |= INET_FRAG_LAST_IN;
 		ft->end = end;
@@ -254,14 +313,21 @@ static struct sk_buff *push_frag(struct sk_buff *skb, struct net_device *dev)
 			 * the incoming packet is corrupt.
 			 */
 			if (ft->flags & INET_FRAG_LAST_IN)
-				goto out;
+				goto invalid;
 
 			ft->end = end;
 		}
 	}
 
 	if (end == offset)	/* Zero-sized? Ignore then. */
+		goto invalid;
+
+	netdev_dbg(dev, "indexing frag id=%d\n", iph->id);
+	ret = index_frag(ft, offset >> 3, skb);
+	if (ret) {
+		ftdir->stats.duplicates++;
 		goto out;
+	}
 
 	if (offset == 0) {
 		ft->flags |= INET_FRAG_FIRST_IN;
@@ -270,43 +336,30 @@ static struct sk_buff *push_frag(struct sk_buff *skb, struct net_device *dev)
 
 	/* Update the logical length received (headers stripped). */
 	ft->len += end - offset;
-
-	netdev_dbg(dev, "indexing frag id=%d\n", iph->id);
-	ret = index_frag(ft, offset >> 3, skb);
-	if (ret)
-		goto out;
+	ft->mem += skb->truesize;
+	ftdir->mem += skb->truesize;
 
 	/* If complete, reassemble the datagram. */
 	if (ft->flags == (INET_FRAG_FIRST_IN | INET_FRAG_LAST_IN) &&
 		ft->len == ft->end) {
 		netdev_dbg(dev, "completed frag id=%d, len=%zu\n", iph->id, ft->len);
-		evl_spin_unlock(&ft->lock);
-		/*
-		 * Stop the timer, then move the frag tree out of the
-		 * gc queue if it's linked there.
-		 */
-		evl_stop_timer(&ft->timer);
-		raw_spin_lock_irqsave(&ftdir->gc.lock, flags);
-		if (!hlist_unhashed(&ft->gc))
-			hlist_del(&ft->gc);
-		raw_spin_unlock_irqrestore(&ftdir->gc.lock, flags);
-		/* Covered by ftdir->lock. */
-		hlist_del(&ft->hash);
+		head = reasm_frag(ft, dev);
+		ftdir->stats.reassembled++;
+		drop_frag_tree(ftdir, ft); /* Empty by now. */
 		evl_unlock_kmutex(&ftdir->lock);
-		head = reasm_frag(net, ft, dev);
-		len = ip_hdrlen(skb) + ft->len;
-		evl_free(ft);
-		if (len > 65535) { /* RFC 791 */
-			evl_net_free_skb(head); /* Timer is off, so we have to cleanup manually. */
-			return ERR_PTR(-E2BIG);
-		}
 		return head;
 	}
 
 	/* Tell the caller to wait for more. */
-	ret = -EINPROGRESS;
+	evl_unlock_kmutex(&ftdir->lock);
+
+	return ERR_PTR(-EINPROGRESS);
+invalid:
+	ftdir->stats.invalid++;
 out:
-	evl_spin_unlock(&ft->lock);
+	/* Do not let a tree we could not fill hold a slot. */
+	if (RB_EMPTY_ROOT(&ft->frags))
+		drop_frag_tree(ftdir, ft);
 out_notree:
 	evl_unlock_kmutex(&ftdir->lock);
 
@@ -319,3 +372,100 @@ struct sk_buff *evl_ipv4_defrag(struct sk_buff *skb)
 
 	return push_frag(skb, dev);
 }
+
+/*
+ * Drop the trees which could not be reassembled within the allotted
+ * time (IP_FRAG_TIME), then rearm the timer for the oldest remaining
+ * one. Runs from the RX thread of the device which got the timer
+ * notification.
+ */
+void evl_ipv4_sweep_frags(struct evl_net_frag_tdir *ftdir)
+{
+	struct evl_net_frag_tree *ft, *n;
+	ktime_t now;
+
+	WRITE_ONCE(ftdir->sweep, false);
+
+	evl_lock_kmutex(&ftdir->lock);
+
+	now = evl_read_clock(&evl_mono_clock);
+
+	list_for_each_entry_safe(ft, n, &ftdir->aging, next) {
+		if (ktime_after(ft->expiry, now)) {
+			arm_frag_timer(ftdir, ft);
+			break;
+		}
+		netdev_dbg(ft->gc_dev, "reassembly timed out, frag tree %px\n", ft);
+		ftdir->stats.timeouts++;
+		drop_frag_tree(ftdir, ft);
+	}
+
+	evl_unlock_kmutex(&ftdir->lock);
+}
+
+ssize_t evl_ipv4_show_frag_stats(struct net *net, char *buf, size_t len)
+{
+	struct evl_net_frag_tdir *ftdir = &net->oob.ipv4.ftdir;
+	struct evl_net_frag_stats stats;
+	size_t mem;
+
+	evl_lock_kmutex(&ftdir->lock);
+	stats = ftdir->stats;
+	mem = ftdir->mem;
+	evl_unlock_kmutex(&ftdir->lock);
+
+	return snprintf(buf, len,
+			"ipv4_frags: reassembled=%lu timeouts=%lu table_full=%lu "
+			"overlimit=%lu invalid=%lu duplicates=%lu mem=%zu/%zu\n",
+			stats.reassembled, stats.timeouts, stats.table_full,
+			stats.overlimit, stats.invalid, stats.duplicates,
+			mem, ftdir->mem_limit);
+}
+
+int evl_net_init_ipv4_frags(struct net *net)
+{
+	struct evl_net_frag_tdir *ftdir = &net->oob.ipv4.ftdir;
+	unsigned int n;
+
+	hash_init(ftdir->ht);
+	INIT_LIST_HEAD(&ftdir->free_trees);
+	INIT_LIST_HEAD(&ftdir->aging);
+	evl_init_kmutex(&ftdir->lock);
+	/* Reassembly timeouts may tick on the housekeeping CPU. */
+	evl_init_timer_on_rq(&ftdir->timer, &evl_mono_clock, frag_expired,
+			NULL, EVL_TIMER_IGRAVITY|EVL_TIMER_NONCRIT);
+	ftdir->gc_dev = NULL;
+	ftdir->sweep = false;
+	ftdir->mem = 0;
+	ftdir->mem_limit = EVL_NET_FRAGS_MEM_LIMIT;
+	ftdir->timeout = (ktime_t)IP_FRAG_TIME / HZ * NANOHZ_PER_HZ;
+	memset(&ftdir->stats, 0, sizeof(ftdir->stats));
+
+	ftdir->trees = kcalloc(EVL_NET_FRAGS_MAX_TREES,
+			sizeof(*ftdir->trees), GFP_KERNEL);
+	if (!ftdir->trees) {
+		evl_destroy_timer(&ftdir->timer);
+		return -ENOMEM;
+	}
+
+	for (n = 0; n < EVL_NET_FRAGS_MAX_TREES; n++)
+		list_add_tail(&ftdir->trees[n].next, &ftdir->free_trees);
+
+	return 0;
+}
+
+void evl_net_cleanup_ipv4_frags(struct net *net)
+{
+	struct evl_net_frag_tdir *ftdir = &net->oob.ipv4.ftdir;
+	struct evl_net_frag_tree *ft, *n;
+
+	evl_destroy_timer(&ftdir->timer);
+
+	evl_lock_kmutex(&ftdir->lock);
+	list_for_each_entry_safe(ft, n, &ftdir->aging, next)
+		drop_frag_tree(ftdir, ft);
+	evl_unlock_kmutex(&ftdir->lock);
+
+	EVL_WARN_ON(NET, ftdir->mem != 0);
+	kfree(ftdir->trees);
+}
@@ -26,9 +26,6 @@
  */
 int evl_net_init_ipv4(struct net *net)
 {
-	struct oob_net_state *nets = &net->oob;
-	struct evl_net_frag_tdir *ftdir;
-	struct evl_net_frag_gc *gc;
 	int ret;
 
 	ret = evl_net_init_ipv4_routing(net);
@@ -43,18 +40,14 @@ int evl_net_init_ipv4(struct net *net)
 	if (ret)
 		goto fail_udp;
 
-	/* Fragment directory and friends. */
-	ftdir = &nets->ipv4.ftdir;
-	hash_init(ftdir->ht);
-	evl_init_kmutex(&ftdir->lock);
-	ftdir->timeout = (ktime_t)IP_FRAG_TIME / HZ * NANOHZ_PER_HZ;
-	gc = &ftdir->gc;
-	INIT_HLIST_HEAD(&gc->queue);
-	raw_spin_lock_init(&gc->lock);
-	might_hard_lock(&gc->lock);
+	ret = evl_net_init_ipv4_frags(net);
+	if (ret)
+		goto fail_frags;
 
 	return 0;
 
+fail_frags:
+	evl_net_cleanup_udp(net);
 fail_udp:
 	evl_net_cleanup_arp(net);
 fail_arp:
@@ -65,13 +58,10 @@ fail_arp:
 
 void evl_net_cleanup_ipv4(struct net *net)
 {
-	struct oob_net_state *nets = &net->oob;
-	struct evl_net_frag_gc *gc = &nets->ipv4.ftdir.gc;
-
+	evl_net_cleanup_ipv4_frags(net);
 	evl_net_cleanup_udp(net);
 	evl_net_cleanup_arp(net);
 	evl_net_cleanup_ipv4_routing(net);
-	EVL_WARN_ON(NET, !hlist_empty(&gc->queue));
 }
 
 /*
@@ -165,20 +155,12 @@ int evl_net_ipv4_deliver(struct sk_buff *skb)
 		skb = evl_ipv4_defrag(skb);
 		if (IS_ERR(skb)) {
 			ret = PTR_ERR(skb);
-			switch (ret) {
-			case -EINPROGRESS:
-			case -E2BIG:
-				/*
-				 * We don't want the caller to drop
-				 * the skb, either because we are
-				 * waiting for more data to reassemble
-				 * the datagram, or we did the cleanup
-				 * already.
-				 */
-				return 0;
-			default:
-				return ret;
-			}
+			/*
+			 * We don't want the caller to drop the skb
+			 * if we are waiting for more data to
+			 * reassemble the datagram.
+			 */
+			return ret == -EINPROGRESS ? 0 : ret;
 		}
 	}
 
@@ -208,24 +190,7 @@ int evl_net_ipv4_deliver(struct sk_buff *skb)
  */
 void __evl_net_ipv4_gc(struct evl_net_frag_tdir *ftdir)
 {
-	struct evl_net_frag_tree *ft;
-	struct hlist_head tmp;
-	struct hlist_node *n;
-	unsigned long flags;
-
-	raw_spin_lock_irqsave(&ftdir->gc.lock, flags);
-	hlist_move_list(&ftdir->gc.queue, &tmp);
-	raw_spin_unlock_irqrestore(&ftdir->gc.lock, flags);
-
-	evl_lock_kmutex(&ftdir->lock);
-
-	hlist_for_each_entry_safe(ft, n, &tmp, gc) {
-		netdev_dbg(ft->gc_dev, "free frag tree %px\n", ft);
-		hlist_del(&ft->hash);
-		evl_free(ft);
-	}
-
-	evl_unlock_kmutex(&ftdir->lock);
+	evl_ipv4_sweep_frags(ftdir);
 }
 
 static struct evl_net_proto *match_ipv4_domain(int type, int protocol)
@@ -9,6 +9,7 @@
 #include <linux/if_vlan.h>
 #include <net/inet_sock.h>
 #include <net/ip.h>
+#include <net/checksum.h>
 #include <evl/random.h>
 #include <evl/net/socket.h>
 #include <evl/net/device.h>
@@ -39,6 +40,44 @@ static void fill_ipv4_header(struct iphdr *iph,
 	iph->protocol = ipc->protocol;
 }
 
+/*
+ * Pull the buffers needed for a whole datagram from the device pool
+ * before any data is copied, so that we either wait for congestion
+ * to clear or fail early, instead of leaving a partially built
+ * datagram behind. The fragments are linked to the frag_list of the
+ * heading buffer, each of them reserving room for the link and
+ * network headers.
+ */
+static struct sk_buff *alloc_datagram(struct evl_socket *esk,
+				struct net_device *real_dev,
+				unsigned int nr_frags,
+				ktime_t timeout)
+{
+	struct sk_buff *head, *skb, **skbp;
+
+	head = evl_net_wget_skb(esk, real_dev, timeout);
+	if (IS_ERR(head))
+		return head;
+
+	skb_reserve(head, real_dev->hard_header_len + sizeof(struct iphdr));
+	skbp = &skb_shinfo(head)->frag_list;
+	*skbp = NULL;
+
+	while (--nr_frags > 0) {
+		skb = evl_net_wget_skb(esk, real_dev, timeout);
+		if (IS_ERR(skb)) {
+			evl_net_wput_skb(head);
+			return skb;
+		}
+		skb_reserve(skb, real_dev->hard_header_len + sizeof(struct iphdr));
+		skb->next = NULL;
+		*skbp = skb;
+		skbp = &skb->next;
+	}
+
+	return head;
+}
+
 /*
  * Create an IPv4 datagram from the contents referred to by a
  * user-provided I/O vector.
@@ -53,10 +92,26 @@ static void fill_ipv4_header(struct iphdr *iph,
  *
  * We make the following assumptions:
  *
- * - no GSO for out-of-band traffic.
+ * - no hardware GSO for out-of-band traffic.
  * - always output frags when required (IP_DF never ignored).
  * - scatter-gather capability of the device is ignored (NETIF_F_SG).
  *
+ * Datagrams larger than the path MTU are fragmented in place: the
+ * chain of buffers is sized from the MTU and allocated at once from
+ * the device pool, then each fragment is filled with up to
+ * maxfraglen bytes. A datagram which could never fit into the pool
+ * is rejected with -EMSGSIZE.
+ *
+ * @iov is consumed as data is copied, so that successive calls may
+ * carve consecutive datagrams out of a single vector.
+ *
+ * If the datagram fits in a single frame and the NIC can checksum it,
+ * ipc->hw_csum is set. Otherwise, the checksum of the payload is
+ * accumulated into ipc->csum as each chunk is copied, while it is
+ * still hot in the cache. If ipc->pinned is set, chunks covered by a
+ * pinned user buffer are read from its kernel mapping instead (see
+ * evl_net_load_payload()).
+ *
  * This routine reserves the space for a transport header in the
  * leading skb if ipc->transhdrlen > 0. The caller is expected to
  * update it eventually.
@@ -73,13 +128,13 @@ struct sk_buff *evl_net_ipv4_build_datagram(struct evl_socket *esk,
 {
 	struct net_device *dev = evl_net_route_dev(ert),
 		*real_dev = evl_net_real_dev(dev);
-	size_t maxfraglen, chunksz, i_offset = 0,
-		offset = 0, thdrlen = 0;
-	struct sk_buff *head = NULL, *skb, **skbp = NULL;
+	size_t maxfraglen, chunksz, offset = 0, thdrlen = 0;
 	struct dst_entry *dst = evl_net_route_dst(ert);
 	struct sock *sk = esk->sk;
 	struct inet_sock *inet = inet_sk(sk);
-	int mtu, n = 0, ret = 0;
+	struct sk_buff *head, *skb;
+	unsigned int nr_frags;
+	int mtu, n = 0, ret;
 	__be16 id = 0, df = 0;
 	struct iphdr *iph;
 	__u16 frag_off;
@@ -96,48 +151,48 @@ struct sk_buff *evl_net_ipv4_build_datagram(struct evl_socket *esk,
 	if (!inetdev_valid_mtu(mtu))
 		return ERR_PTR(-ENETUNREACH); /* Smaller than min ipv4 MTU? */
 
-	/* Room for payload in an IP frag aligned on 8-byte boundary. */
+	/*
+	 * Room for payload in an IP frag aligned on 8-byte
+	 * boundary. The transport header counts as payload, and
+	 * only goes to the heading fragment.
+	 */
 	maxfraglen = (mtu - sizeof(*iph)) & ~7;
-	if (datalen > maxfraglen) {
+	nr_frags = DIV_ROUND_UP(datalen + ipc->transhdrlen, maxfraglen);
+	if (nr_frags > real_dev->oob_state.estate->pool_limit)
+		return ERR_PTR(-EMSGSIZE);
+
+	if (nr_frags > 1) {
 		id = evl_read_rng_u16();
 	} else if (datalen <= IPV4_MIN_MTU || ip_dont_fragment(sk, evl_net_route_dst(ert))) {
 		df = htons(IP_DF);
 	}
 
+	ipc->csum = 0;
+	ipc->hw_csum = nr_frags == 1 &&
+		evl_net_can_offload_csum(dev, NETIF_F_IP_CSUM);
+
 	netdev_dbg(dev, "build dgram: src=%pI4, dst=%pI4, mtu=%d, "
-		   " transhdrlen=%d, maxfraglen=%zd\n",
-		   &ipc->saddr, &ipc->daddr, mtu, ipc->transhdrlen, maxfraglen);
+		   " transhdrlen=%d, maxfraglen=%zd, frags=%u\n",
+		   &ipc->saddr, &ipc->daddr, mtu, ipc->transhdrlen,
+		   maxfraglen, nr_frags);
 
-	for (;;) {
-		skb = evl_net_wget_skb(esk, real_dev, timeout);
-		if (IS_ERR(skb)) {
-			ret = PTR_ERR(skb);
-			goto fail;
-		}
+	head = alloc_datagram(esk, real_dev, nr_frags, timeout);
+	if (IS_ERR(head))
+		return head;
 
-		skb_reserve(skb, real_dev->hard_header_len + sizeof(*iph));
-
-		if (skbp) {
-			skb->next = NULL;
-			*skbp = skb;
-			skbp = &skb->next;
-		} else {
-			head = skb;
-			skb_shinfo(skb)->frag_list = NULL;
-			skbp = &skb_shinfo(skb)->frag_list;
-			/*
-			 * Reserve the required space to store the
-			 * transport header in the first skb. As far
-			 * as we are concerned, this is part of the
-			 * payload.
-			 */
-			if (ipc->transhdrlen > 0) {
-				skb_reserve(skb, ipc->transhdrlen);
-				skb_push(skb, ipc->transhdrlen);
-				skb_reset_transport_header(skb);
-			}
-		}
+	/*
+	 * Reserve the required space to store the transport header
+	 * in the first skb. As far as we are concerned, this is part
+	 * of the payload.
+	 */
+	if (ipc->transhdrlen > 0) {
+		skb_reserve(head, ipc->transhdrlen);
+		skb_push(head, ipc->transhdrlen);
+		skb_reset_transport_header(head);
+	}
 
+	for (skb = head; skb; skb = skb == head ?
+		     skb_shinfo(head)->frag_list : skb->next) {
 		skb->ip_summed = CHECKSUM_NONE;
 		skb->csum = 0;
 		/* To be used as the VLAN priority by the hw layer. */
@@ -152,23 +207,26 @@ struct sk_buff *evl_net_ipv4_build_datagram(struct evl_socket *esk,
 				if (++n >= iovlen)
 					break;
 				iov++;
-				i_offset = 0;
 				continue;
 			}
 
 			chunksz = iov->iov_len;
 			if (chunksz > maxfraglen - skb->len)
 				chunksz = maxfraglen - skb->len;
+			if (chunksz > datalen - offset)
+				chunksz = datalen - offset;
 
 			data = skb_put(skb, chunksz);
-			ret = raw_copy_from_user(data, iov->iov_base + i_offset, chunksz);
+			ret = evl_net_load_payload(data, iov->iov_base, chunksz,
+					ipc->hw_csum ? NULL : &ipc->csum,
+					offset, ipc->pinned);
 			if (ret)
 				goto fail;
 
 			iov->iov_len -= chunksz;
-			i_offset += chunksz; /* input offset (in current vector cell) */
+			iov->iov_base += chunksz;
 			offset += chunksz;   /* virtual packet offset (frag-insensitive) */
-		} while (skb->len < maxfraglen);
+		} while (skb->len < maxfraglen && offset < datalen);
 
 		/* Account for the transport header past the heading packet. */
 		thdrlen = ipc->transhdrlen;
@@ -177,20 +235,19 @@ struct sk_buff *evl_net_ipv4_build_datagram(struct evl_socket *esk,
 		fill_ipv4_header(iph, inet, dst, ipc);
 		iph->tot_len = htons(skb->len);
 		iph->id = id;
-		if (offset < datalen) {
-			iph->frag_off = frag_off | htons(IP_MF);
-			ip_send_check(iph);
-		} else {
-			iph->frag_off = frag_off | df;
-			ip_send_check(iph);
-			break;
-		}
+		iph->frag_off = frag_off | (offset < datalen ? htons(IP_MF) : df);
+		ip_send_check(iph);
+	}
+
+	/* The I/O vector was shorter than advertised. */
+	if (EVL_WARN_ON(NET, offset < datalen)) {
+		ret = -EINVAL;
+		goto fail;
 	}
 
 	return head;
 fail:
-	if (head)
-		evl_net_wput_skb(head);
+	evl_net_wput_skb(head);
 
 	return ERR_PTR(ret);
 }
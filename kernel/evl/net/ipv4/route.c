@@ -5,6 +5,8 @@
  */
 
 #include <linux/slab.h>
+#include <linux/inet.h>
+#include <linux/string.h>
 #include <net/route.h>
 #include <net/ip.h>
 #include <evl/net/ipv4/route.h>
@@ -73,17 +75,80 @@ static bool compare_route_dev(struct evl_cache_entry *entry, void *arg)
 	return dev == evl_net_route_dev(ert);
 }
 
+static bool match_learned_route(struct evl_cache_entry *entry, void *arg)
+{
+	return !container_of(entry, struct evl_net_route, entry)->pinned;
+}
+
+/*
+ * Drop the routes via @dev, pinned or not. Otherwise, drop all the
+ * learned routes if @dev is NULL, leaving the pinned ones in place.
+ */
 static inline void flush_route_cache(struct net *net, struct net_device *dev)
 {
 	if (dev)
 		evl_clean_cache(&net->oob.ipv4.routes, compare_route_dev, dev);
 	else
-		evl_flush_cache(&net->oob.ipv4.routes);
+		evl_clean_cache(&net->oob.ipv4.routes, match_learned_route, NULL);
 }
 
 void evl_net_cleanup_ipv4_routing(struct net *net)
 {
-	flush_route_cache(net, NULL);
+	evl_flush_cache(&net->oob.ipv4.routes);
+}
+
+/* in-band, cache locked */
+static bool is_pinned_locked(struct evl_cache *cache, __be32 daddr)
+{
+	struct evl_cache_entry *entry;
+	bool pinned;
+
+	entry = evl_lookup_cache(cache, &daddr);
+	if (!entry)
+		return false;
+
+	pinned = container_of(entry, struct evl_net_route, entry)->pinned;
+	evl_put_cache_entry(entry);
+
+	return pinned;
+}
+
+/*
+ * Cache a route to @daddr, consuming the reference on @rt. A pinned
+ * route may only be replaced by another pinned route.
+ */
+static int add_ipv4_route(struct net *net, __be32 daddr,
+			struct rtable *rt, bool pinned) /* in-band */
+{
+	struct evl_cache *cache = &net->oob.ipv4.routes;
+	struct evl_net_route *e;
+	int ret;
+
+	e = kzalloc(sizeof(*e) + sizeof(daddr), GFP_ATOMIC);
+	if (!e) {
+		ip_rt_put(rt);
+		return -ENOMEM;
+	}
+
+	e->rt = rt;
+	e->pinned = pinned;
+	*(__be32 *)e->key = daddr;
+
+	evl_lock_cache(cache);
+
+	if (pinned || !is_pinned_locked(cache, daddr))
+		ret = evl_add_cache_entry_locked(cache, &e->entry);
+	else
+		ret = -EEXIST;
+
+	evl_unlock_cache(cache);
+
+	if (ret) {
+		ip_rt_put(e->rt);
+		kfree(e);
+	}
+
+	return ret == -EEXIST ? 0 : ret;
 }
 
 /*
@@ -95,37 +160,26 @@ void evl_net_cleanup_ipv4_routing(struct net *net)
 void evl_net_learn_ipv4_route(struct net *net,
 			struct flowi4 *fl4, struct rtable *rt) /* in-band */
 {
-	struct oob_net_state *nets = &net->oob;
 	struct net_device *dev = rt->dst.dev;
 	struct evl_net_route *e;
-	int ret;
+	struct rtable *clone;
 
 	netdev_dbg(dev, "learning ipv4 route: %pI4 -> %pI4 via %s\n",
 		   &fl4->saddr, &fl4->daddr, netdev_name(dev));
 
 	e = evl_net_get_ipv4_route(net, fl4->daddr);
-	if (e && e->rt->dst.dev == dev) {
+	if (e && (e->pinned || e->rt->dst.dev == dev)) {
 		evl_net_put_route(e);
 		return;
 	}
 
-	e = kzalloc(sizeof(*e) + sizeof(fl4->daddr), GFP_ATOMIC);
-	if (!e)
-		goto warn;
+	if (e)
+		evl_net_put_route(e);
 
-	e->rt = rt_dst_clone(dev, rt);
-	*(__be32 *)e->key = fl4->daddr;
 	netdev_dbg(dev, "caching route to %pI4\n", &fl4->daddr);
-	ret = evl_add_cache_entry(&nets->ipv4.routes, &e->entry);
-	if (ret) {
-		ip_rt_put(e->rt);
-		kfree(e);
-		goto warn;
-	}
-
-	return;
-warn:
-	printk(EVL_WARNING "out of memory for IPv4 route cache\n");
+	clone = rt_dst_clone(dev, rt);
+	if (!clone || add_ipv4_route(net, fl4->daddr, clone, false))
+		printk(EVL_WARNING "out of memory for IPv4 route cache\n");
 }
 
 /*
@@ -151,3 +205,78 @@ void evl_net_flush_ipv4_routes(struct net *net, struct net_device *dev)
 {
 	flush_route_cache(net, dev);
 }
+
+/*
+ * Parse one line written to the ipv4_routes attribute:
+ *
+ * "<ipv4> [<ifname>]" resolves then pins a route to a destination,
+ * optionally forcing the output device,
+ * "-<ipv4>" removes it.
+ */
+static int parse_route_line(struct net *net, const char *line) /* in-band */
+{
+	char addr[INET_ADDRSTRLEN], ifname[IFNAMSIZ];
+	struct net_device *dev;
+	struct rtable *rt;
+	__be32 daddr;
+	int oif = 0;
+	bool del;
+	int ret;
+
+	del = *line == '-';
+	ret = sscanf(line + del, "%15s %15s", addr, ifname);
+	if (ret < 1 || (del && ret > 1) ||
+		!in4_pton(addr, -1, (u8 *)&daddr, -1, NULL))
+		return -EINVAL;
+
+	if (del) {
+		evl_del_cache_entry(&net->oob.ipv4.routes, &daddr);
+		return 0;
+	}
+
+	if (ret > 1) {
+		dev = dev_get_by_name(net, ifname);
+		if (!dev)
+			return -ENODEV;
+		oif = dev->ifindex;
+		dev_put(dev);
+	}
+
+	rt = ip_route_output(net, daddr, 0, 0, oif, RT_SCOPE_UNIVERSE);
+	if (IS_ERR(rt))
+		return PTR_ERR(rt);
+
+	return add_ipv4_route(net, daddr, rt, true);
+}
+
+/*
+ * Store handler for the ipv4_routes attribute, which accepts one
+ * pinned route to add or remove per line, see parse_route_line(). A
+ * single word which is not an address flushes the learned routes
+ * like any write used to.
+ */
+ssize_t evl_net_store_ipv4_routes(struct net *net, const char *buf, size_t len)
+{
+	char *s, *p, *line;
+	__be32 daddr;
+	int ret = 0;
+
+	s = p = kstrndup(buf, len, GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+
+	while (!ret && (line = strsep(&p, "\n")) != NULL) {
+		line = strim(line);
+		if (!*line)
+			continue;
+		if (*line != '-' && !strpbrk(line, " \t") &&
+			!in4_pton(line, -1, (u8 *)&daddr, -1, NULL))
+			flush_route_cache(net, NULL);
+		else
+			ret = parse_route_line(net, line);
+	}
+
+	kfree(s);
+
+	return ret ?: len;
+}
@@ -23,13 +23,26 @@
 #include <evl/net/ipv4/route.h>
 #include <evl/net/ipv4/arp.h>
 #include <evl/net/ipv4/udp.h>
+#include <uapi/evl/net/udp-abi.h>
 
 #define EVL_NET_UDP_CACHE_SHIFT  8
+#define EVL_NET_UDP_MCAST_CACHE_SHIFT  4
 
 /* in-band. */
 static int attach_udp_socket(struct evl_socket *esk,
 			struct evl_net_proto *proto, int protocol)
 {
+	struct evl_net_udp_rxq *rxq;
+
+	rxq = kzalloc(sizeof(*rxq), GFP_KERNEL);
+	if (!rxq)
+		return -ENOMEM;
+
+	INIT_LIST_HEAD(&rxq->queue);
+	evl_init_wait(&rxq->wait, &evl_mono_clock, 0);
+	rxq->cpu = -1;
+	rxq->esk = esk;
+	esk->u.ip.udp.rxq = rxq;
 	esk->proto = proto;
 	esk->protocol = protocol;
 	evl_net_init_ip_socket(esk);
@@ -44,16 +57,21 @@ static int attach_udp_socket(struct evl_socket *esk,
  * mechanism to deal with this information since it supports
  * inband-only updates, inband/oob lookups.
  *
+ * The slot gathers the receive queues of all the sockets sharing the
+ * [addr, port] pair via SO_REUSEPORT, @esk joining the group.
+ *
  * @esk->sk is locked on entry.
  */
 static int add_receive_slot(struct evl_socket *esk) /* inband */
 {
 	struct evl_cache *cache = &esk->net->oob.ipv4.udp;
+	struct evl_net_udp_rxq *rxq = esk->u.ip.udp.rxq;
 	struct inet_sock *inet = inet_sk(esk->sk);
-	struct evl_net_udp_receiver *new, *old;
+	struct evl_net_udp_receiver *new, *e;
 	struct evl_cache_entry *entry;
 	struct __evl_net_udp_key key;
-	int ret;
+	unsigned long flags;
+	int ret = 0;
 
 	/*
 	 * Allocate without holding any lock to eliminate any risk of
@@ -76,40 +94,49 @@ static int add_receive_slot(struct evl_socket *esk) /* inband */
 	key.daddr = inet->inet_rcv_saddr;
 
 	new->key = key;
-	INIT_LIST_HEAD(&new->queue);
-	evl_init_wait(&new->wait, &evl_mono_clock, 0);
-	refcount_set(&new->refs, 1);
+	raw_spin_lock_init(&new->lock);
+	new->fanout = EVL_UDP_FANOUT_HASH;
 
-	/* Lookup and insertion must be seen as atomic. */
+	/*
+	 * Lookup and insertion must be seen as atomic, so are member
+	 * updates with respect to drop_receive_slot().
+	 */
 	evl_lock_cache(cache);
 	entry = evl_lookup_cache(cache, &key);
 	if (entry) {
-		/* Unlock prior to freeing the slot (see above). */
-		evl_unlock_cache(cache);
-		old = container_of(entry, struct evl_net_udp_receiver, entry);
+		e = container_of(entry, struct evl_net_udp_receiver, entry);
 		/* One user more via reuseport, account for it. */
-		refcount_inc(&old->refs);
+		raw_spin_lock_irqsave(&e->lock, flags);
+		if (e->nr_members < EVL_NET_UDP_MAX_FANOUT)
+			e->members[e->nr_members++] = rxq;
+		else
+			ret = -EADDRINUSE;
+		raw_spin_unlock_irqrestore(&e->lock, flags);
 		evl_put_cache_entry(entry);
+		/* Unlock prior to freeing the slot (see above). */
+		evl_unlock_cache(cache);
 		kfree(new);
-		new = old;
 	} else {
-		ret = evl_add_cache_entry_locked(cache, &new->entry);
+		e = new;
+		e->members[0] = rxq;
+		e->nr_members = 1;
+		ret = evl_add_cache_entry_locked(cache, &e->entry);
 		evl_unlock_cache(cache);
-		if (ret) {
+		if (ret)
 			kfree(new);
-			return ret;
-		}
 	}
 
-	WRITE_ONCE(esk->u.ip.udp.receiver, new);
+	if (!ret)
+		WRITE_ONCE(esk->u.ip.udp.receiver, e);
 
-	return 0;
+	return ret;
 }
 
 /*
  * drop_receive_slot - remove a receive slot previously installed by
- * add_receive_slot(). Slots a refcounted, so that SO_REUSEPORT is
- * dealt with.
+ * add_receive_slot(). @esk leaves the group of sockets sharing the
+ * slot, which goes away with the last member (SO_REUSEPORT). The
+ * datagrams still pending on the socket are dropped.
  *
  * @esk->sk is either locked on entry, or not known from anyone else
  * (i.e. zombie state).
@@ -117,16 +144,45 @@ static int add_receive_slot(struct evl_socket *esk) /* inband */
 static void drop_receive_slot(struct evl_socket *esk) /* inband */
 {
 	struct evl_cache *cache = &esk->net->oob.ipv4.udp;
+	struct evl_net_udp_rxq *rxq = esk->u.ip.udp.rxq;
 	struct evl_net_udp_receiver *e;
 	struct __evl_net_udp_key key;
+	unsigned long flags;
+	unsigned int n;
+	bool last;
+	LIST_HEAD(tmp);
 
 	e = READ_ONCE(esk->u.ip.udp.receiver);
-	if (e && refcount_dec_and_test(&e->refs)) {
+	if (!e)
+		return;
+
+	evl_lock_cache(cache);
+
+	raw_spin_lock_irqsave(&e->lock, flags);
+	for (n = 0; n < e->nr_members; n++) {
+		if (e->members[n] == rxq) {
+			e->members[n] = e->members[--e->nr_members];
+			break;
+		}
+	}
+	last = e->nr_members == 0;
+	raw_spin_unlock_irqrestore(&e->lock, flags);
+
+	if (last) {
 		key.dport = e->key.dport;
 		key.daddr = e->key.daddr;
-		evl_del_cache_entry(cache, &key);
-		WRITE_ONCE(esk->u.ip.udp.receiver, NULL);
+		evl_del_cache_entry_locked(cache, &key);
 	}
+
+	evl_unlock_cache(cache);
+
+	WRITE_ONCE(esk->u.ip.udp.receiver, NULL);
+
+	/* No more input can reach rxq, flush what is left. */
+	raw_spin_lock_irqsave(&rxq->wait.wchan.lock, flags);
+	list_splice_init(&rxq->queue, &tmp);
+	raw_spin_unlock_irqrestore(&rxq->wait.wchan.lock, flags);
+	evl_net_free_skb_list(&tmp);
 }
 
 /*
@@ -139,7 +195,105 @@ static void drop_receive_slot(struct evl_socket *esk) /* inband */
  */
 static void destroy_udp_socket(struct evl_socket *esk) /* inband */
 {
+	struct evl_net_udp_rxq *rxq = esk->u.ip.udp.rxq;
+
 	drop_receive_slot(esk);
+	evl_destroy_wait(&rxq->wait);
+	kfree(rxq);
+}
+
+/*
+ * in-band hook called by IP_ADD_MEMBERSHIP and friends, rtnl_lock
+ * held. The in-band stack deals with IGMP and the device filters, we
+ * only have to remember which oob sockets should receive the
+ * datagrams sent to @group via the device at @ifindex.
+ */
+int ip_mc_join_oob_group(struct sock *sk, __be32 group, int ifindex)
+{
+	struct evl_socket *esk = sk->sk_oob_ctx;
+	struct evl_net_udp_mcast *new, *m;
+	struct __evl_net_mcast_key key;
+	struct evl_cache_entry *entry;
+	struct evl_cache *cache;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!esk || esk->proto != &evl_net_udp_proto)
+		return 0;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+
+	key.group = group;
+	key.ifindex = ifindex;
+	new->key = key;
+	raw_spin_lock_init(&new->lock);
+
+	cache = &esk->net->oob.ipv4.mcast;
+	evl_lock_cache(cache);
+	entry = evl_lookup_cache(cache, &key);
+	if (entry) {
+		m = container_of(entry, struct evl_net_udp_mcast, entry);
+		raw_spin_lock_irqsave(&m->lock, flags);
+		if (m->nr_members < EVL_NET_UDP_MAX_MCAST)
+			m->members[m->nr_members++] = esk;
+		else
+			ret = -ENOBUFS;
+		raw_spin_unlock_irqrestore(&m->lock, flags);
+		evl_put_cache_entry(entry);
+		evl_unlock_cache(cache);
+		kfree(new);
+	} else {
+		new->members[0] = esk;
+		new->nr_members = 1;
+		ret = evl_add_cache_entry_locked(cache, &new->entry);
+		evl_unlock_cache(cache);
+		if (ret)
+			kfree(new);
+	}
+
+	return ret;
+}
+
+/* in-band hook, rtnl_lock held. */
+void ip_mc_leave_oob_group(struct sock *sk, __be32 group, int ifindex)
+{
+	struct evl_socket *esk = sk->sk_oob_ctx;
+	struct __evl_net_mcast_key key;
+	struct evl_cache_entry *entry;
+	struct evl_net_udp_mcast *m;
+	struct evl_cache *cache;
+	unsigned long flags;
+	unsigned int n;
+	bool last;
+
+	if (!esk || esk->proto != &evl_net_udp_proto)
+		return;
+
+	key.group = group;
+	key.ifindex = ifindex;
+	cache = &esk->net->oob.ipv4.mcast;
+	evl_lock_cache(cache);
+
+	entry = evl_lookup_cache(cache, &key);
+	if (entry) {
+		m = container_of(entry, struct evl_net_udp_mcast, entry);
+		raw_spin_lock_irqsave(&m->lock, flags);
+		for (n = 0; n < m->nr_members; n++) {
+			if (m->members[n] == esk) {
+				m->members[n] = m->members[--m->nr_members];
+				break;
+			}
+		}
+		last = m->nr_members == 0;
+		raw_spin_unlock_irqrestore(&m->lock, flags);
+		evl_put_cache_entry(entry);
+		if (last)
+			evl_del_cache_entry_locked(cache, &key);
+	}
+
+	evl_unlock_cache(cache);
 }
 
 /*
@@ -156,6 +310,9 @@ static int bind_udp_socket(struct evl_socket *esk,
 			struct sockaddr *addr,
 			int len)
 {
+	/* Leave the wildcard slot receive_udp() may have forced. */
+	drop_receive_slot(esk);
+
 	return add_receive_slot(esk);
 }
 
@@ -190,9 +347,11 @@ static ssize_t offload_send_udp(struct evl_socket *esk,
 /*
  * Given an IPv4 address, look into our oob route and ARP front caches
  * to find an egress path. If we cannot find a route to the next hop
- * through an oob-enabled device, or we don't know the hardware
- * address of this peer, then the caller will have to pass on the
- * datagram to the in-band stack.
+ * through an oob-enabled device, then the caller will have to pass on
+ * the datagram to the in-band stack. If we don't know the hardware
+ * address of an on-link peer, we may resolve it from the oob stage,
+ * in which case *earpp is NULL on return. Otherwise, the datagram
+ * goes in-band too.
  */
 static bool find_egress_path(struct evl_socket *esk, __be32 daddr,
 			struct evl_net_route **ertp, struct evl_net_arp_entry **earpp)
@@ -206,7 +365,11 @@ static bool find_egress_path(struct evl_socket *esk, __be32 daddr,
 		dev = _ert->rt->dst.dev;
 		if (netif_oob_port(dev)) {
 			_earp = evl_net_get_arp_entry(dev, daddr);
-			if (likely(_earp))  {
+			if (likely(_earp) ||
+				(!_ert->rt->rt_uses_gateway &&
+					!ipv4_is_multicast(daddr) &&
+					!ipv4_is_lbcast(daddr) &&
+					evl_net_solicit_arp(dev, daddr))) {
 				*ertp = _ert;
 				*earpp = _earp;
 				return true;
@@ -238,7 +401,10 @@ static inline __wsum checksum_datagram(struct sk_buff *skb)
 
 /*
  * Send a datagram - which might be fragmented - to the peer we have
- * an ARP entry for.
+ * an ARP entry for, or queue it until the resolution in progress
+ * completes if @earp is NULL. The payload checksum was either
+ * computed on the fly by evl_net_ipv4_build_datagram(), or is left
+ * to the NIC.
  */
 static int send_datagram(struct sk_buff *skb, struct net_device *dev,
 			struct evl_net_arp_entry *earp,
@@ -258,15 +424,27 @@ static int send_datagram(struct sk_buff *skb, struct net_device *dev,
 	uh->source = sport;
 	uh->dest = dport;
 	uh->len = htons(ulen);
-	uh->check = 0; /* Caution: checksum_datagram() reads this too. */
-	uh->check = csum_tcpudp_magic(ipc->saddr, ipc->daddr,
-				ulen, IPPROTO_UDP, checksum_datagram(skb));
-	if (uh->check == 0)
-		uh->check = CSUM_MANGLED_0;
+	uh->check = 0;
 
-	skb->ip_summed = CHECKSUM_NONE;
+	if (ipc->hw_csum) {
+		uh->check = ~csum_tcpudp_magic(ipc->saddr, ipc->daddr,
+					ulen, IPPROTO_UDP, 0);
+		skb->ip_summed = CHECKSUM_PARTIAL;
+		skb->csum_start = skb_transport_header(skb) - skb->head;
+		skb->csum_offset = offsetof(struct udphdr, check);
+	} else {
+		uh->check = csum_tcpudp_magic(ipc->saddr, ipc->daddr,
+					ulen, IPPROTO_UDP,
+					csum_partial(uh, sizeof(*uh), ipc->csum));
+		if (uh->check == 0)
+			uh->check = CSUM_MANGLED_0;
+		skb->ip_summed = CHECKSUM_NONE;
+	}
 
-	ret = evl_net_ether_transmit(dev, skb, earp->ha);
+	if (likely(earp))
+		ret = evl_net_ether_transmit(dev, skb, earp->ha);
+	else
+		ret = evl_net_defer_arp_xmit(dev, ipc->daddr, skb);
 	if (ret)
 		evl_net_wput_skb(skb);
 
@@ -287,6 +465,7 @@ static ssize_t send_udp(struct evl_socket *esk,
 	struct evl_net_route *ert;
 	struct msghdr msg = { 0 };
 	struct __evl_timespec uts;
+	size_t segsz, seglen, offset;
 	ssize_t datalen, ret;
 	enum evl_tmode tmode;
 	__u32 msg_flags = 0;
@@ -305,8 +484,10 @@ static ssize_t send_udp(struct evl_socket *esk,
 	/*
 	 * Unlike BSD, we accept MSG_DONTWAIT to decline waiting on
 	 * skb contention, or offloading to the in-band stage.
+	 * MSG_ZEROCOPY reads the payload from pinned user buffers
+	 * when possible.
 	 */
-	if (msg_flags & ~MSG_DONTWAIT)
+	if (msg_flags & ~(MSG_DONTWAIT|MSG_ZEROCOPY))
 		return -EINVAL;
 
 	if (evl_socket_f_flags(esk) & O_NONBLOCK)
@@ -380,6 +561,9 @@ static ssize_t send_udp(struct evl_socket *esk,
 		ret = offload_send_udp(esk, &kvec, ret, namelen ? &in_addr : NULL);
 		if (ret < 0)
 			return ret;
+
+		if (msg_flags & MSG_ZEROCOPY)
+			evl_net_report_zerocopy(esk);
 		/*
 		 * EVL-specific: we had to pass on the request to the
 		 * in-band stage for routing and/or MAC address
@@ -411,20 +595,46 @@ static ssize_t send_udp(struct evl_socket *esk,
 	ipc.daddr = daddr;
 	ipc.protocol = IPPROTO_UDP;
 	ipc.transhdrlen = sizeof(struct udphdr);
-	skb = evl_net_ipv4_build_datagram(esk, iov, iovlen, ert,
-					datalen, timeout, &ipc);
-	if (IS_ERR_OR_NULL(skb)) {
-		ret = PTR_ERR(skb);
-		goto out;
+	ipc.pinned = !!(msg_flags & MSG_ZEROCOPY);
+
+	/*
+	 * With UDP_SEGMENT set, carve consecutive datagrams of at
+	 * most segsz bytes out of the I/O vector, each one going
+	 * through the qdisc like any other message would.
+	 */
+	segsz = READ_ONCE(udp_sk(sk)->gso_size) ?: datalen;
+
+	for (offset = 0; offset < datalen; offset += seglen) {
+		seglen = min_t(size_t, datalen - offset, segsz);
+		skb = evl_net_ipv4_build_datagram(esk, iov, iovlen, ert,
+						seglen, timeout, &ipc);
+		if (IS_ERR_OR_NULL(skb)) {
+			ret = PTR_ERR(skb);
+			break;
+		}
+
+		ret = evl_net_prepare_tx(esk, u_msghdr, skb);
+		if (ret) {
+			evl_net_wput_skb(skb);
+			break;
+		}
+
+		ret = send_datagram(skb, ert->rt->dst.dev, earp, &ipc,
+				dport, inet->inet_sport, seglen);
+		if (ret)
+			break;
 	}
 
-	ret = send_datagram(skb, ert->rt->dst.dev, earp, &ipc,
-			dport, inet->inet_sport, datalen);
-out:
-	evl_net_put_arp_entry(earp);
+	if (earp)
+		evl_net_put_arp_entry(earp);
 	evl_net_put_route(ert);
 
-	return ret ?: datalen;
+	/* The payload was copied, the user buffer is free again. */
+	if (offset && ipc.pinned)
+		evl_net_report_zerocopy(esk);
+
+	/* Report a short write if some segments went out. */
+	return offset ? (ssize_t)offset : ret;
 }
 
 static ssize_t copy_datagram_to_user(struct user_oob_msghdr __user *u_msghdr,
@@ -474,8 +684,80 @@ static ssize_t copy_datagram_to_user(struct user_oob_msghdr __user *u_msghdr,
 		msg_flags |= MSG_TRUNC;
 
 	ret = raw_put_user(msg_flags, &u_msghdr->flags);
+	if (ret)
+		return -EFAULT;
+
+	ret = evl_net_put_rxstamp(u_msghdr, skb);
+
+	return ret ?: count;
+}
+
+static inline size_t udp_payload_len(struct sk_buff *skb)
+{
+	return ntohs(udp_hdr(skb)->len) - sizeof(struct udphdr);
+}
+
+/*
+ * With UDP_GRO enabled, append the datagrams which follow @skb in the
+ * receive queue to the data already copied, as long as they come from
+ * the same peer with the same payload size, and fit in the remaining
+ * room. A shorter datagram ends the batch. The segment size is
+ * returned at @segszp, for the caller to pass it back through the
+ * control buffer.
+ */
+static ssize_t coalesce_datagrams(struct evl_net_udp_rxq *rxq,
+				struct iovec *iov, size_t iovlen,
+				struct sk_buff *skb, ssize_t count,
+				__u32 *segszp)
+{
+	size_t segsz = udp_payload_len(skb), room, len;
+	__be32 saddr = ip_hdr(skb)->saddr;
+	__be16 sport = udp_hdr(skb)->source;
+	struct sk_buff *next;
+	unsigned long flags;
+	bool short_write;
+	ssize_t ret;
+
+	if (count < segsz)	/* Truncated or empty, stop there. */
+		return count;
+
+	room = evl_iov_flat_length(iov, iovlen) - count;
+	evl_iov_advance(iov, iovlen, count);
+
+	while (count + segsz <= 65535) {
+		raw_spin_lock_irqsave(&rxq->wait.wchan.lock, flags);
+		next = list_first_entry_or_null(&rxq->queue, struct sk_buff, list);
+		if (next) {
+			len = udp_payload_len(next);
+			if (ip_hdr(next)->saddr != saddr ||
+				udp_hdr(next)->source != sport ||
+				len > segsz || len > room || len == 0)
+				next = NULL;
+			else
+				list_del(&next->list);
+		}
+		raw_spin_unlock_irqrestore(&rxq->wait.wchan.lock, flags);
+
+		if (next == NULL)
+			break;
 
-	return ret ? -EFAULT : count;
+		skb_pull_inline(next, sizeof(struct udphdr));
+		ret = evl_net_skb_to_uio(iov, iovlen, next,
+					sizeof(struct iphdr), &short_write);
+		evl_net_rput_skb(next);
+		if (ret < 0)
+			return ret;
+		len = ret;
+		count += len;
+		room -= len;
+		if (len < segsz)
+			break;
+		evl_iov_advance(iov, iovlen, len);
+	}
+
+	*segszp = segsz;
+
+	return count;
 }
 
 /* oob */
@@ -484,65 +766,50 @@ static ssize_t receive_udp(struct evl_socket *esk,
 			struct iovec *iov,
 			size_t iovlen)
 {
-	struct evl_net_udp_receiver *e;
+	struct evl_net_udp_rxq *rxq = esk->u.ip.udp.rxq;
+	ktime_t timeout, busy_deadline;
 	struct __evl_timespec uts;
 	enum evl_tmode tmode;
 	struct sk_buff *skb;
 	unsigned long flags;
 	__u32 msg_flags = 0;
-	ktime_t timeout;
 	ssize_t ret;
+	__u32 segsz;
 
 	/*
-	 * The cache entry may be freed only from a RCU callback, get
-	 * a safe reference on it from a RCU read side to prevent
-	 * stale access.
+	 * The receive queue belongs to the socket, so it cannot go
+	 * stale under our feet. We only have to make sure that it is
+	 * part of a receive slot for input to reach it.
 	 */
-again:
-	rcu_read_lock();
-
-	e = READ_ONCE(esk->u.ip.udp.receiver);
-	if (!e) {
+	if (!READ_ONCE(esk->u.ip.udp.receiver)) {
 		/*
 		 * If not bound prior to calling oob_recvmsg(), force
 		 * a binding to 0.0.0.0:0, which means that no receipt
 		 * will ever happen for this socket, causing this call
 		 * to hang indefinitely until interrupted.
 		 */
-		rcu_read_unlock();
 		lock_sock(esk->sk);
 		/* Recheck binding under lock. */
-		e = READ_ONCE(esk->u.ip.udp.receiver);
-		ret = e ? 0 : add_receive_slot(esk);
+		ret = READ_ONCE(esk->u.ip.udp.receiver) ? 0 :
+			add_receive_slot(esk);
 		release_sock(esk->sk);
-		if (!ret)
-			goto again;
-		return ret;
+		if (ret)
+			return ret;
 	}
 
-	evl_get_cache_entry(&e->entry);
-
-	rcu_read_unlock();
-
 	if (u_msghdr) {
 		ret = raw_get_user(msg_flags, &u_msghdr->flags);
-		if (ret) {
-			ret = -EFAULT;
-			goto out;
-		}
+		if (ret)
+			return -EFAULT;
 
 		/* We only support MSG_DONTWAIT at the moment. */
-		if (msg_flags & ~MSG_DONTWAIT) {
-			ret = -EINVAL;
-			goto out;
-		}
+		if (msg_flags & ~MSG_DONTWAIT)
+			return -EINVAL;
 
 		ret = raw_copy_from_user(&uts, &u_msghdr->timeout,
 					sizeof(uts));
-		if (ret) {
-			ret = -EFAULT;
-			goto out;
-		}
+		if (ret)
+			return -EFAULT;
 
 		timeout = u_timespec_to_ktime(uts);
 		tmode = timeout ? EVL_ABS : EVL_REL;
@@ -554,33 +821,85 @@ again:
 	if (evl_socket_f_flags(esk) & O_NONBLOCK)
 		msg_flags |= MSG_DONTWAIT;
 
+	/* Tell EVL_UDP_FANOUT_CPU where we are receiving from. */
+	WRITE_ONCE(rxq->cpu, raw_smp_processor_id());
+
+	busy_deadline = evl_net_busy_poll_deadline(esk);
+
 	do {
-		raw_spin_lock_irqsave(&e->wait.wchan.lock, flags);
+		raw_spin_lock_irqsave(&rxq->wait.wchan.lock, flags);
 
-		if (!list_empty(&e->queue)) {
-			skb = list_get_entry(&e->queue, struct sk_buff, list);
-			raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
+		if (!list_empty(&rxq->queue)) {
+			skb = list_get_entry(&rxq->queue, struct sk_buff, list);
+			raw_spin_unlock_irqrestore(&rxq->wait.wchan.lock, flags);
+			evl_net_note_rx(esk, skb);
 			ret = copy_datagram_to_user(u_msghdr, iov, iovlen, skb);
+			segsz = 0;
+			if (ret > 0 && u_msghdr && udp_test_bit(GRO_ENABLED, esk->sk))
+				ret = coalesce_datagrams(rxq, iov, iovlen,
+							skb, ret, &segsz);
+			if (ret >= 0 && u_msghdr)
+				ret = evl_net_put_rxctl(esk, u_msghdr, skb,
+						segsz ? &segsz : NULL,
+						sizeof(segsz)) ?: ret;
 			evl_net_rput_skb(skb); /* Uncharge rmem and free. */
-			goto out;
+			break;
 		}
 
 		if (msg_flags & MSG_DONTWAIT) {
-			raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
+			raw_spin_unlock_irqrestore(&rxq->wait.wchan.lock, flags);
 			ret = -EWOULDBLOCK;
-			goto out;
+			break;
+		}
+
+		/* Spin on the input lane before sleeping if enabled. */
+		if (busy_deadline) {
+			raw_spin_unlock_irqrestore(&rxq->wait.wchan.lock, flags);
+			busy_deadline = evl_net_busy_poll(esk, busy_deadline);
+			ret = 0;
+			continue;
 		}
 
-		evl_add_wait_queue(&e->wait, timeout, tmode);
-		raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
-		ret = evl_wait_schedule(&e->wait);
+		evl_add_wait_queue(&rxq->wait, timeout, tmode);
+		raw_spin_unlock_irqrestore(&rxq->wait.wchan.lock, flags);
+		ret = evl_wait_schedule(&rxq->wait);
 	} while (!ret);
-out:
-	evl_put_cache_entry(&e->entry);
 
 	return ret;
 }
 
+/* in-band */
+static int ioctl_udp(struct evl_socket *esk, unsigned int cmd,
+		unsigned long arg)
+{
+	struct evl_net_udp_receiver *e;
+	unsigned long flags;
+	__u32 fanout;
+	int ret;
+
+	switch (cmd) {
+	case EVL_UDP_IOC_SETFANOUT:
+		ret = raw_get_user(fanout, (__u32 __user *)arg);
+		if (ret)
+			return -EFAULT;
+		if (fanout > EVL_UDP_FANOUT_CPU)
+			return -EINVAL;
+		lock_sock(esk->sk);
+		e = READ_ONCE(esk->u.ip.udp.receiver);
+		if (e) {
+			raw_spin_lock_irqsave(&e->lock, flags);
+			e->fanout = fanout;
+			raw_spin_unlock_irqrestore(&e->lock, flags);
+		} else {
+			ret = -ENOTCONN;
+		}
+		release_sock(esk->sk);
+		return ret;
+	default:
+		return -ENOTTY;
+	}
+}
+
 /* oob */
 static __poll_t poll_udp(struct evl_socket *esk,
 			struct oob_poll_wait *wait)
@@ -698,30 +1017,160 @@ static inline bool verify_checksum(struct sk_buff *skb)
 	return validate_checksum(skb, ulen, check);
 }
 
+static inline u32 hash_udp_flow(struct sk_buff *skb)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	const struct udphdr *uh = udp_hdr(skb);
+
+	return jhash_3words((__force u32)iph->saddr, (__force u32)iph->daddr,
+			(__force u32)uh->source << 16 | (__force u32)uh->dest, 0);
+}
+
+/* hard irqs off, e->lock held */
+static struct evl_net_udp_rxq *
+pick_fanout_member(struct evl_net_udp_receiver *e, struct sk_buff *skb)
+{
+	unsigned int n;
+	int cpu;
+
+	if (e->nr_members == 1)
+		return e->members[0];
+
+	switch (e->fanout) {
+	case EVL_UDP_FANOUT_RR:
+		n = e->rr_next++;
+		if (e->rr_next >= e->nr_members)
+			e->rr_next = 0;
+		return e->members[n % e->nr_members];
+	case EVL_UDP_FANOUT_CPU:
+		cpu = raw_smp_processor_id();
+		for (n = 0; n < e->nr_members; n++)
+			if (READ_ONCE(e->members[n]->cpu) == cpu)
+				return e->members[n];
+		fallthrough;
+	default:
+		return e->members[reciprocal_scale(hash_udp_flow(skb),
+						e->nr_members)];
+	}
+}
+
+/* hard irqs off. */
+static void __queue_to_rxq(struct evl_net_udp_rxq *rxq, struct sk_buff *skb)
+{
+	evl_net_steer_rx(rxq->esk, skb);
+
+	raw_spin_lock(&rxq->wait.wchan.lock);
+	list_add_tail(&skb->list, &rxq->queue);
+	if (evl_wait_active(&rxq->wait))
+		evl_wake_up_head(&rxq->wait);
+	raw_spin_unlock(&rxq->wait.wchan.lock);
+}
+
 static bool __queue_for_receiver(struct evl_cache *cache,
 				struct sk_buff *skb,
 				const struct __evl_net_udp_key *key)
 {
 	struct evl_cache_entry *entry = evl_lookup_cache(cache, key);
 	struct evl_net_udp_receiver *e;
+	struct evl_net_udp_rxq *rxq;
 	unsigned long flags;
+	bool queued = false;
 
 	/*
-	 * If an entry is found, queue the incoming skb then wake up
-	 * the receiver.
+	 * If an entry is found, pick a member socket according to
+	 * the fanout policy, queue the incoming skb then wake up the
+	 * receiver.
 	 */
 	if (entry) {
 		e = container_of(entry, struct evl_net_udp_receiver, entry);
-		raw_spin_lock_irqsave(&e->wait.wchan.lock, flags);
-		list_add(&skb->list, &e->queue);
-		if (evl_wait_active(&e->wait))
-			evl_wake_up_head(&e->wait);
-		raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
-		evl_schedule();
-		return true;
+		raw_spin_lock_irqsave(&e->lock, flags);
+		if (e->nr_members > 0) {
+			rxq = pick_fanout_member(e, skb);
+			__queue_to_rxq(rxq, skb);
+			queued = true;
+		}
+		raw_spin_unlock_irqrestore(&e->lock, flags);
+		evl_put_cache_entry(entry);
+		if (queued)
+			evl_schedule();
 	}
 
-	return false;
+	return queued;
+}
+
+/* m->lock held, hard irqs off. */
+static bool mcast_member_matches(struct evl_socket *esk,
+				__be32 group, __u16 dport)
+{
+	struct inet_sock *inet = inet_sk(esk->sk);
+	__be32 rcv_saddr;
+
+	if (READ_ONCE(inet->inet_num) != dport)
+		return false;
+
+	rcv_saddr = READ_ONCE(inet->inet_rcv_saddr);
+
+	return rcv_saddr == htonl(INADDR_ANY) || rcv_saddr == group;
+}
+
+/*
+ * Deliver a multicast datagram to every oob socket bound to the
+ * destination port which joined the group on the input device. The
+ * first match receives @skb, the others get a clone sharing its
+ * data, including the fragment list if any.
+ */
+static bool deliver_mcast(struct sk_buff *skb)
+{
+	struct evl_cache *cache = &dev_net(skb->dev)->oob.ipv4.mcast;
+	struct evl_net_udp_rxq *first = NULL;
+	struct __evl_net_mcast_key key;
+	struct evl_cache_entry *entry;
+	struct evl_net_udp_mcast *m;
+	struct evl_socket *esk;
+	struct sk_buff *clone;
+	unsigned long flags;
+	unsigned int n;
+	__u16 dport;
+
+	key.group = ip_hdr(skb)->daddr;
+	key.ifindex = skb->dev->ifindex;
+	entry = evl_lookup_cache(cache, &key);
+	if (!entry)
+		return false;
+
+	m = container_of(entry, struct evl_net_udp_mcast, entry);
+	dport = ntohs(udp_hdr(skb)->dest);
+
+	raw_spin_lock_irqsave(&m->lock, flags);
+
+	for (n = 0; n < m->nr_members; n++) {
+		esk = m->members[n];
+		if (!mcast_member_matches(esk, key.group, dport))
+			continue;
+		if (!first) {
+			first = esk->u.ip.udp.rxq;
+			continue;
+		}
+		clone = evl_net_clone_skb(skb);
+		if (!clone)
+			break;	/* Out of buffer heads, deliver what we can. */
+		__queue_to_rxq(esk->u.ip.udp.rxq, clone);
+	}
+
+	/* The original goes last, clones depend on it. */
+	if (first)
+		__queue_to_rxq(first, skb);
+
+	raw_spin_unlock_irqrestore(&m->lock, flags);
+
+	evl_put_cache_entry(entry);
+
+	if (!first)
+		return false;
+
+	evl_schedule();
+
+	return true;
 }
 
 /*
@@ -738,6 +1187,10 @@ static bool queue_for_receiver(struct sk_buff *skb)
 	struct __evl_net_udp_key key;
 	struct evl_cache *cache = &net->oob.ipv4.udp;
 
+	/* Multicast input goes to the group members only. */
+	if (ipv4_is_multicast(iph->daddr))
+		return deliver_mcast(skb);
+
 	/*
 	 * First try a direct hit to the destination address and port
 	 * number.
@@ -800,13 +1253,8 @@ static void drop_udp_slot(struct evl_cache_entry *entry) /* in-band */
 {
 	struct evl_net_udp_receiver *e =
 		container_of(entry, struct evl_net_udp_receiver, entry);
-	struct sk_buff *skb, *tmp;
-
-	list_for_each_entry_safe(skb, tmp, &e->queue, list) {
-		list_del(&skb->list);
-		evl_net_free_skb(skb);
-	}
 
+	/* Pending input belongs to the member sockets. */
 	kfree(e);
 }
 
@@ -818,10 +1266,60 @@ static struct evl_cache_ops udp_cache_ops = {
 	.drop		= drop_udp_slot,
 };
 
+static u32 hash_mcast_group(const void *key)
+{
+	const struct __evl_net_mcast_key *k = key;
+
+	return jhash2((const u32 *)k, sizeof(*k) / sizeof(u32), 0);
+}
+
+static bool eq_mcast_group(const struct evl_cache_entry *entry,
+			const void *key)
+{
+	const struct __evl_net_mcast_key *k = key;
+	const struct evl_net_udp_mcast *m =
+		container_of(entry, struct evl_net_udp_mcast, entry);
+
+	return m->key.group == k->group && m->key.ifindex == k->ifindex;
+}
+
+static char *format_mcast_key(const struct evl_cache_entry *entry)
+{
+	const struct evl_net_udp_mcast *m =
+		container_of(entry, struct evl_net_udp_mcast, entry);
+
+	return kasprintf(GFP_ATOMIC, "%pI4@%u", &m->key.group, m->key.ifindex);
+}
+
+static const void *get_mcast_key(const struct evl_cache_entry *entry)
+{
+	const struct evl_net_udp_mcast *m =
+		container_of(entry, struct evl_net_udp_mcast, entry);
+
+	return &m->key;
+}
+
+static void drop_mcast_group(struct evl_cache_entry *entry) /* in-band */
+{
+	struct evl_net_udp_mcast *m =
+		container_of(entry, struct evl_net_udp_mcast, entry);
+
+	kfree(m);
+}
+
+static struct evl_cache_ops mcast_cache_ops = {
+	.hash		= hash_mcast_group,
+	.eq		= eq_mcast_group,
+	.get_key	= get_mcast_key,
+	.format_key	= format_mcast_key,
+	.drop		= drop_mcast_group,
+};
+
 int evl_net_init_udp(struct net *net)
 {
 	struct oob_net_state *nets = &net->oob;
 	struct evl_cache *cache;
+	int ret;
 
 	/* Cache of active UDP4 receivers. */
 	cache = &nets->ipv4.udp;
@@ -829,13 +1327,28 @@ int evl_net_init_udp(struct net *net)
 	cache->init_shift = EVL_NET_UDP_CACHE_SHIFT;
 	cache->name = "udp_receivers";
 
-	return evl_init_cache(cache);
+	ret = evl_init_cache(cache);
+	if (ret)
+		return ret;
+
+	/* Multicast group memberships. */
+	cache = &nets->ipv4.mcast;
+	cache->ops = &mcast_cache_ops;
+	cache->init_shift = EVL_NET_UDP_MCAST_CACHE_SHIFT;
+	cache->name = "udp_mcast_groups";
+
+	ret = evl_init_cache(cache);
+	if (ret)
+		evl_flush_cache(&nets->ipv4.udp);
+
+	return ret;
 }
 
 void evl_net_cleanup_udp(struct net *net)
 {
 	struct oob_net_state *nets = &net->oob;
 
+	evl_flush_cache(&nets->ipv4.mcast);
 	evl_flush_cache(&nets->ipv4.udp);
 }
 
@@ -844,6 +1357,7 @@ struct evl_net_proto evl_net_udp_proto = {
 	.destroy = destroy_udp_socket,
 	.bind = bind_udp_socket,
 	.shutdown = shutdown_udp_socket,
+	.ioctl = ioctl_udp,
 	.oob_send = send_udp,
 	.oob_poll = poll_udp,
 	.oob_receive = receive_udp,
@@ -0,0 +1,137 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/net.h>
+#include <linux/in6.h>
+#include <linux/ipv6.h>
+#include <net/ipv6.h>
+#include <evl/assert.h>
+#include <evl/net/socket.h>
+#include <evl/net/skb.h>
+#include <evl/net/ipv6.h>
+#include <evl/net/ipv6/route.h>
+#include <evl/net/ipv6/ndisc.h>
+#include <evl/net/ipv6/udp.h>
+
+/*
+ * Setup the IPv6 portion of the EVL state into an in-band network
+ * namespace.
+ */
+int evl_net_init_ipv6(struct net *net)
+{
+	int ret;
+
+	ret = evl_net_init_ipv6_routing(net);
+	if (ret)
+		return ret;
+
+	ret = evl_net_init_ndisc(net);
+	if (ret)
+		goto fail_ndisc;
+
+	ret = evl_net_init_udp6(net);
+	if (ret)
+		goto fail_udp;
+
+	return 0;
+
+fail_udp:
+	evl_net_cleanup_ndisc(net);
+fail_ndisc:
+	evl_net_cleanup_ipv6_routing(net);
+
+	return ret;
+}
+
+void evl_net_cleanup_ipv6(struct net *net)
+{
+	evl_net_cleanup_udp6(net);
+	evl_net_cleanup_ndisc(net);
+	evl_net_cleanup_ipv6_routing(net);
+}
+
+/*
+ * evl_net_ipv6_deliver - deliver an IPv6 packet to its final handler
+ * (typically the UDP layer).
+ *
+ * @skb the packet to deliver to the IPv6 stack.
+ *
+ * On error from this routine, the caller should care of dropping
+ * @skb.
+ *
+ * This is a subset of ipv6_rcv(): we only accept UDP datagrams
+ * immediately following the IPv6 header. Extension headers, which
+ * includes fragments, are not supported.
+ */
+int evl_net_ipv6_deliver(struct sk_buff *skb)
+{
+	struct ipv6hdr *ip6h;
+	u32 len;
+
+	/* Same requirements as evl_net_ipv4_deliver(). */
+	if (EVL_WARN_ON(NET, skb_shared(skb)))
+		return -EINVAL;
+
+	if (EVL_WARN_ON(NET, skb_is_nonlinear(skb)))
+		return -EINVAL;
+
+	if (skb->pkt_type == PACKET_OTHERHOST)
+		return -ENOMSG;
+
+	if (skb_headlen(skb) < sizeof(*ip6h))
+		return -EINVAL;
+
+	ip6h = ipv6_hdr(skb);
+	if (ip6h->version != 6)
+		return -EINVAL;
+
+	/*
+	 * RFC 4291 2.7: multicast packets with a zero scope must be
+	 * silently dropped, so are loopback addresses from the wire.
+	 */
+	if (ipv6_addr_is_multicast(&ip6h->saddr) ||
+		ipv6_addr_loopback(&ip6h->saddr) ||
+		ipv6_addr_loopback(&ip6h->daddr))
+		return -EINVAL;
+
+	/* No jumbogram, this would come with a hop-by-hop header. */
+	len = ntohs(ip6h->payload_len);
+	if (len == 0 || skb->len < len + sizeof(*ip6h))
+		return -EINVAL;
+
+	if (pskb_trim_rcsum(skb, len + sizeof(*ip6h)))
+		return -EINVAL;
+
+	if (EVL_WARN_ON(NET, ip6h != ipv6_hdr(skb)))
+		return -EINVAL;
+
+	skb->transport_header = skb->network_header + sizeof(*ip6h);
+
+	switch (ip6h->nexthdr) {
+	case IPPROTO_UDP:
+		if (evl_net_deliver_udp6(skb))
+			evl_net_free_skb(skb);
+		return 0;
+	default:
+		return -ENOTSUPP;
+	}
+}
+
+static struct evl_net_proto *match_ipv6_domain(int type, int protocol)
+{
+	switch (protocol) {
+	case IPPROTO_UDP:
+		if (type != SOCK_DGRAM)
+			return ERR_PTR(-ESOCKTNOSUPPORT);
+
+		return &evl_net_udp6_proto;
+	default:
+		return NULL;
+	}
+}
+
+struct evl_socket_domain evl_net_ipv6 = {
+	.af_domain = AF_INET6,
+	.match = match_ipv6_domain,
+};
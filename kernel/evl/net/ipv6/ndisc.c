@@ -0,0 +1,205 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ *
+ * This file implements a simple out-of-band front cache to the
+ * neighbor table the in-band IPv6 stack fills in by neighbor
+ * discovery, mirroring what the ARP front cache does for IPv4.
+ * Neighbor solicitations and advertisements keep flowing through
+ * the in-band stack, we only listen to its update events, caching
+ * complete entries observed on oob-enabled devices.
+ */
+
+#include <linux/if_ether.h>
+#include <linux/hash.h>
+#include <linux/notifier.h>
+#include <net/netevent.h>
+#include <net/ipv6.h>
+#include <evl/net/ipv6/ndisc.h>
+
+#define EVL_NET_NDISC_CACHE_SHIFT  8
+
+static u32 hash_ndisc_entry(const void *key)
+{
+	const struct evl_net_ndisc_key *nd_k = key;
+
+	return ipv6_addr_hash(&nd_k->addr) ^ hash32_ptr(nd_k->dev);
+}
+
+static bool eq_ndisc_entry(const struct evl_cache_entry *entry,
+			const void *key)
+{
+	const struct evl_net_ndisc_entry *e =
+		container_of(entry, struct evl_net_ndisc_entry, entry);
+	const struct evl_net_ndisc_key *nd_k = key;
+
+	return ipv6_addr_equal(&e->key.addr, &nd_k->addr) &&
+		e->key.dev == nd_k->dev;
+}
+
+static char *format_ndisc_key(const struct evl_cache_entry *entry)
+{
+	const struct evl_net_ndisc_entry *e =
+		container_of(entry, struct evl_net_ndisc_entry, entry);
+
+	return kasprintf(GFP_ATOMIC, "%pI6c", &e->key.addr);
+}
+
+static const void *get_ndisc_key(const struct evl_cache_entry *entry)
+{
+	const struct evl_net_ndisc_entry *e =
+		container_of(entry, struct evl_net_ndisc_entry, entry);
+
+	return &e->key;
+}
+
+static void free_ndisc_entry(struct evl_cache_entry *entry) /* in-band */
+{
+	struct evl_net_ndisc_entry *e =
+		container_of(entry, struct evl_net_ndisc_entry, entry);
+
+	netdev_put(e->key.dev, &e->dev_tracker);
+	kfree(e);
+}
+
+static struct evl_cache_ops ndisc_cache_ops = {
+	.hash		= hash_ndisc_entry,
+	.eq		= eq_ndisc_entry,
+	.get_key	= get_ndisc_key,
+	.format_key	= format_ndisc_key,
+	.drop		= free_ndisc_entry,
+};
+
+static int cache_ndisc_entry(struct evl_cache *cache, struct neighbour *neigh) /* in-band */
+{
+	struct net_device *dev = neigh->dev;
+	struct evl_net_ndisc_entry *e;
+	int ret;
+
+	e = kzalloc(sizeof(*e), GFP_ATOMIC);
+	if (!e)
+		return -ENOMEM;
+
+	e->key.dev = dev;
+	e->key.addr = *(const struct in6_addr *)neigh->primary_key;
+	memcpy(e->ha, neigh->ha, sizeof(e->ha));
+	netdev_hold(dev, &e->dev_tracker, GFP_ATOMIC);
+
+	ret = evl_add_cache_entry(cache, &e->entry);
+	if (ret) {
+		netdev_put(dev, &e->dev_tracker);
+		kfree(e);
+	}
+
+	return ret;
+}
+
+static void uncache_ndisc_entry(struct evl_cache *cache, struct neighbour *neigh) /* in-band */
+{
+	const struct evl_net_ndisc_key key = {
+		.addr = *(const struct in6_addr *)neigh->primary_key,
+		.dev = neigh->dev,
+	};
+
+	evl_del_cache_entry(cache, &key);
+}
+
+/*
+ * Handle an update notification from the in-band neighbor table.
+ * Unlike ARP, we keep stale entries: RFC 4861 allows sending to
+ * them, the in-band stack probes the neighbor again only when it
+ * sends traffic there itself, which it won't for oob flows.
+ */
+static void update_ndisc_cache(struct neighbour *neigh) /* in-band */
+{
+	struct net_device *dev = neigh->dev;
+	struct oob_net_state *nets = &dev_net(dev)->oob;
+	struct evl_cache *cache = &nets->ipv6.ndisc;
+	int ret;
+
+	read_lock_bh(&neigh->lock); /* Protect against races on nud_state */
+
+	if (netif_oob_port(dev))
+		netdev_dbg(dev, "state=%#x, dead=%d, iface=%s, ip=%pI6c, mac=%pM\n",
+			neigh->nud_state, neigh->dead, netdev_name(neigh->dev),
+			neigh->primary_key, neigh->ha);
+
+	if (!neigh->dead && neigh->nud_state & (NUD_REACHABLE|NUD_PERMANENT) &&
+		netif_oob_port(dev)) {
+		ret = cache_ndisc_entry(cache, neigh);
+		if (ret)
+			printk(EVL_WARNING "out of memory for neighbor cache\n");
+	} else if (neigh->dead || neigh->nud_state & NUD_FAILED) {
+		/* Same as ARP, do not filter out on netif_oob_port(). */
+		uncache_ndisc_entry(cache, neigh);
+	}
+
+	read_unlock_bh(&neigh->lock);
+}
+
+static int netevent_handler(struct notifier_block *nb,
+			unsigned long event, void *arg)
+{
+	struct neighbour *neigh = arg;
+
+	/* Do not refer to nd_tbl, which may live in a module. */
+	if (event == NETEVENT_NEIGH_UPDATE &&
+		neigh->tbl->family == AF_INET6)
+		update_ndisc_cache(neigh);
+
+	return NOTIFY_DONE;
+}
+
+struct evl_net_ndisc_entry *
+evl_net_get_ndisc_entry(struct net_device *dev, const struct in6_addr *addr)
+{
+	const struct evl_net_ndisc_key key = {
+		.addr = *addr,
+		.dev = dev,
+	};
+	struct oob_net_state *nets = &dev_net(dev)->oob;
+	struct evl_cache_entry *entry;
+
+	entry = evl_lookup_cache(&nets->ipv6.ndisc, &key);
+	if (likely(entry))
+		return container_of(entry, struct evl_net_ndisc_entry, entry);
+
+	return NULL;
+}
+
+static struct notifier_block netevent_notifier __read_mostly = {
+	.notifier_call = netevent_handler,
+};
+
+void evl_net_flush_ndisc(struct net *net)
+{
+	struct oob_net_state *nets = &net->oob;
+
+	evl_flush_cache(&nets->ipv6.ndisc);
+}
+
+int evl_net_init_ndisc(struct net *net)
+{
+	struct oob_net_state *nets = &net->oob;
+	struct evl_cache *cache;
+	int ret;
+
+	/* Neighbor cache. */
+	cache = &nets->ipv6.ndisc;
+	cache->ops = &ndisc_cache_ops;
+	cache->init_shift = EVL_NET_NDISC_CACHE_SHIFT;
+	cache->name = "NDISC";
+
+	ret = evl_init_cache(cache);
+	if (ret)
+		return ret;
+
+	register_netevent_notifier(&netevent_notifier);
+
+	return 0;
+}
+
+void evl_net_cleanup_ndisc(struct net *net)
+{
+	unregister_netevent_notifier(&netevent_notifier);
+	evl_net_flush_ndisc(net);
+}
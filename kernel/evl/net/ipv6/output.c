@@ -0,0 +1,143 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/net.h>
+#include <linux/netdevice.h>
+#include <linux/ipv6.h>
+#include <net/ipv6.h>
+#include <net/ip6_route.h>
+#include <net/checksum.h>
+#include <evl/net/socket.h>
+#include <evl/net/device.h>
+#include <evl/net/skb.h>
+#include <evl/net/ipv6.h>
+#include <evl/net/ipv6/route.h>
+#include <evl/net/ipv6/output.h>
+
+static void fill_ipv6_header(struct ipv6hdr *ip6h,
+			struct sock *sk,
+			struct dst_entry *dst,
+			struct evl_net_ipv6_cookie *ipc,
+			size_t payload_len)
+{
+	struct ipv6_pinfo *np = inet6_sk(sk);
+	int hlimit;
+
+	if (ipv6_addr_is_multicast(&ipc->daddr))
+		hlimit = READ_ONCE(np->mcast_hops);
+	else
+		hlimit = READ_ONCE(np->hop_limit);
+	if (hlimit < 0)
+		hlimit = ip6_dst_hoplimit(dst);
+
+	ip6_flow_hdr(ip6h, READ_ONCE(np->tclass), np->flow_label);
+	ip6h->payload_len = htons(payload_len);
+	ip6h->nexthdr = ipc->protocol;
+	ip6h->hop_limit = hlimit;
+	ip6h->saddr = ipc->saddr;
+	ip6h->daddr = ipc->daddr;
+}
+
+/*
+ * Create an IPv6 datagram from the contents referred to by a
+ * user-provided I/O vector.
+ *
+ * @esk		emitting socket
+ * @iov		source I/O vector
+ * @iovlen	number of cells in vector
+ * @ert		EVL route cache entry
+ * @datalen	length of payload data in @iov (excluding the transport header)
+ * @timeout	time limit for sleeping on congestion
+ * @ipc		IPv6 cookie with misc transmit information
+ *
+ * Same assumptions as evl_net_ipv4_build_datagram(), except that we
+ * do not fragment: IPv6 routers never do either, so the sender has
+ * to fit the path MTU, or get -EMSGSIZE.
+ *
+ * @iov is consumed as data is copied. This routine reserves the space
+ * for a transport header if ipc->transhdrlen > 0, which the caller is
+ * expected to fill in eventually. The payload checksum is either
+ * left to the NIC (ipc->hw_csum), or accumulated into ipc->csum as
+ * the data is copied.
+ *
+ * Returns the socket buffer loaded with the user data to transmit.
+ */
+struct sk_buff *evl_net_ipv6_build_datagram(struct evl_socket *esk,
+					struct iovec *iov, size_t iovlen,
+					struct evl_net_ipv6_route *ert,
+					size_t datalen,
+					ktime_t timeout,
+					struct evl_net_ipv6_cookie *ipc)
+{
+	struct net_device *dev = ert->dst->dev,
+		*real_dev = evl_net_real_dev(dev);
+	struct sock *sk = esk->sk;
+	size_t chunksz, offset = 0;
+	struct ipv6hdr *ip6h;
+	struct sk_buff *skb;
+	int mtu, n = 0, ret;
+	void *data;
+
+	if (EVL_WARN_ON(NET, datalen == 0))
+		return ERR_PTR(-EINVAL);
+
+	mtu = ip6_sk_accept_pmtu(sk) ? dst_mtu(ert->dst) : READ_ONCE(real_dev->mtu);
+	if (mtu < IPV6_MIN_MTU)
+		return ERR_PTR(-ENETUNREACH);
+
+	if (datalen + ipc->transhdrlen > mtu - sizeof(*ip6h))
+		return ERR_PTR(-EMSGSIZE);
+
+	netdev_dbg(dev, "build dgram: src=%pI6c, dst=%pI6c, mtu=%d, "
+		   " transhdrlen=%d\n",
+		   &ipc->saddr, &ipc->daddr, mtu, ipc->transhdrlen);
+
+	skb = evl_net_wget_skb(esk, real_dev, timeout);
+	if (IS_ERR(skb))
+		return skb;
+
+	ipc->csum = 0;
+	ipc->hw_csum = evl_net_can_offload_csum(dev, NETIF_F_IPV6_CSUM);
+
+	skb_reserve(skb, real_dev->hard_header_len + sizeof(*ip6h) +
+		ipc->transhdrlen);
+	if (ipc->transhdrlen > 0) {
+		skb_push(skb, ipc->transhdrlen);
+		skb_reset_transport_header(skb);
+	}
+
+	skb->ip_summed = CHECKSUM_NONE;
+	skb->csum = 0;
+	skb->priority = READ_ONCE(sk->sk_priority);
+	skb->protocol = htons(ETH_P_IPV6);
+
+	while (offset < datalen) {
+		if (iov->iov_len == 0) {
+			if (++n >= iovlen)
+				break;
+			iov++;
+			continue;
+		}
+
+		chunksz = min(iov->iov_len, datalen - offset);
+		data = skb_put(skb, chunksz);
+		ret = evl_net_load_payload(data, iov->iov_base, chunksz,
+					ipc->hw_csum ? NULL : &ipc->csum,
+					offset, ipc->pinned);
+		if (ret) {
+			evl_net_wput_skb(skb);
+			return ERR_PTR(ret);
+		}
+
+		iov->iov_len -= chunksz;
+		iov->iov_base += chunksz;
+		offset += chunksz;
+	}
+
+	ip6h = skb_push(skb, sizeof(*ip6h));
+	skb_reset_network_header(skb);
+	fill_ipv6_header(ip6h, sk, ert->dst, ipc, skb->len - sizeof(*ip6h));
+
+	return skb;
+}
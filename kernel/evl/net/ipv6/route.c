@@ -0,0 +1,169 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/slab.h>
+#include <net/ipv6.h>
+#include <net/ip6_route.h>
+#include <evl/net/ipv6/route.h>
+
+/* Start an IPv6 route cache with 256 entries. */
+#define EVL_NET_IPV6_ROUTE_SHIFT  8
+
+static u32 hash_ipv6_route(const void *key)
+{
+	return ipv6_addr_hash(key);
+}
+
+static bool eq_ipv6_route(const struct evl_cache_entry *entry,
+			const void *key)
+{
+	const struct evl_net_ipv6_route *e =
+		container_of(entry, struct evl_net_ipv6_route, entry);
+
+	return ipv6_addr_equal(&e->key, key);
+}
+
+static char *format_ipv6_key(const struct evl_cache_entry *entry)
+{
+	const struct evl_net_ipv6_route *e =
+		container_of(entry, struct evl_net_ipv6_route, entry);
+
+	return kasprintf(GFP_ATOMIC, "%pI6c", &e->key);
+}
+
+static const void *get_ipv6_key(const struct evl_cache_entry *entry)
+{
+	const struct evl_net_ipv6_route *e =
+		container_of(entry, struct evl_net_ipv6_route, entry);
+
+	return &e->key;
+}
+
+static void free_ipv6_route(struct evl_cache_entry *entry) /* in-band */
+{
+	struct evl_net_ipv6_route *e =
+		container_of(entry, struct evl_net_ipv6_route, entry);
+
+	netdev_dbg(e->dst->dev, "dropping IPv6 route %pI6c\n", &e->key);
+
+	/* Drop the ref. we took in evl_net_learn_ipv6_route(). */
+	dst_release(e->dst);
+
+	kfree(e);
+}
+
+static struct evl_cache_ops ipv6_route_cache_ops = {
+	.hash		= hash_ipv6_route,
+	.eq		= eq_ipv6_route,
+	.get_key	= get_ipv6_key,
+	.format_key	= format_ipv6_key,
+	.drop		= free_ipv6_route,
+};
+
+int evl_net_init_ipv6_routing(struct net *net)
+{
+	struct oob_net_state *nets = &net->oob;
+	struct evl_cache *cache;
+
+	/* Route cache for IPv6 destinations. */
+	cache = &nets->ipv6.routes;
+	cache->ops = &ipv6_route_cache_ops;
+	cache->init_shift = EVL_NET_IPV6_ROUTE_SHIFT;
+	cache->name = "ipv6_routes";
+
+	return evl_init_cache(cache);
+}
+
+static bool compare_route_dev(struct evl_cache_entry *entry, void *arg)
+{
+	const struct evl_net_ipv6_route *ert =
+		container_of(entry, struct evl_net_ipv6_route, entry);
+	struct net_device *dev = arg;
+
+	return dev == ert->dst->dev;
+}
+
+void evl_net_flush_ipv6_routes(struct net *net, struct net_device *dev)
+{
+	if (dev)
+		evl_clean_cache(&net->oob.ipv6.routes, compare_route_dev, dev);
+	else
+		evl_flush_cache(&net->oob.ipv6.routes);
+}
+
+void evl_net_cleanup_ipv6_routing(struct net *net)
+{
+	evl_net_flush_ipv6_routes(net, NULL);
+}
+
+/*
+ * Update the out-of-band front cache with the routing decision the
+ * in-band FIB made for some outgoing IPv6 traffic, along with the
+ * source address it selected. Unlike IPv4, we have no hook into the
+ * in-band routing code, so the caller feeds us with the results of
+ * its own lookups instead. We may be running in softirq context,
+ * don't wait.
+ */
+void evl_net_learn_ipv6_route(struct net *net,
+			struct flowi6 *fl6, struct dst_entry *dst) /* in-band */
+{
+	struct oob_net_state *nets = &net->oob;
+	struct net_device *dev = dst->dev;
+	struct evl_net_ipv6_route *e;
+	int ret;
+
+	if (dst->error || !netif_oob_port(dev))
+		return;
+
+	e = evl_net_get_ipv6_route(net, &fl6->daddr);
+	if (e && e->dst->dev == dev &&
+		ipv6_addr_equal(&e->saddr, &fl6->saddr)) {
+		evl_net_put_ipv6_route(e);
+		return;
+	}
+
+	if (e)
+		evl_net_put_ipv6_route(e);
+
+	netdev_dbg(dev, "learning ipv6 route: %pI6c -> %pI6c via %s\n",
+		   &fl6->saddr, &fl6->daddr, netdev_name(dev));
+
+	e = kzalloc(sizeof(*e), GFP_ATOMIC);
+	if (!e)
+		goto warn;
+
+	dst_hold(dst);
+	e->dst = dst;
+	e->saddr = fl6->saddr;
+	e->key = fl6->daddr;
+	ret = evl_add_cache_entry(&nets->ipv6.routes, &e->entry);
+	if (ret) {
+		dst_release(dst);
+		kfree(e);
+		goto warn;
+	}
+
+	return;
+warn:
+	printk(EVL_WARNING "out of memory for IPv6 route cache\n");
+}
+
+/*
+ * Find a route to a destination IPv6 peer in the front cache.
+ *
+ * On success, the caller needs to release the route by a call to
+ * evl_net_put_ipv6_route().
+ */
+struct evl_net_ipv6_route *
+evl_net_get_ipv6_route(struct net *net, const struct in6_addr *daddr)
+{
+	struct oob_net_state *nets = &net->oob;
+	struct evl_cache_entry *entry;
+
+	entry = evl_lookup_cache(&nets->ipv6.routes, daddr);
+	if (likely(entry))
+		return container_of(entry, struct evl_net_ipv6_route, entry);
+
+	return NULL;
+}
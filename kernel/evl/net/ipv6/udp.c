@@ -0,0 +1,868 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ *
+ * UDP over IPv6 for out-of-band sockets. This follows the logic of
+ * the IPv4 implementation closely, see ipv4/udp.c for the rationale.
+ */
+
+#include <linux/net.h>
+#include <linux/netdevice.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
+#include <linux/jhash.h>
+#include <net/ipv6.h>
+#include <net/ip6_route.h>
+#include <net/ip6_checksum.h>
+#include <net/udp.h>
+#include <evl/memory.h>
+#include <evl/uaccess.h>
+#include <evl/uio.h>
+#include <evl/net/offload.h>
+#include <evl/net/skb.h>
+#include <evl/net/device.h>
+#include <evl/net/ip.h>
+#include <evl/net/ipv6.h>
+#include <evl/net/ipv6/output.h>
+#include <evl/net/ipv6/route.h>
+#include <evl/net/ipv6/ndisc.h>
+#include <evl/net/ipv6/udp.h>
+
+#define EVL_NET_UDP6_CACHE_SHIFT  8
+
+/* in-band. */
+static int attach_udp6_socket(struct evl_socket *esk,
+			struct evl_net_proto *proto, int protocol)
+{
+	esk->proto = proto;
+	esk->protocol = protocol;
+	evl_net_init_ip_socket(esk);
+
+	return 0;
+}
+
+/*
+ * add_receive_slot - install a receive slot for the socket to wait
+ * on, based on the port and address the in-band stack bound it to.
+ *
+ * @esk->sk is locked on entry.
+ */
+static int add_receive_slot(struct evl_socket *esk) /* inband */
+{
+	struct evl_cache *cache = &esk->net->oob.ipv6.udp;
+	struct evl_net_udp6_receiver *new, *old;
+	struct sock *sk = esk->sk;
+	struct evl_cache_entry *entry;
+	struct __evl_net_udp6_key key;
+	int ret;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+
+	key.dport = inet_sk(sk)->inet_num;
+	key.daddr = sk->sk_v6_rcv_saddr;
+
+	new->key = key;
+	INIT_LIST_HEAD(&new->queue);
+	evl_init_wait(&new->wait, &evl_mono_clock, 0);
+	refcount_set(&new->refs, 1);
+
+	/* Lookup and insertion must be seen as atomic. */
+	evl_lock_cache(cache);
+	entry = evl_lookup_cache(cache, &key);
+	if (entry) {
+		evl_unlock_cache(cache);
+		old = container_of(entry, struct evl_net_udp6_receiver, entry);
+		/* One user more via reuseport, account for it. */
+		refcount_inc(&old->refs);
+		evl_put_cache_entry(entry);
+		kfree(new);
+		new = old;
+	} else {
+		ret = evl_add_cache_entry_locked(cache, &new->entry);
+		evl_unlock_cache(cache);
+		if (ret) {
+			kfree(new);
+			return ret;
+		}
+	}
+
+	WRITE_ONCE(esk->u.ip.udp6.receiver, new);
+
+	return 0;
+}
+
+/*
+ * drop_receive_slot - remove a receive slot previously installed by
+ * add_receive_slot().
+ *
+ * @esk->sk is either locked on entry, or not known from anyone else
+ * (i.e. zombie state).
+ */
+static void drop_receive_slot(struct evl_socket *esk) /* inband */
+{
+	struct evl_cache *cache = &esk->net->oob.ipv6.udp;
+	struct evl_net_udp6_receiver *e;
+	struct __evl_net_udp6_key key;
+
+	e = READ_ONCE(esk->u.ip.udp6.receiver);
+	if (e && refcount_dec_and_test(&e->refs)) {
+		key.dport = e->key.dport;
+		key.daddr = e->key.daddr;
+		evl_del_cache_entry(cache, &key);
+		WRITE_ONCE(esk->u.ip.udp6.receiver, NULL);
+	}
+}
+
+static void destroy_udp6_socket(struct evl_socket *esk) /* inband */
+{
+	drop_receive_slot(esk);
+}
+
+/*
+ * Called if the in-band bind handler for AF_INET6 passes the request
+ * on, otherwise the slot is installed on the first oob receive.
+ */
+static int bind_udp6_socket(struct evl_socket *esk,
+			struct sockaddr *addr,
+			int len)
+{
+	return add_receive_slot(esk);
+}
+
+static int shutdown_udp6_socket(struct evl_socket *esk, int how)
+{
+	drop_receive_slot(esk);
+	return 0;
+}
+
+static ssize_t offload_send_udp6(struct evl_socket *esk,
+				struct kvec *kvec, size_t count,
+				struct sockaddr_in6 *in6_dest)
+{
+	struct evl_net_offload *ofld;
+
+	ofld = evl_alloc(sizeof(*ofld));
+	if (!ofld)
+		return -ENOMEM;
+
+	ofld->kvec = *kvec;
+	ofld->count = count;
+	ofld->dest.in6 = in6_dest ? *in6_dest : (struct sockaddr_in6){};
+	ofld->destlen = in6_dest ? sizeof(*in6_dest) : 0;
+	evl_net_offload_inband(esk, ofld, &esk->u.ip.pending_output);
+
+	return count;
+}
+
+/*
+ * Given an IPv6 address, look into our oob route and neighbor front
+ * caches to find an egress path. If we cannot find a route through
+ * an oob-enabled device, or we don't know the hardware address of
+ * the next hop, then the caller will have to pass on the datagram to
+ * the in-band stack.
+ */
+static bool find_egress_path(struct evl_socket *esk,
+			const struct in6_addr *daddr,
+			struct evl_net_ipv6_route **ertp,
+			struct evl_net_ndisc_entry **endp)
+{
+	struct evl_net_ndisc_entry *_end;
+	struct evl_net_ipv6_route *_ert;
+	struct net_device *dev;
+
+	_ert = evl_net_get_ipv6_route(sock_net(esk->sk), daddr);
+	if (likely(_ert)) {
+		dev = _ert->dst->dev;
+		if (netif_oob_port(dev)) {
+			_end = evl_net_get_ndisc_entry(dev,
+					evl_net_ipv6_nexthop(_ert, daddr));
+			if (likely(_end))  {
+				*ertp = _ert;
+				*endp = _end;
+				return true;
+			}
+		}
+		evl_net_put_ipv6_route(_ert);
+	}
+
+	return false;
+}
+
+/*
+ * Send a datagram to the next hop we have a neighbor entry for. The
+ * UDP checksum is mandatory over IPv6, it is either left to the NIC
+ * or completed from the payload checksum evl_net_ipv6_build_datagram()
+ * accumulated.
+ */
+static int send_datagram(struct sk_buff *skb, struct net_device *dev,
+			struct evl_net_ndisc_entry *end,
+			struct evl_net_ipv6_cookie *ipc,
+			__be16 dport, __be16 sport,
+			size_t datalen)
+{
+	size_t ulen = datalen + sizeof(struct udphdr);
+	struct udphdr *uh;
+	int ret;
+
+	uh = udp_hdr(skb);
+	uh->source = sport;
+	uh->dest = dport;
+	uh->len = htons(ulen);
+	uh->check = 0;
+
+	if (ipc->hw_csum) {
+		uh->check = ~csum_ipv6_magic(&ipc->saddr, &ipc->daddr, ulen,
+					IPPROTO_UDP, 0);
+		skb->ip_summed = CHECKSUM_PARTIAL;
+		skb->csum_start = skb_transport_header(skb) - skb->head;
+		skb->csum_offset = offsetof(struct udphdr, check);
+	} else {
+		uh->check = csum_ipv6_magic(&ipc->saddr, &ipc->daddr, ulen,
+					IPPROTO_UDP,
+					csum_partial(uh, sizeof(*uh), ipc->csum));
+		if (uh->check == 0)
+			uh->check = CSUM_MANGLED_0;
+		skb->ip_summed = CHECKSUM_NONE;
+	}
+
+	ret = evl_net_ether_transmit(dev, skb, end->ha);
+	if (ret)
+		evl_net_wput_skb(skb);
+
+	return ret;
+}
+
+/* oob */
+static ssize_t send_udp6(struct evl_socket *esk,
+			const struct user_oob_msghdr __user *u_msghdr,
+			struct iovec *iov,
+			size_t iovlen)
+{
+	struct sockaddr_in6 sin6, *u_sin6;
+	struct evl_net_ipv6_cookie ipc;
+	struct evl_net_ndisc_entry *end;
+	struct evl_net_ipv6_route *ert;
+	struct sock *sk = esk->sk;
+	size_t segsz, seglen, offset;
+	struct __evl_timespec uts;
+	struct in6_addr daddr;
+	ssize_t datalen, ret;
+	enum evl_tmode tmode;
+	__u32 msg_flags = 0;
+	struct sk_buff *skb;
+	__u32 namelen = 0;
+	struct kvec kvec;
+	ktime_t timeout;
+	__u64 name_ptr;
+	__be16 dport;
+
+	ret = raw_get_user(msg_flags, &u_msghdr->flags);
+	if (ret)
+		return -EFAULT;
+
+	if (msg_flags & ~(MSG_DONTWAIT|MSG_ZEROCOPY))
+		return -EINVAL;
+
+	if (evl_socket_f_flags(esk) & O_NONBLOCK)
+		msg_flags |= MSG_DONTWAIT;
+
+	ret = raw_copy_from_user(&uts, &u_msghdr->timeout, sizeof(uts));
+	if (ret)
+		return -EFAULT;
+
+	timeout = msg_flags & MSG_DONTWAIT ? EVL_NONBLOCK :
+		u_timespec_to_ktime(uts);
+	tmode = timeout ? EVL_ABS : EVL_REL;
+
+	ret = raw_get_user(name_ptr, &u_msghdr->name_ptr);
+	if (ret)
+		return -EFAULT;
+
+	if (name_ptr) {
+		ret = raw_get_user(namelen, &u_msghdr->namelen);
+		if (ret)
+			return -EFAULT;
+		if (namelen < sizeof(sin6))
+			return -EINVAL;
+		u_sin6 = evl_valptr64(name_ptr, struct sockaddr_in6);
+		ret = raw_copy_from_user(&sin6, u_sin6, sizeof(sin6));
+		if (ret)
+			return -EFAULT;
+		if (sin6.sin6_family != AF_INET6)
+			return -EAFNOSUPPORT;
+		daddr = sin6.sin6_addr;
+		dport = sin6.sin6_port;
+		if (ipv6_addr_any(&daddr) || !dport)
+			return -EINVAL;
+		namelen = sizeof(sin6);
+	} else {
+		if (sk->sk_state != TCP_ESTABLISHED)
+			return -EDESTADDRREQ;
+		daddr = sk->sk_v6_daddr;
+		dport = inet_sk(sk)->inet_dport;
+	}
+
+	datalen = evl_iov_flat_length(iov, iovlen);
+	if (datalen == 0)
+		return 0;
+
+	if (datalen > 65535)
+		return -EMSGSIZE;
+
+	/*
+	 * IPv4-mapped destinations would need the IPv4 path, let the
+	 * in-band stack deal with them.
+	 */
+	if (ipv6_addr_v4mapped(&daddr) ||
+		!find_egress_path(esk, &daddr, &ert, &end)) {
+		ret = evl_charge_socket_wmem(esk, datalen, timeout, tmode);
+		if (ret)
+			return ret;
+
+		ret = evl_copy_from_uio_to_kvec(iov, iovlen, datalen, &kvec);
+		if (ret < 0) {
+			evl_uncharge_socket_wmem(esk, datalen);
+			return ret;
+		}
+
+		ret = offload_send_udp6(esk, &kvec, ret, namelen ? &sin6 : NULL);
+		if (ret < 0)
+			return ret;
+
+		if (msg_flags & MSG_ZEROCOPY)
+			evl_net_report_zerocopy(esk);
+
+		/* Same as IPv4, see send_udp(). */
+		return unlikely(msg_flags & MSG_DONTWAIT) ? -EINPROGRESS : 0;
+	}
+
+	ipc.saddr = ipv6_addr_any(&sk->sk_v6_rcv_saddr) ?
+		ert->saddr : sk->sk_v6_rcv_saddr;
+	ipc.daddr = daddr;
+	ipc.protocol = IPPROTO_UDP;
+	ipc.transhdrlen = sizeof(struct udphdr);
+	ipc.pinned = !!(msg_flags & MSG_ZEROCOPY);
+
+	/* Honor UDP_SEGMENT, like IPv4 does. */
+	segsz = READ_ONCE(udp_sk(sk)->gso_size) ?: datalen;
+
+	for (offset = 0; offset < datalen; offset += seglen) {
+		seglen = min_t(size_t, datalen - offset, segsz);
+		skb = evl_net_ipv6_build_datagram(esk, iov, iovlen, ert,
+						seglen, timeout, &ipc);
+		if (IS_ERR(skb)) {
+			ret = PTR_ERR(skb);
+			break;
+		}
+
+		ret = evl_net_prepare_tx(esk, u_msghdr, skb);
+		if (ret) {
+			evl_net_wput_skb(skb);
+			break;
+		}
+
+		ret = send_datagram(skb, ert->dst->dev, end, &ipc,
+				dport, inet_sk(sk)->inet_sport, seglen);
+		if (ret)
+			break;
+	}
+
+	evl_net_put_ndisc_entry(end);
+	evl_net_put_ipv6_route(ert);
+
+	if (offset && ipc.pinned)
+		evl_net_report_zerocopy(esk);
+
+	return offset ? (ssize_t)offset : ret;
+}
+
+static ssize_t copy_datagram_to_user(struct user_oob_msghdr __user *u_msghdr,
+				const struct iovec *iov,
+				size_t iovlen,
+				struct sk_buff *skb)
+{
+	struct sockaddr_in6 addr, __user *u_addr;
+	__u64 name_ptr, namelen;
+	__u32 msg_flags = 0;
+	ssize_t ret, count;
+	bool short_write;
+
+	ret = raw_get_user(name_ptr, &u_msghdr->name_ptr);
+	if (ret)
+		return -EFAULT;
+
+	ret = raw_get_user(namelen, &u_msghdr->namelen);
+	if (ret)
+		return -EFAULT;
+
+	if (name_ptr) {
+		if (namelen != sizeof(addr)) {
+			if (namelen < sizeof(addr))
+				return -EINVAL;
+			ret = raw_put_user(sizeof(addr), &u_msghdr->namelen);
+			if (ret)
+				return -EFAULT;
+		}
+		addr.sin6_family = AF_INET6;
+		addr.sin6_port = udp_hdr(skb)->source;
+		addr.sin6_flowinfo = 0;
+		addr.sin6_addr = ipv6_hdr(skb)->saddr;
+		addr.sin6_scope_id = ipv6_iface_scope_id(&addr.sin6_addr,
+							skb->dev->ifindex);
+		u_addr = evl_valptr64(name_ptr, struct sockaddr_in6);
+		ret = raw_copy_to_user(u_addr, &addr, sizeof(addr));
+		if (ret)
+			return -EFAULT;
+	} else {
+		if (namelen)
+			return -EINVAL;
+	}
+
+	count = evl_net_skb_to_uio(iov, iovlen, skb,
+				sizeof(struct ipv6hdr) + sizeof(struct udphdr),
+				&short_write);
+	if (short_write)
+		msg_flags |= MSG_TRUNC;
+
+	ret = raw_put_user(msg_flags, &u_msghdr->flags);
+	if (ret)
+		return -EFAULT;
+
+	ret = evl_net_put_rxstamp(u_msghdr, skb);
+
+	return ret ?: count;
+}
+
+static inline size_t udp_payload_len(struct sk_buff *skb)
+{
+	return ntohs(udp_hdr(skb)->len) - sizeof(struct udphdr);
+}
+
+/* UDP_GRO receive coalescing, see coalesce_datagrams() for IPv4. */
+static ssize_t coalesce_datagrams(struct evl_net_udp6_receiver *e,
+				struct iovec *iov, size_t iovlen,
+				struct sk_buff *skb, ssize_t count,
+				__u32 *segszp)
+{
+	size_t segsz = udp_payload_len(skb), room, len;
+	struct in6_addr saddr = ipv6_hdr(skb)->saddr;
+	__be16 sport = udp_hdr(skb)->source;
+	struct sk_buff *next;
+	unsigned long flags;
+	bool short_write;
+	ssize_t ret;
+
+	if (count < segsz)
+		return count;
+
+	room = evl_iov_flat_length(iov, iovlen) - count;
+	evl_iov_advance(iov, iovlen, count);
+
+	while (count + segsz <= 65535) {
+		raw_spin_lock_irqsave(&e->wait.wchan.lock, flags);
+		next = list_first_entry_or_null(&e->queue, struct sk_buff, list);
+		if (next) {
+			len = udp_payload_len(next);
+			if (!ipv6_addr_equal(&ipv6_hdr(next)->saddr, &saddr) ||
+				udp_hdr(next)->source != sport ||
+				len > segsz || len > room || len == 0)
+				next = NULL;
+			else
+				list_del(&next->list);
+		}
+		raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
+
+		if (next == NULL)
+			break;
+
+		ret = evl_net_skb_to_uio(iov, iovlen, next,
+					sizeof(struct ipv6hdr) + sizeof(struct udphdr),
+					&short_write);
+		evl_net_rput_skb(next);
+		if (ret < 0)
+			return ret;
+		len = ret;
+		count += len;
+		room -= len;
+		if (len < segsz)
+			break;
+		evl_iov_advance(iov, iovlen, len);
+	}
+
+	*segszp = segsz;
+
+	return count;
+}
+
+/* oob */
+static ssize_t receive_udp6(struct evl_socket *esk,
+			struct user_oob_msghdr __user *u_msghdr,
+			struct iovec *iov,
+			size_t iovlen)
+{
+	struct evl_net_udp6_receiver *e;
+	ktime_t timeout, busy_deadline;
+	struct __evl_timespec uts;
+	enum evl_tmode tmode;
+	struct sk_buff *skb;
+	unsigned long flags;
+	__u32 msg_flags = 0;
+	ssize_t ret;
+	__u32 segsz;
+
+again:
+	rcu_read_lock();
+
+	e = READ_ONCE(esk->u.ip.udp6.receiver);
+	if (!e) {
+		/*
+		 * Install the receive slot from the in-band binding,
+		 * or on [::]:0 if none, in which case nothing is ever
+		 * received.
+		 */
+		rcu_read_unlock();
+		lock_sock(esk->sk);
+		e = READ_ONCE(esk->u.ip.udp6.receiver);
+		ret = e ? 0 : add_receive_slot(esk);
+		release_sock(esk->sk);
+		if (!ret)
+			goto again;
+		return ret;
+	}
+
+	evl_get_cache_entry(&e->entry);
+
+	rcu_read_unlock();
+
+	if (u_msghdr) {
+		ret = raw_get_user(msg_flags, &u_msghdr->flags);
+		if (ret) {
+			ret = -EFAULT;
+			goto out;
+		}
+
+		if (msg_flags & ~MSG_DONTWAIT) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		ret = raw_copy_from_user(&uts, &u_msghdr->timeout,
+					sizeof(uts));
+		if (ret) {
+			ret = -EFAULT;
+			goto out;
+		}
+
+		timeout = u_timespec_to_ktime(uts);
+		tmode = timeout ? EVL_ABS : EVL_REL;
+	} else {
+		timeout = EVL_INFINITE;
+		tmode = EVL_REL;
+	}
+
+	if (evl_socket_f_flags(esk) & O_NONBLOCK)
+		msg_flags |= MSG_DONTWAIT;
+
+	busy_deadline = evl_net_busy_poll_deadline(esk);
+
+	do {
+		raw_spin_lock_irqsave(&e->wait.wchan.lock, flags);
+
+		if (!list_empty(&e->queue)) {
+			skb = list_get_entry(&e->queue, struct sk_buff, list);
+			raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
+			evl_net_note_rx(esk, skb);
+			ret = copy_datagram_to_user(u_msghdr, iov, iovlen, skb);
+			segsz = 0;
+			if (ret > 0 && u_msghdr && udp_test_bit(GRO_ENABLED, esk->sk))
+				ret = coalesce_datagrams(e, iov, iovlen,
+							skb, ret, &segsz);
+			if (ret >= 0 && u_msghdr)
+				ret = evl_net_put_rxctl(esk, u_msghdr, skb,
+						segsz ? &segsz : NULL,
+						sizeof(segsz)) ?: ret;
+			evl_net_rput_skb(skb);
+			goto out;
+		}
+
+		if (msg_flags & MSG_DONTWAIT) {
+			raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
+			ret = -EWOULDBLOCK;
+			goto out;
+		}
+
+		if (busy_deadline) {
+			raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
+			busy_deadline = evl_net_busy_poll(esk, busy_deadline);
+			ret = 0;
+			continue;
+		}
+
+		evl_add_wait_queue(&e->wait, timeout, tmode);
+		raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
+		ret = evl_wait_schedule(&e->wait);
+	} while (!ret);
+out:
+	evl_put_cache_entry(&e->entry);
+
+	return ret;
+}
+
+/* oob */
+static __poll_t poll_udp6(struct evl_socket *esk,
+			struct oob_poll_wait *wait)
+{
+	return 0;
+}
+
+/* in-band */
+static struct net_device *get_netif_udp6(struct evl_socket *esk)
+{
+	int ifindex;
+
+	ifindex = READ_ONCE(esk->sk->sk_bound_dev_if);
+	if (ifindex)
+		return evl_net_get_dev_by_index(esk->net, ifindex);
+
+	return NULL;
+}
+
+/*
+ * Ask the in-band FIB for a route to @daddr, passing the result to
+ * the oob front cache if it goes through an oob-enabled device. The
+ * in-band stack resolving the next hop for the datagram we just
+ * offloaded is what fills the neighbor cache.
+ */
+static void learn_route(struct sock *sk, const struct in6_addr *daddr) /* in-band */
+{
+	struct flowi6 fl6 = {
+		.flowi6_proto = IPPROTO_UDP,
+		.flowi6_oif = READ_ONCE(sk->sk_bound_dev_if),
+		.flowi6_mark = READ_ONCE(sk->sk_mark),
+		.flowi6_uid = sk->sk_uid,
+		.daddr = *daddr,
+		.saddr = sk->sk_v6_rcv_saddr,
+	};
+	struct dst_entry *dst;
+
+	if (ipv6_addr_any(daddr) || ipv6_addr_v4mapped(daddr))
+		return;
+
+	dst = ip6_dst_lookup_flow(sock_net(sk), sk, &fl6, NULL);
+	if (IS_ERR(dst))
+		return;
+
+	evl_net_learn_ipv6_route(sock_net(sk), &fl6, dst);
+	dst_release(dst);
+}
+
+/* in-band */
+static void handle_udp6_inband(struct evl_socket *esk)
+{
+	struct evl_net_offload *ofld, *n;
+	struct sock *sk = esk->sk;
+	unsigned long flags;
+	LIST_HEAD(tmp);
+	int ret;
+
+	raw_spin_lock_irqsave(&esk->oob_lock, flags);
+	list_splice_init(&esk->u.ip.pending_output, &tmp);
+	raw_spin_unlock_irqrestore(&esk->oob_lock, flags);
+
+	list_for_each_entry_safe(ofld, n, &tmp, next) {
+		struct msghdr msg = { 0 };
+		list_del(&ofld->next);
+		msg.msg_namelen = ofld->destlen;
+		if (msg.msg_namelen)
+			msg.msg_name = (struct sockaddr *)&ofld->dest.in6;
+		ret = kernel_sendmsg(sk->sk_socket, &msg,
+				&ofld->kvec, 1, ofld->count);
+		if (ret >= 0)
+			learn_route(sk, msg.msg_namelen ?
+				&ofld->dest.in6.sin6_addr : &sk->sk_v6_daddr);
+		evl_free(ofld->kvec.iov_base);
+		evl_uncharge_socket_wmem(esk, ofld->count);
+		evl_free(ofld);
+	}
+}
+
+static bool verify_checksum(struct sk_buff *skb)
+{
+	const struct ipv6hdr *ip6h = ipv6_hdr(skb);
+	struct udphdr *uh = udp_hdr(skb);
+	unsigned int ulen;
+	__wsum csum;
+
+	ulen = ntohs(uh->len);
+	if (ulen < sizeof(*uh) || ulen > skb->len - sizeof(*ip6h))
+		return false;
+
+	if (ulen < skb->len - sizeof(*ip6h) &&
+		pskb_trim_rcsum(skb, sizeof(*ip6h) + ulen))
+		return false;
+
+	/* RFC 8200: a zero checksum is invalid over IPv6. */
+	if (!uh->check)
+		return false;
+
+	if (skb_csum_unnecessary(skb))
+		return true;
+
+	/*
+	 * The hw checksum covers the IPv6 header too, which has no
+	 * checksum of its own to cancel it out, unlike IPv4.
+	 */
+	if (skb->ip_summed == CHECKSUM_COMPLETE) {
+		csum = csum_sub(skb->csum, csum_partial(ip6h, sizeof(*ip6h), 0));
+		if (!csum_ipv6_magic(&ip6h->saddr, &ip6h->daddr, ulen,
+					IPPROTO_UDP, csum))
+			return true;
+	}
+
+	csum = csum_partial(uh, ulen, 0);
+	if (csum_ipv6_magic(&ip6h->saddr, &ip6h->daddr, ulen, IPPROTO_UDP, csum))
+		return false;
+
+	if (skb->ip_summed == CHECKSUM_COMPLETE)
+		netdev_rx_csum_fault(skb->dev, skb);
+
+	return true;
+}
+
+static bool __queue_for_receiver(struct evl_cache *cache,
+				struct sk_buff *skb,
+				const struct __evl_net_udp6_key *key)
+{
+	struct evl_cache_entry *entry = evl_lookup_cache(cache, key);
+	struct evl_net_udp6_receiver *e;
+	unsigned long flags;
+
+	if (entry) {
+		e = container_of(entry, struct evl_net_udp6_receiver, entry);
+		raw_spin_lock_irqsave(&e->wait.wchan.lock, flags);
+		list_add_tail(&skb->list, &e->queue);
+		if (evl_wait_active(&e->wait))
+			evl_wake_up_head(&e->wait);
+		raw_spin_unlock_irqrestore(&e->wait.wchan.lock, flags);
+		evl_put_cache_entry(entry);
+		evl_schedule();
+		return true;
+	}
+
+	return false;
+}
+
+static bool queue_for_receiver(struct sk_buff *skb)
+{
+	struct evl_cache *cache = &dev_net(skb->dev)->oob.ipv6.udp;
+	struct __evl_net_udp6_key key;
+
+	key.dport = ntohs(udp_hdr(skb)->dest);
+	key.daddr = ipv6_hdr(skb)->daddr;
+	if (__queue_for_receiver(cache, skb, &key))
+		return true;
+
+	key.daddr = in6addr_any;
+	return __queue_for_receiver(cache, skb, &key);
+}
+
+int evl_net_deliver_udp6(struct sk_buff *skb)
+{
+	if (unlikely(sizeof(struct ipv6hdr) + sizeof(struct udphdr) > skb->len))
+		return -EINVAL;
+
+	if (!verify_checksum(skb))
+		return -EINVAL;
+
+	return queue_for_receiver(skb) ? 0 : -ESRCH;
+}
+
+static u32 hash_udp6_slot(const void *key)
+{
+	const struct __evl_net_udp6_key *k = key;
+
+	return jhash2((const u32 *)k, sizeof(*k) / sizeof(u32), 0);
+}
+
+static bool eq_udp6_slot(const struct evl_cache_entry *entry,
+			const void *key)
+{
+	const struct __evl_net_udp6_key *k = key;
+	const struct evl_net_udp6_receiver *e =
+		container_of(entry, struct evl_net_udp6_receiver, entry);
+
+	return e->key.dport == k->dport &&
+		ipv6_addr_equal(&e->key.daddr, &k->daddr);
+}
+
+static char *format_udp6_key(const struct evl_cache_entry *entry)
+{
+	const struct evl_net_udp6_receiver *e =
+		container_of(entry, struct evl_net_udp6_receiver, entry);
+
+	return kasprintf(GFP_ATOMIC, "[%pI6c]:%u", &e->key.daddr, e->key.dport);
+}
+
+static const void *get_udp6_key(const struct evl_cache_entry *entry)
+{
+	const struct evl_net_udp6_receiver *e =
+		container_of(entry, struct evl_net_udp6_receiver, entry);
+
+	return &e->key;
+}
+
+static void drop_udp6_slot(struct evl_cache_entry *entry) /* in-band */
+{
+	struct evl_net_udp6_receiver *e =
+		container_of(entry, struct evl_net_udp6_receiver, entry);
+	struct sk_buff *skb, *tmp;
+
+	list_for_each_entry_safe(skb, tmp, &e->queue, list) {
+		list_del(&skb->list);
+		evl_net_free_skb(skb);
+	}
+
+	kfree(e);
+}
+
+static struct evl_cache_ops udp6_cache_ops = {
+	.hash		= hash_udp6_slot,
+	.eq		= eq_udp6_slot,
+	.get_key	= get_udp6_key,
+	.format_key	= format_udp6_key,
+	.drop		= drop_udp6_slot,
+};
+
+int evl_net_init_udp6(struct net *net)
+{
+	struct oob_net_state *nets = &net->oob;
+	struct evl_cache *cache;
+
+	/* Cache of active UDP6 receivers. */
+	cache = &nets->ipv6.udp;
+	cache->ops = &udp6_cache_ops;
+	cache->init_shift = EVL_NET_UDP6_CACHE_SHIFT;
+	cache->name = "udp6_receivers";
+
+	return evl_init_cache(cache);
+}
+
+void evl_net_cleanup_udp6(struct net *net)
+{
+	struct oob_net_state *nets = &net->oob;
+
+	evl_flush_cache(&nets->ipv6.udp);
+}
+
+struct evl_net_proto evl_net_udp6_proto = {
+	.attach	= attach_udp6_socket,
+	.destroy = destroy_udp6_socket,
+	.bind = bind_udp6_socket,
+	.shutdown = shutdown_udp6_socket,
+	.oob_send = send_udp6,
+	.oob_poll = poll_udp6,
+	.oob_receive = receive_udp6,
+	.get_netif = get_netif_udp6,
+	.handle_offload = handle_udp6_inband,
+};
@@ -21,7 +21,12 @@
 #include <evl/net/skb.h>
 #include <evl/net/ipv4/arp.h>
 #include <evl/net/ipv4/route.h>
+#include <evl/net/ipv4/fragment.h>
 #include <evl/net/ipv4.h>
+#include <evl/net/ipv6/ndisc.h>
+#include <evl/net/ipv6/route.h>
+#include <evl/net/ipv6.h>
+#include <evl/net/can.h>
 #include <evl/net.h>
 
 /*
@@ -31,6 +36,7 @@
 void net_init_oob_state(struct net *net)
 {
 	evl_net_init_ipv4(net);
+	evl_net_init_ipv6(net);
 }
 
 /*
@@ -39,6 +45,7 @@ void net_init_oob_state(struct net *net)
  */
 void net_cleanup_oob_state(struct net *net)
 {
+	evl_net_cleanup_ipv6(net);
 	evl_net_cleanup_ipv4(net);
 }
 
@@ -52,6 +59,8 @@ int __init evl_net_init(void)
 
 	evl_net_init_tx();
 
+	evl_net_init_offload();
+
 	evl_net_init_qdisc();
 
 	ret = register_netdevice_notifier(&netdev_notifier);
@@ -66,6 +75,18 @@ int __init evl_net_init(void)
 	if (ret)
 		goto fail_ipv4;
 
+	if (IS_ENABLED(CONFIG_EVL_NET_IPV6)) {
+		ret = evl_register_socket_domain(&evl_net_ipv6);
+		if (ret)
+			goto fail_ipv6;
+	}
+
+	if (IS_ENABLED(CONFIG_EVL_NET_CAN)) {
+		ret = evl_register_socket_domain(&evl_net_can);
+		if (ret)
+			goto fail_can;
+	}
+
 	/* AF_OOB is given no dedicated socket cache. */
 	ret = proto_register(&evl_af_oob_proto, 0);
 	if (ret)
@@ -76,6 +97,12 @@ int __init evl_net_init(void)
 	return 0;
 
 fail_proto:
+	if (IS_ENABLED(CONFIG_EVL_NET_CAN))
+		evl_unregister_socket_domain(&evl_net_can);
+fail_can:
+	if (IS_ENABLED(CONFIG_EVL_NET_IPV6))
+		evl_unregister_socket_domain(&evl_net_ipv6);
+fail_ipv6:
 	evl_unregister_socket_domain(&evl_net_ipv4);
 fail_ipv4:
 	evl_unregister_socket_domain(&evl_net_packet);
@@ -91,6 +118,10 @@ void __init evl_net_cleanup(void)
 {
 	sock_unregister(PF_OOB);
 	proto_unregister(&evl_af_oob_proto);
+	if (IS_ENABLED(CONFIG_EVL_NET_CAN))
+		evl_unregister_socket_domain(&evl_net_can);
+	if (IS_ENABLED(CONFIG_EVL_NET_IPV6))
+		evl_unregister_socket_domain(&evl_net_ipv6);
 	evl_unregister_socket_domain(&evl_net_packet);
 	unregister_netdevice_notifier(&netdev_notifier);
 	evl_net_cleanup_qdisc();
@@ -158,9 +189,7 @@ static ssize_t ipv4_routes_store(struct device *dev,
 {
 	struct net *net = current->nsproxy->net_ns;
 
-	evl_net_flush_ipv4_routes(net, NULL);
-
-	return count;
+	return evl_net_store_ipv4_routes(net, buf, count);
 }
 static DEVICE_ATTR_WO(ipv4_routes);
 
@@ -170,16 +199,85 @@ static ssize_t arp_store(struct device *dev,
 {
 	struct net *net = current->nsproxy->net_ns;
 
-	evl_net_flush_arp(net);
+	return evl_net_store_arp(net, buf, count);
+}
+static DEVICE_ATTR_WO(arp);
+
+#ifdef CONFIG_EVL_NET_IPV6
+
+static ssize_t ipv6_routes_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct net *net = current->nsproxy->net_ns;
+
+	evl_net_flush_ipv6_routes(net, NULL);
 
 	return count;
 }
-static DEVICE_ATTR_WO(arp);
+static DEVICE_ATTR_WO(ipv6_routes);
+
+static ssize_t ndisc_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct net *net = current->nsproxy->net_ns;
+
+	evl_net_flush_ndisc(net);
+
+	return count;
+}
+static DEVICE_ATTR_WO(ndisc);
+
+#endif
+
+static ssize_t caches_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct net *net = current->nsproxy->net_ns;
+	ssize_t ret;
+
+	ret = evl_show_cache_stats(&net->oob.ipv4.arp, buf, PAGE_SIZE);
+	ret += evl_show_cache_stats(&net->oob.ipv4.routes,
+				buf + ret, PAGE_SIZE - ret);
+	ret += evl_show_cache_stats(&net->oob.ipv4.udp,
+				buf + ret, PAGE_SIZE - ret);
+	ret += evl_show_cache_stats(&net->oob.ipv4.mcast,
+				buf + ret, PAGE_SIZE - ret);
+	if (IS_ENABLED(CONFIG_EVL_NET_IPV6)) {
+		ret += evl_show_cache_stats(&net->oob.ipv6.ndisc,
+					buf + ret, PAGE_SIZE - ret);
+		ret += evl_show_cache_stats(&net->oob.ipv6.routes,
+					buf + ret, PAGE_SIZE - ret);
+		ret += evl_show_cache_stats(&net->oob.ipv6.udp,
+					buf + ret, PAGE_SIZE - ret);
+	}
+
+	return ret;
+}
+static DEVICE_ATTR_RO(caches);
+
+static ssize_t ipv4_frags_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct net *net = current->nsproxy->net_ns;
+
+	return evl_ipv4_show_frag_stats(net, buf, PAGE_SIZE);
+}
+static DEVICE_ATTR_RO(ipv4_frags);
 
 static struct attribute *net_attrs[] = {
 	&dev_attr_vlans.attr,
 	&dev_attr_ipv4_routes.attr,
 	&dev_attr_arp.attr,
+#ifdef CONFIG_EVL_NET_IPV6
+	&dev_attr_ipv6_routes.attr,
+	&dev_attr_ndisc.attr,
+#endif
+	&dev_attr_caches.attr,
+	&dev_attr_ipv4_frags.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(net);
@@ -12,10 +12,16 @@
 #include <linux/if_vlan.h>
 #include <linux/interrupt.h>
 #include <linux/irq_work.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <net/dsfield.h>
+#include <net/inet_ecn.h>
 #include <evl/list.h>
 #include <evl/lock.h>
 #include <evl/flag.h>
 #include <evl/net/socket.h>
+#include <evl/net/device.h>
+#include <evl/net/skb.h>
 #include <evl/net/output.h>
 #include <evl/net/qdisc.h>
 
@@ -37,19 +43,20 @@ oob_start_xmit(struct net_device *dev, struct sk_buff *skb)
 	return dev->netdev_ops->ndo_start_xmit(skb, dev);
 }
 
-static inline void do_tx(struct evl_net_qdisc *qdisc,
-			struct net_device *dev, struct sk_buff *skb)
+static inline bool do_tx(struct net_device *dev, struct sk_buff *skb)
 {
+	/* Report the handoff date while the tracker is still valid. */
+	if (skb_shinfo(skb)->tx_flags & SKBTX_SW_TSTAMP)
+		evl_net_report_txstamp(skb);
+
 	evl_net_uncharge_skb_wmem(skb);
 
 	switch (oob_start_xmit(dev, skb)) {
 	case NETDEV_TX_OK:
-		break;
+		return true;
 	default: /* busy, or whatever */
-		qdisc->packet_dropped++;
 		/* FIXME: we need to do better wrt error handling. */
-		evl_net_free_skb(skb);
-		break;
+		return false;
 	}
 }
 
@@ -60,6 +67,7 @@ void evl_net_do_tx(void *arg)
 	struct evl_net_qdisc *qdisc;
 	struct sk_buff *skb;
 	LIST_HEAD(list);
+	bool dropped;
 	int ret;
 
 	est = dev->oob_state.estate;
@@ -69,23 +77,28 @@ void evl_net_do_tx(void *arg)
 		if (ret)
 			break;
 
-		/*
-		 * Reread queueing discipline descriptor to allow
-		 * dynamic updates. FIXME: protect this against
-		 * swap/deletion while pulling packets (stax?).
-		 */
-		qdisc = est->qdisc;
-
 		/*
 		 * First we transmit the traffic as prioritized by the
 		 * out-of-band queueing discipline attached to our
-		 * device.
+		 * device. The descriptor is reread for each packet
+		 * from a RCU read-side, since the qdisc may be
+		 * replaced at any time (see set_qdisc()).
 		 */
 		for (;;) {
+			dropped = false;
+			rcu_read_lock();
+			qdisc = rcu_dereference(est->qdisc);
 			skb = qdisc->oob_ops->dequeue(qdisc);
+			if (skb && !do_tx(dev, skb)) {
+				qdisc->packet_dropped++;
+				evl_net_inc_port_stat(est, tx_errors);
+				dropped = true;
+			}
+			rcu_read_unlock();
 			if (skb == NULL)
 				break;
-			do_tx(qdisc, dev, skb);
+			if (dropped)
+				evl_net_free_skb(skb);
 		}
 	}
 }
@@ -120,6 +133,24 @@ static void xmit_inband(struct irq_work *work) /* in-band, stalled */
 	__raise_softirq_irqoff(NET_TX_SOFTIRQ);
 }
 
+/*
+ * Count the packet as submitted to the port by its socket, qdisc
+ * drops are accounted for separately.
+ */
+static inline void count_tx(struct evl_netdev_state *est,
+			struct sk_buff *skb)
+{
+	struct evl_socket *esk = EVL_NET_CB(skb)->tracker;
+
+	evl_net_inc_port_stat(est, tx_packets);
+	evl_net_add_port_stat(est, tx_bytes, skb->len);
+
+	if (esk) {
+		evl_net_inc_sock_stat(esk, tx_packets);
+		evl_net_add_sock_stat(esk, tx_bytes, skb->len);
+	}
+}
+
 /* oob or in-band */
 static int xmit_oob(struct net_device *dev, struct sk_buff *skb)
 {
@@ -127,14 +158,75 @@ static int xmit_oob(struct net_device *dev, struct sk_buff *skb)
 	int ret;
 
 	ret = evl_net_sched_packet(dev, skb);
-	if (ret)
+	if (ret) {
+		evl_net_inc_port_stat(est, tx_qdisc_drops);
 		return ret;
+	}
 
 	evl_raise_flag(&est->tx_flag);
 
 	return 0;
 }
 
+static void set_tx_dscp(struct sk_buff *skb, u8 dscp)
+{
+	unsigned int nhoff = skb_network_offset(skb);
+
+	/* Keep the ECN bits, ipv4_change_dsfield() fixes the checksum. */
+	switch (skb->protocol) {
+	case htons(ETH_P_IP):
+		if (skb_headlen(skb) >= nhoff + sizeof(struct iphdr))
+			ipv4_change_dsfield(ip_hdr(skb), INET_ECN_MASK, dscp << 2);
+		break;
+	case htons(ETH_P_IPV6):
+		if (skb_headlen(skb) >= nhoff + sizeof(struct ipv6hdr))
+			ipv6_change_dsfield(ipv6_hdr(skb), INET_ECN_MASK, dscp << 2);
+		break;
+	}
+}
+
+static void set_tx_pcp(struct sk_buff *skb, u8 pcp)
+{
+	struct vlan_ethhdr *ehdr;
+	u16 tci;
+
+	/* The VLAN tag is inline, see evl_net_ether_transmit_raw(). */
+	if (skb_headlen(skb) < VLAN_ETH_HLEN)
+		return;
+
+	ehdr = (struct vlan_ethhdr *)skb->data;
+	if (!eth_type_vlan(ehdr->h_vlan_proto))
+		return;
+
+	tci = ntohs(ehdr->h_vlan_TCI) & ~VLAN_PRIO_MASK;
+	ehdr->h_vlan_TCI = htons(tci | (pcp << VLAN_PRIO_SHIFT));
+}
+
+/*
+ * Run the TX program of the port if any, applying the marks it may
+ * have asked for. Returns false if the packet should be dropped.
+ */
+static bool classify_tx(struct net_device *dev, struct sk_buff *skb)
+{
+	u32 verdict = evl_net_filter_tx(dev, skb), marks;
+
+	switch (EVL_TX_ACTION(verdict)) {
+	case EVL_TX_DROP:
+		return false;
+	case EVL_TX_CLASSIFY:
+		marks = EVL_TX_ARG(verdict);
+		if (marks & EVL_TX_SET_PRIO)
+			skb->priority = marks & 0xf;
+		if (marks & EVL_TX_SET_DSCP)
+			set_tx_dscp(skb, (marks >> 5) & 0x3f);
+		if (marks & EVL_TX_SET_PCP)
+			set_tx_pcp(skb, (marks >> 12) & 0x7);
+		break;
+	}
+
+	return true;
+}
+
 /**
  *	evl_net_transmit - queue an egress packet for out-of-band
  *	transmission to the device.
@@ -147,6 +239,9 @@ static int xmit_oob(struct net_device *dev, struct sk_buff *skb)
  *	@skb the packet to queue. Must not be linked to any upstream
  *	queue.
  *
+ *	Returns -EPERM if the TX program of the device dropped the
+ *	packet, which the caller still owns then.
+ *
  *	Prerequisites:
  *	- skb->dev is a valid (real) device. The caller must prevent from
  *        the interface going down.
@@ -165,6 +260,16 @@ int evl_net_transmit(struct sk_buff *skb) /* oob or in-band */
 	if (EVL_WARN_ON(NET, skb->sk))
 		return -EINVAL;
 
+	/*
+	 * Classify before the qdisc sees the packet, the priority
+	 * the TX program may set picks the band or traffic class.
+	 */
+	if (!classify_tx(dev, skb))
+		return -EPERM;
+
+	/* Count before queuing, the packet may go at once. */
+	count_tx(dev->oob_state.estate, skb);
+
 	if (netdev_is_oob_capable(dev))
 		return xmit_oob(dev, skb);
 
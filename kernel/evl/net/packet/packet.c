@@ -13,6 +13,9 @@
 #include <linux/if_vlan.h>
 #include <linux/err.h>
 #include <linux/ip.h>
+#include <linux/log2.h>
+#include <linux/overflow.h>
+#include <linux/math64.h>
 #include <net/sock.h>
 #include <evl/lock.h>
 #include <evl/thread.h>
@@ -20,6 +23,9 @@
 #include <evl/poll.h>
 #include <evl/sched.h>
 #include <evl/uio.h>
+#include <evl/memory.h>
+#include <evl/mutex.h>
+#include <evl/clock.h>
 #include <evl/net/socket.h>
 #include <evl/net/packet.h>
 #include <evl/net/input.h>
@@ -27,12 +33,15 @@
 #include <evl/net/device.h>
 #include <evl/net/skb.h>
 #include <evl/uaccess.h>
+#include <uapi/evl/net/packet-abi.h>
 
 static struct evl_net_proto *
 find_packet_proto(int protocol, struct evl_net_proto *default_proto);
 
 /*
- * Lock nesting: protocol_lock -> rxq->lock -> esk->input_wait.wchan.lock
+ * Receivers look up the protocol hash and the subscriber index
+ * locklessly under RCU, writers serialize on protocol_lock.
+ * Producers to a given socket serialize on its input_wait.wchan.lock.
  * We use linear skbs only (no paged data).
  */
 
@@ -41,91 +50,270 @@ find_packet_proto(int protocol, struct evl_net_proto *default_proto);
 static DEFINE_HASHTABLE(protocol_hash, EVL_PROTO_HASH_BITS);
 
 /*
- * Protects protocol_hash, shared between in-band and oob contexts,
- * never accessed from oob IRQ handlers.
+ * Serializes updates to protocol_hash and to the subscriber lists,
+ * which only happen in-band.
  */
 static DEFINE_EVL_SPINLOCK(protocol_lock);
 
-/* oob, hard irqs off */
-static bool __packet_deliver(struct evl_net_rxqueue *rxq,
-			struct sk_buff *skb, int protocol)
-{
-	struct net_device *dev = skb->dev;
-	bool delivered = false;
+/*
+ * Mapped ring mode, see uapi/evl/net/packet-abi.h for the
+ * protocol. The area is shared with user-space which may scribble
+ * over it, so we work from our private copy of the geometry and of
+ * the counters we move, masking every index we derive from the
+ * shared state. The RX side is fed under the input wait lock, the TX
+ * side is drained under tx_lock. The descriptor rings save the per-packet
+ * syscalls, but the frames are still copied to/from the skbs on the
+ * kernel side, since oob drivers fill and send buffers from their
+ * own page pools.
+ */
+struct evl_packet_umem {
+	struct evl_packet_area *area;
+	struct evl_packet_desc *rx_descs;
+	struct evl_packet_desc *tx_descs;
+	void *frames;
+	u32 frame_size;
+	u32 rx_frames;
+	u32 tx_frames;
+	u32 rx_head;
+	u32 tx_tail;
+	struct evl_kmutex tx_lock;
+	struct evl_packet_sched *sched; /* esk->lock held */
+};
+
+/*
+ * Cyclic transmission schedule, served by a kernel thread which
+ * sends the frames from the TX slots of the mapped area, so that
+ * user-space does not have to wake up for each of them.
+ */
+struct evl_packet_sched {
+	struct evl_kthread kthread;
 	struct evl_socket *esk;
-	struct sk_buff *qskb;
-	u16 vlan_id;
-	int ifindex;
+	struct evl_packet_umem *umem;
+	struct evl_packet_sched_table *table;
+	struct evl_clock *clock;
+	ktime_t start;
+	ktime_t period;
+	u32 max_entries;
+	u32 flags;
+};
 
-	evl_spin_lock(&rxq->lock);
+static inline void *get_umem_frame(struct evl_packet_umem *umem, u32 n)
+{
+	return umem->frames + (size_t)n * umem->frame_size;
+}
+
+/* oob */
+static bool post_umem_frame(struct evl_socket *esk,
+			struct evl_packet_umem *umem,
+			struct sk_buff *skb)
+{
+	struct evl_packet_area *area = umem->area;
+	struct evl_packet_desc *desc;
+	unsigned int len, count;
+	unsigned long flags;
+	u32 head, n;
+
+	evl_net_steer_rx(esk, skb);
+
+	/* Serialize with concurrent producers from other RX lanes. */
+	raw_spin_lock_irqsave(&esk->input_wait.wchan.lock, flags);
 
 	/*
-	 * Subscribers are searched sequentially for a matching net
-	 * device if specified, otherwise we accept traffic from any
-	 * interface. The net_device lookup could be hashed too, but
-	 * [lame excuse coming] we are not supposed to have a
-	 * truckload of NICs to listen to, so keep it plain dumb which
-	 * is going to be faster in the normal case.
+	 * A bogus tail value may only cause drops or overwrite frames
+	 * user-space still owns, we always write within the ring.
 	 */
-	list_for_each_entry(esk, &rxq->subscribers, next_sub) {
-		/*
-		 * Revisit: we could filter on some "activation tag"
-		 * value calculated at activation time
-		 * (enable_oob_port) to eliminate spurious matches on
-		 * a newly registered device reusing an old ifindex we
-		 * initially captured at binding time.
-		 */
-		ifindex = READ_ONCE(esk->u.packet.real_ifindex);
-		if (ifindex) {
-			if (ifindex != dev->ifindex)
-				continue;
-			vlan_id = READ_ONCE(esk->u.packet.vlan_id);
-			if (vlan_id && skb_vlan_tag_get_id(skb) != vlan_id)
-				continue;
+	head = umem->rx_head;
+	if (head - smp_load_acquire(&area->rx.tail) >= umem->rx_frames) {
+		WRITE_ONCE(area->rx.dropped, READ_ONCE(area->rx.dropped) + 1);
+		raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+		evl_net_inc_sock_stat(esk, rx_drops);
+		return false;
+	}
+
+	n = head & (umem->rx_frames - 1);
+	len = skb->len + (skb->data - skb_mac_header(skb));
+	count = min(len, umem->frame_size);
+	memcpy(get_umem_frame(umem, n), skb_mac_header(skb), count);
+
+	desc = umem->rx_descs + n;
+	desc->len = count;
+	desc->ifindex = skb->dev->ifindex;
+	desc->protocol = skb->protocol;
+	desc->pkttype = skb->pkt_type;
+	desc->flags = count < len ? EVL_PACKET_DESC_TRUNC : 0;
+	evl_net_note_rx(esk, skb);
+	evl_net_inc_sock_stat(esk, rx_packets);
+	evl_net_add_sock_stat(esk, rx_bytes, count);
+
+	WRITE_ONCE(umem->rx_head, head + 1);
+	smp_store_release(&area->rx.head, head + 1);
+	if (evl_wait_active(&esk->input_wait))
+		evl_wake_up_head(&esk->input_wait);
+
+	raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+
+	evl_signal_poll_events(&esk->poll_head,	POLLIN|POLLRDNORM);
+
+	return true;
+}
+
+static u32 get_umem_rx_pending(struct evl_packet_umem *umem)
+{
+	u32 pending;
+
+	pending = READ_ONCE(umem->rx_head) -
+		smp_load_acquire(&umem->area->rx.tail);
+
+	return min(pending, umem->rx_frames);
+}
+
+/* oob */
+static void queue_packet(struct evl_socket *esk, struct sk_buff *skb)
+{
+	unsigned long flags;
+
+	evl_net_steer_rx(esk, skb);
+
+	raw_spin_lock_irqsave(&esk->input_wait.wchan.lock, flags);
+
+	list_add_tail(&skb->list, &esk->input);
+	if (evl_wait_active(&esk->input_wait))
+		evl_wake_up_head(&esk->input_wait);
+
+	raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+
+	evl_signal_poll_events(&esk->poll_head,	POLLIN|POLLRDNORM);
+}
+
+static inline u32 get_subscriber_key(int ifindex, u16 vlan_id)
+{
+	return (u32)ifindex * VLAN_N_VID + vlan_id;
+}
+
+enum sub_delivery {
+	SUB_SKIPPED,
+	SUB_DELIVERED,
+	SUB_DONE,
+};
+
+/* oob, rcu_read_lock held. */
+static enum sub_delivery deliver_subscriber(struct evl_socket *esk,
+					struct sk_buff *skb, int protocol,
+					bool *copied)
+{
+	struct evl_packet_umem *umem;
+	struct sk_buff *qskb;
+
+	/*
+	 * Sockets in mapped ring mode receive a copy of the packet
+	 * into their RX ring, so that a consumer of ETH_P_ALL traffic
+	 * needs no clone. Otherwise, we end up consuming the incoming
+	 * buffer, which our caller has to drop once done.
+	 */
+	umem = smp_load_acquire(&esk->u.packet.umem);
+	if (umem) {
+		if (!post_umem_frame(esk, umem, skb))
+			return SUB_SKIPPED;
+		if (protocol != ETH_P_ALL) {
+			*copied = true;
+			return SUB_DONE;
 		}
+		return SUB_DELIVERED;
+	}
 
-		/*
-		 * This packet may be delivered to esk, attempt to
-		 * charge it to its rmem counter. If the socket may
-		 * not consume more memory, skip delivery and try with
-		 * the next subscriber.
-		 */
-		if (!evl_net_charge_skb_rmem(esk, skb))
-			continue;
+	/*
+	 * This packet may be delivered to esk, attempt to charge it
+	 * to its rmem counter. If the socket may not consume more
+	 * memory, skip delivery and try with the next subscriber.
+	 */
+	if (!evl_net_charge_skb_rmem(esk, skb))
+		return SUB_SKIPPED;
 
-		/*
-		 * All sockets bound to ETH_P_ALL receive a clone of
-		 * each incoming buffer, leaving the latter unconsumed
-		 * yet. A single one among the other listeners
-		 * consumes the incoming buffer.
-		 */
-		qskb = skb;
-		if (protocol == ETH_P_ALL) {
-			qskb = evl_net_clone_skb(skb);
-			if (qskb == NULL) {
-				evl_flush_wait(&esk->input_wait, EVL_T_NOMEM);
-				evl_net_uncharge_skb_rmem(skb);
-				break;
-			}
+	/*
+	 * All sockets bound to ETH_P_ALL receive a clone of each
+	 * incoming buffer, leaving the latter unconsumed yet. A
+	 * single one among the other listeners consumes the incoming
+	 * buffer.
+	 */
+	qskb = skb;
+	if (protocol == ETH_P_ALL) {
+		qskb = evl_net_clone_skb(skb);
+		if (qskb == NULL) {
+			evl_flush_wait(&esk->input_wait, EVL_T_NOMEM);
+			evl_net_uncharge_skb_rmem(skb);
+			return SUB_DONE;
 		}
+	}
 
-		raw_spin_lock(&esk->input_wait.wchan.lock);
+	queue_packet(esk, qskb);
 
-		list_add_tail(&qskb->list, &esk->input);
-		if (evl_wait_active(&esk->input_wait))
-			evl_wake_up_head(&esk->input_wait);
+	return protocol == ETH_P_ALL ? SUB_DELIVERED : SUB_DONE;
+}
 
-		raw_spin_unlock(&esk->input_wait.wchan.lock);
+/*
+ * oob, rcu_read_lock held. Deliver to the subscribers bound to
+ * (@ifindex, @vlan_id), zero meaning any device and any VLAN
+ * respectively.
+ */
+static enum sub_delivery deliver_bucket(struct evl_net_rxqueue *rxq,
+					struct sk_buff *skb, int protocol,
+					int ifindex, u16 vlan_id,
+					bool *copied)
+{
+	enum sub_delivery ret = SUB_SKIPPED, status;
+	struct evl_socket *esk;
 
-		evl_signal_poll_events(&esk->poll_head,	POLLIN|POLLRDNORM);
-		delivered = true;
-		if (protocol != ETH_P_ALL)
-			break;
+	/*
+	 * Buckets are shared between keys, so check the binding of
+	 * every socket we find. Rebinding unhashes the socket for a
+	 * grace period before updating it, but we may still read a
+	 * stale binding while it is in flight.
+	 */
+	hash_for_each_possible_rcu(rxq->sub_hash, esk, u.packet.hash_sub,
+				get_subscriber_key(ifindex, vlan_id)) {
+		if (READ_ONCE(esk->u.packet.real_ifindex) != ifindex ||
+			READ_ONCE(esk->u.packet.vlan_id) != vlan_id)
+			continue;
+		status = deliver_subscriber(esk, skb, protocol, copied);
+		if (status == SUB_DONE)
+			return SUB_DONE;
+		if (status == SUB_DELIVERED)
+			ret = SUB_DELIVERED;
 	}
 
-	evl_spin_unlock(&rxq->lock);
+	return ret;
+}
 
-	return delivered;
+/*
+ * oob, rcu_read_lock held. The most specific bindings are served
+ * first: device and VLAN, then device only, then any device.
+ */
+static bool __packet_deliver(struct evl_net_rxqueue *rxq,
+			struct sk_buff *skb, int protocol,
+			bool *copied)
+{
+	int ifindex = skb->dev->ifindex;
+	u16 vlan_id = skb_vlan_tag_get_id(skb);
+	bool delivered = false;
+	enum sub_delivery ret;
+
+	if (vlan_id) {
+		ret = deliver_bucket(rxq, skb, protocol, ifindex, vlan_id, copied);
+		if (ret == SUB_DONE)
+			return true;
+		delivered = ret == SUB_DELIVERED;
+	}
+
+	ret = deliver_bucket(rxq, skb, protocol, ifindex, 0, copied);
+	if (ret == SUB_DONE)
+		return true;
+	delivered |= ret == SUB_DELIVERED;
+
+	ret = deliver_bucket(rxq, skb, protocol, 0, 0, copied);
+	if (ret == SUB_DONE)
+		return true;
+
+	return delivered || ret == SUB_DELIVERED;
 }
 
 /* protocol_lock held, hard irqs off */
@@ -140,6 +328,18 @@ static struct evl_net_rxqueue *find_rxqueue(u32 hkey)
 	return NULL;
 }
 
+/* rcu_read_lock held */
+static struct evl_net_rxqueue *find_rxqueue_rcu(u32 hkey)
+{
+	struct evl_net_rxqueue *rxq;
+
+	hash_for_each_possible_rcu(protocol_hash, rxq, hash, hkey)
+		if (rxq->hkey == hkey)
+			return rxq;
+
+	return NULL;
+}
+
 static inline u32 get_protocol_hash(int protocol)
 {
 	u32 hsrc = protocol;
@@ -150,21 +350,24 @@ static inline u32 get_protocol_hash(int protocol)
 static bool packet_deliver(struct sk_buff *skb, int protocol) /* oob */
 {
 	struct evl_net_rxqueue *rxq;
-	unsigned long flags;
-	bool ret = false;
+	bool ret = false, copied = false;
 	u32 hkey;
 
 	hkey = get_protocol_hash(protocol);
+
+	rcu_read_lock();
+
 	/*
 	 * Find the rx queue linking sockets attached to the protocol.
 	 */
-	evl_spin_lock_irqsave(&protocol_lock, flags); /* FIXME: this is utterly inefficient. */
-
-	rxq = find_rxqueue(hkey);
+	rxq = find_rxqueue_rcu(hkey);
 	if (rxq)
-		ret = __packet_deliver(rxq, skb, protocol);
+		ret = __packet_deliver(rxq, skb, protocol, &copied);
 
-	evl_spin_unlock_irqrestore(&protocol_lock, flags);
+	rcu_read_unlock();
+
+	if (copied)
+		evl_net_free_skb(skb);
 
 	return ret;
 }
@@ -191,6 +394,62 @@ bool evl_net_packet_deliver(struct sk_buff *skb) /* oob */
 	return packet_deliver(skb, ntohs(skb->protocol));
 }
 
+/**
+ *	evl_net_packet_deliver_to - deliver an ethernet packet to a
+ *	given raw socket
+ *
+ *	Deliver @skb to @esk directly, regardless of the protocol and
+ *	device @esk is bound to. This serves the EVL_RX_SOCKET
+ *	verdict of the RX program, which already did the matching.
+ *
+ *	@esk the receiving packet socket.
+ *
+ *	@skb the packet to deliver, not linked to any upstream
+ *	queue.
+ *
+ *      Returns true if @skb was consumed, false if @esk could not
+ *      accept it, in which case the caller still owns @skb.
+ *
+ *	Caller must call evl_schedule().
+ */
+bool evl_net_packet_deliver_to(struct evl_socket *esk,
+			struct sk_buff *skb) /* oob */
+{
+	struct evl_packet_umem *umem;
+	bool ret = false, copied = false;
+
+	/*
+	 * The caller holds a reference on @esk. Unsubscribed sockets
+	 * receive nothing, the producers to the socket serialize
+	 * with the regular packet_deliver() path on the input wait
+	 * channel lock.
+	 */
+	if (list_empty_careful(&esk->next_sub))
+		return false;
+
+	umem = smp_load_acquire(&esk->u.packet.umem);
+	if (umem) {
+		ret = copied = post_umem_frame(esk, umem, skb);
+	} else if (evl_net_charge_skb_rmem(esk, skb)) {
+		queue_packet(esk, skb);
+		ret = true;
+	}
+
+	if (copied)
+		evl_net_free_skb(skb);
+
+	return ret;
+}
+
+/* in-band, protocol_lock held. */
+static void hash_subscriber(struct evl_net_rxqueue *rxq,
+			struct evl_socket *esk)
+{
+	hash_add_rcu(rxq->sub_hash, &esk->u.packet.hash_sub,
+		get_subscriber_key(esk->u.packet.real_ifindex,
+				esk->u.packet.vlan_id));
+}
+
 /* in-band. */
 static int attach_packet_socket(struct evl_socket *esk,
 				struct evl_net_proto *proto, int protocol)
@@ -221,14 +480,18 @@ static int attach_packet_socket(struct evl_socket *esk,
 	esk->u.packet.proto_hash = hkey;
 	esk->protocol = protocol;
 
+	/*
+	 * Index the subscriber before publishing a new rx queue, so
+	 * that receivers never see a partially initialized one.
+	 */
 	_rxq = find_rxqueue(hkey);
 	if (_rxq) {
-		evl_spin_lock(&_rxq->lock);
 		list_add(&esk->next_sub, &_rxq->subscribers);
-		evl_spin_unlock(&_rxq->lock);
+		hash_subscriber(_rxq, esk);
 	} else {
-		hash_add(protocol_hash, &rxq->hash, hkey);
 		list_add(&esk->next_sub, &rxq->subscribers);
+		hash_subscriber(rxq, esk);
+		hash_add_rcu(protocol_hash, &rxq->hash, hkey);
 	}
 
 	evl_spin_unlock_irqrestore(&protocol_lock, flags);
@@ -239,7 +502,11 @@ static int attach_packet_socket(struct evl_socket *esk,
 	return 0;
 }
 
-/* in-band, esk->lock held or __sk_destruct() */
+/*
+ * in-band, esk->lock held or releasing. Receivers may still walk
+ * through @esk and its rx queue until a grace period has elapsed,
+ * which we wait for before returning.
+ */
 static void destroy_packet_socket(struct evl_socket *esk)
 {
 	struct evl_net_rxqueue *rxq, *n;
@@ -254,27 +521,95 @@ static void destroy_packet_socket(struct evl_socket *esk)
 	rxq = find_rxqueue(esk->u.packet.proto_hash);
 
 	list_del_init(&esk->next_sub); /* Remove from rxq->subscribers */
+	hash_del_rcu(&esk->u.packet.hash_sub);
 	if (list_empty(&rxq->subscribers)) {
-		hash_del(&rxq->hash);
+		hash_del_rcu(&rxq->hash);
 		list_add(&rxq->next, &tmp);
 	}
 
 	evl_spin_unlock_irqrestore(&protocol_lock, flags);
 
+	synchronize_rcu();
+
 	list_for_each_entry_safe(rxq, n, &tmp, next)
 		evl_net_free_rxqueue(rxq);
 }
 
+/*
+ * in-band, esk->lock held. Move a subscriber to the index slot
+ * matching its new binding. The socket is unhashed for a grace
+ * period, so that no receiver may follow it from the old slot to
+ * the new one, missing the rest of the former.
+ */
+static void rebind_packet_socket(struct evl_socket *esk,
+				int real_ifindex, u16 vlan_id, int ifindex)
+{
+	struct evl_net_rxqueue *rxq;
+	unsigned long flags;
+	bool hashed;
+
+	evl_spin_lock_irqsave(&protocol_lock, flags);
+	hashed = !list_empty(&esk->next_sub);
+	if (hashed)
+		hash_del_rcu(&esk->u.packet.hash_sub);
+	evl_spin_unlock_irqrestore(&protocol_lock, flags);
+
+	if (hashed)
+		synchronize_rcu();
+
+	/*
+	 * Ensure that all binding-related changes happen atomically
+	 * from the standpoint of oob observers.
+	 */
+	raw_spin_lock_irqsave(&esk->oob_lock, flags);
+	/* First change the real interface, next the vid. */
+	WRITE_ONCE(esk->u.packet.real_ifindex, real_ifindex);
+	WRITE_ONCE(esk->u.packet.vlan_id, vlan_id);
+	WRITE_ONCE(esk->u.packet.ifindex, ifindex);
+	raw_spin_unlock_irqrestore(&esk->oob_lock, flags);
+
+	if (hashed) {
+		evl_spin_lock_irqsave(&protocol_lock, flags);
+		rxq = find_rxqueue(esk->u.packet.proto_hash);
+		hash_subscriber(rxq, esk);
+		evl_spin_unlock_irqrestore(&protocol_lock, flags);
+	}
+}
+
+static void stop_tx_sched(struct evl_socket *esk);
+
+/* in-band, file is closing. */
+static void release_packet_socket(struct evl_socket *esk)
+{
+	stop_tx_sched(esk);
+	/* Unsubscribe while we may still wait for a grace period. */
+	destroy_packet_socket(esk);
+}
+
+/* in-band, __sk_destruct() */
+static void dispose_packet_socket(struct evl_socket *esk)
+{
+	struct evl_packet_umem *umem = esk->u.packet.umem;
+
+	/* No more RX once unsubscribed, TX has stopped already. */
+	destroy_packet_socket(esk);
+
+	if (umem) {
+		evl_destroy_kmutex(&umem->tx_lock);
+		evl_free_chunk(&evl_shared_heap, umem->area);
+		kfree(umem);
+	}
+}
+
 /* in-band */
 static int bind_packet_socket(struct evl_socket *esk,
 			struct sockaddr *addr,
 			int len)
 {
-	int ret, new_ifindex, real_ifindex, old_ifindex;
+	int ret = 0, new_ifindex, real_ifindex, old_ifindex;
 	static struct evl_net_proto *proto;
 	struct net_device *dev = NULL;
 	struct sockaddr_ll *sll;
-	unsigned long flags;
 	u16 vlan_id;
 
 	if (len != sizeof(*sll))
@@ -296,8 +631,10 @@ static int bind_packet_socket(struct evl_socket *esk,
 	if (new_ifindex != old_ifindex) {
 		if (new_ifindex) {
 			dev = evl_net_get_dev_by_index(esk->net, new_ifindex);
-			if (dev == NULL)
+			if (dev == NULL) {
+				ret = -ENXIO;
 				goto out;
+			}
 			if (is_vlan_dev(dev)) {
 				vlan_id = vlan_dev_vlan_id(dev);
 				real_ifindex = vlan_dev_real_dev(dev)->ifindex;
@@ -325,21 +662,8 @@ static int bind_packet_socket(struct evl_socket *esk,
 			goto out;
 	}
 
-	/*
-	 * Ensure that all binding-related changes happen atomically
-	 * from the standpoint of oob observers.
-	 *
-	 * Revisit: cannot race with IRQs, use preemption-disabling
-	 * spinlock instead.
-	 */
-	raw_spin_lock_irqsave(&esk->oob_lock, flags);
-	if (new_ifindex != old_ifindex) {
-		/* First change the real interface, next the vid. */
-		WRITE_ONCE(esk->u.packet.real_ifindex, real_ifindex);
-		esk->u.packet.vlan_id = vlan_id;
-		WRITE_ONCE(esk->u.packet.ifindex, new_ifindex);
-	}
-	raw_spin_unlock_irqrestore(&esk->oob_lock, flags);
+	if (new_ifindex != old_ifindex)
+		rebind_packet_socket(esk, real_ifindex, vlan_id, new_ifindex);
 
  out:
 	mutex_unlock(&esk->lock);
@@ -400,6 +724,75 @@ static struct net_device *find_xmit_device(struct evl_socket *esk,
 	return dev;
 }
 
+/* oob */
+static struct sk_buff *alloc_xmit_skb(struct evl_socket *esk,
+				const struct user_oob_msghdr __user *u_msghdr,
+				struct net_device *real_dev,
+				__be16 protocol,
+				ktime_t timeout, enum evl_tmode tmode)
+{
+	struct sk_buff *skb;
+	int ret;
+
+	skb = evl_net_dev_alloc_skb(real_dev, timeout, tmode);
+	if (IS_ERR(skb))
+		return skb;
+
+	skb_reset_mac_header(skb);
+	skb->protocol = protocol;
+	skb->dev = real_dev;
+	skb->priority = READ_ONCE(esk->sk->sk_priority);
+
+	ret = evl_net_prepare_tx(esk, u_msghdr, skb);
+	if (ret) {
+		evl_net_free_skb(skb);
+		return ERR_PTR(ret);
+	}
+
+	return skb;
+}
+
+/*
+ * oob. Send @count bytes of frame data already copied to @skb. The
+ * caller still owns @skb on error.
+ */
+static int xmit_packet(struct evl_socket *esk,
+		struct net_device *dev, struct sk_buff *skb,
+		size_t count, ktime_t timeout, enum evl_tmode tmode)
+{
+	int ret;
+
+	if (count + dev->hard_header_len + VLAN_HLEN > READ_ONCE(dev->mtu))
+		return -EMSGSIZE;
+
+	if (!dev_validate_header(dev, skb->data, count))
+		return -EINVAL;
+
+	skb_put(skb, count);
+
+	if (!skb->protocol || skb->protocol == htons(ETH_P_ALL))
+		skb->protocol = dev_parse_header_protocol(skb);
+
+	skb_set_network_header(skb, skb->dev->hard_header_len);
+
+	/*
+	 * Charge the socket with the memory consumption of skb,
+	 * waiting for the output to drain if needed. The latter might
+	 * fail if we got forcibly unblocked while waiting for the
+	 * output contention to end, or the caller asked for a
+	 * non-blocking operation while such contention was ongoing.
+	 */
+	ret = evl_net_charge_skb_wmem(esk, skb, timeout, tmode);
+	if (ret)
+		return ret;
+
+	ret = evl_net_ether_transmit_raw(dev, skb);
+	if (ret)
+		evl_net_uncharge_skb_wmem(skb);
+
+	return ret;
+}
+
 /* oob */
 static ssize_t send_packet(struct evl_socket *esk,
 			const struct user_oob_msghdr __user *u_msghdr,
@@ -448,50 +841,22 @@ static ssize_t send_packet(struct evl_socket *esk,
 	 */
 	real_dev = evl_net_real_dev(dev);
 
-	skb = evl_net_dev_alloc_skb(real_dev, timeout, tmode);
+	skb = alloc_xmit_skb(esk, u_msghdr, real_dev, htons(esk->protocol),
+			timeout, tmode);
 	if (IS_ERR(skb)) {
 		ret = PTR_ERR(skb);
 		goto out;
 	}
 
-	skb_reset_mac_header(skb);
-	skb->protocol = htons(esk->protocol);
-	skb->dev = real_dev;
-	skb->priority = READ_ONCE(esk->sk->sk_priority);
-
 	count = evl_copy_from_uio(iov, iovlen, skb->data, skb_tailroom(skb), &rem);
-	if (rem || count + dev->hard_header_len + VLAN_HLEN > READ_ONCE(dev->mtu))
+	if (rem)
 		ret = -EMSGSIZE;
-	else if (!dev_validate_header(dev, skb->data, count))
-		ret = -EINVAL;
+	else
+		ret = xmit_packet(esk, dev, skb, count, timeout, tmode);
 
-	if (ret < 0)
-		goto cleanup;
-
-	skb_put(skb, count);
-
-	if (!skb->protocol || skb->protocol == htons(ETH_P_ALL))
-		skb->protocol = dev_parse_header_protocol(skb);
-
-	skb_set_network_header(skb, real_dev->hard_header_len);
-
-	/*
-	 * Charge the socket with the memory consumption of skb,
-	 * waiting for the output to drain if needed. The latter might
-	 * fail if we got forcibly unblocked while waiting for the
-	 * output contention to end, or the caller asked for a
-	 * non-blocking operation while such contention was ongoing.
-	 */
-	ret = evl_net_charge_skb_wmem(esk, skb, timeout, tmode);
 	if (ret)
 		goto cleanup;
 
-	ret = evl_net_ether_transmit_raw(dev, skb);
-	if (ret) {
-		evl_net_uncharge_skb_wmem(skb);
-		goto cleanup;
-	}
-
 	ret = count;
 out:
 	evl_net_put_dev(dev);
@@ -502,7 +867,8 @@ cleanup:
 	goto out;
 }
 
-static ssize_t copy_packet_to_user(struct user_oob_msghdr __user *u_msghdr,
+static ssize_t copy_packet_to_user(struct evl_socket *esk,
+				struct user_oob_msghdr __user *u_msghdr,
 				const struct iovec *iov,
 				size_t iovlen,
 				struct sk_buff *skb)
@@ -551,6 +917,14 @@ static ssize_t copy_packet_to_user(struct user_oob_msghdr __user *u_msghdr,
 	if (ret)
 		return -EFAULT;
 
+	ret = evl_net_put_rxstamp(u_msghdr, skb);
+	if (ret)
+		return ret;
+
+	ret = evl_net_put_rxctl(esk, u_msghdr, skb, NULL, 0);
+	if (ret)
+		return ret;
+
 	return count;
 }
 
@@ -560,13 +934,15 @@ static ssize_t receive_packet(struct evl_socket *esk,
 			struct iovec *iov,
 			size_t iovlen)
 {
+	struct evl_packet_umem *umem;
 	struct __evl_timespec uts;
 	enum evl_tmode tmode;
+	ktime_t timeout, busy_deadline;
 	struct sk_buff *skb;
 	unsigned long flags;
 	__u32 msg_flags = 0;
-	ktime_t timeout;
 	ssize_t ret;
+	u32 pending;
 
 	if (u_msghdr) {
 		ret = raw_get_user(msg_flags, &u_msghdr->flags);
@@ -596,15 +972,26 @@ static ssize_t receive_packet(struct evl_socket *esk,
 	if (evl_socket_f_flags(esk) & O_NONBLOCK)
 		msg_flags |= MSG_DONTWAIT;
 
+	umem = smp_load_acquire(&esk->u.packet.umem);
+	busy_deadline = evl_net_busy_poll_deadline(esk);
+
 	do {
 		raw_spin_lock_irqsave(&esk->input_wait.wchan.lock, flags);
 
-		if (!list_empty(&esk->input)) {
+		/* In ring mode, wait for the RX ring to fill up. */
+		if (umem) {
+			pending = get_umem_rx_pending(umem);
+			if (pending) {
+				raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+				return pending;
+			}
+		} else if (!list_empty(&esk->input)) {
 			skb = list_get_entry(&esk->input, struct sk_buff, list);
 			raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+			evl_net_note_rx(esk, skb);
 			/* Restore the MAC header. */
 			skb_push(skb, skb->data - skb_mac_header(skb));
-			ret = copy_packet_to_user(u_msghdr, iov, iovlen, skb);
+			ret = copy_packet_to_user(esk, u_msghdr, iov, iovlen, skb);
 			evl_net_uncharge_skb_rmem(skb);
 			evl_net_free_skb(skb);
 			return ret;
@@ -615,6 +1002,14 @@ static ssize_t receive_packet(struct evl_socket *esk,
 			return -EWOULDBLOCK;
 		}
 
+		/* Spin on the input lane before sleeping if enabled. */
+		if (busy_deadline) {
+			raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
+			busy_deadline = evl_net_busy_poll(esk, busy_deadline);
+			ret = 0;
+			continue;
+		}
+
 		evl_add_wait_queue(&esk->input_wait, timeout, tmode);
 		raw_spin_unlock_irqrestore(&esk->input_wait.wchan.lock, flags);
 		ret = evl_wait_schedule(&esk->input_wait);
@@ -628,12 +1023,14 @@ static __poll_t poll_packet(struct evl_socket *esk,
 			struct oob_poll_wait *wait)
 {
 	struct evl_netdev_state *est;
+	struct evl_packet_umem *umem;
 	struct net_device *dev;
 	__poll_t ret = 0;
 
 	/* Enqueue, then test. */
 	evl_poll_watch(&esk->poll_head, wait, NULL);
-	if (!list_empty(&esk->input))
+	umem = smp_load_acquire(&esk->u.packet.umem);
+	if (umem ? get_umem_rx_pending(umem) : !list_empty(&esk->input))
 		ret = POLLIN|POLLRDNORM;
 
 	dev = esk->proto->get_netif(esk);
@@ -648,13 +1045,437 @@ static __poll_t poll_packet(struct evl_socket *esk,
 	return ret;
 }
 
+/* in-band */
+static int setup_umem(struct evl_socket *esk,
+		struct evl_packet_ring_attrs __user *u_attrs)
+{
+	size_t hdr_size, rx_size, tx_size, area_size;
+	struct evl_packet_ring_attrs attrs;
+	struct evl_packet_umem *umem;
+	struct evl_packet_area *area;
+	u32 frame_size;
+	int ret;
+
+	ret = copy_from_user(&attrs, u_attrs, sizeof(attrs));
+	if (ret)
+		return -EFAULT;
+
+	if (attrs.frame_size < ETH_HLEN ||
+		attrs.frame_size > EVL_PACKET_MAX_FRAMESZ ||
+		!attrs.rx_frames || !is_power_of_2(attrs.rx_frames) ||
+		attrs.rx_frames > EVL_PACKET_MAX_FRAMES ||
+		!attrs.tx_frames || !is_power_of_2(attrs.tx_frames) ||
+		attrs.tx_frames > EVL_PACKET_MAX_FRAMES)
+		return -EINVAL;
+
+	/* Keep the frames and descriptor rings on separate lines. */
+	frame_size = ALIGN(attrs.frame_size, L1_CACHE_BYTES);
+	hdr_size = ALIGN(sizeof(*area), L1_CACHE_BYTES);
+	rx_size = ALIGN(attrs.rx_frames * sizeof(struct evl_packet_desc),
+			L1_CACHE_BYTES);
+	tx_size = ALIGN(attrs.tx_frames * sizeof(struct evl_packet_desc),
+			L1_CACHE_BYTES);
+	area_size = size_add(hdr_size + rx_size + tx_size,
+			size_mul(attrs.rx_frames + attrs.tx_frames, frame_size));
+	if (area_size > U32_MAX)
+		return -EINVAL;
+
+	umem = kzalloc(sizeof(*umem), GFP_KERNEL);
+	if (umem == NULL)
+		return -ENOMEM;
+
+	area = evl_zalloc_chunk(&evl_shared_heap, area_size);
+	if (area == NULL) {
+		kfree(umem);
+		return -ENOMEM;
+	}
+
+	area->frame_size = frame_size;
+	area->rx_frames = attrs.rx_frames;
+	area->tx_frames = attrs.tx_frames;
+	area->rx_descs_offset = hdr_size;
+	area->tx_descs_offset = hdr_size + rx_size;
+	area->frames_offset = hdr_size + rx_size + tx_size;
+
+	umem->area = area;
+	umem->rx_descs = (void *)area + hdr_size;
+	umem->tx_descs = (void *)area + hdr_size + rx_size;
+	umem->frames = (void *)area + hdr_size + rx_size + tx_size;
+	umem->frame_size = frame_size;
+	umem->rx_frames = attrs.rx_frames;
+	umem->tx_frames = attrs.tx_frames;
+	evl_init_kmutex(&umem->tx_lock);
+
+	/*
+	 * A socket stays in ring mode until it is closed, so that oob
+	 * users never see the area go stale.
+	 */
+	mutex_lock(&esk->lock);
+
+	if (esk->u.packet.umem) {
+		mutex_unlock(&esk->lock);
+		evl_destroy_kmutex(&umem->tx_lock);
+		evl_free_chunk(&evl_shared_heap, area);
+		kfree(umem);
+		return -EBUSY;
+	}
+
+	smp_store_release(&esk->u.packet.umem, umem);
+
+	mutex_unlock(&esk->lock);
+
+	attrs.area_offset = evl_shared_offset(area);
+
+	return put_user(attrs.area_offset, &u_attrs->area_offset);
+}
+
+/*
+ * oob, umem->tx_lock held. A non-zero @txtime is the launch time of
+ * the frame on the EVL monotonic clock.
+ */
+static int send_umem_frame(struct evl_socket *esk,
+			struct evl_packet_umem *umem, u32 n,
+			ktime_t timeout, enum evl_tmode tmode,
+			ktime_t txtime)
+{
+	struct evl_packet_desc desc = umem->tx_descs[n];
+	struct net_device *dev, *real_dev;
+	struct sk_buff *skb;
+	int ret;
+
+	if (desc.len > umem->frame_size)
+		return -EMSGSIZE;
+
+	if (desc.ifindex)
+		dev = evl_net_get_dev_by_index(esk->net, desc.ifindex);
+	else
+		dev = esk->proto->get_netif(esk);
+
+	if (dev == NULL)
+		return -ENXIO;
+
+	/* Same rules as with send_packet(). */
+	real_dev = evl_net_real_dev(dev);
+
+	skb = alloc_xmit_skb(esk, NULL, real_dev,
+			desc.protocol ?: htons(esk->protocol),
+			timeout, tmode);
+	if (IS_ERR(skb)) {
+		ret = PTR_ERR(skb);
+		goto out;
+	}
+
+	if (txtime)
+		skb->tstamp = txtime;
+
+	if (desc.len > skb_tailroom(skb)) {
+		ret = -EMSGSIZE;
+	} else {
+		memcpy(skb->data, get_umem_frame(umem, umem->rx_frames + n),
+			desc.len);
+		ret = xmit_packet(esk, dev, skb, desc.len, timeout, tmode);
+	}
+
+	if (ret)
+		evl_net_free_skb(skb);
+out:
+	evl_net_put_dev(dev);
+
+	return ret;
+}
+
+/* oob */
+static long kick_umem_tx(struct evl_socket *esk)
+{
+	struct evl_packet_umem *umem;
+	struct evl_packet_area *area;
+	u32 head, pending;
+	enum evl_tmode tmode = EVL_REL;
+	ktime_t timeout;
+	long ret, count;
+
+	umem = smp_load_acquire(&esk->u.packet.umem);
+	if (umem == NULL)
+		return -ENXIO;
+
+	timeout = evl_socket_f_flags(esk) & O_NONBLOCK ?
+		EVL_NONBLOCK : EVL_INFINITE;
+
+	ret = evl_lock_kmutex(&umem->tx_lock);
+	if (ret)
+		return ret;
+
+	area = umem->area;
+	head = smp_load_acquire(&area->tx.head);
+	pending = head - umem->tx_tail;
+	if (pending > umem->tx_frames) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/*
+	 * Malformed descriptors are skipped and counted as dropped,
+	 * we stop at the first resource shortage or wait error,
+	 * leaving the remaining descriptors pending.
+	 */
+	for (count = 0; pending > 0; pending--) {
+		ret = send_umem_frame(esk, umem,
+				umem->tx_tail & (umem->tx_frames - 1),
+				timeout, tmode, 0);
+		if (ret == -EMSGSIZE || ret == -EINVAL || ret == -ENXIO)
+			WRITE_ONCE(area->tx.dropped,
+				READ_ONCE(area->tx.dropped) + 1);
+		else if (ret)
+			break;
+		else
+			count++;
+		smp_store_release(&area->tx.tail, ++umem->tx_tail);
+	}
+
+	if (count || !pending)
+		ret = count;
+out:
+	evl_unlock_kmutex(&umem->tx_lock);
+
+	return ret;
+}
+
+/* oob, sender thread. */
+static int send_sched_frame(struct evl_packet_sched *sched,
+			u32 frame, ktime_t date)
+{
+	struct evl_packet_umem *umem = sched->umem;
+	ktime_t txtime = 0;
+	int ret;
+
+	if (frame >= umem->tx_frames)
+		return -EINVAL;
+
+	if (sched->flags & EVL_PACKET_SCHED_TXTIME) {
+		/* Launch times are read from the monotonic clock. */
+		txtime = ktime_add(evl_read_clock(&evl_mono_clock),
+				ktime_sub(date, evl_read_clock(sched->clock)));
+	} else {
+		if (evl_delay(date, EVL_ABS, sched->clock))
+			return -EINTR;
+	}
+
+	ret = evl_lock_kmutex(&umem->tx_lock);
+	if (ret)
+		return ret;
+
+	/* Never block the schedule on a TX buffer shortage. */
+	ret = send_umem_frame(sched->esk, umem, frame,
+			EVL_NONBLOCK, EVL_REL, txtime);
+
+	evl_unlock_kmutex(&umem->tx_lock);
+
+	return ret;
+}
+
+/*
+ * Cycles we fell behind for are skipped, their frames being counted
+ * as missed, so that the schedule stays in phase with the clock.
+ */
+static void run_tx_sched(void *arg)
+{
+	struct evl_packet_sched *sched = arg;
+	struct evl_packet_sched_table *table = sched->table;
+	struct evl_packet_sched_entry *entry;
+	ktime_t cycle = sched->start, now, lead = 0;
+	u32 nr, n, frame;
+	u64 offset, late;
+
+	/* In launch time mode, a cycle is queued one period ahead. */
+	if (sched->flags & EVL_PACKET_SCHED_TXTIME)
+		lead = sched->period;
+
+	/* Start with the next cycle if the first one is past already. */
+	now = evl_read_clock(sched->clock);
+	if (now > cycle)
+		cycle = ktime_add_ns(cycle, (div64_u64(ktime_sub(now, cycle),
+					sched->period) + 1) * sched->period);
+
+	while (!evl_kthread_should_stop()) {
+		now = evl_read_clock(sched->clock);
+		if (now >= ktime_add(cycle, sched->period)) {
+			late = div64_u64(ktime_sub(now, cycle), sched->period);
+			cycle = ktime_add_ns(cycle, late * sched->period);
+			nr = min(READ_ONCE(table->nr_entries), sched->max_entries);
+			WRITE_ONCE(table->missed, table->missed + late * nr);
+		}
+
+		if (lead && evl_delay(ktime_sub(cycle, lead), EVL_ABS,
+					sched->clock))
+			continue;
+
+		nr = min(READ_ONCE(table->nr_entries), sched->max_entries);
+		for (n = 0; n < nr && !evl_kthread_should_stop(); n++) {
+			entry = table->entries + n;
+			offset = READ_ONCE(entry->offset);
+			frame = READ_ONCE(entry->frame);
+			if (offset >= sched->period ||
+				send_sched_frame(sched, frame,
+						ktime_add_ns(cycle, offset)))
+				WRITE_ONCE(table->missed, table->missed + 1);
+		}
+
+		cycle = ktime_add(cycle, sched->period);
+		WRITE_ONCE(table->cycles, table->cycles + 1);
+	}
+}
+
+/* in-band */
+static int setup_tx_sched(struct evl_socket *esk,
+			struct evl_packet_sched_attrs __user *u_attrs)
+{
+	struct evl_packet_sched_attrs attrs;
+	struct evl_packet_sched *sched;
+	struct evl_packet_umem *umem;
+	size_t table_size;
+	int ret;
+
+	ret = copy_from_user(&attrs, u_attrs, sizeof(attrs));
+	if (ret)
+		return -EFAULT;
+
+	if (!attrs.max_entries ||
+		attrs.max_entries > EVL_PACKET_MAX_SCHED ||
+		attrs.flags & ~EVL_PACKET_SCHED_TXTIME ||
+		attrs.prio < EVL_FIFO_MIN_PRIO ||
+		attrs.prio > EVL_FIFO_MAX_PRIO ||
+		!attrs.period || attrs.period > (u64)KTIME_MAX)
+		return -EINVAL;
+
+	sched = kzalloc(sizeof(*sched), GFP_KERNEL);
+	if (sched == NULL)
+		return -ENOMEM;
+
+	sched->clock = evl_get_clock_by_fd(attrs.clockfd);
+	if (sched->clock == NULL) {
+		ret = -EINVAL;
+		goto fail_clock;
+	}
+
+	table_size = struct_size(sched->table, entries, attrs.max_entries);
+	sched->table = evl_zalloc_chunk(&evl_shared_heap, table_size);
+	if (sched->table == NULL) {
+		ret = -ENOMEM;
+		goto fail_table;
+	}
+
+	sched->esk = esk;
+	sched->start = u_timespec_to_ktime(attrs.start);
+	sched->period = attrs.period;
+	sched->max_entries = attrs.max_entries;
+	sched->flags = attrs.flags;
+
+	mutex_lock(&esk->lock);
+
+	umem = esk->u.packet.umem;
+	if (umem == NULL) {
+		ret = -ENXIO;
+		goto fail_start;
+	}
+
+	if (umem->sched) {
+		ret = -EBUSY;
+		goto fail_start;
+	}
+
+	sched->umem = umem;
+	ret = evl_run_kthread(&sched->kthread, run_tx_sched, sched,
+			attrs.prio, 0, "pktsched:%d", task_pid_nr(current));
+	if (ret)
+		goto fail_start;
+
+	umem->sched = sched;
+
+	mutex_unlock(&esk->lock);
+
+	attrs.table_offset = evl_shared_offset(sched->table);
+
+	return put_user(attrs.table_offset, &u_attrs->table_offset);
+
+fail_start:
+	mutex_unlock(&esk->lock);
+	evl_free_chunk(&evl_shared_heap, sched->table);
+fail_table:
+	evl_put_clock(sched->clock);
+fail_clock:
+	kfree(sched);
+
+	return ret;
+}
+
+/* in-band */
+static void stop_tx_sched(struct evl_socket *esk)
+{
+	struct evl_packet_sched *sched = NULL;
+	struct evl_packet_umem *umem;
+
+	mutex_lock(&esk->lock);
+
+	umem = esk->u.packet.umem;
+	if (umem) {
+		sched = umem->sched;
+		umem->sched = NULL;
+	}
+
+	mutex_unlock(&esk->lock);
+
+	if (sched) {
+		evl_stop_kthread(&sched->kthread);
+		evl_free_chunk(&evl_shared_heap, sched->table);
+		evl_put_clock(sched->clock);
+		kfree(sched);
+	}
+}
+
+/* in-band */
+static int ioctl_packet(struct evl_socket *esk, unsigned int cmd,
+			unsigned long arg)
+{
+	struct evl_packet_sched_attrs __user *u_sattrs;
+	struct evl_packet_ring_attrs __user *u_attrs;
+
+	switch (cmd) {
+	case EVL_PACKET_IOC_SETUP_RING:
+		u_attrs = (typeof(u_attrs))arg;
+		return setup_umem(esk, u_attrs);
+	case EVL_PACKET_IOC_SETUP_SCHED:
+		u_sattrs = (typeof(u_sattrs))arg;
+		return setup_tx_sched(esk, u_sattrs);
+	case EVL_PACKET_IOC_STOP_SCHED:
+		stop_tx_sched(esk);
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+/* oob */
+static long oob_ioctl_packet(struct evl_socket *esk, unsigned int cmd,
+			unsigned long arg)
+{
+	switch (cmd) {
+	case EVL_PACKET_IOC_KICK_TX:
+		return kick_umem_tx(esk);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static struct evl_net_proto ether_packet_proto = {
 	.attach	= attach_packet_socket,
-	.destroy = destroy_packet_socket,
+	.release = release_packet_socket,
+	.destroy = dispose_packet_socket,
 	.bind = bind_packet_socket,
+	.ioctl = ioctl_packet,
 	.oob_send = send_packet,
 	.oob_poll = poll_packet,
 	.oob_receive = receive_packet,
+	.oob_ioctl = oob_ioctl_packet,
 	.get_netif = get_netif_packet,
 };
 
@@ -9,6 +9,8 @@
 #include <linux/slab.h>
 #include <linux/err.h>
 #include <linux/netdevice.h>
+#include <linux/rcupdate.h>
+#include <evl/flag.h>
 #include <evl/net/qdisc.h>
 
 static LIST_HEAD(all_net_qdisc);
@@ -31,7 +33,28 @@ void evl_net_unregister_qdisc(struct evl_net_qdisc_ops *ops) /* in-band */
 }
 EXPORT_SYMBOL_GPL(evl_net_unregister_qdisc);
 
-struct evl_net_qdisc *evl_net_alloc_qdisc(struct evl_net_qdisc_ops *ops) /* in-band */
+struct evl_net_qdisc_ops *evl_net_find_qdisc(const char *name) /* in-band */
+{
+	struct evl_net_qdisc_ops *ops, *found = NULL;
+
+	mutex_lock(&qdisc_list_lock);
+
+	list_for_each_entry(ops, &all_net_qdisc, next) {
+		if (!strcmp(ops->name, name)) {
+			found = ops;
+			break;
+		}
+	}
+
+	mutex_unlock(&qdisc_list_lock);
+
+	return found;
+}
+EXPORT_SYMBOL_GPL(evl_net_find_qdisc);
+
+struct evl_net_qdisc *evl_net_alloc_qdisc(struct evl_net_qdisc_ops *ops,
+					struct net_device *dev,
+					const void *params, size_t len) /* in-band */
 {
 	struct evl_net_qdisc *qdisc;
 	int ret;
@@ -41,8 +64,9 @@ struct evl_net_qdisc *evl_net_alloc_qdisc(struct evl_net_qdisc_ops *ops) /* in-b
 		return ERR_PTR(-ENOMEM);
 
 	qdisc->oob_ops = ops;
+	qdisc->dev = dev;
 
-	ret = ops->init(qdisc);
+	ret = ops->init(qdisc, params, len);
 	if (ret) {
 		kfree(qdisc);
 		return ERR_PTR(ret);
@@ -59,6 +83,24 @@ void evl_net_free_qdisc(struct evl_net_qdisc *qdisc) /* in-band */
 }
 EXPORT_SYMBOL_GPL(evl_net_free_qdisc);
 
+/**
+ *	evl_net_kick_qdisc - wake up the TX handler of the device a
+ *	qdisc is attached to.
+ *
+ *	Qdiscs which hold back packets until some date should call
+ *	this routine when the earliest one becomes eligible, so that
+ *	the next attempt to dequeue picks it.
+ *
+ *	@qdisc the queueing discipline.
+ */
+void evl_net_kick_qdisc(struct evl_net_qdisc *qdisc) /* oob */
+{
+	struct evl_netdev_state *est = qdisc->dev->oob_state.estate;
+
+	evl_raise_flag(&est->tx_flag);
+}
+EXPORT_SYMBOL_GPL(evl_net_kick_qdisc);
+
 /**
  *	evl_net_sched_packet - pass an outgoing buffer to the packet
  *	scheduler.
@@ -70,17 +112,30 @@ EXPORT_SYMBOL_GPL(evl_net_free_qdisc);
  */
 int evl_net_sched_packet(struct net_device *dev, struct sk_buff *skb) /* oob/in-band */
 {
-	struct evl_net_qdisc *qdisc = dev->oob_state.estate->qdisc;
+	struct evl_net_qdisc *qdisc;
+	int ret;
+
+	/* The qdisc may be replaced, see set_qdisc(). */
+	rcu_read_lock();
+	qdisc = rcu_dereference(dev->oob_state.estate->qdisc);
+	ret = qdisc->oob_ops->enqueue(qdisc, skb);
+	rcu_read_unlock();
 
-	return qdisc->oob_ops->enqueue(qdisc, skb);
+	return ret;
 }
 
 void __init evl_net_init_qdisc(void)
 {
 	evl_net_register_qdisc(&evl_net_qdisc_fifo);
+	evl_net_register_qdisc(&evl_net_qdisc_etf);
+	evl_net_register_qdisc(&evl_net_qdisc_taprio);
+	evl_net_register_qdisc(&evl_net_qdisc_prio);
 }
 
 void __init evl_net_cleanup_qdisc(void)
 {
+	evl_net_unregister_qdisc(&evl_net_qdisc_prio);
+	evl_net_unregister_qdisc(&evl_net_qdisc_taprio);
+	evl_net_unregister_qdisc(&evl_net_qdisc_etf);
 	evl_net_unregister_qdisc(&evl_net_qdisc_fifo);
 }
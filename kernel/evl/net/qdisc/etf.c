@@ -0,0 +1,211 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/timekeeping.h>
+#include <net/pkt_sched.h>
+#include <evl/list.h>
+#include <evl/clock.h>
+#include <evl/timer.h>
+#include <evl/net/qdisc.h>
+#include <uapi/evl/net/qdisc-abi.h>
+
+/*
+ * Earliest txtime first. Packets are kept sorted by launch time,
+ * which the senders stored into skb->tstamp from the EVL monotonic
+ * clock, zero meaning as soon as possible. The head of the queue is
+ * released to the device delta nanoseconds ahead of its launch
+ * time, an EVL timer kicks the TX handler when that date is
+ * reached. Packets enqueued past their launch time are dropped,
+ * those which became late while queued are sent immediately.
+ *
+ * With launch time offload, the NIC holds the packet until its
+ * launch time, which is converted to the TAI time base the device
+ * clock is synchronized to.
+ */
+struct qdisc_etf_priv {
+	struct evl_net_qdisc *qdisc;
+	struct list_head queue;
+	hard_spinlock_t lock;
+	struct evl_timer timer;
+	ktime_t delta;
+	bool offload;
+	int txq;
+};
+
+static void etf_timeout(struct evl_timer *timer) /* oob stage stalled */
+{
+	struct qdisc_etf_priv *p = container_of(timer, struct qdisc_etf_priv, timer);
+
+	evl_net_kick_qdisc(p->qdisc);
+}
+
+/* in-band, rtnl_lock held */
+static int set_etf_offload(struct evl_net_qdisc *qdisc, int txq, bool enable)
+{
+	struct net_device *dev = qdisc->dev;
+	struct tc_etf_qopt_offload qopt = {
+		.enable = enable,
+		.queue = txq,
+	};
+
+	if (!dev->netdev_ops->ndo_setup_tc)
+		return -EOPNOTSUPP;
+
+	return dev->netdev_ops->ndo_setup_tc(dev, TC_SETUP_QDISC_ETF, &qopt);
+}
+
+static int init_qdisc_etf(struct evl_net_qdisc *qdisc,
+			const void *params, size_t len)
+{
+	struct qdisc_etf_priv *p = evl_qdisc_priv(qdisc);
+	struct evl_net_etf_params etf = {
+		.delta_ns = 0,
+		.flags = 0,
+		.queue = 0,
+	};
+	int ret;
+
+	if (len) {
+		if (len != sizeof(etf))
+			return -EINVAL;
+		memcpy(&etf, params, sizeof(etf));
+	}
+
+	if (etf.delta_ns < 0 || (etf.flags & ~EVL_NET_ETF_OFFLOAD))
+		return -EINVAL;
+
+	p->qdisc = qdisc;
+	INIT_LIST_HEAD(&p->queue);
+	raw_spin_lock_init(&p->lock);
+	evl_init_timer(&p->timer, etf_timeout);
+	p->delta = ns_to_ktime(etf.delta_ns);
+	p->txq = etf.queue;
+
+	if (etf.flags & EVL_NET_ETF_OFFLOAD) {
+		ret = set_etf_offload(qdisc, etf.queue, true);
+		if (ret)
+			netdev_notice(qdisc->dev,
+				"no launch time offload on queue %d, "
+				"using software release\n", etf.queue);
+		else
+			p->offload = true;
+	}
+
+	return 0;
+}
+
+static void destroy_qdisc_etf(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_etf_priv *p = evl_qdisc_priv(qdisc);
+
+	evl_destroy_timer(&p->timer);
+
+	if (p->offload)
+		set_etf_offload(qdisc, p->txq, false);
+
+	evl_net_free_skb_list(&p->queue);
+}
+
+static int enqueue_qdisc_etf(struct evl_net_qdisc *qdisc,
+			struct sk_buff *skb)
+{
+	struct qdisc_etf_priv *p = evl_qdisc_priv(qdisc);
+	ktime_t now = evl_read_clock(&evl_mono_clock);
+	struct sk_buff *pos;
+	unsigned long flags;
+
+	if (!skb->tstamp) {
+		skb->tstamp = now;
+	} else if (skb->tstamp < now) {
+		qdisc->packet_dropped++;
+		return -ETIME;
+	}
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	/* Launch times mostly come in order, scan from the tail. */
+	list_for_each_entry_reverse(pos, &p->queue, list) {
+		if (pos->tstamp <= skb->tstamp)
+			break;
+	}
+
+	/*
+	 * The caller kicks the TX handler next, which re-arms the
+	 * timer if this packet ends up heading the queue.
+	 */
+	list_add(&skb->list, &pos->list);
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return 0;
+}
+
+static struct sk_buff *dequeue_qdisc_etf(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_etf_priv *p = evl_qdisc_priv(qdisc);
+	struct sk_buff *skb = NULL;
+	unsigned long flags;
+	ktime_t date;
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	if (!list_empty(&p->queue)) {
+		skb = list_first_entry(&p->queue, struct sk_buff, list);
+		date = ktime_sub(skb->tstamp, p->delta);
+		if (date > evl_read_clock(&evl_mono_clock)) {
+			evl_start_timer(&p->timer, date, EVL_INFINITE);
+			skb = NULL;
+		} else {
+			list_del(&skb->list);
+		}
+	}
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	if (skb == NULL)
+		return NULL;
+
+	/*
+	 * Drivers only look at skb->tstamp for launch time offload,
+	 * in which case the date must be converted to TAI.
+	 */
+	if (p->offload)
+		skb->tstamp = ktime_add_ns(skb->tstamp,
+				ktime_get_tai_fast_ns() - ktime_get_mono_fast_ns());
+	else
+		skb->tstamp = 0;
+
+	return skb;
+}
+
+static struct sk_buff *flush_qdisc_etf(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_etf_priv *p = evl_qdisc_priv(qdisc);
+	struct sk_buff *skb = NULL;
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	if (!list_empty(&p->queue)) {
+		skb = list_first_entry(&p->queue, struct sk_buff, list);
+		list_del(&skb->list);
+	}
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return skb;
+}
+
+struct evl_net_qdisc_ops evl_net_qdisc_etf = {
+	.name	        = "oob_etf",
+	.priv_size      = sizeof(struct qdisc_etf_priv),
+	.init		= init_qdisc_etf,
+	.destroy	= destroy_qdisc_etf,
+	.enqueue	= enqueue_qdisc_etf,
+	.dequeue	= dequeue_qdisc_etf,
+	.flush		= flush_qdisc_etf,
+};
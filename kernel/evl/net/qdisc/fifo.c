@@ -14,10 +14,14 @@ struct qdisc_fifo_priv {
 	struct evl_net_skb_queue q;
 };
 
-static int init_qdisc_fifo(struct evl_net_qdisc *qdisc)
+static int init_qdisc_fifo(struct evl_net_qdisc *qdisc,
+			const void *params, size_t len)
 {
 	struct qdisc_fifo_priv *p = evl_qdisc_priv(qdisc);
 
+	if (len)
+		return -EINVAL;
+
 	evl_net_init_skb_queue(&p->q);
 
 	return 0;
@@ -0,0 +1,336 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/if_vlan.h>
+#include <linux/ethtool.h>
+#include <linux/pkt_sched.h>
+#include <evl/list.h>
+#include <evl/clock.h>
+#include <evl/timer.h>
+#include <evl/net/qdisc.h>
+#include <uapi/evl/net/qdisc-abi.h>
+#include <uapi/evl/net/device-abi.h>
+
+/*
+ * Strict priority bands, with optional credit based shaping. Credits
+ * are counted in bit-nanoseconds per second, i.e. 1e6 units per bit,
+ * so that a slope in kbit/s times a duration in nanoseconds gives the
+ * credit change directly. A shaped band which runs out of credit
+ * while others have nothing to send arms a timer for the date it
+ * becomes eligible again, kicking the TX handler from there.
+ */
+
+#define PRIO_DEFAULT_LIMIT	1000
+#define CBS_UNITS_PER_BYTE	(8 * 1000000LL)
+
+struct prio_band {
+	struct list_head queue;
+	unsigned int qlen;
+	unsigned int limit;
+	/* Credit based shaper, idleslope == 0 if disabled. */
+	s64 idleslope;		/* kbit/s */
+	s64 sendslope;		/* kbit/s, negative */
+	s64 hicredit;		/* units */
+	s64 locredit;		/* units */
+	s64 credit;		/* units */
+	ktime_t last;
+	/* Counters */
+	u64 packets;
+	u64 bytes;
+	u64 dropped;
+};
+
+struct qdisc_prio_priv {
+	struct evl_net_qdisc *qdisc;
+	struct prio_band bands[EVL_NET_PRIO_MAX_BANDS];
+	unsigned int nr_bands;
+	u8 prio_band_map[16];
+	u8 pcp_band_map[8];
+	s64 port_rate;		/* kbit/s */
+	hard_spinlock_t lock;
+	struct evl_timer timer;
+};
+
+static void prio_timeout(struct evl_timer *timer) /* oob stage stalled */
+{
+	struct qdisc_prio_priv *p = container_of(timer, struct qdisc_prio_priv, timer);
+
+	evl_net_kick_qdisc(p->qdisc);
+}
+
+/* in-band, rtnl_lock held */
+static s64 get_port_rate(struct net_device *dev)
+{
+	struct ethtool_link_ksettings ecmd;
+
+	if (__ethtool_get_link_ksettings(dev, &ecmd))
+		return 0;
+
+	if (!ecmd.base.speed || ecmd.base.speed == SPEED_UNKNOWN)
+		return 0;
+
+	return (s64)ecmd.base.speed * 1000;
+}
+
+static int init_qdisc_prio(struct evl_net_qdisc *qdisc,
+			const void *params, size_t len)
+{
+	struct qdisc_prio_priv *p = evl_qdisc_priv(qdisc);
+	const struct evl_net_prio_params *pp = params;
+	const struct evl_net_prio_band *pb;
+	struct prio_band *b;
+	unsigned int n;
+
+	if (len != sizeof(*pp) || pp->nr_bands == 0 ||
+		pp->nr_bands > EVL_NET_PRIO_MAX_BANDS)
+		return -EINVAL;
+
+	for (n = 0; n < ARRAY_SIZE(pp->prio_band_map); n++)
+		if (pp->prio_band_map[n] >= pp->nr_bands)
+			return -EINVAL;
+
+	for (n = 0; n < ARRAY_SIZE(pp->pcp_band_map); n++)
+		if (pp->pcp_band_map[n] >= pp->nr_bands)
+			return -EINVAL;
+
+	p->port_rate = get_port_rate(qdisc->dev);
+
+	for (n = 0; n < pp->nr_bands; n++) {
+		pb = pp->bands + n;
+		if (!pb->idleslope_kbps)
+			continue;
+		if (!p->port_rate)
+			return -EOPNOTSUPP;
+		if (pb->idleslope_kbps > p->port_rate ||
+			pb->hicredit < 0 || pb->locredit > 0)
+			return -EINVAL;
+	}
+
+	p->qdisc = qdisc;
+	p->nr_bands = pp->nr_bands;
+	memcpy(p->prio_band_map, pp->prio_band_map, sizeof(p->prio_band_map));
+	memcpy(p->pcp_band_map, pp->pcp_band_map, sizeof(p->pcp_band_map));
+	raw_spin_lock_init(&p->lock);
+	evl_init_timer(&p->timer, prio_timeout);
+
+	for (n = 0; n < p->nr_bands; n++) {
+		pb = pp->bands + n;
+		b = p->bands + n;
+		INIT_LIST_HEAD(&b->queue);
+		b->limit = pb->limit ?: PRIO_DEFAULT_LIMIT;
+		b->idleslope = pb->idleslope_kbps;
+		b->sendslope = b->idleslope - p->port_rate;
+		b->hicredit = pb->hicredit * CBS_UNITS_PER_BYTE;
+		b->locredit = pb->locredit * CBS_UNITS_PER_BYTE;
+	}
+
+	return 0;
+}
+
+static void destroy_qdisc_prio(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_prio_priv *p = evl_qdisc_priv(qdisc);
+	unsigned int n;
+
+	evl_destroy_timer(&p->timer);
+
+	for (n = 0; n < p->nr_bands; n++)
+		evl_net_free_skb_list(&p->bands[n].queue);
+}
+
+static unsigned int classify(struct qdisc_prio_priv *p, struct sk_buff *skb)
+{
+	u16 tci;
+
+	/* Outgoing VLAN frames carry their tag inline. */
+	if (skb_vlan_tag_present(skb))
+		tci = skb_vlan_tag_get(skb);
+	else if (__vlan_get_tag(skb, &tci))
+		return p->prio_band_map[skb->priority & TC_BITMASK];
+
+	return p->pcp_band_map[(tci & VLAN_PRIO_MASK) >> VLAN_PRIO_SHIFT];
+}
+
+/*
+ * hard irqs off, p->lock held. b->last may be ahead of @now while
+ * the last packet sent is still on the wire, its send slope already
+ * accounts for that time.
+ */
+static void restore_credit(struct prio_band *b, ktime_t now, s64 max_credit)
+{
+	if (now <= b->last)
+		return;
+
+	b->credit = min(b->credit + b->idleslope *
+			ktime_to_ns(ktime_sub(now, b->last)), max_credit);
+	b->last = now;
+}
+
+static int enqueue_qdisc_prio(struct evl_net_qdisc *qdisc,
+			struct sk_buff *skb)
+{
+	struct qdisc_prio_priv *p = evl_qdisc_priv(qdisc);
+	struct prio_band *b = p->bands + classify(p, skb);
+	unsigned long flags;
+	int ret = 0;
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	if (b->qlen >= b->limit) {
+		b->dropped++;
+		qdisc->packet_dropped++;
+		ret = -ENOBUFS;
+	} else {
+		/*
+		 * An idle band recovers up to zero credit, and does
+		 * not accrue more.
+		 */
+		if (b->idleslope && !b->qlen)
+			restore_credit(b, evl_read_clock(&evl_mono_clock), 0);
+		list_add_tail(&skb->list, &b->queue);
+		b->qlen++;
+	}
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return ret;
+}
+
+/* hard irqs off, p->lock held */
+static bool band_eligible(struct prio_band *b, ktime_t now, ktime_t *datep)
+{
+	if (!b->idleslope)
+		return true;
+
+	restore_credit(b, now, b->hicredit);
+	if (b->credit >= 0)
+		return true;
+
+	*datep = ktime_add_ns(b->last, div64_s64(-b->credit + b->idleslope - 1,
+						b->idleslope));
+
+	return false;
+}
+
+/* hard irqs off, p->lock held */
+static void charge_band(struct qdisc_prio_priv *p, struct prio_band *b,
+			struct sk_buff *skb, ktime_t now)
+{
+	s64 duration;
+
+	b->packets++;
+	b->bytes += skb->len;
+
+	if (!b->idleslope)
+		return;
+
+	/* Time on the wire in ns, then the credit spent meanwhile. */
+	duration = div64_s64(skb->len * CBS_UNITS_PER_BYTE, p->port_rate);
+	b->credit = max(b->credit + b->sendslope * duration, b->locredit);
+	b->last = ktime_add_ns(now, duration);
+
+	/* Positive credit is lost once the queue drains. */
+	if (!b->qlen && b->credit > 0)
+		b->credit = 0;
+}
+
+static struct sk_buff *dequeue_qdisc_prio(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_prio_priv *p = evl_qdisc_priv(qdisc);
+	ktime_t now, date, next = KTIME_MAX;
+	struct sk_buff *skb = NULL;
+	struct prio_band *b;
+	unsigned long flags;
+	unsigned int n;
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	now = evl_read_clock(&evl_mono_clock);
+
+	for (n = 0; n < p->nr_bands; n++) {
+		b = p->bands + n;
+		if (!b->qlen)
+			continue;
+		if (!band_eligible(b, now, &date)) {
+			next = min(next, date);
+			continue;
+		}
+		skb = list_get_entry(&b->queue, struct sk_buff, list);
+		b->qlen--;
+		charge_band(p, b, skb, now);
+		break;
+	}
+
+	if (skb == NULL && next != KTIME_MAX)
+		evl_start_timer(&p->timer, next, EVL_INFINITE);
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return skb;
+}
+
+static struct sk_buff *flush_qdisc_prio(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_prio_priv *p = evl_qdisc_priv(qdisc);
+	struct sk_buff *skb = NULL;
+	struct prio_band *b;
+	unsigned long flags;
+	unsigned int n;
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	for (n = 0; n < p->nr_bands; n++) {
+		b = p->bands + n;
+		if (b->qlen) {
+			skb = list_get_entry(&b->queue, struct sk_buff, list);
+			b->qlen--;
+			break;
+		}
+	}
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return skb;
+}
+
+static int get_stats_qdisc_prio(struct evl_net_qdisc *qdisc,
+				struct evl_net_qdisc_class_stats *stats,
+				unsigned int nr)
+{
+	struct qdisc_prio_priv *p = evl_qdisc_priv(qdisc);
+	struct prio_band *b;
+	unsigned long flags;
+	unsigned int n;
+
+	nr = min(nr, p->nr_bands);
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	for (n = 0; n < nr; n++) {
+		b = p->bands + n;
+		stats[n].packets = b->packets;
+		stats[n].bytes = b->bytes;
+		stats[n].dropped = b->dropped;
+		stats[n].backlog = b->qlen;
+		stats[n].__pad = 0;
+	}
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return p->nr_bands;
+}
+
+struct evl_net_qdisc_ops evl_net_qdisc_prio = {
+	.name	        = "oob_prio",
+	.priv_size      = sizeof(struct qdisc_prio_priv),
+	.init		= init_qdisc_prio,
+	.destroy	= destroy_qdisc_prio,
+	.enqueue	= enqueue_qdisc_prio,
+	.dequeue	= dequeue_qdisc_prio,
+	.flush		= flush_qdisc_prio,
+	.get_stats	= get_stats_qdisc_prio,
+};
@@ -0,0 +1,340 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/ethtool.h>
+#include <linux/overflow.h>
+#include <linux/pkt_sched.h>
+#include <net/pkt_sched.h>
+#include <evl/list.h>
+#include <evl/clock.h>
+#include <evl/timer.h>
+#include <evl/net/qdisc.h>
+#include <uapi/evl/net/qdisc-abi.h>
+
+/*
+ * Time-aware shaper. The gate control list is walked by an EVL
+ * timer running on the schedule clock, which is re-armed at the end
+ * of every entry, then kicks the TX handler so that the classes
+ * which just opened are served. Entry boundaries are derived from
+ * the base time, so that the schedule never drifts from the clock.
+ * The gate state and the per-class queues are guarded by a single
+ * hard lock, both the timer and the TX handler hold it briefly.
+ *
+ * With offload, the NIC enforces the schedule, we only sort the
+ * traffic into classes and TX queues.
+ */
+
+/* Preamble, start delimiter, FCS and inter-frame gap. */
+#define TAPRIO_FRAME_OVERHEAD	24
+
+struct qdisc_taprio_priv {
+	struct evl_net_qdisc *qdisc;
+	struct evl_clock *clock;
+	struct list_head queues[EVL_NET_TAPRIO_MAX_TC];
+	hard_spinlock_t lock;
+	struct evl_timer timer;
+	struct evl_net_taprio_entry entries[EVL_NET_TAPRIO_MAX_ENTRIES];
+	u8 prio_tc_map[16];
+	unsigned int nr_tc;
+	unsigned int nr_entries;
+	unsigned int cur;	/* Current entry */
+	u32 gates;		/* Open classes */
+	ktime_t base_time;
+	ktime_t cycle_time;
+	ktime_t entry_end;	/* End of current entry, 0 if inactive. */
+	u64 ps_per_byte;	/* Zero if the link speed is unknown. */
+	bool offload;
+};
+
+static void taprio_advance(struct evl_timer *timer) /* oob stage stalled */
+{
+	struct qdisc_taprio_priv *p = container_of(timer, struct qdisc_taprio_priv, timer);
+	struct evl_net_taprio_entry *e;
+
+	raw_spin_lock(&p->lock);
+
+	if (!p->entry_end)	/* Base time reached. */
+		p->entry_end = p->base_time;
+
+	p->cur = (p->cur + 1) % p->nr_entries;
+	e = p->entries + p->cur;
+	p->gates = e->gate_mask;
+	p->entry_end = ktime_add_ns(p->entry_end, e->interval_ns);
+	evl_start_timer(&p->timer, p->entry_end, EVL_INFINITE);
+
+	raw_spin_unlock(&p->lock);
+
+	evl_net_kick_qdisc(p->qdisc);
+}
+
+/* Find the entry covering @now, set the gates accordingly. */
+static void start_schedule(struct qdisc_taprio_priv *p)
+{
+	ktime_t now = evl_read_clock(p->clock), date;
+	unsigned long flags;
+	unsigned int n;
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	if (now < p->base_time) {
+		/* Open wide until the first cycle begins. */
+		p->cur = p->nr_entries - 1;
+		p->gates = GENMASK(p->nr_tc - 1, 0);
+		p->entry_end = 0;
+		evl_start_timer(&p->timer, p->base_time, EVL_INFINITE);
+	} else {
+		/* Start of the current cycle. */
+		date = ktime_divns(ktime_sub(now, p->base_time), p->cycle_time);
+		date = ktime_add(p->base_time, date * p->cycle_time);
+		for (n = 0; n < p->nr_entries; n++) {
+			date = ktime_add_ns(date, p->entries[n].interval_ns);
+			if (date > now)
+				break;
+		}
+		p->cur = n;
+		p->gates = p->entries[n].gate_mask;
+		p->entry_end = date;
+		evl_start_timer(&p->timer, date, EVL_INFINITE);
+	}
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+}
+
+/* in-band, rtnl_lock held */
+static int set_taprio_offload(struct evl_net_qdisc *qdisc, bool enable)
+{
+	struct qdisc_taprio_priv *p = evl_qdisc_priv(qdisc);
+	struct net_device *dev = qdisc->dev;
+	struct tc_taprio_qopt_offload *offload;
+	unsigned int n;
+	int ret;
+
+	if (!dev->netdev_ops->ndo_setup_tc)
+		return -EOPNOTSUPP;
+
+	offload = kzalloc(struct_size(offload, entries, p->nr_entries),
+			GFP_KERNEL);
+	if (offload == NULL)
+		return -ENOMEM;
+
+	if (!enable) {
+		offload->cmd = TAPRIO_CMD_DESTROY;
+		goto setup;
+	}
+
+	if (p->nr_tc > dev->real_num_tx_queues) {
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+
+	offload->cmd = TAPRIO_CMD_REPLACE;
+	offload->mqprio.qopt.num_tc = p->nr_tc;
+	memcpy(offload->mqprio.qopt.prio_tc_map, p->prio_tc_map,
+		sizeof(p->prio_tc_map));
+	for (n = 0; n < p->nr_tc; n++) {
+		offload->mqprio.qopt.count[n] = 1;
+		offload->mqprio.qopt.offset[n] = n;
+	}
+
+	offload->base_time = p->base_time;
+	offload->cycle_time = p->cycle_time;
+	offload->num_entries = p->nr_entries;
+	for (n = 0; n < p->nr_entries; n++) {
+		offload->entries[n].command = TC_TAPRIO_CMD_SET_GATES;
+		offload->entries[n].gate_mask = p->entries[n].gate_mask;
+		offload->entries[n].interval = p->entries[n].interval_ns;
+	}
+setup:
+	ret = dev->netdev_ops->ndo_setup_tc(dev, TC_SETUP_QDISC_TAPRIO, offload);
+out:
+	kfree(offload);
+
+	return ret;
+}
+
+/* in-band, rtnl_lock held */
+static void get_link_speed(struct qdisc_taprio_priv *p, struct net_device *dev)
+{
+	struct ethtool_link_ksettings ecmd;
+
+	p->ps_per_byte = 0;
+
+	if (__ethtool_get_link_ksettings(dev, &ecmd))
+		return;
+
+	if (ecmd.base.speed && ecmd.base.speed != SPEED_UNKNOWN)
+		p->ps_per_byte = div_u64(8ULL * 1000000, ecmd.base.speed);
+}
+
+static int init_qdisc_taprio(struct evl_net_qdisc *qdisc,
+			const void *params, size_t len)
+{
+	struct qdisc_taprio_priv *p = evl_qdisc_priv(qdisc);
+	const struct evl_net_taprio_params *tp = params;
+	unsigned int n;
+	u64 cycle = 0;
+	int ret;
+
+	/* There is no sensible default schedule. */
+	if (len < sizeof(*tp) || tp->nr_entries == 0 ||
+		tp->nr_entries > EVL_NET_TAPRIO_MAX_ENTRIES ||
+		len != struct_size(tp, entries, tp->nr_entries) ||
+		tp->nr_tc == 0 || tp->nr_tc > EVL_NET_TAPRIO_MAX_TC ||
+		tp->base_time_ns < 0 || (tp->flags & ~EVL_NET_TAPRIO_OFFLOAD))
+		return -EINVAL;
+
+	for (n = 0; n < ARRAY_SIZE(tp->prio_tc_map); n++)
+		if (tp->prio_tc_map[n] >= tp->nr_tc)
+			return -EINVAL;
+
+	for (n = 0; n < tp->nr_entries; n++) {
+		if (tp->entries[n].interval_ns == 0 ||
+			tp->entries[n].gate_mask & ~GENMASK(tp->nr_tc - 1, 0))
+			return -EINVAL;
+		cycle += tp->entries[n].interval_ns;
+	}
+
+	p->clock = evl_get_clock_by_fd(tp->clockfd);
+	if (p->clock == NULL)
+		return -EINVAL;
+
+	p->qdisc = qdisc;
+	for (n = 0; n < tp->nr_tc; n++)
+		INIT_LIST_HEAD(p->queues + n);
+	raw_spin_lock_init(&p->lock);
+	evl_init_timer_on_rq(&p->timer, p->clock, taprio_advance,
+			NULL, EVL_TIMER_IGRAVITY);
+	memcpy(p->entries, tp->entries, tp->nr_entries * sizeof(tp->entries[0]));
+	memcpy(p->prio_tc_map, tp->prio_tc_map, sizeof(p->prio_tc_map));
+	p->nr_tc = tp->nr_tc;
+	p->nr_entries = tp->nr_entries;
+	p->base_time = ns_to_ktime(tp->base_time_ns);
+	p->cycle_time = ns_to_ktime(cycle);
+	get_link_speed(p, qdisc->dev);
+
+	if (tp->flags & EVL_NET_TAPRIO_OFFLOAD) {
+		ret = set_taprio_offload(qdisc, true);
+		if (ret)
+			netdev_notice(qdisc->dev,
+				"no taprio offload, using software gates\n");
+		else
+			p->offload = true;
+	}
+
+	/* The NIC enforces the schedule, keep our gates open. */
+	if (p->offload)
+		p->gates = GENMASK(p->nr_tc - 1, 0);
+	else
+		start_schedule(p);
+
+	return 0;
+}
+
+static void destroy_qdisc_taprio(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_taprio_priv *p = evl_qdisc_priv(qdisc);
+	unsigned int n;
+
+	evl_destroy_timer(&p->timer);
+
+	if (p->offload)
+		set_taprio_offload(qdisc, false);
+
+	for (n = 0; n < p->nr_tc; n++)
+		evl_net_free_skb_list(p->queues + n);
+
+	evl_put_clock(p->clock);
+}
+
+static int enqueue_qdisc_taprio(struct evl_net_qdisc *qdisc,
+				struct sk_buff *skb)
+{
+	struct qdisc_taprio_priv *p = evl_qdisc_priv(qdisc);
+	unsigned int tc = p->prio_tc_map[skb->priority & TC_BITMASK];
+	unsigned long flags;
+
+	if (p->offload)
+		skb_set_queue_mapping(skb, tc);
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+	list_add_tail(&skb->list, p->queues + tc);
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return 0;
+}
+
+/* hard irqs off, p->lock held */
+static bool fits_in_window(struct qdisc_taprio_priv *p,
+			struct sk_buff *skb, ktime_t now)
+{
+	u64 duration;
+
+	if (!p->ps_per_byte || !p->entry_end || p->offload)
+		return true;
+
+	duration = div_u64((skb->len + TAPRIO_FRAME_OVERHEAD) * p->ps_per_byte,
+			1000);
+
+	return ktime_add_ns(now, duration) <= p->entry_end;
+}
+
+static struct sk_buff *dequeue_qdisc_taprio(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_taprio_priv *p = evl_qdisc_priv(qdisc);
+	ktime_t now = evl_read_clock(p->clock);
+	struct sk_buff *skb = NULL;
+	unsigned long flags;
+	int tc;
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	for (tc = p->nr_tc - 1; tc >= 0; tc--) {
+		if (!(p->gates & BIT(tc)) || list_empty(p->queues + tc))
+			continue;
+		skb = list_first_entry(p->queues + tc, struct sk_buff, list);
+		if (fits_in_window(p, skb, now)) {
+			list_del(&skb->list);
+			break;
+		}
+		skb = NULL;
+	}
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return skb;
+}
+
+static struct sk_buff *flush_qdisc_taprio(struct evl_net_qdisc *qdisc)
+{
+	struct qdisc_taprio_priv *p = evl_qdisc_priv(qdisc);
+	struct sk_buff *skb = NULL;
+	unsigned long flags;
+	unsigned int tc;
+
+	raw_spin_lock_irqsave(&p->lock, flags);
+
+	for (tc = 0; tc < p->nr_tc; tc++) {
+		if (!list_empty(p->queues + tc)) {
+			skb = list_get_entry(p->queues + tc, struct sk_buff, list);
+			break;
+		}
+	}
+
+	raw_spin_unlock_irqrestore(&p->lock, flags);
+
+	return skb;
+}
+
+struct evl_net_qdisc_ops evl_net_qdisc_taprio = {
+	.name	        = "oob_taprio",
+	.priv_size      = sizeof(struct qdisc_taprio_priv),
+	.init		= init_qdisc_taprio,
+	.destroy	= destroy_qdisc_taprio,
+	.enqueue	= enqueue_qdisc_taprio,
+	.dequeue	= dequeue_qdisc_taprio,
+	.flush		= flush_qdisc_taprio,
+};
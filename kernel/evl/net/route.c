@@ -8,6 +8,7 @@
 #include <net/route.h>
 #include <evl/net/socket.h>
 #include <evl/net/ipv4/route.h>
+#include <evl/net/ipv6/route.h>
 
 /*
  * Cache a new IP route.
@@ -71,4 +72,5 @@ void ip_learn_oob_route(struct net *net, struct flowi4 *fl4, struct rtable *rt)
 void evl_net_flush_routes(struct net *net, struct net_device *dev)
 {
 	evl_net_flush_ipv4_routes(net, dev);
+	evl_net_flush_ipv6_routes(net, dev);
 }
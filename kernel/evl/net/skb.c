@@ -14,7 +14,9 @@
 #include <linux/err.h>
 #include <linux/of_platform.h>
 #include <linux/skbuff_ref.h>
+#include <linux/moduleparam.h>
 #include <net/page_pool/helpers.h>
+#include <net/checksum.h>
 #include <evl/uio.h>
 #include <evl/net.h>
 #include <evl/lock.h>
@@ -24,6 +26,9 @@
 #include <evl/net/device.h>
 #include <evl/net/socket.h>
 
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "evl."
+
 /*
  * skb lifecycle:
  *
@@ -31,6 +36,8 @@
  *             * false: pass down, freed through in-band stack
  *             * true: process -> receive -> evl_net_free_skb(skb)
  *                     skb_has_oob_storage(skb) ? immediately released to oob pool
+ *                              : release_skb_oob(skb) ? immediately released
+ *                                to the driver's oob page pool
  *                              : pushed to in-band recycling queue
  *
  * [TX path]: skb = evl_net_dev_alloc_skb()
@@ -59,6 +66,16 @@
 
 #define SKB_RECYCLING_THRESHOLD 32
 
+/*
+ * Occupancy of adaptive device pools is checked every
+ * netdev_pool_period milliseconds (see dev.c for the size limits).
+ */
+static uint netdev_pool_period_arg = 1000;
+module_param_named(netdev_pool_period, netdev_pool_period_arg, uint, 0444);
+
+/* Periods of low occupancy before a pool is shrunk. */
+#define POOL_IDLE_PERIODS  8
+
 static LIST_HEAD(recycling_queue);
 
 static int recycling_count;
@@ -94,6 +111,76 @@ static inline void maybe_kick_recycler(void)
 		evl_call_inband(&recycler_work);
 }
 
+/* Track the low-water mark of free pages, after pulling some. */
+static inline void note_pool_level(struct evl_netdev_state *est)
+{
+	unsigned int free = page_pool_oob_free(est->tx_pages);
+
+	if (free < atomic_read(&est->pool_low))
+		atomic_set(&est->pool_low, free);
+}
+
+/*
+ * Each CPU keeps a magazine of free pages in front of the device
+ * pool, refilled or drained by half a magazine at a time. This
+ * saves most trips to the pool lock and the wait channel lock on the
+ * fast paths. The magazine size is bounded at setup so that at most
+ * half of the pool may be cached across all CPUs.
+ */
+static struct page *get_magazine_page(struct evl_netdev_state *est)
+{
+	struct evl_netdev_magazine *m;
+	struct page *page = NULL;
+	unsigned long flags;
+
+	if (!est->magazine_size)
+		return NULL;
+
+	flags = hard_local_irq_save();
+
+	m = raw_cpu_ptr(est->magazines);
+	while (m->count < est->magazine_size / 2) {
+		page = page_pool_dev_alloc_pages(est->tx_pages);
+		if (!page)
+			break;
+		m->pages[m->count++] = page;
+	}
+
+	note_pool_level(est);
+	page = m->count > 0 ? m->pages[--m->count] : NULL;
+
+	hard_local_irq_restore(flags);
+
+	return page;
+}
+
+/* @page has no user left. */
+static bool put_magazine_page(struct evl_netdev_state *est,
+			struct page *page)
+{
+	struct evl_netdev_magazine *m;
+	unsigned long flags;
+
+	if (!est->magazine_size)
+		return false;
+
+	flags = hard_local_irq_save();
+
+	m = raw_cpu_ptr(est->magazines);
+	if (m->count >= est->magazine_size) {
+		while (m->count > est->magazine_size / 2)
+			page_pool_put_unrefed_netmem(est->tx_pages,
+					page_to_netmem(m->pages[--m->count]),
+					-1, false);
+	}
+
+	m->pages[m->count++] = page;
+
+	hard_local_irq_restore(flags);
+
+	return true;
+}
+
 static struct page *alloc_bufpage(struct net_device *dev,
 				ktime_t timeout, enum evl_tmode tmode)
 {
@@ -102,12 +189,24 @@ static struct page *alloc_bufpage(struct net_device *dev,
 	struct page *page;
 	int ret;
 
+	page = get_magazine_page(est);
+	if (likely(page))
+		return page;
+
 	for (;;) {
 		raw_spin_lock_irqsave(&est->tx_wait.wchan.lock, flags);
 
 		page = page_pool_dev_alloc_pages(est->tx_pages);
-		if (likely(page))
+		if (likely(page)) {
+			note_pool_level(est);
 			break;
+		}
+
+		atomic_inc(&est->pool_misses);
+
+		/* Ask for more pages without waiting for the next check. */
+		if (est->pool_limit > est->pool_min)
+			evl_call_inband(&est->pool_kick);
 
 		if (timeout == EVL_NONBLOCK) {
 			page = ERR_PTR(-EWOULDBLOCK);
@@ -128,6 +227,46 @@ static struct page *alloc_bufpage(struct net_device *dev,
 	return page;
 }
 
+/*
+ * Give a page back to the device, either to the per-CPU magazine of
+ * the current CPU, or to the pool directly when some thread might
+ * be waiting for buffer space. In the latter case the waiter is only
+ * detected locklessly: if it raced with us, the next release closes
+ * the window.
+ */
+static void release_bufpage(struct net_device *dev, struct page *page)
+{
+	struct evl_netdev_state *est = dev->oob_state.estate;
+	netmem_ref netmem = page_to_netmem(page);
+	unsigned long flags;
+
+	if (!page_pool_unref_and_test(netmem))
+		return;
+
+	/*
+	 * Magazines are only valid while diversion is enabled, they
+	 * are drained before the pool is purged.
+	 */
+	if (likely(list_empty(&est->tx_wait.wchan.wait_list)) &&
+		netif_oob_diversion(dev) && put_magazine_page(est, page))
+		goto signal;
+
+	page_pool_put_unrefed_netmem(est->tx_pages, netmem, -1, false);
+
+	/*
+	 * Wake up any thread waiting for buffer space to send to the
+	 * device we are releasing the page to.
+	 */
+	raw_spin_lock_irqsave(&est->tx_wait.wchan.lock, flags);
+
+	if (evl_wait_active(&est->tx_wait))
+		evl_wake_up_head(&est->tx_wait);
+
+	raw_spin_unlock_irqrestore(&est->tx_wait.wchan.lock, flags);
+signal:
+	evl_signal_poll_events(&est->poll_head,	POLLOUT|POLLWRNORM);
+}
+
 struct sk_buff *evl_net_dev_alloc_skb(struct net_device *dev,
 				      ktime_t timeout, enum evl_tmode tmode)
 {
@@ -182,7 +321,11 @@ struct sk_buff *evl_net_dev_alloc_skb(struct net_device *dev,
 }
 
 /*
- * Plan for a skb to be released by the in-band stack.
+ * Plan for a skb to be released by the in-band stack, unless it only
+ * refers to oob-accessed resources, e.g. a buffer built by an
+ * oob-capable driver around a page from its RX pool. Such buffer is
+ * released to the owning pools immediately, so that the in-band
+ * recycler lagging behind cannot starve the oob RX path.
  *
  * CAUTION: the caller must call evl_schedule() and call the in-band
  * recycler.
@@ -193,7 +336,7 @@ static void free_inband_skb(struct sk_buff *skb)
 
 	if (running_inband()) {
 		finalize_skb_inband(skb);
-	} else {
+	} else if (!release_skb_oob(skb)) {
 		raw_spin_lock_irqsave(&recycling_lock, flags);
 		list_add(&skb->list, &recycling_queue);
 		recycling_count++;
@@ -201,42 +344,31 @@ static void free_inband_skb(struct sk_buff *skb)
 	}
 }
 
-static void __free_evl_skb(struct sk_buff *skb)
+/*
+ * Drop a reference on the data storage of @skb, return true if this
+ * was the last one.
+ */
+static bool put_skb_data(struct sk_buff *skb)
 {
 	struct skb_shared_info *shinfo = skb_shinfo(skb);
-	struct net_device *dev = skb->dev;
-	struct evl_netdev_state *est = dev->oob_state.estate;
-	unsigned long flags;
-
-	/* If the data storage is still shared, don't release it. */
-	if (skb->cloned &&
-	    atomic_sub_return(skb->nohdr ? (1 << SKB_DATAREF_SHIFT) + 1 : 1,
-			      &shinfo->dataref))
-		goto release_head;
 
-	/*
-	 * Release the data. This is the gist of skb_pp_recycle(),
-	 * since we already know for sure that an oob-managed skb is
-	 * built around a page from a per-device pool (in
-	 * evl_netdev_state).
-	 */
-	napi_pp_put_page(page_to_netmem(virt_to_page(skb->head)));
+	return !skb->cloned ||
+		!atomic_sub_return(skb->nohdr ? (1 << SKB_DATAREF_SHIFT) + 1 : 1,
+				&shinfo->dataref);
+}
 
+static void __free_evl_skb(struct sk_buff *skb)
+{
 	/*
-	 * Wake up any thread waiting for buffer space to send to the
-	 * device we are releasing the page to.
+	 * Release the data unless still shared. This is the gist of
+	 * skb_pp_recycle(), since we already know for sure that an
+	 * oob-managed skb is built around a page from a per-device
+	 * pool (in evl_netdev_state).
 	 */
-	raw_spin_lock_irqsave(&est->tx_wait.wchan.lock, flags);
+	if (put_skb_data(skb))
+		release_bufpage(skb->dev, virt_to_page(skb->head));
 
-	if (evl_wait_active(&est->tx_wait))
-		evl_wake_up_head(&est->tx_wait);
-
-	raw_spin_unlock_irqrestore(&est->tx_wait.wchan.lock, flags);
-
-	evl_signal_poll_events(&est->poll_head,	POLLOUT|POLLWRNORM);
-
-release_head:
-	EVL_WARN_ON(NET, atomic_read(&shinfo->dataref) < 0);
+	EVL_WARN_ON(NET, atomic_read(&skb_shinfo(skb)->dataref) < 0);
 	/* Now release the buffer head. */
 	put_oob_skb(skb);
 }
@@ -253,20 +385,26 @@ static void free_evl_skb(struct sk_buff *skb)
 	if (EVL_WARN_ON(NET, dev == NULL))
 		return;
 
+	netdev_dbg(dev, "releasing skb %px (has_frags=%d)\n",
+		skb, skb_has_frag_list(skb));
+
 	/*
-	 * All skbs on a given fragment list are guaranteed to belong
-	 * to the same device.
+	 * The fragment list hangs off the shared info, so clones
+	 * share it too: release it along with the last reference to
+	 * the data. All skbs on a given fragment list are guaranteed
+	 * to belong to the same device.
 	 */
-	for (fskb = skb_shinfo(skb)->frag_list; fskb; fskb = nskb) {
-		netdev_dbg(dev, "releasing frag %px from %px\n", fskb, skb);
-		nskb = fskb->next;
-		__free_evl_skb(fskb);
+	if (put_skb_data(skb)) {
+		for (fskb = skb_shinfo(skb)->frag_list; fskb; fskb = nskb) {
+			netdev_dbg(dev, "releasing frag %px from %px\n", fskb, skb);
+			nskb = fskb->next;
+			__free_evl_skb(fskb);
+		}
+		release_bufpage(dev, virt_to_page(skb->head));
 	}
 
-	netdev_dbg(dev, "releasing skb %px (has_frags=%d)\n",
-		skb, skb_has_frag_list(skb));
-
-	__free_evl_skb(skb);
+	EVL_WARN_ON(NET, atomic_read(&skb_shinfo(skb)->dataref) < 0);
+	put_oob_skb(skb);
 }
 
 static void __free_skb(struct sk_buff *skb)
@@ -369,7 +507,8 @@ void free_skb_oob(struct sk_buff *skb) /* inband/oob */
  *
  *	@skb the packet to clone.
  *
- *      CAUTION: fragments are not cloned.
+ *      CAUTION: fragments are not cloned, but shared with @skb
+ *      until the last reference to the data is dropped.
  */
 struct sk_buff *evl_net_clone_skb(struct sk_buff *skb)
 {
@@ -441,8 +580,13 @@ bool evl_net_charge_skb_rmem(struct evl_socket *esk, struct sk_buff *skb)
 
 	EVL_NET_CB(skb)->tracker = NULL;
 	ret = evl_charge_socket_rmem(esk, skb->truesize);
-	if (likely(ret))
+	if (likely(ret)) {
 		EVL_NET_CB(skb)->tracker = esk;
+		evl_net_inc_sock_stat(esk, rx_packets);
+		evl_net_add_sock_stat(esk, rx_bytes, skb->len);
+	} else {
+		evl_net_inc_sock_stat(esk, rx_drops);
+	}
 
 	return ret;
 }
@@ -486,6 +630,78 @@ void evl_net_uncharge_skb_wmem(struct sk_buff *skb)
 	}
 }
 
+/*
+ * Pages were added to the pool, let the threads waiting for buffer
+ * space retry.
+ */
+static void unblock_pool_waiters(struct evl_netdev_state *est)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&est->tx_wait.wchan.lock, flags);
+	evl_flush_wait_locked(&est->tx_wait, 0);
+	raw_spin_unlock_irqrestore(&est->tx_wait.wchan.lock, flags);
+	evl_signal_poll_events(&est->poll_head, POLLOUT|POLLWRNORM);
+	evl_schedule();
+}
+
+/*
+ * Grow the pool by a quarter when it ran dry or came close to it
+ * during the last period, shrink it by a quarter after it stayed at
+ * most half full for a while, within [pool_min, pool_limit]. Only
+ * free pages can be released, we never wait for those in flight.
+ */
+static void resize_pool(struct work_struct *work)
+{
+	struct evl_netdev_state *est;
+	unsigned int low, size, n;
+	int misses;
+
+	est = container_of(to_delayed_work(work),
+			struct evl_netdev_state, pool_resizer);
+
+	size = est->pool_max;
+	low = atomic_xchg(&est->pool_low, page_pool_oob_free(est->tx_pages));
+	misses = atomic_read(&est->pool_misses);
+	if (misses != est->pool_last_misses)
+		low = 0;
+	est->pool_last_misses = misses;
+
+	est->pool_hist[est->pool_hist_next] =
+		low < size ? (size - low) * 100 / size : 0;
+	est->pool_hist_next = (est->pool_hist_next + 1) % EVL_NETDEV_POOL_HIST;
+
+	if (low <= size / 8) {
+		est->pool_idle = 0;
+		n = min_t(size_t, max(size / 4, 1U), est->pool_limit - size);
+		n = page_pool_oob_grow(est->tx_pages, n);
+		if (n) {
+			WRITE_ONCE(est->pool_max, size + n);
+			unblock_pool_waiters(est);
+		}
+	} else if (low >= size / 2) {
+		if (++est->pool_idle >= POOL_IDLE_PERIODS) {
+			est->pool_idle = 0;
+			n = min_t(size_t, size / 4, size - est->pool_min);
+			n = page_pool_oob_shrink(est->tx_pages, n);
+			WRITE_ONCE(est->pool_max, size - n);
+		}
+	} else {
+		est->pool_idle = 0;
+	}
+
+	schedule_delayed_work(&est->pool_resizer,
+			msecs_to_jiffies(netdev_pool_period_arg));
+}
+
+static void kick_pool_resizer(struct evl_work *work)
+{
+	struct evl_netdev_state *est;
+
+	est = container_of(work, struct evl_netdev_state, pool_kick);
+	mod_delayed_work(system_wq, &est->pool_resizer, 0);
+}
+
 /* in-band */
 int evl_net_dev_build_pool(struct net_device *dev)
 {
@@ -502,13 +718,15 @@ int evl_net_dev_build_pool(struct net_device *dev)
 
 	/*
 	 * Set up a page pool for TX from the EVL netstack through the
-	 * device.
+	 * device. The pool is sized for the largest population we may
+	 * grow to, filled with the requested count of pages.
 	 */
 	est->buf_size = ALIGN(est->buf_size, PAGE_SIZE);
 	pp_params = (struct page_pool_params){
 		.order = ilog2(est->buf_size / PAGE_SIZE),
 		.flags = PP_FLAG_PAGE_OOB,
-		.pool_size = est->pool_max,
+		.pool_size = est->pool_limit,
+		.oob_fill = est->pool_max,
 		.nid = dev_to_node(dev->dev.parent),
 		.dev = dev->dev.parent,
 		.dma_dir = DMA_NONE,
@@ -532,22 +750,59 @@ int evl_net_dev_build_pool(struct net_device *dev)
 	if (IS_ERR(est->tx_pages))
 		return PTR_ERR(est->tx_pages);
 
+	est->magazine_size = min_t(size_t, EVL_NETDEV_MAGAZINE_SIZE,
+				est->pool_max / (2 * num_possible_cpus()));
+	if (est->magazine_size < 2)
+		est->magazine_size = 0;
+
+	est->magazines = alloc_percpu(struct evl_netdev_magazine);
+	if (!est->magazines) {
+		page_pool_destroy(est->tx_pages);
+		return -ENOMEM;
+	}
+
+	atomic_set(&est->pool_misses, 0);
 	evl_init_wait(&est->tx_wait, &evl_mono_clock, EVL_WAIT_PRIO);
 	evl_init_poll_head(&est->poll_head);
 
+	atomic_set(&est->pool_low, est->pool_max);
+	est->pool_last_misses = 0;
+	est->pool_idle = 0;
+	memset(est->pool_hist, 0, sizeof(est->pool_hist));
+	est->pool_hist_next = 0;
+	INIT_DELAYED_WORK(&est->pool_resizer, resize_pool);
+	evl_init_work(&est->pool_kick, kick_pool_resizer);
+	if (est->pool_limit > est->pool_min)
+		schedule_delayed_work(&est->pool_resizer,
+				msecs_to_jiffies(netdev_pool_period_arg));
+
 	return 0;
 }
 
 /* in-band, only when diversion is disabled! */
 void evl_net_dev_purge_pool(struct net_device *dev)
 {
+	struct evl_netdev_magazine *m;
 	struct evl_netdev_state *est;
+	int cpu;
 
 	if (EVL_WARN_ON(NET, netif_oob_diversion(dev)))
 		return;
 
 	est = dev->oob_state.estate;
+	evl_flush_work(&est->pool_kick);
+	cancel_delayed_work_sync(&est->pool_resizer);
 	evl_destroy_wait(&est->tx_wait);
+
+	for_each_possible_cpu(cpu) {
+		m = per_cpu_ptr(est->magazines, cpu);
+		while (m->count > 0)
+			page_pool_put_unrefed_netmem(est->tx_pages,
+					page_to_netmem(m->pages[--m->count]),
+					-1, false);
+	}
+
+	free_percpu(est->magazines);
 	page_pool_destroy(est->tx_pages);
 }
 
@@ -571,8 +826,12 @@ struct sk_buff *evl_net_wget_skb(struct evl_socket *esk,
 		return skb;
 
 	ret = evl_net_charge_skb_wmem(esk, skb, timeout, tmode);
+	if (ret) {
+		evl_net_free_skb(skb);
+		return ERR_PTR(ret);
+	}
 
-	return ret ? ERR_PTR(ret) : skb;
+	return skb;
 }
 
 /*
@@ -698,3 +957,46 @@ ssize_t evl_net_skb_to_uio(const struct iovec *iov, size_t iovlen,
 
 	return ret;
 }
+
+/*
+ * evl_net_load_payload - copy @len bytes of user payload from @src
+ * to @data, accumulating the checksum of the chunk into @csum at
+ * virtual packet offset @offset unless @csum is NULL.
+ *
+ * If @pinned is set and a user buffer pinned by the application
+ * covers the whole chunk, the payload is read through its kernel
+ * mapping, folding the checksum computation into the copy. Otherwise
+ * we go through the uaccess helpers, checksumming the data while it
+ * is still hot in the cache.
+ *
+ * Returns zero on success, -EFAULT on uaccess error.
+ */
+int evl_net_load_payload(void *data, const void __user *src,
+			size_t len, __wsum *csum, size_t offset,
+			bool pinned)
+{
+	struct evl_ubuf *ubuf = NULL;
+	__wsum partial;
+
+	if (pinned)
+		ubuf = evl_get_ubuf(src, len);
+
+	if (ubuf) {
+		if (csum)
+			partial = csum_partial_copy_nocheck(evl_ubuf_ptr(ubuf, src),
+							data, len);
+		else
+			memcpy(data, evl_ubuf_ptr(ubuf, src), len);
+		evl_put_ubuf(ubuf);
+	} else {
+		if (raw_copy_from_user(data, src, len))
+			return -EFAULT;
+		if (csum)
+			partial = csum_partial(data, len, 0);
+	}
+
+	if (csum)
+		*csum = csum_block_add(*csum, partial, offset);
+
+	return 0;
+}
@@ -15,6 +15,8 @@
 #include <linux/if_ether.h>
 #include <linux/err.h>
 #include <linux/hashtable.h>
+#include <linux/llist.h>
+#include <linux/percpu.h>
 #include <linux/jhash.h>
 #include <linux/nsproxy.h>
 #include <linux/compat.h>
@@ -28,6 +30,7 @@
 #include <evl/poll.h>
 #include <evl/memory.h>
 #include <evl/uio.h>
+#include <evl/init.h>
 #include <evl/net/offload.h>
 #include <evl/net/skb.h>
 #include <evl/net/socket.h>
@@ -146,23 +149,132 @@ void evl_unregister_socket_domain(struct evl_socket_domain *domain)
 	mutex_unlock(&domain_lock);
 }
 
-static inline bool charge_socket_wmem(struct evl_socket *esk, size_t size)
-{				/* esk->wmem_wait.wchan.lock held */
-	if (atomic_read(&esk->wmem_count) >= esk->wmem_max)
+/*
+ * Socket memory is charged to the global rmem/wmem counters by
+ * batches of credit cached per-CPU, so that senders and receivers
+ * running on different CPUs mostly update their local cache
+ * instead of bouncing the counters. Credit is grabbed exactly when
+ * a batch would not fit in the budget anymore, and given back in
+ * full when the budget is exhausted, so that the limit is enforced
+ * tightly when it matters. At most twice a batch may linger in the
+ * cache of every CPU, which is why a batch is a small fraction of
+ * the budget.
+ */
+#define EVL_SOCK_CREDIT_RATIO  16
+
+static inline int get_credit_batch(int max)
+{
+	return max / (EVL_SOCK_CREDIT_RATIO * num_possible_cpus());
+}
+
+/* Hard irqs off. */
+static bool charge_credit(atomic_t *count, int max, int batch,
+			int *credit, int size)
+{
+	int need;
+
+	if (*credit >= size) {
+		*credit -= size;
+		return true;
+	}
+
+	/* An overflow of size - 1 is allowed, not more. */
+	if (atomic_read(count) >= max)
 		return false;
 
-	atomic_add(size, &esk->wmem_count);
-	evl_down_crossing(&esk->wmem_drain);
+	need = size - *credit;
+	if (atomic_read(count) + need + batch <= max) {
+		atomic_add(need + batch, count);
+		*credit = batch;
+	} else {
+		atomic_add(need, count);
+		*credit = 0;
+	}
 
 	return true;
 }
 
+/*
+ * Hard irqs off. Returns the updated global count, or INT_MAX if
+ * the credit was kept in the local cache.
+ */
+static int uncharge_credit(atomic_t *count, int max, int batch,
+			int *credit, int size)
+{
+	int excess;
+
+	*credit += size;
+	if (*credit <= 2 * batch && atomic_read(count) < max)
+		return INT_MAX;
+
+	excess = atomic_read(count) < max ? *credit - batch : *credit;
+	*credit -= excess;
+
+	return atomic_sub_return(excess, count);
+}
+
+bool evl_charge_socket_rmem(struct evl_socket *esk, size_t size)
+{
+	unsigned long flags;
+	bool ret;
+
+	flags = hard_local_irq_save();
+	ret = charge_credit(&esk->rmem_count, READ_ONCE(esk->rmem_max),
+			READ_ONCE(esk->rmem_batch),
+			&this_cpu_ptr(esk->credits)->rmem, size);
+	hard_local_irq_restore(flags);
+
+	return ret;
+}
+
+void evl_uncharge_socket_rmem(struct evl_socket *esk, size_t size)
+{
+	unsigned long flags;
+	int count;
+
+	flags = hard_local_irq_save();
+	count = uncharge_credit(&esk->rmem_count, READ_ONCE(esk->rmem_max),
+				READ_ONCE(esk->rmem_batch),
+				&this_cpu_ptr(esk->credits)->rmem, size);
+	hard_local_irq_restore(flags);
+
+	EVL_WARN_ON(NET, count < 0);
+}
+
+static inline bool charge_socket_wmem(struct evl_socket *esk, size_t size)
+{				/* esk->wmem_wait.wchan.lock held */
+	bool ret;
+
+	ret = charge_credit(&esk->wmem_count, esk->wmem_max,
+			READ_ONCE(esk->wmem_batch),
+			&this_cpu_ptr(esk->credits)->wmem, size);
+	if (ret)
+		evl_down_crossing(&esk->wmem_drain);
+
+	return ret;
+}
+
 int evl_charge_socket_wmem(struct evl_socket *esk, size_t size,
 		ktime_t timeout, enum evl_tmode tmode)
 {
+	unsigned long flags;
+	bool ret;
+
 	if (!esk->wmem_max)	/* Unlimited. */
 		return 0;
 
+	/* Try the local credit first, without locking. */
+	flags = hard_local_irq_save();
+	ret = charge_credit(&esk->wmem_count, esk->wmem_max,
+			READ_ONCE(esk->wmem_batch),
+			&this_cpu_ptr(esk->credits)->wmem, size);
+	hard_local_irq_restore(flags);
+
+	if (ret) {
+		evl_down_crossing(&esk->wmem_drain);
+		return 0;
+	}
+
 	return evl_wait_event_timeout(&esk->wmem_wait, timeout, tmode,
 				charge_socket_wmem(esk, size));
 }
@@ -176,16 +288,22 @@ void evl_uncharge_socket_wmem(struct evl_socket *esk, size_t size)
 	 * The tracking socket cannot be stale as it has to pass the
 	 * wmem_crossing first before unwinding in sock_oob_destroy().
 	 */
-	raw_spin_lock_irqsave(&esk->wmem_wait.wchan.lock, flags);
-
-	count = atomic_sub_return(size, &esk->wmem_count);
-	if (count < esk->wmem_max && evl_wait_active(&esk->wmem_wait))
-		evl_flush_wait_locked(&esk->wmem_wait, 0);
+	flags = hard_local_irq_save();
+	count = uncharge_credit(&esk->wmem_count, esk->wmem_max,
+				READ_ONCE(esk->wmem_batch),
+				&this_cpu_ptr(esk->credits)->wmem, size);
+	hard_local_irq_restore(flags);
+
+	/* Only wake up senders when credit went back to the budget. */
+	if (count != INT_MAX) {
+		raw_spin_lock_irqsave(&esk->wmem_wait.wchan.lock, flags);
+		if (count < esk->wmem_max && evl_wait_active(&esk->wmem_wait))
+			evl_flush_wait_locked(&esk->wmem_wait, 0);
+		raw_spin_unlock_irqrestore(&esk->wmem_wait.wchan.lock, flags);
+	}
 
 	evl_up_crossing(&esk->wmem_drain);
 
-	raw_spin_unlock_irqrestore(&esk->wmem_wait.wchan.lock, flags);
-
 	EVL_WARN_ON(NET, count < 0);
 }
 
@@ -222,18 +340,41 @@ static struct evl_net_proto *find_oob_proto(int domain, int type, int protocol)
  * handle from the oob stage directly (e.g. because we don't have the
  * routing information available in our oob front-cache).
  */
-static void inband_offload_handler(struct evl_work *work)
+/*
+ * Sockets with pending offload requests are batched per CPU, so that
+ * a burst of offloads from the oob stage costs a single irq_work
+ * kick, then a single in-band pass over all the requesting sockets.
+ */
+struct evl_net_offload_batch {
+	struct llist_head sockets;
+	struct evl_work work;
+};
+
+static DEFINE_PER_CPU(struct evl_net_offload_batch, offload_batches);
+
+static void flush_offload_batch(struct evl_work *work)
 {
-	struct evl_socket *esk =
-		container_of(work, struct evl_socket, inband_offload);
+	struct evl_net_offload_batch *batch =
+		container_of(work, struct evl_net_offload_batch, work);
+	struct llist_node *first;
+	struct evl_socket *esk, *n;
+	unsigned long flags;
 
-	if (EVL_WARN_ON(NET, !esk->proto->handle_offload))
-		return;
+	/* Sockets were pushed LIFO, serve them in order. */
+	first = llist_reverse_order(llist_del_all(&batch->sockets));
+
+	llist_for_each_entry_safe(esk, n, first, offload_next) {
+		/* Requests queued from now on need another kick. */
+		raw_spin_lock_irqsave(&esk->oob_lock, flags);
+		esk->offload_pending = false;
+		raw_spin_unlock_irqrestore(&esk->oob_lock, flags);
 
-	esk->proto->handle_offload(esk);
+		if (!EVL_WARN_ON(NET, !esk->proto->handle_offload))
+			esk->proto->handle_offload(esk);
 
-	/* Release the ref. obtained by evl_net_offload_inband(). */
-	evl_put_file(&esk->efile);
+		/* Release the ref. obtained by evl_net_offload_inband(). */
+		evl_put_file(&esk->efile);
+	}
 }
 
 /*
@@ -243,20 +384,46 @@ void evl_net_offload_inband(struct evl_socket *esk,
 			struct evl_net_offload *ofld,
 			struct list_head *q)
 {
+	struct evl_net_offload_batch *batch = NULL;
 	unsigned long flags;
 
+	raw_spin_lock_irqsave(&esk->oob_lock, flags);
+
+	list_add_tail(&ofld->next, q);
+	evl_net_inc_sock_stat(esk, tx_offloaded);
+
 	/*
-	 * Make sure esk won't vanish until the offload handler has
-	 * run.
+	 * A socket is batched once until the in-band pass picks it,
+	 * make sure it won't vanish until then.
 	 */
-	evl_get_fileref(&esk->efile);
+	if (!esk->offload_pending) {
+		esk->offload_pending = true;
+		evl_get_fileref(&esk->efile);
+		batch = raw_cpu_ptr(&offload_batches);
+		if (!llist_add(&esk->offload_next, &batch->sockets))
+			batch = NULL; /* Kicked already. */
+	}
 
-	raw_spin_lock_irqsave(&esk->oob_lock, flags);
-	list_add_tail(&ofld->next, q);
 	raw_spin_unlock_irqrestore(&esk->oob_lock, flags);
 
-	if (!evl_call_inband(&esk->inband_offload))
-		evl_put_file(&esk->efile);
+	/*
+	 * If the work is pending already, it will find our socket in
+	 * the batch.
+	 */
+	if (batch)
+		evl_call_inband(&batch->work);
+}
+
+void __init evl_net_init_offload(void)
+{
+	struct evl_net_offload_batch *batch;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		batch = &per_cpu(offload_batches, cpu);
+		init_llist_head(&batch->sockets);
+		evl_init_work(&batch->work, flush_offload_batch);
+	}
 }
 
 /*
@@ -308,6 +475,18 @@ int sock_oob_attach(struct socket *sock)
 
 	esk->sk = sk;
 
+	esk->stats = alloc_percpu(struct evl_socket_pcpu_stats);
+	if (esk->stats == NULL) {
+		ret = -ENOMEM;
+		goto fail_stats;
+	}
+
+	esk->credits = alloc_percpu(struct evl_socket_pcpu_credit);
+	if (esk->credits == NULL) {
+		ret = -ENOMEM;
+		goto fail_credits;
+	}
+
 	/*
 	 * Bind the underlying socket file to an EVL file, which
 	 * enables out-of-band I/O requests for that socket.
@@ -325,14 +504,17 @@ int sock_oob_attach(struct socket *sock)
 	mutex_init(&esk->lock);
 	INIT_LIST_HEAD(&esk->input);
 	INIT_LIST_HEAD(&esk->next_sub);
+	INIT_LIST_HEAD(&esk->errq);
+	esk->rx_cpu = -1;
 	evl_init_wait(&esk->input_wait, &evl_mono_clock, 0);
 	evl_init_wait(&esk->wmem_wait, &evl_mono_clock, 0);
 	evl_init_poll_head(&esk->poll_head);
 	raw_spin_lock_init(&esk->oob_lock);
-	evl_init_work(&esk->inband_offload, inband_offload_handler);
 	/* Inherit the {rw}mem limits from the base socket. */
 	esk->rmem_max = sk->sk_rcvbuf;
+	esk->rmem_batch = get_credit_batch(esk->rmem_max);
 	esk->wmem_max = sk->sk_sndbuf;
+	esk->wmem_batch = get_credit_batch(esk->wmem_max);
 	evl_init_crossing(&esk->wmem_drain);
 
 	ret = proto->attach(esk, proto, ntohs(sk->sk_protocol));
@@ -346,6 +528,10 @@ int sock_oob_attach(struct socket *sock)
 fail_attach:
 	evl_release_file(&esk->efile);
 fail_open:
+	free_percpu(esk->credits);
+fail_credits:
+	free_percpu(esk->stats);
+fail_stats:
 	if (sk->sk_family != PF_OOB)
 		kfree(esk);
 
@@ -372,6 +558,22 @@ void sock_oob_release(struct socket *sock)
 		kfree(esk);
 }
 
+#define EVL_NET_MAX_TXSTAMPS  64
+
+struct evl_net_txstamp {
+	struct list_head next;
+	struct evl_sock_txstamp data;
+};
+
+/* in-band, socket is detaching. */
+static void flush_errq(struct evl_socket *esk)
+{
+	struct evl_net_txstamp *ts, *n;
+
+	list_for_each_entry_safe(ts, n, &esk->errq, next)
+		evl_free(ts);
+}
+
 /*
  * In-band call from the common network stack which is about to
  * destruct a socket, releasing all resources attached (@sock is
@@ -383,6 +585,7 @@ void sock_oob_destroy(struct sock *sk)
 
 	/* We are detaching, so rmem_count can be left out of sync. */
 	evl_net_free_skb_list(&esk->input);
+	flush_errq(esk);
 
 	evl_destroy_wait(&esk->input_wait);
 	evl_destroy_wait(&esk->wmem_wait);
@@ -390,6 +593,9 @@ void sock_oob_destroy(struct sock *sk)
 	if (esk->proto->destroy)
 		esk->proto->destroy(esk);
 
+	free_percpu(esk->credits);
+	free_percpu(esk->stats);
+
 	if (sk->sk_family != PF_OOB && refcount_dec_and_test(&esk->refs))
 		kfree(esk);	/* meaning sk != esk. */
 
@@ -461,16 +667,273 @@ int sock_oob_connect(struct sock *sk,
 	return esk->proto->connect(esk, addr, len, flags);
 }
 
+static int socket_set_txflags(struct evl_socket *esk, __u32 __user *u_flags)
+{
+	__u32 flags;
+	int ret;
+
+	ret = raw_get_user(flags, u_flags);
+	if (ret)
+		return -EFAULT;
+
+	if (flags & ~(EVL_SOCKTX_TIME|EVL_SOCKTX_STAMP))
+		return -EINVAL;
+
+	atomic_set(&esk->tx_seq, 0);
+	WRITE_ONCE(esk->tx_flags, flags);
+
+	return 0;
+}
+
+static int socket_set_rxflags(struct evl_socket *esk, __u32 __user *u_flags)
+{
+	__u32 flags;
+	int ret;
+
+	ret = raw_get_user(flags, u_flags);
+	if (ret)
+		return -EFAULT;
+
+	if (flags & ~EVL_SOCKRX_STAMP)
+		return -EINVAL;
+
+	WRITE_ONCE(esk->rx_flags, flags);
+
+	return 0;
+}
+
+/**
+ *	evl_net_put_rxctl - fill the control buffer of a received
+ *	message.
+ *
+ *	Write the RX stamps of @skb if EVL_SOCKRX_STAMP is set for
+ *	@esk, followed by @len bytes of protocol-specific data from
+ *	@data if non-NULL, then update ctllen to the byte count
+ *	written. The control buffer is left untouched if there is
+ *	nothing to report. Protocol data which does not fit is
+ *	silently dropped, missing room for the stamps is an error.
+ *
+ *	@esk the receiving socket.
+ *
+ *	@u_msghdr the user message header.
+ *
+ *	@skb the packet received.
+ */
+int evl_net_put_rxctl(struct evl_socket *esk,
+		struct user_oob_msghdr __user *u_msghdr,
+		struct sk_buff *skb,
+		const void *data, size_t len) /* oob */
+{
+	bool stamp = READ_ONCE(esk->rx_flags) & EVL_SOCKRX_STAMP;
+	struct evl_sock_rxstamp rxs;
+	__u32 ctllen = 0, off = 0;
+	__u64 ctl_ptr = 0;
+	ktime_t hwstamp;
+	int ret;
+
+	if (!stamp && data == NULL)
+		return 0;
+
+	ret = raw_get_user(ctl_ptr, &u_msghdr->ctl_ptr);
+	if (!ret && ctl_ptr)
+		ret = raw_get_user(ctllen, &u_msghdr->ctllen);
+	if (ret)
+		return -EFAULT;
+
+	if (stamp) {
+		if (ctllen < sizeof(rxs))
+			return -EINVAL;
+		rxs.flags = EVL_SOCKRX_STAMP_SW;
+		rxs.__pad = 0;
+		rxs.sw = ktime_to_u_timespec(skb->tstamp);
+		hwstamp = skb_hwtstamps(skb)->hwtstamp;
+		if (hwstamp)
+			rxs.flags |= EVL_SOCKRX_STAMP_HW;
+		rxs.hw = ktime_to_u_timespec(hwstamp);
+		if (raw_copy_to_user(evl_valptr64(ctl_ptr, void),
+					&rxs, sizeof(rxs)))
+			return -EFAULT;
+		off = sizeof(rxs);
+	}
+
+	if (data && ctllen >= off + len) {
+		if (raw_copy_to_user(evl_valptr64(ctl_ptr, void) + off,
+					data, len))
+			return -EFAULT;
+		off += len;
+	}
+
+	if (off && raw_put_user(off, &u_msghdr->ctllen))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ *	evl_net_prepare_tx - apply the transmit settings of a socket
+ *	to an outgoing packet.
+ *
+ *	Set the launch time of @skb from the message header if
+ *	EVL_SOCKTX_TIME is set for @esk, and request a TX stamp if
+ *	EVL_SOCKTX_STAMP is.
+ *
+ *	@esk the sending socket.
+ *
+ *	@u_msghdr the user message header, NULL if unavailable.
+ *
+ *	@skb the packet, charged to @esk.
+ */
+int evl_net_prepare_tx(struct evl_socket *esk,
+		const struct user_oob_msghdr __user *u_msghdr,
+		struct sk_buff *skb) /* oob */
+{
+	u32 tx_flags = READ_ONCE(esk->tx_flags);
+	struct __evl_timespec uts;
+	struct sk_buff *fskb;
+	int ret;
+
+	skb->tstamp = 0;
+
+	if ((tx_flags & EVL_SOCKTX_TIME) && u_msghdr) {
+		ret = raw_copy_from_user(&uts, &u_msghdr->timestamp,
+					sizeof(uts));
+		if (ret)
+			return -EFAULT;
+		skb->tstamp = u_timespec_to_ktime(uts);
+	}
+
+	/* IP fragments must leave along with the heading frame. */
+	skb_walk_frags(skb, fskb)
+		fskb->tstamp = skb->tstamp;
+
+	if (tx_flags & EVL_SOCKTX_STAMP) {
+		skb_shinfo(skb)->tx_flags |= SKBTX_SW_TSTAMP;
+		skb_shinfo(skb)->tskey = atomic_inc_return(&esk->tx_seq) - 1;
+	}
+
+	return 0;
+}
+
+/**
+ *	evl_net_report_txstamp - queue a TX stamp to the error queue
+ *	of the sending socket.
+ *
+ *	Called by the TX handler right before handing @skb over to
+ *	the driver. Stamps are dropped if the error queue is full.
+ *
+ *	@skb the outgoing packet, still charged to its sender.
+ */
+static void queue_errq(struct evl_socket *esk, u32 id, u32 tsflags)
+{
+	struct evl_net_txstamp *ts;
+	unsigned long flags;
+
+	if (READ_ONCE(esk->errq_len) >= EVL_NET_MAX_TXSTAMPS)
+		return;
+
+	ts = evl_alloc(sizeof(*ts));
+	if (ts == NULL)
+		return;
+
+	ts->data.id = id;
+	ts->data.flags = tsflags;
+	ts->data.stamp = ktime_to_u_timespec(evl_read_clock(&evl_mono_clock));
+
+	raw_spin_lock_irqsave(&esk->oob_lock, flags);
+	list_add_tail(&ts->next, &esk->errq);
+	esk->errq_len++;
+	raw_spin_unlock_irqrestore(&esk->oob_lock, flags);
+
+	evl_signal_poll_events(&esk->poll_head, POLLERR);
+}
+
+void evl_net_report_txstamp(struct sk_buff *skb) /* oob */
+{
+	struct evl_socket *esk = EVL_NET_CB(skb)->tracker;
+
+	skb_shinfo(skb)->tx_flags &= ~SKBTX_SW_TSTAMP;
+
+	if (esk)
+		queue_errq(esk, skb_shinfo(skb)->tskey, EVL_SOCKTX_STAMP_SW);
+}
+
+/**
+ *	evl_net_report_zerocopy - queue a MSG_ZEROCOPY completion to
+ *	the error queue of the sending socket.
+ *
+ *	The payload is always copied to the device pool before the
+ *	send call returns, since oob-capable drivers cannot map user
+ *	pages from the oob stage. So the caller may post the
+ *	completion right after the last datagram of a message was
+ *	built, which is when the user buffer may be reused.
+ *
+ *	@esk the sending socket.
+ */
+void evl_net_report_zerocopy(struct evl_socket *esk) /* oob */
+{
+	queue_errq(esk, atomic_inc_return(&esk->zc_seq) - 1,
+		EVL_SOCKTX_ZEROCOPY_DONE);
+}
+
+static int receive_errq(struct evl_socket *esk,
+			struct user_oob_msghdr __user *u_msghdr)
+{
+	struct evl_net_txstamp *ts = NULL;
+	__u64 ctl_ptr = 0;
+	unsigned long flags;
+	__u32 ctllen = 0;
+	int ret;
+
+	ret = raw_get_user(ctl_ptr, &u_msghdr->ctl_ptr);
+	if (ret)
+		return -EFAULT;
+
+	ret = raw_get_user(ctllen, &u_msghdr->ctllen);
+	if (ret)
+		return -EFAULT;
+
+	if (ctllen < sizeof(ts->data))
+		return -EINVAL;
+
+	raw_spin_lock_irqsave(&esk->oob_lock, flags);
+	if (!list_empty(&esk->errq)) {
+		ts = list_get_entry(&esk->errq, struct evl_net_txstamp, next);
+		esk->errq_len--;
+	}
+	raw_spin_unlock_irqrestore(&esk->oob_lock, flags);
+
+	if (ts == NULL)
+		return -EWOULDBLOCK;
+
+	ret = raw_copy_to_user(evl_valptr64(ctl_ptr, void),
+			&ts->data, sizeof(ts->data));
+	if (!ret)
+		ret = raw_put_user((__s32)sizeof(ts->data), &u_msghdr->count);
+
+	evl_free(ts);
+
+	return ret ? -EFAULT : 0;
+}
+
 static int socket_send_recv(struct evl_socket *esk,
 			struct user_oob_msghdr __user *u_msghdr,
 			unsigned int cmd)
 {
 	struct iovec fast_iov[UIO_FASTIOV], *iov, __user *u_iov;
+	__u32 iovlen, msg_flags;
 	__u64 iov_ptr;
-	__u32 iovlen;
 	__s32 count;
 	int ret;
 
+	/* The error queue is common to all protocols. */
+	if (cmd == EVL_SOCKIOC_RECVMSG) {
+		ret = raw_get_user(msg_flags, &u_msghdr->flags);
+		if (ret)
+			return -EFAULT;
+		if (msg_flags & MSG_ERRQUEUE)
+			return receive_errq(esk, u_msghdr);
+	}
+
 	ret = raw_get_user(iov_ptr, &u_msghdr->iov_ptr);
 	if (ret)
 		return -EFAULT;
@@ -502,11 +965,49 @@ static int socket_send_recv(struct evl_socket *esk,
 	return 0;
 }
 
+static int socket_send_recv_vec(struct evl_socket *esk,
+				struct user_oob_msgvec __user *u_msgvec,
+				unsigned int cmd)
+{
+	struct user_oob_msghdr __user *u_msghdr;
+	struct user_oob_msgvec msgvec;
+	__u32 n;
+	int ret;
+
+	ret = raw_copy_from_user(&msgvec, u_msgvec, sizeof(msgvec));
+	if (ret)
+		return -EFAULT;
+
+	if (msgvec.vlen > UIO_MAXIOV)
+		return -EINVAL;
+
+	u_msghdr = evl_valptr64(msgvec.msg_ptr, struct user_oob_msghdr);
+	cmd = cmd == EVL_SOCKIOC_SENDMMSG ?
+		EVL_SOCKIOC_SENDMSG : EVL_SOCKIOC_RECVMSG;
+
+	for (n = 0; n < msgvec.vlen; n++) {
+		ret = socket_send_recv(esk, u_msghdr + n, cmd);
+		if (ret)
+			break;
+	}
+
+	/* Fail only if nothing went through, report partial completion. */
+	if (n == 0 && ret)
+		return ret;
+
+	if (raw_put_user(n, &u_msgvec->count) ||
+		raw_put_user(ret, &u_msgvec->error))
+		return -EFAULT;
+
+	return 0;
+}
+
 long sock_oob_ioctl(struct file *filp, unsigned int cmd,
 		unsigned long arg)
 {
 	struct evl_socket *esk = evl_sk_from_file(filp);
 	struct user_oob_msghdr __user *u_msghdr;
+	struct user_oob_msgvec __user *u_msgvec;
 	long ret;
 
 	if (esk == NULL)
@@ -518,8 +1019,15 @@ long sock_oob_ioctl(struct file *filp, unsigned int cmd,
 		u_msghdr = (typeof(u_msghdr))arg;
 		ret = socket_send_recv(esk, u_msghdr, cmd);
 		break;
+	case EVL_SOCKIOC_SENDMMSG:
+	case EVL_SOCKIOC_RECVMMSG:
+		u_msgvec = (typeof(u_msgvec))arg;
+		ret = socket_send_recv_vec(esk, u_msgvec, cmd);
+		break;
 	default:
 		ret = -ENOTTY;
+		if (esk->proto->oob_ioctl)
+			ret = esk->proto->oob_ioctl(esk, cmd, arg);
 	}
 
 	return ret;
@@ -565,11 +1073,16 @@ __poll_t sock_oob_poll(struct file *filp,
 			struct oob_poll_wait *wait)
 {
 	struct evl_socket *esk = evl_sk_from_file(filp);
+	__poll_t ret;
 
 	if (esk == NULL)
 		return -EBADFD;
 
-	return esk->proto->oob_poll(esk, wait);
+	ret = esk->proto->oob_poll(esk, wait);
+	if (!list_empty(&esk->errq))
+		ret |= POLLERR;
+
+	return ret;
 }
 
 static int socket_set_rmem(struct evl_socket *esk, int __user *u_val)
@@ -582,7 +1095,9 @@ static int socket_set_rmem(struct evl_socket *esk, int __user *u_val)
 
 	/* Same logic as __sock_set_rcvbuf(). */
 	val = min_t(int, val, INT_MAX / 2);
-	WRITE_ONCE(esk->rmem_max, max_t(int, val * 2, SOCK_MIN_RCVBUF));
+	val = max_t(int, val * 2, SOCK_MIN_RCVBUF);
+	WRITE_ONCE(esk->rmem_batch, get_credit_batch(val));
+	WRITE_ONCE(esk->rmem_max, val);
 
 	return 0;
 }
@@ -596,11 +1111,71 @@ static int socket_set_wmem(struct evl_socket *esk, int __user *u_val)
 		return -EFAULT;
 
 	val = min_t(int, val, INT_MAX / 2);
-	WRITE_ONCE(esk->wmem_max, max_t(int, val * 2, SOCK_MIN_SNDBUF));
+	val = max_t(int, val * 2, SOCK_MIN_SNDBUF);
+	WRITE_ONCE(esk->wmem_batch, get_credit_batch(val));
+	WRITE_ONCE(esk->wmem_max, val);
 
 	return 0;
 }
 
+static int socket_set_busy_poll(struct evl_socket *esk, __u32 __user *u_val)
+{
+	__u32 val;
+	int ret;
+
+	ret = raw_get_user(val, u_val);
+	if (ret)
+		return -EFAULT;
+
+	if (val > EVL_SOCK_MAX_BUSYPOLL)
+		return -EINVAL;
+
+	WRITE_ONCE(esk->busy_poll, ns_to_ktime((u64)val * NSEC_PER_USEC));
+
+	return 0;
+}
+
+static int socket_set_rx_cpu(struct evl_socket *esk, __s32 __user *u_cpu)
+{
+	__s32 cpu;
+	int ret;
+
+	ret = raw_get_user(cpu, u_cpu);
+	if (ret)
+		return -EFAULT;
+
+	if (cpu != -1 && (cpu < 0 || cpu >= nr_cpu_ids ||
+				!cpumask_test_cpu(cpu, &evl_oob_cpus)))
+		return -EINVAL;
+
+	WRITE_ONCE(esk->rx_cpu, cpu);
+
+	return 0;
+}
+
+static int socket_get_stats(struct evl_socket *esk,
+			struct evl_socket_stats __user *u_stats)
+{
+	struct evl_socket_pcpu_stats *p;
+	struct evl_socket_stats stats;
+	int cpu;
+
+	memset(&stats, 0, sizeof(stats));
+
+	for_each_possible_cpu(cpu) {
+		p = per_cpu_ptr(esk->stats, cpu);
+		stats.rx_packets += READ_ONCE(p->rx_packets);
+		stats.rx_bytes += READ_ONCE(p->rx_bytes);
+		stats.rx_drops += READ_ONCE(p->rx_drops);
+		stats.tx_packets += READ_ONCE(p->tx_packets);
+		stats.tx_bytes += READ_ONCE(p->tx_bytes);
+		stats.tx_offloaded += READ_ONCE(p->tx_offloaded);
+		stats.rx_remote += READ_ONCE(p->rx_remote);
+	}
+
+	return copy_to_user(u_stats, &stats, sizeof(stats)) ? -EFAULT : 0;
+}
+
 static int sock_inband_ioctl(struct sock *sk, unsigned int cmd,
 			unsigned long arg)
 {
@@ -628,6 +1203,21 @@ static int sock_inband_ioctl(struct sock *sk, unsigned int cmd,
 		u_val = (typeof(u_val))arg;
 		ret = socket_set_wmem(esk, u_val);
 		break;
+	case EVL_SOCKIOC_SETTXFLAGS:
+		ret = socket_set_txflags(esk, (__u32 __user *)arg);
+		break;
+	case EVL_SOCKIOC_SETRXFLAGS:
+		ret = socket_set_rxflags(esk, (__u32 __user *)arg);
+		break;
+	case EVL_SOCKIOC_SETBUSYPOLL:
+		ret = socket_set_busy_poll(esk, (__u32 __user *)arg);
+		break;
+	case EVL_SOCKIOC_GETSTATS:
+		ret = socket_get_stats(esk, (struct evl_socket_stats __user *)arg);
+		break;
+	case EVL_SOCKIOC_SETRXCPU:
+		ret = socket_set_rx_cpu(esk, (__s32 __user *)arg);
+		break;
 	default:
 		ret = -ENOTTY;
 		if (esk->proto->ioctl)
@@ -9,14 +9,17 @@
 #include <linux/rbtree.h>
 #include <linux/poll.h>
 #include <linux/rbtree.h>
+#include <linux/log2.h>
 #include <evl/sched.h>
 #include <evl/thread.h>
 #include <evl/clock.h>
 #include <evl/observable.h>
 #include <evl/factory.h>
+#include <evl/memory.h>
 
 /* Co-exists with EVL_NOTIFY_MASK bits. */
 #define EVL_NOTIFY_INITIAL	(1 << 31)
+#define EVL_NOTIFY_MAPPED	(1 << 30)
 
 #define EVL_OBSERVABLE_CLONE_FLAGS	\
 	(EVL_CLONE_PUBLIC|EVL_CLONE_OBSERVABLE|EVL_CLONE_UNICAST)
@@ -50,12 +53,63 @@ struct evl_observer {
 	struct rb_node rb;		/* in evl_subscriber.subscriptions */
 	int flags;			/* EVL_NOTIFY_xx */
 	int refs;			/* notification vs unsubscription */
+	u32 rdseq;			/* shared ring cursor */
+	struct evl_notice_ring *ring;	/* mapped observers */
+	u32 ring_size;
+	u32 wrseq;			/* private copy of ring->head */
 	struct evl_notice last_notice;
 	struct evl_notification_record backlog[0];
 };
 
 static const struct file_operations observable_fops;
 
+static bool is_pool_unicast(struct evl_observable *observable)
+{
+	return !!(observable->element.clone_flags & EVL_CLONE_UNICAST);
+}
+
+static inline bool is_shared_observer(struct evl_observer *observer)
+{
+	return !!(observer->flags & EVL_NOTIFY_SHARED);
+}
+
+static inline bool is_mapped_observer(struct evl_observer *observer)
+{
+	return !!(observer->flags & EVL_NOTIFY_MAPPED);
+}
+
+/*
+ * observable->oob_wait.wchan.lock held. Shared and mapped observers
+ * never prevent writers from sending notices.
+ */
+static inline bool is_writable_observer(struct evl_observer *observer)
+{
+	return is_shared_observer(observer) ||
+		is_mapped_observer(observer) ||
+		!list_empty(&observer->free_list);
+}
+
+/* observable->oob_wait.wchan.lock held. */
+static inline bool has_notice(struct evl_observable *observable,
+			struct evl_observer *observer)
+{
+	if (is_shared_observer(observer))
+		return observer->rdseq != observable->ring_head;
+
+	if (is_mapped_observer(observer))
+		return observer->wrseq != READ_ONCE(observer->ring->tail);
+
+	return !list_empty(&observer->pending_list);
+}
+
+static void free_observer(struct evl_observer *observer)
+{
+	if (observer->ring)
+		evl_free_chunk(&evl_shared_heap, observer->ring);
+
+	kfree(observer);
+}
+
 static inline
 int index_observer(struct rb_root *root, struct evl_observer *observer)
 {
@@ -109,15 +163,81 @@ find_observer(struct rb_root *root, fundle_t fundle)
  * in this direction so that observables can go away while subscribers
  * still target them.
  */
+/*
+ * Install the ring shared observers read from, sized according to
+ * the first shared subscription.
+ */
+static int init_shared_ring(struct evl_observable *observable,
+			unsigned int backlog_count) /* in-band */
+{
+	struct evl_notification_record *ring;
+	unsigned long flags;
+	u32 size;
+
+	if (READ_ONCE(observable->ring))
+		return 0;
+
+	if (order_base_2(backlog_count) > 20) /* LART */
+		return -EINVAL;
+
+	size = roundup_pow_of_two(backlog_count);
+	ring = kcalloc(size, sizeof(*ring), GFP_KERNEL);
+	if (ring == NULL)
+		return -ENOMEM;
+
+	raw_spin_lock_irqsave(&observable->oob_wait.wchan.lock, flags);
+
+	if (observable->ring == NULL) {
+		observable->ring_size = size;
+		WRITE_ONCE(observable->ring, ring);
+		ring = NULL;
+	}
+
+	raw_spin_unlock_irqrestore(&observable->oob_wait.wchan.lock, flags);
+
+	kfree(ring);	/* Lost the race. */
+
+	return 0;
+}
+
+/*
+ * The notice ring of a mapped observer lives in the shared heap.
+ * Since user-space may scribble over it, we only rely on our private
+ * copy of the geometry and write index.
+ */
+static int init_mapped_ring(struct evl_observer *observer,
+			unsigned int backlog_count, u32 *ring_offp)
+{
+	struct evl_notice_ring *ring;
+	u32 size;
+
+	if (order_base_2(backlog_count) > 16) /* LART */
+		return -EINVAL;
+
+	size = roundup_pow_of_two(backlog_count);
+	ring = evl_zalloc_chunk(&evl_shared_heap,
+				struct_size(ring, slots, size));
+	if (ring == NULL)
+		return -ENOMEM;
+
+	ring->size = size;
+	observer->ring = ring;
+	observer->ring_size = size;
+	*ring_offp = evl_shared_offset(ring);
+
+	return 0;
+}
+
 static int add_subscription(struct evl_observable *observable,
-			unsigned int backlog_count, int op_flags) /* in-band */
+			unsigned int backlog_count, int op_flags,
+			u32 *ring_offp) /* in-band */
 {
 	struct evl_subscriber *sbr = evl_get_subscriber();
 	struct evl_notification_record *nf;
 	struct evl_observer *observer;
+	unsigned int n, ring_count;
 	size_t backlog_size;
 	unsigned long flags;
-	unsigned int n;
 	int ret;
 
 	inband_context_only();
@@ -128,6 +248,17 @@ static int add_subscription(struct evl_observable *observable,
 	if (op_flags & ~EVL_NOTIFY_MASK)
 		return -EINVAL;
 
+	if (ring_offp) {
+		if (op_flags & (EVL_NOTIFY_SHARED|EVL_NOTIFY_CONFLATE))
+			return -EINVAL;
+		op_flags |= EVL_NOTIFY_MAPPED;
+	}
+
+	if ((op_flags & EVL_NOTIFY_SHARED) &&
+		((op_flags & (EVL_NOTIFY_ONCHANGE|EVL_NOTIFY_CONFLATE)) ||
+			is_pool_unicast(observable)))
+		return -EINVAL;
+
 	if (sbr == NULL) {
 		sbr = kzalloc(sizeof(*sbr), GFP_KERNEL);
 		if (sbr == NULL)
@@ -149,8 +280,19 @@ static int add_subscription(struct evl_observable *observable,
 	/*
 	 * The observer descriptor and its backlog are adjacent in
 	 * memory. The backlog contains notification records, align on
-	 * this element size.
+	 * this element size. Shared and mapped observers have no
+	 * backlog.
 	 */
+	if (op_flags & EVL_NOTIFY_SHARED) {
+		ret = init_shared_ring(observable, backlog_count);
+		if (ret)
+			goto fail_alloc;
+	}
+
+	ring_count = backlog_count;
+	if (op_flags & (EVL_NOTIFY_SHARED|EVL_NOTIFY_MAPPED))
+		backlog_count = 0;
+
 	backlog_size = backlog_count * sizeof(*nf);
 	observer = kzalloc(sizeof(*observer) + backlog_size, GFP_KERNEL);
 	if (observer == NULL) {
@@ -168,6 +310,12 @@ static int add_subscription(struct evl_observable *observable,
 	if (op_flags & EVL_NOTIFY_ONCHANGE)
 		observer->flags |= EVL_NOTIFY_INITIAL;
 
+	if (ring_offp) {
+		ret = init_mapped_ring(observer, ring_count, ring_offp);
+		if (ret)
+			goto fail_ring;
+	}
+
 	raw_spin_lock_irqsave(&sbr->lock, flags);
 	ret = index_observer(&sbr->subscriptions, observer);
 	raw_spin_unlock_irqrestore(&sbr->lock, flags);
@@ -187,8 +335,13 @@ static int add_subscription(struct evl_observable *observable,
 	 * (which undergoes round-robin).
 	 */
 	raw_spin_lock_irqsave(&observable->lock, flags);
-	list_add_tail(&observer->next, &observable->observers);
+	if (op_flags & EVL_NOTIFY_SHARED)
+		list_add_tail(&observer->next, &observable->shared_observers);
+	else
+		list_add_tail(&observer->next, &observable->observers);
 	raw_spin_lock(&observable->oob_wait.wchan.lock);
+	/* Shared observers only get the notices sent from now on. */
+	observer->rdseq = observable->ring_head;
 	observable->writable_observers++;
 	raw_spin_unlock(&observable->oob_wait.wchan.lock);
 	raw_spin_unlock_irqrestore(&observable->lock, flags);
@@ -196,13 +349,16 @@ static int add_subscription(struct evl_observable *observable,
 	evl_schedule();
 	smp_mb();
 	if (waitqueue_active(&observable->inband_wait_w))
-		wake_up(&observable->inband_wait_w);
+		wake_up_poll(&observable->inband_wait_w, EPOLLOUT|EPOLLWRNORM);
 
 	evl_put_element(&observable->element);
 
 	return 0;
 
 dup_subscription:
+	free_observer(observer);
+	goto fail_alloc;
+fail_ring:
 	kfree(observer);
 fail_alloc:
 	evl_put_element(&observable->element);
@@ -225,7 +381,7 @@ static void detach_observer_locked(struct evl_observer *observer,
 
 	raw_spin_lock(&observable->oob_wait.wchan.lock);
 
-	if (!list_empty(&observer->free_list))
+	if (is_writable_observer(observer))
 		decrease_writability(observable);
 
 	raw_spin_unlock(&observable->oob_wait.wchan.lock);
@@ -307,7 +463,7 @@ static int cancel_subscription(struct evl_observable *observable) /* in-band */
 	evl_put_element(&observable->element);
 
 	if (dropped)
-		kfree(observer);
+		free_observer(observer);
 
 	return 0;
 }
@@ -344,27 +500,27 @@ void evl_drop_subscriptions(struct evl_subscriber *sbr)
 			}
 		}
 		if (dropped)
-			kfree(observer);
+			free_observer(observer);
 	}
 
 	kfree(sbr);
 }
 
-static void inband_wake_r_irqwork(struct irq_work *work)
+static void inband_wake_r_wakeup(struct evl_inband_wakeup *wakeup)
 {
 	struct evl_observable *observable;
 
-	observable = container_of(work, struct evl_observable, wake_r_irqwork);
-	wake_up(&observable->inband_wait_r);
+	observable = container_of(wakeup, struct evl_observable, wake_r_wakeup);
+	wake_up_poll(&observable->inband_wait_r, EPOLLIN|EPOLLRDNORM);
 	evl_put_element(&observable->element);
 }
 
-static void inband_wake_w_irqwork(struct irq_work *work)
+static void inband_wake_w_wakeup(struct evl_inband_wakeup *wakeup)
 {
 	struct evl_observable *observable;
 
-	observable = container_of(work, struct evl_observable, wake_w_irqwork);
-	wake_up(&observable->inband_wait_w);
+	observable = container_of(wakeup, struct evl_observable, wake_w_wakeup);
+	wake_up_poll(&observable->inband_wait_w, EPOLLOUT|EPOLLWRNORM);
 	evl_put_element(&observable->element);
 }
 
@@ -386,6 +542,12 @@ void evl_flush_observable(struct evl_observable *observable)
 			decrease_writability(observable);
 	}
 
+	list_for_each_entry_safe(observer, tmp,
+				&observable->shared_observers, next) {
+		list_del_init(&observer->next);
+		decrease_writability(observable);
+	}
+
 	if (evl_wait_active(&observable->oob_wait))
 		evl_flush_wait_locked(&observable->oob_wait, 0);
 
@@ -431,7 +593,7 @@ static void do_flush_work(struct evl_observable *observable)
 		observer = list_get_entry(&observable->flush_list,
 					struct evl_observer, next);
 		raw_spin_unlock_irqrestore(&observable->lock, flags);
-		kfree(observer);
+		free_observer(observer);
 		raw_spin_lock_irqsave(&observable->lock, flags);
 	}
 
@@ -447,6 +609,35 @@ static void inband_flush_irqwork(struct irq_work *work)
 	evl_put_element(&observable->element);
 }
 
+/*
+ * observable->oob_wait.wchan.lock held, irqs off. A bogus tail
+ * value from user-space reads as a full ring.
+ */
+static bool push_mapped_notice(struct evl_observer *observer,
+			const struct evl_notification_record *nfr)
+{
+	struct evl_notice_ring *ring = observer->ring;
+	struct __evl_notification *slot;
+	u32 head = observer->wrseq;
+
+	if (head - READ_ONCE(ring->tail) >= observer->ring_size) {
+		WRITE_ONCE(ring->lost, READ_ONCE(ring->lost) + 1);
+		return false;
+	}
+
+	slot = ring->slots + (head & (observer->ring_size - 1));
+	slot->tag = nfr->tag;
+	slot->serial = nfr->serial;
+	slot->issuer = nfr->issuer;
+	slot->event = nfr->event;
+	slot->date = ktime_to_u_timespec(nfr->date);
+	observer->wrseq = ++head;
+	/* Pairs with the acquire load of head by the observer. */
+	smp_store_release(&ring->head, head);
+
+	return true;
+}
+
 static bool notify_one_observer(struct evl_observable *observable,
 			struct evl_observer *observer,
 			const struct evl_notification_record *tmpl_nfr)
@@ -468,6 +659,32 @@ static bool notify_one_observer(struct evl_observable *observable,
 			goto done;
 	}
 
+	if (is_mapped_observer(observer)) {
+		if (!push_mapped_notice(observer, tmpl_nfr)) {
+			raw_spin_unlock_irqrestore(&observable->oob_wait.wchan.lock, flags);
+			return false;
+		}
+		goto done;
+	}
+
+	/*
+	 * A conflating observer only cares for the latest value per
+	 * tag, overwrite any pending notice with the same tag. The
+	 * pending list is bounded by the number of distinct tags in
+	 * this case, so a linear scan is fine.
+	 */
+	if (observer->flags & EVL_NOTIFY_CONFLATE) {
+		list_for_each_entry(nfr, &observer->pending_list, next) {
+			if (nfr->tag == tmpl_nfr->tag) {
+				nfr->serial = tmpl_nfr->serial;
+				nfr->issuer = tmpl_nfr->issuer;
+				nfr->event = tmpl_nfr->event;
+				nfr->date = tmpl_nfr->date;
+				goto done;
+			}
+		}
+	}
+
 	if (list_empty(&observer->free_list)) {
 		raw_spin_unlock_irqrestore(&observable->oob_wait.wchan.lock, flags);
 		return false;
@@ -533,6 +750,21 @@ out:
 	return do_flush;
 }
 
+/*
+ * observable->lock held, irqs off. Write the notice once for all
+ * shared observers.
+ */
+static void notify_shared(struct evl_observable *observable,
+			const struct evl_notification_record *tmpl_nfr)
+{
+	u32 pos;
+
+	raw_spin_lock(&observable->oob_wait.wchan.lock);
+	pos = observable->ring_head++ & (observable->ring_size - 1);
+	observable->ring[pos] = *tmpl_nfr;
+	raw_spin_unlock(&observable->oob_wait.wchan.lock);
+}
+
 static bool notify_all(struct evl_observable *observable,
 			struct evl_notification_record *nfr,
 			ssize_t *len_r)
@@ -540,17 +772,26 @@ static bool notify_all(struct evl_observable *observable,
 	struct list_head *pos, *nextpos;
 	struct evl_observer *observer;
 	unsigned long flags;
-	bool do_flush;
+	bool do_flush, shared;
 
 	raw_spin_lock_irqsave(&observable->lock, flags);
 
-	if (list_empty(&observable->observers)) {
+	shared = !list_empty(&observable->shared_observers);
+	if (list_empty(&observable->observers) && !shared) {
 		do_flush = false;
 		goto out;
 	}
 
 	nfr->serial = observable->serial_counter++;
 
+	/* Shared observers are served first, at once. */
+	if (shared) {
+		notify_shared(observable, nfr);
+		*len_r += sizeof(struct evl_notice);
+		if (list_empty(&observable->observers))
+			goto done;
+	}
+
 	observer = list_first_entry(&observable->observers,
 				struct evl_observer, next);
 	get_observer(observer);
@@ -586,7 +827,7 @@ static bool notify_all(struct evl_observable *observable,
 			list_add(&observer->next, &observable->flush_list);
 		}
 	}
-
+done:
 	do_flush = !list_empty(&observable->flush_list);
 out:
 	raw_spin_unlock_irqrestore(&observable->lock, flags);
@@ -594,11 +835,6 @@ out:
 	return do_flush;
 }
 
-static bool is_pool_unicast(struct evl_observable *observable)
-{
-	return !!(observable->element.clone_flags & EVL_CLONE_UNICAST);
-}
-
 static bool push_notification(struct evl_observable *observable,
 			const struct evl_notice *ntc,
 			ktime_t date)
@@ -657,14 +893,14 @@ static void wake_up_observers(struct evl_observable *observable)
 	if (waitqueue_active(&observable->inband_wait_r)) {
 		/*
 		 * If running oob, we need to go through the
-		 * wake_irqwork trampoline for waking up in-band
+		 * deferred wake up queue for reaching in-band
 		 * waiters.
 		 */
 		if (running_inband()) {
-			wake_up(&observable->inband_wait_r);
+			wake_up_poll(&observable->inband_wait_r, EPOLLIN|EPOLLRDNORM);
 		} else {
 			evl_get_element(&observable->element);
-			if (!irq_work_queue(&observable->wake_r_irqwork))
+			if (!evl_queue_inband_wakeup(&observable->wake_r_wakeup))
 				evl_put_element(&observable->element);
 		}
 	}
@@ -733,9 +969,73 @@ ssize_t evl_write_observable(struct evl_observable *observable,
 	return ret ?: len;
 }
 
+/* observable->oob_wait.wchan.lock held, irqs off. */
+static struct evl_notification_record *
+get_mapped_notice(struct evl_observer *observer,
+		struct evl_notification_record *buf)
+{
+	struct evl_notice_ring *ring = observer->ring;
+	struct __evl_notification *slot;
+	u32 tail = READ_ONCE(ring->tail);
+
+	/* Resync on a bogus tail value from user-space. */
+	if (unlikely(observer->wrseq - tail > observer->ring_size))
+		tail = observer->wrseq - observer->ring_size;
+
+	slot = ring->slots + (tail & (observer->ring_size - 1));
+	buf->tag = slot->tag;
+	buf->serial = slot->serial;
+	buf->issuer = slot->issuer;
+	buf->event = slot->event;
+	buf->date = timespec64_to_ktime(u_timespec_to_timespec64(slot->date));
+	smp_store_release(&ring->tail, tail + 1);
+
+	return buf;
+}
+
+/*
+ * observable->oob_wait.wchan.lock held, irqs off. Shared and mapped
+ * observers receive a copy of the next notice from their ring into
+ * @buf.
+ */
+static struct evl_notification_record *
+get_notice(struct evl_observable *observable,
+	struct evl_observer *observer,
+	struct evl_notification_record *buf)
+{
+	u32 lag;
+
+	if (is_mapped_observer(observer))
+		return get_mapped_notice(observer, buf);
+
+	if (!is_shared_observer(observer))
+		return list_get_entry(&observer->pending_list,
+				struct evl_notification_record, next);
+
+	/*
+	 * An observer lapped by the writer is told how many notices
+	 * it lost, then resyncs to the oldest notice available.
+	 */
+	lag = observable->ring_head - observer->rdseq;
+	if (unlikely(lag > observable->ring_size)) {
+		buf->tag = EVL_NOTICE_OVERRUN;
+		buf->serial = 0;
+		buf->issuer = 0;
+		buf->event = evl_intval(lag - observable->ring_size);
+		buf->date = evl_ktime_monotonic();
+		observer->rdseq = observable->ring_head - observable->ring_size;
+		return buf;
+	}
+
+	*buf = observable->ring[observer->rdseq++ & (observable->ring_size - 1)];
+
+	return buf;
+}
+
 static struct evl_notification_record *
 pull_from_oob(struct evl_observable *observable,
 	struct evl_observer *observer,
+	struct evl_notification_record *buf,
 	bool wait)
 {
 	struct evl_notification_record *nfr;
@@ -754,7 +1054,7 @@ pull_from_oob(struct evl_observable *observable,
 			nfr = ERR_PTR(-EBADF);
 			goto out;
 		}
-		if (!list_empty(&observer->pending_list))
+		if (has_notice(observable, observer))
 			break;
 		if (!wait) {
 			nfr = ERR_PTR(-EWOULDBLOCK);
@@ -768,8 +1068,7 @@ pull_from_oob(struct evl_observable *observable,
 		raw_spin_lock_irqsave(&observable->oob_wait.wchan.lock, flags);
 	}
 
-	nfr = list_get_entry(&observer->pending_list,
-			struct evl_notification_record, next);
+	nfr = get_notice(observable, observer, buf);
 out:
 	raw_spin_unlock_irqrestore(&observable->oob_wait.wchan.lock, flags);
 
@@ -779,6 +1078,7 @@ out:
 static struct evl_notification_record *
 pull_from_inband(struct evl_observable *observable,
 		struct evl_observer *observer,
+		struct evl_notification_record *buf,
 		bool wait)
 {
 	struct evl_notification_record *nfr = NULL;
@@ -804,9 +1104,8 @@ pull_from_inband(struct evl_observable *observable,
 		if (list_empty(&wq_entry.entry))
 			__add_wait_queue(&observable->inband_wait_r, &wq_entry);
 
-		if (!list_empty(&observer->pending_list)) {
-			nfr = list_get_entry(&observer->pending_list,
-					struct evl_notification_record, next);
+		if (has_notice(observable, observer)) {
+			nfr = get_notice(observable, observer, buf);
 			break;
 		}
 		if (!wait) {
@@ -839,16 +1138,16 @@ static int pull_notification(struct evl_observable *observable,
 			char __user *u_buf,
 			bool wait)
 {
-	struct evl_notification_record *nfr;
+	struct evl_notification_record *nfr, buf;
 	struct __evl_notification nf;
 	bool sigpoll = false;
 	unsigned long flags;
 	int ret;
 
 	if (running_inband())
-		nfr = pull_from_inband(observable, observer, wait);
+		nfr = pull_from_inband(observable, observer, &buf, wait);
 	else
-		nfr = pull_from_oob(observable, observer, wait);
+		nfr = pull_from_oob(observable, observer, &buf, wait);
 
 	if (IS_ERR(nfr))
 		return PTR_ERR(nfr);
@@ -870,7 +1169,20 @@ static int pull_notification(struct evl_observable *observable,
 
 	raw_spin_lock_irqsave(&observable->oob_wait.wchan.lock, flags);
 
-	if (ret) {
+	if (is_mapped_observer(observer)) {
+		if (ret) {
+			WRITE_ONCE(observer->ring->tail,
+				READ_ONCE(observer->ring->tail) - 1);
+			ret = -EFAULT;
+		}
+	} else if (is_shared_observer(observer)) {
+		/* An overrun notice cannot be re-posted, too bad. */
+		if (ret) {
+			if (nfr->tag != EVL_NOTICE_OVERRUN)
+				observer->rdseq--;
+			ret = -EFAULT;
+		}
+	} else if (ret) {
 		list_add(&nfr->next, &observer->pending_list);
 		ret = -EFAULT;
 	} else {
@@ -890,10 +1202,10 @@ static int pull_notification(struct evl_observable *observable,
 		smp_mb();
 		if (waitqueue_active(&observable->inband_wait_w)) {
 			if (running_inband()) {
-				wake_up(&observable->inband_wait_w);
+				wake_up_poll(&observable->inband_wait_w, EPOLLOUT|EPOLLWRNORM);
 			} else {
 				evl_get_element(&observable->element);
-				if (!irq_work_queue(&observable->wake_w_irqwork))
+				if (!evl_queue_inband_wakeup(&observable->wake_w_wakeup))
 					evl_put_element(&observable->element);
 			}
 		}
@@ -968,7 +1280,7 @@ static __poll_t poll_observable(struct evl_observable *observable)
 	raw_spin_lock_irqsave(&observable->oob_wait.wchan.lock, flags);
 
 	/* Only subscribers can inquire about readability. */
-	if (observer && !list_empty(&observer->pending_list))
+	if (observer && has_notice(observable, observer))
 		ret = POLLIN|POLLRDNORM;
 
 	if (observable->writable_observers > 0)
@@ -999,6 +1311,7 @@ __poll_t evl_poll_observable(struct evl_observable *observable,
 long evl_ioctl_observable(struct evl_observable *observable, unsigned int cmd,
 			unsigned long arg)
 {
+	struct evl_mapped_subscription msub, __user *u_msub;
 	struct evl_subscription sub, *u_sub;
 	int ret;
 
@@ -1013,7 +1326,20 @@ long evl_ioctl_observable(struct evl_observable *observable, unsigned int cmd,
 		if (ret)
 			return -EFAULT;
 		ret = add_subscription(observable,
-				sub.backlog_count, sub.flags);
+				sub.backlog_count, sub.flags, NULL);
+		break;
+	case EVL_OBSIOC_SUBSCRIBE_MAPPED:
+		/* Same as above, with a notice ring in the shared heap. */
+		u_msub = (typeof(u_msub))arg;
+		ret = raw_copy_from_user(&msub, u_msub, sizeof(msub));
+		if (ret)
+			return -EFAULT;
+		ret = add_subscription(observable, msub.backlog_count,
+				msub.flags, &msub.ring_offset);
+		if (!ret && raw_copy_to_user(&u_msub->ring_offset,
+					&msub.ring_offset,
+					sizeof(msub.ring_offset)))
+			ret = -EFAULT;
 		break;
 	case EVL_OBSIOC_UNSUBSCRIBE:
 		/* Likewise for unsubscribing from @observable. */
@@ -1120,11 +1446,12 @@ struct evl_observable *evl_alloc_observable(const char __user *u_name,
 
 	INIT_LIST_HEAD(&observable->observers);
 	INIT_LIST_HEAD(&observable->flush_list);
+	INIT_LIST_HEAD(&observable->shared_observers);
 	evl_init_wait(&observable->oob_wait, &evl_mono_clock, EVL_WAIT_PRIO);
 	init_waitqueue_head(&observable->inband_wait_r);
 	init_waitqueue_head(&observable->inband_wait_w);
-	init_irq_work(&observable->wake_r_irqwork, inband_wake_r_irqwork);
-	init_irq_work(&observable->wake_w_irqwork, inband_wake_w_irqwork);
+	evl_init_inband_wakeup(&observable->wake_r_wakeup, inband_wake_r_wakeup);
+	evl_init_inband_wakeup(&observable->wake_w_wakeup, inband_wake_w_wakeup);
 	init_irq_work(&observable->flush_irqwork, inband_flush_irqwork);
 	evl_init_poll_head(&observable->poll_head);
 	raw_spin_lock_init(&observable->lock);
@@ -1157,6 +1484,7 @@ static void observable_factory_dispose(struct evl_element *e)
 	evl_destroy_wait(&observable->oob_wait);
 	evl_unindex_factory_element(&observable->element);
 	evl_destroy_element(&observable->element);
+	kfree(observable->ring);
 	kfree_rcu(observable, element.rcu);
 }
 
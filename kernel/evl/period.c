@@ -0,0 +1,253 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <evl/thread.h>
+#include <evl/sched.h>
+#include <evl/clock.h>
+#include <evl/list.h>
+#include <evl/period.h>
+#include <trace/events/evl.h>
+
+/*
+ * Threads from a period group which run on the same CPU share a
+ * single periodic timer, which releases all of them in priority
+ * order at each tick. This saves a timer interrupt per periodic
+ * thread when many of them share the same timeline, as compared
+ * to evl_set_period(). Each member keeps track of the next release
+ * it expects, so that overruns are accounted per thread.
+ */
+
+static void release_handler(struct evl_timer *timer) /* oob stage stalled */
+{
+	struct evl_period_slot *slot;
+	struct evl_thread *thread, *tmp;
+
+	slot = container_of(timer, struct evl_period_slot, timer);
+
+	raw_spin_lock(&slot->lock);
+
+	/* Ticks missed due to overruns are skipped. */
+	slot->released = timer->periodic_ticks + 1;
+
+	list_for_each_entry_safe(thread, tmp, &slot->waiters, pgroup.next) {
+		list_del_init(&thread->pgroup.next);
+		evl_wakeup_thread(thread, EVL_T_WAIT, EVL_T_TIMEO);
+	}
+
+	raw_spin_unlock(&slot->lock);
+}
+
+/**
+ * evl_init_period_group - initialize a period group
+ * @pg: the group descriptor
+ * @clock: the clock timing the releases
+ * @idate: the date of the first release, or EVL_INFINITE to start
+ * one period from now
+ * @period: the release period
+ */
+int evl_init_period_group(struct evl_period_group *pg,
+			struct evl_clock *clock,
+			ktime_t idate, ktime_t period)
+{
+	struct evl_period_slot *slot;
+	int cpu;
+
+	inband_context_only();
+
+	if (period < evl_get_clock_gravity(clock, kernel))
+		return -EINVAL;
+
+	pg->slots = alloc_percpu(struct evl_period_slot);
+	if (pg->slots == NULL)
+		return -ENOMEM;
+
+	if (timeout_infinite(idate))
+		idate = ktime_add(evl_read_clock(clock), period);
+
+	pg->clock = clock;
+	pg->idate = idate;
+	pg->period = period;
+
+	for_each_possible_cpu(cpu) {
+		slot = per_cpu_ptr(pg->slots, cpu);
+		raw_spin_lock_init(&slot->lock);
+		INIT_LIST_HEAD(&slot->waiters);
+		slot->released = 0;
+		slot->nr_members = 0;
+		slot->group = pg;
+		if (!is_evl_cpu(cpu))
+			continue;
+		evl_init_timer_on_rq(&slot->timer, clock, release_handler,
+				evl_cpu_rq(cpu), EVL_TIMER_KGRAVITY);
+		evl_set_timer_name(&slot->timer, "[period-group]");
+		evl_set_timer_class(&slot->timer, EVL_TIMER_CLASS_PERIODIC);
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(evl_init_period_group);
+
+/**
+ * evl_destroy_period_group - destroy a period group
+ * @pg: the group descriptor
+ *
+ * All members must have left the group.
+ */
+void evl_destroy_period_group(struct evl_period_group *pg)
+{
+	struct evl_period_slot *slot;
+	int cpu;
+
+	inband_context_only();
+
+	for_each_possible_cpu(cpu) {
+		slot = per_cpu_ptr(pg->slots, cpu);
+		EVL_WARN_ON(CORE, slot->nr_members > 0);
+		if (is_evl_cpu(cpu))
+			evl_destroy_timer(&slot->timer);
+	}
+
+	free_percpu(pg->slots);
+}
+EXPORT_SYMBOL_GPL(evl_destroy_period_group);
+
+/* slot->lock held, irqs off. */
+static void start_slot(struct evl_period_slot *slot)
+{
+	struct evl_period_group *pg = slot->group;
+	ktime_t now, date = pg->idate;
+	u64 n;
+
+	/* Resume on the group timeline. */
+	now = evl_read_clock(pg->clock);
+	if (date < now) {
+		n = div64_u64(ktime_sub(now, date), pg->period) + 1;
+		date = ktime_add_ns(date, n * ktime_to_ns(pg->period));
+	}
+
+	slot->released = 0;
+	evl_start_timer(&slot->timer, date, pg->period);
+}
+
+/**
+ * evl_join_period_group - join a period group
+ * @pg: the group to join
+ *
+ * The current thread joins @pg, being released by the timer of its
+ * current CPU from now on. The first release the caller may wait
+ * for with evl_wait_group_period() is the next one of the group.
+ */
+int evl_join_period_group(struct evl_period_group *pg)
+{
+	struct evl_thread *curr = evl_current();
+	struct evl_period_slot *slot;
+	unsigned long flags;
+	int cpu;
+
+	if (curr == NULL)
+		return -EPERM;
+
+	if (curr->pgroup.slot)
+		return -EBUSY;
+
+	flags = hard_local_irq_save();
+	cpu = evl_rq_cpu(evl_thread_rq(curr));
+	slot = per_cpu_ptr(pg->slots, cpu);
+	raw_spin_lock(&slot->lock);
+	if (slot->nr_members++ == 0)
+		start_slot(slot);
+	curr->pgroup.slot = slot;
+	curr->pgroup.release = slot->released + 1;
+	evl_mark_release(&curr->stat.resptime, 0);
+	raw_spin_unlock(&slot->lock);
+	hard_local_irq_restore(flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(evl_join_period_group);
+
+/**
+ * evl_leave_period_group - leave a period group
+ * @thread: the member leaving its group
+ *
+ * @thread is either the current thread, or an exiting one.
+ */
+void evl_leave_period_group(struct evl_thread *thread)
+{
+	struct evl_period_slot *slot = thread->pgroup.slot;
+	unsigned long flags;
+
+	if (slot == NULL)
+		return;
+
+	raw_spin_lock_irqsave(&slot->lock, flags);
+	list_del_init(&thread->pgroup.next);
+	if (--slot->nr_members == 0)
+		evl_stop_timer(&slot->timer);
+	thread->pgroup.slot = NULL;
+	raw_spin_unlock_irqrestore(&slot->lock, flags);
+}
+EXPORT_SYMBOL_GPL(evl_leave_period_group);
+
+/**
+ * evl_wait_group_period - wait for the next release of the group
+ * @overruns_r: set to the count of releases missed on overrun
+ *
+ * Same as evl_wait_period(), for a member of a period group.
+ */
+int evl_wait_group_period(unsigned long *overruns_r)
+{
+	struct evl_thread *curr = evl_current();
+	struct evl_period_slot *slot;
+	unsigned long overruns, flags;
+	int ret = 0;
+
+	slot = curr->pgroup.slot;
+	if (unlikely(slot == NULL))
+		return -EAGAIN;
+
+	trace_evl_thread_wait_period(curr);
+
+	raw_spin_lock_irqsave(&slot->lock, flags);
+
+	evl_account_resptime(&curr->stat.resptime,
+			evl_read_clock(slot->group->clock),
+			slot->group->period);
+
+	if (slot->released < curr->pgroup.release) {
+		list_add_priff(curr, &slot->waiters, wprio, pgroup.next);
+		evl_sleep_on(EVL_INFINITE, EVL_REL, slot->group->clock,
+			NULL); /* EVL_T_WAIT */
+		raw_spin_unlock_irqrestore(&slot->lock, flags);
+		evl_schedule();
+		raw_spin_lock_irqsave(&slot->lock, flags);
+		if (unlikely(curr->info & EVL_T_BREAK)) {
+			list_del_init(&curr->pgroup.next);
+			ret = -EINTR;
+			goto out;
+		}
+	}
+
+	overruns = slot->released - curr->pgroup.release;
+	curr->pgroup.release = slot->released + 1;
+	/* Release #1 happens at the start date of the timer. */
+	evl_mark_release(&curr->stat.resptime,
+			ktime_add_ns(slot->timer.start_date,
+				(slot->released - 1) *
+				ktime_to_ns(slot->group->period)));
+	if (overruns) {
+		evl_count_overruns(&curr->stat.resptime, overruns);
+		if (likely(overruns_r != NULL))
+			*overruns_r = overruns;
+		trace_evl_thread_missed_period(curr);
+		ret = -ETIMEDOUT;
+	}
+out:
+	raw_spin_unlock_irqrestore(&slot->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(evl_wait_group_period);
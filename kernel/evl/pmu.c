@@ -0,0 +1,89 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/perf_event.h>
+#include <evl/control.h>
+#include <evl/sched.h>
+#include <evl/stat.h>
+
+/*
+ * Per-CPU hardware counters sampled on every context switch by
+ * __evl_schedule(), the delta since the previous switch is charged
+ * to the outgoing thread. Counters are pinned kernel events created
+ * once the PMU drivers are up, which then stay in place.
+ *
+ * We cannot go through perf_event_read_local() from the oob stage,
+ * since it plays with the in-band interrupt state. Instead we call
+ * the PMU read handler directly, which has to be NMI-safe already,
+ * for an event we know is bound to the current CPU.
+ */
+
+static uint pmu_events_arg = (1U << EVL_PMU_NR) - 1;
+module_param_named(pmu_events, pmu_events_arg, uint, 0444);
+
+static const u64 pmu_configs[EVL_PMU_NR] = {
+	[EVL_PMU_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+	[EVL_PMU_INSNS] = PERF_COUNT_HW_INSTRUCTIONS,
+	[EVL_PMU_LLC_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+	[EVL_PMU_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+void evl_pmu_switch(struct evl_rq *rq, struct evl_thread *prev) /* hard irqs off */
+{
+	struct perf_event *event;
+	u64 value;
+	int n;
+
+	for (n = 0; n < EVL_PMU_NR; n++) {
+		event = READ_ONCE(rq->pmu.events[n]);
+		if (event == NULL)
+			continue;
+
+		if (event->state == PERF_EVENT_STATE_ACTIVE)
+			event->pmu->read(event);
+
+		value = local64_read(&event->count);
+		prev->stat.pmu.total[n] += value - rq->pmu.last[n];
+		rq->pmu.last[n] = value;
+	}
+}
+
+static int __init evl_init_pmu(void)
+{
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HARDWARE,
+		.size = sizeof(attr),
+		.pinned = 1,
+	};
+	struct perf_event *event;
+	struct evl_rq *rq;
+	int cpu, n;
+
+	if (!evl_is_enabled())
+		return 0;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		rq = evl_cpu_rq(cpu);
+		for (n = 0; n < EVL_PMU_NR; n++) {
+			if (!(pmu_events_arg & BIT(n)))
+				continue;
+			attr.config = pmu_configs[n];
+			event = perf_event_create_kernel_counter(&attr, cpu,
+							NULL, NULL, NULL);
+			if (IS_ERR(event)) {
+				printk(EVL_WARNING
+				       "cannot sample PMU event #%d on CPU%d (%ld)\n",
+				       n, cpu, PTR_ERR(event));
+				continue;
+			}
+			WRITE_ONCE(rq->pmu.events[n], event);
+		}
+	}
+
+	return 0;
+}
+late_initcall(evl_init_pmu);
@@ -11,16 +11,24 @@
 #include <linux/poll.h>
 #include <linux/module.h>
 #include <linux/spinlock.h>
+#include <linux/log2.h>
 #include <evl/file.h>
 #include <evl/thread.h>
 #include <evl/memory.h>
+#include <evl/slab.h>
 #include <evl/poll.h>
 #include <evl/sched.h>
 #include <evl/flag.h>
 #include <evl/mutex.h>
 #include <evl/lock.h>
+#include <evl/clock.h>
 #include <evl/uaccess.h>
 
+struct poll_ring_watchpoint {
+	struct evl_poll_watchpoint wpt;
+	struct poll_group *group;
+};
+
 struct poll_group {
 	struct rb_root item_index;  /* struct poll_item */
 	struct list_head item_list; /* struct poll_item */
@@ -30,18 +38,35 @@ struct poll_group {
 	struct evl_kmutex item_lock;
 	int nr_items;
 	unsigned int generation;
+	/* Completion ring mode, ring_table guarded by item_lock. */
+	struct evl_poll_ring *ring;
+	u32 ring_size;
+	u32 ring_head;		/* private copy, guarded by wait_lock. */
+	struct evl_flag ring_flag;
+	struct poll_ring_watchpoint *ring_table;
+	int ring_nr;
 };
 
 struct poll_item {
 	unsigned int fd;
 	int events_polled;
+	int modifiers;
 	union evl_value pollval;
 	struct rb_node rb;	    /* in group->item_index */
 	struct list_head next;	    /* in group->item_list */
 };
 
+DEFINE_EVL_SLAB(poll_item_slab, struct poll_item, NULL);
+
+/*
+ * Watchpoints receiving events while their owner sleeps are queued
+ * to the waiter's ready list, so that only those are looked at upon
+ * wakeup. The waiter lives on the sleeper's stack, watchpoints are
+ * all disconnected by clear_wait() before it goes away.
+ */
 struct poll_waiter {
 	struct evl_flag flag;
+	struct llist_head ready_list;  /* struct evl_poll_watchpoint */
 	struct list_head next;
 };
 
@@ -56,12 +81,18 @@ static const struct file_operations poll_fops;
 	     __poco++)								\
 		if ((__poco)->head)
 
-/* head->lock held, irqs off */
+/*
+ * head->lock held, irqs off. Watchpoints are queued by decreasing
+ * priority of their waiter, FIFO among equals, so that an event goes
+ * to the most urgent waiter first. Persistent watchpoints have no
+ * waiter, they come first.
+ */
 static void connect_watchpoint(struct oob_poll_wait *wait,
 			struct evl_poll_head *head,
-			void (*unwatch)(struct evl_poll_head *head))
+			void (*unwatch)(struct evl_poll_head *head),
+			int prio)
 {
-	struct evl_poll_connector *poco;
+	struct evl_poll_connector *poco, *pos;
 	int i;
 
 	for (i = 0; i < EVL_POLL_NR_CONNECTORS; i++) {
@@ -70,7 +101,11 @@ static void connect_watchpoint(struct oob_poll_wait *wait,
 			poco->head = head;
 			poco->unwatch = unwatch;
 			poco->events_received = 0;
-			list_add(&poco->next, &head->watchpoints);
+			poco->prio = prio;
+			list_for_each_entry(pos, &head->watchpoints, next)
+				if (pos->prio < prio)
+					break;
+			list_add_tail(&poco->next, &pos->next);
 			poco->index = i;
 			return;
 		}
@@ -87,49 +122,73 @@ void evl_poll_watch(struct evl_poll_head *head,
 		struct oob_poll_wait *wait,
 		void (*unwatch)(struct evl_poll_head *head))
 {
+	struct evl_thread *curr = evl_current();
 	struct evl_poll_watchpoint *wpt;
 	unsigned long flags;
+	int prio = INT_MAX;
 
 	wpt = container_of(wait, struct evl_poll_watchpoint, wait);
+	if (!wpt->signal && curr)
+		prio = curr->wprio;
+
 	/* Connect to a driver's poll head. */
 	raw_spin_lock_irqsave(&head->lock, flags);
-	connect_watchpoint(wait, head, unwatch);
+	connect_watchpoint(wait, head, unwatch, prio);
 	raw_spin_unlock_irqrestore(&head->lock, flags);
 }
 EXPORT_SYMBOL_GPL(evl_poll_watch);
 
-/*
- * __evl_signal_poll_events - wake up threads polling for events.
- *
- * @head	poll head waiters sleep on
- * @events	incoming events to signal
- *
- * A single waiter is unblocked for any distinct event signaled on
- * entry.
- */
-void __evl_signal_poll_events(struct evl_poll_head *head,
-			int events)
+/* Lock-free, may be called concurrently for distinct poll heads. */
+static inline void queue_ready(struct evl_poll_watchpoint *wpt)
+{
+	if (!atomic_xchg(&wpt->queued, 1))
+		llist_add(&wpt->ready, wpt->ready_list);
+}
+
+/* head->lock held, irqs off. */
+static void signal_watchpoints(struct evl_poll_head *head, int events)
 {
 	struct evl_poll_watchpoint *wpt;
 	struct evl_poll_connector *poco;
-	unsigned long flags;
 	int ready;
 
-	raw_spin_lock_irqsave(&head->lock, flags);
-
 	list_for_each_entry(poco, &head->watchpoints, next) {
 		wpt = container_of(poco, struct evl_poll_watchpoint,
 				wait.connectors[poco->index]);
 		ready = events & wpt->events_polled;
 		if (ready) {
 			poco->events_received |= ready;
-			evl_raise_flag_nosched(wpt->flag);
+			if (wpt->signal) {
+				wpt->signal(wpt, ready);
+			} else {
+				queue_ready(wpt);
+				evl_raise_flag_nosched(wpt->flag);
+			}
 			events &= ~ready;
 			if (!events)
 				break;
 		}
 	}
+}
+
+/*
+ * __evl_signal_poll_events - wake up threads polling for events.
+ *
+ * @head	poll head waiters sleep on
+ * @events	incoming events to signal
+ *
+ * A single waiter is unblocked for any distinct event signaled on
+ * entry, the one with the highest priority. Events this waiter does
+ * not pick are handed over to the next one when it stops waiting
+ * (see clear_wait()).
+ */
+void __evl_signal_poll_events(struct evl_poll_head *head,
+			int events)
+{
+	unsigned long flags;
 
+	raw_spin_lock_irqsave(&head->lock, flags);
+	signal_watchpoints(head, events);
 	raw_spin_unlock_irqrestore(&head->lock, flags);
 }
 EXPORT_SYMBOL_GPL(__evl_signal_poll_events);
@@ -228,13 +287,14 @@ static int add_item(struct file *filp, struct poll_group *group,
 	struct evl_file *efilp;
 	int ret, events;
 
-	item = evl_alloc(sizeof(*item));
+	item = evl_slab_alloc(&poll_item_slab);
 	if (item == NULL)
 		return -ENOMEM;
 
 	item->fd = creq->fd;
-	events = creq->events & ~POLLNVAL;
+	events = creq->events & ~(POLLNVAL|EVL_POLL_MODIFIERS);
 	item->events_polled = events | POLLERR | POLLHUP;
+	item->modifiers = creq->events & EVL_POLL_MODIFIERS;
 	item->pollval = creq->pollval;
 
 	efilp = evl_get_file(creq->fd);
@@ -267,7 +327,7 @@ fail_add:
 	evl_unlock_kmutex(&group->item_lock);
 	evl_put_file(efilp);
 fail_get:
-	evl_free(item);
+	evl_slab_free(&poll_item_slab, item);
 
 	return ret;
 }
@@ -312,17 +372,18 @@ static int del_item(struct poll_group *group,
 
 	evl_unlock_kmutex(&group->item_lock);
 
-	evl_free(item);
+	evl_slab_free(&poll_item_slab, item);
 
 	return 0;
 }
 
-/* fdt_lock held, irqs off. */
+/* fd bucket lock held, irqs off. */
 void evl_drop_watchpoints(struct list_head *drop_list)
 {
 	struct evl_poll_watchpoint *wpt;
 	struct evl_poll_connector *poco;
-	struct evl_poll_node *node;
+	struct evl_poll_node *node, *tmp;
+	struct evl_poll_head *head;
 
 	/*
 	 * Drop the watchpoints attached to a file descriptor which is
@@ -335,18 +396,31 @@ void evl_drop_watchpoints(struct list_head *drop_list)
 	 *
 	 * NOTE: poco->next is kept untouched, only the thread which
 	 * is sleeping on a watchpoint is allowed to alter such
-	 * information for any of the related connectors.
+	 * information for any of the related connectors. Persistent
+	 * watchpoints have no such owner, so we disconnect them
+	 * entirely from the poll heads and the fd.
 	 */
-	list_for_each_entry(node, drop_list, next) {
+	list_for_each_entry_safe(node, tmp, drop_list, next) {
 		wpt = container_of(node, struct evl_poll_watchpoint, node);
 		for_each_poll_connector(poco, wpt) {
-			raw_spin_lock(&poco->head->lock);
+			head = poco->head;
+			raw_spin_lock(&head->lock);
 			poco->events_received |= POLLNVAL;
 			if (poco->unwatch) /* handler must NOT reschedule. */
-				poco->unwatch(poco->head);
-			raw_spin_unlock(&poco->head->lock);
+				poco->unwatch(head);
+			if (wpt->signal) {
+				list_del_init(&poco->next);
+				poco->head = NULL;
+			}
+			raw_spin_unlock(&head->lock);
+		}
+		if (wpt->signal) {
+			list_del_init(&node->next);
+			wpt->signal(wpt, POLLNVAL);
+		} else {
+			queue_ready(wpt);
+			evl_raise_flag_nosched(wpt->flag);
 		}
-		evl_raise_flag_nosched(wpt->flag);
 		wpt->filp = NULL;
 	}
 }
@@ -358,7 +432,7 @@ int mod_item(struct poll_group *group,
 	struct poll_item *item;
 	int events;
 
-	events = creq->events & ~POLLNVAL;
+	events = creq->events & ~(POLLNVAL|EVL_POLL_MODIFIERS);
 
 	evl_lock_kmutex(&group->item_lock);
 
@@ -369,6 +443,7 @@ int mod_item(struct poll_group *group,
 	}
 
 	item->events_polled = events | POLLERR | POLLHUP;
+	item->modifiers = creq->events & EVL_POLL_MODIFIERS;
 	item->pollval = creq->pollval;
 	new_generation(group);
 
@@ -377,12 +452,252 @@ int mod_item(struct poll_group *group,
 	return 0;
 }
 
+/* Hard irqs may be off. */
+static void append_ring_event(struct poll_group *group,
+			struct evl_poll_watchpoint *wpt, int events)
+{
+	struct evl_poll_ring *ring = group->ring;
+	struct evl_poll_event *ev;
+	unsigned long flags;
+	u32 head;
+
+	raw_spin_lock_irqsave(&group->wait_lock, flags);
+
+	/* A bogus tail value from user-space reads as a full ring. */
+	head = group->ring_head;
+	if (head - READ_ONCE(ring->tail) >= group->ring_size) {
+		WRITE_ONCE(ring->lost, READ_ONCE(ring->lost) + 1);
+	} else {
+		ev = ring->events + (head & (group->ring_size - 1));
+		ev->fd = wpt->fd;
+		ev->events = events;
+		ev->pollval = wpt->pollval;
+		group->ring_head = ++head;
+		/* Pairs with the acquire load of head by the consumer. */
+		smp_store_release(&ring->head, head);
+	}
+
+	raw_spin_unlock_irqrestore(&group->wait_lock, flags);
+
+	evl_raise_flag_nosched(&group->ring_flag);
+}
+
+/* head->lock or fd bucket lock held, hard irqs off. */
+static void signal_ring(struct evl_poll_watchpoint *wpt, int events)
+{
+	struct poll_ring_watchpoint *rwpt;
+
+	rwpt = container_of(wpt, struct poll_ring_watchpoint, wpt);
+	append_ring_event(rwpt->group, wpt, events);
+
+	/* A one-shot item stays quiet until the group is updated. */
+	if (wpt->modifiers & EVL_POLLONESHOT)
+		wpt->events_polled = 0;
+}
+
+/*
+ * group->item_lock held. Stop watching the items, reflecting the
+ * state of the one-shot items which fired back to the group.
+ */
+static void disarm_ring(struct poll_group *group)
+{
+	struct evl_poll_watchpoint *wpt;
+	struct evl_poll_connector *poco;
+	struct poll_item *item;
+	unsigned long flags;
+	int n;
+
+	for (n = 0; n < group->ring_nr; n++) {
+		wpt = &group->ring_table[n].wpt;
+		/*
+		 * Unregistering from the fd first serializes with
+		 * evl_drop_watchpoints(), which may have disconnected
+		 * the watchpoint already.
+		 */
+		evl_ignore_fd(&wpt->node);
+		for_each_poll_connector(poco, wpt) {
+			raw_spin_lock_irqsave(&poco->head->lock, flags);
+			list_del(&poco->next);
+			if (!(poco->events_received & POLLNVAL) && poco->unwatch)
+				poco->unwatch(poco->head);
+			raw_spin_unlock_irqrestore(&poco->head->lock, flags);
+		}
+		if ((wpt->modifiers & EVL_POLLONESHOT) && !wpt->events_polled) {
+			item = lookup_item(&group->item_index, wpt->fd);
+			if (item)
+				item->events_polled = 0;
+		}
+	}
+
+	group->ring_nr = 0;
+}
+
+/* group->item_lock held. Watch all the items continuously. */
+static int arm_ring(struct poll_group *group)
+{
+	struct poll_ring_watchpoint *table;
+	struct evl_poll_watchpoint *wpt;
+	struct evl_poll_connector *poco;
+	struct poll_item *item;
+	struct evl_file *efilp;
+	struct file *filp;
+	int ready;
+
+	if (group->ring_table)
+		evl_free(group->ring_table);
+
+	group->ring_table = NULL;
+	if (group->nr_items == 0)
+		return 0;
+
+	table = evl_alloc(sizeof(*table) * group->nr_items);
+	if (table == NULL)
+		return -ENOMEM;
+
+	group->ring_table = table;
+
+	list_for_each_entry(item, &group->item_list, next) {
+		table->group = group;
+		wpt = &table->wpt;
+		wpt->fd = item->fd;
+		wpt->events_polled = item->events_polled;
+		wpt->modifiers = item->modifiers;
+		wpt->pollval = item->pollval;
+		wpt->flag = NULL;
+		wpt->ready_list = NULL;
+		wpt->signal = signal_ring;
+		wpt->filp = NULL;
+		INIT_LIST_HEAD(&wpt->node.next);
+		for_each_poll_connector(poco, wpt) {
+			poco->head = NULL;
+			INIT_LIST_HEAD(&poco->next);
+		}
+		group->ring_nr++;
+		table++;
+		/* If oob_poll() is absent, default to all events ready. */
+		ready = POLLIN|POLLOUT|POLLRDNORM|POLLWRNORM;
+		efilp = evl_watch_fd(wpt->fd, &wpt->node);
+		if (efilp == NULL) {
+			ready = POLLNVAL;
+		} else {
+			filp = efilp->filp;
+			wpt->filp = filp;
+			if (filp->f_op->oob_poll)
+				ready = filp->f_op->oob_poll(filp, &wpt->wait);
+			evl_put_file(efilp);
+		}
+		ready &= wpt->events_polled | POLLNVAL;
+		if (ready)
+			signal_ring(wpt, ready);
+	}
+
+	evl_schedule();
+
+	return 0;
+}
+
+static int update_ring(struct poll_group *group, bool arm)
+{
+	int ret = 0;
+
+	evl_lock_kmutex(&group->item_lock);
+
+	if (group->ring) {
+		if (arm)
+			ret = arm_ring(group);
+		else
+			disarm_ring(group);
+	}
+
+	evl_unlock_kmutex(&group->item_lock);
+
+	return ret;
+}
+
+static int setup_ring(struct poll_group *group,
+		struct evl_poll_ringreq *rreq)
+{
+	struct evl_poll_ring *ring;
+	u32 size;
+	int ret;
+
+	if (rreq->nr_events == 0 || order_base_2(rreq->nr_events) > 16)
+		return -EINVAL;
+
+	size = roundup_pow_of_two(rreq->nr_events);
+	ring = evl_zalloc_chunk(&evl_shared_heap,
+				struct_size(ring, events, size));
+	if (ring == NULL)
+		return -ENOMEM;
+
+	ring->size = size;
+
+	evl_lock_kmutex(&group->item_lock);
+
+	if (group->ring) {
+		evl_unlock_kmutex(&group->item_lock);
+		evl_free_chunk(&evl_shared_heap, ring);
+		return -EBUSY;
+	}
+
+	group->ring_size = size;
+	group->ring_head = 0;
+	group->ring = ring;
+	ret = arm_ring(group);
+	if (ret) {
+		group->ring = NULL;
+		evl_unlock_kmutex(&group->item_lock);
+		evl_free_chunk(&evl_shared_heap, ring);
+		return ret;
+	}
+
+	evl_unlock_kmutex(&group->item_lock);
+
+	rreq->ring_offset = evl_shared_offset(ring);
+
+	return 0;
+}
+
+static int wait_ring(struct file *filp, struct poll_group *group,
+		struct timespec64 *ts64)
+{
+	enum evl_tmode tmode;
+	ktime_t timeout;
+
+	if (group->ring == NULL)
+		return -EINVAL;
+
+	/*
+	 * A stale raise of the ring flag causes a spurious wakeup,
+	 * the consumer has to check the ring again anyway.
+	 */
+	if (READ_ONCE(group->ring_head) != READ_ONCE(group->ring->tail))
+		return 0;
+
+	if (filp->f_flags & O_NONBLOCK)
+		return -EAGAIN;
+
+	timeout = timespec64_to_ktime(*ts64);
+	tmode = timeout ? EVL_ABS : EVL_REL;
+
+	return evl_wait_flag_timeout(&group->ring_flag, timeout, tmode);
+}
+
 static inline
 int setup_item(struct file *filp, struct poll_group *group,
 	struct evl_poll_ctlreq *creq)
 {
 	int ret;
 
+	/*
+	 * In ring mode, stop watching while the group is updated,
+	 * then re-arm. The events signaled meanwhile are not lost
+	 * for ready items, since arming probes them.
+	 */
+	ret = update_ring(group, false);
+	if (ret)
+		return ret;
+
 	switch (creq->action) {
 	case EVL_POLL_CTLADD:
 		ret = add_item(filp, group, creq);
@@ -397,18 +712,111 @@ int setup_item(struct file *filp, struct poll_group *group,
 		ret = -EINVAL;
 	}
 
-	return ret;
+	return update_ring(group, true) ?: ret;
+}
+
+/*
+ * Copy an event to the user set. With @read_timers set, ready
+ * timerfds are read on the fly in addition, so that the caller
+ * gets all the tick counts in a single syscall.
+ */
+static int put_event(void __user **u_setp, struct evl_poll_watchpoint *wpt,
+		int ready, bool read_timers)
+{
+	struct evl_poll_timer_event tev;
+	struct evl_poll_event ev;
+	struct evl_file *efilp;
+	ktime_t expiry = 0;
+	u64 ticks = 0;
+
+	if (!read_timers) {
+		ev.fd = wpt->fd;
+		ev.pollval = wpt->pollval;
+		ev.events = ready;
+		if (raw_copy_to_user(*u_setp, &ev, sizeof(ev)))
+			return -EFAULT;
+		*u_setp += sizeof(ev);
+		return 0;
+	}
+
+	if (ready & POLLIN) {
+		efilp = evl_get_file(wpt->fd);
+		if (efilp) {
+			/* Non-timerfds are reported with no tick. */
+			evl_read_timerfd(efilp->filp, &ticks, &expiry);
+			evl_put_file(efilp);
+		}
+	}
+
+	tev.fd = wpt->fd;
+	tev.events = ready;
+	tev.pollval = wpt->pollval;
+	tev.ticks = ticks;
+	tev.expiry = ktime_to_u_timespec(expiry);
+	if (raw_copy_to_user(*u_setp, &tev, sizeof(tev)))
+		return -EFAULT;
+
+	*u_setp += sizeof(tev);
+
+	return 0;
+}
+
+/*
+ * Disable a one-shot item after it reported an event, unless it was
+ * updated in the meantime. Our own table is updated in the same way,
+ * so that only other waiters have to resync.
+ */
+static void disarm_item(struct poll_group *group,
+			struct evl_poll_watchpoint *wpt)
+{
+	struct evl_thread *curr = evl_current();
+	struct poll_item *item;
+
+	evl_lock_kmutex(&group->item_lock);
+
+	if (curr->poll_context.generation == group->generation) {
+		item = lookup_item(&group->item_index, wpt->fd);
+		if (item) {
+			item->events_polled = 0;
+			wpt->events_polled = 0;
+			new_generation(group);
+			curr->poll_context.generation = group->generation;
+		}
+	}
+
+	evl_unlock_kmutex(&group->item_lock);
+}
+
+static int report_event(struct poll_group *group,
+			void __user **u_setp, struct evl_poll_watchpoint *wpt,
+			int ready, bool read_timers)
+{
+	int ret;
+
+	ret = put_event(u_setp, wpt, ready, read_timers);
+	if (ret)
+		return ret;
+
+	wpt->events_reported |= ready;
+
+	if (wpt->modifiers & EVL_POLLONESHOT)
+		disarm_item(group, wpt);
+
+	return 0;
 }
 
+/*
+ * Probe all items of the group, arming a watchpoint on each of them
+ * so that @waiter is notified of events to come.
+ */
 static int collect_events(struct poll_group *group,
-			struct evl_poll_event __user *u_set,
-			int maxevents, struct evl_flag *flag)
+			void __user *u_set, int maxevents,
+			struct poll_waiter *waiter, bool read_timers)
 {
 	struct evl_thread *curr = evl_current();
 	struct evl_poll_watchpoint *wpt, *table;
-	int ret, n, nr, count = 0, ready;
+	int ret, n, nr, count = 0, ready, state;
 	struct evl_poll_connector *poco;
-	struct evl_poll_event ev;
 	unsigned int generation;
 	struct poll_item *item;
 	struct evl_file *efilp;
@@ -428,9 +836,6 @@ static int collect_events(struct poll_group *group,
 	 * directly using those watchpoints if so, otherwise resync.
 	 */
 	table = curr->poll_context.table;
-	if (flag == NULL)
-		goto collect;
-
 	generation = group->generation;
 	if (likely(generation == curr->poll_context.generation))
 		goto collect;
@@ -460,6 +865,8 @@ static int collect_events(struct poll_group *group,
 	list_for_each_entry(item, &group->item_list, next) {
 		wpt->fd = item->fd;
 		wpt->events_polled = item->events_polled;
+		wpt->modifiers = item->modifiers;
+		wpt->events_seen = 0;
 		wpt->pollval = item->pollval;
 		wpt++;
 	}
@@ -467,44 +874,44 @@ static int collect_events(struct poll_group *group,
 collect:
 	evl_unlock_kmutex(&group->item_lock);
 
-	if (flag)
-		curr->poll_context.active = 0;
+	curr->poll_context.active = 0;
+	init_llist_head(&waiter->ready_list);
 
 	for (n = 0, wpt = table; n < nr; n++, wpt++) {
-		if (flag) {
-			wpt->flag = flag;
-			for_each_poll_connector(poco, wpt) {
-				poco->head = NULL;
-				INIT_LIST_HEAD(&poco->next);
-			}
-			/* If oob_poll() is absent, default to all events ready. */
-			ready = POLLIN|POLLOUT|POLLRDNORM|POLLWRNORM;
-			efilp = evl_watch_fd(wpt->fd, &wpt->node);
-			if (efilp == NULL)
-				goto stale;
-			curr->poll_context.active++;
-			filp = efilp->filp;
-			wpt->filp = filp;
-			if (filp->f_op->oob_poll)
-				ready = filp->f_op->oob_poll(filp, &wpt->wait);
-			evl_put_file(efilp);
-		} else {
-			ready = 0;
-			for_each_poll_connector(poco, wpt)
-				ready |= poco->events_received;
+		wpt->flag = &waiter->flag;
+		wpt->ready_list = &waiter->ready_list;
+		wpt->signal = NULL;
+		wpt->events_reported = 0;
+		atomic_set(&wpt->queued, 0);
+		for_each_poll_connector(poco, wpt) {
+			poco->head = NULL;
+			INIT_LIST_HEAD(&poco->next);
 		}
+		/* If oob_poll() is absent, default to all events ready. */
+		ready = POLLIN|POLLOUT|POLLRDNORM|POLLWRNORM;
+		efilp = evl_watch_fd(wpt->fd, &wpt->node);
+		if (efilp == NULL)
+			goto stale;
+		curr->poll_context.active++;
+		filp = efilp->filp;
+		wpt->filp = filp;
+		if (filp->f_op->oob_poll)
+			ready = filp->f_op->oob_poll(filp, &wpt->wait);
+		evl_put_file(efilp);
 
 		ready &= wpt->events_polled | POLLNVAL;
+		if (wpt->modifiers & EVL_POLLET) {
+			state = ready;
+			ready &= ~wpt->events_seen;
+			wpt->events_seen = state;
+		}
+
 		if (ready) {
-			ev.fd = wpt->fd;
-			ev.pollval = wpt->pollval;
-			ev.events = ready;
-			ret = raw_copy_to_user(u_set, &ev, sizeof(ev));
+			ret = report_event(group, &u_set, wpt, ready, read_timers);
 			if (ret) {
-				count = -EFAULT;
+				count = ret;
 				break;
 			}
-			u_set++;
 			if (++count >= maxevents) {
 				count = maxevents;
 				break;
@@ -525,13 +932,51 @@ stale:
 	return -EBADF;
 }
 
+/*
+ * Report the events received by the watchpoints @waiter was
+ * notified about while sleeping, in order of arrival. The cost
+ * depends on the number of ready items, not on the group size.
+ */
+static int harvest_events(struct poll_group *group,
+			void __user *u_set, int maxevents,
+			struct poll_waiter *waiter, bool read_timers)
+{
+	struct evl_poll_watchpoint *wpt;
+	struct evl_poll_connector *poco;
+	struct llist_node *ready_list;
+	int ret, count = 0, ready;
+
+	ready_list = llist_del_all(&waiter->ready_list);
+	ready_list = llist_reverse_order(ready_list);
+
+	llist_for_each_entry(wpt, ready_list, ready) {
+		ready = 0;
+		for_each_poll_connector(poco, wpt)
+			ready |= poco->events_received;
+
+		ready &= wpt->events_polled | POLLNVAL;
+		if (!ready)
+			continue;
+
+		wpt->events_seen |= ready;
+		ret = report_event(group, &u_set, wpt, ready, read_timers);
+		if (ret)
+			return ret;
+		if (++count >= maxevents)
+			break;
+	}
+
+	return count;
+}
+
 static inline void clear_wait(void)
 {
 	struct evl_thread *curr = evl_current();
 	struct evl_poll_watchpoint *wpt;
 	struct evl_poll_connector *poco;
+	bool handoff = false;
 	unsigned long flags;
-	int n;
+	int n, leftover;
 
 	/*
 	 * Current stopped waiting for events, remove the watchpoints
@@ -545,6 +990,11 @@ static inline void clear_wait(void)
 	 * is stale. Since only the caller may update the linkage of
 	 * its watchpoints, using list_empty() locklessly is safe
 	 * here.
+	 *
+	 * Since an event wakes up a single waiter, those we received
+	 * but did not report, e.g. past maxevents or once timed out,
+	 * are passed on to the next waiter in line, which would
+	 * remain asleep otherwise.
 	 */
 	for (n = 0, wpt = curr->poll_context.table;
 	     n < curr->poll_context.active; n++, wpt++) {
@@ -553,21 +1003,33 @@ static inline void clear_wait(void)
 		for_each_poll_connector(poco, wpt) {
 			raw_spin_lock_irqsave(&poco->head->lock, flags);
 			list_del(&poco->next);
-			if (!(poco->events_received & POLLNVAL) && poco->unwatch)
-				poco->unwatch(poco->head);
+			if (!(poco->events_received & POLLNVAL)) {
+				if (poco->unwatch)
+					poco->unwatch(poco->head);
+				leftover = poco->events_received &
+					~wpt->events_reported;
+				if (leftover) {
+					signal_watchpoints(poco->head, leftover);
+					handoff = true;
+				}
+			}
 			raw_spin_unlock_irqrestore(&poco->head->lock, flags);
 		}
 	}
+
+	if (handoff)
+		evl_schedule();
 }
 
 static inline
 int wait_events(struct file *filp,
 		struct poll_group *group,
 		struct evl_poll_waitreq *wreq,
-		struct timespec64 *ts64)
+		struct timespec64 *ts64,
+		bool read_timers)
 {
-	struct evl_poll_event __user *u_set;
 	struct poll_waiter waiter;
+	void __user *u_set;
 	enum evl_tmode tmode;
 	unsigned long flags;
 	ktime_t timeout;
@@ -579,10 +1041,11 @@ int wait_events(struct file *filp,
 	if (wreq->nrset == 0)
 		return 0;
 
-	u_set = evl_valptr64(wreq->pollset_ptr, struct evl_poll_event);
+	u_set = evl_valptr64(wreq->pollset_ptr, void);
 	evl_init_flag_on_stack(&waiter.flag);
 
-	count = collect_events(group, u_set, wreq->nrset, &waiter.flag);
+	count = collect_events(group, u_set, wreq->nrset,
+			&waiter, read_timers);
 	if (count > 0 || (count == -EFAULT || count == -EBADF))
 		goto unwait;
 	if (count < 0)
@@ -605,8 +1068,9 @@ int wait_events(struct file *filp,
 	raw_spin_unlock_irqrestore(&group->wait_lock, flags);
 
 	count = ret;
-	if (count == 0)	/* Re-collect events after successful wait. */
-		count = collect_events(group, u_set, wreq->nrset, NULL);
+	if (count == 0)	/* Harvest events after successful wait. */
+		count = harvest_events(group, u_set, wreq->nrset,
+				&waiter, read_timers);
 unwait:
 	clear_wait();
 out:
@@ -634,6 +1098,7 @@ static int poll_open(struct inode *inode, struct file *filp)
 	INIT_LIST_HEAD(&group->item_list);
 	INIT_LIST_HEAD(&group->waiter_list);
 	evl_init_kmutex(&group->item_lock);
+	evl_init_flag(&group->ring_flag);
 	raw_spin_lock_init(&group->wait_lock);
 	might_hard_lock(&group->wait_lock); /* see __evl_init_wait(). */
 	filp->private_data = group;
@@ -647,7 +1112,7 @@ static inline void flush_items(struct poll_group *group)
 	struct poll_item *item, *n;
 
 	list_for_each_entry_safe(item, n, &group->item_list, next)
-		evl_free(item);
+		evl_slab_free(&poll_item_slab, item);
 }
 
 static int poll_release(struct inode *inode, struct file *filp)
@@ -662,7 +1127,16 @@ static int poll_release(struct inode *inode, struct file *filp)
 	raw_spin_unlock_irqrestore(&group->wait_lock, flags);
 	evl_schedule();
 
+	/* No more callers, no locking needed. */
+	if (group->ring) {
+		disarm_ring(group);
+		if (group->ring_table)
+			evl_free(group->ring_table);
+		evl_free_chunk(&evl_shared_heap, group->ring);
+	}
+
 	flush_items(group);
+	evl_destroy_flag(&group->ring_flag);
 	evl_destroy_kmutex(&group->item_lock);
 	evl_release_file(&group->efile);
 	kfree(group);
@@ -676,6 +1150,8 @@ static long poll_oob_ioctl(struct file *filp, unsigned int cmd,
 	struct poll_group *group = filp->private_data;
 	struct evl_poll_waitreq wreq, __user *u_wreq;
 	struct evl_poll_ctlreq creq, __user *u_creq;
+	struct evl_poll_ringreq rreq, __user *u_rreq;
+	struct evl_poll_ringwait rwait, __user *u_rwait;
 	struct __evl_timespec __user *u_uts;
 	struct __evl_timespec uts = {
 		.tv_sec = 0,
@@ -693,6 +1169,7 @@ static long poll_oob_ioctl(struct file *filp, unsigned int cmd,
 		ret = setup_item(filp, group, &creq);
 		break;
 	case EVL_POLIOC_WAIT:
+	case EVL_POLIOC_WAIT_TIMERS:
 		u_wreq = (typeof(u_wreq))arg;
 		ret = raw_copy_from_user(&wreq, u_wreq, sizeof(wreq));
 		if (ret)
@@ -704,13 +1181,39 @@ static long poll_oob_ioctl(struct file *filp, unsigned int cmd,
 		if ((unsigned long)uts.tv_nsec >= ONE_BILLION)
 			return -EINVAL;
 		ts64 = u_timespec_to_timespec64(uts);
-		ret = wait_events(filp, group, &wreq, &ts64);
+		ret = wait_events(filp, group, &wreq, &ts64,
+				cmd == EVL_POLIOC_WAIT_TIMERS);
 		if (ret < 0)
 			return ret;
 		if (raw_put_user(ret, &u_wreq->nrset))
 			return -EFAULT;
 		ret = 0;
 		break;
+	case EVL_POLIOC_SETUP_RING:
+		u_rreq = (typeof(u_rreq))arg;
+		ret = raw_copy_from_user(&rreq, u_rreq, sizeof(rreq));
+		if (ret)
+			return -EFAULT;
+		ret = setup_ring(group, &rreq);
+		if (ret)
+			return ret;
+		if (raw_put_user(rreq.ring_offset, &u_rreq->ring_offset))
+			return -EFAULT;
+		break;
+	case EVL_POLIOC_WAIT_RING:
+		u_rwait = (typeof(u_rwait))arg;
+		ret = raw_copy_from_user(&rwait, u_rwait, sizeof(rwait));
+		if (ret)
+			return -EFAULT;
+		u_uts = evl_valptr64(rwait.timeout_ptr, struct __evl_timespec);
+		ret = raw_copy_from_user(&uts, u_uts, sizeof(uts));
+		if (ret)
+			return -EFAULT;
+		if ((unsigned long)uts.tv_nsec >= ONE_BILLION)
+			return -EINVAL;
+		ts64 = u_timespec_to_timespec64(uts);
+		ret = wait_ring(filp, group, &ts64);
+		break;
 	default:
 		ret = -ENOTTY;
 	}
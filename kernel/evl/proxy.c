@@ -16,6 +16,8 @@
 #include <linux/irq_work.h>
 #include <linux/workqueue.h>
 #include <linux/atomic.h>
+#include <linux/uio.h>
+#include <linux/jiffies.h>
 #include <evl/factory.h>
 #include <evl/work.h>
 #include <evl/flag.h>
@@ -23,7 +25,7 @@
 #include <uapi/evl/proxy-abi.h>
 
 #define EVL_PROXY_CLONE_FLAGS	\
-	(EVL_CLONE_PUBLIC|EVL_CLONE_OUTPUT|EVL_CLONE_INPUT)
+	(EVL_CLONE_PUBLIC|EVL_CLONE_OUTPUT|EVL_CLONE_INPUT|EVL_CLONE_LOSSY)
 
 struct proxy_ring {
 	void *bufmem;
@@ -34,10 +36,21 @@ struct proxy_ring {
 	unsigned int wroff;
 	unsigned int reserved;
 	unsigned int granularity;
+	/* Output only, see do_proxy_write(). */
+	atomic64_t head;
+	atomic64_t done;
+	atomic64_t ready;
+	atomic64_t consumed;
+	u64 rdpos;
+	bool inflight;
+	unsigned long dropped;
+	bool lossy;
 	struct evl_flag oob_wait;
 	wait_queue_head_t inband_wait_r;
 	wait_queue_head_t inband_wait_w;
 	struct evl_work relay_work;
+	struct delayed_work flush_work;
+	unsigned long flush_delay;
 	hard_spinlock_t lock;
 	struct workqueue_struct *wq;
 	struct mutex worker_lock;
@@ -52,6 +65,8 @@ struct proxy_in {		/* read->oob_read */
 	atomic_t reqsz;
 	atomic_t on_eof;
 	int on_error;
+	unsigned int ra_wmark;	/* Read-ahead watermark, zero if none */
+	atomic_t ra_pending;
 };
 
 struct evl_proxy {
@@ -72,6 +87,84 @@ static inline bool proxy_may_write(struct evl_proxy *proxy)
 	return !!(proxy->element.clone_flags & EVL_CLONE_OUTPUT);
 }
 
+static inline unsigned int ring_offset(struct proxy_ring *ring, u64 pos)
+{
+	u32 off;
+
+	div_u64_rem(pos, ring->bufsz, &off);
+
+	return off;
+}
+
+/*
+ * The relay claims the pending output under the ring lock, so that
+ * writers in lossy mode can tell whether the oldest data is in
+ * flight to the target file.
+ */
+static unsigned int claim_output(struct proxy_ring *ring,
+				unsigned int *rdoffp)
+{
+	unsigned long flags;
+	unsigned int count;
+
+	raw_spin_lock_irqsave(&ring->lock, flags);
+	/* Pairs with publish_output(). */
+	count = atomic_read_acquire(&ring->fillsz);
+	*rdoffp = ring_offset(ring, ring->rdpos);
+	ring->rdpos += count;
+	ring->inflight = true;
+	raw_spin_unlock_irqrestore(&ring->lock, flags);
+
+	return count;
+}
+
+static unsigned int release_output(struct proxy_ring *ring,
+				unsigned int count)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&ring->lock, flags);
+	count = atomic_sub_return(count, &ring->fillsz);
+	/* Pairs with reserve_output(). */
+	atomic64_set_release(&ring->consumed, ring->rdpos);
+	ring->inflight = false;
+	raw_spin_unlock_irqrestore(&ring->lock, flags);
+
+	return count;
+}
+
+/*
+ * Send out the pending output in a single call, covering both ends
+ * of the ring if the data wraps around.
+ */
+static ssize_t write_output_vec(struct proxy_ring *ring, struct file *filp,
+				unsigned int rdoff, unsigned int count,
+				loff_t *ppos)
+{
+	struct iov_iter iter;
+	struct kvec iov[2];
+	int nr = 1;
+	ssize_t ret;
+
+	iov[0].iov_base = ring->bufmem + rdoff;
+	iov[0].iov_len = count;
+	if (rdoff + count > ring->bufsz) {
+		iov[0].iov_len = ring->bufsz - rdoff;
+		iov[1].iov_base = ring->bufmem;
+		iov[1].iov_len = count - iov[0].iov_len;
+		nr = 2;
+	}
+
+	iov_iter_kvec(&iter, ITER_SOURCE, iov, nr, count);
+
+	/* Short writes may happen with pipes and sockets. */
+	do
+		ret = vfs_iter_write(filp, &iter, ppos, 0);
+	while (ret > 0 && iov_iter_count(&iter) > 0);
+
+	return ret;
+}
+
 static void relay_output(struct evl_proxy *proxy)
 {
 	struct proxy_ring *ring = &proxy->output.ring;
@@ -82,8 +175,7 @@ static void relay_output(struct evl_proxy *proxy)
 
 	mutex_lock(&ring->worker_lock);
 
-	count = atomic_read(&ring->fillsz);
-	rdoff = ring->rdoff;
+	count = claim_output(ring, &rdoff);
 
 	ppos = NULL;
 	if (filp->f_mode & FMODE_ATOMIC_POS) {
@@ -93,34 +185,35 @@ static void relay_output(struct evl_proxy *proxy)
 	}
 
 	while (count > 0 && ret >= 0) {
-		len = count;
-		do {
-			if (rdoff + len > ring->bufsz)
-				n = ring->bufsz - rdoff;
-			else
-				n = len;
-
-			if (ring->granularity > 0)
-				n = min(n, ring->granularity);
-
-			ret = kernel_write(filp, ring->bufmem + rdoff, n, ppos);
+		if (ring->granularity == 0) {
+			ret = write_output_vec(ring, filp, rdoff, count, ppos);
 			if (ret >= 0 && ppos)
 				filp->f_pos = *ppos;
-			len -= n;
-			rdoff = (rdoff + n) % ring->bufsz;
-		} while (len > 0 && ret > 0);
+		} else {
+			len = count;
+			do {
+				n = min3(len, ring->bufsz - rdoff,
+					ring->granularity);
+				ret = kernel_write(filp, ring->bufmem + rdoff,
+						n, ppos);
+				if (ret >= 0 && ppos)
+					filp->f_pos = *ppos;
+				len -= n;
+				rdoff = (rdoff + n) % ring->bufsz;
+			} while (len > 0 && ret > 0);
+		}
 		/*
 		 * On error, the portion we failed writing is
 		 * lost. Fair enough.
 		 */
-		count = atomic_sub_return(count, &ring->fillsz);
+		count = release_output(ring, count);
+		if (count > 0 && ret >= 0)
+			count = claim_output(ring, &rdoff);
 	}
 
 	if (ppos)
 		mutex_unlock(&filp->f_pos_lock);
 
-	ring->rdoff = rdoff;
-
 	mutex_unlock(&ring->worker_lock);
 
 	/*
@@ -136,24 +229,143 @@ static void relay_output(struct evl_proxy *proxy)
 	 */
 	if (count < ring->bufsz) {
 		evl_raise_flag(&ring->oob_wait); /* Reschedules. */
-		wake_up(&ring->inband_wait_w);
+		wake_up_poll(&ring->inband_wait_w, EPOLLOUT|EPOLLWRNORM);
 	} else {
 		evl_schedule();	/* Covers evl_signal_poll_events() */
 	}
 }
 
+/*
+ * If a flush delay is set, give the writers some time to pile up
+ * more output before relaying it, so that bursts are merged.
+ */
+static void flush_output(struct evl_proxy *proxy)
+{
+	struct proxy_ring *ring = &proxy->output.ring;
+	unsigned long delay = READ_ONCE(ring->flush_delay);
+
+	if (delay)
+		queue_delayed_work(ring->wq, &ring->flush_work, delay);
+	else
+		relay_output(proxy);
+}
+
 static void relay_output_work(struct evl_work *work)
 {
 	struct evl_proxy *proxy =
 		container_of(work, struct evl_proxy, output.ring.relay_work);
 
+	flush_output(proxy);
+}
+
+static void flush_output_work(struct work_struct *work)
+{
+	struct evl_proxy *proxy =
+		container_of(work, struct evl_proxy, output.ring.flush_work.work);
+
 	relay_output(proxy);
 }
 
 static bool can_write_buffer(struct proxy_ring *ring, size_t size)
 {
-	return atomic_read(&ring->fillsz) +
-		ring->reserved + size <= ring->bufsz;
+	return atomic64_read(&ring->head) + size -
+		atomic64_read_acquire(&ring->consumed) <= ring->bufsz;
+}
+
+/*
+ * Producers on the output ring do not serialize, except in lossy
+ * mode. The ring is tracked by free-running byte positions: head is
+ * the end of the reserved space, done the count of bytes committed
+ * by the producers so far, ready the end of the data the relay may
+ * send out, consumed the start of the space the relay still holds
+ * on to. Space is reserved by moving head forward atomically, then
+ * filled concurrently. Once the committed count catches up with the
+ * reservations, all the data up to that point is complete, so the
+ * last producer to commit publishes it at once to the relay. In
+ * other words, the output becomes visible to the relay in order,
+ * once all the producers which reserved space earlier are done.
+ */
+static int reserve_output(struct proxy_ring *ring, size_t size, u64 *posp)
+{
+	s64 pos = atomic64_read(&ring->head);
+
+	do {
+		if (pos + size - atomic64_read_acquire(&ring->consumed) >
+			ring->bufsz)
+			return -EAGAIN;
+	} while (!atomic64_try_cmpxchg(&ring->head, &pos, pos + size));
+
+	*posp = pos;
+
+	return 0;
+}
+
+/*
+ * ring locked, hard irqs off. Make room for @size bytes by dropping
+ * the oldest data. This is only possible if the relay is not holding
+ * it, since the free space must be contiguous. Returns false if not
+ * enough data can be dropped.
+ */
+static bool drop_output(struct proxy_ring *ring, size_t size)
+{
+	s64 consumed = atomic64_read(&ring->consumed);
+	unsigned int need;
+
+	if (ring->inflight)
+		return false;
+
+	/* Respect the granularity for what remains. */
+	need = atomic64_read(&ring->head) + size - consumed - ring->bufsz;
+	need = roundup(need, ring->granularity ?: 1);
+	if (need > atomic_read(&ring->fillsz))
+		return false;
+
+	ring->rdpos += need;
+	atomic_sub(need, &ring->fillsz);
+	atomic64_set_release(&ring->consumed, ring->rdpos);
+	ring->dropped += need;
+
+	return true;
+}
+
+static int reserve_output_lossy(struct proxy_ring *ring,
+				size_t size, u64 *posp)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	raw_spin_lock_irqsave(&ring->lock, flags);
+
+	/*
+	 * If the relay holds too much of the ring, discard the new
+	 * message silently.
+	 */
+	if (!can_write_buffer(ring, size) && !drop_output(ring, size)) {
+		ring->dropped += size;
+		ret = -ENOSPC;
+	} else {
+		*posp = atomic64_fetch_add(size, &ring->head);
+	}
+
+	raw_spin_unlock_irqrestore(&ring->lock, flags);
+
+	return ret;
+}
+
+/* Returns true on empty -> non-empty transition. */
+static bool publish_output(struct proxy_ring *ring, s64 end)
+{
+	s64 ready = atomic64_read(&ring->ready);
+	unsigned int n;
+
+	do {
+		if (ready >= end)
+			return false;
+	} while (!atomic64_try_cmpxchg(&ring->ready, &ready, end));
+
+	n = end - ready;
+
+	return atomic_add_return(n, &ring->fillsz) == n;
 }
 
 static ssize_t do_proxy_write(struct file *filp,
@@ -161,9 +373,10 @@ static ssize_t do_proxy_write(struct file *filp,
 {
 	struct evl_proxy *proxy = element_of(filp, struct evl_proxy);
 	struct proxy_ring *ring = &proxy->output.ring;
-	unsigned int wroff, wbytes, n, rsvd;
-	unsigned long flags;
+	unsigned int wroff, wbytes, n;
 	ssize_t ret;
+	s64 done;
+	u64 pos;
 	int xret;
 
 	if (count == 0)
@@ -175,19 +388,20 @@ static ssize_t do_proxy_write(struct file *filp,
 	if (ring->granularity > 1 && count % ring->granularity > 0)
 		return -EINVAL;
 
-	raw_spin_lock_irqsave(&ring->lock, flags);
-
-	/* No short or scattered writes. */
-	if (!can_write_buffer(ring, count)) {
-		ret = -EAGAIN;
-		goto out;
+	/*
+	 * No short or scattered writes. In lossy mode, writers never
+	 * wait for the relay.
+	 */
+	if (ring->lossy) {
+		if (reserve_output_lossy(ring, count, &pos))
+			return count;
+	} else {
+		ret = reserve_output(ring, count, &pos);
+		if (ret)
+			return ret;
 	}
 
-	/* Reserve a write slot into the circular buffer. */
-	wroff = ring->wroff;
-	ring->wroff = (wroff + count) % ring->bufsz;
-	ring->nesting++;
-	ring->reserved += count;
+	wroff = ring_offset(ring, pos);
 	wbytes = ret = count;
 
 	do {
@@ -196,11 +410,16 @@ static ssize_t do_proxy_write(struct file *filp,
 		else
 			n = wbytes;
 
-		raw_spin_unlock_irqrestore(&ring->lock, flags);
 		xret = raw_copy_from_user(ring->bufmem + wroff, u_buf, n);
-		raw_spin_lock_irqsave(&ring->lock, flags);
 		if (xret) {
+			/*
+			 * We can't rollback, bluntly clear the
+			 * unavailable bytes instead.
+			 */
 			memset(ring->bufmem + wroff + n - xret, 0, xret);
+			wbytes -= n;
+			if (wbytes > 0)
+				memset(ring->bufmem, 0, wbytes);
 			ret = -EFAULT;
 			break;
 		}
@@ -210,38 +429,129 @@ static ssize_t do_proxy_write(struct file *filp,
 		wroff = (wroff + n) % ring->bufsz;
 	} while (wbytes > 0);
 
-	if (--ring->nesting == 0) {
-		n = atomic_add_return(ring->reserved, &ring->fillsz);
-		rsvd = ring->reserved;
-		ring->reserved = 0;
-		if (n == rsvd) { /* empty -> non-empty transition */
-			if (running_inband()) {
-				raw_spin_unlock_irqrestore(&ring->lock, flags);
-				relay_output(proxy);
-				return ret;
-			}
-			evl_call_inband_from(&ring->relay_work, ring->wq);
+	/* Fully ordered, pairs with the relay reading the data. */
+	done = atomic64_add_return(count, &ring->done);
+	if (done != atomic64_read(&ring->head) ||
+		!publish_output(ring, done))
+		return ret;
+
+	if (running_inband())
+		flush_output(proxy);
+	else
+		evl_call_inband_from(&ring->relay_work, ring->wq);
+
+	return ret;
+}
+
+/*
+ * Read up to @len bytes from the proxied file into the input ring
+ * at @wroff. If the file implements read_iter, we get as much as we
+ * may store in a single vectored call, wrapping around the end of
+ * the ring, unless the data comes in chunks of fixed size.
+ */
+static ssize_t fill_input(struct proxy_ring *ring, struct file *filp,
+			unsigned int wroff, unsigned int len,
+			loff_t *ppos, rwf_t flags)
+{
+	struct iov_iter iter;
+	struct kvec vec[2];
+	unsigned int n;
+	int nr = 1;
+
+	n = min(len, ring->bufsz - wroff);
+	if (ring->granularity > 0)
+		len = n = min(n, ring->granularity);
+
+	if (!filp->f_op->read_iter || filp->f_op->read)
+		return kernel_read(filp, ring->bufmem + wroff, n, ppos);
+
+	vec[0].iov_base = ring->bufmem + wroff;
+	vec[0].iov_len = n;
+	if (len > n) {
+		vec[1].iov_base = ring->bufmem;
+		vec[1].iov_len = len - n;
+		nr = 2;
+	}
+	iov_iter_kvec(&iter, ITER_DEST, vec, nr, len);
+
+	return vfs_iter_read(filp, &iter, ppos, flags);
+}
+
+static inline bool input_may_nowait(struct file *filp)
+{
+	return filp->f_op->read_iter && !filp->f_op->read &&
+		filp->f_mode & FMODE_NOWAIT;
+}
+
+/*
+ * Top up the input ring past what the readers asked for. If the
+ * proxied file supports non-blocking reads, we batch as much data
+ * as it has readily available, otherwise we issue a single read.
+ * Returns false upon EOF or error.
+ */
+static bool read_ahead(struct evl_proxy *proxy, unsigned int *wroffp,
+		loff_t *ppos)
+{
+	struct proxy_in *in = &proxy->input;
+	struct proxy_ring *ring = &in->ring;
+	struct file *filp = proxy->filp;
+	bool nowait = input_may_nowait(filp);
+	unsigned int room;
+	ssize_t ret;
+
+	room = ring->bufsz - atomic_read(&ring->fillsz);
+	room = rounddown(room, ring->granularity ?: 1);
+
+	while (room > 0) {
+		ret = fill_input(ring, filp, *wroffp, room, ppos,
+				nowait ? RWF_NOWAIT : 0);
+		if (ret == -EAGAIN && nowait)
+			break;
+
+		if (ret <= 0) {
+			if (ret)
+				in->on_error = ret;
+			else
+				atomic_set(&in->on_eof, true);
+			return false;
 		}
+
+		if (ppos)
+			filp->f_pos = *ppos;
+
+		atomic_add(ret, &ring->fillsz);
+		*wroffp = (*wroffp + ret) % ring->bufsz;
+		room -= ret;
+		if (!nowait)
+			break;
 	}
-out:
-	raw_spin_unlock_irqrestore(&ring->lock, flags);
 
-	return ret;
+	return true;
+}
+
+static void signal_input(struct evl_proxy *proxy)
+{
+	struct proxy_ring *ring = &proxy->input.ring;
+
+	evl_signal_poll_events(&proxy->poll_head, POLLIN|POLLRDNORM);
+	evl_raise_flag(&ring->oob_wait); /* Reschedules. */
+	wake_up_poll(&ring->inband_wait_r, EPOLLIN|EPOLLRDNORM);
 }
 
 static void relay_input(struct evl_proxy *proxy)
 {
 	struct proxy_in *in = &proxy->input;
 	struct proxy_ring *ring = &in->ring;
-	unsigned int wroff, count, len, n;
+	unsigned int wroff, count, len, room;
 	struct file *filp = proxy->filp;
-	bool exception = false;
+	bool exception = false, readahead;
 	loff_t pos, *ppos;
 	ssize_t ret = 0;
 
 	mutex_lock(&ring->worker_lock);
 
 	count = atomic_read(&in->reqsz);
+	readahead = atomic_xchg(&in->ra_pending, 0);
 	wroff = ring->wroff;
 
 	ppos = NULL;
@@ -254,15 +564,16 @@ static void relay_input(struct evl_proxy *proxy)
 	while (count > 0) {
 		len = count;
 		do {
-			if (wroff + len > ring->bufsz)
-				n = ring->bufsz - wroff;
-			else
-				n = len;
-
-			if (ring->granularity > 0)
-				n = min(n, ring->granularity);
+			/*
+			 * Readers only release space concurrently, so
+			 * room may only grow while we read.
+			 */
+			room = ring->bufsz - atomic_read(&ring->fillsz);
+			if (room == 0)
+				break;
 
-			ret = kernel_read(filp, ring->bufmem + wroff, n, ppos);
+			ret = fill_input(ring, filp, wroff, min(len, room),
+					ppos, 0);
 			if (ret <= 0) {
 				atomic_sub(count - len, &in->reqsz);
 				if (ret)
@@ -277,11 +588,19 @@ static void relay_input(struct evl_proxy *proxy)
 				filp->f_pos = *ppos;
 
 			atomic_add(ret, &ring->fillsz);
-			len -= ret;
-			wroff = (wroff + n) % ring->bufsz;
+			len -= min_t(unsigned int, ret, len);
+			wroff = (wroff + ret) % ring->bufsz;
 		} while (len > 0);
 		count = atomic_sub_return(count, &in->reqsz);
 	}
+
+	if (readahead) {
+		/* Let the readers consume what they asked for first. */
+		if (atomic_read(&ring->fillsz) > 0)
+			signal_input(proxy);
+		if (!read_ahead(proxy, &wroff, ppos))
+			exception = true;
+	}
 done:
 	if (ppos)
 		mutex_unlock(&filp->f_pos_lock);
@@ -290,11 +609,8 @@ done:
 
 	mutex_unlock(&ring->worker_lock);
 
-	if (atomic_read(&ring->fillsz) > 0 || exception) {
-		evl_signal_poll_events(&proxy->poll_head, POLLIN|POLLRDNORM);
-		evl_raise_flag(&ring->oob_wait); /* Reschedules. */
-		wake_up(&ring->inband_wait_r);
-	}
+	if (atomic_read(&ring->fillsz) > 0 || exception)
+		signal_input(proxy);
 }
 
 static void relay_input_work(struct evl_work *work)
@@ -305,6 +621,21 @@ static void relay_input_work(struct evl_work *work)
 	relay_input(proxy);
 }
 
+/*
+ * Kick the relay early if the input ring drained down to the
+ * read-ahead watermark, so that readers do not find it empty.
+ */
+static void kick_read_ahead(struct evl_proxy *proxy)
+{
+	struct proxy_in *in = &proxy->input;
+	struct proxy_ring *ring = &in->ring;
+	unsigned int wmark = READ_ONCE(in->ra_wmark);
+
+	if (wmark && atomic_read(&ring->fillsz) <= wmark &&
+		!atomic_xchg(&in->ra_pending, 1))
+		evl_call_inband_from(&ring->relay_work, ring->wq);
+}
+
 static ssize_t do_proxy_read(struct file *filp,
 			char __user *u_buf, size_t count)
 {
@@ -390,6 +721,9 @@ retry:
 
 	raw_spin_unlock_irqrestore(&ring->lock, flags);
 
+	if (ret > 0)
+		kick_read_ahead(proxy);
+
 	evl_schedule();
 
 	return ret;
@@ -568,6 +902,39 @@ static __poll_t proxy_poll(struct file *filp, poll_table *wait)
 	return ret;
 }
 
+static long proxy_ioctl(struct file *filp,
+			unsigned int cmd, unsigned long arg)
+{
+	struct evl_proxy *proxy = element_of(filp, struct evl_proxy);
+	__u32 val, __user *u_val = (typeof(u_val))arg;
+
+	switch (cmd) {
+	case EVL_PROXYIOC_SET_FLUSH_DELAY:
+		if (!proxy_may_write(proxy))
+			return -ENXIO;
+		if (get_user(val, u_val))
+			return -EFAULT;
+		WRITE_ONCE(proxy->output.ring.flush_delay,
+			usecs_to_jiffies(val));
+		break;
+	case EVL_PROXYIOC_SET_READAHEAD:
+		if (!proxy_may_read(proxy))
+			return -ENXIO;
+		if (get_user(val, u_val))
+			return -EFAULT;
+		if (val >= proxy->input.ring.bufsz)
+			return -EINVAL;
+		WRITE_ONCE(proxy->input.ra_wmark, val);
+		/* Prime the ring right away. */
+		kick_read_ahead(proxy);
+		break;
+	default:
+		return -ENOTTY;
+	}
+
+	return 0;
+}
+
 static int proxy_mmap(struct file *filp, struct vm_area_struct *vma)
 {
 	struct evl_proxy *proxy = element_of(filp, struct evl_proxy);
@@ -618,7 +985,11 @@ static const struct file_operations proxy_fops = {
 	.write		= proxy_write,
 	.read		= proxy_read,
 	.poll		= proxy_poll,
+	.unlocked_ioctl	= proxy_ioctl,
 	.mmap		= proxy_mmap,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl	= compat_ptr_ioctl,
+#endif
 };
 
 static int init_ring(struct proxy_ring *ring,
@@ -646,10 +1017,13 @@ static int init_ring(struct proxy_ring *ring,
 	ring->bufmem = bufmem;
 	ring->bufsz = bufsz;
 	ring->granularity = granularity;
+	ring->lossy = is_output &&
+		!!(proxy->element.clone_flags & EVL_CLONE_LOSSY);
 	raw_spin_lock_init(&ring->lock);
 	evl_init_work_safe(&ring->relay_work,
 			is_output ? relay_output_work : relay_input_work,
 			&proxy->element);
+	INIT_DELAYED_WORK(&ring->flush_work, flush_output_work);
 	evl_init_flag(&ring->oob_wait);
 	init_waitqueue_head(&ring->inband_wait_r);
 	init_waitqueue_head(&ring->inband_wait_w);
@@ -668,6 +1042,7 @@ static void destroy_ring(struct proxy_ring *ring)
 	 * POLLOUT before closing the target file is your friend.
 	 */
 	evl_cancel_work(&ring->relay_work);
+	cancel_delayed_work(&ring->flush_work);
 	destroy_workqueue(ring->wq);
 	kfree(ring->bufmem);
 }
@@ -779,11 +1154,40 @@ static void proxy_factory_dispose(struct evl_element *e)
 	kfree_rcu(proxy, element.rcu);
 }
 
+/* Count of output bytes dropped in lossy mode. */
+static ssize_t drops_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_proxy *proxy;
+	ssize_t ret;
+
+	proxy = evl_get_element_by_dev(dev, struct evl_proxy);
+	if (proxy == NULL)
+		return -EIO;
+
+	ret = snprintf(buf, PAGE_SIZE, "%lu\n",
+		proxy_may_write(proxy) ?
+		READ_ONCE(proxy->output.ring.dropped) : 0);
+
+	evl_put_element(&proxy->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(drops);
+
+static struct attribute *proxy_attrs[] = {
+	&dev_attr_drops.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(proxy);
+
 struct evl_factory evl_proxy_factory = {
 	.name	=	EVL_PROXY_DEV,
 	.fops	=	&proxy_fops,
 	.build =	proxy_factory_build,
 	.dispose =	proxy_factory_dispose,
 	.nrdev	=	CONFIG_EVL_NR_PROXIES,
+	.attrs	=	proxy_groups,
 	.flags	=	EVL_FACTORY_CLONE,
 };
@@ -0,0 +1,234 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/math64.h>
+#include <linux/ptp_clock_kernel.h>
+#include <evl/ptp.h>
+#include <evl/timer.h>
+
+/*
+ * An EVL clock tracking a PTP hardware clock (PHC). Reading a PHC
+ * usually involves device I/O under regular locks, which is not
+ * allowed from the out-of-band stage. Instead, the PHC is sampled
+ * periodically from a kernel workqueue along with the monotonic
+ * clock, and readings from the out-of-band stage are extrapolated
+ * linearly from the latest sample, using the rate of the PHC
+ * relative to the monotonic clock measured between samples.
+ *
+ * This clock is a slave of the monotonic clock: its timers are
+ * queued by PHC date to the monotonic timer base, which converts the
+ * earliest one with the current offset between both clocks when
+ * programming the next shot. Each sample updates this offset, then
+ * evl_adjust_timers() reprograms the shot accordingly, so that the
+ * timers keep in phase with the network time base without any
+ * user-space servo loop. The residual error on a timer date is
+ * bounded by the PHC drift over a sync period.
+ */
+
+#define PTP_DEFAULT_SYNC_PERIOD  (100 * NSEC_PER_MSEC)
+
+/*
+ * Maximum rate deviation we may expect from a PHC being disciplined
+ * (about 500 ppm). Larger values are the sign of a time step, in
+ * which case the previous rate estimate is kept.
+ */
+#define PTP_MAX_RATE_DEV  ((1ULL << 32) / 2000)
+
+static inline struct evl_ptp_clock *to_ptp_clock(struct evl_clock *clock)
+{
+	return container_of(clock, struct evl_ptp_clock, clock);
+}
+
+static ktime_t read_ptp_clock(struct evl_clock *clock)
+{
+	struct evl_ptp_clock *pc = to_ptp_clock(clock);
+	ktime_t delta, phc;
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&pc->seq);
+		delta = ktime_sub(evl_ktime_monotonic(), pc->mono_ref);
+		phc = ktime_add(pc->phc_ref,
+				mul_u64_u64_shr(max_t(ktime_t, delta, 0),
+						pc->mult, 32));
+	} while (read_seqcount_retry(&pc->seq, seq));
+
+	return phc;
+}
+
+static u64 read_ptp_clock_cycles(struct evl_clock *clock)
+{
+	return read_ptp_clock(clock);
+}
+
+/* in-band context. */
+static int sample_phc(struct ptp_clock_info *info,
+		ktime_t *mono, ktime_t *phc)
+{
+	struct ptp_system_timestamp sts = {
+		.clockid = CLOCK_MONOTONIC,
+	};
+	struct timespec64 ts;
+	ktime_t pre, post;
+	int ret;
+
+	/*
+	 * Prefer the extended read, which brackets the PHC access
+	 * more tightly than we could from here.
+	 */
+	if (info->gettimex64) {
+		ret = info->gettimex64(info, &ts, &sts);
+		if (ret)
+			return ret;
+		pre = timespec64_to_ktime(sts.pre_ts);
+		post = timespec64_to_ktime(sts.post_ts);
+	} else {
+		pre = ktime_get();
+		ret = info->gettime64(info, &ts);
+		post = ktime_get();
+		if (ret)
+			return ret;
+	}
+
+	*mono = ktime_add_ns(pre, ktime_sub(post, pre) / 2);
+	*phc = timespec64_to_ktime(ts);
+
+	return 0;
+}
+
+static void sync_ptp_clock(struct work_struct *work)
+{
+	struct evl_ptp_clock *pc = container_of(to_delayed_work(work),
+						struct evl_ptp_clock, sync_work);
+	ktime_t mono, phc, old_offset;
+	unsigned long flags;
+	u64 mult;
+
+	if (sample_phc(pc->info, &mono, &phc))
+		goto requeue;
+
+	mult = pc->mult;
+	if (mono > pc->mono_ref && phc > pc->phc_ref) {
+		mult = mul_u64_u64_div_u64(ktime_sub(phc, pc->phc_ref),
+					1ULL << 32,
+					ktime_sub(mono, pc->mono_ref));
+		if (abs_diff(mult, 1ULL << 32) > PTP_MAX_RATE_DEV)
+			mult = pc->mult;
+	}
+
+	flags = hard_local_irq_save();
+	raw_write_seqcount_begin(&pc->seq);
+	pc->mono_ref = mono;
+	pc->phc_ref = phc;
+	pc->mult = mult;
+	raw_write_seqcount_end(&pc->seq);
+	hard_local_irq_restore(flags);
+
+	evl_publish_clock_state(&pc->clock, mono, phc, mult, 32);
+
+	old_offset = pc->clock.offset;
+	pc->clock.offset = evl_read_clock(&pc->clock) -
+		evl_read_clock(&evl_mono_clock);
+	if (pc->clock.offset != old_offset)
+		evl_adjust_timers(&pc->clock, pc->clock.offset - old_offset);
+requeue:
+	schedule_delayed_work(&pc->sync_work, pc->sync_delay);
+}
+
+static void dispose_ptp_clock(struct evl_clock *clock)
+{
+	struct evl_ptp_clock *pc = to_ptp_clock(clock);
+
+	kfree(clock->name);
+	kfree(pc);
+}
+
+/**
+ * evl_register_ptp_clock - expose a PHC as an EVL clock
+ * @info: the PHC descriptor, as registered with the PTP core
+ * @name: the name of the EVL clock device
+ * @sync_period: the delay between two samples of the PHC, zero
+ * selects the default (100ms)
+ *
+ * Typically called by the driver of a NIC which provides a PHC
+ * once the latter is operational. Timers and threads may then be
+ * timed by this clock using the EVL clock device.
+ */
+struct evl_ptp_clock *
+evl_register_ptp_clock(struct ptp_clock_info *info,
+		const char *name, ktime_t sync_period)
+{
+	struct evl_ptp_clock *pc;
+	int ret;
+
+	inband_context_only();
+
+	if (!info->gettimex64 && !info->gettime64)
+		return ERR_PTR(-EINVAL);
+
+	pc = kzalloc(sizeof(*pc), GFP_KERNEL);
+	if (pc == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	pc->clock.name = kstrdup(name, GFP_KERNEL);
+	if (pc->clock.name == NULL) {
+		ret = -ENOMEM;
+		goto fail_name;
+	}
+
+	pc->info = info;
+	pc->mult = 1ULL << 32;
+	seqcount_init(&pc->seq);
+	ret = sample_phc(info, &pc->mono_ref, &pc->phc_ref);
+	if (ret)
+		goto fail_sample;
+
+	pc->clock.resolution = 1;	/* nanosecond. */
+	pc->clock.gravity = evl_mono_clock.gravity;
+	pc->clock.flags = EVL_CLONE_PUBLIC;
+	pc->clock.ops.read = read_ptp_clock;
+	pc->clock.ops.read_cycles = read_ptp_clock_cycles;
+	pc->clock.dispose = dispose_ptp_clock;
+
+	ret = evl_init_slave_clock(&pc->clock, &evl_mono_clock);
+	if (ret)
+		goto fail_sample;
+
+	evl_publish_clock_state(&pc->clock, pc->mono_ref, pc->phc_ref,
+				pc->mult, 32);
+
+	pc->sync_delay = nsecs_to_jiffies(sync_period ?: PTP_DEFAULT_SYNC_PERIOD);
+	INIT_DELAYED_WORK(&pc->sync_work, sync_ptp_clock);
+	schedule_delayed_work(&pc->sync_work, pc->sync_delay);
+
+	return pc;
+
+fail_sample:
+	kfree(pc->clock.name);
+fail_name:
+	kfree(pc);
+
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(evl_register_ptp_clock);
+
+/**
+ * evl_unregister_ptp_clock - stop exposing a PHC as an EVL clock
+ * @pc: the clock returned by evl_register_ptp_clock()
+ *
+ * The PHC is not sampled anymore on return, so the caller may
+ * dispose of it. The EVL clock goes away when the last reference
+ * to it is dropped, extrapolating from the last sample until then.
+ */
+void evl_unregister_ptp_clock(struct evl_ptp_clock *pc)
+{
+	inband_context_only();
+
+	cancel_delayed_work_sync(&pc->sync_work);
+	pc->info = NULL;
+	evl_put_element(&pc->clock.element);
+}
+EXPORT_SYMBOL_GPL(evl_unregister_ptp_clock);
@@ -6,11 +6,20 @@
  */
 
 #include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/random.h>
+#include <crypto/chacha.h>
 #include <evl/factory.h>
 #include <evl/random.h>
 #include <evl/uaccess.h>
 #include <uapi/evl/random-abi.h>
 
+/*
+ * Each CPU runs its own set of generators, serialized by disabling
+ * hard irqs locally, so that callers from any stage never compete
+ * for the same state, nor share cache lines.
+ */
+
 static const u64 EVL_RNG_PRIME_u8 = 409;
 
 static const u64 EVL_RNG_PRIME_u16 = 106013;
@@ -21,11 +30,14 @@ static const u64 EVL_RNG_PRIME_u32 = 949402981;
 #define EVL_RNG_J	24
 #define EVL_RNG_K	EVL_RNG_SIZE
 
+/* Largest chunk filled with hard irqs off. */
+#define EVL_RNG_CHUNK	256
+
 #define EVL_DEFINE_RNG(__type)						\
-	static struct evl_rng_ ## __type {				\
+	struct evl_rng_ ## __type {					\
 		__type array[EVL_RNG_SIZE];				\
 		size_t index;						\
-	} evl_rng_ ## __type;						\
+	};								\
 									\
 	static void init_rng_ ## __type(struct evl_rng_ ## __type *rng, __type seed) \
 	{								\
@@ -37,6 +49,9 @@ static const u64 EVL_RNG_PRIME_u32 = 949402981;
 			val += EVL_RNG_PRIME_ ## __type;		\
 			rng->array[n] = (__type)val;			\
 		}							\
+		/* At least one odd seed for the full period. */	\
+		rng->array[0] |= 1;					\
+		rng->index = 0;						\
 	}								\
 									\
 	static __type read_rng_ ## __type(struct evl_rng_ ## __type *rng) \
@@ -57,31 +72,143 @@ static const u64 EVL_RNG_PRIME_u32 = 949402981;
 		rng->index = (rng->index + 1) % ARRAY_SIZE(rng->array);	\
 									\
 		return res;						\
-	}								\
-									\
-	__type evl_read_rng_ ## __type(void)				\
-	{								\
-		return read_rng_ ## __type(&evl_rng_ ## __type);	\
 	}
 
 EVL_DEFINE_RNG(u8);
 EVL_DEFINE_RNG(u16);
 EVL_DEFINE_RNG(u32);
 
+struct evl_rng_state {
+	struct evl_rng_u8 rng_u8;
+	struct evl_rng_u16 rng_u16;
+	struct evl_rng_u32 rng_u32;
+	u32 chacha[CHACHA_STATE_WORDS];
+	u8 stream[CHACHA_BLOCK_SIZE];
+	unsigned int avail;	/* unused bytes at the end of stream[] */
+};
+
+static DEFINE_PER_CPU(struct evl_rng_state, evl_rng_state);
+
+#define EVL_DEFINE_RNG_READ(__type)					\
+	__type evl_read_rng_ ## __type(void)				\
+	{								\
+		struct evl_rng_state *st;				\
+		unsigned long flags;					\
+		__type res;						\
+									\
+		flags = hard_local_irq_save();				\
+		st = raw_cpu_ptr(&evl_rng_state);			\
+		res = read_rng_ ## __type(&st->rng_ ## __type);		\
+		hard_local_irq_restore(flags);				\
+									\
+		return res;						\
+	}								\
+	EXPORT_SYMBOL_GPL(evl_read_rng_ ## __type);
+
+EVL_DEFINE_RNG_READ(u8);
+EVL_DEFINE_RNG_READ(u16);
+EVL_DEFINE_RNG_READ(u32);
+
+static void fill_fast(struct evl_rng_state *st, u8 *buf, size_t len)
+{
+	u32 val;
+
+	while (len >= sizeof(val)) {
+		val = read_rng_u32(&st->rng_u32);
+		memcpy(buf, &val, sizeof(val));
+		buf += sizeof(val);
+		len -= sizeof(val);
+	}
+
+	if (len) {
+		val = read_rng_u32(&st->rng_u32);
+		memcpy(buf, &val, len);
+	}
+}
+
+static void fill_chacha(struct evl_rng_state *st, u8 *buf, size_t len)
+{
+	size_t n;
+
+	while (len > 0) {
+		if (st->avail == 0) {
+			chacha20_block(st->chacha, st->stream);
+			/* Carry the block counter over to the nonce. */
+			if (st->chacha[12] == 0)
+				st->chacha[13]++;
+			st->avail = CHACHA_BLOCK_SIZE;
+		}
+		n = min_t(size_t, len, st->avail);
+		memcpy(buf, st->stream + CHACHA_BLOCK_SIZE - st->avail, n);
+		/* Never hand out the same key stream twice. */
+		memzero_explicit(st->stream + CHACHA_BLOCK_SIZE - st->avail, n);
+		st->avail -= n;
+		buf += n;
+		len -= n;
+	}
+}
+
+/*
+ * Fill @buf with @len random bytes, from the ChaCha20 key stream of
+ * the current CPU if @mode is EVL_RNG_CHACHA, or from the fast
+ * generator otherwise. Callable from any stage, does not sleep.
+ */
+void evl_fill_rng(void *buf, size_t len, int mode)
+{
+	struct evl_rng_state *st;
+	unsigned long flags;
+	size_t n;
+
+	while (len > 0) {
+		n = min_t(size_t, len, EVL_RNG_CHUNK);
+		flags = hard_local_irq_save();
+		st = raw_cpu_ptr(&evl_rng_state);
+		if (mode == EVL_RNG_CHACHA)
+			fill_chacha(st, buf, n);
+		else
+			fill_fast(st, buf, n);
+		hard_local_irq_restore(flags);
+		buf += n;
+		len -= n;
+	}
+}
+EXPORT_SYMBOL_GPL(evl_fill_rng);
+
+static ssize_t fill_user_rng(void __user *u_buf, size_t count, int mode)
+{
+	u8 chunk[EVL_RNG_CHUNK];
+	size_t len, n;
+
+	for (len = count; len > 0; len -= n, u_buf += n) {
+		n = min_t(size_t, len, sizeof(chunk));
+		evl_fill_rng(chunk, n, mode);
+		if (raw_copy_to_user(u_buf, chunk, n))
+			return -EFAULT;
+	}
+
+	memzero_explicit(chunk, sizeof(chunk));
+
+	return count;
+}
+
 static ssize_t rng_common_read(struct file *filp,
 			char __user *u_buf, size_t count)
 {
 	u32 val32;
 
-	if (count != sizeof(val32))
-		return -EINVAL;
-
-	val32 = evl_read_rng_u32();
+	/* Keep the common single value case simple. */
+	if (count == sizeof(val32)) {
+		val32 = evl_read_rng_u32();
+		if (raw_put_user(val32, (u32 __user *)u_buf))
+			return -EFAULT;
+		return count;
+	}
 
-	if (raw_put_user(val32, (u32 __user *)u_buf))
-		return -EFAULT;
+	if (count == 0)
+		return -EINVAL;
 
-	return count;
+	return fill_user_rng(u_buf, min_t(size_t, count, MAX_RW_COUNT),
+			EVL_RNG_FAST);
 }
 
 static ssize_t rng_oob_read(struct file *filp,
@@ -96,6 +223,26 @@ static ssize_t rng_read(struct file *filp, char __user *u_buf,
 	return rng_common_read(filp, u_buf, count);
 }
 
+static long rng_fill_ioctl(struct evl_rng_fillreq __user *u_req)
+{
+	struct evl_rng_fillreq req;
+	ssize_t ret;
+
+	if (raw_copy_from_user(&req, u_req, sizeof(req)))
+		return -EFAULT;
+
+	if (req.mode != EVL_RNG_FAST && req.mode != EVL_RNG_CHACHA)
+		return -EINVAL;
+
+	if (req.len > MAX_RW_COUNT)
+		return -EINVAL;
+
+	ret = fill_user_rng(evl_valptr64(req.buf_ptr, void __user),
+			req.len, req.mode);
+
+	return ret < 0 ? ret : 0;
+}
+
 static long rng_common_ioctl(struct file *filp, unsigned int cmd,
 			unsigned long arg)
 {
@@ -117,6 +264,8 @@ static long rng_common_ioctl(struct file *filp, unsigned int cmd,
 		val32 = evl_read_rng_u32();
 		ret = raw_put_user(val32, (u32 __user *)arg);
 		break;
+	case EVL_RNGIOC_FILL:
+		return rng_fill_ioctl((struct evl_rng_fillreq __user *)arg);
 	default:
 		ret = -ENOTTY;
 	}
@@ -136,13 +285,26 @@ static long rng_ioctl(struct file *filp, unsigned int cmd,
 	return rng_common_ioctl(filp, cmd, arg);
 }
 
+/* In-band, early at boot, seed each CPU from the kernel CRNG. */
 void evl_init_rng(void)
 {
-	u64 now = ktime_get();
+	u32 key[CHACHA_KEY_SIZE / sizeof(u32)];
+	u8 iv[CHACHA_IV_SIZE];
+	struct evl_rng_state *st;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(&evl_rng_state, cpu);
+		init_rng_u8(&st->rng_u8, get_random_u8());
+		init_rng_u16(&st->rng_u16, get_random_u16());
+		init_rng_u32(&st->rng_u32, get_random_u32());
+		get_random_bytes(key, sizeof(key));
+		get_random_bytes(iv, sizeof(iv));
+		chacha_init_generic(st->chacha, key, iv);
+		st->avail = 0;
+	}
 
-	init_rng_u8(&evl_rng_u8, (u8)now);
-	init_rng_u16(&evl_rng_u16, (u16)now);
-	init_rng_u32(&evl_rng_u32, (u32)now);
+	memzero_explicit(key, sizeof(key));
 }
 
 static const struct file_operations rng_fops = {
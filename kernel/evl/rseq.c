@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/uaccess.h>
+#include <linux/ptrace.h>
+#include <evl/thread.h>
+#include <evl/rseq.h>
+#include <evl/uaccess.h>
+
+/*
+ * Restartable sequences for oob threads. This is the out-of-band
+ * counterpart of rseq(2): the in-band flavour only deals with
+ * preemption by the in-band scheduler, which cannot happen to a
+ * thread running out-of-band.
+ */
+
+static bool fetch_rseq_cs(u64 ptr, struct evl_rseq_cs *cs)
+{
+	if (ptr >= TASK_SIZE)
+		return false;
+
+	/*
+	 * We run with hard irqs off from the mayday trap, the
+	 * descriptor must be resident (mlockall() is required for
+	 * EVL threads anyway).
+	 */
+	if (copy_from_user_nofault(cs, evl_valptr64(ptr, void __user),
+					sizeof(*cs)))
+		return false;
+
+	if (cs->version || cs->flags)
+		return false;
+
+	if (cs->start_ip >= TASK_SIZE ||
+		cs->start_ip + cs->post_commit_offset < cs->start_ip ||
+		cs->start_ip + cs->post_commit_offset >= TASK_SIZE ||
+		cs->abort_ip >= TASK_SIZE)
+		return false;
+
+	/* Aborting into the section would loop forever. */
+	if (cs->abort_ip - cs->start_ip < cs->post_commit_offset)
+		return false;
+
+	return true;
+}
+
+/* From the mayday trap, on the way back to user mode. */
+void evl_rseq_handle_abort(struct evl_thread *curr, struct pt_regs *regs)
+{
+	struct evl_user_window *u_window = curr->u_window;
+	struct evl_rseq_cs cs;
+	unsigned long ip;
+	u64 ptr;
+
+	if (u_window == NULL)
+		return;
+
+	ptr = READ_ONCE(u_window->rseq_cs);
+	if (!ptr)
+		return;
+
+	WRITE_ONCE(u_window->rseq_cs, 0);
+
+	/* Ignore malformed descriptors, there is nothing to abort. */
+	if (!fetch_rseq_cs(ptr, &cs))
+		return;
+
+	ip = instruction_pointer(regs);
+	if (ip - cs.start_ip < cs.post_commit_offset)
+		instruction_pointer_set(regs, cs.abort_ip);
+}
@@ -23,8 +23,16 @@
 #include <evl/monitor.h>
 #include <evl/mutex.h>
 #include <evl/flag.h>
+#include <evl/flightrec.h>
+#include <evl/statmap.h>
+#include <evl/memguard.h>
+#include <evl/smpcall.h>
+#include <evl/rseq.h>
 #include <uapi/evl/signal.h>
 #include <trace/events/evl.h>
+#ifdef CONFIG_EVL_RESCTRL
+#include <asm/resctrl.h>
+#endif
 
 DEFINE_PER_CPU(struct evl_rq, evl_runqueues);
 EXPORT_PER_CPU_SYMBOL_GPL(evl_runqueues);
@@ -37,17 +45,10 @@ static struct evl_sched_class *evl_sched_topmost;
 #define for_each_evl_sched_class(p)		\
 	for (p = evl_sched_topmost; p; p = p->next)
 
-static struct evl_sched_class *evl_sched_lower;
-
-#define for_each_evl_lower_sched_class(p)	\
-	for (p = evl_sched_lower; p; p = p->next)
-
 static void register_one_class(struct evl_sched_class *sched_class)
 {
 	sched_class->next = evl_sched_topmost;
 	evl_sched_topmost = sched_class;
-	if (sched_class != &evl_sched_fifo)
-		evl_sched_lower = sched_class;
 
 	/*
 	 * Classes shall be registered by increasing priority order,
@@ -66,6 +67,9 @@ static void register_classes(void)
 #endif
 #ifdef CONFIG_EVL_SCHED_TP
 	register_one_class(&evl_sched_tp);
+#endif
+#ifdef CONFIG_EVL_SCHED_EDF
+	register_one_class(&evl_sched_edf);
 #endif
 	register_one_class(&evl_sched_fifo);
 
@@ -73,6 +77,39 @@ static void register_classes(void)
 	EVL_WARN_ON_ONCE(CORE, evl_sched_topmost != &evl_sched_fifo);
 }
 
+#if defined(CONFIG_EVL_WATCHDOG) || defined(CONFIG_EVL_THREAD_BUDGET)
+
+/* oob stage stalled, @curr is this_rq->curr. */
+static void kick_runaway_thread(struct evl_rq *this_rq,
+				struct evl_thread *curr, int diag)
+{
+	if (curr->state & EVL_T_USER) {
+		raw_spin_lock(&curr->lock);
+		raw_spin_lock(&this_rq->lock);
+		curr->info |= EVL_T_KICKED;
+		raw_spin_unlock(&this_rq->lock);
+		raw_spin_unlock(&curr->lock);
+		evl_notify_thread(curr, diag, evl_nil);
+		dovetail_send_mayday(current);
+	} else {
+		/*
+		 * On behalf on an IRQ handler, evl_cancel_thread()
+		 * would go half way cancelling the preempted
+		 * thread. Therefore we manually raise EVL_T_KICKED to
+		 * cause the next blocking call to return early in
+		 * EVL_T_BREAK condition, and EVL_T_CANCELD so that @curr
+		 * exits next time it invokes evl_test_cancel().
+		 */
+		raw_spin_lock(&curr->lock);
+		raw_spin_lock(&this_rq->lock);
+		curr->info |= (EVL_T_KICKED|EVL_T_CANCELD);
+		raw_spin_unlock(&this_rq->lock);
+		raw_spin_unlock(&curr->lock);
+	}
+}
+
+#endif
+
 #ifdef CONFIG_EVL_WATCHDOG
 
 static unsigned long wd_timeout_arg = CONFIG_EVL_WATCHDOG_TIMEOUT;
@@ -99,37 +136,214 @@ static void watchdog_handler(struct evl_timer *timer) /* oob stage stalled */
 	if (curr->state & EVL_T_ROOT)
 		return;
 
-	if (curr->state & EVL_T_USER) {
-		raw_spin_lock(&curr->lock);
-		raw_spin_lock(&this_rq->lock);
-		curr->info |= EVL_T_KICKED;
-		raw_spin_unlock(&this_rq->lock);
-		raw_spin_unlock(&curr->lock);
-		evl_notify_thread(curr, EVL_HMDIAG_WATCHDOG, evl_nil);
-		dovetail_send_mayday(current);
-		printk(EVL_WARNING "watchdog triggered on CPU #%d -- runaway thread "
-			"'%s' signaled\n", evl_rq_cpu(this_rq), curr->name);
-	} else {
-		printk(EVL_WARNING "watchdog triggered on CPU #%d -- runaway thread "
-			"'%s' canceled\n", evl_rq_cpu(this_rq), curr->name);
-		/*
-		 * On behalf on an IRQ handler, evl_cancel_thread()
-		 * would go half way cancelling the preempted
-		 * thread. Therefore we manually raise EVL_T_KICKED to
-		 * cause the next blocking call to return early in
-		 * EVL_T_BREAK condition, and EVL_T_CANCELD so that @curr
-		 * exits next time it invokes evl_test_cancel().
-		 */
-		raw_spin_lock(&curr->lock);
-		raw_spin_lock(&this_rq->lock);
-		curr->info |= (EVL_T_KICKED|EVL_T_CANCELD);
-		raw_spin_unlock(&this_rq->lock);
-		raw_spin_unlock(&curr->lock);
-	}
+	printk(EVL_WARNING "watchdog triggered on CPU #%d -- runaway thread "
+		"'%s' %s\n", evl_rq_cpu(this_rq), curr->name,
+		curr->state & EVL_T_USER ? "signaled" : "canceled");
+
+	kick_runaway_thread(this_rq, curr, EVL_HMDIAG_WATCHDOG);
 }
 
 #endif /* CONFIG_EVL_WATCHDOG */
 
+#ifdef CONFIG_EVL_THREAD_BUDGET
+
+/*
+ * The budget timer is armed when switching in a thread which has a
+ * runtime budget, so it fires if the latter keeps the CPU past its
+ * allotted time without ever being switched out.
+ */
+static void budget_handler(struct evl_timer *timer) /* oob stage stalled */
+{
+	struct evl_rq *this_rq = container_of(timer, struct evl_rq, budget_timer);
+	struct evl_thread *curr = this_rq->curr;
+
+	/*
+	 * The budget of the current thread may have been revoked
+	 * since it was switched in, or the tick might have been
+	 * delayed past a switch to a thread which has none.
+	 */
+	if (curr->state & EVL_T_ROOT || !curr->budget.runtime)
+		return;
+
+	trace_evl_budget_overrun(curr);
+
+	switch (READ_ONCE(curr->budget.action)) {
+	case EVL_BUDGET_STOP:
+		kick_runaway_thread(this_rq, curr, EVL_HMDIAG_BUDGET);
+		break;
+	case EVL_BUDGET_DEMOTE:
+		evl_notify_thread(curr, EVL_HMDIAG_BUDGET, evl_nil);
+		evl_demote_thread(curr);
+		break;
+	default:
+		evl_notify_thread(curr, EVL_HMDIAG_BUDGET, evl_nil);
+	}
+}
+
+#endif /* CONFIG_EVL_THREAD_BUDGET */
+
+#ifdef CONFIG_EVL_RESCTRL
+
+/*
+ * Load the resctrl settings for @curr which is running on this CPU:
+ * those of the underlying task as __resctrl_sched_in() would pick
+ * them, unless overridden for the oob stage. CLOSIDs which became
+ * out of range since the override was set, e.g. after remounting
+ * with CDP enabled, are ignored. Hard irqs off.
+ */
+void evl_switch_resctrl(struct evl_thread *curr)
+{
+	struct resctrl_pqr_state *state;
+	int flags = curr->resctrl.flags;
+	u32 closid, rmid;
+
+	if (!static_branch_unlikely(&rdt_enable_key))
+		return;
+
+	if (likely(!flags)) {
+		__resctrl_sched_in(current);
+		return;
+	}
+
+	state = this_cpu_ptr(&pqr_state);
+
+	closid = READ_ONCE(current->closid) ?: state->default_closid;
+	if (flags & EVL_RESCTRL_CLOSID &&
+		curr->resctrl.closid < closids_supported())
+		closid = curr->resctrl.closid;
+
+	rmid = READ_ONCE(current->rmid) ?: state->default_rmid;
+	if (flags & EVL_RESCTRL_RMID)
+		rmid = curr->resctrl.rmid;
+
+	if (closid != state->cur_closid || rmid != state->cur_rmid) {
+		state->cur_closid = closid;
+		state->cur_rmid = rmid;
+		wrmsr(MSR_IA32_PQR_ASSOC, rmid, closid);
+	}
+}
+
+#endif /* CONFIG_EVL_RESCTRL */
+
+#ifdef CONFIG_EVL_RUNSTATS
+
+/*
+ * Tell switches which may keep the active mm, i.e. toward a thread
+ * of the same process or a kernel thread borrowing it, from those
+ * which require the arch code to switch address spaces.
+ */
+static inline void account_mm_switch(struct evl_rq *rq,
+				struct evl_thread *prev,
+				struct evl_thread *next)
+{
+	struct mm_struct *next_mm = next->altsched.active_mm;
+
+	if (next_mm == NULL || next_mm == prev->altsched.active_mm)
+		WRITE_ONCE(rq->mm_lazy, rq->mm_lazy + 1);
+	else
+		WRITE_ONCE(rq->mm_switches, rq->mm_switches + 1);
+}
+
+#else
+
+static inline void account_mm_switch(struct evl_rq *rq,
+				struct evl_thread *prev,
+				struct evl_thread *next)
+{ }
+
+#endif
+
+#ifdef CONFIG_EVL_PREEMPT_DEFER
+
+static uint preempt_defer_arg = 20000;
+module_param_named(preempt_defer, preempt_defer_arg, uint, 0444);
+
+#ifdef CONFIG_EVL_RUNSTATS
+#define account_preempt_deferral(__rq, __counter)			\
+	WRITE_ONCE((__rq)->__counter, (__rq)->__counter + 1)
+#else
+#define account_preempt_deferral(__rq, __counter)	do { } while (0)
+#endif
+
+static void defer_handler(struct evl_timer *timer) /* hard irqs off */
+{
+	struct evl_rq *this_rq = container_of(timer, struct evl_rq, defer_timer);
+
+	raw_spin_lock(&this_rq->lock);
+
+	if (this_rq->local_flags & RQ_PDEFER) {
+		this_rq->local_flags &= ~RQ_PDEFER;
+		this_rq->local_flags |= RQ_PDEXPIRED;
+		account_preempt_deferral(this_rq, defer_expired);
+		evl_set_self_resched(this_rq);
+	}
+
+	raw_spin_unlock(&this_rq->lock);
+}
+
+/* rq->lock held, hard irqs off. */
+static void end_preempt_deferral(struct evl_rq *rq)
+{
+	if (rq->local_flags & RQ_PDEFER)
+		evl_stop_timer(&rq->defer_timer);
+
+	rq->local_flags &= ~(RQ_PDEFER|RQ_PDEXPIRED);
+}
+
+/*
+ * Decide whether the preemption of @curr which is still runnable
+ * should be deferred, as requested from its user window. A single
+ * grace period is granted until @curr is switched out or leaves its
+ * critical section, whichever comes first. rq->lock held, hard irqs
+ * off.
+ */
+static bool defer_preemption(struct evl_rq *rq, struct evl_thread *curr)
+{
+	struct evl_user_window *u_window = curr->u_window;
+
+	if ((curr->state & (EVL_T_USER|EVL_THREAD_BLOCK_BITS|EVL_T_ZOMBIE)) !=
+		EVL_T_USER || u_window == NULL)
+		return false;
+
+	if (!READ_ONCE(u_window->preempt_defer)) {
+		end_preempt_deferral(rq);
+		return false;
+	}
+
+	if (rq->local_flags & RQ_PDEXPIRED)
+		return false;
+
+	if (!(rq->local_flags & RQ_PDEFER)) {
+		if (!preempt_defer_arg)
+			return false;
+		rq->local_flags |= RQ_PDEFER;
+		evl_start_timer(&rq->defer_timer,
+				evl_abs_timeout(&rq->defer_timer,
+						preempt_defer_arg),
+				EVL_INFINITE);
+		WRITE_ONCE(u_window->preempt_yield, 1);
+		account_preempt_deferral(rq, defer_granted);
+	}
+
+	/* Keep the rescheduling request pending. */
+	evl_set_self_resched(rq);
+
+	return true;
+}
+
+#else
+
+static inline void end_preempt_deferral(struct evl_rq *rq)
+{ }
+
+static inline
+bool defer_preemption(struct evl_rq *rq, struct evl_thread *curr)
+{
+	return false;
+}
+
+#endif /* CONFIG_EVL_PREEMPT_DEFER */
+
 static void roundrobin_handler(struct evl_timer *timer) /* hard irqs off */
 {
 	struct evl_rq *this_rq = container_of(timer, struct evl_rq, rrbtimer);
@@ -168,6 +382,8 @@ static void init_rq(struct evl_rq *rq, int cpu)
 
 	rq->flags = 0;
 	rq->local_flags = RQ_IDLE;
+	if (cpumask_test_cpu(cpu, &evl_tickless_cpus))
+		rq->local_flags |= RQ_TICKLESS;
 	rq->curr = &rq->root_thread;
 
 	/*
@@ -181,11 +397,32 @@ static void init_rq(struct evl_rq *rq, int cpu)
 	evl_init_timer_on_rq(&rq->rrbtimer, &evl_mono_clock, roundrobin_handler,
 			rq, EVL_TIMER_IGRAVITY);
 	evl_set_timer_name(&rq->rrbtimer, rq->rrb_timer_name);
+	evl_set_timer_class(&rq->rrbtimer, EVL_TIMER_CLASS_RR);
 #ifdef CONFIG_EVL_WATCHDOG
 	evl_init_timer_on_rq(&rq->wdtimer, &evl_mono_clock, watchdog_handler,
 			rq, EVL_TIMER_IGRAVITY);
 	evl_set_timer_name(&rq->wdtimer, "[watchdog]");
+	evl_set_timer_class(&rq->wdtimer, EVL_TIMER_CLASS_WATCHDOG);
 #endif /* CONFIG_EVL_WATCHDOG */
+#ifdef CONFIG_EVL_THREAD_BUDGET
+	evl_init_timer_on_rq(&rq->budget_timer, &evl_mono_clock, budget_handler,
+			rq, EVL_TIMER_IGRAVITY);
+	evl_set_timer_name(&rq->budget_timer, "[budget]");
+	evl_set_timer_class(&rq->budget_timer, EVL_TIMER_CLASS_BUDGET);
+#endif /* CONFIG_EVL_THREAD_BUDGET */
+#ifdef CONFIG_EVL_PREEMPT_DEFER
+	evl_init_timer_on_rq(&rq->defer_timer, &evl_mono_clock, defer_handler,
+			rq, EVL_TIMER_IGRAVITY);
+	evl_set_timer_name(&rq->defer_timer, "[preempt-defer]");
+#endif /* CONFIG_EVL_PREEMPT_DEFER */
+#ifdef CONFIG_EVL_IDLE_LEAD
+	rq->idle_lead = 0;
+#endif
+#ifdef CONFIG_EVL_SMT_EXCL
+	rq->smt_holding = false;
+	atomic_set(&rq->smt_holds, 0);
+	cpumask_clear(&rq->smt_siblings);
+#endif
 
 	evl_set_current_account(rq, &rq->root_thread.stat.account);
 
@@ -219,6 +456,12 @@ static void destroy_rq(struct evl_rq *rq)
 #ifdef CONFIG_EVL_WATCHDOG
 	evl_destroy_timer(&rq->wdtimer);
 #endif /* CONFIG_EVL_WATCHDOG */
+#ifdef CONFIG_EVL_THREAD_BUDGET
+	evl_destroy_timer(&rq->budget_timer);
+#endif /* CONFIG_EVL_THREAD_BUDGET */
+#ifdef CONFIG_EVL_PREEMPT_DEFER
+	evl_destroy_timer(&rq->defer_timer);
+#endif /* CONFIG_EVL_PREEMPT_DEFER */
 }
 
 #ifdef CONFIG_EVL_DEBUG_CORE
@@ -291,6 +534,7 @@ static void migrate_rq(struct evl_thread *thread, struct evl_rq *dst_rq)
 	 * result of calling the per-class migration hook.
 	 */
 	thread->rq = dst_rq;
+	evl_rseq_set_cpu(thread, evl_rq_cpu(dst_rq));
 
 	if (!(thread->state & EVL_THREAD_BLOCK_BITS)) {
 		evl_requeue_thread(thread);
@@ -403,6 +647,206 @@ static void check_cpu_affinity(struct task_struct *p) /* inband, hard irqs off *
 		evl_adjust_wait_priority(thread);
 }
 
+#if defined(CONFIG_EVL_SCHED_BALANCE) || defined(CONFIG_EVL_SCHED_CAPACITY)
+
+/*
+ * Move the current in-band task to @cpu. CPU migration is an
+ * in-band operation by design; the EVL scheduler state is fixed up
+ * later by check_cpu_affinity() when the transition to the oob
+ * stage completes.
+ */
+static void move_inband_task(int cpu)
+{
+	struct task_struct *p = current;
+	cpumask_var_t saved;
+
+	if (!alloc_cpumask_var(&saved, GFP_KERNEL))
+		return;
+
+	/*
+	 * Pin to the target CPU, which migrates the caller
+	 * immediately, then restore the original affinity, which
+	 * includes that CPU.
+	 */
+	cpumask_copy(saved, p->cpus_ptr);
+	if (!set_cpus_allowed_ptr(p, cpumask_of(cpu)))
+		set_cpus_allowed_ptr(p, saved);
+
+	free_cpumask_var(saved);
+}
+
+/*
+ * Never move a thread involved in a PI chain, this would break the
+ * boost propagation which assumes the owner and its boosters stay
+ * put. Holding a mutex is enough to skip.
+ */
+static inline bool may_move_thread(struct evl_thread *curr)
+{
+	return !(curr->state & EVL_T_BOOST) &&
+		atomic_read(&curr->held_mutex_count) == 0;
+}
+
+#endif
+
+#ifdef CONFIG_EVL_SCHED_CAPACITY
+
+static uint min_capacity_arg;
+module_param_named(min_capacity, min_capacity_arg, uint, 0444);
+
+void evl_init_thread_capacity(struct evl_thread *thread)
+{
+	thread->min_capacity = min_t(uint, min_capacity_arg,
+				SCHED_CAPACITY_SCALE);
+}
+
+/*
+ * Pick the CPU @thread should run on, starting from @cpu. We stay
+ * there if it meets the capacity hint, otherwise we pick the least
+ * capable allowed out-of-band CPU which does, so that the most
+ * capable ones remain available to the most demanding threads. If
+ * none fits, we fall back to the most capable CPU allowed.
+ */
+int evl_select_capacity_cpu(struct evl_thread *thread, int cpu)
+{
+	unsigned long cap, fit_cap = ULONG_MAX, best_cap;
+	int n, fit_cpu = -1, best_cpu = cpu;
+
+	if (evl_cpu_fits(thread, cpu))
+		return cpu;
+
+	best_cap = arch_scale_cpu_capacity(cpu);
+
+	for_each_cpu_and(n, &thread->affinity, &evl_oob_cpus) {
+		if (n == cpu || !cpu_online(n))
+			continue;
+		cap = arch_scale_cpu_capacity(n);
+		if (cap >= thread->min_capacity) {
+			if (cap < fit_cap) {
+				fit_cap = cap;
+				fit_cpu = n;
+			}
+		} else if (cap > best_cap) {
+			best_cap = cap;
+			best_cpu = n;
+		}
+	}
+
+	if (fit_cpu >= 0)
+		best_cpu = fit_cpu;
+
+	if (best_cpu != cpu)
+		trace_evl_thread_place(thread, cpu, best_cpu,
+				thread->min_capacity);
+
+	return best_cpu;
+}
+
+/*
+ * Move @curr to a CPU meeting its capacity hint before it resumes
+ * oob execution, if the current one does not. in-band, on behalf
+ * of @curr.
+ */
+static void place_oob_thread(struct evl_thread *curr)
+{
+	int this_cpu, cpu;
+
+	if (!(curr->state & EVL_T_USER) || curr->min_capacity == 0 ||
+		!may_move_thread(curr))
+		return;
+
+	this_cpu = task_cpu(current);
+	cpu = evl_select_capacity_cpu(curr, this_cpu);
+	if (cpu != this_cpu)
+		move_inband_task(cpu);
+}
+
+#else
+
+static inline void place_oob_thread(struct evl_thread *curr)
+{ }
+
+#endif	/* !CONFIG_EVL_SCHED_CAPACITY */
+
+#ifdef CONFIG_EVL_SCHED_BALANCE
+
+/*
+ * Return the weighted priority of the most urgent work pending on
+ * @rq, -1 if idle. in-band, hard irqs on.
+ */
+static int get_rq_busy_prio(struct evl_rq *rq)
+{
+	unsigned long flags;
+	int wprio, prio;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+
+	wprio = rq->curr->wprio;
+	prio = evl_get_schedq_prio(&rq->fifo.runnable);
+	if (prio >= 0)
+		wprio = max(wprio, evl_calc_weighted_prio(&evl_sched_fifo, prio));
+
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	return wprio;
+}
+
+static int select_oob_cpu(struct evl_thread *curr, int this_cpu)
+{
+	int cpu, best_cpu = this_cpu, prio, best_prio;
+
+	/*
+	 * Stay on the current CPU unless @curr would have to wait
+	 * for it. Otherwise, look for the allowed CPU running the
+	 * least urgent work, cpupri-style. The runqueue states we
+	 * read may be obsolete by the time we use this information,
+	 * this is a best effort placement.
+	 */
+	best_prio = get_rq_busy_prio(evl_cpu_rq(this_cpu));
+	if (best_prio < curr->wprio)
+		return this_cpu;
+
+	for_each_cpu_and(cpu, &curr->affinity, &evl_oob_cpus) {
+		if (cpu == this_cpu || !cpu_online(cpu) ||
+			!evl_cpu_fits(curr, cpu))
+			continue;
+		prio = get_rq_busy_prio(evl_cpu_rq(cpu));
+		if (prio < best_prio) {
+			best_prio = prio;
+			best_cpu = cpu;
+			if (prio < 0) /* idle */
+				break;
+		}
+	}
+
+	return best_prio < curr->wprio ? best_cpu : this_cpu;
+}
+
+/*
+ * Move @curr to the least busy oob CPU it is allowed to run on,
+ * before it resumes oob execution. in-band, on behalf of @curr.
+ */
+static void balance_oob_thread(struct evl_thread *curr)
+{
+	int this_cpu, cpu;
+
+	if (!(curr->state & EVL_T_USER) ||
+		cpumask_weight(&curr->affinity) < 2 ||
+		!may_move_thread(curr))
+		return;
+
+	this_cpu = task_cpu(current);
+	cpu = select_oob_cpu(curr, this_cpu);
+	if (cpu != this_cpu)
+		move_inband_task(cpu);
+}
+
+#else
+
+static inline void balance_oob_thread(struct evl_thread *curr)
+{ }
+
+#endif	/* !CONFIG_EVL_SCHED_BALANCE */
+
 #else
 
 #define evl_double_rq_lock(__rq1, __rq2)  \
@@ -413,6 +857,12 @@ static void check_cpu_affinity(struct task_struct *p) /* inband, hard irqs off *
 static inline void check_cpu_affinity(struct task_struct *p)
 { }
 
+static inline void balance_oob_thread(struct evl_thread *curr)
+{ }
+
+static inline void place_oob_thread(struct evl_thread *curr)
+{ }
+
 #endif	/* CONFIG_SMP */
 
 /* thread->lock + thread->rq->lock held, hard irqs off. */
@@ -706,7 +1156,30 @@ static struct evl_thread *lookup_fifo_class(struct evl_rq *rq)
 	return thread;
 }
 
-#else /* !CONFIG_EVL_SCHED_SCALABLE */
+#elif defined(CONFIG_EVL_SCHED_BITMAP)
+
+static __always_inline
+struct evl_thread *lookup_fifo_class(struct evl_rq *rq)
+{
+	struct evl_sched_queue *q = &rq->fifo.runnable;
+	struct evl_thread *thread;
+	int prio;
+
+	prio = evl_get_schedq_prio(q);
+	if (prio < 0)
+		return NULL;
+
+	/* See comment in the CONFIG_EVL_SCHED_SCALABLE variant. */
+	thread = evl_peek_schedq(q, prio);
+	if (unlikely(thread->sched_class != &evl_sched_fifo))
+		return thread->sched_class->sched_pick(rq);
+
+	evl_del_schedq(q, thread);
+
+	return thread;
+}
+
+#else /* !CONFIG_EVL_SCHED_SCALABLE && !CONFIG_EVL_SCHED_BITMAP */
 
 static __always_inline
 struct evl_thread *lookup_fifo_class(struct evl_rq *rq)
@@ -726,13 +1199,16 @@ struct evl_thread *lookup_fifo_class(struct evl_rq *rq)
 	return thread;
 }
 
-#endif /* CONFIG_EVL_SCHED_SCALABLE */
+#endif /* !CONFIG_EVL_SCHED_SCALABLE && !CONFIG_EVL_SCHED_BITMAP */
 
 static inline void enter_inband(struct evl_thread *root)
 {
 #ifdef CONFIG_EVL_WATCHDOG
 	evl_stop_timer(&evl_thread_rq(root)->wdtimer);
 #endif
+#ifdef CONFIG_EVL_DEFER_INBAND_IPIS
+	smp_unshield_inband_ipis();
+#endif
 }
 
 static inline void leave_inband(struct evl_thread *root)
@@ -743,13 +1219,27 @@ static inline void leave_inband(struct evl_thread *root)
 					get_watchdog_timeout()),
 			EVL_INFINITE);
 #endif
+#ifdef CONFIG_EVL_DEFER_INBAND_IPIS
+	smp_shield_inband_ipis();
+#endif
 }
 
 #ifdef CONFIG_SMP
 /* oob stalled. */
 static irqreturn_t oob_reschedule_interrupt(int irq, void *dev_id)
 {
-	trace_evl_reschedule_ipi(this_evl_rq());
+	struct evl_rq *this_rq = this_evl_rq();
+
+	trace_evl_reschedule_ipi(this_rq);
+
+	/* A sibling may want us to hold this CPU. */
+	evl_kick_smt_idler(this_rq);
+
+	/* Our memory budget may be exhausted. */
+	evl_kick_memguard();
+
+	/* Drain the cross-CPU calls queued to us. */
+	evl_run_smp_calls();
 
 	/* Will reschedule from evl_exit_irq(). */
 
@@ -771,9 +1261,69 @@ static inline void set_next_running(struct evl_rq *rq,
 		evl_stop_timer(&rq->rrbtimer);
 }
 
+/*
+ * Charge the CPU time consumed by the current thread to its CBS
+ * budget if it undergoes the EDF policy.
+ */
+static __always_inline void charge_edf_current(struct evl_rq *rq)
+{
+#ifdef CONFIG_EVL_SCHED_EDF
+	struct evl_thread *curr = rq->curr;
+
+	if (curr->sched_class == &evl_sched_edf &&
+		curr->base_class == &evl_sched_edf)
+		evl_edf_charge_current(rq);
+#endif
+}
+
+/*
+ * Poll the classes below FIFO by decreasing weight (see
+ * register_classes()). The optional ones are called indirectly, only
+ * if they may have work to do on @rq, the weak and idle classes are
+ * open-coded.
+ */
+static __always_inline
+struct evl_thread *lookup_lower_classes(struct evl_rq *rq)
+{
+	struct evl_thread *next;
+
+#ifdef CONFIG_EVL_SCHED_EDF
+	if (!list_empty(&rq->edf.runnable)) {
+		next = evl_sched_edf.sched_pick(rq);
+		if (next)
+			return next;
+	}
+#endif
+#ifdef CONFIG_EVL_SCHED_TP
+	/* No thread is picked unless partitions are scheduled. */
+	if (evl_timer_is_running(&rq->tp.tf_timer)) {
+		next = evl_sched_tp.sched_pick(rq);
+		if (next)
+			return next;
+	}
+#endif
+#ifdef CONFIG_EVL_SCHED_QUOTA
+	/*
+	 * The FIFO runqueue quota threads share is empty at this
+	 * point, we only need the outgoing group to be charged and
+	 * the limit timer to be stopped.
+	 */
+	if (rq->curr->quota || evl_timer_is_running(&rq->quota.limit_timer)) {
+		next = evl_sched_quota.sched_pick(rq);
+		if (next)
+			return next;
+	}
+#endif
+
+	next = __evl_pick_weak_thread(rq);
+	if (next)
+		return next;
+
+	return &rq->root_thread; /* Idle class. */
+}
+
 static struct evl_thread *__pick_next_thread(struct evl_rq *rq)
 {
-	struct evl_sched_class *sched_class;
 	struct evl_thread *curr = rq->curr;
 	struct evl_thread *next;
 
@@ -782,20 +1332,29 @@ static struct evl_thread *__pick_next_thread(struct evl_rq *rq)
 	 * condition is raised for it. Otherwise, check whether
 	 * preemption is allowed.
 	 */
-	if (!(curr->state & (EVL_THREAD_BLOCK_BITS | EVL_T_ZOMBIE))) {
-		if (evl_preempt_count() > 0) {
-			evl_set_self_resched(rq);
-			return curr;
-		}
-		/*
-		 * Push the current thread back to the run queue of
-		 * the scheduling class it belongs to, if not yet
-		 * linked to it (EVL_T_READY tells us if it is).
-		 */
-		if (!(curr->state & EVL_T_READY)) {
-			evl_requeue_thread(curr);
-			curr->state |= EVL_T_READY;
-		}
+	if (!(curr->state & (EVL_THREAD_BLOCK_BITS | EVL_T_ZOMBIE)) &&
+		evl_preempt_count() > 0) {
+		evl_set_self_resched(rq);
+		return curr;
+	}
+
+	if (defer_preemption(rq, curr))
+		return curr;
+
+	/*
+	 * Charge an outgoing EDF thread before it is requeued, since
+	 * this may postpone its deadline.
+	 */
+	charge_edf_current(rq);
+
+	/*
+	 * Push the current thread back to the run queue of the
+	 * scheduling class it belongs to, if still runnable and not
+	 * yet linked to it (EVL_T_READY tells us if it is).
+	 */
+	if (!(curr->state & (EVL_THREAD_BLOCK_BITS | EVL_T_ZOMBIE | EVL_T_READY))) {
+		evl_requeue_thread(curr);
+		curr->state |= EVL_T_READY;
 	}
 
 	/*
@@ -809,13 +1368,7 @@ static struct evl_thread *__pick_next_thread(struct evl_rq *rq)
 	if (likely(next))
 		return next;
 
-	for_each_evl_lower_sched_class(sched_class) {
-		next = sched_class->sched_pick(rq);
-		if (next)
-			return next;
-	}
-
-	return NULL; /* NOT REACHED (idle class). */
+	return lookup_lower_classes(rq);
 }
 
 /* rq->curr->lock + rq->lock held, hard irqs off. */
@@ -856,6 +1409,41 @@ static struct evl_thread *pick_next_thread(struct evl_rq *rq)
 	return next;
 }
 
+#ifdef CONFIG_EVL_DEBUG_SWSTATS
+
+static __always_inline
+void swstat_begin(struct evl_rq *this_rq, enum evl_swstat_kind kind)
+{
+	this_rq->swstats.start[kind] = evl_read_clock(&evl_mono_clock);
+}
+
+static __always_inline
+void swstat_end(struct evl_rq *this_rq, enum evl_swstat_kind kind)
+{
+	unsigned long *hist = this_rq->swstats.hist[kind];
+	ktime_t delta;
+	int bucket = 0;
+
+	delta = ktime_sub(evl_read_clock(&evl_mono_clock),
+			this_rq->swstats.start[kind]);
+	if (delta > 0)
+		bucket = min_t(int, fls64(delta), EVL_SWSTAT_BUCKETS - 1);
+
+	WRITE_ONCE(hist[bucket], hist[bucket] + 1);
+}
+
+#else
+
+static __always_inline
+void swstat_begin(struct evl_rq *this_rq, enum evl_swstat_kind kind)
+{ }
+
+static __always_inline
+void swstat_end(struct evl_rq *this_rq, enum evl_swstat_kind kind)
+{ }
+
+#endif
+
 static __always_inline
 void prepare_rq_switch(struct evl_rq *this_rq,
 		struct evl_thread *prev, struct evl_thread *next)
@@ -868,6 +1456,10 @@ void prepare_rq_switch(struct evl_rq *this_rq,
 #endif
 
 	trace_evl_switch_context(prev, next);
+	evl_account_runlat(&next->stat.runlat);
+	evl_flightrec(EVL_FLTREC_SWITCH, evl_get_inband_pid(prev),
+		evl_get_inband_pid(next), prev->state);
+	swstat_begin(this_rq, EVL_SWSTAT_SWITCH);
 }
 
 static __always_inline
@@ -875,6 +1467,7 @@ void finish_rq_switch(bool inband_tail, unsigned long flags)
 {
 	struct evl_rq *this_rq = this_evl_rq();
 
+	swstat_end(this_rq, EVL_SWSTAT_SWITCH);
 	trace_evl_switch_tail(this_rq->curr);
 
 	EVL_WARN_ON(CORE, this_rq->curr->state & EVL_THREAD_BLOCK_BITS);
@@ -889,9 +1482,11 @@ void finish_rq_switch(bool inband_tail, unsigned long flags)
 	 *                               back from dovetail_context_switch()
 	 */
 	if (likely(!inband_tail)) {
+		evl_switch_resctrl(this_rq->curr);
 		if (irq_pipeline_debug_locking())
 			spin_acquire(&this_rq->lock.rlock.dep_map,
 				0, 0, _THIS_IP_);
+		swstat_end(this_rq, EVL_SWSTAT_IRQOFF);
 		raw_spin_unlock_irqrestore(&this_rq->lock, flags);
 	}
 }
@@ -902,10 +1497,18 @@ static __always_inline void finish_rq_switch_from_inband(void)
 
 	assert_hard_lock(&this_rq->lock);
 
+	/*
+	 * We are completing a switch from the root thread started by
+	 * __evl_schedule(), account for it here.
+	 */
+	swstat_end(this_rq, EVL_SWSTAT_SWITCH);
+	evl_switch_resctrl(this_rq->curr);
+
 	if (irq_pipeline_debug_locking())
 		spin_acquire(&this_rq->lock.rlock.dep_map,
 			0, 0, _THIS_IP_);
 
+	swstat_end(this_rq, EVL_SWSTAT_IRQOFF);
 	raw_spin_unlock_irq(&this_rq->lock);
 }
 
@@ -917,6 +1520,9 @@ static __always_inline bool test_resched(struct evl_rq *this_rq)
 #ifdef CONFIG_SMP
 	/* Send resched IPI to remote CPU(s). */
 	if (unlikely(!cpumask_empty(&this_rq->resched_cpus))) {
+#ifdef CONFIG_EVL_RUNSTATS
+		this_rq->resched_ipis += cpumask_weight(&this_rq->resched_cpus);
+#endif
 		irq_send_oob_ipi(RESCHEDULE_OOB_IPI, &this_rq->resched_cpus);
 		cpumask_clear(&this_rq->resched_cpus);
 		this_rq->local_flags &= ~RQ_SCHED;
@@ -948,6 +1554,7 @@ void __evl_schedule(void) /* oob or/and hard irqs off (CPU migration-safe) */
 	trace_evl_schedule(this_rq);
 
 	flags = hard_local_irq_save();
+	swstat_begin(this_rq, EVL_SWSTAT_IRQOFF);
 
 	/*
 	 * Check whether we have a pending priority ceiling request to
@@ -999,7 +1606,9 @@ void __evl_schedule(void) /* oob or/and hard irqs off (CPU migration-safe) */
 		return;
 	}
 
+	swstat_begin(this_rq, EVL_SWSTAT_PICK);
 	next = pick_next_thread(this_rq);
+	swstat_end(this_rq, EVL_SWSTAT_PICK);
 	trace_evl_pick_thread(next);
 	if (next == curr) {
 		if (unlikely(next->state & EVL_T_ROOT)) {
@@ -1017,6 +1626,9 @@ void __evl_schedule(void) /* oob or/and hard irqs off (CPU migration-safe) */
 	this_rq->curr = next;
 	leaving_inband = false;
 
+	if (this_rq->local_flags & (RQ_PDEFER|RQ_PDEXPIRED))
+		end_preempt_deferral(this_rq);
+
 	if (prev->state & EVL_T_ROOT) {
 		leave_inband(prev);
 		leaving_inband = true;
@@ -1028,10 +1640,17 @@ void __evl_schedule(void) /* oob or/and hard irqs off (CPU migration-safe) */
 		enter_inband(next);
 	}
 
+	evl_switch_budget(this_rq, next);
+	evl_switch_smt(this_rq, next);
+	evl_switch_freq(this_rq, next);
 	evl_switch_account(this_rq, &next->stat.account);
+	evl_pmu_switch(this_rq, prev);
 	evl_inc_counter(&next->stat.csw);
+	evl_update_statslot(prev);
+	evl_rseq_preempt(prev);
 	raw_spin_unlock(&prev->lock);
 
+	account_mm_switch(this_rq, prev, next);
 	prepare_rq_switch(this_rq, prev, next);
 	inband_tail = dovetail_context_switch(&prev->altsched,
 					&next->altsched, leaving_inband);
@@ -1106,6 +1725,9 @@ int evl_switch_oob(void)
 
 	trace_evl_switch_oob(curr);
 
+	place_oob_thread(curr);
+	balance_oob_thread(curr);
+
 	evl_clear_sync_uwindow(curr, EVL_T_INBAND);
 
 	ret = dovetail_leave_inband();
@@ -1258,6 +1880,8 @@ void evl_switch_inband_details(int cause, union evl_value details)
 	evl_propagate_schedparam_change(curr);
 
 	if (notify) {
+		evl_log_inband_switch(curr, cause, details);
+
 		/*
 		 * Help debugging spurious stage switches by sending
 		 * an HM event.
@@ -1339,6 +1963,22 @@ evl_find_sched_class(union evl_sched_param *param,
 		break;
 #else
 		return ERR_PTR(-EOPNOTSUPP);
+#endif
+	case SCHED_EDF:
+#ifdef CONFIG_EVL_SCHED_EDF
+		if (prio)
+			return ERR_PTR(-EINVAL);
+		param->edf.prio = EVL_EDF_PRIO;
+		param->edf.runtime = u_timespec_to_ktime(attrs->sched_edf_runtime);
+		param->edf.period = u_timespec_to_ktime(attrs->sched_edf_period);
+		param->edf.deadline = u_timespec_to_ktime(attrs->sched_edf_deadline);
+		if (param->edf.deadline == 0)
+			param->edf.deadline = param->edf.period;
+		param->edf.abs_deadline = 0;
+		sched_class = &evl_sched_edf;
+		break;
+#else
+		return ERR_PTR(-EOPNOTSUPP);
 #endif
 	default:
 		return ERR_PTR(-EINVAL);
@@ -1366,6 +2006,13 @@ notrace const char *evl_trace_sched_attrs(struct trace_seq *p,
 		trace_seq_printf(p, "priority=%d, partition=%d",
 				attrs->sched_priority,
 				attrs->sched_tp_partition);
+		break;
+	case SCHED_EDF:
+		trace_seq_printf(p, "runtime=%Ld, period=%Ld, deadline=%Ld",
+				ktime_to_ns(u_timespec_to_ktime(attrs->sched_edf_runtime)),
+				ktime_to_ns(u_timespec_to_ktime(attrs->sched_edf_period)),
+				ktime_to_ns(u_timespec_to_ktime(attrs->sched_edf_deadline)));
+		break;
 	case SCHED_NORMAL:
 		break;
 	case SCHED_RR:
@@ -1382,18 +2029,72 @@ notrace const char *evl_trace_sched_attrs(struct trace_seq *p,
 
 #endif /* CONFIG_TRACING */
 
+#ifdef CONFIG_EVL_IDLE_LEAD
+
+/*
+ * Allow @state only if the CPU can leave it before the next EVL
+ * timer is due, in which case the next shot is programmed earlier
+ * by the exit latency, so that the wakeup does not delay the
+ * timer. The next tick clears this anticipation.
+ */
+static bool allow_idle_state(struct cpuidle_state *state)
+{
+	struct evl_rq *this_rq = this_evl_rq();
+	struct evl_timerbase *tmb;
+	struct evl_timer *timer;
+	struct evl_tnode *tn;
+	bool ret = true;
+	ktime_t lead;
+
+	if (!is_evl_cpu(evl_rq_cpu(this_rq)) || state->exit_latency_ns == 0)
+		return true;
+
+	lead = ns_to_ktime(state->exit_latency_ns);
+	tmb = evl_this_cpu_timers(&evl_mono_clock);
+
+	raw_spin_lock(&tmb->lock);
+
+	tn = evl_get_tqueue_head(&tmb->q);
+	if (tn) {
+		timer = container_of(tn, struct evl_timer, node);
+		if (ktime_sub(evl_tdate(timer),
+				evl_read_clock(&evl_mono_clock)) <= lead) {
+			ret = false;
+		} else {
+			this_rq->idle_lead = lead;
+			evl_program_local_tick(&evl_mono_clock);
+		}
+	}
+
+	raw_spin_unlock(&tmb->lock);
+
+	return ret;
+}
+
+#else
+
+static inline bool allow_idle_state(struct cpuidle_state *state)
+{
+	return true;
+}
+
+#endif
+
 /* in-band stage, hard_irqs_disabled() */
 bool irq_cpuidle_control(struct cpuidle_device *dev,
 			struct cpuidle_state *state)
 {
+	if (state == NULL)
+		return true;
+
 	/*
 	 * Deny entering sleep state if this entails stopping the
 	 * timer (i.e. C3STOP misfeature).
 	 */
-	if (state && (state->flags & CPUIDLE_FLAG_TIMER_STOP))
+	if (state->flags & CPUIDLE_FLAG_TIMER_STOP)
 		return false;
 
-	return true;
+	return allow_idle_state(state);
 }
 
 int __init evl_init_sched(void)
@@ -0,0 +1,370 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/math64.h>
+#include <evl/sched.h>
+#include <evl/clock.h>
+#include <uapi/evl/sched-abi.h>
+
+/*
+ * With this policy, each thread is given a runtime budget to consume
+ * over a replenishment period, and a relative deadline by which that
+ * runtime should be consumed. The per-CPU runqueue is ordered by
+ * increasing absolute deadline, the thread with the earliest one
+ * being picked first (EDF).
+ *
+ * Each thread is served by a constant bandwidth server (CBS) which
+ * enforces its reservation:
+ *
+ * - the time consumed by the current thread is charged to its budget
+ * each time the core picks the next thread to run (see
+ * evl_edf_charge_current()). A per-CPU timer
+ * (evl_sched_edf->budget_timer) is armed to elapse when the budget
+ * of the incoming thread would be exhausted, forcing a rescheduling.
+ *
+ * - when the budget is exhausted, it is immediately replenished and
+ * the absolute deadline is postponed by one period. The thread
+ * remains runnable, but competes with a later deadline, which
+ * prevents it from exceeding its bandwidth at the expense of other
+ * EDF threads.
+ *
+ * - when a thread wakes up, it keeps the current deadline and budget
+ * only if consuming that budget by the deadline would not exceed its
+ * bandwidth. Otherwise, a new deadline is computed from the wakeup
+ * time, with a full budget.
+ *
+ * The sum of the bandwidths of all EDF threads attached to a
+ * runqueue is bounded by 100%, so that no deadline can be missed as
+ * long as threads from higher classes (i.e. SCHED_FIFO) do not
+ * consume the CPU.
+ *
+ * NOTE: EDF threads share a single priority level, therefore PI
+ * boosting applies between EDF threads and threads from other
+ * classes, but not among EDF threads. A thread boosted into the EDF
+ * class inherits the absolute deadline of its waiter, and is not
+ * charged any budget while the boost undergoes.
+ */
+
+static inline u64 edf_bandwidth(ktime_t runtime, ktime_t period)
+{
+	return div64_u64((u64)runtime << EVL_EDF_BW_SHIFT, period);
+}
+
+static void enqueue_by_deadline(struct evl_thread *thread, bool lifo)
+{
+	struct list_head *head = &thread->rq->edf.runnable;
+
+	/*
+	 * FIFO ordering among threads with the same deadline for
+	 * regular enqueuing, LIFO for requeuing a preempted thread.
+	 */
+	if (lifo)
+		__list_add_pri(thread, head, edf.abs_deadline, rq_next, >);
+	else
+		__list_add_pri(thread, head, edf.abs_deadline, rq_next, >=);
+}
+
+static void edf_budget_handler(struct evl_timer *timer) /* oob stage stalled */
+{
+	struct evl_rq *rq;
+
+	rq = container_of(timer, struct evl_rq, edf.budget_timer);
+	/*
+	 * Force a rescheduling on the return path of the current
+	 * interrupt, so that the exhausted budget is charged in
+	 * evl_edf_charge_current().
+	 */
+	raw_spin_lock(&rq->lock);
+	evl_set_self_resched(rq);
+	raw_spin_unlock(&rq->lock);
+}
+
+/* rq->curr->lock + rq->lock held, hard irqs off. */
+void evl_edf_charge_current(struct evl_rq *rq)
+{
+	struct evl_thread *curr = rq->curr;
+	ktime_t now, elapsed;
+	bool queued;
+	u64 n;
+
+	assert_hard_lock(&rq->lock);
+
+	evl_stop_timer(&rq->edf.budget_timer);
+
+	now = evl_read_clock(&evl_mono_clock);
+	elapsed = ktime_sub(now, curr->edf.run_start);
+	curr->edf.run_start = now;
+	curr->edf.budget = ktime_sub(curr->edf.budget, elapsed);
+	if (curr->edf.budget > 0)
+		return;
+
+	/*
+	 * Budget exhausted: replenish and postpone the deadline
+	 * accordingly (CBS rule). We might have overrun by more than
+	 * a full runtime if interrupts were delayed for some reason,
+	 * catch up if so.
+	 */
+	queued = curr->state & EVL_T_READY;
+	if (queued)
+		list_del(&curr->rq_next);
+
+	n = div64_u64(-curr->edf.budget, curr->edf.runtime) + 1;
+	curr->edf.abs_deadline = ktime_add(curr->edf.abs_deadline,
+					n * curr->edf.period);
+	curr->edf.budget = ktime_add(curr->edf.budget,
+				n * curr->edf.runtime);
+
+	curr->edf.nr_postponed++;
+
+	if (queued)
+		enqueue_by_deadline(curr, false);
+}
+
+static void edf_update_on_wakeup(struct evl_thread *thread)
+{
+	ktime_t now, laxity;
+	u64 budget_max;
+
+	now = evl_read_clock(&evl_mono_clock);
+	laxity = ktime_sub(thread->edf.abs_deadline, now);
+
+	/*
+	 * Keep the current (deadline, budget) pair only if the
+	 * remaining budget fits in the bandwidth share available
+	 * until the deadline, otherwise start a new server period.
+	 */
+	if (laxity > 0) {
+		budget_max = ((u64)laxity * thread->edf.bw) >> EVL_EDF_BW_SHIFT;
+		if ((u64)thread->edf.budget <= budget_max)
+			return;
+	}
+
+	thread->edf.abs_deadline = ktime_add(now, thread->edf.deadline);
+	thread->edf.budget = thread->edf.runtime;
+}
+
+static void edf_init(struct evl_rq *rq)
+{
+	struct evl_sched_edf *edf = &rq->edf;
+
+	INIT_LIST_HEAD(&edf->runnable);
+	edf->total_bw = 0;
+	evl_init_timer_on_rq(&edf->budget_timer, &evl_mono_clock,
+			edf_budget_handler, rq, EVL_TIMER_IGRAVITY);
+	evl_set_timer_name(&edf->budget_timer, "[edf-budget]");
+}
+
+static void edf_enqueue(struct evl_thread *thread)
+{
+	/*
+	 * Apply the CBS wakeup rule to threads which are resuming,
+	 * the current thread is merely put back into the runqueue.
+	 */
+	if (thread->base_class == &evl_sched_edf && thread != thread->rq->curr)
+		edf_update_on_wakeup(thread);
+
+	enqueue_by_deadline(thread, false);
+}
+
+static void edf_dequeue(struct evl_thread *thread)
+{
+	list_del(&thread->rq_next);
+}
+
+static void edf_requeue(struct evl_thread *thread)
+{
+	enqueue_by_deadline(thread, true);
+}
+
+static struct evl_thread *edf_pick(struct evl_rq *rq)
+{
+	struct evl_sched_edf *edf = &rq->edf;
+	struct evl_thread *next;
+	ktime_t now;
+
+	if (list_empty(&edf->runnable))
+		return NULL;
+
+	next = list_get_entry(&edf->runnable, struct evl_thread, rq_next);
+
+	/* Threads boosted into this class have no budget to enforce. */
+	if (next->base_class != &evl_sched_edf)
+		return next;
+
+	now = evl_read_clock(&evl_mono_clock);
+	next->edf.run_start = now;
+	evl_start_timer(&edf->budget_timer,
+			ktime_add(now, next->edf.budget),
+			EVL_INFINITE);
+
+	return next;
+}
+
+static void edf_yield(struct evl_thread *thread)
+{
+	/*
+	 * Yielding gives up the remaining budget for the current
+	 * server period, the deadline is postponed next time the
+	 * budget is charged.
+	 */
+	thread->edf.budget = 0;
+	evl_putback_thread(thread);
+}
+
+static int edf_chkparam(struct evl_thread *thread,
+			const union evl_sched_param *p)
+{
+	struct evl_sched_edf *edf = &thread->rq->edf;
+	u64 bw, total_bw;
+
+	if (p->edf.prio != EVL_EDF_PRIO)
+		return -EINVAL;
+
+	if (p->edf.runtime <= 0 || p->edf.period <= 0 ||
+		p->edf.runtime > p->edf.deadline ||
+		p->edf.deadline > p->edf.period)
+		return -EINVAL;
+
+	if (p->edf.runtime < evl_get_clock_gravity(&evl_mono_clock, user))
+		return -EINVAL;
+
+	/*
+	 * Admission control: the overall bandwidth reserved on the
+	 * runqueue may not exceed 100%.
+	 */
+	bw = edf_bandwidth(p->edf.runtime, p->edf.period);
+	total_bw = edf->total_bw;
+	if (thread->edf.bw_rq == thread->rq)
+		total_bw -= thread->edf.bw;
+
+	if (total_bw + bw > EVL_EDF_BW_UNIT)
+		return -EBUSY;
+
+	return 0;
+}
+
+static void release_bandwidth(struct evl_thread *thread)
+{
+	if (thread->edf.bw_rq) {
+		thread->edf.bw_rq->edf.total_bw -= thread->edf.bw;
+		thread->edf.bw_rq = NULL;
+		thread->edf.bw = 0;
+	}
+}
+
+static bool edf_setparam(struct evl_thread *thread,
+			const union evl_sched_param *p)
+{
+	struct evl_rq *rq = thread->rq;
+	ktime_t now;
+
+	thread->state &= ~EVL_T_WEAK;
+
+	release_bandwidth(thread);
+	thread->edf.bw = edf_bandwidth(p->edf.runtime, p->edf.period);
+	thread->edf.bw_rq = rq;
+	rq->edf.total_bw += thread->edf.bw;
+
+	thread->edf.runtime = p->edf.runtime;
+	thread->edf.period = p->edf.period;
+	thread->edf.deadline = p->edf.deadline;
+
+	/* Start a new server period with a full budget. */
+	now = evl_read_clock(&evl_mono_clock);
+	thread->edf.abs_deadline = ktime_add(now, p->edf.deadline);
+	thread->edf.budget = p->edf.runtime;
+	thread->edf.run_start = now;
+
+	return evl_set_effective_thread_priority(thread, p->edf.prio);
+}
+
+static void edf_getparam(struct evl_thread *thread,
+			union evl_sched_param *p)
+{
+	p->edf.prio = thread->cprio;
+	p->edf.runtime = thread->edf.runtime;
+	p->edf.period = thread->edf.period;
+	p->edf.deadline = thread->edf.deadline;
+	p->edf.abs_deadline = thread->edf.abs_deadline;
+}
+
+static void edf_trackprio(struct evl_thread *thread,
+			const union evl_sched_param *p)
+{
+	if (p) {
+		thread->cprio = p->edf.prio;
+		/*
+		 * A thread from a lower class which is boosted by an
+		 * EDF waiter runs by the deadline of the latter.
+		 */
+		if (thread->base_class != &evl_sched_edf)
+			thread->edf.abs_deadline = p->edf.abs_deadline;
+	} else {
+		thread->cprio = thread->bprio;
+	}
+}
+
+static void edf_ceilprio(struct evl_thread *thread, int prio)
+{
+	/* PP boosts always move threads to the FIFO class. */
+	EVL_WARN_ON_ONCE(CORE, 1);
+}
+
+static void edf_forget(struct evl_thread *thread)
+{
+	release_bandwidth(thread);
+}
+
+static void edf_migrate(struct evl_thread *thread, struct evl_rq *rq)
+{
+	/*
+	 * Both runqueues are locked by our caller. Move the
+	 * bandwidth reservation along with the thread. Since
+	 * migration is decided in-band, we cannot fail it, so the
+	 * remote runqueue might be overcommitted until the thread
+	 * moves back or leaves the EDF class.
+	 */
+	if (thread->edf.bw_rq) {
+		thread->edf.bw_rq->edf.total_bw -= thread->edf.bw;
+		rq->edf.total_bw += thread->edf.bw;
+		thread->edf.bw_rq = rq;
+	}
+}
+
+static const char *edf_name(struct evl_thread *thread)
+{
+	return "edf";
+}
+
+static ssize_t edf_show(struct evl_thread *thread,
+			char *buf, ssize_t count)
+{
+	return snprintf(buf, count, "%Ld %Ld %Ld %lu\n",
+			ktime_to_ns(thread->edf.runtime),
+			ktime_to_ns(thread->edf.period),
+			ktime_to_ns(thread->edf.deadline),
+			thread->edf.nr_postponed);
+}
+
+struct evl_sched_class evl_sched_edf = {
+	.sched_init		=	edf_init,
+	.sched_enqueue		=	edf_enqueue,
+	.sched_dequeue		=	edf_dequeue,
+	.sched_requeue		=	edf_requeue,
+	.sched_pick		=	edf_pick,
+	.sched_yield		=	edf_yield,
+	.sched_migrate		=	edf_migrate,
+	.sched_chkparam		=	edf_chkparam,
+	.sched_setparam		=	edf_setparam,
+	.sched_getparam		=	edf_getparam,
+	.sched_trackprio	=	edf_trackprio,
+	.sched_ceilprio		=	edf_ceilprio,
+	.sched_forget		=	edf_forget,
+	.sched_name		=	edf_name,
+	.sched_show		=	edf_show,
+	.weight			=	EVL_CLASS_WEIGHT(4),
+	.policy			=	SCHED_EDF,
+	.name			=	"edf"
+};
+EXPORT_SYMBOL_GPL(evl_sched_edf);
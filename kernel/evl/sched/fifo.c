@@ -74,7 +74,7 @@ struct evl_sched_class evl_sched_fifo = {
 	.sched_getparam		=	evl_fifo_getparam,
 	.sched_name		=	evl_fifo_name,
 	.sched_show		=	evl_fifo_show,
-	.weight			=	EVL_CLASS_WEIGHT(4),
+	.weight			=	EVL_CLASS_WEIGHT(5),
 	.policy			=	SCHED_FIFO,
 	.name			=	"fifo"
 };
@@ -0,0 +1,237 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/cpufreq.h>
+#include <linux/pm_qos.h>
+#include <evl/control.h>
+#include <evl/sched.h>
+#include <evl/work.h>
+
+/*
+ * Frequency locking. The first switch to an out-of-band thread on
+ * an EVL CPU pins the frequency of its cpufreq policy to a fixed
+ * level, by adding a min and a max QoS request, which every cpufreq
+ * driver honors (intel_pstate, cpufreq-dt etc). The lock is dropped
+ * once no out-of-band thread has run there for evl.freq_hold_ms,
+ * so that periodic threads sleeping between releases do not cause
+ * a transition on each period.
+ *
+ * QoS requests may only be updated in-band, the lock is relayed
+ * via an evl_work. Since policies may span several CPUs, locking
+ * one of them holds the frequency of its siblings too.
+ */
+
+static uint freq_lock_khz_arg;	/* 0 = highest frequency of the policy */
+module_param_named(freq_lock_khz, freq_lock_khz_arg, uint, 0444);
+
+static uint freq_hold_ms_arg = 1000;
+module_param_named(freq_hold_ms, freq_hold_ms_arg, uint, 0444);
+
+struct evl_freqlock {
+	struct mutex lock;
+	struct cpufreq_policy *policy;
+	struct freq_qos_request min_req;
+	struct freq_qos_request max_req;
+	struct evl_work lock_work;
+	struct delayed_work release_work;
+	int cpu;
+};
+
+static DEFINE_PER_CPU(struct evl_freqlock, freqlocks);
+
+static bool freqlock_ready;
+
+static void set_level(struct evl_freqlock *fl, bool locked) /* fl->lock held */
+{
+	s32 level;
+
+	if (fl->policy == NULL)
+		return;
+
+	/* Keep min <= max all along. */
+	if (locked) {
+		level = freq_lock_khz_arg ?: fl->policy->cpuinfo.max_freq;
+		freq_qos_update_request(&fl->max_req, level);
+		freq_qos_update_request(&fl->min_req, level);
+	} else {
+		freq_qos_update_request(&fl->min_req, FREQ_QOS_MIN_DEFAULT_VALUE);
+		freq_qos_update_request(&fl->max_req, FREQ_QOS_MAX_DEFAULT_VALUE);
+	}
+}
+
+static void do_lock(struct evl_work *work) /* in-band */
+{
+	struct evl_freqlock *fl = container_of(work, struct evl_freqlock, lock_work);
+	struct evl_rq *rq = evl_cpu_rq(fl->cpu);
+
+	mutex_lock(&fl->lock);
+
+	if (READ_ONCE(rq->freq_locked)) {
+		set_level(fl, true);
+		schedule_delayed_work(&fl->release_work,
+				msecs_to_jiffies(freq_hold_ms_arg));
+	}
+
+	mutex_unlock(&fl->lock);
+}
+
+static void do_release(struct work_struct *work) /* in-band */
+{
+	struct evl_freqlock *fl = container_of(to_delayed_work(work),
+					struct evl_freqlock, release_work);
+	unsigned long hold = msecs_to_jiffies(freq_hold_ms_arg);
+	struct evl_rq *rq = evl_cpu_rq(fl->cpu);
+
+	mutex_lock(&fl->lock);
+
+	if (time_before(jiffies, READ_ONCE(rq->freq_activity) + hold))
+		goto recheck;
+
+	/*
+	 * Clear the lock state before reading the activity date
+	 * again. At worst, a thread which ran meanwhile without
+	 * seeing the update goes unlocked until the next switch.
+	 */
+	WRITE_ONCE(rq->freq_locked, false);
+	smp_mb();
+	if (time_before(jiffies, READ_ONCE(rq->freq_activity) + hold)) {
+		WRITE_ONCE(rq->freq_locked, true);
+		goto recheck;
+	}
+
+	set_level(fl, false);
+	mutex_unlock(&fl->lock);
+
+	return;
+recheck:
+	schedule_delayed_work(&fl->release_work, hold);
+	mutex_unlock(&fl->lock);
+}
+
+/* rq->lock held, hard irqs off. */
+void __evl_lock_freq(struct evl_rq *rq)
+{
+	/* Threads may run before we are set up, retry next time. */
+	if (!READ_ONCE(freqlock_ready) || !is_evl_cpu(evl_rq_cpu(rq)))
+		return;
+
+	WRITE_ONCE(rq->freq_locked, true);
+	evl_call_inband(&per_cpu(freqlocks, evl_rq_cpu(rq)).lock_work);
+}
+
+static void attach_policy(struct cpufreq_policy *policy, int cpu)
+{
+	struct evl_freqlock *fl = per_cpu_ptr(&freqlocks, cpu);
+	int ret;
+
+	mutex_lock(&fl->lock);
+
+	if (fl->policy)
+		goto out;
+
+	ret = freq_qos_add_request(&policy->constraints, &fl->min_req,
+				FREQ_QOS_MIN, FREQ_QOS_MIN_DEFAULT_VALUE);
+	if (ret < 0)
+		goto fail;
+
+	ret = freq_qos_add_request(&policy->constraints, &fl->max_req,
+				FREQ_QOS_MAX, FREQ_QOS_MAX_DEFAULT_VALUE);
+	if (ret < 0) {
+		freq_qos_remove_request(&fl->min_req);
+		goto fail;
+	}
+
+	fl->policy = policy;
+	if (READ_ONCE(evl_cpu_rq(cpu)->freq_locked))
+		set_level(fl, true);
+out:
+	mutex_unlock(&fl->lock);
+
+	return;
+fail:
+	mutex_unlock(&fl->lock);
+	printk(EVL_WARNING "cannot lock frequency of CPU%d (%d)\n", cpu, ret);
+}
+
+static void detach_policy(int cpu)
+{
+	struct evl_freqlock *fl = per_cpu_ptr(&freqlocks, cpu);
+
+	mutex_lock(&fl->lock);
+
+	if (fl->policy) {
+		freq_qos_remove_request(&fl->max_req);
+		freq_qos_remove_request(&fl->min_req);
+		fl->policy = NULL;
+	}
+
+	mutex_unlock(&fl->lock);
+}
+
+static int freq_policy_notifier(struct notifier_block *nb,
+				unsigned long event, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	int cpu;
+
+	for_each_cpu_and(cpu, policy->related_cpus, &evl_oob_cpus) {
+		if (event == CPUFREQ_CREATE_POLICY)
+			attach_policy(policy, cpu);
+		else if (event == CPUFREQ_REMOVE_POLICY)
+			detach_policy(cpu);
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block freq_policy_nb = {
+	.notifier_call = freq_policy_notifier,
+};
+
+static int __init evl_init_freqlock(void)
+{
+	struct cpufreq_policy *policy;
+	struct evl_freqlock *fl;
+	int cpu, ret;
+
+	if (!evl_is_enabled())
+		return 0;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		fl = per_cpu_ptr(&freqlocks, cpu);
+		mutex_init(&fl->lock);
+		evl_init_work(&fl->lock_work, do_lock);
+		INIT_DELAYED_WORK(&fl->release_work, do_release);
+		fl->cpu = cpu;
+	}
+
+	smp_wmb();
+	WRITE_ONCE(freqlock_ready, true);
+
+	/* Catch the policies created past this point... */
+	ret = cpufreq_register_notifier(&freq_policy_nb,
+					CPUFREQ_POLICY_NOTIFIER);
+	if (ret) {
+		printk(EVL_WARNING "cannot monitor cpufreq policies (%d)\n", ret);
+		return 0;
+	}
+
+	/* ...and those which already exist. */
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		policy = cpufreq_cpu_get(cpu);
+		if (policy) {
+			attach_policy(policy, cpu);
+			cpufreq_cpu_put(policy);
+		}
+	}
+
+	return 0;
+}
+late_initcall(evl_init_freqlock);
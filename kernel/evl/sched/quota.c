@@ -6,6 +6,7 @@
  */
 
 #include <linux/bitmap.h>
+#include <linux/math64.h>
 #include <asm/div64.h>
 #include <evl/sched.h>
 #include <evl/memory.h>
@@ -51,6 +52,21 @@
  * budget - are still seen as runnable (i.e. not blocked/suspended) by
  * the EVL core. This only means that the SCHED_QUOTA policy won't
  * pick them until the corresponding budget is replenished.
+ *
+ * Groups may be nested on a runqueue: the run time consumed by a
+ * thread is charged to its group and to every ancestor of that
+ * group, and a thread may run only as long as none of these groups
+ * has exhausted its budget. This way, the budget of a parent group
+ * caps the aggregated consumption of its children, and a child
+ * group which is allotted the same share as its parent simply
+ * competes with its siblings for the parent budget. A child group
+ * inherits the limits of its parent when created, and may not be
+ * given a larger share afterwards.
+ *
+ * A top-level group may also run in adaptive mode, in which case its
+ * budget is adjusted at every refill from the consumption and the
+ * throttling events observed over the last period, within bounds set
+ * by the user (see adapt_budgets()).
  */
 
 #define MAX_QUOTA_GROUPS  1024
@@ -61,17 +77,78 @@ static DECLARE_BITMAP(group_map, MAX_QUOTA_GROUPS);
 
 static LIST_HEAD(group_list);
 
+static inline bool group_in_subtree(struct evl_quota_group *tg,
+				struct evl_quota_group *root)
+{
+	for (; tg; tg = tg->parent) {
+		if (tg == root)
+			return true;
+	}
+
+	return false;
+}
+
 static inline bool thread_on_quota(struct evl_thread *thread,
 				struct evl_quota_group *tg)
 {
 	/*
 	 * Check whether @thread is running on some CPU, and belongs
-	 * to quota group @tg.
+	 * to quota group @tg or any of its children.
 	 */
-	return thread->quota == tg &&
+	return group_in_subtree(thread->quota, tg) &&
 		!(thread->state & (EVL_T_READY|EVL_THREAD_BLOCK_BITS));
 }
 
+/* A group may run only if no group up its hierarchy is depleted. */
+static inline bool group_has_budget(struct evl_quota_group *tg)
+{
+	for (; tg; tg = tg->parent) {
+		if (tg->run_budget == 0)
+			return false;
+	}
+
+	return true;
+}
+
+static ktime_t group_budget(struct evl_quota_group *tg)
+{
+	ktime_t budget = tg->run_budget;
+
+	while ((tg = tg->parent) != NULL)
+		budget = min(budget, tg->run_budget);
+
+	return budget;
+}
+
+static void charge_group(struct evl_quota_group *tg, ktime_t now)
+{
+	ktime_t elapsed = ktime_sub(now, tg->run_start);
+
+	tg->run_start = now;
+
+	for (; tg; tg = tg->parent) {
+		tg->run_time = ktime_add(tg->run_time, elapsed);
+		if (elapsed < tg->run_budget) {
+			tg->run_budget = ktime_sub(tg->run_budget, elapsed);
+		} else if (tg->run_budget > 0) {
+			tg->run_budget = 0;
+			tg->nr_throttled++;
+		}
+	}
+}
+
+static inline void inc_active(struct evl_quota_group *tg)
+{
+	for (; tg; tg = tg->parent)
+		tg->nr_active++;
+}
+
+static inline void dec_active(struct evl_quota_group *tg)
+{
+	for (; tg; tg = tg->parent)
+		tg->nr_active--;
+}
+
 static inline bool group_is_active(struct evl_quota_group *tg)
 {
 	if (tg->nr_active)
@@ -148,10 +225,127 @@ static inline void replenish_budget(struct evl_sched_quota *qs,
 		tg->run_budget = budget;
 }
 
+static void release_expired(struct evl_rq *rq, struct evl_quota_group *tg)
+{
+	struct evl_thread *thread, *tmp;
+
+	if (list_empty(&tg->expired) || !group_has_budget(tg))
+		return;
+
+	/*
+	 * Move all expired threads back to the runqueue. Since those
+	 * threads were moved out of the runqueue as we were
+	 * considering them for execution, we push them back in LIFO
+	 * order to their respective priority group. The expiry queue
+	 * is FIFO to keep ordering right among expired threads.
+	 */
+	list_for_each_entry_safe_reverse(thread, tmp,
+					&tg->expired, quota_expired) {
+		list_del_init(&thread->quota_expired);
+		evl_add_schedq(&rq->fifo.runnable, thread);
+	}
+}
+
+static inline ktime_t percent_of_period(struct evl_sched_quota *qs,
+					int percent)
+{
+	u64 n = qs->period * percent;
+
+	do_div(n, 100);
+
+	return n;
+}
+
+static void set_adapted_quota(struct evl_sched_quota *qs,
+			struct evl_quota_group *tg, ktime_t quota)
+{
+	tg->quota = quota;
+	/* No credit accumulation, which would fight the adaptation. */
+	tg->quota_peak = quota;
+	tg->quota_percent = div64_u64((u64)quota * 100, qs->period);
+	tg->quota_peak_percent = tg->quota_percent;
+}
+
+/*
+ * Adjust the budget of the adaptive groups for the next period. A
+ * group which got throttled asks for a quarter more, a group which
+ * left more than half of its budget unused asks for its consumption
+ * plus a quarter of headroom, each demand being kept within the
+ * [min, max] bounds of the group.
+ *
+ * The adaptive groups share the CPU time the static top-level groups
+ * leave available. If their demands exceed it, every group keeps its
+ * minimum and the rest is split in proportion of the extra time each
+ * group asked for. Otherwise, the spare time is redistributed evenly
+ * to the throttled groups, up to their maximum.
+ */
+static void adapt_budgets(struct evl_sched_quota *qs)
+{
+	ktime_t capacity = qs->period, demand_sum = 0, min_sum = 0;
+	ktime_t used, want, extra, spare = 0;
+	struct evl_quota_group *tg;
+	int nr_busy = 0;
+
+	list_for_each_entry(tg, &qs->groups, next) {
+		if (tg->parent)
+			continue;
+
+		if (!tg->adaptive) {
+			capacity = ktime_sub(capacity, min(capacity, tg->quota));
+			continue;
+		}
+
+		used = ktime_sub(tg->run_time, tg->adapt_run_time);
+		tg->adapt_run_time = tg->run_time;
+		tg->adapt_busy = tg->nr_throttled != tg->adapt_throttled;
+		tg->adapt_throttled = tg->nr_throttled;
+
+		want = tg->quota;
+		if (tg->adapt_busy)
+			want = ktime_add(want, max(want / 4, qs->period / 100));
+		else if (used < want / 2)
+			want = ktime_add(used, used / 4);
+
+		want = clamp(want, tg->quota_min, tg->quota_max);
+		tg->adapt_demand = want;
+		demand_sum = ktime_add(demand_sum, want);
+		min_sum = ktime_add(min_sum, tg->quota_min);
+		if (tg->adapt_busy)
+			nr_busy++;
+	}
+
+	if (demand_sum > capacity) {
+		extra = capacity > min_sum ? ktime_sub(capacity, min_sum) : 0;
+		list_for_each_entry(tg, &qs->groups, next) {
+			if (tg->parent || !tg->adaptive)
+				continue;
+			want = tg->quota_min;
+			if (extra && demand_sum > min_sum)
+				want = ktime_add(want,
+					mul_u64_u64_div_u64(extra,
+						tg->adapt_demand - tg->quota_min,
+						demand_sum - min_sum));
+			set_adapted_quota(qs, tg, want);
+		}
+		return;
+	}
+
+	if (nr_busy)
+		spare = div64_u64(ktime_sub(capacity, demand_sum), nr_busy);
+
+	list_for_each_entry(tg, &qs->groups, next) {
+		if (tg->parent || !tg->adaptive)
+			continue;
+		want = tg->adapt_demand;
+		if (tg->adapt_busy)
+			want = min(ktime_add(want, spare), tg->quota_max);
+		set_adapted_quota(qs, tg, want);
+	}
+}
+
 static void quota_refill_handler(struct evl_timer *timer) /* oob stage stalled */
 {
 	struct evl_quota_group *tg;
-	struct evl_thread *thread, *tmp;
 	struct evl_sched_quota *qs;
 	struct evl_rq *rq;
 
@@ -160,27 +354,23 @@ static void quota_refill_handler(struct evl_timer *timer) /* oob stage stalled *
 
 	raw_spin_lock(&rq->lock);
 
-	list_for_each_entry(tg, &qs->groups, next) {
-		/* Allot a new runtime budget for the group. */
+	/*
+	 * Budgets of adaptive groups follow their demand, this must
+	 * happen before they are replenished.
+	 */
+	if (qs->nr_adaptive)
+		adapt_budgets(qs);
+
+	/* Allot a new runtime budget to every group on this CPU. */
+	list_for_each_entry(tg, &qs->groups, next)
 		replenish_budget(qs, tg);
 
-		if (tg->run_budget == 0 || list_empty(&tg->expired))
-			continue;
-		/*
-		 * For each group living on this CPU, move all expired
-		 * threads back to the runqueue. Since those threads
-		 * were moved out of the runqueue as we were
-		 * considering them for execution, we push them back
-		 * in LIFO order to their respective priority group.
-		 * The expiry queue is FIFO to keep ordering right
-		 * among expired threads.
-		 */
-		list_for_each_entry_safe_reverse(thread, tmp,
-						&tg->expired, quota_expired) {
-			list_del_init(&thread->quota_expired);
-			evl_add_schedq(&rq->fifo.runnable, thread);
-		}
-	}
+	/*
+	 * Then release the expired threads, which requires the
+	 * ancestors of their group to be replenished first.
+	 */
+	list_for_each_entry(tg, &qs->groups, next)
+		release_expired(rq, tg);
 
 	evl_set_self_resched(evl_get_timer_rq(timer));
 
@@ -210,9 +400,12 @@ static int quota_sum_all(struct evl_sched_quota *qs)
 	if (list_empty(&qs->groups))
 		return 0;
 
+	/* Child groups draw from their parent's share. */
 	sum = 0;
-	list_for_each_entry(tg, &qs->groups, next)
-		sum += tg->quota_percent;
+	list_for_each_entry(tg, &qs->groups, next) {
+		if (tg->parent == NULL)
+			sum += tg->quota_percent;
+	}
 
 	return sum;
 }
@@ -222,6 +415,7 @@ static void quota_init(struct evl_rq *rq)
 	struct evl_sched_quota *qs = &rq->quota;
 
 	qs->period = quota_period;
+	qs->nr_adaptive = 0;
 	INIT_LIST_HEAD(&qs->groups);
 
 	evl_init_timer_on_rq(&qs->refill_timer,
@@ -345,7 +539,7 @@ static void quota_kick(struct evl_thread *thread)
 	 * switches to in-band context, even if the group it belongs
 	 * to lacks runtime budget.
 	 */
-	if (tg->run_budget == 0 && !list_empty(&thread->quota_expired)) {
+	if (!group_has_budget(tg) && !list_empty(&thread->quota_expired)) {
 		list_del_init(&thread->quota_expired);
 		evl_add_schedq_tail(&rq->fifo.runnable, thread);
 	}
@@ -353,7 +547,7 @@ static void quota_kick(struct evl_thread *thread)
 
 static inline int thread_is_runnable(struct evl_thread *thread)
 {
-	return thread->quota->run_budget > 0 || (thread->info & EVL_T_KICKED);
+	return group_has_budget(thread->quota) || (thread->info & EVL_T_KICKED);
 }
 
 static void quota_enqueue(struct evl_thread *thread)
@@ -366,7 +560,7 @@ static void quota_enqueue(struct evl_thread *thread)
 	else
 		evl_add_schedq_tail(&rq->fifo.runnable, thread);
 
-	tg->nr_active++;
+	inc_active(tg);
 }
 
 static void quota_dequeue(struct evl_thread *thread)
@@ -379,7 +573,7 @@ static void quota_dequeue(struct evl_thread *thread)
 	else
 		evl_del_schedq(&rq->fifo.runnable, thread);
 
-	tg->nr_active--;
+	dec_active(tg);
 }
 
 static void quota_requeue(struct evl_thread *thread)
@@ -392,7 +586,7 @@ static void quota_requeue(struct evl_thread *thread)
 	else
 		evl_add_schedq(&rq->fifo.runnable, thread);
 
-	tg->nr_active++;
+	inc_active(tg);
 }
 
 static struct evl_thread *quota_pick(struct evl_rq *rq)
@@ -400,21 +594,16 @@ static struct evl_thread *quota_pick(struct evl_rq *rq)
 	struct evl_thread *next, *curr = rq->curr;
 	struct evl_sched_quota *qs = &rq->quota;
 	struct evl_quota_group *otg, *tg;
-	ktime_t now, elapsed;
+	ktime_t now;
 
 	now = evl_read_clock(&evl_mono_clock);
 	otg = curr->quota;
-	if (otg == NULL)
-		goto pick;
 	/*
 	 * Charge the time consumed by the outgoing thread to the
-	 * group it belongs to.
+	 * group it belongs to, and its ancestors.
 	 */
-	elapsed = ktime_sub(now, otg->run_start);
-	if (elapsed < otg->run_budget)
-		otg->run_budget = ktime_sub(otg->run_budget, elapsed);
-	else
-		otg->run_budget = 0;
+	if (otg)
+		charge_group(otg, now);
 pick:
 	next = evl_get_schedq(&rq->fifo.runnable);
 	if (next == NULL) {
@@ -442,7 +631,7 @@ pick:
 		goto out;
 	}
 
-	if (ktime_to_ns(tg->run_budget) == 0) {
+	if (!group_has_budget(tg)) {
 		/* Flush expired group members as we go. */
 		list_add_tail(&next->quota_expired, &tg->expired);
 		goto pick;
@@ -454,10 +643,10 @@ pick:
 
 	/* Arm limit timer for the new running group. */
 	evl_start_timer(&qs->limit_timer,
-			ktime_add(now, tg->run_budget),
+			ktime_add(now, group_budget(tg)),
 			EVL_INFINITE);
 out:
-	tg->nr_active--;
+	dec_active(tg);
 
 	return next;
 }
@@ -488,6 +677,7 @@ static ssize_t quota_show(struct evl_thread *thread,
 
 static int quota_create_group(struct evl_quota_group *tg,
 			struct evl_rq *rq,
+			struct evl_quota_group *parent,
 			int *quota_sum_r)
 {
 	int tgid, nr_groups = MAX_QUOTA_GROUPS;
@@ -502,14 +692,28 @@ static int quota_create_group(struct evl_quota_group *tg,
 	__set_bit(tgid, group_map);
 	tg->tgid = tgid;
 	tg->rq = rq;
-	tg->run_budget = qs->period;
+	tg->parent = parent;
 	tg->run_credit = 0;
-	tg->quota_percent = 100;
-	tg->quota_peak_percent = 100;
-	tg->quota = qs->period;
-	tg->quota_peak = qs->period;
+	if (parent) {
+		/* Children inherit the limits of their parent. */
+		tg->quota_percent = parent->quota_percent;
+		tg->quota_peak_percent = parent->quota_peak_percent;
+		tg->quota = parent->quota;
+		tg->quota_peak = parent->quota_peak;
+		parent->nr_children++;
+	} else {
+		tg->quota_percent = 100;
+		tg->quota_peak_percent = 100;
+		tg->quota = qs->period;
+		tg->quota_peak = qs->period;
+	}
+	tg->run_budget = tg->quota;
 	tg->nr_active = 0;
 	tg->nr_threads = 0;
+	tg->nr_children = 0;
+	tg->run_time = 0;
+	tg->nr_throttled = 0;
+	tg->adaptive = false;
 	INIT_LIST_HEAD(&tg->members);
 	INIT_LIST_HEAD(&tg->expired);
 
@@ -535,6 +739,10 @@ static int quota_destroy_group(struct evl_quota_group *tg,
 
 	assert_hard_lock(&rq->lock);
 
+	/* Children must be removed first, even when forcing. */
+	if (tg->nr_children > 0)
+		return -EBUSY;
+
 	if (!list_empty(&tg->members) && !force)
 		return -EBUSY;
 
@@ -547,6 +755,9 @@ static int quota_destroy_group(struct evl_quota_group *tg,
 	__clear_bit(tg->tgid, group_map);
 	list_del(&tg->next);
 
+	if (tg->adaptive)
+		qs->nr_adaptive--;
+
 	if (list_empty(&qs->groups))
 		evl_stop_timer(&qs->refill_timer);
 
@@ -573,6 +784,13 @@ static int quota_destroy_group(struct evl_quota_group *tg,
 		raw_spin_lock_irqsave(&rq->lock, flags);
 	}
 
+	/*
+	 * Our former members might have referred to the parent group
+	 * until now, release it only at this point.
+	 */
+	if (tg->parent)
+		tg->parent->nr_children--;
+
 	*quota_sum_r = quota_sum_all(qs);
 
 	return 0;
@@ -583,48 +801,44 @@ static void quota_set_limit(struct evl_quota_group *tg,
 			int *quota_sum_r)
 {
 	struct evl_rq *rq = tg->rq;
-	struct evl_thread *thread, *tmp, *curr = rq->curr;
+	struct evl_thread *curr = rq->curr;
 	struct evl_sched_quota *qs = &rq->quota;
-	ktime_t now, elapsed, consumed;
+	struct evl_quota_group *other;
 	ktime_t old_quota = tg->quota;
-	u64 n;
+	ktime_t consumed;
 
 	assert_hard_lock(&rq->lock);
 
-	if (quota_percent < 0 || quota_percent > 100) { /* Quota off. */
+	if (quota_percent < 0 || quota_percent > 100) /* Quota off. */
 		quota_percent = 100;
-		tg->quota = qs->period;
-	} else {
-		n = qs->period * quota_percent;
-		do_div(n, 100);
-		tg->quota = n;
-	}
 
 	if (quota_peak_percent < quota_percent)
 		quota_peak_percent = quota_percent;
 
-	if (quota_peak_percent < 0 || quota_peak_percent > 100) {
+	if (quota_peak_percent < 0 || quota_peak_percent > 100)
 		quota_peak_percent = 100;
-		tg->quota_peak = qs->period;
-	} else {
-		n = qs->period * quota_peak_percent;
-		do_div(n, 100);
-		tg->quota_peak = n;
+
+	/*
+	 * A child group may not be given more than its parent,
+	 * although lowering the share of a parent group later on
+	 * does not update its children: the budget of the parent
+	 * caps their consumption anyway.
+	 */
+	if (tg->parent) {
+		quota_percent = min(quota_percent,
+				tg->parent->quota_percent);
+		quota_peak_percent = min(quota_peak_percent,
+					tg->parent->quota_peak_percent);
 	}
 
+	tg->quota = percent_of_period(qs, quota_percent);
+	tg->quota_peak = percent_of_period(qs, quota_peak_percent);
+
 	tg->quota_percent = quota_percent;
 	tg->quota_peak_percent = quota_peak_percent;
 
 	if (thread_on_quota(curr, tg)) {
-		now = evl_read_clock(&evl_mono_clock);
-
-		elapsed = now - tg->run_start;
-		if (elapsed < tg->run_budget)
-			tg->run_budget -= elapsed;
-		else
-			tg->run_budget = 0;
-
-		tg->run_start = now;
+		charge_group(curr->quota, evl_read_clock(&evl_mono_clock));
 		evl_stop_timer(&qs->limit_timer);
 	}
 
@@ -642,13 +856,9 @@ static void quota_set_limit(struct evl_quota_group *tg,
 
 	*quota_sum_r = quota_sum_all(qs);
 
-	if (tg->run_budget > 0) {
-		list_for_each_entry_safe_reverse(thread, tmp, &tg->expired,
-						quota_expired) {
-			list_del_init(&thread->quota_expired);
-			evl_add_schedq(&rq->fifo.runnable, thread);
-		}
-	}
+	/* Children of @tg might be allowed to run again too. */
+	list_for_each_entry(other, &qs->groups, next)
+		release_expired(rq, other);
 
 	/*
 	 * Apply the new budget immediately, in case a member of this
@@ -657,6 +867,55 @@ static void quota_set_limit(struct evl_quota_group *tg,
 	evl_set_resched(rq);
 }
 
+/*
+ * Switch a top-level group to adaptive mode, with a budget kept
+ * within [quota_min_percent, quota_max_percent] of the period. A
+ * negative @quota_min_percent switches it back to the static mode,
+ * keeping the budget in effect.
+ */
+static int quota_set_adaptive(struct evl_quota_group *tg,
+			int quota_min_percent, int quota_max_percent,
+			int *quota_sum_r)
+{
+	struct evl_sched_quota *qs = &tg->rq->quota;
+	int quota_percent;
+
+	assert_hard_lock(&tg->rq->lock);
+
+	/* Children are capped by their parent's budget already. */
+	if (tg->parent)
+		return -EINVAL;
+
+	if (quota_min_percent < 0) {
+		if (tg->adaptive) {
+			tg->adaptive = false;
+			qs->nr_adaptive--;
+		}
+		*quota_sum_r = quota_sum_all(qs);
+		return 0;
+	}
+
+	if (quota_max_percent < quota_min_percent || quota_max_percent > 100)
+		return -EINVAL;
+
+	if (!tg->adaptive) {
+		tg->adaptive = true;
+		qs->nr_adaptive++;
+	}
+
+	tg->quota_min = percent_of_period(qs, quota_min_percent);
+	tg->quota_max = percent_of_period(qs, quota_max_percent);
+	tg->adapt_run_time = tg->run_time;
+	tg->adapt_throttled = tg->nr_throttled;
+
+	/* Start from the current budget, brought within bounds. */
+	quota_percent = clamp(tg->quota_percent,
+			quota_min_percent, quota_max_percent);
+	quota_set_limit(tg, quota_percent, quota_percent, quota_sum_r);
+
+	return 0;
+}
+
 static struct evl_quota_group *
 find_quota_group(struct evl_rq *rq, int tgid)
 {
@@ -664,6 +923,9 @@ find_quota_group(struct evl_rq *rq, int tgid)
 
 	assert_hard_lock(&rq->lock);
 
+	if (tgid < 0 || tgid >= MAX_QUOTA_GROUPS)
+		return NULL;
+
 	/* Quick check using the global id. map first. */
 	if (!test_bit(tgid, group_map))
 		return NULL;
@@ -688,8 +950,8 @@ static ssize_t quota_control(int cpu, union evl_sched_ctlparam *ctlp,
 {
 	struct evl_quota_ctlparam *pq = &ctlp->quota;
 	struct evl_quota_ctlinfo *iq = &infp->quota;
+	struct evl_quota_group *tg, *parent;
 	struct evl_sched_group *group;
-	struct evl_quota_group *tg;
 	unsigned long flags;
 	int ret, quota_sum;
 	struct evl_rq *rq;
@@ -699,13 +961,24 @@ static ssize_t quota_control(int cpu, union evl_sched_ctlparam *ctlp,
 
 	switch (pq->op) {
 	case evl_quota_add:
+	case evl_quota_add_child:
 		group = evl_alloc(sizeof(*group));
 		if (group == NULL)
 			return -ENOMEM;
 		tg = &group->quota;
 		rq = evl_cpu_rq(cpu);
 		raw_spin_lock_irqsave(&rq->lock, flags);
-		ret = quota_create_group(tg, rq, &quota_sum);
+		parent = NULL;
+		if (pq->op == evl_quota_add_child) {
+			/* The parent must live on the same CPU. */
+			parent = find_quota_group(rq, pq->u.add_child.parent);
+			if (parent == NULL) {
+				raw_spin_unlock_irqrestore(&rq->lock, flags);
+				evl_free(group);
+				return -EINVAL;
+			}
+		}
+		ret = quota_create_group(tg, rq, parent, &quota_sum);
 		if (ret) {
 			raw_spin_unlock_irqrestore(&rq->lock, flags);
 			evl_free(group);
@@ -740,9 +1013,27 @@ static ssize_t quota_control(int cpu, union evl_sched_ctlparam *ctlp,
 		if (tg == NULL)
 			goto bad_tgid;
 		group = container_of(tg, struct evl_sched_group, quota);
+		/* A static budget ends the adaptive mode. */
+		if (tg->adaptive) {
+			tg->adaptive = false;
+			rq->quota.nr_adaptive--;
+		}
 		quota_set_limit(tg, pq->u.set.quota, pq->u.set.quota_peak,
 				&quota_sum);
 		break;
+	case evl_quota_set_adaptive:
+		rq = evl_cpu_rq(cpu);
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		tg = find_quota_group(rq, pq->u.adapt.tgid);
+		if (tg == NULL)
+			goto bad_tgid;
+		ret = quota_set_adaptive(tg, pq->u.adapt.quota_min,
+					pq->u.adapt.quota_max, &quota_sum);
+		if (ret) {
+			raw_spin_unlock_irqrestore(&rq->lock, flags);
+			return ret;
+		}
+		break;
 	case evl_quota_get:
 		rq = evl_cpu_rq(cpu);
 		raw_spin_lock_irqsave(&rq->lock, flags);
@@ -758,6 +1049,9 @@ static ssize_t quota_control(int cpu, union evl_sched_ctlparam *ctlp,
 	iq->tgid = tg->tgid;
 	iq->quota = tg->quota_percent;
 	iq->quota_peak = tg->quota_peak_percent;
+	iq->parent = tg->parent ? tg->parent->tgid : -1;
+	iq->run_time = ktime_to_ns(tg->run_time);
+	iq->nr_throttled = tg->nr_throttled;
 	raw_spin_unlock_irqrestore(&rq->lock, flags);
 	iq->quota_sum = quota_sum;
 done:
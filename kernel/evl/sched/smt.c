@@ -0,0 +1,105 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/topology.h>
+#include <linux/irq_pipeline.h>
+#include <evl/sched.h>
+#include <evl/flag.h>
+
+/*
+ * SMT sibling exclusion. While a thread bearing EVL_T_EXCL runs
+ * out-of-band on a CPU, every out-of-band sibling sharing the same
+ * core is held by a per-CPU idler running at the lowest FIFO
+ * priority. The idler spins until all its siblings release it, which
+ * keeps the in-band stage off that CPU meanwhile, without preventing
+ * its own out-of-band threads from preempting the idler as usual.
+ * Siblings are notified by the reschedule IPI.
+ */
+
+struct smt_idler {
+	struct evl_kthread kthread;
+	struct evl_flag hold;
+};
+
+static DEFINE_PER_CPU(struct smt_idler, smt_idlers);
+
+/* rq->lock held, hard irqs off. */
+void __evl_switch_smt(struct evl_rq *rq, bool hold)
+{
+	struct evl_rq *sibling;
+	int cpu;
+
+	rq->smt_holding = hold;
+
+	if (cpumask_empty(&rq->smt_siblings))
+		return;
+
+	for_each_cpu(cpu, &rq->smt_siblings) {
+		sibling = evl_cpu_rq(cpu);
+		if (hold)
+			atomic_inc(&sibling->smt_holds);
+		else
+			atomic_dec(&sibling->smt_holds);
+	}
+
+	if (hold)
+		irq_send_oob_ipi(RESCHEDULE_OOB_IPI, &rq->smt_siblings);
+}
+
+/* oob stage stalled, from the reschedule IPI handler. */
+void evl_kick_smt_idler(struct evl_rq *this_rq)
+{
+	if (atomic_read(&this_rq->smt_holds) > 0)
+		evl_raise_flag_nosched(&this_cpu_ptr(&smt_idlers)->hold);
+}
+
+static void smt_idler_work(void *arg)
+{
+	struct smt_idler *idler = arg;
+	struct evl_rq *this_rq = this_evl_rq();
+
+	while (!evl_kthread_should_stop()) {
+		if (evl_wait_flag(&idler->hold))
+			break;
+		while (atomic_read(&this_rq->smt_holds) > 0 &&
+			!evl_kthread_should_stop())
+			cpu_relax();
+	}
+}
+
+void __init evl_init_smt(void)
+{
+	const struct cpumask *siblings;
+	struct smt_idler *idler;
+	int cpu, sibling, ret;
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		siblings = topology_sibling_cpumask(cpu);
+		if (cpumask_weight_and(siblings, &evl_oob_cpus) < 2)
+			continue;
+
+		idler = per_cpu_ptr(&smt_idlers, cpu);
+		evl_init_flag(&idler->hold);
+		ret = evl_run_kthread_on_cpu(&idler->kthread, cpu,
+					smt_idler_work, idler,
+					EVL_FIFO_MIN_PRIO,
+					EVL_CLONE_PUBLIC,
+					"smt-idler:%d", cpu);
+		if (ret) {
+			printk(EVL_WARNING "cannot hold SMT sibling CPU%d\n",
+				cpu);
+			evl_destroy_flag(&idler->hold);
+			continue;
+		}
+
+		/* @cpu may now be held by its siblings. */
+		for_each_cpu_and(sibling, siblings, &evl_oob_cpus) {
+			if (sibling != cpu)
+				cpumask_set_cpu(cpu,
+					&evl_cpu_rq(sibling)->smt_siblings);
+		}
+	}
+}
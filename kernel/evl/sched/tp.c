@@ -6,10 +6,45 @@
  */
 
 #include <linux/err.h>
+#include <linux/math64.h>
 #include <evl/sched.h>
+#include <evl/clock.h>
 #include <evl/memory.h>
 #include <uapi/evl/sched-abi.h>
 
+/*
+ * In synchronized mode, the start date of the current time frame is
+ * tracked on the reference clock the epoch is based on, then
+ * converted to the timebase of evl_mono_clock which drives the
+ * per-CPU frame timer. Converting again at every frame boundary
+ * compensates for any drift between both clocks, so that all CPUs
+ * following the same epoch remain phase-locked.
+ */
+static ktime_t tp_sync_to_mono(struct evl_tp_schedule *gps, ktime_t date)
+{
+	ktime_t delta;
+
+	if (gps->clock == &evl_mono_clock)
+		return date;
+
+	delta = ktime_sub(evl_read_clock(gps->clock),
+			evl_read_clock(&evl_mono_clock));
+
+	return ktime_sub(date, delta);
+}
+
+static void tp_advance_frame(struct evl_sched_tp *tp)
+{
+	struct evl_tp_schedule *gps = tp->gps;
+
+	if (gps->clock) {
+		tp->tf_start_ref = ktime_add(tp->tf_start_ref, gps->tf_duration);
+		tp->tf_start = tp_sync_to_mono(gps, tp->tf_start_ref);
+	} else {
+		tp->tf_start = ktime_add(tp->tf_start, gps->tf_duration);
+	}
+}
+
 static void tp_schedule_next(struct evl_sched_tp *tp)
 {
 	struct evl_tp_window *w;
@@ -47,8 +82,8 @@ static void tp_schedule_next(struct evl_sched_tp *tp)
 		now = evl_read_clock(&evl_mono_clock);
 		if (ktime_compare(now, t) <= 0)
 			break;
-		t = ktime_add(tp->tf_start, tp->gps->tf_duration);
-		tp->tf_start = t;
+		tp_advance_frame(tp);
+		t = tp->tf_start;
 		tp->wnext = 0;
 	}
 
@@ -56,9 +91,42 @@ static void tp_schedule_next(struct evl_sched_tp *tp)
 	evl_set_resched(rq);
 }
 
+static void free_tp_schedule(struct evl_tp_schedule *gps)
+{
+	if (gps->clock)
+		evl_put_clock(gps->clock);
+
+	evl_free(gps);
+}
+
+static void put_tp_schedule(struct evl_tp_schedule *gps)
+{
+	if (atomic_dec_and_test(&gps->refcount))
+		free_tp_schedule(gps);
+}
+
+/*
+ * Switch to the staged schedule at the boundary of a time frame. The
+ * new time frames follow on from this boundary, so that the
+ * partitions keep running across the change with no gap.
+ */
+static struct evl_tp_schedule *tp_swap_schedule(struct evl_sched_tp *tp)
+{
+	struct evl_tp_schedule *old_gps = tp->gps, *gps = tp->staged_gps;
+
+	tp->staged_gps = NULL;
+	tp->gps = gps;
+	tp->wnext = 0;
+	if (gps->clock)
+		gps->epoch = tp->tf_start_ref;
+
+	return old_gps;
+}
+
 static void tp_tick_handler(struct evl_timer *timer)
 {
 	struct evl_rq *rq = container_of(timer, struct evl_rq, tp.tf_timer);
+	struct evl_tp_schedule *old_gps = NULL;
 	struct evl_thread *curr = rq->curr;
 	struct evl_sched_tp *tp = &rq->tp;
 	int overrun_frame = -1;
@@ -79,17 +147,27 @@ static void tp_tick_handler(struct evl_timer *timer)
 			overrun_frame = tp->gps->pwin_nr - 1;
 	}
 
+	/*
+	 * A time frame begins when we are about to enter window #0,
+	 * this is where a staged schedule may replace the current one.
+	 */
+	if (tp->wnext == 0 && tp->staged_gps)
+		old_gps = tp_swap_schedule(tp);
+
 	/*
 	 * Advance the start date for the next time frame by a full
 	 * period if we are processing the last window.
 	 */
 	if (tp->wnext + 1 == tp->gps->pwin_nr)
-		tp->tf_start = ktime_add(tp->tf_start, tp->gps->tf_duration);
+		tp_advance_frame(tp);
 
 	tp_schedule_next(tp);
 
 	raw_spin_unlock(&rq->lock);
 
+	if (old_gps)
+		put_tp_schedule(old_gps);
+
 	if (overrun_frame >= 0)
 		evl_notify_thread(curr, EVL_HMDIAG_OVERRUN,
 				evl_intval(overrun_frame));
@@ -105,6 +183,7 @@ static void tp_init(struct evl_rq *rq)
 
 	tp->tps = NULL;
 	tp->gps = NULL;
+	tp->staged_gps = NULL;
 	INIT_LIST_HEAD(&tp->threads);
 	evl_init_schedq(&tp->idle.runnable);
 	evl_init_timer_on_rq(&tp->tf_timer, &evl_mono_clock, tp_tick_handler,
@@ -249,9 +328,70 @@ static const char *tp_name(struct evl_thread *thread)
 static ssize_t tp_show(struct evl_thread *thread,
 		char *buf, ssize_t count)
 {
-	int ptid = thread->tps - evl_thread_rq(thread)->tp.partitions;
+	struct evl_rq *rq = evl_thread_rq(thread);
+	struct evl_sched_tp *tp = &rq->tp;
+	int ptid = thread->tps - tp->partitions;
+	struct evl_tp_schedule *gps;
+	ssize_t ret;
+
+	/*
+	 * A staged schedule may replace the current one at any frame
+	 * boundary, hold the runqueue lock while peeking at it.
+	 */
+	raw_spin_lock(&rq->lock);
+
+	gps = tp->gps;
+	if (gps && gps->clock)
+		ret = snprintf(buf, count, "%d %Lu %s\n", ptid,
+			ktime_to_ns(gps->epoch), gps->clock->name);
+	else
+		ret = snprintf(buf, count, "%d\n", ptid);
+
+	raw_spin_unlock(&rq->lock);
+
+	return ret;
+}
+
+static void start_synced_schedule(struct evl_rq *rq)
+{
+	struct evl_sched_tp *tp = &rq->tp;
+	struct evl_tp_schedule *gps = tp->gps;
+	ktime_t now, elapsed;
+	u64 nr_frames;
+	int w;
+
+	now = evl_read_clock(gps->clock);
+
+	/*
+	 * Before the epoch, idle until window #0 of the first time
+	 * frame opens. tp_tick_handler() takes over from there.
+	 */
+	if (ktime_compare(now, gps->epoch) < 0) {
+		tp->tf_start_ref = gps->epoch;
+		tp->tf_start = tp_sync_to_mono(gps, gps->epoch);
+		tp->tps = &tp->idle;
+		evl_start_timer(&tp->tf_timer, tp->tf_start, EVL_INFINITE);
+		evl_set_resched(rq);
+		return;
+	}
+
+	/*
+	 * Otherwise, enter the window which is currently open in the
+	 * ongoing time frame, so that we join the other CPUs
+	 * following the same epoch in phase.
+	 */
+	elapsed = ktime_sub(now, gps->epoch);
+	nr_frames = div64_u64(elapsed, gps->tf_duration);
+	tp->tf_start_ref = ktime_add(gps->epoch, nr_frames * gps->tf_duration);
+	tp->tf_start = tp_sync_to_mono(gps, tp->tf_start_ref);
+	elapsed = ktime_sub(now, tp->tf_start_ref);
+
+	for (w = gps->pwin_nr - 1; w > 0; w--)
+		if (ktime_compare(gps->pwins[w].w_offset, elapsed) <= 0)
+			break;
 
-	return snprintf(buf, count, "%d\n", ptid);
+	tp->wnext = w;
+	tp_schedule_next(tp);
 }
 
 static void start_tp_schedule(struct evl_rq *rq)
@@ -264,6 +404,12 @@ static void start_tp_schedule(struct evl_rq *rq)
 		return;
 
 	tp->wnext = 0;
+
+	if (tp->gps->clock) {
+		start_synced_schedule(rq);
+		return;
+	}
+
 	tp->tf_start = evl_read_clock(&evl_mono_clock);
 	tp_schedule_next(tp);
 }
@@ -281,8 +427,8 @@ static void stop_tp_schedule(struct evl_rq *rq)
 static struct evl_tp_schedule *
 set_tp_schedule(struct evl_rq *rq, struct evl_tp_schedule *gps)
 {
+	struct evl_tp_schedule *old_gps, *staged_gps;
 	struct evl_sched_tp *tp = &rq->tp;
-	struct evl_tp_schedule *old_gps;
 	unsigned long flags;
 
 	if (EVL_WARN_ON(CORE, gps != NULL &&
@@ -293,7 +439,8 @@ set_tp_schedule(struct evl_rq *rq, struct evl_tp_schedule *gps)
 	 * Changing the TP schedule on a runqueue is a twofold
 	 * operation which happens atomically: first we stop the
 	 * per-CPU timer driving the time slicing, next the new
-	 * scheduling table is swapped with the old one.
+	 * scheduling table is swapped with the old one. Any staged
+	 * schedule is dropped in the same move.
 	 */
 	raw_spin_lock_irqsave(&rq->lock, flags);
 
@@ -309,9 +456,52 @@ set_tp_schedule(struct evl_rq *rq, struct evl_tp_schedule *gps)
 	stop_tp_schedule(rq);
 	old_gps = tp->gps;
 	tp->gps = gps;
+	staged_gps = tp->staged_gps;
+	tp->staged_gps = NULL;
+
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	if (staged_gps)
+		put_tp_schedule(staged_gps);
+
+	return old_gps;
+}
+
+/*
+ * Stage @gps for replacing the running schedule at the next time
+ * frame boundary, see tp_tick_handler(). Any schedule staged earlier
+ * is dropped. If no schedule is running, @gps is installed at once.
+ */
+static struct evl_tp_schedule *
+stage_tp_schedule(struct evl_rq *rq, struct evl_tp_schedule *gps)
+{
+	struct evl_tp_schedule *old_gps = NULL, *staged_gps = NULL;
+	struct evl_sched_tp *tp = &rq->tp;
+	unsigned long flags;
+
+	if (EVL_WARN_ON(CORE, gps->pwin_nr <= 0 ||
+				gps->pwins[0].w_offset != 0))
+		return ERR_PTR(-EINVAL);
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+
+	if (tp->gps == NULL || !evl_timer_is_running(&tp->tf_timer)) {
+		old_gps = tp->gps;
+		tp->gps = gps;
+	} else if (gps->clock != tp->gps->clock) {
+		/* We could not follow on from the current frame. */
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+		return ERR_PTR(-EINVAL);
+	} else {
+		staged_gps = tp->staged_gps;
+		tp->staged_gps = gps;
+	}
 
 	raw_spin_unlock_irqrestore(&rq->lock, flags);
 
+	if (staged_gps)
+		put_tp_schedule(staged_gps);
+
 	return old_gps;
 }
 
@@ -330,12 +520,6 @@ get_tp_schedule(struct evl_rq *rq)
 	return gps;
 }
 
-static void put_tp_schedule(struct evl_tp_schedule *gps)
-{
-	if (atomic_dec_and_test(&gps->refcount))
-		evl_free(gps);
-}
-
 static ssize_t tp_control(int cpu, union evl_sched_ctlparam *ctlp,
 		union evl_sched_ctlinfo *infp)
 {
@@ -367,10 +551,19 @@ static ssize_t tp_control(int cpu, union evl_sched_ctlparam *ctlp,
 		start_tp_schedule(rq);
 		raw_spin_unlock_irqrestore(&rq->lock, flags);
 		goto done;
+	case evl_tp_stage:
+		if (pt->nr_windows <= 0)
+			return -EINVAL;
+		goto install_schedule;
 	case evl_tp_stop:
+		/* A staged schedule would never take effect. */
 		raw_spin_lock_irqsave(&rq->lock, flags);
 		stop_tp_schedule(rq);
+		ogps = rq->tp.staged_gps;
+		rq->tp.staged_gps = NULL;
 		raw_spin_unlock_irqrestore(&rq->lock, flags);
+		if (ogps)
+			put_tp_schedule(ogps);
 		goto done;
 	case evl_tp_get:
 		raw_spin_lock_irqsave(&rq->lock, flags);
@@ -393,6 +586,7 @@ static ssize_t tp_control(int cpu, union evl_sched_ctlparam *ctlp,
 	it = &infp->tp;
 	nr_windows = min(pt->nr_windows, gps->pwin_nr);
 	it->nr_windows = gps->pwin_nr; /* Actual count is returned. */
+	it->epoch = ktime_to_u_timespec(gps->clock ? gps->epoch : 0);
 
 	for (n = 0, pp = p = it->windows, pw = w = gps->pwins;
 	     n < nr_windows; pp = p, p++, pw = w, w++, n++) {
@@ -409,12 +603,20 @@ static ssize_t tp_control(int cpu, union evl_sched_ctlparam *ctlp,
 
 	return evl_tp_infolen(nr_windows);
 
-install_schedule:	/* evl_tp_install */
+install_schedule:	/* evl_tp_install, evl_tp_stage */
 
 	gps = evl_alloc(sizeof(*gps) + pt->nr_windows * sizeof(*w));
 	if (gps == NULL)
 		return -ENOMEM;
 
+	gps->clock = NULL;
+	gps->epoch = u_timespec_to_ktime(pt->epoch);
+	if (gps->epoch) {
+		gps->clock = evl_get_clock_by_fd(pt->clockfd);
+		if (gps->clock == NULL)
+			goto fail;
+	}
+
 	for (n = 0, p = pt->windows, w = gps->pwins, next_offset = 0;
 	     n < pt->nr_windows; n++, p++, w++) {
 		/*
@@ -444,9 +646,12 @@ install_schedule:	/* evl_tp_install */
 	gps->pwin_nr = n;
 	gps->tf_duration = next_offset;
 
-switch_schedule:	/* evl_tp_{un}install */
+switch_schedule:	/* evl_tp_{un}install, evl_tp_stage */
 
-	ogps = set_tp_schedule(rq, gps);
+	if (pt->op == evl_tp_stage)
+		ogps = stage_tp_schedule(rq, gps);
+	else
+		ogps = set_tp_schedule(rq, gps);
 	if (IS_ERR(ogps)) {
 		ret = PTR_ERR(ogps);
 		goto fail;
@@ -458,7 +663,8 @@ done:
 
 	return 0;
 fail:
-	evl_free(gps);
+	if (gps)
+		free_tp_schedule(gps);
 
 	return ret;
 }
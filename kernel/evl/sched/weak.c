@@ -15,22 +15,22 @@ static void weak_init(struct evl_rq *rq)
 
 static void weak_requeue(struct evl_thread *thread)
 {
-	evl_add_schedq(&thread->rq->weak.runnable, thread);
+	__evl_requeue_weak_thread(thread);
 }
 
 static void weak_enqueue(struct evl_thread *thread)
 {
-	evl_add_schedq_tail(&thread->rq->weak.runnable, thread);
+	__evl_enqueue_weak_thread(thread);
 }
 
 static void weak_dequeue(struct evl_thread *thread)
 {
-	evl_del_schedq(&thread->rq->weak.runnable, thread);
+	__evl_dequeue_weak_thread(thread);
 }
 
 static struct evl_thread *weak_pick(struct evl_rq *rq)
 {
-	return evl_get_schedq(&rq->weak.runnable);
+	return __evl_pick_weak_thread(rq);
 }
 
 static int weak_chkparam(struct evl_thread *thread,
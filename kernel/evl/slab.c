@@ -0,0 +1,202 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <evl/memory.h>
+#include <evl/assert.h>
+#include <evl/slab.h>
+
+/*
+ * Objects are carved from slab pages obtained from the system heap,
+ * which are only released when the slab is destroyed. Free objects
+ * are queued to a per-CPU list, which is served with hard irqs off
+ * without locking. EVL_SLAB_BATCH objects move at once between a
+ * per-CPU list and the depot shared by all CPUs, when the former
+ * runs empty, or grows beyond EVL_SLAB_CPU_MAX.
+ *
+ * A constructor is called once for each object when its slab page
+ * is carved, with hard irqs off. Therefore, objects should be
+ * released in constructed state, like with kmem caches.
+ *
+ * All objects must have been released before destroying a slab.
+ */
+
+#define EVL_SLAB_BATCH		8
+#define EVL_SLAB_CPU_MAX	(EVL_SLAB_BATCH * 2)
+
+struct evl_slab_page {
+	struct evl_slab_page *next;
+} ____cacheline_aligned;
+
+static inline void **free_link(struct evl_slab *slab, void *obj)
+{
+	return obj + __EVL_SLAB_LINK(slab->size);
+}
+
+int evl_init_slab(struct evl_slab *slab, const char *name,
+		size_t size, void (*ctor)(void *obj))
+{
+	inband_context_only();
+
+	slab->pcpu = alloc_percpu(struct evl_slab_cpu);
+	if (slab->pcpu == NULL)
+		return -ENOMEM;
+
+	slab->name = name;
+	slab->size = size;
+	slab->stride = __EVL_SLAB_STRIDE(size);
+	slab->ctor = ctor;
+	raw_spin_lock_init(&slab->lock);
+	slab->depot = NULL;
+	slab->pages = NULL;
+	slab->nr_objs = 0;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(evl_init_slab);
+
+void evl_destroy_slab(struct evl_slab *slab)
+{
+	struct evl_slab_page *page, *next;
+
+	inband_context_only();
+
+	for (page = slab->pages; page; page = next) {
+		next = page->next;
+		evl_free(page);
+	}
+
+	free_percpu(slab->pcpu);
+	slab->pages = NULL;
+}
+EXPORT_SYMBOL_GPL(evl_destroy_slab);
+
+/* hard irqs off, returns a list of free objects. */
+static void *grow_slab(struct evl_slab *slab, unsigned int *countp)
+{
+	struct evl_slab_page *page;
+	void *obj, *list = NULL;
+	unsigned int nr, n;
+	size_t len;
+
+	/*
+	 * Carve at least EVL_SLAB_BATCH objects per page, rounding up
+	 * to the heap page size, which guarantees cache line
+	 * alignment.
+	 */
+	len = ALIGN(sizeof(*page) + slab->stride * EVL_SLAB_BATCH,
+		EVL_HEAP_PAGE_SIZE);
+	page = evl_alloc(len);
+	if (page == NULL)
+		return NULL;
+
+	nr = (len - sizeof(*page)) / slab->stride;
+	obj = (void *)(page + 1) + slab->stride * nr;
+	for (n = 0; n < nr; n++) {
+		obj -= slab->stride;
+		if (slab->ctor)
+			slab->ctor(obj);
+		*free_link(slab, obj) = list;
+		list = obj;
+	}
+
+	raw_spin_lock(&slab->lock);
+	page->next = slab->pages;
+	slab->pages = page;
+	slab->nr_objs += nr;
+	raw_spin_unlock(&slab->lock);
+
+	*countp = nr;
+
+	return list;
+}
+
+/* hard irqs off */
+static void refill_cpu(struct evl_slab *slab, struct evl_slab_cpu *pc)
+{
+	void *list, *obj;
+	unsigned int n;
+
+	raw_spin_lock(&slab->lock);
+
+	list = slab->depot;
+	for (n = 0, obj = list; obj && n < EVL_SLAB_BATCH - 1; n++)
+		obj = *free_link(slab, obj);
+
+	if (obj) {
+		slab->depot = *free_link(slab, obj);
+		*free_link(slab, obj) = NULL;
+		n++;
+	} else {
+		slab->depot = NULL;
+	}
+
+	raw_spin_unlock(&slab->lock);
+
+	if (list == NULL)
+		list = grow_slab(slab, &n);
+
+	pc->free = list;
+	pc->count = list ? n : 0;
+}
+
+/* hard irqs off */
+static void drain_cpu(struct evl_slab *slab, struct evl_slab_cpu *pc)
+{
+	void *list = pc->free, *last = list;
+	unsigned int n;
+
+	for (n = 1; n < EVL_SLAB_BATCH; n++)
+		last = *free_link(slab, last);
+
+	pc->free = *free_link(slab, last);
+	pc->count -= EVL_SLAB_BATCH;
+
+	raw_spin_lock(&slab->lock);
+	*free_link(slab, last) = slab->depot;
+	slab->depot = list;
+	raw_spin_unlock(&slab->lock);
+}
+
+void *evl_slab_alloc(struct evl_slab *slab)
+{
+	struct evl_slab_cpu *pc;
+	unsigned long flags;
+	void *obj;
+
+	flags = hard_local_irq_save();
+
+	pc = this_cpu_ptr(slab->pcpu);
+	if (unlikely(pc->free == NULL))
+		refill_cpu(slab, pc);
+
+	obj = pc->free;
+	if (likely(obj)) {
+		pc->free = *free_link(slab, obj);
+		pc->count--;
+	}
+
+	hard_local_irq_restore(flags);
+
+	return obj;
+}
+EXPORT_SYMBOL_GPL(evl_slab_alloc);
+
+void evl_slab_free(struct evl_slab *slab, void *obj)
+{
+	struct evl_slab_cpu *pc;
+	unsigned long flags;
+
+	flags = hard_local_irq_save();
+
+	pc = this_cpu_ptr(slab->pcpu);
+	*free_link(slab, obj) = pc->free;
+	pc->free = obj;
+	if (unlikely(++pc->count > EVL_SLAB_CPU_MAX))
+		drain_cpu(slab, pc);
+
+	hard_local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(evl_slab_free);
@@ -0,0 +1,107 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/llist.h>
+#include <linux/irq_pipeline.h>
+#include <evl/sched.h>
+#include <evl/assert.h>
+#include <evl/smpcall.h>
+
+/*
+ * Per-CPU mailboxes of pending calls. Only the first call queued to
+ * an empty mailbox sends the reschedule IPI, those piling up until
+ * the target CPU drains its mailbox ride the same IPI.
+ */
+static DEFINE_PER_CPU(struct llist_head, smp_call_mailbox);
+
+static int queue_call(int cpu, struct evl_smp_call *call)
+{
+	if (cpu >= nr_cpu_ids || !is_evl_cpu(cpu))
+		return -EINVAL;
+
+	if (test_and_set_bit_lock(EVL_SMPCALL_PENDING, &call->flags))
+		return -EBUSY;
+
+	if (llist_add(&call->next, per_cpu_ptr(&smp_call_mailbox, cpu)))
+		irq_send_oob_ipi(RESCHEDULE_OOB_IPI, cpumask_of(cpu));
+
+	return 0;
+}
+
+/*
+ * Queue @call for running on @cpu, then return immediately. The
+ * descriptor belongs to the core until evl_smp_call_pending() is
+ * false again, queuing it meanwhile fails with -EBUSY. May be
+ * called from any context, including with hard irqs off.
+ */
+int evl_smp_call_async(int cpu, struct evl_smp_call *call)
+{
+	return queue_call(cpu, call);
+}
+EXPORT_SYMBOL_GPL(evl_smp_call_async);
+
+/*
+ * Run @func(@arg) on @cpu, waiting for completion. The caller must
+ * be able to take the reschedule IPI while waiting, so that two
+ * CPUs calling each other cannot deadlock: hard irqs must be on,
+ * and the oob stage unstalled when running oob. A call to the
+ * local CPU runs immediately, with hard irqs off.
+ */
+int evl_smp_call(int cpu, void (*func)(void *arg), void *arg)
+{
+	struct evl_smp_call call;
+	unsigned long flags;
+	int ret;
+
+	if (EVL_WARN_ON(CORE, hard_irqs_disabled() ||
+				(running_oob() && oob_irqs_disabled())))
+		return -EPERM;
+
+	evl_init_smp_call(&call, func, arg);
+
+	flags = hard_local_irq_save();
+
+	if (cpu == raw_smp_processor_id()) {
+		func(arg);
+		hard_local_irq_restore(flags);
+		return 0;
+	}
+
+	ret = queue_call(cpu, &call);
+
+	hard_local_irq_restore(flags);
+
+	if (ret)
+		return ret;
+
+	while (evl_smp_call_pending(&call))
+		cpu_relax();
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(evl_smp_call);
+
+/* oob stage stalled, from the reschedule IPI handler. */
+void evl_run_smp_calls(void)
+{
+	struct evl_smp_call *call, *tmp;
+	struct llist_node *list;
+
+	list = llist_del_all(this_cpu_ptr(&smp_call_mailbox));
+	if (list == NULL)
+		return;
+
+	/*
+	 * Run calls in queuing order. The descriptor may be reused
+	 * or go away as soon as the pending bit is cleared.
+	 */
+	list = llist_reverse_order(list);
+	llist_for_each_entry_safe(call, tmp, list, next) {
+		call->func(call->arg);
+		clear_bit_unlock(EVL_SMPCALL_PENDING, &call->flags);
+	}
+}
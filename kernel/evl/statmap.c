@@ -0,0 +1,135 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <evl/thread.h>
+#include <evl/statmap.h>
+
+/*
+ * Binary snapshot of the per-thread statistics, which monitoring
+ * tools may sample without issuing any syscall. Slots are indexed by
+ * minor number, all writers to a given slot hold the thread's
+ * runqueue lock, readers are lockless, serialized by the per-slot
+ * sequence count only.
+ */
+
+static struct evl_thread_statslot *statmap;
+
+static size_t statmap_size;
+
+static inline void begin_slot_update(struct evl_thread_statslot *slot)
+{
+	WRITE_ONCE(slot->seq, slot->seq + 1);
+	smp_wmb();
+}
+
+static inline void end_slot_update(struct evl_thread_statslot *slot)
+{
+	smp_wmb();
+	WRITE_ONCE(slot->seq, slot->seq + 1);
+}
+
+/* thread->rq->lock held, irqs off. */
+static void fill_slot(struct evl_thread_statslot *slot,
+		struct evl_thread *thread)
+{
+	slot->cpu = evl_rq_cpu(thread->rq);
+	slot->state = thread->state;
+	slot->isw = evl_get_counter(&thread->stat.isw);
+	slot->csw = evl_get_counter(&thread->stat.csw);
+	slot->sc = evl_get_counter(&thread->stat.sc);
+	slot->rwa = evl_get_counter(&thread->stat.rwa);
+	slot->xtime = ktime_to_ns(evl_get_account_total(&thread->stat.account));
+	slot->runlat_count = thread->stat.runlat.count;
+	slot->runlat_max_ns = ktime_to_ns(thread->stat.runlat.max);
+}
+
+/* In-band, from the mapped task, before it runs out-of-band. */
+void evl_attach_statslot(struct evl_thread *thread)
+{
+	struct evl_thread_statslot *slot;
+	unsigned long flags;
+	struct evl_rq *rq;
+
+	if (statmap == NULL)
+		return;
+
+	slot = statmap + thread->element.minor;
+	rq = evl_get_thread_rq(thread, flags);
+	begin_slot_update(slot);
+	slot->fundle = fundle_of(thread);
+	slot->pid = task_pid_nr(current);
+	strscpy_pad(slot->name, thread->name, sizeof(slot->name));
+	fill_slot(slot, thread);
+	end_slot_update(slot);
+	thread->stat.slot = slot;
+	evl_put_thread_rq(thread, rq, flags);
+}
+
+void evl_detach_statslot(struct evl_thread *thread)
+{
+	struct evl_thread_statslot *slot;
+	unsigned long flags;
+	struct evl_rq *rq;
+
+	rq = evl_get_thread_rq(thread, flags);
+	slot = thread->stat.slot;
+	if (slot) {
+		begin_slot_update(slot);
+		slot->fundle = EVL_NO_HANDLE;
+		slot->pid = 0;
+		end_slot_update(slot);
+		thread->stat.slot = NULL;
+	}
+	evl_put_thread_rq(thread, rq, flags);
+}
+
+/* thread->rq->lock held, irqs off. */
+void evl_update_statslot(struct evl_thread *thread)
+{
+	struct evl_thread_statslot *slot = thread->stat.slot;
+
+	if (slot) {
+		begin_slot_update(slot);
+		fill_slot(slot, thread);
+		end_slot_update(slot);
+	}
+}
+
+int evl_get_statmap_info(struct evl_statmap_info *info)
+{
+	if (statmap == NULL)
+		return -ENOMEM;
+
+	info->nr_slots = CONFIG_EVL_NR_THREADS;
+	info->slot_size = sizeof(struct evl_thread_statslot);
+	info->size = statmap_size;
+
+	return 0;
+}
+
+int evl_mmap_statmap(struct vm_area_struct *vma)
+{
+	if (statmap == NULL)
+		return -ENOMEM;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	return remap_vmalloc_range(vma, statmap, 0);
+}
+
+void __init evl_init_statmap(void)
+{
+	statmap_size = PAGE_ALIGN(CONFIG_EVL_NR_THREADS *
+				sizeof(struct evl_thread_statslot));
+	statmap = vmalloc_user(statmap_size);
+	if (statmap == NULL)
+		printk(EVL_WARNING "cannot allocate thread statistics map\n");
+}
@@ -19,23 +19,83 @@
  * clear at init).
  */
 #define STAX_CLAIMED_BIT BIT(30)
+/* The single thread traversing the section has exclusive access. */
+#define STAX_EXCL_BIT    BIT(29)
+/*
+ * Exclusive access is pending, new threads may not enter the section
+ * until the claimer gets in then leaves it, which bounds its wait to
+ * the time the current holders need to leave the section. This bit
+ * is manipulated exclusively while holding oob_wait.wchan.lock.
+ */
+#define STAX_XCLAIM_BIT  BIT(28)
+
+#define STAX_EXCL_MASK   (STAX_EXCL_BIT|STAX_XCLAIM_BIT)
 
 /* The number of threads currently traversing the section. */
-#define STAX_CONCURRENCY_MASK (~(STAX_INBAND_BIT|STAX_CLAIMED_BIT))
+#define STAX_CONCURRENCY_MASK \
+	(~(STAX_INBAND_BIT|STAX_CLAIMED_BIT|STAX_EXCL_MASK))
 
-static void wakeup_inband_waiters(struct irq_work *work);
+static void wakeup_inband_waiters(struct evl_inband_wakeup *wakeup);
 
-void evl_init_stax(struct evl_stax *stax, int flags)
+void __evl_init_stax(struct evl_stax *stax, int flags,
+		struct evl_lockstat_class *lockstat)
 {
 	atomic_set(&stax->gate, 0);
 	stax->flags = flags;
+	stax->nr_excl_waiters = 0;
+	atomic_set(&stax->oob_contended, 0);
+	atomic_set(&stax->inband_contended, 0);
+	atomic_set(&stax->excl_contended, 0);
 	evl_init_wait(&stax->oob_wait, &evl_mono_clock, EVL_WAIT_FIFO);
 	if (!(flags & EVL_STAX_INBAND_SPIN)) {
 		init_waitqueue_head(&stax->inband_wait);
-		init_irq_work(&stax->irq_work, wakeup_inband_waiters);
+		evl_init_inband_wakeup(&stax->wakeup, wakeup_inband_waiters);
 	}
+#ifdef CONFIG_EVL_LOCKSTAT
+	stax->lockstat = lockstat;
+	stax->lockstat_date = 0;
+	evl_register_lockstat(lockstat);
+#endif
 }
-EXPORT_SYMBOL_GPL(evl_init_stax);
+EXPORT_SYMBOL_GPL(__evl_init_stax);
+
+#ifdef CONFIG_EVL_LOCKSTAT
+
+static inline void account_stax_wait(struct evl_stax *stax,
+				ktime_t start, unsigned long ip)
+{
+	if (start)
+		evl_lockstat_wait(stax->lockstat, start, ip);
+}
+
+/* Exclusive ownership only, shared holders are not timed. */
+static inline void start_stax_hold(struct evl_stax *stax)
+{
+	stax->lockstat_date = evl_lockstat_date();
+}
+
+/* oob_wait.wchan.lock held, irqs off. */
+static inline void stop_stax_hold(struct evl_stax *stax)
+{
+	if (stax->lockstat_date) {
+		evl_lockstat_hold(stax->lockstat, stax->lockstat_date);
+		stax->lockstat_date = 0;
+	}
+}
+
+#else
+
+static inline void account_stax_wait(struct evl_stax *stax,
+				ktime_t start, unsigned long ip)
+{ }
+
+static inline void start_stax_hold(struct evl_stax *stax)
+{ }
+
+static inline void stop_stax_hold(struct evl_stax *stax)
+{ }
+
+#endif
 
 void evl_destroy_stax(struct evl_stax *stax)
 {
@@ -47,9 +107,10 @@ static inline bool oob_may_access(int gateval)
 {
 	/*
 	 * Out-of-band threads may access as long as no in-band thread
-	 * holds the stax.
+	 * holds the stax, and exclusive access is neither granted nor
+	 * pending.
 	 */
-	return !(gateval & STAX_INBAND_BIT);
+	return !(gateval & (STAX_INBAND_BIT|STAX_EXCL_MASK));
 }
 
 static int claim_stax_from_oob(struct evl_stax *stax, int gateval)
@@ -61,6 +122,8 @@ static int claim_stax_from_oob(struct evl_stax *stax, int gateval)
 
 	raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, flags);
 
+	atomic_inc(&stax->oob_contended);
+
 	if (gateval & STAX_CLAIMED_BIT) {
 		prev = atomic_read(&stax->gate);
 		goto check_access;
@@ -74,11 +137,11 @@ static int claim_stax_from_oob(struct evl_stax *stax, int gateval)
 		if (likely(prev == old))
 			break;
 	check_access:
-		if (!(prev & STAX_INBAND_BIT))
+		if (oob_may_access(prev))
 			goto out;
 	} while (!(prev & STAX_CLAIMED_BIT));
 
-	if (curr->state & EVL_T_WOSX)
+	if (prev & STAX_INBAND_BIT && curr->state & EVL_T_WOSX)
 		notify = true;
 
 	do {
@@ -110,17 +173,21 @@ out:
 	return ret;
 }
 
-static int lock_from_oob(struct evl_stax *stax, bool wait)
+static int lock_from_oob(struct evl_stax *stax, bool wait,
+			unsigned long ip)
 {
 	int old, prev, ret = 0;
+	ktime_t wait_start = 0;
 
 	for (;;) {
 		/*
 		 * The inband flag is the sign bit, mask it out in
 		 * arithmetics. In addition, this ensures cmpxchg()
-		 * fails if inband currently owns the section.
+		 * fails if inband currently owns the section, or
+		 * exclusive access is granted or pending.
 		 */
-		old = atomic_read(&stax->gate) & ~STAX_INBAND_BIT;
+		old = atomic_read(&stax->gate) &
+			~(STAX_INBAND_BIT|STAX_EXCL_MASK);
 		prev = atomic_cmpxchg(&stax->gate, old, old + 1);
 		if (prev == old)
 			break;
@@ -134,11 +201,15 @@ static int lock_from_oob(struct evl_stax *stax, bool wait)
 			ret = -EAGAIN;
 			break;
 		}
+		if (!wait_start)
+			wait_start = evl_lockstat_date();
 		ret = claim_stax_from_oob(stax, prev);
 		if (ret)
 			break;
 	}
 
+	account_stax_wait(stax, wait_start, ip);
+
 	return ret;
 }
 
@@ -147,8 +218,11 @@ static inline bool inband_may_access(int gateval)
 	/*
 	 * The section is clear for entry by inband if the concurrency
 	 * value is either zero, or STAX_INBAND_BIT is set in the gate
-	 * mask.
+	 * mask, unless exclusive access is granted or pending.
 	 */
+	if (gateval & STAX_EXCL_MASK)
+		return false;
+
 	return !(gateval & STAX_CONCURRENCY_MASK) ||
 		!!(gateval & STAX_INBAND_BIT);
 }
@@ -169,6 +243,8 @@ static int claim_stax_from_inband(struct evl_stax *stax, int gateval)
 	spin_lock_irqsave(&stax->inband_wait.lock, ib_flags);
 	raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, oob_flags);
 
+	atomic_inc(&stax->inband_contended);
+
 	if (gateval & STAX_CLAIMED_BIT) {
 		prev = atomic_read(&stax->gate);
 		goto check_access;
@@ -182,7 +258,7 @@ static int claim_stax_from_inband(struct evl_stax *stax, int gateval)
 		if (likely(prev == old))
 			break;
 	check_access:
-		if (prev & STAX_INBAND_BIT)
+		if (inband_may_access(prev))
 			goto out;
 	} while (!(prev & STAX_CLAIMED_BIT));
 
@@ -223,12 +299,15 @@ out:
 	return ret;
 }
 
-static int lock_from_inband(struct evl_stax *stax, bool wait)
+static int lock_from_inband(struct evl_stax *stax, bool wait,
+			unsigned long ip)
 {
 	int old, prev, new, ret = 0;
+	ktime_t wait_start = 0;
 
 	for (;;) {
-		old = atomic_read(&stax->gate);
+		/* Make cmpxchg() fail if exclusive access is involved. */
+		old = atomic_read(&stax->gate) & ~STAX_EXCL_MASK;
 		/*
 		 * If oob currently owns the stax, we have
 		 * STAX_INBAND_BIT clear and at least one thread is
@@ -260,11 +339,15 @@ static int lock_from_inband(struct evl_stax *stax, bool wait)
 			ret = -EAGAIN;
 			break;
 		}
+		if (!wait_start)
+			wait_start = evl_lockstat_date();
 		ret = claim_stax_from_inband(stax, prev);
 		if (ret)
 			break;
 	}
 
+	account_stax_wait(stax, wait_start, ip);
+
 	return ret;
 }
 
@@ -273,24 +356,220 @@ int evl_lock_stax(struct evl_stax *stax)
 	EVL_WARN_ON(CORE, evl_in_irq());
 
 	if (running_inband())
-		return lock_from_inband(stax, true);
+		return lock_from_inband(stax, true, _RET_IP_);
 
-	return lock_from_oob(stax, true);
+	return lock_from_oob(stax, true, _RET_IP_);
 }
 EXPORT_SYMBOL_GPL(evl_lock_stax);
 
 int evl_trylock_stax(struct evl_stax *stax)
 {
 	if (running_inband())
-		return lock_from_inband(stax, false);
+		return lock_from_inband(stax, false, _RET_IP_);
 
-	return lock_from_oob(stax, false);
+	return lock_from_oob(stax, false, _RET_IP_);
 }
 EXPORT_SYMBOL_GPL(evl_trylock_stax);
 
-static void wakeup_inband_waiters(struct irq_work *work)
+/* oob_wait.wchan.lock held, irqs off. */
+static void claim_excl(struct evl_stax *stax)
+{
+	stax->nr_excl_waiters++;
+	atomic_or(STAX_XCLAIM_BIT, &stax->gate);
+}
+
+/* oob_wait.wchan.lock held, irqs off. */
+static void abort_excl(struct evl_stax *stax)
+{
+	if (--stax->nr_excl_waiters == 0)
+		atomic_andnot(STAX_XCLAIM_BIT, &stax->gate);
+}
+
+/* oob_wait.wchan.lock held, irqs off. */
+static bool grab_excl(struct evl_stax *stax, int stage_bit)
+{
+	int old, new, prev;
+
+	prev = atomic_read(&stax->gate);
+	do {
+		if (prev & STAX_CONCURRENCY_MASK)
+			return false;
+		old = prev;
+		/* Keep the exclusive claim for the next waiter in line. */
+		new = (old & STAX_CLAIMED_BIT) | STAX_EXCL_BIT | stage_bit | 1;
+		if (stax->nr_excl_waiters > 1)
+			new |= STAX_XCLAIM_BIT;
+		prev = atomic_cmpxchg(&stax->gate, old, new);
+	} while (prev != old);
+
+	stax->nr_excl_waiters--;
+
+	return true;
+}
+
+/* No lock held. */
+static void wakeup_all_waiters(struct evl_stax *stax)
+{
+	evl_flush_wait(&stax->oob_wait, 0);
+
+	if (!(stax->flags & EVL_STAX_INBAND_SPIN)) {
+		if (running_inband())
+			wake_up_all(&stax->inband_wait);
+		else
+			evl_queue_inband_wakeup(&stax->wakeup);
+	}
+
+	evl_schedule();
+}
+
+static int lock_excl_from_oob(struct evl_stax *stax)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, flags);
+
+	claim_excl(stax);
+
+	while (!grab_excl(stax, 0)) {
+		evl_add_wait_queue(&stax->oob_wait, EVL_INFINITE, EVL_REL);
+		raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock, flags);
+		ret = evl_wait_schedule(&stax->oob_wait);
+		raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, flags);
+		if (ret) {
+			abort_excl(stax);
+			break;
+		}
+	}
+
+	raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock, flags);
+
+	/* Threads held back by our claim might be allowed in now. */
+	if (ret)
+		wakeup_all_waiters(stax);
+
+	return ret;
+}
+
+static int lock_excl_from_inband(struct evl_stax *stax)
+{
+	unsigned long ib_flags, oob_flags;
+	struct wait_queue_entry wq_entry;
+	int ret = 0;
+
+	if (stax->flags & EVL_STAX_INBAND_SPIN) {
+		raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, oob_flags);
+		claim_excl(stax);
+		while (!grab_excl(stax, STAX_INBAND_BIT)) {
+			raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock,
+						oob_flags);
+			cpu_relax();
+			raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock,
+					oob_flags);
+		}
+		raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock, oob_flags);
+		return 0;
+	}
+
+	init_wait_entry(&wq_entry, 0);
+
+	/* Same locking sequence as claim_stax_from_inband(). */
+	spin_lock_irqsave(&stax->inband_wait.lock, ib_flags);
+	raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, oob_flags);
+
+	claim_excl(stax);
+
+	for (;;) {
+		if (list_empty(&wq_entry.entry))
+			__add_wait_queue(&stax->inband_wait, &wq_entry);
+
+		if (grab_excl(stax, STAX_INBAND_BIT))
+			break;
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock, oob_flags);
+		spin_unlock_irqrestore(&stax->inband_wait.lock, ib_flags);
+		schedule();
+		spin_lock_irqsave(&stax->inband_wait.lock, ib_flags);
+		raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, oob_flags);
+
+		if (signal_pending(current)) {
+			abort_excl(stax);
+			ret = -ERESTARTSYS;
+			break;
+		}
+	}
+
+	list_del(&wq_entry.entry);
+
+	raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock, oob_flags);
+	spin_unlock_irqrestore(&stax->inband_wait.lock, ib_flags);
+
+	if (ret)
+		wakeup_all_waiters(stax);
+
+	return ret;
+}
+
+static int lock_excl(struct evl_stax *stax, bool wait, unsigned long ip)
 {
-	struct evl_stax *stax = container_of(work, struct evl_stax, irq_work);
+	bool inband = running_inband();
+	ktime_t wait_start;
+	int new, ret;
+
+	/* Fast path: nobody holds, claims or waits for the stax. */
+	new = STAX_EXCL_BIT | (inband ? STAX_INBAND_BIT : 0) | 1;
+	if (atomic_cmpxchg(&stax->gate, 0, new) == 0) {
+		start_stax_hold(stax);
+		return 0;
+	}
+
+	if (!wait)
+		return -EAGAIN;
+
+	atomic_inc(&stax->excl_contended);
+	wait_start = evl_lockstat_date();
+
+	if (inband)
+		ret = lock_excl_from_inband(stax);
+	else
+		ret = lock_excl_from_oob(stax);
+
+	account_stax_wait(stax, wait_start, ip);
+	if (!ret)
+		start_stax_hold(stax);
+
+	return ret;
+}
+
+/**
+ * evl_lock_stax_excl - enter the section exclusively
+ * @stax: the stax to lock
+ *
+ * Unlike evl_lock_stax() which admits any number of threads running
+ * on the same stage, this call excludes all other threads from the
+ * section. New threads are held back while the caller waits for the
+ * current ones to leave the section, so that a stream of concurrent
+ * threads cannot starve it. Exclusive access may be requested from
+ * either stage, but never while holding the stax already.
+ */
+int evl_lock_stax_excl(struct evl_stax *stax)
+{
+	EVL_WARN_ON(CORE, evl_in_irq());
+
+	return lock_excl(stax, true, _RET_IP_);
+}
+EXPORT_SYMBOL_GPL(evl_lock_stax_excl);
+
+int evl_trylock_stax_excl(struct evl_stax *stax)
+{
+	return lock_excl(stax, false, _RET_IP_);
+}
+EXPORT_SYMBOL_GPL(evl_trylock_stax_excl);
+
+static void wakeup_inband_waiters(struct evl_inband_wakeup *wakeup)
+{
+	struct evl_stax *stax = container_of(wakeup, struct evl_stax, wakeup);
 
 	wake_up_all(&stax->inband_wait);
 }
@@ -299,13 +578,14 @@ static bool oob_unlock_sane(int gateval)
 {
 	return !EVL_WARN_ON(CORE,
 			!(gateval & STAX_CONCURRENCY_MASK) ||
-			gateval & STAX_INBAND_BIT);
+			gateval & (STAX_INBAND_BIT|STAX_EXCL_BIT));
 }
 
 static void unlock_from_oob(struct evl_stax *stax)
 {
 	unsigned long flags;
 	int old, prev, new;
+	bool xclaimed;
 
 	/*
 	 * Try the fast path: non-contended (unclaimed by inband,
@@ -313,12 +593,12 @@ static void unlock_from_oob(struct evl_stax *stax)
 	 */
 	prev = atomic_read(&stax->gate);
 
-	while (!(prev & STAX_CLAIMED_BIT)) {
+	while (!(prev & (STAX_CLAIMED_BIT|STAX_XCLAIM_BIT))) {
 		old = prev;
 		if (unlikely(!oob_unlock_sane(old)))
 			return;
 		/* Force slow path if claimed. */
-		old &= ~STAX_CLAIMED_BIT;
+		old &= ~(STAX_CLAIMED_BIT|STAX_XCLAIM_BIT);
 		new = old - 1;
 		prev = atomic_cmpxchg(&stax->gate, old, new);
 		if (prev == old)
@@ -327,7 +607,8 @@ static void unlock_from_oob(struct evl_stax *stax)
 
 	/*
 	 * stax is claimed by inband (which is therefore NOT
-	 * spinning), we have to take the slow path under lock.
+	 * spinning), or exclusive access is pending, we have to take
+	 * the slow path under lock.
 	 */
 	raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, flags);
 
@@ -339,33 +620,43 @@ static void unlock_from_oob(struct evl_stax *stax)
 		prev = atomic_cmpxchg(&stax->gate, old, new);
 	} while (prev != old);
 
+	/* Last one out lets the exclusive claimer in. */
+	xclaimed = !(new & STAX_CONCURRENCY_MASK) && new & STAX_XCLAIM_BIT;
+	if (xclaimed)
+		evl_flush_wait_locked(&stax->oob_wait, 0);
+
 	raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock, flags);
 
-	if (!(new & STAX_CONCURRENCY_MASK))
-		irq_work_queue(&stax->irq_work);
+	if (!(new & STAX_CONCURRENCY_MASK) &&
+		!(stax->flags & EVL_STAX_INBAND_SPIN))
+		evl_queue_inband_wakeup(&stax->wakeup);
+
+	if (xclaimed)
+		evl_schedule();
 }
 
 static inline bool inband_unlock_sane(int gateval)
 {
 	return !EVL_WARN_ON(CORE,
 			!(gateval & STAX_CONCURRENCY_MASK) ||
-			!(gateval & STAX_INBAND_BIT));
+			!(gateval & STAX_INBAND_BIT) ||
+			gateval & STAX_EXCL_BIT);
 }
 
 static void unlock_from_inband(struct evl_stax *stax)
 {
 	unsigned long flags;
-	int old, prev, new;
+	int old, prev, new = 0;
 
 	/* Try the fast path: non-contended (unclaimed by oob). */
 	prev = atomic_read(&stax->gate);
 
-	while (!(prev & STAX_CLAIMED_BIT)) {
+	while (!(prev & (STAX_CLAIMED_BIT|STAX_XCLAIM_BIT))) {
 		old = prev;
 		if (unlikely(!inband_unlock_sane(old)))
 			return;
 		/* Force slow path if claimed. */
-		old &= ~STAX_CLAIMED_BIT;
+		old &= ~(STAX_CLAIMED_BIT|STAX_XCLAIM_BIT);
 		new = (old & ~STAX_INBAND_BIT) - 1;
 		if (new & STAX_CONCURRENCY_MASK)
 			new |= STAX_INBAND_BIT;
@@ -375,8 +666,9 @@ static void unlock_from_inband(struct evl_stax *stax)
 	}
 
 	/*
-	 * Converse to unlock_from_oob(): stax is claimed by oob, we
-	 * have to take the slow path under lock.
+	 * Converse to unlock_from_oob(): stax is claimed by oob, or
+	 * exclusive access is pending, we have to take the slow path
+	 * under lock.
 	 */
 	raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, flags);
 
@@ -395,6 +687,11 @@ static void unlock_from_inband(struct evl_stax *stax)
 out:
 	raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock, flags);
 
+	/* Last one out lets the exclusive claimer in. */
+	if (!(new & STAX_CONCURRENCY_MASK) && new & STAX_XCLAIM_BIT &&
+		!(stax->flags & EVL_STAX_INBAND_SPIN))
+		wake_up_all(&stax->inband_wait);
+
 	evl_schedule();
 }
 
@@ -408,3 +705,41 @@ void evl_unlock_stax(struct evl_stax *stax)
 		unlock_from_oob(stax);
 }
 EXPORT_SYMBOL_GPL(evl_unlock_stax);
+
+void evl_unlock_stax_excl(struct evl_stax *stax)
+{
+	unsigned long flags;
+	int old, prev;
+
+	EVL_WARN_ON(CORE, evl_in_irq());
+
+	raw_spin_lock_irqsave(&stax->oob_wait.wchan.lock, flags);
+
+	stop_stax_hold(stax);
+
+	prev = atomic_read(&stax->gate);
+	do {
+		old = prev;
+		if (EVL_WARN_ON(CORE, !(old & STAX_EXCL_BIT))) {
+			raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock,
+						flags);
+			return;
+		}
+		/* Pending claims remain. */
+		prev = atomic_cmpxchg(&stax->gate, old,
+				old & (STAX_CLAIMED_BIT|STAX_XCLAIM_BIT));
+	} while (prev != old);
+
+	raw_spin_unlock_irqrestore(&stax->oob_wait.wchan.lock, flags);
+
+	wakeup_all_waiters(stax);
+}
+EXPORT_SYMBOL_GPL(evl_unlock_stax_excl);
+
+void evl_get_stax_stats(struct evl_stax *stax, struct evl_stax_stats *stats)
+{
+	stats->oob_contended = atomic_read(&stax->oob_contended);
+	stats->inband_contended = atomic_read(&stax->inband_contended);
+	stats->excl_contended = atomic_read(&stax->excl_contended);
+}
+EXPORT_SYMBOL_GPL(evl_get_stax_stats);
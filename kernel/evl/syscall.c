@@ -18,8 +18,12 @@
 #include <linux/prctl.h>
 #include <linux/sched/task_stack.h>
 #include <linux/sched/signal.h>
+#include <linux/compat.h>
+#include <linux/time.h>
 #include <evl/thread.h>
 #include <evl/sched.h>
+#include <evl/clock.h>
+#include <evl/flightrec.h>
 #include <asm/syscall.h>
 #include <uapi/evl/syscall-abi.h>
 #include <asm/evl/syscall.h>
@@ -108,6 +112,39 @@ static EVL_SYSCALL(ioctl, (int fd, unsigned int request, unsigned long arg))
 	return ret;
 }
 
+static EVL_SYSCALL(batch, (struct evl_oob_op __user *u_ops, int nr))
+{
+	struct evl_thread *curr = evl_current();
+	struct evl_oob_op op;
+	int n;
+
+	if (nr < 0)
+		return -EINVAL;
+
+	for (n = 0; n < nr; n++) {
+		if (raw_copy_from_user(&op, u_ops + n, sizeof(op)))
+			return n ?: -EFAULT;
+
+		op.result = EVL_ioctl((int)op.fd, op.request,
+				(unsigned long)op.arg);
+
+		if (raw_put_user(op.result, &u_ops[n].result))
+			return -EFAULT;
+
+		/*
+		 * The remaining requests have to be issued from the
+		 * oob stage, with no signal pending. Let the common
+		 * code handle the latter.
+		 */
+		if (op.result < 0 || evl_is_inband() ||
+			signal_pending(current) ||
+			(curr->info & EVL_T_KICKED))
+			return n + 1;
+	}
+
+	return nr;
+}
+
 #define __EVL_CALL_NAME(__name)  \
 	[sys_evl_ ## __name] = #__name
 
@@ -115,6 +152,7 @@ static const char *evl_sysnames[] = {
 	   __EVL_CALL_NAME(read),
 	   __EVL_CALL_NAME(write),
 	   __EVL_CALL_NAME(ioctl),
+	   __EVL_CALL_NAME(batch),
 };
 
 #define SYSCALL_PROPAGATE   0
@@ -148,6 +186,10 @@ void invoke_syscall(unsigned int nr, struct pt_regs *regs,
 				(unsigned int)args[1],
 				args[2]);
 		break;
+	case sys_evl_batch:
+		ret = EVL_batch((struct evl_oob_op __user *)args[0],
+				(int)args[1]);
+		break;
 	}
 
 	error = IS_ERR_VALUE(ret) ? ret : 0;
@@ -194,21 +236,37 @@ static void prepare_for_signal(struct task_struct *p,
 	evl_switch_inband(EVL_HMDIAG_SIGDEMOTE);
 }
 
+static bool get_fallback_clock(int clock_id, struct evl_clock **clockp)
+{
+	switch (clock_id) {
+	case CLOCK_MONOTONIC:
+	case CLOCK_MONOTONIC_COARSE:
+		*clockp = &evl_mono_clock;
+		return true;
+	case CLOCK_REALTIME:
+	case CLOCK_REALTIME_COARSE:
+		*clockp = &evl_realtime_clock;
+		return true;
+	default:
+		return false;
+	}
+}
+
 /*
  * Intercepting __NR_clock_gettime (or __NR_clock_gettime64 on 32bit
  * archs) here means that we are handling a fallback syscall for
  * clock_gettime*() from the vDSO, which failed performing a direct
  * access to the clocksource.  Such fallback would involve a switch to
  * in-band mode unless we provide the service directly from here,
- * which is not optimal but still correct.
+ * which is not optimal but still correct. The coarse clocks are
+ * served with the precise readings.
  */
-static bool handle_vdso_fallback(struct pt_regs *regs, unsigned int nr,
-				unsigned long *args)
+static bool fallback_clock_gettime(unsigned int nr, unsigned long *args,
+				long *retp)
 {
 	struct __kernel_old_timespec __user *u_old_ts;
 	struct __kernel_timespec uts, __user *u_uts;
 	struct __kernel_old_timespec old_ts;
-	int clock_id, ret = 0, error;
 	struct evl_clock *clock;
 	struct timespec64 ts64;
 
@@ -219,46 +277,161 @@ static bool handle_vdso_fallback(struct pt_regs *regs, unsigned int nr,
 #define is_clock_gettime64(__nr) ((__nr) == __NR_clock_gettime64)
 #endif
 
-	if (!is_clock_gettime(nr) && !is_clock_gettime64(nr))
-		return false;
-
-	clock_id = (int)args[0];
-	switch (clock_id) {
-	case CLOCK_MONOTONIC:
-		clock = &evl_mono_clock;
-		break;
-	case CLOCK_REALTIME:
-		clock = &evl_realtime_clock;
-		break;
-	default:
+	if (!get_fallback_clock((int)args[0], &clock))
 		return false;
-	}
 
 	ts64 = ktime_to_timespec64(evl_read_clock(clock));
+	*retp = 0;
 
 	if (is_clock_gettime(nr)) {
 		old_ts.tv_sec = (__kernel_old_time_t)ts64.tv_sec;
 		old_ts.tv_nsec = ts64.tv_nsec;
 		u_old_ts = (struct __kernel_old_timespec __user *)args[1];
 		if (raw_copy_to_user(u_old_ts, &old_ts, sizeof(old_ts)))
-			ret = -EFAULT;
+			*retp = -EFAULT;
 	} else if (is_clock_gettime64(nr)) {
 		uts.tv_sec = ts64.tv_sec;
 		uts.tv_nsec = ts64.tv_nsec;
 		u_uts = (struct __kernel_timespec __user *)args[1];
 		if (raw_copy_to_user(u_uts, &uts, sizeof(uts)))
-			ret = -EFAULT;
+			*retp = -EFAULT;
 	}
 
-	error = IS_ERR_VALUE((long)ret) ? ret : 0;
-	syscall_set_return_value(current, regs, error, ret);
-
 #undef is_clock_gettime
 #undef is_clock_gettime64
 
 	return true;
 }
 
+/*
+ * Serve [clock_]nanosleep() with evl_delay(), for the variants
+ * passing a struct __kernel_timespec only. The request may not be
+ * restarted, -EINTR is returned instead along with the remaining
+ * time if a signal is pending on wakeup.
+ */
+static bool fallback_nanosleep(struct evl_thread *curr, int clock_id,
+			int flags, struct __kernel_timespec __user *u_req,
+			struct __kernel_timespec __user *u_rem, long *retp)
+{
+	struct __kernel_timespec uts;
+	enum evl_tmode tmode;
+	struct evl_clock *clock;
+	struct timespec64 ts64;
+	ktime_t timeout, rem;
+
+	if (!get_fallback_clock(clock_id, &clock))
+		return false;
+
+	if (raw_copy_from_user(&uts, u_req, sizeof(uts))) {
+		*retp = -EFAULT;
+		return true;
+	}
+
+	if (uts.tv_sec < 0 || (unsigned long)uts.tv_nsec >= ONE_BILLION) {
+		*retp = -EINVAL;
+		return true;
+	}
+
+	ts64.tv_sec = uts.tv_sec;
+	ts64.tv_nsec = uts.tv_nsec;
+	timeout = timespec64_to_ktime(ts64);
+	*retp = 0;
+
+	/* A null timeout means infinite to EVL. */
+	if (timeout == 0)
+		return true;
+
+	tmode = flags & TIMER_ABSTIME ? EVL_ABS : EVL_REL;
+	curr->local_info |= EVL_T_NORST;
+	rem = evl_delay(timeout, tmode, clock);
+	/* prepare_for_signal() consumes EVL_T_NORST otherwise. */
+	if (!signal_pending(current))
+		curr->local_info &= ~EVL_T_NORST;
+	if (!rem)
+		return true;
+
+	*retp = -EINTR;
+	if (u_rem && tmode == EVL_REL) {
+		ts64 = ktime_to_timespec64(rem);
+		uts.tv_sec = ts64.tv_sec;
+		uts.tv_nsec = ts64.tv_nsec;
+		if (raw_copy_to_user(u_rem, &uts, sizeof(uts)))
+			*retp = -EFAULT;
+	}
+
+	return true;
+}
+
+/*
+ * A few in-band syscalls are cheap enough to be served directly from
+ * the oob stage, sparing the caller a stage switch. This is mostly
+ * useful to legacy code linked to EVL applications. Return true if
+ * the syscall was handled.
+ */
+static bool handle_oob_fallback(struct pt_regs *regs, unsigned int nr,
+				unsigned long *args)
+{
+	struct evl_thread *curr = evl_current();
+	long ret;
+	int error;
+
+	/* Syscall numbers differ for compat tasks. */
+	if (in_compat_syscall())
+		return false;
+
+	switch (nr) {
+	case __NR_getpid:
+		ret = task_tgid_vnr(current);
+		break;
+	case __NR_gettid:
+		ret = task_pid_vnr(current);
+		break;
+	case __NR_sched_yield:
+		evl_release_thread(curr, 0, 0);
+		evl_schedule();
+		ret = 0;
+		break;
+	case __NR_clock_gettime:
+#ifdef __NR_clock_gettime64
+	case __NR_clock_gettime64:
+#endif
+		if (!fallback_clock_gettime(nr, args, &ret))
+			return false;
+		break;
+#ifdef CONFIG_64BIT
+#ifdef __NR_nanosleep
+	case __NR_nanosleep:
+		if (!fallback_nanosleep(curr, CLOCK_MONOTONIC, 0,
+				(struct __kernel_timespec __user *)args[0],
+				(struct __kernel_timespec __user *)args[1],
+				&ret))
+			return false;
+		break;
+#endif
+	case __NR_clock_nanosleep:
+#else
+	case __NR_clock_nanosleep_time64:
+#endif
+		if (!fallback_nanosleep(curr, (int)args[0], (int)args[1],
+				(struct __kernel_timespec __user *)args[2],
+				(struct __kernel_timespec __user *)args[3],
+				&ret))
+			return false;
+		break;
+	default:
+		return false;
+	}
+
+	error = IS_ERR_VALUE(ret) ? ret : 0;
+	syscall_set_return_value(current, regs, error, ret);
+
+	/* We might have been kicked while sleeping. */
+	if (signal_pending(current) || (curr->info & EVL_T_KICKED))
+		prepare_for_signal(current, curr, regs);
+
+	return true;
+}
+
 static int do_oob_syscall(struct irq_stage *stage, struct pt_regs *regs,
 			unsigned int scno, unsigned long *args, bool is_evlsc)
 {
@@ -292,6 +465,7 @@ static int do_oob_syscall(struct irq_stage *stage, struct pt_regs *regs,
 		return SYSCALL_PROPAGATE;
 
 	trace_evl_oob_sysentry(scno);
+	evl_flightrec(EVL_FLTREC_SYSENTRY, task_pid_nr(tsk), scno, 0);
 
 	invoke_syscall(scno, regs, args);
 
@@ -309,6 +483,8 @@ static int do_oob_syscall(struct irq_stage *stage, struct pt_regs *regs,
 	evl_sync_uwindow(curr);
 
 	trace_evl_oob_sysexit(syscall_get_return_value(tsk, regs));
+	evl_flightrec(EVL_FLTREC_SYSEXIT, task_pid_nr(tsk),
+		syscall_get_return_value(tsk, regs), 0);
 
 	return SYSCALL_STOP;
 
@@ -324,9 +500,10 @@ do_inband:
 	 * propagating the syscall down the pipeline.
 	 */
 	if (is_valid_inband_syscall(scno)) {
-		if (handle_vdso_fallback(regs, scno, args))
+		if (handle_oob_fallback(regs, scno, args))
 			return SYSCALL_STOP;
-		evl_switch_inband(EVL_HMDIAG_SYSDEMOTE);
+		evl_switch_inband_details(EVL_HMDIAG_SYSDEMOTE,
+					evl_intval(scno));
 		return SYSCALL_PROPAGATE;
 	}
 
@@ -411,6 +588,23 @@ done:
 	return SYSCALL_STOP;
 }
 
+/*
+ * Since ABI 36, we recognize EVL requests only when folded into a
+ * prctl() call, such as prctl(PR_OOB_SYSCALL, @nr, args...). Fetch
+ * the EVL syscall number then shift the arguments left to skip it
+ * (3 arguments max).
+ */
+static __always_inline void fetch_evl_syscall_args(struct pt_regs *regs,
+						unsigned long *args,
+						unsigned int *scno)
+{
+	syscall_get_arguments(current, regs, args);
+	*scno = args[1];
+	args[0] = args[2];
+	args[1] = args[3];
+	args[2] = args[4];
+}
+
 static bool collect_syscall_args(struct pt_regs *regs,
 				unsigned long *args,
 				unsigned int *scno)
@@ -418,28 +612,18 @@ static bool collect_syscall_args(struct pt_regs *regs,
 	struct task_struct *tsk = current;
 
 	/*
-	 * We'll need the arguments later on for handling either of
-	 * inband or evl syscalls.
+	 * Assume this is an in-band syscall unless it bears the EVL
+	 * signature, so leave the argument vector unchanged. We'll
+	 * need the arguments later on for handling either of inband
+	 * or evl syscalls.
 	 */
-	syscall_get_arguments(tsk, regs, args);
-
 	if (!in_oob_syscall(regs)) {
+		syscall_get_arguments(tsk, regs, args);
 		*scno = syscall_get_nr(tsk, regs);
 		return false;
 	}
 
-	/*
-	 * Since ABI 36, we recognize EVL requests only when folded
-	 * into a prctl() call, such as prctl(PR_OOB_SYSCALL, @nr,
-	 * args...). If so, fetch the EVL syscall number then shift
-	 * the arguments left to skip it (3 arguments max).
-	 * Otherwise, assume this is an in-band syscall, so leave the
-	 * argument vector unchanged.
-	 */
-	*scno = args[1];
-	args[0] = args[2];
-	args[1] = args[3];
-	args[2] = args[4];
+	fetch_evl_syscall_args(regs, args, scno);
 
 	return true;
 }
@@ -458,15 +642,20 @@ int handle_pipelined_syscall(struct irq_stage *stage, struct pt_regs *regs)
 	return do_oob_syscall(stage, regs, scno, args, is_evlsc);
 }
 
+/*
+ * Fast path for oob syscalls issued by threads running out-of-band:
+ * Dovetail calls us directly from the syscall entry, without going
+ * through the pipeline stages, once it has matched the EVL call
+ * signature. Do not check the signature a second time.
+ */
 int handle_oob_syscall(struct pt_regs *regs)
 {
-	unsigned long args[6] = { 0 };
+	unsigned long args[6];
 	unsigned int scno;
-	bool is_evlsc;
 	int ret;
 
-	is_evlsc = collect_syscall_args(regs, args, &scno);
-	ret = do_oob_syscall(&oob_stage, regs, scno, args, is_evlsc);
+	fetch_evl_syscall_args(regs, args, &scno);
+	ret = do_oob_syscall(&oob_stage, regs, scno, args, true);
 	EVL_WARN_ON(CORE, ret == SYSCALL_PROPAGATE); /* Keep me there! */
 
 	return ret;
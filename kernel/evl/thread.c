@@ -8,6 +8,7 @@
 
 #include <linux/stdarg.h>
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
 #include <linux/slab.h>
@@ -23,6 +24,11 @@
 #include <linux/ptrace.h>
 #include <linux/math64.h>
 #include <linux/cn_proc.h>
+#include <linux/uaccess.h>
+#include <linux/sched/task_stack.h>
+#include <linux/mm.h>
+#include <linux/workqueue.h>
+#include <linux/bitmap.h>
 #include <evl/assert.h>
 #include <evl/thread.h>
 #include <evl/memory.h>
@@ -32,10 +38,20 @@
 #include <evl/flag.h>
 #include <evl/factory.h>
 #include <evl/observable.h>
+#include <evl/period.h>
 #include <evl/uaccess.h>
 #include <evl/lock.h>
+#include <evl/flightrec.h>
+#include <evl/statmap.h>
+#include <evl/rseq.h>
+#include <evl/uio.h>
 #include <uapi/linux/sched/types.h>
+#include <uapi/evl/control-abi.h>
 #include <trace/events/evl.h>
+#ifdef CONFIG_EVL_RESCTRL
+#include <linux/resctrl.h>
+#include <asm/resctrl.h>
+#endif
 
 #define EVL_THREAD_CLONE_FLAGS	\
 	(EVL_CLONE_PUBLIC|EVL_CLONE_OBSERVABLE|EVL_CLONE_UNICAST)
@@ -141,6 +157,9 @@ static void pin_to_initial_cpu(struct evl_thread *thread)
 	if (!cpumask_test_cpu(cpu, &thread->affinity))
 		cpu = cpumask_first(&thread->affinity);
 
+	/* Then honor the capacity hint if need be. */
+	cpu = evl_select_capacity_cpu(thread, cpu);
+
 	set_cpus_allowed_ptr(p, cpumask_of(cpu));
 	/*
 	 * @thread is still unstarted EVL-wise, we are in the process
@@ -158,6 +177,99 @@ static void pin_to_initial_cpu(struct evl_thread *thread)
 	raw_spin_unlock_irqrestore(&thread->lock, flags);
 }
 
+#ifdef CONFIG_EVL_DEBUG_SWITCH_LOG
+
+#define EVL_SWITCH_LOG_LEN	32
+#define EVL_SWITCH_STACK_WORDS	4
+
+struct evl_switch_record {
+	ktime_t date;
+	int cause;
+	union evl_value details;
+	unsigned long ip;
+	unsigned long stack[EVL_SWITCH_STACK_WORDS];
+};
+
+struct evl_switch_log {
+	hard_spinlock_t lock;
+	unsigned int next;
+	unsigned int count;
+	unsigned long totals[EVL_HMDIAG_BUDGET + 1];
+	struct evl_switch_record records[EVL_SWITCH_LOG_LEN];
+};
+
+static int init_switch_log(struct evl_thread *thread)
+{
+	struct evl_switch_log *log;
+
+	thread->switch_log = NULL;
+	if (!(thread->state & EVL_T_USER))
+		return 0;
+
+	log = kzalloc(sizeof(*log), GFP_KERNEL);
+	if (log == NULL)
+		return -ENOMEM;
+
+	raw_spin_lock_init(&log->lock);
+	thread->switch_log = log;
+
+	return 0;
+}
+
+static void free_switch_log(struct evl_thread *thread)
+{
+	kfree(thread->switch_log);
+	thread->switch_log = NULL;
+}
+
+/*
+ * Called by @curr on the in-band stage, right after it was switched
+ * there unexpectedly. Sample the user stack from the syscall or trap
+ * frame, this is best effort.
+ */
+void evl_log_inband_switch(struct evl_thread *curr,
+			int cause, union evl_value details)
+{
+	struct evl_switch_log *log = curr->switch_log;
+	unsigned long stack[EVL_SWITCH_STACK_WORDS] = { 0 };
+	struct pt_regs *regs = task_pt_regs(current);
+	struct evl_switch_record *r;
+	unsigned long flags;
+
+	if (log == NULL || cause <= 0 || cause > EVL_HMDIAG_BUDGET)
+		return;
+
+	if (copy_from_user_nofault(stack,
+			(void __user *)user_stack_pointer(regs),
+			sizeof(stack)))
+		memset(stack, 0, sizeof(stack));
+
+	raw_spin_lock_irqsave(&log->lock, flags);
+	r = log->records + log->next;
+	r->date = evl_read_clock(&evl_mono_clock);
+	r->cause = cause;
+	r->details = details;
+	r->ip = instruction_pointer(regs);
+	memcpy(r->stack, stack, sizeof(r->stack));
+	log->next = (log->next + 1) % EVL_SWITCH_LOG_LEN;
+	if (log->count < EVL_SWITCH_LOG_LEN)
+		log->count++;
+	log->totals[cause]++;
+	raw_spin_unlock_irqrestore(&log->lock, flags);
+}
+
+#else
+
+static inline int init_switch_log(struct evl_thread *thread)
+{
+	return 0;
+}
+
+static inline void free_switch_log(struct evl_thread *thread)
+{ }
+
+#endif	/* !CONFIG_EVL_DEBUG_SWITCH_LOG */
+
 int evl_init_thread(struct evl_thread *thread,
 		const struct evl_init_thread_attr *iattr,
 		struct evl_rq *rq,
@@ -210,6 +322,14 @@ int evl_init_thread(struct evl_thread *thread,
 	thread->cprio = EVL_IDLE_PRIO;
 	thread->bprio = EVL_IDLE_PRIO;
 	thread->rrperiod = EVL_INFINITE;
+#ifdef CONFIG_EVL_THREAD_BUDGET
+	thread->budget.runtime = 0;
+	thread->budget.action = EVL_BUDGET_NOTIFY;
+#endif
+#ifdef CONFIG_EVL_RESCTRL
+	thread->resctrl.flags = 0;
+#endif
+	evl_init_thread_capacity(thread);
 	thread->wchan = NULL;
 	thread->wait_data = NULL;
 	thread->u_window = NULL;
@@ -222,6 +342,7 @@ int evl_init_thread(struct evl_thread *thread,
 
 	INIT_LIST_HEAD(&thread->next);
 	INIT_LIST_HEAD(&thread->boosters);
+	RB_CLEAR_NODE(&thread->wait_group);
 	INIT_LIST_HEAD(&thread->owned_mutexes);
 	raw_spin_lock_init(&thread->lock);
 	init_completion(&thread->exited);
@@ -232,9 +353,17 @@ int evl_init_thread(struct evl_thread *thread,
 	evl_init_timer_on_rq(&thread->rtimer, &evl_mono_clock, timeout_handler,
 			rq, gravity);
 	evl_set_timer_name(&thread->rtimer, thread->name);
+	evl_set_timer_class(&thread->rtimer, EVL_TIMER_CLASS_TIMEOUT);
 	evl_init_timer_on_rq(&thread->ptimer, &evl_mono_clock, periodic_handler,
 			rq, gravity);
 	evl_set_timer_name(&thread->ptimer, thread->name);
+	evl_set_timer_class(&thread->ptimer, EVL_TIMER_CLASS_PERIODIC);
+	thread->pgroup.slot = NULL;
+	INIT_LIST_HEAD(&thread->pgroup.next);
+
+	ret = init_switch_log(thread);
+	if (ret)
+		goto err_out;
 
 	thread->base_class = NULL; /* evl_set_thread_policy() sets it. */
 	ret = evl_init_rq_thread(thread);
@@ -266,6 +395,7 @@ err_out:
 	evl_destroy_timer(&thread->rtimer);
 	evl_destroy_timer(&thread->ptimer);
 	trace_evl_init_thread(thread, iattr, ret);
+	free_switch_log(thread);
 	kfree(thread->name);
 
 	return ret;
@@ -293,9 +423,12 @@ static void uninit_thread(struct evl_thread *thread)
 	evl_forget_thread(thread);
 	evl_put_thread_rq(thread, rq, flags);
 
+	evl_detach_statslot(thread);
+
 	if (!(thread->state & EVL_T_ROOT))
 		lockdep_unregister_key(&thread->lock_key);
 
+	free_switch_log(thread);
 	kfree(thread->name);
 }
 
@@ -317,8 +450,18 @@ static void do_cleanup_current(struct evl_thread *curr)
 
 	evl_unindex_factory_element(&curr->element);
 
+	/*
+	 * Unlike user threads, kthread descriptors are not released
+	 * via kfree_rcu(), wait for lookups by fundle to drain.
+	 */
+	if (!(curr->state & EVL_T_USER))
+		synchronize_rcu();
+
+	evl_leave_period_group(curr);
+
 	if (curr->state & EVL_T_USER) {
-		evl_free_chunk(&evl_shared_heap, curr->u_window);
+		evl_free_chunk(curr->u_window_heap, curr->u_window);
+		evl_put_state_heap(curr->u_window_heap);
 		curr->u_window = NULL;
 		evl_drop_poll_table(curr);
 		newcap = prepare_creds();
@@ -385,6 +528,7 @@ static int map_kthread_self(struct evl_kthread *kthread)
 	struct evl_thread *curr = &kthread->thread;
 
 	pin_to_initial_cpu(curr);
+	evl_attach_statslot(curr);
 
 	dovetail_init_altsched(&curr->altsched);
 	set_oob_threadinfo(curr);
@@ -595,6 +739,8 @@ static void evl_wakeup_thread_locked(struct evl_thread *thread,
 		return;
 
 	trace_evl_wakeup_thread(thread, mask, info);
+	evl_flightrec(EVL_FLTREC_WAKEUP, evl_get_inband_pid(thread),
+		mask, info);
 
 	oldstate = thread->state;
 	if (likely(oldstate & mask)) {
@@ -615,6 +761,9 @@ static void evl_wakeup_thread_locked(struct evl_thread *thread,
 		if (!(thread->state & EVL_THREAD_BLOCK_BITS)) {
 			evl_enqueue_thread(thread);
 			thread->state |= EVL_T_READY;
+			/* Current may resume before switching out. */
+			if (thread != rq->curr)
+				evl_mark_ready(&thread->stat.runlat);
 			evl_set_resched(rq);
 			if (rq != this_evl_rq())
 				evl_inc_counter(&thread->stat.rwa);
@@ -632,17 +781,13 @@ void evl_wakeup_thread(struct evl_thread *thread, int mask, int info)
 	evl_put_thread_rq(thread, rq, flags);
 }
 
-void evl_hold_thread(struct evl_thread *thread, int mask)
+/* thread->lock + thread->rq->lock held, irqs off */
+static void evl_hold_thread_locked(struct evl_thread *thread, int mask)
 {
-	unsigned long oldstate, flags;
-	struct evl_rq *rq;
-
-	if (EVL_WARN_ON(CORE, mask & ~(EVL_T_SUSP|EVL_T_HALT|EVL_T_DORMANT)))
-		return;
-
-	trace_evl_hold_thread(thread, mask);
+	struct evl_rq *rq = thread->rq;
+	unsigned long oldstate;
 
-	rq = evl_get_thread_rq(thread, flags);
+	assert_thread_pinned(thread);
 
 	oldstate = thread->state;
 
@@ -655,7 +800,7 @@ void evl_hold_thread(struct evl_thread *thread, int mask)
 		if (thread->info & EVL_T_KICKED) {
 			thread->info &= ~(EVL_T_RMID|EVL_T_TIMEO);
 			thread->info |= EVL_T_BREAK;
-			goto out;
+			return;
 		}
 		if (thread == rq->curr)
 			thread->info &= ~EVL_THREAD_INFO_MASK;
@@ -680,7 +825,20 @@ void evl_hold_thread(struct evl_thread *thread, int mask)
 		evl_set_resched(rq);
 	else if (((oldstate & (EVL_THREAD_BLOCK_BITS|EVL_T_USER)) == (EVL_T_INBAND|EVL_T_USER)))
 		dovetail_request_ucall(thread->altsched.task);
- out:
+}
+
+void evl_hold_thread(struct evl_thread *thread, int mask)
+{
+	unsigned long flags;
+	struct evl_rq *rq;
+
+	if (EVL_WARN_ON(CORE, mask & ~(EVL_T_SUSP|EVL_T_HALT|EVL_T_DORMANT)))
+		return;
+
+	trace_evl_hold_thread(thread, mask);
+
+	rq = evl_get_thread_rq(thread, flags);
+	evl_hold_thread_locked(thread, mask);
 	evl_put_thread_rq(thread, rq, flags);
 }
 
@@ -719,6 +877,9 @@ static void evl_release_thread_locked(struct evl_thread *thread,
 	evl_enqueue_thread(thread);
 ready:
 	thread->state |= EVL_T_READY;
+	/* Yielding is not waiting. */
+	if (thread != rq->curr)
+		evl_mark_ready(&thread->stat.runlat);
 	evl_set_resched(rq);
 	if (rq != this_evl_rq())
 		evl_inc_counter(&thread->stat.rwa);
@@ -734,6 +895,103 @@ void evl_release_thread(struct evl_thread *thread, int mask, int info)
 	evl_put_thread_rq(thread, rq, flags);
 }
 
+/* thread->lock + thread->rq->lock held, irqs off */
+static inline void apply_thread_set_op(struct evl_thread *thread,
+				bool hold, int mask, int info)
+{
+	if (hold) {
+		trace_evl_hold_thread(thread, mask);
+		evl_hold_thread_locked(thread, mask);
+	} else {
+		evl_release_thread_locked(thread, mask, info);
+	}
+}
+
+/*
+ * Apply a hold or release request to a set of threads, grouping them
+ * by runqueue so that each rq lock is taken once, then reschedule in
+ * a single round. Holding the rq lock first inverts the regular
+ * locking order, hence the trylock on the thread lock: a thread
+ * which is contended or migrates meanwhile is handled the regular
+ * way next.
+ */
+static void apply_thread_set(struct evl_thread **threads, int nr,
+			bool hold, int mask, int info)
+{
+	DECLARE_BITMAP(done, EVL_THREAD_SET_MAX);
+	struct evl_thread *thread;
+	unsigned long flags;
+	struct evl_rq *rq;
+	int n, m;
+
+	if (EVL_WARN_ON(CORE, nr > EVL_THREAD_SET_MAX))
+		return;
+
+	bitmap_zero(done, nr);
+
+	for (n = 0; n < nr; n++) {
+		if (test_bit(n, done))
+			continue;
+
+		rq = READ_ONCE(threads[n]->rq);
+		raw_spin_lock_irqsave(&rq->lock, flags);
+
+		for (m = n; m < nr; m++) {
+			thread = threads[m];
+			if (test_bit(m, done) || READ_ONCE(thread->rq) != rq)
+				continue;
+			if (!raw_spin_trylock(&thread->lock))
+				continue;
+			if (thread->rq == rq) {
+				apply_thread_set_op(thread, hold, mask, info);
+				__set_bit(m, done);
+			}
+			raw_spin_unlock(&thread->lock);
+		}
+
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+		if (!test_bit(n, done)) {
+			thread = threads[n];
+			rq = evl_get_thread_rq(thread, flags);
+			apply_thread_set_op(thread, hold, mask, info);
+			evl_put_thread_rq(thread, rq, flags);
+			__set_bit(n, done);
+		}
+	}
+
+	evl_schedule();
+}
+
+/**
+ * evl_hold_thread_set - suspend a set of threads at once.
+ *
+ * Hold every thread in @threads with @mask, in a single locking and
+ * rescheduling round per CPU. No thread may be current.
+ */
+void evl_hold_thread_set(struct evl_thread **threads, int nr, int mask)
+{
+	if (EVL_WARN_ON(CORE, mask & ~(EVL_T_SUSP|EVL_T_HALT)))
+		return;
+
+	apply_thread_set(threads, nr, true, mask, 0);
+}
+
+/**
+ * evl_release_thread_set - resume a set of threads at once.
+ *
+ * Counterpart of evl_hold_thread_set(), clearing @mask for every
+ * thread in @threads.
+ */
+void evl_release_thread_set(struct evl_thread **threads, int nr,
+			int mask, int info)
+{
+	if (EVL_WARN_ON(CORE, mask & ~(EVL_T_SUSP|EVL_T_HALT)))
+		return;
+
+	apply_thread_set(threads, nr, false, mask, info);
+}
+
 static void inband_task_wakeup(struct irq_work *work)
 {
 	struct evl_thread *thread;
@@ -856,6 +1114,8 @@ int evl_set_period(struct evl_clock *clock,
 
 	raw_spin_lock_irqsave(&curr->lock, flags);
 
+	/* A new timeline starts, no release is pending. */
+	evl_mark_release(&curr->stat.resptime, 0);
 	evl_prepare_timed_wait(&curr->ptimer, clock, evl_thread_rq(curr));
 
 	if (timeout_infinite(idate))
@@ -885,6 +1145,9 @@ int evl_wait_period(unsigned long *overruns_r)
 	flags = hard_local_irq_save();
 	clock = curr->ptimer.clock;
 	now = evl_read_clock(clock);
+	/* The work for the current release is complete. */
+	evl_account_resptime(&curr->stat.resptime, now,
+			curr->ptimer.interval);
 	if (likely(now < evl_get_timer_next_date(&curr->ptimer))) {
 		evl_sleep_on(EVL_INFINITE, EVL_REL, clock, NULL); /* EVL_T_WAIT */
 		hard_local_irq_restore(flags);
@@ -895,7 +1158,12 @@ int evl_wait_period(unsigned long *overruns_r)
 		hard_local_irq_restore(flags);
 
 	overruns = evl_get_timer_overruns(&curr->ptimer);
+	/* We are running for the latest release due. */
+	evl_mark_release(&curr->stat.resptime,
+			ktime_sub(evl_get_timer_next_date(&curr->ptimer),
+				curr->ptimer.interval));
 	if (overruns) {
+		evl_count_overruns(&curr->stat.resptime, overruns);
 		if (likely(overruns_r != NULL))
 			*overruns_r = overruns;
 		trace_evl_thread_missed_period(curr);
@@ -1504,6 +1772,7 @@ int activate_oob_mm_state(struct oob_mm_state *p)
 {
 	evl_init_wait(&p->ptsync_barrier, &evl_mono_clock, EVL_WAIT_PRIO);
 	INIT_LIST_HEAD(&p->ptrace_sync);
+	evl_init_ubufs(p);
 	smp_mb__before_atomic();
 	set_bit(EVL_MM_ACTIVE_BIT, &p->flags);
 
@@ -1521,6 +1790,8 @@ static void flush_oob_mm_state(struct oob_mm_state *p)
 	if (test_and_clear_bit(EVL_MM_ACTIVE_BIT, &p->flags)) {
 		EVL_WARN_ON(CORE, !list_empty(&p->ptrace_sync));
 		evl_destroy_wait(&p->ptsync_barrier);
+		evl_drop_ubufs(p);
+		evl_drop_private_heap(p);
 	}
 }
 
@@ -1551,6 +1822,71 @@ static inline void note_trap(struct evl_thread *curr,
 			(void *)instruction_pointer(regs));
 }
 
+#ifdef CONFIG_EVL_OOB_TRAPS
+
+static bool fixup_oob_fpe(struct pt_regs *regs)
+{
+	return user_mode(regs) && evl_fixup_fpe_trap(regs);
+}
+
+static bool fixup_oob_brk(struct pt_regs *regs)
+{
+	/* Debuggers and uprobes need the in-band handler. */
+	if (!user_mode(regs) || (current->ptrace & PT_PTRACED) ||
+		test_bit(MMF_HAS_UPROBES, &current->mm->flags))
+		return false;
+
+	return evl_fixup_brk_trap(regs);
+}
+
+/*
+ * Trap classes we can fully handle on the oob stage: the fixup
+ * routine makes the faulting context restartable, we count the
+ * event then resume without switching in-band. The arch code tells
+ * us which trap numbers match these classes, if any.
+ */
+static const struct evl_oob_trap {
+	unsigned int trapnr;
+	bool (*fixup)(struct pt_regs *regs);
+	const char *msg;
+} oob_traps[] = {
+#ifdef EVL_OOB_TRAP_FPE
+	{ EVL_OOB_TRAP_FPE, fixup_oob_fpe, "FP exception handled out-of-band" },
+#endif
+#ifdef EVL_OOB_TRAP_BRK
+	{ EVL_OOB_TRAP_BRK, fixup_oob_brk, "breakpoint handled out-of-band" },
+#endif
+};
+
+static bool handle_trap_oob(struct evl_thread *curr,
+			unsigned int trapnr, struct pt_regs *regs)
+{
+	const struct evl_oob_trap *t;
+
+	for (t = oob_traps; t < oob_traps + ARRAY_SIZE(oob_traps); t++) {
+		if (t->trapnr != trapnr)
+			continue;
+		if (!t->fixup(regs))
+			return false;
+		evl_inc_counter(&curr->stat.oobtrap);
+		if (EVL_DEBUG(CORE))
+			note_trap(curr, trapnr, regs, t->msg);
+		return true;
+	}
+
+	return false;
+}
+
+#else
+
+static inline bool handle_trap_oob(struct evl_thread *curr,
+			unsigned int trapnr, struct pt_regs *regs)
+{
+	return false;
+}
+
+#endif	/* !CONFIG_EVL_OOB_TRAPS */
+
 /* hard irqs off. */
 void handle_oob_trap_entry(unsigned int trapnr, struct pt_regs *regs)
 {
@@ -1584,6 +1920,9 @@ void handle_oob_trap_entry(unsigned int trapnr, struct pt_regs *regs)
 
 	oob_context_only();
 
+	if (handle_trap_oob(curr, trapnr, regs))
+		return;
+
 	curr->local_info |= EVL_T_INFAULT;
 
 	if (current->ptrace & PT_PTRACED)
@@ -1650,6 +1989,18 @@ void handle_oob_mayday(struct pt_regs *regs)
 	if (EVL_WARN_ON(CORE, !(curr->state & EVL_T_USER)))
 		return;
 
+	/*
+	 * A mayday trap sent for checking a restartable sequence
+	 * only should not demote the thread, unless it was kicked
+	 * meanwhile.
+	 */
+	if (curr->local_info & EVL_T_RSEQ) {
+		curr->local_info &= ~EVL_T_RSEQ;
+		evl_rseq_handle_abort(curr, regs);
+		if (!(curr->info & EVL_T_KICKED))
+			return;
+	}
+
 	/*
 	 * It might happen that a thread gets a mayday trap right
 	 * after it switched to in-band mode while returning from a
@@ -2086,6 +2437,15 @@ static void __get_sched_attrs(struct evl_sched_class *sched_class,
 	}
 #endif
 
+#ifdef CONFIG_EVL_SCHED_EDF
+	if (sched_class == &evl_sched_edf) {
+		attrs->sched_edf_runtime = ktime_to_u_timespec(param.edf.runtime);
+		attrs->sched_edf_period = ktime_to_u_timespec(param.edf.period);
+		attrs->sched_edf_deadline = ktime_to_u_timespec(param.edf.deadline);
+		goto out;
+	}
+#endif
+
 out:
 	trace_evl_thread_getsched(thread, attrs);
 }
@@ -2125,6 +2485,170 @@ void evl_get_thread_state(struct evl_thread *thread,
 }
 EXPORT_SYMBOL_GPL(evl_get_thread_state);
 
+#ifdef CONFIG_EVL_RUNSTATS
+
+static void get_thread_runlat(struct evl_thread *thread,
+			struct evl_thread_runlat *rlbuf)
+{
+	struct evl_runlat *rl = &thread->stat.runlat;
+	unsigned long flags;
+	struct evl_rq *rq;
+	int n;
+
+	rq = evl_get_thread_rq(thread, flags);
+	rlbuf->count = rl->count;
+	rlbuf->total_ns = ktime_to_ns(rl->total);
+	rlbuf->min_ns = ktime_to_ns(rl->min);
+	rlbuf->max_ns = ktime_to_ns(rl->max);
+	for (n = 0; n < EVL_RUNLAT_BUCKETS; n++)
+		rlbuf->hist[n] = rl->hist[n];
+	evl_put_thread_rq(thread, rq, flags);
+}
+
+static void get_thread_resptime(struct evl_thread *thread,
+			struct evl_thread_resptime *rtbuf)
+{
+	struct evl_resptime *rt = &thread->stat.resptime;
+	int n;
+
+	rtbuf->count = READ_ONCE(rt->count);
+	rtbuf->total_ns = ktime_to_ns(READ_ONCE(rt->total));
+	rtbuf->min_ns = ktime_to_ns(READ_ONCE(rt->min));
+	rtbuf->max_ns = ktime_to_ns(READ_ONCE(rt->max));
+	rtbuf->misses = READ_ONCE(rt->misses);
+	rtbuf->overruns = READ_ONCE(rt->overruns);
+	for (n = 0; n < EVL_RESPTIME_BUCKETS; n++)
+		rtbuf->hist[n] = READ_ONCE(rt->hist[n]);
+}
+
+#else
+
+static void get_thread_runlat(struct evl_thread *thread,
+			struct evl_thread_runlat *rlbuf)
+{
+	memset(rlbuf, 0, sizeof(*rlbuf));
+}
+
+static void get_thread_resptime(struct evl_thread *thread,
+			struct evl_thread_resptime *rtbuf)
+{
+	memset(rtbuf, 0, sizeof(*rtbuf));
+}
+
+#endif
+
+#ifdef CONFIG_EVL_THREAD_BUDGET
+
+static int set_thread_budget(struct evl_thread *thread,
+			const struct evl_thread_budget *budget)
+{
+	unsigned long flags;
+	struct evl_rq *rq;
+
+	if (budget->action > EVL_BUDGET_STOP ||
+		budget->runtime_ns > KTIME_MAX)
+		return -EINVAL;
+
+	rq = evl_get_thread_rq(thread, flags);
+
+	thread->budget.runtime = ns_to_ktime(budget->runtime_ns);
+	thread->budget.action = budget->action;
+
+	/*
+	 * A thread running on its CPU is not switched in again before
+	 * it sleeps or gets preempted, so apply the change right away
+	 * in this case, counting its budget from now on.
+	 */
+	if (thread == rq->curr)
+		evl_switch_budget(rq, thread);
+
+	evl_put_thread_rq(thread, rq, flags);
+
+	return 0;
+}
+
+#else
+
+static int set_thread_budget(struct evl_thread *thread,
+			const struct evl_thread_budget *budget)
+{
+	return -EOPNOTSUPP;
+}
+
+#endif
+
+#ifdef CONFIG_EVL_RESCTRL
+
+static int set_thread_resctrl(struct evl_thread *thread,
+			const struct evl_thread_resctrl *rc)
+{
+	unsigned long flags;
+	struct evl_rq *rq;
+
+	if (rc->flags & ~(EVL_RESCTRL_CLOSID|EVL_RESCTRL_RMID))
+		return -EINVAL;
+
+	/* The resctrl filesystem must be mounted. */
+	if (rc->flags & EVL_RESCTRL_CLOSID &&
+		(!resctrl_arch_alloc_capable() ||
+			rc->closid >= closids_supported()))
+		return -EINVAL;
+
+	if (rc->flags & EVL_RESCTRL_RMID &&
+		(!resctrl_arch_mon_capable() ||
+			rc->rmid >= resctrl_arch_system_num_rmid_idx()))
+		return -EINVAL;
+
+	rq = evl_get_thread_rq(thread, flags);
+
+	thread->resctrl.closid = rc->closid;
+	thread->resctrl.rmid = rc->rmid;
+	thread->resctrl.flags = rc->flags;
+
+	/* Reload the PQR settings if @thread runs oob on this CPU. */
+	if (thread == this_evl_rq()->curr)
+		evl_switch_resctrl(thread);
+
+	evl_put_thread_rq(thread, rq, flags);
+
+	return 0;
+}
+
+#else
+
+static int set_thread_resctrl(struct evl_thread *thread,
+			const struct evl_thread_resctrl *rc)
+{
+	return -EOPNOTSUPP;
+}
+
+#endif
+
+#ifdef CONFIG_EVL_SCHED_CAPACITY
+
+/*
+ * The hint applies from the next transition of @thread to the oob
+ * stage, CPU migration is an in-band operation.
+ */
+static int set_thread_capacity(struct evl_thread *thread, __u32 capacity)
+{
+	if (capacity > SCHED_CAPACITY_SCALE)
+		return -EINVAL;
+
+	WRITE_ONCE(thread->min_capacity, capacity);
+
+	return 0;
+}
+
+#else
+
+static int set_thread_capacity(struct evl_thread *thread, __u32 capacity)
+{
+	return -EOPNOTSUPP;
+}
+
+#endif
+
 static int update_mode(struct evl_thread *thread, __u32 mask,
 		__u32 *oldmask, bool set)
 {
@@ -2141,7 +2665,8 @@ static int update_mode(struct evl_thread *thread, __u32 mask,
 		if (mask & EVL_T_HMOBS && thread->observable == NULL)
 			return -EINVAL;
 		/* Default to EVL_T_HMSIG if not specified. */
-		if (!(mask & (EVL_T_HMSIG|EVL_T_HMOBS)))
+		if (mask & EVL_THREAD_HM_BITS &&
+			!(mask & (EVL_T_HMSIG|EVL_T_HMOBS)))
 			mask |= EVL_T_HMSIG;
 	}
 
@@ -2159,6 +2684,9 @@ static int update_mode(struct evl_thread *thread, __u32 mask,
 			else if (!(thread->state & (EVL_T_HMSIG|EVL_T_HMOBS)))
 				thread->state &= ~(EVL_T_WOSS|EVL_T_WOLI|EVL_T_WOSX|EVL_T_WOSO);
 		}
+		/* Apply core exclusion right away if running. */
+		if (mask & EVL_T_EXCL && thread == rq->curr)
+			evl_switch_smt(rq, thread);
 	}
 
 	evl_put_thread_rq(thread, rq, flags);
@@ -2170,8 +2698,12 @@ static long thread_common_ioctl(struct evl_thread *thread,
 				unsigned int cmd, unsigned long arg)
 {
 	struct evl_thread_state statebuf;
+	struct evl_thread_runlat rlbuf;
+	struct evl_thread_resptime rtbuf;
+	struct evl_thread_budget budget;
+	struct evl_thread_resctrl rc;
 	struct evl_sched_attrs attrs;
-	__u32 mask, oldmask;
+	__u32 mask, oldmask, capacity;
 	long ret = 0;
 
 	switch (cmd) {
@@ -2215,6 +2747,40 @@ static long thread_common_ioctl(struct evl_thread *thread,
 	case EVL_THRIOC_DEMOTE:
 		evl_demote_thread(thread);
 		break;
+	case EVL_THRIOC_GET_RUNLAT:
+		get_thread_runlat(thread, &rlbuf);
+		ret = raw_copy_to_user((struct evl_thread_runlat *)arg,
+				&rlbuf, sizeof(rlbuf));
+		if (ret)
+			return -EFAULT;
+		break;
+	case EVL_THRIOC_GET_RESPTIME:
+		get_thread_resptime(thread, &rtbuf);
+		ret = raw_copy_to_user((struct evl_thread_resptime *)arg,
+				&rtbuf, sizeof(rtbuf));
+		if (ret)
+			return -EFAULT;
+		break;
+	case EVL_THRIOC_SET_BUDGET:
+		ret = raw_copy_from_user(&budget,
+				(struct evl_thread_budget *)arg, sizeof(budget));
+		if (ret)
+			return -EFAULT;
+		ret = set_thread_budget(thread, &budget);
+		break;
+	case EVL_THRIOC_SET_RESCTRL:
+		ret = raw_copy_from_user(&rc,
+				(struct evl_thread_resctrl *)arg, sizeof(rc));
+		if (ret)
+			return -EFAULT;
+		ret = set_thread_resctrl(thread, &rc);
+		break;
+	case EVL_THRIOC_SET_CAPACITY:
+		ret = raw_get_user(capacity, (__u32 *)arg);
+		if (ret)
+			return -EFAULT;
+		ret = set_thread_capacity(thread, capacity);
+		break;
 	default:
 		ret = -ENOTTY;
 	}
@@ -2264,6 +2830,99 @@ static long thread_oob_ioctl(struct file *filp, unsigned int cmd,
 	return ret;
 }
 
+/*
+ * Depth of the stack area below the current stack pointer we
+ * prefault when attaching, which should cover the common case.
+ */
+#define EVL_STACK_PREFAULT_SIZE	(64 * 1024)
+
+/*
+ * Populate the range [addr, addr + len) for the current process,
+ * breaking COW for writable private mappings, then report what may
+ * still cause a fault from the oob stage. Pages are locked in memory
+ * only if the mappings are, which mlockall(MCL_FUTURE) guarantees
+ * for those created after the call.
+ */
+static u32 prefault_range(unsigned long addr, unsigned long len)
+{
+	unsigned long start = PAGE_ALIGN_DOWN(addr), end, next;
+	struct mm_struct *mm = current->mm;
+	VMA_ITERATOR(vmi, mm, start);
+	struct vm_area_struct *vma;
+	vm_flags_t vm_flags;
+	u32 risk = 0;
+
+	end = PAGE_ALIGN(addr + len);
+	next = start;
+
+	mmap_read_lock(mm);
+
+	for_each_vma_range(vmi, vma, end) {
+		vm_flags = vma->vm_flags;
+		if (vma->vm_start > next)
+			risk |= EVL_RESIDENCY_UNMAPPED;
+		if (!(vm_flags & VM_LOCKED))
+			risk |= EVL_RESIDENCY_UNLOCKED;
+		if (vm_flags & (VM_IO | VM_PFNMAP))
+			risk |= EVL_RESIDENCY_UNPOPULATED;
+		if ((vm_flags & (VM_WRITE|VM_SHARED|VM_DONTCOPY)) == VM_WRITE)
+			risk |= EVL_RESIDENCY_COW;
+		next = vma->vm_end;
+	}
+
+	if (next < end)
+		risk |= EVL_RESIDENCY_UNMAPPED;
+
+	mmap_read_unlock(mm);
+
+	if (__mm_populate(start, end - start, 1))
+		risk |= EVL_RESIDENCY_UNPOPULATED;
+
+	return risk;
+}
+
+static u32 prefault_stack(void)
+{
+	unsigned long sp = user_stack_pointer(current_pt_regs());
+	unsigned long start = sp > EVL_STACK_PREFAULT_SIZE ?
+		sp - EVL_STACK_PREFAULT_SIZE : 0;
+	struct vm_area_struct *vma;
+
+	/* Do not extend the stack, only populate what is mapped. */
+	mmap_read_lock(current->mm);
+	vma = find_vma(current->mm, sp);
+	if (vma && vma->vm_start <= sp)
+		start = max(start, vma->vm_start);
+	mmap_read_unlock(current->mm);
+
+	return prefault_range(start, sp - start + 1);
+}
+
+static long prefault_uthread(struct evl_thread *thread,
+			struct evl_residency_req __user *u_req)
+{
+	struct evl_residency_req req;
+	int ret;
+
+	/* We are walking the memory of current. */
+	if (thread != evl_current())
+		return -EPERM;
+
+	ret = raw_copy_from_user(&req, u_req, sizeof(req));
+	if (ret)
+		return -EFAULT;
+
+	if (req.len == 0)
+		req.risk = prefault_stack();
+	else if (req.addr + req.len < req.addr ||
+		req.addr + req.len > TASK_SIZE)
+		return -EINVAL;
+	else
+		req.risk = prefault_range(req.addr, req.len);
+
+	return raw_put_user(req.risk, &u_req->risk) ? -EFAULT : 0;
+}
+
 static long thread_ioctl(struct file *filp, unsigned int cmd,
 			unsigned long arg)
 {
@@ -2285,7 +2944,12 @@ static long thread_ioctl(struct file *filp, unsigned int cmd,
 	case EVL_THRIOC_JOIN:
 		ret = evl_join_thread(thread, false);
 		break;
+	case EVL_THRIOC_PREFAULT:
+		ret = prefault_uthread(thread,
+				(struct evl_residency_req __user *)arg);
+		break;
 	case EVL_OBSIOC_SUBSCRIBE:
+	case EVL_OBSIOC_SUBSCRIBE_MAPPED:
 	case EVL_OBSIOC_UNSUBSCRIBE:
 		if (thread->observable)
 			ret = evl_ioctl_observable(thread->observable,
@@ -2398,9 +3062,26 @@ static int map_uthread_self(struct evl_thread *thread)
 	if (!(mm->def_flags & VM_LOCKED))
 		return -EINVAL;
 
-	u_window = evl_zalloc_chunk(&evl_shared_heap, sizeof(*u_window));
-	if (u_window == NULL)
-		return -ENOMEM;
+	/*
+	 * Spare the thread the first-touch faults on its stack. Other
+	 * areas such as TLS may be prefaulted by EVL_THRIOC_PREFAULT.
+	 */
+	prefault_stack();
+
+	/* A window may have been pre-allocated by the thread pool. */
+	u_window = thread->u_window;
+	if (u_window == NULL) {
+		u_window = evl_zalloc_chunk(thread->u_window_heap,
+					sizeof(*u_window));
+		if (u_window == NULL)
+			return -ENOMEM;
+		thread->u_window = u_window;
+	}
+
+	u_window->rseq_cs = 0;
+	u_window->preempt_defer = 0;
+	u_window->preempt_yield = 0;
+	evl_rseq_set_cpu(thread, evl_rq_cpu(thread->rq));
 
 	/*
 	 * Raise capababilities of user threads when attached to the
@@ -2422,8 +3103,8 @@ static int map_uthread_self(struct evl_thread *thread)
 	 * therefore there is no added capability to drop in
 	 * discard_unmapped_uthread().
 	 */
-	thread->u_window = u_window;
 	pin_to_initial_cpu(thread);
+	evl_attach_statslot(thread);
 	trace_evl_thread_map(thread);
 
 	dovetail_init_altsched(&thread->altsched);
@@ -2460,16 +3141,114 @@ static void discard_unmapped_uthread(struct evl_thread *thread)
 	evl_destroy_timer(&thread->ptimer);
 	dequeue_old_thread(thread);
 
-	if (thread->u_window)
-		evl_free_chunk(&evl_shared_heap, thread->u_window);
+	if (thread->u_window) {
+		evl_free_chunk(thread->u_window_heap, thread->u_window);
+		thread->u_window = NULL;
+	}
+}
+
+#ifdef CONFIG_EVL_THREAD_POOL
+
+static uint thread_pool_arg = 8;
+module_param_named(thread_pool, thread_pool_arg, uint, 0444);
+
+/*
+ * Pre-built descriptors for user threads, each with its user window
+ * already carved out of the shared heap. Attaching tasks draw from
+ * this pool, which the pool worker refills in-band afterwards, so
+ * that bursts of attachments do not wait on the allocators. Pooled
+ * descriptors are linked via thread->next, which evl_init_thread()
+ * resets once claimed.
+ */
+static LIST_HEAD(thread_pool);
+
+static unsigned int thread_pool_count;
+
+static DEFINE_MUTEX(thread_pool_lock);
+
+static void refill_thread_pool(struct work_struct *work)
+{
+	struct evl_thread *thread;
+
+	mutex_lock(&thread_pool_lock);
+
+	while (thread_pool_count < thread_pool_arg) {
+		thread = kzalloc(sizeof(*thread), GFP_KERNEL);
+		if (thread == NULL)
+			break;
+		thread->u_window = evl_zalloc_chunk(&evl_shared_heap,
+						sizeof(*thread->u_window));
+		if (thread->u_window == NULL) {
+			kfree(thread);
+			break;
+		}
+		list_add_tail(&thread->next, &thread_pool);
+		thread_pool_count++;
+	}
+
+	mutex_unlock(&thread_pool_lock);
 }
 
+static DECLARE_WORK(thread_pool_work, refill_thread_pool);
+
+/*
+ * Returns a zeroed thread descriptor, along with a pre-allocated
+ * user window in *u_windowp if it came from the pool.
+ */
+static struct evl_thread *
+alloc_user_thread(struct evl_user_window **u_windowp)
+{
+	struct evl_thread *thread = NULL;
+
+	*u_windowp = NULL;
+
+	mutex_lock(&thread_pool_lock);
+
+	if (!list_empty(&thread_pool)) {
+		thread = list_first_entry(&thread_pool,
+					struct evl_thread, next);
+		list_del(&thread->next);
+		thread_pool_count--;
+		*u_windowp = thread->u_window;
+		thread->u_window = NULL;
+	}
+
+	mutex_unlock(&thread_pool_lock);
+
+	if (thread_pool_arg)
+		schedule_work(&thread_pool_work);
+
+	if (thread == NULL)
+		thread = kzalloc(sizeof(*thread), GFP_KERNEL);
+
+	return thread;
+}
+
+void __init evl_init_thread_pool(void)
+{
+	refill_thread_pool(NULL);
+}
+
+#else
+
+static inline struct evl_thread *
+alloc_user_thread(struct evl_user_window **u_windowp)
+{
+	*u_windowp = NULL;
+
+	return kzalloc(sizeof(struct evl_thread), GFP_KERNEL);
+}
+
+#endif
+
 static struct evl_element *
 thread_factory_build(struct evl_factory *fac, const char __user *u_name,
 		void __user *u_attrs, int clone_flags, u32 *state_offp)
 {
 	struct evl_observable *observable = NULL;
+	struct evl_user_window *u_window;
 	struct task_struct *tsk = current;
+	struct evl_heap *heap;
 	struct evl_init_thread_attr iattr;
 	unsigned char comm[sizeof(tsk->comm)];
 	struct evl_thread *curr;
@@ -2485,10 +3264,22 @@ thread_factory_build(struct evl_factory *fac, const char __user *u_name,
 	if (!test_bit(EVL_MM_ACTIVE_BIT, &dovetail_mm_state()->flags))
 		return ERR_PTR(-EPERM);
 
-	curr = kzalloc(sizeof(*curr), GFP_KERNEL);
+	curr = alloc_user_thread(&u_window);
 	if (curr == NULL)
 		return ERR_PTR(-ENOMEM);
 
+	/*
+	 * Only the thread itself accesses its user window, which may
+	 * live in the private heap of its process regardless of the
+	 * visibility of the element. Pooled windows come from the
+	 * shared heap, drop ours if we have a better option.
+	 */
+	heap = evl_get_state_heap(0);
+	if (heap != &evl_shared_heap && u_window) {
+		evl_free_chunk(&evl_shared_heap, u_window);
+		u_window = NULL;
+	}
+
 	ret = evl_init_user_element(&curr->element, &evl_thread_factory,
 				u_name, clone_flags);
 	if (ret)
@@ -2533,11 +3324,16 @@ thread_factory_build(struct evl_factory *fac, const char __user *u_name,
 	if (ret)
 		goto fail_thread;
 
+	/* From now on, discard_unmapped_uthread() releases the window. */
+	curr->u_window = u_window;
+	curr->u_window_heap = heap;
+	u_window = NULL;
+
 	ret = map_uthread_self(curr);
 	if (ret)
 		goto fail_map;
 
-	*state_offp = evl_shared_offset(curr->u_window);
+	*state_offp = evl_state_offset(heap, curr->u_window);
 	evl_index_factory_element(&curr->element);
 
 	/*
@@ -2566,6 +3362,9 @@ fail_observable_dev:
 fail_observable:
 	evl_destroy_element(&curr->element);
 fail_element:
+	if (u_window)
+		evl_free_chunk(&evl_shared_heap, u_window);
+	evl_put_state_heap(heap);
 	kfree(curr);
 
 	return ERR_PTR(ret);
@@ -2744,6 +3543,135 @@ static ssize_t stats_show(struct device *dev,
 
 static DEVICE_ATTR_RO(stats);
 
+#ifdef CONFIG_EVL_RUNSTATS_PMU
+
+/*
+ * Cycles, instructions, LLC misses and branch misses accumulated
+ * while the thread ran, updated at each context switch. Readings
+ * may race with updates on the thread's CPU, which is harmless for
+ * such counters.
+ */
+static ssize_t pmu_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_thread *thread;
+	u64 *total;
+	ssize_t ret;
+
+	thread = evl_get_element_by_dev(dev, struct evl_thread);
+	if (thread == NULL)
+		return -EIO;
+
+	total = thread->stat.pmu.total;
+	ret = snprintf(buf, PAGE_SIZE, "%llu %llu %llu %llu\n",
+		READ_ONCE(total[EVL_PMU_CYCLES]),
+		READ_ONCE(total[EVL_PMU_INSNS]),
+		READ_ONCE(total[EVL_PMU_LLC_MISSES]),
+		READ_ONCE(total[EVL_PMU_BRANCH_MISSES]));
+
+	evl_put_element(&thread->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(pmu);
+
+#endif	/* CONFIG_EVL_RUNSTATS_PMU */
+
+/*
+ * Ready-queue latency: count of samples, min, average and max delay
+ * (ns), followed by the histogram buckets (see EVL_RUNLAT_BUCKETS).
+ */
+static ssize_t runlat_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_thread_runlat rlbuf;
+	struct evl_thread *thread;
+	ssize_t len;
+	int n;
+
+	thread = evl_get_element_by_dev(dev, struct evl_thread);
+	if (thread == NULL)
+		return -EIO;
+
+	get_thread_runlat(thread, &rlbuf);
+
+	evl_put_element(&thread->element);
+
+	len = snprintf(buf, PAGE_SIZE, "%llu %llu %llu %llu",
+		rlbuf.count, rlbuf.min_ns,
+		rlbuf.count ? div64_u64(rlbuf.total_ns, rlbuf.count) : 0,
+		rlbuf.max_ns);
+	for (n = 0; n < EVL_RUNLAT_BUCKETS; n++)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				" %llu", rlbuf.hist[n]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+static DEVICE_ATTR_RO(runlat);
+
+/*
+ * Periodic response time: count of samples, min, average and max
+ * time (ns), deadline misses, overruns, followed by the histogram
+ * buckets (see EVL_RESPTIME_BUCKETS).
+ */
+static ssize_t resptime_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_thread_resptime rtbuf;
+	struct evl_thread *thread;
+	ssize_t len;
+	int n;
+
+	thread = evl_get_element_by_dev(dev, struct evl_thread);
+	if (thread == NULL)
+		return -EIO;
+
+	get_thread_resptime(thread, &rtbuf);
+
+	evl_put_element(&thread->element);
+
+	len = snprintf(buf, PAGE_SIZE, "%llu %llu %llu %llu %llu %llu",
+		rtbuf.count, rtbuf.min_ns,
+		rtbuf.count ? div64_u64(rtbuf.total_ns, rtbuf.count) : 0,
+		rtbuf.max_ns, rtbuf.misses, rtbuf.overruns);
+	for (n = 0; n < EVL_RESPTIME_BUCKETS; n++)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				" %llu", rtbuf.hist[n]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+static DEVICE_ATTR_RO(resptime);
+
+#ifdef CONFIG_EVL_OOB_TRAPS
+
+/* Count of traps fixed up without leaving the oob stage. */
+static ssize_t oob_traps_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_thread *thread;
+	ssize_t ret;
+
+	thread = evl_get_element_by_dev(dev, struct evl_thread);
+	if (thread == NULL)
+		return -EIO;
+
+	ret = snprintf(buf, PAGE_SIZE, "%lu\n",
+		evl_get_counter(&thread->stat.oobtrap));
+
+	evl_put_element(&thread->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(oob_traps);
+
+#endif	/* CONFIG_EVL_OOB_TRAPS */
+
 static ssize_t timeout_show(struct device *dev,
 			struct device_attribute *attr,
 			char *buf)
@@ -2836,14 +3764,120 @@ static ssize_t wchan_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(wchan);
 
+#ifdef CONFIG_EVL_DEBUG_SWITCH_LOG
+
+/*
+ * One line per in-band switch, oldest first: date cause details ip,
+ * followed by the user stack sample.
+ */
+static ssize_t switches_show(struct device *dev,
+			struct device_attribute *attr,
+			char *buf)
+{
+	struct evl_switch_record *r, *records;
+	struct evl_switch_log *log;
+	struct evl_thread *thread;
+	unsigned int n, count;
+	unsigned long flags;
+	ssize_t ret = 0;
+	int w;
+
+	thread = evl_get_element_by_dev(dev, struct evl_thread);
+	if (thread == NULL)
+		return -EIO;
+
+	log = thread->switch_log;
+	if (log == NULL)
+		goto out;
+
+	records = kmalloc(sizeof(log->records), GFP_KERNEL);
+	if (records == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* Copy the log in order, so that we don't format it locked. */
+	raw_spin_lock_irqsave(&log->lock, flags);
+	count = log->count;
+	for (n = 0; n < count; n++)
+		records[n] = log->records[(log->next + EVL_SWITCH_LOG_LEN -
+					count + n) % EVL_SWITCH_LOG_LEN];
+	raw_spin_unlock_irqrestore(&log->lock, flags);
+
+	for (n = 0, r = records; n < count; n++, r++) {
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "%Ld %d %#Lx %#lx",
+				ktime_to_ns(r->date), r->cause,
+				r->details.lval, r->ip);
+		for (w = 0; w < EVL_SWITCH_STACK_WORDS; w++)
+			ret += scnprintf(buf + ret, PAGE_SIZE - ret, " %#lx",
+					r->stack[w]);
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "\n");
+	}
+
+	kfree(records);
+out:
+	evl_put_element(&thread->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(switches);
+
+/* One line per cause observed so far: cause count. */
+static ssize_t switch_summary_show(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	unsigned long totals[EVL_HMDIAG_BUDGET + 1];
+	struct evl_switch_log *log;
+	struct evl_thread *thread;
+	unsigned long flags;
+	ssize_t ret = 0;
+	int cause;
+
+	thread = evl_get_element_by_dev(dev, struct evl_thread);
+	if (thread == NULL)
+		return -EIO;
+
+	log = thread->switch_log;
+	if (log) {
+		raw_spin_lock_irqsave(&log->lock, flags);
+		memcpy(totals, log->totals, sizeof(totals));
+		raw_spin_unlock_irqrestore(&log->lock, flags);
+		for (cause = 1; cause <= EVL_HMDIAG_BUDGET; cause++) {
+			if (totals[cause])
+				ret += scnprintf(buf + ret, PAGE_SIZE - ret,
+						"%d %lu\n", cause, totals[cause]);
+		}
+	}
+
+	evl_put_element(&thread->element);
+
+	return ret;
+}
+static DEVICE_ATTR_RO(switch_summary);
+
+#endif	/* CONFIG_EVL_DEBUG_SWITCH_LOG */
+
 static struct attribute *thread_attrs[] = {
 	&dev_attr_state.attr,
 	&dev_attr_sched.attr,
 	&dev_attr_timeout.attr,
 	&dev_attr_stats.attr,
+	&dev_attr_runlat.attr,
+	&dev_attr_resptime.attr,
+#ifdef CONFIG_EVL_RUNSTATS_PMU
+	&dev_attr_pmu.attr,
+#endif
+#ifdef CONFIG_EVL_OOB_TRAPS
+	&dev_attr_oob_traps.attr,
+#endif
 	&dev_attr_pid.attr,
 	&dev_attr_observable.attr,
 	&dev_attr_wchan.attr,
+#ifdef CONFIG_EVL_DEBUG_SWITCH_LOG
+	&dev_attr_switches.attr,
+	&dev_attr_switch_summary.attr,
+#endif
 	NULL,
 };
 ATTRIBUTE_GROUPS(thread);
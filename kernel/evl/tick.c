@@ -14,9 +14,65 @@
 #include <linux/irq_pipeline.h>
 #include <evl/tick.h>
 #include <trace/events/evl.h>
+#ifdef CONFIG_EVL_DIRECT_TICK
+#include <asm/evl/tick.h>
+#endif
 
 static DEFINE_PER_CPU(struct clock_proxy_device *, proxy_device);
 
+#ifdef CONFIG_EVL_DIRECT_TICK
+
+/*
+ * Arch-specific access mode to the real device if we may program
+ * it directly, a negative value otherwise.
+ */
+static DEFINE_PER_CPU(int, direct_tick_access) = -ENODEV;
+
+static void setup_direct_tick(struct clock_proxy_device *dev)
+{
+	__this_cpu_write(direct_tick_access,
+			evl_arch_get_direct_tick(dev->real_device));
+}
+
+/*
+ * The devices we know how to program directly either have an
+ * absolute comparator, which fires immediately if set to a past
+ * date, or their arch-specific handler enforces the minimum delay
+ * by itself.
+ */
+static inline bool program_direct_tick(struct clock_event_device *real_dev,
+				struct evl_timer *timer, int64_t delta)
+{
+	int access = __this_cpu_read(direct_tick_access);
+	u64 cycles = 0;
+
+	if (access < 0)
+		return false;
+
+	if (delta > 0) {
+		delta = min(delta, (int64_t)real_dev->max_delta_ns);
+		cycles = ((u64)delta * real_dev->mult) >> real_dev->shift;
+	}
+
+	evl_arch_program_direct_tick(access, cycles);
+	trace_evl_timer_shot(timer, delta, cycles);
+
+	return true;
+}
+
+#else
+
+static inline void setup_direct_tick(struct clock_proxy_device *dev)
+{ }
+
+static inline bool program_direct_tick(struct clock_event_device *real_dev,
+				struct evl_timer *timer, int64_t delta)
+{
+	return false;
+}
+
+#endif
+
 static int proxy_set_next_ktime(ktime_t expires,
 				struct clock_event_device *proxy_dev)
 {
@@ -96,6 +152,7 @@ static void setup_proxy(struct clock_proxy_device *dev)
 		proxy_dev->set_state_oneshot_stopped = proxy_set_oneshot_stopped;
 
 	__this_cpu_write(proxy_device, dev);
+	setup_direct_tick(dev);
 }
 
 #ifdef CONFIG_SMP
@@ -197,12 +254,12 @@ void evl_program_proxy_tick(struct evl_clock *clock)
 	struct clock_proxy_device *dev = __this_cpu_read(proxy_device);
 	struct clock_event_device *real_dev = dev->real_device;
 	struct evl_rq *this_rq = this_evl_rq();
+	struct evl_timer *timer, *stimer;
 	struct evl_timerbase *tmb;
-	struct evl_timer *timer;
 	struct evl_tnode *tn;
 	int64_t delta;
+	ktime_t t, st;
 	u64 cycles;
-	ktime_t t;
 	int ret;
 
 	/*
@@ -215,7 +272,8 @@ void evl_program_proxy_tick(struct evl_clock *clock)
 
 	tmb = evl_this_cpu_timers(clock);
 	tn = evl_get_tqueue_head(&tmb->q);
-	if (tn == NULL) {
+	stimer = evl_get_slave_timers_head(tmb, &st);
+	if (tn == NULL && stimer == NULL) {
 		this_rq->local_flags |= RQ_IDLE;
 		return;
 	}
@@ -237,9 +295,17 @@ void evl_program_proxy_tick(struct evl_clock *clock)
 	 * to yield control to the in-band code (see
 	 * __evl_schedule()), or a timer with an earlier timeout date
 	 * is scheduled, whichever comes first.
+	 *
+	 * On a tickless CPU, we go further by stopping the hardware
+	 * timer if no other timer is pending, instead of letting the
+	 * in-band tick preempt the OOB activity only to be postponed
+	 * until in-band resumes. The next EVL timer started will
+	 * reprogram the hardware (RQ_TSTOPPED), so will the switch to
+	 * in-band (RQ_TDEFER), at which point any overdue in-band
+	 * tick is relayed immediately.
 	 */
 	this_rq->local_flags &= ~(RQ_TDEFER|RQ_IDLE|RQ_TSTOPPED);
-	timer = container_of(tn, struct evl_timer, node);
+	timer = tn ? container_of(tn, struct evl_timer, node) : NULL;
 	if (timer == &this_rq->inband_timer) {
 		if (evl_need_resched(this_rq) ||
 			!(this_rq->curr->state & EVL_T_ROOT)) {
@@ -247,13 +313,40 @@ void evl_program_proxy_tick(struct evl_clock *clock)
 			if (tn) {
 				this_rq->local_flags |= RQ_TDEFER;
 				timer = container_of(tn, struct evl_timer, node);
+			} else if (stimer) {
+				this_rq->local_flags |= RQ_TDEFER;
+				timer = NULL;
+			} else if (this_rq->local_flags & RQ_TICKLESS &&
+				real_dev->set_state_oneshot_stopped) {
+				this_rq->local_flags |= RQ_TDEFER|RQ_TSTOPPED;
+				real_dev->set_state_oneshot_stopped(real_dev);
+				return;
 			}
 		}
 	}
 
-	t = evl_tdate(timer);
+	/*
+	 * Timers with some slack may share a single shot with the
+	 * following ones, fired in the same pass by the tick handler.
+	 * The earliest timer from the slave clocks is considered
+	 * too, by its date converted to the master timebase.
+	 */
+	if (timer)
+		t = evl_get_timer_batch_date(&tmb->q, &timer->node);
+
+	if (stimer && (timer == NULL || st < t)) {
+		timer = stimer;
+		t = st;
+	}
+
+	/* Wake up early enough if idling. */
+	t = ktime_sub(t, evl_get_idle_lead(this_rq));
+
 	delta = ktime_to_ns(ktime_sub(t, evl_read_clock(clock)));
 
+	if (program_direct_tick(real_dev, timer, delta))
+		return;
+
 	if (real_dev->features & CLOCK_EVT_FEAT_KTIME) {
 		real_dev->set_next_ktime(t, real_dev);
 		trace_evl_timer_shot(timer, delta, t);
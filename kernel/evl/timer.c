@@ -6,6 +6,7 @@
  * Copyright (C) 2001, 2018 Philippe Gerum  <rpm@xenomai.org>
  */
 
+#include <linux/module.h>
 #include <evl/thread.h>
 #include <evl/timer.h>
 #include <evl/tick.h>
@@ -88,7 +89,7 @@ static bool timer_at_front(struct evl_timer *timer)
 	struct evl_tqueue *tq;
 	struct evl_tnode *tn;
 
-	tq = &timer->base->q;
+	tq = timer->tq;
 	tn = evl_get_tqueue_head(tq);
 	if (tn == &timer->node)
 		return true;
@@ -102,6 +103,32 @@ static bool timer_at_front(struct evl_timer *timer)
 	return false;
 }
 
+/*
+ * timer base locked. Tell whether @timer is due earlier than the
+ * latest date allowed by the slack of the timer the hardware shot
+ * was programmed for, in which case the batch has to be recomputed.
+ */
+static bool timer_within_batch(struct evl_timer *timer)
+{
+	struct evl_rq *rq = evl_get_timer_rq(timer);
+	struct evl_timer *head;
+	struct evl_tqueue *tq;
+	struct evl_tnode *tn;
+
+	tq = timer->tq;
+	tn = evl_get_tqueue_head(tq);
+	if (rq->local_flags & RQ_TDEFER)
+		tn = evl_get_tqueue_next(tq, tn);
+
+	if (tn == NULL)
+		return false;
+
+	head = container_of(tn, struct evl_timer, node);
+
+	return head->slack &&
+		evl_tdate(timer) < ktime_add(evl_tdate(head), head->slack);
+}
+
 /* timer base locked. */
 static void program_timer(struct evl_timer *timer,
 			struct evl_tqueue *tq)
@@ -111,7 +138,8 @@ static void program_timer(struct evl_timer *timer,
 	evl_enqueue_timer(timer, tq);
 
 	rq = evl_get_timer_rq(timer);
-	if (!(rq->local_flags & RQ_TSTOPPED) && !timer_at_front(timer))
+	if (!(rq->local_flags & RQ_TSTOPPED) && !timer_at_front(timer) &&
+		!timer_within_batch(timer))
 		return;
 
 	if (rq != this_evl_rq())
@@ -125,31 +153,30 @@ void evl_start_timer(struct evl_timer *timer,
 {
 	struct evl_timerbase *base;
 	struct evl_tqueue *tq;
-	ktime_t date, gravity;
 	unsigned long flags;
+	ktime_t gravity;
 
 	trace_evl_timer_start(timer, value, interval);
 
 	base = lock_timer_base(timer, &flags);
-	tq = &base->q;
+	tq = timer->tq;
 
 	if ((timer->status & EVL_TIMER_DEQUEUED) == 0)
 		evl_dequeue_timer(timer, tq);
 
 	timer->status &= ~(EVL_TIMER_FIRED | EVL_TIMER_PERIODIC);
 
-	date = ktime_sub(value, timer->clock->offset);
-
 	/*
 	 * To cope with the basic system latency, we apply a clock
 	 * gravity value, which is the amount of time expressed in
 	 * nanoseconds by which we should anticipate the shot for the
 	 * timer. The gravity value varies with the type of context
 	 * the timer wakes up, i.e. irq handler, kernel or user
-	 * thread.
+	 * thread. The expiry date is relative to the timer clock,
+	 * including for slave clocks (see evl_timerbase).
 	 */
 	gravity = evl_get_timer_gravity(timer);
-	evl_tdate(timer) = ktime_sub(date, gravity);
+	evl_tdate(timer) = ktime_sub(value, gravity);
 
 	timer->interval = EVL_INFINITE;
 	if (!timeout_infinite(interval)) {
@@ -170,7 +197,7 @@ EXPORT_SYMBOL_GPL(evl_start_timer);
 /* timer base locked. */
 bool evl_timer_deactivate(struct evl_timer *timer)
 {
-	struct evl_tqueue *tq = &timer->base->q;
+	struct evl_tqueue *tq = timer->tq;
 	bool heading = true;
 
 	if (!(timer->status & EVL_TIMER_DEQUEUED)) {
@@ -281,6 +308,50 @@ static inline int get_clock_cpu(struct evl_clock *clock, int cpu)
 
 #endif /* CONFIG_SMP */
 
+#ifdef CONFIG_EVL_TIMER_HOUSEKEEPING
+
+static int housekeeping_cpu_arg = -1;
+module_param_named(timer_housekeeping_cpu, housekeeping_cpu_arg, int, 0444);
+
+/*
+ * Redirect a non-critical timer to the housekeeping CPU, provided
+ * the latter runs EVL and receives events from the clock device.
+ * Otherwise, keep @cpu.
+ */
+static int offload_timer(struct evl_timer *timer,
+			struct evl_clock *clock, int cpu)
+{
+	int hk_cpu = housekeeping_cpu_arg;
+
+	if (!(timer->status & EVL_TIMER_NONCRIT) ||
+		hk_cpu < 0 || hk_cpu >= nr_cpu_ids ||
+		!is_evl_cpu(hk_cpu) ||
+		!cpumask_test_cpu(hk_cpu, &clock->affinity))
+		return cpu;
+
+	return hk_cpu;
+}
+
+static inline void set_timer_home(struct evl_timer *timer,
+				struct evl_rq *rq)
+{
+	WRITE_ONCE(timer->home_rq, rq);
+}
+
+#else
+
+static inline int offload_timer(struct evl_timer *timer,
+				struct evl_clock *clock, int cpu)
+{
+	return cpu;
+}
+
+static inline void set_timer_home(struct evl_timer *timer,
+				struct evl_rq *rq)
+{ }
+
+#endif /* CONFIG_EVL_TIMER_HOUSEKEEPING */
+
 void __evl_init_timer(struct evl_timer *timer,
 		struct evl_clock *clock,
 		void (*handler)(struct evl_timer *timer),
@@ -295,6 +366,7 @@ void __evl_init_timer(struct evl_timer *timer,
 	timer->status = EVL_TIMER_DEQUEUED|(flags & EVL_TIMER_INIT_MASK);
 	timer->handler = handler;
 	timer->interval = EVL_INFINITE;
+	timer->slack = 0;
 
 	/*
 	 * Set the timer affinity to the CPU rq is on if given, or the
@@ -303,13 +375,17 @@ void __evl_init_timer(struct evl_timer *timer,
 	cpu = rq ?
 		get_clock_cpu(clock->master, evl_rq_cpu(rq)) :
 		cpumask_first(&evl_cpu_affinity);
+	set_timer_home(timer, rq ?: evl_cpu_rq(cpu));
+	cpu = offload_timer(timer, clock->master, cpu);
 #ifdef CONFIG_SMP
 	timer->rq = evl_cpu_rq(cpu);
 #endif
 	timer->base = evl_percpu_timers(clock, cpu);
+	timer->tq = evl_percpu_tqueue(clock, cpu);
 	timer->clock = clock;
 	timer->name = name ?: "<timer>";
 	evl_reset_timer_stats(timer);
+	evl_set_timer_class(timer, EVL_TIMER_CLASS_OTHER);
 }
 EXPORT_SYMBOL_GPL(__evl_init_timer);
 
@@ -326,6 +402,93 @@ void evl_set_timer_gravity(struct evl_timer *timer, int gravity)
 }
 EXPORT_SYMBOL_GPL(evl_set_timer_gravity);
 
+/*
+ * Allow @timer to elapse up to @slack nanoseconds past its expiry
+ * date, so that it may be batched with other timers firing in the
+ * same time window, sharing a single hardware shot. The change
+ * applies at the next (re)programming of the hardware timer.
+ */
+void evl_set_timer_slack(struct evl_timer *timer, ktime_t slack)
+{
+	struct evl_timerbase *base;
+	unsigned long flags;
+
+	base = lock_timer_base(timer, &flags);
+	timer->slack = slack;
+	unlock_timer_base(base, flags);
+}
+EXPORT_SYMBOL_GPL(evl_set_timer_slack);
+
+/*
+ * Maximum number of timers considered for batching into a single
+ * hardware shot, which bounds the time spent computing it.
+ */
+#define TIMER_BATCH_MAX  16
+
+/*
+ * Return the latest date the hardware timer may be programmed for,
+ * so that the timer queued at @tn and the next ones which can be
+ * batched with it are all fired in a single shot, without any of
+ * them elapsing later than its slack allows. Timers without slack
+ * end the batch at their exact expiry date.
+ *
+ * timer base locked.
+ */
+ktime_t evl_get_timer_batch_date(struct evl_tqueue *tq,
+				struct evl_tnode *tn)
+{
+	struct evl_timer *timer;
+	ktime_t limit;
+	int n;
+
+	timer = container_of(tn, struct evl_timer, node);
+	if (!timer->slack)
+		return evl_tdate(timer);
+
+	limit = ktime_add(evl_tdate(timer), timer->slack);
+
+	for (n = 1; n < TIMER_BATCH_MAX; n++) {
+		tn = evl_get_tqueue_next(tq, tn);
+		if (!tn || tn->date > limit)
+			break;
+		timer = container_of(tn, struct evl_timer, node);
+		limit = min(limit, ktime_add(evl_tdate(timer), timer->slack));
+	}
+
+	return limit;
+}
+
+/*
+ * Find the earliest timer among the slave clocks ticking on @tmb,
+ * returning the date of the shot for it in the master timebase
+ * into *datep, batching with the following timers from the same
+ * queue if applicable.
+ *
+ * timer base locked.
+ */
+struct evl_timer *evl_get_slave_timers_head(struct evl_timerbase *tmb,
+					ktime_t *datep)
+{
+	struct evl_timer *timer = NULL;
+	struct evl_slave_tqueue *sq;
+	struct evl_tnode *tn;
+	ktime_t date;
+
+	list_for_each_entry(sq, &tmb->slaves, next) {
+		tn = evl_get_tqueue_head(&sq->q);
+		if (tn == NULL)
+			continue;
+		date = ktime_sub(evl_get_timer_batch_date(&sq->q, tn),
+				sq->clock->offset);
+		if (timer == NULL || date < *datep) {
+			timer = container_of(tn, struct evl_timer, node);
+			*datep = date;
+		}
+	}
+
+	return timer;
+}
+
 void evl_destroy_timer(struct evl_timer *timer)
 {
 	evl_stop_timer(timer);
@@ -362,9 +525,13 @@ void evl_move_timer(struct evl_timer *timer,
 	 * Find out which CPU is best suited for managing this timer,
 	 * preferably picking evl_rq_cpu(rq) if the ticking device
 	 * moving the timer clock beats on that CPU. Otherwise, pick
-	 * the first CPU from the clock affinity mask if set.
+	 * the first CPU from the clock affinity mask if set. A
+	 * non-critical timer goes to the housekeeping CPU instead if
+	 * any.
 	 */
 	cpu = get_clock_cpu(clock->master, evl_rq_cpu(rq));
+	set_timer_home(timer, rq);
+	cpu = offload_timer(timer, master, cpu);
 	rq = evl_cpu_rq(cpu);
 
 	old_base = lock_timer_base(timer, &flags);
@@ -385,8 +552,9 @@ void evl_move_timer(struct evl_timer *timer,
 		timer->rq = rq;
 #endif
 		timer->base = new_base;
+		timer->tq = evl_percpu_tqueue(clock, cpu);
 		timer->clock = clock;
-		evl_enqueue_timer(timer, &new_base->q);
+		evl_enqueue_timer(timer, timer->tq);
 		if (timer_at_front(timer))
 			evl_program_remote_tick(clock, rq);
 		double_timer_base_unlock(old_base, new_base);
@@ -396,6 +564,7 @@ void evl_move_timer(struct evl_timer *timer,
 		timer->rq = rq;
 #endif
 		timer->base = new_base;
+		timer->tq = evl_percpu_tqueue(clock, cpu);
 		timer->clock = clock;
 		unlock_timer_base(old_base, flags);
 	}
@@ -463,7 +632,7 @@ unsigned long evl_get_timer_overruns(struct evl_timer *timer)
 	 * Re-enqueue the periodic timer so that it ticks at the next
 	 * interval boundary.
 	 */
-	tq = &base->q;
+	tq = timer->tq;
 	evl_dequeue_timer(timer, tq);
 	while (evl_tdate(timer) < now) {
 		timer->periodic_ticks++;
@@ -521,4 +690,110 @@ void evl_insert_tnode(struct evl_tqueue *tq, struct evl_tnode *node)
 	rb_insert_color(&node->rb, &tq->root);
 }
 
+#elif defined(CONFIG_EVL_TIMER_WHEEL)
+
+void evl_init_tqueue(struct evl_tqueue *tq)
+{
+	int n;
+
+	INIT_LIST_HEAD(&tq->q);
+	tq->horizon = 0;
+	tq->nr_wheel = 0;
+	bitmap_zero(tq->slot_map, EVL_TWHEEL_SLOTS);
+	for (n = 0; n < EVL_TWHEEL_SLOTS; n++)
+		INIT_LIST_HEAD(tq->wheel + n);
+}
+
+static void insert_exact(struct evl_tqueue *tq, struct evl_tnode *node)
+{
+	struct evl_tnode *n;
+
+	node->slot = -1;
+	list_for_each_entry_reverse(n, &tq->q, next) {
+		if (n->date <= node->date)
+			break;
+	}
+	list_add(&node->next, &n->next);
+}
+
+void evl_insert_tnode(struct evl_tqueue *tq, struct evl_tnode *node)
+{
+	int slot;
+
+	if (node->date < tq->horizon) {
+		insert_exact(tq, node);
+		return;
+	}
+
+	slot = evl_twheel_slot(node->date);
+	node->slot = slot;
+	list_add_tail(&node->next, tq->wheel + slot);
+	__set_bit(slot, tq->slot_map);
+	tq->nr_wheel++;
+}
+
+/*
+ * Move the wheel timers which belong to the first non-empty span
+ * past the horizon to the exact list, advancing the horizon
+ * accordingly. All wheel timers are later than any timer from the
+ * exact list, so the latter stays ordered. On entry, the wheel
+ * holds at least one timer.
+ */
+void evl_cascade_tqueue(struct evl_tqueue *tq)
+{
+	struct evl_tnode *node, *tmp;
+	int cur, slot, skip, n;
+	struct list_head *head;
+	ktime_t end, min_date;
+	bool moved = false;
+retry:
+	for (n = 0; n < EVL_TWHEEL_SLOTS; n += skip + 1) {
+		cur = evl_twheel_slot(tq->horizon);
+		slot = find_next_bit(tq->slot_map, EVL_TWHEEL_SLOTS, cur);
+		if (slot >= EVL_TWHEEL_SLOTS)
+			slot = find_first_bit(tq->slot_map, EVL_TWHEEL_SLOTS);
+
+		/* Skip the empty spans in between. */
+		skip = (slot - cur) & (EVL_TWHEEL_SLOTS - 1);
+		tq->horizon = ktime_add(tq->horizon, skip * EVL_TWHEEL_SPAN);
+		end = ktime_add(tq->horizon, EVL_TWHEEL_SPAN);
+
+		/*
+		 * A slot also holds timers due in later revolutions
+		 * of the wheel, leave them in place.
+		 */
+		head = tq->wheel + slot;
+		list_for_each_entry_safe(node, tmp, head, next) {
+			if (node->date < end) {
+				list_del(&node->next);
+				tq->nr_wheel--;
+				insert_exact(tq, node);
+				moved = true;
+			}
+		}
+
+		if (list_empty(head))
+			__clear_bit(slot, tq->slot_map);
+
+		tq->horizon = end;
+		if (moved)
+			return;
+	}
+
+	/*
+	 * Nothing is due within a full revolution past the horizon,
+	 * jump to the span of the earliest timer directly.
+	 */
+	min_date = KTIME_MAX;
+	for_each_set_bit(slot, tq->slot_map, EVL_TWHEEL_SLOTS) {
+		list_for_each_entry(node, tq->wheel + slot, next) {
+			if (node->date < min_date)
+				min_date = node->date;
+		}
+	}
+
+	tq->horizon = min_date & ~(EVL_TWHEEL_SPAN - 1);
+	goto retry;
+}
+
 #endif
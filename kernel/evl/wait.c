@@ -22,6 +22,8 @@ void __evl_init_wait(struct evl_wait_queue *wq,
 	wq->wchan.requeue_wait = evl_requeue_wait;
 	wq->wchan.name = name;
 	INIT_LIST_HEAD(&wq->wchan.wait_list);
+	wq->wchan.wait_index = RB_ROOT;
+	wq->wchan.nr_waiters = 0;
 	raw_spin_lock_init(&wq->wchan.lock);
 	lockdep_set_class_and_name(&wq->wchan.lock, lock_key, name);
 	might_hard_lock(&wq->wchan.lock);
@@ -35,6 +37,152 @@ void evl_destroy_wait(struct evl_wait_queue *wq)
 }
 EXPORT_SYMBOL_GPL(evl_destroy_wait);
 
+/*
+ * Wait lists are ordered by decreasing priority, FIFO among waiters
+ * of equal priority. Once a list gets crowded, its priority groups
+ * are indexed into an rbtree, each group being represented by its
+ * last waiter. Priority-ordered insertions then take O(log(n)) in
+ * the number of distinct priorities instead of scanning the list.
+ * The index lives until the list drains.
+ */
+#define EVL_WAIT_INDEX_THRESHOLD  16
+
+static inline struct evl_thread *group_tail(struct rb_node *node)
+{
+	return rb_entry(node, struct evl_thread, wait_group);
+}
+
+static void index_group(struct evl_wait_channel *wchan,
+			struct evl_thread *tail)
+{
+	struct rb_node **new = &wchan->wait_index.rb_node, *parent = NULL;
+
+	tail->wait_group_prio = tail->wprio;
+
+	while (*new) {
+		parent = *new;
+		if (tail->wait_group_prio < group_tail(parent)->wait_group_prio)
+			new = &parent->rb_left;
+		else
+			new = &parent->rb_right;
+	}
+
+	rb_link_node(&tail->wait_group, parent, new);
+	rb_insert_color(&tail->wait_group, &wchan->wait_index);
+}
+
+/* Find the tail of the lowest priority group at or above @prio. */
+static struct evl_thread *find_group(struct evl_wait_channel *wchan,
+				int prio)
+{
+	struct rb_node *node = wchan->wait_index.rb_node;
+	struct evl_thread *tail, *found = NULL;
+
+	while (node) {
+		tail = group_tail(node);
+		if (tail->wait_group_prio >= prio) {
+			found = tail;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	return found;
+}
+
+static void build_wait_index(struct evl_wait_channel *wchan)
+{
+	struct evl_thread *pos;
+
+	list_for_each_entry(pos, &wchan->wait_list, wait_next) {
+		if (list_is_last(&pos->wait_next, &wchan->wait_list) ||
+			list_next_entry(pos, wait_next)->wprio != pos->wprio)
+			index_group(wchan, pos);
+	}
+}
+
+/* wchan->lock held, hard irqs off */
+void evl_add_waiter(struct evl_wait_channel *wchan,
+		struct evl_thread *waiter)
+{
+	struct evl_thread *tail;
+
+	assert_hard_lock(&wchan->lock);
+
+	wchan->nr_waiters++;
+
+	if (RB_EMPTY_ROOT(&wchan->wait_index)) {
+		list_add_priff(waiter, &wchan->wait_list, wprio, wait_next);
+		if (wchan->nr_waiters >= EVL_WAIT_INDEX_THRESHOLD)
+			build_wait_index(wchan);
+		return;
+	}
+
+	tail = find_group(wchan, waiter->wprio);
+	if (tail == NULL) {
+		list_add(&waiter->wait_next, &wchan->wait_list);
+		index_group(wchan, waiter);
+		return;
+	}
+
+	list_add(&waiter->wait_next, &tail->wait_next);
+	if (tail->wait_group_prio != waiter->wprio) {
+		index_group(wchan, waiter);
+	} else {
+		/* We are the new tail of this group. */
+		waiter->wait_group_prio = tail->wait_group_prio;
+		rb_replace_node(&tail->wait_group, &waiter->wait_group,
+				&wchan->wait_index);
+		RB_CLEAR_NODE(&tail->wait_group);
+	}
+}
+EXPORT_SYMBOL_GPL(evl_add_waiter);
+
+/* wchan->lock held, hard irqs off */
+void evl_add_waiter_tail(struct evl_wait_channel *wchan,
+			struct evl_thread *waiter)
+{
+	assert_hard_lock(&wchan->lock);
+
+	wchan->nr_waiters++;
+	list_add_tail(&waiter->wait_next, &wchan->wait_list);
+}
+EXPORT_SYMBOL_GPL(evl_add_waiter_tail);
+
+/*
+ * Group membership is inferred from the index, not from the
+ * priority of @waiter, which may have changed already if it is
+ * being requeued.
+ *
+ * wchan->lock held, hard irqs off
+ */
+void evl_del_waiter(struct evl_wait_channel *wchan,
+		struct evl_thread *waiter)
+{
+	struct evl_thread *prev;
+
+	assert_hard_lock(&wchan->lock);
+
+	if (!RB_EMPTY_NODE(&waiter->wait_group)) {
+		prev = list_prev_entry(waiter, wait_next);
+		if (&prev->wait_next != &wchan->wait_list &&
+			RB_EMPTY_NODE(&prev->wait_group)) {
+			/* Our predecessor now ends the group. */
+			prev->wait_group_prio = waiter->wait_group_prio;
+			rb_replace_node(&waiter->wait_group, &prev->wait_group,
+					&wchan->wait_index);
+		} else {
+			rb_erase(&waiter->wait_group, &wchan->wait_index);
+		}
+		RB_CLEAR_NODE(&waiter->wait_group);
+	}
+
+	list_del_init(&waiter->wait_next);
+	wchan->nr_waiters--;
+}
+EXPORT_SYMBOL_GPL(evl_del_waiter);
+
 /* wq->wchan.lock held, hard irqs off */
 static void __evl_add_wait_queue(struct evl_thread *curr,
 				struct evl_wait_queue *wq,
@@ -45,9 +193,9 @@ static void __evl_add_wait_queue(struct evl_thread *curr,
 	trace_evl_wait(&wq->wchan);
 
 	if (!(wq->flags & EVL_WAIT_PRIO))
-		list_add_tail(&curr->wait_next, &wq->wchan.wait_list);
+		evl_add_waiter_tail(&wq->wchan, curr);
 	else
-		list_add_priff(curr, &wq->wchan.wait_list, wprio, wait_next);
+		evl_add_waiter(&wq->wchan, curr);
 
 	evl_sleep_on(timeout, timeout_mode, wq->clock, &wq->wchan);
 }
@@ -89,7 +237,7 @@ struct evl_thread *evl_wake_up(struct evl_wait_queue *wq,
 		if (waiter == NULL)
 			waiter = list_first_entry(&wq->wchan.wait_list,
 						struct evl_thread, wait_next);
-		list_del_init(&waiter->wait_next);
+		evl_del_waiter(&wq->wchan, waiter);
 		evl_wakeup_thread(waiter, EVL_T_PEND, reason);
 	}
 
@@ -108,7 +256,7 @@ int evl_flush_wait_locked(struct evl_wait_queue *wq, int reason)
 	trace_evl_flush_wait(&wq->wchan);
 
 	list_for_each_entry_safe(waiter, tmp, &wq->wchan.wait_list, wait_next) {
-		list_del_init(&waiter->wait_next);
+		evl_del_waiter(&wq->wchan, waiter);
 		evl_wakeup_thread(waiter, EVL_T_PEND, reason);
 		ret++;
 	}
@@ -145,8 +293,8 @@ bool evl_requeue_wait(struct evl_wait_channel *wchan, struct evl_thread *waiter)
 	assert_hard_lock(&waiter->lock);
 
 	if (wq->flags & EVL_WAIT_PRIO) {
-		list_del(&waiter->wait_next);
-		list_add_priff(waiter, &wq->wchan.wait_list, wprio, wait_next);
+		evl_del_waiter(wchan, waiter);
+		evl_add_waiter(wchan, waiter);
 	}
 
 	return true;
@@ -211,7 +359,7 @@ int __evl_wait_schedule(struct evl_wait_channel *wchan)
 	raw_spin_lock_irqsave(&wchan->lock, flags);
 
 	if (!list_empty(&curr->wait_next))
-		list_del_init(&curr->wait_next);
+		evl_del_waiter(wchan, curr);
 
 	raw_spin_unlock_irqrestore(&wchan->lock, flags);
 
@@ -269,6 +417,27 @@ void evl_adjust_wait_priority(struct evl_thread *thread)
 	evl_put_thread_wchan(wchan);
 }
 
+#ifdef CONFIG_EVL_RUNSTATS
+
+static void account_chain_walk(unsigned int depth, bool cutoff)
+{
+	struct evl_pi_stats *st = &this_evl_rq()->pi_stats;
+
+	st->walks++;
+	st->hops += depth;
+	if (cutoff)
+		st->cutoffs++;
+	if (depth > st->max_depth)
+		st->max_depth = depth;
+}
+
+#else
+
+static inline void account_chain_walk(unsigned int depth, bool cutoff)
+{ }
+
+#endif
+
 /*
  * Walking the lock chain deals with the following items:
  *
@@ -303,6 +472,8 @@ int evl_walk_lock_chain(struct evl_wait_channel *orig_wchan,
 {
 	struct evl_thread *waiter = orig_waiter, *owner = orig_wchan->owner;
 	struct evl_wait_channel *wchan = orig_wchan, *next_wchan;
+	unsigned int depth = 1;
+	bool cutoff = false;
 	int ret = 0;
 
 	assert_hard_lock(&wchan->lock);
@@ -341,14 +512,12 @@ int evl_walk_lock_chain(struct evl_wait_channel *orig_wchan,
 
 		/*
 		 * If no adjustment was deemed necessary, we may stop
-		 * the walk right here, since there would be no
+		 * the walk at the next hop, since there would be no
 		 * priority change to propagate further down the
 		 * chain.
 		 */
-		if (!check_only && !evl_adjust_thread_boost(owner)) {
-			raw_spin_unlock(&owner->lock);
-			break;
-		}
+		if (!check_only && !evl_adjust_thread_boost(owner))
+			cutoff = true;
 
 		next_wchan = evl_get_thread_wchan(owner);
 		if (!next_wchan) {
@@ -362,24 +531,36 @@ int evl_walk_lock_chain(struct evl_wait_channel *orig_wchan,
 		 */
 		waiter = owner;
 		wchan = next_wchan;
+		depth++;
 
 		/*
-		 * If the priority of the last owner we visited has
-		 * changed, update its position into the wait channel
-		 * it sleeps on.
+		 * Check for a cyclic dependency before anything else,
+		 * a walk we cut short must not miss a deadlock with
+		 * the next owner.
 		 */
-		if (!check_only && !wchan->requeue_wait(wchan, waiter))
+		owner = wchan->owner;
+		if (owner == orig_waiter) {
+			ret = -EDEADLK;
 			goto unlock_out;
+		}
 
-		owner = wchan->owner;
-		if (!owner) /* End of lock chain, we are done. */
+		if (cutoff)
 			goto unlock_out;
 
-		if (owner == orig_waiter) {
-			ret = -EDEADLK;
+		/*
+		 * If the priority of the last owner we visited has
+		 * changed, update its position into the wait channel
+		 * it sleeps on. Stop walking if this does not affect
+		 * the priority of the next owner.
+		 */
+		if (!check_only && !wchan->requeue_wait(wchan, waiter)) {
+			cutoff = true;
 			goto unlock_out;
 		}
 
+		if (!owner) /* End of lock chain, we are done. */
+			goto unlock_out;
+
 		raw_spin_unlock(&waiter->lock);
 		/*
 		 * We must grab this lock before we drop wchan->lock
@@ -388,6 +569,7 @@ int evl_walk_lock_chain(struct evl_wait_channel *orig_wchan,
 		raw_spin_lock(&owner->lock);
 	}
 out:
+	account_chain_walk(depth, cutoff);
 	raw_spin_lock(&orig_wchan->lock);
 	raw_spin_lock(&orig_waiter->lock);
 	evl_put_element(&orig_waiter->element);
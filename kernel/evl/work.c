@@ -4,6 +4,9 @@
  * Copyright (C) 2020 Philippe Gerum  <rpm@xenomai.org>
  */
 
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <evl/sched.h>
 #include <evl/work.h>
 
 void __evl_do_work(struct work_struct *wq_work)
@@ -116,3 +119,298 @@ int evl_call_inband_sync_from(struct evl_sync_work *sync_work,
 	return evl_wait_flag(&sync_work->done) ?: sync_work->result;
 }
 EXPORT_SYMBOL_GPL(evl_call_inband_sync_from);
+
+/*
+ * Oob workqueues have one worker per out-of-band CPU. Work is queued
+ * to the worker of a given CPU, which is only kicked when its queue
+ * was empty, then processes every item queued until the queue is
+ * drained, so that bursts of work are handled in a single pass.
+ */
+struct evl_oob_worker {
+	struct evl_kthread kthread;
+	hard_spinlock_t lock;
+	struct list_head queue;
+	struct evl_flag kick;
+};
+
+struct evl_oob_workqueue {
+	struct evl_oob_worker __percpu *workers;
+	struct cpumask cpus;	/* CPUs with a worker running */
+};
+
+struct evl_oob_workqueue *evl_oob_wq;
+EXPORT_SYMBOL_GPL(evl_oob_wq);
+
+struct evl_oob_workqueue *evl_oob_highpri_wq;
+EXPORT_SYMBOL_GPL(evl_oob_highpri_wq);
+
+static void oob_worker(void *arg)
+{
+	struct evl_oob_worker *worker = arg;
+	struct evl_oob_work *work;
+	unsigned long flags;
+
+	while (!evl_kthread_should_stop()) {
+		if (evl_wait_flag(&worker->kick))
+			break;
+
+		raw_spin_lock_irqsave(&worker->lock, flags);
+
+		while (!list_empty(&worker->queue)) {
+			work = list_first_entry(&worker->queue,
+					struct evl_oob_work, next);
+			list_del_init(&work->next);
+			/* The handler may queue @work again. */
+			clear_bit(EVL_OOB_WORK_PENDING, &work->flags);
+			raw_spin_unlock_irqrestore(&worker->lock, flags);
+			work->handler(work);
+			raw_spin_lock_irqsave(&worker->lock, flags);
+		}
+
+		raw_spin_unlock_irqrestore(&worker->lock, flags);
+	}
+}
+
+/* Any stage, returns false if @work is pending already. */
+bool evl_queue_oob_work_on(struct evl_oob_workqueue *wq,
+			int cpu, struct evl_oob_work *work)
+{
+	struct evl_oob_worker *worker;
+	unsigned long flags;
+	bool kick;
+
+	if (EVL_WARN_ON(CORE, !cpumask_test_cpu(cpu, &wq->cpus)))
+		return false;
+
+	if (test_and_set_bit(EVL_OOB_WORK_PENDING, &work->flags))
+		return false;
+
+	worker = per_cpu_ptr(wq->workers, cpu);
+	raw_spin_lock_irqsave(&worker->lock, flags);
+	kick = list_empty(&worker->queue);
+	list_add_tail(&work->next, &worker->queue);
+	work->worker = worker;
+	raw_spin_unlock_irqrestore(&worker->lock, flags);
+
+	if (kick)
+		evl_raise_flag(&worker->kick);
+
+	return true;
+}
+EXPORT_SYMBOL_GPL(evl_queue_oob_work_on);
+
+/*
+ * Queue @work to the worker of the current CPU if it has one, to the
+ * first one available otherwise.
+ */
+bool evl_queue_oob_work(struct evl_oob_workqueue *wq,
+			struct evl_oob_work *work)
+{
+	int cpu = raw_smp_processor_id();
+
+	if (!cpumask_test_cpu(cpu, &wq->cpus))
+		cpu = cpumask_first(&wq->cpus);
+
+	return evl_queue_oob_work_on(wq, cpu, work);
+}
+EXPORT_SYMBOL_GPL(evl_queue_oob_work);
+
+/*
+ * Remove @work from its queue unless its handler has started
+ * already, which is not waited for. Returns true if cancelled.
+ */
+bool evl_cancel_oob_work(struct evl_oob_work *work)
+{
+	struct evl_oob_worker *worker = READ_ONCE(work->worker);
+	unsigned long flags;
+	bool ret = false;
+
+	if (worker == NULL)
+		return false;
+
+	raw_spin_lock_irqsave(&worker->lock, flags);
+
+	if (!list_empty(&work->next)) {
+		list_del_init(&work->next);
+		clear_bit(EVL_OOB_WORK_PENDING, &work->flags);
+		ret = true;
+	}
+
+	raw_spin_unlock_irqrestore(&worker->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(evl_cancel_oob_work);
+
+static void stop_oob_workers(struct evl_oob_workqueue *wq)
+{
+	struct evl_oob_worker *worker;
+	int cpu;
+
+	for_each_cpu(cpu, &wq->cpus) {
+		worker = per_cpu_ptr(wq->workers, cpu);
+		evl_stop_kthread(&worker->kthread);
+		evl_destroy_flag(&worker->kick);
+	}
+}
+
+/* In-band only. */
+struct evl_oob_workqueue *
+evl_alloc_oob_workqueue(const char *name, int priority)
+{
+	struct evl_oob_workqueue *wq;
+	struct evl_oob_worker *worker;
+	int cpu, ret;
+
+	wq = kzalloc(sizeof(*wq), GFP_KERNEL);
+	if (wq == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	wq->workers = alloc_percpu(struct evl_oob_worker);
+	if (wq->workers == NULL) {
+		kfree(wq);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	for_each_cpu(cpu, &evl_oob_cpus) {
+		worker = per_cpu_ptr(wq->workers, cpu);
+		raw_spin_lock_init(&worker->lock);
+		INIT_LIST_HEAD(&worker->queue);
+		evl_init_flag(&worker->kick);
+		ret = evl_run_kthread_on_cpu(&worker->kthread, cpu,
+					oob_worker, worker, priority,
+					EVL_CLONE_PUBLIC,
+					"%s:%d", name, cpu);
+		if (ret) {
+			evl_destroy_flag(&worker->kick);
+			stop_oob_workers(wq);
+			free_percpu(wq->workers);
+			kfree(wq);
+			return ERR_PTR(ret);
+		}
+		cpumask_set_cpu(cpu, &wq->cpus);
+	}
+
+	return wq;
+}
+EXPORT_SYMBOL_GPL(evl_alloc_oob_workqueue);
+
+/* In-band only, pending work is dropped. */
+void evl_destroy_oob_workqueue(struct evl_oob_workqueue *wq)
+{
+	stop_oob_workers(wq);
+	free_percpu(wq->workers);
+	kfree(wq);
+}
+EXPORT_SYMBOL_GPL(evl_destroy_oob_workqueue);
+
+int __init evl_init_oob_workqueues(void)
+{
+	evl_oob_wq = evl_alloc_oob_workqueue("oob-wq", EVL_OOB_WQ_PRIO);
+	if (IS_ERR(evl_oob_wq))
+		return PTR_ERR(evl_oob_wq);
+
+	evl_oob_highpri_wq = evl_alloc_oob_workqueue("oob-wq-hi",
+						EVL_OOB_WQ_HIGHPRIO);
+	if (IS_ERR(evl_oob_highpri_wq)) {
+		evl_destroy_oob_workqueue(evl_oob_wq);
+		return PTR_ERR(evl_oob_highpri_wq);
+	}
+
+	return 0;
+}
+
+struct inband_wakeup_queue {
+	struct llist_head list;
+	struct irq_work irq_work;
+#ifdef CONFIG_EVL_RUNSTATS
+	unsigned long requests;
+	unsigned long batches;
+	unsigned int max_batch;
+#endif
+};
+
+static void run_inband_wakeups(struct irq_work *irq_work);
+
+static DEFINE_PER_CPU(struct inband_wakeup_queue, inband_wakeups) = {
+	.irq_work = IRQ_WORK_INIT(run_inband_wakeups),
+};
+
+static void run_inband_wakeups(struct irq_work *irq_work) /* in-band */
+{
+	struct inband_wakeup_queue *q =
+		container_of(irq_work, struct inband_wakeup_queue, irq_work);
+	struct evl_inband_wakeup *wakeup, *tmp;
+	struct llist_node *list;
+	unsigned int count = 0;
+
+	list = llist_reverse_order(llist_del_all(&q->list));
+	llist_for_each_entry_safe(wakeup, tmp, list, node) {
+		clear_bit(EVL_INBAND_WAKEUP_PENDING, &wakeup->flags);
+		smp_mb__after_atomic();
+		wakeup->handler(wakeup);
+		count++;
+	}
+
+#ifdef CONFIG_EVL_RUNSTATS
+	if (count) {
+		WRITE_ONCE(q->batches, q->batches + 1);
+		if (count > q->max_batch)
+			WRITE_ONCE(q->max_batch, count);
+	}
+#endif
+}
+
+/*
+ * Queue a wake up request for the in-band stage, handled on the
+ * current CPU. Like irq_work_queue(), return false if @wakeup is
+ * already pending. Only the first request queued since the last run
+ * raises the irq_work, so that a burst of oob events triggering
+ * in-band wake ups only costs a single in-band interrupt. Callable
+ * from any stage.
+ */
+bool evl_queue_inband_wakeup(struct evl_inband_wakeup *wakeup)
+{
+	struct inband_wakeup_queue *q;
+	unsigned long flags;
+
+	if (test_and_set_bit(EVL_INBAND_WAKEUP_PENDING, &wakeup->flags))
+		return false;
+
+	flags = hard_local_irq_save();
+	q = this_cpu_ptr(&inband_wakeups);
+#ifdef CONFIG_EVL_RUNSTATS
+	WRITE_ONCE(q->requests, q->requests + 1);
+#endif
+	if (llist_add(&wakeup->node, &q->list))
+		irq_work_queue(&q->irq_work);
+	hard_local_irq_restore(flags);
+
+	return true;
+}
+EXPORT_SYMBOL_GPL(evl_queue_inband_wakeup);
+
+#ifdef CONFIG_EVL_RUNSTATS
+
+/*
+ * One line per online CPU: count of wake up requests, count of
+ * in-band runs they were batched into, largest batch.
+ */
+ssize_t evl_show_inband_wakeups(char *buf, size_t size)
+{
+	struct inband_wakeup_queue *q;
+	ssize_t len = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		q = per_cpu_ptr(&inband_wakeups, cpu);
+		len += scnprintf(buf + len, size - len, "%d %lu %lu %u\n",
+				cpu, READ_ONCE(q->requests),
+				READ_ONCE(q->batches),
+				READ_ONCE(q->max_batch));
+	}
+
+	return len;
+}
+
+#endif
@@ -6,9 +6,11 @@
 
 #include <linux/types.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/uio.h>
 #include <linux/kernel.h>
 #include <linux/poll.h>
-#include <linux/irq_work.h>
 #include <linux/wait.h>
 #include <linux/log2.h>
 #include <linux/atomic.h>
@@ -18,8 +20,21 @@
 #include <evl/sched.h>
 #include <evl/poll.h>
 #include <evl/flag.h>
+#include <evl/work.h>
+#include <evl/memory.h>
+#include <evl/uaccess.h>
+#include <evl/uio.h>
 #include <uapi/evl/xbuf-abi.h>
 
+/*
+ * EVL_CLONE_UNICAST turns the outbound ring into a work queue: every
+ * message goes to a single out-of-band consumer, the one with the
+ * highest priority among the waiters, instead of waking them all up
+ * to compete for the data.
+ */
+#define EVL_XBUF_CLONE_FLAGS	\
+	(EVL_CLONE_PUBLIC|EVL_CLONE_UNICAST)
+
 struct xbuf_ring {
 	void *bufmem;
 	size_t bufsz;
@@ -34,6 +49,7 @@ struct xbuf_ring {
 	void (*unlock)(struct xbuf_ring *ring, unsigned long flags);
 	int (*wait_input)(struct xbuf_ring *ring, size_t len, size_t avail);
 	void (*signal_input)(struct xbuf_ring *ring, bool sigpoll);
+	void (*relay_input)(struct xbuf_ring *ring);
 	int (*wait_output)(struct xbuf_ring *ring, size_t len);
 	void (*signal_output)(struct xbuf_ring *ring, bool sigpoll);
 };
@@ -41,7 +57,7 @@ struct xbuf_ring {
 struct xbuf_inbound {		/* oob_write->read */
 	struct wait_queue_head i_event;
 	struct evl_flag o_event;
-	struct irq_work irq_work;
+	struct evl_inband_wakeup wakeup;
 	struct xbuf_ring ring;
 	hard_spinlock_t lock;
 };
@@ -49,7 +65,7 @@ struct xbuf_inbound {		/* oob_write->read */
 struct xbuf_outbound {		/* write->oob_read */
 	struct evl_wait_queue i_event;
 	struct wait_queue_head o_event;
-	struct irq_work irq_work;
+	struct evl_inband_wakeup wakeup;
 	struct xbuf_ring ring;
 };
 
@@ -63,6 +79,7 @@ struct evl_xbuf {
 struct xbuf_rdesc {
 	char *buf;
 	char *buf_ptr;
+	struct iov_iter *iter;
 	size_t count;
 	int (*xfer)(struct xbuf_rdesc *dst, char *src, size_t len);
 };
@@ -79,9 +96,15 @@ static int write_to_kernel(struct xbuf_rdesc *dst, char *src, size_t len)
 	return 0;
 }
 
+static int write_to_iter(struct xbuf_rdesc *dst, char *src, size_t len)
+{
+	return len - copy_to_iter(src, len, dst->iter);
+}
+
 struct xbuf_wdesc {
 	const char *buf;
 	const char *buf_ptr;
+	struct iov_iter *iter;
 	size_t count;
 	int (*xfer)(char *dst, struct xbuf_wdesc *src, size_t len);
 };
@@ -98,23 +121,18 @@ static int read_from_kernel(char *dst, struct xbuf_wdesc *src, size_t len)
 	return 0;
 }
 
-static ssize_t do_xbuf_read(struct xbuf_ring *ring,
-			struct xbuf_rdesc *rd, int f_flags)
+static int read_from_iter(char *dst, struct xbuf_wdesc *src, size_t len)
 {
-	ssize_t len, ret, rbytes, n;
-	unsigned int rdoff, avail;
-	unsigned long flags;
-	bool sigpoll;
-	int xret;
-
-	len = rd->count;
-	if (len == 0)
-		return 0;
+	return len - copy_from_iter(dst, len, src->iter);
+}
 
-	if (ring->bufsz == 0)
-		return -ENOBUFS;
-retry:
-	rd->buf_ptr = rd->buf;
+static int reserve_read(struct xbuf_ring *ring, size_t *lenp,
+			int f_flags, unsigned int *rdoffp)
+{
+	size_t len = *lenp;
+	unsigned long flags;
+	unsigned int avail;
+	int ret;
 
 	for (;;) {
 		flags = ring->lock(ring);
@@ -127,98 +145,128 @@ retry:
 		 * flight to userland as we drop the lock during copy.
 		 */
 		avail = ring->fillsz - ring->rdrsvd;
-		if (avail < len) {
-			if (f_flags & O_NONBLOCK) {
-				if (avail == 0) {
-					ret = -EAGAIN;
-					break;
-				}
-				len = avail;
-			} else {
-				if (len > ring->bufsz) {
-					ret = -EINVAL;
-					break;
-				}
+		if (avail >= len)
+			break;
+
+		if (f_flags & O_NONBLOCK) {
+			if (avail == 0) {
 				ring->unlock(ring, flags);
-				ret = ring->wait_input(ring, len, avail);
-				if (unlikely(ret)) {
-					if (ret == -EAGAIN) {
-						len = avail;
-						goto retry;
-					}
-					return ret;
-				}
-				continue;
+				return -EAGAIN;
 			}
+			len = avail;
+			break;
 		}
 
-		/* Reserve a read slot into the circular buffer. */
-		rdoff = ring->rdoff;
-		ring->rdoff = (rdoff + len) % ring->bufsz;
-		ring->rdpending++;
-		ring->rdrsvd += len;
-		rbytes = ret = len;
-
-		do {
-			if (rdoff + rbytes > ring->bufsz)
-				n = ring->bufsz - rdoff;
-			else
-				n = rbytes;
-
-			/*
-			 * Drop the lock before copying data to
-			 * user. The read slot is consumed in any
-			 * case: the non-copied portion of the message
-			 * is lost on bad write.
-			 */
+		if (len > ring->bufsz) {
 			ring->unlock(ring, flags);
+			return -EINVAL;
+		}
 
-			xret = rd->xfer(rd, ring->bufmem + rdoff, n);
-			flags = ring->lock(ring);
-			if (xret) {
-				ret = -EFAULT;
-				break;
-			}
-
-			rd->buf_ptr += n;
-			rbytes -= n;
-			rdoff = (rdoff + n) % ring->bufsz;
-		} while (rbytes > 0);
-
-		if (--ring->rdpending == 0) {
-			/* sigpoll := full -> non-full transition. */
-			sigpoll = ring->fillsz == ring->bufsz;
-			ring->fillsz -= ring->rdrsvd;
-			ring->rdrsvd = 0;
-			ring->signal_output(ring, sigpoll);
+		ring->unlock(ring, flags);
+		ret = ring->wait_input(ring, len, avail);
+		if (unlikely(ret)) {
+			if (ret != -EAGAIN)
+				return ret;
+			len = avail;
 		}
-		break;
 	}
 
-	ring->unlock(ring, flags);
+	/* Reserve a read slot into the circular buffer. */
+	*rdoffp = ring->rdoff;
+	ring->rdoff = (ring->rdoff + len) % ring->bufsz;
+	ring->rdpending++;
+	ring->rdrsvd += len;
+	*lenp = len;
 
-	evl_schedule();
+	/* Pass on what we left to the next consumer in line. */
+	if (ring->relay_input && ring->fillsz > ring->rdrsvd)
+		ring->relay_input(ring);
 
-	return ret;
+	ring->unlock(ring, flags);
+
+	return 0;
 }
 
-static ssize_t do_xbuf_write(struct xbuf_ring *ring,
-			struct xbuf_wdesc *wd, int f_flags)
+static int release_read(struct xbuf_ring *ring)
 {
-	ssize_t len, ret, wbytes, n;
-	unsigned int wroff, avail;
 	unsigned long flags;
 	bool sigpoll;
+	int ret = 0;
+
+	flags = ring->lock(ring);
+
+	if (ring->rdpending == 0) {
+		ret = -EINVAL;
+	} else if (--ring->rdpending == 0) {
+		/* sigpoll := full -> non-full transition. */
+		sigpoll = ring->fillsz == ring->bufsz;
+		ring->fillsz -= ring->rdrsvd;
+		ring->rdrsvd = 0;
+		ring->signal_output(ring, sigpoll);
+	}
+
+	ring->unlock(ring, flags);
+
+	return ret;
+}
+
+static ssize_t do_xbuf_read(struct xbuf_ring *ring,
+			struct xbuf_rdesc *rd, int f_flags)
+{
+	unsigned int rdoff;
+	size_t len, n;
+	ssize_t ret;
 	int xret;
 
-	len = wd->count;
+	len = rd->count;
 	if (len == 0)
 		return 0;
 
 	if (ring->bufsz == 0)
 		return -ENOBUFS;
 
-	wd->buf_ptr = wd->buf;
+	ret = reserve_read(ring, &len, f_flags, &rdoff);
+	if (ret)
+		return ret;
+
+	rd->buf_ptr = rd->buf;
+	ret = len;
+
+	do {
+		if (rdoff + len > ring->bufsz)
+			n = ring->bufsz - rdoff;
+		else
+			n = len;
+
+		/*
+		 * The read slot is consumed in any case: the
+		 * non-copied portion of the message is lost on bad
+		 * write.
+		 */
+		xret = rd->xfer(rd, ring->bufmem + rdoff, n);
+		if (xret) {
+			ret = -EFAULT;
+			break;
+		}
+
+		rd->buf_ptr += n;
+		len -= n;
+		rdoff = (rdoff + n) % ring->bufsz;
+	} while (len > 0);
+
+	release_read(ring);
+
+	evl_schedule();
+
+	return ret;
+}
+
+static int reserve_write(struct xbuf_ring *ring, size_t len,
+			int f_flags, unsigned int *wroffp)
+{
+	unsigned long flags;
+	unsigned int avail;
+	int ret;
 
 	for (;;) {
 		flags = ring->lock(ring);
@@ -227,63 +275,183 @@ static ssize_t do_xbuf_write(struct xbuf_ring *ring,
 		 * entire message atomically or block.
 		 */
 		avail = ring->fillsz + ring->wrrsvd;
-		if (avail + len > ring->bufsz) {
-			ring->unlock(ring, flags);
+		if (avail + len <= ring->bufsz)
+			break;
 
-			if (f_flags & O_NONBLOCK)
-				return -EAGAIN;
+		ring->unlock(ring, flags);
 
-			ret = ring->wait_output(ring, len);
-			if (unlikely(ret))
-				return ret;
+		if (f_flags & O_NONBLOCK)
+			return -EAGAIN;
 
-			continue;
-		}
+		ret = ring->wait_output(ring, len);
+		if (unlikely(ret))
+			return ret;
+	}
 
-		/* Reserve a write slot into the circular buffer. */
-		wroff = ring->wroff;
-		ring->wroff = (wroff + len) % ring->bufsz;
-		ring->wrpending++;
-		ring->wrrsvd += len;
-		wbytes = ret = len;
-
-		do {
-			if (wroff + wbytes > ring->bufsz)
-				n = ring->bufsz - wroff;
-			else
-				n = wbytes;
-
-			/*
-			 * We have to drop the lock while reading in
-			 * data, but we can't rollback on bad read
-			 * from user because some other thread might
-			 * have populated the memory ahead of our
-			 * write slot already: bluntly clear the
-			 * unavailable bytes on copy error.
-			 */
-			ring->unlock(ring, flags);
-			xret = wd->xfer(ring->bufmem + wroff, wd, n);
-			flags = ring->lock(ring);
-			if (xret) {
-				memset(ring->bufmem + wroff + n - xret, 0, xret);
-				ret = -EFAULT;
-				break;
-			}
+	/* Reserve a write slot into the circular buffer. */
+	*wroffp = ring->wroff;
+	ring->wroff = (ring->wroff + len) % ring->bufsz;
+	ring->wrpending++;
+	ring->wrrsvd += len;
+
+	ring->unlock(ring, flags);
+
+	return 0;
+}
+
+static int commit_write(struct xbuf_ring *ring)
+{
+	unsigned long flags;
+	bool sigpoll;
+	int ret = 0;
+
+	flags = ring->lock(ring);
+
+	/*
+	 * The written data only becomes visible to readers once all
+	 * pending write slots are committed, since slots reserved
+	 * later might be filled before earlier ones.
+	 */
+	if (ring->wrpending == 0) {
+		ret = -EINVAL;
+	} else if (--ring->wrpending == 0) {
+		sigpoll = ring->fillsz == 0;
+		ring->fillsz += ring->wrrsvd;
+		ring->wrrsvd = 0;
+		ring->signal_input(ring, sigpoll);
+	}
+
+	ring->unlock(ring, flags);
+
+	return ret;
+}
+
+static void clear_slot(struct xbuf_ring *ring,
+		unsigned int off, size_t len)
+{
+	size_t n = min_t(size_t, len, ring->bufsz - off);
 
-			wd->buf_ptr += n;
-			wbytes -= n;
-			wroff = (wroff + n) % ring->bufsz;
-		} while (wbytes > 0);
+	memset(ring->bufmem + off, 0, n);
+	if (len > n)
+		memset(ring->bufmem, 0, len - n);
+}
+
+static ssize_t do_xbuf_write(struct xbuf_ring *ring,
+			struct xbuf_wdesc *wd, int f_flags)
+{
+	unsigned int wroff;
+	size_t len, n;
+	ssize_t ret;
+	int xret;
 
-		if (--ring->wrpending == 0) {
-			sigpoll = ring->fillsz == 0;
-			ring->fillsz += ring->wrrsvd;
-			ring->wrrsvd = 0;
-			ring->signal_input(ring, sigpoll);
+	len = wd->count;
+	if (len == 0)
+		return 0;
+
+	if (ring->bufsz == 0)
+		return -ENOBUFS;
+
+	ret = reserve_write(ring, len, f_flags, &wroff);
+	if (ret)
+		return ret;
+
+	wd->buf_ptr = wd->buf;
+	ret = len;
+
+	do {
+		if (wroff + len > ring->bufsz)
+			n = ring->bufsz - wroff;
+		else
+			n = len;
+
+		/*
+		 * We can't rollback on bad read from user because
+		 * some other thread might have populated the memory
+		 * ahead of our write slot already: bluntly clear the
+		 * unavailable bytes on copy error.
+		 */
+		xret = wd->xfer(ring->bufmem + wroff, wd, n);
+		if (xret) {
+			clear_slot(ring, wroff + n - xret, len - n + xret);
+			ret = -EFAULT;
+			break;
 		}
 
-		ring->unlock(ring, flags);
+		wd->buf_ptr += n;
+		len -= n;
+		wroff = (wroff + n) % ring->bufsz;
+	} while (len > 0);
+
+	commit_write(ring);
+
+	evl_schedule();
+
+	return ret;
+}
+
+/*
+ * In-place frame exchange through the ring mappings. @rd_ring is
+ * the ring the caller consumes from, @wr_ring the one it produces
+ * to, depending on the calling stage.
+ */
+static long xbuf_frame_ioctl(struct xbuf_ring *rd_ring,
+			struct xbuf_ring *wr_ring,
+			unsigned int cmd, unsigned long arg,
+			int f_flags)
+{
+	struct evl_xbuf_frame __user *u_frame;
+	struct evl_xbuf_frame frame;
+	unsigned int off;
+	size_t len;
+	long ret;
+
+	u_frame = (typeof(u_frame))arg;
+	ret = raw_copy_from_user(&frame, u_frame, sizeof(frame));
+	if (ret)
+		return -EFAULT;
+
+	switch (cmd) {
+	case EVL_XBUFIOC_RESERVE:
+		if (wr_ring->bufsz == 0)
+			return -ENOBUFS;
+		if (frame.len == 0 || frame.len > wr_ring->bufsz)
+			return -EINVAL;
+		ret = reserve_write(wr_ring, frame.len, f_flags, &off);
+		if (ret)
+			return ret;
+		frame.offset = off;
+		if (!raw_copy_to_user(u_frame, &frame, sizeof(frame)))
+			return 0;
+		/* The slot cannot be dropped, push zeroes. */
+		clear_slot(wr_ring, off, frame.len);
+		commit_write(wr_ring);
+		ret = -EFAULT;
+		break;
+	case EVL_XBUFIOC_COMMIT:
+		ret = commit_write(wr_ring);
 		break;
+	case EVL_XBUFIOC_ACQUIRE:
+		if (rd_ring->bufsz == 0)
+			return -ENOBUFS;
+		if (frame.len == 0)
+			return -EINVAL;
+		len = frame.len;
+		ret = reserve_read(rd_ring, &len, f_flags, &off);
+		if (ret)
+			return ret;
+		frame.offset = off;
+		frame.len = len;
+		if (!raw_copy_to_user(u_frame, &frame, sizeof(frame)))
+			return 0;
+		/* Like with read(), the frame is lost on bad write. */
+		release_read(rd_ring);
+		ret = -EFAULT;
+		break;
+	case EVL_XBUFIOC_RELEASE:
+		ret = release_read(rd_ring);
+		break;
+	default:
+		return -ENOTTY;
 	}
 
 	evl_schedule();
@@ -291,6 +459,95 @@ static ssize_t do_xbuf_write(struct xbuf_ring *ring,
 	return ret;
 }
 
+static long xbuf_batch_ioctl(struct xbuf_ring *rd_ring,
+			struct xbuf_ring *wr_ring,
+			unsigned int cmd, unsigned long arg,
+			int f_flags)
+{
+	struct iovec fast_iov[UIO_FASTIOV], *iov, __user *u_iov;
+	struct evl_xbuf_batch __user *u_batch;
+	struct evl_xbuf_batch batch;
+	__u32 __user *u_lens;
+	ssize_t ret = 0;
+	__u32 n;
+
+	u_batch = (typeof(u_batch))arg;
+	if (raw_copy_from_user(&batch, u_batch, sizeof(batch)))
+		return -EFAULT;
+
+	if (batch.iovlen == 0)
+		return -EINVAL;
+
+	u_iov = evl_valptr64(batch.iov_ptr, struct iovec);
+	iov = evl_load_uio(u_iov, batch.iovlen, fast_iov);
+	if (IS_ERR(iov))
+		return PTR_ERR(iov);
+
+	u_lens = evl_valptr64(batch.lens_ptr, __u32);
+
+	for (n = 0; n < batch.iovlen; n++) {
+		if (cmd == EVL_XBUFIOC_READV) {
+			struct xbuf_rdesc rd = {
+				.buf = iov[n].iov_base,
+				.count = iov[n].iov_len,
+				.xfer = write_to_user,
+			};
+			ret = do_xbuf_read(rd_ring, &rd, f_flags);
+		} else {
+			struct xbuf_wdesc wd = {
+				.buf = iov[n].iov_base,
+				.count = iov[n].iov_len,
+				.xfer = read_from_user,
+			};
+			ret = do_xbuf_write(wr_ring, &wd, f_flags);
+		}
+
+		if (ret < 0)
+			break;
+
+		/* The message is gone already, count it regardless. */
+		if (u_lens && raw_put_user((__u32)ret, u_lens + n)) {
+			ret = -EFAULT;
+			n++;
+			break;
+		}
+
+		/* Only the first message may block. */
+		f_flags |= O_NONBLOCK;
+	}
+
+	if (iov != fast_iov)
+		evl_free(iov);
+
+	if (n == 0)
+		return ret;
+
+	if (raw_put_user(n, &u_batch->count))
+		return -EFAULT;
+
+	/* Faults are reported even past the first message. */
+	return ret == -EFAULT ? -EFAULT : 0;
+}
+
+static long do_xbuf_ioctl(struct xbuf_ring *rd_ring,
+			struct xbuf_ring *wr_ring,
+			unsigned int cmd, unsigned long arg,
+			int f_flags)
+{
+	switch (cmd) {
+	case EVL_XBUFIOC_RESERVE:
+	case EVL_XBUFIOC_COMMIT:
+	case EVL_XBUFIOC_ACQUIRE:
+	case EVL_XBUFIOC_RELEASE:
+		return xbuf_frame_ioctl(rd_ring, wr_ring, cmd, arg, f_flags);
+	case EVL_XBUFIOC_READV:
+	case EVL_XBUFIOC_WRITEV:
+		return xbuf_batch_ioctl(rd_ring, wr_ring, cmd, arg, f_flags);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static unsigned long inbound_lock(struct xbuf_ring *ring)
 {
 	struct evl_xbuf *xbuf = container_of(ring, struct evl_xbuf, ibnd.ring);
@@ -333,11 +590,11 @@ static int inbound_wait_input(struct xbuf_ring *ring, size_t len, size_t avail)
 	return wait_event_interruptible(ibnd->i_event, ring->fillsz >= len);
 }
 
-static void resume_inband_reader(struct irq_work *work)
+static void resume_inband_reader(struct evl_inband_wakeup *wakeup)
 {
-	struct evl_xbuf *xbuf = container_of(work, struct evl_xbuf, ibnd.irq_work);
+	struct evl_xbuf *xbuf = container_of(wakeup, struct evl_xbuf, ibnd.wakeup);
 
-	wake_up(&xbuf->ibnd.i_event);
+	wake_up_poll(&xbuf->ibnd.i_event, EPOLLIN|EPOLLRDNORM);
 }
 
 /* ring locked, irqsoff */
@@ -345,7 +602,7 @@ static void inbound_signal_input(struct xbuf_ring *ring, bool sigpoll)
 {
 	struct evl_xbuf *xbuf = container_of(ring, struct evl_xbuf, ibnd.ring);
 
-	irq_work_queue(&xbuf->ibnd.irq_work);
+	evl_queue_inband_wakeup(&xbuf->ibnd.wakeup);
 }
 
 static int inbound_wait_output(struct xbuf_ring *ring, size_t len)
@@ -391,10 +648,54 @@ static ssize_t xbuf_write(struct file *filp, const char __user *u_buf,
 	return do_xbuf_write(&xbuf->obnd.ring, &wd, filp->f_flags);
 }
 
+/*
+ * Vectored and io_uring I/O from the in-band stage, including
+ * registered buffers. IOCB_NOWAIT requests behave as O_NONBLOCK
+ * ones, so that io_uring can issue them inline then wait for
+ * readiness via xbuf_poll() on -EAGAIN, instead of having a worker
+ * thread block on the ring.
+ */
+static inline int iocb_flags_to_f_flags(struct kiocb *iocb)
+{
+	int f_flags = iocb->ki_filp->f_flags;
+
+	if (iocb->ki_flags & IOCB_NOWAIT)
+		f_flags |= O_NONBLOCK;
+
+	return f_flags;
+}
+
+static ssize_t xbuf_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct evl_xbuf *xbuf = element_of(iocb->ki_filp, struct evl_xbuf);
+	struct xbuf_rdesc rd = {
+		.iter = to,
+		.count = iov_iter_count(to),
+		.xfer = write_to_iter,
+	};
+
+	return do_xbuf_read(&xbuf->ibnd.ring, &rd, iocb_flags_to_f_flags(iocb));
+}
+
+static ssize_t xbuf_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct evl_xbuf *xbuf = element_of(iocb->ki_filp, struct evl_xbuf);
+	struct xbuf_wdesc wd = {
+		.iter = from,
+		.count = iov_iter_count(from),
+		.xfer = read_from_iter,
+	};
+
+	return do_xbuf_write(&xbuf->obnd.ring, &wd, iocb_flags_to_f_flags(iocb));
+}
+
 static long xbuf_ioctl(struct file *filp,
 		unsigned int cmd, unsigned long arg)
 {
-	return -ENOTTY;
+	struct evl_xbuf *xbuf = element_of(filp, struct evl_xbuf);
+
+	return do_xbuf_ioctl(&xbuf->ibnd.ring, &xbuf->obnd.ring,
+			cmd, arg, filp->f_flags);
 }
 
 static __poll_t xbuf_poll(struct file *filp, poll_table *wait)
@@ -428,7 +729,10 @@ static __poll_t xbuf_poll(struct file *filp, poll_table *wait)
 static long xbuf_oob_ioctl(struct file *filp,
 			unsigned int cmd, unsigned long arg)
 {
-	return -ENOTTY;
+	struct evl_xbuf *xbuf = element_of(filp, struct evl_xbuf);
+
+	return do_xbuf_ioctl(&xbuf->obnd.ring, &xbuf->ibnd.ring,
+			cmd, arg, filp->f_flags);
 }
 
 static unsigned long outbound_lock(struct xbuf_ring *ring)
@@ -452,11 +756,27 @@ static int outbound_wait_input(struct xbuf_ring *ring, size_t len, size_t avail)
 {
 	struct evl_xbuf *xbuf = container_of(ring, struct evl_xbuf, obnd.ring);
 	struct xbuf_outbound *obnd = &xbuf->obnd;
+	unsigned long flags;
+	int ret;
 
 	if (avail > 0 && wq_has_sleeper(&obnd->o_event))
 		return -EAGAIN;
 
-	return evl_wait_event(&obnd->i_event, ring->fillsz >= len);
+	ret = evl_wait_event(&obnd->i_event, ring->fillsz >= len);
+
+	/*
+	 * In work queue mode, we might have been picked for consuming
+	 * the data right before bailing out, in which case the next
+	 * waiter in line should get it instead.
+	 */
+	if (unlikely(ret) && ring->relay_input) {
+		flags = ring->lock(ring);
+		if (ring->fillsz > ring->rdrsvd)
+			ring->relay_input(ring);
+		ring->unlock(ring, flags);
+	}
+
+	return ret;
 }
 
 /* obnd.i_event locked, hard irqs off */
@@ -467,7 +787,21 @@ static void outbound_signal_input(struct xbuf_ring *ring, bool sigpoll)
 	if (sigpoll)
 		evl_signal_poll_events(&xbuf->poll_head, POLLIN|POLLRDNORM);
 
-	evl_flush_wait_locked(&xbuf->obnd.i_event, 0);
+	if (ring->relay_input)
+		ring->relay_input(ring);
+	else
+		evl_flush_wait_locked(&xbuf->obnd.i_event, 0);
+}
+
+/*
+ * obnd.i_event locked, hard irqs off. Waiters are queued by priority,
+ * so the head is the best candidate for consuming the input.
+ */
+static void outbound_relay_input(struct xbuf_ring *ring)
+{
+	struct evl_xbuf *xbuf = container_of(ring, struct evl_xbuf, obnd.ring);
+
+	evl_wake_up_head(&xbuf->obnd.i_event);
 }
 
 static int outbound_wait_output(struct xbuf_ring *ring, size_t len)
@@ -478,18 +812,24 @@ static int outbound_wait_output(struct xbuf_ring *ring, size_t len)
 					ring->fillsz + len <= ring->bufsz);
 }
 
-static void resume_inband_writer(struct irq_work *work)
+static void resume_inband_writer(struct evl_inband_wakeup *wakeup)
 {
-	struct evl_xbuf *xbuf = container_of(work, struct evl_xbuf, obnd.irq_work);
+	struct evl_xbuf *xbuf = container_of(wakeup, struct evl_xbuf, obnd.wakeup);
 
-	wake_up(&xbuf->obnd.o_event);
+	wake_up_poll(&xbuf->obnd.o_event, EPOLLOUT|EPOLLWRNORM);
 }
 
 static void outbound_signal_output(struct xbuf_ring *ring, bool sigpoll)
 {
 	struct evl_xbuf *xbuf = container_of(ring, struct evl_xbuf, obnd.ring);
 
-	irq_work_queue(&xbuf->obnd.irq_work);
+	/*
+	 * Slots freed by consumers are only signaled to the in-band
+	 * stage if some writer or poller waits for them, the pending
+	 * wake up request coalescing multiple releases until it runs.
+	 */
+	if (wq_has_sleeper(&xbuf->obnd.o_event))
+		evl_queue_inband_wakeup(&xbuf->obnd.wakeup);
 }
 
 static ssize_t xbuf_oob_read(struct file *filp,
@@ -546,6 +886,67 @@ static __poll_t xbuf_oob_poll(struct file *filp,
 	return ready;
 }
 
+static int map_ring(struct vm_area_struct *vma,
+		struct xbuf_ring *ring)
+{
+	size_t len = vma->vm_end - vma->vm_start;
+	size_t mapsz = PAGE_ALIGN(ring->bufsz);
+	int ret;
+
+	if (len == mapsz)
+		return remap_vmalloc_range_partial(vma, vma->vm_start,
+						ring->bufmem, 0, mapsz);
+
+	/*
+	 * Mirror the ring right after itself, so that frames wrapping
+	 * around the end of the ring are contiguous in user memory.
+	 * This only works if there is no padding at the end of the
+	 * first copy.
+	 */
+	if (len != mapsz * 2 || mapsz != ring->bufsz)
+		return -EINVAL;
+
+	ret = remap_vmalloc_range_partial(vma, vma->vm_start,
+					ring->bufmem, 0, mapsz);
+	if (ret)
+		return ret;
+
+	return remap_vmalloc_range_partial(vma, vma->vm_start + mapsz,
+					ring->bufmem, 0, mapsz);
+}
+
+static int xbuf_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct evl_xbuf *xbuf = element_of(filp, struct evl_xbuf);
+	struct xbuf_ring *i_ring = &xbuf->ibnd.ring, *o_ring = &xbuf->obnd.ring;
+	unsigned long o_pgoff;
+
+	/* The outbound ring follows the inbound one, if any. */
+	o_pgoff = PAGE_ALIGN(i_ring->bufsz) >> PAGE_SHIFT;
+
+	if (vma->vm_pgoff == 0 && i_ring->bufsz > 0)
+		return map_ring(vma, i_ring);
+
+	if (vma->vm_pgoff == o_pgoff && o_ring->bufsz > 0)
+		return map_ring(vma, o_ring);
+
+	return -EINVAL;
+}
+
+static int xbuf_open(struct inode *inode, struct file *filp)
+{
+	int ret;
+
+	ret = evl_open_element(inode, filp);
+	if (ret)
+		return ret;
+
+	/* xbuf_read_iter() and xbuf_write_iter() honor IOCB_NOWAIT. */
+	filp->f_mode |= FMODE_NOWAIT;
+
+	return 0;
+}
+
 static int xbuf_release(struct inode *inode, struct file *filp)
 {
 	struct evl_xbuf *xbuf = element_of(filp, struct evl_xbuf);
@@ -557,16 +958,19 @@ static int xbuf_release(struct inode *inode, struct file *filp)
 }
 
 static const struct file_operations xbuf_fops = {
-	.open		= evl_open_element,
+	.open		= xbuf_open,
 	.release	= xbuf_release,
 	.unlocked_ioctl	= xbuf_ioctl,
 	.read		= xbuf_read,
 	.write		= xbuf_write,
+	.read_iter	= xbuf_read_iter,
+	.write_iter	= xbuf_write_iter,
 	.poll		= xbuf_poll,
 	.oob_ioctl	= xbuf_oob_ioctl,
 	.oob_read	= xbuf_oob_read,
 	.oob_write	= xbuf_oob_write,
 	.oob_poll	= xbuf_oob_poll,
+	.mmap		= xbuf_mmap,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl	= compat_ptr_ioctl,
 	.compat_oob_ioctl  = compat_ptr_oob_ioctl,
@@ -624,6 +1028,54 @@ ssize_t evl_write_xbuf(struct evl_xbuf *xbuf, const void *buf,
 }
 EXPORT_SYMBOL_GPL(evl_write_xbuf);
 
+/*
+ * Zero-copy variant of evl_write_xbuf(): reserve @count bytes in the
+ * ring, which the caller fills in place (e.g. from a DMA completion
+ * handler), then makes visible to readers as a single message by
+ * calling evl_commit_xbuf(). The reserved space may wrap around the
+ * end of the ring, in which case it spans both segments of @slot.
+ * Readers are held back until every slot reserved before the commit
+ * is committed too, so reservations should be short-lived. A caller
+ * which cannot fill a slot should clear it before committing it, the
+ * space cannot be given back.
+ */
+int evl_reserve_xbuf(struct evl_xbuf *xbuf, size_t count,
+		struct evl_xbuf_slot *slot, int f_flags)
+{
+	struct xbuf_ring *ring = &xbuf->ibnd.ring;
+	unsigned int wroff;
+	int ret;
+
+	if (ring->bufsz == 0)
+		return -ENOBUFS;
+
+	if (count == 0 || count > ring->bufsz)
+		return -EINVAL;
+
+	if (!(f_flags & O_NONBLOCK) && evl_cannot_block())
+		return -EPERM;
+
+	ret = reserve_write(ring, count, f_flags, &wroff);
+	if (ret)
+		return ret;
+
+	slot->ptr[0] = ring->bufmem + wroff;
+	slot->len[0] = min_t(size_t, count, ring->bufsz - wroff);
+	slot->ptr[1] = ring->bufmem;
+	slot->len[1] = count - slot->len[0];
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(evl_reserve_xbuf);
+
+void evl_commit_xbuf(struct evl_xbuf *xbuf)
+{
+	commit_write(&xbuf->ibnd.ring);
+
+	evl_schedule();
+}
+EXPORT_SYMBOL_GPL(evl_commit_xbuf);
+
 static struct evl_element *
 xbuf_factory_build(struct evl_factory *fac, const char __user *u_name,
 		void __user *u_attrs, int clone_flags, u32 *state_offp)
@@ -637,7 +1089,7 @@ xbuf_factory_build(struct evl_factory *fac, const char __user *u_name,
 	if (ret)
 		return ERR_PTR(-EFAULT);
 
-	if (clone_flags & ~EVL_CLONE_PUBLIC)
+	if (clone_flags & ~EVL_XBUF_CLONE_FLAGS)
 		return ERR_PTR(-EINVAL);
 
 	/* LART */
@@ -651,7 +1103,7 @@ xbuf_factory_build(struct evl_factory *fac, const char __user *u_name,
 		return ERR_PTR(-ENOMEM);
 
 	if (attrs.i_bufsz > 0) {
-		i_bufmem = kzalloc(attrs.i_bufsz, GFP_KERNEL);
+		i_bufmem = vmalloc_user(attrs.i_bufsz);
 		if (i_bufmem == NULL) {
 			ret = -ENOMEM;
 			goto fail_ibufmem;
@@ -659,7 +1111,7 @@ xbuf_factory_build(struct evl_factory *fac, const char __user *u_name,
 	}
 
 	if (attrs.o_bufsz > 0) {
-		o_bufmem = kzalloc(attrs.o_bufsz, GFP_KERNEL);
+		o_bufmem = vmalloc_user(attrs.o_bufsz);
 		if (o_bufmem == NULL) {
 			ret = -ENOMEM;
 			goto fail_obufmem;
@@ -675,7 +1127,7 @@ xbuf_factory_build(struct evl_factory *fac, const char __user *u_name,
 	init_waitqueue_head(&xbuf->ibnd.i_event);
 	evl_init_flag(&xbuf->ibnd.o_event);
 	raw_spin_lock_init(&xbuf->ibnd.lock);
-	init_irq_work(&xbuf->ibnd.irq_work, resume_inband_reader);
+	evl_init_inband_wakeup(&xbuf->ibnd.wakeup, resume_inband_reader);
 	xbuf->ibnd.ring.bufmem = i_bufmem;
 	xbuf->ibnd.ring.bufsz = attrs.i_bufsz;
 	xbuf->ibnd.ring.lock = inbound_lock;
@@ -688,13 +1140,15 @@ xbuf_factory_build(struct evl_factory *fac, const char __user *u_name,
 	/* Outbound traffic: write() -> oob_read(). */
 	evl_init_wait(&xbuf->obnd.i_event, &evl_mono_clock, EVL_WAIT_PRIO);
 	init_waitqueue_head(&xbuf->obnd.o_event);
-	init_irq_work(&xbuf->obnd.irq_work, resume_inband_writer);
+	evl_init_inband_wakeup(&xbuf->obnd.wakeup, resume_inband_writer);
 	xbuf->obnd.ring.bufmem = o_bufmem;
 	xbuf->obnd.ring.bufsz = attrs.o_bufsz;
 	xbuf->obnd.ring.lock = outbound_lock;
 	xbuf->obnd.ring.unlock = outbound_unlock;
 	xbuf->obnd.ring.wait_input = outbound_wait_input;
 	xbuf->obnd.ring.signal_input = outbound_signal_input;
+	if (clone_flags & EVL_CLONE_UNICAST)
+		xbuf->obnd.ring.relay_input = outbound_relay_input;
 	xbuf->obnd.ring.wait_output = outbound_wait_output;
 	xbuf->obnd.ring.signal_output = outbound_signal_output;
 
@@ -704,10 +1158,10 @@ xbuf_factory_build(struct evl_factory *fac, const char __user *u_name,
 
 fail_element:
 	if (o_bufmem)
-		kfree(o_bufmem);
+		vfree(o_bufmem);
 fail_obufmem:
 	if (i_bufmem)
-		kfree(i_bufmem);
+		vfree(i_bufmem);
 fail_ibufmem:
 	kfree(xbuf);
 
@@ -724,9 +1178,9 @@ static void xbuf_factory_dispose(struct evl_element *e)
 	evl_destroy_flag(&xbuf->ibnd.o_event);
 	evl_destroy_element(&xbuf->element);
 	if (xbuf->ibnd.ring.bufmem)
-		kfree(xbuf->ibnd.ring.bufmem);
+		vfree(xbuf->ibnd.ring.bufmem);
 	if (xbuf->obnd.ring.bufmem)
-		kfree(xbuf->obnd.ring.bufmem);
+		vfree(xbuf->obnd.ring.bufmem);
 	kfree_rcu(xbuf, element.rcu);
 }
 
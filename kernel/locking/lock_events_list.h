@@ -67,3 +67,9 @@ LOCK_EVENT(rwsem_rlock_handoff)	/* # of read lock handoffs		*/
 LOCK_EVENT(rwsem_wlock)		/* # of write locks acquired		*/
 LOCK_EVENT(rwsem_wlock_fail)	/* # of failed write lock acquisitions	*/
 LOCK_EVENT(rwsem_wlock_handoff)	/* # of write lock handoffs		*/
+
+/*
+ * Locking events for EVL (CONFIG_EVL_LOCKSTAT)
+ */
+LOCK_EVENT(evl_mutex_contended)	/* # of contended evl_mutex acquisitions	*/
+LOCK_EVENT(evl_stax_contended)	/* # of contended evl_stax acquisitions	*/
@@ -54,6 +54,57 @@ static void __flush_smp_call_function_queue(bool warn_cpu_offline);
 
 static void call_function_oob_init(void);
 
+#ifdef CONFIG_IRQ_PIPELINE
+
+/*
+ * The pipeline only logs the in-band IPIs received by a CPU running
+ * on the oob stage, their handler has to wait for the in-band stage
+ * to resume there anyway. The companion core may shield such CPU
+ * while it runs oob, so that we queue the calls to it without
+ * raising any IPI, which that CPU sends to itself when it leaves the
+ * oob stage. Senders waiting for a call raise the IPI nevertheless
+ * if it did not complete within INBAND_IPI_BOUND_NS.
+ */
+#define INBAND_IPI_BOUND_NS	NSEC_PER_MSEC
+
+struct inband_ipi_shield {
+	int active;
+	atomic_long_t deferred;
+	atomic_long_t forced;
+};
+
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct inband_ipi_shield, inband_ipi_shield);
+
+/* Order the queuing of calls before testing the shields. */
+static __always_inline void inband_ipi_barrier(void)
+{
+	/* Pairs with smp_unshield_inband_ipis(). */
+	smp_mb();
+}
+
+static __always_inline bool defer_inband_ipi(int cpu)
+{
+	struct inband_ipi_shield *s = per_cpu_ptr(&inband_ipi_shield, cpu);
+
+	if (!READ_ONCE(s->active))
+		return false;
+
+	atomic_long_inc(&s->deferred);
+
+	return true;
+}
+
+#else
+
+static __always_inline void inband_ipi_barrier(void) { }
+
+static __always_inline bool defer_inband_ipi(int cpu)
+{
+	return false;
+}
+
+#endif
+
 int smpcfd_prepare_cpu(unsigned int cpu)
 {
 	struct call_function_data *cfd = &per_cpu(cfd_data, cpu);
@@ -117,6 +168,10 @@ void __init call_function_init(void)
 static __always_inline void
 send_call_function_single_ipi(int cpu)
 {
+	inband_ipi_barrier();
+	if (defer_inband_ipi(cpu))
+		return;
+
 	if (call_function_single_prep_ipi(cpu)) {
 		trace_ipi_send_cpu(cpu, _RET_IP_,
 				   generic_smp_call_function_single_interrupt);
@@ -127,6 +182,18 @@ send_call_function_single_ipi(int cpu)
 static __always_inline void
 send_call_function_ipi_mask(struct cpumask *mask)
 {
+#ifdef CONFIG_IRQ_PIPELINE
+	int cpu;
+
+	inband_ipi_barrier();
+	for_each_cpu(cpu, mask) {
+		if (defer_inband_ipi(cpu))
+			__cpumask_clear_cpu(cpu, mask);
+	}
+
+	if (cpumask_empty(mask))
+		return;
+#endif
 	trace_ipi_send_cpumask(mask, _RET_IP_,
 			       generic_smp_call_function_single_interrupt);
 	arch_send_call_function_ipi_mask(mask);
@@ -378,6 +445,42 @@ static __always_inline void csd_unlock(call_single_data_t *csd)
 	smp_store_release(&csd->node.u_flags, 0);
 }
 
+#ifdef CONFIG_IRQ_PIPELINE
+
+/*
+ * Wait for a call to @cpu to complete, raising the IPI we may have
+ * deferred if that CPU did not run it within the bound.
+ */
+static void csd_lock_wait_shielded(call_single_data_t *csd, int cpu)
+{
+	struct inband_ipi_shield *s = per_cpu_ptr(&inband_ipi_shield, cpu);
+	u64 ts0;
+
+	if (READ_ONCE(s->active)) {
+		ts0 = ktime_get_mono_fast_ns();
+		while (smp_load_acquire(&csd->node.u_flags) & CSD_FLAG_LOCK) {
+			if (ktime_get_mono_fast_ns() - ts0 >= INBAND_IPI_BOUND_NS) {
+				atomic_long_inc(&s->forced);
+				arch_send_call_function_single_ipi(cpu);
+				break;
+			}
+			cpu_relax();
+		}
+	}
+
+	csd_lock_wait(csd);
+}
+
+#else
+
+static __always_inline
+void csd_lock_wait_shielded(call_single_data_t *csd, int cpu)
+{
+	csd_lock_wait(csd);
+}
+
+#endif
+
 static DEFINE_PER_CPU_SHARED_ALIGNED(call_single_data_t, csd_data);
 
 void __smp_call_single_queue(int cpu, struct llist_node *node)
@@ -681,7 +784,7 @@ int smp_call_function_single(int cpu, smp_call_func_t func, void *info,
 	err = generic_exec_single(cpu, csd);
 
 	if (wait)
-		csd_lock_wait(csd);
+		csd_lock_wait_shielded(csd, cpu);
 
 	put_cpu();
 
@@ -887,7 +990,7 @@ static void smp_call_function_many_cond(const struct cpumask *mask,
 			call_single_data_t *csd;
 
 			csd = per_cpu_ptr(cfd->csd, cpu);
-			csd_lock_wait(csd);
+			csd_lock_wait_shielded(csd, cpu);
 		}
 	}
 }
@@ -1294,6 +1397,49 @@ out:
 }
 EXPORT_SYMBOL_GPL(smp_call_function_oob);
 
+/*
+ * smp_shield_inband_ipis - Defer the in-band IPIs to the current CPU
+ *                          until smp_unshield_inband_ipis() is called.
+ *
+ * The companion core calls this when the CPU switches to an oob
+ * task, hard irqs off.
+ */
+void smp_shield_inband_ipis(void)
+{
+	WRITE_ONCE(raw_cpu_ptr(&inband_ipi_shield)->active, 1);
+	smp_mb();
+}
+EXPORT_SYMBOL_GPL(smp_shield_inband_ipis);
+
+/*
+ * smp_unshield_inband_ipis - Stop deferring the in-band IPIs to the
+ *                            current CPU.
+ *
+ * The companion core calls this when the CPU switches back to the
+ * in-band stage, hard irqs off. The calls queued in the meantime
+ * are kicked by a self-IPI, which the pipeline plays as soon as the
+ * in-band stage is unstalled.
+ */
+void smp_unshield_inband_ipis(void)
+{
+	WRITE_ONCE(raw_cpu_ptr(&inband_ipi_shield)->active, 0);
+	/* Pairs with send_call_function_*(). */
+	smp_mb();
+	if (!llist_empty(raw_cpu_ptr(&call_single_queue)))
+		arch_send_call_function_single_ipi(raw_smp_processor_id());
+}
+EXPORT_SYMBOL_GPL(smp_unshield_inband_ipis);
+
+void smp_get_inband_ipi_stats(int cpu, unsigned long *deferred,
+			unsigned long *forced)
+{
+	struct inband_ipi_shield *s = per_cpu_ptr(&inband_ipi_shield, cpu);
+
+	*deferred = atomic_long_read(&s->deferred);
+	*forced = atomic_long_read(&s->forced);
+}
+EXPORT_SYMBOL_GPL(smp_get_inband_ipi_stats);
+
 #else
 static inline void call_function_oob_init(void) { }
 #endif
@@ -454,6 +454,11 @@ __weak ssize_t netif_oob_query_pool(struct net_device *dev, char *buf)
 	return -EIO;
 }
 
+__weak ssize_t netif_oob_query_stats(struct net_device *dev, char *buf)
+{
+	return -EIO;
+}
+
 static int switch_oob_port(struct net_device *dev, unsigned long enable)
 {
 	return netif_oob_switch_port(dev, (bool)enable);
@@ -483,6 +488,15 @@ static ssize_t oob_pool_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(oob_pool);
 
+static ssize_t oob_stats_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct net_device *netdev = to_net_dev(dev);
+
+	return netif_oob_query_stats(netdev, buf);
+}
+static DEVICE_ATTR_RO(oob_stats);
+
 #endif
 
 static int change_gro_flush_timeout(struct net_device *dev, unsigned long val)
@@ -757,6 +771,7 @@ static struct attribute *net_class_attrs[] __ro_after_init = {
 #ifdef CONFIG_NET_OOB
 	&dev_attr_oob_port.attr,
 	&dev_attr_oob_pool.attr,
+	&dev_attr_oob_stats.attr,
 #endif
 	NULL,
 };
@@ -317,8 +317,12 @@ static int page_pool_init(struct page_pool *pool,
 	}
 	raw_spin_lock_init(&pool->alloc.oob_lock);
 	/* Populate the fast cache of oob-accessed pools at init. */
-	if (page_pool_is_oob(pool))
-		__page_pool_alloc_pages_slow(pool, GFP_KERNEL);
+	if (page_pool_is_oob(pool)) {
+		if (params->oob_fill)
+			page_pool_oob_grow(pool, params->oob_fill);
+		else
+			__page_pool_alloc_pages_slow(pool, GFP_KERNEL);
+	}
 #endif
 
 	return 0;
@@ -783,6 +787,68 @@ static bool page_pool_recycle_in_cache(netmem_ref netmem,
 	return true;
 }
 
+#ifdef CONFIG_PAGE_POOL_OOB
+
+/*
+ * Add up to @nr pages to an oob-accessed pool, without exceeding the
+ * capacity of its cache, so that all pages in flight can always be
+ * recycled there. Returns the count of pages added. In-band only,
+ * callers must serialize resizing requests.
+ */
+unsigned int page_pool_oob_grow(struct page_pool *pool, unsigned int nr)
+{
+	unsigned long flags;
+	struct page *page;
+	unsigned int n;
+
+	if (WARN_ON(!page_pool_is_oob(pool)))
+		return 0;
+
+	for (n = 0; n < nr; n++) {
+		if (page_pool_inflight(pool, false) >= pool->p.pool_size)
+			break;
+		page = __page_pool_alloc_page_order(pool, GFP_KERNEL);
+		if (!page)
+			break;
+		raw_spin_lock_irqsave(&pool->alloc.oob_lock, flags);
+		pool->alloc.cache[pool->alloc.count++] = page_to_netmem(page);
+		raw_spin_unlock_irqrestore(&pool->alloc.oob_lock, flags);
+	}
+
+	return n;
+}
+EXPORT_SYMBOL(page_pool_oob_grow);
+
+/*
+ * Release up to @nr free pages from an oob-accessed pool. Pages in
+ * flight are left alone. Returns the count of pages released.
+ * In-band only, callers must serialize resizing requests.
+ */
+unsigned int page_pool_oob_shrink(struct page_pool *pool, unsigned int nr)
+{
+	unsigned long flags;
+	netmem_ref netmem;
+	unsigned int n;
+
+	if (WARN_ON(!page_pool_is_oob(pool)))
+		return 0;
+
+	for (n = 0; n < nr; n++) {
+		raw_spin_lock_irqsave(&pool->alloc.oob_lock, flags);
+		netmem = pool->alloc.count ?
+			pool->alloc.cache[--pool->alloc.count] : 0;
+		raw_spin_unlock_irqrestore(&pool->alloc.oob_lock, flags);
+		if (!netmem)
+			break;
+		page_pool_return_page(pool, netmem);
+	}
+
+	return n;
+}
+EXPORT_SYMBOL(page_pool_oob_shrink);
+
+#endif	/* CONFIG_PAGE_POOL_OOB */
+
 static bool __page_pool_page_can_be_recycled(netmem_ref netmem)
 {
 	return netmem_is_net_iov(netmem) ||
@@ -471,11 +471,17 @@ static struct sk_buff *__napi_build_skb(void *data, unsigned int frag_size)
 {
 	struct sk_buff *skb;
 
-	skb = napi_skb_cache_get();
-	if (unlikely(!skb))
-		return NULL;
+	if (running_oob()) {
+		skb = get_oob_skb();
+		if (unlikely(!skb))
+			return NULL;
+	} else {
+		skb = napi_skb_cache_get();
+		if (unlikely(!skb))
+			return NULL;
+		memset(skb, 0, offsetof(struct sk_buff, tail));
+	}
 
-	memset(skb, 0, offsetof(struct sk_buff, tail));
 	__build_skb_around(skb, data, frag_size);
 
 	return skb;
@@ -489,6 +495,9 @@ static struct sk_buff *__napi_build_skb(void *data, unsigned int frag_size)
  * Version of __napi_build_skb() that takes care of skb->head_frag
  * and skb->pfmemalloc when the data is a page or page fragment.
  *
+ * Dovetail: allocation requests issued from the oob execution stage
+ * are served by the oob buffer cache.
+ *
  * Returns a new &sk_buff on success, %NULL on allocation failure.
  */
 struct sk_buff *napi_build_skb(void *data, unsigned int frag_size)
@@ -536,11 +545,26 @@ void finalize_skb_inband(struct sk_buff *skb)
 }
 
 /*
- * Pool for out-of-band allocation of buffers. The implementation is
- * trivial ATM, we may improve this with per-CPU caches in the future.
+ * Pool for out-of-band allocation of buffers. Each CPU keeps a
+ * magazine of free heads in front of the shared pool, which is
+ * refilled or drained by batches, so that the shared lock is only
+ * taken once every few allocations or releases. The magazine size is
+ * bounded so that at most a fraction of the pool may sit idle in the
+ * per-CPU caches.
  */
+#define SKB_OOB_MAGAZINE_SIZE	32
+
+struct skbuff_oob_magazine {
+	unsigned int count;
+	struct sk_buff *skbs[SKB_OOB_MAGAZINE_SIZE];
+};
+
 static struct skbuff_oob_pool skbuff_oob_pool;
 
+static DEFINE_PER_CPU_ALIGNED(struct skbuff_oob_magazine, skbuff_oob_magazines);
+
+static unsigned int skb_oob_magazine_size __read_mostly;
+
 static void init_oob_cache(void)
 {
 	struct skbuff_oob_pool *c = &skbuff_oob_pool;
@@ -563,23 +587,73 @@ static void init_oob_cache(void)
 		BUG_ON(!skb);
 		list_add(&skb->list, &c->pool);
 	}
+
+	/* Leave at least 3/4 of the heads to the shared pool. */
+	skb_oob_magazine_size = min_t(unsigned int, SKB_OOB_MAGAZINE_SIZE,
+				max_skbs / (4 * num_possible_cpus()));
+	if (skb_oob_magazine_size < 2)
+		skb_oob_magazine_size = 0;
+}
+
+/* hard irqs off */
+static void refill_oob_magazine(struct skbuff_oob_magazine *m)
+{
+	struct skbuff_oob_pool *c = &skbuff_oob_pool;
+	unsigned int batch = skb_oob_magazine_size / 2;
+	struct sk_buff *skb;
+
+	raw_spin_lock(&c->lock);
+
+	while (m->count < batch && !list_empty(&c->pool)) {
+		skb = list_first_entry(&c->pool, struct sk_buff, list);
+		list_del(&skb->list);
+		m->skbs[m->count++] = skb;
+	}
+
+	raw_spin_unlock(&c->lock);
+}
+
+/* hard irqs off */
+static void drain_oob_magazine(struct skbuff_oob_magazine *m,
+			unsigned int count)
+{
+	struct skbuff_oob_pool *c = &skbuff_oob_pool;
+
+	raw_spin_lock(&c->lock);
+
+	while (m->count > count)
+		list_add(&m->skbs[--m->count]->list, &c->pool);
+
+	raw_spin_unlock(&c->lock);
 }
 
 struct sk_buff *get_oob_skb(void)
 {
 	struct skbuff_oob_pool *c = &skbuff_oob_pool;
+	struct skbuff_oob_magazine *m;
 	struct sk_buff *skb = NULL;
 	unsigned long flags;
 
-	raw_spin_lock_irqsave(&c->lock, flags);
-	if (!list_empty(&c->pool)) {
-		skb = list_first_entry(&c->pool, struct sk_buff, list);
-		list_del(&skb->list);
+	if (unlikely(!skb_oob_magazine_size)) {
+		raw_spin_lock_irqsave(&c->lock, flags);
+		if (!list_empty(&c->pool)) {
+			skb = list_first_entry(&c->pool, struct sk_buff, list);
+			list_del(&skb->list);
+		}
 		raw_spin_unlock_irqrestore(&c->lock, flags);
+	} else {
+		flags = hard_local_irq_save();
+		m = raw_cpu_ptr(&skbuff_oob_magazines);
+		if (m->count == 0)
+			refill_oob_magazine(m);
+		if (m->count > 0)
+			skb = m->skbs[--m->count];
+		hard_local_irq_restore(flags);
+	}
+
+	if (skb) {
 		memset(skb, 0, offsetof(struct sk_buff, tail));
 		skb_mark_oob(skb);
-	} else {
-		raw_spin_unlock_irqrestore(&c->lock, flags);
 	}
 
 	return skb;
@@ -589,11 +663,25 @@ EXPORT_SYMBOL(get_oob_skb);
 void put_oob_skb(struct sk_buff *skb)
 {
 	struct skbuff_oob_pool *c = &skbuff_oob_pool;
+	struct skbuff_oob_magazine *m;
 	unsigned long flags;
 
-	raw_spin_lock_irqsave(&c->lock, flags);
-	list_add(&skb->list, &c->pool);
-	raw_spin_unlock_irqrestore(&c->lock, flags);
+	if (unlikely(!skb_oob_magazine_size)) {
+		raw_spin_lock_irqsave(&c->lock, flags);
+		list_add(&skb->list, &c->pool);
+		raw_spin_unlock_irqrestore(&c->lock, flags);
+		return;
+	}
+
+	flags = hard_local_irq_save();
+
+	m = raw_cpu_ptr(&skbuff_oob_magazines);
+	if (m->count >= skb_oob_magazine_size)
+		drain_oob_magazine(m, skb_oob_magazine_size / 2);
+
+	m->skbs[m->count++] = skb;
+
+	hard_local_irq_restore(flags);
 }
 EXPORT_SYMBOL(put_oob_skb);
 
@@ -1059,6 +1147,55 @@ bool napi_pp_put_page(netmem_ref netmem)
 EXPORT_SYMBOL(napi_pp_put_page);
 #endif
 
+#ifdef CONFIG_NET_OOB
+
+static bool is_oob_pp_netmem(netmem_ref netmem)
+{
+	netmem = netmem_compound_head(netmem);
+
+	return is_pp_netmem(netmem) &&
+		page_pool_is_oob(netmem_get_pp(netmem));
+}
+
+/*
+ * release_skb_oob - release a buffer without the help of the
+ * in-band stage, which is possible if it only refers to oob-accessed
+ * resources: a head from the oob pool, data and page fragments from
+ * oob-accessed page pools, and no in-band state attached. Returns
+ * false if not, leaving the buffer untouched. The caller must own
+ * the last reference to @skb.
+ */
+bool release_skb_oob(struct sk_buff *skb)
+{
+	struct skb_shared_info *shinfo;
+	int n;
+
+	if (!skb_is_oob(skb) || !skb->pp_recycle || !skb->head_frag ||
+		skb->cloned || skb->destructor || skb_dst(skb) ||
+		skb_get_nfct(skb) || skb_has_extensions(skb) ||
+		skb_zcopy(skb) || skb_has_frag_list(skb))
+		return false;
+
+	if (!is_oob_pp_netmem(page_to_netmem(virt_to_page(skb->head))))
+		return false;
+
+	shinfo = skb_shinfo(skb);
+	for (n = 0; n < shinfo->nr_frags; n++)
+		if (!is_oob_pp_netmem(skb_frag_netmem(&shinfo->frags[n])))
+			return false;
+
+	for (n = 0; n < shinfo->nr_frags; n++)
+		napi_pp_put_page(skb_frag_netmem(&shinfo->frags[n]));
+
+	napi_pp_put_page(page_to_netmem(virt_to_page(skb->head)));
+	put_oob_skb(skb);
+
+	return true;
+}
+EXPORT_SYMBOL(release_skb_oob);
+
+#endif	/* CONFIG_NET_OOB */
+
 static bool skb_pp_recycle(struct sk_buff *skb, void *data)
 {
 	if (!IS_ENABLED(CONFIG_PAGE_POOL) || !skb->pp_recycle)
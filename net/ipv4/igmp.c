@@ -2250,6 +2250,22 @@ static void ip_mc_clear_src(struct ip_mc_list *pmc)
 	ip_sf_list_clear_all(sources);
 }
 
+#ifdef CONFIG_NET_OOB
+__weak int ip_mc_join_oob_group(struct sock *sk, __be32 group, int ifindex)
+{
+	return 0;
+}
+__weak void ip_mc_leave_oob_group(struct sock *sk, __be32 group, int ifindex)
+{ }
+#else
+static inline int ip_mc_join_oob_group(struct sock *sk, __be32 group, int ifindex)
+{
+	return 0;
+}
+static inline void ip_mc_leave_oob_group(struct sock *sk, __be32 group, int ifindex)
+{ }
+#endif
+
 /* Join a multicast group
  */
 static int __ip_mc_join_group(struct sock *sk, struct ip_mreqn *imr,
@@ -2287,9 +2303,16 @@ static int __ip_mc_join_group(struct sock *sk, struct ip_mreqn *imr,
 	err = -ENOBUFS;
 	if (count >= READ_ONCE(net->ipv4.sysctl_igmp_max_memberships))
 		goto done;
+	/* Let the oob core track the membership of oob sockets. */
+	err = ip_mc_join_oob_group(sk, addr, ifindex);
+	if (err)
+		goto done;
+	err = -ENOBUFS;
 	iml = sock_kmalloc(sk, sizeof(*iml), GFP_KERNEL);
-	if (!iml)
+	if (!iml) {
+		ip_mc_leave_oob_group(sk, addr, ifindex);
 		goto done;
+	}
 
 	memcpy(&iml->multi, imr, sizeof(*imr));
 	iml->next_rcu = inet->mc_list;
@@ -2370,6 +2393,7 @@ int ip_mc_leave_group(struct sock *sk, struct ip_mreqn *imr)
 			continue;
 
 		(void) ip_mc_leave_src(sk, iml, in_dev);
+		ip_mc_leave_oob_group(sk, group, iml->multi.imr_ifindex);
 
 		*imlp = iml->next_rcu;
 
@@ -2788,6 +2812,8 @@ void ip_mc_drop_socket(struct sock *sk)
 		inet->mc_list = iml->next_rcu;
 		in_dev = inetdev_by_index(net, iml->multi.imr_ifindex);
 		(void) ip_mc_leave_src(sk, iml, in_dev);
+		ip_mc_leave_oob_group(sk, iml->multi.imr_multiaddr.s_addr,
+				      iml->multi.imr_ifindex);
 		if (in_dev)
 			ip_mc_dec_group(in_dev, iml->multi.imr_multiaddr.s_addr);
 		/* decrease mem now to avoid the memleak warning */
@@ -0,0 +1,398 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/miscdevice.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/uaccess.h>
+#include <sound/soc-oob-pcm.h>
+#include <evl/file.h>
+#include <evl/wait.h>
+#include <evl/poll.h>
+#include <evl/clock.h>
+#include <uapi/evl/devices/pcm.h>
+
+/*
+ * Out-of-band PCM streams bypass the ALSA period model entirely: the
+ * DAI driver hands over a DMA channel it configured for its FIFO, we
+ * run a cyclic transfer with DMA_OOB_INTERRUPT on a coherent ring,
+ * and the period callback wakes up EVL threads directly from the oob
+ * stage. The stream is exposed as a misc device, which excludes
+ * regular ALSA users of the same DMA channel by construction.
+ */
+
+struct snd_soc_oob_pcm {
+	struct device *dev;
+	struct dma_chan *chan;
+	enum dma_transfer_direction dir;
+	size_t period_bytes;
+	unsigned int nr_periods;
+	size_t ring_size;
+	void *area;
+	dma_addr_t dma_addr;
+	/* Protected by wait.wchan.lock */
+	u64 period_count;
+	u64 last_count;
+	ktime_t timestamp;
+	bool running;
+	/* In-band state, serialized by @lock. */
+	struct mutex lock;
+	bool busy;
+	struct evl_wait_queue wait;
+	struct evl_poll_head poll_head;
+	struct evl_file efile;
+	struct miscdevice miscdev;
+	char name[32];
+};
+
+static inline __poll_t period_events(struct snd_soc_oob_pcm *opcm)
+{
+	return opcm->dir == DMA_MEM_TO_DEV ?
+		POLLOUT|POLLWRNORM : POLLIN|POLLRDNORM;
+}
+
+static void period_elapsed(void *arg) /* oob stage, hard irqs off */
+{
+	struct snd_soc_oob_pcm *opcm = arg;
+
+	raw_spin_lock(&opcm->wait.wchan.lock);
+	opcm->period_count++;
+	opcm->timestamp = evl_read_clock(&evl_mono_clock);
+	evl_flush_wait_locked(&opcm->wait, 0);
+	evl_signal_poll_events(&opcm->poll_head, period_events(opcm));
+	raw_spin_unlock(&opcm->wait.wchan.lock);
+}
+
+/* opcm->lock held. */
+static int start_stream(struct snd_soc_oob_pcm *opcm)
+{
+	struct dma_async_tx_descriptor *desc;
+	dma_cookie_t cookie;
+	unsigned long flags;
+	int ret;
+
+	if (opcm->running)
+		return -EBUSY;
+
+	desc = dmaengine_prep_dma_cyclic(opcm->chan, opcm->dma_addr,
+					opcm->ring_size, opcm->period_bytes,
+					opcm->dir, DMA_OOB_INTERRUPT);
+	if (!desc)
+		return -EIO;
+
+	desc->callback = period_elapsed;
+	desc->callback_param = opcm;
+
+	cookie = dmaengine_submit(desc);
+	ret = dma_submit_error(cookie);
+	if (ret) {
+		dmaengine_terminate_sync(opcm->chan);
+		return ret;
+	}
+
+	raw_spin_lock_irqsave(&opcm->wait.wchan.lock, flags);
+	opcm->period_count = 0;
+	opcm->last_count = 0;
+	opcm->timestamp = evl_read_clock(&evl_mono_clock);
+	opcm->running = true;
+	raw_spin_unlock_irqrestore(&opcm->wait.wchan.lock, flags);
+
+	dma_async_issue_pending(opcm->chan);
+
+	return 0;
+}
+
+/* opcm->lock held. */
+static void stop_stream(struct snd_soc_oob_pcm *opcm)
+{
+	unsigned long flags;
+
+	if (!opcm->running)
+		return;
+
+	dmaengine_terminate_sync(opcm->chan);
+
+	raw_spin_lock_irqsave(&opcm->wait.wchan.lock, flags);
+	opcm->running = false;
+	evl_flush_wait_locked(&opcm->wait, 0);
+	evl_signal_poll_events(&opcm->poll_head, POLLERR);
+	raw_spin_unlock_irqrestore(&opcm->wait.wchan.lock, flags);
+}
+
+static inline bool period_ready(struct snd_soc_oob_pcm *opcm)
+{
+	return opcm->period_count != opcm->last_count || !opcm->running;
+}
+
+static ssize_t oob_pcm_oob_read(struct file *filp, char __user *u_buf,
+				size_t count)
+{
+	struct snd_soc_oob_pcm *opcm = filp->private_data;
+	struct evl_pcm_status status;
+	unsigned long flags;
+	int ret;
+
+	if (count != sizeof(status))
+		return -EINVAL;
+
+	if (!(filp->f_flags & O_NONBLOCK)) {
+		ret = evl_wait_event(&opcm->wait, period_ready(opcm));
+		if (ret)
+			return ret;
+	}
+
+	raw_spin_lock_irqsave(&opcm->wait.wchan.lock, flags);
+
+	if (opcm->period_count == opcm->last_count) {
+		ret = opcm->running ? -EAGAIN : -EIO;
+		raw_spin_unlock_irqrestore(&opcm->wait.wchan.lock, flags);
+		return ret;
+	}
+
+	status.period_count = opcm->period_count;
+	status.timestamp = ktime_to_ns(opcm->timestamp);
+	status.missed = opcm->period_count - opcm->last_count - 1;
+	status.__pad = 0;
+	opcm->last_count = opcm->period_count;
+
+	raw_spin_unlock_irqrestore(&opcm->wait.wchan.lock, flags);
+
+	if (raw_copy_to_user(u_buf, &status, sizeof(status)))
+		return -EFAULT;
+
+	return sizeof(status);
+}
+
+static __poll_t oob_pcm_oob_poll(struct file *filp,
+				struct oob_poll_wait *wait)
+{
+	struct snd_soc_oob_pcm *opcm = filp->private_data;
+	unsigned long flags;
+	__poll_t ready = 0;
+
+	evl_poll_watch(&opcm->poll_head, wait, NULL);
+
+	raw_spin_lock_irqsave(&opcm->wait.wchan.lock, flags);
+
+	if (opcm->period_count != opcm->last_count)
+		ready = period_events(opcm);
+	else if (!opcm->running)
+		ready = POLLERR;
+
+	raw_spin_unlock_irqrestore(&opcm->wait.wchan.lock, flags);
+
+	return ready;
+}
+
+static long oob_pcm_ioctl(struct file *filp, unsigned int cmd,
+			unsigned long arg)
+{
+	struct snd_soc_oob_pcm *opcm = filp->private_data;
+	struct evl_pcm_info info;
+	long ret = 0;
+
+	switch (cmd) {
+	case EVL_PCMIOC_GET_INFO:
+		info.period_bytes = opcm->period_bytes;
+		info.nr_periods = opcm->nr_periods;
+		info.direction = opcm->dir == DMA_MEM_TO_DEV ?
+			EVL_PCM_PLAYBACK : EVL_PCM_CAPTURE;
+		info.__pad = 0;
+		if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+			ret = -EFAULT;
+		break;
+	case EVL_PCMIOC_START:
+		mutex_lock(&opcm->lock);
+		ret = start_stream(opcm);
+		mutex_unlock(&opcm->lock);
+		break;
+	case EVL_PCMIOC_STOP:
+		mutex_lock(&opcm->lock);
+		stop_stream(opcm);
+		mutex_unlock(&opcm->lock);
+		break;
+	default:
+		ret = -ENOTTY;
+	}
+
+	return ret;
+}
+
+static int oob_pcm_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct snd_soc_oob_pcm *opcm = filp->private_data;
+	size_t len = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff || len > PAGE_ALIGN(opcm->ring_size))
+		return -EINVAL;
+
+	return dma_mmap_coherent(opcm->chan->device->dev, vma,
+				opcm->area, opcm->dma_addr, len);
+}
+
+static int oob_pcm_open(struct inode *inode, struct file *filp)
+{
+	struct snd_soc_oob_pcm *opcm =
+		container_of(filp->private_data, struct snd_soc_oob_pcm, miscdev);
+	int ret;
+
+	mutex_lock(&opcm->lock);
+
+	if (opcm->busy) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	filp->private_data = opcm;
+	ret = evl_open_file(&opcm->efile, filp);
+	if (ret)
+		goto out;
+
+	opcm->busy = true;
+out:
+	mutex_unlock(&opcm->lock);
+
+	return ret;
+}
+
+static int oob_pcm_release(struct inode *inode, struct file *filp)
+{
+	struct snd_soc_oob_pcm *opcm = filp->private_data;
+
+	/* Unblock the oob readers first, evl_release_file() waits for them. */
+	mutex_lock(&opcm->lock);
+	stop_stream(opcm);
+	mutex_unlock(&opcm->lock);
+
+	evl_release_file(&opcm->efile);
+
+	mutex_lock(&opcm->lock);
+	opcm->busy = false;
+	mutex_unlock(&opcm->lock);
+
+	return 0;
+}
+
+static const struct file_operations oob_pcm_fops = {
+	.owner		= THIS_MODULE,
+	.open		= oob_pcm_open,
+	.release	= oob_pcm_release,
+	.unlocked_ioctl	= oob_pcm_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
+	.mmap		= oob_pcm_mmap,
+	.oob_read	= oob_pcm_oob_read,
+	.oob_poll	= oob_pcm_oob_poll,
+	.llseek		= noop_llseek,
+};
+
+/**
+ * snd_soc_oob_pcm_register - register an out-of-band PCM stream
+ * @dev: the DAI device
+ * @name: stream name, the device node is /dev/pcm-@name-oob
+ * @chan: DMA channel to the DAI FIFO, configured by the caller
+ *	which keeps ownership of it. Its dmaengine driver must support
+ *	cyclic transfers with DMA_OOB_INTERRUPT.
+ * @dir: DMA_MEM_TO_DEV for playback, DMA_DEV_TO_MEM for capture
+ * @period_bytes: size of a period
+ * @nr_periods: number of periods in the ring, at least two
+ */
+struct snd_soc_oob_pcm *
+snd_soc_oob_pcm_register(struct device *dev, const char *name,
+			struct dma_chan *chan,
+			enum dma_transfer_direction dir,
+			size_t period_bytes, unsigned int nr_periods)
+{
+	struct snd_soc_oob_pcm *opcm;
+	int ret;
+
+	if (!is_slave_direction(dir) || !period_bytes || nr_periods < 2)
+		return ERR_PTR(-EINVAL);
+
+	opcm = kzalloc(sizeof(*opcm), GFP_KERNEL);
+	if (!opcm)
+		return ERR_PTR(-ENOMEM);
+
+	opcm->dev = dev;
+	opcm->chan = chan;
+	opcm->dir = dir;
+	opcm->period_bytes = period_bytes;
+	opcm->nr_periods = nr_periods;
+	opcm->ring_size = period_bytes * nr_periods;
+	opcm->area = dma_alloc_coherent(chan->device->dev, opcm->ring_size,
+					&opcm->dma_addr, GFP_KERNEL);
+	if (!opcm->area) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
+
+	mutex_init(&opcm->lock);
+	evl_init_wait(&opcm->wait, &evl_mono_clock, EVL_WAIT_PRIO);
+	evl_init_poll_head(&opcm->poll_head);
+
+	snprintf(opcm->name, sizeof(opcm->name), "pcm-%s-oob", name);
+	opcm->miscdev.minor = MISC_DYNAMIC_MINOR;
+	opcm->miscdev.name = opcm->name;
+	opcm->miscdev.fops = &oob_pcm_fops;
+	opcm->miscdev.parent = dev;
+
+	ret = misc_register(&opcm->miscdev);
+	if (ret)
+		goto fail_register;
+
+	return opcm;
+
+fail_register:
+	evl_destroy_wait(&opcm->wait);
+	dma_free_coherent(chan->device->dev, opcm->ring_size,
+			opcm->area, opcm->dma_addr);
+fail_alloc:
+	kfree(opcm);
+
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(snd_soc_oob_pcm_register);
+
+/**
+ * snd_soc_oob_pcm_unregister - unregister an out-of-band PCM stream
+ * @opcm: the stream returned by snd_soc_oob_pcm_register()
+ */
+void snd_soc_oob_pcm_unregister(struct snd_soc_oob_pcm *opcm)
+{
+	misc_deregister(&opcm->miscdev);
+	evl_destroy_wait(&opcm->wait);
+	dma_free_coherent(opcm->chan->device->dev, opcm->ring_size,
+			opcm->area, opcm->dma_addr);
+	mutex_destroy(&opcm->lock);
+	kfree(opcm);
+}
+EXPORT_SYMBOL_GPL(snd_soc_oob_pcm_unregister);
+
+static void __devm_snd_soc_oob_pcm_unregister(void *opcm)
+{
+	snd_soc_oob_pcm_unregister(opcm);
+}
+
+/**
+ * devm_snd_soc_oob_pcm_register - resource managed variant of
+ * snd_soc_oob_pcm_register()
+ */
+int devm_snd_soc_oob_pcm_register(struct device *dev, const char *name,
+				struct dma_chan *chan,
+				enum dma_transfer_direction dir,
+				size_t period_bytes, unsigned int nr_periods)
+{
+	struct snd_soc_oob_pcm *opcm;
+
+	opcm = snd_soc_oob_pcm_register(dev, name, chan, dir,
+					period_bytes, nr_periods);
+	if (IS_ERR(opcm))
+		return PTR_ERR(opcm);
+
+	return devm_add_action_or_reset(dev, __devm_snd_soc_oob_pcm_unregister,
+					opcm);
+}
+EXPORT_SYMBOL_GPL(devm_snd_soc_oob_pcm_register);
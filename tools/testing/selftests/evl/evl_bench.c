@@ -0,0 +1,1128 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Microbenchmarks for the EVL core primitives. This talks to the raw
+ * kernel ABI so that no libevl is required, only measuring the cost
+ * of the kernel paths: user-space fast paths are out of scope.
+ *
+ * Every benchmark emits one JSON record as a TAP comment line, or on
+ * a line of its own with -j, giving the distribution of the measured
+ * durations in nanoseconds, so that runs can be compared across
+ * commits and Kconfig variants (-t tags the records).
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+#include <evl/control-abi.h>
+#include <evl/factory-abi.h>
+#include <evl/syscall-abi.h>
+#include <evl/thread-abi.h>
+#include <evl/clock-abi.h>
+#include <evl/monitor-abi.h>
+#include <evl/xbuf-abi.h>
+#include <evl/proxy-abi.h>
+#include <evl/observable-abi.h>
+#include <evl/poll-abi.h>
+#include <evl/net/socket-abi.h>
+
+#include "../kselftest.h"
+
+#ifndef PR_OOB_SYSCALL
+#define PR_OOB_SYSCALL	0x4f4f4243
+#endif
+
+#ifndef O_OOB
+#define O_OOB		010000000000
+#endif
+
+#define EVL_DEV_ROOT	"/dev/evl"
+#define BENCH_PRIO	90
+#define XBUF_MSGSZ	64
+#define PROXY_MSGSZ	64
+#define UDP_MSGSZ	64
+#define MAX_OBSERVERS	16
+
+static unsigned int nr_iterations = 10000;
+static unsigned int nr_observers = 4;
+static int cpus[2] = { -1, -1 };
+static const char *run_tag = "";
+static const char *udp_peer;
+static bool json_only;
+
+static int clock_fd = -1;
+
+struct bench_stats {
+	uint64_t *samples;
+	unsigned int count;
+	uint64_t bytes;	/* Throughput tests only. */
+	uint64_t elapsed;
+};
+
+/*
+ * Oob syscalls are folded into prctl(2) requests, which Dovetail
+ * routes to the EVL core.
+ */
+static inline long oob_syscall(int nr, long a0, long a1, long a2)
+{
+	return syscall(__NR_prctl, PR_OOB_SYSCALL, nr, a0, a1, a2);
+}
+
+static inline long oob_ioctl(int fd, unsigned long req, void *arg)
+{
+	return oob_syscall(sys_evl_ioctl, fd, req, (long)arg);
+}
+
+static inline long oob_read(int fd, void *buf, size_t len)
+{
+	return oob_syscall(sys_evl_read, fd, (long)buf, len);
+}
+
+static inline long oob_write(int fd, const void *buf, size_t len)
+{
+	return oob_syscall(sys_evl_write, fd, (long)buf, len);
+}
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	/* Served by the vDSO, does not leave the oob stage. */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int create_element(const char *type, const char *name,
+			void *attrs, int clone_flags)
+{
+	struct evl_clone_req req = { 0 };
+	char path[64], ename[64];
+	int clonefd, ret;
+
+	snprintf(path, sizeof(path), EVL_DEV_ROOT "/%s/clone", type);
+	clonefd = open(path, O_RDWR);
+	if (clonefd < 0)
+		return -errno;
+
+	snprintf(ename, sizeof(ename), "bench-%d-%s", getpid(), name);
+	req.name_ptr = (uintptr_t)ename;
+	req.attrs_ptr = (uintptr_t)attrs;
+	req.clone_flags = clone_flags;
+	ret = ioctl(clonefd, EVL_IOC_CLONE, &req);
+	if (ret)
+		ret = -errno;
+	else
+		ret = req.efd;
+
+	/* The element fd holds the reference from now on. */
+	close(clonefd);
+
+	return ret;
+}
+
+/*
+ * Attach the caller to the core as a SCHED_FIFO thread pinned to
+ * @cpu, then switch it to the oob stage. Returns the thread fd.
+ */
+static int attach_self(const char *name, int cpu, int prio)
+{
+	struct evl_sched_attrs attrs = { 0 };
+	cpu_set_t cpuset;
+	int efd;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	if (sched_setaffinity(0, sizeof(cpuset), &cpuset))
+		return -errno;
+
+	efd = create_element(EVL_THREAD_DEV, name, NULL, EVL_CLONE_PRIVATE);
+	if (efd < 0)
+		return efd;
+
+	attrs.sched_policy = SCHED_FIFO;
+	attrs.sched_priority = prio;
+	if (ioctl(efd, EVL_THRIOC_SET_SCHEDPARAM, &attrs) ||
+		oob_ioctl(efd, EVL_THRIOC_SWITCH_OOB, NULL)) {
+		close(efd);
+		return -errno;
+	}
+
+	return efd;
+}
+
+static void detach_self(int efd)
+{
+	ioctl(efd, EVL_THRIOC_DETACH_SELF);
+	close(efd);
+}
+
+static int create_monitor(const char *name, int type, int protocol,
+			unsigned int initval)
+{
+	struct evl_monitor_attrs attrs = { 0 };
+
+	attrs.clockfd = clock_fd;
+	attrs.type = type;
+	attrs.protocol = protocol;
+	attrs.initval = initval;
+
+	return create_element(EVL_MONITOR_DEV, name, &attrs,
+			EVL_CLONE_PRIVATE);
+}
+
+static int sem_post(int efd)
+{
+	__s32 count = 1;
+
+	return oob_ioctl(efd, EVL_MONIOC_SIGNAL, &count) ? -errno : 0;
+}
+
+static int sem_wait(int efd)
+{
+	struct __evl_timespec timeout = { 0 }; /* Infinite. */
+	struct evl_monitor_waitreq req = {
+		.timeout_ptr = (uintptr_t)&timeout,
+		.gatefd = -1,
+	};
+
+	if (oob_ioctl(efd, EVL_MONIOC_WAIT, &req))
+		return -errno;
+
+	return req.status;
+}
+
+static int init_stats(struct bench_stats *st, unsigned int count)
+{
+	memset(st, 0, sizeof(*st));
+	st->samples = calloc(count, sizeof(uint64_t));
+
+	return st->samples ? 0 : -ENOMEM;
+}
+
+static inline void add_sample(struct bench_stats *st, uint64_t delta)
+{
+	st->samples[st->count++] = delta;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t percentile(const struct bench_stats *st, unsigned int ppm)
+{
+	uint64_t rank = (uint64_t)st->count * ppm / 1000000;
+
+	if (rank >= st->count)
+		rank = st->count - 1;
+
+	return st->samples[rank];
+}
+
+static void report(const char *bench, struct bench_stats *st)
+{
+	char rec[512];
+	uint64_t sum = 0;
+	unsigned int n;
+	int len;
+
+	if (st->count == 0)
+		return;
+
+	qsort(st->samples, st->count, sizeof(uint64_t), cmp_u64);
+	for (n = 0; n < st->count; n++)
+		sum += st->samples[n];
+
+	len = snprintf(rec, sizeof(rec),
+		"{\"bench\":\"%s\",\"tag\":\"%s\",\"samples\":%u,"
+		"\"min_ns\":%llu,\"avg_ns\":%llu,\"p50_ns\":%llu,"
+		"\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu",
+		bench, run_tag, st->count,
+		(unsigned long long)st->samples[0],
+		(unsigned long long)(sum / st->count),
+		(unsigned long long)percentile(st, 500000),
+		(unsigned long long)percentile(st, 990000),
+		(unsigned long long)percentile(st, 999000),
+		(unsigned long long)st->samples[st->count - 1]);
+
+	if (st->bytes && st->elapsed)
+		len += snprintf(rec + len, sizeof(rec) - len,
+				",\"bytes\":%llu,\"mbytes_per_s\":%.1f",
+				(unsigned long long)st->bytes,
+				(double)st->bytes * 1000.0 / st->elapsed);
+
+	snprintf(rec + len, sizeof(rec) - len, "}");
+
+	if (json_only)
+		printf("%s\n", rec);
+	else
+		ksft_print_msg("%s\n", rec);
+}
+
+static void free_stats(struct bench_stats *st)
+{
+	free(st->samples);
+}
+
+/*
+ * Once peer threads are running, they might wait on us forever
+ * should anything go wrong, so just give up.
+ */
+static void __noreturn bail_out(const char *what, int err)
+{
+	ksft_exit_fail_msg("%s: %s\n", what, strerror(-err));
+}
+
+/*
+ * Oob syscall round trip, reading the EVL monotonic clock, which is
+ * about the cheapest request there is. This measures the fixed cost
+ * of the syscall fast path.
+ */
+static int bench_syscall(struct bench_stats *st)
+{
+	struct __evl_timespec ts;
+	unsigned int n;
+	int efd, ret = 0;
+	uint64_t t0;
+
+	efd = attach_self("syscall", cpus[0], BENCH_PRIO);
+	if (efd < 0)
+		return efd;
+
+	for (n = 0; n < nr_iterations; n++) {
+		t0 = now_ns();
+		if (oob_ioctl(clock_fd, EVL_CLKIOC_GET_TIME, &ts)) {
+			ret = -errno;
+			break;
+		}
+		add_sample(st, now_ns() - t0);
+	}
+
+	detach_self(efd);
+
+	return ret;
+}
+
+/* Monitor gate: uncontended enter/exit pair through the kernel. */
+static int bench_gate(struct bench_stats *st)
+{
+	struct __evl_timespec timeout = { 0 };
+	int gatefd, efd, ret = 0;
+	unsigned int n;
+	uint64_t t0;
+
+	gatefd = create_monitor("gate", EVL_MONITOR_GATE, EVL_GATE_PI, 0);
+	if (gatefd < 0)
+		return gatefd;
+
+	efd = attach_self("gate", cpus[0], BENCH_PRIO);
+	if (efd < 0) {
+		close(gatefd);
+		return efd;
+	}
+
+	for (n = 0; n < nr_iterations; n++) {
+		t0 = now_ns();
+		if (oob_ioctl(gatefd, EVL_MONIOC_ENTER, &timeout) ||
+			oob_ioctl(gatefd, EVL_MONIOC_EXIT, NULL)) {
+			ret = -errno;
+			break;
+		}
+		add_sample(st, now_ns() - t0);
+	}
+
+	detach_self(efd);
+	close(gatefd);
+
+	return ret;
+}
+
+/* Event post/wait ping-pong between two threads on distinct CPUs. */
+
+struct pingpong {
+	int ping, pong;
+	pthread_barrier_t barrier;
+};
+
+static void *pong_thread(void *arg)
+{
+	struct pingpong *pp = arg;
+	unsigned int n;
+	int efd, ret;
+
+	efd = attach_self("pong", cpus[1], BENCH_PRIO);
+	if (efd < 0)
+		bail_out("pong", efd);
+
+	pthread_barrier_wait(&pp->barrier);
+
+	for (n = 0; n < nr_iterations; n++) {
+		ret = sem_wait(pp->ping) ?: sem_post(pp->pong);
+		if (ret)
+			bail_out("pong", ret);
+	}
+
+	detach_self(efd);
+
+	return NULL;
+}
+
+static int bench_pingpong(struct bench_stats *st)
+{
+	struct pingpong pp;
+	int efd, ret = 0;
+	pthread_t tid;
+	unsigned int n;
+	uint64_t t0;
+
+	pp.ping = create_monitor("ping", EVL_MONITOR_EVENT, EVL_EVENT_COUNT, 0);
+	if (pp.ping < 0)
+		return pp.ping;
+
+	pp.pong = create_monitor("pong", EVL_MONITOR_EVENT, EVL_EVENT_COUNT, 0);
+	if (pp.pong < 0) {
+		close(pp.ping);
+		return pp.pong;
+	}
+
+	efd = attach_self("ping", cpus[0], BENCH_PRIO);
+	if (efd < 0) {
+		ret = efd;
+		goto out;
+	}
+
+	pthread_barrier_init(&pp.barrier, NULL, 2);
+	if (pthread_create(&tid, NULL, pong_thread, &pp))
+		bail_out("ping", -EAGAIN);
+
+	pthread_barrier_wait(&pp.barrier);
+
+	for (n = 0; n < nr_iterations; n++) {
+		t0 = now_ns();
+		ret = sem_post(pp.ping) ?: sem_wait(pp.pong);
+		if (ret)
+			bail_out("ping", ret);
+		add_sample(st, now_ns() - t0);
+	}
+
+	pthread_join(tid, NULL);
+	pthread_barrier_destroy(&pp.barrier);
+	detach_self(efd);
+out:
+	close(pp.ping);
+	close(pp.pong);
+
+	return ret;
+}
+
+/*
+ * Cross-buffer throughput: an oob writer feeds an in-band reader,
+ * the samples are the oob_write() costs.
+ */
+
+struct xbuf_reader {
+	int fd;
+	uint64_t bytes;
+};
+
+static void *xbuf_reader_thread(void *arg)
+{
+	struct xbuf_reader *xr = arg;
+	char buf[XBUF_MSGSZ * 16];
+	uint64_t total = (uint64_t)nr_iterations * XBUF_MSGSZ;
+	ssize_t ret;
+
+	while (xr->bytes < total) {
+		ret = read(xr->fd, buf, sizeof(buf));
+		if (ret <= 0)
+			break;
+		xr->bytes += ret;
+	}
+
+	return NULL;
+}
+
+static int bench_xbuf(struct bench_stats *st)
+{
+	struct evl_xbuf_attrs attrs = {
+		.i_bufsz = 65536,
+		.o_bufsz = 65536,
+	};
+	struct xbuf_reader xr = { 0 };
+	char msg[XBUF_MSGSZ] = { 0 };
+	uint64_t t0, start;
+	int efd, ret = 0;
+	unsigned int n;
+	pthread_t tid;
+
+	xr.fd = create_element(EVL_XBUF_DEV, "xbuf", &attrs, EVL_CLONE_PRIVATE);
+	if (xr.fd < 0)
+		return xr.fd;
+
+	if (pthread_create(&tid, NULL, xbuf_reader_thread, &xr)) {
+		close(xr.fd);
+		return -EAGAIN;
+	}
+
+	efd = attach_self("xbuf", cpus[0], BENCH_PRIO);
+	if (efd < 0) {
+		pthread_cancel(tid);
+		pthread_join(tid, NULL);
+		ret = efd;
+		goto out;
+	}
+
+	start = now_ns();
+	for (n = 0; n < nr_iterations; n++) {
+		t0 = now_ns();
+		if (oob_write(xr.fd, msg, sizeof(msg)) != sizeof(msg)) {
+			ret = -errno;
+			pthread_cancel(tid);
+			break;
+		}
+		add_sample(st, now_ns() - t0);
+	}
+
+	detach_self(efd);
+	pthread_join(tid, NULL);
+	st->elapsed = now_ns() - start;
+	st->bytes = xr.bytes;
+out:
+	close(xr.fd);
+
+	return ret;
+}
+
+/* Proxy throughput, relaying oob writes to /dev/null. */
+static int bench_proxy(struct bench_stats *st)
+{
+	struct evl_proxy_attrs attrs = {
+		.bufsz = 65536,
+		.granularity = 0,
+	};
+	char msg[PROXY_MSGSZ] = { 0 };
+	int nullfd, proxyfd, efd, ret = 0;
+	uint64_t t0, start;
+	unsigned int n;
+	ssize_t len;
+
+	nullfd = open("/dev/null", O_WRONLY);
+	if (nullfd < 0)
+		return -errno;
+
+	attrs.fd = nullfd;
+	proxyfd = create_element(EVL_PROXY_DEV, "proxy", &attrs,
+				EVL_CLONE_PRIVATE|EVL_CLONE_OUTPUT);
+	if (proxyfd < 0) {
+		close(nullfd);
+		return proxyfd;
+	}
+
+	efd = attach_self("proxy", cpus[0], BENCH_PRIO);
+	if (efd < 0) {
+		ret = efd;
+		goto out;
+	}
+
+	start = now_ns();
+	for (n = 0; n < nr_iterations; n++) {
+		t0 = now_ns();
+		len = oob_write(proxyfd, msg, sizeof(msg));
+		if (len < 0) {
+			ret = -errno;
+			break;
+		}
+		add_sample(st, now_ns() - t0);
+		st->bytes += len;
+	}
+	st->elapsed = now_ns() - start;
+
+	detach_self(efd);
+out:
+	close(proxyfd);
+	close(nullfd);
+
+	return ret;
+}
+
+/*
+ * Observable fan-out: one notice wakes up all observers, the sample
+ * is the delay until the last of them received it.
+ */
+
+struct fanout {
+	int obsfd;
+	int ackfd;
+	uint64_t last_date;
+	pthread_mutex_t lock;
+	pthread_barrier_t barrier;
+};
+
+static void *observer_thread(void *arg)
+{
+	struct evl_subscription sub = { .backlog_count = 16 };
+	struct __evl_notification nf;
+	struct fanout *fo = arg;
+	uint64_t date;
+	unsigned int n;
+	int efd;
+
+	efd = attach_self("observer", cpus[1], BENCH_PRIO - 1);
+	if (efd < 0)
+		bail_out("observer", efd);
+
+	if (ioctl(fo->obsfd, EVL_OBSIOC_SUBSCRIBE, &sub))
+		bail_out("subscribe", -errno);
+
+	pthread_barrier_wait(&fo->barrier);
+
+	for (n = 0; n < nr_iterations; n++) {
+		if (oob_read(fo->obsfd, &nf, sizeof(nf)) != sizeof(nf))
+			bail_out("observer", -errno);
+		date = now_ns();
+		/* Only the latest receipt matters. */
+		pthread_mutex_lock(&fo->lock);
+		if (date > fo->last_date)
+			fo->last_date = date;
+		pthread_mutex_unlock(&fo->lock);
+		sem_post(fo->ackfd);
+	}
+
+	ioctl(fo->obsfd, EVL_OBSIOC_UNSUBSCRIBE);
+	detach_self(efd);
+
+	return NULL;
+}
+
+static int bench_fanout(struct bench_stats *st)
+{
+	pthread_t tids[MAX_OBSERVERS];
+	struct evl_notice ntc;
+	struct fanout fo;
+	int efd, ret = 0;
+	unsigned int n, m;
+	uint64_t t0;
+
+	fo.obsfd = create_element(EVL_OBSERVABLE_DEV, "observable", NULL,
+				EVL_CLONE_PRIVATE);
+	if (fo.obsfd < 0)
+		return fo.obsfd;
+
+	fo.ackfd = create_monitor("ack", EVL_MONITOR_EVENT, EVL_EVENT_COUNT, 0);
+	if (fo.ackfd < 0) {
+		close(fo.obsfd);
+		return fo.ackfd;
+	}
+
+	efd = attach_self("notifier", cpus[0], BENCH_PRIO);
+	if (efd < 0) {
+		ret = efd;
+		goto out;
+	}
+
+	pthread_mutex_init(&fo.lock, NULL);
+	pthread_barrier_init(&fo.barrier, NULL, nr_observers + 1);
+
+	for (m = 0; m < nr_observers; m++) {
+		if (pthread_create(&tids[m], NULL, observer_thread, &fo))
+			bail_out("observable", -EAGAIN);
+	}
+
+	pthread_barrier_wait(&fo.barrier);
+
+	for (n = 0; n < nr_iterations; n++) {
+		fo.last_date = 0;
+		ntc.tag = EVL_NOTICE_USER;
+		ntc.event = evl_intval(n);
+		t0 = now_ns();
+		if (oob_write(fo.obsfd, &ntc, sizeof(ntc)) != sizeof(ntc))
+			bail_out("notifier", -errno);
+		for (m = 0; m < nr_observers; m++) {
+			ret = sem_wait(fo.ackfd);
+			if (ret)
+				bail_out("notifier", ret);
+		}
+		add_sample(st, fo.last_date - t0);
+	}
+
+	for (m = 0; m < nr_observers; m++)
+		pthread_join(tids[m], NULL);
+
+	pthread_barrier_destroy(&fo.barrier);
+	pthread_mutex_destroy(&fo.lock);
+	detach_self(efd);
+out:
+	close(fo.ackfd);
+	close(fo.obsfd);
+
+	return ret;
+}
+
+/*
+ * Poll group wakeup: the sample is the delay from posting an event
+ * to the poller returning from EVL_POLIOC_WAIT on another CPU.
+ */
+
+struct pollwake {
+	int pollfd;
+	int eventfd;
+	int ackfd;
+	volatile uint64_t post_date;
+	uint64_t *deltas;
+	pthread_barrier_t barrier;
+};
+
+static void *poller_thread(void *arg)
+{
+	struct __evl_timespec timeout = { 0 };
+	struct pollwake *pw = arg;
+	struct evl_poll_event ev;
+	struct evl_poll_waitreq req = {
+		.timeout_ptr = (uintptr_t)&timeout,
+		.pollset_ptr = (uintptr_t)&ev,
+		.nrset = 1,
+	};
+	unsigned int n;
+	int efd, ret;
+
+	efd = attach_self("poller", cpus[1], BENCH_PRIO);
+	if (efd < 0)
+		bail_out("poller", efd);
+
+	pthread_barrier_wait(&pw->barrier);
+
+	for (n = 0; n < nr_iterations; n++) {
+		if (oob_ioctl(pw->pollfd, EVL_POLIOC_WAIT, &req) < 0)
+			bail_out("poller", -errno);
+		pw->deltas[n] = now_ns() - pw->post_date;
+		/* Consume the unit so that the event reads clear again. */
+		ret = sem_wait(pw->eventfd) ?: sem_post(pw->ackfd);
+		if (ret)
+			bail_out("poller", ret);
+	}
+
+	detach_self(efd);
+
+	return NULL;
+}
+
+static int bench_poll(struct bench_stats *st)
+{
+	struct evl_poll_ctlreq creq = { 0 };
+	int efd = -1, ret = 0;
+	struct pollwake pw;
+	unsigned int n;
+	pthread_t tid;
+
+	pw.deltas = st->samples;
+	pw.eventfd = pw.ackfd = -1;
+	pw.pollfd = create_element(EVL_POLL_DEV, "poll", NULL,
+				EVL_CLONE_PRIVATE);
+	if (pw.pollfd < 0)
+		return pw.pollfd;
+
+	pw.eventfd = create_monitor("pollev", EVL_MONITOR_EVENT,
+				EVL_EVENT_COUNT, 0);
+	if (pw.eventfd < 0) {
+		ret = pw.eventfd;
+		goto out;
+	}
+
+	pw.ackfd = create_monitor("pollack", EVL_MONITOR_EVENT,
+				EVL_EVENT_COUNT, 0);
+	if (pw.ackfd < 0) {
+		ret = pw.ackfd;
+		goto out;
+	}
+
+	creq.action = EVL_POLL_CTLADD;
+	creq.fd = pw.eventfd;
+	creq.events = POLLIN;
+	if (ioctl(pw.pollfd, EVL_POLIOC_CTL, &creq)) {
+		ret = -errno;
+		goto out;
+	}
+
+	efd = attach_self("pollpost", cpus[0], BENCH_PRIO);
+	if (efd < 0) {
+		ret = efd;
+		goto out;
+	}
+
+	pthread_barrier_init(&pw.barrier, NULL, 2);
+	if (pthread_create(&tid, NULL, poller_thread, &pw))
+		bail_out("poll", -EAGAIN);
+
+	pthread_barrier_wait(&pw.barrier);
+
+	for (n = 0; n < nr_iterations; n++) {
+		pw.post_date = now_ns();
+		ret = sem_post(pw.eventfd) ?: sem_wait(pw.ackfd);
+		if (ret)
+			bail_out("pollpost", ret);
+		st->count++;
+	}
+
+	pthread_join(tid, NULL);
+	pthread_barrier_destroy(&pw.barrier);
+out:
+	if (efd >= 0)
+		detach_self(efd);
+	if (pw.ackfd >= 0)
+		close(pw.ackfd);
+	if (pw.eventfd >= 0)
+		close(pw.eventfd);
+	close(pw.pollfd);
+
+	return ret;
+}
+
+/*
+ * Timerfd arming cost. The timer is armed a few tens of
+ * microseconds ahead each time, then waited for, so that arming
+ * always involves queuing into the timer base.
+ */
+static int bench_timerfd(struct bench_stats *st)
+{
+	struct __evl_itimerspec its = { 0 };
+	struct evl_timerfd_setreq sreq = {
+		.value_ptr = (uintptr_t)&its,
+	};
+	int tfd, efd, ret = 0;
+	uint64_t t0, ticks;
+	unsigned int n;
+
+	if (ioctl(clock_fd, EVL_CLKIOC_NEW_TIMER, &tfd))
+		return -errno;
+
+	efd = attach_self("timerfd", cpus[0], BENCH_PRIO);
+	if (efd < 0) {
+		close(tfd);
+		return efd;
+	}
+
+	for (n = 0; n < nr_iterations; n++) {
+		t0 = now_ns();
+		its.it_value.tv_sec = (t0 + 50000) / 1000000000ULL;
+		its.it_value.tv_nsec = (t0 + 50000) % 1000000000ULL;
+		if (oob_ioctl(tfd, EVL_TFDIOC_SET, &sreq)) {
+			ret = -errno;
+			break;
+		}
+		add_sample(st, now_ns() - t0);
+		if (oob_read(tfd, &ticks, sizeof(ticks)) != sizeof(ticks)) {
+			ret = -errno;
+			break;
+		}
+	}
+
+	detach_self(efd);
+	close(tfd);
+
+	return ret;
+}
+
+/*
+ * Oob UDP round trip to a peer echoing our datagrams, e.g. another
+ * instance of this program started with -s. The network device
+ * must have been switched to oob mode beforehand.
+ */
+
+static int parse_peer(const char *spec, struct sockaddr_in *sin)
+{
+	char host[64], *port;
+
+	snprintf(host, sizeof(host), "%s", spec);
+	port = strrchr(host, ':');
+	if (port == NULL)
+		return -EINVAL;
+
+	*port++ = '\0';
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_port = htons(atoi(port));
+
+	return inet_pton(AF_INET, host, &sin->sin_addr) == 1 ? 0 : -EINVAL;
+}
+
+static int udp_sendto(int s, void *buf, size_t len, struct sockaddr_in *sin)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	struct user_oob_msghdr msghdr = {
+		.name_ptr = (uintptr_t)sin,
+		.namelen = sizeof(*sin),
+		.iov_ptr = (uintptr_t)&iov,
+		.iovlen = 1,
+	};
+
+	return oob_ioctl(s, EVL_SOCKIOC_SENDMSG, &msghdr) < 0 ? -errno : 0;
+}
+
+static int udp_recvfrom(int s, void *buf, size_t len, struct sockaddr_in *sin)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	struct user_oob_msghdr msghdr = {
+		.name_ptr = (uintptr_t)sin,
+		.namelen = sizeof(*sin),
+		.iov_ptr = (uintptr_t)&iov,
+		.iovlen = 1,
+	};
+
+	return oob_ioctl(s, EVL_SOCKIOC_RECVMSG, &msghdr) < 0 ?
+		-errno : msghdr.count;
+}
+
+static int bench_udp(struct bench_stats *st)
+{
+	char msg[UDP_MSGSZ] = { 0 };
+	struct sockaddr_in peer, from;
+	int s, efd, ret;
+	unsigned int n;
+	uint64_t t0;
+
+	ret = parse_peer(udp_peer, &peer);
+	if (ret)
+		return ret;
+
+	s = socket(AF_INET, SOCK_DGRAM | SOCK_OOB, 0);
+	if (s < 0)
+		return -errno;
+
+	efd = attach_self("udp", cpus[0], BENCH_PRIO);
+	if (efd < 0) {
+		close(s);
+		return efd;
+	}
+
+	for (n = 0; n < nr_iterations; n++) {
+		t0 = now_ns();
+		ret = udp_sendto(s, msg, sizeof(msg), &peer);
+		if (ret)
+			break;
+		ret = udp_recvfrom(s, msg, sizeof(msg), &from);
+		if (ret < 0)
+			break;
+		add_sample(st, now_ns() - t0);
+		ret = 0;
+	}
+
+	detach_self(efd);
+	close(s);
+
+	return ret;
+}
+
+static int run_udp_echo(int port)
+{
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+	char buf[UDP_MSGSZ];
+	int s, efd, ret;
+
+	s = socket(AF_INET, SOCK_DGRAM | SOCK_OOB, 0);
+	if (s < 0 || bind(s, (struct sockaddr *)&sin, sizeof(sin)))
+		return -errno;
+
+	efd = attach_self("echo", cpus[0], BENCH_PRIO);
+	if (efd < 0)
+		return efd;
+
+	for (;;) {
+		ret = udp_recvfrom(s, buf, sizeof(buf), &sin);
+		if (ret < 0)
+			break;
+		ret = udp_sendto(s, buf, ret, &sin);
+		if (ret)
+			break;
+	}
+
+	detach_self(efd);
+	close(s);
+
+	return ret;
+}
+
+static const struct bench {
+	const char *name;
+	int (*run)(struct bench_stats *st);
+} benches[] = {
+	{ "oob_syscall", bench_syscall },
+	{ "gate_enter_exit", bench_gate },
+	{ "event_pingpong", bench_pingpong },
+	{ "xbuf_write", bench_xbuf },
+	{ "proxy_write", bench_proxy },
+	{ "observable_fanout", bench_fanout },
+	{ "poll_wakeup", bench_poll },
+	{ "timerfd_arm", bench_timerfd },
+	{ "udp_echo", bench_udp },
+};
+
+static void pick_cpus(void)
+{
+	cpu_set_t cpuset;
+	int cpu, n = 0;
+
+	if (cpus[0] >= 0 && cpus[1] >= 0)
+		return;
+
+	sched_getaffinity(0, sizeof(cpuset), &cpuset);
+	for (cpu = 0; cpu < CPU_SETSIZE && n < 2; cpu++) {
+		if (CPU_ISSET(cpu, &cpuset))
+			cpus[n++] = cpu;
+	}
+
+	/* Uniprocessor: ping-pong on the same CPU. */
+	if (n == 1)
+		cpus[1] = cpus[0];
+}
+
+static void usage(const char *arg0)
+{
+	fprintf(stderr,
+		"usage: %s [-n iterations] [-c cpu0,cpu1] [-o observers]\n"
+		"          [-t tag] [-u peer_ip:port] [-s port] [-j]\n",
+		arg0);
+	exit(KSFT_FAIL);
+}
+
+int main(int argc, char *const argv[])
+{
+	struct evl_core_info info;
+	struct bench_stats st;
+	struct utsname ubuf;
+	int ctlfd, c, ret, echo_port = 0;
+	unsigned int n, nr_failed = 0;
+
+	while ((c = getopt(argc, argv, "n:c:o:t:u:s:j")) != -1) {
+		switch (c) {
+		case 'n':
+			nr_iterations = atoi(optarg);
+			break;
+		case 'c':
+			if (sscanf(optarg, "%d,%d", &cpus[0], &cpus[1]) != 2)
+				usage(argv[0]);
+			break;
+		case 'o':
+			nr_observers = atoi(optarg);
+			if (nr_observers == 0 || nr_observers > MAX_OBSERVERS)
+				usage(argv[0]);
+			break;
+		case 't':
+			run_tag = optarg;
+			break;
+		case 'u':
+			udp_peer = optarg;
+			break;
+		case 's':
+			echo_port = atoi(optarg);
+			break;
+		case 'j':
+			json_only = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (nr_iterations == 0)
+		usage(argv[0]);
+
+	if (!json_only)
+		ksft_print_header();
+
+	ctlfd = open(EVL_CONTROL_DEV, O_RDWR);
+	if (ctlfd < 0)
+		ksft_exit_skip("EVL core not available\n");
+
+	if (ioctl(ctlfd, EVL_CTLIOC_GET_COREINFO, &info))
+		ksft_exit_fail_msg("cannot retrieve core information\n");
+
+	if (info.abi_current != EVL_ABI_LEVEL)
+		ksft_exit_skip("ABI mismatch (kernel %u, test %u)\n",
+			info.abi_current, EVL_ABI_LEVEL);
+
+	clock_fd = open(EVL_DEV_ROOT "/clock/monotonic", O_RDWR);
+	if (clock_fd < 0)
+		ksft_exit_fail_msg("cannot open EVL monotonic clock\n");
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE))
+		ksft_exit_fail_msg("mlockall: %s\n", strerror(errno));
+
+	pick_cpus();
+
+	if (echo_port)
+		return run_udp_echo(echo_port) ? KSFT_FAIL : KSFT_PASS;
+
+	uname(&ubuf);
+	if (json_only)
+		printf("{\"kernel\":\"%s\",\"version\":\"%s\",\"abi\":%u,"
+			"\"tag\":\"%s\",\"cpus\":[%d,%d]}\n",
+			ubuf.release, ubuf.version, info.abi_current,
+			run_tag, cpus[0], cpus[1]);
+	else
+		ksft_set_plan(ARRAY_SIZE(benches));
+
+	for (n = 0; n < ARRAY_SIZE(benches); n++) {
+		if (benches[n].run == bench_udp && udp_peer == NULL) {
+			if (!json_only)
+				ksft_test_result_skip("%s: no peer (-u)\n",
+						benches[n].name);
+			continue;
+		}
+
+		if (init_stats(&st, nr_iterations))
+			ksft_exit_fail_msg("out of memory\n");
+
+		ret = benches[n].run(&st);
+		if (!ret)
+			report(benches[n].name, &st);
+		else if (ret != -ENOENT && ret != -ENXIO)
+			nr_failed++;
+
+		if (!json_only) {
+			if (ret == -ENOENT || ret == -ENXIO)
+				ksft_test_result_skip("%s: %s\n",
+						benches[n].name, strerror(-ret));
+			else if (ret)
+				ksft_test_result_fail("%s: %s\n",
+						benches[n].name, strerror(-ret));
+			else
+				ksft_test_result_pass("%s\n", benches[n].name);
+		}
+
+		free_stats(&st);
+	}
+
+	close(clock_fd);
+	close(ctlfd);
+
+	if (json_only)
+		return nr_failed ? KSFT_FAIL : KSFT_PASS;
+
+	ksft_finished();
+}
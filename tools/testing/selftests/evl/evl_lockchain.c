@@ -0,0 +1,593 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Lock chain tests for the EVL core. This builds chains of threads
+ * each holding a gate while waiting for the next one, then checks
+ * that cyclic dependencies are detected, and compares the cost of
+ * entering a contended gate at the tail of a deep chain when this
+ * boosts every owner down the chain, with the cost of the same
+ * operation when no priority changes, in which case the core only
+ * checks the chain for cycles. Like evl_bench, this talks to the raw
+ * kernel ABI.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <evl/control-abi.h>
+#include <evl/factory-abi.h>
+#include <evl/syscall-abi.h>
+#include <evl/thread-abi.h>
+#include <evl/clock-abi.h>
+#include <evl/monitor-abi.h>
+
+#include "../kselftest.h"
+
+#ifndef PR_OOB_SYSCALL
+#define PR_OOB_SYSCALL	0x4f4f4243
+#endif
+
+#define EVL_DEV_ROOT	"/dev/evl"
+#define PI_WALKS_ATTR	"/sys/class/evl/control/pi_walks"
+#define LOW_PRIO	10
+#define HIGH_PRIO	90
+#define MAX_DEPTH	64
+/* Time given to a thread to block on a gate. */
+#define SETTLE_US	2000
+/* Timeout of contended entries in the chain benchmark. */
+#define ENTER_TMO_US	50
+
+static unsigned int nr_iterations = 1000;
+static unsigned int chain_depth = 16;
+static int test_cpu = -1;
+
+static int clock_fd = -1;
+
+static inline long oob_syscall(int nr, long a0, long a1, long a2)
+{
+	return syscall(__NR_prctl, PR_OOB_SYSCALL, nr, a0, a1, a2);
+}
+
+static inline long oob_ioctl(int fd, unsigned long req, void *arg)
+{
+	return oob_syscall(sys_evl_ioctl, fd, req, (long)arg);
+}
+
+static uint64_t evl_now_ns(void)
+{
+	struct __evl_timespec ts;
+
+	if (oob_ioctl(clock_fd, EVL_CLKIOC_GET_TIME, &ts))
+		return 0;
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct __evl_timespec ns_to_ts(uint64_t ns)
+{
+	struct __evl_timespec ts = {
+		.tv_sec = ns / 1000000000ULL,
+		.tv_nsec = ns % 1000000000ULL,
+	};
+
+	return ts;
+}
+
+static void oob_sleep_us(unsigned int us)
+{
+	struct __evl_timespec ts = ns_to_ts(evl_now_ns() + us * 1000ULL);
+
+	oob_ioctl(clock_fd, EVL_CLKIOC_SLEEP, &ts);
+}
+
+static int create_element(const char *type, const char *name,
+			void *attrs, int clone_flags)
+{
+	struct evl_clone_req req = { 0 };
+	char path[64], ename[64];
+	int clonefd, ret;
+
+	snprintf(path, sizeof(path), EVL_DEV_ROOT "/%s/clone", type);
+	clonefd = open(path, O_RDWR);
+	if (clonefd < 0)
+		return -errno;
+
+	snprintf(ename, sizeof(ename), "lockchain-%d-%s", getpid(), name);
+	req.name_ptr = (uintptr_t)ename;
+	req.attrs_ptr = (uintptr_t)attrs;
+	req.clone_flags = clone_flags;
+	ret = ioctl(clonefd, EVL_IOC_CLONE, &req);
+	if (ret)
+		ret = -errno;
+	else
+		ret = req.efd;
+
+	close(clonefd);
+
+	return ret;
+}
+
+/* All threads share a single CPU, so that priorities always matter. */
+static int attach_self(const char *name, int prio)
+{
+	struct evl_sched_attrs attrs = { 0 };
+	cpu_set_t cpuset;
+	int efd;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(test_cpu, &cpuset);
+	if (sched_setaffinity(0, sizeof(cpuset), &cpuset))
+		return -errno;
+
+	efd = create_element(EVL_THREAD_DEV, name, NULL, EVL_CLONE_PRIVATE);
+	if (efd < 0)
+		return efd;
+
+	attrs.sched_policy = SCHED_FIFO;
+	attrs.sched_priority = prio;
+	if (ioctl(efd, EVL_THRIOC_SET_SCHEDPARAM, &attrs) ||
+		oob_ioctl(efd, EVL_THRIOC_SWITCH_OOB, NULL)) {
+		close(efd);
+		return -errno;
+	}
+
+	return efd;
+}
+
+static void detach_self(int efd)
+{
+	ioctl(efd, EVL_THRIOC_DETACH_SELF);
+	close(efd);
+}
+
+static int create_gate(const char *name, int protocol, unsigned int ceiling)
+{
+	struct evl_monitor_attrs attrs = { 0 };
+
+	attrs.clockfd = clock_fd;
+	attrs.type = EVL_MONITOR_GATE;
+	attrs.protocol = protocol;
+	attrs.initval = ceiling;
+
+	return create_element(EVL_MONITOR_DEV, name, &attrs,
+			EVL_CLONE_PRIVATE);
+}
+
+static int create_sem(const char *name)
+{
+	struct evl_monitor_attrs attrs = { 0 };
+
+	attrs.clockfd = clock_fd;
+	attrs.type = EVL_MONITOR_EVENT;
+	attrs.protocol = EVL_EVENT_COUNT;
+
+	return create_element(EVL_MONITOR_DEV, name, &attrs,
+			EVL_CLONE_PRIVATE);
+}
+
+static int gate_enter(int gatefd)
+{
+	struct __evl_timespec timeout = { 0 }; /* Infinite. */
+
+	return oob_ioctl(gatefd, EVL_MONIOC_ENTER, &timeout) ? -errno : 0;
+}
+
+static int gate_enter_until(int gatefd, uint64_t date)
+{
+	struct __evl_timespec timeout = ns_to_ts(date);
+
+	return oob_ioctl(gatefd, EVL_MONIOC_ENTER, &timeout) ? -errno : 0;
+}
+
+static int gate_exit(int gatefd)
+{
+	return oob_ioctl(gatefd, EVL_MONIOC_EXIT, NULL) ? -errno : 0;
+}
+
+static int sem_post(int efd)
+{
+	__s32 count = 1;
+
+	return oob_ioctl(efd, EVL_MONIOC_SIGNAL, &count) ? -errno : 0;
+}
+
+static int sem_wait(int efd)
+{
+	struct __evl_timespec timeout = { 0 };
+	struct evl_monitor_waitreq req = {
+		.timeout_ptr = (uintptr_t)&timeout,
+		.gatefd = -1,
+	};
+
+	if (oob_ioctl(efd, EVL_MONIOC_WAIT, &req))
+		return -errno;
+
+	return req.status;
+}
+
+static void __noreturn bail_out(const char *what, int err)
+{
+	ksft_exit_fail_msg("%s: %s\n", what, strerror(-err));
+}
+
+/*
+ * Sum of the walk, hop and cutoff counts over all CPUs, if the core
+ * was built with CONFIG_EVL_RUNSTATS.
+ */
+struct walk_stats {
+	unsigned long walks, hops, cutoffs;
+};
+
+static bool read_walk_stats(struct walk_stats *ws)
+{
+	unsigned long walks, hops, cutoffs;
+	unsigned int max_depth;
+	int cpu;
+	FILE *fp;
+
+	memset(ws, 0, sizeof(*ws));
+
+	fp = fopen(PI_WALKS_ATTR, "r");
+	if (fp == NULL)
+		return false;
+
+	while (fscanf(fp, "%d %lu %lu %u %lu", &cpu, &walks, &hops,
+			&max_depth, &cutoffs) == 5) {
+		ws->walks += walks;
+		ws->hops += hops;
+		ws->cutoffs += cutoffs;
+	}
+
+	fclose(fp);
+
+	return true;
+}
+
+/*
+ * ABBA through a priority protected gate: the low priority thread
+ * holds the PI gate and waits on the PP gate, the high priority
+ * thread holds the PP gate then enters the PI gate. Boosting the
+ * low priority thread does not change the boost of the PP gate,
+ * but the cycle must be reported nevertheless, instead of both
+ * threads waiting forever.
+ */
+struct abba {
+	int pi_gate, pp_gate;
+	int held, done;
+};
+
+static void *abba_low_thread(void *arg)
+{
+	struct abba *ab = arg;
+	int efd, ret;
+
+	efd = attach_self("abba-low", LOW_PRIO);
+	if (efd < 0)
+		bail_out("abba-low", efd);
+
+	ret = gate_enter(ab->pi_gate) ?: sem_post(ab->held);
+	if (ret)
+		bail_out("abba-low", ret);
+
+	/* Blocks until the high priority thread gives up. */
+	ret = gate_enter(ab->pp_gate) ?: gate_exit(ab->pp_gate) ?:
+		gate_exit(ab->pi_gate) ?: sem_post(ab->done);
+	if (ret)
+		bail_out("abba-low", ret);
+
+	detach_self(efd);
+
+	return NULL;
+}
+
+static int test_abba(void)
+{
+	struct abba ab;
+	pthread_t tid;
+	int efd, ret;
+
+	ab.pi_gate = create_gate("abba-pi", EVL_GATE_PI, 0);
+	ab.pp_gate = create_gate("abba-pp", EVL_GATE_PP, HIGH_PRIO + 1);
+	ab.held = create_sem("abba-held");
+	ab.done = create_sem("abba-done");
+	if (ab.pi_gate < 0 || ab.pp_gate < 0 || ab.held < 0 || ab.done < 0)
+		return -ENOMEM;
+
+	efd = attach_self("abba-high", HIGH_PRIO);
+	if (efd < 0)
+		return efd;
+
+	ret = gate_enter(ab.pp_gate);
+	if (ret)
+		bail_out("abba-high", ret);
+
+	if (pthread_create(&tid, NULL, abba_low_thread, &ab))
+		bail_out("abba-high", -EAGAIN);
+
+	/* Let the low priority thread block on the PP gate. */
+	ret = sem_wait(ab.held);
+	if (ret)
+		bail_out("abba-high", ret);
+	oob_sleep_us(SETTLE_US);
+
+	ret = gate_enter(ab.pi_gate);
+	if (ret == 0)
+		gate_exit(ab.pi_gate);
+
+	gate_exit(ab.pp_gate);
+	sem_wait(ab.done);
+	pthread_join(tid, NULL);
+	detach_self(efd);
+
+	close(ab.done);
+	close(ab.held);
+	close(ab.pp_gate);
+	close(ab.pi_gate);
+
+	return ret == -EDEADLK ? 0 : -EPROTO;
+}
+
+/*
+ * Chain of @chain_depth low priority threads: link #n holds gate #n
+ * and waits for gate #n-1, the head gate #0 being held by a thread
+ * waiting for the release event.
+ */
+struct chain {
+	int gates[MAX_DEPTH + 1];
+	int ready, release;
+	pthread_t tids[MAX_DEPTH + 1];
+};
+
+struct link {
+	struct chain *chain;
+	unsigned int n;
+};
+
+static struct link links[MAX_DEPTH + 1];
+
+static void *link_thread(void *arg)
+{
+	struct link *l = arg;
+	struct chain *c = l->chain;
+	char name[32];
+	int efd, ret;
+
+	snprintf(name, sizeof(name), "link-%u", l->n);
+	efd = attach_self(name, LOW_PRIO);
+	if (efd < 0)
+		bail_out(name, efd);
+
+	ret = gate_enter(c->gates[l->n]) ?: sem_post(c->ready);
+	if (ret)
+		bail_out(name, ret);
+
+	if (l->n == 0)
+		ret = sem_wait(c->release);
+	else
+		ret = gate_enter(c->gates[l->n - 1]) ?:
+			gate_exit(c->gates[l->n - 1]);
+
+	ret = ret ?: gate_exit(c->gates[l->n]);
+	if (ret)
+		bail_out(name, ret);
+
+	detach_self(efd);
+
+	return NULL;
+}
+
+static int build_chain(struct chain *c)
+{
+	char name[32];
+	unsigned int n;
+	int ret;
+
+	c->ready = create_sem("ready");
+	c->release = create_sem("release");
+	if (c->ready < 0 || c->release < 0)
+		return -ENOMEM;
+
+	for (n = 0; n <= chain_depth; n++) {
+		snprintf(name, sizeof(name), "gate-%u", n);
+		c->gates[n] = create_gate(name, EVL_GATE_PI, 0);
+		if (c->gates[n] < 0)
+			return c->gates[n];
+	}
+
+	/* Link #n must own its gate before link #n+1 waits for it. */
+	for (n = 0; n <= chain_depth; n++) {
+		links[n].chain = c;
+		links[n].n = n;
+		if (pthread_create(&c->tids[n], NULL, link_thread, &links[n]))
+			return -EAGAIN;
+		ret = sem_wait(c->ready);
+		if (ret)
+			return ret;
+	}
+
+	oob_sleep_us(SETTLE_US);
+
+	return 0;
+}
+
+static void release_chain(struct chain *c)
+{
+	unsigned int n;
+
+	sem_post(c->release);
+
+	for (n = 0; n <= chain_depth; n++) {
+		pthread_join(c->tids[n], NULL);
+		close(c->gates[n]);
+	}
+
+	close(c->release);
+	close(c->ready);
+}
+
+/*
+ * Enter the tail gate with a short timeout, boosting every owner down
+ * the chain if @prio is higher than theirs, then unboosting them on
+ * timeout. Report the average overhead over the timeout, and the
+ * count of hops the core walked per entry.
+ */
+static int bench_chain(struct chain *c, int efd, const char *label, int prio)
+{
+	struct evl_sched_attrs attrs = { 0 };
+	uint64_t t0, date, overhead = 0;
+	struct walk_stats ws0, ws1;
+	bool has_stats;
+	unsigned int n;
+	int ret = 0;
+
+	attrs.sched_policy = SCHED_FIFO;
+	attrs.sched_priority = prio;
+	if (ioctl(efd, EVL_THRIOC_SET_SCHEDPARAM, &attrs))
+		return -errno;
+
+	has_stats = read_walk_stats(&ws0);
+
+	for (n = 0; n < nr_iterations; n++) {
+		t0 = evl_now_ns();
+		date = t0 + ENTER_TMO_US * 1000ULL;
+		ret = gate_enter_until(c->gates[chain_depth], date);
+		if (ret != -ETIMEDOUT) {
+			if (ret == 0)
+				gate_exit(c->gates[chain_depth]);
+			ret = ret ?: -EPROTO;
+			break;
+		}
+		overhead += evl_now_ns() - date;
+		ret = 0;
+	}
+
+	if (ret)
+		return ret;
+
+	ksft_print_msg("%s: depth %u, avg overhead %llu ns\n", label,
+		chain_depth, (unsigned long long)(overhead / nr_iterations));
+
+	if (has_stats && read_walk_stats(&ws1))
+		ksft_print_msg("%s: %.1f hops/walk, %lu walks cut off\n",
+			label, ws1.walks > ws0.walks ?
+			(double)(ws1.hops - ws0.hops) /
+			(ws1.walks - ws0.walks) : 0.0,
+			ws1.cutoffs - ws0.cutoffs);
+
+	return 0;
+}
+
+static int test_chain(void)
+{
+	struct chain c;
+	int efd, ret;
+
+	/* Same priority as the links while building the chain. */
+	efd = attach_self("chain-tail", LOW_PRIO);
+	if (efd < 0)
+		return efd;
+
+	ret = build_chain(&c);
+	if (ret)
+		bail_out("chain", ret);
+
+	/* No boost, cycle check only. */
+	ret = bench_chain(&c, efd, "chain-noboost", LOW_PRIO);
+	if (ret == 0)
+		ret = bench_chain(&c, efd, "chain-boost", HIGH_PRIO);
+
+	release_chain(&c);
+	detach_self(efd);
+
+	return ret;
+}
+
+static void usage(const char *arg0)
+{
+	fprintf(stderr, "usage: %s [-n iterations] [-d depth] [-c cpu]\n",
+		arg0);
+	exit(KSFT_FAIL);
+}
+
+int main(int argc, char *const argv[])
+{
+	struct evl_core_info info;
+	cpu_set_t cpuset;
+	int ctlfd, c, ret;
+
+	while ((c = getopt(argc, argv, "n:d:c:")) != -1) {
+		switch (c) {
+		case 'n':
+			nr_iterations = atoi(optarg);
+			break;
+		case 'd':
+			chain_depth = atoi(optarg);
+			break;
+		case 'c':
+			test_cpu = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (nr_iterations == 0 || chain_depth == 0 || chain_depth > MAX_DEPTH)
+		usage(argv[0]);
+
+	ksft_print_header();
+
+	ctlfd = open(EVL_CONTROL_DEV, O_RDWR);
+	if (ctlfd < 0)
+		ksft_exit_skip("EVL core not available\n");
+
+	if (ioctl(ctlfd, EVL_CTLIOC_GET_COREINFO, &info))
+		ksft_exit_fail_msg("cannot retrieve core information\n");
+
+	if (info.abi_current != EVL_ABI_LEVEL)
+		ksft_exit_skip("ABI mismatch (kernel %u, test %u)\n",
+			info.abi_current, EVL_ABI_LEVEL);
+
+	clock_fd = open(EVL_DEV_ROOT "/clock/monotonic", O_RDWR);
+	if (clock_fd < 0)
+		ksft_exit_fail_msg("cannot open EVL monotonic clock\n");
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE))
+		ksft_exit_fail_msg("mlockall: %s\n", strerror(errno));
+
+	if (test_cpu < 0) {
+		sched_getaffinity(0, sizeof(cpuset), &cpuset);
+		for (test_cpu = 0; !CPU_ISSET(test_cpu, &cpuset); test_cpu++)
+			;
+	}
+
+	ksft_set_plan(2);
+
+	ret = test_abba();
+	if (ret)
+		ksft_test_result_fail("abba_deadlock: %s\n", strerror(-ret));
+	else
+		ksft_test_result_pass("abba_deadlock\n");
+
+	ret = test_chain();
+	if (ret)
+		ksft_test_result_fail("deep_chain: %s\n", strerror(-ret));
+	else
+		ksft_test_result_pass("deep_chain\n");
+
+	close(clock_fd);
+	close(ctlfd);
+
+	ksft_finished();
+}